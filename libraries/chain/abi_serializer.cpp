@@ -3,6 +3,7 @@
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
@@ -46,14 +47,125 @@ namespace eosio { namespace chain {
       );
    }
 
+   inline void append_json( const fc::variant& v, std::string& out ) {
+      out += fc::json::to_string( v, fc::time_point::maximum() );
+   }
+
+   template <typename T>
+   void integer_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      T v;
+      fc::raw::unpack( stream, v );
+      if constexpr( sizeof(T) <= 4 ) {
+         out += std::to_string( v );
+      } else if constexpr( std::is_signed_v<T> ) {
+         // fc::json quotes integers that do not fit in 32 bits, leave those to it
+         if( v <= T(0xffffffff) && v >= -T(0xffffffff) ) out += std::to_string( v );
+         else append_json( fc::variant( v ), out );
+      } else {
+         if( v <= T(0xffffffff) ) out += std::to_string( v );
+         else append_json( fc::variant( v ), out );
+      }
+   }
+
+   template <typename T>
+   void varint_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      T v;
+      fc::raw::unpack( stream, v );
+      out += std::to_string( v.value );
+   }
+
+   void name_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      name n;
+      fc::raw::unpack( stream, n );
+      // name characters never need escaping
+      char buf[name::max_length + 2];
+      buf[0] = '"';
+      char* end = n.to_chars( buf + 1 );
+      *end++ = '"';
+      out.append( buf, end );
+   }
+
+   /// symbol names are upper case letters once valid, which never need escaping
+   template <typename T>
+   void symbol_string_to_json( const T& v, std::string& out ) {
+      char buf[T::max_string_length + 2];
+      buf[0] = '"';
+      char* end = v.to_chars( buf + 1 );
+      *end++ = '"';
+      out.append( buf, end );
+   }
+
+   void symbol_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      symbol s;
+      fc::raw::unpack( stream, s );
+      symbol_string_to_json( s, out );
+   }
+
+   void asset_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      asset a;
+      fc::raw::unpack( stream, a );
+      symbol_string_to_json( a, out );
+   }
+
+   template <typename T>
+   void key_string_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      T v;
+      fc::raw::unpack( stream, v );
+      // base58 and the key type prefixes never need escaping
+      out += '"';
+      out += key_string_cache::instance().to_string( v );
+      out += '"';
+   }
+
+   void symbol_code_to_json( fc::datastream<const char*>& stream, std::string& out ) {
+      symbol_code sc;
+      fc::raw::unpack( stream, sc );
+      const symbol s( sc.value << 8 );
+      char buf[symbol::max_name_length + 2];
+      buf[0] = '"';
+      char* end = s.name_to_chars( buf + 1 );
+      *end++ = '"';
+      out.append( buf, end );
+   }
+
    abi_serializer::abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time ) {
       configure_built_in_types();
       set_abi(abi, max_serialization_time);
    }
 
+   abi_serializer::abi_serializer( const abi_serializer& other )
+   : typedefs( other.typedefs )
+   , structs( other.structs )
+   , actions( other.actions )
+   , tables( other.tables )
+   , error_messages( other.error_messages )
+   , variants( other.variants )
+   , built_in_types( other.built_in_types )
+   , built_in_json_writers( other.built_in_json_writers )
+   {
+      // compiled types point into the maps of the serializer they were compiled for
+      if( !other.compiled_types.empty() ) {
+         impl::abi_traverse_context ctx( fc::microseconds::maximum() );
+         compile_types( ctx );
+      }
+   }
+
+   abi_serializer& abi_serializer::operator=( const abi_serializer& other ) {
+      if( this != &other ) {
+         *this = abi_serializer( other );
+      }
+      return *this;
+   }
+
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      built_in_json_writers.erase( name );
+      // a built-in takes precedence over ABI types of the same name
+      if( !compiled_types.empty() ) {
+         impl::abi_traverse_context ctx( fc::microseconds::maximum() );
+         compile_types( ctx );
+      }
    }
 
    void abi_serializer::configure_built_in_types() {
@@ -97,6 +209,25 @@ namespace eosio { namespace chain {
       built_in_types.emplace("symbol_code",               pack_unpack<symbol_code>());
       built_in_types.emplace("asset",                     pack_unpack<asset>());
       built_in_types.emplace("extended_asset",            pack_unpack<extended_asset>());
+
+      // same unpacked types as above, bool is unpacked as uint8
+      built_in_json_writers.emplace("bool",               &integer_to_json<uint8_t>);
+      built_in_json_writers.emplace("int8",               &integer_to_json<int8_t>);
+      built_in_json_writers.emplace("uint8",              &integer_to_json<uint8_t>);
+      built_in_json_writers.emplace("int16",              &integer_to_json<int16_t>);
+      built_in_json_writers.emplace("uint16",             &integer_to_json<uint16_t>);
+      built_in_json_writers.emplace("int32",              &integer_to_json<int32_t>);
+      built_in_json_writers.emplace("uint32",             &integer_to_json<uint32_t>);
+      built_in_json_writers.emplace("int64",              &integer_to_json<int64_t>);
+      built_in_json_writers.emplace("uint64",             &integer_to_json<uint64_t>);
+      built_in_json_writers.emplace("varint32",           &varint_to_json<fc::signed_int>);
+      built_in_json_writers.emplace("varuint32",          &varint_to_json<fc::unsigned_int>);
+      built_in_json_writers.emplace("name",               &name_to_json);
+      built_in_json_writers.emplace("symbol",             &symbol_to_json);
+      built_in_json_writers.emplace("symbol_code",        &symbol_code_to_json);
+      built_in_json_writers.emplace("asset",              &asset_to_json);
+      built_in_json_writers.emplace("public_key",         &key_string_to_json<public_key_type>);
+      built_in_json_writers.emplace("signature",          &key_string_to_json<signature_type>);
    }
 
    void abi_serializer::set_abi(const abi_def& abi, const fc::microseconds& max_serialization_time) {
@@ -104,6 +235,8 @@ namespace eosio { namespace chain {
 
       EOS_ASSERT(starts_with(abi.version, "eosio::abi/1."), unsupported_abi_version_exception, "ABI has an unsupported version");
 
+      compiled_type_index.clear();
+      compiled_types.clear();
       typedefs.clear();
       structs.clear();
       actions.clear();
@@ -144,6 +277,100 @@ namespace eosio { namespace chain {
       EOS_ASSERT( variants.size() == abi.variants.value.size(), duplicate_abi_variant_def_exception, "duplicate variant definition detected" );
 
       validate(ctx);
+      compile_types(ctx);
+   }
+
+   void abi_serializer::compile_types( impl::abi_traverse_context& ctx ) {
+      compiled_type_index.clear();
+      compiled_types.clear();
+
+      // types are created when first referenced and filled in afterwards, so recursive and deeply nested
+      // types neither recurse here nor get compiled twice
+      vector<compiled_type*> pending;
+      for( const auto& t : typedefs )
+         compile_type( t.first, pending );
+      for( const auto& s : structs )
+         compile_type( s.first, pending );
+      for( const auto& v : variants )
+         compile_type( v.first, pending );
+      for( const auto& a : actions )
+         compile_type( a.second, pending );
+      for( const auto& t : tables )
+         compile_type( t.second, pending );
+
+      while( !pending.empty() ) {
+         ctx.check_deadline();
+         compiled_type& c = *pending.back();
+         pending.pop_back();
+
+         // same resolution order as the uncompiled _binary_to_variant and _variant_to_binary
+         auto rtype = resolve_type( c.name );
+         auto ftype = fundamental_type( rtype );
+         auto btype = built_in_types.find( ftype );
+         if( btype != built_in_types.end() ) {
+            c.kind = compiled_type::kind_type::built_in;
+            c.fundamental = type_name( ftype );
+            c.built_in = &btype->second;
+            c.built_in_array = is_array( rtype );
+            c.built_in_optional = is_optional( rtype );
+            auto jw = built_in_json_writers.find( ftype );
+            if( jw != built_in_json_writers.end() && !c.built_in_array && !c.built_in_optional )
+               c.built_in_json = jw->second;
+         } else if( is_array( rtype ) ) {
+            c.kind = compiled_type::kind_type::array;
+            c.element = compile_type( ftype, pending );
+         } else if( is_optional( rtype ) ) {
+            c.kind = compiled_type::kind_type::optional;
+            c.element = compile_type( ftype, pending );
+         } else if( auto v_itr = variants.find( rtype ); v_itr != variants.end() ) {
+            c.kind = compiled_type::kind_type::variant;
+            c.variant_itr = v_itr;
+            for( const auto& t : v_itr->second.types )
+               c.variant_types.push_back( compile_type( t, pending ) );
+         } else if( auto s_itr = structs.find( rtype ); s_itr != structs.end() ) {
+            c.kind = compiled_type::kind_type::structure;
+            c.struct_itr = s_itr;
+            const auto& st = s_itr->second;
+            if( st.base != type_name() )
+               c.base = compile_type( resolve_type( st.base ), pending );
+            c.fields.reserve( st.fields.size() );
+            for( const auto& f : st.fields ) {
+               const bool extension = ends_with( f.type, "$" );
+               c.fields.push_back( { compile_type( extension ? _remove_bin_extension( f.type ) : std::string_view( f.type ), pending ),
+                                     extension, fc::json::to_string( fc::variant( f.name ), fc::time_point::maximum() ) + ':' } );
+            }
+            // a repeated name replaces the earlier value in the variant object, only binary_to_variant handles that
+            std::set<std::string_view> names;
+            c.unique_fields = true;
+            for( const struct_def* cur = &st; cur != nullptr && c.unique_fields; ) {
+               for( const auto& f : cur->fields )
+                  c.unique_fields &= names.insert( f.name ).second;
+               if( cur->base == type_name() ) break;
+               auto b_itr = structs.find( resolve_type( cur->base ) );
+               cur = b_itr != structs.end() ? &b_itr->second : nullptr;
+               c.unique_fields &= cur != nullptr;
+            }
+         }
+      }
+   }
+
+   abi_serializer::compiled_type* abi_serializer::compile_type( const std::string_view& type, vector<compiled_type*>& pending ) {
+      auto itr = compiled_type_index.find( type );
+      if( itr != compiled_type_index.end() )
+         return itr->second;
+
+      compiled_type& c = compiled_types.emplace_back();
+      c.name = type_name( type );
+      compiled_type_index.emplace( c.name, &c );
+      pending.push_back( &c );
+      return &c;
+   }
+
+   const abi_serializer::compiled_type* abi_serializer::find_compiled_type( const std::string_view& type )const {
+      auto itr = compiled_type_index.find( type );
+      if( itr == compiled_type_index.end() || itr->second->kind == compiled_type::kind_type::unknown )
+         return nullptr;
+      return itr->second;
    }
 
    bool abi_serializer::is_builtin_type(const std::string_view& type)const {
@@ -312,6 +539,9 @@ namespace eosio { namespace chain {
    fc::variant abi_serializer::_binary_to_variant( const std::string_view& type, fc::datastream<const char *>& stream,
                                                    impl::binary_to_variant_context& ctx )const
    {
+      if( const auto* c = find_compiled_type(type) ) {
+         return _binary_to_variant(*c, stream, ctx);
+      }
       auto h = ctx.enter_scope();
       auto rtype = resolve_type(type);
       auto ftype = fundamental_type(rtype);
@@ -374,6 +604,212 @@ namespace eosio { namespace chain {
       return fc::variant( std::move(mvo) );
    }
 
+   void abi_serializer::_binary_to_variant( const compiled_type& type, fc::datastream<const char *>& stream,
+                                            fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      ctx.hint_struct_type_if_in_array( type.struct_itr );
+      const auto& st = type.struct_itr->second;
+      if( type.base ) {
+         _binary_to_variant(*type.base, stream, obj, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         const auto& compiled_field = type.fields[i];
+         encountered_extension |= compiled_field.extension;
+         if( !stream.remaining() ) {
+            if( compiled_field.extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = type.struct_itr, .field_ordinal = i } );
+         obj( field.name, _binary_to_variant(*compiled_field.type, stream, ctx) );
+      }
+   }
+
+   fc::variant abi_serializer::_binary_to_variant( const compiled_type& type, fc::datastream<const char *>& stream,
+                                                   impl::binary_to_variant_context& ctx )const
+   {
+      using kind_type = compiled_type::kind_type;
+      if( type.kind == kind_type::unknown ) {
+         return _binary_to_variant(std::string_view(type.name), stream, ctx);
+      }
+      auto h = ctx.enter_scope();
+      switch( type.kind ) {
+         case kind_type::built_in:
+            try {
+               return type.built_in->first(stream, type.built_in_array, type.built_in_optional);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                      ("class", type.built_in_array ? "array of built-in" : type.built_in_optional ? "optional of built-in" : "built-in")
+                                      ("type", impl::limit_size(type.fundamental))("p", ctx.get_path_string()) )
+         case kind_type::array: {
+            ctx.hint_array_type_if_in_array();
+            fc::unsigned_int size;
+            try {
+               fc::raw::unpack(stream, size);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+            vector<fc::variant> vars;
+            auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+            for( decltype(size.value) i = 0; i < size; ++i ) {
+               ctx.set_array_index_of_path_back(i);
+               auto v = _binary_to_variant(*type.element, stream, ctx);
+               EOS_ASSERT( !v.is_null(), unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+               vars.emplace_back(std::move(v));
+            }
+            return fc::variant( std::move(vars) );
+         }
+         case kind_type::optional: {
+            char flag;
+            try {
+               fc::raw::unpack(stream, flag);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+            return flag ? _binary_to_variant(*type.element, stream, ctx) : fc::variant();
+         }
+         case kind_type::variant: {
+            ctx.hint_variant_type_if_in_array( type.variant_itr );
+            fc::unsigned_int select;
+            try {
+               fc::raw::unpack(stream, select);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+            EOS_ASSERT( (size_t)select < type.variant_types.size(), unpack_exception,
+                        "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = type.variant_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+            return vector<fc::variant>{type.variant_itr->second.types[select], _binary_to_variant(*type.variant_types[select], stream, ctx)};
+         }
+         default:
+            break;
+      }
+
+      fc::mutable_variant_object mvo;
+      _binary_to_variant(type, stream, mvo, ctx);
+      EOS_ASSERT( mvo.size() > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      return fc::variant( std::move(mvo) );
+   }
+
+   void abi_serializer::_binary_to_json_fields( const compiled_type& type, fc::datastream<const char *>& stream, std::string& out,
+                                                impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      ctx.hint_struct_type_if_in_array( type.struct_itr );
+      const auto& st = type.struct_itr->second;
+      if( type.base ) {
+         _binary_to_json_fields(*type.base, stream, out, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         const auto& compiled_field = type.fields[i];
+         encountered_extension |= compiled_field.extension;
+         if( !stream.remaining() ) {
+            if( compiled_field.extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = type.struct_itr, .field_ordinal = i } );
+         if( out.back() != '{' ) out += ',';
+         out += compiled_field.json_key;
+         _binary_to_json(*compiled_field.type, stream, out, ctx);
+      }
+   }
+
+   bool abi_serializer::_binary_to_json( const compiled_type& type, fc::datastream<const char *>& stream, std::string& out,
+                                         impl::binary_to_variant_context& ctx )const
+   {
+      using kind_type = compiled_type::kind_type;
+      if( type.kind == kind_type::unknown ) {
+         auto v = _binary_to_variant(std::string_view(type.name), stream, ctx);
+         append_json( v, out );
+         return !v.is_null();
+      }
+      auto h = ctx.enter_scope();
+      switch( type.kind ) {
+         case kind_type::built_in:
+            try {
+               if( type.built_in_json ) {
+                  type.built_in_json(stream, out);
+                  return true;
+               }
+               auto v = type.built_in->first(stream, type.built_in_array, type.built_in_optional);
+               append_json( v, out );
+               return !v.is_null();
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                      ("class", type.built_in_array ? "array of built-in" : type.built_in_optional ? "optional of built-in" : "built-in")
+                                      ("type", impl::limit_size(type.fundamental))("p", ctx.get_path_string()) )
+         case kind_type::array: {
+            ctx.hint_array_type_if_in_array();
+            fc::unsigned_int size;
+            try {
+               fc::raw::unpack(stream, size);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+            out += '[';
+            auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+            for( decltype(size.value) i = 0; i < size; ++i ) {
+               ctx.set_array_index_of_path_back(i);
+               if( i > 0 ) out += ',';
+               EOS_ASSERT( _binary_to_json(*type.element, stream, out, ctx), unpack_exception,
+                           "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+            }
+            out += ']';
+            return true;
+         }
+         case kind_type::optional: {
+            char flag;
+            try {
+               fc::raw::unpack(stream, flag);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+            if( flag ) return _binary_to_json(*type.element, stream, out, ctx);
+            out += "null";
+            return false;
+         }
+         case kind_type::variant: {
+            ctx.hint_variant_type_if_in_array( type.variant_itr );
+            fc::unsigned_int select;
+            try {
+               fc::raw::unpack(stream, select);
+            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+            EOS_ASSERT( (size_t)select < type.variant_types.size(), unpack_exception,
+                        "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = type.variant_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+            out += '[';
+            append_json( fc::variant( type.variant_itr->second.types[select] ), out );
+            out += ',';
+            _binary_to_json(*type.variant_types[select], stream, out, ctx);
+            out += ']';
+            return true;
+         }
+         default:
+            break;
+      }
+
+      if( !type.unique_fields ) {
+         fc::mutable_variant_object mvo;
+         _binary_to_variant(type, stream, mvo, ctx);
+         EOS_ASSERT( mvo.size() > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+         append_json( fc::variant( std::move(mvo) ), out );
+         return true;
+      }
+      out += '{';
+      _binary_to_json_fields(type, stream, out, ctx);
+      EOS_ASSERT( out.back() != '{', unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      out += '}';
+      return true;
+   }
+
    fc::variant abi_serializer::_binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
@@ -393,8 +829,37 @@ namespace eosio { namespace chain {
       return _binary_to_variant(type, binary, ctx);
    }
 
+   void abi_serializer::binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, std::string& out,
+                                        const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
+      if( const auto* c = find_compiled_type(type) ) {
+         _binary_to_json(*c, binary, out, ctx);
+      } else {
+         append_json( _binary_to_variant(type, binary, ctx), out );
+      }
+   }
+
+   std::string abi_serializer::binary_to_json( const std::string_view& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
+      auto h = ctx.enter_scope();
+      fc::datastream<const char*> ds( binary.data(), binary.size() );
+      std::string out;
+      if( const auto* c = find_compiled_type(type) ) {
+         _binary_to_json(*c, ds, out, ctx);
+      } else {
+         append_json( _binary_to_variant(type, ds, ctx), out );
+      }
+      return out;
+   }
+
    void abi_serializer::_variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
    { try {
+      if( const auto* c = find_compiled_type(type) ) {
+         _variant_to_binary(*c, var, ds, ctx);
+         return;
+      }
       auto h = ctx.enter_scope();
       auto rtype = resolve_type(type);
 
@@ -498,6 +963,125 @@ namespace eosio { namespace chain {
       }
    } FC_CAPTURE_AND_RETHROW() }
 
+   void abi_serializer::_variant_to_binary( const compiled_type& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
+   { try {
+      using kind_type = compiled_type::kind_type;
+      if( type.kind == kind_type::unknown ) {
+         _variant_to_binary(std::string_view(type.name), var, ds, ctx);
+         return;
+      }
+      auto h = ctx.enter_scope();
+
+      switch( type.kind ) {
+         case kind_type::built_in:
+            type.built_in->second(var, ds, type.built_in_array, type.built_in_optional);
+            break;
+         case kind_type::array: {
+            ctx.hint_array_type_if_in_array();
+            const vector<fc::variant>& vars = var.get_array();
+            fc::raw::pack(ds, (fc::unsigned_int)vars.size());
+
+            auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+            auto h2 = ctx.disallow_extensions_unless(false);
+
+            int64_t i = 0;
+            for (const auto& var : vars) {
+               ctx.set_array_index_of_path_back(i);
+               _variant_to_binary(*type.element, var, ds, ctx);
+               ++i;
+            }
+            break;
+         }
+         case kind_type::optional: {
+            char flag = !var.is_null();
+            fc::raw::pack(ds, flag);
+            if( flag ) {
+               _variant_to_binary(*type.element, var, ds, ctx);
+            }
+            break;
+         }
+         case kind_type::variant: {
+            ctx.hint_variant_type_if_in_array( type.variant_itr );
+            const auto& v = type.variant_itr->second;
+            EOS_ASSERT( var.is_array() && var.size() == 2, pack_exception,
+                       "Expected input to be an array of two items while processing variant '${p}'", ("p", ctx.get_path_string()) );
+            EOS_ASSERT( var[size_t(0)].is_string(), pack_exception,
+                       "Encountered non-string as first item of input array while processing variant '${p}'", ("p", ctx.get_path_string()) );
+            const auto& variant_type_str = var[size_t(0)].get_string();
+            auto it = find(v.types.begin(), v.types.end(), variant_type_str);
+            EOS_ASSERT( it != v.types.end(), pack_exception,
+                        "Specified type '${t}' in input array is not valid within the variant '${p}'",
+                        ("t", ctx.maybe_shorten(variant_type_str))("p", ctx.get_path_string()) );
+            const uint32_t ordinal = it - v.types.begin();
+            fc::raw::pack(ds, fc::unsigned_int(ordinal));
+            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = type.variant_itr, .variant_ordinal = ordinal } );
+            _variant_to_binary( *type.variant_types[ordinal], var[size_t(1)], ds, ctx );
+            break;
+         }
+         case kind_type::structure: {
+            ctx.hint_struct_type_if_in_array( type.struct_itr );
+            const auto& st = type.struct_itr->second;
+
+            if( var.is_object() ) {
+               const auto& vo = var.get_object();
+
+               if( type.base ) {
+                  auto h2 = ctx.disallow_extensions_unless(false);
+                  _variant_to_binary(*type.base, var, ds, ctx);
+               }
+               bool disallow_additional_fields = false;
+               for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+                  const auto& field = st.fields[i];
+                  const auto& compiled_field = type.fields[i];
+                  auto field_itr = vo.find( string(field.name).c_str() );
+                  if( field_itr != vo.end() ) {
+                     if( disallow_additional_fields )
+                        EOS_THROW( pack_exception, "Unexpected field '${f}' found in input object while processing struct '${p}'",
+                                   ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+                     {
+                        auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = type.struct_itr, .field_ordinal = i } );
+                        auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
+                        _variant_to_binary(*compiled_field.type, field_itr->value(), ds, ctx);
+                     }
+                  } else if( compiled_field.extension && ctx.extensions_allowed() ) {
+                     disallow_additional_fields = true;
+                  } else if( disallow_additional_fields ) {
+                     EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                                ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+                  } else {
+                     EOS_THROW( pack_exception, "Missing field '${f}' in input object while processing struct '${p}'",
+                                ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+                  }
+               }
+            } else if( var.is_array() ) {
+               const auto& va = var.get_array();
+               EOS_ASSERT( st.base == type_name(), invalid_type_inside_abi,
+                           "Using input array to specify the fields of the derived struct '${p}'; input arrays are currently only allowed for structs without a base",
+                           ("p",ctx.get_path_string()) );
+               for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+                  const auto& field = st.fields[i];
+                  const auto& compiled_field = type.fields[i];
+                  if( va.size() > i ) {
+                     auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = type.struct_itr, .field_ordinal = i } );
+                     auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
+                     _variant_to_binary(*compiled_field.type, va[i], ds, ctx);
+                  } else if( compiled_field.extension && ctx.extensions_allowed() ) {
+                     break;
+                  } else {
+                     EOS_THROW( pack_exception, "Early end to input array specifying the fields of struct '${p}'; require input for field '${f}'",
+                                ("p", ctx.get_path_string())("f", ctx.maybe_shorten(field.name)) );
+                  }
+               }
+            } else {
+               EOS_THROW( pack_exception, "Unexpected input encountered while processing struct '${p}'", ("p",ctx.get_path_string()) );
+            }
+            break;
+         }
+         default:
+            break;
+      }
+   } FC_CAPTURE_AND_RETHROW() }
+
    bytes abi_serializer::_variant_to_binary( const std::string_view& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const
    { try {
       auto h = ctx.enter_scope();
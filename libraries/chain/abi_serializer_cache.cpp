@@ -0,0 +1,137 @@
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      struct abi_cache_key {
+         account_name account;
+         uint64_t     abi_sequence = 0;
+
+         friend bool operator==( const abi_cache_key& a, const abi_cache_key& b ) {
+            return a.account == b.account && a.abi_sequence == b.abi_sequence;
+         }
+      };
+
+      struct abi_cache_key_hash {
+         size_t operator()( const abi_cache_key& k )const {
+            return std::hash<uint64_t>()( k.account.to_uint64_t() ) ^ ( std::hash<uint64_t>()( k.abi_sequence ) << 1 );
+         }
+      };
+
+      struct abi_cache_entry {
+         abi_cache_key                              key;
+         std::string                                abi; ///< packed abi_def the serializer was built from
+         abi_serializer_cache::abi_serializer_ptr   serializer;
+
+         bool built_from( const shared_blob& a )const {
+            return abi.size() == a.size() && std::memcmp( abi.data(), a.data(), a.size() ) == 0;
+         }
+      };
+
+      struct by_key;
+      using abi_cache_index = boost::multi_index_container<
+         abi_cache_entry,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique< boost::multi_index::tag<by_key>,
+               boost::multi_index::member<abi_cache_entry, abi_cache_key, &abi_cache_entry::key>, abi_cache_key_hash >
+         >
+      >;
+
+      struct abi_serializer_cache_impl {
+         mutable std::mutex    mtx;
+         abi_cache_index       entries;
+         size_t                capacity = config::default_abi_serializer_cache_size;
+         std::atomic<uint64_t> hits{0};
+         std::atomic<uint64_t> misses{0};
+
+         // requires mtx to be held
+         void evict() {
+            while( entries.size() > capacity ) entries.pop_back();
+         }
+      };
+   }
+
+   abi_serializer_cache& abi_serializer_cache::instance() {
+      static abi_serializer_cache the_cache;
+      return the_cache;
+   }
+
+   abi_serializer_cache::abi_serializer_cache()
+   : my( new detail::abi_serializer_cache_impl() )
+   {}
+
+   abi_serializer_cache::~abi_serializer_cache() = default;
+
+   abi_serializer_cache::abi_serializer_ptr
+   abi_serializer_cache::get( const chainbase::database& db, account_name account, const fc::microseconds& max_serialization_time ) {
+      const auto* accnt = db.find<account_object, by_name>( account );
+      if( accnt == nullptr || accnt->abi.size() == 0 ) return abi_serializer_ptr();
+
+      const auto& metadata = db.get<account_metadata_object, by_name>( account );
+      detail::abi_cache_key key{ account, metadata.abi_sequence };
+      bool enabled = true;
+      {
+         std::lock_guard<std::mutex> g( my->mtx );
+         enabled = my->capacity > 0;
+         auto& idx = my->entries.get<detail::by_key>();
+         auto itr = idx.find( key );
+         if( itr != idx.end() && itr->built_from( accnt->abi ) ) {
+            my->entries.relocate( my->entries.begin(), my->entries.project<0>( itr ) );
+            ++my->hits;
+            return itr->serializer;
+         }
+      }
+
+      // build outside of the lock, other threads may build the same serializer concurrently which is harmless
+      ++my->misses;
+      abi_def abi;
+      if( !abi_serializer::to_abi( accnt->abi, abi ) ) return abi_serializer_ptr();
+      auto serializer = std::make_shared<const abi_serializer>( abi, max_serialization_time );
+      if( !enabled ) return serializer;
+
+      detail::abi_cache_entry entry{ key, std::string( accnt->abi.data(), accnt->abi.size() ), serializer };
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto& idx = my->entries.get<detail::by_key>();
+      auto itr = idx.find( key );
+      if( itr != idx.end() ) {
+         // same sequence but a different abi, e.g. set on another fork
+         idx.replace( itr, std::move( entry ) );
+         my->entries.relocate( my->entries.begin(), my->entries.project<0>( itr ) );
+      } else {
+         my->entries.push_front( std::move( entry ) );
+      }
+      my->evict();
+      return serializer;
+   }
+
+   void abi_serializer_cache::set_capacity( size_t capacity ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->capacity = capacity;
+      my->evict();
+   }
+
+   abi_serializer_cache::stats abi_serializer_cache::get_stats()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return stats{ my->hits.load(), my->misses.load(), my->entries.size(), my->capacity };
+   }
+
+   void abi_serializer_cache::clear() {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->entries.clear();
+      my->hits = 0;
+      my->misses = 0;
+   }
+
+} } /// eosio::chain
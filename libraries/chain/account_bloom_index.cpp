@@ -0,0 +1,260 @@
+#include <eosio/chain/account_bloom_index.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace eosio { namespace chain {
+
+namespace {
+   constexpr uint32_t hash_count = 4;
+
+   enum class key_kind : uint64_t {
+      account = 1,
+      action  = 2
+   };
+
+   uint64_t mix( uint64_t x ) {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+   }
+
+   /// calls f with the hash_count bits of the key among bit_count bits
+   template<typename F>
+   void for_each_bit( name n, key_kind kind, uint64_t bit_count, F&& f ) {
+      const uint64_t h = mix( n.to_uint64_t() ^ ( uint64_t(kind) * 0x9e3779b97f4a7c15ULL ) );
+      const uint64_t h1 = uint32_t( h );
+      const uint64_t h2 = ( h >> 32 ) | 1;
+      for( uint32_t i = 0; i < hash_count; ++i )
+         f( ( h1 + i * h2 ) % bit_count );
+   }
+
+   /// calls f with each key of b
+   template<typename F>
+   void for_each_key( const signed_block& b, F&& f ) {
+      auto add_actions = [&]( const vector<action>& actions ) {
+         for( const auto& a : actions ) {
+            f( a.account, key_kind::account );
+            f( a.name, key_kind::action );
+            for( const auto& auth : a.authorization )
+               f( auth.actor, key_kind::account );
+         }
+      };
+      for( const auto& receipt : b.transactions ) {
+         if( !receipt.trx.contains<packed_transaction>() ) continue;
+         const auto& trx = receipt.trx.get<packed_transaction>().get_transaction();
+         add_actions( trx.context_free_actions );
+         add_actions( trx.actions );
+      }
+   }
+}
+
+vector<uint32_t> account_bloom_index::filter::add( const signed_block& b ) {
+   vector<uint32_t> changed;
+   const uint64_t bit_count = uint64_t(_bits.size()) * 8;
+   for_each_key( b, [&]( name n, key_kind kind ) {
+      for_each_bit( n, kind, bit_count, [&]( uint64_t bit ) {
+         auto& byte = _bits[bit / 8];
+         const uint8_t mask = 1 << ( bit % 8 );
+         if( byte & mask ) return;
+         byte |= mask;
+         changed.push_back( bit / 8 );
+      } );
+   } );
+   return changed;
+}
+
+bool account_bloom_index::filter::may_match( const fc::optional<account_name>& account, const fc::optional<action_name>& action )const {
+   const uint64_t bit_count = uint64_t(_bits.size()) * 8;
+   auto contains = [&]( name n, key_kind kind ) {
+      bool result = true;
+      for_each_bit( n, kind, bit_count, [&]( uint64_t bit ) {
+         result = result && ( _bits[bit / 8] & ( 1 << ( bit % 8 ) ) );
+      } );
+      return result;
+   };
+   return ( !account || contains( *account, key_kind::account ) ) && ( !action || contains( *action, key_kind::action ) );
+}
+
+account_bloom_index::account_bloom_index( const fc::path& file, uint32_t blocks_per_range, uint32_t filter_bytes )
+:_file( file )
+{
+   EOS_ASSERT( blocks_per_range > 0 && filter_bytes > 0, block_log_exception,
+               "account index needs blocks per range and filter bytes" );
+   _fd = ::open( _file.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+   EOS_ASSERT( _fd >= 0, block_log_exception, "Unable to open ${file}: ${e}", ("file", _file.generic_string())("e", strerror(errno)) );
+
+   _size = fc::file_size( _file );
+   if( _size == 0 ) {
+      _header = { magic_number, current_version, blocks_per_range, filter_bytes, 0 };
+      write_header();
+      _size = sizeof(_header);
+   } else {
+      EOS_ASSERT( _size >= sizeof(header), block_log_exception, "${file} is truncated", ("file", _file.generic_string()) );
+      read( (char*)&_header, sizeof(_header), 0 );
+      EOS_ASSERT( _header.magic == magic_number, block_log_exception, "${file} is not an account index", ("file", _file.generic_string()) );
+      EOS_ASSERT( _header.version == current_version, block_log_exception,
+                  "${file} has unsupported version ${v}", ("file", _file.generic_string())("v", _header.version) );
+      EOS_ASSERT( _header.blocks_per_range > 0 && _header.filter_bytes > 0, block_log_exception,
+                  "${file} is corrupted", ("file", _file.generic_string()) );
+   }
+}
+
+account_bloom_index::~account_bloom_index() {
+   try {
+      flush();
+   } FC_LOG_AND_DROP()
+   ::close( _fd );
+}
+
+void account_bloom_index::read( char* data, size_t size, uint64_t pos )const {
+   while( size > 0 ) {
+      const ssize_t n = ::pread( _fd, data, size, pos );
+      if( n < 0 && errno == EINTR ) continue;
+      EOS_ASSERT( n > 0, block_log_exception, "Unable to read ${size} bytes at ${pos} of ${file}",
+                  ("size", size)("pos", pos)("file", _file.generic_string()) );
+      data += n;
+      pos += n;
+      size -= n;
+   }
+}
+
+void account_bloom_index::write( const char* data, size_t size, uint64_t pos ) {
+   _size = std::max<uint64_t>( _size, pos + size );
+   while( size > 0 ) {
+      const ssize_t n = ::pwrite( _fd, data, size, pos );
+      if( n < 0 && errno == EINTR ) continue;
+      EOS_ASSERT( n > 0, block_log_exception, "Unable to write ${size} bytes at ${pos} of ${file}",
+                  ("size", size)("pos", pos)("file", _file.generic_string()) );
+      data += n;
+      pos += n;
+      size -= n;
+   }
+}
+
+void account_bloom_index::write_header() {
+   write( (const char*)&_header, sizeof(_header), 0 );
+}
+
+void account_bloom_index::read_range( uint32_t range, filter& f )const {
+   auto& bits = f.bits();
+   bits.assign( _header.filter_bytes, 0 );
+   const uint64_t pos = range_pos( range );
+   // ranges are written sparsely, what lies past the end of the file was never set
+   if( pos < _size )
+      read( (char*)bits.data(), std::min<uint64_t>( bits.size(), _size - pos ), pos );
+}
+
+void account_bloom_index::add( const signed_block& b ) {
+   const uint32_t block_num = b.block_num();
+   const uint32_t range = range_of( block_num );
+   std::lock_guard<std::mutex> g( _mtx );
+   if( range != _current_range ) {
+      read_range( range, _current );
+      _current_range = range;
+   }
+   // only the bytes which gained bits are written, most accounts of a range are already in its filter
+   const uint64_t pos = range_pos( range );
+   for( uint32_t offset : _current.add( b ) )
+      write( (const char*)&_current.bits()[offset], 1, pos + offset );
+   _header.last_block_num = block_num;
+}
+
+void account_bloom_index::write_range( uint32_t range, const filter& f ) {
+   EOS_ASSERT( f.bits().size() == _header.filter_bytes, block_log_exception,
+               "filter of ${s} bytes does not fit ${file}", ("s", f.bits().size())("file", _file.generic_string()) );
+   std::lock_guard<std::mutex> g( _mtx );
+   write( (const char*)f.bits().data(), f.bits().size(), range_pos( range ) );
+   if( range == _current_range )
+      _current = f;
+}
+
+vector<std::pair<uint32_t, uint32_t>> account_bloom_index::find( uint32_t first, uint32_t last, const fc::optional<account_name>& account,
+                                                                 const fc::optional<action_name>& action )const {
+   vector<std::pair<uint32_t, uint32_t>> result;
+   if( first == 0 ) first = 1;
+   if( first > last ) return result;
+   auto append = [&]( uint32_t start, uint32_t end ) {
+      if( !result.empty() && result.back().second + 1 == start )
+         result.back().second = end;
+      else
+         result.emplace_back( start, end );
+   };
+
+   std::lock_guard<std::mutex> g( _mtx );
+   filter f( 0 );
+   for( uint32_t range = range_of( first ); range <= range_of( last ); ++range ) {
+      const uint32_t start = std::max( first, first_block_of( range ) );
+      const uint32_t end = std::min<uint64_t>( last, uint64_t(first_block_of( range )) + _header.blocks_per_range - 1 );
+      if( start > _header.last_block_num ) {
+         append( start, last );
+         break;
+      }
+      bool match = true;
+      if( account || action ) {
+         if( range == _current_range ) {
+            match = _current.may_match( account, action );
+         } else {
+            read_range( range, f );
+            match = f.may_match( account, action );
+         }
+      }
+      if( match )
+         append( start, end );
+      else if( end > _header.last_block_num )
+         append( _header.last_block_num + 1, end );
+   }
+   return result;
+}
+
+uint32_t account_bloom_index::last_block_num()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _header.last_block_num;
+}
+
+void account_bloom_index::set_last_block_num( uint32_t block_num ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _header.last_block_num = block_num;
+}
+
+void account_bloom_index::clear() {
+   std::lock_guard<std::mutex> g( _mtx );
+   _header.last_block_num = 0;
+   _current_range = std::numeric_limits<uint32_t>::max();
+   _size = 0;
+   EOS_ASSERT( ::ftruncate( _fd, 0 ) == 0, block_log_exception, "Unable to truncate ${file}", ("file", _file.generic_string()) );
+   write_header();
+}
+
+void account_bloom_index::flush() {
+   std::lock_guard<std::mutex> g( _mtx );
+   write_header();
+}
+
+bool account_bloom_index::touches( const signed_block& b, const fc::optional<account_name>& account, const fc::optional<action_name>& action ) {
+   auto matches = [&]( const vector<action>& actions ) {
+      for( const auto& a : actions ) {
+         if( action && a.name != *action ) continue;
+         if( !account || a.account == *account ) return true;
+         for( const auto& auth : a.authorization )
+            if( auth.actor == *account ) return true;
+      }
+      return false;
+   };
+   for( const auto& receipt : b.transactions ) {
+      if( !receipt.trx.contains<packed_transaction>() ) continue;
+      const auto& trx = receipt.trx.get<packed_transaction>().get_transaction();
+      if( matches( trx.context_free_actions ) || matches( trx.actions ) )
+         return true;
+   }
+   return false;
+}
+
+} } /// eosio::chain
@@ -0,0 +1,89 @@
+#include <eosio/chain/action_stats.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <algorithm>
+
+namespace eosio { namespace chain {
+
+   action_stats::action_stats( uint32_t window_blocks )
+   :_window_blocks( window_blocks )
+   {
+      EOS_ASSERT( window_blocks > 0, misc_exception, "action stats window must have at least one block" );
+   }
+
+   void action_stats::record( account_name receiver, account_name account, action_name action,
+                              fc::microseconds elapsed, int64_t ram_delta, bool failed ) {
+      histogram& h = _current.entries[std::make_tuple( receiver, account, action )];
+      const uint64_t us = std::max<int64_t>( elapsed.count(), 0 );
+      ++h.count;
+      h.failures += failed;
+      h.total_us += us;
+      h.max_us = std::max( h.max_us, us );
+      h.ram_delta += ram_delta;
+      size_t bucket = 0;
+      while( bucket + 1 < num_buckets && (uint64_t(1) << bucket) <= us )
+         ++bucket;
+      ++h.buckets[bucket];
+   }
+
+   void action_stats::record_notifications( account_name account, action_name action, uint32_t notifications ) {
+      if( notifications )
+         _current.entries[std::make_tuple( account, account, action )].notifications += notifications;
+   }
+
+   void action_stats::on_accepted_block( uint32_t block_num ) {
+      if( _current.first_block == 0 )
+         _current.first_block = block_num;
+      _current.last_block = block_num;
+      if( block_num - _current.first_block + 1 >= _window_blocks ) {
+         _completed = std::move( _current );
+         _current = window();
+      }
+   }
+
+   uint64_t action_stats::histogram::percentile( double p )const {
+      const uint64_t rank = std::max<uint64_t>( 1, uint64_t( p * count + 0.5 ) );
+      uint64_t seen = 0;
+      for( size_t i = 0; i < num_buckets; ++i ) {
+         seen += buckets[i];
+         if( seen >= rank )
+            return i + 1 < num_buckets ? std::min( uint64_t(1) << i, max_us ) : max_us;
+      }
+      return max_us;
+   }
+
+   action_stats_window action_stats::to_rows( const window& w, uint32_t limit ) {
+      action_stats_window result;
+      result.first_block = w.first_block;
+      result.last_block = w.last_block;
+      result.rows.reserve( w.entries.size() );
+      for( const auto& e : w.entries ) {
+         const histogram& h = e.second;
+         action_stats_row row;
+         std::tie( row.receiver, row.account, row.action ) = e.first;
+         row.count = h.count;
+         row.failures = h.failures;
+         row.total_us = h.total_us;
+         row.p50_us = h.count ? h.percentile( 0.50 ) : 0;
+         row.p99_us = h.count ? h.percentile( 0.99 ) : 0;
+         row.max_us = h.max_us;
+         row.ram_delta = h.ram_delta;
+         row.notifications = h.notifications;
+         result.rows.push_back( std::move( row ) );
+      }
+      const size_t n = std::min<size_t>( limit, result.rows.size() );
+      std::partial_sort( result.rows.begin(), result.rows.begin() + n, result.rows.end(),
+                         []( const auto& a, const auto& b ) { return a.total_us > b.total_us; } );
+      result.rows.resize( n );
+      return result;
+   }
+
+   action_stats_window action_stats::current( uint32_t limit )const {
+      return to_rows( _current, limit );
+   }
+
+   action_stats_window action_stats::completed( uint32_t limit )const {
+      return to_rows( _completed, limit );
+   }
+
+} } // eosio::chain
@@ -4,6 +4,7 @@
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
@@ -34,6 +35,7 @@ apply_context::apply_context(controller& con, transaction_context& trx_ctx, uint
 :control(con)
 ,db(con.mutable_db())
 ,trx_context(trx_ctx)
+,db_write_ns(con.get_apply_phase_stats() ? &con.get_apply_phase_stats()->db_write_ns : nullptr)
 ,recurse_depth(depth)
 ,first_receiver_action_ordinal(action_ordinal)
 ,action_ordinal(action_ordinal)
@@ -59,12 +61,21 @@ void apply_context::exec_one()
 
    const auto& cfg = control.get_global_properties().configuration;
    const account_metadata_object* receiver_account = nullptr;
+
+   if( trx_context.access_set ) {
+      trx_context.access_set->add_account( receiver );
+      for( const auto& auth : act->authorization ) {
+         trx_context.access_set->add_account( auth.actor );
+      }
+   }
+
    try {
       try {
          receiver_account = &db.get<account_metadata_object,by_name>( receiver );
          privileged = receiver_account->is_privileged();
          auto native = control.find_apply_handler( receiver, act->account, act->name );
          if( native ) {
+            check_writable(); // all native handlers modify state
             if( trx_context.enforce_whiteblacklist && control.is_producing_block() ) {
                control.check_contract_list( receiver );
                control.check_action_list( act->account, act->name );
@@ -83,9 +94,17 @@ void apply_context::exec_one()
                control.check_contract_list( receiver );
                control.check_action_list( act->account, act->name );
             }
-            try {
-               control.get_wasm_interface().apply( receiver_account->code_hash, receiver_account->vm_type, receiver_account->vm_version, *this );
-            } catch( const wasm_exit& ) {}
+            fc::microseconds concurrent_elapsed;
+            if( context_free && trx_context.take_context_free_result( action_ordinal, *receiver_account, _pending_console_output, concurrent_elapsed ) ) {
+               start -= concurrent_elapsed;
+               control.get_wasm_interface().record_concurrent_apply( receiver_account->code_hash, *this, concurrent_elapsed );
+            } else {
+               try {
+                  auto* phase_stats = control.get_apply_phase_stats();
+                  apply_phase_timer wasm_timer( phase_stats ? &phase_stats->wasm_ns : nullptr );
+                  control.get_wasm_interface().apply( receiver_account->code_hash, receiver_account->vm_type, receiver_account->vm_version, *this );
+               } catch( const wasm_exit& ) {}
+            }
          }
 
          if( !privileged && control.is_builtin_activated( builtin_protocol_feature_t::ram_restrictions ) ) {
@@ -116,6 +135,7 @@ void apply_context::exec_one()
       trace.error_code = controller::convert_exception_to_error_code( e );
       trace.except = e;
       finalize_trace( trace, start );
+      record_stats( trace, true );
       throw;
    }
 
@@ -147,12 +167,21 @@ void apply_context::exec_one()
    trx_context.executed.emplace_back( std::move(r) );
 
    finalize_trace( trace, start );
+   record_stats( trace, false );
 
    if ( control.contracts_console() ) {
       print_debug(receiver, trace);
    }
 }
 
+std::string apply_context::exec_context_free_concurrently( wasm_instantiated_module_interface& module )
+{
+   try {
+      module.apply( *this );
+   } catch( const wasm_exit& ) {}
+   return std::move( _pending_console_output );
+}
+
 void apply_context::finalize_trace( action_trace& trace, const fc::time_point& start )
 {
    trace.account_ram_deltas = std::move( _account_ram_deltas );
@@ -164,6 +193,17 @@ void apply_context::finalize_trace( action_trace& trace, const fc::time_point& s
    trace.elapsed = fc::time_point::now() - start;
 }
 
+void apply_context::record_stats( const action_trace& trace, bool failed )
+{
+   auto* stats = control.get_action_stats();
+   if( !stats )
+      return;
+   int64_t ram_delta = 0;
+   for( const auto& d : trace.account_ram_deltas )
+      ram_delta += d.delta;
+   stats->record( receiver, act->account, act->name, trace.elapsed, ram_delta, failed );
+}
+
 void apply_context::exec()
 {
    _notified.emplace_back( receiver, action_ordinal );
@@ -172,6 +212,8 @@ void apply_context::exec()
       std::tie( receiver, action_ordinal ) = _notified[i];
       exec_one();
    }
+   if( auto* stats = control.get_action_stats() )
+      stats->record_notifications( act->account, act->name, _notified.size() - 1 );
 
    if( _cfa_inline_actions.size() > 0 || _inline_actions.size() > 0 ) {
       EOS_ASSERT( recurse_depth < control.get_global_properties().configuration.max_inline_action_depth,
@@ -346,6 +388,7 @@ void apply_context::execute_context_free_inline( action&& a ) {
 
 
 void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, account_name payer, transaction&& trx, bool replace_existing ) {
+   check_writable();
    EOS_ASSERT( trx.context_free_actions.size() == 0, cfa_inside_generated_tx, "context free actions are not currently allowed in generated transactions" );
 
    bool enforce_actor_whitelist_blacklist = trx_context.enforce_whiteblacklist && control.is_producing_block()
@@ -528,6 +571,7 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
 }
 
 bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, account_name sender ) {
+   check_writable();
    auto& generated_transaction_idx = db.get_mutable_index<generated_transaction_multi_index>();
    const auto* gto = db.find<generated_transaction_object,by_sender_id>(boost::make_tuple(sender, sender_id));
    if ( gto ) {
@@ -558,27 +602,37 @@ uint32_t apply_context::schedule_action( action&& act_to_schedule, account_name
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
-   return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   if( trx_context.access_set ) trx_context.access_set->add_table( code, scope, table );
+   // tables are only created and removed through this context while it runs, so a cached miss stays valid too
+   auto itr = _table_lookup_cache.find( std::make_tuple(code, scope, table) );
+   if( itr != _table_lookup_cache.end() ) return itr->second;
+
+   const auto* tid = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   _table_lookup_cache.emplace( std::make_tuple(code, scope, table), tid );
+   return tid;
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
-   const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   const auto* existing_tid = find_table( code, scope, table );
    if (existing_tid != nullptr) {
       return *existing_tid;
    }
 
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-   return db.create<table_id_object>([&](table_id_object &t_id){
+   const auto& tid = db.create<table_id_object>([&](table_id_object &t_id){
       t_id.code = code;
       t_id.scope = scope;
       t_id.table = table;
       t_id.payer = payer;
    });
+   _table_lookup_cache[std::make_tuple(code, scope, table)] = &tid;
+   return tid;
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
+   _table_lookup_cache[std::make_tuple(tid.code, tid.scope, tid.table)] = nullptr;
    db.remove(tid);
 }
 
@@ -656,7 +710,14 @@ int apply_context::db_store_i64( name scope, name table, const account_name& pay
    return db_store_i64( receiver, scope, table, payer, id, buffer, buffer_size);
 }
 
+void apply_context::check_writable()const {
+   EOS_ASSERT( !trx_context.read_only, read_only_trx_write_exception,
+               "read-only transaction cannot modify state of ${receiver}", ("receiver", receiver) );
+}
+
 int apply_context::db_store_i64( name code, name scope, name table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size ) {
+   apply_phase_timer timer( db_write_ns );
+   check_writable();
 //   require_write_lock( scope );
    const auto& tab = find_or_create_table( code, scope, table, payer );
    auto tableid = tab.id;
@@ -682,6 +743,8 @@ int apply_context::db_store_i64( name code, name scope, name table, const accoun
 }
 
 void apply_context::db_update_i64( int iterator, account_name payer, const char* buffer, size_t buffer_size ) {
+   apply_phase_timer timer( db_write_ns );
+   check_writable();
    const key_value_object& obj = keyval_cache.get( iterator );
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
@@ -712,6 +775,8 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
 }
 
 void apply_context::db_remove_i64( int iterator ) {
+   apply_phase_timer timer( db_write_ns );
+   check_writable();
    const key_value_object& obj = keyval_cache.get( iterator );
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
@@ -724,13 +789,12 @@ void apply_context::db_remove_i64( int iterator ) {
    db.modify( table_obj, [&]( auto& t ) {
       --t.count;
    });
+   keyval_cache.remove( iterator );
    db.remove( obj );
 
    if (table_obj.count == 0) {
       remove_table(table_obj);
    }
-
-   keyval_cache.remove( iterator );
 }
 
 int apply_context::db_get_i64( int iterator, char* buffer, size_t buffer_size ) {
@@ -800,7 +864,10 @@ int apply_context::db_find_i64( name code, name scope, name table, uint64_t id )
 
    auto table_end_itr = keyval_cache.cache_table( *tab );
 
-   const key_value_object* obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
+   int cached = keyval_cache.find_by_primary( tab->id, id );
+   if( cached >= 0 ) return cached;
+
+   const key_value_object* obj = db.find<key_value_object, by_table_primary>( boost::make_tuple( tab->id, id ) );
    if( !obj ) return table_end_itr;
 
    return keyval_cache.add( *obj );
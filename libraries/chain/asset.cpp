@@ -1,5 +1,6 @@
 #include <eosio/chain/asset.hpp>
 #include <boost/rational.hpp>
+#include <algorithm>
 #include <fc/reflect/variant.hpp>
 
 namespace eosio { namespace chain {
@@ -17,15 +18,30 @@ int64_t asset::precision()const {
 }
 
 string asset::to_string()const {
-   string sign = amount < 0 ? "-" : "";
-   int64_t abs_amount = std::abs(amount);
-   string result = fc::to_string( static_cast<int64_t>(abs_amount) / precision());
-   if( decimals() )
-   {
-      auto fract = static_cast<int64_t>(abs_amount) % precision();
-      result += "." + fc::to_string(precision() + fract).erase(0,1);
-   }
-   return sign + result + " " + symbol_name();
+   char buf[max_string_length];
+   return string( buf, to_chars( buf ) );
+}
+
+char* asset::to_chars( char* buf )const {
+   if( amount < 0 ) *buf++ = '-';
+   const uint64_t abs_amount = amount < 0 ? -static_cast<uint64_t>(amount) : amount;
+   const uint8_t d = decimals();
+
+   // digits of the amount from the last one, with the decimal point after the integer part
+   char digits[21];
+   char* first = digits + sizeof(digits);
+   uint64_t v = abs_amount;
+   for( uint8_t i = 0; i < d; ++i, v /= 10 )
+      *--first = '0' + v % 10;
+   if( d ) *--first = '.';
+   do {
+      *--first = '0' + v % 10;
+      v /= 10;
+   } while( v > 0 );
+
+   buf = std::copy( first, digits + sizeof(digits), buf );
+   *buf++ = ' ';
+   return sym.name_to_chars( buf );
 }
 
 asset asset::from_string(const string& from)
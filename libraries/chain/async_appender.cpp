@@ -0,0 +1,86 @@
+#include <eosio/chain/async_appender.hpp>
+#include <fc/log/console_appender.hpp>
+#include <fc/log/gelf_appender.hpp>
+#include <fc/log/logger_config.hpp>
+#include <fc/exception/exception.hpp>
+
+namespace eosio { namespace chain {
+
+async_appender::async_appender( const fc::variant& args ) {
+   const auto& cfg = args.get_object();
+   const std::string type = cfg.contains( "type" ) ? cfg["type"].as_string() : std::string( "console" );
+   const fc::variant target_args = cfg.contains( "args" ) ? cfg["args"] : fc::variant( fc::variant_object() );
+   if( type == "console" ) {
+      _target = std::make_unique<fc::console_appender>( target_args );
+   } else if( type == "gelf" ) {
+      _target = std::make_unique<fc::gelf_appender>( target_args );
+   } else {
+      FC_THROW( "async appender cannot wrap appender type ${t}, expected console or gelf", ("t", type) );
+   }
+
+   const uint64_t capacity = cfg.contains( "capacity" ) ? cfg["capacity"].as_uint64() : 65536;
+   FC_ASSERT( capacity > 0, "async appender capacity must be greater than 0" );
+   _ring = std::make_unique<mpsc_ring<fc::log_message>>( capacity );
+
+   _thread = std::thread( [this]() {
+      fc::set_os_thread_name( "log" );
+      run();
+   } );
+}
+
+async_appender::~async_appender() {
+   _stopping = true;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+   }
+   _cv.notify_one();
+   _thread.join();
+}
+
+void async_appender::initialize( boost::asio::io_service& io_service ) {
+   _target->initialize( io_service );
+}
+
+void async_appender::log( const fc::log_message& m ) {
+   if( !_ring->push( m ) ) {
+      _dropped.fetch_add( 1, std::memory_order_relaxed );
+      return;
+   }
+   if( _sleeping.load( std::memory_order_acquire ) ) {
+      { std::lock_guard<std::mutex> g( _mtx ); }
+      _cv.notify_one();
+   }
+}
+
+void async_appender::run() {
+   fc::log_message m;
+   for( ;; ) {
+      bool any = false;
+      while( _ring->pop( m ) ) {
+         any = true;
+         try {
+            _target->log( m );
+         } catch( ... ) {
+            // a failing appender must not stop the logging thread
+         }
+      }
+      const uint64_t dropped = _dropped.load( std::memory_order_relaxed );
+      if( dropped != _dropped_reported ) {
+         try {
+            _target->log( fc::log_message( FC_LOG_CONTEXT( warn ), "async log appender dropped ${n} messages, ${t} in total",
+                                           fc::mutable_variant_object()( "n", dropped - _dropped_reported )( "t", dropped ) ) );
+         } catch( ... ) {}
+         _dropped_reported = dropped;
+      }
+      if( any ) continue;
+      if( _stopping ) break;
+
+      std::unique_lock<std::mutex> g( _mtx );
+      _sleeping.store( true, std::memory_order_release );
+      // the timeout covers a message pushed between the last pop and setting _sleeping
+      _cv.wait_for( g, std::chrono::milliseconds( 10 ), [this]() { return _stopping || !_ring->empty(); } );
+      _sleeping.store( false, std::memory_order_relaxed );
+   }
+}
+
+} } // eosio::chain
@@ -0,0 +1,69 @@
+#include <eosio/chain/async_signal.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger_config.hpp>
+
+namespace eosio { namespace chain {
+
+async_signal_consumer::async_signal_consumer( std::string name, size_t max_queued )
+:_name( std::move(name) )
+,_max_queued( std::max<size_t>( max_queued, 1 ) )
+{
+   _thread = std::thread( [this]() {
+      fc::set_os_thread_name( _name );
+      run();
+   } );
+}
+
+async_signal_consumer::~async_signal_consumer() {
+   std::vector<boost::signals2::scoped_connection> connections;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      connections = std::move( _connections );
+   }
+   connections.clear();
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      _stopping = true;
+   }
+   _queued_cv.notify_one();
+   _thread.join();
+}
+
+void async_signal_consumer::post( std::function<void()> f ) {
+   std::unique_lock<std::mutex> g( _mtx );
+   _handled_cv.wait( g, [&]() { return _queue.size() < _max_queued; } );
+   _queue.emplace_back( std::move( f ) );
+   ++_posted;
+   g.unlock();
+   _queued_cv.notify_one();
+}
+
+void async_signal_consumer::wait() {
+   std::unique_lock<std::mutex> g( _mtx );
+   const uint64_t posted = _posted;
+   _handled_cv.wait( g, [&]() { return _handled >= posted; } );
+}
+
+size_t async_signal_consumer::queued()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _queue.size();
+}
+
+void async_signal_consumer::run() {
+   std::unique_lock<std::mutex> g( _mtx );
+   while( true ) {
+      _queued_cv.wait( g, [&]() { return _stopping || !_queue.empty(); } );
+      if( _queue.empty() ) return;
+      auto f = std::move( _queue.front() );
+      _queue.pop_front();
+      g.unlock();
+      try {
+         f();
+      } FC_LOG_AND_DROP()
+      g.lock();
+      ++_handled;
+      _handled_cv.notify_all();
+   }
+}
+
+} } // eosio::chain
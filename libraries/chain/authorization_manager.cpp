@@ -29,6 +29,7 @@ namespace eosio { namespace chain {
 
    void authorization_manager::initialize_database() {
       _db.create<permission_object>([](auto&){}); /// reserve perm 0 (used else where)
+      _satisfied_authorities.clear();
    }
 
    namespace detail {
@@ -110,6 +111,7 @@ namespace eosio { namespace chain {
    }
 
    void authorization_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+      _satisfied_authorities.clear();
       authorization_index_set::walk_indices([this, &snapshot]( auto utils ){
          using section_t = typename decltype(utils)::index_t::value_type;
 
@@ -157,6 +159,8 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = auth;
       });
+      // new permissions cannot change checks that did not run into a missing permission
+      on_permission_changed( false );
       return perm;
    }
 
@@ -188,6 +192,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = std::move(auth);
       });
+      on_permission_changed( false );
       return perm;
    }
 
@@ -200,6 +205,7 @@ namespace eosio { namespace chain {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
       });
+      on_permission_changed( true );
    }
 
    void authorization_manager::remove_permission( const permission_object& permission ) {
@@ -210,6 +216,18 @@ namespace eosio { namespace chain {
 
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
+      on_permission_changed( true );
+   }
+
+   void authorization_manager::on_permission_changed( bool clear_cache ) {
+      _last_permission_change_block_num = _control.head_block_num() + 1;
+      if( clear_cache )
+         _satisfied_authorities.clear();
+   }
+
+   void authorization_manager::discard_cached_authorities( uint32_t from_block_num ) {
+      if( _last_permission_change_block_num >= from_block_num )
+         _satisfied_authorities.clear();
    }
 
    void authorization_manager::update_permission_usage( const permission_object& permission ) {
@@ -453,8 +471,17 @@ namespace eosio { namespace chain {
 
       auto effective_provided_delay =  (provided_delay >= delay_max_limit) ? fc::microseconds::maximum() : provided_delay;
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
-                                        _control.get_global_properties().configuration.max_authority_depth,
+      const auto max_authority_depth = _control.get_global_properties().configuration.max_authority_depth;
+      bool missing_permission = false;
+      auto checker = make_auth_checker( [&](const permission_level& p){
+                                           try {
+                                              return get_permission(p).auth;
+                                           } catch( const permission_query_exception& ) {
+                                              missing_permission = true;
+                                              throw;
+                                           }
+                                        },
+                                        max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
                                         effective_provided_delay,
@@ -517,9 +544,31 @@ namespace eosio { namespace chain {
       // for checking the set of declared authorizations.
       // The permission_levels are traversed in ascending order, which is:
       // ascending order of the actor name with ties broken by ascending order of the permission name.
+      // Only checks against keys alone are cached, provided permissions come from contracts and rarely repeat.
+      const bool use_cache = provided_permissions.empty() && !provided_keys.empty();
       for( const auto& p : permissions_to_satisfy ) {
          checktime(); // TODO: this should eventually move into authority_checker instead
-         EOS_ASSERT( checker.satisfied( p.first, p.second ), unsatisfied_authorization,
+         bool satisfied = false;
+         if( use_cache ) {
+            authority_cache_key key{ p.first, p.second, max_authority_depth, provided_keys };
+            auto itr = _satisfied_authorities.find( key );
+            if( itr != _satisfied_authorities.end() ) {
+               checker.mark_keys_used( itr->second );
+               satisfied = true;
+            } else {
+               flat_set<public_key_type> keys_used;
+               missing_permission = false;
+               satisfied = checker.satisfied_with_used_keys( p.first, p.second, keys_used );
+               if( satisfied && !missing_permission ) {
+                  if( _satisfied_authorities.size() >= max_cached_authorities )
+                     _satisfied_authorities.clear();
+                  _satisfied_authorities.emplace( std::move( key ), std::move( keys_used ) );
+               }
+            }
+         } else {
+            satisfied = checker.satisfied( p.first, p.second );
+         }
+         EOS_ASSERT( satisfied, unsatisfied_authorization,
                      "transaction declares authority '${auth}', "
                      "but does not have signatures for it under a provided delay of ${provided_delay} ms, "
                      "provided permissions ${provided_permissions}, provided keys ${provided_keys}, "
@@ -584,6 +633,18 @@ namespace eosio { namespace chain {
                                                                        const flat_set<public_key_type>& candidate_keys,
                                                                        fc::microseconds provided_delay
                                                                      )const
+   {
+      vector<permission_level> declared_auths;
+      for (const auto& act : trx.actions ) {
+         declared_auths.insert( declared_auths.end(), act.authorization.begin(), act.authorization.end() );
+      }
+      return get_required_keys( declared_auths, candidate_keys, provided_delay );
+   }
+
+   flat_set<public_key_type> authorization_manager::get_required_keys( const vector<permission_level>& declared_auths,
+                                                                       const flat_set<public_key_type>& candidate_keys,
+                                                                       fc::microseconds provided_delay
+                                                                     )const
    {
       auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
@@ -593,12 +654,10 @@ namespace eosio { namespace chain {
                                         _noop_checktime
                                       );
 
-      for (const auto& act : trx.actions ) {
-         for (const auto& declared_auth : act.authorization) {
-            EOS_ASSERT( checker.satisfied(declared_auth), unsatisfied_authorization,
-                        "transaction declares authority '${auth}', but does not have signatures for it.",
-                        ("auth", declared_auth) );
-         }
+      for (const auto& declared_auth : declared_auths ) {
+         EOS_ASSERT( checker.satisfied(declared_auth), unsatisfied_authorization,
+                     "transaction declares authority '${auth}', but does not have signatures for it.",
+                     ("auth", declared_auth) );
       }
 
       return checker.used_keys();
@@ -16,9 +16,9 @@ namespace eosio { namespace chain {
    }
 
    producer_authority block_header_state::get_scheduled_producer( block_timestamp_type t )const {
-      auto index = t.slot % (active_schedule.producers.size() * config::producer_repetitions);
+      auto index = t.slot % (active_schedule->producers.size() * config::producer_repetitions);
       index /= config::producer_repetitions;
-      return active_schedule.producers[index];
+      return active_schedule->producers[index];
    }
 
    uint32_t block_header_state::calc_dpos_last_irreversible( account_name producer_of_next_block )const {
@@ -60,7 +60,7 @@ namespace eosio { namespace chain {
       result.previous                                        = id;
       result.timestamp                                       = when;
       result.confirmed                                       = num_prev_blocks_to_confirm;
-      result.active_schedule_version                         = active_schedule.version;
+      result.active_schedule_version                         = active_schedule->version;
       result.prev_activated_protocol_features                = activated_protocol_features;
 
       result.valid_block_signing_authority                   = proauth.authority;
@@ -73,7 +73,7 @@ namespace eosio { namespace chain {
       static_assert(std::numeric_limits<uint8_t>::max() >= (config::max_producers * 2 / 3) + 1, "8bit confirmations may not be able to hold all of the needed confirmations");
 
       // This uses the previous block active_schedule because thats the "schedule" that signs and therefore confirms _this_ block
-      auto num_active_producers = active_schedule.producers.size();
+      auto num_active_producers = active_schedule->producers.size();
       uint32_t required_confs = (uint32_t)(num_active_producers * 2 / 3) + 1;
 
       if( confirm_count.size() < config::maximum_tracked_dpos_confirmations ) {
@@ -118,14 +118,14 @@ namespace eosio { namespace chain {
 
       result.prev_pending_schedule                 = pending_schedule;
 
-      if( pending_schedule.schedule.producers.size() &&
+      if( pending_schedule.schedule->producers.size() &&
           result.dpos_irreversible_blocknum >= pending_schedule.schedule_lib_num )
       {
          result.active_schedule = pending_schedule.schedule;
 
          flat_map<account_name,uint32_t> new_producer_to_last_produced;
 
-         for( const auto& pro : result.active_schedule.producers ) {
+         for( const auto& pro : result.active_schedule->producers ) {
             if( pro.producer_name == proauth.producer_name ) {
                new_producer_to_last_produced[pro.producer_name] = result.block_num;
             } else {
@@ -143,7 +143,7 @@ namespace eosio { namespace chain {
 
          flat_map<account_name,uint32_t> new_producer_to_last_implied_irb;
 
-         for( const auto& pro : result.active_schedule.producers ) {
+         for( const auto& pro : result.active_schedule->producers ) {
             if( pro.producer_name == proauth.producer_name ) {
                new_producer_to_last_implied_irb[pro.producer_name] = dpos_proposed_irreversible_blocknum;
             } else {
@@ -251,8 +251,8 @@ namespace eosio { namespace chain {
          EOS_ASSERT( !was_pending_promoted, producer_schedule_exception, "cannot set pending producer schedule in the same block in which pending was promoted to active" );
 
          const auto& new_producers = *h.new_producers;
-         EOS_ASSERT( new_producers.version == active_schedule.version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
-         EOS_ASSERT( prev_pending_schedule.schedule.producers.empty(), producer_schedule_exception,
+         EOS_ASSERT( new_producers.version == active_schedule->version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
+         EOS_ASSERT( prev_pending_schedule.schedule->producers.empty(), producer_schedule_exception,
                     "cannot set new pending producers until last pending is confirmed" );
 
          maybe_new_producer_schedule_hash.emplace(digest_type::hash(new_producers));
@@ -265,8 +265,8 @@ namespace eosio { namespace chain {
 
          const auto& new_producer_schedule = exts.lower_bound(producer_schedule_change_extension::extension_id())->second.get<producer_schedule_change_extension>();
 
-         EOS_ASSERT( new_producer_schedule.version == active_schedule.version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
-         EOS_ASSERT( prev_pending_schedule.schedule.producers.empty(), producer_schedule_exception,
+         EOS_ASSERT( new_producer_schedule.version == active_schedule->version + 1, producer_schedule_exception, "wrong producer schedule version specified" );
+         EOS_ASSERT( prev_pending_schedule.schedule->producers.empty(), producer_schedule_exception,
                      "cannot set new pending producers until last pending is confirmed" );
 
          maybe_new_producer_schedule_hash.emplace(digest_type::hash(new_producer_schedule));
@@ -303,7 +303,7 @@ namespace eosio { namespace chain {
          result.pending_schedule.schedule_lib_num    = block_number;
       } else {
          if( was_pending_promoted ) {
-            result.pending_schedule.schedule.version = prev_pending_schedule.schedule.version;
+            result.pending_schedule.schedule.mutate().version = prev_pending_schedule.schedule->version;
          } else {
             result.pending_schedule.schedule         = std::move( prev_pending_schedule.schedule );
          }
@@ -1,9 +1,28 @@
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trx_block_index.hpp>
+#include <eosio/chain/account_bloom_index.hpp>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <fc/bitutil.hpp>
 #include <fc/io/cfile.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/log/logger_config.hpp>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
@@ -31,12 +50,146 @@ namespace eosio { namespace chain {
     *            this is in the form of an first_block_num that is written immediately after the version
     * Version 3: improvement on version 2 to not require the genesis state be provided when not starting
     *            from block 1
+    * Version 4: same header as version 3, every block is stored zlib compressed behind its block number and
+    *            compressed size; only written when compression is enabled
     */
-   const uint32_t block_log::max_supported_version = 3;
+   const uint32_t block_log::max_supported_version = 4;
+
+   const uint32_t block_log::compressed_version = 4;
 
    namespace detail {
       using unique_file = std::unique_ptr<FILE, decltype(&fclose)>;
 
+      namespace bio = boost::iostreams;
+
+      // block number and compressed size in front of the zlib stream of a compressed entry
+      constexpr size_t compressed_entry_header_size = 2 * sizeof(uint32_t);
+
+      /// @return entry of b as written to a compressed block log, without the trailing position
+      std::vector<char> pack_compressed_entry( const signed_block& b ) {
+         const auto packed = fc::raw::pack( b );
+         std::vector<char> entry( compressed_entry_header_size );
+         bio::filtering_ostream comp;
+         comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+         comp.push( bio::back_inserter( entry ) );
+         bio::write( comp, packed.data(), packed.size() );
+         bio::close( comp );
+
+         const uint32_t block_num = b.block_num();
+         const uint32_t size = entry.size() - compressed_entry_header_size;
+         memcpy( entry.data(), &block_num, sizeof(block_num) );
+         memcpy( entry.data() + sizeof(block_num), &size, sizeof(size) );
+         return entry;
+      }
+
+      /// @return packed signed_block from the zlib stream of a compressed entry
+      std::vector<char> decompress_entry( const char* data, size_t size ) {
+         std::vector<char> packed;
+         try {
+            bio::filtering_ostream decomp;
+            decomp.push( bio::zlib_decompressor() );
+            decomp.push( bio::back_inserter( packed ) );
+            bio::write( decomp, data, size );
+            bio::close( decomp );
+         } catch( const std::exception& e ) {
+            EOS_THROW( block_log_exception, "Could not decompress block from block log: ${e}", ("e", e.what()) );
+         }
+         return packed;
+      }
+
+      /// unpacks T (a signed_block or its header) from the zlib stream of a compressed entry
+      template<typename T>
+      void unpack_compressed( const char* data, size_t size, T& result ) {
+         const auto packed = decompress_entry( data, size );
+         fc::datastream<const char*> ds( packed.data(), packed.size() );
+         fc::raw::unpack( ds, result );
+      }
+
+      /**
+       * Read only descriptors of the files of a block log, read with pread so that any thread can read blocks while
+       * the main thread appends them. Replaced as a whole when the files are recreated, readers holding the previous
+       * one keep reading the blocks it covers.
+       */
+      struct readable_files {
+         readable_files( const fc::path& block_file_name, const fc::path& index_file_name, uint32_t first_block_num, bool compressed );
+         ~readable_files();
+
+         /// reads exactly size bytes at pos of fd
+         void read( int fd, char* data, size_t size, uint64_t pos )const;
+
+         /// @return the decompressed packed block of the compressed entry at pos
+         std::vector<char> read_decompressed( uint64_t pos )const;
+
+         const fc::path        block_file_name;
+         int                   block_fd = -1;
+         int                   index_fd = -1;
+         const uint32_t        first_block_num;
+         const bool            compressed;
+         std::atomic<uint32_t> last_block_num{0}; ///< of the last block flushed with its index entry, 0 for none
+         std::atomic<uint64_t> end_pos{0};        ///< of the flushed part of the block file
+      };
+
+      /*
+       *  @brief datastream adapter that unpacks from a file by positional reads
+       *
+       *  This class supports unpack functionality but not pack.
+       */
+      class pread_datastream {
+      public:
+         pread_datastream( const readable_files& files, uint64_t pos ) : _files(files), _pos(pos) {}
+
+         void skip( size_t s ) {
+            const size_t buffered = std::min( s, _buffer.size() - _next );
+            _next += buffered;
+            _pos += s - buffered;
+         }
+
+         bool read( char* d, size_t s ) {
+            const size_t buffered = std::min( s, _buffer.size() - _next );
+            memcpy( d, _buffer.data() + _next, buffered );
+            _next += buffered;
+            d += buffered;
+            s -= buffered;
+            if( s >= buffer_size ) {
+               _files.read( _files.block_fd, d, s, _pos );
+               _pos += s;
+            } else if( s > 0 ) {
+               fill( s );
+               memcpy( d, _buffer.data(), s );
+               _next = s;
+            }
+            return true;
+         }
+
+         bool get( unsigned char& c ) { return get( *(char*)&c ); }
+
+         bool get( char& c ) { return read(&c, 1); }
+
+      private:
+         static constexpr size_t buffer_size = 64*1024;
+
+         // refills the buffer from _pos with at least min_size bytes, fewer than buffer_size when the file ends
+         void fill( size_t min_size ) {
+            _buffer.resize( buffer_size );
+            ssize_t n = 0;
+            size_t filled = 0;
+            while( filled < min_size ) {
+               n = ::pread( _files.block_fd, _buffer.data() + filled, buffer_size - filled, _pos + filled );
+               if( n < 0 && errno == EINTR ) continue;
+               EOS_ASSERT( n > 0, block_log_exception, "only able to read ${act} bytes of the expected ${exp} bytes in file: ${file}",
+                           ("act", filled)("exp", min_size)("file", _files.block_file_name.generic_string()) );
+               filled += n;
+            }
+            _buffer.resize( filled );
+            _pos += filled;
+         }
+
+         const readable_files& _files;
+         uint64_t              _pos;    ///< of the end of the buffer
+         std::vector<char>     _buffer;
+         size_t                _next = 0;
+      };
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
@@ -47,6 +200,44 @@ namespace eosio { namespace chain {
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
+            bool                     compressed = false;
+            bool                     compress_new_log = false;
+
+            struct retained_partition {
+               uint32_t                    last_block_num = 0;
+               fc::path                    block_file;
+               std::shared_ptr<block_log>  log;          // opened on the first read
+            };
+            block_log_partition_config                partitions;
+            fc::path                                  data_dir;
+            fc::path                                  retained_dir;
+            fc::path                                  archive_dir;
+            std::map<uint32_t, retained_partition>    retained;   // by first block number
+            mutable std::mutex                        retained_mtx; // protects retained, read from any thread
+
+            std::shared_ptr<readable_files>           readable; // accessed with std::atomic_load and std::atomic_store
+
+            // blocks being compressed ahead of their append, by block number
+            using compressed_entry_future = std::pair<signed_block_ptr, std::future<std::vector<char>>>;
+            std::mutex                                       pending_mtx; // protects pending_entries
+            std::multimap<uint32_t, compressed_entry_future> pending_entries;
+            fc::optional<named_thread_pool>                  compress_thread;
+            static constexpr size_t                          max_pending_entries = 4096;
+
+            // blocks of append_async, written in order by the writer thread
+            fc::optional<named_thread_pool>                  write_thread;
+            std::mutex                                       queue_mtx;
+            std::condition_variable                          queue_cv;
+            struct queued_block {
+               signed_block_ptr                         block;
+               std::shared_ptr<const std::vector<char>> packed; ///< block packed already, if it was
+            };
+            std::map<uint32_t, queued_block>                 queued;      ///< appended but not yet readable from the files, by block number
+            std::exception_ptr                               write_error; ///< of the first failed write, the blocks after it are dropped
+            static constexpr size_t                          max_queued_appends = 1024;
+
+            std::unique_ptr<trx_block_index>                 trx_index; ///< engaged by open_trx_index()
+            std::unique_ptr<account_bloom_index>             account_index; ///< engaged by open_account_index()
 
             inline void check_open_files() {
                if( !open_files ) {
@@ -66,6 +257,10 @@ namespace eosio { namespace chain {
             template<typename T>
             void reset( const T& t, const signed_block_ptr& genesis_block, uint32_t first_block_num );
 
+            /// recreates the files, empty but for their header
+            template<typename T>
+            void reset_files( const T& t, uint32_t first_block_num );
+
             void write( const genesis_state& gs );
 
             void write( const chain_id_type& chain_id );
@@ -74,10 +269,119 @@ namespace eosio { namespace chain {
 
             uint64_t append(const signed_block_ptr& b);
 
+            /// writes b, packed unless it is given packed, to the files, without touching head and head_id which may be ahead of the files
+            uint64_t write_block(const signed_block_ptr& b, const std::vector<char>* packed = nullptr);
+
+            void append_async(const signed_block_ptr& b, std::shared_ptr<const std::vector<char>> packed);
+            void write_queued(const queued_block& q);
+            /// waits until the blocks of append_async are written, returning the error of a failed write if any
+            std::exception_ptr wait_for_writes();
+            fc::optional<queued_block> find_queued(uint32_t block_num);
+
+            void prepare_append(const signed_block_ptr& b);
+
+            std::vector<char> take_compressed_entry(const signed_block_ptr& b);
+
             template <typename ChainContext, typename Lambda>
-            static fc::optional<ChainContext> extract_chain_context( const fc::path& data_dir, Lambda&& lambda );
+            static fc::optional<ChainContext> extract_chain_context( const fc::path& block_file_name, Lambda&& lambda );
+
+            static chain_id_type read_chain_id( const fc::path& block_file_name );
+
+            void open_retained();
+            void resume_after_retained();
+            void split( uint32_t last_block_num );
+            void apply_retention();
+            std::shared_ptr<block_log> retained_log( uint32_t block_num );
+
+            /// opens the files for reading, publishing them to readers with the blocks up to last_block_num
+            void publish_readable( uint32_t last_block_num = 0 );
+            std::shared_ptr<readable_files> get_readable()const;
+            /// makes the blocks up to last_block_num, ending at end_pos in the block file, readable
+            void set_readable( uint32_t last_block_num, uint64_t end_pos );
       };
 
+      readable_files::readable_files( const fc::path& block_file_name, const fc::path& index_file_name, uint32_t first_block_num, bool compressed )
+      :block_file_name( block_file_name )
+      ,first_block_num( first_block_num )
+      ,compressed( compressed )
+      {
+         block_fd = ::open( block_file_name.generic_string().c_str(), O_RDONLY | O_CLOEXEC );
+         index_fd = ::open( index_file_name.generic_string().c_str(), O_RDONLY | O_CLOEXEC );
+         if( block_fd < 0 || index_fd < 0 ) {
+            const int err = errno;
+            if( block_fd >= 0 ) ::close( block_fd );
+            if( index_fd >= 0 ) ::close( index_fd );
+            EOS_THROW( block_log_exception, "Unable to open ${file} for reading: ${e}",
+                       ("file", block_file_name.generic_string())("e", strerror(err)) );
+         }
+      }
+
+      readable_files::~readable_files() {
+         ::close( block_fd );
+         ::close( index_fd );
+      }
+
+      void readable_files::read( int fd, char* data, size_t size, uint64_t pos )const {
+         while( size > 0 ) {
+            const ssize_t n = ::pread( fd, data, size, pos );
+            if( n < 0 && errno == EINTR ) continue;
+            EOS_ASSERT( n > 0, block_log_exception, "Unable to read ${size} bytes at ${pos} of ${file}",
+                        ("size", size)("pos", pos)("file", block_file_name.generic_string()) );
+            data += n;
+            pos += n;
+            size -= n;
+         }
+      }
+
+      std::vector<char> readable_files::read_decompressed( uint64_t pos )const {
+         uint32_t header[2]; // block number and compressed size
+         read( block_fd, (char*)header, sizeof(header), pos );
+         std::vector<char> data( header[1] );
+         read( block_fd, data.data(), data.size(), pos + sizeof(header) );
+         return decompress_entry( data.data(), data.size() );
+      }
+
+      /// unpacks T (a signed_block or its header) from the entry at pos
+      template<typename T>
+      void unpack_entry( const readable_files& files, uint64_t pos, T& result ) {
+         if( files.compressed ) {
+            const auto packed = files.read_decompressed( pos );
+            fc::datastream<const char*> ds( packed.data(), packed.size() );
+            fc::raw::unpack( ds, result );
+         } else {
+            pread_datastream ds( files, pos );
+            fc::raw::unpack( ds, result );
+         }
+      }
+
+      /// @return position of block_num in the block file, block_log::npos if files do not have it
+      uint64_t block_pos( const readable_files& files, uint32_t block_num ) {
+         const uint32_t last_block_num = files.last_block_num.load( std::memory_order_acquire );
+         if( last_block_num == 0 || block_num < files.first_block_num || block_num > last_block_num )
+            return block_log::npos;
+         uint64_t pos;
+         files.read( files.index_fd, (char*)&pos, sizeof(pos), sizeof(uint64_t) * (block_num - files.first_block_num) );
+         return pos;
+      }
+
+      fc::path index_file_for( const fc::path& block_file_name ) {
+         return fc::path( block_file_name ).replace_extension( ".index" );
+      }
+
+      fc::path partition_file_name( uint32_t first_block_num, uint32_t last_block_num ) {
+         return "blocks-" + std::to_string( first_block_num ) + "-" + std::to_string( last_block_num ) + ".log";
+      }
+
+      // rename, or copy when the directories are on different file systems
+      void move_file( const fc::path& from, const fc::path& to ) {
+         try {
+            fc::rename( from, to );
+         } catch( const fc::exception& ) {
+            fc::copy( from, to );
+            fc::remove( from );
+         }
+      }
+
       void detail::block_log_impl::reopen() {
          close();
 
@@ -181,31 +485,52 @@ namespace eosio { namespace chain {
       };
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   block_log::block_log(const fc::path& data_dir, bool compress_new_log, const block_log_partition_config& partitions)
    :my(new detail::block_log_impl()) {
+      my->compress_new_log = compress_new_log;
+      my->partitions = partitions;
       open(data_dir);
    }
 
+   block_log::block_log(const fc::path& block_file_name, const fc::path& index_file_name)
+   :my(new detail::block_log_impl()) {
+      open(block_file_name, index_file_name);
+   }
+
    block_log::block_log(block_log&& other) {
       my = std::move(other.my);
    }
 
    block_log::~block_log() {
       if (my) {
-         flush();
+         // a failed write was already logged by the writer
+         my->wait_for_writes();
+         my->write_thread.reset();
+         my->flush();
          my->close();
          my.reset();
       }
    }
 
    void block_log::open(const fc::path& data_dir) {
-      my->close();
-
       if (!fc::is_directory(data_dir))
          fc::create_directories(data_dir);
 
-      my->block_file.set_file_path( data_dir / "blocks.log" );
-      my->index_file.set_file_path( data_dir / "blocks.index" );
+      my->data_dir = data_dir;
+      if (my->partitions.stride)
+         my->open_retained();
+
+      open(data_dir / "blocks.log", data_dir / "blocks.index");
+
+      if (!my->retained.empty())
+         my->resume_after_retained();
+   }
+
+   void block_log::open(const fc::path& block_file_name, const fc::path& index_file_name) {
+      my->close();
+
+      my->block_file.set_file_path( block_file_name );
+      my->index_file.set_file_path( index_file_name );
 
       my->reopen();
 
@@ -239,7 +564,10 @@ namespace eosio { namespace chain {
          EOS_ASSERT( is_supported_version(my->version), block_log_unsupported_version,
                      "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
                      ("version", my->version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
-
+         my->compressed = is_compressed_version(my->version);
+         if (my->compress_new_log && !my->compressed) {
+            ilog("Existing block log is not compressed, it keeps being written uncompressed");
+         }
 
          my->genesis_written_to_block_log = true; // Assume it was constructed properly.
          if (my->version > 1){
@@ -250,6 +578,7 @@ namespace eosio { namespace chain {
             my->first_block_num = 1;
          }
 
+         my->publish_readable();
          my->head = read_head();
          if( my->head ) {
             my->head_id = my->head->id();
@@ -284,16 +613,91 @@ namespace eosio { namespace chain {
          fc::remove_all( my->index_file.get_file_path() );
          my->reopen();
       }
+      // once the index is rebuilt, which replaces the index file
+      my->publish_readable( my->head ? block_header::num_from_id(my->head_id) : 0 );
    }
 
    uint64_t block_log::append(const signed_block_ptr& b) {
       return my->append(b);
    }
 
+   void block_log::append_async(const signed_block_ptr& b, std::shared_ptr<const std::vector<char>> packed) {
+      my->append_async(b, std::move(packed));
+   }
+
    uint64_t detail::block_log_impl::append(const signed_block_ptr& b) {
-      try {
-         EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
+      EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
+      if( auto e = wait_for_writes() )
+         std::rethrow_exception( e );
+      const uint64_t pos = write_block(b);
+      head = b;
+      head_id = b->id();
+      return pos;
+   }
+
+   void detail::block_log_impl::append_async(const signed_block_ptr& b, std::shared_ptr<const std::vector<char>> packed) {
+      EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
+      {
+         std::unique_lock<std::mutex> g( queue_mtx );
+         if( write_error )
+            std::rethrow_exception( write_error );
+         // the writer falling this far behind throttles the appends instead of queuing without bound
+         queue_cv.wait( g, [&]() { return queued.size() < max_queued_appends || write_error; } );
+         queued.emplace( b->block_num(), queued_block{ b, packed } );
+      }
+      head = b;
+      head_id = b->id();
+
+      if( !write_thread )
+         write_thread.emplace( "blklog", 1 );
+      boost::asio::post( write_thread->get_executor(), [this, q = queued_block{ b, std::move(packed) }]() {
+         write_queued(q);
+      } );
+   }
+
+   // called from the writer thread, which writes the queued blocks one at a time in order
+   void detail::block_log_impl::write_queued(const queued_block& q) {
+      const auto& b = q.block;
+      std::exception_ptr error;
+      {
+         std::lock_guard<std::mutex> g( queue_mtx );
+         error = write_error;
+      }
+      if( !error ) {
+         try {
+            write_block(b, q.packed.get());
+         } catch( const fc::exception& e ) {
+            elog( "Unable to append block ${n} to the block log: ${e}", ("n", b->block_num())("e", e.to_detail_string()) );
+            error = std::current_exception();
+         } catch( const std::exception& e ) {
+            elog( "Unable to append block ${n} to the block log: ${e}", ("n", b->block_num())("e", e.what()) );
+            error = std::current_exception();
+         }
+      }
+      // once written the block is read from the files, erasing it only now leaves no gap for readers
+      std::lock_guard<std::mutex> g( queue_mtx );
+      if( error && !write_error )
+         write_error = error;
+      queued.erase( b->block_num() );
+      queue_cv.notify_all();
+   }
+
+   std::exception_ptr detail::block_log_impl::wait_for_writes() {
+      std::unique_lock<std::mutex> g( queue_mtx );
+      queue_cv.wait( g, [&]() { return queued.empty(); } );
+      return write_error;
+   }
 
+   fc::optional<detail::block_log_impl::queued_block> detail::block_log_impl::find_queued(uint32_t block_num) {
+      std::lock_guard<std::mutex> g( queue_mtx );
+      auto itr = queued.find( block_num );
+      if( itr == queued.end() )
+         return {};
+      return itr->second;
+   }
+
+   uint64_t detail::block_log_impl::write_block(const signed_block_ptr& b, const std::vector<char>* packed) {
+      try {
          check_open_files();
 
          block_file.seek_end(0);
@@ -304,31 +708,116 @@ namespace eosio { namespace chain {
                    "Append to index file occuring at wrong position.",
                    ("position", (uint64_t) index_file.tellp())
                    ("expected", (b->block_num() - first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         block_file.write(data.data(), data.size());
+         std::vector<char> data;
+         if (compressed) {
+            data = take_compressed_entry(b);
+            packed = &data;
+         } else if (!packed) {
+            data = fc::raw::pack(*b);
+            packed = &data;
+         }
+         block_file.write(packed->data(), packed->size());
          block_file.write((char*)&pos, sizeof(pos));
          index_file.write((char*)&pos, sizeof(pos));
-         head = b;
-         head_id = b->id();
 
+         if (trx_index)
+            trx_index->add(*b);
+         if (account_index)
+            account_index->add(*b);
+
+         // readers see the block once it is flushed
          flush();
+         set_readable(b->block_num(), pos + packed->size() + sizeof(pos));
+
+         if (partitions.stride && b->block_num() % partitions.stride == 0)
+            split(b->block_num());
 
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   void block_log::prepare_append(const signed_block_ptr& b) {
+      my->prepare_append(b);
+   }
+
+   void detail::block_log_impl::prepare_append(const signed_block_ptr& b) {
+      // when the backlog is full the block is simply compressed by append itself
+      if( !get_readable()->compressed )
+         return;
+      if( head && b->block_num() <= block_header::num_from_id(head_id) )
+         return;
+
+      if( !compress_thread )
+         compress_thread.emplace( "blkcmp", 1 );
+      std::lock_guard<std::mutex> g( pending_mtx );
+      if( pending_entries.size() >= max_pending_entries )
+         return;
+      auto fut = async_thread_pool( compress_thread->get_executor(), [b]() {
+         return pack_compressed_entry( *b );
+      } );
+      pending_entries.emplace( b->block_num(), compressed_entry_future{ b, std::move(fut) } );
+   }
+
+   std::vector<char> detail::block_log_impl::take_compressed_entry(const signed_block_ptr& b) {
+      const uint32_t block_num = b->block_num();
+      std::future<std::vector<char>> fut;
+      {
+         std::lock_guard<std::mutex> g( pending_mtx );
+         auto range = pending_entries.equal_range( block_num );
+         for( auto itr = range.first; itr != range.second; ++itr ) {
+            if( itr->second.first == b ) {
+               fut = std::move( itr->second.second );
+               break;
+            }
+         }
+         // entries of this block number that were not taken belong to blocks of forks that were dropped
+         pending_entries.erase( pending_entries.begin(), pending_entries.upper_bound( block_num ) );
+      }
+
+      std::vector<char> entry;
+      if( fut.valid() )
+         entry = fut.get();
+      if( entry.empty() )
+         entry = pack_compressed_entry( *b );
+      return entry;
+   }
+
    void block_log::flush() {
+      auto error = my->wait_for_writes();
       my->flush();
+      if( error )
+         std::rethrow_exception( error );
    }
 
    void detail::block_log_impl::flush() {
       block_file.flush();
       index_file.flush();
+      if (trx_index)
+         trx_index->flush();
+      if (account_index)
+         account_index->flush();
    }
 
    template<typename T>
    void detail::block_log_impl::reset( const T& t, const signed_block_ptr& first_block, uint32_t first_bnum ) {
+      if( auto e = wait_for_writes() )
+         std::rethrow_exception( e );
+      reset_files( t, first_bnum );
+      if (trx_index)
+         trx_index->clear();
+      if (account_index)
+         account_index->clear();
+      if (first_block) {
+         append(first_block);
+      } else {
+         head.reset();
+         head_id = {};
+      }
+   }
+
+   template<typename T>
+   void detail::block_log_impl::reset_files( const T& t, uint32_t first_bnum ) {
       close();
 
       fc::remove_all( block_file.get_file_path() );
@@ -338,6 +827,12 @@ namespace eosio { namespace chain {
 
       version = 0; // version of 0 is invalid; it indicates that subsequent data was not properly written to the block log
       first_block_num = first_bnum;
+      compressed = compress_new_log;
+      {
+         std::lock_guard<std::mutex> g( pending_mtx );
+         pending_entries.clear();
+      }
+      publish_readable();
 
       block_file.seek_end(0);
       block_file.write((char*)&version, sizeof(version));
@@ -350,19 +845,12 @@ namespace eosio { namespace chain {
       auto totem = block_log::npos;
       block_file.write((char*)&totem, sizeof(totem));
 
-      if (first_block) {
-         append(first_block);
-      } else {
-         head.reset();
-         head_id = {};
-      }
-
       auto pos = block_file.tellp();
 
       static_assert( block_log::max_supported_version > 0, "a version number of zero is not supported" );
 
       // going back to write correct version to indicate that all block log header data writes completed successfully
-      version = block_log::max_supported_version;
+      version = compressed ? block_log::compressed_version : 3;
       block_file.seek( 0 );
       block_file.write( (char*)&version, sizeof(version) );
       block_file.seek( pos );
@@ -379,6 +867,133 @@ namespace eosio { namespace chain {
       my->reset(chain_id, signed_block_ptr(), first_block_num);
    }
 
+   void detail::block_log_impl::open_retained() {
+      retained_dir = partitions.retained_dir.empty() ? data_dir
+                   : partitions.retained_dir.is_relative() ? data_dir / partitions.retained_dir : partitions.retained_dir;
+      if (!partitions.archive_dir.empty())
+         archive_dir = partitions.archive_dir.is_relative() ? data_dir / partitions.archive_dir : partitions.archive_dir;
+      if (!fc::is_directory(retained_dir))
+         fc::create_directories(retained_dir);
+
+      for (fc::directory_iterator itr(retained_dir), end; itr != end; ++itr) {
+         const fc::path file = *itr;
+         if (!fc::is_regular_file(file))
+            continue;
+         const auto name = file.filename().generic_string();
+         uint32_t first = 0, last = 0;
+         if (sscanf(name.c_str(), "blocks-%u-%u.log", &first, &last) != 2 || partition_file_name(first, last).generic_string() != name)
+            continue;
+         EOS_ASSERT( first <= last, block_log_exception, "Retained block log ${f} has an invalid block range", ("f", name) );
+         auto& p = retained[first];
+         p.last_block_num = last;
+         p.block_file = file;
+      }
+
+      uint32_t expected = 0;
+      for (const auto& p : retained) {
+         EOS_ASSERT( !expected || p.first == expected, block_log_exception,
+                     "Retained block logs in ${dir} are not contiguous, expected one starting at block ${n}",
+                     ("dir", retained_dir.generic_string())("n", expected) );
+         expected = p.second.last_block_num + 1;
+      }
+      apply_retention();
+   }
+
+   void detail::block_log_impl::resume_after_retained() {
+      auto& newest = *retained.rbegin();
+      const uint32_t next_block_num = newest.second.last_block_num + 1;
+      if (!genesis_written_to_block_log) {
+         // the process stopped between moving a partition away and creating the blocks.log following it
+         ilog("Starting blocks.log at block ${n} after the retained block logs", ("n", next_block_num));
+         reset(read_chain_id(newest.second.block_file), signed_block_ptr(), next_block_num);
+      }
+      EOS_ASSERT( first_block_num == next_block_num, block_log_exception,
+                  "blocks.log starts at block ${f} but the retained block logs end at block ${l}",
+                  ("f", first_block_num)("l", newest.second.last_block_num) );
+      if (!head) {
+         auto log = retained_log(newest.second.last_block_num);
+         head = log->head();
+         head_id = log->head_id();
+      }
+   }
+
+   void detail::block_log_impl::split( uint32_t last_block_num ) {
+      const auto chain_id = read_chain_id(block_file.get_file_path());
+      const auto retained_file = retained_dir / partition_file_name(first_block_num, last_block_num);
+      ilog("Moving blocks ${f} to ${l} to ${file}", ("f", first_block_num)("l", last_block_num)("file", retained_file.generic_string()));
+
+      close();
+      move_file(index_file.get_file_path(), index_file_for(retained_file));
+      move_file(block_file.get_file_path(), retained_file);
+      {
+         // before the new blocks.log is readable, so that readers find the blocks it no longer has here
+         std::lock_guard<std::mutex> g( retained_mtx );
+         auto& p = retained[first_block_num];
+         p.last_block_num = last_block_num;
+         p.block_file = retained_file;
+      }
+
+      // the head stays the last block appended although the new blocks.log is empty
+      reset_files(chain_id, last_block_num + 1);
+
+      apply_retention();
+   }
+
+   void detail::block_log_impl::apply_retention() {
+      std::lock_guard<std::mutex> g( retained_mtx );
+      while (retained.size() > partitions.max_retained_files) {
+         auto oldest = retained.begin();
+         oldest->second.log.reset();
+         const auto& file = oldest->second.block_file;
+         if (archive_dir.empty()) {
+            ilog("Removing ${file}", ("file", file.generic_string()));
+            fc::remove(index_file_for(file));
+            fc::remove(file);
+         } else {
+            ilog("Moving ${file} to ${dir}", ("file", file.generic_string())("dir", archive_dir.generic_string()));
+            if (!fc::is_directory(archive_dir))
+               fc::create_directories(archive_dir);
+            move_file(index_file_for(file), archive_dir / index_file_for(file).filename());
+            move_file(file, archive_dir / file.filename());
+         }
+         retained.erase(oldest);
+      }
+   }
+
+   std::shared_ptr<block_log> detail::block_log_impl::retained_log( uint32_t block_num ) {
+      std::lock_guard<std::mutex> g( retained_mtx );
+      auto itr = retained.upper_bound(block_num);
+      if (itr == retained.begin())
+         return nullptr;
+      --itr;
+      if (block_num > itr->second.last_block_num)
+         return nullptr;
+      if (!itr->second.log)
+         itr->second.log = std::make_shared<block_log>(itr->second.block_file, index_file_for(itr->second.block_file));
+      return itr->second.log;
+   }
+
+   void detail::block_log_impl::publish_readable( uint32_t last_block_num ) {
+      auto files = std::make_shared<readable_files>( block_file.get_file_path(), index_file.get_file_path(), first_block_num, compressed );
+      if( last_block_num >= first_block_num ) {
+         files->last_block_num = last_block_num;
+         files->end_pos = fc::file_size( block_file.get_file_path() );
+      }
+      std::atomic_store( &readable, std::move(files) );
+   }
+
+   std::shared_ptr<detail::readable_files> detail::block_log_impl::get_readable()const {
+      auto files = std::atomic_load( &readable );
+      EOS_ASSERT( files, block_log_exception, "Block log is not open" );
+      return files;
+   }
+
+   void detail::block_log_impl::set_readable( uint32_t last_block_num, uint64_t end_pos ) {
+      auto files = get_readable();
+      files->end_pos.store( end_pos, std::memory_order_release );
+      files->last_block_num.store( last_block_num, std::memory_order_release );
+   }
+
    void detail::block_log_impl::write( const genesis_state& gs ) {
       auto data = fc::raw::pack(gs);
       block_file.write(data.data(), data.size());
@@ -389,29 +1004,31 @@ namespace eosio { namespace chain {
    }
 
    signed_block_ptr block_log::read_block(uint64_t pos)const {
-      my->check_open_files();
-
-      my->block_file.seek(pos);
+      const auto files = my->get_readable();
       signed_block_ptr result = std::make_shared<signed_block>();
-      auto ds = my->block_file.create_datastream();
-      fc::raw::unpack(ds, *result);
+      detail::unpack_entry(*files, pos, *result);
       return result;
    }
 
    void block_log::read_block_header(block_header& bh, uint64_t pos)const {
-      my->check_open_files();
-
-      my->block_file.seek(pos);
-      auto ds = my->block_file.create_datastream();
-      fc::raw::unpack(ds, bh);
+      const auto files = my->get_readable();
+      detail::unpack_entry(*files, pos, bh);
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
+         if (auto q = my->find_queued(block_num))
+            return q->block;
+         const auto files = my->get_readable();
+         if (block_num < files->first_block_num) {
+            auto log = my->retained_log(block_num);
+            return log ? log->read_block_by_num(block_num) : signed_block_ptr();
+         }
          signed_block_ptr b;
-         uint64_t pos = get_block_pos(block_num);
+         uint64_t pos = detail::block_pos(*files, block_num);
          if (pos != npos) {
-            b = read_block(pos);
+            b = std::make_shared<signed_block>();
+            detail::unpack_entry(*files, pos, *b);
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
          }
@@ -419,12 +1036,60 @@ namespace eosio { namespace chain {
       } FC_LOG_AND_RETHROW()
    }
 
+   std::vector<char> block_log::read_serialized_block_by_num(uint32_t block_num)const {
+      try {
+         if (auto q = my->find_queued(block_num))
+            return q->packed ? *q->packed : fc::raw::pack(*q->block);
+         const auto files = my->get_readable();
+         if (block_num < files->first_block_num) {
+            auto log = my->retained_log(block_num);
+            return log ? log->read_serialized_block_by_num(block_num) : std::vector<char>();
+         }
+         std::vector<char> result;
+         uint64_t pos = detail::block_pos(*files, block_num);
+         if (pos == npos)
+            return result;
+
+         if (files->compressed) {
+            result = files->read_decompressed(pos);
+         } else {
+            // the entry of a block ends with its position, followed by the next entry or the end of the file
+            uint64_t end_pos = 0;
+            if (block_num < files->last_block_num.load(std::memory_order_acquire)) {
+               end_pos = detail::block_pos(*files, block_num + 1);
+            } else {
+               end_pos = files->end_pos.load(std::memory_order_acquire);
+            }
+            EOS_ASSERT(end_pos >= pos + sizeof(uint64_t), block_log_exception,
+                       "Block log has invalid positions for block ${b}", ("b", block_num));
+            result.resize(end_pos - pos - sizeof(uint64_t));
+            files->read(files->block_fd, result.data(), result.size(), pos);
+         }
+
+         uint32_t prior_blknum = 0;
+         EOS_ASSERT(result.size() >= trim_data::blknum_offset + sizeof(prior_blknum), block_log_exception,
+                    "Block ${b} in block log is truncated", ("b", block_num));
+         memcpy(&prior_blknum, result.data() + trim_data::blknum_offset, sizeof(prior_blknum));
+         const uint32_t returned = fc::endian_reverse_u32(prior_blknum) + 1;
+         EOS_ASSERT(returned == block_num, reversible_blocks_exception,
+                    "Wrong block was read from block log.", ("returned", returned)("expected", block_num));
+         return result;
+      } FC_LOG_AND_RETHROW()
+   }
+
    block_id_type block_log::read_block_id_by_num(uint32_t block_num)const {
       try {
-         uint64_t pos = get_block_pos(block_num);
+         if (auto q = my->find_queued(block_num))
+            return q->block->id();
+         const auto files = my->get_readable();
+         if (block_num < files->first_block_num) {
+            auto log = my->retained_log(block_num);
+            return log ? log->read_block_id_by_num(block_num) : block_id_type();
+         }
+         uint64_t pos = detail::block_pos(*files, block_num);
          if (pos != npos) {
             block_header bh;
-            read_block_header(bh, pos);
+            detail::unpack_entry(*files, pos, bh);
             EOS_ASSERT(bh.block_num() == block_num, reversible_blocks_exception,
                        "Wrong block header was read from block log.", ("returned", bh.block_num())("expected", block_num));
             return bh.id();
@@ -433,14 +1098,197 @@ namespace eosio { namespace chain {
       } FC_LOG_AND_RETHROW()
    }
 
+   void block_log::open_trx_index() {
+      if (my->trx_index)
+         return;
+      if( auto e = my->wait_for_writes() )
+         std::rethrow_exception( e );
+      auto index = std::make_unique<trx_block_index>(my->data_dir / "trx.index");
+      const uint32_t head_num = my->head ? block_header::num_from_id(my->head_id) : 0;
+      if (index->last_block_num() > head_num) {
+         // the entries of the blocks past the head are left, lookups check the blocks they point to
+         index->set_last_block_num(head_num);
+      } else if (index->last_block_num() < head_num) {
+         const uint32_t first = std::max(index->last_block_num() + 1, first_block_num());
+         ilog("Adding blocks ${f} to ${l} to ${file}, eosio-blocklog --make-trx-index builds it faster from a stopped node",
+              ("f", first)("l", head_num)("file", index->file().generic_string()));
+         for (uint32_t n = first; n <= head_num; ++n) {
+            auto b = read_block_by_num(n);
+            EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", n) );
+            index->add(*b);
+            if (n % 100000 == 0)
+               ilog("Added block ${n} to ${file}", ("n", n)("file", index->file().generic_string()));
+         }
+      }
+      index->flush();
+      my->trx_index = std::move(index);
+   }
+
+   bool block_log::has_trx_index()const {
+      return !!my->trx_index;
+   }
+
+   vector<uint32_t> block_log::find_trx_block_nums(const transaction_id_type& id)const {
+      if (!my->trx_index)
+         return {};
+      vector<uint32_t> result;
+      {
+         // blocks are indexed once they are written
+         std::lock_guard<std::mutex> g( my->queue_mtx );
+         for (auto itr = my->queued.rbegin(); itr != my->queued.rend(); ++itr) {
+            if (trx_block_index::contains(*itr->second.block, id))
+               result.push_back(itr->first);
+         }
+      }
+      for (uint32_t n : my->trx_index->find(id)) {
+         if (result.empty() || n < result.back())
+            result.push_back(n);
+      }
+      return result;
+   }
+
+   void block_log::construct_trx_index(const fc::path& data_dir, const fc::path& index_file, uint32_t threads) {
+      block_log log(data_dir);
+      EOS_ASSERT( log.head(), block_log_exception, "No blocks found in block log" );
+      const uint32_t first = log.first_block_num();
+      const uint32_t last = log.head()->block_num();
+
+      if (fc::exists(index_file))
+         fc::remove(index_file);
+      trx_block_index index(index_file);
+      ilog("Indexing the transactions of blocks ${f} to ${l} into ${file}", ("f", first)("l", last)("file", index_file.generic_string()));
+
+      // blocks are read with positional reads and their transaction ids computed on every thread, the index takes
+      // the entries in any order
+      constexpr uint32_t blocks_per_task = 1000;
+      std::atomic<uint64_t> next{first};
+      std::mutex error_mtx;
+      std::exception_ptr error;
+      auto work = [&]() {
+         try {
+            for (uint64_t start = next.fetch_add(blocks_per_task); start <= last; start = next.fetch_add(blocks_per_task)) {
+               const uint32_t end = std::min<uint64_t>(start + blocks_per_task - 1, last);
+               for (uint32_t n = start; n <= end; ++n) {
+                  auto b = log.read_block_by_num(n);
+                  EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", n) );
+                  for (const auto& id : trx_block_index::transaction_ids(*b))
+                     index.add(id, n);
+               }
+               if (end / 100000 != (start - 1) / 100000)
+                  ilog("Indexed blocks ${s} to ${e}", ("s", start)("e", end));
+            }
+         } catch (...) {
+            std::lock_guard<std::mutex> g(error_mtx);
+            if (!error)
+               error = std::current_exception();
+            next = uint64_t(last) + 1;
+         }
+      };
+      std::vector<std::thread> workers;
+      for (uint32_t i = 1; i < threads; ++i)
+         workers.emplace_back(work);
+      work();
+      for (auto& w : workers)
+         w.join();
+      if (error)
+         std::rethrow_exception(error);
+
+      index.set_last_block_num(last);
+      index.flush();
+   }
+
+   void block_log::open_account_index() {
+      if (my->account_index)
+         return;
+      if( auto e = my->wait_for_writes() )
+         std::rethrow_exception( e );
+      auto index = std::make_unique<account_bloom_index>(my->data_dir / "accounts.bloom");
+      const uint32_t head_num = my->head ? block_header::num_from_id(my->head_id) : 0;
+      if (index->last_block_num() > head_num) {
+         // the bits of the blocks past the head are left, lookups check the blocks of the ranges they return
+         index->set_last_block_num(head_num);
+      } else if (index->last_block_num() < head_num) {
+         const uint32_t first = std::max(index->last_block_num() + 1, first_block_num());
+         ilog("Adding blocks ${f} to ${l} to ${file}, eosio-blocklog --make-account-index builds it faster from a stopped node",
+              ("f", first)("l", head_num)("file", index->file().generic_string()));
+         for (uint32_t n = first; n <= head_num; ++n) {
+            auto b = read_block_by_num(n);
+            EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", n) );
+            index->add(*b);
+            if (n % 100000 == 0)
+               ilog("Added block ${n} to ${file}", ("n", n)("file", index->file().generic_string()));
+         }
+      }
+      index->flush();
+      my->account_index = std::move(index);
+   }
+
+   bool block_log::has_account_index()const {
+      return !!my->account_index;
+   }
+
+   vector<std::pair<uint32_t, uint32_t>> block_log::find_account_block_ranges(uint32_t first, uint32_t last,
+                                                                              const fc::optional<account_name>& account,
+                                                                              const fc::optional<action_name>& action)const {
+      if (!my->account_index)
+         return first <= last ? vector<std::pair<uint32_t, uint32_t>>{{first, last}} : vector<std::pair<uint32_t, uint32_t>>{};
+      return my->account_index->find(first, last, account, action);
+   }
+
+   void block_log::construct_account_index(const fc::path& data_dir, const fc::path& index_file, uint32_t threads) {
+      block_log log(data_dir);
+      EOS_ASSERT( log.head(), block_log_exception, "No blocks found in block log" );
+      const uint32_t first = log.first_block_num();
+      const uint32_t last = log.head()->block_num();
+
+      if (fc::exists(index_file))
+         fc::remove(index_file);
+      account_bloom_index index(index_file);
+      ilog("Indexing the accounts of blocks ${f} to ${l} into ${file}", ("f", first)("l", last)("file", index_file.generic_string()));
+
+      // each task fills the filter of a whole range on its own and writes it at once
+      std::atomic<uint32_t> next{index.range_of(first)};
+      const uint32_t last_range = index.range_of(last);
+      std::mutex error_mtx;
+      std::exception_ptr error;
+      auto work = [&]() {
+         try {
+            account_bloom_index::filter f(index.filter_bytes());
+            for (uint32_t range = next++; range <= last_range; range = next++) {
+               std::fill(f.bits().begin(), f.bits().end(), 0);
+               const uint32_t start = std::max(first, index.first_block_of(range));
+               const uint32_t end = std::min<uint64_t>(last, uint64_t(index.first_block_of(range)) + index.blocks_per_range() - 1);
+               for (uint32_t n = start; n <= end; ++n) {
+                  auto b = log.read_block_by_num(n);
+                  EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", n) );
+                  f.add(*b);
+               }
+               index.write_range(range, f);
+               if (end / 100000 != (start - 1) / 100000)
+                  ilog("Indexed blocks ${s} to ${e}", ("s", start)("e", end));
+            }
+         } catch (...) {
+            std::lock_guard<std::mutex> g(error_mtx);
+            if (!error)
+               error = std::current_exception();
+            next = last_range + 1;
+         }
+      };
+      std::vector<std::thread> workers;
+      for (uint32_t i = 1; i < threads; ++i)
+         workers.emplace_back(work);
+      work();
+      for (auto& w : workers)
+         w.join();
+      if (error)
+         std::rethrow_exception(error);
+
+      index.set_last_block_num(last);
+      index.flush();
+   }
+
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_open_files();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
-         return npos;
-      my->index_file.seek(sizeof(uint64_t) * (block_num - my->first_block_num));
-      uint64_t pos;
-      my->index_file.read((char*)&pos, sizeof(pos));
-      return pos;
+      return detail::block_pos(*my->get_readable(), block_num);
    }
 
    signed_block_ptr block_log::read_head()const {
@@ -471,7 +1319,20 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_log::first_block_num() const {
-      return my->first_block_num;
+      std::lock_guard<std::mutex> g( my->retained_mtx );
+      return my->retained.empty() ? my->get_readable()->first_block_num : my->retained.begin()->first;
+   }
+
+   uint32_t block_log::log_first_block_num() const {
+      return my->get_readable()->first_block_num;
+   }
+
+   uint32_t block_log::version() const {
+      return my->version;
+   }
+
+   bool block_log::is_compressed() const {
+      return my->compressed;
    }
 
    void block_log::construct_index() {
@@ -485,17 +1346,264 @@ namespace eosio { namespace chain {
 
       my->close();
 
-      block_log::construct_index(my->block_file.get_file_path(), my->index_file.get_file_path());
+      block_log::construct_index(my->block_file.get_file_path(), my->index_file.get_file_path(),
+                                 std::min(std::max(std::thread::hardware_concurrency(), 1U), 8U));
 
       my->reopen();
    } // construct_index
 
-   void block_log::construct_index(const fc::path& block_file_name, const fc::path& index_file_name) {
+   namespace detail {
+      // entries larger than this are not considered when looking for a block boundary in a region of the log
+      constexpr uint64_t max_indexed_entry_size = 1ULL << 26;
+
+      // regions smaller than this are not worth a thread of their own
+      constexpr uint64_t min_index_region_size = 1ULL << 26;
+
+      /*
+       *  @brief random access reads of a block log through a window which ends at the requested position
+       *
+       *  Made for walking a file backwards, each thread of construct_index uses its own.
+       */
+      class window_reader {
+      public:
+         explicit window_reader(const std::string& file_name)
+         : _file(FC_FOPEN(file_name.c_str(), "rb"), &fclose)
+         , _file_name(file_name)
+         , _buffer_ptr(std::make_unique<char[]>(_buf_len)) {
+            EOS_ASSERT( _file, block_log_exception, "Could not open Block log file at '${blocks_log}'", ("blocks_log", _file_name) );
+         }
+
+         template<typename T>
+         T read(uint64_t pos) {
+            if (pos < _start || pos + sizeof(T) > _start + _size)
+               load(pos + sizeof(T));
+            T result;
+            memcpy(&result, _buffer_ptr.get() + (pos - _start), sizeof(T));
+            return result;
+         }
+
+         constexpr static uint64_t _buf_len = 1U << 24;
+      private:
+         void load(uint64_t end) {
+            _start = end > _buf_len ? end - _buf_len : 0;
+            _size = 0;
+            auto status = fseek(_file.get(), _start, SEEK_SET);
+            EOS_ASSERT( status == 0, block_log_exception, "Could not seek in '${blocks_log}' to position: ${pos}. Returned status: ${status}", ("blocks_log", _file_name)("pos", _start)("status", status) );
+            const uint64_t size = fread(_buffer_ptr.get(), 1, end - _start, _file.get());
+            EOS_ASSERT( size == end - _start, block_log_exception, "Could not read in '${blocks_log}' at position: ${pos}", ("blocks_log", _file_name)("pos", _start) );
+            _size = size;
+         }
+
+         unique_file                    _file;
+         const std::string              _file_name;
+         std::unique_ptr<char[]>        _buffer_ptr;
+         uint64_t                       _start = 0;
+         uint64_t                       _size  = 0;
+      };
+
+      /*
+       *  @brief writes the positions of a run of blocks, found from the highest block number down, into their slots
+       *         of a presized index file
+       */
+      class region_index_writer {
+      public:
+         region_index_writer(const std::string& index_file_name, uint32_t first_block_num)
+         : _file(FC_FOPEN(index_file_name.c_str(), "r+b"), &fclose)
+         , _index_file_name(index_file_name)
+         , _first_block_num(first_block_num) {
+            EOS_ASSERT( _file, block_log_exception, "Could not open Block index file at '${blocks_index}'", ("blocks_index", _index_file_name) );
+            _positions.reserve(_max_positions);
+         }
+
+         void write(uint32_t block_num, uint64_t pos) {
+            if (!_positions.empty() && (_positions.size() == _max_positions || block_num + 1 != _lowest_block_num))
+               flush();
+            _positions.push_back(pos);
+            _lowest_block_num = block_num;
+         }
+
+         void flush() {
+            if (_positions.empty())
+               return;
+            std::reverse(_positions.begin(), _positions.end());
+            const uint64_t offset = uint64_t(_lowest_block_num - _first_block_num) * sizeof(uint64_t);
+            auto status = fseek(_file.get(), offset, SEEK_SET);
+            EOS_ASSERT( status == 0, block_log_exception, "Could not seek in '${blocks_index}' to position: ${pos}. Returned status: ${status}", ("blocks_index", _index_file_name)("pos", offset)("status", status) );
+            const auto written = fwrite(_positions.data(), sizeof(uint64_t), _positions.size(), _file.get());
+            EOS_ASSERT( written == _positions.size(), block_log_exception, "Could not write to '${blocks_index}' at position: ${pos}", ("blocks_index", _index_file_name)("pos", offset) );
+            _positions.clear();
+         }
+
+         void complete() {
+            flush();
+            EOS_ASSERT( fflush(_file.get()) == 0, block_log_exception, "Could not flush '${blocks_index}'", ("blocks_index", _index_file_name) );
+         }
+
+      private:
+         constexpr static size_t            _max_positions = index_writer::_buffer_bytes / sizeof(uint64_t);
+
+         unique_file                        _file;
+         const std::string                  _index_file_name;
+         const uint32_t                     _first_block_num;
+         uint32_t                           _lowest_block_num = 0;
+         std::vector<uint64_t>              _positions;
+      };
+
+      struct index_region_result {
+         bool     found                = false;    // false when the region holds no trailing position, one block spans it
+         uint64_t anchor_pos           = 0;        // last trailing position in the region
+         uint32_t anchor_block_num     = 0;        // block it points to
+         uint64_t previous_totem_pos   = 0;        // trailing position before the lowest block found, below the region
+         uint32_t lowest_block_num     = 0;
+      };
+
+      struct log_layout {
+         uint32_t version          = 0;
+         uint32_t first_block_num  = 0;
+         uint32_t last_block_num   = 0;
+         uint64_t eof              = 0;
+      };
+
+      // true if pos holds the trailing position of a block entry: it points back to a block whose number matches the
+      // trailing position in front of that block
+      bool is_trailing_position(window_reader& reader, const log_layout& log, uint64_t pos,
+                                uint64_t& block_pos, uint32_t& block_num) {
+         constexpr uint64_t min_block_pos = sizeof(uint32_t) + sizeof(uint64_t);
+         const uint64_t blknum_offset = trim_data::blknum_offset_for(log.version);
+         block_pos = reader.read<uint64_t>(pos);
+         if (block_pos < min_block_pos || block_pos + blknum_offset + sizeof(uint32_t) > pos ||
+             pos - block_pos > max_indexed_entry_size)
+            return false;
+         block_num = trim_data::block_num_from_raw(reader.read<uint32_t>(block_pos + blknum_offset), log.version);
+         if (block_num < log.first_block_num || block_num > log.last_block_num)
+            return false;
+         const uint64_t previous = reader.read<uint64_t>(block_pos - sizeof(uint64_t));
+         if (block_num == log.first_block_num)
+            return log.version == 1 || previous == block_log::npos;
+         if (previous < min_block_pos || previous + blknum_offset + sizeof(uint32_t) > block_pos - sizeof(uint64_t))
+            return false;
+         return trim_data::block_num_from_raw(reader.read<uint32_t>(previous + blknum_offset), log.version) == block_num - 1;
+      }
+
+      // indexes the blocks whose trailing position lies in [begin, end)
+      index_region_result index_region(const std::string& block_file_name, const std::string& index_file_name,
+                                       const log_layout& log, uint64_t begin, uint64_t end) {
+         window_reader reader(block_file_name);
+         index_region_result result;
+         uint64_t block_pos = 0;
+         uint32_t block_num = 0;
+         uint64_t pos = std::min(end - 1, log.eof - sizeof(uint64_t));
+         while (!is_trailing_position(reader, log, pos, block_pos, block_num)) {
+            if (pos == begin)
+               return result;
+            --pos;
+         }
+         result.found = true;
+         result.anchor_pos = pos;
+         result.anchor_block_num = block_num;
+
+         region_index_writer index(index_file_name, log.first_block_num);
+         while (true) {
+            index.write(block_num, block_pos);
+            if (block_num == log.first_block_num)
+               break;
+            pos = block_pos - sizeof(uint64_t);
+            if (pos < begin)
+               break;
+            const uint64_t previous = reader.read<uint64_t>(pos);
+            EOS_ASSERT( previous < pos, block_log_exception,
+                        "Block log file at '${blocks_log}' formatting is incorrect, indicates position later location in file: ${pos}, which was retrieved at: ${orig_pos}.",
+                        ("blocks_log", block_file_name)("pos", previous)("orig_pos", pos) );
+            block_pos = previous;
+            --block_num;
+         }
+         index.complete();
+         result.previous_totem_pos = block_pos - sizeof(uint64_t);
+         result.lowest_block_num = block_num;
+         return result;
+      }
+
+      /*
+       *  Splits the log into one region per thread. Each thread looks backwards from the end of its region for the last
+       *  trailing position in it, validated against the block numbers of the entry it points to and of the one before,
+       *  then follows the trailing positions down to the start of its region and writes the positions it found into
+       *  their slots of the presized index. The regions are stitched by checking that every walk ends on the trailing
+       *  position the region below it started from. Returns false, leaving the index to the sequential construction,
+       *  whenever the regions do not line up.
+       */
+      bool construct_index_parallel(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads) {
+         log_layout log;
+         {
+            reverse_iterator block_log_iter;
+            const uint32_t num_blocks = block_log_iter.open(block_file_name);
+            if (num_blocks == 0)
+               return false;
+            log.version = block_log_iter.version();
+            log.first_block_num = block_log_iter.first_block_num();
+            log.last_block_num = log.first_block_num + num_blocks - 1;
+         }
+         log.eof = fc::file_size(block_file_name);
+
+         const uint64_t header_end = sizeof(uint32_t);
+         const uint64_t regions = std::min<uint64_t>(threads, (log.eof - header_end) / min_index_region_size);
+         if (regions < 2)
+            return false;
+
+         {
+            unique_file index_file(FC_FOPEN(index_file_name.generic_string().c_str(), "wb"), &fclose);
+            EOS_ASSERT( index_file, block_log_exception, "Could not create Block index file at '${blocks_index}'", ("blocks_index", index_file_name.generic_string()) );
+         }
+         fc::resize_file(index_file_name, uint64_t(log.last_block_num - log.first_block_num + 1) * sizeof(uint64_t));
+
+         ilog("Indexing ${n} regions of ${file} in parallel", ("n", regions)("file", block_file_name.generic_string()));
+         const uint64_t region_size = (log.eof - header_end) / regions;
+         std::vector<std::future<index_region_result>> futures;
+         {
+            named_thread_pool pool("blkidx", regions);
+            for (uint64_t i = 0; i < regions; ++i) {
+               const uint64_t begin = header_end + i * region_size;
+               const uint64_t end = i + 1 == regions ? log.eof : begin + region_size;
+               futures.emplace_back(async_thread_pool(pool.get_executor(),
+                  [block_file = block_file_name.generic_string(), index_file = index_file_name.generic_string(), &log, begin, end]() {
+                     return index_region(block_file, index_file, log, begin, end);
+                  }));
+            }
+            for (auto& f : futures)
+               f.wait();
+         }
+
+         fc::optional<index_region_result> below;
+         for (auto& f : futures) {
+            const index_region_result r = f.get();
+            if (!r.found)
+               continue;
+            const bool stitched = below ? r.previous_totem_pos == below->anchor_pos && r.lowest_block_num == below->anchor_block_num + 1
+                                        : r.lowest_block_num == log.first_block_num;
+            if (!stitched) {
+               wlog("Regions of ${file} do not line up at block ${n}", ("file", block_file_name.generic_string())("n", r.lowest_block_num));
+               return false;
+            }
+            below = r;
+         }
+         return below && below->anchor_pos == log.eof - sizeof(uint64_t) && below->anchor_block_num == log.last_block_num;
+      }
+   }
+
+   void block_log::construct_index(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads) {
       detail::reverse_iterator block_log_iter;
 
       ilog("Will read existing blocks.log file ${file}", ("file", block_file_name.generic_string()));
       ilog("Will write new blocks.index file ${file}", ("file", index_file_name.generic_string()));
 
+      if (threads > 1) {
+         try {
+            if (detail::construct_index_parallel(block_file_name, index_file_name, threads))
+               return;
+         } FC_LOG_AND_DROP()
+         ilog("Falling back to reading ${file} sequentially", ("file", block_file_name.generic_string()));
+         fc::remove_all(index_file_name);
+      }
+
       const uint32_t num_blocks = block_log_iter.open(block_file_name);
 
       ilog("block log version= ${version}", ("version", block_log_iter.version()));
@@ -616,12 +1724,29 @@ namespace eosio { namespace chain {
 
       block_id_type previous;
 
+      const bool compressed = is_compressed_version(version);
+      vector<char> compressed_entry;
+
       uint64_t pos = old_block_stream.tellg();
       while( pos < end_pos ) {
          signed_block tmp;
 
          try {
-            fc::raw::unpack(old_block_stream, tmp);
+            if( compressed ) {
+               compressed_entry.resize( detail::compressed_entry_header_size );
+               old_block_stream.read( compressed_entry.data(), compressed_entry.size() );
+               EOS_ASSERT( old_block_stream.good(), block_log_exception, "Could not read compressed block header" );
+               uint32_t size = 0;
+               memcpy( &size, compressed_entry.data() + sizeof(uint32_t), sizeof(size) );
+               EOS_ASSERT( pos + compressed_entry.size() + size <= end_pos, block_log_exception,
+                           "Compressed block extends past the end of the block log" );
+               compressed_entry.resize( compressed_entry.size() + size );
+               old_block_stream.read( compressed_entry.data() + detail::compressed_entry_header_size, size );
+               EOS_ASSERT( old_block_stream.good(), block_log_exception, "Could not read compressed block" );
+               detail::unpack_compressed( compressed_entry.data() + detail::compressed_entry_header_size, size, tmp );
+            } else {
+               fc::raw::unpack(old_block_stream, tmp);
+            }
          } catch( ... ) {
             except_ptr = std::current_exception();
             incomplete_block_data.resize( end_pos - pos );
@@ -651,8 +1776,12 @@ namespace eosio { namespace chain {
             break;
          }
 
-         auto data = fc::raw::pack(tmp);
-         new_block_stream.write( data.data(), data.size() );
+         if( compressed ) {
+            new_block_stream.write( compressed_entry.data(), compressed_entry.size() );
+         } else {
+            auto data = fc::raw::pack(tmp);
+            new_block_stream.write( data.data(), data.size() );
+         }
          new_block_stream.write( reinterpret_cast<char*>(&pos), sizeof(pos) );
          block_num = tmp.block_num();
          if(block_num % 1000 == 0)
@@ -702,12 +1831,12 @@ namespace eosio { namespace chain {
    }
 
    template <typename ChainContext, typename Lambda>
-   fc::optional<ChainContext> detail::block_log_impl::extract_chain_context( const fc::path& data_dir, Lambda&& lambda ) {
-      EOS_ASSERT( fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
-                  "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir)          );
+   fc::optional<ChainContext> detail::block_log_impl::extract_chain_context( const fc::path& block_file_name, Lambda&& lambda ) {
+      EOS_ASSERT( fc::is_regular_file(block_file_name), block_log_not_found,
+                  "Block log not found at '${blocks_log}'", ("blocks_log", block_file_name)          );
 
       std::fstream  block_stream;
-      block_stream.open( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
+      block_stream.open( block_file_name.generic_string().c_str(), LOG_READ );
 
       uint32_t version = 0;
       block_stream.read( (char*)&version, sizeof(version) );
@@ -724,7 +1853,7 @@ namespace eosio { namespace chain {
    }
 
    fc::optional<genesis_state> block_log::extract_genesis_state( const fc::path& data_dir ) {
-      return detail::block_log_impl::extract_chain_context<genesis_state>(data_dir, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<genesis_state> {
+      return detail::block_log_impl::extract_chain_context<genesis_state>(data_dir / "blocks.log", [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<genesis_state> {
          if (contains_genesis_state(version, first_block_num)) {
             genesis_state gs;
             fc::raw::unpack(block_stream, gs);
@@ -737,14 +1866,18 @@ namespace eosio { namespace chain {
    }
 
    chain_id_type block_log::extract_chain_id( const fc::path& data_dir ) {
-      return *(detail::block_log_impl::extract_chain_context<chain_id_type>(data_dir, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<chain_id_type> {
+      return detail::block_log_impl::read_chain_id(data_dir / "blocks.log");
+   }
+
+   chain_id_type detail::block_log_impl::read_chain_id( const fc::path& block_file_name ) {
+      return *(extract_chain_context<chain_id_type>(block_file_name, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<chain_id_type> {
          // supported versions either contain a genesis state, or else the chain id only
-         if (contains_genesis_state(version, first_block_num)) {
+         if (block_log::contains_genesis_state(version, first_block_num)) {
             genesis_state gs;
             fc::raw::unpack(block_stream, gs);
             return gs.compute_chain_id();
          }
-         EOS_ASSERT( contains_chain_id(version, first_block_num), block_log_exception,
+         EOS_ASSERT( block_log::contains_chain_id(version, first_block_num), block_log_exception,
                      "Block log error! version: ${version} with first_block_num: ${num} does not contain a "
                      "chain id or genesis state, so the chain id cannot be determined.",
                      ("version", version)("num", first_block_num) );
@@ -797,19 +1930,20 @@ namespace eosio { namespace chain {
          return 0;
       }
 
+      const auto blknum_offset = trim_data::blknum_offset_for(_version);
       uint32_t bnum = 0;
       if (block_pos >= _start_of_buffer_position) {
          const uint32_t index_of_block = block_pos - _start_of_buffer_position;
-         bnum = *reinterpret_cast<uint32_t*>(buf + index_of_block + trim_data::blknum_offset);  //block number of previous block (is big endian)
+         bnum = *reinterpret_cast<uint32_t*>(buf + index_of_block + blknum_offset);
       }
       else {
-         const auto blknum_offset_pos = block_pos + trim_data::blknum_offset;
+         const auto blknum_offset_pos = block_pos + blknum_offset;
          auto status = fseek(_file.get(), blknum_offset_pos, SEEK_SET);
          EOS_ASSERT( status == 0, block_log_exception, "Could not seek in '${blocks_log}' to position: ${pos}. Returned status: ${status}", ("blocks_log", _block_file_name)("pos", blknum_offset_pos)("status", status) );
          auto size = fread((void*)&bnum, sizeof(bnum), 1, _file.get());
          EOS_ASSERT( size == 1, block_log_exception, "Could not read in '${blocks_log}' at position: ${pos}", ("blocks_log", _block_file_name)("pos", blknum_offset_pos) );
       }
-      _last_block_num = fc::endian_reverse_u32(bnum) + 1;                     //convert from big endian to little endian and add 1
+      _last_block_num = trim_data::block_num_from_raw(bnum, _version);
       _blocks_expected = _last_block_num - _first_block_num + 1;
       return _blocks_expected;
    }
@@ -956,6 +2090,10 @@ namespace eosio { namespace chain {
       return std::clamp(version, min_supported_version, max_supported_version) == version;
    }
 
+   bool block_log::is_compressed_version(uint32_t version) {
+      return version >= compressed_version;
+   }
+
    bool block_log::trim_blocklog_front(const fc::path& block_dir, const fc::path& temp_dir, uint32_t truncate_at_block) {
       using namespace std;
       EOS_ASSERT( block_dir != temp_dir, block_log_exception, "block_dir and temp_dir need to be different directories" );
@@ -985,9 +2123,10 @@ namespace eosio { namespace chain {
       new_block_file.close();
       new_block_file.open( LOG_RW_C );
 
-      static_assert( block_log::max_supported_version == 3,
-                     "Code was written to support version 3 format, need to update this code for latest format." );
-      uint32_t version = block_log::max_supported_version;
+      static_assert( block_log::max_supported_version == 4,
+                     "Code was written to support version 4 format, need to update this code for latest format." );
+      // versions 1 through 3 share their block layout and are rewritten as version 3, entries are copied unchanged
+      uint32_t version = std::max<uint32_t>(original_block_log.version, 3);
       new_block_file.seek(0);
       new_block_file.write((char*)&version, sizeof(version));
       new_block_file.write((char*)&truncate_at_block, sizeof(truncate_at_block));
@@ -1065,6 +2204,44 @@ namespace eosio { namespace chain {
       return true;
    }
 
+   void block_log::convert_log(const fc::path& data_dir, const fc::path& output_dir, bool compress) {
+      EOS_ASSERT( data_dir != output_dir, block_log_exception, "data_dir and output_dir need to be different directories" );
+      EOS_ASSERT( !fc::exists(output_dir / "blocks.log"), block_log_exception,
+                  "Block log already exists in '${dir}'", ("dir", output_dir.generic_string()) );
+
+      block_log original(data_dir);
+      EOS_ASSERT( original.head(), block_log_exception, "No blocks found in block log '${dir}'", ("dir", data_dir.generic_string()) );
+      const uint32_t first_block = original.first_block_num();
+      const uint32_t last_block = original.head()->block_num();
+      ilog("Converting blocks ${first} through ${last} of ${dir} to a ${c} block log in ${out}",
+           ("first", first_block)("last", last_block)("dir", data_dir.generic_string())
+           ("c", compress ? "compressed" : "uncompressed")("out", output_dir.generic_string()));
+
+      block_log converted(output_dir, compress);
+      uint32_t next_block = first_block;
+      auto gs = extract_genesis_state(data_dir);
+      if (gs) {
+         converted.reset(*gs, original.read_block_by_num(next_block++));
+      } else {
+         converted.reset(extract_chain_id(data_dir), first_block);
+      }
+
+      // keep the worker thread compressing blocks ahead of the ones being appended
+      constexpr uint32_t read_ahead = 64;
+      std::deque<signed_block_ptr> queued;
+      for (uint32_t n = next_block; n <= last_block || !queued.empty(); ) {
+         while (n <= last_block && queued.size() < read_ahead) {
+            queued.emplace_back(original.read_block_by_num(n++));
+            converted.prepare_append(queued.back());
+         }
+         converted.append(queued.front());
+         queued.pop_front();
+         if ((converted.head()->block_num() & 0xfffff) == 0)
+            ilog("Converted block ${b}", ("b", converted.head()->block_num()));
+      }
+      converted.flush();
+   }
+
    trim_data::trim_data(fc::path block_dir) {
 
       // code should follow logic in block_log::repair_log
@@ -1168,20 +2345,202 @@ namespace eosio { namespace chain {
       EOS_ASSERT( size == 1, block_log_exception, "cannot read ${file} entry for block ${b}", ("file", index_file_name.string())("b",n) );
 
       //read blocks.log and verify block number n is found at the determined file position
-      const auto calc_blknum_pos = block_n_pos + blknum_offset;
-      status = fseek(blk_in, calc_blknum_pos, SEEK_SET);
-      EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file", ("file", block_file_name.string())("pos", calc_blknum_pos) );
-      const uint64_t block_offset_pos = ftell(blk_in);
-      EOS_ASSERT( block_offset_pos == calc_blknum_pos, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file", ("file", block_file_name.string())("pos", calc_blknum_pos) );
-      uint32_t prior_blknum;
-      size = fread((void*)&prior_blknum, sizeof(prior_blknum), 1, blk_in);     //read bigendian block number of prior block
-      EOS_ASSERT( size == 1, block_log_exception, "cannot read prior block");
-      const uint32_t bnum = fc::endian_reverse_u32(prior_blknum) + 1;          //convert to little endian, add 1 since prior block
+      const uint32_t bnum = read_block_num(block_n_pos);
       EOS_ASSERT( bnum == n, block_log_exception,
                   "At position ${pos} in ${file} expected to find ${exp_bnum} but found ${act_bnum}",
-                  ("pos",block_offset_pos)("file", block_file_name.string())("exp_bnum",n)("act_bnum",bnum) );
+                  ("pos",block_n_pos)("file", block_file_name.string())("exp_bnum",n)("act_bnum",bnum) );
 
       return block_n_pos;
    }
 
+   uint32_t trim_data::read_block_num(uint64_t pos) {
+      const auto calc_blknum_pos = pos + blknum_offset_for(version);
+      auto status = fseek(blk_in, calc_blknum_pos, SEEK_SET);
+      EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file", ("file", block_file_name.string())("pos", calc_blknum_pos) );
+      const uint64_t block_offset_pos = ftell(blk_in);
+      EOS_ASSERT( block_offset_pos == calc_blknum_pos, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file", ("file", block_file_name.string())("pos", calc_blknum_pos) );
+      uint32_t raw_blknum;
+      auto size = fread((void*)&raw_blknum, sizeof(raw_blknum), 1, blk_in);
+      EOS_ASSERT( size == 1, block_log_exception, "cannot read block number at ${pos} in ${file}", ("pos", calc_blknum_pos)("file", block_file_name.string()) );
+      return block_num_from_raw(raw_blknum, version);
+   }
+
+   int trim_data::blknum_offset_for(uint32_t version) {
+      return block_log::is_compressed_version(version) ? compressed_blknum_offset : blknum_offset;
+   }
+
+   uint32_t trim_data::block_num_from_raw(uint32_t raw, uint32_t version) {
+      if (block_log::is_compressed_version(version))
+         return raw;
+      return fc::endian_reverse_u32(raw) + 1;          //big endian number of the prior block, convert to little endian and add 1
+   }
+
+   namespace detail {
+      class block_log_prefetcher_impl {
+         public:
+            block_log_prefetcher_impl( const fc::path& data_dir, uint32_t log_first_block_num,
+                                       uint32_t first_block_num, uint32_t last_block_num, size_t max_queued_blocks,
+                                       boost::asio::io_context& thread_pool, block_log_prefetcher::decoded_callback cb )
+            : block_file_name( data_dir / "blocks.log" )
+            , index_file_name( data_dir / "blocks.index" )
+            , log_first_block_num( log_first_block_num )
+            , first_block_num( first_block_num )
+            , last_block_num( last_block_num )
+            , max_queued_blocks( std::max<size_t>( max_queued_blocks, 1 ) )
+            , thread_pool( thread_pool )
+            , on_decoded( std::move( cb ) )
+            {
+               EOS_ASSERT( log_first_block_num <= first_block_num, block_log_exception,
+                           "cannot prefetch block ${b} from ${file}, its first block is ${first}",
+                           ("b", first_block_num)("file", block_file_name.string())("first", log_first_block_num) );
+               reader = std::thread( [this]() { read_blocks(); } );
+            }
+
+            signed_block_ptr next() {
+               std::unique_lock<std::mutex> g( mtx );
+               cv.wait( g, [this]() { return !queue.empty() || done; } );
+               if( queue.empty() ) {
+                  if( except ) std::rethrow_exception( except );
+                  return signed_block_ptr();
+               }
+               auto fut = std::move( queue.front() );
+               queue.pop_front();
+               g.unlock();
+               cv.notify_all();
+               return fut.get();
+            }
+
+            void stop() {
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  stopping = true;
+               }
+               cv.notify_all();
+               if( reader.joinable() )
+                  reader.join();
+            }
+
+         private:
+            void read_blocks() {
+               fc::set_os_thread_name( "blockpf" );
+               try {
+                  unique_file blk_in( FC_FOPEN( block_file_name.generic_string().c_str(), "rb" ), &fclose );
+                  EOS_ASSERT( blk_in, block_log_exception, "cannot read file ${file}", ("file", block_file_name.string()) );
+                  unique_file ind_in( FC_FOPEN( index_file_name.generic_string().c_str(), "rb" ), &fclose );
+                  EOS_ASSERT( ind_in, block_log_exception, "cannot read file ${file}", ("file", index_file_name.string()) );
+
+                  uint32_t version = 0;
+                  auto size = fread( (void*)&version, sizeof(version), 1, blk_in.get() );
+                  EOS_ASSERT( size == 1, block_log_exception, "cannot read version of ${file}", ("file", block_file_name.string()) );
+                  const bool compressed = block_log::is_compressed_version( version );
+
+                  const uint64_t block_file_size = fc::file_size( block_file_name );
+                  const uint64_t index_entries = fc::file_size( index_file_name ) / sizeof(uint64_t);
+                  EOS_ASSERT( last_block_num - log_first_block_num < index_entries, block_log_exception,
+                              "${file} has no entry for block ${b}", ("file", index_file_name.string())("b", last_block_num) );
+
+                  const uint64_t index_pos = sizeof(uint64_t) * (first_block_num - log_first_block_num);
+                  auto status = fseek( ind_in.get(), index_pos, SEEK_SET );
+                  EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file",
+                              ("file", index_file_name.string())("pos", index_pos) );
+
+                  auto read_index_entry = [&]() {
+                     uint64_t pos;
+                     auto size = fread( (void*)&pos, sizeof(pos), 1, ind_in.get() );
+                     EOS_ASSERT( size == 1, block_log_exception, "cannot read ${file} entry", ("file", index_file_name.string()) );
+                     return pos;
+                  };
+
+                  uint64_t pos = read_index_entry();
+                  for( uint32_t n = first_block_num; n <= last_block_num; ++n ) {
+                     // each entry in the block log is the packed block followed by its own position
+                     const bool has_next_entry = (uint64_t(n) + 1 - log_first_block_num) < index_entries;
+                     const uint64_t next_pos = has_next_entry ? read_index_entry() : block_file_size;
+                     EOS_ASSERT( next_pos >= pos + sizeof(uint64_t), block_log_exception,
+                                 "${file} has invalid positions for block ${b}", ("file", index_file_name.string())("b", n) );
+
+                     auto data = std::make_shared<std::vector<char>>( next_pos - pos - sizeof(uint64_t) );
+                     status = fseek( blk_in.get(), pos, SEEK_SET );
+                     EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file",
+                                 ("file", block_file_name.string())("pos", pos) );
+                     size = fread( data->data(), data->size(), 1, blk_in.get() );
+                     EOS_ASSERT( size == 1 || data->empty(), block_log_exception, "cannot read block ${b} from ${file}",
+                                 ("b", n)("file", block_file_name.string()) );
+
+                     auto fut = async_thread_pool( thread_pool, [data, n, compressed, cb = on_decoded]() {
+                        auto b = std::make_shared<signed_block>();
+                        if( compressed ) {
+                           EOS_ASSERT( data->size() >= compressed_entry_header_size, block_log_exception,
+                                       "Compressed block ${n} is truncated", ("n", n) );
+                           unpack_compressed( data->data() + compressed_entry_header_size,
+                                              data->size() - compressed_entry_header_size, *b );
+                        } else {
+                           fc::datastream<const char*> ds( data->data(), data->size() );
+                           fc::raw::unpack( ds, *b );
+                        }
+                        EOS_ASSERT( b->block_num() == n, block_log_exception,
+                                    "Wrong block was read from block log, expected ${n}, found ${b}",
+                                    ("n", n)("b", b->block_num()) );
+                        if( cb ) cb( b );
+                        return signed_block_ptr( std::move( b ) );
+                     } );
+
+                     std::unique_lock<std::mutex> g( mtx );
+                     cv.wait( g, [this]() { return queue.size() < max_queued_blocks || stopping; } );
+                     if( stopping ) break;
+                     queue.emplace_back( std::move( fut ) );
+                     g.unlock();
+                     cv.notify_all();
+
+                     pos = next_pos;
+                  }
+               } catch( ... ) {
+                  std::lock_guard<std::mutex> g( mtx );
+                  except = std::current_exception();
+               }
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  done = true;
+               }
+               cv.notify_all();
+            }
+
+            const fc::path                         block_file_name;
+            const fc::path                         index_file_name;
+            const uint32_t                         log_first_block_num;
+            const uint32_t                         first_block_num;
+            const uint32_t                         last_block_num;
+            const size_t                           max_queued_blocks;
+            boost::asio::io_context&               thread_pool;
+            block_log_prefetcher::decoded_callback on_decoded;
+
+            std::mutex                             mtx;
+            std::condition_variable                cv;
+            std::deque<std::future<signed_block_ptr>> queue;
+            std::exception_ptr                     except;
+            bool                                   done = false;
+            bool                                   stopping = false;
+            std::thread                            reader;
+      };
+   } /// namespace detail
+
+   block_log_prefetcher::block_log_prefetcher( const fc::path& data_dir, uint32_t log_first_block_num,
+                                               uint32_t first_block_num, uint32_t last_block_num, size_t max_queued_blocks,
+                                               boost::asio::io_context& thread_pool, decoded_callback cb )
+   : my( new detail::block_log_prefetcher_impl( data_dir, log_first_block_num, first_block_num, last_block_num,
+                                                max_queued_blocks, thread_pool, std::move( cb ) ) )
+   {}
+
+   block_log_prefetcher::~block_log_prefetcher() {
+      stop();
+   }
+
+   signed_block_ptr block_log_prefetcher::next() {
+      return my->next();
+   }
+
+   void block_log_prefetcher::stop() {
+      my->stop();
+   }
+
    } } /// eosio::chain
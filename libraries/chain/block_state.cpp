@@ -1,5 +1,6 @@
 #include <eosio/chain/block_state.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/memory_accounting.hpp>
 
 namespace eosio { namespace chain {
 
@@ -101,4 +102,21 @@ namespace eosio { namespace chain {
    ,_cached_trxs( std::move(trx_metas) )
    {}
 
+   std::shared_ptr<const std::vector<char>> block_state::packed_block()const {
+      auto packed = std::atomic_load( &_packed_block );
+      if( !packed ) {
+         std::shared_ptr<const std::vector<char>> expected;
+         auto* p = new std::vector<char>( fc::raw::pack( *block ) );
+         const uint64_t bytes = p->capacity();
+         memory_accounting::block_states().allocated( bytes );
+         packed = std::shared_ptr<const std::vector<char>>( p, [bytes]( const std::vector<char>* v ) {
+            memory_accounting::block_states().freed( bytes );
+            delete v;
+         } );
+         if( !std::atomic_compare_exchange_strong( &_packed_block, &expected, packed ) )
+            packed = expected;
+      }
+      return packed;
+   }
+
 } } /// eosio::chain
@@ -14,7 +14,7 @@
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 #include <eosio/chain/genesis_intrinsics.hpp>
 #include <eosio/chain/whitelisted_intrinsics.hpp>
 #include <eosio/chain/database_header_object.hpp>
@@ -25,6 +25,13 @@
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/transaction_conflict_detector.hpp>
+#include <eosio/chain/state_delta.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
+#include <eosio/chain/trx_block_index.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/startup_timeline.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
@@ -33,6 +40,7 @@
 #include <fc/variant_object.hpp>
 
 #include <new>
+#include <mutex>
 
 namespace eosio { namespace chain {
 
@@ -62,17 +70,52 @@ using contract_database_index_set = index_set<
    index_long_double_index
 >;
 
+/// tables whose changes are kept in the state_delta of validated blocks
+using state_delta_index_set = index_set<
+   account_index,
+   account_metadata_index,
+   account_ram_correction_index,
+   dynamic_global_property_multi_index,
+   block_summary_multi_index,
+   transaction_multi_index,
+   generated_transaction_multi_index,
+   table_id_multi_index,
+   code_index,
+   key_value_index,
+   index64_index,
+   index128_index,
+   index256_index,
+   index_double_index,
+   index_long_double_index,
+   permission_usage_index,
+   permission_link_index,
+   resource_limits::resource_limits_index,
+   resource_limits::resource_usage_index,
+   resource_limits::resource_limits_state_index,
+   resource_limits::resource_limits_config_index
+>;
+
+/// tables holding shared containers that state_delta does not pack, blocks changing them are always re-applied
+using state_delta_unsupported_index_set = index_set<
+   global_property_multi_index,
+   protocol_state_multi_index,
+   database_header_multi_index,
+   permission_index
+>;
+
 class maybe_session {
    public:
       maybe_session() = default;
 
       maybe_session( maybe_session&& other)
       :_session(move(other._session))
+      ,_usage_session(move(other._usage_session))
       {
       }
 
-      explicit maybe_session(database& db) {
+      maybe_session(database& db, resource_limits_manager& rl) {
          _session = db.start_undo_session(true);
+         _usage_session = rl.start_usage_session();
       }
 
       maybe_session(const maybe_session&) = delete;
@@ -80,16 +123,22 @@ class maybe_session {
       void squash() {
          if (_session)
             _session->squash();
+         if (_usage_session)
+            _usage_session->squash();
       }
 
       void undo() {
          if (_session)
             _session->undo();
+         if (_usage_session)
+            _usage_session->undo();
       }
 
       void push() {
          if (_session)
             _session->push();
+         if (_usage_session)
+            _usage_session->push();
       }
 
       maybe_session& operator = ( maybe_session&& mv ) {
@@ -100,11 +149,19 @@ class maybe_session {
             _session.reset();
          }
 
+         if (mv._usage_session) {
+            _usage_session = move(*mv._usage_session);
+            mv._usage_session.reset();
+         } else {
+            _usage_session.reset();
+         }
+
          return *this;
       };
 
    private:
-      optional<database::session>     _session;
+      optional<database::session>                        _session;
+      optional<resource_limits_manager::usage_session>   _usage_session;
 };
 
 struct building_block {
@@ -122,7 +179,7 @@ struct building_block {
    size_t                                _num_new_protocol_features_that_have_activated = 0;
    vector<transaction_metadata_ptr>      _pending_trx_metas;
    vector<transaction_receipt>           _pending_trx_receipts;
-   vector<action_receipt>                _actions;
+   incremental_merkle                    _action_merkle; ///< of the receipts of the actions applied so far
 };
 
 struct assembled_block {
@@ -154,6 +211,7 @@ struct pending_state {
    block_stage_type                   _block_stage;
    controller::block_status           _block_status = controller::block_status::incomplete;
    optional<block_id_type>            _producer_block_id;
+   vector<applied_transaction_trace>  _applied_traces; ///< kept for the state_delta of the block
 
    /** @pre _block_stage cannot hold completed_block alternative */
    const pending_block_header_state& get_pending_block_header_state()const {
@@ -222,10 +280,22 @@ struct controller_impl {
       reset_new_handler() { std::set_new_handler([](){ throw std::bad_alloc(); }); }
    };
 
+   struct preload_database {
+      explicit preload_database( const controller::config& cfg ) {
+         {
+            startup_timeline::scope phase( "preload state file" );
+            preload_database_file( cfg.state_dir / "shared_memory.bin", cfg.db_map_mode, cfg.db_memory );
+         }
+         done = fc::time_point::now();
+      }
+      fc::time_point done; ///< start of the construction of the other fields
+   };
+
    reset_new_handler              rnh; // placed here to allow for this to be set before constructing the other fields
    controller&                    self;
+   preload_database               db_preload; // placed before db, which loads the whole file in "heap" and "locked" mode
    chainbase::database            db;
-   chainbase::database            reversible_blocks; ///< a special database to persist blocks that have successfully been applied but are still reversible
+   reversible_block_log           reversible_blocks; ///< persists blocks that have successfully been applied but are still reversible
    block_log                      blog;
    optional<pending_state>        pending;
    block_state_ptr                head;
@@ -235,19 +305,52 @@ struct controller_impl {
    authorization_manager          authorization;
    protocol_feature_manager       protocol_features;
    controller::config             conf;
+   /// compiled copies of the whitelists and blacklists of conf, rebuilt whenever one of them is replaced
+   access_list<account_name>      actor_whitelist;
+   access_list<account_name>      actor_blacklist;
+   access_list<account_name>      contract_whitelist;
+   access_list<account_name>      contract_blacklist;
+   access_list<pair<account_name, action_name>> action_blacklist;
+   access_list<public_key_type>   key_blacklist;
    const chain_id_type            chain_id; // read by thread_pool threads, value will not be changed
    optional<fc::time_point>       replay_head_time;
    db_read_mode                   read_mode = db_read_mode::SPECULATIVE;
    bool                           in_trx_requiring_checks = false; ///< if true, checks that are normally skipped on replay (e.g. auth checks) cannot be skipped
+   bool                           applying_final_blocks = false; ///< applying irreversible blocks without undo sessions in irreversible mode, see conf.irreversible_undo_free
+   bool                           state_unrecoverable = false; ///< a block failed while applied without undo sessions, see apply_final_block
    optional<fc::microseconds>     subjective_cpu_leeway;
-   bool                           trusted_producer_light_validation = false;
+   bool                           trusted_producer_light_validation = false; ///< also set for the blocks up to conf.trusted_block
    uint32_t                       snapshot_head_block = 0;
    named_thread_pool              thread_pool;
-   platform_timer                 timer;
-#if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
-   vm::wasm_allocator                 wasm_alloc;
-#endif
+   optional<transaction_conflict_detector> conflict_detector; ///< only engaged while applying a block with parallel_apply_analysis
+   optional<action_stats>         action_statistics; ///< engaged when conf.action_stats_window_blocks is not 0
+   optional<apply_phase_stats>    phase_stats; ///< engaged when conf.apply_phase_timing
+
+   /// exported by the metrics registry, shared by every controller of the process
+   struct chain_metrics {
+      metrics::counter&    blocks_accepted = metrics::registry::instance().get_counter(
+            "nodeos_chain_blocks_accepted_total", "blocks added to the head of the chain, produced or received" );
+      metrics::counter&    block_transactions = metrics::registry::instance().get_counter(
+            "nodeos_chain_block_transactions_total", "transactions of the blocks accepted" );
+      metrics::gauge&      head_block_num = metrics::registry::instance().get_gauge(
+            "nodeos_chain_head_block_num", "number of the head block" );
+      metrics::gauge&      last_irreversible_block_num = metrics::registry::instance().get_gauge(
+            "nodeos_chain_last_irreversible_block_num", "number of the last irreversible block" );
+      metrics::histogram&  apply_block_us = metrics::registry::instance().get_histogram(
+            "nodeos_chain_apply_block_microseconds", "time applying received blocks", metrics::time_buckets_us() );
+   };
+   chain_metrics                  registered_metrics;
 
+   /// prefetched from a block as received, which only its id ties to the block later applied under that id
+   struct prefetched_block {
+      block_id_type                  id;
+      vector<packed_transaction_ptr> trxs;     ///< one entry per packed_transaction receipt, in block order
+      vector<recover_keys_future>    trx_keys; ///< of trxs
+   };
+   std::mutex                     prefetched_blocks_mtx;
+   deque<prefetched_block>        prefetched_blocks; ///< protected by prefetched_blocks_mtx, oldest first
+   std::mutex                     async_consumers_mtx;
+   vector<std::weak_ptr<async_signal_consumer>> async_consumers; ///< protected by async_consumers_mtx
    typedef pair<scope_name,action_name>                   handler_key;
    map< account_name, map<handler_key, apply_handler> >   apply_handlers;
    unordered_map< builtin_protocol_feature_t, std::function<void(controller_impl&)>, enum_hash<builtin_protocol_feature_t> > protocol_feature_activation_handlers;
@@ -260,15 +363,13 @@ struct controller_impl {
          prev = fork_db.root();
       }
 
-      if( const auto* b = reversible_blocks.find<reversible_block_object,by_num>(head->block_num) )
-      {
-         reversible_blocks.remove( *b );
-      }
+      reversible_blocks.truncate_from( head->block_num );
 
       if ( read_mode == db_read_mode::SPECULATIVE ) {
          EOS_ASSERT( head->block, block_validate_exception, "attempting to pop a block that was sparsely loaded from a snapshot");
       }
 
+      authorization.discard_cached_authorities( head->block_num );
       head = prev;
 
       db.undo();
@@ -298,15 +399,14 @@ struct controller_impl {
    controller_impl( const controller::config& cfg, controller& s, protocol_feature_set&& pfs, const chain_id_type& chain_id )
    :rnh(),
     self(s),
+    db_preload( cfg ),
     db( cfg.state_dir,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.state_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
-        cfg.read_only ? database::read_only : database::read_write,
-        cfg.reversible_cache_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    blog( cfg.blocks_dir ),
+    reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name, cfg.read_only ),
+    blog( cfg.blocks_dir, cfg.compress_block_log, cfg.blocks_log_partitions ),
     fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config ),
+    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config, cfg.wasm_preinstantiate_codes, cfg.wasm_cache_size, cfg.wasm_profile ),
     resource_limits( db ),
     authorization( s, db ),
     protocol_features( std::move(pfs) ),
@@ -315,11 +415,56 @@ struct controller_impl {
     read_mode( cfg.read_mode ),
     thread_pool( "chain", cfg.thread_pool_size )
    {
-      fork_db.open( [this]( block_timestamp_type timestamp,
-                            const flat_set<digest_type>& cur_features,
-                            const vector<digest_type>& new_features )
-                           { check_protocol_features( timestamp, cur_features, new_features ); }
-      );
+      startup_timeline::instance().record( "open state database, block logs and wasm interface", db_preload.done );
+
+      // the fork database and the transaction index read files of their own, they are loaded on the thread pool while
+      // the mapping of the state database is configured
+      auto open_fork_db = async_thread_pool( thread_pool.get_executor(), [this]() {
+         startup_timeline::scope phase( "open fork database" );
+         fork_db.open( [this]( block_timestamp_type timestamp,
+                               const flat_set<digest_type>& cur_features,
+                               const vector<digest_type>& new_features )
+                              { check_protocol_features( timestamp, cur_features, new_features ); }
+         );
+      } );
+      auto open_trx_index = async_thread_pool( thread_pool.get_executor(), [this, &cfg]() {
+         if( cfg.trx_index ) {
+            startup_timeline::scope phase( "open transaction index" );
+            blog.open_trx_index();
+         }
+         if( cfg.account_index ) {
+            startup_timeline::scope phase( "open account index" );
+            blog.open_account_index();
+         }
+      } );
+
+      // never leave them running against a controller whose construction failed
+      auto wait_for_opens = fc::make_scoped_exit( [&]() {
+         if( open_fork_db.valid() ) open_fork_db.wait();
+         if( open_trx_index.valid() ) open_trx_index.wait();
+      } );
+
+      {
+         startup_timeline::scope phase( "configure state memory" );
+         configure_database_memory( db, cfg.state_dir / "shared_memory.bin", cfg.db_map_mode, cfg.db_memory );
+      }
+      // create the deadline timer of this thread up front, its construction measures the timer accuracy
+      platform_timer::current_thread_timer();
+
+      actor_whitelist.reset( conf.actor_whitelist );
+      actor_blacklist.reset( conf.actor_blacklist );
+      contract_whitelist.reset( conf.contract_whitelist );
+      contract_blacklist.reset( conf.contract_blacklist );
+      action_blacklist.reset( conf.action_blacklist );
+      key_blacklist.reset( conf.key_blacklist );
+
+      if( cfg.action_stats_window_blocks )
+         action_statistics.emplace( cfg.action_stats_window_blocks );
+      if( cfg.apply_phase_timing )
+         phase_stats.emplace();
+
+      open_fork_db.get();
+      open_trx_index.get();
 
       set_activation_handler<builtin_protocol_feature_t::preactivate_feature>();
       set_activation_handler<builtin_protocol_feature_t::replace_deferred>();
@@ -405,27 +550,41 @@ struct controller_impl {
          return;
 
       const auto branch = fork_db.fetch_branch( fork_head->id, fork_head->dpos_irreversible_blocknum );
+      // once irreversibility resumes after a stall, the backlog is committed over several blocks instead of stalling
+      // one of them; not in irreversible mode where this is what advances the head. At least
+      // config::irreversible_min_step_blocks are committed each time, so the backlog shrinks by a block or more with
+      // every block that advances irreversibility by one, whatever the deadline
+      const bool bounded = conf.irreversible_step_time_us > 0 && read_mode != db_read_mode::IRREVERSIBLE;
+      const auto step_deadline = bounded ? fc::time_point::now() + fc::microseconds( conf.irreversible_step_time_us ) : fc::time_point::maximum();
+      uint32_t committed = 0;
       try {
-         const auto& rbi = reversible_blocks.get_index<reversible_block_index,by_num>();
-
          for( auto bitr = branch.rbegin(); bitr != branch.rend(); ++bitr ) {
             if( read_mode == db_read_mode::IRREVERSIBLE ) {
-               apply_block( *bitr, controller::block_status::complete, trx_meta_cache_lookup{} );
+               if( conf.irreversible_undo_free ) {
+                  apply_final_block( *bitr );
+               } else {
+                  apply_block( *bitr, controller::block_status::complete, trx_meta_cache_lookup{} );
+               }
                head = (*bitr);
                fork_db.mark_valid( head );
             }
 
             emit( self.irreversible_block, *bitr );
+            registered_metrics.last_irreversible_block_num.set( (*bitr)->block_num );
 
             db.commit( (*bitr)->block_num );
             root_id = (*bitr)->id;
 
-            blog.append( (*bitr)->block );
+            // written on the block log's own thread, the block is served from its queue meanwhile
+            blog.append_async( (*bitr)->block, (*bitr)->packed_block() );
 
-            auto rbitr = rbi.begin();
-            while( rbitr != rbi.end() && rbitr->blocknum <= (*bitr)->block_num ) {
-               reversible_blocks.remove( *rbitr );
-               rbitr = rbi.begin();
+            reversible_blocks.remove_through( (*bitr)->block_num );
+
+            if( bounded && ++committed >= config::irreversible_min_step_blocks && std::next( bitr ) != branch.rend() &&
+                fc::time_point::now() >= step_deadline ) {
+               dlog( "irreversible step ended at block ${n}, ${r} blocks left for the next ones",
+                     ("n", (*bitr)->block_num)("r", fork_head->dpos_irreversible_blocknum - (*bitr)->block_num) );
+               break;
             }
          }
       } catch( fc::exception& ) {
@@ -442,6 +601,40 @@ struct controller_impl {
       }
    }
 
+   /**
+    *  Applies a block of the irreversible branch in irreversible mode without undo sessions for the block nor its
+    *  transactions, the block is still fully validated. Nothing can be rolled back once it started: if the block
+    *  fails, state_unrecoverable_exception is thrown and no more blocks are accepted. The database must then not be
+    *  closed cleanly, so that its dirty flag requires a replay or a snapshot on the next start. A block whose body is
+    *  not the one its header commits to is applied with undo sessions instead, so that it fails like any invalid block.
+    */
+   void apply_final_block( const block_state_ptr& bsp ) {
+      EOS_ASSERT( db.revision() == head->block_num, database_exception, "undo-free application requires an empty undo stack",
+                  ("db.revision()", db.revision())("head", head->block_num) );
+      if( !block_body_matches_header( *bsp ) ) {
+         wlog( "body of block ${n} ${id} does not match its header, applying it with undo sessions", ("n", bsp->block_num)("id", bsp->id) );
+         apply_block( bsp, controller::block_status::complete, trx_meta_cache_lookup{} );
+         return;
+      }
+      auto reset_applying_final_blocks = fc::make_scoped_exit([this](){
+         applying_final_blocks = false;
+      });
+      applying_final_blocks = true;
+      try {
+         apply_block( bsp, controller::block_status::complete, trx_meta_cache_lookup{} );
+      } catch( const fc::exception& e ) {
+         state_unrecoverable = true;
+         EOS_THROW( state_unrecoverable_exception, "block ${n} ${id} failed after changing the state without undo sessions: ${e}",
+                    ("n", bsp->block_num)("id", bsp->id)("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         state_unrecoverable = true;
+         EOS_THROW( state_unrecoverable_exception, "block ${n} ${id} failed after changing the state without undo sessions: ${e}",
+                    ("n", bsp->block_num)("id", bsp->id)("e", e.what()) );
+      }
+      // nothing was pushed on the undo stack, the revision follows the head as db.commit expects
+      db.set_revision( bsp->block_num );
+   }
+
    /**
     *  Sets fork database head to the genesis state.
     */
@@ -480,12 +673,40 @@ struct controller_impl {
       if( start_block_num <= blog_head->block_num() ) {
          ilog( "existing block log, attempting to replay from ${s} to ${n} blocks",
                ("s", start_block_num)("n", blog_head->block_num()) );
+         const auto trusted_num = block_header::num_from_id( conf.trusted_block );
+         if( trusted_num >= start_block_num && trusted_num <= blog_head->block_num() ) {
+            EOS_ASSERT( blog.read_block_id_by_num( trusted_num ) == conf.trusted_block, block_log_exception,
+                        "block log does not contain the trusted block ${id}", ("id", conf.trusted_block) );
+         }
          try {
-            while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
+            // read and deserialize blocks ahead of the replay, when signatures are verified during replay their
+            // keys are recovered on the thread pool as soon as a block is decoded
+            block_log_prefetcher::decoded_callback on_decoded;
+            if( conf.force_all_checks ) {
+               on_decoded = [this]( const signed_block_ptr& b ) { prefetch_block( b ); };
+            }
+            // blocks of retained partitions are read one at a time, the prefetcher only reads blocks.log
+            auto next_block_num = start_block_num;
+            bool stopped = false;
+            for( ; !stopped && next_block_num < blog.log_first_block_num() && next_block_num <= blog_head->block_num(); ++next_block_num ) {
+               auto next = blog.read_block_by_num( next_block_num );
+               EOS_ASSERT( next, block_log_exception, "block ${n} is missing from the retained block logs", ("n", next_block_num) );
                replay_push_block( next, controller::block_status::irreversible );
                if( next->block_num() % 500 == 0 ) {
                   ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
-                  if( shutdown() ) break;
+                  stopped = shutdown();
+               }
+            }
+            if( !stopped && next_block_num <= blog_head->block_num() ) {
+               block_log_prefetcher prefetcher( conf.blocks_dir, blog.log_first_block_num(), next_block_num,
+                                                blog_head->block_num(), std::max<uint32_t>( conf.max_prefetched_blocks, 1 ),
+                                                thread_pool.get_executor(), std::move( on_decoded ) );
+               while( auto next = prefetcher.next() ) {
+                  replay_push_block( next, controller::block_status::irreversible );
+                  if( next->block_num() % 500 == 0 ) {
+                     ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
+                     if( shutdown() ) break;
+                  }
                }
             }
          } catch(  const database_guard_exception& e ) {
@@ -517,9 +738,9 @@ struct controller_impl {
 
       if( !except_ptr && !shutdown() ) {
          int rev = 0;
-         while( auto obj = reversible_blocks.find<reversible_block_object,by_num>(head->block_num+1) ) {
+         while( auto b = reversible_blocks.read_block( head->block_num+1 ) ) {
             ++rev;
-            replay_push_block( obj->get_block(), controller::block_status::validated );
+            replay_push_block( b, controller::block_status::validated );
          }
          ilog( "${n} reversible blocks replayed", ("n",rev) );
       }
@@ -539,19 +760,25 @@ struct controller_impl {
       EOS_ASSERT( snapshot, snapshot_exception, "No snapshot reader provided" );
       ilog( "Starting initialization from snapshot, this may take a significant amount of time" );
       try {
-         snapshot->validate();
-         if( blog.head() ) {
-            read_from_snapshot( snapshot, blog.first_block_num(), blog.head()->block_num() );
-         } else {
-            read_from_snapshot( snapshot, 0, std::numeric_limits<uint32_t>::max() );
-            const uint32_t lib_num = head->block_num;
-            EOS_ASSERT( lib_num > 0, snapshot_exception,
-                        "Snapshot indicates controller head at block number 0, but that is not allowed. "
-                        "Snapshot is invalid." );
-            blog.reset( chain_id, lib_num + 1 );
+         {
+            startup_timeline::scope phase( "load snapshot" );
+            snapshot->validate();
+            if( blog.head() ) {
+               read_from_snapshot( snapshot, blog.first_block_num(), blog.head()->block_num() );
+            } else {
+               read_from_snapshot( snapshot, 0, std::numeric_limits<uint32_t>::max() );
+               const uint32_t lib_num = head->block_num;
+               EOS_ASSERT( lib_num > 0, snapshot_exception,
+                           "Snapshot indicates controller head at block number 0, but that is not allowed. "
+                           "Snapshot is invalid." );
+               blog.reset( chain_id, lib_num + 1 );
+            }
+         }
+         {
+            startup_timeline::scope phase( "hash loaded state" );
+            const auto hash = calculate_integrity_hash();
+            ilog( "database initialized with hash: ${hash}", ("hash", hash) );
          }
-         const auto hash = calculate_integrity_hash();
-         ilog( "database initialized with hash: ${hash}", ("hash", hash) );
 
          init(shutdown);
       } catch (boost::interprocess::bad_alloc& e) {
@@ -578,7 +805,10 @@ struct controller_impl {
       } else {
          wlog( "No existing chain state or fork database. Initializing fresh blockchain state and resetting fork database.");
       }
-      initialize_blockchain_state(genesis); // sets head to genesis state
+      {
+         startup_timeline::scope phase( "initialize genesis state" );
+         initialize_blockchain_state(genesis); // sets head to genesis state
+      }
 
       if( !fork_db.head() ) {
          fork_db.reset( *head );
@@ -637,6 +867,18 @@ struct controller_impl {
       return header_itr;
    }
 
+   /**
+    *  Gives the hashed index of the contract table rows by primary key buckets for conf.contract_row_hash_reserve rows
+    *  beyond those of the state, whether just opened or loaded from a snapshot, so that storing rows in transactions
+    *  does not rehash the whole index. The buckets, a pointer each, stay allocated in the state database.
+    */
+   void reserve_contract_row_buckets() {
+      if( conf.read_only || conf.contract_row_hash_reserve == 0 ) return;
+      // only the buckets change, not the rows nor the undo state chainbase keeps of them
+      auto& by_hash = db.get_mutable_index<key_value_index>().mutable_indices().get<by_table_primary>();
+      by_hash.reserve( by_hash.size() + conf.contract_row_hash_reserve );
+   }
+
    void init(std::function<bool()> shutdown) {
       uint32_t lib_num = (blog.head() ? blog.head()->block_num() : fork_db.root()->block_num);
 
@@ -657,6 +899,8 @@ struct controller_impl {
          });
       }
 
+      reserve_contract_row_buckets();
+
       // At this point head != nullptr && fork_db.head() != nullptr && fork_db.root() != nullptr.
       // Furthermore, fork_db.root()->block_num <= lib_num.
       // Also, even though blog.head() may still be nullptr, blog.first_block_num() is guaranteed to be lib_num + 1.
@@ -676,31 +920,24 @@ struct controller_impl {
 
       protocol_features.init( db );
 
-      const auto& rbi = reversible_blocks.get_index<reversible_block_index,by_num>();
       auto last_block_num = lib_num;
 
       if( read_mode == db_read_mode::IRREVERSIBLE ) {
          // ensure there are no reversible blocks
-         auto itr = rbi.begin();
-         if( itr != rbi.end() ) {
+         if( !reversible_blocks.empty() ) {
             wlog( "read_mode has changed to irreversible: erasing reversible blocks" );
          }
-         for( ; itr != rbi.end(); itr = rbi.begin() )
-            reversible_blocks.remove( *itr );
+         reversible_blocks.clear();
       } else {
-         auto itr = rbi.begin();
-         for( ; itr != rbi.end() && itr->blocknum <= lib_num; itr = rbi.begin() )
-            reversible_blocks.remove( *itr );
+         reversible_blocks.remove_through( lib_num );
 
-         EOS_ASSERT( itr == rbi.end() || itr->blocknum == lib_num + 1, reversible_blocks_exception,
+         EOS_ASSERT( reversible_blocks.empty() || reversible_blocks.first_block_num() == lib_num + 1, reversible_blocks_exception,
                      "gap exists between last irreversible block (${lib}) and first reversible block (${first_reversible_block_num})",
-                     ("lib", lib_num)("first_reversible_block_num", itr->blocknum)
+                     ("lib", lib_num)("first_reversible_block_num", reversible_blocks.first_block_num())
          );
 
-         auto ritr = rbi.rbegin();
-
-         if( ritr != rbi.rend() ) {
-            last_block_num = ritr->blocknum;
+         if( !reversible_blocks.empty() ) {
+            last_block_num = reversible_blocks.last_block_num();
          }
 
          EOS_ASSERT( head->block_num <= last_block_num, reversible_blocks_exception,
@@ -710,23 +947,23 @@ struct controller_impl {
 
          auto pending_head = fork_db.pending_head();
 
-         if( ritr != rbi.rend()
+         if( !reversible_blocks.empty()
              && lib_num < pending_head->block_num
              && pending_head->block_num <= last_block_num
          ) {
-            auto rbitr = rbi.find( pending_head->block_num );
-            EOS_ASSERT( rbitr != rbi.end(), reversible_blocks_exception, "pending head block not found in reversible blocks");
-            auto rev_id = rbitr->get_block_id();
+            EOS_ASSERT( reversible_blocks.contains( pending_head->block_num ), reversible_blocks_exception,
+                        "pending head block not found in reversible blocks");
+            auto rev_id = reversible_blocks.read_block_id( pending_head->block_num );
             EOS_ASSERT( rev_id == pending_head->id,
                         reversible_blocks_exception,
                         "mismatch in block id of pending head block ${num} in reversible blocks database: "
                         "expected: ${expected}, actual: ${actual}",
                         ("num", pending_head->block_num)("expected", pending_head->id)("actual", rev_id)
             );
-         } else if( ritr != rbi.rend() && last_block_num < pending_head->block_num ) {
+         } else if( !reversible_blocks.empty() && last_block_num < pending_head->block_num ) {
             const auto b = fork_db.search_on_branch( pending_head->id, last_block_num );
             FC_ASSERT( b, "unexpected violation of invariants" );
-            auto rev_id = ritr->get_block_id();
+            auto rev_id = reversible_blocks.read_block_id( last_block_num );
             EOS_ASSERT( rev_id == b->id,
                         reversible_blocks_exception,
                         "mismatch in block id of last block (${num}) in reversible blocks database: "
@@ -737,7 +974,15 @@ struct controller_impl {
          // else no checks needed since fork_db will be completely reset on replay anyway
       }
 
+      // compile the contracts that were hot before the restart while replaying and syncing
+      wasmif.start_eosvmoc_warm_up();
+      {
+         startup_timeline::scope phase( "preinstantiate recent contracts" );
+         wasmif.preinstantiate_recent_codes();
+      }
+
       if( last_block_num > head->block_num ) {
+         startup_timeline::scope phase( "replay" );
          replay( shutdown ); // replay any irreversible and reversible blocks ahead of current head
       }
 
@@ -765,8 +1010,6 @@ struct controller_impl {
    }
 
    void add_indices() {
-      reversible_blocks.add_index<reversible_block_index>();
-
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
 
@@ -784,9 +1027,26 @@ struct controller_impl {
                   */
    }
 
-   void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section("contract_tables", [this]( auto& section ) {
-         index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
+   // number of contract tables serialized together when writing a snapshot concurrently
+   static constexpr size_t contract_tables_per_snapshot_shard = 256;
+
+   void add_contract_tables_to_snapshot( concurrent_section_writer& sections ) const {
+      // shard the section by ranges of table ids, each shard is serialized on its own
+      std::vector<table_id_object::id_type> shard_begins;
+      table_id_object::id_type end_id = 0;
+      size_t num_tables = 0;
+      index_utils<table_id_multi_index>::walk(db, [&shard_begins, &end_id, &num_tables]( const table_id_object& table_row ){
+         if (num_tables++ % contract_tables_per_snapshot_shard == 0) {
+            shard_begins.push_back(table_row.id);
+         }
+         end_id = table_id_object::id_type(table_row.id._id + 1);
+      });
+      shard_begins.push_back(end_id);
+
+      sections.add_section("contract_tables", shard_begins.size() - 1, [this, &shard_begins]( auto& section, size_t shard ) {
+         auto begin_key = boost::make_tuple(shard_begins[shard]);
+         auto end_key = boost::make_tuple(shard_begins[shard + 1]);
+         index_utils<table_id_multi_index>::walk_range<by_id>(db, begin_key, end_key, [this, &section]( const table_id_object& table_row ){
             // add a row for the table
             section.add_row(table_row, db);
 
@@ -839,16 +1099,19 @@ struct controller_impl {
       });
    }
 
-   void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section<chain_snapshot_header>([this]( auto &section ){
+   void add_to_snapshot( const snapshot_writer_ptr& snapshot ) {
+      // sections are serialized on the thread pool, the state must not change until they are written
+      concurrent_section_writer sections( *snapshot, thread_pool.get_executor(), 2 * conf.thread_pool_size );
+
+      sections.add_section<chain_snapshot_header>([this]( auto &section ){
          section.add_row(chain_snapshot_header(), db);
       });
 
-      snapshot->write_section<block_state>([this]( auto &section ){
+      sections.add_section<block_state>([this]( auto &section ){
          section.template add_row<block_header_state>(*fork_db.head(), db);
       });
 
-      controller_index_set::walk_indices([this, &snapshot]( auto utils ){
+      controller_index_set::walk_indices([this, &sections]( auto utils ){
          using value_t = typename decltype(utils)::index_t::value_type;
 
          // skip the table_id_object as its inlined with contract tables section
@@ -861,14 +1124,15 @@ struct controller_impl {
             return;
          }
 
-         snapshot->write_section<value_t>([this]( auto& section ){
+         sections.add_section<value_t>([this]( auto& section ){
             decltype(utils)::walk(db, [this, &section]( const auto &row ) {
                section.add_row(row, db);
             });
          });
       });
 
-      add_contract_tables_to_snapshot(snapshot);
+      add_contract_tables_to_snapshot(sections);
+      sections.finish();
 
       authorization.add_to_snapshot(snapshot);
       resource_limits.add_to_snapshot(snapshot);
@@ -986,7 +1250,7 @@ struct controller_impl {
       );
    }
 
-   sha256 calculate_integrity_hash() const {
+   sha256 calculate_integrity_hash() {
       sha256::encoder enc;
       auto hash_writer = std::make_shared<integrity_hash_snapshot_writer>(enc);
       add_to_snapshot(hash_writer);
@@ -1088,17 +1352,18 @@ struct controller_impl {
       auto& bb = pending->_block_stage.get<building_block>();
       auto orig_block_transactions_size = bb._pending_trx_receipts.size();
       auto orig_state_transactions_size = bb._pending_trx_metas.size();
-      auto orig_state_actions_size      = bb._actions.size();
+      // a few digests, one per level of the tree
+      auto orig_action_merkle           = bb._action_merkle;
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
                                         orig_state_transactions_size,
-                                        orig_state_actions_size]()
+                                        orig_action_merkle]()
       {
          auto& bb = pending->_block_stage.get<building_block>();
          bb._pending_trx_receipts.resize(orig_block_transactions_size);
          bb._pending_trx_metas.resize(orig_state_transactions_size);
-         bb._actions.resize(orig_state_actions_size);
+         bb._action_merkle = orig_action_merkle;
       };
 
       return fc::make_scoped_exit( std::move(callback) );
@@ -1126,12 +1391,13 @@ struct controller_impl {
          etrx.set_reference_block( self.head_block_id() );
       }
 
-      transaction_checktime_timer trx_timer(timer);
+      transaction_checktime_timer trx_timer(platform_timer::current_thread_timer());
       transaction_context trx_context( self, etrx, etrx.id(), std::move(trx_timer), start );
       trx_context.deadline = deadline;
       trx_context.explicit_billed_cpu_time = explicit_billed_cpu_time;
       trx_context.billed_cpu_time_us = billed_cpu_time_us;
       trx_context.enforce_whiteblacklist = enforce_whiteblacklist;
+      if( conflict_detector ) trx_context.access_set = conflict_detector->current();
       transaction_trace_ptr trace = trx_context.trace;
       try {
          trx_context.init_for_implicit_trx();
@@ -1142,7 +1408,7 @@ struct controller_impl {
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_action_receipts( trx_context.executed );
 
          trx_context.squash();
          restore.cancel();
@@ -1193,6 +1459,14 @@ struct controller_impl {
              || failure_is_subjective(e);
    }
 
+   /// emits applied_transaction, keeping the traces of the transactions which made it into the block for its state_delta
+   void emit_applied_transaction( const transaction_trace_ptr& trace, const transaction_metadata_ptr& trx,
+                                  const signed_transaction& trn ) {
+      if( conf.fork_switch_delta_size > 0 && trace->receipt )
+         pending->_applied_traces.emplace_back( trace, trx->packed_trx() );
+      emit( self.applied_transaction, std::tie(trace, trn) );
+   }
+
    transaction_trace_ptr push_scheduled_transaction( const transaction_id_type& trxid, fc::time_point deadline, uint32_t billed_cpu_time_us, bool explicit_billed_cpu_time = false ) {
       const auto& idx = db.get_index<generated_transaction_multi_index,by_trx_id>();
       auto itr = idx.find( trxid );
@@ -1204,7 +1478,7 @@ struct controller_impl {
    { try {
       maybe_session undo_session;
       if ( !self.skip_db_sessions() )
-         undo_session = maybe_session(db);
+         undo_session = maybe_session(db, resource_limits);
 
       auto gtrx = generated_transaction(gto);
 
@@ -1237,7 +1511,7 @@ struct controller_impl {
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::expired, billed_cpu_time_us, 0 ); // expire the transaction
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
          emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, dtrx) );
+         emit_applied_transaction( trace, trx, dtrx );
          undo_session.squash();
          return trace;
       }
@@ -1249,13 +1523,14 @@ struct controller_impl {
 
       uint32_t cpu_time_to_bill_us = billed_cpu_time_us;
 
-      transaction_checktime_timer trx_timer(timer);
+      transaction_checktime_timer trx_timer(platform_timer::current_thread_timer());
       transaction_context trx_context( self, dtrx, gtrx.trx_id, std::move(trx_timer) );
       trx_context.leeway =  fc::microseconds(0); // avoid stealing cpu resource
       trx_context.deadline = deadline;
       trx_context.explicit_billed_cpu_time = explicit_billed_cpu_time;
       trx_context.billed_cpu_time_us = billed_cpu_time_us;
       trx_context.enforce_whiteblacklist = gtrx.sender.empty() ? true : !sender_avoids_whitelist_blacklist_enforcement( gtrx.sender );
+      if( conflict_detector ) trx_context.access_set = conflict_detector->current();
       trace = trx_context.trace;
       try {
          trx_context.init_for_deferred_trx( gtrx.published );
@@ -1280,12 +1555,12 @@ struct controller_impl {
                                         trx_context.billed_cpu_time_us,
                                         trace->net_usage );
 
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_action_receipts( trx_context.executed );
 
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
 
          emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, dtrx) );
+         emit_applied_transaction( trace, trx, dtrx );
 
          trx_context.squash();
          undo_session.squash();
@@ -1319,7 +1594,7 @@ struct controller_impl {
          if( !trace->except_ptr ) {
             trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
             emit( self.accepted_transaction, trx );
-            emit( self.applied_transaction, std::tie(trace, dtrx) );
+            emit_applied_transaction( trace, trx, dtrx );
             undo_session.squash();
             return trace;
          }
@@ -1357,12 +1632,12 @@ struct controller_impl {
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
 
          emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, dtrx) );
+         emit_applied_transaction( trace, trx, dtrx );
 
          undo_session.squash();
       } else {
          emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, dtrx) );
+         emit_applied_transaction( trace, trx, dtrx );
       }
 
       return trace;
@@ -1399,6 +1674,9 @@ struct controller_impl {
       EOS_ASSERT(deadline != fc::time_point(), transaction_exception, "deadline cannot be uninitialized");
 
       transaction_trace_ptr trace;
+      auto trace_step = fc::make_scoped_exit([&]() {
+         if( trx->trace ) trx->trace->step( "execute", trace && trace->except ? trace->except->top_message() : std::string() );
+      });
       try {
          auto start = fc::time_point::now();
          const bool check_auth = !self.skip_auth_check() && !trx->implicit;
@@ -1415,7 +1693,7 @@ struct controller_impl {
          }
 
          const signed_transaction& trn = trx->packed_trx()->get_signed_transaction();
-         transaction_checktime_timer trx_timer(timer);
+         transaction_checktime_timer trx_timer(platform_timer::current_thread_timer());
          transaction_context trx_context(self, trn, trx->id(), std::move(trx_timer), start);
          if ((bool)subjective_cpu_leeway && pending->_block_status == controller::block_status::incomplete) {
             trx_context.leeway = *subjective_cpu_leeway;
@@ -1423,6 +1701,7 @@ struct controller_impl {
          trx_context.deadline = deadline;
          trx_context.explicit_billed_cpu_time = explicit_billed_cpu_time;
          trx_context.billed_cpu_time_us = billed_cpu_time_us;
+         if( conflict_detector && !trx->implicit ) trx_context.access_set = conflict_detector->current();
          trace = trx_context.trace;
          try {
             if( trx->implicit ) {
@@ -1436,8 +1715,10 @@ struct controller_impl {
             }
 
             trx_context.delay = fc::seconds(trn.delay_sec);
+            trx_context.start_context_free_actions();
 
             if( check_auth ) {
+               apply_phase_timer auth_timer( phase_stats ? &phase_stats->authorization_ns : nullptr );
                authorization.check_authorization(
                        trn.actions,
                        trx->recovered_keys(),
@@ -1466,7 +1747,7 @@ struct controller_impl {
                trace->receipt = r;
             }
 
-            fc::move_append(pending->_block_stage.get<building_block>()._actions, move(trx_context.executed));
+            append_action_receipts( trx_context.executed );
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1474,7 +1755,7 @@ struct controller_impl {
                emit( self.accepted_transaction, trx);
             }
 
-            emit(self.applied_transaction, std::tie(trace, trn));
+            emit_applied_transaction( trace, trx, trn );
 
 
             if ( read_mode != db_read_mode::SPECULATIVE && pending->_block_status == controller::block_status::incomplete ) {
@@ -1497,12 +1778,37 @@ struct controller_impl {
          }
 
          emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, trn) );
+         emit_applied_transaction( trace, trx, trn );
 
          return trace;
       } FC_CAPTURE_AND_RETHROW((trace))
    } /// push_transaction
 
+   transaction_trace_ptr push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline )
+   {
+      EOS_ASSERT( deadline != fc::time_point(), transaction_exception, "deadline cannot be uninitialized" );
+      EOS_ASSERT( pending, block_validate_exception, "no pending block" );
+      EOS_ASSERT( !self.skip_db_sessions(), transaction_exception, "read-only transactions need undo sessions" );
+
+      const signed_transaction& trn = trx->packed_trx()->get_signed_transaction();
+      transaction_checktime_timer trx_timer(platform_timer::current_thread_timer());
+      transaction_context trx_context(self, trn, trx->id(), std::move(trx_timer));
+      trx_context.deadline = deadline;
+      transaction_trace_ptr trace = trx_context.trace;
+      try {
+         trx_context.init_for_read_only_trx();
+         trx_context.exec();
+         trace->elapsed = fc::time_point::now() - trx_context.start;
+      } catch( const fc::exception& e ) {
+         trace->error_code = controller::convert_exception_to_error_code( e );
+         trace->except = e;
+         trace->except_ptr = std::current_exception();
+      }
+      trx_context.undo();
+
+      return trace;
+   } /// push_read_only_transaction
+
    void start_block( block_timestamp_type when,
                      uint16_t confirm_block_count,
                      const vector<digest_type>& new_protocol_feature_activations,
@@ -1513,6 +1819,7 @@ struct controller_impl {
 
       auto guard_pending = fc::make_scoped_exit([this, head_block_num=head->block_num](){
          protocol_features.popped_blocks_to( head_block_num );
+         authorization.discard_cached_authorities( head_block_num + 1 );
          pending.reset();
       });
 
@@ -1520,7 +1827,7 @@ struct controller_impl {
          EOS_ASSERT( db.revision() == head->block_num, database_exception, "db revision is not on par with head block",
                      ("db.revision()", db.revision())("controller_head_block", head->block_num)("fork_db_head_block", fork_db.head()->block_num) );
 
-         pending.emplace( maybe_session(db), *head, when, confirm_block_count, new_protocol_feature_activations );
+         pending.emplace( maybe_session(db, resource_limits), *head, when, confirm_block_count, new_protocol_feature_activations );
       } else {
          pending.emplace( maybe_session(), *head, when, confirm_block_count, new_protocol_feature_activations );
       }
@@ -1604,7 +1911,7 @@ struct controller_impl {
 
          if( gpo.proposed_schedule_block_num.valid() && // if there is a proposed schedule that was proposed in a block ...
              ( *gpo.proposed_schedule_block_num <= pbhs.dpos_irreversible_blocknum ) && // ... that has now become irreversible ...
-             pbhs.prev_pending_schedule.schedule.producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
+             pbhs.prev_pending_schedule.schedule->producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
          )
          {
             // Promote proposed schedule to pending schedule.
@@ -1731,20 +2038,20 @@ struct controller_impl {
          if( add_to_fork_db ) {
             fork_db.add( bsp );
             fork_db.mark_valid( bsp );
+            blog.prepare_append( bsp->block );
             emit( self.accepted_block_header, bsp );
             head = fork_db.head();
             EOS_ASSERT( bsp == head, fork_database_exception, "committed block did not become the new head in fork database");
          }
 
          if( !replay_head_time && read_mode != db_read_mode::IRREVERSIBLE ) {
-            reversible_blocks.create<reversible_block_object>( [&]( auto& ubo ) {
-               ubo.blocknum = bsp->block_num;
-               ubo.set_block( bsp->block );
-            });
+            reversible_blocks.append( bsp->block );
          }
 
          emit( self.accepted_block, bsp );
 
+         record_accepted_block( bsp );
+
          if( add_to_fork_db ) {
             log_irreversible();
          }
@@ -1755,10 +2062,73 @@ struct controller_impl {
          throw;
       }
 
+      if( conf.fork_switch_delta_size > 0 && read_mode != db_read_mode::IRREVERSIBLE && !replay_head_time
+          && !self.skip_db_sessions( pending->_block_status ) ) {
+         const auto& bsp = pending->_block_stage.get<completed_block>()._block_state;
+         auto delta = state_delta::capture<state_delta_index_set, state_delta_unsupported_index_set>( db, conf.fork_switch_delta_size );
+         if( delta ) {
+            bsp->_state_delta = std::make_shared<const state_delta>( std::move(*delta) );
+            bsp->_state_delta_traces = std::make_shared<const vector<applied_transaction_trace>>( std::move(pending->_applied_traces) );
+         }
+      }
+
       // push the state for pending.
       pending->push();
    }
 
+   /// the metrics and statistics of a block which became the head
+   void record_accepted_block( const block_state_ptr& bsp ) {
+      registered_metrics.blocks_accepted.add();
+      registered_metrics.block_transactions.add( bsp->block->transactions.size() );
+      registered_metrics.head_block_num.set( bsp->block_num );
+
+      if( action_statistics )
+         action_statistics->on_accepted_block( bsp->block_num );
+   }
+
+   /**
+    *  Reproduces the chainbase changes of a block this node validated before from its state_delta, without
+    *  executing its transactions. The traces the transactions produced then are emitted again, in the same order.
+    *
+    *  @return false if the block has to be applied in full instead, the state is then unchanged
+    */
+   bool replay_state_delta( const block_state_ptr& bsp ) {
+      if( !bsp->_state_delta || !bsp->get_new_protocol_feature_activations().empty() ) return false;
+      EOS_ASSERT( !pending, block_validate_exception, "it is not valid to replay a block when there is a pending block" );
+
+      maybe_session session( db, resource_limits );
+      bool applied = false;
+      try {
+         applied = bsp->_state_delta->apply<state_delta_index_set>( db );
+      } catch( const fc::exception& e ) {
+         wlog( "unable to replay state delta of block ${id}: ${e}", ("id", bsp->id)("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         wlog( "unable to replay state delta of block ${id}: ${e}", ("id", bsp->id)("e", e.what()) );
+      }
+      if( !applied ) {
+         session.undo();
+         bsp->_state_delta.reset();
+         bsp->_state_delta_traces.reset();
+         return false;
+      }
+
+      if( bsp->_state_delta_traces ) {
+         for( const auto& t : *bsp->_state_delta_traces )
+            emit( self.applied_transaction, std::tie( t.first, t.second->get_signed_transaction() ) );
+      }
+
+      if( !replay_head_time && read_mode != db_read_mode::IRREVERSIBLE ) {
+         reversible_blocks.append( bsp->block );
+      }
+
+      emit( self.accepted_block, bsp );
+
+      record_accepted_block( bsp );
+
+      session.push();
+      return true;
+   }
+
    /**
     *  This method is called from other threads. The controller_impl should outlive those threads.
     *  However, to avoid race conditions, it means that the behavior of this function should not change
@@ -1823,9 +2193,15 @@ struct controller_impl {
    void apply_block( const block_state_ptr& bsp, controller::block_status s, const trx_meta_cache_lookup& trx_lookup )
    { try {
       try {
+         const auto apply_start = fc::time_point::now();
          const signed_block_ptr& b = bsp->block;
          const auto& new_protocol_feature_activations = bsp->get_new_protocol_feature_activations();
 
+         auto reset_conflict_detector = fc::make_scoped_exit([this](){
+            conflict_detector.reset();
+         });
+         if( conf.parallel_apply_analysis ) conflict_detector.emplace();
+
          auto producer_block_id = b->id();
          start_block( b->timestamp, b->confirmed, new_protocol_feature_activations, s, producer_block_id);
 
@@ -1834,6 +2210,7 @@ struct controller_impl {
          const bool skip_auth_checks = self.skip_auth_check();
          std::vector<std::tuple<transaction_metadata_ptr, recover_keys_future>> trx_metas;
          bool use_bsp_cached = false;
+         prefetched_block prefetched = extract_prefetched_block( bsp->id );
          if( pub_keys_recovered || (skip_auth_checks && existing_trxs_metas) ) {
             use_bsp_cached = true;
          } else {
@@ -1841,6 +2218,7 @@ struct controller_impl {
             for( const auto& receipt : b->transactions ) {
                if( receipt.trx.contains<packed_transaction>()) {
                   const auto& pt = receipt.trx.get<packed_transaction>();
+                  const size_t idx = trx_metas.size();
                   transaction_metadata_ptr trx_meta_ptr = trx_lookup ? trx_lookup( pt.id() ) : transaction_metadata_ptr{};
                   if( trx_meta_ptr && ( skip_auth_checks || !trx_meta_ptr->recovered_keys().empty() ) ) {
                      trx_metas.emplace_back( std::move( trx_meta_ptr ), recover_keys_future{} );
@@ -1848,6 +2226,8 @@ struct controller_impl {
                      trx_metas.emplace_back(
                            transaction_metadata::create_no_recover_keys( pt, transaction_metadata::trx_type::input ),
                            recover_keys_future{} );
+                  } else if( idx < prefetched.trxs.size() && prefetched.trx_keys[idx].valid() && same_packed_transaction( *prefetched.trxs[idx], pt ) ) {
+                     trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( prefetched.trx_keys[idx] ) );
                   } else {
                      auto ptrx = std::make_shared<packed_transaction>( pt );
                      auto fut = transaction_metadata::start_recover_keys(
@@ -1864,11 +2244,16 @@ struct controller_impl {
          for( const auto& receipt : b->transactions ) {
             const auto& trx_receipts = pending->_block_stage.get<building_block>()._pending_trx_receipts;
             auto num_pending_receipts = trx_receipts.size();
+            if( conflict_detector ) conflict_detector->begin_transaction();
             if( receipt.trx.contains<packed_transaction>() ) {
-               const auto& trx_meta = ( use_bsp_cached ? bsp->trxs_metas().at( packed_idx )
-                                                       : ( !!std::get<0>( trx_metas.at( packed_idx ) ) ?
-                                                             std::get<0>( trx_metas.at( packed_idx ) )
-                                                             : std::get<1>( trx_metas.at( packed_idx ) ).get() ) );
+               transaction_metadata_ptr trx_meta;
+               {
+                  apply_phase_timer recover_timer( phase_stats ? &phase_stats->recover_keys_ns : nullptr );
+                  trx_meta = ( use_bsp_cached ? bsp->trxs_metas().at( packed_idx )
+                                              : ( !!std::get<0>( trx_metas.at( packed_idx ) ) ?
+                                                    std::get<0>( trx_metas.at( packed_idx ) )
+                                                    : std::get<1>( trx_metas.at( packed_idx ) ).get() ) );
+               }
                trace = push_transaction( trx_meta, fc::time_point::maximum(), receipt.cpu_usage_us, true );
                ++packed_idx;
             } else if( receipt.trx.contains<transaction_id_type>() ) {
@@ -1898,7 +2283,17 @@ struct controller_impl {
                         ("producer_receipt", receipt)("validator_receipt", trx_receipts.back()) );
          }
 
-         finalize_block();
+         if( conflict_detector ) log_conflict_groups( bsp->block_num );
+
+         if( phase_stats ) {
+            ++phase_stats->blocks;
+            phase_stats->transactions += b->transactions.size();
+         }
+
+         {
+            apply_phase_timer finalize_timer( phase_stats ? &phase_stats->finalize_block_ns : nullptr );
+            finalize_block();
+         }
 
          auto& ab = pending->_block_stage.get<assembled_block>();
 
@@ -1912,7 +2307,11 @@ struct controller_impl {
          // create completed_block with the existing block_state as we just verified it is the same as assembled_block
          pending->_block_stage = completed_block{ bsp };
 
-         commit_block(false);
+         {
+            apply_phase_timer commit_timer( phase_stats ? &phase_stats->commit_block_ns : nullptr );
+            commit_block(false);
+         }
+         registered_metrics.apply_block_us.record( std::max<int64_t>( (fc::time_point::now() - apply_start).count(), 0 ) );
          return;
       } catch ( const fc::exception& e ) {
          edump((e.to_detail_string()));
@@ -1921,6 +2320,82 @@ struct controller_impl {
       }
    } FC_CAPTURE_AND_RETHROW() } /// apply_block
 
+   void log_conflict_groups( uint32_t block_num )const {
+      const auto groups = conflict_detector->conflict_groups();
+      size_t largest = 0;
+      for( const auto& g : groups ) {
+         largest = std::max( largest, g.size() );
+      }
+      ilog( "block ${n}: ${t} transactions form ${g} conflict-free groups, largest group has ${l} transactions",
+            ("n", block_num)("t", conflict_detector->size())("g", groups.size())("l", largest) );
+   }
+
+   /**
+    * @return true if the block is at or below conf.trusted_block, its transactions are then trusted. The trusted block
+    * itself must match, the blocks below are only trusted on the strength of their producer signatures until the
+    * trusted block confirms the branch.
+    */
+   bool is_trusted_block( uint32_t block_num, const block_id_type& id )const {
+      const auto trusted_num = block_header::num_from_id( conf.trusted_block );
+      EOS_ASSERT( block_num != trusted_num || id == conf.trusted_block, block_validate_exception,
+                  "block ${id} does not match the trusted block ${trusted}", ("id", id)("trusted", conf.trusted_block) );
+      return block_num <= trusted_num;
+   }
+
+   /**
+    *  This method is called from other threads. It only uses thread_pool, chain_id and conf, which do not change
+    *  after construction, and prefetched_blocks which is protected by prefetched_blocks_mtx.
+    */
+   void prefetch_block( const signed_block_ptr& b ) {
+      if( !b || conf.block_validation_mode == validation_mode::LIGHT || conf.max_prefetched_blocks == 0 )
+         return;
+      if( b->block_num() <= block_header::num_from_id( conf.trusted_block ) )
+         return;
+
+      // nothing checked the body of b against its id yet, so a later copy replaces it; apply_block only takes the
+      // transactions which are the same as in the block it applies
+      prefetched_block pb{ b->id(), {}, {} };
+      pb.trxs.reserve( b->transactions.size() );
+      pb.trx_keys.reserve( b->transactions.size() );
+      for( const auto& receipt : b->transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            pb.trxs.emplace_back( std::make_shared<packed_transaction>( receipt.trx.get<packed_transaction>() ) );
+            pb.trx_keys.emplace_back( transaction_metadata::start_recover_keys(
+                  pb.trxs.back(), thread_pool.get_executor(), chain_id, microseconds::maximum() ) );
+         }
+      }
+
+      std::lock_guard<std::mutex> g( prefetched_blocks_mtx );
+      auto same = std::find_if( prefetched_blocks.begin(), prefetched_blocks.end(), [&]( const auto& e ) { return e.id == pb.id; } );
+      if( same != prefetched_blocks.end() )
+         prefetched_blocks.erase( same );
+      prefetched_blocks.emplace_back( std::move( pb ) );
+      while( prefetched_blocks.size() > conf.max_prefetched_blocks ) {
+         prefetched_blocks.pop_front(); // abandoned futures still complete on the thread pool, results are discarded
+      }
+   }
+
+   prefetched_block extract_prefetched_block( const block_id_type& id ) {
+      std::lock_guard<std::mutex> g( prefetched_blocks_mtx );
+      for( auto itr = prefetched_blocks.begin(); itr != prefetched_blocks.end(); ++itr ) {
+         if( itr->id == id ) {
+            prefetched_block pb = std::move( *itr );
+            prefetched_blocks.erase( itr );
+            return pb;
+         }
+      }
+      return {};
+   }
+
+   /// everything the recovered keys and the applied transaction are made of
+   static bool same_packed_transaction( const packed_transaction& a, const packed_transaction& b ) {
+      return a.id() == b.id() &&
+             a.get_compression() == b.get_compression() &&
+             a.get_signatures() == b.get_signatures() &&
+             a.get_packed_transaction() == b.get_packed_transaction() &&
+             a.get_packed_context_free_data() == b.get_packed_context_free_data();
+   }
+
    std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b ) {
       EOS_ASSERT( b, block_validate_exception, "null block" );
 
@@ -1954,6 +2429,7 @@ struct controller_impl {
    {
       controller::block_status s = controller::block_status::complete;
       EOS_ASSERT(!pending, block_validate_exception, "it is not valid to push a block when there is a pending block");
+      EOS_ASSERT(!state_unrecoverable, state_unrecoverable_exception, "no block can be applied to the state of a failed block");
 
       auto reset_prod_light_validation = fc::make_scoped_exit([old_value=trusted_producer_light_validation, this]() {
          trusted_producer_light_validation = old_value;
@@ -1963,10 +2439,12 @@ struct controller_impl {
          const auto& b = bsp->block;
 
          emit( self.pre_accepted_block, b );
+         const bool trusted = is_trusted_block( bsp->block_num, bsp->id );
 
          fork_db.add( bsp );
+         blog.prepare_append( b );
 
-         if (conf.trusted_producers.count(b->producer)) {
+         if (conf.trusted_producers.count(b->producer) || trusted) {
             trusted_producer_light_validation = true;
          };
 
@@ -1993,6 +2471,11 @@ struct controller_impl {
                      block_validate_exception, "invalid block status for replay" );
          emit( self.pre_accepted_block, b );
          const bool skip_validate_signee = !conf.force_all_checks;
+         const bool trusted = is_trusted_block( b->block_num(), b->id() );
+
+         auto reset_prod_light_validation = fc::make_scoped_exit([old_value=trusted_producer_light_validation, this]() {
+            trusted_producer_light_validation = old_value;
+         });
 
          auto bsp = std::make_shared<block_state>(
                         *head,
@@ -2011,6 +2494,11 @@ struct controller_impl {
 
          emit( self.accepted_block_header, bsp );
 
+         // replays are only fully validated with force-all-checks, which the trusted block overrides
+         if( trusted ) {
+            trusted_producer_light_validation = true;
+         }
+
          if( s == controller::block_status::irreversible ) {
             apply_block( bsp, s, trx_meta_cache_lookup{} );
             head = bsp;
@@ -2064,8 +2552,10 @@ struct controller_impl {
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr ) {
             optional<fc::exception> except;
             try {
-               apply_block( *ritr, (*ritr)->is_valid() ? controller::block_status::validated
-                                                       : controller::block_status::complete, trx_lookup );
+               if( !(*ritr)->is_valid() || !replay_state_delta( *ritr ) ) {
+                  apply_block( *ritr, (*ritr)->is_valid() ? controller::block_status::validated
+                                                          : controller::block_status::complete, trx_lookup );
+               }
                fork_db.mark_valid( *ritr );
                head = *ritr;
             } catch (const fc::exception& e) {
@@ -2089,7 +2579,8 @@ struct controller_impl {
 
                // re-apply good blocks
                for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr ) {
-                  apply_block( *ritr, controller::block_status::validated /* we previously validated these blocks*/, trx_lookup );
+                  if( !replay_state_delta( *ritr ) )
+                     apply_block( *ritr, controller::block_status::validated /* we previously validated these blocks*/, trx_lookup );
                   head = *ritr;
                }
                throw *except;
@@ -2112,18 +2603,33 @@ struct controller_impl {
          applied_trxs = pending->extract_trx_metas();
          pending.reset();
          protocol_features.popped_blocks_to( head->block_num );
+         authorization.discard_cached_authorities( head->block_num + 1 );
       }
       return applied_trxs;
    }
 
+   /// folds the receipts of an applied transaction into the action merkle tree, so that the block does not hash
+   /// all of them once the last transaction is in
+   void append_action_receipts( const vector<action_receipt>& receipts ) {
+      auto& action_merkle = pending->_block_stage.get<building_block>()._action_merkle;
+      for( const auto& r : receipts )
+         action_merkle.append( r.digest() );
+   }
+
    checksum256_type calculate_action_merkle() {
-      vector<digest_type> action_digests;
-      const auto& actions = pending->_block_stage.get<building_block>()._actions;
-      action_digests.reserve( actions.size() );
-      for( const auto& a : actions )
-         action_digests.emplace_back( a.digest() );
+      // same root as merkle() of all the digests
+      return pending->_block_stage.get<building_block>()._action_merkle.get_root();
+   }
 
-      return merkle( move(action_digests) );
+   static bool block_body_matches_header( const block_state& bs ) {
+      const signed_block& b = *bs.block;
+      if( b.id() != bs.id )
+         return false;
+      vector<digest_type> trx_digests;
+      trx_digests.reserve( b.transactions.size() );
+      for( const auto& a : b.transactions )
+         trx_digests.emplace_back( a.digest() );
+      return merkle( move(trx_digests) ) == b.transaction_mroot;
    }
 
    checksum256_type calculate_trx_merkle() {
@@ -2137,7 +2643,7 @@ struct controller_impl {
    }
 
    void update_producers_authority() {
-      const auto& producers = pending->get_pending_block_header_state().active_schedule.producers;
+      const auto& producers = pending->get_pending_block_header_state().active_schedule->producers;
 
       auto update_permission = [&]( auto& permission, auto threshold ) {
          auto auth = authority( threshold, {}, {});
@@ -2204,30 +2710,10 @@ struct controller_impl {
    void check_actor_list( const flat_set<account_name>& actors )const {
       if( actors.size() == 0 ) return;
 
-      if( conf.actor_whitelist.size() > 0 ) {
+      if( !actor_whitelist.empty() ) {
          // throw if actors is not a subset of whitelist
-         const auto& whitelist = conf.actor_whitelist;
-         bool is_subset = true;
-
-         // quick extents check, then brute force the check actors
-         if (*actors.cbegin() >= *whitelist.cbegin() && *actors.crbegin() <= *whitelist.crbegin() ) {
-            auto lower_bound = whitelist.cbegin();
-            for (const auto& actor: actors) {
-               lower_bound = std::lower_bound(lower_bound, whitelist.cend(), actor);
-
-               // if the actor is not found, this is not a subset
-               if (lower_bound == whitelist.cend() || *lower_bound != actor ) {
-                  is_subset = false;
-                  break;
-               }
-
-               // if the actor was found, we are guaranteed that other actors are either not present in the whitelist
-               // or will be present in the range defined as [next actor,end)
-               lower_bound = std::next(lower_bound);
-            }
-         } else {
-            is_subset = false;
-         }
+         const bool is_subset = std::all_of( actors.begin(), actors.end(),
+                                             [this]( const account_name& a ) { return actor_whitelist.contains( a ); } );
 
          // helper lambda to lazily calculate the actors for error messaging
          static auto generate_missing_actors = [](const flat_set<account_name>& actors, const flat_set<account_name>& whitelist) -> vector<account_name> {
@@ -2241,32 +2727,12 @@ struct controller_impl {
 
          EOS_ASSERT( is_subset,  actor_whitelist_exception,
                      "authorizing actor(s) in transaction are not on the actor whitelist: ${actors}",
-                     ("actors", generate_missing_actors(actors, whitelist))
+                     ("actors", generate_missing_actors(actors, conf.actor_whitelist))
                    );
-      } else if( conf.actor_blacklist.size() > 0 ) {
+      } else if( !actor_blacklist.empty() ) {
          // throw if actors intersects blacklist
-         const auto& blacklist = conf.actor_blacklist;
-         bool intersects = false;
-
-         // quick extents check then brute force check actors
-         if( *actors.cbegin() <= *blacklist.crbegin() && *actors.crbegin() >= *blacklist.cbegin() ) {
-            auto lower_bound = blacklist.cbegin();
-            for (const auto& actor: actors) {
-               lower_bound = std::lower_bound(lower_bound, blacklist.cend(), actor);
-
-               // if the lower bound in the blacklist is at the end, all other actors are guaranteed to
-               // not exist in the blacklist
-               if (lower_bound == blacklist.cend()) {
-                  break;
-               }
-
-               // if the lower bound of an actor IS the actor, then we have an intersection
-               if (*lower_bound == actor) {
-                  intersects = true;
-                  break;
-               }
-            }
-         }
+         const bool intersects = std::any_of( actors.begin(), actors.end(),
+                                              [this]( const account_name& a ) { return actor_blacklist.contains( a ); } );
 
          // helper lambda to lazily calculate the actors for error messaging
          static auto generate_blacklisted_actors = [](const flat_set<account_name>& actors, const flat_set<account_name>& blacklist) -> vector<account_name> {
@@ -2281,19 +2747,19 @@ struct controller_impl {
 
          EOS_ASSERT( !intersects, actor_blacklist_exception,
                      "authorizing actor(s) in transaction are on the actor blacklist: ${actors}",
-                     ("actors", generate_blacklisted_actors(actors, blacklist))
+                     ("actors", generate_blacklisted_actors(actors, conf.actor_blacklist))
                    );
       }
    }
 
    void check_contract_list( account_name code )const {
-      if( conf.contract_whitelist.size() > 0 ) {
-         EOS_ASSERT( conf.contract_whitelist.find( code ) != conf.contract_whitelist.end(),
+      if( !contract_whitelist.empty() ) {
+         EOS_ASSERT( contract_whitelist.contains( code ),
                      contract_whitelist_exception,
                      "account '${code}' is not on the contract whitelist", ("code", code)
                    );
-      } else if( conf.contract_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.contract_blacklist.find( code ) == conf.contract_blacklist.end(),
+      } else if( !contract_blacklist.empty() ) {
+         EOS_ASSERT( !contract_blacklist.contains( code ),
                      contract_blacklist_exception,
                      "account '${code}' is on the contract blacklist", ("code", code)
                    );
@@ -2301,8 +2767,8 @@ struct controller_impl {
    }
 
    void check_action_list( account_name code, action_name action )const {
-      if( conf.action_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.action_blacklist.find( std::make_pair(code, action) ) == conf.action_blacklist.end(),
+      if( !action_blacklist.empty() ) {
+         EOS_ASSERT( !action_blacklist.contains( std::make_pair(code, action) ),
                      action_blacklist_exception,
                      "action '${code}::${action}' is on the action blacklist",
                      ("code", code)("action", action)
@@ -2311,8 +2777,8 @@ struct controller_impl {
    }
 
    void check_key_list( const public_key_type& key )const {
-      if( conf.key_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.key_blacklist.find( key ) == conf.key_blacklist.end(),
+      if( !key_blacklist.empty() ) {
+         EOS_ASSERT( !key_blacklist.contains( key ),
                      key_blacklist_exception,
                      "public key '${key}' is on the key blacklist",
                      ("key", key)
@@ -2398,6 +2864,13 @@ controller::controller( const config& cfg, protocol_feature_set&& pfs, const cha
 
 controller::~controller() {
    my->abort_block();
+   try {
+      wait_for_async_signals();
+   } FC_LOG_AND_DROP()
+   // the fork database saved on close starts after the blocks still queued for the block log
+   try {
+      my->blog.flush();
+   } FC_LOG_AND_DROP()
    /* Shouldn't be needed anymore.
    //close fork_db here, because it can generate "irreversible" signal to this controller,
    //in case if read-mode == IRREVERSIBLE, we will apply latest irreversible block
@@ -2625,6 +3098,10 @@ boost::asio::io_context& controller::get_thread_pool() {
    return my->thread_pool.get_executor();
 }
 
+void controller::prefetch_block( const signed_block_ptr& b ) {
+   my->prefetch_block( b );
+}
+
 std::future<block_state_ptr> controller::create_block_state_future( const signed_block_ptr& b ) {
    return my->create_block_state_future( b );
 }
@@ -2644,6 +3121,11 @@ transaction_trace_ptr controller::push_transaction( const transaction_metadata_p
    return my->push_transaction(trx, deadline, billed_cpu_time_us, billed_cpu_time_us > 0 );
 }
 
+transaction_trace_ptr controller::push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline ) {
+   EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
+   return my->push_read_only_transaction( trx, deadline );
+}
+
 transaction_trace_ptr controller::push_scheduled_transaction( const transaction_id_type& trxid, fc::time_point deadline, uint32_t billed_cpu_time_us )
 {
    validate_db_available_size();
@@ -2671,15 +3153,19 @@ const flat_set<public_key_type>& controller::get_key_blacklist() const {
 
 void controller::set_actor_whitelist( const flat_set<account_name>& new_actor_whitelist ) {
    my->conf.actor_whitelist = new_actor_whitelist;
+   my->actor_whitelist.reset( my->conf.actor_whitelist );
 }
 void controller::set_actor_blacklist( const flat_set<account_name>& new_actor_blacklist ) {
    my->conf.actor_blacklist = new_actor_blacklist;
+   my->actor_blacklist.reset( my->conf.actor_blacklist );
 }
 void controller::set_contract_whitelist( const flat_set<account_name>& new_contract_whitelist ) {
    my->conf.contract_whitelist = new_contract_whitelist;
+   my->contract_whitelist.reset( my->conf.contract_whitelist );
 }
 void controller::set_contract_blacklist( const flat_set<account_name>& new_contract_blacklist ) {
    my->conf.contract_blacklist = new_contract_blacklist;
+   my->contract_blacklist.reset( my->conf.contract_blacklist );
 }
 void controller::set_action_blacklist( const flat_set< pair<account_name, action_name> >& new_action_blacklist ) {
    for (auto& act: new_action_blacklist) {
@@ -2687,9 +3173,11 @@ void controller::set_action_blacklist( const flat_set< pair<account_name, action
       EOS_ASSERT(act.second != action_name(), action_type_exception, "Action blacklist - action name should not be empty");
    }
    my->conf.action_blacklist = new_action_blacklist;
+   my->action_blacklist.reset( my->conf.action_blacklist );
 }
 void controller::set_key_blacklist( const flat_set<public_key_type>& new_key_blacklist ) {
    my->conf.key_blacklist = new_key_blacklist;
+   my->key_blacklist.reset( my->conf.key_blacklist );
 }
 
 uint32_t controller::head_block_num()const {
@@ -2814,16 +3302,45 @@ signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  {
    return my->blog.read_block_by_num(block_num);
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+std::vector<char> controller::fetch_serialized_block_by_number( uint32_t block_num )const  { try {
+   auto blk_state = fetch_block_state_by_number( block_num );
+   if( blk_state ) {
+      return *blk_state->packed_block();
+   }
+
+   return my->blog.read_serialized_block_by_num(block_num);
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+std::vector<char> controller::fetch_serialized_block_from_log( uint32_t block_num )const  { try {
+   return my->blog.read_serialized_block_by_num(block_num);
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+optional<uint32_t> controller::get_transaction_block( const transaction_id_type& id )const { try {
+   const auto root_num = my->fork_db.root()->block_num;
+   for( auto bsp = my->read_mode == db_read_mode::IRREVERSIBLE ? my->fork_db.pending_head() : my->head;
+        bsp && bsp->block_num > root_num; bsp = my->fork_db.get_block( bsp->header.previous ) ) {
+      if( bsp->block && trx_block_index::contains( *bsp->block, id ) )
+         return bsp->block_num;
+   }
+   for( uint32_t block_num : my->blog.find_trx_block_nums( id ) ) {
+      auto b = my->blog.read_block_by_num( block_num );
+      if( b && trx_block_index::contains( *b, id ) )
+         return block_num;
+   }
+   return {};
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+bool controller::has_trx_index()const {
+   return my->blog.has_trx_index();
+}
+
 block_state_ptr controller::fetch_block_state_by_id( block_id_type id )const {
    auto state = my->fork_db.get_block(id);
    return state;
 }
 
 block_state_ptr controller::fetch_block_state_by_number( uint32_t block_num )const  { try {
-   const auto& rev_blocks = my->reversible_blocks.get_index<reversible_block_index,by_num>();
-   auto objitr = rev_blocks.find(block_num);
-
-   if( objitr == rev_blocks.end() ) {
+   if( !my->reversible_blocks.contains(block_num) ) {
       if( my->read_mode == db_read_mode::IRREVERSIBLE ) {
          return my->fork_db.search_on_branch( my->fork_db.pending_head()->id, block_num );
       } else {
@@ -2831,7 +3348,8 @@ block_state_ptr controller::fetch_block_state_by_number( uint32_t block_num )con
       }
    }
 
-   return my->fork_db.get_block( objitr->get_block_id() );
+   // the head is on the branch of the pending head unless a block or a fork switch is being applied
+   return my->fork_db.search_on_branch( my->head->id, block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
 block_id_type controller::get_block_id_for_num( uint32_t block_num )const { try {
@@ -2846,10 +3364,9 @@ block_id_type controller::get_block_id_for_num( uint32_t block_num )const { try
 
    if( !find_in_blog ) {
       if( my->read_mode != db_read_mode::IRREVERSIBLE ) {
-         const auto& rev_blocks = my->reversible_blocks.get_index<reversible_block_index,by_num>();
-         auto objitr = rev_blocks.find(block_num);
-         if( objitr != rev_blocks.end() ) {
-            return objitr->get_block_id();
+         if( my->reversible_blocks.contains(block_num) ) {
+            if( auto bsp = my->fork_db.search_on_branch( my->head->id, block_num ) ) return bsp->id;
+            return my->reversible_blocks.read_block_id(block_num);
          }
       } else {
          auto bsp = my->fork_db.search_on_branch( my->fork_db.pending_head()->id, block_num );
@@ -2872,9 +3389,32 @@ sha256 controller::calculate_integrity_hash()const { try {
 
 void controller::write_snapshot( const snapshot_writer_ptr& snapshot ) const {
    EOS_ASSERT( !my->pending, block_validate_exception, "cannot take a consistent snapshot with a pending block" );
+   // the block log holds every block up to the snapshot's lib once it is written
+   my->blog.flush();
    return my->add_to_snapshot(snapshot);
 }
 
+std::shared_ptr<async_signal_consumer> controller::make_async_signal_consumer( std::string name, size_t max_queued ) {
+   auto consumer = std::make_shared<async_signal_consumer>( std::move(name), max_queued );
+   std::lock_guard<std::mutex> g( my->async_consumers_mtx );
+   auto& consumers = my->async_consumers;
+   consumers.erase( std::remove_if( consumers.begin(), consumers.end(), []( const auto& c ) { return c.expired(); } ),
+                    consumers.end() );
+   consumers.emplace_back( consumer );
+   return consumer;
+}
+
+void controller::wait_for_async_signals() {
+   vector<std::shared_ptr<async_signal_consumer>> consumers;
+   {
+      std::lock_guard<std::mutex> g( my->async_consumers_mtx );
+      for( const auto& c : my->async_consumers )
+         if( auto consumer = c.lock() ) consumers.emplace_back( std::move( consumer ) );
+   }
+   for( const auto& c : consumers )
+      c->wait();
+}
+
 int64_t controller::set_proposed_producers( vector<producer_authority> producers ) {
    const auto& gpo = get_global_properties();
    auto cur_block_num = head_block_num() + 1;
@@ -2928,20 +3468,20 @@ int64_t controller::set_proposed_producers( vector<producer_authority> producers
 
 const producer_authority_schedule&    controller::active_producers()const {
    if( !(my->pending) )
-      return  my->head->active_schedule;
+      return  *my->head->active_schedule;
 
    if( my->pending->_block_stage.contains<completed_block>() )
-      return my->pending->_block_stage.get<completed_block>()._block_state->active_schedule;
+      return *my->pending->_block_stage.get<completed_block>()._block_state->active_schedule;
 
-   return my->pending->get_pending_block_header_state().active_schedule;
+   return *my->pending->get_pending_block_header_state().active_schedule;
 }
 
 const producer_authority_schedule& controller::pending_producers()const {
    if( !(my->pending) )
-      return  my->head->pending_schedule.schedule;
+      return  *my->head->pending_schedule.schedule;
 
    if( my->pending->_block_stage.contains<completed_block>() )
-      return my->pending->_block_stage.get<completed_block>()._block_state->pending_schedule.schedule;
+      return *my->pending->_block_stage.get<completed_block>()._block_state->pending_schedule.schedule;
 
    if( my->pending->_block_stage.contains<assembled_block>() ) {
       const auto& new_prods_cache = my->pending->_block_stage.get<assembled_block>()._new_producer_authority_cache;
@@ -2955,7 +3495,7 @@ const producer_authority_schedule& controller::pending_producers()const {
    if( bb._new_pending_producer_schedule )
       return *bb._new_pending_producer_schedule;
 
-   return bb._pending_block_header_state.prev_pending_schedule.schedule;
+   return *bb._pending_block_header_state.prev_pending_schedule.schedule;
 }
 
 optional<producer_authority_schedule> controller::proposed_producers()const {
@@ -2980,7 +3520,10 @@ bool controller::light_validation_allowed(bool replay_opts_disabled_by_policy) c
    const bool consider_skipping_on_validate = (pb_status == block_status::complete &&
          (my->conf.block_validation_mode == validation_mode::LIGHT || my->trusted_producer_light_validation));
 
-   return consider_skipping_on_replay || consider_skipping_on_validate;
+   // OR in a replayed block up to the trusted block
+   const bool consider_skipping_trusted = pb_status != block_status::incomplete && my->trusted_producer_light_validation;
+
+   return consider_skipping_on_replay || consider_skipping_on_validate || consider_skipping_trusted;
 }
 
 
@@ -2989,7 +3532,7 @@ bool controller::skip_auth_check() const {
 }
 
 bool controller::skip_db_sessions( block_status bs ) const {
-   bool consider_skipping = bs == block_status::irreversible;
+   bool consider_skipping = bs == block_status::irreversible || my->applying_final_blocks;
    return consider_skipping
       && !my->conf.disable_replay_opts
       && !my->in_trx_requiring_checks;
@@ -3003,6 +3546,10 @@ bool controller::skip_db_sessions( ) const {
    }
 }
 
+bool controller::state_unrecoverable()const {
+   return my->state_unrecoverable;
+}
+
 bool controller::skip_trx_checks() const {
    return light_validation_allowed(my->conf.disable_replay_opts);
 }
@@ -3037,6 +3584,38 @@ wasm_interface& controller::get_wasm_interface() {
    return my->wasmif;
 }
 
+fc::optional<eosvmoc::warm_up_status> controller::get_eosvmoc_warm_up_status()const {
+   return my->wasmif.get_eosvmoc_warm_up_status();
+}
+
+fc::optional<eosvmoc::code_artifact> controller::export_eosvmoc_code( const digest_type& code_hash, uint8_t vm_version )const {
+   return my->wasmif.export_eosvmoc_code( code_hash, vm_version );
+}
+
+bool controller::import_eosvmoc_code( const eosvmoc::code_artifact& artifact ) {
+   return my->wasmif.import_eosvmoc_code( artifact );
+}
+
+wasm_cache_stats controller::get_wasm_cache_stats()const {
+   return my->wasmif.get_cache_stats();
+}
+
+vector<wasm_profile_entry> controller::get_wasm_profile()const {
+   return my->wasmif.get_profile();
+}
+
+action_stats* controller::get_action_stats() {
+   return my->action_statistics ? &*my->action_statistics : nullptr;
+}
+
+const action_stats* controller::get_action_stats()const {
+   return my->action_statistics ? &*my->action_statistics : nullptr;
+}
+
+apply_phase_stats* controller::get_apply_phase_stats() {
+   return my->phase_stats ? &*my->phase_stats : nullptr;
+}
+
 const account_object& controller::get_account( account_name name )const
 { try {
    return my->db.get<account_object, by_name>(name);
@@ -3050,6 +3629,11 @@ void controller::check_actor_list( const flat_set<account_name>& actors )const {
    my->check_actor_list( actors );
 }
 
+whitelist_blacklist_stats controller::get_whitelist_blacklist_stats()const {
+   return { my->actor_whitelist.get_stats(), my->actor_blacklist.get_stats(), my->contract_whitelist.get_stats(),
+            my->contract_blacklist.get_stats(), my->action_blacklist.get_stats(), my->key_blacklist.get_stats() };
+}
+
 void controller::check_contract_list( account_name code )const {
    my->check_contract_list( code );
 }
@@ -3111,12 +3695,6 @@ void controller::validate_db_available_size() const {
    EOS_ASSERT(free >= guard, database_guard_exception, "database free: ${f}, guard size: ${g}", ("f", free)("g",guard));
 }
 
-void controller::validate_reversible_available_size() const {
-   const auto free = my->reversible_blocks.get_segment_manager()->get_free_memory();
-   const auto guard = my->conf.reversible_guard_size;
-   EOS_ASSERT(free >= guard, reversible_guard_exception, "reversible free: ${f}, guard size: ${g}", ("f", free)("g",guard));
-}
-
 bool controller::is_protocol_feature_activated( const digest_type& feature_digest )const {
    if( my->pending )
       return my->pending->is_protocol_feature_activated( feature_digest );
@@ -3197,7 +3775,10 @@ bool controller::all_subjective_mitigations_disabled()const {
 
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
 vm::wasm_allocator& controller::get_wasm_allocator() {
-   return my->wasm_alloc;
+   // one linear memory per thread so that actions may run concurrently; it stays mapped across actions and eos-vm
+   // only zeroes the pages the previous action used
+   static thread_local vm::wasm_allocator wasm_alloc;
+   return wasm_alloc;
 }
 #endif
 
@@ -0,0 +1,207 @@
+#include <eosio/chain/database_memory.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/log/logger.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#endif
+
+namespace eosio { namespace chain {
+
+#ifdef __linux__
+namespace {
+   // from linux/mempolicy.h, called through syscall() so libnuma is not required
+   constexpr int      mpol_preferred = 1;
+   constexpr unsigned mpol_mf_move = 1 << 1;
+   constexpr size_t   max_numa_nodes = 1024;
+   constexpr size_t   prefetch_chunk_size = 64*1024*1024;
+   constexpr size_t   parallel_chunk_size = 8*1024*1024;
+
+   using node_mask = std::array<unsigned long, max_numa_nodes / (8 * sizeof(unsigned long))>;
+
+   node_mask mask_for( int32_t node ) {
+      node_mask mask{};
+      mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+      return mask;
+   }
+
+   /// parses /sys/devices/system/node/nodeN/cpulist, e.g. "0-15,32-47"
+   cpu_set_t cpus_of_node( int32_t node ) {
+      const std::string path = "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist";
+      std::ifstream in( path );
+      std::string list;
+      EOS_ASSERT( in && std::getline( in, list ), misc_exception, "NUMA node ${n} does not exist, ${p} is not readable",
+                  ("n", node)("p", path) );
+      cpu_set_t cpus;
+      CPU_ZERO( &cpus );
+      std::istringstream ranges( list );
+      std::string range;
+      while( std::getline( ranges, range, ',' ) ) {
+         if( range.empty() )
+            continue;
+         const auto dash = range.find( '-' );
+         const int first = std::stoi( range.substr( 0, dash ) );
+         const int last = dash == std::string::npos ? first : std::stoi( range.substr( dash + 1 ) );
+         for( int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu )
+            CPU_SET( cpu, &cpus );
+      }
+      EOS_ASSERT( CPU_COUNT( &cpus ) > 0, misc_exception, "NUMA node ${n} has no CPUs", ("n", node) );
+      return cpus;
+   }
+
+   void bind_to_node( char* addr, size_t len, int32_t node ) {
+      const cpu_set_t cpus = cpus_of_node( node );
+      if( sched_setaffinity( 0, sizeof(cpus), &cpus ) != 0 )
+         wlog( "unable to bind the main thread to NUMA node ${n}: ${e}", ("n", node)("e", strerror(errno)) );
+
+      // preferred rather than bind so allocations fall back to other nodes instead of failing when the node is full
+      const node_mask mask = mask_for( node );
+      if( syscall( SYS_set_mempolicy, mpol_preferred, mask.data(), max_numa_nodes ) != 0 )
+         wlog( "unable to set the memory policy of the main thread to NUMA node ${n}: ${e}", ("n", node)("e", strerror(errno)) );
+      // moves the pages already resident, e.g. those chainbase copied in "heap" and "locked" mode
+      if( syscall( SYS_mbind, addr, len, mpol_preferred, mask.data(), max_numa_nodes, mpol_mf_move ) != 0 )
+         wlog( "unable to bind the database to NUMA node ${n}: ${e}", ("n", node)("e", strerror(errno)) );
+      else
+         ilog( "Bound the main thread and the database to NUMA node ${n}", ("n", node) );
+   }
+
+   /// runs f(offset, size) for the chunks of [0, len) on threads threads, each taking the next chunk left
+   template<typename F>
+   void for_each_chunk_in_parallel( uint64_t len, size_t chunk_size, uint32_t threads, F f ) {
+      std::atomic<uint64_t> next{0};
+      auto work = [&]() {
+         for( uint64_t off = next.fetch_add( chunk_size ); off < len; off = next.fetch_add( chunk_size ) )
+            f( off, std::min<uint64_t>( chunk_size, len - off ) );
+      };
+      std::vector<std::thread> workers;
+      for( uint32_t i = 1; i < threads; ++i )
+         workers.emplace_back( work );
+      work();
+      for( auto& t : workers )
+         t.join();
+   }
+
+   /**
+    * Reads fd into the page cache, front to back in large chunks on a single thread, or in smaller chunks on threads
+    * threads to keep the device busy with that many reads at once. @return the bytes read
+    */
+   uint64_t read_into_page_cache( int fd, uint32_t threads ) {
+      if( threads <= 1 ) {
+         posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+         std::vector<char> buffer( prefetch_chunk_size );
+         uint64_t total = 0;
+         ssize_t r;
+         while( (r = ::read( fd, buffer.data(), buffer.size() )) > 0 )
+            total += r;
+         return total;
+      }
+      struct stat st;
+      if( fstat( fd, &st ) != 0 )
+         return 0;
+      std::atomic<uint64_t> total{0};
+      for_each_chunk_in_parallel( st.st_size, parallel_chunk_size, threads, [&]( uint64_t off, uint64_t size ) {
+         thread_local std::vector<char> buffer( parallel_chunk_size );
+         uint64_t done = 0;
+         ssize_t r;
+         while( done < size && (r = ::pread( fd, buffer.data(), size - done, off + done )) > 0 )
+            done += r;
+         total += done;
+      } );
+      return total;
+   }
+
+   /**
+    * Reads the state file into the page cache in large chunks so it is filled by streaming reads instead of by
+    * random faults, then touches every page of the mapping so the faults taken now are minor ones.
+    */
+   void prefetch( char* addr, size_t len, const fc::path& state_file, uint32_t threads ) {
+      const auto start = fc::time_point::now();
+      const int fd = ::open( state_file.generic_string().c_str(), O_RDONLY | O_CLOEXEC );
+      if( fd < 0 ) {
+         wlog( "unable to open ${f} for prefetch: ${e}", ("f", state_file.generic_string())("e", strerror(errno)) );
+         return;
+      }
+      const uint64_t total = read_into_page_cache( fd, threads );
+      ::close( fd );
+
+      madvise( addr, len, MADV_WILLNEED );
+      const size_t page_size = sysconf( _SC_PAGESIZE );
+      for_each_chunk_in_parallel( len, parallel_chunk_size, std::max( threads, 1u ), [&]( uint64_t off, uint64_t size ) {
+         volatile char sink = 0;
+         for( uint64_t p = off; p < off + size; p += page_size )
+            sink += addr[p];
+         (void)sink;
+      } );
+
+      const auto elapsed = fc::time_point::now() - start;
+      ilog( "Prefetched ${mb} MiB of ${f} in ${ms} ms",
+            ("mb", total >> 20)("f", state_file.generic_string())("ms", elapsed.count() / 1000) );
+   }
+}
+#endif
+
+void preload_database_file( const fc::path& state_file, chainbase::pinnable_mapped_file::map_mode mode,
+                            const database_memory_config& cfg ) {
+#ifdef __linux__
+   if( mode == chainbase::pinnable_mapped_file::map_mode::mapped || cfg.load_threads == 0 )
+      return;
+   const int fd = ::open( state_file.generic_string().c_str(), O_RDONLY | O_CLOEXEC );
+   if( fd < 0 )
+      return; // a new database
+   const auto start = fc::time_point::now();
+   const uint64_t total = read_into_page_cache( fd, cfg.load_threads );
+   ::close( fd );
+   ilog( "Read ${mb} MiB of ${f} into the page cache with ${t} threads in ${ms} ms",
+         ("mb", total >> 20)("f", state_file.generic_string())("t", cfg.load_threads)
+         ("ms", (fc::time_point::now() - start).count() / 1000) );
+#endif
+}
+
+void configure_database_memory( const chainbase::database& db, const fc::path& state_file,
+                                chainbase::pinnable_mapped_file::map_mode mode, const database_memory_config& cfg ) {
+#ifdef __linux__
+   if( !cfg.prefetch && !cfg.transparent_hugepages && cfg.numa_node < 0 )
+      return;
+   EOS_ASSERT( cfg.numa_node < int32_t(max_numa_nodes), misc_exception, "NUMA node ${n} is out of range", ("n", cfg.numa_node) );
+
+   // the segment manager lives just behind the header at the start of the mapping and extends to its end
+   const uintptr_t page_size = sysconf( _SC_PAGESIZE );
+   char* const segment = reinterpret_cast<char*>( db.get_segment_manager() );
+   char* const addr = reinterpret_cast<char*>( reinterpret_cast<uintptr_t>( segment ) & ~(page_size - 1) );
+   const size_t len = segment + db.get_segment_manager()->get_size() - addr;
+
+   if( cfg.numa_node >= 0 )
+      bind_to_node( addr, len, cfg.numa_node );
+
+   if( cfg.transparent_hugepages ) {
+      if( mode == chainbase::pinnable_mapped_file::map_mode::locked )
+         ilog( "database-transparent-hugepages has no effect in \"locked\" mode, use database-hugepage-path" );
+      else if( madvise( addr, len, MADV_HUGEPAGE ) != 0 )
+         wlog( "madvise(MADV_HUGEPAGE) of the database failed: ${e}", ("e", strerror(errno)) );
+   }
+
+   if( cfg.prefetch ) {
+      if( mode == chainbase::pinnable_mapped_file::map_mode::mapped )
+         prefetch( addr, len, state_file, cfg.load_threads );
+      else
+         ilog( "database-prefetch has no effect unless database-map-mode is \"mapped\", the database is already loaded" );
+   }
+#endif
+}
+
+} } // eosio::chain
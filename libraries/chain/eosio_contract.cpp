@@ -137,7 +137,7 @@ void apply_eosio_setcode(apply_context& context) {
 
    if( code_size > 0 ) {
      code_hash = fc::sha256::hash( act.code.data(), (uint32_t)act.code.size() );
-     wasm_interface::validate(context.control, act.code);
+     context.control.get_wasm_interface().validate(context.control, act.code, code_hash);
    }
 
    const auto& account = db.get<account_metadata_object,by_name>(act.account);
@@ -180,6 +180,7 @@ void apply_eosio_setcode(apply_context& context) {
             o.vm_version = act.vmversion;
          });
       }
+      context.control.get_wasm_interface().preinstantiate(code_hash, act.vmtype, act.vmversion, act.code);
    }
 
    db.modify( account, [&]( auto& a ) {
@@ -8,7 +8,11 @@
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/scoped_exit.hpp>
+#include <boost/filesystem.hpp>
+#include <deque>
 #include <fstream>
+#include <future>
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
@@ -29,6 +33,28 @@ namespace eosio { namespace chain {
     * Version 1: initial version of the new refactored fork database portable format
     */
 
+   /**
+    * The fork database is persisted as a journal of its modifications in config::forkdb_journal_filename, appended
+    * to as they happen so that nothing has to be written at shutdown and a killed process loses at most the record
+    * being written. The journal starts with the magic number and journal_version, followed by records of
+    * [uint32_t size of type and payload][journal_record type][payload]. Once it has grown enough, the journal is
+    * rewritten in the background as a reset to the root, an add of every block and the head.
+    */
+   const uint32_t journal_version = 1;
+
+   enum class journal_record : uint8_t {
+      reset                 = 0, ///< block_header_state of the new root
+      add                   = 1, ///< block_state
+      mark_valid            = 2, ///< block_id_type
+      advance_root          = 3, ///< block_id_type
+      remove                = 4, ///< block_id_type
+      rollback_head_to_root = 5, ///< no payload
+      head                  = 6  ///< block_id_type, only written by compaction
+   };
+
+   // the journal is compacted once it is larger than this and twice its size after the last compaction
+   constexpr uint64_t min_journal_compaction_size = 64*1024*1024;
+
    struct by_block_id;
    struct by_lib_block_num;
    struct by_prev;
@@ -71,11 +97,57 @@ namespace eosio { namespace chain {
       block_state_ptr       head;
       fc::path              datadir;
 
-      void add( const block_state_ptr& n,
+      /// blocks of the branch of the pending head by number, the first one follows the root
+      std::deque<block_state_ptr> pending_branch;
+
+      using validator_t = std::function<void( block_timestamp_type,
+                                              const flat_set<digest_type>&,
+                                              const vector<digest_type>& )>;
+
+      struct compaction_entry {
+         block_header_state                       bhs;
+         std::shared_ptr<const std::vector<char>> packed_block;
+         bool                                     validated = false;
+      };
+
+      std::ofstream         journal;
+      bool                  journaling = false;      ///< false while the fork database is rebuilt from storage
+      uint64_t              journal_size = 0;
+      uint64_t              compacted_size = 0;      ///< journal size after the last compaction
+      uint64_t              compact_from = 0;        ///< journal offset of the records not in the running compaction
+      std::future<uint64_t> compaction;              ///< size of the compacted journal
+
+      /// @return false if n was a duplicate and ignored
+      bool add( const block_state_ptr& n,
                 bool ignore_duplicate, bool validate,
-                const std::function<void( block_timestamp_type,
-                                          const flat_set<digest_type>&,
-                                          const vector<digest_type>& )>& validator );
+                const validator_t& validator );
+
+      /// follows the pending head after a modification, walking back only to where the new branch joins the old one
+      void update_pending_branch();
+      /// block with block_num on pending_branch, nullptr if it has none
+      block_state_ptr on_pending_branch( uint32_t block_num )const;
+
+      fc::path journal_path()const { return datadir / config::forkdb_journal_filename; }
+      fc::path compacted_journal_path()const { return datadir / (string(config::forkdb_journal_filename) + ".compact"); }
+
+      void load_legacy( const fc::path& fork_db_dat, const validator_t& validator );
+      void replay_journal( const validator_t& validator );
+      void open_journal();
+
+      template<typename T>
+      void append( journal_record type, const T& payload );
+      void append( journal_record type );
+      void append_record( journal_record type, const std::vector<char>& payload );
+      /// @return payload of an add record, block_state as packed by fc::raw::pack with its block packed already
+      static std::vector<char> pack_block_state( const block_header_state& bhs, const std::vector<char>& packed_block, bool validated );
+
+      /// blocks in an order they can be added back in, reproducing the head
+      vector<block_state_ptr> sorted_blocks()const;
+      vector<compaction_entry> compaction_entries()const;
+      static uint64_t write_compacted_journal( const fc::path& path, const block_header_state& root,
+                                               const vector<compaction_entry>& entries, const block_id_type& head_id );
+      void maybe_compact();
+      void finish_compaction();
    };
 
 
@@ -91,96 +163,256 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(my->datadir))
          fc::create_directories(my->datadir);
 
+      EOS_ASSERT( !my->journal.is_open(), fork_database_exception, "fork database already open" );
+      fc::remove( my->compacted_journal_path() ); // of a compaction that did not finish
+
       auto fork_db_dat = my->datadir / config::forkdb_filename;
       if( fc::exists( fork_db_dat ) ) {
-         try {
-            string content;
-            fc::read_file_contents( fork_db_dat, content );
-
-            fc::datastream<const char*> ds( content.data(), content.size() );
-
-            // validate totem
-            uint32_t totem = 0;
-            fc::raw::unpack( ds, totem );
-            EOS_ASSERT( totem == magic_number, fork_database_exception,
-                        "Fork database file '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
-                        ("filename", fork_db_dat.generic_string())
-                        ("actual_totem", totem)
-                        ("expected_totem", magic_number)
-            );
-
-            // validate version
-            uint32_t version = 0;
-            fc::raw::unpack( ds, version );
-            EOS_ASSERT( version >= min_supported_version && version <= max_supported_version,
-                        fork_database_exception,
-                       "Unsupported version of fork database file '${filename}'. "
-                       "Fork database version is ${version} while code supports version(s) [${min},${max}]",
-                       ("filename", fork_db_dat.generic_string())
-                       ("version", version)
-                       ("min", min_supported_version)
-                       ("max", max_supported_version)
-            );
-
-            block_header_state bhs;
-            fc::raw::unpack( ds, bhs );
-            reset( bhs );
-
-            unsigned_int size; fc::raw::unpack( ds, size );
-            for( uint32_t i = 0, n = size.value; i < n; ++i ) {
-               block_state s;
-               fc::raw::unpack( ds, s );
-               // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
-               s.header_exts = s.block->validate_and_extract_header_extensions();
-               my->add( std::make_shared<block_state>( move( s ) ), false, true, validator );
-            }
-            block_id_type head_id;
-            fc::raw::unpack( ds, head_id );
+         // written by a version without the journal, or by a close of this version
+         fc::remove( my->journal_path() );
+         my->load_legacy( fork_db_dat, validator );
+         if( my->root ) {
+            my->compacted_size = fork_database_impl::write_compacted_journal( my->compacted_journal_path(), *my->root,
+                                                                              my->compaction_entries(), my->head->id );
+            fc::rename( my->compacted_journal_path(), my->journal_path() );
+         }
+         fc::remove( fork_db_dat );
+      } else if( fc::exists( my->journal_path() ) ) {
+         my->replay_journal( validator );
+      }
 
-            if( my->root->id == head_id ) {
-               my->head = my->root;
-            } else {
-               my->head = get_block( head_id );
-               EOS_ASSERT( my->head, fork_database_exception,
-                           "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            }
+      my->open_journal();
+   }
 
-            auto candidate = my->index.get<by_lib_block_num>().begin();
-            if( candidate == my->index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
-               EOS_ASSERT( my->head->id == my->root->id, fork_database_exception,
-                           "head not set to root despite no better option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            } else {
-               EOS_ASSERT( !first_preferred( **candidate, *my->head ), fork_database_exception,
-                           "head not set to best available option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            }
-         } FC_CAPTURE_AND_RETHROW( (fork_db_dat) )
+   void fork_database_impl::load_legacy( const fc::path& fork_db_dat, const validator_t& validator ) {
+      try {
+         string content;
+         fc::read_file_contents( fork_db_dat, content );
+
+         fc::datastream<const char*> ds( content.data(), content.size() );
+
+         // validate totem
+         uint32_t totem = 0;
+         fc::raw::unpack( ds, totem );
+         EOS_ASSERT( totem == fork_database::magic_number, fork_database_exception,
+                     "Fork database file '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
+                     ("filename", fork_db_dat.generic_string())
+                     ("actual_totem", totem)
+                     ("expected_totem", fork_database::magic_number)
+         );
 
-         fc::remove( fork_db_dat );
-      }
+         // validate version
+         uint32_t version = 0;
+         fc::raw::unpack( ds, version );
+         EOS_ASSERT( version >= fork_database::min_supported_version && version <= fork_database::max_supported_version,
+                     fork_database_exception,
+                    "Unsupported version of fork database file '${filename}'. "
+                    "Fork database version is ${version} while code supports version(s) [${min},${max}]",
+                    ("filename", fork_db_dat.generic_string())
+                    ("version", version)
+                    ("min", fork_database::min_supported_version)
+                    ("max", fork_database::max_supported_version)
+         );
+
+         block_header_state bhs;
+         fc::raw::unpack( ds, bhs );
+         self.reset( bhs );
+
+         unsigned_int size; fc::raw::unpack( ds, size );
+         for( uint32_t i = 0, n = size.value; i < n; ++i ) {
+            block_state s;
+            fc::raw::unpack( ds, s );
+            // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+            s.header_exts = s.block->validate_and_extract_header_extensions();
+            add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+         }
+         block_id_type head_id;
+         fc::raw::unpack( ds, head_id );
+
+         if( root->id == head_id ) {
+            head = root;
+         } else {
+            head = self.get_block( head_id );
+            EOS_ASSERT( head, fork_database_exception,
+                        "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
+                        ("filename", fork_db_dat.generic_string()) );
+         }
+         update_pending_branch();
+
+         auto candidate = index.get<by_lib_block_num>().begin();
+         if( candidate == index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
+            EOS_ASSERT( head->id == root->id, fork_database_exception,
+                        "head not set to root despite no better option available; '${filename}' is likely corrupted",
+                        ("filename", fork_db_dat.generic_string()) );
+         } else {
+            EOS_ASSERT( !first_preferred( **candidate, *head ), fork_database_exception,
+                        "head not set to best available option available; '${filename}' is likely corrupted",
+                        ("filename", fork_db_dat.generic_string()) );
+         }
+      } FC_CAPTURE_AND_RETHROW( (fork_db_dat) )
    }
 
-   void fork_database::close() {
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
+   void fork_database_impl::replay_journal( const validator_t& validator ) {
+      const auto path = journal_path();
+      try {
+         string content;
+         fc::read_file_contents( path, content );
+
+         fc::datastream<const char*> ds( content.data(), content.size() );
+
+         uint32_t totem = 0;
+         fc::raw::unpack( ds, totem );
+         EOS_ASSERT( totem == fork_database::magic_number, fork_database_exception,
+                     "Fork database journal '${filename}' has unexpected magic number: ${actual_totem}. Expected ${expected_totem}",
+                     ("filename", path.generic_string())
+                     ("actual_totem", totem)
+                     ("expected_totem", fork_database::magic_number)
+         );
+
+         uint32_t version = 0;
+         fc::raw::unpack( ds, version );
+         EOS_ASSERT( version == journal_version, fork_database_exception,
+                     "Unsupported version of fork database journal '${filename}'. "
+                     "Journal version is ${version} while code supports version ${supported}",
+                     ("filename", path.generic_string())
+                     ("version", version)
+                     ("supported", journal_version)
+         );
 
-      if( !my->root ) {
-         if( my->index.size() > 0 ) {
-            elog( "fork_database is in a bad state when closing; not writing out '${filename}'",
-                  ("filename", fork_db_dat.generic_string()) );
+         uint64_t valid_size = ds.tellp();
+         uint32_t num_records = 0;
+         while( ds.remaining() > 0 ) {
+            uint32_t size = 0;
+            if( ds.remaining() < sizeof(size) ) break;
+            fc::raw::unpack( ds, size );
+            // a record cut short by a crash ends the journal
+            if( size == 0 || ds.remaining() < size ) break;
+
+            fc::datastream<const char*> rds( ds.pos(), size );
+            ds.skip( size );
+
+            uint8_t type = 0;
+            fc::raw::unpack( rds, type );
+            switch( static_cast<journal_record>( type ) ) {
+               case journal_record::reset: {
+                  block_header_state bhs;
+                  fc::raw::unpack( rds, bhs );
+                  self.reset( bhs );
+                  break;
+               }
+               case journal_record::add: {
+                  block_state s;
+                  fc::raw::unpack( rds, s );
+                  // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+                  s.header_exts = s.block->validate_and_extract_header_extensions();
+                  add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+                  break;
+               }
+               case journal_record::mark_valid: {
+                  block_id_type id;
+                  fc::raw::unpack( rds, id );
+                  auto b = self.get_block( id );
+                  EOS_ASSERT( b, fork_database_exception, "journal marks unknown block ${id} valid", ("id", id) );
+                  self.mark_valid( b );
+                  break;
+               }
+               case journal_record::advance_root: {
+                  block_id_type id;
+                  fc::raw::unpack( rds, id );
+                  self.advance_root( id );
+                  break;
+               }
+               case journal_record::remove: {
+                  block_id_type id;
+                  fc::raw::unpack( rds, id );
+                  self.remove( id );
+                  break;
+               }
+               case journal_record::rollback_head_to_root:
+                  self.rollback_head_to_root();
+                  break;
+               case journal_record::head: {
+                  block_id_type id;
+                  fc::raw::unpack( rds, id );
+                  EOS_ASSERT( root, fork_database_exception, "journal sets head before the root" );
+                  head = root->id == id ? root : self.get_block( id );
+                  EOS_ASSERT( head, fork_database_exception, "journal sets unknown block ${id} as head", ("id", id) );
+                  update_pending_branch();
+                  break;
+               }
+               default:
+                  EOS_THROW( fork_database_exception, "unknown journal record type ${t}", ("t", type) );
+            }
+            valid_size = ds.tellp();
+            ++num_records;
          }
-         return;
+
+         if( valid_size < content.size() ) {
+            wlog( "dropping ${n} bytes of an incomplete record at the end of fork database journal '${filename}'",
+                  ("n", content.size() - valid_size)("filename", path.generic_string()) );
+            boost::filesystem::resize_file( path.generic_string(), valid_size );
+         }
+         journal_size = valid_size;
+         compacted_size = valid_size;
+         ilog( "fork database restored from ${n} journal records", ("n", num_records) );
+      } FC_CAPTURE_AND_RETHROW( (path) )
+   }
+
+   void fork_database_impl::open_journal() {
+      const auto path = journal_path();
+      const bool exists = fc::exists( path );
+      journal.open( path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      EOS_ASSERT( journal, fork_database_exception, "unable to open fork database journal '${filename}'",
+                  ("filename", path.generic_string()) );
+      if( !exists ) {
+         fc::raw::pack( journal, fork_database::magic_number );
+         fc::raw::pack( journal, journal_version );
+         journal.flush();
+         journal_size = compacted_size = sizeof(fork_database::magic_number) + sizeof(journal_version);
+      } else {
+         journal_size = fc::file_size( path );
       }
+      journaling = true;
+   }
 
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      fc::raw::pack( out, magic_number );
-      fc::raw::pack( out, max_supported_version ); // write out current version which is always max_supported_version
-      fc::raw::pack( out, *static_cast<block_header_state*>(&*my->root) );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
+   void fork_database_impl::append_record( journal_record type, const std::vector<char>& payload ) {
+      if( !journaling ) return;
+      const uint32_t size = payload.size() + sizeof(type);
+      journal.write( (const char*)&size, sizeof(size) );
+      journal.put( static_cast<char>( type ) );
+      journal.write( payload.data(), payload.size() );
+      journal.flush();
+      EOS_ASSERT( journal, fork_database_exception, "unable to write fork database journal '${filename}'",
+                  ("filename", journal_path().generic_string()) );
+      journal_size += sizeof(size) + size;
+      maybe_compact();
+   }
 
-      const auto& indx = my->index.get<by_lib_block_num>();
+   std::vector<char> fork_database_impl::pack_block_state( const block_header_state& bhs, const std::vector<char>& packed_block,
+                                                           bool validated ) {
+      std::vector<char> payload( fc::raw::pack_size( bhs ) + packed_block.size() + 1 );
+      fc::datastream<char*> ds( payload.data(), payload.size() );
+      fc::raw::pack( ds, bhs );
+      ds.write( packed_block.data(), packed_block.size() );
+      fc::raw::pack( ds, validated );
+      return payload;
+   }
+
+   template<typename T>
+   void fork_database_impl::append( journal_record type, const T& payload ) {
+      if( !journaling ) return;
+      append_record( type, fc::raw::pack( payload ) );
+   }
+
+   void fork_database_impl::append( journal_record type ) {
+      append_record( type, {} );
+   }
+
+   vector<block_state_ptr> fork_database_impl::sorted_blocks()const {
+      vector<block_state_ptr> result;
+      result.reserve( index.size() );
+
+      const auto& indx = index.get<by_lib_block_num>();
 
       auto unvalidated_itr = indx.rbegin();
       auto unvalidated_end = boost::make_reverse_iterator( indx.lower_bound( false ) );
@@ -212,17 +444,121 @@ namespace eosio { namespace chain {
             ++validated_itr;
          }
 
-         fc::raw::pack( out, *(*itr) );
+         result.push_back( *itr );
       }
+      return result;
+   }
 
-      if( my->head ) {
-         fc::raw::pack( out, my->head->id );
-      } else {
-         elog( "head not set in fork database; '${filename}' will be corrupted",
-               ("filename", fork_db_dat.generic_string()) );
+   vector<fork_database_impl::compaction_entry> fork_database_impl::compaction_entries()const {
+      // copies of the header states, whose validated flags may change while the compaction runs
+      vector<compaction_entry> result;
+      for( const auto& b : sorted_blocks() ) {
+         result.push_back( compaction_entry{ *b, b->packed_block(), b->validated } );
+      }
+      return result;
+   }
+
+   uint64_t fork_database_impl::write_compacted_journal( const fc::path& path, const block_header_state& root,
+                                                         const vector<compaction_entry>& entries, const block_id_type& head_id ) {
+      std::ofstream out( path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+      fc::raw::pack( out, fork_database::magic_number );
+      fc::raw::pack( out, journal_version );
+
+      auto write = [&out]( journal_record type, const std::vector<char>& payload ) {
+         const uint32_t size = payload.size() + sizeof(type);
+         out.write( (const char*)&size, sizeof(size) );
+         out.put( static_cast<char>( type ) );
+         out.write( payload.data(), payload.size() );
+      };
+
+      write( journal_record::reset, fc::raw::pack( root ) );
+      for( const auto& e : entries ) {
+         write( journal_record::add, pack_block_state( e.bhs, *e.packed_block, e.validated ) );
+      }
+      write( journal_record::head, fc::raw::pack( head_id ) );
+
+      out.flush();
+      EOS_ASSERT( out, fork_database_exception, "unable to write compacted fork database journal '${filename}'",
+                  ("filename", path.generic_string()) );
+      return static_cast<uint64_t>( out.tellp() );
+   }
+
+   void fork_database_impl::maybe_compact() {
+      if( compaction.valid() ) {
+         if( compaction.wait_for( std::chrono::seconds(0) ) == std::future_status::ready ) {
+            finish_compaction();
+         }
+         return;
+      }
+      if( !root || journal_size < std::max( min_journal_compaction_size, 2 * compacted_size ) ) {
+         return;
+      }
+
+      compact_from = journal_size;
+      compaction = std::async( std::launch::async,
+                               [path = compacted_journal_path(), root_bhs = block_header_state( *root ),
+                                entries = compaction_entries(), head_id = head->id]() {
+         return write_compacted_journal( path, root_bhs, entries, head_id );
+      } );
+   }
+
+   void fork_database_impl::finish_compaction() {
+      const auto path = journal_path();
+      const auto compacted_path = compacted_journal_path();
+      uint64_t size = 0;
+      try {
+         size = compaction.get();
+      } catch( const fc::exception& e ) {
+         wlog( "fork database journal compaction failed: ${e}", ("e", e.to_detail_string()) );
+         fc::remove( compacted_path );
+         return;
+      } catch( const std::exception& e ) {
+         wlog( "fork database journal compaction failed: ${e}", ("e", e.what()) );
+         fc::remove( compacted_path );
+         return;
+      }
+
+      // records appended while the compaction ran follow the compacted state
+      journal.close();
+      {
+         std::ifstream in( path.generic_string().c_str(), std::ios::in | std::ios::binary );
+         in.seekg( compact_from );
+         std::ofstream out( compacted_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+         std::vector<char> tail( journal_size - compact_from );
+         in.read( tail.data(), tail.size() );
+         out.write( tail.data(), tail.size() );
+         out.flush();
+         EOS_ASSERT( in && out, fork_database_exception, "unable to finish compaction of fork database journal '${filename}'",
+                     ("filename", path.generic_string()) );
+      }
+      fc::rename( compacted_path, path );
+      compacted_size = size;
+      journal_size = size + ( journal_size - compact_from );
+
+      journal.open( path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      EOS_ASSERT( journal, fork_database_exception, "unable to open fork database journal '${filename}'",
+                  ("filename", path.generic_string()) );
+   }
+
+   void fork_database::close() {
+      // the journal holds the fork database, nothing is left to write
+      if( my->compaction.valid() ) {
+         try {
+            my->compaction.wait();
+            my->finish_compaction();
+         } FC_LOG_AND_DROP()
+      }
+      if( my->journal.is_open() ) {
+         my->journal.close();
+      }
+      my->journaling = false;
+
+      if( !my->root && my->index.size() > 0 ) {
+         elog( "fork_database is in a bad state when closing" );
       }
 
       my->index.clear();
+      my->pending_branch.clear();
    }
 
    fork_database::~fork_database() {
@@ -235,6 +571,8 @@ namespace eosio { namespace chain {
       static_cast<block_header_state&>(*my->root) = root_bhs;
       my->root->validated = true;
       my->head = my->root;
+      my->pending_branch.clear();
+      my->append( journal_record::reset, root_bhs );
    }
 
    void fork_database::rollback_head_to_root() {
@@ -247,6 +585,8 @@ namespace eosio { namespace chain {
          ++itr;
       }
       my->head = my->root;
+      my->update_pending_branch();
+      my->append( journal_record::rollback_head_to_root );
    }
 
    void fork_database::advance_root( const block_id_type& id ) {
@@ -269,17 +609,24 @@ namespace eosio { namespace chain {
       // The new root block should be erased from the fork database index individually rather than with the remove method,
       // because we do not want the blocks branching off of it to be removed from the fork database.
       my->index.erase( my->index.find( id ) );
+      my->root = new_root;
 
       // The other blocks to be removed are removed using the remove method so that orphaned branches do not remain in the fork database.
-      for( const auto& block_id : blocks_to_remove ) {
-         remove( block_id );
+      // They are part of the advance_root record of the journal.
+      {
+         auto restore = fc::make_scoped_exit( [this, journaling = my->journaling]() { my->journaling = journaling; } );
+         my->journaling = false;
+         for( const auto& block_id : blocks_to_remove ) {
+            remove( block_id );
+         }
       }
 
       // Even though fork database no longer needs block or trxs when a block state becomes a root of the tree,
       // avoid mutating the block state at all, for example clearing the block shared pointer, because other
       // parts of the code which run asynchronously (e.g. mongo_db_plugin) may later expect it remain unmodified.
 
-      my->root = new_root;
+      my->update_pending_branch();
+      my->append( journal_record::advance_root, id );
    }
 
    block_header_state_ptr fork_database::get_block_header( const block_id_type& id )const {
@@ -296,7 +643,7 @@ namespace eosio { namespace chain {
       return block_header_state_ptr();
    }
 
-   void fork_database_impl::add( const block_state_ptr& n,
+   bool fork_database_impl::add( const block_state_ptr& n,
                                  bool ignore_duplicate, bool validate,
                                  const std::function<void( block_timestamp_type,
                                                            const flat_set<digest_type>&,
@@ -323,7 +670,7 @@ namespace eosio { namespace chain {
 
       auto inserted = index.insert(n);
       if( !inserted.second ) {
-         if( ignore_duplicate ) return;
+         if( ignore_duplicate ) return false;
          EOS_THROW( fork_database_exception, "duplicate block added", ("id", n->id) );
       }
 
@@ -331,15 +678,55 @@ namespace eosio { namespace chain {
       if( (*candidate)->is_valid() ) {
          head = *candidate;
       }
+      update_pending_branch();
+      return true;
+   }
+
+   void fork_database_impl::update_pending_branch() {
+      if( !root ) {
+         pending_branch.clear();
+         return;
+      }
+      while( !pending_branch.empty() && pending_branch.front()->block_num <= root->block_num )
+         pending_branch.pop_front();
+
+      size_t kept = 0;
+      vector<block_state_ptr> added;
+      for( auto b = self.pending_head(); b->id != root->id; ) {
+         const size_t i = b->block_num - root->block_num - 1;
+         if( i < pending_branch.size() && pending_branch[i]->id == b->id ) {
+            kept = i + 1;
+            break;
+         }
+         added.push_back( b );
+         auto itr = index.find( b->header.previous );
+         if( itr == index.end() ) {
+            // the pending head is not linked to the root while advance_root removes the branches it orphans
+            if( b->header.previous != root->id ) added.clear();
+            break;
+         }
+         b = *itr;
+      }
+      pending_branch.resize( kept );
+      pending_branch.insert( pending_branch.end(), added.rbegin(), added.rend() );
+   }
+
+   block_state_ptr fork_database_impl::on_pending_branch( uint32_t block_num )const {
+      if( !root || block_num <= root->block_num || block_num - root->block_num > pending_branch.size() )
+         return block_state_ptr();
+      return pending_branch[block_num - root->block_num - 1];
    }
 
    void fork_database::add( const block_state_ptr& n, bool ignore_duplicate ) {
-      my->add( n, ignore_duplicate, false,
-               []( block_timestamp_type timestamp,
-                   const flat_set<digest_type>& cur_features,
-                   const vector<digest_type>& new_features )
-               {}
+      bool added = my->add( n, ignore_duplicate, false,
+                            []( block_timestamp_type timestamp,
+                                const flat_set<digest_type>& cur_features,
+                                const vector<digest_type>& new_features )
+                            {}
       );
+      if( added && my->journaling ) {
+         my->append_record( journal_record::add, fork_database_impl::pack_block_state( *n, *n->packed_block(), n->validated ) );
+      }
    }
 
    const block_state_ptr& fork_database::root()const { return my->root; }
@@ -369,6 +756,11 @@ namespace eosio { namespace chain {
    }
 
    block_state_ptr fork_database::search_on_branch( const block_id_type& h, uint32_t block_num )const {
+      const uint32_t h_num = block_header::num_from_id( h );
+      if( auto b = my->on_pending_branch( h_num ); b && b->id == h ) {
+         return block_num <= h_num ? my->on_pending_branch( block_num ) : block_state_ptr();
+      }
+
       for( auto s = get_block(h); s; s = get_block( s->header.previous ) ) {
          if( s->block_num == block_num )
              return s;
@@ -462,6 +854,8 @@ namespace eosio { namespace chain {
          if( itr != my->index.end() )
             my->index.erase(itr);
       }
+      my->update_pending_branch();
+      my->append( journal_record::remove, id );
    }
 
    void fork_database::mark_valid( const block_state_ptr& h ) {
@@ -482,6 +876,8 @@ namespace eosio { namespace chain {
       if( first_preferred( **candidate, *my->head ) ) {
          my->head = *candidate;
       }
+      my->update_pending_branch();
+      my->append( journal_record::mark_valid, h->id );
    }
 
    block_state_ptr   fork_database::get_block(const block_id_type& id)const {
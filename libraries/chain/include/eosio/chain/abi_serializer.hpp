@@ -2,8 +2,10 @@
 #include <eosio/chain/abi_def.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/key_string_cache.hpp>
 #include <fc/variant_object.hpp>
 #include <fc/scoped_exit.hpp>
+#include <deque>
 
 namespace eosio { namespace chain {
 
@@ -30,6 +32,10 @@ namespace impl {
 struct abi_serializer {
    abi_serializer(){ configure_built_in_types(); }
    abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time );
+   abi_serializer( const abi_serializer& other );
+   abi_serializer( abi_serializer&& other ) = default;
+   abi_serializer& operator=( const abi_serializer& other );
+   abi_serializer& operator=( abi_serializer&& other ) = default;
    void set_abi(const abi_def& abi, const fc::microseconds& max_serialization_time);
 
    /// @return string_view of `t` or internal string type
@@ -55,6 +61,14 @@ struct abi_serializer {
    fc::variant binary_to_variant( const std::string_view& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    fc::variant binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
+   /**
+    * Appends the JSON of binary unpacked as type to out without building an fc::variant tree in between. The result
+    * is the same as fc::json::to_string of binary_to_variant and the same max_serialization_time and recursion depth
+    * checks apply; out is left partially written if an exception is thrown.
+    */
+   void        binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, std::string& out, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+   std::string binary_to_json( const std::string_view& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+
    bytes       variant_to_binary( const std::string_view& type, const fc::variant& var, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    void        variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
@@ -88,6 +102,42 @@ struct abi_serializer {
 
    static const size_t max_recursion_depth = 32; // arbitrary depth to prevent infinite recursion
 
+   typedef void (*json_writer)( fc::datastream<const char*>&, std::string& );
+
+   /**
+    * A type of the ABI with its typedefs resolved and its kind, element types, struct fields and built-in
+    * pack/unpack functions looked up once by set_abi, so that (de)serialization can follow pointers instead of
+    * looking up type names for every field of every value. Encoders of other formats walk it too, see
+    * mongo_db_plugin.
+    */
+   struct compiled_type {
+      enum class kind_type : uint8_t { unknown, built_in, array, optional, variant, structure };
+
+      struct field {
+         const compiled_type* type      = nullptr;
+         bool                 extension = false;
+         string               json_key;  ///< quoted field name followed by ':'
+      };
+
+      kind_type                                                kind = kind_type::unknown;
+      type_name                                                name;        ///< type as referenced in the ABI
+      type_name                                                fundamental; ///< built-in type, without [] or ?
+      const pair<unpack_function, pack_function>*              built_in = nullptr;
+      json_writer                                              built_in_json = nullptr; ///< only for a non-array, non-optional built-in
+      bool                                                     built_in_array = false;
+      bool                                                     built_in_optional = false;
+      const compiled_type*                                     element = nullptr; ///< of array or optional
+      map<type_name, variant_def, std::less<>>::const_iterator variant_itr;
+      vector<const compiled_type*>                             variant_types;
+      map<type_name, struct_def, std::less<>>::const_iterator  struct_itr;
+      const compiled_type*                                     base = nullptr;
+      vector<field>                                            fields;
+      bool                                                     unique_fields = false; ///< no field name repeated, bases included
+   };
+
+   /// @return nullptr if type is not part of the ABI
+   const compiled_type* find_compiled_type( const std::string_view& type )const;
+
 private:
 
    map<type_name, type_name, std::less<>>     typedefs;
@@ -100,6 +150,27 @@ private:
    map<type_name, pair<unpack_function, pack_function>, std::less<>> built_in_types;
    void configure_built_in_types();
 
+   /// built-in types whose JSON binary_to_json writes directly, specialized built-ins are removed
+   map<type_name, json_writer, std::less<>> built_in_json_writers;
+
+   std::deque<compiled_type>                                  compiled_types;      ///< stable addresses
+   map<type_name, compiled_type*, std::less<>>                compiled_type_index;
+
+   void compile_types( impl::abi_traverse_context& ctx );
+   compiled_type* compile_type( const std::string_view& type, vector<compiled_type*>& pending );
+
+   fc::variant _binary_to_variant( const compiled_type& type, fc::datastream<const char*>& stream, impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_variant( const compiled_type& type, fc::datastream<const char*>& stream,
+                                   fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
+   void        _variant_to_binary( const compiled_type& type, const fc::variant& var,
+                                   fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
+
+   /// @return false if null was written
+   bool        _binary_to_json( const compiled_type& type, fc::datastream<const char*>& stream, std::string& out,
+                                impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_json_fields( const compiled_type& type, fc::datastream<const char*>& stream, std::string& out,
+                                       impl::binary_to_variant_context& ctx )const;
+
    fc::variant _binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
    void        _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& stream,
@@ -392,7 +463,7 @@ namespace impl {
 
          try {
             auto abi = resolver(act.account);
-            if (abi.valid()) {
+            if (abi) {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
                   try {
@@ -433,7 +504,7 @@ namespace impl {
          mutable_variant_object mvo;
          auto trx = ptrx.get_transaction();
          mvo("id", trx.id());
-         mvo("signatures", ptrx.get_signatures());
+         mvo("signatures", key_string_cache::instance().to_variants( ptrx.get_signatures() ));
          mvo("compression", ptrx.get_compression());
          mvo("packed_context_free_data", ptrx.get_packed_context_free_data());
          mvo("context_free_data", ptrx.get_context_free_data());
@@ -512,14 +583,15 @@ namespace impl {
             mvo("new_producer_schedule", new_producer_schedule);
          }
 
-         mvo("producer_signature", block.producer_signature);
+         mvo("producer_signature", key_string_cache::instance().to_string( block.producer_signature ));
          add(mvo, "transactions", block.transactions, resolver, ctx);
 
          // process contents of block.block_extensions
          auto block_exts = block.validate_and_extract_extensions();
          if ( block_exts.count(additional_block_signatures_extension::extension_id()) > 0) {
             const auto& additional_signatures = block_exts.lower_bound(additional_block_signatures_extension::extension_id())->second.get<additional_block_signatures_extension>();
-            mvo("additional_signatures", additional_signatures);
+            static_assert(fc::reflector<additional_block_signatures_extension>::total_member_count == 1);
+            mvo("additional_signatures", mutable_variant_object()("signatures", key_string_cache::instance().to_variants( additional_signatures.signatures )));
          }
 
          out(name, std::move(mvo));
@@ -642,7 +714,7 @@ namespace impl {
                valid_empty_data = act.data.empty();
             } else if ( data.is_object() ) {
                auto abi = resolver(act.account);
-               if (abi.valid()) {
+               if (abi) {
                   auto type = abi->get_action_type(act.name);
                   if (!type.empty()) {
                      variant_to_binary_context _ctx(*abi, ctx, type);
@@ -0,0 +1,59 @@
+#pragma once
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <memory>
+
+namespace chainbase {
+   class database;
+}
+
+namespace eosio { namespace chain {
+
+   namespace detail { struct abi_serializer_cache_impl; }
+
+   /**
+    * Bounded, thread safe, process wide cache of immutable abi_serializer instances built from the abi set on an
+    * account, keyed by (account, abi_sequence).
+    *
+    * API handlers and plugins otherwise unpack and validate the same abi, e.g. the one of eosio, on every request.
+    * The abi_sequence can repeat across forks and across chains in the same process, so the bytes of the abi the
+    * serializer was built from are compared on every hit as well. Least recently used entries are evicted first.
+    */
+   class abi_serializer_cache {
+      public:
+         using abi_serializer_ptr = std::shared_ptr<const abi_serializer>;
+
+         struct stats {
+            uint64_t hits     = 0;
+            uint64_t misses   = 0;
+            size_t   size     = 0;
+            size_t   capacity = 0;
+         };
+
+         static abi_serializer_cache& instance();
+
+         ~abi_serializer_cache();
+
+         /**
+          * @return serializer for the abi currently set on account in db, nullptr if the account does not exist or
+          * has no abi; throws if the abi is invalid
+          */
+         abi_serializer_ptr get( const chainbase::database& db, account_name account, const fc::microseconds& max_serialization_time );
+
+         /// a capacity of 0 disables the cache, shrinking evicts the least recently used entries
+         void set_capacity( size_t capacity );
+
+         stats get_stats()const;
+
+         /// removes all entries and resets the hit/miss counters
+         void clear();
+
+      private:
+         abi_serializer_cache();
+
+         std::unique_ptr<detail::abi_serializer_cache_impl> my;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::abi_serializer_cache::stats, (hits)(misses)(size)(capacity) )
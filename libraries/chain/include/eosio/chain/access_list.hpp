@@ -0,0 +1,117 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <fc/crypto/sha256.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace eosio { namespace chain {
+
+   struct access_list_stats {
+      uint64_t entries     = 0;
+      uint64_t checks      = 0; ///< lookups against the list
+      uint64_t prefiltered = 0; ///< lookups answered by the bloom filter without searching the entries
+      uint64_t matches     = 0; ///< lookups of values which are on the list
+   };
+
+   /// counters of the whitelists and blacklists enforced by the controller
+   struct whitelist_blacklist_stats {
+      access_list_stats actor_whitelist;
+      access_list_stats actor_blacklist;
+      access_list_stats contract_whitelist;
+      access_list_stats contract_blacklist;
+      access_list_stats action_blacklist;
+      access_list_stats key_blacklist;
+   };
+
+   namespace detail {
+      inline uint64_t access_list_mix( uint64_t h ) {
+         h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+         h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+         return h ^ (h >> 31);
+      }
+
+      inline uint64_t access_list_hash( const name& n ) {
+         return access_list_mix( n.to_uint64_t() );
+      }
+
+      inline uint64_t access_list_hash( const std::pair<name, name>& p ) {
+         return access_list_mix( p.first.to_uint64_t() ^ access_list_mix( p.second.to_uint64_t() ) );
+      }
+
+      inline uint64_t access_list_hash( const public_key_type& k ) {
+         return fc::sha256::hash( k )._hash[0];
+      }
+   }
+
+   /**
+    * Whitelist or blacklist compiled for the lookups done on every action. Values are first tested against a bloom
+    * filter of 16 bits per entry probed three times, which rejects almost every value not on the list without
+    * searching it; the others are confirmed by a binary search of the sorted entries.
+    *
+    * Lookups are counted, the counters restart when the list is replaced.
+    */
+   template<typename T>
+   class access_list {
+      public:
+         void reset( const flat_set<T>& entries ) {
+            _entries.assign( entries.begin(), entries.end() );
+            size_t num_bits = 64;
+            while( num_bits < entries.size() * 16 ) num_bits <<= 1;
+            _mask = num_bits - 1;
+            _bits.assign( num_bits / 64, 0 );
+            for( const auto& e : _entries ) {
+               const uint64_t h = detail::access_list_hash( e );
+               for( uint32_t i = 0; i < num_probes; ++i ) {
+                  const uint64_t bit = probe( h, i );
+                  _bits[bit / 64] |= uint64_t(1) << (bit % 64);
+               }
+            }
+            _checks = 0;
+            _prefiltered = 0;
+            _matches = 0;
+         }
+
+         bool empty()const { return _entries.empty(); }
+
+         bool contains( const T& v )const {
+            _checks.fetch_add( 1, std::memory_order_relaxed );
+            if( _entries.empty() ) return false;
+            const uint64_t h = detail::access_list_hash( v );
+            for( uint32_t i = 0; i < num_probes; ++i ) {
+               const uint64_t bit = probe( h, i );
+               if( !(_bits[bit / 64] & (uint64_t(1) << (bit % 64))) ) {
+                  _prefiltered.fetch_add( 1, std::memory_order_relaxed );
+                  return false;
+               }
+            }
+            if( !std::binary_search( _entries.begin(), _entries.end(), v ) ) return false;
+            _matches.fetch_add( 1, std::memory_order_relaxed );
+            return true;
+         }
+
+         access_list_stats get_stats()const {
+            return { _entries.size(), _checks.load( std::memory_order_relaxed ),
+                     _prefiltered.load( std::memory_order_relaxed ), _matches.load( std::memory_order_relaxed ) };
+         }
+
+      private:
+         static constexpr uint32_t num_probes = 3;
+
+         uint64_t probe( uint64_t h, uint32_t i )const {
+            return ( h + i * ((h >> 32) | 1) ) & _mask;
+         }
+
+         vector<T>                     _entries; ///< sorted
+         vector<uint64_t>              _bits;
+         uint64_t                      _mask = 0;
+         mutable std::atomic<uint64_t> _checks{0};
+         mutable std::atomic<uint64_t> _prefiltered{0};
+         mutable std::atomic<uint64_t> _matches{0};
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::access_list_stats, (entries)(checks)(prefiltered)(matches) )
+FC_REFLECT( eosio::chain::whitelist_blacklist_stats, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)
+            (action_blacklist)(key_blacklist) )
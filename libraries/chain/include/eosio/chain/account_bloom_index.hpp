@@ -0,0 +1,121 @@
+#pragma once
+#include <eosio/chain/block.hpp>
+#include <fc/filesystem.hpp>
+
+#include <limits>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    * On disk bloom filters of the accounts and action names of the blocks of a block log, one per range of
+    * blocks_per_range blocks, kept as accounts.bloom next to blocks.log, so that a scan of the log for the actions of
+    * an account reads only the ranges which may have them:
+    *
+    * +--------+-------------------+-------------------+-----+
+    * | Header | Filter of range 0 | Filter of range 1 | ... |
+    * +--------+-------------------+-------------------+-----+
+    *
+    * A filter holds the accounts of the actions, context free or not, of the transactions of its blocks and the
+    * accounts authorizing them, and apart from those the names of the actions. Actions of deferred transactions
+    * executed by id, inline actions and notified accounts are not in the blocks and so not in the filters.
+    *
+    * Filters only ever gain bits, blocks past a truncation of the log are left, lookups return candidate ranges which
+    * the caller checks against the blocks themselves, see touches().
+    *
+    * Thread safe.
+    */
+   class account_bloom_index {
+   public:
+      static constexpr uint32_t default_blocks_per_range = 10000;
+      static constexpr uint32_t default_filter_bytes = 128 * 1024;
+
+      /// bits of a filter, filled from a whole range by construct methods which build ranges on their own
+      class filter {
+      public:
+         explicit filter( uint32_t bytes ) : _bits( bytes ) {}
+
+         /// @return the offsets of the bytes which gained bits
+         vector<uint32_t> add( const signed_block& b );
+         bool may_match( const fc::optional<account_name>& account, const fc::optional<action_name>& action )const;
+
+         const vector<uint8_t>& bits()const { return _bits; }
+         vector<uint8_t>&       bits()      { return _bits; }
+
+      private:
+         vector<uint8_t> _bits;
+      };
+
+      /// opens file, creating it with the given layout if it does not exist
+      explicit account_bloom_index( const fc::path& file, uint32_t blocks_per_range = default_blocks_per_range,
+                                    uint32_t filter_bytes = default_filter_bytes );
+      ~account_bloom_index();
+
+      account_bloom_index( const account_bloom_index& ) = delete;
+      account_bloom_index& operator=( const account_bloom_index& ) = delete;
+
+      /// adds b to the filter of its range, then records b as the last block indexed
+      void add( const signed_block& b );
+
+      /// replaces the filter of range, which holds the blocks from first_block_of( range )
+      void write_range( uint32_t range, const filter& f );
+
+      /**
+       * @return the first and last blocks of the ranges overlapping [first, last] which may have an action of account,
+       *         authorized by account or named action, whichever are given, in block order. Blocks past the last block
+       *         indexed are returned whole.
+       */
+      vector<std::pair<uint32_t, uint32_t>> find( uint32_t first, uint32_t last, const fc::optional<account_name>& account,
+                                                  const fc::optional<action_name>& action )const;
+
+      uint32_t range_of( uint32_t block_num )const { return ( block_num - 1 ) / _header.blocks_per_range; }
+      uint32_t first_block_of( uint32_t range )const { return range * _header.blocks_per_range + 1; }
+      uint32_t blocks_per_range()const { return _header.blocks_per_range; }
+      uint32_t filter_bytes()const { return _header.filter_bytes; }
+
+      /// last block whose accounts were all added, 0 if none
+      uint32_t last_block_num()const;
+      void     set_last_block_num( uint32_t block_num );
+
+      /// removes every filter
+      void clear();
+
+      /// writes the header, filter bits are written as they are set
+      void flush();
+
+      const fc::path& file()const { return _file; }
+
+      /// whether b has an action of account, authorized by account or named action, whichever are given
+      static bool touches( const signed_block& b, const fc::optional<account_name>& account, const fc::optional<action_name>& action );
+
+   private:
+      struct header {
+         uint32_t magic = 0;
+         uint32_t version = 0;
+         uint32_t blocks_per_range = 0;
+         uint32_t filter_bytes = 0;
+         uint32_t last_block_num = 0;
+      };
+
+      static constexpr uint32_t magic_number = 0x4c424341; // "ACBL"
+      static constexpr uint32_t current_version = 1;
+
+      uint64_t range_pos( uint32_t range )const { return sizeof(header) + uint64_t(range) * _header.filter_bytes; }
+
+      void read( char* data, size_t size, uint64_t pos )const;
+      void write( const char* data, size_t size, uint64_t pos );
+      /// @pre _mtx is held, reads the filter of range, empty if it was never written
+      void read_range( uint32_t range, filter& f )const;
+      /// @pre _mtx is held
+      void write_header();
+
+      const fc::path        _file;
+      int                   _fd = -1;
+      mutable std::mutex    _mtx;
+      header                _header;
+      uint64_t              _size = 0;      ///< of the file
+      uint32_t              _current_range = std::numeric_limits<uint32_t>::max(); ///< of _current, none if max
+      filter                _current{0};    ///< filter of the range of the last block added
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <array>
+#include <map>
+#include <tuple>
+
+namespace eosio { namespace chain {
+
+   /// one (receiver, account, action) of an action_stats window
+   struct action_stats_row {
+      account_name receiver;
+      account_name account;
+      action_name  action;
+      uint64_t     count = 0;
+      uint64_t     failures = 0;
+      uint64_t     total_us = 0;
+      uint64_t     p50_us = 0;          ///< upper bound of the histogram bucket holding the median
+      uint64_t     p99_us = 0;
+      uint64_t     max_us = 0;
+      int64_t      ram_delta = 0;       ///< net RAM bytes charged by the executions
+      uint64_t     notifications = 0;   ///< require_recipient fan-out, counted where receiver == account
+   };
+
+   struct action_stats_window {
+      uint32_t                      first_block = 0;
+      uint32_t                      last_block = 0;
+      std::vector<action_stats_row> rows; ///< highest total_us first
+   };
+
+   /**
+    * Aggregates the executions of apply_context::exec_one, including speculative ones and failed attempts, per
+    * (receiver, account, action) over windows of a fixed number of blocks. The current window and the last completed
+    * one are kept. Only used from the main thread.
+    */
+   class action_stats {
+      public:
+         explicit action_stats( uint32_t window_blocks );
+
+         void record( account_name receiver, account_name account, action_name action,
+                      fc::microseconds elapsed, int64_t ram_delta, bool failed );
+         void record_notifications( account_name account, action_name action, uint32_t notifications );
+
+         /// starts a new window once window_blocks blocks have been accepted in the current one
+         void on_accepted_block( uint32_t block_num );
+
+         action_stats_window current( uint32_t limit )const;
+         action_stats_window completed( uint32_t limit )const;
+
+      private:
+         // bucket i counts executions of less than 2^i us, the last one everything longer
+         static constexpr size_t num_buckets = 24;
+
+         struct histogram {
+            uint64_t                           count = 0;
+            uint64_t                           failures = 0;
+            uint64_t                           total_us = 0;
+            uint64_t                           max_us = 0;
+            int64_t                            ram_delta = 0;
+            uint64_t                           notifications = 0;
+            std::array<uint32_t, num_buckets>  buckets{};
+
+            uint64_t percentile( double p )const;
+         };
+
+         using key_type = std::tuple<account_name, account_name, action_name>;
+
+         struct window {
+            uint32_t                       first_block = 0;
+            uint32_t                       last_block = 0;
+            std::map<key_type, histogram>  entries;
+         };
+
+         static action_stats_window to_rows( const window& w, uint32_t limit );
+
+         const uint32_t _window_blocks;
+         window         _current;
+         window         _completed;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::action_stats_row, (receiver)(account)(action)(count)(failures)(total_us)(p50_us)(p99_us)(max_us)
+                                            (ram_delta)(notifications) )
+FC_REFLECT( eosio::chain::action_stats_window, (first_block)(last_block)(rows) )
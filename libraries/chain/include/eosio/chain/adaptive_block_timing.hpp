@@ -0,0 +1,89 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+namespace eosio { namespace chain {
+
+/**
+ * Offset of the deadline of the last block of a round of production, adapted to how late the next producer would
+ * have it: the latency of the blocks of the next producer, from their timestamp to when this node had them validated,
+ * stands for the latency of our blocks to it. It is smoothed like a round trip time, as the mean plus four times the
+ * mean deviation, so that the occasional slow block moves it up quickly and slowly back down.
+ *
+ * The next producer building its first block on an earlier one of ours means it missed our last block, each such
+ * handoff adds a penalty which decays with the handoffs that succeed.
+ *
+ * The offset is kept within [min_offset_us, max_offset_us], a producer without measured blocks gets the static offset.
+ */
+class adaptive_block_timing {
+public:
+   static constexpr int64_t missed_handoff_penalty_us = 50'000;
+
+   void configure( bool enabled, int32_t min_offset_us, int32_t max_offset_us, uint32_t margin_us ) {
+      _enabled = enabled;
+      _min_offset_us = std::min( min_offset_us, max_offset_us );
+      _max_offset_us = std::max( min_offset_us, max_offset_us );
+      _margin_us = margin_us;
+   }
+
+   bool enabled()const { return _enabled; }
+
+   /// latency_us of a block of producer, from its timestamp to when it was validated
+   void record_latency( account_name producer, int64_t latency_us ) {
+      if( !_enabled ) return;
+      auto& e = _estimates[producer];
+      if( e.samples++ == 0 ) {
+         e.mean_us = latency_us;
+         e.deviation_us = std::abs( latency_us ) / 2;
+      } else {
+         e.deviation_us += ( std::abs( latency_us - e.mean_us ) - e.deviation_us ) / 4;
+         e.mean_us += ( latency_us - e.mean_us ) / 8;
+      }
+   }
+
+   /// whether the next producer built its first block on our last block of the round
+   void record_handoff( bool received ) {
+      if( !_enabled ) return;
+      if( received ) _penalty_us -= _penalty_us / 8;
+      else _penalty_us += missed_handoff_penalty_us;
+      _penalty_us = std::min<int64_t>( _penalty_us, int64_t(_max_offset_us) - _min_offset_us );
+   }
+
+   /// expected latency of our blocks to producer, empty if none of its blocks were measured
+   fc::optional<int64_t> latency_us( account_name producer )const {
+      auto itr = _estimates.find( producer );
+      if( itr == _estimates.end() ) return {};
+      return itr->second.mean_us + 4 * itr->second.deviation_us;
+   }
+
+   /// offset of the deadline of our last block of the round when next_producer produces after us
+   int32_t last_block_offset_us( account_name next_producer, int32_t static_offset_us )const {
+      if( !_enabled ) return static_offset_us;
+      const auto latency = latency_us( next_producer );
+      if( !latency ) return static_offset_us;
+      const int64_t offset = -( std::max<int64_t>( *latency, 0 ) + _margin_us + _penalty_us );
+      return std::clamp<int64_t>( offset, _min_offset_us, _max_offset_us );
+   }
+
+   int64_t penalty_us()const { return _penalty_us; }
+
+private:
+   struct estimate {
+      uint64_t samples = 0;
+      int64_t  mean_us = 0;
+      int64_t  deviation_us = 0;
+   };
+
+   bool                              _enabled = false;
+   int32_t                           _min_offset_us = 0;
+   int32_t                           _max_offset_us = 0;
+   uint32_t                          _margin_us = 0;
+   int64_t                           _penalty_us = 0;
+   std::map<account_name, estimate>  _estimates;
+};
+
+} } //eosio::chain
@@ -3,6 +3,7 @@
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <fc/utility.hpp>
+#include <boost/container/small_vector.hpp>
 #include <sstream>
 #include <algorithm>
 #include <set>
@@ -19,78 +20,130 @@ class apply_context {
       template<typename T>
       class iterator_cache {
          public:
-            iterator_cache(){
-               _end_iterator_to_table.reserve(8);
-               _iterator_to_object.reserve(32);
+            /// takes the containers a finished context of this thread left behind, so that their capacity is reused
+            iterator_cache() {
+               auto& spare = spare_storage();
+               if( !spare.empty() ) {
+                  _s = std::move( spare.back() );
+                  spare.pop_back();
+               } else {
+                  _s.table_cache.reserve(8);
+                  _s.end_iterator_to_table.reserve(8);
+                  _s.iterator_to_object.reserve(32);
+               }
             }
 
+            ~iterator_cache() {
+               auto& spare = spare_storage();
+               if( spare.size() < max_spare_storage ) {
+                  _s.clear();
+                  spare.push_back( std::move(_s) );
+               }
+            }
+
+            iterator_cache( const iterator_cache& ) = delete;
+            iterator_cache& operator=( const iterator_cache& ) = delete;
+
             /// Returns end iterator of the table.
             int cache_table( const table_id_object& tobj ) {
-               auto itr = _table_cache.find(tobj.id);
-               if( itr != _table_cache.end() )
+               auto itr = _s.table_cache.find(tobj.id);
+               if( itr != _s.table_cache.end() )
                   return itr->second.second;
 
-               auto ei = index_to_end_iterator(_end_iterator_to_table.size());
-               _end_iterator_to_table.push_back( &tobj );
-               _table_cache.emplace( tobj.id, make_pair(&tobj, ei) );
+               auto ei = index_to_end_iterator(_s.end_iterator_to_table.size());
+               _s.end_iterator_to_table.push_back( &tobj );
+               _s.table_cache.emplace( tobj.id, make_pair(&tobj, ei) );
                return ei;
             }
 
             const table_id_object& get_table( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
+               auto itr = _s.table_cache.find(i);
+               EOS_ASSERT( itr != _s.table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
                return *itr->second.first;
             }
 
             int get_end_iterator_by_table_id( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
+               auto itr = _s.table_cache.find(i);
+               EOS_ASSERT( itr != _s.table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
                return itr->second.second;
             }
 
             const table_id_object* find_table_by_end_iterator( int ei )const {
                EOS_ASSERT( ei < -1, invalid_table_iterator, "not an end iterator" );
                auto indx = end_iterator_to_index(ei);
-               if( indx >= _end_iterator_to_table.size() ) return nullptr;
-               return _end_iterator_to_table[indx];
+               if( indx >= _s.end_iterator_to_table.size() ) return nullptr;
+               return _s.end_iterator_to_table[indx];
             }
 
             const T& get( int iterator ) {
                EOS_ASSERT( iterator != -1, invalid_table_iterator, "invalid iterator" );
                EOS_ASSERT( iterator >= 0, table_operation_not_permitted, "dereference of end iterator" );
-               EOS_ASSERT( (size_t)iterator < _iterator_to_object.size(), invalid_table_iterator, "iterator out of range" );
-               auto result = _iterator_to_object[iterator];
+               EOS_ASSERT( (size_t)iterator < _s.iterator_to_object.size(), invalid_table_iterator, "iterator out of range" );
+               auto result = _s.iterator_to_object[iterator];
                EOS_ASSERT( result, table_operation_not_permitted, "dereference of deleted object" );
                return *result;
             }
 
+            /// Returns the iterator of the row with the given primary key of the table if that row has already been
+            /// handed out (and not removed), or -1. Saves the index search when the same row is looked up repeatedly.
+            int find_by_primary( table_id_object::id_type tid, uint64_t primary )const {
+               auto itr = _s.primary_to_iterator.find( std::make_pair(tid, primary) );
+               if( itr == _s.primary_to_iterator.end() ) return -1;
+               return itr->second;
+            }
+
+            /// Must be called before the object is removed from the database
             void remove( int iterator ) {
                EOS_ASSERT( iterator != -1, invalid_table_iterator, "invalid iterator" );
                EOS_ASSERT( iterator >= 0, table_operation_not_permitted, "cannot call remove on end iterators" );
-               EOS_ASSERT( (size_t)iterator < _iterator_to_object.size(), invalid_table_iterator, "iterator out of range" );
+               EOS_ASSERT( (size_t)iterator < _s.iterator_to_object.size(), invalid_table_iterator, "iterator out of range" );
 
-               auto obj_ptr = _iterator_to_object[iterator];
+               auto obj_ptr = _s.iterator_to_object[iterator];
                if( !obj_ptr ) return;
-               _iterator_to_object[iterator] = nullptr;
-               _object_to_iterator.erase( obj_ptr );
+               _s.iterator_to_object[iterator] = nullptr;
+               _s.object_to_iterator.erase( obj_ptr );
+               _s.primary_to_iterator.erase( std::make_pair(obj_ptr->t_id, obj_ptr->primary_key) );
             }
 
             int add( const T& obj ) {
-               auto itr = _object_to_iterator.find( &obj );
-               if( itr != _object_to_iterator.end() )
+               auto itr = _s.object_to_iterator.find( &obj );
+               if( itr != _s.object_to_iterator.end() )
                     return itr->second;
 
-               _iterator_to_object.push_back( &obj );
-               _object_to_iterator[&obj] = _iterator_to_object.size() - 1;
+               int i = _s.iterator_to_object.size();
+               _s.iterator_to_object.push_back( &obj );
+               _s.object_to_iterator[&obj] = i;
+               _s.primary_to_iterator[std::make_pair(obj.t_id, obj.primary_key)] = i;
 
-               return _iterator_to_object.size() - 1;
+               return i;
             }
 
          private:
-            map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
-            vector<const table_id_object*>                  _end_iterator_to_table;
-            vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            struct storage {
+               flat_map<table_id_object::id_type, pair<const table_id_object*, int>> table_cache;
+               vector<const table_id_object*>                  end_iterator_to_table;
+               vector<const T*>                                iterator_to_object;
+               map<const T*,int>                               object_to_iterator;
+               map<std::pair<table_id_object::id_type, uint64_t>, int> primary_to_iterator;
+
+               void clear() {
+                  table_cache.clear();
+                  end_iterator_to_table.clear();
+                  iterator_to_object.clear();
+                  object_to_iterator.clear();
+                  primary_to_iterator.clear();
+               }
+            };
+
+            /// contexts are alive at once only along the chain of inline actions being executed
+            static constexpr size_t max_spare_storage = 8;
+
+            static vector<storage>& spare_storage() {
+               static thread_local vector<storage> spare;
+               return spare;
+            }
+
+            storage _s;
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -176,7 +229,9 @@ class apply_context {
             int store( uint64_t scope, uint64_t table, const account_name& payer,
                        uint64_t id, secondary_key_proxy_const_type value )
             {
+               apply_phase_timer timer( context.db_write_ns );
                EOS_ASSERT( payer != account_name(), invalid_table_payer, "must specify a valid account to pay for new record" );
+               context.check_writable();
 
 //               context.require_write_lock( scope );
 
@@ -200,6 +255,8 @@ class apply_context {
             }
 
             void remove( int iterator ) {
+               apply_phase_timer timer( context.db_write_ns );
+               context.check_writable();
                const auto& obj = itr_cache.get( iterator );
                context.update_db_usage( obj.payer, -( config::billable_size_v<ObjectType> ) );
 
@@ -211,16 +268,17 @@ class apply_context {
                context.db.modify( table_obj, [&]( auto& t ) {
                   --t.count;
                });
+               itr_cache.remove( iterator );
                context.db.remove( obj );
 
                if (table_obj.count == 0) {
                   context.remove_table(table_obj);
                }
-
-               itr_cache.remove( iterator );
             }
 
             void update( int iterator, account_name payer, secondary_key_proxy_const_type secondary ) {
+               apply_phase_timer timer( context.db_write_ns );
+               context.check_writable();
                const auto& obj = itr_cache.get( iterator );
 
                const auto& table_obj = itr_cache.get_table( obj.t_id );
@@ -351,6 +409,12 @@ class apply_context {
 
                auto table_end_itr = itr_cache.cache_table( *tab );
 
+               int cached = itr_cache.find_by_primary( tab->id, primary );
+               if( cached >= 0 ) {
+                  secondary_key_helper_t::get(secondary, itr_cache.get( cached ).secondary_key);
+                  return cached;
+               }
+
                const auto* obj = context.db.find<ObjectType, by_primary>( boost::make_tuple( tab->id, primary ) );
                if( !obj ) return table_end_itr;
                secondary_key_helper_t::get(secondary, obj->secondary_key);
@@ -455,12 +519,18 @@ class apply_context {
 
       void exec_one();
       void exec();
+      /// runs the code of a context-free action ahead of exec_one() on a thread other than the main thread, which
+      /// waits for it meanwhile; returns the console output, exec_one() of the action takes it instead of running it
+      std::string exec_context_free_concurrently( wasm_instantiated_module_interface& module );
       void execute_inline( action&& a );
       void execute_context_free_inline( action&& a );
       void schedule_deferred_transaction( const uint128_t& sender_id, account_name payer, transaction&& trx, bool replace_existing );
       bool cancel_deferred_transaction( const uint128_t& sender_id, account_name sender );
       bool cancel_deferred_transaction( const uint128_t& sender_id ) { return cancel_deferred_transaction(sender_id, receiver); }
 
+      /// throws if the action is part of a read-only transaction
+      void check_writable()const;
+
    protected:
       uint32_t schedule_action( uint32_t ordinal_of_action_to_schedule, account_name receiver, bool context_free );
       uint32_t schedule_action( action&& act_to_schedule, account_name receiver, bool context_free );
@@ -545,6 +615,7 @@ class apply_context {
 
       void add_ram_usage( account_name account, int64_t ram_delta );
       void finalize_trace( action_trace& trace, const fc::time_point& start );
+      void record_stats( const action_trace& trace, bool failed );
 
       bool is_context_free()const { return context_free; }
       bool is_privileged()const { return privileged; }
@@ -559,6 +630,7 @@ class apply_context {
       controller&                   control;
       chainbase::database&          db;  ///< database where state is stored
       transaction_context&          trx_context; ///< transaction context in which the action is running
+      uint64_t*                     db_write_ns = nullptr; ///< apply_phase_stats::db_write_ns, set with config::apply_phase_timing
 
    private:
       const action*                 act = nullptr; ///< action being applied
@@ -580,9 +652,13 @@ class apply_context {
    private:
 
       iterator_cache<key_value_object>    keyval_cache;
-      vector< std::pair<account_name, uint32_t> > _notified; ///< keeps track of new accounts to be notifed of current message
-      vector<uint32_t>                    _inline_actions; ///< action_ordinals of queued inline actions
-      vector<uint32_t>                    _cfa_inline_actions; ///< action_ordinals of queued inline context-free actions
+      /// table_id_object lookups of this context, including misses; kept in sync by find_or_create_table and remove_table
+      map<std::tuple<name, name, name>, const table_id_object*> _table_lookup_cache;
+      /// most actions notify and send a handful of accounts/actions, so these are kept inline and one apply_context per
+      /// action does not cost a heap allocation each
+      boost::container::small_vector< std::pair<account_name, uint32_t>, 4 > _notified; ///< keeps track of new accounts to be notifed of current message
+      boost::container::small_vector<uint32_t, 4>  _inline_actions; ///< action_ordinals of queued inline actions
+      boost::container::small_vector<uint32_t, 2>  _cfa_inline_actions; ///< action_ordinals of queued inline context-free actions
       std::string                         _pending_console_output;
       flat_set<account_delta>             _account_ram_deltas; ///< flat_set of account_delta so json is an array of objects
 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <chrono>
+#include <cstdint>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Cumulative time the main thread spends in each phase of applying blocks and transactions. wasm_ns includes the
+    * db_write_ns of the intrinsics called from contracts. Only used from the main thread.
+    */
+   struct apply_phase_stats {
+      uint64_t blocks = 0;
+      uint64_t transactions = 0;
+      uint64_t recover_keys_ns = 0;        ///< waiting for signature recovery started ahead of the transaction
+      uint64_t authorization_ns = 0;
+      uint64_t wasm_ns = 0;
+      uint64_t db_write_ns = 0;            ///< table row creation, modification and removal
+      uint64_t finalize_block_ns = 0;
+      uint64_t commit_block_ns = 0;
+   };
+
+   /// adds its lifetime to *total; does not read the clock when total is null
+   class apply_phase_timer {
+      public:
+         explicit apply_phase_timer( uint64_t* total )
+         :_total( total )
+         {
+            if( _total )
+               _start = std::chrono::steady_clock::now();
+         }
+
+         ~apply_phase_timer() {
+            if( _total )
+               *_total += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _start ).count();
+         }
+
+         apply_phase_timer( const apply_phase_timer& ) = delete;
+         apply_phase_timer& operator=( const apply_phase_timer& ) = delete;
+
+      private:
+         uint64_t*                             _total;
+         std::chrono::steady_clock::time_point _start;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::apply_phase_stats, (blocks)(transactions)(recover_keys_ns)(authorization_ns)(wasm_ns)(db_write_ns)
+                                             (finalize_block_ns)(commit_block_ns) )
@@ -34,8 +34,13 @@ struct asset : fc::reflect_init
    const symbol& get_symbol() const { return sym; }
    share_type get_amount()const { return amount; }
 
+   /// "-4611686018427387903 ABCDEFG", or with up to 18 decimals "-4.611686018427387903 ABCDEFG"
+   static constexpr size_t max_string_length = 1 + 19 + 1 + 1 + symbol::max_name_length;
+
    static asset from_string(const string& from);
    string       to_string()const;
+   /// writes to_string() at buf, which must have room for max_string_length, and returns the end of it
+   char*        to_chars( char* buf )const;
 
    asset& operator += (const asset& o)
    {
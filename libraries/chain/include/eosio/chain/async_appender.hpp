@@ -0,0 +1,50 @@
+#pragma once
+#include <eosio/chain/mpsc_ring.hpp>
+#include <fc/log/appender.hpp>
+#include <fc/log/log_message.hpp>
+#include <fc/variant.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Appender which hands log messages to a background thread that formats and writes them through a wrapped
+    * console or gelf appender, so the logging thread only pays for building the log_message.
+    *
+    * Messages go through a bounded lock-free ring; when it is full the message is dropped and counted, and the
+    * number of dropped messages is reported through the wrapped appender once there is room again.
+    *
+    * Configured in logging.json with type "async" and args
+    *    { "type": "console" | "gelf", "args": { <args of the wrapped appender> }, "capacity": 65536 }
+    */
+   class async_appender : public fc::appender {
+   public:
+      explicit async_appender( const fc::variant& args );
+      ~async_appender();
+
+      void initialize( boost::asio::io_service& io_service ) override;
+      void log( const fc::log_message& m ) override;
+
+      uint64_t dropped()const { return _dropped; }
+
+   private:
+      void run();
+
+      std::unique_ptr<fc::appender>                 _target;
+      std::unique_ptr<mpsc_ring<fc::log_message>>   _ring;
+      std::atomic<uint64_t>                         _dropped{0};
+      uint64_t                                      _dropped_reported = 0;
+
+      std::mutex                                    _mtx;
+      std::condition_variable                       _cv;
+      std::atomic<bool>                             _sleeping{false};
+      std::atomic<bool>                             _stopping{false};
+      std::thread                                   _thread;
+   };
+
+} } // eosio::chain
@@ -0,0 +1,75 @@
+#pragma once
+#include <boost/signals2/connection.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Runs handlers of controller signals on a thread of its own instead of the thread emitting the signal, so that the
+    * cost of a plugin's handlers is no longer part of block processing time.
+    *
+    * Each signal is handed a copy of its payload, e.g. a block_state_ptr, or a transaction_trace_ptr and a copy of
+    * the signed_transaction for applied_transaction, and handlers see the signals in the order they were emitted.
+    * Handlers must therefore not read chain state, which has moved on by the time they run. At most max_queued
+    * signals wait to be handled, emitting one more blocks the emitting thread until there is room.
+    *
+    * Exceptions thrown by handlers are logged and dropped, like those of handlers run by the controller.
+    */
+   class async_signal_consumer {
+   public:
+      async_signal_consumer( std::string name, size_t max_queued );
+
+      /// disconnects from every signal, then handles the signals still queued
+      ~async_signal_consumer();
+
+      /**
+       * Connects handler, called with a Payload built from the arguments of the signal, to signal.
+       * The connection ends with this consumer.
+       */
+      template<typename Payload, typename Signal>
+      void connect( Signal& signal, std::function<void(const Payload&)> handler ) {
+         connect<Payload>( signal, []( const auto&... args ) { return Payload( args... ); }, std::move(handler) );
+      }
+
+      /// as above, with the Payload returned by snapshot, called with the arguments of the signal on the emitting thread
+      template<typename Payload, typename Signal, typename Snapshot>
+      void connect( Signal& signal, Snapshot snapshot, std::function<void(const Payload&)> handler ) {
+         std::lock_guard<std::mutex> g( _mtx );
+         _connections.emplace_back( signal.connect( [this, snapshot, handler]( const auto&... args ) {
+            post( [handler, payload = Payload( snapshot( args... ) )]() { handler( payload ); } );
+         } ) );
+      }
+
+      /// returns once every signal emitted before is handled
+      void wait();
+
+      const std::string& name()const { return _name; }
+      size_t queued()const;
+      uint64_t handled()const { return _handled; }
+
+   private:
+      void post( std::function<void()> f );
+      void run();
+
+      const std::string                               _name;
+      const size_t                                    _max_queued;
+      mutable std::mutex                              _mtx;
+      std::condition_variable                         _queued_cv;   ///< signaled when a signal is queued or on stop
+      std::condition_variable                         _handled_cv;  ///< signaled when a signal is handled
+      std::deque<std::function<void()>>               _queue;
+      uint64_t                                        _posted = 0;  ///< protected by _mtx
+      std::atomic<uint64_t>                           _handled{0};
+      bool                                            _stopping = false;
+      std::vector<boost::signals2::scoped_connection> _connections;
+      std::thread                                     _thread;
+   };
+
+} } // eosio::chain
@@ -118,6 +118,38 @@ namespace detail {
             return satisfied( authority, *cached_perms, 0 );
          }
 
+         /**
+          * Same as satisfied( permission, override_provided_delay ) but also reports the keys that satisfied the
+          * permission, regardless of which keys were already used by previous calls. Marking exactly those keys
+          * with mark_keys_used reproduces the effect of a successful call.
+          */
+         bool satisfied_with_used_keys( const permission_level& permission,
+                                        fc::microseconds override_provided_delay,
+                                        flat_set<public_key_type>& keys_used )
+         {
+            auto prior_used_keys = std::move( _used_keys );
+            _used_keys.assign( provided_keys.size(), false );
+            auto used_keys_merger = fc::make_scoped_exit( [this, &prior_used_keys] () {
+               for( size_t i = 0; i < _used_keys.size(); ++i )
+                  _used_keys[i] = _used_keys[i] || prior_used_keys[i];
+            });
+
+            if( !satisfied( permission, override_provided_delay ) )
+               return false;
+
+            keys_used = used_keys();
+            return true;
+         }
+
+         /// marks provided keys as used, keys which were not provided are ignored
+         void mark_keys_used( const flat_set<public_key_type>& keys ) {
+            for( const auto& k : keys ) {
+               auto itr = boost::find( provided_keys, k );
+               if( itr != provided_keys.end() )
+                  _used_keys[itr - provided_keys.begin()] = true;
+            }
+         }
+
          bool all_keys_used() const { return boost::algorithm::all_of_equal(_used_keys, true); }
 
          flat_set<public_key_type> used_keys() const {
@@ -111,13 +111,53 @@ namespace eosio { namespace chain {
                                                       fc::microseconds provided_delay = fc::microseconds(0)
                                                     )const;
 
+         /// the keys of candidate_keys needed to satisfy the authorizations declared by the actions of a transaction
+         flat_set<public_key_type> get_required_keys( const vector<permission_level>& declared_auths,
+                                                      const flat_set<public_key_type>& candidate_keys,
+                                                      fc::microseconds provided_delay = fc::microseconds(0)
+                                                    )const;
+
+
+         /**
+          *  @brief Discard cached authority checks that may depend on permission changes made in the given block or later
+          *
+          *  Must be called whenever the state changes of those blocks are undone, e.g. when a pending block is aborted
+          *  or a block is popped during a fork switch.
+          */
+         void discard_cached_authorities( uint32_t from_block_num );
 
          static std::function<void()> _noop_checktime;
 
+         /// maximum number of satisfied authority checks retained, the cache is cleared once it is exceeded
+         static constexpr size_t max_cached_authorities = 10000;
+
       private:
          const controller&    _control;
          chainbase::database& _db;
 
+         /**
+          *  A permission satisfied by a set of keys under a delay. The result only depends on the permission objects
+          *  reachable from the permission, which is why checks that ran into a missing permission are not cached
+          *  and why modifying or removing any permission clears the cache.
+          */
+         struct authority_cache_key {
+            permission_level           permission;
+            fc::microseconds           delay;
+            uint16_t                   max_depth = 0;
+            flat_set<public_key_type>  keys;
+
+            friend bool operator<( const authority_cache_key& a, const authority_cache_key& b ) {
+               return std::tie( a.permission, a.delay, a.max_depth, a.keys ) < std::tie( b.permission, b.delay, b.max_depth, b.keys );
+            }
+         };
+
+         /// maps to the subset of keys that satisfied the permission
+         mutable map<authority_cache_key, flat_set<public_key_type>> _satisfied_authorities;
+         /// block of the most recent permission change, cached checks after it are only valid while it is not undone
+         uint32_t                                                     _last_permission_change_block_num = 0;
+
+         void             on_permission_changed( bool clear_cache );
+
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
          void             check_linkauth_authorization( const linkauth& link, const vector<permission_level>& auths )const;
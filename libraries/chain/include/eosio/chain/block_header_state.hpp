@@ -3,6 +3,7 @@
 #include <eosio/chain/incremental_merkle.hpp>
 #include <eosio/chain/protocol_feature_manager.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
+#include <eosio/chain/copy_on_write.hpp>
 #include <future>
 
 namespace eosio { namespace chain {
@@ -48,11 +49,14 @@ using signer_callback_type = std::function<std::vector<signature_type>(const dig
 struct block_header_state;
 
 namespace detail {
+   /// producer schedules only change on promotion or proposal, consecutive states share them instead of copying
+   using shared_schedule = copy_on_write<producer_authority_schedule>;
+
    struct block_header_state_common {
       uint32_t                          block_num = 0;
       uint32_t                          dpos_proposed_irreversible_blocknum = 0;
       uint32_t                          dpos_irreversible_blocknum = 0;
-      producer_authority_schedule       active_schedule;
+      shared_schedule                   active_schedule;
       incremental_merkle                blockroot_merkle;
       flat_map<account_name,uint32_t>   producer_to_last_produced;
       flat_map<account_name,uint32_t>   producer_to_last_implied_irb;
@@ -63,7 +67,7 @@ namespace detail {
    struct schedule_info {
       uint32_t                          schedule_lib_num = 0; /// last irr block num
       digest_type                       schedule_hash;
-      producer_authority_schedule       schedule;
+      shared_schedule                   schedule;
    };
 
    bool is_builtin_activated( const protocol_feature_activation_set_ptr& pfa,
@@ -143,7 +147,7 @@ struct block_header_state : public detail::block_header_state_common {
                                                         const vector<digest_type>& )>& validator,
                               bool skip_validate_signee = false )const;
 
-   bool                 has_pending_producers()const { return pending_schedule.schedule.producers.size(); }
+   bool                 has_pending_producers()const { return pending_schedule.schedule->producers.size(); }
    uint32_t             calc_dpos_last_irreversible( account_name producer_of_next_block )const;
 
    producer_authority     get_scheduled_producer( block_timestamp_type t )const;
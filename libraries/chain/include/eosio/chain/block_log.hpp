@@ -2,6 +2,8 @@
 #include <fc/filesystem.hpp>
 #include <eosio/chain/block.hpp>
 #include <eosio/chain/genesis_state.hpp>
+#include <boost/asio/io_context.hpp>
+#include <functional>
 
 namespace eosio { namespace chain {
 
@@ -30,15 +32,60 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Starting with the compressed version of the log each block is stored as its own zlib stream, preceded by
+    * the block number and the size of the compressed data, so that blocks stay individually addressable:
+    *
+    * +-----------+-----------------+---------------------------+----------------+
+    * | Block Num | Compressed Size | zlib(packed signed_block) | Pos of Block   |
+    * +-----------+-----------------+---------------------------+----------------+
+    *
+    * The positions and the index file are unchanged, so random access remains a single index lookup.
+    *
+    * A block log can be split into partitions of a fixed number of blocks, see block_log_partition_config. When
+    * the last block of a partition is appended, blocks.log and blocks.index are moved to the retained directory as
+    * blocks-<first>-<last>.log and blocks-<first>-<last>.index, and a new blocks.log starting at the next block
+    * is created. Blocks of retained partitions are still read through the block log.
+    *
+    * Reading blocks by number or position uses positional reads of separate file descriptors, from any thread while
+    * the owning thread appends blocks, a block becomes readable once it is flushed with its index entry. Everything
+    * else, appending, resetting and head(), is for the owning thread only.
     */
 
+   /// settings of a block log split into partitions, the default keeps a single growing blocks.log
+   struct block_log_partition_config {
+      uint32_t stride              = 0;   ///< last block number of every partition is a multiple of it, 0 disables partitions
+      uint16_t max_retained_files  = 10;  ///< completed partitions kept in retained_dir
+      fc::path retained_dir;              ///< completed partitions, relative to the blocks dir, the blocks dir itself when empty
+      fc::path archive_dir;               ///< partitions beyond max_retained_files are moved here, relative to the blocks dir, or removed when empty
+   };
+
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         /**
+          * @param compress_new_log  a log created by reset() uses the compressed format, an existing log
+          *                          keeps the format it was written with
+          */
+         block_log(const fc::path& data_dir, bool compress_new_log = false,
+                   const block_log_partition_config& partitions = block_log_partition_config());
          block_log(block_log&& other);
          ~block_log();
 
          uint64_t append(const signed_block_ptr& b);
+
+         /**
+          * Appends b on the block log's writer thread. head() is b right away and the read_* functions return b while
+          * it is queued. A failed write is thrown by the next append or flush, the blocks queued after it are lost.
+          * @param packed  b as packed by fc::raw::pack if it was packed already, written as is to an uncompressed log
+          */
+         void append_async(const signed_block_ptr& b, std::shared_ptr<const std::vector<char>> packed = {});
+
+         /**
+          * Starts compressing b on the block log's worker thread so that a later append(b) only has to write it.
+          * Does nothing if the log is not compressed.
+          */
+         void prepare_append(const signed_block_ptr& b);
+         /// waits for the blocks of append_async to be written, then flushes the files
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block );
          void reset( const chain_id_type& chain_id, uint32_t first_block_num );
@@ -47,23 +94,64 @@ namespace eosio { namespace chain {
          void             read_block_header(block_header& bh, uint64_t file_pos)const;
          signed_block_ptr read_block_by_num(uint32_t block_num)const;
          block_id_type    read_block_id_by_num(uint32_t block_num)const;
+
+         /**
+          * @return the block as packed by fc::raw::pack, copied from the log without deserializing it,
+          *         or an empty vector if the block is not in the log
+          */
+         std::vector<char> read_serialized_block_by_num(uint32_t block_num)const;
          signed_block_ptr read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
 
          /**
-          * Return offset of block in file, or block_log::npos if it does not exist.
+          * Keeps trx.index in the blocks dir up to date with the blocks appended, see trx_block_index, first adding
+          * the blocks appended while it was not kept.
+          */
+         void open_trx_index();
+         bool has_trx_index()const;
+
+         /**
+          * @return the numbers of the blocks, queued or in the log, which may include the transaction id, the most
+          *         recent first, empty without open_trx_index(). Thread safe.
+          */
+         vector<uint32_t> find_trx_block_nums(const transaction_id_type& id)const;
+
+         /**
+          * Keeps accounts.bloom in the blocks dir up to date with the blocks appended, see account_bloom_index, first
+          * adding the blocks appended while it was not kept.
+          */
+         void open_account_index();
+         bool has_account_index()const;
+
+         /**
+          * @return the first and last blocks of the parts of [first, last] which may have an action of account,
+          *         authorized by account or named action, whichever are given, in block order, [first, last] whole
+          *         without open_account_index(). Blocks are checked with account_bloom_index::touches(). Thread safe.
+          */
+         vector<std::pair<uint32_t, uint32_t>> find_account_block_ranges(uint32_t first, uint32_t last,
+                                                                         const fc::optional<account_name>& account,
+                                                                         const fc::optional<action_name>& action)const;
+
+         /**
+          * Return offset of block in blocks.log, or block_log::npos if it does not exist there.
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
          const block_id_type&    head_id()const;
+         /// first block that can be read, including retained partitions
          uint32_t                first_block_num() const;
+         /// first block of blocks.log itself
+         uint32_t                log_first_block_num() const;
+         uint32_t                version() const;
+         bool                    is_compressed() const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
          static const uint32_t min_supported_version;
          static const uint32_t max_supported_version;
+         static const uint32_t compressed_version;
 
          static fc::path repair_log( const fc::path& data_dir, uint32_t truncate_at_block = 0 );
 
@@ -71,7 +159,14 @@ namespace eosio { namespace chain {
 
          static chain_id_type extract_chain_id( const fc::path& data_dir );
 
-         static void construct_index(const fc::path& block_file_name, const fc::path& index_file_name);
+         /// with threads > 1 regions of the log are indexed in parallel, falling back to a single backwards pass
+         static void construct_index(const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads = 1);
+
+         /// writes index_file, a trx.index of the blocks of the log in data_dir, reading the blocks on threads threads
+         static void construct_trx_index(const fc::path& data_dir, const fc::path& index_file, uint32_t threads = 1);
+
+         /// writes index_file, an accounts.bloom of the blocks of the log in data_dir, filling ranges on threads threads
+         static void construct_account_index(const fc::path& data_dir, const fc::path& index_file, uint32_t threads = 1);
 
          static bool contains_genesis_state(uint32_t version, uint32_t first_block_num);
 
@@ -79,20 +174,69 @@ namespace eosio { namespace chain {
 
          static bool is_supported_version(uint32_t version);
 
+         static bool is_compressed_version(uint32_t version);
+
          static bool trim_blocklog_front(const fc::path& block_dir, const fc::path& temp_dir, uint32_t truncate_at_block);
 
+         /**
+          * Writes a copy of the block log in data_dir to output_dir, converting it to the compressed format or back.
+          * output_dir must not already contain a block log.
+          */
+         static void convert_log(const fc::path& data_dir, const fc::path& output_dir, bool compress);
+
    private:
+         friend class detail::block_log_impl;
+
+         /// read access to a retained partition
+         block_log(const fc::path& block_file_name, const fc::path& index_file_name);
+
          void open(const fc::path& data_dir);
+         void open(const fc::path& block_file_name, const fc::path& index_file_name);
          void construct_index();
 
          std::unique_ptr<detail::block_log_impl> my;
    };
 
+   namespace detail { class block_log_prefetcher_impl; }
+
+   /**
+    * Reads a contiguous range of blocks from blocks.log ahead of the consumer. A dedicated thread reads the raw
+    * block bytes sequentially using the index file for block boundaries, the blocks are deserialized on the
+    * provided thread pool and handed out in order through a bounded queue.
+    *
+    * The prefetcher opens its own read-only handles to the files, the block_log it reads from must not be
+    * written to while the prefetcher is alive.
+    */
+   class block_log_prefetcher {
+      public:
+         /// called on a thread pool thread for every deserialized block
+         using decoded_callback = std::function<void(const signed_block_ptr&)>;
+
+         block_log_prefetcher( const fc::path& data_dir, uint32_t log_first_block_num,
+                               uint32_t first_block_num, uint32_t last_block_num, size_t max_queued_blocks,
+                               boost::asio::io_context& thread_pool, decoded_callback cb = decoded_callback() );
+         ~block_log_prefetcher();
+
+         /**
+          * Blocks until the next block of the range is available.
+          * @return next block in order, or nullptr once the range is exhausted
+          * @throws errors encountered while reading or deserializing the block
+          */
+         signed_block_ptr next();
+
+         /// stop reading ahead and join the reader thread, called by the destructor
+         void stop();
+
+      private:
+         std::unique_ptr<detail::block_log_prefetcher_impl> my;
+   };
+
 //to derive blknum_offset==14 see block_header.hpp and note on disk struct is packed
 //   block_timestamp_type timestamp;                  //bytes 0:3
 //   account_name         producer;                   //bytes 4:11
 //   uint16_t             confirmed;                  //bytes 12:13
 //   block_id_type        previous;                   //bytes 14:45, low 4 bytes is big endian block number of previous block
+//compressed entries instead start with their own block number, little endian, see block_log above
 
    struct trim_data {            //used by trim_blocklog_front(), trim_blocklog_end(), and smoke_test()
       trim_data(fc::path block_dir);
@@ -109,6 +253,13 @@ namespace eosio { namespace chain {
       uint64_t first_block_pos = 0;                      //file position in blocks.log for the first block in the log
       chain_id_type chain_id;
 
-      static constexpr int blknum_offset{14};            //offset from start of block to 4 byte block number, valid for the only allowed versions
+      static constexpr int blknum_offset{14};            //offset from start of block to 4 byte block number, valid for uncompressed versions
+      static constexpr int compressed_blknum_offset{0};  //offset from start of a compressed entry to its 4 byte block number
+
+      static int blknum_offset_for(uint32_t version);
+      //block number of the entry given the 4 bytes read at blknum_offset_for(version)
+      static uint32_t block_num_from_raw(uint32_t raw, uint32_t version);
+      //block number of the entry at pos in blocks.log
+      uint32_t read_block_num(uint64_t pos);
    };
 } }
@@ -4,9 +4,17 @@
 #include <eosio/chain/block.hpp>
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/action_receipt.hpp>
+#include <eosio/chain/trace.hpp>
+
+#include <atomic>
 
 namespace eosio { namespace chain {
 
+   struct state_delta;
+
+   /// a trace emitted by applied_transaction with the transaction it was emitted for
+   using applied_transaction_trace = std::pair<transaction_trace_ptr, packed_transaction_ptr>;
+
    struct block_state : public block_header_state {
       block_state( const block_header_state& prev,
                    signed_block_ptr b,
@@ -32,6 +40,14 @@ namespace eosio { namespace chain {
 
       signed_block_ptr                                    block;
 
+      /**
+       * block as packed by fc::raw::pack, packed on first use and then shared by the fork database, the block log
+       * and the peers it is sent to. Thread safe, the block must not change once it is packed.
+       */
+      std::shared_ptr<const std::vector<char>> packed_block()const;
+      /// packed_block() if it was packed already, nullptr otherwise
+      std::shared_ptr<const std::vector<char>> cached_packed_block()const { return std::atomic_load( &_packed_block ); }
+
    private: // internal use only, not thread safe
       friend struct fc::reflector<block_state>;
       friend bool block_state_is_valid( const block_state& ); // work-around for multi-index access
@@ -62,6 +78,14 @@ namespace eosio { namespace chain {
       /// this data is redundant with the data stored in block, but facilitates
       /// recapturing transactions when we pop a block
       vector<transaction_metadata_ptr>                    _cached_trxs;
+
+      /// changes this block made to chainbase when it was validated, replayed instead of the block on a fork switch
+      std::shared_ptr<const state_delta>                  _state_delta;
+      /// traces of the transactions of this block in the order they were applied, emitted again when _state_delta is replayed
+      std::shared_ptr<const vector<applied_transaction_trace>> _state_delta_traces;
+
+      /// accessed atomically, of threads packing it at once the first to store it wins
+      mutable std::shared_ptr<const std::vector<char>>    _packed_block;
    };
 
    using block_state_ptr = std::shared_ptr<block_state>;
@@ -10,11 +10,11 @@ typedef __uint128_t uint128_t;
 
 const static auto default_blocks_dir_name    = "blocks";
 const static auto reversible_blocks_dir_name = "reversible";
-const static auto default_reversible_cache_size = 340*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
-const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
+const static auto reversible_blocks_log_filename = "reversible_blocks.log";
 
 const static auto default_state_dir_name     = "state";
 const static auto forkdb_filename            = "fork_db.dat";
+const static auto forkdb_journal_filename    = "fork_db.log";
 const static auto default_state_size            = 1*1024*1024*1024ll;
 const static auto default_state_guard_size      =    128*1024*1024ll;
 
@@ -80,6 +80,11 @@ const static uint16_t   default_max_inline_action_depth        = 4;
 const static uint16_t   default_max_auth_depth                 = 6;
 const static uint32_t   default_sig_cpu_bill_pct               = 50 * percent_1; // billable percentage of signature recovery
 const static uint16_t   default_controller_thread_pool_size    = 2;
+const static uint32_t   default_max_prefetched_blocks          = 128;
+const static uint32_t   irreversible_min_step_blocks           = 2; ///< blocks committed per block once irreversible, more than the one a block adds to the backlog
+const static uint32_t   default_sig_recovery_cache_size        = 100000; // entries in the recovered public key cache
+const static uint32_t   default_abi_serializer_cache_size      = 1024;   // entries in the abi serializer cache
+const static uint32_t   default_key_string_cache_size          = 8192;   // base58 strings of public keys, and of signatures, cached
 const static uint32_t   default_max_variable_signature_length  = 16384u;
 
 const static uint32_t   min_net_usage_delta_between_base_and_max_for_trx  = 10*1024;
@@ -96,6 +101,9 @@ const static uint32_t   setcode_ram_bytes_multiplier       = 10;     ///< multip
 const static uint32_t   hashing_checktime_block_size       = 10*1024;  /// call checktime from hashing intrinsic once per this number of bytes
 
 const static eosio::chain::wasm_interface::vm_type default_wasm_runtime = eosio::chain::wasm_interface::vm_type::wabt;
+const static uint32_t   default_wasm_preinstantiate_codes  = 64; ///< most recently used contracts instantiated in the background at startup
+const static uint64_t   default_wasm_cache_size            = 0;  ///< estimated bytes of instantiated contracts kept, 0 is unbounded
+const static uint32_t   default_contract_row_hash_reserve  = 1024*1024; ///< contract table rows stored without rehashing their by_table_primary index
 const static uint32_t   default_abi_serializer_max_time_ms = 15*1000; ///< default deadline for abi serialization methods
 
 /**
@@ -44,6 +44,7 @@ namespace eosio { namespace chain {
    using table_id = table_id_object::id_type;
 
    struct by_scope_primary;
+   struct by_table_primary;
    struct by_scope_secondary;
    struct by_scope_tertiary;
 
@@ -61,6 +62,15 @@ namespace eosio { namespace chain {
       shared_blob           value;
    };
 
+   struct table_id_hash {
+      size_t operator()( const table_id& t )const { return std::hash<int64_t>()( t._id ); }
+   };
+
+   /**
+    * by_table_primary holds the same keys as by_scope_primary in a hash table, for finding a row by its exact key
+    * without walking the tree. Its order of iteration depends on the hash and must never be relied upon, iterate
+    * by_scope_primary instead.
+    */
    using key_value_index = chainbase::shared_multi_index_container<
       key_value_object,
       indexed_by<
@@ -71,6 +81,13 @@ namespace eosio { namespace chain {
                member<key_value_object, uint64_t, &key_value_object::primary_key>
             >,
             composite_key_compare< std::less<table_id>, std::less<uint64_t> >
+         >,
+         hashed_unique<tag<by_table_primary>,
+            composite_key< key_value_object,
+               member<key_value_object, table_id, &key_value_object::t_id>,
+               member<key_value_object, uint64_t, &key_value_object::primary_key>
+            >,
+            composite_key_hash< table_id_hash, std::hash<uint64_t> >
          >
       >
    >;
@@ -78,6 +95,34 @@ namespace eosio { namespace chain {
    struct by_primary;
    struct by_secondary;
 
+   /**
+    * Index of the objects of a secondary_index ordered by SecondaryKeyLess. Separate from secondary_index so that an
+    * index can change its comparator while its objects keep their type, by whose name chainbase finds their index in
+    * an existing state database and snapshots name their section.
+    */
+   template<typename IndexObject, typename SecondaryKeyLess>
+   using secondary_index_container = chainbase::shared_multi_index_container<
+      IndexObject,
+      indexed_by<
+         ordered_unique<tag<by_id>, member<IndexObject, typename IndexObject::id_type, &IndexObject::id>>,
+         ordered_unique<tag<by_primary>,
+            composite_key< IndexObject,
+               member<IndexObject, table_id, &IndexObject::t_id>,
+               member<IndexObject, uint64_t, &IndexObject::primary_key>
+            >,
+            composite_key_compare< std::less<table_id>, std::less<uint64_t> >
+         >,
+         ordered_unique<tag<by_secondary>,
+            composite_key< IndexObject,
+               member<IndexObject, table_id, &IndexObject::t_id>,
+               member<IndexObject, typename IndexObject::secondary_key_type, &IndexObject::secondary_key>,
+               member<IndexObject, uint64_t, &IndexObject::primary_key>
+            >,
+            composite_key_compare< std::less<table_id>, SecondaryKeyLess, std::less<uint64_t> >
+         >
+      >
+   >;
+
    template<typename SecondaryKey, uint64_t ObjectTypeId, typename SecondaryKeyLess = std::less<SecondaryKey> >
    struct secondary_index
    {
@@ -92,28 +137,7 @@ namespace eosio { namespace chain {
          SecondaryKey  secondary_key; //< secondary_key should not be changed within a chainbase modifier lambda
       };
 
-
-      typedef chainbase::shared_multi_index_container<
-         index_object,
-         indexed_by<
-            ordered_unique<tag<by_id>, member<index_object, typename index_object::id_type, &index_object::id>>,
-            ordered_unique<tag<by_primary>,
-               composite_key< index_object,
-                  member<index_object, table_id, &index_object::t_id>,
-                  member<index_object, uint64_t, &index_object::primary_key>
-               >,
-               composite_key_compare< std::less<table_id>, std::less<uint64_t> >
-            >,
-            ordered_unique<tag<by_secondary>,
-               composite_key< index_object,
-                  member<index_object, table_id, &index_object::t_id>,
-                  member<index_object, SecondaryKey, &index_object::secondary_key>,
-                  member<index_object, uint64_t, &index_object::primary_key>
-               >,
-               composite_key_compare< std::less<table_id>, SecondaryKeyLess, std::less<uint64_t> >
-            >
-         >
-      > index_index;
+      typedef secondary_index_container<index_object, SecondaryKeyLess> index_index;
    };
 
    typedef secondary_index<uint64_t,index64_object_type>::index_object   index64_object;
@@ -123,8 +147,20 @@ namespace eosio { namespace chain {
    typedef secondary_index<uint128_t,index128_object_type>::index_index  index128_index;
 
    typedef std::array<uint128_t, 2> key256_t;
+
+   /**
+    * Orders key256_t as std::less does, without the loop and the early exits of std::lexicographical_compare: both
+    * words are compared and combined without branching, the words being native integers there is nothing to swap.
+    */
+   struct key256_less {
+      bool operator()( const key256_t& lhs, const key256_t& rhs ) const {
+         return (lhs[0] < rhs[0]) | ((lhs[0] == rhs[0]) & (lhs[1] < rhs[1]));
+      }
+   };
+
+   // the objects keep the type they had when ordered with std::less, existing state databases and snapshots refer to it
    typedef secondary_index<key256_t,index256_object_type>::index_object index256_object;
-   typedef secondary_index<key256_t,index256_object_type>::index_index  index256_index;
+   typedef secondary_index_container<index256_object,key256_less>       index256_index;
 
    struct soft_double_less {
       bool operator()( const float64_t& lhs, const float64_t& rhs ) const {
@@ -1,15 +1,22 @@
 #pragma once
 #include <eosio/chain/block_state.hpp>
+#include <eosio/chain/block_log.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/genesis_state.hpp>
 #include <chainbase/pinnable_mapped_file.hpp>
+#include <eosio/chain/database_memory.hpp>
 #include <boost/signals2/signal.hpp>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/protocol_feature_manager.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
+#include <eosio/chain/action_stats.hpp>
+#include <eosio/chain/apply_phase_stats.hpp>
+#include <eosio/chain/access_list.hpp>
+#include <eosio/chain/async_signal.hpp>
 
 namespace chainbase {
    class database;
@@ -69,10 +76,13 @@ namespace eosio { namespace chain {
             path                     state_dir              =  chain::config::default_state_dir_name;
             uint64_t                 state_size             =  chain::config::default_state_size;
             uint64_t                 state_guard_size       =  chain::config::default_state_guard_size;
-            uint64_t                 reversible_cache_size  =  chain::config::default_reversible_cache_size;
-            uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             uint32_t                 sig_cpu_bill_pct       =  chain::config::default_sig_cpu_bill_pct;
             uint16_t                 thread_pool_size       =  chain::config::default_controller_thread_pool_size;
+            uint32_t                 max_prefetched_blocks  =  chain::config::default_max_prefetched_blocks;
+            bool                     compress_block_log     =  false; //< create new blocks.log files in the compressed format
+            block_log_partition_config blocks_log_partitions;       //< split blocks.log into partitions with retention
+            bool                     trx_index              =  false; //< keep trx.index of the transaction ids in the block log
+            bool                     account_index          =  false; //< keep accounts.bloom of the accounts of the block log
             bool                     read_only              =  false;
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
@@ -80,8 +90,18 @@ namespace eosio { namespace chain {
             bool                     allow_ram_billing_in_notify = false;
             uint32_t                 maximum_variable_signature_length = chain::config::default_max_variable_signature_length;
             bool                     disable_all_subjective_mitigations = false; //< for testing purposes only
+            bool                     parallel_apply_analysis = false; //< record per-transaction accounts/tables of applied blocks and log their conflict groups
+            uint64_t                 fork_switch_delta_size = 0; //< max bytes of chainbase changes kept per validated block to replay on fork switches, 0 disables
+            uint32_t                 irreversible_step_time_us = 0; //< time after which blocks becoming irreversible are left for the next block, 0 handles them all at once
+            bool                     irreversible_undo_free = false; //< in irreversible read mode, apply the blocks becoming irreversible without undo sessions
+            uint32_t                 contract_row_hash_reserve = chain::config::default_contract_row_hash_reserve; //< rows beyond those of the state the by_table_primary buckets are reserved for at startup
 
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
+            uint32_t                 wasm_preinstantiate_codes = chain::config::default_wasm_preinstantiate_codes; //< 0 disables background instantiation
+            uint64_t                 wasm_cache_size = chain::config::default_wasm_cache_size; //< 0 does not bound the instantiation cache
+            bool                     wasm_profile = false; //< time wasm execution per receiver and action
+            uint32_t                 action_stats_window_blocks = 0; //< blocks per window of action_stats, 0 disables it
+            bool                     apply_phase_timing = false; //< accumulate apply_phase_stats
             eosvmoc::config          eosvmoc_config;
             bool                     eosvmoc_tierup         = false;
 
@@ -90,9 +110,11 @@ namespace eosio { namespace chain {
 
             pinnable_mapped_file::map_mode db_map_mode      = pinnable_mapped_file::map_mode::mapped;
             vector<string>           db_hugepage_paths;
+            database_memory_config   db_memory;
 
             flat_set<account_name>   resource_greylist;
             flat_set<account_name>   trusted_producers;
+            block_id_type            trusted_block; //< blocks up to this one are applied without signature recovery and authorization checks, empty for none
             uint32_t                 greylist_limit         = chain::config::maximum_elastic_resource_multiplier;
          };
 
@@ -144,6 +166,13 @@ namespace eosio { namespace chain {
           */
          transaction_trace_ptr push_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline, uint32_t billed_cpu_time_us = 0 );
 
+         /**
+          * Execute a transaction against the pending state without keeping any of its effects. Contract table writes,
+          * deferred transactions and native actions fail with read_only_trx_write_exception; signatures, TaPoS and
+          * expiration are not checked and nothing is billed. Errors are reported in the returned trace.
+          */
+         transaction_trace_ptr push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline );
+
          /**
           * Attempt to execute a specific transaction in our deferred trx database
           *
@@ -154,6 +183,14 @@ namespace eosio { namespace chain {
          void sign_block( const signer_callback_type& signer_callback );
          void commit_block();
 
+         /**
+          * Thread safe. Starts recovering the signing keys of the block's transactions on the controller thread pool
+          * so that they are already available when the block is later applied via push_block.
+          * At most config::max_prefetched_blocks blocks are retained, oldest are dropped first. b may be unvalidated: a later
+          * block with the same id replaces it, and keys are only used for transactions identical to those of the block applied.
+          */
+         void prefetch_block( const signed_block_ptr& b );
+
          std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b );
 
          /**
@@ -227,6 +264,18 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// packed signed_block, irreversible blocks are copied from the block log without being deserialized
+         std::vector<char> fetch_serialized_block_by_number( uint32_t block_num )const;
+         /// packed signed_block read from the block log alone, empty if it is not there, safe to call from any thread
+         std::vector<char> fetch_serialized_block_from_log( uint32_t block_num )const;
+
+         /**
+          * @return the number of the block including the transaction id, searching the reversible blocks and, with
+          *         trx_index, the block log, empty if it is not found
+          */
+         optional<uint32_t> get_transaction_block( const transaction_id_type& id )const;
+         /// true if the block log keeps trx.index, so that get_transaction_block() finds irreversible transactions
+         bool has_trx_index()const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
@@ -241,6 +290,7 @@ namespace eosio { namespace chain {
          void check_contract_list( account_name code )const;
          void check_action_list( account_name code, action_name action )const;
          void check_key_list( const public_key_type& key )const;
+         whitelist_blacklist_stats get_whitelist_blacklist_stats()const;
          bool is_building_block()const;
          bool is_producing_block()const;
 
@@ -259,7 +309,6 @@ namespace eosio { namespace chain {
          void validate_expiration( const transaction& t )const;
          void validate_tapos( const transaction& t )const;
          void validate_db_available_size() const;
-         void validate_reversible_available_size() const;
 
          bool is_protocol_feature_activated( const digest_type& feature_digest )const;
          bool is_builtin_activated( builtin_protocol_feature_t f )const;
@@ -273,6 +322,8 @@ namespace eosio { namespace chain {
          bool skip_db_sessions( )const;
          bool skip_db_sessions( block_status bs )const;
          bool skip_trx_checks()const;
+         /// true once a block failed after changing the state without undo sessions, the state must then not be closed cleanly
+         bool state_unrecoverable()const;
 
          bool contracts_console()const;
 
@@ -290,6 +341,7 @@ namespace eosio { namespace chain {
          bool all_subjective_mitigations_disabled()const;
 
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
+         /// linear memory of the calling thread
          vm::wasm_allocator&  get_wasm_allocator();
 #endif
 
@@ -313,20 +365,46 @@ namespace eosio { namespace chain {
          signal<void(const transaction_trace_ptr&)>  post_apply_action;
          */
 
+         /**
+          * Consumer running the handlers connected to it on its own thread, see async_signal_consumer. The controller
+          * waits for it to catch up only in wait_for_async_signals(), called when the controller is destroyed.
+          */
+         std::shared_ptr<async_signal_consumer> make_async_signal_consumer( std::string name, size_t max_queued = 1024 );
+         /// returns once every signal emitted before is handled by every consumer made by make_async_signal_consumer()
+         void wait_for_async_signals();
+
          const apply_handler* find_apply_handler( account_name contract, scope_name scope, action_name act )const;
          wasm_interface& get_wasm_interface();
 
+         /// progress of compiling the previously hot contracts at startup, empty if EOS VM OC tier-up is disabled
+         fc::optional<eosvmoc::warm_up_status> get_eosvmoc_warm_up_status()const;
+
+         /// EOS VM OC compiled code of a contract, for importing into other nodes
+         fc::optional<eosvmoc::code_artifact> export_eosvmoc_code( const digest_type& code_hash, uint8_t vm_version )const;
+         /// adds EOS VM OC compiled code exported by another node to the code cache, false if already there or compiling
+         bool import_eosvmoc_code( const eosvmoc::code_artifact& artifact );
+
+         /// counters of the cache of instantiated contracts
+         wasm_cache_stats get_wasm_cache_stats()const;
+
+         /// wasm execution time per receiver and action, most expensive first; empty unless config::wasm_profile
+         vector<wasm_profile_entry> get_wasm_profile()const;
+
+         /// nullptr unless config::action_stats_window_blocks
+         action_stats*       get_action_stats();
+         const action_stats* get_action_stats()const;
+
+         /// nullptr unless config::apply_phase_timing
+         apply_phase_stats*  get_apply_phase_stats();
+
 
-         optional<abi_serializer> get_abi_serializer( account_name n, const fc::microseconds& max_serialization_time )const {
+         abi_serializer_cache::abi_serializer_ptr get_abi_serializer( account_name n, const fc::microseconds& max_serialization_time )const {
             if( n.good() ) {
                try {
-                  const auto& a = get_account( n );
-                  abi_def abi;
-                  if( abi_serializer::to_abi( a.abi, abi ))
-                     return abi_serializer( abi, max_serialization_time );
+                  return abi_serializer_cache::instance().get( db(), n, max_serialization_time );
                } FC_CAPTURE_AND_LOG((n))
             }
-            return optional<abi_serializer>();
+            return abi_serializer_cache::abi_serializer_ptr();
          }
 
          template<typename T>
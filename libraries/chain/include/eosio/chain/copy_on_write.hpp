@@ -0,0 +1,80 @@
+#pragma once
+#include <fc/io/raw.hpp>
+#include <fc/variant.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Value shared by all of its copies until one of them is modified through mutate(), which then works on a
+    * private clone. Copying is a reference count increment, so values that rarely change can be carried along
+    * from one state to the next for free.
+    *
+    * Packs and converts to and from variants exactly like T.
+    */
+   template<typename T>
+   class copy_on_write {
+      public:
+         copy_on_write() : _value( empty() ) {}
+         copy_on_write( const T& v ) : _value( std::make_shared<T>( v ) ) {}
+         copy_on_write( T&& v ) : _value( std::make_shared<T>( std::move(v) ) ) {}
+
+         copy_on_write& operator=( const T& v ) { _value = std::make_shared<T>( v ); return *this; }
+         copy_on_write& operator=( T&& v ) { _value = std::make_shared<T>( std::move(v) ); return *this; }
+
+         const T& get()const { return *_value; }
+         const T& operator*()const { return *_value; }
+         const T* operator->()const { return _value.get(); }
+         operator const T&()const { return *_value; }
+
+         /// the value for modification, cloned first if it is shared with other copies
+         T& mutate() {
+            if( _value.use_count() > 1 ) _value = std::make_shared<T>( *_value );
+            return *_value;
+         }
+
+         /// true if both refer to the same instance, in which case they are also equal
+         bool shares_with( const copy_on_write& o )const { return _value == o._value; }
+
+      private:
+         /// default constructed values share a single instance, mutate() never modifies it since it always holds a reference
+         static const std::shared_ptr<T>& empty() {
+            static const std::shared_ptr<T> e = std::make_shared<T>();
+            return e;
+         }
+
+         std::shared_ptr<T> _value;
+   };
+
+} } /// eosio::chain
+
+namespace fc {
+
+   template<typename T>
+   void to_variant( const eosio::chain::copy_on_write<T>& v, variant& vo ) {
+      to_variant( *v, vo );
+   }
+
+   template<typename T>
+   void from_variant( const variant& v, eosio::chain::copy_on_write<T>& cow ) {
+      T value;
+      from_variant( v, value );
+      cow = std::move(value);
+   }
+
+namespace raw {
+
+   template<typename Stream, typename T>
+   void pack( Stream& s, const eosio::chain::copy_on_write<T>& v ) {
+      fc::raw::pack( s, *v );
+   }
+
+   template<typename Stream, typename T>
+   void unpack( Stream& s, eosio::chain::copy_on_write<T>& cow ) {
+      T value;
+      fc::raw::unpack( s, value );
+      cow = std::move(value);
+   }
+
+} } /// fc::raw
@@ -24,10 +24,12 @@ namespace eosio { namespace chain {
           *         no changes to its format were made so it can be safely added to existing databases
           *   - 2 : shared_authority now holds shared_key_weights & shared_public_keys
           *         change from producer_key to producer_authority for many in-memory structures
+          *   - 3 : key_value_index has a hashed index of the rows by table and primary key; a version 2 state can not be
+          *         upgraded in place and has to be replayed or restored from a snapshot
           */
 
-         static constexpr uint32_t current_version            = 2;
-         static constexpr uint32_t minimum_version            = 2;
+         static constexpr uint32_t current_version            = 3;
+         static constexpr uint32_t minimum_version            = 3;
 
          id_type        id;
          uint32_t       version = current_version;
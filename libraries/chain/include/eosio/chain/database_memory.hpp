@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chainbase/chainbase.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+
+namespace eosio { namespace chain {
+
+   /// placement of the chainbase mapping; every setting is a no-op on platforms other than Linux
+   struct database_memory_config {
+      bool     prefetch = false;              ///< stream the state file into the page cache and fault in the mapping at startup ("mapped" mode)
+      bool     transparent_hugepages = false; ///< madvise(MADV_HUGEPAGE) the mapping ("mapped" and "heap" modes)
+      int32_t  numa_node = -1;                ///< node to bind the calling thread and the mapping to, -1 leaves placement to the kernel
+      uint32_t load_threads = 0;              ///< threads reading the state file into the page cache before it is loaded or prefetched, 0 for none ("heap" and "locked" modes) or one ("mapped" mode)
+   };
+
+   /**
+    * Called before the database whose file is state_file is opened. In "heap" and "locked" mode, where chainbase copies
+    * the whole file into memory in one sequential pass, reads the file into the page cache with cfg.load_threads
+    * threads first, so that the copy is bound by memory rather than by single threaded reads of the disk.
+    */
+   void preload_database_file( const fc::path& state_file, chainbase::pinnable_mapped_file::map_mode mode,
+                               const database_memory_config& cfg );
+
+   /**
+    * Applies cfg to the mapping of an open database whose file is state_file. The NUMA binding also applies to the
+    * calling thread and to every thread it starts afterwards, which inherit its affinity and memory policy.
+    */
+   void configure_database_memory( const chainbase::database& db, const fc::path& state_file,
+                                   chainbase::pinnable_mapped_file::map_mode mode, const database_memory_config& cfg );
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::database_memory_config, (prefetch)(transparent_hugepages)(numa_node)(load_threads) )
@@ -16,6 +16,9 @@ namespace eosio { namespace chain {
     * database tracks the longest chain and the last irreversible block number. All
     * blocks older than the last irreversible block are freed after emitting the
     * irreversible signal.
+    *
+    * Every modification is appended to a journal in the data directory as it happens, which open() replays, so
+    * close() has nothing left to write. The journal is compacted in the background once it has grown enough.
     */
    class fork_database {
       public:
@@ -73,6 +76,7 @@ namespace eosio { namespace chain {
          /**
           *  Returns the block state with a block number of `block_num` that is on the branch that
           *  contains a block with an id of`h`, or the empty shared pointer if no such block can be found.
+          *  Constant time when `h` is on the branch of the pending head, whose blocks are kept indexed by number.
           */
          block_state_ptr search_on_branch( const block_id_type& h, uint32_t block_num )const;
 
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <functional>
+#include <limits>
+#include <map>
+
+namespace eosio { namespace chain {
+
+using namespace boost::multi_index;
+
+enum class trx_queue_policy {
+   fifo = 0,         ///< arrival order
+   account_fair = 1, ///< round robin between the first authorizers of the queued transactions
+   expiry = 2,       ///< earliest expiration first
+   cpu = 3,          ///< lowest CPU usage of previous runs of the same first action first
+   priority = 4      ///< first authorizers of the configured priority accounts first, in their configured order
+};
+
+struct incoming_transaction {
+   using next_func_t = std::function<void(const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>&)>;
+
+   transaction_metadata_ptr trx_meta;
+   bool                     persist_until_expired = false;
+   next_func_t              next;
+   int64_t                  rank = 0;  ///< position by policy, lowest first
+   int64_t                  seq = 0;   ///< arrival order within a rank
+   uint64_t                 size = 0;  ///< bytes accounted against the queue size limit
+
+   /// queued behind every transaction which is not, whatever the policy
+   bool deprioritized()const { return rank == std::numeric_limits<int64_t>::max(); }
+};
+
+/**
+ * Incoming transactions waiting to be applied, ordered by a configurable trx_queue_policy with O(log n) add and
+ * pop. The queue is bounded in bytes; when full, a transaction ordered ahead of the last queued transactions
+ * evicts them. With the fifo policy a new transaction is never ahead, so it is dropped instead.
+ *
+ * Deprioritized transactions, e.g. of accounts over their subjective CPU budget, are queued in arrival order behind
+ * all others and are the first ones evicted.
+ */
+class incoming_transaction_queue {
+public:
+   using next_func_t = incoming_transaction::next_func_t;
+
+private:
+   struct by_order;
+
+   typedef multi_index_container< incoming_transaction,
+      indexed_by<
+         ordered_unique< tag<by_order>,
+            composite_key< incoming_transaction,
+               member<incoming_transaction, int64_t, &incoming_transaction::rank>,
+               member<incoming_transaction, int64_t, &incoming_transaction::seq>
+            >
+         >
+      >
+   > incoming_trx_queue_type;
+
+   struct account_state {
+      int64_t  next_rank = 0; ///< account_fair rank of the next transaction of the account
+      uint32_t queued = 0;
+   };
+
+   static constexpr size_t max_cpu_estimates = 100*1000;
+
+   incoming_trx_queue_type queue;
+   trx_queue_policy        policy = trx_queue_policy::fifo;
+   bool                    track_cpu_usage = false;
+   uint64_t                max_size_in_bytes = 0;
+   uint64_t                size_in_bytes = 0;
+   int64_t                 back_seq = 0;
+   int64_t                 front_seq = 0;
+   int64_t                 virtual_time = 0;  ///< account_fair rank of the last popped transaction
+   std::map<account_name, account_state>                     accounts;
+   std::map<std::pair<account_name, action_name>, uint32_t>  cpu_estimates;
+   std::map<account_name, int64_t>                           priority_ranks;
+
+   static uint64_t calc_size( const transaction_metadata_ptr& trx ) {
+      return trx->packed_trx()->get_unprunable_size() + trx->packed_trx()->get_prunable_size() + sizeof( *trx );
+   }
+
+   static account_name authorizer_of( const transaction_metadata_ptr& trx ) {
+      return trx->packed_trx()->get_transaction().first_authorizer();
+   }
+
+   static std::pair<account_name, action_name> first_action_of( const transaction_metadata_ptr& trx ) {
+      const auto& actions = trx->packed_trx()->get_transaction().actions;
+      if( actions.empty() ) return {};
+      return { actions.front().account, actions.front().name };
+   }
+
+   int64_t rank_of( const transaction_metadata_ptr& trx )const {
+      switch( policy ) {
+         case trx_queue_policy::fifo:
+            return 0;
+         case trx_queue_policy::account_fair: {
+            auto itr = accounts.find( authorizer_of( trx ) );
+            return itr == accounts.end() ? virtual_time : std::max( virtual_time, itr->second.next_rank );
+         }
+         case trx_queue_policy::expiry:
+            return trx->packed_trx()->expiration().sec_since_epoch();
+         case trx_queue_policy::cpu: {
+            auto itr = cpu_estimates.find( first_action_of( trx ) );
+            return itr == cpu_estimates.end() ? 0 : itr->second;
+         }
+         case trx_queue_policy::priority: {
+            auto itr = priority_ranks.find( authorizer_of( trx ) );
+            return itr == priority_ranks.end() ? static_cast<int64_t>( priority_ranks.size() ) : itr->second;
+         }
+      }
+      return 0;
+   }
+
+   void insert( incoming_transaction&& in ) {
+      if( policy == trx_queue_policy::account_fair && !in.deprioritized() ) {
+         auto& a = accounts[authorizer_of( in.trx_meta )];
+         a.next_rank = std::max( a.next_rank, in.rank + 1 );
+         ++a.queued;
+      }
+      size_in_bytes += in.size;
+      queue.insert( std::move( in ) );
+   }
+
+   template<typename Itr>
+   incoming_transaction remove( Itr itr ) {
+      incoming_transaction result = *itr;
+      queue.get<by_order>().erase( itr );
+      size_in_bytes -= result.size;
+      if( policy == trx_queue_policy::account_fair && !result.deprioritized() ) {
+         auto a = accounts.find( authorizer_of( result.trx_meta ) );
+         // an account without queued transactions starts over at virtual_time, idle accounts get no credit
+         if( a != accounts.end() && --a->second.queued == 0 ) accounts.erase( a );
+      }
+      return result;
+   }
+
+public:
+   void set_max_incoming_transaction_queue_size( uint64_t v ) { max_size_in_bytes = v; }
+
+   void set_policy( trx_queue_policy p ) {
+      if( p != policy ) {
+         FC_ASSERT( empty(), "set_policy, queue required to be empty" );
+      }
+      policy = p;
+   }
+
+   trx_queue_policy get_policy()const { return policy; }
+
+   /// accounts of trx_queue_policy::priority in priority order
+   void set_priority_accounts( const vector<account_name>& priority_accounts ) {
+      FC_ASSERT( empty(), "set_priority_accounts, queue required to be empty" );
+      priority_ranks.clear();
+      for( const auto& a : priority_accounts )
+         priority_ranks.emplace( a, priority_ranks.size() );
+   }
+
+   /// whether CPU usage is recorded for cpu_estimate() whatever the policy
+   void set_track_cpu_usage( bool v ) { track_cpu_usage = v; }
+
+   /// records the CPU usage of a run of trx for trx_queue_policy::cpu and cpu_estimate()
+   void record_cpu_usage( const transaction_metadata_ptr& trx, uint32_t cpu_usage_us ) {
+      if( policy != trx_queue_policy::cpu && !track_cpu_usage ) return;
+      const auto key = first_action_of( trx );
+      auto itr = cpu_estimates.find( key );
+      if( itr != cpu_estimates.end() ) {
+         itr->second = ( uint64_t( itr->second ) * 3 + cpu_usage_us ) / 4;
+      } else if( cpu_estimates.size() < max_cpu_estimates ) {
+         cpu_estimates.emplace( key, cpu_usage_us );
+      }
+   }
+
+   /**
+    * Queues trx by policy, throws tx_resource_exhaustion if the queue is full and trx is not ordered ahead of
+    * enough queued transactions to make room for it.
+    * @param deprioritized to queue trx behind all transactions which are not
+    * @return the transactions evicted to make room for trx, their next has not been called
+    */
+   vector<incoming_transaction> add( const transaction_metadata_ptr& trx, bool persist_until_expired, next_func_t next,
+                                     bool deprioritized = false ) {
+      incoming_transaction in{ trx, persist_until_expired, std::move( next ),
+                               deprioritized ? std::numeric_limits<int64_t>::max() : rank_of( trx ), back_seq++, calc_size( trx ) };
+      vector<incoming_transaction> evicted;
+      if( size_in_bytes + in.size >= max_size_in_bytes ) {
+         auto& idx = queue.get<by_order>();
+         uint64_t freed = 0;
+         size_t num_evicted = 0;
+         for( auto itr = idx.rbegin(); itr != idx.rend() && size_in_bytes - freed + in.size >= max_size_in_bytes &&
+                                       itr->rank > in.rank; ++itr ) {
+            freed += itr->size;
+            ++num_evicted;
+         }
+         EOS_ASSERT( size_in_bytes - freed + in.size < max_size_in_bytes, tx_resource_exhaustion,
+                     "Transaction exceeded producer resource limit" );
+         evicted.reserve( num_evicted );
+         for( ; num_evicted > 0; --num_evicted ) {
+            evicted.emplace_back( remove( std::prev( idx.end() ) ) );
+         }
+      }
+      insert( std::move( in ) );
+      return evicted;
+   }
+
+   /// queues trx ahead of all others, e.g. to retry it first
+   void add_front( const transaction_metadata_ptr& trx, bool persist_until_expired, next_func_t next ) {
+      const auto size = calc_size( trx );
+      EOS_ASSERT( size_in_bytes + size < max_size_in_bytes, tx_resource_exhaustion, "Transaction exceeded producer resource limit" );
+      insert( { trx, persist_until_expired, std::move( next ), std::numeric_limits<int64_t>::min(), --front_seq, size } );
+   }
+
+   incoming_transaction pop_front() {
+      EOS_ASSERT( !queue.empty(), producer_exception, "logic error, front() called on empty incoming_transactions" );
+      auto& idx = queue.get<by_order>();
+      incoming_transaction result = remove( idx.begin() );
+      if( policy == trx_queue_policy::account_fair && result.rank != std::numeric_limits<int64_t>::min() && !result.deprioritized() )
+         virtual_time = result.rank;
+      return result;
+   }
+
+   /// CPU usage of previous runs of the same first action as trx, 0 if none was recorded
+   uint32_t cpu_estimate( const transaction_metadata_ptr& trx )const {
+      auto itr = cpu_estimates.find( first_action_of( trx ) );
+      return itr == cpu_estimates.end() ? 0 : itr->second;
+   }
+
+   /// the first n transactions in queue order, deprioritized ones excluded
+   vector<transaction_metadata_ptr> front( size_t n )const {
+      vector<transaction_metadata_ptr> result;
+      const auto& idx = queue.get<by_order>();
+      for( auto itr = idx.begin(); itr != idx.end() && result.size() < n && !itr->deprioritized(); ++itr )
+         result.push_back( itr->trx_meta );
+      return result;
+   }
+
+   /**
+    * Queues the transactions among front( n ) for which pred returns true behind all others, as if they had been
+    * added deprioritized.
+    * @return how many were deprioritized
+    */
+   template<typename Pred>
+   size_t deprioritize_front( size_t n, Pred&& pred ) {
+      auto& idx = queue.get<by_order>();
+      vector<decltype( idx.begin() )> moved;
+      for( auto itr = idx.begin(); itr != idx.end() && n > 0 && !itr->deprioritized(); ++itr, --n ) {
+         if( pred( itr->trx_meta ) ) moved.push_back( itr );
+      }
+      for( auto itr : moved ) {
+         incoming_transaction in = remove( itr );
+         in.rank = std::numeric_limits<int64_t>::max();
+         in.seq = back_seq++;
+         insert( std::move( in ) );
+      }
+      return moved.size();
+   }
+
+   bool empty()const { return queue.empty(); }
+   size_t size()const { return queue.size(); }
+};
+
+} } //eosio::chain
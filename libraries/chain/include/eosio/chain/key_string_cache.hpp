@@ -0,0 +1,60 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   namespace detail { struct key_string_cache_impl; }
+
+   /**
+    * Bounded, thread safe, process wide cache of the base58 strings of public keys and signatures.
+    *
+    * API responses and history documents convert the same producer and exchange keys, and the signatures of the same
+    * recent blocks, over and over, each conversion being a big number division per output character. Keys and
+    * signatures are kept in separate tables of the same capacity, so that the signatures of a burst of blocks do not
+    * evict the keys. Least recently used entries are evicted first.
+    */
+   class key_string_cache {
+      public:
+         struct stats {
+            uint64_t hits     = 0;
+            uint64_t misses   = 0;
+            size_t   size     = 0; ///< of both tables
+            size_t   capacity = 0; ///< of each table
+         };
+
+         static key_string_cache& instance();
+
+         ~key_string_cache();
+
+         std::string to_string( const public_key_type& key );
+         std::string to_string( const signature_type& sig );
+
+         /// string variants of keys or signatures, for the places that would convert them through fc::variant
+         template<typename Container>
+         fc::variants to_variants( const Container& c ) {
+            fc::variants result;
+            result.reserve( c.size() );
+            for( const auto& v : c )
+               result.emplace_back( to_string( v ) );
+            return result;
+         }
+
+         /// a capacity of 0 disables the cache, shrinking evicts the least recently used entries
+         void set_capacity( size_t capacity );
+
+         stats get_stats()const;
+
+         /// removes all entries and resets the hit/miss counters
+         void clear();
+
+      private:
+         key_string_cache();
+
+         std::unique_ptr<detail::key_string_cache_impl> my;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::key_string_cache::stats, (hits)(misses)(size)(capacity) )
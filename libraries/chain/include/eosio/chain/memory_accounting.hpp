@@ -0,0 +1,118 @@
+#pragma once
+#include <eosio/chain/metrics.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain { namespace memory_accounting {
+
+   /**
+    * Heap bytes held by one subsystem of nodeos. The subsystem reports what it allocates and frees at the places
+    * where it already knows the size of its buffers and queued entries, instead of the allocator attributing every
+    * allocation, so that accounting costs a couple of relaxed atomic adds per buffer or entry.
+    *
+    * Exported as nodeos_memory_live_bytes and nodeos_memory_allocated_bytes_total labeled with the subsystem, the
+    * allocation rate is the rate of the latter.
+    *
+    * Thread safe.
+    */
+   class subsystem {
+      public:
+         explicit subsystem( const std::string& name );
+
+         void allocated( uint64_t bytes ) {
+            if( !enabled() ) return;
+            _live.add( int64_t(bytes) );
+            _allocated.add( bytes );
+         }
+         void freed( uint64_t bytes ) {
+            if( !enabled() ) return;
+            _live.add( -int64_t(bytes) );
+         }
+
+         const std::string& name()const { return _name; }
+         int64_t  live_bytes()const { return _live.value(); }
+         uint64_t allocated_bytes()const { return _allocated.value(); }
+
+         static bool enabled() { return _enabled.load( std::memory_order_relaxed ); }
+         /// set at startup before anything is accounted, bytes allocated while enabled are expected to be freed while enabled
+         static void set_enabled( bool e ) { _enabled.store( e, std::memory_order_relaxed ); }
+
+      private:
+         static std::atomic<bool> _enabled;
+
+         const std::string  _name;
+         metrics::gauge&    _live;
+         metrics::counter&  _allocated;
+   };
+
+   /// bytes accounted to a subsystem for as long as this lives, e.g. as a member of a queued entry
+   class tracked_bytes {
+      public:
+         tracked_bytes() = default;
+         tracked_bytes( subsystem& s, uint64_t bytes )
+         :_subsystem( &s ), _bytes( bytes ) { s.allocated( bytes ); }
+
+         tracked_bytes( tracked_bytes&& other )
+         :_subsystem( other._subsystem ), _bytes( other._bytes ) { other._subsystem = nullptr; }
+
+         tracked_bytes& operator=( tracked_bytes&& other ) {
+            if( this != &other ) {
+               release();
+               _subsystem = other._subsystem;
+               _bytes = other._bytes;
+               other._subsystem = nullptr;
+            }
+            return *this;
+         }
+
+         tracked_bytes( const tracked_bytes& ) = delete;
+         tracked_bytes& operator=( const tracked_bytes& ) = delete;
+
+         ~tracked_bytes() { release(); }
+
+         uint64_t bytes()const { return _subsystem ? _bytes : 0; }
+
+      private:
+         void release() {
+            if( _subsystem ) _subsystem->freed( _bytes );
+            _subsystem = nullptr;
+         }
+
+         subsystem* _subsystem = nullptr;
+         uint64_t   _bytes = 0;
+   };
+
+   /// net_plugin buffers of the messages sent and of its buffer pool
+   subsystem& net_buffers();
+   /// transactions of the unapplied transaction queue
+   subsystem& unapplied_transactions();
+   /// packed blocks of the block states, shared by the fork database, the block log queue and the peers
+   subsystem& block_states();
+   /// instantiated contracts of the wasm cache
+   subsystem& wasm_cache();
+   /// blocks, transactions and traces queued for the mongo_db_plugin consume thread
+   subsystem& mongo_db_queues();
+
+   struct subsystem_usage {
+      std::string name;
+      int64_t     live_bytes = 0;
+      uint64_t    allocated_bytes = 0; ///< since startup
+   };
+
+   struct usage {
+      bool                         enabled = false;
+      std::vector<subsystem_usage> subsystems;
+      fc::optional<uint64_t>       heap_bytes; ///< in use according to the allocator, when it can tell
+   };
+
+   usage get_usage();
+
+} } } /// eosio::chain::memory_accounting
+
+FC_REFLECT( eosio::chain::memory_accounting::subsystem_usage, (name)(live_bytes)(allocated_bytes) )
+FC_REFLECT( eosio::chain::memory_accounting::usage, (enabled)(subsystems)(heap_bytes) )
@@ -14,6 +14,12 @@ namespace eosio { namespace chain {
       return make_pair(make_canonical_left(l), make_canonical_right(r));
    };
 
+   /**
+    *  Same result as digest_type::hash(make_canonical_pair(l, r)), but hashes the 64 byte node directly
+    *  instead of building the pair and serializing it through the encoder.
+    */
+   digest_type hash_canonical_pair(const digest_type& l, const digest_type& r);
+
    /**
     *  Calculates the merkle root of a set of digests, if ids is odd it will duplicate the last id.
     */
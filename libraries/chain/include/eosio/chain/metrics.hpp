@@ -0,0 +1,102 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain { namespace metrics {
+
+   /// counter sharded by thread, so that threads adding to it do not contend for one cache line
+   class counter {
+      public:
+         void add( uint64_t n = 1 ) { _shards[shard_index()].value.fetch_add( n, std::memory_order_relaxed ); }
+         uint64_t value()const;
+
+      private:
+         static constexpr size_t shard_count = 16;
+         struct alignas(64) shard {
+            std::atomic<uint64_t> value{0};
+         };
+
+         static size_t shard_index();
+
+         std::array<shard, shard_count> _shards;
+   };
+
+   class gauge {
+      public:
+         void set( int64_t v ) { _value.store( v, std::memory_order_relaxed ); }
+         void add( int64_t n ) { _value.fetch_add( n, std::memory_order_relaxed ); }
+         int64_t value()const { return _value.load( std::memory_order_relaxed ); }
+
+      private:
+         std::atomic<int64_t> _value{0};
+   };
+
+   /// histogram with fixed upper bounds, exported as cumulative prometheus buckets
+   class histogram {
+      public:
+         explicit histogram( std::vector<uint64_t> bounds );
+
+         void record( uint64_t v );
+
+         const std::vector<uint64_t>& bounds()const { return _bounds; }
+         /// count of values of each bucket, the last one for the values above every bound
+         std::vector<uint64_t> counts()const;
+         uint64_t sum()const { return _sum.load( std::memory_order_relaxed ); }
+
+      private:
+         const std::vector<uint64_t>        _bounds;
+         std::vector<std::atomic<uint64_t>> _counts;
+         std::atomic<uint64_t>              _sum{0};
+   };
+
+   /// microseconds from 100us to 1s
+   const std::vector<uint64_t>& time_buckets_us();
+   /// bytes from 256B to 16MiB
+   const std::vector<uint64_t>& size_buckets();
+
+   /**
+    * Process wide set of metrics, exported in the prometheus text format. Metrics are registered once, typically when
+    * a plugin is initialized, and live as long as the process, so that recording one is a relaxed atomic add on a
+    * reference kept by its owner. Registering the same name and labels again returns the same metric.
+    *
+    * Thread safe.
+    */
+   class registry {
+      public:
+         static registry& instance();
+
+         /// @param labels prometheus labels without the braces, e.g. from label("url", url), empty for none
+         counter&   get_counter( const std::string& name, const std::string& help, const std::string& labels = std::string() );
+         gauge&     get_gauge( const std::string& name, const std::string& help, const std::string& labels = std::string() );
+         histogram& get_histogram( const std::string& name, const std::string& help, const std::vector<uint64_t>& bounds,
+                                   const std::string& labels = std::string() );
+
+         /// the metrics whose name starts with prefix, all of them if it is empty
+         std::string prometheus_text( const std::string& prefix = std::string() )const;
+
+         /// key="value" with value escaped
+         static std::string label( const std::string& key, const std::string& value );
+
+      private:
+         enum class metric_type { counter, gauge, histogram };
+
+         struct family {
+            metric_type                                        type;
+            std::string                                        help;
+            std::map<std::string, std::unique_ptr<counter>>    counters;   ///< by labels
+            std::map<std::string, std::unique_ptr<gauge>>      gauges;     ///< by labels
+            std::map<std::string, std::unique_ptr<histogram>>  histograms; ///< by labels
+         };
+
+         family& get_family( const std::string& name, const std::string& help, metric_type type );
+
+         mutable std::mutex                 _mtx;
+         std::map<std::string, family>      _families; ///< by name
+   };
+
+} } } /// eosio::chain::metrics
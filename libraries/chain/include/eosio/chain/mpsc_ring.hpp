@@ -0,0 +1,84 @@
+#pragma once
+#include <fc/optional.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Bounded lock-free queue for any number of producer threads and a single consumer thread.
+    * Slots are preallocated, pushing never allocates beyond the move or copy of the value into its slot.
+    * A slot is free for position pos once its sequence equals pos, and holds a value for pos once it equals pos + 1.
+    */
+   template<typename T>
+   class mpsc_ring {
+   public:
+      /// capacity is rounded up to a power of two
+      explicit mpsc_ring( uint64_t capacity ) {
+         uint64_t size = 1;
+         while( size < capacity ) size <<= 1;
+         _slots = std::vector<slot>( size );
+         for( uint64_t i = 0; i < size; ++i ) _slots[i].sequence.store( i, std::memory_order_relaxed );
+         _mask = size - 1;
+      }
+
+      mpsc_ring( const mpsc_ring& ) = delete;
+      mpsc_ring& operator=( const mpsc_ring& ) = delete;
+
+      /// thread safe, false if the ring is full
+      template<typename U>
+      bool push( U&& v ) {
+         uint64_t pos = _head.load( std::memory_order_relaxed );
+         for( ;; ) {
+            slot& s = _slots[pos & _mask];
+            const uint64_t seq = s.sequence.load( std::memory_order_acquire );
+            const int64_t diff = int64_t(seq) - int64_t(pos);
+            if( diff == 0 ) {
+               if( _head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                  s.value.emplace( std::forward<U>( v ) );
+                  s.sequence.store( pos + 1, std::memory_order_release );
+                  return true;
+               }
+            } else if( diff < 0 ) {
+               return false;
+            } else {
+               pos = _head.load( std::memory_order_relaxed );
+            }
+         }
+      }
+
+      /// consumer thread only, false if the ring is empty
+      bool pop( T& v ) {
+         const uint64_t pos = _tail.load( std::memory_order_relaxed );
+         slot& s = _slots[pos & _mask];
+         if( s.sequence.load( std::memory_order_acquire ) != pos + 1 ) return false;
+         v = std::move( *s.value );
+         s.value.reset();
+         s.sequence.store( pos + _mask + 1, std::memory_order_release );
+         _tail.store( pos + 1, std::memory_order_relaxed );
+         return true;
+      }
+
+      /// consumer thread only
+      bool empty()const {
+         const uint64_t pos = _tail.load( std::memory_order_relaxed );
+         return _slots[pos & _mask].sequence.load( std::memory_order_acquire ) != pos + 1;
+      }
+
+      uint64_t capacity()const { return _mask + 1; }
+
+   private:
+      struct slot {
+         std::atomic<uint64_t> sequence{0};
+         fc::optional<T>       value;
+      };
+
+      std::vector<slot>      _slots;
+      uint64_t               _mask = 0;
+      std::atomic<uint64_t>  _head{0}; ///< next position to write
+      std::atomic<uint64_t>  _tail{0}; ///< next position to read
+   };
+
+} } // eosio::chain
@@ -1,7 +1,8 @@
 #pragma once
+#include <array>
 #include <string>
 #include <fc/reflect/reflect.hpp>
-#include <iosfwd>
+#include <ostream>
 
 namespace eosio::chain {
   struct name;
@@ -13,28 +14,34 @@ namespace fc {
 } // fc
 
 namespace eosio::chain {
+   /// 5 bit value of each character in a name, 0 for '.' and for the characters a name can't hold
+   static constexpr std::array<uint8_t, 256> name_char_values = []() {
+      std::array<uint8_t, 256> values{};
+      for( char c = 'a'; c <= 'z'; ++c )
+         values[uint8_t(c)] = (c - 'a') + 6;
+      for( char c = '1'; c <= '5'; ++c )
+         values[uint8_t(c)] = (c - '1') + 1;
+      return values;
+   }();
+
+   /// character of each 5 bit value in a name
+   static constexpr char name_chars[] = ".12345abcdefghijklmnopqrstuvwxyz";
+
    static constexpr uint64_t char_to_symbol( char c ) {
-      if( c >= 'a' && c <= 'z' )
-         return (c - 'a') + 6;
-      if( c >= '1' && c <= '5' )
-         return (c - '1') + 1;
-      return 0;
+      return name_char_values[uint8_t(c)];
    }
 
    static constexpr uint64_t string_to_uint64_t( std::string_view str ) {
       uint64_t n = 0;
-      int i = 0;
-      for ( ; str[i] && i < 12; ++i) {
-         // NOTE: char_to_symbol() returns char type, and without this explicit
-         // expansion to uint64 type, the compilation fails at the point of usage
-         // of string_to_name(), where the usage requires constant (compile time) expression.
+      size_t i = 0;
+      for ( ; i < 12 && i < str.size() && str[i]; ++i) {
          n |= (char_to_symbol(str[i]) & 0x1f) << (64 - 5 * (i + 1));
       }
 
       // The for-loop encoded up to 60 high bits into uint64 'name' variable,
       // if (strlen(str) > 12) then encode str[12] into the low (remaining)
       // 4 bits of 'name'
-      if (i == 12)
+      if (i == 12 && str.size() > 12)
          n |= char_to_symbol(str[12]) & 0x0F;
       return n;
    }
@@ -57,11 +64,29 @@ namespace eosio::chain {
       constexpr explicit name( uint64_t v ) : value(v) {}
       constexpr name() = default;
 
+      static constexpr size_t max_length = 13;
+
+      /// number of characters of to_string(), trailing dots are not written
+      constexpr size_t length()const {
+         if( value == 0 ) return 0;
+         const int zeros = __builtin_ctzll( value );
+         return zeros < 4 ? 13 : 12 - (zeros - 4) / 5;
+      }
+
+      /// writes length() characters at buf, which must have room for max_length, and returns the end of them
+      constexpr char* to_chars( char* buf )const {
+         const size_t len = length();
+         for( size_t i = 0; i < len; ++i )
+            buf[i] = name_chars[ i < 12 ? (value >> (59 - 5 * i)) & 0x1f : value & 0x0f ];
+         return buf + len;
+      }
+
       std::string to_string()const;
       constexpr uint64_t to_uint64_t()const { return value; }
 
       friend std::ostream& operator << ( std::ostream& out, const name& n ) {
-         return out << n.to_string();
+         char buf[max_length];
+         return out.write( buf, n.to_chars( buf ) - buf );
       }
 
       friend constexpr bool operator < ( const name& a, const name& b ) { return a.value < b.value; }
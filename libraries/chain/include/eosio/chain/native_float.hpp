@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2_MATH__)
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Hardware IEEE-754 arithmetic is correctly rounded just like softfloat, so it produces the same bits for every
+ * result which is not a NaN as long as each operation is evaluated in its own precision (SSE2 or AArch64, not
+ * x87), rounds to nearest even and keeps subnormals (no flush-to-zero or denormals-are-zero). NaN results are left
+ * to softfloat because the payload and sign of a produced or propagated NaN differ between implementations.
+ */
+#if (defined(__SSE2_MATH__) || defined(__aarch64__)) && !defined(__FAST_MATH__) && FLT_EVAL_METHOD == 0
+#define EOSIO_NATIVE_FLOAT_ENABLED
+#endif
+
+namespace eosio { namespace chain { namespace native_float {
+
+   /// the floating point environment is the default one, checked on every call as a library could change it
+   inline bool environment_matches_softfloat() {
+#if !defined(EOSIO_NATIVE_FLOAT_ENABLED)
+      return false;
+#elif defined(__SSE2_MATH__)
+      // rounding control, flush-to-zero and denormals-are-zero must be clear
+      return (_mm_getcsr() & 0xE040) == 0;
+#else
+      uint64_t fpcr;
+      __asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+      // rounding mode and flush-to-zero must be clear
+      return (fpcr & 0x01C00000) == 0;
+#endif
+   }
+
+   /**
+    * Evaluates op in hardware into result; returns false when the caller has to compute it with softfloat instead.
+    * op must be a single IEEE-754 operation: add, sub, mul, div, sqrt or a conversion.
+    */
+   template<typename T, typename Op>
+   inline bool compute( T& result, Op&& op ) {
+      if( !environment_matches_softfloat() )
+         return false;
+      result = op();
+      return !std::isnan( result );
+   }
+
+} } } // eosio::chain::native_float
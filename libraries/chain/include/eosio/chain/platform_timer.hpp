@@ -18,6 +18,12 @@ struct platform_timer {
    void start(fc::time_point tp);
    void stop();
 
+   /// timer of the calling thread, created on first use; every thread executing transactions checks its own deadlines
+   static platform_timer& current_thread_timer() {
+      static thread_local platform_timer timer;
+      return timer;
+   }
+
    /* Sets a callback for when timer expires. Be aware this could might fire from a signal handling context and/or
       on any particular thread. Only a single callback can be registered at once; trying to register more will
       result in an exception. Setting to nullptr disables any current set callback */
@@ -38,7 +44,7 @@ struct platform_timer {
 
 private:
    struct impl;
-   constexpr static size_t fwd_size = 8;
+   constexpr static size_t fwd_size = 16;
    fc::fwd<impl,fwd_size> my;
 
    void call_expiration_callback() {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/chain/types.hpp>
+#include <atomic>
 #include <iterator>
 
 namespace eosio { namespace chain {
@@ -338,7 +339,14 @@ public:
    const_iterator upper_bound( uint32_t block_num )const;
 
 
-   bool is_builtin_activated( builtin_protocol_feature_t feature_codename, uint32_t current_block_num )const;
+   /// answered from a bit mask of the builtin features activated as of the block number of the previous lookup
+   bool is_builtin_activated( builtin_protocol_feature_t feature_codename, uint32_t current_block_num )const {
+      const uint32_t indx = static_cast<uint32_t>( feature_codename );
+      const uint64_t cache = _builtin_activation_cache.load( std::memory_order_relaxed );
+      if( indx < 32 && static_cast<uint32_t>( cache >> 32 ) == current_block_num )
+         return (cache >> indx) & 1;
+      return refresh_builtin_activation_cache( indx, current_block_num );
+   }
 
    void activate_feature( const digest_type& feature_digest, uint32_t current_block_num );
    void popped_blocks_to( uint32_t block_num );
@@ -364,6 +372,12 @@ protected:
    vector<builtin_protocol_feature_entry> _builtin_protocol_features;
    size_t                                 _head_of_builtin_activation_list = builtin_protocol_feature_entry::no_previous;
    bool                                   _initialized = false;
+
+   /// block number in the upper half, activation bits of the first 32 builtin features as of that block in the lower
+   static constexpr uint64_t              invalid_builtin_activation_cache = uint64_t(builtin_protocol_feature_entry::not_active) << 32;
+   mutable std::atomic<uint64_t>          _builtin_activation_cache{ invalid_builtin_activation_cache };
+
+   bool refresh_builtin_activation_cache( uint32_t indx, uint32_t current_block_num )const;
 };
 
 } } // namespace eosio::chain
@@ -4,6 +4,7 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <chainbase/chainbase.hpp>
+#include <memory>
 #include <set>
 
 namespace eosio { namespace chain { namespace resource_limits {
@@ -47,18 +48,53 @@ namespace eosio { namespace chain { namespace resource_limits {
       }
    };
 
+   namespace impl {
+      struct pending_account_usage;
+      struct pending_usage_state;
+   }
+
    struct account_resource_limit {
       int64_t used = 0; ///< quantity used in current window
       int64_t available = 0; ///< quantity available in current window (based upon fractional reserve)
       int64_t max = 0; ///< max per window under current congestion
    };
 
+   /**
+    * CPU and NET usage billed to accounts while a block is being built is accumulated in memory and only written
+    * to chainbase, once per account, by process_block_usage. Chainbase undo sessions therefore do not cover
+    * the accumulated usage, every undo session that may contain usage changes must be paired with a
+    * usage_session started right after it and squashed, undone or pushed together with it.
+    */
    class resource_limits_manager {
       public:
-         explicit resource_limits_manager(chainbase::database& db)
-         :_db(db)
-         {
-         }
+         class usage_session {
+            public:
+               usage_session( usage_session&& mv );
+               usage_session& operator=( usage_session&& mv );
+               ~usage_session();
+
+               usage_session( const usage_session& ) = delete;
+               usage_session& operator=( const usage_session& ) = delete;
+
+               /// merge the usage accumulated in this session into the enclosing one
+               void squash();
+               /// discard the usage accumulated in this session
+               void undo();
+               /// keep the usage accumulated in this session
+               void push();
+
+            private:
+               friend class resource_limits_manager;
+               usage_session( resource_limits_manager& rl, uint64_t level_id );
+
+               resource_limits_manager* _rl = nullptr;
+               uint64_t                 _level_id = 0;
+         };
+
+         explicit resource_limits_manager(chainbase::database& db);
+         ~resource_limits_manager();
+
+         usage_session start_usage_session();
 
          void add_indices();
          void initialize_database();
@@ -71,7 +107,8 @@ namespace eosio { namespace chain { namespace resource_limits {
          void update_account_usage( const flat_set<account_name>& accounts, uint32_t ordinal );
          void add_transaction_usage( const flat_set<account_name>& accounts, uint64_t cpu_usage, uint64_t net_usage, uint32_t ordinal );
 
-         void add_pending_ram_usage( const account_name account, int64_t ram_delta );
+         /// with verify, also checks the resulting usage against the ram limit of account, like verify_account_ram_usage
+         void add_pending_ram_usage( const account_name account, int64_t ram_delta, bool verify = false );
          void verify_account_ram_usage( const account_name accunt )const;
 
          /// set_account_limits returns true if new ram_bytes limit is more restrictive than the previously set one
@@ -97,7 +134,13 @@ namespace eosio { namespace chain { namespace resource_limits {
          int64_t get_account_ram_usage( const account_name& name ) const;
 
       private:
-         chainbase::database& _db;
+         const impl::pending_account_usage* find_pending_usage( const account_name& account )const;
+         impl::pending_account_usage&       modify_pending_usage( const account_name& account );
+         void                               end_usage_session( uint64_t level_id, bool undo );
+         void                               verify_ram_usage( const account_name account, uint64_t ram_usage )const;
+
+         chainbase::database&                        _db;
+         std::unique_ptr<impl::pending_usage_state>  _pending;
    };
 } } } /// eosio::chain
 
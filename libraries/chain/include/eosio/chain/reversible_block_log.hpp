@@ -0,0 +1,78 @@
+#pragma once
+#include <eosio/chain/block.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/cfile.hpp>
+#include <deque>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Blocks that have been applied but are not yet irreversible, persisted so that they can be replayed after a
+    * restart. The log is a single append only file of consecutive blocks:
+    *
+    * +-------+---------+-----------+------+----------------------+-----------+------+-----
+    * | Magic | Version | Block Num | Size | packed signed_block  | Block Num | Size | ...
+    * +-------+---------+-----------+------+----------------------+-----------+------+-----
+    *
+    * Popped blocks are truncated from the end of the file. Blocks that became irreversible are only dropped from
+    * the in-memory index; the file is rewritten without them once they take up more space than the remaining
+    * blocks. The index of block positions is rebuilt by a scan of the file when the log is opened, a block cut
+    * short by an unclean shutdown ends the scan and is dropped.
+    */
+   class reversible_block_log {
+      public:
+         /**
+          * @param read_only  the file is neither created nor modified, a dropped block stays in the file
+          */
+         explicit reversible_block_log( const fc::path& reversible_dir, bool read_only = false );
+         reversible_block_log( const reversible_block_log& ) = delete;
+         reversible_block_log& operator=( const reversible_block_log& ) = delete;
+         ~reversible_block_log();
+
+         /// b has to be the block following last_block_num(), unless the log is empty
+         void append( const signed_block_ptr& b );
+
+         /// drops the blocks up to and including block_num
+         void remove_through( uint32_t block_num );
+
+         /// drops block_num and the blocks after it
+         void truncate_from( uint32_t block_num );
+
+         void clear() { truncate_from( 0 ); }
+
+         /// @return nullptr if block_num is not in the log
+         signed_block_ptr  read_block( uint32_t block_num )const;
+         /// @return an empty id if block_num is not in the log
+         block_id_type     read_block_id( uint32_t block_num )const;
+         /// @return the block as packed by fc::raw::pack, or an empty vector if block_num is not in the log
+         std::vector<char> read_serialized_block( uint32_t block_num )const;
+
+         bool     empty()const { return positions.empty(); }
+         bool     contains( uint32_t block_num )const {
+            return !empty() && first_num <= block_num && block_num <= last_block_num();
+         }
+         uint32_t first_block_num()const { return first_num; }
+         uint32_t last_block_num()const { return first_num + positions.size() - 1; }
+
+         /// true if the scan on open found a block cut short, or data that is not a block, at the end of the file
+         bool     dropped_partial_block()const { return dropped_partial; }
+
+         static const uint32_t magic_number;
+         static const uint32_t version;
+
+      private:
+         void     scan();
+         void     reopen( const char* mode );
+         void     truncate_file( uint64_t size );
+         void     reclaim();
+
+         fc::path                  log_path;
+         bool                      read_only = false;
+         mutable fc::cfile         log_file;
+         uint32_t                  first_num = 0;
+         std::deque<uint64_t>      positions;        ///< file position of first_num + i
+         uint64_t                  end_pos = 0;      ///< file position after the last block
+         bool                      dropped_partial = false;
+   };
+
+} } // eosio::chain
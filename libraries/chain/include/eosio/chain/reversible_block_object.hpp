@@ -8,6 +8,9 @@
 
 namespace eosio { namespace chain {
 
+   /**
+    * Reversible blocks database of older versions, only read to convert it into a reversible_block_log
+    */
    class reversible_block_object : public chainbase::object<reversible_block_object_type, reversible_block_object> {
       OBJECT_CTOR(reversible_block_object,(packedblock) )
 
@@ -0,0 +1,55 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   namespace detail { struct signature_recovery_cache_impl; }
+
+   /**
+    * Bounded, thread safe, process wide cache of public keys recovered from (signature, digest) pairs.
+    *
+    * The same transaction is usually received from several peers and later again inside a block, each time its
+    * signatures would otherwise be recovered from scratch. Contracts verifying signatures with the recover_key and
+    * assert_recover_key intrinsics share it, as the same transaction is executed speculatively, again from the
+    * unapplied queue and once more in the block. Least recently used entries are evicted first.
+    * Only successful recoveries are cached.
+    */
+   class signature_recovery_cache {
+      public:
+         struct stats {
+            uint64_t hits     = 0;
+            uint64_t misses   = 0;
+            size_t   size     = 0;
+            size_t   capacity = 0;
+         };
+
+         static signature_recovery_cache& instance();
+
+         ~signature_recovery_cache();
+
+         /**
+          * @return public key that produced sig over digest, from the cache if available
+          * @param check_canonical false for the intrinsics, which accept non canonical signatures; an entry recovered
+          * without the check is not used for a recovery requiring it
+          */
+         public_key_type recover( const signature_type& sig, const digest_type& digest, bool check_canonical = true );
+
+         /// a capacity of 0 disables the cache, shrinking evicts the least recently used entries
+         void set_capacity( size_t capacity );
+
+         stats get_stats()const;
+
+         /// removes all entries and resets the hit/miss counters
+         void clear();
+
+      private:
+         signature_recovery_cache();
+
+         std::unique_ptr<detail::signature_recovery_cache_impl> my;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::signature_recovery_cache::stats, (hits)(misses)(size)(capacity) )
@@ -2,8 +2,13 @@
 
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/variant_object.hpp>
 #include <boost/core/demangle.hpp>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <map>
 #include <ostream>
 
 namespace eosio { namespace chain {
@@ -110,8 +115,47 @@ namespace eosio { namespace chain {
       snapshot_row_writer<T> make_row_writer( const T& data) {
          return snapshot_row_writer<T>(data);
       }
+
+      struct vector_append_stream {
+         explicit vector_append_stream(std::vector<char>& data)
+         :data(data) {}
+
+         bool write( const char* d, size_t s ) {
+            data.insert(data.end(), d, d + s);
+            return true;
+         }
+
+         bool put(char c) {
+            data.push_back(c);
+            return true;
+         }
+
+         std::vector<char>& data;
+      };
    }
 
+   /**
+    * Packed rows of a part of a section, serialized apart from any snapshot_writer so that sections, and shards of
+    * a large section, can be serialized on different threads. It has the add_row interface of
+    * snapshot_writer::section_writer.
+    */
+   class snapshot_section_shard {
+      public:
+         template<typename T>
+         void add_row( const T& row, const chainbase::database& db ) {
+            detail::vector_append_stream out(_data);
+            detail::make_row_writer(detail::snapshot_row_traits<T>::to_snapshot_row(row, db)).write_stream(out);
+            ++_row_count;
+         }
+
+         const std::vector<char>& data() const { return _data; }
+         uint64_t row_count() const { return _row_count; }
+
+      private:
+         std::vector<char> _data;
+         uint64_t          _row_count = 0;
+   };
+
    class snapshot_writer {
       public:
          class section_writer {
@@ -146,17 +190,143 @@ namespace eosio { namespace chain {
 
       virtual ~snapshot_writer(){};
 
+      /// true if the writer can append the packed rows of a snapshot_section_shard with write_shard
+      virtual bool supports_shards() const { return false; }
+
       protected:
+         friend class concurrent_section_writer;
+
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
          virtual void write_end_section() = 0;
+         virtual void write_shard( const snapshot_section_shard& ) {
+            EOS_THROW(snapshot_exception, "Snapshot writer does not support section shards");
+         }
    };
 
    using snapshot_writer_ptr = std::shared_ptr<snapshot_writer>;
 
+   /**
+    * Serializes the shards of sections on a thread pool and appends them to a snapshot_writer in the order they were
+    * added, leaving the snapshot identical to one written section by section. At most max_pending shards are
+    * serialized ahead of the writer to bound the memory held. Writers that do not support shards get the sections
+    * written directly, on the calling thread.
+    *
+    * The shard functions run concurrently and so may only read the state they serialize, which must not be modified
+    * until finish() returns or the concurrent_section_writer is destroyed.
+    */
+   class concurrent_section_writer {
+      public:
+         concurrent_section_writer( snapshot_writer& writer, boost::asio::io_context& thread_pool, size_t max_pending );
+         ~concurrent_section_writer();
+
+         /// calls f(section, shard) for shard in [0, num_shards), possibly concurrently, to write the rows of a section
+         template<typename F>
+         void add_section( const std::string& section_name, size_t num_shards, F f ) {
+            if( !_writer.supports_shards() ) {
+               _writer.write_section(section_name, [&f, num_shards]( auto& section ) {
+                  for( size_t shard = 0; shard < num_shards; ++shard ) {
+                     f(section, shard);
+                  }
+               });
+               return;
+            }
+
+            for( size_t shard = 0; shard < num_shards; ++shard ) {
+               add_shard( shard == 0 ? section_name : std::string(), shard == 0, shard + 1 == num_shards,
+                          [f, shard]( snapshot_section_shard& section ) { f(section, shard); } );
+            }
+            if( num_shards == 0 ) {
+               add_shard( section_name, true, true, []( snapshot_section_shard& ) {} );
+            }
+         }
+
+         template<typename F>
+         void add_section( const std::string& section_name, F f ) {
+            add_section(section_name, 1, [f]( auto& section, size_t ) { f(section); });
+         }
+
+         template<typename T, typename F>
+         void add_section( F f ) {
+            add_section(detail::snapshot_section_traits<T>::section_name(), f);
+         }
+
+         /// writes all added sections, rethrowing the first exception of a shard function
+         void finish();
+
+      private:
+         struct pending_shard {
+            std::string                         section_name;
+            bool                                first = false;
+            bool                                last = false;
+            std::future<snapshot_section_shard> shard;
+         };
+
+         void add_shard( std::string section_name, bool first, bool last, std::function<void(snapshot_section_shard&)> f );
+         void write_front();
+
+         snapshot_writer&           _writer;
+         boost::asio::io_context&   _thread_pool;
+         size_t                     _max_pending;
+         std::deque<pending_shard>  _pending;
+   };
+
    namespace detail {
+      /**
+       * Reads an istream through a large buffer so that rows are unpacked from memory instead of calling into the
+       * istream for every field of every row. The istream must not be read or repositioned directly until reset().
+       */
+      class buffered_istream {
+         public:
+            explicit buffered_istream(std::istream& in)
+            :in(in) {}
+
+            bool read( char* d, size_t s ) {
+               while (s > 0) {
+                  if (pos == buffer.size()) {
+                     fill();
+                  }
+                  const size_t n = std::min(s, buffer.size() - pos);
+                  memcpy(d, buffer.data() + pos, n);
+                  pos += n;
+                  d += n;
+                  s -= n;
+               }
+               return true;
+            }
+
+            bool get( char& c ) {
+               if (pos == buffer.size()) {
+                  fill();
+               }
+               c = buffer[pos++];
+               return true;
+            }
+
+            /// discards the buffered data, after repositioning the istream
+            void reset() {
+               buffer.clear();
+               pos = 0;
+            }
+
+            static constexpr size_t buffer_size = 1024*1024;
+
+         private:
+            void fill() {
+               buffer.resize(buffer_size);
+               in.read(buffer.data(), buffer.size());
+               buffer.resize(in.gcount());
+               pos = 0;
+               EOS_ASSERT(!buffer.empty(), snapshot_exception, "Binary snapshot ended inside of a row");
+            }
+
+            std::istream&     in;
+            std::vector<char> buffer;
+            size_t            pos = 0;
+      };
+
       struct abstract_snapshot_row_reader {
-         virtual void provide(std::istream& in) const = 0;
+         virtual void provide(buffered_istream& in) const = 0;
          virtual void provide(const fc::variant&) const = 0;
          virtual std::string row_type_name() const = 0;
       };
@@ -196,7 +366,7 @@ namespace eosio { namespace chain {
          :data(data) {}
 
 
-         void provide(std::istream& in) const override {
+         void provide(buffered_istream& in) const override {
             row_validation_helper::apply(data, [&in,this](){
                fc::raw::unpack(in, data);
             });
@@ -333,6 +503,8 @@ namespace eosio { namespace chain {
          void write_start_section( const std::string& section_name ) override;
          void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
          void write_end_section( ) override;
+         void write_shard( const snapshot_section_shard& shard ) override;
+         bool supports_shards() const override { return true; }
          void finalize();
 
          static const uint32_t magic_number = 0x30510550;
@@ -359,13 +531,130 @@ namespace eosio { namespace chain {
 
       private:
          bool validate_section() const;
+         const std::map<std::string, std::pair<std::streampos, uint64_t>>& section_index();
 
          std::istream&  snapshot;
          std::streampos header_pos;
          uint64_t       num_rows;
          uint64_t       cur_row;
+         /// rows of the current section are read through the buffer
+         detail::buffered_istream rows;
+         /// position of the first row and row count of each section by name, built on first use
+         fc::optional<std::map<std::string, std::pair<std::streampos, uint64_t>>> sections;
    };
 
+   namespace detail {
+      struct compressed_snapshot_chunk {
+         uint64_t offset            = 0; ///< in the uncompressed snapshot
+         uint64_t compressed_offset = 0; ///< of the zlib stream from the start of the container
+         uint32_t size              = 0;
+         uint32_t compressed_size   = 0;
+      };
+
+      /// bytes rewritten after the chunk holding them was compressed, e.g. the size of a section
+      struct compressed_snapshot_patch {
+         uint64_t          offset = 0; ///< in the uncompressed snapshot
+         std::vector<char> data;
+      };
+
+      struct compressed_snapshot_directory {
+         std::vector<compressed_snapshot_chunk> chunks;
+         std::vector<compressed_snapshot_patch> patches;
+      };
+
+      /// writable and seekable view of a binary snapshot, stored as chunks of independent zlib streams
+      class compressing_snapshot_streambuf : public std::streambuf {
+         public:
+            compressing_snapshot_streambuf(std::ostream& out, uint32_t chunk_size);
+
+            /// writes the last chunk and the directory, nothing can be written afterwards
+            void finish();
+
+         protected:
+            std::streamsize xsputn( const char* s, std::streamsize n ) override;
+            int_type overflow( int_type c ) override;
+            pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override;
+            pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override;
+
+         private:
+            void compress_chunk();
+
+            std::ostream&                 out;
+            std::streampos                start_pos;
+            uint32_t                      chunk_size;
+            compressed_snapshot_directory directory;
+            std::vector<char>             chunk;                 ///< uncompressed data after the compressed chunks
+            uint64_t                      chunk_offset = 0;      ///< uncompressed offset of chunk
+            uint64_t                      pos = 0;               ///< uncompressed write position
+            uint64_t                      compressed_offset = 0; ///< from start_pos, where the next chunk is written
+      };
+
+      /// readable and seekable view of the binary snapshot in a compressed snapshot container
+      class decompressing_snapshot_streambuf : public std::streambuf {
+         public:
+            explicit decompressing_snapshot_streambuf(std::istream& in);
+
+         protected:
+            int_type underflow() override;
+            pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override;
+            pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override;
+
+         private:
+            void load_chunk( size_t index );
+
+            std::istream&                 in;
+            std::streampos                start_pos;
+            compressed_snapshot_directory directory;
+            uint64_t                      size = 0;  ///< of the uncompressed snapshot
+            size_t                        cur_chunk = std::numeric_limits<size_t>::max();
+            std::vector<char>             data;      ///< uncompressed cur_chunk
+      };
+
+      // members are constructed ahead of the snapshot writer and reader bases using their streams
+      struct compressed_snapshot_ostream {
+         compressed_snapshot_ostream(std::ostream& out, uint32_t chunk_size)
+         :buf(out, chunk_size), stream(&buf) {}
+
+         compressing_snapshot_streambuf buf;
+         std::ostream                   stream;
+      };
+
+      struct compressed_snapshot_istream {
+         explicit compressed_snapshot_istream(std::istream& in)
+         :buf(in), stream(&buf) {}
+
+         decompressing_snapshot_streambuf buf;
+         std::istream                     stream;
+      };
+   }
+
+   /**
+    * Writes the binary snapshot of ostream_snapshot_writer compressed, as chunks of independent zlib streams
+    * followed by a directory of the chunks. Readers seek to a section by decompressing only the chunks they read.
+    */
+   class compressed_ostream_snapshot_writer : private detail::compressed_snapshot_ostream, public ostream_snapshot_writer {
+      public:
+         explicit compressed_ostream_snapshot_writer(std::ostream& snapshot, uint32_t chunk_size = default_chunk_size);
+
+         void finalize();
+
+         static const uint32_t magic_number = 0x30510551;
+         static const uint32_t container_version = 1;
+         static const uint32_t default_chunk_size = 4*1024*1024;
+   };
+
+   /// reads the snapshots of compressed_ostream_snapshot_writer, the stream must be seekable
+   class compressed_istream_snapshot_reader : private detail::compressed_snapshot_istream, public istream_snapshot_reader {
+      public:
+         explicit compressed_istream_snapshot_reader(std::istream& snapshot);
+
+         /// @return true if snapshot, at its current position, holds a compressed snapshot container
+         static bool is_compressed( std::istream& snapshot );
+   };
+
+   /// @return reader of the binary snapshot in snapshot, compressed or not
+   std::shared_ptr<istream_snapshot_reader> make_istream_snapshot_reader( std::istream& snapshot );
+
    class integrity_hash_snapshot_writer : public snapshot_writer {
       public:
          explicit integrity_hash_snapshot_writer(fc::sha256::encoder&  enc);
@@ -373,6 +662,8 @@ namespace eosio { namespace chain {
          void write_start_section( const std::string& section_name ) override;
          void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
          void write_end_section( ) override;
+         void write_shard( const snapshot_section_shard& shard ) override;
+         bool supports_shards() const override { return true; }
          void finalize();
 
       private:
@@ -381,3 +672,7 @@ namespace eosio { namespace chain {
    };
 
 }}
+
+FC_REFLECT( eosio::chain::detail::compressed_snapshot_chunk, (offset)(compressed_offset)(size)(compressed_size) )
+FC_REFLECT( eosio::chain::detail::compressed_snapshot_patch, (offset)(data) )
+FC_REFLECT( eosio::chain::detail::compressed_snapshot_directory, (chunks)(patches) )
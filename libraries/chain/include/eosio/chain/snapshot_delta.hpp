@@ -0,0 +1,44 @@
+#pragma once
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <istream>
+#include <ostream>
+
+namespace eosio { namespace chain {
+
+   /**
+    * A snapshot delta turns the binary snapshot it was written against, its base, into a later binary snapshot, its
+    * target, and is usually a small fraction of the size of the target when few rows changed in between.
+    *
+    * Both snapshots are split into content defined chunks, so that rows inserted or removed only shift the chunk
+    * boundaries around them. The delta is a sequence of copies of chunks found in the base and of the literal bytes of
+    * the others. It records the digests of the uncompressed base and target, applying it checks both, so that a chain
+    * of deltas can only be applied in order on top of the right base.
+    *
+    * Snapshots are read compressed or not, the target is always produced uncompressed.
+    */
+   namespace snapshot_delta {
+      static const uint32_t magic_number = 0x30510552;
+      static const uint32_t version = 1;
+
+      struct header {
+         fc::sha256 base_digest;   ///< of the uncompressed base snapshot
+         fc::sha256 target_digest; ///< of the uncompressed target snapshot
+         uint64_t   target_size = 0;
+      };
+
+      /// writes to delta the delta from base to target, both seekable, returns its header
+      header write( std::istream& base, std::istream& target, std::ostream& delta );
+
+      /// writes to target the uncompressed snapshot of base, seekable, with delta applied
+      header apply( std::istream& base, std::istream& delta, std::ostream& target );
+
+      /// @return true if in, at its current position, holds a snapshot delta
+      bool is_delta( std::istream& in );
+   }
+
+}}
+
+FC_REFLECT( eosio::chain::snapshot_delta::header, (base_digest)(target_digest)(target_size) )
@@ -0,0 +1,52 @@
+#pragma once
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   struct startup_phase {
+      std::string    name;
+      fc::time_point start;
+      int64_t        duration_us = 0;
+   };
+
+   /**
+    * Process wide record of how long each phase of the startup of nodeos took, logged as each phase ends and kept for
+    * the get_startup_timing api. Phases may overlap when they run concurrently. Thread safe.
+    */
+   class startup_timeline {
+      public:
+         static startup_timeline& instance();
+
+         /// records the phase name from start until now
+         void record( std::string name, const fc::time_point& start );
+
+         /// records a phase from its construction until its destruction
+         class scope {
+            public:
+               explicit scope( std::string name ) : _name( std::move( name ) ), _start( fc::time_point::now() ) {}
+               ~scope() { startup_timeline::instance().record( std::move( _name ), _start ); }
+
+               scope( const scope& ) = delete;
+               scope& operator=( const scope& ) = delete;
+
+            private:
+               std::string    _name;
+               fc::time_point _start;
+         };
+
+         /// by start time
+         std::vector<startup_phase> get()const;
+
+      private:
+         mutable std::mutex           _mtx;
+         std::vector<startup_phase>   _phases;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::startup_phase, (name)(start)(duration_us) )
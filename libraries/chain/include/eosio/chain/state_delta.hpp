@@ -0,0 +1,184 @@
+#pragma once
+#include <eosio/chain/database_utils.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <fc/io/raw.hpp>
+
+#include <type_traits>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      /// rows are packed through their reflection, plus the members the reflection leaves out
+      template<typename T, typename = void>
+      struct state_delta_row_traits {
+         template<typename Stream>
+         static void pack( Stream& s, const T& row ) { fc::raw::pack( s, row ); }
+         template<typename Stream>
+         static void unpack( Stream& s, T& row ) { fc::raw::unpack( s, row ); }
+      };
+
+      /// contract table rows do not reflect the table they belong to
+      template<typename T>
+      struct state_delta_row_traits<T, std::void_t<decltype(std::declval<T>().t_id)>> {
+         template<typename Stream>
+         static void pack( Stream& s, const T& row ) {
+            fc::raw::pack( s, row.t_id._id );
+            fc::raw::pack( s, row );
+         }
+         template<typename Stream>
+         static void unpack( Stream& s, T& row ) {
+            fc::raw::unpack( s, row.t_id._id );
+            fc::raw::unpack( s, row );
+         }
+      };
+
+      template<>
+      struct state_delta_row_traits<resource_limits::resource_limits_object> {
+         template<typename Stream>
+         static void pack( Stream& s, const resource_limits::resource_limits_object& row ) {
+            fc::raw::pack( s, row.pending );
+            fc::raw::pack( s, row );
+         }
+         template<typename Stream>
+         static void unpack( Stream& s, resource_limits::resource_limits_object& row ) {
+            fc::raw::unpack( s, row.pending );
+            fc::raw::unpack( s, row );
+         }
+      };
+   }
+
+   /**
+    * Compact record of the changes a block made to chainbase, taken from the undo state of the block session
+    * right before it is pushed. Rows are kept packed in process memory, outside of the database segment.
+    *
+    * Applying the record on top of the state the block was originally applied to reproduces the state after
+    * the block without executing its transactions. Only chainbase is covered; the caller is responsible for any
+    * state held elsewhere.
+    */
+   struct state_delta {
+      struct index_delta {
+         uint32_t                     index = 0;      ///< position of the index within the index_set it was captured from
+         vector<int64_t>              removed_ids;
+         vector<pair<int64_t, bytes>> modified_rows;
+         vector<pair<int64_t, bytes>> created_rows;   ///< in ascending id order
+      };
+
+      vector<index_delta> indices;
+      size_t              size = 0; ///< approximate number of bytes held by the record
+
+      /**
+       * @return the record of the last undo session of db, or an empty optional if a table of UnsupportedSet was
+       * modified by the session or the record would grow beyond max_size bytes
+       */
+      template<typename DeltaSet, typename UnsupportedSet>
+      static optional<state_delta> capture( const chainbase::database& db, size_t max_size );
+
+      /**
+       * Applies the record to db, which must be in the state the block was applied to.
+       * @return false if the state of db does not match the record, db is then left partially modified and the
+       * enclosing undo session must be undone
+       */
+      template<typename DeltaSet>
+      bool apply( chainbase::database& db )const;
+   };
+
+   template<typename DeltaSet, typename UnsupportedSet>
+   optional<state_delta> state_delta::capture( const chainbase::database& db, size_t max_size ) {
+      bool supported = true;
+      UnsupportedSet::walk_indices( [&db, &supported]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         const auto& index = db.get_index<index_t>();
+         if( index.stack().empty() ) return;
+         const auto& undo = index.stack().back();
+         if( !undo.old_values.empty() || !undo.removed_values.empty() || !undo.new_ids.empty() )
+            supported = false;
+      });
+      if( !supported ) return {};
+
+      state_delta result;
+      uint32_t pos = 0;
+      DeltaSet::walk_indices( [&db, &result, &pos, &supported, max_size]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         using value_t = typename index_t::value_type;
+         const auto& index = db.get_index<index_t>();
+         const uint32_t index_pos = pos++;
+         if( !supported || index.stack().empty() ) return;
+
+         const auto& undo = index.stack().back();
+         if( undo.old_values.empty() && undo.removed_values.empty() && undo.new_ids.empty() ) return;
+
+         auto pack_row = [&result]( const value_t& row ) {
+            bytes packed;
+            fc::datastream<size_t> ps;
+            detail::state_delta_row_traits<value_t>::pack( ps, row );
+            packed.resize( ps.tellp() );
+            fc::datastream<char*> ds( packed.data(), packed.size() );
+            detail::state_delta_row_traits<value_t>::pack( ds, row );
+            result.size += packed.size() + sizeof(int64_t);
+            return packed;
+         };
+
+         index_delta delta;
+         delta.index = index_pos;
+         delta.removed_ids.reserve( undo.removed_values.size() );
+         for( const auto& removed : undo.removed_values ) {
+            delta.removed_ids.push_back( removed.first._id );
+         }
+         result.size += delta.removed_ids.size() * sizeof(int64_t);
+         delta.modified_rows.reserve( undo.old_values.size() );
+         for( const auto& old : undo.old_values ) {
+            delta.modified_rows.emplace_back( old.first._id, pack_row( index.get( old.first ) ) );
+         }
+         delta.created_rows.reserve( undo.new_ids.size() );
+         for( const auto& id : undo.new_ids ) {
+            delta.created_rows.emplace_back( id._id, pack_row( index.get( id ) ) );
+         }
+         result.indices.emplace_back( std::move(delta) );
+
+         if( result.size > max_size ) supported = false;
+      });
+      if( !supported ) return {};
+
+      return result;
+   }
+
+   template<typename DeltaSet>
+   bool state_delta::apply( chainbase::database& db )const {
+      bool matches = true;
+      auto next = indices.begin();
+      uint32_t pos = 0;
+      DeltaSet::walk_indices( [this, &db, &matches, &next, &pos]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         using value_t = typename index_t::value_type;
+         const uint32_t index_pos = pos++;
+         if( !matches || next == indices.end() || next->index != index_pos ) return;
+         const index_delta& delta = *next++;
+
+         auto unpack_row = []( const bytes& packed, value_t& row ) {
+            fc::datastream<const char*> ds( packed.data(), packed.size() );
+            detail::state_delta_row_traits<value_t>::unpack( ds, row );
+         };
+
+         // removals first so that unique keys released by the block are free again for the rows that took them
+         for( const auto& id : delta.removed_ids ) {
+            const auto* row = db.find<value_t>( typename value_t::id_type(id) );
+            if( !row ) { matches = false; return; }
+            db.remove( *row );
+         }
+         for( const auto& modified : delta.modified_rows ) {
+            const auto* row = db.find<value_t>( typename value_t::id_type(modified.first) );
+            if( !row ) { matches = false; return; }
+            db.modify( *row, [&]( value_t& r ) { unpack_row( modified.second, r ); } );
+         }
+         // rows are created in the order of their original ids, which they receive again from the index if no
+         // row the block created and removed again was in between
+         for( const auto& created : delta.created_rows ) {
+            const auto& row = db.create<value_t>( [&]( value_t& r ) { unpack_row( created.second, r ); } );
+            if( row.id._id != created.first ) { matches = false; return; }
+         }
+      });
+
+      return matches && next == indices.end();
+   }
+
+} } /// eosio::chain
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <eosio/chain/block_timestamp.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace eosio { namespace chain {
+
+/**
+ * CPU time a node spent executing the transactions of each account which the chain did not bill, e.g. runs of
+ * transactions which failed, accumulated like the on-chain usage of an account: averaged over a window of block
+ * slots, so that it decays to nothing within the window once the account stops.
+ *
+ * An account over its budget is not refused, its transactions wait until those of the accounts within theirs.
+ */
+class subjective_cpu_ledger {
+public:
+   /// @param budget_us CPU per window an account may use before it is over budget, 0 to disable the ledger
+   void set_budget( uint64_t budget_us, fc::microseconds window ) {
+      _budget_us = budget_us;
+      _window_size = std::max<uint32_t>( 1, window.count() / (config::block_interval_ms * 1000) );
+      if( !enabled() ) _accounts.clear();
+   }
+
+   bool enabled()const { return _budget_us > 0; }
+   uint64_t budget_us()const { return _budget_us; }
+
+   void record( account_name account, uint64_t cpu_us, const fc::time_point& now ) {
+      if( !enabled() || cpu_us == 0 ) return;
+      auto& acc = _accounts[account];
+      acc.add( cpu_us, std::max( ordinal_of( now ), acc.last_ordinal ), _window_size );
+   }
+
+   /// CPU of account over the window ending at now
+   uint64_t usage_us( account_name account, const fc::time_point& now )const {
+      auto itr = _accounts.find( account );
+      if( itr == _accounts.end() ) return 0;
+      auto acc = itr->second;
+      acc.add( 0, std::max( ordinal_of( now ), acc.last_ordinal ), _window_size );
+      return acc.average() * _window_size;
+   }
+
+   bool over_budget( account_name account, const fc::time_point& now )const {
+      return enabled() && usage_us( account, now ) > _budget_us;
+   }
+
+   /// forgets the accounts which have used nothing during the window ending at now
+   void prune( const fc::time_point& now ) {
+      const uint64_t ordinal = ordinal_of( now );
+      for( auto itr = _accounts.begin(); itr != _accounts.end(); ) {
+         if( uint64_t( itr->second.last_ordinal ) + _window_size <= ordinal ) itr = _accounts.erase( itr );
+         else ++itr;
+      }
+   }
+
+   size_t size()const { return _accounts.size(); }
+
+private:
+   static uint32_t ordinal_of( const fc::time_point& now ) {
+      return block_timestamp_type( now ).slot;
+   }
+
+   uint64_t                                                    _budget_us = 0;
+   uint32_t                                                    _window_size = 1;
+   std::map<account_name, resource_limits::usage_accumulator>  _accounts;
+};
+
+} } //eosio::chain
@@ -58,6 +58,9 @@ namespace eosio {
          public:
 
             static constexpr uint8_t max_precision = 18;
+            static constexpr size_t max_name_length = 7;
+            /// "255,ABCDEFG", the precision of an invalid symbol included
+            static constexpr size_t max_string_length = 4 + max_name_length;
 
             explicit symbol(uint8_t p, const char* s): m_value(string_to_symbol(p, s)) {
                EOS_ASSERT(valid(), symbol_type_exception, "invalid symbol: ${s}", ("s",s));
@@ -82,8 +85,12 @@ namespace eosio {
             uint64_t value() const { return m_value; }
             bool valid() const
             {
-               const auto& s = name();
-               return decimals() <= max_precision && valid_name(s);
+               if( decimals() > max_precision ) return false;
+               for( uint64_t v = m_value >> 8; v > 0; v >>= 8 ) {
+                  const char c = v & 0xFF;
+                  if( c < 'A' || c > 'Z' ) return false;
+               }
+               return true;
             }
             static bool valid_name(const string& name)
             {
@@ -101,29 +108,35 @@ namespace eosio {
                }
                return p10;
             }
+            /// writes the name at buf, which must have room for max_name_length, and returns the end of it
+            char* name_to_chars( char* buf ) const
+            {
+               for( uint64_t v = m_value >> 8; v > 0; v >>= 8 )
+                  *buf++ = v & 0xFF;
+               return buf;
+            }
             string name() const
             {
-               uint64_t v = m_value;
-               v >>= 8;
-               string result;
-               while (v > 0) {
-                  char c = v & 0xFF;
-                  result += c;
-                  v >>= 8;
-               }
-               return result;
+               char buf[max_name_length];
+               return string( buf, name_to_chars( buf ) );
+            }
+            /// writes "precision,NAME" at buf, which must have room for max_string_length, and returns the end of it
+            char* to_chars( char* buf ) const
+            {
+               uint8_t p = decimals();
+               if( p >= 100 ) *buf++ = '0' + p / 100;
+               if( p >= 10 ) *buf++ = '0' + p / 10 % 10;
+               *buf++ = '0' + p % 10;
+               *buf++ = ',';
+               return name_to_chars( buf );
             }
 
             symbol_code to_symbol_code()const { return {m_value >> 8}; }
 
             explicit operator string() const
             {
-               uint64_t v = m_value;
-               uint8_t p = v & 0xFF;
-               string ret = eosio::chain::to_string(p);
-               ret += ',';
-               ret += name();
-               return ret;
+               char buf[max_string_length];
+               return string( buf, to_chars( buf ) );
             }
 
             string to_string() const { return string(*this); }
@@ -1,17 +1,142 @@
 #pragma once
 
 #include <fc/optional.hpp>
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace eosio { namespace chain {
 
+   /// cpu ids of a list like "0-3,8,10-11"
+   std::vector<uint32_t> parse_cpu_list( const std::string& list );
+   std::string cpu_list_to_string( const std::vector<uint32_t>& cpus );
+
+   /// pins the calling thread, or process pid if not 0, to cpus; false if refused or not supported on the platform
+   bool set_cpu_affinity( const std::vector<uint32_t>& cpus, int pid = 0 );
+
+   /// cpus the calling thread may run on, empty if not supported on the platform
+   std::vector<uint32_t> get_cpu_affinity();
+
+   /// runs the calling thread SCHED_FIFO at priority, or back under the default policy if priority is 0
+   bool set_realtime_priority( int priority );
+
+   /**
+    * Where the named threads of the process were placed. Holds the cpu sets configured for named_thread_pools, which
+    * pin their threads when they start, and records the placement of every thread for the logs and diagnostics.
+    */
+   class thread_placement {
+   public:
+      struct entry {
+         std::string thread;
+         std::string cpus;                  ///< cpus the thread may run on
+         int         realtime_priority = 0; ///< SCHED_FIFO priority, 0 if it runs under the default policy
+      };
+
+      static thread_placement& instance();
+
+      /// must be set before the pools start, keyed by name_prefix
+      void set_pool_cpus( std::map<std::string, std::vector<uint32_t>> cpus );
+      std::vector<uint32_t> pool_cpus( const std::string& name_prefix )const;
+
+      /// records the current placement of the calling thread
+      void record( const std::string& thread, int realtime_priority = 0 );
+      void record( entry e );
+
+      std::vector<entry> get()const;
+
+   private:
+      thread_placement() = default;
+
+      mutable std::mutex                              _mtx;
+      std::map<std::string, std::vector<uint32_t>>    _pool_cpus;
+      std::map<std::string, entry>                    _threads;
+   };
+
+   /**
+    * Process wide set of worker threads shared by the named_thread_pools configured to opt into it.
+    *
+    * An opted in pool keeps its own io_context, so strands, timers and sockets work unchanged, but runs no thread of
+    * its own: it becomes a lane of the shared pool. Every worker has a home lane it waits on when idle and steals
+    * ready handlers from the other lanes, highest priority first, so a backlog in one lane is picked up by every
+    * worker another lane leaves idle. A lane never has more than its max_concurrency workers in it at once.
+    * Queueing latency of every lane is measured by periodically posting a timestamped probe to it.
+    */
+   class shared_thread_pool {
+   public:
+      struct lane_options {
+         uint32_t priority = 0;        ///< ready handlers of lanes with a higher priority are run first
+         uint32_t max_concurrency = 0; ///< most workers running handlers of the lane at once, 0 for the pool threads of the lane
+      };
+
+      struct lane_stats {
+         std::string name;
+         uint64_t    handlers = 0;     ///< handlers run for the lane
+         uint64_t    stolen = 0;       ///< handlers run by a worker the lane is not home to
+         uint64_t    samples = 0;      ///< latency probes run
+         int64_t     avg_latency_us = 0;
+         int64_t     max_latency_us = 0;
+      };
+
+      static shared_thread_pool& instance();
+
+      // stops and joins the workers, lanes must have been removed already
+      ~shared_thread_pool();
+
+      /**
+       * Starts num_threads workers, which must happen before any named_thread_pool opts in.
+       * @param cpus workers are pinned round-robin to these cpus, not pinned if empty
+       * @param lanes named_thread_pools whose name_prefix is listed here opt in
+       */
+      void configure( size_t num_threads, std::vector<uint32_t> cpus, std::map<std::string, lane_options> lanes,
+                      fc::microseconds latency_sample_interval );
+
+      /// options of the lane a named_thread_pool with name_prefix should become, empty if it should run its own threads
+      fc::optional<lane_options> lane_for( const std::string& name_prefix )const;
+
+      void add_lane( const std::string& name, boost::asio::io_context& ioc, lane_options options, size_t default_concurrency );
+
+      /// returns once no worker runs handlers of ioc anymore
+      void remove_lane( boost::asio::io_context& ioc );
+
+      std::vector<lane_stats> get_stats()const;
+
+   private:
+      struct lane;
+      using lanes_t = std::vector<std::shared_ptr<lane>>;
+
+      shared_thread_pool() = default;
+
+      void run( size_t worker );
+      void sample_latency( const lanes_t& lanes );
+
+      std::vector<std::thread>              _workers;
+      std::vector<uint32_t>                 _cpus;
+      std::map<std::string, lane_options>   _lane_options;
+      fc::microseconds                      _latency_sample_interval;
+      std::atomic<bool>                     _stopping{false};
+      std::atomic<int64_t>                  _next_sample_us{0};
+
+      mutable std::mutex                    _mtx;
+      std::condition_variable               _lanes_changed;
+      std::shared_ptr<const lanes_t>        _lanes;         ///< sorted by priority, protected by _mtx
+      std::atomic<uint64_t>                 _lanes_version{0};
+      std::vector<lane_stats>               _removed_stats; ///< protected by _mtx
+   };
+
    /**
     * Wrapper class for boost asio thread pool and io_context run.
     * Also names threads so that tools like htop can see thread name.
+    * Runs on the shared_thread_pool instead of its own threads if configured to.
     */
    class named_thread_pool {
    public:
@@ -27,12 +152,15 @@ namespace eosio { namespace chain {
       // destroy work guard, stop io_context, join thread_pool, and stop thread_pool
       void stop();
 
+      bool is_shared()const { return _shared; }
+
    private:
       using ioc_work_t = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
 
-      boost::asio::thread_pool       _thread_pool;
+      fc::optional<boost::asio::thread_pool> _thread_pool;
       boost::asio::io_context        _ioc;
       fc::optional<ioc_work_t>       _ioc_work;
+      bool                           _shared = false;
    };
 
 
@@ -46,4 +174,7 @@ namespace eosio { namespace chain {
 
 } } // eosio::chain
 
+FC_REFLECT( eosio::chain::thread_placement::entry, (thread)(cpus)(realtime_priority) )
+FC_REFLECT( eosio::chain::shared_thread_pool::lane_stats, (name)(handlers)(stolen)(samples)(avg_latency_us)(max_latency_us) )
+
 
@@ -133,6 +133,11 @@ namespace eosio { namespace chain {
                                                     bool allow_duplicate_keys = false )const;
    };
 
+   /**
+    * A transaction in its packed form, as sent over the network and stored in blocks, together with the
+    * unpacked form it is validated against. The unpacked form is immutable once constructed and shared
+    * between copies, so copying into a block receipt or a transaction_metadata only copies the packed bytes.
+    */
    struct packed_transaction : fc::reflect_init {
       enum class compression_type {
          none = 0,
@@ -146,14 +151,14 @@ namespace eosio { namespace chain {
       packed_transaction& operator=(packed_transaction&&) = default;
 
       explicit packed_transaction(const signed_transaction& t, compression_type _compression = compression_type::none)
-      :signatures(t.signatures), compression(_compression), unpacked_trx(t), trx_id(unpacked_trx.id())
+      :signatures(t.signatures), compression(_compression), unpacked_trx(std::make_shared<const signed_transaction>(t)), trx_id(unpacked_trx->id())
       {
          local_pack_transaction();
          local_pack_context_free_data();
       }
 
       explicit packed_transaction(signed_transaction&& t, compression_type _compression = compression_type::none)
-      :signatures(t.signatures), compression(_compression), unpacked_trx(std::move(t)), trx_id(unpacked_trx.id())
+      :signatures(t.signatures), compression(_compression), unpacked_trx(std::make_shared<const signed_transaction>(std::move(t))), trx_id(unpacked_trx->id())
       {
          local_pack_transaction();
          local_pack_context_free_data();
@@ -172,10 +177,10 @@ namespace eosio { namespace chain {
       const transaction_id_type& id()const { return trx_id; }
       bytes               get_raw_transaction()const;
 
-      time_point_sec                expiration()const { return unpacked_trx.expiration; }
-      const vector<bytes>&          get_context_free_data()const { return unpacked_trx.context_free_data; }
-      const transaction&            get_transaction()const { return unpacked_trx; }
-      const signed_transaction&     get_signed_transaction()const { return unpacked_trx; }
+      time_point_sec                expiration()const { return unpacked_trx->expiration; }
+      const vector<bytes>&          get_context_free_data()const { return unpacked_trx->context_free_data; }
+      const transaction&            get_transaction()const { return *unpacked_trx; }
+      const signed_transaction&     get_signed_transaction()const { return *unpacked_trx; }
       const vector<signature_type>& get_signatures()const { return signatures; }
       const fc::enum_type<uint8_t,compression_type>& get_compression()const { return compression; }
       const bytes&                  get_packed_context_free_data()const { return packed_context_free_data; }
@@ -183,7 +188,7 @@ namespace eosio { namespace chain {
 
    private:
       void local_unpack_transaction(vector<bytes>&& context_free_data);
-      void local_unpack_context_free_data();
+      vector<bytes> local_unpack_context_free_data()const;
       void local_pack_transaction();
       void local_pack_context_free_data();
 
@@ -198,8 +203,10 @@ namespace eosio { namespace chain {
       bytes                                   packed_trx;
 
    private:
-      // cache unpacked trx, for thread safety do not modify after construction
-      signed_transaction                      unpacked_trx;
+      static const std::shared_ptr<const signed_transaction>& empty_unpacked_trx();
+
+      // cache unpacked trx, shared by copies, for thread safety do not modify after construction
+      std::shared_ptr<const signed_transaction> unpacked_trx = empty_unpacked_trx();
       transaction_id_type                     trx_id;
    };
 
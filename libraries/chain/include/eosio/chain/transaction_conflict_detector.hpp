@@ -0,0 +1,46 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Accounts and contract tables touched while executing a single transaction.
+    * No distinction is made between reads and writes, so the set is a conservative
+    * over-approximation of what the transaction depends on.
+    */
+   struct trx_access_set {
+      flat_set<account_name>                                 accounts;
+      flat_set<std::tuple<account_name, scope_name, table_name>> tables; ///< (code, scope, table)
+
+      void add_account( account_name a ) { accounts.insert( a ); }
+      void add_table( account_name code, scope_name scope, table_name table ) { tables.emplace( code, scope, table ); }
+   };
+
+   /**
+    * Collects the access sets of the transactions of a block, in block order, and partitions them into
+    * groups that share no account and no (code, scope, table) tuple. Transactions in different groups could
+    * be executed independently of each other; transactions in the same group must be executed in block order.
+    */
+   class transaction_conflict_detector {
+      public:
+         /// starts recording a new transaction, the returned pointer stays valid until reset()
+         trx_access_set* begin_transaction();
+
+         /// @return access set of the transaction currently being recorded, nullptr if none has been started
+         trx_access_set* current();
+
+         size_t size()const { return _access_sets.size(); }
+
+         /**
+          * @return indices of the recorded transactions grouped by conflict; groups are ordered by their first
+          * transaction and the indices within each group are in block order
+          */
+         vector<vector<uint32_t>> conflict_groups()const;
+
+         void reset() { _access_sets.clear(); }
+
+      private:
+         deque<trx_access_set> _access_sets;
+   };
+
+} } /// eosio::chain
@@ -1,8 +1,11 @@
 #pragma once
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/transaction_conflict_detector.hpp>
 #include <signal.h>
+#include <future>
 
 namespace eosio { namespace chain {
 
@@ -49,6 +52,16 @@ namespace eosio { namespace chain {
 
          void init_for_deferred_trx( fc::time_point published );
 
+         /// no TaPoS, expiration or duplicate checks and nothing is billed, the caller must undo the transaction
+         void init_for_read_only_trx();
+
+         ~transaction_context();
+
+         /// Starts running the code of the context-free actions on the thread pool, when the wasm runtime allows it,
+         /// while the main thread goes on with the authorization checks; exec() waits for them and takes their results
+         /// in order. Called after init and before exec.
+         void start_context_free_actions();
+
          void exec();
          void finalize();
          void squash();
@@ -93,6 +106,12 @@ namespace eosio { namespace chain {
 
          void execute_action( uint32_t action_ordinal, uint32_t recurse_depth );
 
+         void schedule_context_free_actions();
+         void wait_for_context_free_actions();
+         /// false if the context-free action at action_ordinal was not run ahead with the code of receiver or failed
+         bool take_context_free_result( uint32_t action_ordinal, const account_metadata_object& receiver,
+                                        std::string& console, fc::microseconds& elapsed );
+
          void schedule_transaction();
          void record_transaction( const transaction_id_type& id, fc::time_point_sec expire );
 
@@ -107,6 +126,7 @@ namespace eosio { namespace chain {
          const signed_transaction&     trx;
          transaction_id_type           id;
          optional<chainbase::database::session>  undo_session;
+         optional<resource_limits_manager::usage_session> usage_undo_session;
          transaction_trace_ptr         trace;
          fc::time_point                start;
 
@@ -116,6 +136,8 @@ namespace eosio { namespace chain {
          vector<action_receipt>        executed;
          flat_set<account_name>        bill_to_accounts;
          flat_set<account_name>        validate_ram_usage;
+         /// net ram deltas of the transaction per account, applied to the resource limits in one pass by finalize()
+         flat_map<account_name, int64_t> pending_ram_deltas;
 
          /// the maximum number of virtual CPU instructions of the transaction that can be safely billed to the billable accounts
          uint64_t                      initial_max_billable_cpu = 0;
@@ -124,6 +146,7 @@ namespace eosio { namespace chain {
          bool                          is_input           = false;
          bool                          apply_context_free = true;
          bool                          enforce_whiteblacklist = true;
+         bool                          read_only          = false;
 
          fc::time_point                deadline = fc::time_point::maximum();
          fc::microseconds              leeway = fc::microseconds( config::default_subjective_cpu_leeway_us );
@@ -132,6 +155,9 @@ namespace eosio { namespace chain {
 
          transaction_checktime_timer   transaction_timer;
 
+         /// when set, accounts and tables touched by the transaction are recorded here
+         trx_access_set*               access_set = nullptr;
+
       private:
          bool                          is_initialized = false;
 
@@ -152,6 +178,20 @@ namespace eosio { namespace chain {
          fc::time_point                pseudo_start;
          fc::microseconds              billed_time;
          fc::microseconds              billing_timer_duration_limit;
+
+         struct context_free_result {
+            wasm_instantiated_module_interface* module = nullptr; ///< until waited for, nullptr if not run ahead
+            digest_type                         code_hash;
+            uint8_t                             vm_type = 0;
+            uint8_t                             vm_version = 0;
+            bool                                succeeded = false;
+            std::string                         console;
+            fc::microseconds                    elapsed;
+         };
+
+         bool                          context_free_scheduled = false;
+         vector<context_free_result>   context_free_results; ///< by index in trx.context_free_actions
+         std::future<void>             context_free_task;
    };
 
 } }
@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/transaction_tracing.hpp>
 #include <eosio/chain/types.hpp>
 #include <boost/asio/io_context.hpp>
 #include <future>
@@ -35,6 +36,7 @@ class transaction_metadata {
       const bool                                                 implicit;
       const bool                                                 scheduled;
       bool                                                       accepted = false;  // not thread safe
+      const transaction_trace_context_ptr                        trace; ///< set when the transaction is sampled by transaction_tracing
 
    private:
       struct private_type{};
@@ -49,12 +51,14 @@ class transaction_metadata {
       // creation of tranaction_metadata restricted to start_recover_keys and create_no_recover_keys below, public for make_shared
       explicit transaction_metadata( const private_type& pt, packed_transaction_ptr ptrx,
                                      fc::microseconds sig_cpu_usage, flat_set<public_key_type> recovered_pub_keys,
-                                     bool _implicit = false, bool _scheduled = false)
+                                     bool _implicit = false, bool _scheduled = false,
+                                     transaction_trace_context_ptr _trace = transaction_trace_context_ptr() )
          : _packed_trx( std::move( ptrx ) )
          , _sig_cpu_usage( sig_cpu_usage )
          , _recovered_pub_keys( std::move( recovered_pub_keys ) )
          , implicit( _implicit )
-         , scheduled( _scheduled ) {
+         , scheduled( _scheduled )
+         , trace( std::move( _trace ) ) {
       }
 
       transaction_metadata() = delete;
@@ -70,11 +74,13 @@ class transaction_metadata {
       const flat_set<public_key_type>& recovered_keys()const { return _recovered_pub_keys; }
 
       /// Thread safe.
+      /// @param trace of the transaction, ends a "recover_keys" step once the keys are recovered
       /// @returns transaction_metadata_ptr or exception via future
       static recover_keys_future
       start_recover_keys( packed_transaction_ptr trx, boost::asio::io_context& thread_pool,
                           const chain_id_type& chain_id, fc::microseconds time_limit,
-                          uint32_t max_variable_sig_size = UINT32_MAX );
+                          uint32_t max_variable_sig_size = UINT32_MAX,
+                          transaction_trace_context_ptr trace = transaction_trace_context_ptr() );
 
       /// @returns constructed transaction_metadata with no key recovery (sig_cpu_usage=0, recovered_pub_keys=empty)
       static transaction_metadata_ptr
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/transaction_metadata.hpp>
+
+#include <atomic>
+#include <future>
+
+namespace eosio { namespace chain {
+
+/**
+ * Screening of queued incoming transactions against the chain state on worker threads, while the main thread has
+ * nothing to do with the state but wait, e.g. for the signatures of the block it produced. Transactions which look
+ * bound to fail can then be queued behind the others before the main thread sets them up.
+ *
+ * Transactions are not executed, the checks only read the state: expiration at the next block, existence of the
+ * accounts of the actions and of the authorities they declare, and the CPU available to each authorizer against
+ * the estimated usage of the transaction. The state may change before the transactions are applied, so a failure
+ * is only a prediction.
+ */
+class transaction_prescreener {
+public:
+   struct queued_transaction {
+      transaction_metadata_ptr trx;
+      uint32_t                 cpu_estimate_us = 0; ///< 0 if unknown
+   };
+
+   /// main thread: screens against the current state of chain for a block at block_time
+   transaction_prescreener( const controller& chain, fc::time_point block_time );
+   ~transaction_prescreener();
+
+   transaction_prescreener( const transaction_prescreener& ) = delete;
+   transaction_prescreener& operator=( const transaction_prescreener& ) = delete;
+
+   /// thread safe as long as no thread modifies the state; why trx looks bound to fail, empty if it does not
+   optional<string> screen( const transaction_metadata& trx, uint32_t cpu_estimate_us )const;
+
+   /// screens trxs, in order, on threads of thread_pool until stop() is called; no thread may modify the state meanwhile
+   void start( boost::asio::io_context& thread_pool, uint16_t threads, vector<queued_transaction> trxs );
+
+   /**
+    * Waits for the threads to finish the transactions they are screening.
+    * @return the predicted failures by index of the transactions started with, empty for the ones which were not
+    *         screened or look fine
+    */
+   const vector<optional<string>>& stop();
+
+   const vector<queued_transaction>& transactions()const { return _trxs; }
+   size_t screened()const { return _screened; }
+
+private:
+   const controller&              _chain;
+   const fc::time_point           _block_time;
+   uint32_t                       _min_cpu_us = 0;
+
+   vector<queued_transaction>     _trxs;
+   vector<optional<string>>       _failures;   ///< by index of _trxs, each written by the thread screening it
+   std::atomic<size_t>            _next{0};
+   std::atomic<bool>              _stopping{false};
+   vector<std::future<void>>      _workers;
+   size_t                         _screened = 0;
+};
+
+} } /// eosio::chain
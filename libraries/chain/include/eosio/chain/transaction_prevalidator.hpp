@@ -0,0 +1,72 @@
+#pragma once
+
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/chain_config.hpp>
+#include <eosio/chain/transaction.hpp>
+
+#include <deque>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace chainbase { class database; }
+
+namespace eosio { namespace chain {
+
+/**
+ * Checks of incoming transactions which need no access to the chain state, done on the threads receiving them so
+ * that transactions bound to fail are rejected before their keys are recovered and before they are posted to the
+ * main thread: expiration, TaPoS, inclusion in a recent block and the net usage limits. The state the checks use is
+ * kept up to date by the main thread as blocks are accepted.
+ *
+ * Every check only rejects transactions which the controller would reject as well: the expiration is compared to
+ * the head block time, which the pending block time never precedes, TaPoS entries of blocks popped by a fork switch
+ * are not checked until replaced, and the net usage checked is a lower bound of what the transaction is billed.
+ */
+class transaction_prevalidator {
+public:
+   /// recent transaction ids are dropped, oldest blocks first, beyond this many
+   static constexpr size_t default_max_recent_ids = 1024*1024;
+
+   explicit transaction_prevalidator( size_t max_recent_ids = default_max_recent_ids );
+
+   /// main thread: loads the block summaries of db, whose head is head
+   void reset( const chainbase::database& db, const block_state_ptr& head, const chain_config& cfg );
+   /// main thread
+   void on_accepted_block( const block_state_ptr& bsp, const chain_config& cfg );
+
+   /// thread safe; throws the exception the controller would reject trx with
+   void validate( const packed_transaction& trx )const;
+
+   size_t recent_ids()const;
+
+private:
+   struct recent_block {
+      uint32_t                    block_num = 0;
+      fc::time_point              timestamp;
+      vector<transaction_id_type> ids;
+   };
+
+   struct id_hash {
+      size_t operator()( const transaction_id_type& id )const { return id._hash[0]; }
+   };
+
+   /// prefix of the block referenced by a ref_block_num, or unknown_ref_block
+   static constexpr uint64_t unknown_ref_block = 0;
+   static constexpr uint64_t known_ref_block = uint64_t(1) << 32;
+
+   void set_config( const chain_config& cfg );
+   void pop_recent_block();
+
+   mutable std::shared_mutex                         _mtx;
+   const size_t                                      _max_recent_ids;
+   vector<uint64_t>                                  _ref_blocks; ///< by ref_block_num
+   uint32_t                                          _head_num = 0;
+   fc::time_point                                    _head_time;
+   uint32_t                                          _max_transaction_net_usage = 0;
+   uint32_t                                          _base_per_transaction_net_usage = 0;
+   uint32_t                                          _max_transaction_lifetime = 0;
+   std::deque<recent_block>                          _recent_blocks;   ///< oldest first
+   std::unordered_set<transaction_id_type, id_hash>  _recent_ids;      ///< of the input transactions of _recent_blocks
+};
+
+} } /// eosio::chain
@@ -0,0 +1,86 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   namespace detail { struct transaction_tracing_impl; }
+
+   struct transaction_trace_span {
+      std::string    name;
+      fc::time_point start;
+      fc::time_point end;
+      std::string    detail; ///< exported as the span attribute "detail" when not empty
+   };
+
+   /**
+    * The spans of one sampled transaction, each running from the end of the previous one, so that together they
+    * cover the time from its arrival to its inclusion in a block or its failure. Thread safe.
+    */
+   class transaction_trace_context {
+      public:
+         transaction_trace_context( const transaction_id_type& id, std::string origin );
+
+         const transaction_id_type& id()const { return _id; }
+
+         /// ends the current step as a span named name
+         void step( std::string name, std::string detail = std::string() );
+
+         struct snapshot {
+            std::string                         origin;
+            fc::time_point                      start;
+            std::vector<transaction_trace_span> spans;
+         };
+         snapshot get()const;
+
+      private:
+         const transaction_id_type           _id;
+         const std::string                   _origin;
+         const fc::time_point                _start;
+         mutable std::mutex                  _mtx;
+         fc::time_point                      _last;
+         std::vector<transaction_trace_span> _spans;
+   };
+
+   using transaction_trace_context_ptr = std::shared_ptr<transaction_trace_context>;
+
+   /**
+    * Process wide, sampled tracing of transactions from their arrival over http or p2p, through the appbase queue, key
+    * recovery, the producer queue and execution, to their inclusion in a block. Transactions are sampled by id, so
+    * every node tracing with the same rate samples the same transactions.
+    *
+    * Finished traces are exported on a background thread as OTLP JSON, one ExportTraceServiceRequest per line, which an
+    * OpenTelemetry collector reads with its file receiver. The trace id is the first half of the transaction id.
+    */
+   class transaction_tracing {
+      public:
+         static transaction_tracing& instance();
+
+         ~transaction_tracing();
+
+         /// traces one in sample_one_in transactions into export_file, 0 disables tracing
+         void configure( uint32_t sample_one_in, const fc::path& export_file );
+
+         bool enabled()const;
+
+         /// @return the trace of id, started now if it is sampled and not traced yet, nullptr if it is not sampled
+         transaction_trace_context_ptr begin( const transaction_id_type& id, const char* origin );
+
+         /// @return the trace of id, nullptr if it is not traced
+         transaction_trace_context_ptr find( const transaction_id_type& id )const;
+
+         /// ends the trace of id, if any, with status and queues it for export
+         void end( const transaction_id_type& id, const std::string& status );
+
+         /// stops the export thread after writing the traces already ended
+         void shutdown();
+
+      private:
+         transaction_tracing();
+
+         std::unique_ptr<detail::transaction_tracing_impl> my;
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,93 @@
+#pragma once
+#include <eosio/chain/block.hpp>
+#include <fc/filesystem.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    * On disk map from the ids of the transactions of the blocks of a block log to the numbers of those blocks,
+    * kept as trx.index next to blocks.log.
+    *
+    * The first 8 bytes of an id select one of 2^bucket_bits buckets. A bucket is a chain of pages of 41 entries, each
+    * the first 8 bytes of an id and a block number, the newest page first, so that a lookup reads only the pages of
+    * one bucket:
+    *
+    * +--------+-------------------------------------+--------+--------+-----+
+    * | Header | Newest page of bucket 0 ... 2^bits-1 | Page 1 | Page 2 | ... |
+    * +--------+-------------------------------------+--------+--------+-----+
+    *
+    * Since only a prefix of the id is kept, and blocks past a truncation of the log are not removed, lookups return
+    * candidate block numbers which the caller checks against the blocks themselves.
+    *
+    * Thread safe.
+    */
+   class trx_block_index {
+   public:
+      static constexpr uint32_t default_bucket_bits = 20;
+
+      /// opens file, creating it with 2^bucket_bits buckets if it does not exist
+      explicit trx_block_index( const fc::path& file, uint32_t bucket_bits = default_bucket_bits );
+      ~trx_block_index();
+
+      trx_block_index( const trx_block_index& ) = delete;
+      trx_block_index& operator=( const trx_block_index& ) = delete;
+
+      /// adds the transactions of b, then records b as the last block indexed
+      void add( const signed_block& b );
+      void add( const transaction_id_type& id, uint32_t block_num );
+
+      /// @return the numbers of the blocks which may include id, the most recently added first
+      vector<uint32_t> find( const transaction_id_type& id )const;
+
+      /// last block whose transactions were all added, 0 if none
+      uint32_t last_block_num()const;
+      void     set_last_block_num( uint32_t block_num );
+
+      /// removes every entry
+      void clear();
+
+      /// writes the header, entries are written as they are added
+      void flush();
+
+      const fc::path& file()const { return _file; }
+
+      /// ids of the transactions of b, in block order
+      static vector<transaction_id_type> transaction_ids( const signed_block& b );
+      static bool contains( const signed_block& b, const transaction_id_type& id );
+
+   private:
+      struct header {
+         uint32_t magic = 0;
+         uint32_t version = 0;
+         uint32_t bucket_bits = 0;
+         uint32_t last_block_num = 0;
+      };
+
+      static constexpr uint32_t magic_number = 0x58495254; // "TRIX"
+      static constexpr uint32_t current_version = 1;
+      static constexpr uint64_t page_size = 512;
+      static constexpr uint32_t entry_size = sizeof(uint64_t) + sizeof(uint32_t);
+      static constexpr uint32_t page_header_size = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+      static constexpr uint32_t entries_per_page = (page_size - page_header_size) / entry_size;
+
+      uint64_t directory_pos( uint64_t bucket )const { return sizeof(header) + bucket * sizeof(uint64_t); }
+      uint64_t data_pos()const { return directory_pos( _directory.size() ); }
+
+      void read( char* data, size_t size, uint64_t pos )const;
+      void write( const char* data, size_t size, uint64_t pos );
+      /// @pre _mtx is held
+      void write_header();
+
+      const fc::path        _file;
+      int                   _fd = -1;
+      mutable std::mutex    _mtx;
+      header                _header;
+      vector<uint64_t>      _directory;  ///< position of the newest page of each bucket, 0 if it has none
+      vector<uint8_t>       _page_count; ///< entries in the newest page of each bucket, unknown_count until read
+      uint64_t              _end_pos = 0;
+      static constexpr uint8_t unknown_count = 0xff;
+   };
+
+} } /// eosio::chain
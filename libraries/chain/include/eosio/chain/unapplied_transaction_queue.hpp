@@ -3,12 +3,15 @@
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/block_state.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/memory_accounting.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 
+#include <deque>
+
 namespace fc {
   inline std::size_t hash_value( const fc::sha256& v ) {
      return v._hash[3];
@@ -26,10 +29,20 @@ enum class trx_enum_type {
    aborted = 3
 };
 
+/// memo of the subjective failures in a row of an unapplied transaction, so it is not re-executed before it could succeed
+struct subjective_failure {
+   int64_t                        code = 0;      ///< exception code of the last failure
+   fc::microseconds               elapsed;       ///< time spent before the last failure
+   uint32_t                       block_num = 0; ///< pending block of the last failure
+   uint32_t                       count = 0;     ///< blocks failed in a row
+};
+
 struct unapplied_transaction {
    const transaction_metadata_ptr trx_meta;
    const fc::time_point           expiry;
    trx_enum_type                  trx_type = trx_enum_type::unknown;
+   subjective_failure             last_failure;
+   memory_accounting::tracked_bytes memory;
 
    const transaction_id_type& id()const { return trx_meta->id(); }
 
@@ -42,6 +55,11 @@ struct unapplied_transaction {
 /**
  * Track unapplied transactions for persisted, forked blocks, and aborted blocks.
  * Persisted are first so that they can be applied in each block until expired.
+ *
+ * Expiry is tracked by a wheel of one bucket of ids per second instead of an ordered index: queuing a transaction
+ * appends its id to the bucket of its expiration second and expiring a second drains its bucket. Ids are left in their
+ * bucket when the transaction leaves the queue otherwise and are skipped when the bucket is drained; the wheel is
+ * rebuilt from the queue once such stale ids outnumber the queued transactions.
  */
 class unapplied_transaction_queue {
 public:
@@ -54,21 +72,55 @@ public:
 private:
    struct by_trx_id;
    struct by_type;
-   struct by_expiry;
 
    typedef multi_index_container< unapplied_transaction,
       indexed_by<
          hashed_unique< tag<by_trx_id>,
                const_mem_fun<unapplied_transaction, const transaction_id_type&, &unapplied_transaction::id>
          >,
-         ordered_non_unique< tag<by_type>, member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type> >,
-         ordered_non_unique< tag<by_expiry>, member<unapplied_transaction, const fc::time_point, &unapplied_transaction::expiry> >
+         ordered_non_unique< tag<by_type>, member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type> >
       >
    > unapplied_trx_queue_type;
 
+   static constexpr size_t min_expiry_compaction = 1024;
+
    unapplied_trx_queue_type queue;
    process_mode mode = process_mode::speculative_producer;
 
+   std::deque<std::vector<transaction_id_type>> expiry_buckets;  ///< ids by expiration second, from expiry_base_sec on
+   int64_t                                      expiry_base_sec = 0;
+   size_t                                       expiry_entries = 0; ///< ids in all buckets, stale ones included
+
+   static int64_t expiry_sec( const fc::time_point& expiry ) {
+      return expiry.time_since_epoch().count() / 1000000;
+   }
+
+   void add_expiry( const transaction_id_type& id, const fc::time_point& expiry ) {
+      const int64_t sec = expiry_sec( expiry );
+      if( expiry_buckets.empty() ) expiry_base_sec = sec;
+      // already expired transactions go to the oldest bucket, which is drained first
+      const size_t pos = sec > expiry_base_sec ? size_t(sec - expiry_base_sec) : 0;
+      if( pos >= expiry_buckets.size() ) expiry_buckets.resize( pos + 1 );
+      expiry_buckets[pos].push_back( id );
+      ++expiry_entries;
+   }
+
+   void rebuild_expiry() {
+      expiry_buckets.clear();
+      expiry_entries = 0;
+      for( const auto& un : queue ) add_expiry( un.id(), un.expiry );
+   }
+
+   void insert( transaction_metadata_ptr trx, trx_enum_type type ) {
+      fc::time_point expiry = trx->packed_trx()->expiration();
+      const uint64_t bytes = trx->packed_trx()->get_unprunable_size() + trx->packed_trx()->get_prunable_size() + sizeof( *trx );
+      auto r = queue.insert( { std::move( trx ), expiry, type, {},
+                               memory_accounting::tracked_bytes( memory_accounting::unapplied_transactions(), bytes ) } );
+      if( !r.second ) return;
+      add_expiry( r.first->id(), expiry );
+      if( expiry_entries > std::max( 2 * queue.size(), min_expiry_compaction ) ) rebuild_expiry();
+   }
+
 public:
 
    void set_mode( process_mode new_mode ) {
@@ -88,6 +140,8 @@ public:
 
    void clear() {
       queue.clear();
+      expiry_buckets.clear();
+      expiry_entries = 0;
    }
 
    bool contains_persisted()const {
@@ -106,15 +160,26 @@ public:
       return itr->trx_meta;
    }
 
+   /// removes the transactions expiring at or before pending_block_time, oldest second first
    template <typename Func>
    bool clear_expired( const time_point& pending_block_time, const time_point& deadline, Func&& callback ) {
-      auto& persisted_by_expiry = queue.get<by_expiry>();
-      while(!persisted_by_expiry.empty() && persisted_by_expiry.begin()->expiry <= pending_block_time) {
-         if (deadline <= fc::time_point::now()) {
-            return false;
+      auto& idx = queue.get<by_trx_id>();
+      while( !expiry_buckets.empty() && expiry_base_sec <= expiry_sec( pending_block_time ) ) {
+         auto& bucket = expiry_buckets.front();
+         while( !bucket.empty() ) {
+            auto itr = idx.find( bucket.back() );
+            if( itr != idx.end() ) {
+               // expirations are whole seconds, a later one only shares the bucket of pending_block_time
+               if( itr->expiry > pending_block_time ) return true;
+               if( deadline <= fc::time_point::now() ) return false;
+               callback( itr->id(), itr->trx_type );
+               idx.erase( itr );
+            }
+            bucket.pop_back();
+            --expiry_entries;
          }
-         callback( persisted_by_expiry.begin()->id(), persisted_by_expiry.begin()->trx_type );
-         persisted_by_expiry.erase( persisted_by_expiry.begin() );
+         expiry_buckets.pop_front();
+         ++expiry_base_sec;
       }
       return true;
    }
@@ -141,9 +206,7 @@ public:
       for( auto ritr = forked_branch.rbegin(), rend = forked_branch.rend(); ritr != rend; ++ritr ) {
          const block_state_ptr& bsptr = *ritr;
          for( auto itr = bsptr->trxs_metas().begin(), end = bsptr->trxs_metas().end(); itr != end; ++itr ) {
-            const auto& trx = *itr;
-            fc::time_point expiry = trx->packed_trx()->expiration();
-            queue.insert( { trx, expiry, trx_enum_type::forked } );
+            insert( *itr, trx_enum_type::forked );
          }
       }
    }
@@ -151,8 +214,7 @@ public:
    void add_aborted( std::vector<transaction_metadata_ptr> aborted_trxs ) {
       if( mode == process_mode::non_speculative || mode == process_mode::speculative_non_producer ) return;
       for( auto& trx : aborted_trxs ) {
-         fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { std::move( trx ), expiry, trx_enum_type::aborted } );
+         insert( std::move( trx ), trx_enum_type::aborted );
       }
    }
 
@@ -160,8 +222,7 @@ public:
       if( mode == process_mode::non_speculative ) return;
       auto itr = queue.get<by_trx_id>().find( trx->id() );
       if( itr == queue.get<by_trx_id>().end() ) {
-         fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { trx, expiry, trx_enum_type::persisted } );
+         insert( trx, trx_enum_type::persisted );
       } else if( itr->trx_type != trx_enum_type::persisted ) {
          queue.get<by_trx_id>().modify( itr, [](auto& un){
             un.trx_type = trx_enum_type::persisted;
@@ -179,6 +240,34 @@ public:
 
    iterator erase( iterator itr ) { return queue.get<by_type>().erase( itr ); }
 
+   static constexpr uint32_t max_failure_backoff_blocks = 32;
+
+   /// records a subjective failure of the transaction at itr in pending block block_num
+   void record_subjective_failure( iterator itr, int64_t code, fc::microseconds elapsed, uint32_t block_num ) {
+      queue.get<by_type>().modify( itr, [&]( auto& un ) {
+         auto& f = un.last_failure;
+         if( f.count == 0 || block_num > f.block_num ) ++f.count;
+         f.code = code;
+         f.elapsed = elapsed;
+         f.block_num = block_num;
+      } );
+   }
+
+   /**
+    * A transaction failing subjectively in a row is retried after 1, 2, 4 ... up to max_failure_backoff_blocks
+    * blocks, since until then the block resources it failed on are likely as contended.
+    * @return true if un is due to be retried in pending block block_num
+    */
+   static bool retry_due( const unapplied_transaction& un, uint32_t block_num ) {
+      return retry_due( un.last_failure, block_num );
+   }
+
+   static bool retry_due( const subjective_failure& f, uint32_t block_num ) {
+      if( f.count == 0 ) return true;
+      const uint32_t backoff = std::min<uint32_t>( 1u << std::min<uint32_t>( f.count - 1, 31 ), max_failure_backoff_blocks );
+      return block_num >= f.block_num + backoff;
+   }
+
 };
 
 } } //eosio::chain
@@ -3,6 +3,8 @@
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/whitelisted_intrinsics.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/code_artifact.hpp>
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
 #include <eosio/vm/allocator.hpp>
 #endif
@@ -13,13 +15,34 @@ namespace eosio { namespace chain {
 
    class apply_context;
    class wasm_runtime_interface;
+   class wasm_instantiated_module_interface;
+   class transaction_context;
    class controller;
-   namespace eosvmoc { struct config; }
-
    struct wasm_exit {
       int32_t code = 0;
    };
 
+   struct wasm_cache_stats {
+      uint64_t hits = 0;                   ///< applies which found their code instantiated
+      uint64_t misses = 0;                 ///< applies which had to instantiate or wait for a background instantiation
+      uint64_t preinstantiated = 0;        ///< background instantiations taken into the cache
+      uint64_t evictions = 0;              ///< entries dropped to stay within max_bytes
+      uint64_t instantiation_time_us = 0;  ///< main thread time spent on misses
+      uint64_t resident_bytes = 0;         ///< estimated size of the instantiated contracts
+      uint64_t max_bytes = 0;              ///< 0 is unbounded
+      uint32_t entries = 0;
+   };
+
+   struct wasm_profile_entry {
+      account_name receiver;
+      account_name account;
+      action_name  action;
+      digest_type  code_hash;     ///< of the latest execution
+      uint64_t     calls = 0;
+      uint64_t     total_us = 0;  ///< wall clock of the executions including their host functions
+      uint64_t     max_us = 0;
+   };
+
    namespace webassembly { namespace common {
       class intrinsics_accessor;
 
@@ -82,7 +105,8 @@ namespace eosio { namespace chain {
             eos_vm_oc
          };
 
-         wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config);
+         wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                        uint32_t preinstantiate_codes = 0, uint64_t max_cache_bytes = 0, bool profile = false);
          ~wasm_interface();
 
          //call before dtor to skip what can be minutes of dtor overhead with some runtimes; can cause leaks
@@ -91,6 +115,10 @@ namespace eosio { namespace chain {
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
          static void validate(const controller& control, const bytes& code);
 
+         //validate() unless code with this hash already passed it under the same intrinsic whitelist and validation rules;
+         //the codes which passed are kept across restarts and replays
+         void validate(const controller& control, const bytes& code, const digest_type& code_hash);
+
          //indicate that a particular code probably won't be used after given block_num
          void code_block_num_last_used(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const uint32_t& block_num);
 
@@ -103,6 +131,39 @@ namespace eosio { namespace chain {
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         //module of a code for running context-free actions on a thread other than the main thread, nullptr if the
+         //runtime cannot run modules on several threads; it is not evicted from the cache until end_concurrent_apply()
+         wasm_instantiated_module_interface* begin_concurrent_apply(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, transaction_context& trx_context);
+         void end_concurrent_apply();
+
+         //records in the wasm profile an apply of a module from begin_concurrent_apply() that ran for elapsed on
+         //another thread, as apply() does for the main thread
+         void record_concurrent_apply(const digest_type& code_hash, const apply_context& context, fc::microseconds elapsed);
+
+         //starts compiling the codes that were hottest in the previous run when EOS VM OC tier-up is enabled
+         void start_eosvmoc_warm_up();
+
+         //progress of start_eosvmoc_warm_up(), empty when EOS VM OC tier-up is not enabled
+         fc::optional<eosvmoc::warm_up_status> get_eosvmoc_warm_up_status();
+
+         //code compiled by EOS VM OC for importing into other nodes, empty when not compiled or tier-up is not enabled
+         fc::optional<eosvmoc::code_artifact> export_eosvmoc_code(const digest_type& code_hash, const uint8_t& vm_version);
+
+         //adds code compiled by EOS VM OC on another node to the code cache, see code_cache_async::import_code
+         bool import_eosvmoc_code(const eosvmoc::code_artifact& artifact);
+
+         //starts instantiating code on a background thread so its first apply does not have to; no-op if background
+         //instantiation is disabled or not supported by the runtime
+         void preinstantiate(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const bytes& code);
+
+         //preinstantiates the codes most recently used before the restart
+         void preinstantiate_recent_codes();
+
+         wasm_cache_stats get_cache_stats()const;
+
+         //wasm execution time per receiver and action seen since startup, most expensive first
+         std::vector<wasm_profile_entry> get_profile()const;
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -115,3 +176,5 @@ namespace eosio{ namespace chain {
 }}
 
 FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wabt)(eos_vm)(eos_vm_jit)(eos_vm_oc) )
+FC_REFLECT( eosio::chain::wasm_profile_entry, (receiver)(account)(action)(code_hash)(calls)(total_us)(max_us) )
+FC_REFLECT( eosio::chain::wasm_cache_stats, (hits)(misses)(preinstantiated)(evictions)(instantiation_time_us)(resident_bytes)(max_bytes)(entries) )
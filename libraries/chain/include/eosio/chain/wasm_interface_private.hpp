@@ -14,7 +14,16 @@
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/code_object.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/memory_accounting.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+
+#include <fstream>
+#include <future>
+#include <map>
+#include <set>
 
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
@@ -37,6 +46,16 @@ namespace eosio { namespace chain {
 
    namespace eosvmoc { struct config; }
 
+   struct wasm_code_key {
+      digest_type code_hash;
+      uint8_t     vm_type = 0;
+      uint8_t     vm_version = 0;
+
+      friend bool operator<(const wasm_code_key& a, const wasm_code_key& b) {
+         return std::tie(a.code_hash, a.vm_type, a.vm_version) < std::tie(b.code_hash, b.vm_type, b.vm_version);
+      }
+   };
+
    struct wasm_interface_impl {
       struct wasm_cache_entry {
          digest_type                                          code_hash;
@@ -45,21 +64,37 @@ namespace eosio { namespace chain {
          std::unique_ptr<wasm_instantiated_module_interface>  module;
          uint8_t                                              vm_type = 0;
          uint8_t                                              vm_version = 0;
+         uint64_t                                             last_used_seq = 0; //0 for background instantiations not used yet
+         uint64_t                                             size = 0; //estimated, see estimated_module_size()
       };
       struct by_hash;
       struct by_first_block_num;
       struct by_last_block_num;
+      struct by_last_used;
+
+      //instantiated modules are not measurable through wasm_instantiated_module_interface; decoded eos-vm modules and
+      //their generated code come out at a few times the size of the wasm per instance, and eos-vm modules keep a copy
+      //of the wasm to build more instances from
+      uint64_t estimated_module_size(size_t code_size, uint32_t instances = 1)const {
+         const bool keeps_code = wasm_runtime_time == wasm_interface::vm_type::eos_vm || wasm_runtime_time == wasm_interface::vm_type::eos_vm_jit;
+         return uint64_t(code_size) * (4 * instances + (keeps_code ? 1 : 0));
+      }
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       struct eosvmoc_tier {
-         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), exec(cc) {}
+         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), executors(cc, c.execution_slices) {}
          eosvmoc::code_cache_async cc;
-         eosvmoc::executor exec;
-         eosvmoc::memory mem;
+         eosvmoc::executor_pool executors;
+         //handed out by wasm_interface::begin_concurrent_apply, released once no concurrent apply is left
+         std::vector<std::unique_ptr<wasm_instantiated_module_interface>> concurrent_modules;
       };
 #endif
 
-      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config) : db(d), wasm_runtime_time(vm) {
+      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                          uint32_t preinstantiate_codes, uint64_t max_cache_bytes, bool profile)
+         : db(d), wasm_runtime_time(vm), preinstantiate_codes(preinstantiate_codes), recent_codes_path(data_dir/"recent_codes.bin"),
+           max_cache_bytes(max_cache_bytes), validated_codes_path(data_dir/"validated_codes.bin"),
+           profile(profile), profile_path(data_dir/"wasm_profile.folded") {
          if(vm == wasm_interface::vm_type::wabt)
             runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
 #ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
@@ -83,9 +118,45 @@ namespace eosio { namespace chain {
             eosvmoc.emplace(data_dir, eosvmoc_config, d);
          }
 #endif
+
+         //wabt keeps injection state in statics so it can only instantiate on the main thread, and EOS VM OC compiles
+         //out of process already
+         if(preinstantiate_codes && (vm == wasm_interface::vm_type::eos_vm || vm == wasm_interface::vm_type::eos_vm_jit))
+            instantiation_thread.emplace("wasm", 1);
+
+         if(boost::filesystem::exists(validated_codes_path)) {
+            try {
+               std::string data;
+               fc::read_file_contents(validated_codes_path, data);
+               fc::datastream<const char*> ds(data.data(), data.size());
+               fc::raw::unpack(ds, validated_codes);
+            } catch(const fc::exception& e) {
+               wlog("unable to read validated codes from ${f}: ${e}", ("f", validated_codes_path.generic_string())("e", e.to_detail_string()));
+               validated_codes.clear();
+            }
+         }
       }
 
       ~wasm_interface_impl() {
+         memory_accounting::wasm_cache().freed(stats.resident_bytes);
+         if(instantiation_thread) {
+            instantiation_thread->stop();
+            pending_instantiations.clear();
+            try {
+               save_recent_codes();
+            } FC_LOG_AND_DROP()
+         }
+         try {
+            const auto data = fc::raw::pack(validated_codes);
+            std::ofstream ofs(validated_codes_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+            ofs.write(data.data(), data.size());
+            EOS_ASSERT(ofs.good(), database_exception, "unable to write validated codes");
+         } FC_LOG_AND_DROP()
+         if(profile) {
+            try {
+               save_profile();
+            } FC_LOG_AND_DROP()
+         }
          if(is_shutting_down)
             for(wasm_cache_index::iterator it = wasm_instantiation_cache.begin(); it != wasm_instantiation_cache.end(); ++it)
                wasm_instantiation_cache.modify(it, [](wasm_cache_entry& e) {
@@ -111,6 +182,170 @@ namespace eosio { namespace chain {
          return mem_image;
       }
 
+      //bump when wasm_validations or the intrinsics they link against change, it invalidates validated_codes.bin
+      static constexpr uint32_t validation_rules_version = 1;
+
+      static digest_type validation_key(const whitelisted_intrinsics_type& whitelisted_intrinsics, const digest_type& code_hash) {
+         digest_type::encoder enc;
+         fc::raw::pack(enc, validation_rules_version);
+         fc::raw::pack(enc, code_hash);
+         for(const auto& intrinsic : whitelisted_intrinsics) {
+            enc.write(intrinsic.second.data(), intrinsic.second.size());
+            enc.put('\0'); //so names can't run together
+         }
+         return enc.result();
+      }
+
+      //parses, injects and instantiates code; only touches runtime_interface so it may run on instantiation_thread
+      std::unique_ptr<wasm_instantiated_module_interface> instantiate(const char* code, size_t code_size, const digest_type& code_hash,
+                                                                      const uint8_t& vm_type, const uint8_t& vm_version) {
+         //eos-vm neither injects nor uses the initial memory image, and setcode validated the code, so skip the WAVM parse
+         if(wasm_runtime_time == wasm_interface::vm_type::eos_vm || wasm_runtime_time == wasm_interface::vm_type::eos_vm_jit)
+            return runtime_interface->instantiate_module(code, code_size, {}, code_hash, vm_type, vm_version);
+         IR::Module module;
+         std::vector<U8> bytes = {(const U8*)code, (const U8*)code + code_size};
+         try {
+            Serialization::MemoryInputStream stream((const U8*)bytes.data(),
+                                                    bytes.size());
+            WASM::serialize(stream, module);
+            module.userSections.clear();
+         } catch (const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch (const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+         if (runtime_interface->inject_module(module)) {
+            try {
+               Serialization::ArrayOutputStream outstream;
+               WASM::serialize(outstream, module);
+               bytes = outstream.getBytes();
+            } catch (const Serialization::FatalSerializationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error,
+                          e.message.c_str());
+            } catch (const IR::ValidationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error,
+                          e.message.c_str());
+            }
+         }
+         return runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module), code_hash, vm_type, vm_version);
+      }
+
+      void preinstantiate(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const char* code, size_t code_size) {
+         if(!instantiation_thread || pending_instantiations.size() >= preinstantiate_codes)
+            return;
+         const wasm_code_key key{code_hash, vm_type, vm_version};
+         if(pending_instantiations.count(key) || wasm_instantiation_cache.count(boost::make_tuple(code_hash, vm_type, vm_version)))
+            return;
+         //the code may live in chainbase, which only the main thread may read
+         auto code_copy = std::make_shared<bytes>(code, code + code_size);
+         pending_instantiations.emplace(key, async_thread_pool(instantiation_thread->get_executor(), [this, code_copy, key]() {
+            return instantiate(code_copy->data(), code_copy->size(), key.code_hash, key.vm_type, key.vm_version);
+         }));
+      }
+
+      void preinstantiate_recent_codes() {
+         if(!instantiation_thread || !boost::filesystem::exists(recent_codes_path))
+            return;
+         std::string data;
+         fc::read_file_contents(recent_codes_path, data);
+         fc::datastream<const char*> ds(data.data(), data.size());
+         fc::raw::unpack(ds, previous_recent_codes);
+
+         for(const wasm_code_key& key : previous_recent_codes) {
+            const code_object* codeobject = db.find<code_object,by_code_hash>(boost::make_tuple(key.code_hash, key.vm_type, key.vm_version));
+            if(codeobject)
+               preinstantiate(key.code_hash, key.vm_type, key.vm_version, codeobject->code.data(), codeobject->code.size());
+         }
+         ilog("instantiating ${n} of ${t} recently used contracts in the background", ("n", pending_instantiations.size())("t", previous_recent_codes.size()));
+      }
+
+      //most recently used codes still in the cache first, topped up with the previous run's list
+      void save_recent_codes() {
+         std::vector<std::pair<uint64_t, wasm_code_key>> used;
+         for(const wasm_cache_entry& e : wasm_instantiation_cache)
+            if(e.last_used_seq)
+               used.emplace_back(e.last_used_seq, wasm_code_key{e.code_hash, e.vm_type, e.vm_version});
+         std::sort(used.begin(), used.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+         std::vector<wasm_code_key> recent_codes;
+         std::set<wasm_code_key> seen;
+         for(const auto& u : used)
+            if(recent_codes.size() < preinstantiate_codes && seen.insert(u.second).second)
+               recent_codes.push_back(u.second);
+         for(const wasm_code_key& key : previous_recent_codes)
+            if(recent_codes.size() < preinstantiate_codes && seen.insert(key).second)
+               recent_codes.push_back(key);
+
+         const auto data = fc::raw::pack(recent_codes);
+         std::ofstream ofs(recent_codes_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+         ofs.write(data.data(), data.size());
+         EOS_ASSERT(ofs.good(), database_exception, "unable to write recently used contracts");
+      }
+
+      //takes the background instantiation of a code, returns nullptr if there is none or it failed
+      std::unique_ptr<wasm_instantiated_module_interface> take_pending_instantiation(std::map<wasm_code_key, std::future<std::unique_ptr<wasm_instantiated_module_interface>>>::iterator it) {
+         auto f = std::move(it->second);
+         const wasm_code_key key = it->first;
+         pending_instantiations.erase(it);
+         try {
+            return f.get();
+         } catch(const fc::exception& e) {
+            wlog("background instantiation of ${h} failed: ${e}", ("h", key.code_hash)("e", e.to_detail_string()));
+         } catch(const std::exception& e) {
+            wlog("background instantiation of ${h} failed: ${e}", ("h", key.code_hash)("e", e.what()));
+         }
+         return nullptr;
+      }
+
+      void add_resident(uint64_t size) {
+         stats.resident_bytes += size;
+         memory_accounting::wasm_cache().allocated(size);
+      }
+
+      void remove_resident(uint64_t size) {
+         stats.resident_bytes -= size;
+         memory_accounting::wasm_cache().freed(size);
+      }
+
+      //drops least recently used entries until the cache fits in max_cache_bytes; in_use is about to run and is kept
+      void evict_to_bound(const wasm_cache_entry& in_use) {
+         if(!max_cache_bytes || concurrent_applies)
+            return;
+         auto& by_use = wasm_instantiation_cache.get<by_last_used>();
+         for(auto lru = by_use.begin(); stats.resident_bytes > max_cache_bytes && lru != by_use.end();) {
+            if(&*lru == &in_use) {
+               ++lru;
+               continue;
+            }
+            remove_resident(lru->size);
+            ++stats.evictions;
+            lru = by_use.erase(lru);
+         }
+      }
+
+      void record_profile(account_name receiver, const action& act, const digest_type& code_hash, fc::microseconds elapsed) {
+         wasm_profile_entry& e = profile_entries[std::make_tuple(receiver, act.account, act.name)];
+         if(!e.calls) {
+            e.receiver = receiver;
+            e.account = act.account;
+            e.action = act.name;
+         }
+         e.code_hash = code_hash;
+         ++e.calls;
+         e.total_us += elapsed.count();
+         e.max_us = std::max<uint64_t>(e.max_us, elapsed.count());
+      }
+
+      //collapsed stacks of flamegraph.pl and speedscope, one receiver;account::action frame pair per line
+      void save_profile() {
+         std::ofstream ofs(profile_path.generic_string(), std::ofstream::trunc);
+         for(const auto& p : profile_entries)
+            ofs << p.second.receiver.to_string() << ';' << p.second.account.to_string() << "::" << p.second.action.to_string()
+                << ' ' << p.second.total_us << '\n';
+         EOS_ASSERT(ofs.good(), database_exception, "unable to write the wasm profile");
+         ilog("wrote the wasm profile of ${n} actions to ${f}", ("n", profile_entries.size())("f", profile_path.generic_string()));
+      }
+
       void code_block_num_last_used(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const uint32_t& block_num) {
          wasm_cache_index::iterator it = wasm_instantiation_cache.find(boost::make_tuple(code_hash, vm_type, vm_version));
          if(it != wasm_instantiation_cache.end())
@@ -127,7 +362,38 @@ namespace eosio { namespace chain {
          if(eosvmoc) for(auto it = first_it; it != last_it; it++)
             eosvmoc->cc.free_code(it->code_hash, it->vm_version);
 #endif
+         for(auto it = first_it; it != last_it; it++)
+            remove_resident(it->size);
          wasm_instantiation_cache.get<by_last_block_num>().erase(first_it, last_it);
+
+         //finished background instantiations join the cache as if used in the head block, dropped if their setcode did not stick
+         for(auto it = pending_instantiations.begin(); it != pending_instantiations.end();) {
+            if(it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+               ++it;
+               continue;
+            }
+            const wasm_code_key key = it->first;
+            auto next = std::next(it);
+            const code_object* codeobject = db.find<code_object,by_code_hash>(boost::make_tuple(key.code_hash, key.vm_type, key.vm_version));
+            auto module = take_pending_instantiation(it);
+            it = next;
+            if(!codeobject || !module || wasm_instantiation_cache.count(boost::make_tuple(key.code_hash, key.vm_type, key.vm_version)))
+               continue;
+            const auto size = estimated_module_size(codeobject->code.size());
+            auto added = wasm_instantiation_cache.emplace( wasm_interface_impl::wasm_cache_entry{
+                                                              .code_hash = key.code_hash,
+                                                              .first_block_num_used = codeobject->first_block_used,
+                                                              .last_block_num_used = std::max(lib + 1, static_cast<uint32_t>(db.revision())),
+                                                              .module = std::move(module),
+                                                              .vm_type = key.vm_type,
+                                                              .vm_version = key.vm_version,
+                                                              .last_used_seq = 0,
+                                                              .size = size
+                                                           } ).first;
+            add_resident(size);
+            ++stats.preinstantiated;
+            evict_to_bound(*added);
+         }
       }
 
       const std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_hash, const uint8_t& vm_type,
@@ -149,49 +415,67 @@ namespace eosio { namespace chain {
                                                    } ).first;
          }
 
-         if(!it->module) {
+         if(it->module) {
+            ++stats.hits;
+         } else {
             if(!codeobject)
                codeobject = &db.get<code_object,by_code_hash>(boost::make_tuple(code_hash, vm_type, vm_version));
 
+            ++stats.misses;
+            const auto start = fc::time_point::now();
             auto timer_pause = fc::make_scoped_exit([&](){
+               stats.instantiation_time_us += (fc::time_point::now() - start).count();
                trx_context.resume_billing_timer();
             });
             trx_context.pause_billing_timer();
-            IR::Module module;
-            std::vector<U8> bytes = {
-                (const U8*)codeobject->code.data(),
-                (const U8*)codeobject->code.data() + codeobject->code.size()};
-            try {
-               Serialization::MemoryInputStream stream((const U8*)bytes.data(),
-                                                       bytes.size());
-               WASM::serialize(stream, module);
-               module.userSections.clear();
-            } catch (const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch (const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            }
-            if (runtime_interface->inject_module(module)) {
-               try {
-                  Serialization::ArrayOutputStream outstream;
-                  WASM::serialize(outstream, module);
-                  bytes = outstream.getBytes();
-               } catch (const Serialization::FatalSerializationException& e) {
-                  EOS_ASSERT(false, wasm_serialization_error,
-                             e.message.c_str());
-               } catch (const IR::ValidationException& e) {
-                  EOS_ASSERT(false, wasm_serialization_error,
-                             e.message.c_str());
-               }
-            }
-
+            std::unique_ptr<wasm_instantiated_module_interface> module;
+            auto pending = pending_instantiations.find(wasm_code_key{code_hash, vm_type, vm_version});
+            if(pending != pending_instantiations.end())
+               module = take_pending_instantiation(pending);
+            if(!module)
+               module = instantiate(codeobject->code.data(), codeobject->code.size(), code_hash, vm_type, vm_version);
+
+            const auto size = estimated_module_size(codeobject->code.size());
             wasm_instantiation_cache.modify(it, [&](auto& c) {
-               c.module = runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module), code_hash, vm_type, vm_version);
+               c.module = std::move(module);
+               c.size = size;
             });
+            add_resident(size);
          }
+         wasm_instantiation_cache.modify(it, [&](auto& c) {
+            c.last_used_seq = ++use_seq;
+         });
+         evict_to_bound(*it);
          return it->module;
       }
 
+      //module of a code for running on a thread of the thread pool as well as on the main thread; what that needs is
+      //built here with billing paused and added to the estimated size of the cache entry
+      wasm_instantiated_module_interface* get_concurrent_module( const digest_type& code_hash, const uint8_t& vm_type,
+                                                                 const uint8_t& vm_version, transaction_context& trx_context )
+      {
+         wasm_instantiated_module_interface* module = get_instantiated_module(code_hash, vm_type, vm_version, trx_context).get();
+         auto it = wasm_instantiation_cache.find(boost::make_tuple(code_hash, vm_type, vm_version));
+
+         const auto start = fc::time_point::now();
+         auto timer_pause = fc::make_scoped_exit([&](){
+            stats.instantiation_time_us += (fc::time_point::now() - start).count();
+            trx_context.resume_billing_timer();
+         });
+         trx_context.pause_billing_timer();
+         //the main thread, and the thread running the context-free actions of the transaction
+         const uint32_t added = module->prepare_concurrent_apply(2);
+         if(added) {
+            const code_object& codeobject = db.get<code_object,by_code_hash>(boost::make_tuple(code_hash, vm_type, vm_version));
+            const auto size = estimated_module_size(codeobject.code.size(), 1 + added) - estimated_module_size(codeobject.code.size());
+            wasm_instantiation_cache.modify(it, [&](auto& c) {
+               c.size += size;
+            });
+            add_resident(size);
+         }
+         return module;
+      }
+
       bool is_shutting_down = false;
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
 
@@ -206,7 +490,8 @@ namespace eosio { namespace chain {
                >
             >,
             ordered_non_unique<tag<by_first_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::first_block_num_used>>,
-            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>
+            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>,
+            ordered_non_unique<tag<by_last_used>, member<wasm_cache_entry, uint64_t, &wasm_cache_entry::last_used_seq>>
          >
       > wasm_cache_index;
       wasm_cache_index wasm_instantiation_cache;
@@ -214,6 +499,24 @@ namespace eosio { namespace chain {
       const chainbase::database& db;
       const wasm_interface::vm_type wasm_runtime_time;
 
+      const uint32_t                        preinstantiate_codes;
+      const boost::filesystem::path         recent_codes_path;
+      std::vector<wasm_code_key>            previous_recent_codes;
+      uint64_t                              use_seq = 0;
+      fc::optional<named_thread_pool>       instantiation_thread;
+      std::map<wasm_code_key, std::future<std::unique_ptr<wasm_instantiated_module_interface>>> pending_instantiations;
+
+      const uint64_t                        max_cache_bytes;
+      uint32_t                              concurrent_applies = 0; //while not 0 the cache may exceed max_cache_bytes
+      wasm_cache_stats                      stats; //max_bytes and entries are filled in by wasm_interface::get_cache_stats()
+
+      const boost::filesystem::path         validated_codes_path;
+      std::map<digest_type, bool>           validated_codes; //validation_key() -> passed the checks only enforced while producing
+
+      const bool                            profile;
+      const boost::filesystem::path         profile_path;
+      std::map<std::tuple<account_name, account_name, action_name>, wasm_profile_entry> profile_entries;
+
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       fc::optional<eosvmoc_tier> eosvmoc;
 #endif
@@ -264,3 +567,5 @@ namespace eosio { namespace chain {
    BOOST_PP_SEQ_FOR_EACH(_REGISTER_INJECTED_INTRINSIC, CLS, _WRAPPED_SEQ(MEMBERS))
 
 } } // eosio::chain
+
+FC_REFLECT(eosio::chain::wasm_code_key, (code_hash)(vm_type)(vm_version))
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/ipc_protocol.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace chain { namespace eosvmoc {
+
+/**
+ * Code compiled by EOS VM OC as exported from the code cache of one node to be imported into the code cache of
+ * another one, which then runs it without compiling it. The code only runs correctly on a node built for the same
+ * target: the same LLVM version and process triple, the same intrinsic ordinals and the same memory layout, all of
+ * which make up code_artifact_target(). The machine code is trusted, artifacts must only come from trusted nodes.
+ */
+struct code_artifact {
+   static constexpr uint32_t current_format = 1;
+
+   uint32_t                            format = current_format;
+   std::string                         target;
+   code_tuple                          code;
+   eosvmoc_optional_offset_or_import_t start;
+   unsigned                            apply_offset = 0;
+   int                                 starting_memory_pages = 0;
+   unsigned                            initdata_prologue_size = 0;
+   std::vector<char>                   machine_code;
+   std::vector<char>                   initdata;
+   fc::sha256                          checksum; ///< of all the fields above, catches artifacts damaged in transit
+
+   fc::sha256 compute_checksum()const {
+      fc::sha256::encoder enc;
+      fc::raw::pack( enc, format );
+      fc::raw::pack( enc, target );
+      fc::raw::pack( enc, code );
+      fc::raw::pack( enc, start );
+      fc::raw::pack( enc, apply_offset );
+      fc::raw::pack( enc, starting_memory_pages );
+      fc::raw::pack( enc, initdata_prologue_size );
+      fc::raw::pack( enc, machine_code );
+      fc::raw::pack( enc, initdata );
+      return enc.result();
+   }
+};
+
+/// target of the code compiled by this node
+std::string code_artifact_target();
+
+}}}
+
+FC_REFLECT(eosio::chain::eosvmoc::code_artifact, (format)(target)(code)(start)(apply_offset)(starting_memory_pages)
+           (initdata_prologue_size)(machine_code)(initdata)(checksum))
@@ -3,7 +3,10 @@
 #include <boost/lockfree/spsc_queue.hpp>
 
 #include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/code_artifact.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/ipc_helpers.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/compile_queue.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
@@ -16,13 +19,7 @@
 
 #include <thread>
 
-namespace std {
-    template<> struct hash<eosio::chain::eosvmoc::code_tuple> {
-        size_t operator()(const eosio::chain::eosvmoc::code_tuple& ct) const noexcept {
-            return ct.code_id._hash[0];
-        }
-    };
-}
+#include <sys/types.h>
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
@@ -34,7 +31,13 @@ namespace bfs = boost::filesystem;
 
 using allocator_t = bip::rbtree_best_fit<bip::null_mutex_family, bip::offset_ptr<void>, alignof(std::max_align_t)>;
 
-struct config;
+//the codes a code_cache_async warms up with at its next startup: the most executed codes first, topped up with the
+// previous run's codes which were not executed, at most max_codes
+std::vector<code_tuple> rank_hot_codes(const std::unordered_map<code_tuple, uint64_t>& execution_counts,
+                                       const std::vector<code_tuple>& previous_hot_codes, uint32_t max_codes);
+void write_hot_codes(const bfs::path& path, const std::vector<code_tuple>& hot_codes);
+//throws when the file cannot be read; at most max_codes, hottest first
+std::vector<code_tuple> read_hot_codes(const bfs::path& path, uint32_t max_codes);
 
 class code_cache_base {
    public:
@@ -45,6 +48,9 @@ class code_cache_base {
 
       void free_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //compiled code for importing into the cache of another node, empty when the code is not in the cache
+      fc::optional<code_artifact> export_code(const digest_type& code_id, const uint8_t& vm_version);
+
    protected:
       struct by_hash;
 
@@ -73,9 +79,24 @@ class code_cache_base {
 
       //these are really only useful to the async code cache, but keep them here so
       //free_code can be shared
-      std::unordered_set<code_tuple> _queued_compiles;
+      compile_queue _queued_compiles;
+      std::unordered_set<code_tuple> _warm_up_pending;
+      warm_up_status _warm_up_status;
       std::unordered_map<code_tuple, bool> _outstanding_compiles_and_poison;
 
+      //compiled code executions counted towards a recompile at _hot_opt_level, and codes already sent for it
+      uint8_t _opt_level;
+      uint8_t _hot_opt_level;
+      uint32_t _hot_recompile_executions;
+      std::unordered_map<code_tuple, uint32_t> _hot_executions;
+      std::unordered_set<code_tuple> _hot_recompiled;
+
+      cache_mode _mode;
+      bfs::path _shared_index_path;
+      bool _shared_index_changed = false;
+      size_t _shared_cache_size = 0; ///< shared_reader: size of the cache file when it was opened
+      void publish_shared_index();
+
       size_t _free_bytes_eviction_threshold;
       void check_eviction_threshold(size_t free_bytes);
       void run_eviction_round();
@@ -96,18 +117,46 @@ class code_cache_async : public code_cache_base {
       //otherwise: return nullptr
       const code_descriptor* const get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //Called after code ran in the interpreter because get_descriptor_for_code returned nullptr. Raises the
+      // priority of the code if it is waiting for a compile thread
+      void record_interpreted_execution(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& elapsed);
+
+      //Starts compiling the codes that were hottest in the previous run, must be called once the state is loaded
+      void start_warm_up();
+      const warm_up_status& get_warm_up_status();
+
+      //Stores code compiled by another node, after checking it was compiled for the target of this node and for code
+      // on chain. Returns false when the code is already in the cache or compiling; otherwise the code is added to the
+      // cache like a compiled code, once get_descriptor_for_code picks up the result
+      bool import_code(const code_artifact& artifact);
+
    private:
       std::thread _monitor_reply_thread;
       boost::lockfree::spsc_queue<wasm_compilation_result_message> _result_queue;
       void wait_on_compile_monitor_message();
       std::tuple<size_t, size_t> consume_compile_thread_queue();
+      void process_finished_compiles();
+      void count_hot_execution(const code_tuple& ct);
+      uint32_t compile_partitions() const;
       std::unordered_set<code_tuple> _blacklist;
       size_t _threads;
+
+      bfs::path _hot_codes_path;
+      uint32_t _warm_up_codes;
+      std::unordered_map<code_tuple, uint64_t> _execution_counts;
+      std::vector<code_tuple> _previous_hot_codes;
+      void save_hot_codes();
+
+      //shared_reader: the index published by the writing process, checked for a new version at most every 500ms
+      void reload_shared_index();
+      fc::time_point _next_shared_index_check;
+      ino_t _shared_index_ino = 0;
+      bool _shared_cache_replaced = false;
 };
 
 class code_cache_sync : public code_cache_base {
    public:
-      using code_cache_base::code_cache_base;
+      code_cache_sync(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db);
       ~code_cache_sync();
 
       //Can still fail and return nullptr if, for example, there is an expected instantiation failure
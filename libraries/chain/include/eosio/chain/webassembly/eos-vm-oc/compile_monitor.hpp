@@ -9,4 +9,7 @@ namespace eosio { namespace chain { namespace eosvmoc {
 
 wrapped_fd get_connection_to_compile_monitor(int cache_fd);
 
+/// pins the compile monitor and its trampoline, and so every compile process they start afterwards, to cpus
+void set_compile_monitor_affinity(const std::vector<uint32_t>& cpus);
+
 }}}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <eosio/chain/webassembly/eos-vm-oc/ipc_protocol.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/key_extractors.hpp>
+
+namespace std {
+    template<> struct hash<eosio::chain::eosvmoc::code_tuple> {
+        size_t operator()(const eosio::chain::eosvmoc::code_tuple& ct) const noexcept {
+            return ct.code_id._hash[0];
+        }
+    };
+}
+
+namespace eosio { namespace chain { namespace eosvmoc {
+
+/**
+ * Code waiting for a free compile thread along with how hot it has been in the interpreter meanwhile. The hottest
+ * code, by interpreter time then by executions, is compiled first; equally hot code in the order it was queued.
+ */
+class compile_queue {
+   public:
+      bool contains(const code_tuple& ct) const { return _queue.find(ct) != _queue.end(); }
+      bool empty() const { return _queue.empty(); }
+      size_t size() const { return _queue.size(); }
+
+      //does nothing if the code is already queued
+      void push(const code_tuple& ct) { _queue.insert(queued_compile{ct}); }
+
+      //does nothing if the code is not queued
+      void record_interpreted_execution(const code_tuple& ct, const fc::microseconds& elapsed) {
+         auto it = _queue.find(ct);
+         if(it == _queue.end())
+            return;
+         _queue.modify(it, [&](queued_compile& q) {
+            ++q.executions;
+            q.interpreter_time_us += std::max<int64_t>(elapsed.count(), 0);
+         });
+      }
+
+      //the hottest code, the queue must not be empty
+      const code_tuple& front() const { return _queue.get<by_hotness>().begin()->code; }
+      void pop_front() { _queue.get<by_hotness>().erase(_queue.get<by_hotness>().begin()); }
+
+      bool erase(const code_tuple& ct) { return _queue.erase(ct); }
+
+   private:
+      struct queued_compile {
+         code_tuple code;
+         uint64_t   executions = 0;
+         uint64_t   interpreter_time_us = 0;
+      };
+      struct by_hotness;
+      typedef boost::multi_index_container<
+         queued_compile,
+         boost::multi_index::indexed_by<
+            boost::multi_index::hashed_unique<boost::multi_index::member<queued_compile, code_tuple, &queued_compile::code>,
+                                              std::hash<code_tuple>>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_hotness>,
+               boost::multi_index::composite_key< queued_compile,
+                  boost::multi_index::member<queued_compile, uint64_t, &queued_compile::interpreter_time_us>,
+                  boost::multi_index::member<queued_compile, uint64_t, &queued_compile::executions>
+               >,
+               boost::multi_index::composite_key_compare< std::greater<uint64_t>, std::greater<uint64_t> >
+            >
+         >
+      > queued_compile_index;
+      queued_compile_index _queue;
+};
+
+}}}
@@ -10,9 +10,44 @@
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
+/**
+ * Optimization tiers of the LLVM pipeline, each one includes the previous:
+ *  0: mem2reg, instcombine, CFG simplification, jump threading and constant propagation
+ *  1: adds early CSE, SCCP, reassociation, GVN, LICM and dead store elimination
+ *  2: adds inlining of small wasm functions, loop unrolling and vectorization and the aggressive backend
+ * Higher tiers only change how fast the generated code runs, never what it does.
+ */
+constexpr uint8_t max_opt_level = 2u;
+
+/**
+ * How the code cache file is shared with other nodeos processes on the host. A shared_writer compiles and publishes
+ * its index next to the cache file, and never frees compiled code because readers may be running it. A
+ * shared_reader maps the file read-only, compiles nothing and picks up the published index as it changes.
+ */
+enum class cache_mode {
+   exclusive,
+   shared_writer,
+   shared_reader
+};
+
 struct config {
    uint64_t cache_size = 1024u*1024u*1024u;
    uint64_t threads    = 1u;
+   uint32_t warm_up_codes = 64u; ///< hottest codes recorded at shutdown and compiled at startup
+   uint32_t execution_slices = 1u; ///< executor and memory pairs of the tier-up, those beyond the first run context-free actions ahead
+   uint8_t  opt_level = 0u; ///< tier codes are first compiled at
+   uint8_t  hot_opt_level = 0u; ///< tier codes are recompiled at once hot, ignored unless above opt_level
+   uint32_t hot_recompile_executions = 10000u; ///< executions of compiled code that make it hot
+   cache_mode mode = cache_mode::exclusive;
+   boost::filesystem::path cache_dir; ///< directory of code_cache.bin, the state directory when empty
+};
+
+struct warm_up_status {
+   uint32_t total    = 0; ///< recorded hot codes still on chain
+   uint32_t compiled = 0;
+   uint32_t failed   = 0;
 };
 
 }}}
+
+FC_REFLECT(eosio::chain::eosvmoc::warm_up_status, (total)(compiled)(failed))
@@ -7,7 +7,10 @@
 
 #include <list>
 #include <vector>
+#include <memory>
 #include <cstddef>
+#include <mutex>
+#include <condition_variable>
 
 namespace eosio { namespace chain {
 
@@ -24,7 +27,7 @@ class executor {
       executor(const code_cache_base& cc);
       ~executor();
 
-      void execute(const code_descriptor& code, const memory& mem, apply_context& context);
+      void execute(const code_descriptor& code, memory& mem, apply_context& context);
 
    private:
       uint8_t* code_mapping;
@@ -36,4 +39,33 @@ class executor {
       std::list<std::vector<std::byte>> executors_bounce_buffers;
 };
 
+/**
+ * A fixed set of executor and memory pairs, each memory mapping its own full set of
+ * memory::total_memory_per_slice strides, so that OC compiled code can run on several
+ * threads at the same time. A thread takes a pair for the duration of one action and
+ * waits when all of them are in use. Code descriptors still have to be looked up in the
+ * code cache from a single thread. The tier-up runs the context-free actions a transaction
+ * runs ahead of its other actions on the slices beyond the first.
+ */
+class executor_pool {
+   struct execution_slice;
+
+   public:
+      executor_pool(const code_cache_base& cc, uint32_t slices);
+      ~executor_pool();
+
+      void execute(const code_descriptor& code, apply_context& context);
+
+      uint32_t size() const { return _slices.size(); }
+
+   private:
+      execution_slice& acquire();
+      void release(execution_slice& s);
+
+      std::vector<std::unique_ptr<execution_slice>> _slices;
+      std::vector<execution_slice*>                 _free_slices;
+      std::mutex                                    _mtx;
+      std::condition_variable                       _slice_released;
+};
+
 }}}
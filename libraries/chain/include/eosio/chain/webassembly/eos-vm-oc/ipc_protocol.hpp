@@ -22,6 +22,8 @@ struct code_tuple {
 
 struct compile_wasm_message {
    code_tuple code;
+   uint8_t opt_level = 0;
+   uint32_t partitions = 1; ///< processes the functions of a large module may be compiled by in parallel
    //Two sent fd: 1) communication socket for result, 2) the wasm to compile
 };
 
@@ -49,6 +51,15 @@ struct wasm_compilation_result_message {
    code_tuple code;
    wasm_compilation_result result;
    size_t cache_free_bytes;
+   uint8_t opt_level = 0;
+};
+
+//code compiled elsewhere to store in the cache, answered like a compile_wasm_message
+struct import_code_message {
+   code_tuple code;
+   code_compilation_result_message compiled;
+   uint8_t opt_level = 0;
+   //Two sent fds: 1) wasm code, 2) initial memory snapshot
 };
 
 using eosvmoc_message = fc::static_variant<initialize_message,
@@ -56,16 +67,18 @@ using eosvmoc_message = fc::static_variant<initialize_message,
                                            compile_wasm_message,
                                            evict_wasms_message,
                                            code_compilation_result_message,
-                                           wasm_compilation_result_message
+                                           wasm_compilation_result_message,
+                                           import_code_message
                                           >;
 }}}
 
 FC_REFLECT(eosio::chain::eosvmoc::initialize_message, )
 FC_REFLECT(eosio::chain::eosvmoc::initalize_response_message, (error_message))
 FC_REFLECT(eosio::chain::eosvmoc::code_tuple, (code_id)(vm_version))
-FC_REFLECT(eosio::chain::eosvmoc::compile_wasm_message, (code))
+FC_REFLECT(eosio::chain::eosvmoc::compile_wasm_message, (code)(opt_level)(partitions))
 FC_REFLECT(eosio::chain::eosvmoc::evict_wasms_message, (codes))
 FC_REFLECT(eosio::chain::eosvmoc::code_compilation_result_message, (start)(apply_offset)(starting_memory_pages)(initdata_prologue_size))
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_unknownfailure, )
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_toofull, )
-FC_REFLECT(eosio::chain::eosvmoc::wasm_compilation_result_message, (code)(result)(cache_free_bytes))
\ No newline at end of file
+FC_REFLECT(eosio::chain::eosvmoc::wasm_compilation_result_message, (code)(result)(cache_free_bytes)(opt_level))
+FC_REFLECT(eosio::chain::eosvmoc::import_code_message, (code)(compiled)(opt_level))
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <algorithm>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 class memory {
@@ -35,6 +37,19 @@ class memory {
 
       control_block* const get_control_block() const { return reinterpret_cast<control_block* const>(zeropage_base - cb_offset);}
 
+      /**
+       * Zeroes the first pages wasm pages of linear memory before an execution. Only pages below the mark of
+       * those possibly written by earlier executions are cleared. When that is at least release_threshold bytes
+       * they are released from the memfd instead of written, so that only the pages the next execution touches
+       * are faulted in again, already zeroed; contracts starting with a lot of memory but using little of it
+       * do not pay for clearing all of it on every action.
+       */
+      void reset(uint64_t pages);
+      /// pages up to this many may have been written since the last reset
+      void mark_dirty(uint64_t pages) { dirty_pages = std::max(dirty_pages, pages); }
+
+      static constexpr uint64_t release_threshold = 1024u*1024u;
+
       //these two are really only inteded for SEGV handling
       uint8_t* const start_of_memory_slices() const { return mapbase; }
       size_t size_of_memory_slice_mapping() const { return mapsize; }
@@ -57,6 +72,8 @@ class memory {
 
       uint8_t* zeropage_base;
       uint8_t* fullpage_base;
+
+      uint64_t dirty_pages = 0; ///< wasm pages of linear memory from its start which may not be zero
 };
 
 }}}
@@ -124,15 +124,6 @@ class eos_vm_runtime : public eosio::chain::wasm_runtime_interface {
                                                                              const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version) override;
 
       void immediately_exit_currently_running_module() override;
-
-   private:
-      // todo: managing this will get more complicated with sync calls;
-      //       immediately_exit_currently_running_module() should probably
-      //       move from wasm_runtime_interface to wasm_instantiated_module_interface.
-      backend<apply_context, Backend>* _bkend = nullptr;  // non owning pointer to allow for immediate exit
-
-   template<typename Impl>
-   friend class eos_vm_instantiated_module;
 };
 
 } } } }// eosio::chain::webassembly::wabt_runtime
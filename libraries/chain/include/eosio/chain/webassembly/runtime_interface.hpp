@@ -14,6 +14,10 @@ class wasm_instantiated_module_interface {
    public:
       virtual void apply(apply_context& context) = 0;
 
+      //builds ahead what running the module on this many threads at once needs, so that the actions do not;
+      //returns the number of additional instances of the module now kept
+      virtual uint32_t prepare_concurrent_apply(uint32_t threads) { return 0; }
+
       virtual ~wasm_instantiated_module_interface();
 };
 
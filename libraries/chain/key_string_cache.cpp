@@ -0,0 +1,114 @@
+#include <eosio/chain/key_string_cache.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <atomic>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      template<typename T>
+      struct string_entry {
+         T           value;
+         std::string str;
+      };
+
+      struct by_value;
+      template<typename T>
+      using string_index = boost::multi_index_container<
+         string_entry<T>,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::ordered_unique< boost::multi_index::tag<by_value>,
+               boost::multi_index::member<string_entry<T>, T, &string_entry<T>::value> >
+         >
+      >;
+
+      struct key_string_cache_impl {
+         mutable std::mutex                 mtx;
+         string_index<public_key_type>      public_keys;
+         string_index<signature_type>       signatures;
+         size_t                             capacity = config::default_key_string_cache_size;
+         std::atomic<uint64_t>              hits{0};
+         std::atomic<uint64_t>              misses{0};
+
+         // requires mtx to be held
+         void evict() {
+            while( public_keys.size() > capacity ) public_keys.pop_back();
+            while( signatures.size() > capacity ) signatures.pop_back();
+         }
+
+         template<typename T>
+         std::string lookup( string_index<T>& entries, const T& v ) {
+            {
+               std::lock_guard<std::mutex> g( mtx );
+               if( capacity == 0 ) {
+                  ++misses;
+                  return std::string( v );
+               }
+               auto& idx = entries.template get<by_value>();
+               auto itr = idx.find( v );
+               if( itr != idx.end() ) {
+                  entries.relocate( entries.begin(), entries.template project<0>( itr ) );
+                  ++hits;
+                  return itr->str;
+               }
+            }
+
+            // convert outside of the lock, other threads may convert the same value concurrently which is harmless
+            ++misses;
+            std::string str( v );
+
+            std::lock_guard<std::mutex> g( mtx );
+            auto res = entries.push_front( string_entry<T>{ v, str } );
+            if( !res.second ) entries.relocate( entries.begin(), res.first );
+            evict();
+            return str;
+         }
+      };
+   }
+
+   key_string_cache& key_string_cache::instance() {
+      static key_string_cache the_cache;
+      return the_cache;
+   }
+
+   key_string_cache::key_string_cache()
+   : my( new detail::key_string_cache_impl() )
+   {}
+
+   key_string_cache::~key_string_cache() = default;
+
+   std::string key_string_cache::to_string( const public_key_type& key ) {
+      return my->lookup( my->public_keys, key );
+   }
+
+   std::string key_string_cache::to_string( const signature_type& sig ) {
+      return my->lookup( my->signatures, sig );
+   }
+
+   void key_string_cache::set_capacity( size_t capacity ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->capacity = capacity;
+      my->evict();
+   }
+
+   key_string_cache::stats key_string_cache::get_stats()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return stats{ my->hits.load(), my->misses.load(), my->public_keys.size() + my->signatures.size(), my->capacity };
+   }
+
+   void key_string_cache::clear() {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->public_keys.clear();
+      my->signatures.clear();
+      my->hits = 0;
+      my->misses = 0;
+   }
+
+} } /// eosio::chain
@@ -0,0 +1,58 @@
+#include <eosio/chain/memory_accounting.hpp>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace eosio { namespace chain { namespace memory_accounting {
+
+std::atomic<bool> subsystem::_enabled{true};
+
+subsystem::subsystem( const std::string& name )
+:_name( name )
+,_live( metrics::registry::instance().get_gauge( "nodeos_memory_live_bytes", "heap bytes held by a subsystem",
+                                                 metrics::registry::label( "subsystem", name ) ) )
+,_allocated( metrics::registry::instance().get_counter( "nodeos_memory_allocated_bytes_total", "heap bytes allocated by a subsystem",
+                                                        metrics::registry::label( "subsystem", name ) ) )
+{}
+
+subsystem& net_buffers() {
+   static subsystem s( "net_buffers" );
+   return s;
+}
+
+subsystem& unapplied_transactions() {
+   static subsystem s( "unapplied_transactions" );
+   return s;
+}
+
+subsystem& block_states() {
+   static subsystem s( "block_states" );
+   return s;
+}
+
+subsystem& wasm_cache() {
+   static subsystem s( "wasm_cache" );
+   return s;
+}
+
+subsystem& mongo_db_queues() {
+   static subsystem s( "mongo_db_queues" );
+   return s;
+}
+
+usage get_usage() {
+   usage result;
+   result.enabled = subsystem::enabled();
+   for( subsystem* s : { &net_buffers(), &unapplied_transactions(), &block_states(), &wasm_cache(), &mongo_db_queues() } ) {
+      result.subsystems.push_back( { s->name(), s->live_bytes(), s->allocated_bytes() } );
+   }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+   // walks the arenas, only done when asked for
+   const auto info = mallinfo2();
+   result.heap_bytes = uint64_t( info.uordblks + info.hblkhd );
+#endif
+   return result;
+}
+
+} } } /// eosio::chain::memory_accounting
@@ -1,5 +1,6 @@
 #include <eosio/chain/merkle.hpp>
 #include <fc/io/raw.hpp>
+#include <cstring>
 
 namespace eosio { namespace chain {
 
@@ -31,19 +32,33 @@ bool is_canonical_right(const digest_type& val) {
    return (val._hash[0] & 0x0000000000000080ULL) != 0;
 }
 
+digest_type hash_canonical_pair(const digest_type& l, const digest_type& r) {
+   static_assert( sizeof(l._hash) == 32, "unexpected digest size" );
+   uint64_t node[8];
+   memcpy( node, l._hash, sizeof(l._hash) );
+   memcpy( node + 4, r._hash, sizeof(r._hash) );
+   node[0] &= 0xFFFFFFFFFFFFFF7FULL;
+   node[4] |= 0x0000000000000080ULL;
+   return digest_type::hash( reinterpret_cast<const char*>(node), sizeof(node) );
+}
 
 digest_type merkle(vector<digest_type> ids) {
    if( 0 == ids.size() ) { return digest_type(); }
 
+   // an odd level duplicates its last node, reserve once so that never reallocates
+   ids.reserve( ids.size() + 1 );
+
    while( ids.size() > 1 ) {
       if( ids.size() % 2 )
          ids.push_back(ids.back());
 
-      for (size_t i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+      // each level is hashed in place, node i only depends on nodes 2i and 2i+1 which are not yet overwritten
+      const size_t n = ids.size() / 2;
+      for (size_t i = 0; i < n; i++) {
+         ids[i] = hash_canonical_pair(ids[2 * i], ids[(2 * i) + 1]);
       }
 
-      ids.resize(ids.size() / 2);
+      ids.resize(n);
    }
 
    return ids.front();
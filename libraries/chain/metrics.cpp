@@ -0,0 +1,150 @@
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace eosio { namespace chain { namespace metrics {
+
+size_t counter::shard_index() {
+   static std::atomic<size_t> next_index{0};
+   thread_local const size_t index = next_index.fetch_add( 1, std::memory_order_relaxed ) % shard_count;
+   return index;
+}
+
+uint64_t counter::value()const {
+   uint64_t v = 0;
+   for( const auto& s : _shards )
+      v += s.value.load( std::memory_order_relaxed );
+   return v;
+}
+
+histogram::histogram( std::vector<uint64_t> bounds )
+:_bounds( std::move( bounds ) )
+,_counts( _bounds.size() + 1 )
+{
+   EOS_ASSERT( std::is_sorted( _bounds.begin(), _bounds.end() ), misc_exception, "histogram bounds must be sorted" );
+}
+
+void histogram::record( uint64_t v ) {
+   const size_t i = std::lower_bound( _bounds.begin(), _bounds.end(), v ) - _bounds.begin();
+   _counts[i].fetch_add( 1, std::memory_order_relaxed );
+   _sum.fetch_add( v, std::memory_order_relaxed );
+}
+
+std::vector<uint64_t> histogram::counts()const {
+   std::vector<uint64_t> result;
+   result.reserve( _counts.size() );
+   for( const auto& c : _counts )
+      result.push_back( c.load( std::memory_order_relaxed ) );
+   return result;
+}
+
+const std::vector<uint64_t>& time_buckets_us() {
+   static const std::vector<uint64_t> b{ 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+   return b;
+}
+
+const std::vector<uint64_t>& size_buckets() {
+   static const std::vector<uint64_t> b{ 256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216 };
+   return b;
+}
+
+registry& registry::instance() {
+   static registry the_instance;
+   return the_instance;
+}
+
+registry::family& registry::get_family( const std::string& name, const std::string& help, metric_type type ) {
+   auto itr = _families.find( name );
+   if( itr == _families.end() ) {
+      itr = _families.emplace( name, family{ type, help } ).first;
+   }
+   EOS_ASSERT( itr->second.type == type, misc_exception, "metric ${n} is already registered with another type", ("n", name) );
+   return itr->second;
+}
+
+counter& registry::get_counter( const std::string& name, const std::string& help, const std::string& labels ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& m = get_family( name, help, metric_type::counter ).counters[labels];
+   if( !m ) m = std::make_unique<counter>();
+   return *m;
+}
+
+gauge& registry::get_gauge( const std::string& name, const std::string& help, const std::string& labels ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& m = get_family( name, help, metric_type::gauge ).gauges[labels];
+   if( !m ) m = std::make_unique<gauge>();
+   return *m;
+}
+
+histogram& registry::get_histogram( const std::string& name, const std::string& help, const std::vector<uint64_t>& bounds,
+                                    const std::string& labels ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& m = get_family( name, help, metric_type::histogram ).histograms[labels];
+   if( !m ) m = std::make_unique<histogram>( bounds );
+   return *m;
+}
+
+std::string registry::prometheus_text( const std::string& prefix )const {
+   std::ostringstream out;
+   auto with_labels = []( const std::string& labels, const std::string& more = std::string() ) {
+      if( labels.empty() && more.empty() ) return std::string();
+      if( labels.empty() || more.empty() ) return "{" + labels + more + "}";
+      return "{" + labels + "," + more + "}";
+   };
+
+   std::lock_guard<std::mutex> g( _mtx );
+   for( auto itr = _families.lower_bound( prefix ); itr != _families.end() && itr->first.compare( 0, prefix.size(), prefix ) == 0; ++itr ) {
+      const auto& name = itr->first;
+      const auto& f = itr->second;
+      out << "# HELP " << name << " " << f.help << "\n";
+      switch( f.type ) {
+         case metric_type::counter:
+            out << "# TYPE " << name << " counter\n";
+            for( const auto& m : f.counters )
+               out << name << with_labels( m.first ) << " " << m.second->value() << "\n";
+            break;
+         case metric_type::gauge:
+            out << "# TYPE " << name << " gauge\n";
+            for( const auto& m : f.gauges )
+               out << name << with_labels( m.first ) << " " << m.second->value() << "\n";
+            break;
+         case metric_type::histogram:
+            out << "# TYPE " << name << " histogram\n";
+            for( const auto& m : f.histograms ) {
+               const auto& bounds = m.second->bounds();
+               const auto counts = m.second->counts();
+               uint64_t cumulative = 0;
+               for( size_t i = 0; i < counts.size(); ++i ) {
+                  cumulative += counts[i];
+                  out << name << "_bucket" << with_labels( m.first, "le=\"" + ( i < bounds.size() ? std::to_string( bounds[i] ) : "+Inf" ) + "\"" )
+                      << " " << cumulative << "\n";
+               }
+               out << name << "_sum" << with_labels( m.first ) << " " << m.second->sum() << "\n";
+               out << name << "_count" << with_labels( m.first ) << " " << cumulative << "\n";
+            }
+            break;
+      }
+   }
+   return out.str();
+}
+
+std::string registry::label( const std::string& key, const std::string& value ) {
+   std::string escaped;
+   escaped.reserve( key.size() + value.size() + 3 );
+   escaped += key;
+   escaped += "=\"";
+   for( char c : value ) {
+      if( c == '\\' || c == '"' ) escaped += '\\';
+      if( c == '\n' ) {
+         escaped += "\\n";
+         continue;
+      }
+      escaped += c;
+   }
+   escaped += '"';
+   return escaped;
+}
+
+} } } /// eosio::chain::metrics
@@ -1,6 +1,5 @@
 #include <eosio/chain/name.hpp>
 #include <fc/variant.hpp>
-#include <boost/algorithm/string.hpp>
 #include <fc/exception/exception.hpp>
 #include <eosio/chain/exceptions.hpp>
 
@@ -8,28 +7,18 @@ namespace eosio::chain {
 
    void name::set( std::string_view str ) {
       const auto len = str.size();
-      EOS_ASSERT(len <= 13, name_type_exception, "Name is longer than 13 characters (${name}) ", ("name", std::string(str)));
+      EOS_ASSERT(len <= max_length, name_type_exception, "Name is longer than 13 characters (${name}) ", ("name", std::string(str)));
       value = string_to_uint64_t(str);
-      EOS_ASSERT(to_string() == str, name_type_exception,
+      char buf[max_length];
+      EOS_ASSERT(std::string_view(buf, to_chars(buf) - buf) == str, name_type_exception,
                  "Name not properly normalized (name: ${name}, normalized: ${normalized}) ",
                  ("name", std::string(str))("normalized", to_string()));
    }
 
    // keep in sync with name::to_string() in contract definition for name
    std::string name::to_string()const {
-     static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
-
-      std::string str(13,'.');
-
-      uint64_t tmp = value;
-      for( uint32_t i = 0; i <= 12; ++i ) {
-         char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
-         str[12-i] = c;
-         tmp >>= (i == 0 ? 4 : 5);
-      }
-
-      boost::algorithm::trim_right_if( str, []( char c ){ return c == '.'; } );
-      return str;
+      char buf[max_length];
+      return std::string( buf, to_chars( buf ) );
    }
 
 } // eosio::chain
@@ -0,0 +1,125 @@
+#include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/platform_timer_accuracy.hpp>
+
+#include <fc/fwd_impl.hpp>
+#include <fc/log/logger_config.hpp> //set_os_thread_name()
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace eosio { namespace chain {
+
+/*
+ * All instances share one watchdog thread which sleeps until the earliest armed deadline. Arming a timer is a heap
+ * insert under a mutex; the thread is only woken when the new deadline is earlier than the one it sleeps until,
+ * which is rarely the case when transactions run back to back since each deadline lies after the previous one.
+ * Disarming is an erase, the thread notices on its next wake up. No kernel timer is reprogrammed per transaction.
+ */
+namespace {
+   using deadline_map = std::multimap<fc::time_point, platform_timer*>;
+
+   struct watchdog {
+      std::mutex              mtx;
+      std::condition_variable cv;
+      deadline_map            deadlines;
+      fc::time_point          wake_at = fc::time_point::maximum(); ///< deadline the thread sleeps until
+      bool                    stopping = false;
+      std::thread             thread;
+   };
+
+   std::mutex                watchdog_ref_mutex;
+   unsigned                  refcount;
+   std::unique_ptr<watchdog> the_watchdog;
+}
+
+struct platform_timer::impl {
+   deadline_map::iterator deadline;
+   bool                   armed = false;
+
+   static void run( watchdog& w ) {
+      fc::set_os_thread_name( "checktime" );
+      std::unique_lock g( w.mtx );
+      while( !w.stopping ) {
+         const auto now = fc::time_point::now();
+         while( !w.deadlines.empty() && w.deadlines.begin()->first <= now ) {
+            platform_timer* t = w.deadlines.begin()->second;
+            w.deadlines.erase( w.deadlines.begin() );
+            t->my->armed = false;
+            t->expired = 1;
+            // under the lock, so that once stop() returns the callback is not running
+            t->call_expiration_callback();
+         }
+         w.wake_at = w.deadlines.empty() ? fc::time_point::maximum() : w.deadlines.begin()->first;
+         if( w.wake_at == fc::time_point::maximum() ) {
+            w.cv.wait( g );
+         } else {
+            w.cv.wait_until( g, std::chrono::system_clock::time_point( std::chrono::microseconds( w.wake_at.time_since_epoch().count() ) ) );
+         }
+      }
+   }
+};
+
+platform_timer::platform_timer() {
+   static_assert(sizeof(impl) <= fwd_size);
+
+   if(std::lock_guard guard(watchdog_ref_mutex); refcount++ == 0) {
+      the_watchdog = std::make_unique<watchdog>();
+      the_watchdog->thread = std::thread( [w = the_watchdog.get()]() { impl::run( *w ); } );
+   }
+
+   compute_and_print_timer_accuracy(*this);
+}
+
+platform_timer::~platform_timer() {
+   stop();
+   if(std::lock_guard guard(watchdog_ref_mutex); --refcount == 0) {
+      {
+         std::lock_guard g( the_watchdog->mtx );
+         the_watchdog->stopping = true;
+      }
+      the_watchdog->cv.notify_one();
+      the_watchdog->thread.join();
+      the_watchdog.reset();
+   }
+}
+
+void platform_timer::start(fc::time_point tp) {
+   if(tp == fc::time_point::maximum()) {
+      expired = 0;
+      return;
+   }
+   if(tp <= fc::time_point::now()) {
+      expired = 1;
+      return;
+   }
+
+   watchdog& w = *the_watchdog;
+   bool wake = false;
+   {
+      std::lock_guard g( w.mtx );
+      expired = 0;
+      my->deadline = w.deadlines.emplace( tp, this );
+      my->armed = true;
+      wake = tp < w.wake_at;
+      if( wake ) w.wake_at = tp;
+   }
+   if( wake ) w.cv.notify_one();
+}
+
+void platform_timer::stop() {
+   if(expired)
+      return;
+
+   watchdog& w = *the_watchdog;
+   std::lock_guard g( w.mtx );
+   if( my->armed ) {
+      w.deadlines.erase( my->deadline );
+      my->armed = false;
+   }
+   expired = 1;
+}
+
+}}
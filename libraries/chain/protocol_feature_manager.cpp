@@ -621,10 +621,16 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       return const_iterator{this, static_cast<std::size_t>(itr - begin)};
    }
 
-   bool protocol_feature_manager::is_builtin_activated( builtin_protocol_feature_t feature_codename,
-                                                        uint32_t current_block_num )const
+   bool protocol_feature_manager::refresh_builtin_activation_cache( uint32_t indx, uint32_t current_block_num )const
    {
-      uint32_t indx = static_cast<uint32_t>( feature_codename );
+      if( current_block_num != builtin_protocol_feature_entry::not_active ) {
+         uint64_t mask = 0;
+         for( uint32_t i = 0; i < _builtin_protocol_features.size() && i < 32; ++i ) {
+            if( _builtin_protocol_features[i].activation_block_num <= current_block_num )
+               mask |= uint64_t(1) << i;
+         }
+         _builtin_activation_cache.store( (uint64_t(current_block_num) << 32) | mask, std::memory_order_relaxed );
+      }
 
       if( indx >= _builtin_protocol_features.size() ) return false;
 
@@ -677,6 +683,7 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       _builtin_protocol_features[indx].previous = _head_of_builtin_activation_list;
       _builtin_protocol_features[indx].activation_block_num = current_block_num;
       _head_of_builtin_activation_list = indx;
+      _builtin_activation_cache.store( invalid_builtin_activation_cache, std::memory_order_relaxed );
    }
 
    void protocol_feature_manager::popped_blocks_to( uint32_t block_num ) {
@@ -696,6 +703,7 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       {
          _activated_protocol_features.pop_back();
       }
+      _builtin_activation_cache.store( invalid_builtin_activation_cache, std::memory_order_relaxed );
    }
 
 } }  // eosio::chain
@@ -6,6 +6,7 @@
 #include <boost/tuple/tuple_io.hpp>
 #include <eosio/chain/database_utils.hpp>
 #include <algorithm>
+#include <unordered_map>
 
 namespace eosio { namespace chain { namespace resource_limits {
 
@@ -18,6 +19,145 @@ using resource_index_set = index_set<
 
 static_assert( config::rate_limiting_precision > 0, "config::rate_limiting_precision must be positive" );
 
+namespace impl {
+   struct pending_account_usage {
+      usage_accumulator net_usage;
+      usage_accumulator cpu_usage;
+      uint64_t          saved_in_level = 0; ///< id of the innermost usage session that saved the prior value
+   };
+
+   struct pending_usage_state {
+      struct saved_usage {
+         account_name                    account;
+         optional<pending_account_usage> prior;   ///< empty if the account had no pending usage
+      };
+
+      struct level {
+         uint64_t id;
+         size_t   saved_begin;
+         uint64_t cpu_usage;
+         uint64_t net_usage;
+      };
+
+      std::unordered_map<account_name, pending_account_usage> accounts;
+      uint64_t                                                cpu_usage = 0; ///< not yet added to resource_limits_state_object::pending_cpu_usage
+      uint64_t                                                net_usage = 0; ///< not yet added to resource_limits_state_object::pending_net_usage
+
+      vector<saved_usage>                                     saved;
+      vector<level>                                           levels;
+      uint64_t                                                next_level_id = 1;
+
+      void clear() {
+         accounts.clear();
+         cpu_usage = 0;
+         net_usage = 0;
+         saved.clear();
+         for( auto& l : levels ) {
+            l.saved_begin = 0;
+            l.cpu_usage = 0;
+            l.net_usage = 0;
+         }
+      }
+   };
+}
+
+resource_limits_manager::usage_session::usage_session( resource_limits_manager& rl, uint64_t level_id )
+:_rl(&rl), _level_id(level_id)
+{}
+
+resource_limits_manager::usage_session::usage_session( usage_session&& mv )
+:_rl(mv._rl), _level_id(mv._level_id)
+{
+   mv._rl = nullptr;
+}
+
+resource_limits_manager::usage_session& resource_limits_manager::usage_session::operator=( usage_session&& mv ) {
+   if( this == &mv ) return *this;
+   undo();
+   _rl = mv._rl;
+   _level_id = mv._level_id;
+   mv._rl = nullptr;
+   return *this;
+}
+
+resource_limits_manager::usage_session::~usage_session() {
+   undo();
+}
+
+void resource_limits_manager::usage_session::squash() {
+   if( _rl ) _rl->end_usage_session( _level_id, false );
+   _rl = nullptr;
+}
+
+void resource_limits_manager::usage_session::undo() {
+   if( _rl ) _rl->end_usage_session( _level_id, true );
+   _rl = nullptr;
+}
+
+void resource_limits_manager::usage_session::push() {
+   squash();
+}
+
+resource_limits_manager::resource_limits_manager( chainbase::database& db )
+:_db(db)
+,_pending(std::make_unique<impl::pending_usage_state>())
+{
+}
+
+resource_limits_manager::~resource_limits_manager() = default;
+
+resource_limits_manager::usage_session resource_limits_manager::start_usage_session() {
+   auto& p = *_pending;
+   const uint64_t id = p.next_level_id++;
+   p.levels.push_back( impl::pending_usage_state::level{ id, p.saved.size(), p.cpu_usage, p.net_usage } );
+   return usage_session( *this, id );
+}
+
+void resource_limits_manager::end_usage_session( uint64_t level_id, bool undo ) {
+   auto& p = *_pending;
+   EOS_ASSERT( !p.levels.empty() && p.levels.back().id == level_id, resource_limit_exception,
+               "usage sessions must be ended in the reverse order they were started" );
+   const auto l = p.levels.back();
+   p.levels.pop_back();
+   if( !undo ) {
+      // saved values now belong to the enclosing session, they are only needed if there is one
+      if( p.levels.empty() ) p.saved.clear();
+      return;
+   }
+
+   for( size_t i = p.saved.size(); i > l.saved_begin; --i ) {
+      auto& s = p.saved[i - 1];
+      if( s.prior ) {
+         p.accounts[s.account] = *s.prior;
+      } else {
+         p.accounts.erase( s.account );
+      }
+   }
+   p.saved.resize( l.saved_begin );
+   p.cpu_usage = l.cpu_usage;
+   p.net_usage = l.net_usage;
+}
+
+const impl::pending_account_usage* resource_limits_manager::find_pending_usage( const account_name& account )const {
+   auto itr = _pending->accounts.find( account );
+   return itr != _pending->accounts.end() ? &itr->second : nullptr;
+}
+
+impl::pending_account_usage& resource_limits_manager::modify_pending_usage( const account_name& account ) {
+   auto& p = *_pending;
+   const uint64_t level_id = p.levels.empty() ? 0 : p.levels.back().id;
+   auto itr = p.accounts.find( account );
+   if( itr == p.accounts.end() ) {
+      const auto& usage = _db.get<resource_usage_object,by_owner>( account );
+      if( level_id ) p.saved.push_back( { account, optional<impl::pending_account_usage>() } );
+      itr = p.accounts.emplace( account, impl::pending_account_usage{ usage.net_usage, usage.cpu_usage, level_id } ).first;
+   } else if( level_id && itr->second.saved_in_level != level_id ) {
+      p.saved.push_back( { account, itr->second } );
+      itr->second.saved_in_level = level_id;
+   }
+   return itr->second;
+}
+
 static uint64_t update_elastic_limit(uint64_t current_limit, uint64_t average_usage, const elastic_limit_parameters& params) {
    uint64_t result = current_limit;
    if (average_usage > params.target ) {
@@ -52,6 +192,7 @@ void resource_limits_manager::add_indices() {
 }
 
 void resource_limits_manager::initialize_database() {
+   _pending->clear();
    const auto& config = _db.create<resource_limits_config_object>([](resource_limits_config_object& config){
       // see default settings in the declaration
    });
@@ -76,6 +217,7 @@ void resource_limits_manager::add_to_snapshot( const snapshot_writer_ptr& snapsh
 }
 
 void resource_limits_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+   _pending->clear();
    resource_index_set::walk_indices([this, &snapshot]( auto utils ){
       snapshot->read_section<typename decltype(utils)::index_t::value_type>([this]( auto& section ) {
          bool more = !section.empty();
@@ -113,11 +255,9 @@ void resource_limits_manager::set_block_parameters(const elastic_limit_parameter
 void resource_limits_manager::update_account_usage(const flat_set<account_name>& accounts, uint32_t time_slot ) {
    const auto& config = _db.get<resource_limits_config_object>();
    for( const auto& a : accounts ) {
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
-      });
+      auto& usage = modify_pending_usage( a );
+      usage.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
+      usage.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
    }
 }
 
@@ -127,16 +267,14 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
 
    for( const auto& a : accounts ) {
 
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
+      auto& usage = modify_pending_usage( a );
       int64_t unused;
       int64_t net_weight;
       int64_t cpu_weight;
       get_account_limits( a, unused, net_weight, cpu_weight );
 
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
-      });
+      usage.net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
+      usage.cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
 
       if( cpu_weight >= 0 && state.total_cpu_weight > 0 ) {
          uint128_t window_size = config.account_cpu_usage_average_window;
@@ -178,41 +316,48 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
    }
 
    // account for this transaction in the block and do not exceed those limits either
-   _db.modify(state, [&](resource_limits_state_object& rls){
-      rls.pending_cpu_usage += cpu_usage;
-      rls.pending_net_usage += net_usage;
-   });
+   _pending->cpu_usage += cpu_usage;
+   _pending->net_usage += net_usage;
 
-   EOS_ASSERT( state.pending_cpu_usage <= config.cpu_limit_parameters.max, block_resource_exhausted, "Block has insufficient cpu resources" );
-   EOS_ASSERT( state.pending_net_usage <= config.net_limit_parameters.max, block_resource_exhausted, "Block has insufficient net resources" );
+   EOS_ASSERT( state.pending_cpu_usage + _pending->cpu_usage <= config.cpu_limit_parameters.max, block_resource_exhausted, "Block has insufficient cpu resources" );
+   EOS_ASSERT( state.pending_net_usage + _pending->net_usage <= config.net_limit_parameters.max, block_resource_exhausted, "Block has insufficient net resources" );
 }
 
-void resource_limits_manager::add_pending_ram_usage( const account_name account, int64_t ram_delta ) {
-   if (ram_delta == 0) {
+void resource_limits_manager::add_pending_ram_usage( const account_name account, int64_t ram_delta, bool verify ) {
+   if (ram_delta == 0 && !verify) {
       return;
    }
 
    const auto& usage  = _db.get<resource_usage_object,by_owner>( account );
 
-   EOS_ASSERT( ram_delta <= 0 || UINT64_MAX - usage.ram_usage >= (uint64_t)ram_delta, transaction_exception,
-              "Ram usage delta would overflow UINT64_MAX");
-   EOS_ASSERT(ram_delta >= 0 || usage.ram_usage >= (uint64_t)(-ram_delta), transaction_exception,
-              "Ram usage delta would underflow UINT64_MAX");
+   if (ram_delta != 0) {
+      EOS_ASSERT( ram_delta <= 0 || UINT64_MAX - usage.ram_usage >= (uint64_t)ram_delta, transaction_exception,
+                 "Ram usage delta would overflow UINT64_MAX");
+      EOS_ASSERT(ram_delta >= 0 || usage.ram_usage >= (uint64_t)(-ram_delta), transaction_exception,
+                 "Ram usage delta would underflow UINT64_MAX");
 
-   _db.modify( usage, [&]( auto& u ) {
-     u.ram_usage += ram_delta;
-   });
+      _db.modify( usage, [&]( auto& u ) {
+        u.ram_usage += ram_delta;
+      });
+   }
+
+   if (verify) {
+      verify_ram_usage( account, usage.ram_usage );
+   }
 }
 
 void resource_limits_manager::verify_account_ram_usage( const account_name account )const {
+   verify_ram_usage( account, _db.get<resource_usage_object,by_owner>( account ).ram_usage );
+}
+
+void resource_limits_manager::verify_ram_usage( const account_name account, uint64_t ram_usage )const {
    int64_t ram_bytes; int64_t net_weight; int64_t cpu_weight;
    get_account_limits( account, ram_bytes, net_weight, cpu_weight );
-   const auto& usage  = _db.get<resource_usage_object,by_owner>( account );
 
    if( ram_bytes >= 0 ) {
-      EOS_ASSERT( usage.ram_usage <= static_cast<uint64_t>(ram_bytes), ram_usage_exceeded,
+      EOS_ASSERT( ram_usage <= static_cast<uint64_t>(ram_bytes), ram_usage_exceeded,
                   "account ${account} has insufficient ram; needs ${needs} bytes has ${available} bytes",
-                  ("account", account)("needs",usage.ram_usage)("available",ram_bytes)              );
+                  ("account", account)("needs",ram_usage)("available",ram_bytes)              );
    }
 }
 
@@ -326,9 +471,21 @@ void resource_limits_manager::process_account_limit_updates() {
 }
 
 void resource_limits_manager::process_block_usage(uint32_t block_num) {
+   // write the usage accumulated by the transactions of the block, once per account
+   for( const auto& pending_usage : _pending->accounts ) {
+      const auto& usage = _db.get<resource_usage_object,by_owner>( pending_usage.first );
+      _db.modify( usage, [&]( auto& bu ){
+         bu.net_usage = pending_usage.second.net_usage;
+         bu.cpu_usage = pending_usage.second.cpu_usage;
+      });
+   }
+
    const auto& s = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
    _db.modify(s, [&](resource_limits_state_object& state){
+      state.pending_cpu_usage += _pending->cpu_usage;
+      state.pending_net_usage += _pending->net_usage;
+
       // apply pending usage, update virtual limits and reset the pending
 
       state.average_block_cpu_usage.add(state.pending_cpu_usage, block_num, config.cpu_limit_parameters.periods);
@@ -341,6 +498,8 @@ void resource_limits_manager::process_block_usage(uint32_t block_num) {
 
    });
 
+   // the written usage is covered by the enclosing chainbase undo sessions from here on
+   _pending->clear();
 }
 
 uint64_t resource_limits_manager::get_virtual_block_cpu_limit() const {
@@ -356,13 +515,13 @@ uint64_t resource_limits_manager::get_virtual_block_net_limit() const {
 uint64_t resource_limits_manager::get_block_cpu_limit() const {
    const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
-   return config.cpu_limit_parameters.max - state.pending_cpu_usage;
+   return config.cpu_limit_parameters.max - state.pending_cpu_usage - _pending->cpu_usage;
 }
 
 uint64_t resource_limits_manager::get_block_net_limit() const {
    const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
-   return config.net_limit_parameters.max - state.pending_net_usage;
+   return config.net_limit_parameters.max - state.pending_net_usage - _pending->net_usage;
 }
 
 std::pair<int64_t, bool> resource_limits_manager::get_account_cpu_limit( const account_name& name, uint32_t greylist_limit ) const {
@@ -401,7 +560,9 @@ std::pair<account_resource_limit, bool> resource_limits_manager::get_account_cpu
    uint128_t all_user_weight = (uint128_t)state.total_cpu_weight;
 
    auto max_user_use_in_window = (virtual_cpu_capacity_in_window * user_weight) / all_user_weight;
-   auto cpu_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.cpu_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   const auto* pending_usage = find_pending_usage( name );
+   const auto& cpu_usage = pending_usage ? pending_usage->cpu_usage : usage.cpu_usage;
+   auto cpu_used_in_window  = impl::integer_divide_ceil((uint128_t)cpu_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
 
    if( max_user_use_in_window <= cpu_used_in_window )
       arl.available = 0;
@@ -448,7 +609,9 @@ std::pair<account_resource_limit, bool> resource_limits_manager::get_account_net
    uint128_t all_user_weight = (uint128_t)state.total_net_weight;
 
    auto max_user_use_in_window = (virtual_network_capacity_in_window * user_weight) / all_user_weight;
-   auto net_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.net_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   const auto* pending_usage = find_pending_usage( name );
+   const auto& net_usage = pending_usage ? pending_usage->net_usage : usage.net_usage;
+   auto net_used_in_window  = impl::integer_divide_ceil((uint128_t)net_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
 
    if( max_user_use_in_window <= net_used_in_window )
       arl.available = 0;
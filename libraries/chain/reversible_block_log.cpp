@@ -0,0 +1,292 @@
+#include <eosio/chain/reversible_block_log.hpp>
+#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
+#include <boost/filesystem.hpp>
+
+namespace eosio { namespace chain {
+
+   const uint32_t reversible_block_log::magic_number = 0x30510EB1;
+
+   /**
+    * History:
+    * Version 1: initial version, replacing the reversible blocks chainbase database
+    */
+   const uint32_t reversible_block_log::version = 1;
+
+   namespace {
+      constexpr uint64_t header_size       = sizeof(uint32_t) + sizeof(uint32_t);   // magic, version
+      constexpr uint64_t entry_header_size = sizeof(uint32_t) + sizeof(uint32_t);   // block num, size
+
+      // the file is rewritten without the irreversible blocks once they take up at least this much and more than
+      // the reversible blocks, so that on average every byte is copied at most once
+      constexpr uint64_t min_reclaim_size  = 16*1024*1024;
+      constexpr size_t   copy_buffer_size  = 1024*1024;
+
+      const auto legacy_database_filename  = "shared_memory.bin";
+
+      fc::path temp_path( const fc::path& log_path ) {
+         return log_path.generic_string() + ".tmp";
+      }
+
+      /// moves the consecutive blocks of a reversible blocks chainbase database written by an older version into log
+      void import_legacy_database( const fc::path& reversible_dir, reversible_block_log& log ) {
+         ilog( "Converting reversible blocks database in '${dir}' to a reversible block log", ("dir", reversible_dir) );
+         uint32_t num = 0;
+         try {
+            chainbase::database legacy( reversible_dir, chainbase::database::read_only, 0, true );
+            legacy.add_index<reversible_block_index>();
+            for( const auto& obj : legacy.get_index<reversible_block_index,by_num>() ) {
+               if( !log.empty() && obj.blocknum != log.last_block_num() + 1 ) {
+                  wlog( "gap in reversible block database between ${end} and ${blocknum}",
+                        ("end", log.last_block_num())("blocknum", obj.blocknum) );
+                  break;
+               }
+               log.append( obj.get_block() );
+               ++num;
+            }
+         } catch( const std::runtime_error& e ) {
+            wlog( "Did not convert all reversible blocks since the reversible database is incompatible: ${e}", ("e", e.what()) );
+         } catch( const fc::exception& e ) {
+            wlog( "Did not convert all reversible blocks: ${details}", ("details", e.to_detail_string()) );
+         }
+         ilog( "Converted ${num} reversible blocks", ("num", num) );
+         fc::remove( reversible_dir / legacy_database_filename );
+      }
+   }
+
+   reversible_block_log::reversible_block_log( const fc::path& reversible_dir, bool read_only )
+   :log_path( reversible_dir / config::reversible_blocks_log_filename ),
+    read_only( read_only )
+   {
+      log_file.set_file_path( log_path );
+      if( read_only ) {
+         if( fc::exists( log_path ) ) {
+            reopen( "rb" );
+            scan();
+         }
+         return;
+      }
+
+      if( !fc::is_directory( reversible_dir ) )
+         fc::create_directories( reversible_dir );
+      fc::remove( temp_path( log_path ) ); // left behind by a rewrite that did not finish
+
+      const bool import_legacy = !fc::exists( log_path ) && fc::exists( reversible_dir / legacy_database_filename );
+
+      // open to create the file if it does not exist
+      reopen( "ab+" );
+      reopen( "rb+" );
+      scan();
+
+      if( import_legacy )
+         import_legacy_database( reversible_dir, *this );
+   }
+
+   reversible_block_log::~reversible_block_log() {
+      if( log_file.is_open() ) {
+         log_file.flush();
+         log_file.close();
+      }
+   }
+
+   void reversible_block_log::reopen( const char* mode ) {
+      if( log_file.is_open() )
+         log_file.close();
+      log_file.open( mode );
+   }
+
+   void reversible_block_log::scan() {
+      log_file.seek_end( 0 );
+      const uint64_t file_size = log_file.tellp();
+
+      if( file_size == 0 ) {
+         end_pos = header_size;
+         if( read_only ) return;
+         log_file.seek( 0 );
+         log_file.write( reinterpret_cast<const char*>(&magic_number), sizeof(magic_number) );
+         log_file.write( reinterpret_cast<const char*>(&version), sizeof(version) );
+         log_file.flush();
+         return;
+      }
+
+      uint32_t magic = 0;
+      uint32_t log_version = 0;
+      EOS_ASSERT( file_size >= header_size, reversible_blocks_exception,
+                  "reversible block log '${path}' is too small to contain its header", ("path", log_path) );
+      log_file.seek( 0 );
+      log_file.read( reinterpret_cast<char*>(&magic), sizeof(magic) );
+      log_file.read( reinterpret_cast<char*>(&log_version), sizeof(log_version) );
+      EOS_ASSERT( magic == magic_number, reversible_blocks_exception,
+                  "'${path}' is not a reversible block log", ("path", log_path) );
+      EOS_ASSERT( log_version == version, reversible_blocks_exception,
+                  "unsupported version of reversible block log '${path}': ${actual}, supported version: ${version}",
+                  ("path", log_path)("actual", log_version)("version", version) );
+
+      uint64_t pos = header_size;
+      while( pos + entry_header_size <= file_size ) {
+         uint32_t num = 0;
+         uint32_t size = 0;
+         log_file.seek( pos );
+         log_file.read( reinterpret_cast<char*>(&num), sizeof(num) );
+         log_file.read( reinterpret_cast<char*>(&size), sizeof(size) );
+         if( pos + entry_header_size + size > file_size )
+            break;
+         if( !empty() && num != last_block_num() + 1 )
+            break;
+
+         // the block's own block number guards against an entry that was only partly written
+         block_header h;
+         try {
+            auto ds = log_file.create_datastream();
+            fc::raw::unpack( ds, h );
+         } catch( ... ) {
+            break;
+         }
+         if( h.block_num() != num )
+            break;
+
+         if( empty() )
+            first_num = num;
+         positions.push_back( pos );
+         pos += entry_header_size + size;
+      }
+      end_pos = pos;
+
+      if( end_pos != file_size ) {
+         dropped_partial = true;
+         wlog( "reversible block log '${path}' ends with ${n} bytes that are not a complete block, dropping them",
+               ("path", log_path)("n", file_size - end_pos) );
+         if( !read_only )
+            truncate_file( end_pos );
+      }
+   }
+
+   void reversible_block_log::truncate_file( uint64_t size ) {
+      log_file.close();
+      boost::filesystem::resize_file( log_path, size );
+      reopen( "rb+" );
+   }
+
+   void reversible_block_log::append( const signed_block_ptr& b ) {
+      EOS_ASSERT( !read_only, reversible_blocks_exception, "cannot append to a read only reversible block log" );
+      const uint32_t num = b->block_num();
+      EOS_ASSERT( empty() || num == last_block_num() + 1, reversible_blocks_exception,
+                  "block ${num} does not follow the last reversible block ${last}",
+                  ("num", num)("last", last_block_num()) );
+
+      const auto data = fc::raw::pack( *b );
+      const uint32_t size = data.size();
+      log_file.seek( end_pos );
+      log_file.write( reinterpret_cast<const char*>(&num), sizeof(num) );
+      log_file.write( reinterpret_cast<const char*>(&size), sizeof(size) );
+      log_file.write( data.data(), data.size() );
+      log_file.flush();
+
+      if( empty() )
+         first_num = num;
+      positions.push_back( end_pos );
+      end_pos += entry_header_size + size;
+   }
+
+   void reversible_block_log::remove_through( uint32_t block_num ) {
+      if( empty() || block_num < first_num )
+         return;
+      if( block_num >= last_block_num() ) {
+         positions.clear();
+      } else {
+         positions.erase( positions.begin(), positions.begin() + (block_num - first_num + 1) );
+         first_num = block_num + 1;
+      }
+      reclaim();
+   }
+
+   void reversible_block_log::truncate_from( uint32_t block_num ) {
+      if( empty() || block_num > last_block_num() )
+         return;
+      if( block_num <= first_num ) {
+         positions.clear();
+         end_pos = header_size; // the irreversible blocks before the first position go as well
+      } else {
+         end_pos = positions[block_num - first_num];
+         positions.resize( block_num - first_num );
+      }
+      if( !read_only )
+         truncate_file( end_pos );
+   }
+
+   void reversible_block_log::reclaim() {
+      if( read_only )
+         return;
+      const uint64_t live_pos = empty() ? end_pos : positions.front();
+      const uint64_t dead = live_pos - header_size;
+      if( dead < min_reclaim_size || dead < end_pos - live_pos )
+         return;
+
+      if( empty() ) {
+         end_pos = header_size;
+         truncate_file( end_pos );
+         return;
+      }
+
+      const auto tmp_path = temp_path( log_path );
+      fc::cfile new_file;
+      new_file.set_file_path( tmp_path );
+      new_file.open( "wb" );
+      new_file.write( reinterpret_cast<const char*>(&magic_number), sizeof(magic_number) );
+      new_file.write( reinterpret_cast<const char*>(&version), sizeof(version) );
+
+      std::vector<char> buffer( copy_buffer_size );
+      log_file.seek( live_pos );
+      for( uint64_t remaining = end_pos - live_pos; remaining > 0; ) {
+         const size_t n = std::min<uint64_t>( remaining, buffer.size() );
+         log_file.read( buffer.data(), n );
+         new_file.write( buffer.data(), n );
+         remaining -= n;
+      }
+      new_file.flush();
+      new_file.close();
+
+      log_file.close();
+      fc::rename( tmp_path, log_path );
+      reopen( "rb+" );
+
+      for( auto& p : positions )
+         p -= dead;
+      end_pos -= dead;
+   }
+
+   std::vector<char> reversible_block_log::read_serialized_block( uint32_t block_num )const {
+      if( !contains( block_num ) )
+         return {};
+      const size_t i = block_num - first_num;
+      const uint64_t pos = positions[i] + entry_header_size;
+      const uint64_t next = i + 1 < positions.size() ? positions[i + 1] : end_pos;
+      std::vector<char> data( next - pos );
+      log_file.seek( pos );
+      log_file.read( data.data(), data.size() );
+      return data;
+   }
+
+   signed_block_ptr reversible_block_log::read_block( uint32_t block_num )const {
+      if( !contains( block_num ) )
+         return {};
+      const auto data = read_serialized_block( block_num );
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      auto result = std::make_shared<signed_block>();
+      fc::raw::unpack( ds, *result );
+      return result;
+   }
+
+   block_id_type reversible_block_log::read_block_id( uint32_t block_num )const {
+      if( !contains( block_num ) )
+         return {};
+      // only the header is needed for the id, the rest of the block is not unpacked
+      block_header h;
+      log_file.seek( positions[block_num - first_num] + entry_header_size );
+      auto ds = log_file.create_datastream();
+      fc::raw::unpack( ds, h );
+      return h.id();
+   }
+
+} } // eosio::chain
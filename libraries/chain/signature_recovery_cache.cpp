@@ -0,0 +1,120 @@
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <atomic>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      struct recovery_key {
+         digest_type    digest;
+         signature_type sig;
+
+         friend bool operator==( const recovery_key& a, const recovery_key& b ) {
+            return a.digest == b.digest && a.sig == b.sig;
+         }
+      };
+
+      struct recovery_key_hash {
+         // the digest is already a cryptographic hash, signatures of a multi-sig transaction share it and are
+         // distinguished by the equality check
+         size_t operator()( const recovery_key& k )const { return k.digest._hash[0]; }
+      };
+
+      struct recovery_entry {
+         recovery_key    key;
+         public_key_type pub_key;
+         bool            canonical_checked = true;
+      };
+
+      struct by_key;
+      using recovery_index = boost::multi_index_container<
+         recovery_entry,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique< boost::multi_index::tag<by_key>,
+               boost::multi_index::member<recovery_entry, recovery_key, &recovery_entry::key>, recovery_key_hash >
+         >
+      >;
+
+      struct signature_recovery_cache_impl {
+         mutable std::mutex    mtx;
+         recovery_index        entries;
+         size_t                capacity = config::default_sig_recovery_cache_size;
+         std::atomic<uint64_t> hits{0};
+         std::atomic<uint64_t> misses{0};
+
+         // requires mtx to be held
+         void evict() {
+            while( entries.size() > capacity ) entries.pop_back();
+         }
+      };
+   }
+
+   signature_recovery_cache& signature_recovery_cache::instance() {
+      static signature_recovery_cache the_cache;
+      return the_cache;
+   }
+
+   signature_recovery_cache::signature_recovery_cache()
+   : my( new detail::signature_recovery_cache_impl() )
+   {}
+
+   signature_recovery_cache::~signature_recovery_cache() = default;
+
+   public_key_type signature_recovery_cache::recover( const signature_type& sig, const digest_type& digest, bool check_canonical ) {
+      detail::recovery_key key{ digest, sig };
+      {
+         std::lock_guard<std::mutex> g( my->mtx );
+         if( my->capacity == 0 ) {
+            ++my->misses;
+            return public_key_type( sig, digest, check_canonical );
+         }
+         auto& idx = my->entries.get<detail::by_key>();
+         auto itr = idx.find( key );
+         if( itr != idx.end() && ( itr->canonical_checked || !check_canonical ) ) {
+            my->entries.relocate( my->entries.begin(), my->entries.project<0>( itr ) );
+            ++my->hits;
+            return itr->pub_key;
+         }
+      }
+
+      // recover outside of the lock, other threads may recover the same pair concurrently which is harmless
+      ++my->misses;
+      public_key_type pub_key( sig, digest, check_canonical );
+
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto res = my->entries.push_front( detail::recovery_entry{ std::move( key ), pub_key, check_canonical } );
+      if( !res.second ) {
+         my->entries.modify( res.first, [&]( auto& e ) { e.canonical_checked = e.canonical_checked || check_canonical; } );
+         my->entries.relocate( my->entries.begin(), res.first );
+      }
+      my->evict();
+      return pub_key;
+   }
+
+   void signature_recovery_cache::set_capacity( size_t capacity ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->capacity = capacity;
+      my->evict();
+   }
+
+   signature_recovery_cache::stats signature_recovery_cache::get_stats()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return stats{ my->hits.load(), my->misses.load(), my->entries.size(), my->capacity };
+   }
+
+   void signature_recovery_cache::clear() {
+      std::lock_guard<std::mutex> g( my->mtx );
+      my->entries.clear();
+      my->hits = 0;
+      my->misses = 0;
+   }
+
+} } /// eosio::chain
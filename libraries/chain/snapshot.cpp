@@ -1,7 +1,14 @@
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <algorithm>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
 namespace eosio { namespace chain {
 
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
@@ -11,6 +18,54 @@ variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& sna
    snapshot.set("version", current_snapshot_version );
 }
 
+concurrent_section_writer::concurrent_section_writer( snapshot_writer& writer, boost::asio::io_context& thread_pool, size_t max_pending )
+:_writer(writer)
+,_thread_pool(thread_pool)
+,_max_pending(std::max<size_t>(max_pending, 1))
+{
+}
+
+concurrent_section_writer::~concurrent_section_writer() {
+   // the shard functions reference state owned by the caller, wait for them even if finish() was not reached
+   for( auto& p : _pending ) {
+      if( p.shard.valid() ) {
+         p.shard.wait();
+      }
+   }
+}
+
+void concurrent_section_writer::add_shard( std::string section_name, bool first, bool last, std::function<void(snapshot_section_shard&)> f ) {
+   while( _pending.size() >= _max_pending ) {
+      write_front();
+   }
+
+   auto shard = async_thread_pool( _thread_pool, [f{std::move(f)}]() {
+      snapshot_section_shard result;
+      f(result);
+      return result;
+   } );
+   _pending.emplace_back( pending_shard{std::move(section_name), first, last, std::move(shard)} );
+}
+
+void concurrent_section_writer::write_front() {
+   auto& p = _pending.front();
+   auto shard = p.shard.get();
+   if( p.first ) {
+      _writer.write_start_section(p.section_name);
+   }
+   _writer.write_shard(shard);
+   if( p.last ) {
+      _writer.write_end_section();
+   }
+   _pending.pop_front();
+}
+
+void concurrent_section_writer::finish() {
+   while( !_pending.empty() ) {
+      write_front();
+   }
+}
+
 void variant_snapshot_writer::write_start_section( const std::string& section_name ) {
    current_rows.clear();
    current_section_name = section_name;
@@ -164,6 +219,12 @@ void ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_wri
    row_count++;
 }
 
+void ostream_snapshot_writer::write_shard( const snapshot_section_shard& shard ) {
+   const auto& data = shard.data();
+   snapshot.write(data.data(), data.size());
+   row_count += shard.row_count();
+}
+
 void ostream_snapshot_writer::write_end_section( ) {
    auto restore = snapshot.tellp();
 
@@ -195,6 +256,7 @@ istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 ,header_pos(snapshot.tellg())
 ,num_rows(0)
 ,cur_row(0)
+,rows(snapshot)
 {
 
 }
@@ -246,58 +308,26 @@ bool istream_snapshot_reader::validate_section() const {
    return true;
 }
 
-bool istream_snapshot_reader::has_section( const string& section_name ) {
-   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
-      snapshot.seekg(pos);
-   });
-
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
-
-   auto next_section_pos = header_pos + header_size;
-
-   while (true) {
-      snapshot.seekg(next_section_pos);
-      uint64_t section_size = 0;
-      snapshot.read((char*)&section_size,sizeof(section_size));
-      if (section_size == std::numeric_limits<uint64_t>::max()) {
-         break;
-      }
-
-      next_section_pos = snapshot.tellg() + std::streamoff(section_size);
-
-      uint64_t ignore = 0;
-      snapshot.read((char*)&ignore,sizeof(ignore));
-
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
-         }
-      }
-
-      if (match && snapshot.get() == 0) {
-         return true;
-      }
+const std::map<std::string, std::pair<std::streampos, uint64_t>>& istream_snapshot_reader::section_index() {
+   if( sections ) {
+      return *sections;
    }
 
-   return false;
-}
-
-void istream_snapshot_reader::set_section( const string& section_name ) {
    auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
+      snapshot.clear();
       snapshot.seekg(pos);
    });
 
    const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
 
    auto next_section_pos = header_pos + header_size;
+   std::map<std::string, std::pair<std::streampos, uint64_t>> index;
 
    while (true) {
       snapshot.seekg(next_section_pos);
       uint64_t section_size = 0;
       snapshot.read((char*)&section_size,sizeof(section_size));
-      if (section_size == std::numeric_limits<uint64_t>::max()) {
+      if (!snapshot || section_size == std::numeric_limits<uint64_t>::max()) {
          break;
       }
 
@@ -306,29 +336,40 @@ void istream_snapshot_reader::set_section( const string& section_name ) {
       uint64_t row_count = 0;
       snapshot.read((char*)&row_count,sizeof(row_count));
 
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
-         }
+      std::string section_name;
+      for( auto c = snapshot.get(); snapshot && c != 0; c = snapshot.get() ) {
+         section_name.push_back((char)c);
       }
-
-      if (match && snapshot.get() == 0) {
-         cur_row = 0;
-         num_rows = row_count;
-
-         // leave the stream at the right point
-         restore_pos.cancel();
-         return;
+      if (!snapshot) {
+         break;
       }
+
+      index.emplace(std::move(section_name), std::make_pair(snapshot.tellg(), row_count));
    }
 
-   EOS_THROW(snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+   sections.emplace(std::move(index));
+   return *sections;
+}
+
+bool istream_snapshot_reader::has_section( const string& section_name ) {
+   return section_index().count(section_name) > 0;
+}
+
+void istream_snapshot_reader::set_section( const string& section_name ) {
+   const auto& index = section_index();
+   auto itr = index.find(section_name);
+   EOS_ASSERT(itr != index.end(), snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+
+   // leave the stream at the first row
+   snapshot.clear();
+   snapshot.seekg(itr->second.first);
+   rows.reset();
+   cur_row = 0;
+   num_rows = itr->second.second;
 }
 
 bool istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
-   row_reader.provide(snapshot);
+   row_reader.provide(rows);
    return ++cur_row < num_rows;
 }
 
@@ -342,7 +383,9 @@ void istream_snapshot_reader::clear_section() {
 }
 
 void istream_snapshot_reader::return_to_header() {
+   snapshot.clear();
    snapshot.seekg( header_pos );
+   rows.reset();
    clear_section();
 }
 
@@ -360,6 +403,11 @@ void integrity_hash_snapshot_writer::write_row( const detail::abstract_snapshot_
    row_writer.write(enc);
 }
 
+void integrity_hash_snapshot_writer::write_shard( const snapshot_section_shard& shard ) {
+   const auto& data = shard.data();
+   enc.write(data.data(), data.size());
+}
+
 void integrity_hash_snapshot_writer::write_end_section( ) {
    // no-op for structural details
 }
@@ -368,4 +416,266 @@ void integrity_hash_snapshot_writer::finalize() {
    // no-op for structural details
 }
 
+namespace detail {
+
+namespace bio = boost::iostreams;
+
+compressing_snapshot_streambuf::compressing_snapshot_streambuf(std::ostream& out, uint32_t chunk_size)
+:out(out)
+,start_pos(out.tellp())
+,chunk_size(chunk_size)
+{
+   EOS_ASSERT(chunk_size > 0, snapshot_exception, "Compressed snapshot chunk size must be greater than 0");
+   auto totem = compressed_ostream_snapshot_writer::magic_number;
+   out.write((char*)&totem, sizeof(totem));
+   auto version = compressed_ostream_snapshot_writer::container_version;
+   out.write((char*)&version, sizeof(version));
+   compressed_offset = sizeof(totem) + sizeof(version);
+}
+
+std::streamsize compressing_snapshot_streambuf::xsputn( const char* s, std::streamsize n ) {
+   const std::streamsize result = n;
+   while (n > 0) {
+      if (pos < chunk_offset) {
+         // rewriting data of a compressed chunk
+         const auto size = std::min<uint64_t>(n, chunk_offset - pos);
+         directory.patches.emplace_back(compressed_snapshot_patch{pos, std::vector<char>(s, s + size)});
+         pos += size;
+         s += size;
+         n -= size;
+         continue;
+      }
+
+      const uint64_t at = pos - chunk_offset;
+      const uint64_t size = at < chunk_size
+                            ? std::min<uint64_t>(n, chunk_size - at) : n;
+      if (at + size > chunk.size()) {
+         chunk.resize(at + size);
+      }
+      memcpy(chunk.data() + at, s, size);
+      pos += size;
+      s += size;
+      n -= size;
+
+      // only a full chunk written up to its end is compressed, data behind pos may still be rewritten in place
+      if (chunk.size() >= chunk_size && pos == chunk_offset + chunk.size()) {
+         compress_chunk();
+      }
+   }
+   return result;
+}
+
+compressing_snapshot_streambuf::int_type compressing_snapshot_streambuf::overflow( int_type c ) {
+   if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      char ch = traits_type::to_char_type(c);
+      xsputn(&ch, 1);
+   }
+   return traits_type::not_eof(c);
+}
+
+compressing_snapshot_streambuf::pos_type compressing_snapshot_streambuf::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) {
+   if (!(which & std::ios_base::out)) {
+      return pos_type(off_type(-1));
+   }
+   const uint64_t end = chunk_offset + chunk.size();
+   const off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? pos : end;
+   if (base + off < 0 || uint64_t(base + off) > end) {
+      return pos_type(off_type(-1));
+   }
+   pos = base + off;
+   return pos_type(off_type(pos));
+}
+
+compressing_snapshot_streambuf::pos_type compressing_snapshot_streambuf::seekpos( pos_type p, std::ios_base::openmode which ) {
+   return seekoff(off_type(p), std::ios_base::beg, which);
+}
+
+void compressing_snapshot_streambuf::compress_chunk() {
+   std::vector<char> compressed;
+   bio::filtering_ostream comp;
+   comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+   comp.push( bio::back_inserter( compressed ) );
+   bio::write( comp, chunk.data(), chunk.size() );
+   bio::close( comp );
+
+   out.write(compressed.data(), compressed.size());
+   EOS_ASSERT(out, snapshot_exception, "Unable to write compressed snapshot chunk");
+
+   directory.chunks.emplace_back(compressed_snapshot_chunk{chunk_offset, compressed_offset, (uint32_t)chunk.size(), (uint32_t)compressed.size()});
+   compressed_offset += compressed.size();
+   chunk_offset += chunk.size();
+   chunk.clear();
+}
+
+void compressing_snapshot_streambuf::finish() {
+   EOS_ASSERT(pos == chunk_offset + chunk.size(), snapshot_exception, "Compressed snapshot finished ahead of its end");
+   if (!chunk.empty()) {
+      compress_chunk();
+   }
+
+   // the directory is followed by its offset and the magic number, so readers find it from the end
+   const auto packed = fc::raw::pack(directory);
+   out.write(packed.data(), packed.size());
+   uint64_t directory_offset = compressed_offset;
+   out.write((char*)&directory_offset, sizeof(directory_offset));
+   auto totem = compressed_ostream_snapshot_writer::magic_number;
+   out.write((char*)&totem, sizeof(totem));
+   out.flush();
+   EOS_ASSERT(out, snapshot_exception, "Unable to write compressed snapshot directory");
+}
+
+decompressing_snapshot_streambuf::decompressing_snapshot_streambuf(std::istream& in)
+:in(in)
+,start_pos(in.tellg())
+{
+   EOS_ASSERT(compressed_istream_snapshot_reader::is_compressed(in), snapshot_exception,
+              "Compressed snapshot has unexpected magic number!");
+
+   uint32_t version = 0;
+   in.seekg(start_pos + std::streamoff(sizeof(compressed_ostream_snapshot_writer::magic_number)));
+   in.read((char*)&version, sizeof(version));
+   EOS_ASSERT(in && version == compressed_ostream_snapshot_writer::container_version, snapshot_exception,
+              "Compressed snapshot is an unsupported version.  Expected : ${expected}, Got: ${actual}",
+              ("expected", compressed_ostream_snapshot_writer::container_version)("actual", version));
+
+   uint64_t directory_offset = 0;
+   uint32_t totem = 0;
+   const std::streamoff footer_size = sizeof(directory_offset) + sizeof(totem);
+   in.seekg(-footer_size, std::ios::end);
+   const std::streampos footer_pos = in.tellg();
+   in.read((char*)&directory_offset, sizeof(directory_offset));
+   in.read((char*)&totem, sizeof(totem));
+   EOS_ASSERT(in && totem == compressed_ostream_snapshot_writer::magic_number, snapshot_exception,
+              "Compressed snapshot is truncated, it has no directory");
+
+   const std::streampos directory_pos = start_pos + std::streamoff(directory_offset);
+   EOS_ASSERT(directory_pos < footer_pos, snapshot_exception, "Compressed snapshot has an invalid directory offset");
+   std::vector<char> packed(footer_pos - directory_pos);
+   in.seekg(directory_pos);
+   in.read(packed.data(), packed.size());
+   EOS_ASSERT(in, snapshot_exception, "Unable to read compressed snapshot directory");
+   fc::datastream<const char*> ds(packed.data(), packed.size());
+   fc::raw::unpack(ds, directory);
+
+   for (const auto& c : directory.chunks) {
+      EOS_ASSERT(c.offset == size, snapshot_exception, "Compressed snapshot directory has non-contiguous chunks");
+      size += c.size;
+   }
+   setg(nullptr, nullptr, nullptr);
+}
+
+void decompressing_snapshot_streambuf::load_chunk( size_t index ) {
+   if (index == cur_chunk) {
+      return;
+   }
+
+   const auto& c = directory.chunks.at(index);
+   std::vector<char> compressed(c.compressed_size);
+   in.clear();
+   in.seekg(start_pos + std::streamoff(c.compressed_offset));
+   in.read(compressed.data(), compressed.size());
+   EOS_ASSERT(in, snapshot_exception, "Unable to read compressed snapshot chunk at ${offset}", ("offset", c.offset));
+
+   data.clear();
+   data.reserve(c.size);
+   try {
+      bio::filtering_ostream decomp;
+      decomp.push( bio::zlib_decompressor() );
+      decomp.push( bio::back_inserter( data ) );
+      bio::write( decomp, compressed.data(), compressed.size() );
+      bio::close( decomp );
+   } catch( const std::exception& e ) {
+      EOS_THROW( snapshot_exception, "Could not decompress snapshot chunk at ${offset}: ${e}", ("offset", c.offset)("e", e.what()) );
+   }
+   EOS_ASSERT(data.size() == c.size, snapshot_exception,
+              "Compressed snapshot chunk at ${offset} has unexpected size", ("offset", c.offset));
+
+   for (const auto& patch : directory.patches) {
+      const uint64_t begin = std::max(patch.offset, c.offset);
+      const uint64_t end = std::min(patch.offset + patch.data.size(), c.offset + c.size);
+      if (begin < end) {
+         memcpy(data.data() + (begin - c.offset), patch.data.data() + (begin - patch.offset), end - begin);
+      }
+   }
+
+   cur_chunk = index;
+   setg(data.data(), data.data(), data.data() + data.size());
+}
+
+decompressing_snapshot_streambuf::int_type decompressing_snapshot_streambuf::underflow() {
+   if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+   }
+   const size_t next = cur_chunk == std::numeric_limits<size_t>::max() ? 0 : cur_chunk + 1;
+   if (next >= directory.chunks.size()) {
+      return traits_type::eof();
+   }
+   load_chunk(next);
+   return traits_type::to_int_type(*gptr());
+}
+
+decompressing_snapshot_streambuf::pos_type decompressing_snapshot_streambuf::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) {
+   if (!(which & std::ios_base::in)) {
+      return pos_type(off_type(-1));
+   }
+   const uint64_t cur = cur_chunk == std::numeric_limits<size_t>::max()
+                        ? 0 : directory.chunks[cur_chunk].offset + (gptr() - eback());
+   const off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? cur : size;
+   return seekpos(pos_type(base + off), which);
+}
+
+decompressing_snapshot_streambuf::pos_type decompressing_snapshot_streambuf::seekpos( pos_type p, std::ios_base::openmode which ) {
+   const off_type target = off_type(p);
+   if (!(which & std::ios_base::in) || target < 0 || uint64_t(target) > size) {
+      return pos_type(off_type(-1));
+   }
+   if (directory.chunks.empty()) {
+      return p;
+   }
+
+   // the chunk holding target, or the last chunk when target is the end
+   auto itr = std::upper_bound(directory.chunks.begin(), directory.chunks.end(), uint64_t(target),
+                               []( uint64_t offset, const auto& c ) { return offset < c.offset; });
+   load_chunk(std::distance(directory.chunks.begin(), itr) - 1);
+   setg(eback(), eback() + (target - directory.chunks[cur_chunk].offset), egptr());
+   return p;
+}
+
+}
+
+compressed_ostream_snapshot_writer::compressed_ostream_snapshot_writer(std::ostream& snapshot, uint32_t chunk_size)
+:detail::compressed_snapshot_ostream(snapshot, chunk_size)
+,ostream_snapshot_writer(stream)
+{
+}
+
+void compressed_ostream_snapshot_writer::finalize() {
+   ostream_snapshot_writer::finalize();
+   buf.finish();
+}
+
+compressed_istream_snapshot_reader::compressed_istream_snapshot_reader(std::istream& snapshot)
+:detail::compressed_snapshot_istream(snapshot)
+,istream_snapshot_reader(stream)
+{
+}
+
+bool compressed_istream_snapshot_reader::is_compressed( std::istream& snapshot ) {
+   auto restore_pos = fc::make_scoped_exit([&snapshot,pos=snapshot.tellg()](){
+      snapshot.clear();
+      snapshot.seekg(pos);
+   });
+
+   uint32_t totem = 0;
+   snapshot.read((char*)&totem, sizeof(totem));
+   return snapshot && totem == magic_number;
+}
+
+std::shared_ptr<istream_snapshot_reader> make_istream_snapshot_reader( std::istream& snapshot ) {
+   if (compressed_istream_snapshot_reader::is_compressed(snapshot)) {
+      return std::make_shared<compressed_istream_snapshot_reader>(snapshot);
+   }
+   return std::make_shared<istream_snapshot_reader>(snapshot);
+}
+
 }}
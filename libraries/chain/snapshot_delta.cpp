@@ -0,0 +1,258 @@
+#include <eosio/chain/snapshot_delta.hpp>
+#include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
+
+#include <array>
+#include <limits>
+#include <unordered_map>
+
+namespace eosio { namespace chain { namespace snapshot_delta {
+
+namespace {
+   enum class op : uint8_t {
+      copy    = 0, ///< uint64_t offset in the base, uint32_t size
+      literal = 1, ///< uint32_t size, bytes
+      end     = 2
+   };
+
+   // chunks are 2 KiB to 64 KiB, about 8 KiB past the minimum on average
+   constexpr uint32_t min_chunk_size = 2*1024;
+   constexpr uint32_t max_chunk_size = 64*1024;
+   constexpr uint64_t boundary_mask  = (uint64_t(1) << 13) - 1;
+
+   /// random values of the gear rolling hash, generated by splitmix64 so that every build chunks alike
+   const std::array<uint64_t, 256>& gear_table() {
+      static const auto table = []() {
+         std::array<uint64_t, 256> t;
+         uint64_t x = 0;
+         for( auto& v : t ) {
+            uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            v = z ^ (z >> 31);
+         }
+         return t;
+      }();
+      return table;
+   }
+
+   /// uncompressed view of a binary snapshot, compressed or not, from the current position of in
+   struct snapshot_view {
+      explicit snapshot_view( std::istream& in ) {
+         if( compressed_istream_snapshot_reader::is_compressed(in) ) {
+            decompressed.emplace(in);
+            start = 0;
+         } else {
+            start = in.tellg();
+         }
+         raw = &in;
+      }
+
+      std::istream& stream() { return decompressed ? decompressed->stream : *raw; }
+
+      std::istream*                                     raw = nullptr;
+      fc::optional<detail::compressed_snapshot_istream> decompressed;
+      std::streampos                                    start;
+   };
+
+   /// calls f(offset, data, size) for the content defined chunks of in, from its current position to its end
+   template<typename F>
+   void for_each_chunk( std::istream& in, F&& f ) {
+      const auto& gear = gear_table();
+      std::vector<char> buffer(1024*1024);
+      std::vector<char> chunk;
+      chunk.reserve(max_chunk_size);
+      uint64_t offset = 0;
+      uint64_t h = 0;
+      auto emit = [&]() {
+         f(offset, chunk.data(), chunk.size());
+         offset += chunk.size();
+         chunk.clear();
+         h = 0;
+      };
+      while( in ) {
+         in.read(buffer.data(), buffer.size());
+         const size_t n = in.gcount();
+         for( size_t i = 0; i < n; ++i ) {
+            const auto c = static_cast<uint8_t>(buffer[i]);
+            chunk.push_back(buffer[i]);
+            h = (h << 1) + gear[c];
+            if( (chunk.size() >= min_chunk_size && (h & boundary_mask) == 0) || chunk.size() == max_chunk_size ) {
+               emit();
+            }
+         }
+      }
+      if( !chunk.empty() ) {
+         emit();
+      }
+   }
+
+   struct sha256_hash {
+      size_t operator()( const fc::sha256& d ) const { return d._hash[0]; }
+   };
+
+   // header fields are fixed size, packed apart since fc::raw on std::ostream resolves to its operator<<s
+   void write_header( std::ostream& out, const header& h ) {
+      const auto packed = fc::raw::pack(h);
+      out.write(packed.data(), packed.size());
+   }
+
+   header read_header( std::istream& in ) {
+      std::vector<char> packed(fc::raw::pack_size(header()));
+      in.read(packed.data(), packed.size());
+      EOS_ASSERT(in, snapshot_exception, "Snapshot delta is truncated");
+      return fc::raw::unpack<header>(packed);
+   }
+
+   template<typename T>
+   void write_value( std::ostream& out, const T& v ) {
+      out.write((const char*)&v, sizeof(v));
+   }
+
+   template<typename T>
+   T read_value( std::istream& in ) {
+      T v;
+      in.read((char*)&v, sizeof(v));
+      EOS_ASSERT(in, snapshot_exception, "Snapshot delta is truncated");
+      return v;
+   }
+}
+
+header write( std::istream& base, std::istream& target, std::ostream& delta ) {
+   snapshot_view base_view(base);
+   snapshot_view target_view(target);
+
+   // where every distinct chunk of the base is
+   std::unordered_map<fc::sha256, std::pair<uint64_t, uint32_t>, sha256_hash> base_chunks;
+   fc::sha256::encoder base_enc;
+   for_each_chunk(base_view.stream(), [&]( uint64_t offset, const char* data, size_t size ) {
+      base_enc.write(data, size);
+      base_chunks.emplace(fc::sha256::hash(data, size), std::make_pair(offset, uint32_t(size)));
+   });
+
+   header h;
+   h.base_digest = base_enc.result();
+
+   write_value(delta, magic_number);
+   write_value(delta, version);
+   const std::streampos header_pos = delta.tellp();
+   write_header(delta, h); // rewritten once the target is known
+
+   // adjacent copies and literals are merged into one op
+   uint64_t          copy_offset = 0;
+   uint32_t          copy_size = 0;
+   std::vector<char> literal;
+   auto flush_copy = [&]() {
+      if( copy_size == 0 ) return;
+      write_value(delta, op::copy);
+      write_value(delta, copy_offset);
+      write_value(delta, copy_size);
+      copy_size = 0;
+   };
+   auto flush_literal = [&]() {
+      if( literal.empty() ) return;
+      write_value(delta, op::literal);
+      write_value(delta, uint32_t(literal.size()));
+      delta.write(literal.data(), literal.size());
+      literal.clear();
+   };
+
+   fc::sha256::encoder target_enc;
+   for_each_chunk(target_view.stream(), [&]( uint64_t, const char* data, size_t size ) {
+      target_enc.write(data, size);
+      h.target_size += size;
+      auto it = base_chunks.find(fc::sha256::hash(data, size));
+      if( it != base_chunks.end() && it->second.second == size ) {
+         flush_literal();
+         const auto [offset, chunk_size] = it->second;
+         if( copy_size && copy_offset + copy_size == offset && uint64_t(copy_size) + chunk_size <= std::numeric_limits<uint32_t>::max() ) {
+            copy_size += chunk_size;
+         } else {
+            flush_copy();
+            copy_offset = offset;
+            copy_size = chunk_size;
+         }
+      } else {
+         flush_copy();
+         if( literal.size() + size > std::numeric_limits<uint32_t>::max() ) flush_literal();
+         literal.insert(literal.end(), data, data + size);
+      }
+   });
+   flush_copy();
+   flush_literal();
+   write_value(delta, op::end);
+   h.target_digest = target_enc.result();
+
+   const std::streampos end_pos = delta.tellp();
+   delta.seekp(header_pos);
+   write_header(delta, h);
+   delta.seekp(end_pos);
+   delta.flush();
+   EOS_ASSERT(delta, snapshot_exception, "Unable to write snapshot delta");
+   return h;
+}
+
+header apply( std::istream& base, std::istream& delta, std::ostream& target ) {
+   EOS_ASSERT(read_value<uint32_t>(delta) == magic_number, snapshot_exception, "Snapshot delta has unexpected magic number");
+   const auto v = read_value<uint32_t>(delta);
+   EOS_ASSERT(v == version, snapshot_exception, "Snapshot delta is an unsupported version.  Expected : ${expected}, Got: ${actual}",
+              ("expected", version)("actual", v));
+   const header h = read_header(delta);
+
+   snapshot_view base_view(base);
+   std::istream& base_in = base_view.stream();
+   fc::sha256::encoder base_enc;
+   std::vector<char> buffer(1024*1024);
+   while( base_in ) {
+      base_in.read(buffer.data(), buffer.size());
+      base_enc.write(buffer.data(), base_in.gcount());
+   }
+   EOS_ASSERT(base_enc.result() == h.base_digest, snapshot_exception,
+              "Snapshot delta is not based on the given snapshot, expected base ${expected}", ("expected", h.base_digest));
+   base_in.clear();
+
+   fc::sha256::encoder target_enc;
+   uint64_t target_size = 0;
+   auto copy_from = [&]( std::istream& in, uint64_t size ) {
+      while( size > 0 ) {
+         const size_t n = std::min<uint64_t>(size, buffer.size());
+         in.read(buffer.data(), n);
+         EOS_ASSERT(in, snapshot_exception, "Snapshot delta refers past the end of its base or is truncated");
+         target.write(buffer.data(), n);
+         target_enc.write(buffer.data(), n);
+         target_size += n;
+         size -= n;
+      }
+   };
+   for( op o = read_value<op>(delta); o != op::end; o = read_value<op>(delta) ) {
+      if( o == op::copy ) {
+         const auto offset = read_value<uint64_t>(delta);
+         const auto size = read_value<uint32_t>(delta);
+         base_in.seekg(base_view.start + std::streamoff(offset));
+         copy_from(base_in, size);
+      } else {
+         EOS_ASSERT(o == op::literal, snapshot_exception, "Snapshot delta has an unknown op ${o}", ("o", uint32_t(o)));
+         copy_from(delta, read_value<uint32_t>(delta));
+      }
+   }
+   target.flush();
+   EOS_ASSERT(target, snapshot_exception, "Unable to write snapshot applying a delta");
+   EOS_ASSERT(target_size == h.target_size && target_enc.result() == h.target_digest, snapshot_exception,
+              "Snapshot applying a delta does not match the delta's target ${expected}", ("expected", h.target_digest));
+   return h;
+}
+
+bool is_delta( std::istream& in ) {
+   auto restore_pos = fc::make_scoped_exit([&in,pos=in.tellg()](){
+      in.clear();
+      in.seekg(pos);
+   });
+
+   uint32_t totem = 0;
+   in.read((char*)&totem, sizeof(totem));
+   return in && totem == magic_number;
+}
+
+}}}
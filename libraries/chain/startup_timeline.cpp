@@ -0,0 +1,30 @@
+#include <eosio/chain/startup_timeline.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace eosio { namespace chain {
+
+startup_timeline& startup_timeline::instance() {
+   static startup_timeline the_instance;
+   return the_instance;
+}
+
+void startup_timeline::record( std::string name, const fc::time_point& start ) {
+   const auto duration = fc::time_point::now() - start;
+   ilog( "startup phase \"${p}\" took ${ms} ms", ("p", name)("ms", duration.count() / 1000) );
+   std::lock_guard<std::mutex> g( _mtx );
+   _phases.push_back( startup_phase{ std::move( name ), start, duration.count() } );
+}
+
+std::vector<startup_phase> startup_timeline::get()const {
+   std::vector<startup_phase> result;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      result = _phases;
+   }
+   std::stable_sort( result.begin(), result.end(), []( const auto& a, const auto& b ) { return a.start < b.start; } );
+   return result;
+}
+
+} } /// eosio::chain
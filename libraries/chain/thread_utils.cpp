@@ -1,20 +1,359 @@
 #include <eosio/chain/thread_utils.hpp>
 #include <fc/log/logger_config.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace eosio { namespace chain {
 
 
+//
+// cpu placement
+//
+std::vector<uint32_t> parse_cpu_list( const std::string& list ) {
+   std::vector<uint32_t> cpus;
+   std::vector<std::string> ranges;
+   boost::split( ranges, list, boost::is_any_of( "," ) );
+   for( auto& r : ranges ) {
+      boost::trim( r );
+      if( r.empty() ) continue;
+      auto dash = r.find( '-' );
+      try {
+         const uint32_t first = boost::lexical_cast<uint32_t>( r.substr( 0, dash ) );
+         const uint32_t last = dash == std::string::npos ? first : boost::lexical_cast<uint32_t>( r.substr( dash + 1 ) );
+         FC_ASSERT( first <= last, "invalid cpu range ${r}", ("r", r) );
+         for( uint32_t c = first; c <= last; ++c ) cpus.push_back( c );
+      } catch( const boost::bad_lexical_cast& ) {
+         FC_THROW( "invalid cpu list ${l}", ("l", list) );
+      }
+   }
+   std::sort( cpus.begin(), cpus.end() );
+   cpus.erase( std::unique( cpus.begin(), cpus.end() ), cpus.end() );
+   return cpus;
+}
+
+std::string cpu_list_to_string( const std::vector<uint32_t>& cpus ) {
+   std::string result;
+   for( size_t i = 0; i < cpus.size(); ) {
+      size_t j = i;
+      while( j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1 ) ++j;
+      if( !result.empty() ) result += ",";
+      result += std::to_string( cpus[i] );
+      if( j > i ) result += "-" + std::to_string( cpus[j] );
+      i = j + 1;
+   }
+   return result;
+}
+
+bool set_cpu_affinity( const std::vector<uint32_t>& cpus, int pid ) {
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+   for( auto c : cpus ) CPU_SET( c, &set );
+   const int r = pid ? sched_setaffinity( pid, sizeof(set), &set ) : pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+   if( r != 0 ) {
+      wlog( "unable to pin ${w} to cpus ${c}", ("w", pid ? "process " + std::to_string( pid ) : std::string( "thread" ))("c", cpu_list_to_string( cpus )) );
+      return false;
+   }
+   return true;
+#else
+   wlog( "cpu affinity is not supported on this platform, cpus ${c} ignored", ("c", cpu_list_to_string( cpus )) );
+   return false;
+#endif
+}
+
+std::vector<uint32_t> get_cpu_affinity() {
+   std::vector<uint32_t> cpus;
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+   if( pthread_getaffinity_np( pthread_self(), sizeof(set), &set ) == 0 ) {
+      for( uint32_t c = 0; c < CPU_SETSIZE; ++c ) {
+         if( CPU_ISSET( c, &set ) ) cpus.push_back( c );
+      }
+   }
+#endif
+   return cpus;
+}
+
+bool set_realtime_priority( int priority ) {
+#ifdef __linux__
+   sched_param param{};
+   param.sched_priority = priority;
+   if( pthread_setschedparam( pthread_self(), priority ? SCHED_FIFO : SCHED_OTHER, &param ) != 0 ) {
+      wlog( "unable to set real-time priority ${p}, which needs CAP_SYS_NICE or an rtprio limit", ("p", priority) );
+      return false;
+   }
+   return true;
+#else
+   wlog( "real-time priority is not supported on this platform" );
+   return false;
+#endif
+}
+
+thread_placement& thread_placement::instance() {
+   static thread_placement placement;
+   return placement;
+}
+
+void thread_placement::set_pool_cpus( std::map<std::string, std::vector<uint32_t>> cpus ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _pool_cpus = std::move( cpus );
+}
+
+std::vector<uint32_t> thread_placement::pool_cpus( const std::string& name_prefix )const {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto itr = _pool_cpus.find( name_prefix );
+   return itr == _pool_cpus.end() ? std::vector<uint32_t>() : itr->second;
+}
+
+void thread_placement::record( const std::string& thread, int realtime_priority ) {
+   record( entry{ thread, cpu_list_to_string( get_cpu_affinity() ), realtime_priority } );
+}
+
+void thread_placement::record( entry e ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _threads[e.thread] = std::move( e );
+}
+
+std::vector<thread_placement::entry> thread_placement::get()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   std::vector<entry> result;
+   result.reserve( _threads.size() );
+   for( const auto& t : _threads ) result.push_back( t.second );
+   return result;
+}
+
+
+//
+// shared_thread_pool
+//
+struct shared_thread_pool::lane {
+   lane( std::string name, boost::asio::io_context& ioc, lane_options options )
+   : name( std::move(name) ), ioc( ioc ), options( options ) {}
+
+   const std::string             name;
+   boost::asio::io_context&      ioc;
+   const lane_options            options;
+
+   std::atomic<uint32_t>         active{0};
+   std::atomic<bool>             removed{false};
+
+   std::atomic<uint64_t>         handlers{0};
+   std::atomic<uint64_t>         stolen{0};
+   std::atomic<uint64_t>         samples{0};
+   std::atomic<int64_t>          total_latency_us{0};
+   std::atomic<int64_t>          max_latency_us{0};
+
+   // a worker that entered a lane must check removed before touching ioc, remove_lane waits for active to drop to 0
+   bool enter() {
+      uint32_t a = active.load();
+      while( a < options.max_concurrency ) {
+         if( active.compare_exchange_weak( a, a + 1 ) ) {
+            if( !removed ) return true;
+            --active;
+            return false;
+         }
+      }
+      return false;
+   }
+
+   void leave() { --active; }
+
+   void record_latency( int64_t us ) {
+      ++samples;
+      total_latency_us += us;
+      int64_t m = max_latency_us.load();
+      while( us > m && !max_latency_us.compare_exchange_weak( m, us ) ) {}
+   }
+
+   lane_stats stats()const {
+      lane_stats s;
+      s.name = name;
+      s.handlers = handlers;
+      s.stolen = stolen;
+      s.samples = samples;
+      s.avg_latency_us = s.samples ? total_latency_us / int64_t(s.samples) : 0;
+      s.max_latency_us = max_latency_us;
+      return s;
+   }
+};
+
+shared_thread_pool& shared_thread_pool::instance() {
+   static shared_thread_pool pool;
+   return pool;
+}
+
+shared_thread_pool::~shared_thread_pool() {
+   _stopping = true;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      ++_lanes_version;
+   }
+   _lanes_changed.notify_all();
+   for( auto& t : _workers ) t.join();
+}
+
+void shared_thread_pool::configure( size_t num_threads, std::vector<uint32_t> cpus, std::map<std::string, lane_options> lanes,
+                                    fc::microseconds latency_sample_interval ) {
+   FC_ASSERT( _workers.empty(), "shared thread pool already configured" );
+   _cpus = std::move( cpus );
+   _lane_options = std::move( lanes );
+   _latency_sample_interval = latency_sample_interval;
+   _lanes = std::make_shared<const lanes_t>();
+   _workers.reserve( num_threads );
+   for( size_t i = 0; i < num_threads; ++i ) {
+      _workers.emplace_back( [this, i]() { run( i ); } );
+   }
+}
+
+fc::optional<shared_thread_pool::lane_options> shared_thread_pool::lane_for( const std::string& name_prefix )const {
+   if( _workers.empty() ) return {};
+   auto itr = _lane_options.find( name_prefix );
+   if( itr == _lane_options.end() ) return {};
+   return itr->second;
+}
+
+void shared_thread_pool::add_lane( const std::string& name, boost::asio::io_context& ioc, lane_options options, size_t default_concurrency ) {
+   if( options.max_concurrency == 0 ) options.max_concurrency = default_concurrency;
+   options.max_concurrency = std::max<uint32_t>( options.max_concurrency, 1 );
+   auto l = std::make_shared<lane>( name, ioc, options );
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto lanes = std::make_shared<lanes_t>( *_lanes );
+      auto pos = std::find_if( lanes->begin(), lanes->end(), [&]( const auto& o ) { return o->options.priority < options.priority; } );
+      lanes->insert( pos, std::move(l) );
+      _lanes = std::move( lanes );
+      ++_lanes_version;
+   }
+   _lanes_changed.notify_all();
+}
+
+void shared_thread_pool::remove_lane( boost::asio::io_context& ioc ) {
+   std::shared_ptr<lane> l;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto lanes = std::make_shared<lanes_t>( *_lanes );
+      auto itr = std::find_if( lanes->begin(), lanes->end(), [&]( const auto& o ) { return &o->ioc == &ioc; } );
+      if( itr == lanes->end() ) return;
+      l = *itr;
+      l->removed = true;
+      lanes->erase( itr );
+      _lanes = std::move( lanes );
+      ++_lanes_version;
+      _removed_stats.push_back( l->stats() );
+   }
+   // workers blocked on ioc return from run_one_for within their idle wait
+   while( l->active > 0 ) {
+      std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+   }
+}
+
+std::vector<shared_thread_pool::lane_stats> shared_thread_pool::get_stats()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   std::vector<lane_stats> result = _removed_stats;
+   if( _lanes ) {
+      for( const auto& l : *_lanes ) result.push_back( l->stats() );
+   }
+   return result;
+}
+
+void shared_thread_pool::sample_latency( const lanes_t& lanes ) {
+   const int64_t now = fc::time_point::now().time_since_epoch().count();
+   int64_t next = _next_sample_us.load();
+   if( now < next || !_next_sample_us.compare_exchange_strong( next, now + _latency_sample_interval.count() ) ) return;
+   for( const auto& l : lanes ) {
+      // only needs a slot to keep remove_lane from returning while posting, not one to run handlers
+      ++l->active;
+      if( !l->removed ) {
+         boost::asio::post( l->ioc, [l, now]() {
+            l->record_latency( fc::time_point::now().time_since_epoch().count() - now );
+         } );
+      }
+      l->leave();
+   }
+}
+
+void shared_thread_pool::run( size_t worker ) {
+   const std::string tn = "shared-" + std::to_string( worker );
+   fc::set_os_thread_name( tn );
+   if( !_cpus.empty() ) set_cpu_affinity( { _cpus[worker % _cpus.size()] } );
+   thread_placement::instance().record( tn );
+
+   constexpr auto idle_wait = std::chrono::milliseconds( 2 );
+   std::shared_ptr<const lanes_t> lanes;
+   uint64_t version = 0;
+   size_t round = 0;
+   while( !_stopping ) {
+      if( !lanes || version != _lanes_version ) {
+         std::unique_lock<std::mutex> g( _mtx );
+         _lanes_changed.wait( g, [&]() { return _stopping || !_lanes->empty(); } );
+         lanes = _lanes;
+         version = _lanes_version;
+         continue;
+      }
+      if( _latency_sample_interval.count() > 0 ) sample_latency( *lanes );
+
+      // home lanes rotate so that lanes outnumbering workers are still waited on
+      const size_t home = ( worker + round ) % lanes->size();
+
+      // steal a ready handler, highest priority lane first
+      bool ran = false;
+      for( size_t i = 0; i < lanes->size() && !ran; ++i ) {
+         lane& l = *(*lanes)[i];
+         if( !l.enter() ) continue;
+         if( l.ioc.poll_one() > 0 ) {
+            ++l.handlers;
+            if( i != home ) ++l.stolen;
+            ran = true;
+         }
+         l.leave();
+      }
+      if( ran ) continue;
+
+      // nothing is ready anywhere, wait for the home lane
+      lane& l = *(*lanes)[home];
+      if( l.enter() ) {
+         if( l.ioc.run_one_for( idle_wait ) > 0 ) ++l.handlers;
+         l.leave();
+      } else {
+         std::this_thread::sleep_for( idle_wait );
+      }
+      ++round;
+   }
+}
+
+
 //
 // named_thread_pool
 //
 named_thread_pool::named_thread_pool( std::string name_prefix, size_t num_threads )
-: _thread_pool( num_threads )
 {
    _ioc_work.emplace( boost::asio::make_work_guard( _ioc ) );
+   auto& shared = shared_thread_pool::instance();
+   if( auto lane = shared.lane_for( name_prefix ) ) {
+      _shared = true;
+      shared.add_lane( name_prefix, _ioc, *lane, num_threads );
+      return;
+   }
+   _thread_pool.emplace( num_threads );
+   const auto cpus = thread_placement::instance().pool_cpus( name_prefix );
+   if( !cpus.empty() )
+      ilog( "pinning ${n} threads to cpus ${c}", ("n", name_prefix)("c", cpu_list_to_string( cpus )) );
    for( size_t i = 0; i < num_threads; ++i ) {
-      boost::asio::post( _thread_pool, [&ioc = _ioc, name_prefix, i]() {
+      boost::asio::post( *_thread_pool, [&ioc = _ioc, name_prefix, cpus, i]() {
          std::string tn = name_prefix + "-" + std::to_string( i );
          fc::set_os_thread_name( tn );
+         if( !cpus.empty() ) set_cpu_affinity( cpus );
+         thread_placement::instance().record( tn );
          ioc.run();
       } );
    }
@@ -25,11 +364,14 @@ named_thread_pool::~named_thread_pool() {
 }
 
 void named_thread_pool::stop() {
+   if( _shared ) shared_thread_pool::instance().remove_lane( _ioc );
    _ioc_work.reset();
    _ioc.stop();
-   _thread_pool.join();
-   _thread_pool.stop();
+   if( _thread_pool ) {
+      _thread_pool->join();
+      _thread_pool->stop();
+   }
 }
 
 
-} } // eosio::chain
\ No newline at end of file
+} } // eosio::chain
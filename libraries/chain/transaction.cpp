@@ -9,6 +9,7 @@
 
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 #include <eosio/chain/transaction.hpp>
 
 namespace eosio { namespace chain {
@@ -63,12 +64,13 @@ fc::microseconds transaction::get_signature_keys( const vector<signature_type>&
    auto start = fc::time_point::now();
    recovered_pub_keys.clear();
    const digest_type digest = sig_digest(chain_id, cfd);
+   auto& cache = signature_recovery_cache::instance();
 
    for(const signature_type& sig : signatures) {
       auto now = fc::time_point::now();
       EOS_ASSERT( now < deadline, tx_cpu_usage_exceeded, "transaction signature verification executed for too long ${time}us",
                   ("time", now - start)("now", now)("deadline", deadline)("start", start) );
-      auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( sig, digest );
+      auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( cache.recover( sig, digest ) );
       EOS_ASSERT( allow_duplicate_keys || successful_insertion, tx_duplicate_sig,
                   "transaction includes more than one signature signed using the same key associated with public key: ${key}",
                   ("key", *itr ) );
@@ -276,10 +278,7 @@ packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_typ
 ,packed_context_free_data(std::move(packed_cfd))
 ,packed_trx(std::move(packed_txn))
 {
-   local_unpack_transaction({});
-   if( !packed_context_free_data.empty() ) {
-      local_unpack_context_free_data();
-   }
+   local_unpack_transaction( local_unpack_context_free_data() );
 }
 
 packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_type>&& sigs, vector<bytes>&& cfd, compression_type _compression )
@@ -288,7 +287,7 @@ packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_typ
 ,packed_trx(std::move(packed_txn))
 {
    local_unpack_transaction( std::move( cfd ) );
-   if( !unpacked_trx.context_free_data.empty() ) {
+   if( !unpacked_trx->context_free_data.empty() ) {
       local_pack_context_free_data();
    }
 }
@@ -297,13 +296,10 @@ packed_transaction::packed_transaction( transaction&& t, vector<signature_type>&
 :signatures(std::move(sigs))
 ,compression(_compression)
 ,packed_context_free_data(std::move(packed_cfd))
-,unpacked_trx(std::move(t), signatures, {})
-,trx_id(unpacked_trx.id())
+,unpacked_trx(std::make_shared<const signed_transaction>(std::move(t), signatures, local_unpack_context_free_data()))
+,trx_id(unpacked_trx->id())
 {
    local_pack_transaction();
-   if( !packed_context_free_data.empty() ) {
-      local_unpack_context_free_data();
-   }
 }
 
 void packed_transaction::reflector_init()
@@ -311,9 +307,14 @@ void packed_transaction::reflector_init()
    // called after construction, but always on the same thread and before packed_transaction passed to any other threads
    static_assert(fc::raw::has_feature_reflector_init_on_unpacked_reflected_types,
                  "FC unpack needs to call reflector_init otherwise unpacked_trx will not be initialized");
-   EOS_ASSERT( unpacked_trx.expiration == time_point_sec(), tx_decompression_error, "packed_transaction already unpacked" );
-   local_unpack_transaction({});
-   local_unpack_context_free_data();
+   EOS_ASSERT( unpacked_trx == empty_unpacked_trx(), tx_decompression_error, "packed_transaction already unpacked" );
+   local_unpack_transaction( local_unpack_context_free_data() );
+}
+
+const std::shared_ptr<const signed_transaction>& packed_transaction::empty_unpacked_trx()
+{
+   static const auto empty = std::make_shared<const signed_transaction>();
+   return empty;
 }
 
 void packed_transaction::local_unpack_transaction(vector<bytes>&& context_free_data)
@@ -321,29 +322,26 @@ void packed_transaction::local_unpack_transaction(vector<bytes>&& context_free_d
    try {
       switch( compression ) {
          case compression_type::none:
-            unpacked_trx = signed_transaction( unpack_transaction( packed_trx ), signatures, std::move(context_free_data) );
+            unpacked_trx = std::make_shared<const signed_transaction>( unpack_transaction( packed_trx ), signatures, std::move(context_free_data) );
             break;
          case compression_type::zlib:
-            unpacked_trx = signed_transaction( zlib_decompress_transaction( packed_trx ), signatures, std::move(context_free_data) );
+            unpacked_trx = std::make_shared<const signed_transaction>( zlib_decompress_transaction( packed_trx ), signatures, std::move(context_free_data) );
             break;
          default:
             EOS_THROW( unknown_transaction_compression, "Unknown transaction compression algorithm" );
       }
-      trx_id = unpacked_trx.id();
+      trx_id = unpacked_trx->id();
    } FC_CAPTURE_AND_RETHROW( (compression) )
 }
 
-void packed_transaction::local_unpack_context_free_data()
+vector<bytes> packed_transaction::local_unpack_context_free_data()const
 {
    try {
-      EOS_ASSERT(unpacked_trx.context_free_data.empty(), tx_decompression_error, "packed_transaction.context_free_data not empty");
       switch( compression ) {
          case compression_type::none:
-            unpacked_trx.context_free_data = unpack_context_free_data( packed_context_free_data );
-            break;
+            return unpack_context_free_data( packed_context_free_data );
          case compression_type::zlib:
-            unpacked_trx.context_free_data = zlib_decompress_context_free_data( packed_context_free_data );
-            break;
+            return zlib_decompress_context_free_data( packed_context_free_data );
          default:
             EOS_THROW( unknown_transaction_compression, "Unknown transaction compression algorithm" );
       }
@@ -355,10 +353,10 @@ void packed_transaction::local_pack_transaction()
    try {
       switch(compression) {
          case compression_type::none:
-            packed_trx = pack_transaction(unpacked_trx);
+            packed_trx = pack_transaction(*unpacked_trx);
             break;
          case compression_type::zlib:
-            packed_trx = zlib_compress_transaction(unpacked_trx);
+            packed_trx = zlib_compress_transaction(*unpacked_trx);
             break;
          default:
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
@@ -371,10 +369,10 @@ void packed_transaction::local_pack_context_free_data()
    try {
       switch(compression) {
          case compression_type::none:
-            packed_context_free_data = pack_context_free_data(unpacked_trx.context_free_data);
+            packed_context_free_data = pack_context_free_data(unpacked_trx->context_free_data);
             break;
          case compression_type::zlib:
-            packed_context_free_data = zlib_compress_context_free_data(unpacked_trx.context_free_data);
+            packed_context_free_data = zlib_compress_context_free_data(unpacked_trx->context_free_data);
             break;
          default:
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
@@ -0,0 +1,70 @@
+#include <eosio/chain/transaction_conflict_detector.hpp>
+
+#include <limits>
+
+namespace eosio { namespace chain {
+
+trx_access_set* transaction_conflict_detector::begin_transaction() {
+   _access_sets.emplace_back();
+   return &_access_sets.back();
+}
+
+trx_access_set* transaction_conflict_detector::current() {
+   if( _access_sets.empty() ) return nullptr;
+   return &_access_sets.back();
+}
+
+vector<vector<uint32_t>> transaction_conflict_detector::conflict_groups()const {
+   const uint32_t n = _access_sets.size();
+
+   // union-find over transaction indices, the root of a set is always its lowest index
+   vector<uint32_t> parent( n );
+   for( uint32_t i = 0; i < n; ++i ) parent[i] = i;
+
+   auto find_root = [&parent]( uint32_t i ) {
+      while( parent[i] != i ) {
+         parent[i] = parent[parent[i]];
+         i = parent[i];
+      }
+      return i;
+   };
+
+   auto unite = [&]( uint32_t a, uint32_t b ) {
+      a = find_root( a );
+      b = find_root( b );
+      if( a == b ) return;
+      if( a < b ) parent[b] = a;
+      else        parent[a] = b;
+   };
+
+   // first transaction seen touching each resource
+   flat_map<account_name, uint32_t>                                     account_owner;
+   flat_map<std::tuple<account_name, scope_name, table_name>, uint32_t> table_owner;
+
+   for( uint32_t i = 0; i < n; ++i ) {
+      const auto& s = _access_sets[i];
+      for( const auto& a : s.accounts ) {
+         auto res = account_owner.emplace( a, i );
+         if( !res.second ) unite( res.first->second, i );
+      }
+      for( const auto& t : s.tables ) {
+         auto res = table_owner.emplace( t, i );
+         if( !res.second ) unite( res.first->second, i );
+      }
+   }
+
+   vector<vector<uint32_t>> groups;
+   vector<uint32_t> group_of_root( n, std::numeric_limits<uint32_t>::max() );
+   for( uint32_t i = 0; i < n; ++i ) {
+      auto root = find_root( i );
+      if( group_of_root[root] == std::numeric_limits<uint32_t>::max() ) {
+         group_of_root[root] = groups.size();
+         groups.emplace_back();
+      }
+      groups[group_of_root[root]].push_back( i );
+   }
+
+   return groups;
+}
+
+} } /// eosio::chain
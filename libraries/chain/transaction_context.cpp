@@ -6,6 +6,9 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/wasm_interface.hpp>
 
 #pragma push_macro("N")
 #undef N
@@ -60,6 +63,7 @@ namespace eosio { namespace chain {
    {
       if (!c.skip_db_sessions()) {
          undo_session = c.mutable_db().start_undo_session(true);
+         usage_undo_session = c.get_mutable_resource_limits_manager().start_usage_session();
       }
       trace->id = id;
       trace->block_num = c.head_block_num() + 1;
@@ -125,7 +129,9 @@ namespace eosio { namespace chain {
          validate_cpu_usage_to_bill( billed_cpu_time_us, false ); // Fail early if the amount to be billed is too high
 
       // Record accounts to be billed for network and CPU usage
-      if( control.is_builtin_activated(builtin_protocol_feature_t::only_bill_first_authorizer) ) {
+      if( read_only ) {
+         // nothing is billed for a read-only transaction
+      } else if( control.is_builtin_activated(builtin_protocol_feature_t::only_bill_first_authorizer) ) {
          bill_to_accounts.insert( trx.first_authorizer() );
       } else {
          for( const auto& act : trx.actions ) {
@@ -255,14 +261,108 @@ namespace eosio { namespace chain {
       init( 0 );
    }
 
-   void transaction_context::exec() {
+   void transaction_context::init_for_read_only_trx()
+   {
+      EOS_ASSERT( trx.transaction_extensions.size() == 0, invalid_transaction_extension,
+                  "no transaction extensions supported for read-only transactions" );
+      EOS_ASSERT( trx.delay_sec.value == 0, transaction_exception, "read-only transaction cannot be delayed" );
+
+      published = control.pending_block_time();
+      read_only = true;
+      init( 0 );
+   }
+
+   transaction_context::~transaction_context() {
+      wait_for_context_free_actions();
+   }
+
+   void transaction_context::start_context_free_actions() {
       EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
+      if( context_free_scheduled || !apply_context_free || trx.context_free_actions.empty() ) return;
+      schedule_context_free_actions();
+
+      // the modules are looked up on the main thread, where the wasm cache lives
+      auto& wasmif = control.get_wasm_interface();
+      context_free_results.resize( trx.context_free_actions.size() );
+      bool run_ahead = false;
+      for( size_t i = 0; i < trx.context_free_actions.size(); ++i ) {
+         const auto* receiver = control.db().find<account_metadata_object, by_name>( trx.context_free_actions[i].account );
+         if( !receiver || receiver->code_hash == digest_type() ) continue;
+         auto& r = context_free_results[i];
+         try {
+            r.module = wasmif.begin_concurrent_apply( receiver->code_hash, receiver->vm_type, receiver->vm_version, *this );
+         } catch( const fc::exception& ) {
+            continue; // exec() runs into the same error
+         }
+         if( !r.module ) break; // not supported by the runtime
+         r.code_hash = receiver->code_hash;
+         r.vm_type = receiver->vm_type;
+         r.vm_version = receiver->vm_version;
+         run_ahead = true;
+      }
+      if( !run_ahead ) return;
+
+      // in order on one thread since a transaction has a single checktime timer to interrupt a running module with
+      context_free_task = async_thread_pool( control.get_thread_pool(), [this]() {
+         for( uint32_t i = 0; i < context_free_results.size(); ++i ) {
+            auto& r = context_free_results[i];
+            if( !r.module ) continue;
+            const auto start = fc::time_point::now();
+            try {
+               apply_context acontext( control, *this, i + 1 );
+               r.console = acontext.exec_context_free_concurrently( *r.module );
+               r.succeeded = true;
+            } catch( ... ) {
+               // exec() runs it again to fail the transaction the usual way
+            }
+            r.elapsed = fc::time_point::now() - start;
+         }
+      } );
+   }
+
+   void transaction_context::schedule_context_free_actions() {
+      context_free_scheduled = true;
+
+      // room for the original actions plus about as many notifications and inline actions, so that typical
+      // transactions build their action traces without moving them around
+      const size_t num_original_actions = ( apply_context_free ? trx.context_free_actions.size() : 0 )
+                                          + ( delay == fc::microseconds() ? trx.actions.size() : 0 );
+      trace->action_traces.reserve( 2 * num_original_actions );
 
       if( apply_context_free ) {
          for( const auto& act : trx.context_free_actions ) {
             schedule_action( act, act.account, true, 0, 0 );
          }
       }
+   }
+
+   void transaction_context::wait_for_context_free_actions() {
+      if( context_free_task.valid() ) context_free_task.wait();
+      for( auto& r : context_free_results ) {
+         if( !r.module ) continue;
+         control.get_wasm_interface().end_concurrent_apply();
+         r.module = nullptr;
+      }
+   }
+
+   bool transaction_context::take_context_free_result( uint32_t action_ordinal, const account_metadata_object& receiver,
+                                                       std::string& console, fc::microseconds& elapsed ) {
+      // the context-free actions of the transaction have the first action ordinals
+      if( action_ordinal == 0 || action_ordinal > context_free_results.size() ) return false;
+      auto& r = context_free_results[action_ordinal - 1];
+      if( !r.succeeded || r.code_hash != receiver.code_hash || r.vm_type != receiver.vm_type || r.vm_version != receiver.vm_version )
+         return false;
+      r.succeeded = false;
+      console = std::move( r.console );
+      elapsed = r.elapsed;
+      return true;
+   }
+
+   void transaction_context::exec() {
+      EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
+
+      if( !context_free_scheduled ) schedule_context_free_actions();
+      wait_for_context_free_actions();
 
       if( delay == fc::microseconds() ) {
          for( const auto& act : trx.actions ) {
@@ -294,9 +394,14 @@ namespace eosio { namespace chain {
       }
 
       auto& rl = control.get_mutable_resource_limits_manager();
+      for( const auto& d : pending_ram_deltas ) {
+         rl.add_pending_ram_usage( d.first, d.second, validate_ram_usage.count( d.first ) > 0 );
+      }
       for( auto a : validate_ram_usage ) {
-         rl.verify_account_ram_usage( a );
+         if( pending_ram_deltas.count( a ) == 0 )
+            rl.verify_account_ram_usage( a );
       }
+      pending_ram_deltas.clear();
 
       // Calculate the new highest network usage and CPU time that all of the billed accounts can afford to be billed
       int64_t account_net_limit = 0;
@@ -338,10 +443,12 @@ namespace eosio { namespace chain {
 
    void transaction_context::squash() {
       if (undo_session) undo_session->squash();
+      if (usage_undo_session) usage_undo_session->squash();
    }
 
    void transaction_context::undo() {
       if (undo_session) undo_session->undo();
+      if (usage_undo_session) usage_undo_session->undo();
    }
 
    void transaction_context::check_net_usage()const {
@@ -455,8 +562,9 @@ namespace eosio { namespace chain {
    }
 
    void transaction_context::add_ram_usage( account_name account, int64_t ram_delta ) {
-      auto& rl = control.get_mutable_resource_limits_manager();
-      rl.add_pending_ram_usage( account, ram_delta );
+      if( ram_delta == 0 ) return;
+      // rows written for the same payer only add up here, the usage object of each account is updated once in finalize()
+      pending_ram_deltas[account] += ram_delta;
       if( ram_delta > 0 ) {
          validate_ram_usage.insert( account );
       }
@@ -557,7 +665,11 @@ namespace eosio { namespace chain {
    {
       uint32_t new_action_ordinal = trace->action_traces.size() + 1;
 
-      trace->action_traces.reserve( new_action_ordinal );
+      // grow geometrically, reserving exactly one more element would move every action trace on each notification
+      auto& action_traces = trace->action_traces;
+      if( action_traces.capacity() < new_action_ordinal ) {
+         action_traces.reserve( std::max<size_t>( new_action_ordinal, 2 * action_traces.capacity() ) );
+      }
 
       const action& provided_action = get_action_trace( action_ordinal ).act;
 
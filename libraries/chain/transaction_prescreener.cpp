@@ -0,0 +1,81 @@
+#include <eosio/chain/transaction_prescreener.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/thread_utils.hpp>
+
+namespace eosio { namespace chain {
+
+transaction_prescreener::transaction_prescreener( const controller& chain, fc::time_point block_time )
+:_chain( chain )
+,_block_time( block_time )
+,_min_cpu_us( chain.get_global_properties().configuration.min_transaction_cpu_usage )
+{}
+
+transaction_prescreener::~transaction_prescreener() {
+   stop();
+}
+
+optional<string> transaction_prescreener::screen( const transaction_metadata& trx, uint32_t cpu_estimate_us )const {
+   try {
+      const auto& t = trx.packed_trx()->get_transaction();
+      if( fc::time_point( t.expiration ) < _block_time )
+         return string( "expired" );
+
+      const auto& db = _chain.db();
+      flat_set<account_name> authorizers;
+      for( const auto* actions : { &t.context_free_actions, &t.actions } ) {
+         for( const auto& a : *actions ) {
+            if( !db.find<account_object, by_name>( a.account ) )
+               return "action of unknown account " + a.account.to_string();
+            for( const auto& auth : a.authorization ) {
+               if( !db.find<permission_object, by_owner>( boost::make_tuple( auth.actor, auth.permission ) ) )
+                  return "unknown authority " + auth.actor.to_string() + "@" + auth.permission.to_string();
+               authorizers.insert( auth.actor );
+            }
+         }
+      }
+
+      // every authorizer is billed the CPU of the transaction, the greylist is not applied so this errs on the side of passing
+      const int64_t needed = std::max( _min_cpu_us, cpu_estimate_us );
+      const auto& rl = _chain.get_resource_limits_manager();
+      for( const auto& a : authorizers ) {
+         const int64_t available = rl.get_account_cpu_limit( a ).first;
+         if( available >= 0 && available < needed )
+            return "insufficient CPU of " + a.to_string();
+      }
+   } catch( ... ) {
+      // nothing the checks can predict, applying the transaction reports whatever is wrong with it
+   }
+   return {};
+}
+
+void transaction_prescreener::start( boost::asio::io_context& thread_pool, uint16_t threads, vector<queued_transaction> trxs ) {
+   EOS_ASSERT( _workers.empty(), misc_exception, "transaction prescreener already started" );
+   _trxs = std::move( trxs );
+   _failures.assign( _trxs.size(), optional<string>() );
+   const size_t workers = std::min<size_t>( std::max<uint16_t>( threads, 1 ), _trxs.size() );
+   _workers.reserve( workers );
+   for( size_t w = 0; w < workers; ++w ) {
+      _workers.emplace_back( async_thread_pool( thread_pool, [this]() {
+         while( !_stopping.load( std::memory_order_relaxed ) ) {
+            const size_t i = _next.fetch_add( 1 );
+            if( i >= _trxs.size() ) break;
+            _failures[i] = screen( *_trxs[i].trx, _trxs[i].cpu_estimate_us );
+         }
+      } ) );
+   }
+}
+
+const vector<optional<string>>& transaction_prescreener::stop() {
+   _stopping = true;
+   for( auto& w : _workers ) {
+      if( w.valid() ) w.wait();
+   }
+   // every index taken by a worker was screened before it returned
+   _screened = std::min( _next.load(), _trxs.size() );
+   return _failures;
+}
+
+} } /// eosio::chain
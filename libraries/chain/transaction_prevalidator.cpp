@@ -0,0 +1,104 @@
+#include <eosio/chain/transaction_prevalidator.hpp>
+#include <eosio/chain/block_summary_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+namespace eosio { namespace chain {
+
+transaction_prevalidator::transaction_prevalidator( size_t max_recent_ids )
+:_max_recent_ids( max_recent_ids )
+{}
+
+void transaction_prevalidator::reset( const chainbase::database& db, const block_state_ptr& head, const chain_config& cfg ) {
+   std::unique_lock g( _mtx );
+   _ref_blocks.assign( 0x10000, unknown_ref_block );
+   for( const auto& summary : db.get_index<block_summary_multi_index, by_id>() ) {
+      if( summary.block_id == block_id_type() ) continue;
+      _ref_blocks[summary.id._id & 0xffff] = known_ref_block | uint32_t(summary.block_id._hash[1]);
+   }
+   _head_num = head->block_num;
+   _head_time = head->header.timestamp.to_time_point();
+   _recent_blocks.clear();
+   _recent_ids.clear();
+   set_config( cfg );
+}
+
+void transaction_prevalidator::on_accepted_block( const block_state_ptr& bsp, const chain_config& cfg ) {
+   std::unique_lock g( _mtx );
+   if( _ref_blocks.empty() ) return;
+
+   if( bsp->block_num <= _head_num ) {
+      // a fork switch popped the blocks from this one on, the controller restored their previous summaries
+      for( uint32_t n = bsp->block_num + 1; n <= _head_num && n - bsp->block_num <= 0x10000; ++n )
+         _ref_blocks[n & 0xffff] = unknown_ref_block;
+      while( !_recent_blocks.empty() && _recent_blocks.back().block_num >= bsp->block_num ) {
+         for( const auto& id : _recent_blocks.back().ids ) _recent_ids.erase( id );
+         _recent_blocks.pop_back();
+      }
+   }
+   _ref_blocks[bsp->block_num & 0xffff] = known_ref_block | uint32_t(bsp->id._hash[1]);
+   _head_num = bsp->block_num;
+   _head_time = bsp->header.timestamp.to_time_point();
+   set_config( cfg );
+
+   recent_block b{ bsp->block_num, _head_time, {} };
+   b.ids.reserve( bsp->block->transactions.size() );
+   for( const auto& receipt : bsp->block->transactions ) {
+      if( !receipt.trx.contains<packed_transaction>() ) continue;
+      const auto& id = receipt.trx.get<packed_transaction>().id();
+      if( _recent_ids.insert( id ).second ) b.ids.push_back( id );
+   }
+   _recent_blocks.emplace_back( std::move(b) );
+
+   // transactions of blocks older than the maximum lifetime have all expired
+   const fc::microseconds lifetime = fc::seconds( _max_transaction_lifetime );
+   while( !_recent_blocks.empty() &&
+          ( _recent_ids.size() > _max_recent_ids || _recent_blocks.front().timestamp + lifetime < _head_time ) ) {
+      pop_recent_block();
+   }
+}
+
+void transaction_prevalidator::pop_recent_block() {
+   for( const auto& id : _recent_blocks.front().ids ) _recent_ids.erase( id );
+   _recent_blocks.pop_front();
+}
+
+void transaction_prevalidator::set_config( const chain_config& cfg ) {
+   _max_transaction_net_usage = cfg.max_transaction_net_usage;
+   _base_per_transaction_net_usage = cfg.base_per_transaction_net_usage;
+   _max_transaction_lifetime = cfg.max_transaction_lifetime;
+}
+
+void transaction_prevalidator::validate( const packed_transaction& trx )const {
+   std::shared_lock g( _mtx );
+   if( _ref_blocks.empty() ) return;
+   const transaction& t = trx.get_transaction();
+
+   // the pending block time is never before the head block time
+   EOS_ASSERT( fc::time_point( t.expiration ) >= _head_time, expired_tx_exception,
+               "expired transaction ${id}, expiration ${e}, head block time ${bt}",
+               ("id", trx.id())("e", t.expiration)("bt", _head_time) );
+
+   const uint64_t ref_block = _ref_blocks[t.ref_block_num];
+   EOS_ASSERT( ref_block == unknown_ref_block || uint32_t(ref_block) == t.ref_block_prefix, invalid_ref_block_exception,
+               "Transaction's reference block did not match. Is this transaction from a different fork?" );
+
+   EOS_ASSERT( _recent_ids.count( trx.id() ) == 0, tx_duplicate, "duplicate transaction ${id}", ("id", trx.id()) );
+
+   // the net usage billed includes at least the unprunable data, the limit is rounded down to whole words
+   uint64_t net_limit = _max_transaction_net_usage;
+   const uint64_t trx_specified_net_usage_limit = static_cast<uint64_t>(t.max_net_usage_words.value) * 8;
+   if( trx_specified_net_usage_limit > 0 && trx_specified_net_usage_limit < net_limit )
+      net_limit = trx_specified_net_usage_limit;
+   net_limit = (net_limit / 8) * 8;
+   const uint64_t min_net_usage = static_cast<uint64_t>(_base_per_transaction_net_usage) + trx.get_unprunable_size();
+   EOS_ASSERT( min_net_usage <= net_limit, tx_net_usage_exceeded,
+               "transaction net usage is too high: ${net_usage} > ${net_limit}",
+               ("net_usage", min_net_usage)("net_limit", net_limit) );
+}
+
+size_t transaction_prevalidator::recent_ids()const {
+   std::shared_lock g( _mtx );
+   return _recent_ids.size();
+}
+
+} } /// eosio::chain
@@ -0,0 +1,245 @@
+#include <eosio/chain/transaction_tracing.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+transaction_trace_context::transaction_trace_context( const transaction_id_type& id, std::string origin )
+:_id( id )
+,_origin( std::move(origin) )
+,_start( fc::time_point::now() )
+,_last( _start )
+{}
+
+void transaction_trace_context::step( std::string name, std::string detail ) {
+   const auto now = fc::time_point::now();
+   std::lock_guard g( _mtx );
+   _spans.push_back( { std::move(name), _last, now, std::move(detail) } );
+   _last = now;
+}
+
+transaction_trace_context::snapshot transaction_trace_context::get()const {
+   std::lock_guard g( _mtx );
+   return { _origin, _start, _spans };
+}
+
+namespace detail {
+
+   struct finished_trace {
+      transaction_id_type                  id;
+      transaction_trace_context::snapshot  trace;
+      fc::time_point                       end;
+      std::string                          status;
+   };
+
+   struct transaction_tracing_impl {
+      // traces of transactions never included nor failed, e.g. dropped by a full queue, are ended when this many are open
+      static constexpr size_t max_open_traces = 100000;
+
+      mutable std::mutex                                   mtx;
+      std::atomic<uint32_t>                                sample_one_in{0};
+      std::unordered_map<transaction_id_type, transaction_trace_context_ptr> open;
+      std::deque<transaction_id_type>                      open_order;
+
+      std::mutex                                           export_mtx;
+      std::condition_variable                              export_cv;
+      std::deque<finished_trace>                           to_export;
+      bool                                                 stopping = false;
+      std::ofstream                                        out;
+      std::thread                                          exporter;
+
+      bool sampled( const transaction_id_type& id )const {
+         const auto n = sample_one_in.load( std::memory_order_relaxed );
+         return n != 0 && id._hash[1] % n == 0;
+      }
+
+      static std::string hex( uint64_t v ) {
+         return fc::to_hex( (const char*)&v, sizeof(v) );
+      }
+
+      static std::string unix_nano( const fc::time_point& t ) {
+         return std::to_string( uint64_t(t.time_since_epoch().count()) * 1000 );
+      }
+
+      static fc::mutable_variant_object span( const std::string& trace_id, uint64_t span_id, const uint64_t* parent,
+                                              const std::string& name, const fc::time_point& start, const fc::time_point& end,
+                                              fc::variants attributes ) {
+         fc::mutable_variant_object s;
+         s( "traceId", trace_id )( "spanId", hex( span_id ) );
+         if( parent ) s( "parentSpanId", hex( *parent ) );
+         s( "name", name )( "kind", 1 )
+          ( "startTimeUnixNano", unix_nano( start ) )( "endTimeUnixNano", unix_nano( end ) )
+          ( "attributes", std::move( attributes ) );
+         return s;
+      }
+
+      static fc::variant attribute( const std::string& key, const std::string& value ) {
+         return fc::mutable_variant_object()( "key", key )( "value", fc::mutable_variant_object()( "stringValue", value ) );
+      }
+
+      static std::string to_otlp_json( const finished_trace& t ) {
+         const std::string trace_id = fc::to_hex( t.id.data(), 16 );
+         const uint64_t root_id = t.id._hash[2];
+         fc::variants spans;
+         spans.reserve( t.trace.spans.size() + 1 );
+         auto root = span( trace_id, root_id, nullptr, "transaction", t.trace.start, t.end,
+                           { attribute( "transaction.id", t.id.str() ), attribute( "origin", t.trace.origin ) } );
+         const bool ok = t.status == "included";
+         root( "status", fc::mutable_variant_object()( "code", ok ? 1 : 2 )( "message", t.status ) );
+         spans.emplace_back( std::move( root ) );
+         uint64_t child_id = root_id;
+         for( const auto& s : t.trace.spans ) {
+            fc::variants attributes;
+            if( !s.detail.empty() ) attributes.emplace_back( attribute( "detail", s.detail ) );
+            spans.emplace_back( span( trace_id, ++child_id, &root_id, s.name, s.start, s.end, std::move( attributes ) ) );
+         }
+         fc::variants scope_spans{ fc::mutable_variant_object()
+               ( "scope", fc::mutable_variant_object()( "name", "eosio.transaction" ) )
+               ( "spans", std::move( spans ) ) };
+         fc::variants resource_spans{ fc::mutable_variant_object()
+               ( "resource", fc::mutable_variant_object()( "attributes", fc::variants{ attribute( "service.name", "nodeos" ) } ) )
+               ( "scopeSpans", std::move( scope_spans ) ) };
+         return fc::json::to_string( fc::mutable_variant_object()( "resourceSpans", std::move( resource_spans ) ),
+                                     fc::time_point::maximum() );
+      }
+
+      void export_loop() {
+         std::unique_lock g( export_mtx );
+         while( true ) {
+            export_cv.wait( g, [&]() { return stopping || !to_export.empty(); } );
+            if( to_export.empty() ) return;
+            auto batch = std::move( to_export );
+            to_export.clear();
+            g.unlock();
+            for( const auto& t : batch ) {
+               try {
+                  out << to_otlp_json( t ) << '\n';
+               } FC_LOG_AND_DROP()
+            }
+            out.flush();
+            g.lock();
+         }
+      }
+
+      void stop() {
+         {
+            std::lock_guard g( export_mtx );
+            stopping = true;
+         }
+         export_cv.notify_one();
+         if( exporter.joinable() )
+            exporter.join();
+      }
+
+      /// @pre mtx is held
+      void finish( const transaction_trace_context_ptr& ctx, const std::string& status ) {
+         finished_trace t{ ctx->id(), ctx->get(), fc::time_point::now(), status };
+         {
+            std::lock_guard g( export_mtx );
+            if( stopping ) return;
+            to_export.emplace_back( std::move( t ) );
+         }
+         export_cv.notify_one();
+      }
+   };
+}
+
+transaction_tracing& transaction_tracing::instance() {
+   static transaction_tracing the_instance;
+   return the_instance;
+}
+
+transaction_tracing::transaction_tracing()
+:my( new detail::transaction_tracing_impl() )
+{}
+
+transaction_tracing::~transaction_tracing() {
+   my->stop();
+}
+
+void transaction_tracing::configure( uint32_t sample_one_in, const fc::path& export_file ) {
+   my->stop();
+   std::lock_guard g( my->mtx );
+   my->open.clear();
+   my->open_order.clear();
+   my->sample_one_in = 0;
+   if( my->out.is_open() ) my->out.close();
+   if( sample_one_in == 0 )
+      return;
+   my->out.open( export_file.generic_string(), std::ios::out | std::ios::app );
+   EOS_ASSERT( my->out, misc_exception, "unable to open transaction trace file ${f}", ("f", export_file.generic_string()) );
+   my->stopping = false;
+   my->exporter = std::thread( [this]() {
+      fc::set_os_thread_name( "trx-trace" );
+      my->export_loop();
+   } );
+   my->sample_one_in = sample_one_in;
+}
+
+bool transaction_tracing::enabled()const {
+   return my->sample_one_in.load( std::memory_order_relaxed ) != 0;
+}
+
+transaction_trace_context_ptr transaction_tracing::begin( const transaction_id_type& id, const char* origin ) {
+   if( !my->sampled( id ) )
+      return {};
+   std::lock_guard g( my->mtx );
+   auto& ctx = my->open[id];
+   if( ctx )
+      return ctx;
+   ctx = std::make_shared<transaction_trace_context>( id, origin );
+   auto result = ctx;
+   my->open_order.push_back( id );
+   if( my->open_order.size() > 2 * detail::transaction_tracing_impl::max_open_traces ) {
+      // drop the ids of the traces already ended
+      std::deque<transaction_id_type> order;
+      for( const auto& i : my->open_order )
+         if( my->open.count( i ) ) order.push_back( i );
+      my->open_order = std::move( order );
+   }
+   while( my->open.size() > detail::transaction_tracing_impl::max_open_traces && !my->open_order.empty() ) {
+      auto itr = my->open.find( my->open_order.front() );
+      my->open_order.pop_front();
+      if( itr == my->open.end() ) continue;
+      my->finish( itr->second, "abandoned" );
+      my->open.erase( itr );
+   }
+   return result;
+}
+
+transaction_trace_context_ptr transaction_tracing::find( const transaction_id_type& id )const {
+   if( !my->sampled( id ) )
+      return {};
+   std::lock_guard g( my->mtx );
+   auto itr = my->open.find( id );
+   return itr == my->open.end() ? transaction_trace_context_ptr() : itr->second;
+}
+
+void transaction_tracing::end( const transaction_id_type& id, const std::string& status ) {
+   if( !my->sampled( id ) )
+      return;
+   std::lock_guard g( my->mtx );
+   auto itr = my->open.find( id );
+   if( itr == my->open.end() )
+      return;
+   my->finish( itr->second, status );
+   my->open.erase( itr );
+   // open_order keeps the id until it reaches the front, where it is skipped
+   if( my->open.empty() ) my->open_order.clear();
+}
+
+void transaction_tracing::shutdown() {
+   my->stop();
+}
+
+} } /// eosio::chain
@@ -0,0 +1,205 @@
+#include <eosio/chain/trx_block_index.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace eosio { namespace chain {
+
+namespace {
+   uint64_t id_prefix( const transaction_id_type& id ) {
+      return id._hash[0];
+   }
+}
+
+trx_block_index::trx_block_index( const fc::path& file, uint32_t bucket_bits )
+:_file( file )
+{
+   EOS_ASSERT( bucket_bits > 0 && bucket_bits <= 30, block_log_exception,
+               "trx index bucket bits ${b} out of range [1,30]", ("b", bucket_bits) );
+   _fd = ::open( _file.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+   EOS_ASSERT( _fd >= 0, block_log_exception, "Unable to open ${file}: ${e}", ("file", _file.generic_string())("e", strerror(errno)) );
+
+   const uint64_t size = fc::file_size( _file );
+   if( size == 0 ) {
+      _header = { magic_number, current_version, bucket_bits, 0 };
+      _directory.assign( uint64_t(1) << bucket_bits, 0 );
+      _end_pos = data_pos();
+      EOS_ASSERT( ::ftruncate( _fd, _end_pos ) == 0, block_log_exception, "Unable to size ${file}", ("file", _file.generic_string()) );
+      write_header();
+   } else {
+      EOS_ASSERT( size >= sizeof(header), block_log_exception, "${file} is truncated", ("file", _file.generic_string()) );
+      read( (char*)&_header, sizeof(_header), 0 );
+      EOS_ASSERT( _header.magic == magic_number, block_log_exception, "${file} is not a transaction index", ("file", _file.generic_string()) );
+      EOS_ASSERT( _header.version == current_version, block_log_exception,
+                  "${file} has unsupported version ${v}", ("file", _file.generic_string())("v", _header.version) );
+      EOS_ASSERT( _header.bucket_bits > 0 && _header.bucket_bits <= 30, block_log_exception,
+                  "${file} is corrupted", ("file", _file.generic_string()) );
+      _directory.resize( uint64_t(1) << _header.bucket_bits );
+      EOS_ASSERT( size >= data_pos(), block_log_exception, "${file} is truncated", ("file", _file.generic_string()) );
+      read( (char*)_directory.data(), _directory.size() * sizeof(uint64_t), directory_pos( 0 ) );
+      // a page cut short by a crash is dropped, no directory entry written after it can refer to it
+      _end_pos = data_pos() + ( size - data_pos() ) / page_size * page_size;
+      for( auto& d : _directory )
+         if( d >= _end_pos ) d = 0;
+   }
+   _page_count.assign( _directory.size(), unknown_count );
+}
+
+trx_block_index::~trx_block_index() {
+   try {
+      flush();
+   } FC_LOG_AND_DROP()
+   ::close( _fd );
+}
+
+void trx_block_index::read( char* data, size_t size, uint64_t pos )const {
+   while( size > 0 ) {
+      const ssize_t n = ::pread( _fd, data, size, pos );
+      if( n < 0 && errno == EINTR ) continue;
+      EOS_ASSERT( n > 0, block_log_exception, "Unable to read ${size} bytes at ${pos} of ${file}",
+                  ("size", size)("pos", pos)("file", _file.generic_string()) );
+      data += n;
+      pos += n;
+      size -= n;
+   }
+}
+
+void trx_block_index::write( const char* data, size_t size, uint64_t pos ) {
+   while( size > 0 ) {
+      const ssize_t n = ::pwrite( _fd, data, size, pos );
+      if( n < 0 && errno == EINTR ) continue;
+      EOS_ASSERT( n > 0, block_log_exception, "Unable to write ${size} bytes at ${pos} of ${file}",
+                  ("size", size)("pos", pos)("file", _file.generic_string()) );
+      data += n;
+      pos += n;
+      size -= n;
+   }
+}
+
+void trx_block_index::write_header() {
+   write( (const char*)&_header, sizeof(_header), 0 );
+}
+
+void trx_block_index::add( const signed_block& b ) {
+   const uint32_t block_num = b.block_num();
+   for( const auto& id : transaction_ids( b ) )
+      add( id, block_num );
+   set_last_block_num( block_num );
+}
+
+void trx_block_index::add( const transaction_id_type& id, uint32_t block_num ) {
+   const uint64_t prefix = id_prefix( id );
+   const uint64_t bucket = prefix & ( _directory.size() - 1 );
+
+   char entry[entry_size];
+   memcpy( entry, &prefix, sizeof(prefix) );
+   memcpy( entry + sizeof(prefix), &block_num, sizeof(block_num) );
+
+   std::lock_guard<std::mutex> g( _mtx );
+   uint64_t page = _directory[bucket];
+   uint32_t count = 0;
+   if( page ) {
+      count = _page_count[bucket];
+      if( count == unknown_count ) {
+         read( (char*)&count, sizeof(count), page + sizeof(uint64_t) );
+         count = std::min( count, entries_per_page );
+      }
+   }
+   if( !page || count == entries_per_page ) {
+      // the new page is written whole before the directory refers to it
+      char data[page_size] = {};
+      count = 1;
+      memcpy( data, &page, sizeof(page) );
+      memcpy( data + sizeof(page), &count, sizeof(count) );
+      memcpy( data + page_header_size, entry, entry_size );
+      page = _end_pos;
+      write( data, page_size, page );
+      _end_pos += page_size;
+      write( (const char*)&page, sizeof(page), directory_pos( bucket ) );
+      _directory[bucket] = page;
+   } else {
+      write( entry, entry_size, page + page_header_size + count * entry_size );
+      ++count;
+      write( (const char*)&count, sizeof(count), page + sizeof(uint64_t) );
+   }
+   _page_count[bucket] = count;
+}
+
+vector<uint32_t> trx_block_index::find( const transaction_id_type& id )const {
+   const uint64_t prefix = id_prefix( id );
+   vector<uint32_t> result;
+   std::lock_guard<std::mutex> g( _mtx );
+   char data[page_size];
+   for( uint64_t page = _directory[prefix & ( _directory.size() - 1 )]; page; ) {
+      read( data, page_size, page );
+      uint32_t count = 0;
+      memcpy( &count, data + sizeof(uint64_t), sizeof(count) );
+      for( uint32_t i = std::min( count, entries_per_page ); i-- > 0; ) {
+         const char* entry = data + page_header_size + i * entry_size;
+         if( memcmp( entry, &prefix, sizeof(prefix) ) == 0 ) {
+            uint32_t block_num = 0;
+            memcpy( &block_num, entry + sizeof(prefix), sizeof(block_num) );
+            if( result.empty() || result.back() != block_num )
+               result.push_back( block_num );
+         }
+      }
+      uint64_t previous = 0;
+      memcpy( &previous, data, sizeof(previous) );
+      // pages only ever refer to pages written before them
+      page = previous < page ? previous : 0;
+   }
+   return result;
+}
+
+uint32_t trx_block_index::last_block_num()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _header.last_block_num;
+}
+
+void trx_block_index::set_last_block_num( uint32_t block_num ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _header.last_block_num = block_num;
+}
+
+void trx_block_index::clear() {
+   std::lock_guard<std::mutex> g( _mtx );
+   std::fill( _directory.begin(), _directory.end(), 0 );
+   std::fill( _page_count.begin(), _page_count.end(), unknown_count );
+   _header.last_block_num = 0;
+   _end_pos = data_pos();
+   EOS_ASSERT( ::ftruncate( _fd, 0 ) == 0 && ::ftruncate( _fd, _end_pos ) == 0, block_log_exception,
+               "Unable to truncate ${file}", ("file", _file.generic_string()) );
+   write_header();
+}
+
+void trx_block_index::flush() {
+   std::lock_guard<std::mutex> g( _mtx );
+   write_header();
+}
+
+vector<transaction_id_type> trx_block_index::transaction_ids( const signed_block& b ) {
+   vector<transaction_id_type> ids;
+   ids.reserve( b.transactions.size() );
+   for( const auto& receipt : b.transactions ) {
+      if( receipt.trx.contains<packed_transaction>() )
+         ids.push_back( receipt.trx.get<packed_transaction>().id() );
+      else
+         ids.push_back( receipt.trx.get<transaction_id_type>() );
+   }
+   return ids;
+}
+
+bool trx_block_index::contains( const signed_block& b, const transaction_id_type& id ) {
+   for( const auto& receipt : b.transactions ) {
+      if( receipt.trx.contains<packed_transaction>() ? receipt.trx.get<packed_transaction>().id() == id
+                                                     : receipt.trx.get<transaction_id_type>() == id )
+         return true;
+   }
+   return false;
+}
+
+} } /// eosio::chain
@@ -13,10 +13,13 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/native_float.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha1.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <softfloat.hpp>
 #include <compiler_builtins.hpp>
@@ -32,8 +35,9 @@
 namespace eosio { namespace chain {
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config)
-     : my( new wasm_interface_impl(vm, eosvmoc_tierup, d, data_dir, eosvmoc_config) ) {}
+   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                                  uint32_t preinstantiate_codes, uint64_t max_cache_bytes, bool profile)
+     : my( new wasm_interface_impl(vm, eosvmoc_tierup, d, data_dir, eosvmoc_config, preinstantiate_codes, max_cache_bytes, profile) ) {}
 
    wasm_interface::~wasm_interface() {}
 
@@ -56,11 +60,22 @@ namespace eosio { namespace chain {
       root_resolver resolver( pso.whitelisted_intrinsics );
       LinkResult link_result = linkModule(module, resolver);
 
-      //there are a couple opportunties for improvement here--
+      //there is an opportunity for improvement here--
       //Easy: Cache the Module created here so it can be reused for instantiaion
-      //Hard: Kick off instantiation in a separate thread at this location
+      //(eos-vm runtimes instantiate in a separate thread from setcode, see preinstantiate())
 	 }
 
+   void wasm_interface::validate(const controller& control, const bytes& code, const digest_type& code_hash) {
+      //nested limits are only enforced while producing, so a code validated while applying others' blocks may still fail them
+      const bool strict = control.is_producing_block();
+      const auto key = my->validation_key(control.db().get<protocol_state_object>().whitelisted_intrinsics, code_hash);
+      auto it = my->validated_codes.find(key);
+      if(it != my->validated_codes.end() && (it->second || !strict))
+         return;
+      validate(control, code);
+      my->validated_codes[key] = strict;
+   }
+
    void wasm_interface::indicate_shutting_down() {
       my->is_shutting_down = true;
    }
@@ -74,6 +89,12 @@ namespace eosio { namespace chain {
    }
 
    void wasm_interface::apply( const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context ) {
+      //failed and exited executions are timed too
+      const fc::time_point profile_start = my->profile ? fc::time_point::now() : fc::time_point();
+      auto profile = fc::make_scoped_exit([&]() {
+         if(my->profile)
+            my->record_profile(context.get_receiver(), context.get_action(), code_hash, fc::time_point::now() - profile_start);
+      });
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       if(my->eosvmoc) {
          const chain::eosvmoc::code_descriptor* cd = nullptr;
@@ -89,9 +110,16 @@ namespace eosio { namespace chain {
             once_is_enough = true;
          }
          if(cd) {
-            my->eosvmoc->exec.execute(*cd, my->eosvmoc->mem, context);
+            my->eosvmoc->executors.execute(*cd, context);
             return;
          }
+         //time the interpreter so the hottest code gets compiled first
+         const fc::time_point start = fc::time_point::now();
+         auto record = fc::make_scoped_exit([&]() {
+            my->eosvmoc->cc.record_interpreted_execution(code_hash, vm_version, fc::time_point::now() - start);
+         });
+         my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context)->apply(context);
+         return;
       }
 #endif
       my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context)->apply(context);
@@ -101,6 +129,118 @@ namespace eosio { namespace chain {
       my->runtime_interface->immediately_exit_currently_running_module();
    }
 
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   //OC compiled code run by a slice of the tier-up's executor pool. The descriptor was looked up on the main thread,
+   // which leaves the code cache alone until end_concurrent_apply() since it waits for the concurrent applies first
+   class eosvmoc_concurrent_module : public wasm_instantiated_module_interface {
+      public:
+         eosvmoc_concurrent_module(eosvmoc::executor_pool& executors, const eosvmoc::code_descriptor& cd) : _executors(executors), _cd(cd) {}
+         void apply(apply_context& context) override { _executors.execute(_cd, context); }
+      private:
+         eosvmoc::executor_pool&          _executors;
+         const eosvmoc::code_descriptor& _cd;
+   };
+#endif
+
+   wasm_instantiated_module_interface* wasm_interface::begin_concurrent_apply(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, transaction_context& trx_context) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc) {
+         //a transaction runs ahead on one thread, the other slices are left to the main thread
+         if(my->eosvmoc->executors.size() < 2)
+            return nullptr;
+         const eosvmoc::code_descriptor* cd = nullptr;
+         try {
+            cd = my->eosvmoc->cc.get_descriptor_for_code(code_hash, vm_version);
+         } catch(...) {} //apply() reports it when the action runs on the main thread
+         if(cd) {
+            my->eosvmoc->concurrent_modules.emplace_back(std::make_unique<eosvmoc_concurrent_module>(my->eosvmoc->executors, *cd));
+            ++my->concurrent_applies;
+            return my->eosvmoc->concurrent_modules.back().get();
+         }
+         //code not compiled yet runs ahead in the base runtime
+      }
+#endif
+      //eos-vm modules hand each concurrent apply its own backend, wabt runs in statics
+      if(my->wasm_runtime_time != wasm_interface::vm_type::eos_vm && my->wasm_runtime_time != wasm_interface::vm_type::eos_vm_jit)
+         return nullptr;
+      wasm_instantiated_module_interface* module = my->get_concurrent_module(code_hash, vm_type, vm_version, trx_context);
+      ++my->concurrent_applies;
+      return module;
+   }
+
+   void wasm_interface::end_concurrent_apply() {
+      --my->concurrent_applies;
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc && !my->concurrent_applies)
+         my->eosvmoc->concurrent_modules.clear();
+#endif
+   }
+
+   void wasm_interface::record_concurrent_apply(const digest_type& code_hash, const apply_context& context, fc::microseconds elapsed) {
+      if(my->profile)
+         my->record_profile(context.get_receiver(), context.get_action(), code_hash, elapsed);
+   }
+
+   void wasm_interface::preinstantiate(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const bytes& code) {
+      my->preinstantiate(code_hash, vm_type, vm_version, code.data(), code.size());
+   }
+
+   void wasm_interface::preinstantiate_recent_codes() {
+      try {
+         my->preinstantiate_recent_codes();
+      } FC_LOG_AND_DROP()
+   }
+
+   wasm_cache_stats wasm_interface::get_cache_stats()const {
+      wasm_cache_stats stats = my->stats;
+      stats.max_bytes = my->max_cache_bytes;
+      stats.entries = my->wasm_instantiation_cache.size();
+      return stats;
+   }
+
+   std::vector<wasm_profile_entry> wasm_interface::get_profile()const {
+      std::vector<wasm_profile_entry> result;
+      result.reserve(my->profile_entries.size());
+      for(const auto& e : my->profile_entries)
+         result.push_back(e.second);
+      std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.total_us > b.total_us; });
+      return result;
+   }
+
+   void wasm_interface::start_eosvmoc_warm_up() {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc) {
+         try {
+            my->eosvmoc->cc.start_warm_up();
+         } FC_LOG_AND_DROP()
+      }
+#endif
+   }
+
+   fc::optional<eosvmoc::warm_up_status> wasm_interface::get_eosvmoc_warm_up_status() {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc)
+         return my->eosvmoc->cc.get_warm_up_status();
+#endif
+      return {};
+   }
+
+   fc::optional<eosvmoc::code_artifact> wasm_interface::export_eosvmoc_code(const digest_type& code_hash, const uint8_t& vm_version) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc)
+         return my->eosvmoc->cc.export_code(code_hash, vm_version);
+#endif
+      return {};
+   }
+
+   bool wasm_interface::import_eosvmoc_code(const eosvmoc::code_artifact& artifact) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc)
+         return my->eosvmoc->cc.import_code(artifact);
+#endif
+      EOS_THROW(misc_exception, "EOS VM OC tier-up is not enabled");
+   }
+
    wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
    wasm_runtime_interface::~wasm_runtime_interface() {}
 
@@ -326,18 +466,30 @@ class softfloat_api : public context_aware_api {
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
       // float binops
       float _eosio_f32_add( float a, float b ) {
+         float r;
+         if( native_float::compute( r, [&]{ return a + b; } ) )
+            return r;
          float32_t ret = ::f32_add( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_sub( float a, float b ) {
+         float r;
+         if( native_float::compute( r, [&]{ return a - b; } ) )
+            return r;
          float32_t ret = ::f32_sub( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_div( float a, float b ) {
+         float r;
+         if( native_float::compute( r, [&]{ return a / b; } ) )
+            return r;
          float32_t ret = ::f32_div( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_mul( float a, float b ) {
+         float r;
+         if( native_float::compute( r, [&]{ return a * b; } ) )
+            return r;
          float32_t ret = ::f32_mul( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
@@ -392,6 +544,9 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
+         float r;
+         if( native_float::compute( r, [&]{ return std::sqrt( a ); } ) )
+            return r;
          float32_t ret = ::f32_sqrt( to_softfloat32(a) );
          return from_softfloat32(ret);
       }
@@ -495,18 +650,30 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
+         double r;
+         if( native_float::compute( r, [&]{ return a + b; } ) )
+            return r;
          float64_t ret = ::f64_add( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_sub( double a, double b ) {
+         double r;
+         if( native_float::compute( r, [&]{ return a - b; } ) )
+            return r;
          float64_t ret = ::f64_sub( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_div( double a, double b ) {
+         double r;
+         if( native_float::compute( r, [&]{ return a / b; } ) )
+            return r;
          float64_t ret = ::f64_div( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_mul( double a, double b ) {
+         double r;
+         if( native_float::compute( r, [&]{ return a * b; } ) )
+            return r;
          float64_t ret = ::f64_mul( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
@@ -555,6 +722,9 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return std::sqrt( a ); } ) )
+            return r;
          float64_t ret = ::f64_sqrt( to_softfloat64(a) );
          return from_softfloat64(ret);
       }
@@ -665,9 +835,15 @@ class softfloat_api : public context_aware_api {
 
       // float and double conversions
       double _eosio_f32_promote( float a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return double( a ); } ) )
+            return r;
          return from_softfloat64(f32_to_f64( to_softfloat32(a)) );
       }
       float _eosio_f64_demote( double a ) {
+         float r;
+         if( native_float::compute( r, [&]{ return float( a ); } ) )
+            return r;
          return from_softfloat32(f64_to_f32( to_softfloat64(a)) );
       }
       int32_t _eosio_f32_trunc_i32s( float af ) {
@@ -737,27 +913,51 @@ class softfloat_api : public context_aware_api {
          return f64_to_ui64( to_softfloat64(_eosio_f64_trunc( af )), 0, false );
       }
       float _eosio_i32_to_f32( int32_t a )  {
+         float r;
+         if( native_float::compute( r, [&]{ return float( a ); } ) )
+            return r;
          return from_softfloat32(i32_to_f32( a ));
       }
       float _eosio_i64_to_f32( int64_t a ) {
+         float r;
+         if( native_float::compute( r, [&]{ return float( a ); } ) )
+            return r;
          return from_softfloat32(i64_to_f32( a ));
       }
       float _eosio_ui32_to_f32( uint32_t a ) {
+         float r;
+         if( native_float::compute( r, [&]{ return float( a ); } ) )
+            return r;
          return from_softfloat32(ui32_to_f32( a ));
       }
       float _eosio_ui64_to_f32( uint64_t a ) {
+         float r;
+         if( native_float::compute( r, [&]{ return float( a ); } ) )
+            return r;
          return from_softfloat32(ui64_to_f32( a ));
       }
       double _eosio_i32_to_f64( int32_t a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return double( a ); } ) )
+            return r;
          return from_softfloat64(i32_to_f64( a ));
       }
       double _eosio_i64_to_f64( int64_t a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return double( a ); } ) )
+            return r;
          return from_softfloat64(i64_to_f64( a ));
       }
       double _eosio_ui32_to_f64( uint32_t a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return double( a ); } ) )
+            return r;
          return from_softfloat64(ui32_to_f64( a ));
       }
       double _eosio_ui64_to_f64( uint64_t a ) {
+         double r;
+         if( native_float::compute( r, [&]{ return double( a ); } ) )
+            return r;
          return from_softfloat64(ui64_to_f64( a ));
       }
 
@@ -821,7 +1021,7 @@ class crypto_api : public context_aware_api {
             EOS_ASSERT(s.variable_size() <= context.control.configured_subjective_signature_length_limit(),
                        sig_variable_size_limit_exception, "signature variable length component size greater than subjective maximum");
 
-         auto check = fc::crypto::public_key( s, digest, false );
+         auto check = signature_recovery_cache::instance().recover( s, digest, false );
          EOS_ASSERT( check == p, crypto_api_exception, "Error expected key different than recovered key" );
       }
 
@@ -840,7 +1040,7 @@ class crypto_api : public context_aware_api {
                        sig_variable_size_limit_exception, "signature variable length component size greater than subjective maximum");
 
 
-         auto recovered = fc::crypto::public_key(s, digest, false);
+         auto recovered = signature_recovery_cache::instance().recover( s, digest, false );
 
          // the key types newer than the first 2 may be varible in length
          if (s.which() >= config::genesis_num_supported_key_types ) {
@@ -861,6 +1061,8 @@ class crypto_api : public context_aware_api {
          }
       }
 
+      // The fc encoders are OpenSSL's, which picks the SHA extensions (x86 SHA-NI, ARMv8 crypto) at runtime for
+      // sha1 and sha256. The crypto_*_encode_* cases of chain_benchmark measure this path with and without SHA-NI.
       template<class Encoder> auto encode(char* data, uint32_t datalen) {
          Encoder e;
          const size_t bs = eosio::chain::config::hashing_checktime_block_size;
@@ -1547,10 +1749,10 @@ class compiler_builtins : public context_aware_api {
       compiler_builtins( apply_context& ctx )
       :context_aware_api(ctx,true){}
 
+      // shifts by 128 bits or more give 0 except __ashrti3; the EOS VM OC compiler inlines these, keep it in sync
       void __ashlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         const unsigned __int128 i = ((unsigned __int128)high << 64) | low;
+         ret = shift >= 128 ? 0 : i << shift;
       }
 
       void __ashrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
@@ -1562,15 +1764,13 @@ class compiler_builtins : public context_aware_api {
       }
 
       void __lshlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         const unsigned __int128 i = ((unsigned __int128)high << 64) | low;
+         ret = shift >= 128 ? 0 : i << shift;
       }
 
       void __lshrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i >>= shift;
-         ret = (unsigned __int128)i;
+         const unsigned __int128 i = ((unsigned __int128)high << 64) | low;
+         ret = shift >= 128 ? 0 : i >> shift;
       }
 
       void __divti3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
@@ -1606,6 +1806,7 @@ class compiler_builtins : public context_aware_api {
          ret = lhs;
       }
 
+      // inlined by the EOS VM OC compiler as well
       void __multi3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
          __int128 lhs = ha;
          __int128 rhs = hb;
@@ -139,9 +139,14 @@ namespace LLVMJIT
 		llvm::MDNode* likelyFalseBranchWeights;
 		llvm::MDNode* likelyTrueBranchWeights;
 
-		EmitModuleContext(const Module& inModule)
+		Uptr beginFunctionDef;
+		Uptr endFunctionDef;
+
+		EmitModuleContext(const Module& inModule, Uptr inBeginFunctionDef, Uptr inEndFunctionDef)
 		: module(inModule)
 		, llvmModule(new llvm::Module("",context))
+		, beginFunctionDef(inBeginFunctionDef)
+		, endFunctionDef(std::min<Uptr>(inEndFunctionDef, inModule.functions.defs.size()))
 		{
 			auto zeroAsMetadata = llvm::ConstantAsMetadata::get(emitLiteral(I32(0)));
 			auto i32MaxAsMetadata = llvm::ConstantAsMetadata::get(emitLiteral(I32(INT32_MAX)));
@@ -682,6 +687,61 @@ namespace LLVMJIT
 		// Call operators
 		//
 
+		llvm::Value* emitImportedFunctionPointer(Uptr functionIndex,const FunctionType* calleeType)
+		{
+			llvm::Value* ic = irBuilder.CreateLoad( emitLiteralPointer((void*)(OFFSET_OF_FIRST_INTRINSIC-moduleContext.importedFunctionOffsets[functionIndex]*8), llvmI64Type->getPointerTo(256)) );
+			return irBuilder.CreateIntToPtr(ic, asLLVMType(calleeType)->getPointerTo());
+		}
+
+		// The 128-bit integer compiler builtins which LLVM's i128 operations compute exactly are emitted inline rather
+		// than as calls into the host; they must match compiler_builtins in wasm_interface.cpp, where shifts by 128 bits
+		// or more give 0. A null result pointer still calls the host, which rejects it like every other runtime does.
+		// Returns false, leaving the operand stack alone, for any other import.
+		bool emitInlineBuiltin(Uptr functionIndex,const std::string& name,const FunctionType* calleeType)
+		{
+			using VT = ValueType;
+			const bool isMul = name == "__multi3";
+			const bool isShift = name == "__ashlti3" || name == "__lshlti3" || name == "__lshrti3";
+			if(!isMul && !isShift) { return false; }
+			const std::vector<ValueType> expected = isMul ? std::vector<ValueType>{VT::i32,VT::i64,VT::i64,VT::i64,VT::i64}
+			                                              : std::vector<ValueType>{VT::i32,VT::i64,VT::i64,VT::i32};
+			if(calleeType->ret != ResultType::none || calleeType->parameters.size() != expected.size()) { return false; }
+			for(Uptr i = 0;i < expected.size();++i) { if(calleeType->parameters[i] != expected[i]) { return false; } }
+
+			llvm::Value* args[5];
+			popMultiple(args,expected.size());
+
+			auto nullBlock = llvm::BasicBlock::Create(context,"inlineBuiltinNull",llvmFunction);
+			auto inlineBlock = llvm::BasicBlock::Create(context,"inlineBuiltin",llvmFunction);
+			irBuilder.CreateCondBr(irBuilder.CreateICmpEQ(args[0],emitLiteral((U32)0)),nullBlock,inlineBlock,moduleContext.likelyFalseBranchWeights);
+
+			irBuilder.SetInsertPoint(nullBlock);
+			irBuilder.CreateCall(emitImportedFunctionPointer(functionIndex,calleeType),llvm::ArrayRef<llvm::Value*>(args,expected.size()));
+			irBuilder.CreateUnreachable();
+
+			irBuilder.SetInsertPoint(inlineBlock);
+
+			auto i128Type = llvm::Type::getInt128Ty(context);
+			auto joinHalves = [&](llvm::Value* low,llvm::Value* high) {
+				return irBuilder.CreateOr(irBuilder.CreateShl(irBuilder.CreateZExt(high,i128Type),64),irBuilder.CreateZExt(low,i128Type));
+			};
+			llvm::Value* result;
+			if(isMul) { result = irBuilder.CreateMul(joinHalves(args[1],args[2]),joinHalves(args[3],args[4])); }
+			else
+			{
+				auto value = joinHalves(args[1],args[2]);
+				auto shift = irBuilder.CreateZExt(args[3],i128Type);
+				auto shifted = name == "__lshrti3" ? irBuilder.CreateLShr(value,shift) : irBuilder.CreateShl(value,shift);
+				result = irBuilder.CreateSelect(irBuilder.CreateICmpUGE(args[3],emitLiteral((U32)128)),llvm::ConstantInt::get(i128Type,0),shifted);
+			}
+
+			// The result is written to linear memory like a store instruction would.
+			auto store = irBuilder.CreateStore(result,coerceByteIndexToPointer(args[0],0,i128Type));
+			store->setVolatile(true);
+			store->setAlignment(1);
+			return true;
+		}
+
 		void call(CallImm imm)
 		{
 			// Map the callee function index to either an imported function pointer or a function in this module.
@@ -690,9 +750,11 @@ namespace LLVMJIT
 			bool isExit = false;
 			if(imm.functionIndex < moduleContext.importedFunctionOffsets.size())
 			{
+				const auto& import = module.functions.imports[imm.functionIndex];
+				if(import.moduleName == "env" && emitInlineBuiltin(imm.functionIndex,import.exportName,module.types[import.type.index])) { return; }
+
 				calleeType = module.types[module.functions.imports[imm.functionIndex].type.index];
-				llvm::Value* ic = irBuilder.CreateLoad( emitLiteralPointer((void*)(OFFSET_OF_FIRST_INTRINSIC-moduleContext.importedFunctionOffsets[imm.functionIndex]*8), llvmI64Type->getPointerTo(256)) );
-				callee = irBuilder.CreateIntToPtr(ic, asLLVMType(calleeType)->getPointerTo());
+				callee = emitImportedFunctionPointer(imm.functionIndex,calleeType);
 				isExit = module.functions.imports[imm.functionIndex].moduleName == "env" && module.functions.imports[imm.functionIndex].exportName == "eosio_exit";
 			}
 			else
@@ -1277,16 +1339,20 @@ namespace LLVMJIT
 			auto llvmFunctionType = asLLVMType(module.types[module.functions.defs[functionDefIndex].type.index]);
 			auto externalName = getExternalFunctionName(functionDefIndex);
 			functionDefs[functionDefIndex] = llvm::Function::Create(llvmFunctionType,llvm::Function::ExternalLinkage,externalName,llvmModule);
+			// Functions defined by another partition are called directly rather than through the PLT, which the
+			// object loader would turn into a stub holding an absolute address.
+			if(functionDefIndex < beginFunctionDef || functionDefIndex >= endFunctionDef)
+				functionDefs[functionDefIndex]->setDSOLocal(true);
 		}
 
-		// Compile each function in the module.
-		for(Uptr functionDefIndex = 0;functionDefIndex < module.functions.defs.size();++functionDefIndex)
+		// Compile each function of the partition.
+		for(Uptr functionDefIndex = beginFunctionDef;functionDefIndex < endFunctionDef;++functionDefIndex)
 		{ EmitFunctionContext(*this,module,module.functions.defs[functionDefIndex],functionDefs[functionDefIndex]).emit(); }
 
 		return llvmModule;
 	}
 
-	llvm::Module* emitModule(const Module& module)
+	llvm::Module* emitModule(const Module& module, Uptr beginFunctionDef, Uptr endFunctionDef)
 	{
 		static bool inited;
 		if(!inited) {
@@ -1314,7 +1380,7 @@ namespace LLVMJIT
 			typedZeroConstants[(Uptr)ValueType::f64] = emitLiteral((F64)0.0);
 		}
 
-		return EmitModuleContext(module).emit();
+		return EmitModuleContext(module, beginFunctionDef, endFunctionDef).emit();
 	}
 }
 }}}
\ No newline at end of file
@@ -18,6 +18,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
@@ -26,6 +27,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "llvm/ExecutionEngine/Orc/Core.h"
 
 #include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/IRBuilder.h"
@@ -44,17 +46,27 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "llvm/Support/Host.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Vectorize.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Utils.h"
 #include <memory>
 
+#include <eosio/chain/webassembly/eos-vm-oc/ipc_helpers.hpp>
+
 #include <fc/io/datastream.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/reflect/typename.hpp>
 
 #include "llvm/Support/LEB128.h"
 
+#include <cerrno>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 #if LLVM_VERSION_MAJOR == 7
 namespace llvm { namespace orc {
 	using LegacyRTDyldObjectLinkingLayer = RTDyldObjectLinkingLayer;
@@ -105,10 +117,14 @@ namespace LLVMJIT
 {
 	llvm::TargetMachine* targetMachine = nullptr;
 
-	// Allocates memory for the LLVM object loader.
+	// Code larger than this is rejected
+	constexpr uintptr_t maxCodeBytes = 16u*1024u*1024u;
+
+	// Allocates memory for the LLVM object loader. When several objects are loaded, they are placed one after the
+	// other in a buffer reserved for all of them up front, so that the code stays one position independent block.
 	struct UnitMemoryManager : llvm::RTDyldMemoryManager
 	{
-		UnitMemoryManager() {}
+		UnitMemoryManager(uintptr_t reserve = 0) : reserve(reserve) {}
 		virtual ~UnitMemoryManager() override
 		{}
 
@@ -117,8 +133,13 @@ namespace LLVMJIT
 		
 		virtual bool needsToReserveAllocationSpace() override { return true; }
 		virtual void reserveAllocationSpace(uintptr_t numCodeBytes,U32 codeAlignment,uintptr_t numReadOnlyBytes,U32 readOnlyAlignment,uintptr_t numReadWriteBytes,U32 readWriteAlignment) override {
-			code = std::make_unique<std::vector<uint8_t>>(numCodeBytes + numReadOnlyBytes + numReadWriteBytes);
-			ptr = code->data();
+			const uintptr_t numBytes = numCodeBytes + numReadOnlyBytes + numReadWriteBytes;
+			if(!code) {
+				code = std::make_unique<std::vector<uint8_t>>(std::max(numBytes, reserve));
+				ptr = code->data();
+			}
+			else
+				WAVM_ASSERT_THROW(uintptr_t(code->data() + code->size() - ptr) >= numBytes);
 		}
 		virtual U8* allocateCodeSection(uintptr_t numBytes,U32 alignment,U32 sectionID,llvm::StringRef sectionName) override
 		{
@@ -143,6 +164,7 @@ namespace LLVMJIT
 			return true;
 		}
 
+		const uintptr_t reserve;
 		std::unique_ptr<std::vector<uint8_t>> code;
 		uint8_t* ptr;
 
@@ -164,6 +186,28 @@ namespace LLVMJIT
 		void operator=(const UnitMemoryManager&) = delete;
 	};
 
+	// Records the offset from base of each wasm function of a loaded object.
+	static void recordFunctionOffsets(const llvm::object::ObjectFile& Obj, const llvm::RuntimeDyld::LoadedObjectInfo& o, const uint8_t* base, std::map<unsigned, uintptr_t>& function_to_offsets)
+	{
+		for(auto symbolSizePair : llvm::object::computeSymbolSizes(Obj)) {
+			auto symbol = symbolSizePair.first;
+			auto name = symbol.getName();
+			auto address = symbol.getAddress();
+			if(symbol.getType() && symbol.getType().get() == llvm::object::SymbolRef::ST_Function && name && address) {
+				Uptr loadedAddress = Uptr(*address);
+				auto symbolSection = symbol.getSection();
+				if(symbolSection)
+					loadedAddress += (Uptr)o.getSectionLoadAddress(*symbolSection.get());
+				Uptr functionDefIndex;
+				if(getFunctionIndexFromExternalName(name->data(),functionDefIndex))
+					function_to_offsets[functionDefIndex] = loadedAddress-(uintptr_t)base;
+#if PRINT_DISASSEMBLY
+				disassembleFunction((U8*)loadedAddress, symbolSizePair.second);
+#endif
+			}
+		}
+	}
+
 	// The JIT compilation unit for a WebAssembly module instance.
 	struct JITModule
 	{
@@ -177,30 +221,14 @@ namespace LLVMJIT
 								  //nothing to do
 							  },
 							  [this](llvm::orc::VModuleKey, const llvm::object::ObjectFile &Obj, const llvm::RuntimeDyld::LoadedObjectInfo &o) {
-									for(auto symbolSizePair : llvm::object::computeSymbolSizes(Obj)) {
-										auto symbol = symbolSizePair.first;
-										auto name = symbol.getName();
-										auto address = symbol.getAddress();
-										if(symbol.getType() && symbol.getType().get() == llvm::object::SymbolRef::ST_Function && name && address) {
-											Uptr loadedAddress = Uptr(*address);
-											auto symbolSection = symbol.getSection();
-											if(symbolSection)
-												loadedAddress += (Uptr)o.getSectionLoadAddress(*symbolSection.get());
-											Uptr functionDefIndex;
-											if(getFunctionIndexFromExternalName(name->data(),functionDefIndex))
-												function_to_offsets[functionDefIndex] = loadedAddress-(uintptr_t)unitmemorymanager->code->data();
-#if PRINT_DISASSEMBLY
-											disassembleFunction((U8*)loadedAddress, symbolSizePair.second);
-#endif
-										}
-									}
+									recordFunctionOffsets(Obj, o, unitmemorymanager->code->data(), function_to_offsets);
 							  }
 							  );
 			objectLayer->setProcessAllSections(true);
 			compileLayer = llvm::make_unique<CompileLayer>(*objectLayer,llvm::orc::SimpleCompiler(*targetMachine));
 		}
 
-		void compile(llvm::Module* llvmModule);
+		void compile(llvm::Module* llvmModule, uint8_t opt_level);
 
 		std::shared_ptr<UnitMemoryManager> unitmemorymanager = std::make_shared<UnitMemoryManager>();
 
@@ -229,7 +257,8 @@ namespace LLVMJIT
 		///Log::printf(Log::Category::debug,"Dumped LLVM module to: %s\n",augmentedFilename.c_str());
 	}
 
-	void JITModule::compile(llvm::Module* llvmModule)
+	// Runs the optimization pipeline of opt_level on the module and sets the code generation level to match.
+	static void optimizeModule(llvm::Module* llvmModule, uint8_t opt_level)
 	{
 		// Get a target machine object for this host, and set the module to use its data layout.
 		llvmModule->setDataLayout(targetMachine->createDataLayout());
@@ -245,19 +274,59 @@ namespace LLVMJIT
 			///Log::printf(Log::Category::debug,"Verified LLVM module\n");
 		}
 
+		// Inline small wasm functions into their callers first so the function passes see through them. Every function
+		// keeps external linkage, so none is dropped and each one still gets its own symbol and stack size entry.
+		if(opt_level >= 2)
+		{
+			llvm::legacy::PassManager mpm;
+			mpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+			mpm.add(llvm::createPromoteMemoryToRegisterPass());
+			mpm.add(llvm::createFunctionInliningPass(2, 0, false));
+			mpm.run(*llvmModule);
+		}
+
 		auto fpm = new llvm::legacy::FunctionPassManager(llvmModule);
+		if(opt_level >= 2)
+			fpm->add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
 		fpm->add(llvm::createPromoteMemoryToRegisterPass());
 		fpm->add(llvm::createInstructionCombiningPass());
 		fpm->add(llvm::createCFGSimplificationPass());
 		fpm->add(llvm::createJumpThreadingPass());
 		fpm->add(llvm::createConstantPropagationPass());
+		if(opt_level >= 1)
+		{
+			fpm->add(llvm::createEarlyCSEPass());
+			fpm->add(llvm::createSCCPPass());
+			fpm->add(llvm::createReassociatePass());
+			fpm->add(llvm::createGVNPass());
+			fpm->add(llvm::createLICMPass());
+			fpm->add(llvm::createDeadStoreEliminationPass());
+			fpm->add(llvm::createInstructionCombiningPass());
+			fpm->add(llvm::createCFGSimplificationPass());
+		}
+		if(opt_level >= 2)
+		{
+			fpm->add(llvm::createLoopRotatePass());
+			fpm->add(llvm::createLoopUnrollPass(2));
+			fpm->add(llvm::createLoopVectorizePass());
+			fpm->add(llvm::createSLPVectorizerPass());
+			fpm->add(llvm::createInstructionCombiningPass());
+			fpm->add(llvm::createCFGSimplificationPass());
+		}
 		fpm->doInitialization();
 
 		for(auto functionIt = llvmModule->begin();functionIt != llvmModule->end();++functionIt)
 		{ fpm->run(*functionIt); }
 		delete fpm;
 
+		targetMachine->setOptLevel(opt_level >= 2 ? llvm::CodeGenOpt::Aggressive : llvm::CodeGenOpt::Default);
+
 		if(DUMP_OPTIMIZED_MODULE) { printModule(llvmModule,"llvmOptimizedDump"); }
+	}
+
+	void JITModule::compile(llvm::Module* llvmModule, uint8_t opt_level)
+	{
+		optimizeModule(llvmModule, opt_level);
 
 		llvm::orc::VModuleKey K = ES.allocateVModule();
 		std::unique_ptr<llvm::Module> mod(llvmModule);
@@ -267,7 +336,92 @@ namespace LLVMJIT
 		final_pic_code = std::move(*unitmemorymanager->code);
 	}
 
-	instantiated_code instantiateModule(const IR::Module& module)
+	// Fewest bytes of function code worth compiling in a partition of its own.
+	constexpr size_t minPartitionCodeBytes = 64u*1024u;
+
+	// Splits the function definitions into at most partitions contiguous ranges holding about as much code each,
+	// returned as the index each range ends at.
+	static std::vector<Uptr> partitionFunctionDefs(const IR::Module& module, unsigned partitions)
+	{
+		size_t totalBytes = 0;
+		for(const IR::FunctionDef& def : module.functions.defs)
+			totalBytes += def.code.size();
+		partitions = std::max<size_t>(1u, std::min<size_t>(partitions, totalBytes / minPartitionCodeBytes));
+
+		std::vector<Uptr> ends;
+		size_t bytes = 0;
+		for(Uptr functionDefIndex = 0;functionDefIndex < module.functions.defs.size();++functionDefIndex) {
+			bytes += module.functions.defs[functionDefIndex].code.size();
+			if(ends.size() + 1 < partitions && functionDefIndex + 1 < module.functions.defs.size() && bytes * partitions >= totalBytes * (ends.size() + 1))
+				ends.push_back(functionDefIndex + 1);
+		}
+		ends.push_back(module.functions.defs.size());
+		return ends;
+	}
+
+	// Compiles each partition in a process of its own, since the IR emitter keeps its LLVM context and types in
+	// globals, and loads the resulting objects one after the other into a single buffer. Calls to functions of other
+	// partitions are direct calls to dso_local declarations, which the object loader resolves PC-relative like the
+	// calls within a partition. Inlining at opt_level 2 only sees the functions of the same partition.
+	static std::unique_ptr<UnitMemoryManager> compilePartitions(const IR::Module& module, uint8_t opt_level, const std::vector<Uptr>& ends, std::map<unsigned, uintptr_t>& function_to_offsets)
+	{
+		std::vector<std::pair<pid_t, wrapped_fd>> jobs;
+		Uptr begin = 0;
+		for(Uptr end : ends) {
+			wrapped_fd object = memfd_for_bytearray(std::vector<uint8_t>());
+			pid_t pid = fork();
+			if(pid == 0) {
+				llvm::Module* llvmModule = emitModule(module, begin, end);
+				optimizeModule(llvmModule, opt_level);
+				auto buffer = llvm::orc::SimpleCompiler(*targetMachine)(*llvmModule);
+				const char* p = buffer->getBufferStart();
+				size_t left = buffer->getBufferSize();
+				while(left) {
+					ssize_t wrote = write(object, p, left);
+					if(wrote == -1 && errno == EINTR)
+						continue;
+					if(wrote <= 0)
+						_exit(1);
+					p += wrote;
+					left -= wrote;
+				}
+				_exit(0);
+			}
+			WAVM_ASSERT_THROW(pid != -1);
+			jobs.emplace_back(pid, std::move(object));
+			begin = end;
+		}
+
+		bool failed = false;
+		for(const auto& job : jobs) {
+			int status;
+			pid_t r;
+			do {
+				r = waitpid(job.first, &status, 0);
+			} while(r == -1 && errno == EINTR);
+			failed |= r == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+		}
+		WAVM_ASSERT_THROW(!failed);
+
+		auto memoryManager = std::make_unique<UnitMemoryManager>(maxCodeBytes);
+		llvm::orc::NullLegacyResolver resolver;
+		llvm::RuntimeDyld dyld(*memoryManager, resolver);
+		dyld.setProcessAllSections(true);
+		for(const auto& job : jobs) {
+			std::vector<uint8_t> bytes = vector_for_memfd(job.second);
+			auto buffer = llvm::MemoryBuffer::getMemBuffer(llvm::StringRef((const char*)bytes.data(), bytes.size()), "", false);
+			auto obj = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+			WAVM_ASSERT_THROW(obj);
+			auto info = dyld.loadObject(**obj);
+			WAVM_ASSERT_THROW(info && !dyld.hasError());
+			recordFunctionOffsets(**obj, *info, memoryManager->code->data(), function_to_offsets);
+		}
+		dyld.finalizeWithMemoryManagerLocking();
+		WAVM_ASSERT_THROW(!dyld.hasError());
+		return memoryManager;
+	}
+
+	instantiated_code instantiateModule(const IR::Module& module, uint8_t opt_level, unsigned partitions)
 	{
 		static bool inited;
 		if(!inited) {
@@ -288,16 +442,29 @@ namespace LLVMJIT
 				);
 		}
 
-		// Emit LLVM IR for the module.
-		auto llvmModule = emitModule(module);
-
-		// Construct the JIT compilation pipeline for this module.
-		auto jitModule = new JITModule();
-		// Compile the module.
-		jitModule->compile(llvmModule);
+		instantiated_code ret;
+		std::shared_ptr<UnitMemoryManager> unitmemorymanager;
+		const std::vector<Uptr> ends = partitionFunctionDefs(module, partitions);
+		if(ends.size() > 1) {
+			unitmemorymanager = compilePartitions(module, opt_level, ends, ret.function_offsets);
+			ret.code = std::move(*unitmemorymanager->code);
+		}
+		else {
+			// Emit LLVM IR for the module.
+			auto llvmModule = emitModule(module);
+
+			// Construct the JIT compilation pipeline for this module.
+			auto jitModule = new JITModule();
+			// Compile the module.
+			jitModule->compile(llvmModule, opt_level);
+
+			unitmemorymanager = jitModule->unitmemorymanager;
+			ret.code = jitModule->final_pic_code;
+			ret.function_offsets = jitModule->function_to_offsets;
+		}
 
 		unsigned num_functions_stack_size_found = 0;
-		for(const auto& stacksizes : jitModule->unitmemorymanager->stack_sizes) {
+		for(const auto& stacksizes : unitmemorymanager->stack_sizes) {
 			fc::datastream<const unsigned char*> ds(stacksizes.data(), stacksizes.size());
 			while(ds.remaining()) {
 				uint64_t funcaddr;
@@ -312,12 +479,9 @@ namespace LLVMJIT
 		}
 		if(num_functions_stack_size_found != module.functions.defs.size())
 			_exit(1);
-		if(jitModule->final_pic_code.size() >= 16u*1024u*1024u)
+		if(ret.code.size() >= maxCodeBytes)
 			_exit(1);
 
-		instantiated_code ret;
-		ret.code = jitModule->final_pic_code;
-		ret.function_offsets = jitModule->function_to_offsets;
 		return ret;
 	}
 }
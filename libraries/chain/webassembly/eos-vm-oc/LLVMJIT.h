@@ -19,7 +19,9 @@ struct instantiated_code {
 
 namespace LLVMJIT {
    bool getFunctionIndexFromExternalName(const char* externalName,Uptr& outFunctionDefIndex);
-   llvm::Module* emitModule(const IR::Module& module);
-   instantiated_code instantiateModule(const IR::Module& module);
+   /// defines the functions of [beginFunctionDef, endFunctionDef), the others are only declared
+   llvm::Module* emitModule(const IR::Module& module, Uptr beginFunctionDef = 0, Uptr endFunctionDef = UINTPTR_MAX);
+   /// compiles the functions in up to partitions processes in parallel, large enough modules only
+   instantiated_code instantiateModule(const IR::Module& module, uint8_t opt_level, unsigned partitions = 1);
 }
 }}}
\ No newline at end of file
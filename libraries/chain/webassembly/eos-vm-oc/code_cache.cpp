@@ -9,7 +9,13 @@
 #include <eosio/chain/webassembly/eos-vm-oc/compile_monitor.hpp>
 #include <eosio/chain/exceptions.hpp>
 
+#include <fc/io/fstream.hpp>
+#include <fc/scoped_exit.hpp>
+
+#include <algorithm>
+
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <linux/memfd.h>
@@ -19,6 +25,9 @@
 #include "WASM/WASM.h"
 #include "LLVMJIT.h"
 
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Host.h"
+
 using namespace IR;
 using namespace Runtime;
 
@@ -42,10 +51,15 @@ static_assert(sizeof(code_cache_header) <= header_size, "code_cache_header too b
 code_cache_async::code_cache_async(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
    code_cache_base(data_dir, eosvmoc_config, db),
    _result_queue(eosvmoc_config.threads * 2),
-   _threads(eosvmoc_config.threads)
+   _threads(eosvmoc_config.threads),
+   _hot_codes_path(data_dir/"hot_codes.bin"),
+   _warm_up_codes(eosvmoc_config.warm_up_codes)
 {
    FC_ASSERT(_threads, "EOS VM OC requires at least 1 compile thread");
 
+   if(_mode == cache_mode::shared_reader)
+      return;
+
    wait_on_compile_monitor_message();
 
    _monitor_reply_thread = std::thread([this]() {
@@ -55,6 +69,11 @@ code_cache_async::code_cache_async(const bfs::path data_dir, const eosvmoc::conf
 }
 
 code_cache_async::~code_cache_async() {
+   try {
+      save_hot_codes();
+   } FC_LOG_AND_DROP()
+   if(_mode == cache_mode::shared_reader)
+      return;
    _compile_monitor_write_socket.shutdown(local::datagram_protocol::socket::shutdown_send);
    _monitor_reply_thread.join();
    consume_compile_thread_queue();
@@ -85,16 +104,45 @@ void code_cache_async::wait_on_compile_monitor_message() {
 std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
    size_t bytes_remaining = 0;
    size_t gotsome = _result_queue.consume_all([&](const wasm_compilation_result_message& result) {
+      const bool warm_up = _warm_up_pending.erase(result.code);
+      if(warm_up && (_outstanding_compiles_and_poison[result.code] || !result.result.contains<code_descriptor>()))
+         ++_warm_up_status.failed;
+      else if(warm_up)
+         ++_warm_up_status.compiled;
+      if(warm_up && _warm_up_pending.empty())
+         ilog("EOS VM OC warm-up done: ${c} of ${t} hot codes compiled", ("c", _warm_up_status.compiled)("t", _warm_up_status.total));
+
       if(_outstanding_compiles_and_poison[result.code] == false) {
+         const bool hot_recompile = result.opt_level != _opt_level;
          result.result.visit(overloaded {
             [&](const code_descriptor& cd) {
+               //a hot recompile replaces the code compiled at the lower tier
+               auto& by_hash_index = _cache_index.get<by_hash>();
+               auto existing = by_hash_index.find(boost::make_tuple(cd.code_hash, cd.vm_version));
+               if(existing != by_hash_index.end()) {
+                  if(_mode != cache_mode::shared_writer)
+                     write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*existing} });
+                  by_hash_index.erase(existing);
+               }
                _cache_index.push_front(cd);
+               _shared_index_changed = true;
             },
             [&](const compilation_result_unknownfailure&) {
+               //the code compiled at the lower tier keeps running
+               if(hot_recompile) {
+                  wlog("code ${c} failed to recompile at EOS VM OC optimization tier ${t}", ("c", result.code.code_id)("t", result.opt_level));
+                  return;
+               }
                wlog("code ${c} failed to tier-up with EOS VM OC", ("c", result.code.code_id));
                _blacklist.emplace(result.code);
             },
             [&](const compilation_result_toofull&) {
+               //a shared cache never evicts, so the code has to keep running in the interpreter
+               if(_mode == cache_mode::shared_writer) {
+                  wlog("shared EOS VM OC code cache is full; code ${c} is not compiled", ("c", result.code.code_id));
+                  _blacklist.emplace(result.code);
+                  return;
+               }
                run_eviction_round();
             }
          });
@@ -106,7 +154,7 @@ std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
    return {gotsome, bytes_remaining};
 }
 
-const code_descriptor* const code_cache_async::get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version) {
+void code_cache_async::process_finished_compiles() {
    //if there are any outstanding compiles, process the result queue now
    if(_outstanding_compiles_and_poison.size()) {
       auto [count_processed, bytes_remaining] = consume_compile_thread_queue();
@@ -114,43 +162,62 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
       if(count_processed)
          check_eviction_threshold(bytes_remaining);
 
-      while(count_processed && _queued_compiles.size()) {
-         auto nextup = _queued_compiles.begin();
+      while(count_processed && !_queued_compiles.empty()) {
+         const code_tuple nextup = _queued_compiles.front();
 
          //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
          // if we got notification of it no longer existing we would have removed it from queued_compiles
-         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->code_id, 0, nextup->vm_version));
+         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup.code_id, 0, nextup.vm_version));
          if(codeobject) {
-            _outstanding_compiles_and_poison.emplace(*nextup, false);
+            _outstanding_compiles_and_poison.emplace(nextup, false);
             std::vector<wrapped_fd> fds_to_pass;
             fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ *nextup }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ nextup, _opt_level, compile_partitions() }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
             --count_processed;
          }
-         _queued_compiles.erase(nextup);
+         _queued_compiles.pop_front();
       }
    }
 
+   if(_shared_index_changed)
+      publish_shared_index();
+}
+
+const code_descriptor* const code_cache_async::get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version) {
+   if(_mode == cache_mode::shared_reader) {
+      reload_shared_index();
+      auto it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
+      if(it == _cache_index.get<by_hash>().end())
+         return nullptr;
+      return &*it;
+   }
+
+   process_finished_compiles();
+
+   const code_tuple ct = code_tuple{code_id, vm_version};
+   if(_warm_up_codes)
+      ++_execution_counts[ct];
+
    //check for entry in cache
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
       _cache_index.relocate(_cache_index.begin(), _cache_index.project<0>(it));
+      if(_hot_opt_level > _opt_level)
+         count_hot_execution(ct);
       return &*it;
    }
 
-   const code_tuple ct = code_tuple{code_id, vm_version};
-
    if(_blacklist.find(ct) != _blacklist.end())
       return nullptr;
    if(auto it = _outstanding_compiles_and_poison.find(ct); it != _outstanding_compiles_and_poison.end()) {
       it->second = false;
       return nullptr;
    }
-   if(_queued_compiles.find(ct) != _queued_compiles.end())
+   if(_queued_compiles.contains(ct))
       return nullptr;
 
    if(_outstanding_compiles_and_poison.size() >= _threads) {
-      _queued_compiles.emplace(ct);
+      _queued_compiles.push(ct);
       return nullptr;
    }
 
@@ -161,10 +228,214 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
    _outstanding_compiles_and_poison.emplace(ct, false);
    std::vector<wrapped_fd> fds_to_pass;
    fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass);
+   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct, _opt_level, compile_partitions() }, fds_to_pass);
    return nullptr;
 }
 
+//compile threads left idle by the outstanding compiles, the one being started included, are lent to it for compiling
+// the functions of a large module in parallel. Compiles started later still get their own thread, so the budget is
+// only exceeded until the lending compile finishes
+uint32_t code_cache_async::compile_partitions() const {
+   return 1u + (_threads - std::min(_threads, _outstanding_compiles_and_poison.size()));
+}
+
+//recompiles at the hot tier once, in the background; the code compiled at the lower tier runs meanwhile
+void code_cache_async::count_hot_execution(const code_tuple& ct) {
+   if(_hot_recompiled.count(ct) || _outstanding_compiles_and_poison.count(ct))
+      return;
+   if(++_hot_executions[ct] < _hot_recompile_executions)
+      return;
+   //compile threads are for code still running in the interpreter first; try again on the next execution
+   if(_outstanding_compiles_and_poison.size() >= _threads || !_queued_compiles.empty())
+      return;
+
+   const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(ct.code_id, 0, ct.vm_version));
+   if(!codeobject)
+      return;
+
+   _hot_executions.erase(ct);
+   _hot_recompiled.emplace(ct);
+   _outstanding_compiles_and_poison.emplace(ct, false);
+   std::vector<wrapped_fd> fds_to_pass;
+   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
+   FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct, _hot_opt_level, compile_partitions() }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+}
+
+void code_cache_async::record_interpreted_execution(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& elapsed) {
+   _queued_compiles.record_interpreted_execution(code_tuple{code_id, vm_version}, elapsed);
+}
+
+void code_cache_async::start_warm_up() {
+   if(!_warm_up_codes || _mode == cache_mode::shared_reader || !bfs::exists(_hot_codes_path))
+      return;
+   try {
+      _previous_hot_codes = read_hot_codes(_hot_codes_path, _warm_up_codes);
+   } catch(const fc::exception& e) {
+      wlog("unable to read EOS VM OC hot codes from ${f}: ${e}", ("f", _hot_codes_path.generic_string())("e", e.to_detail_string()));
+      _previous_hot_codes.clear();
+      return;
+   }
+
+   //queued in order, ties in the hotness queue keep insertion order so the hottest code is compiled first
+   for(const code_tuple& ct : _previous_hot_codes) {
+      if(_warm_up_pending.count(ct) || _blacklist.count(ct))
+         continue;
+      if(_cache_index.get<by_hash>().find(boost::make_tuple(ct.code_id, ct.vm_version)) != _cache_index.get<by_hash>().end()) {
+         ++_warm_up_status.total;
+         ++_warm_up_status.compiled;
+         continue;
+      }
+      const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(ct.code_id, 0, ct.vm_version));
+      if(!codeobject) //replaced since the hot codes were recorded
+         continue;
+      ++_warm_up_status.total;
+      _warm_up_pending.emplace(ct);
+      if(_outstanding_compiles_and_poison.count(ct) || _queued_compiles.contains(ct))
+         continue;
+      if(_outstanding_compiles_and_poison.size() >= _threads) {
+         _queued_compiles.push(ct);
+         continue;
+      }
+      _outstanding_compiles_and_poison.emplace(ct, false);
+      std::vector<wrapped_fd> fds_to_pass;
+      fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
+      FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct, _opt_level, compile_partitions() }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+   }
+   ilog("EOS VM OC warm-up: ${p} of ${t} hot codes to compile", ("p", _warm_up_pending.size())("t", _warm_up_status.total));
+}
+
+bool code_cache_async::import_code(const code_artifact& artifact) {
+   EOS_ASSERT(_mode != cache_mode::shared_reader, misc_exception, "a shared_reader EOS VM OC code cache compiles nothing and imports nothing");
+   EOS_ASSERT(artifact.format == code_artifact::current_format, wasm_serialization_error, "unsupported EOS VM OC code artifact format ${f}", ("f", artifact.format));
+   EOS_ASSERT(artifact.checksum == artifact.compute_checksum(), wasm_serialization_error, "EOS VM OC code artifact is damaged");
+   const std::string target = code_artifact_target();
+   EOS_ASSERT(artifact.target == target, wasm_serialization_error, "EOS VM OC code artifact was compiled for ${a}, this node needs ${t}",
+              ("a", artifact.target)("t", target));
+   EOS_ASSERT(_db.find<code_object,by_code_hash>(boost::make_tuple(artifact.code.code_id, 0, artifact.code.vm_version)), wasm_serialization_error,
+              "EOS VM OC code artifact is for code ${c} which is not on chain", ("c", artifact.code.code_id));
+   const size_t code_size = artifact.machine_code.size();
+   EOS_ASSERT(code_size && code_size < 16u*1024u*1024u && artifact.apply_offset < code_size, wasm_serialization_error, "EOS VM OC code artifact has invalid code");
+   if(artifact.start.contains<code_offset>())
+      EOS_ASSERT(artifact.start.get<code_offset>().offset < code_size, wasm_serialization_error, "EOS VM OC code artifact has invalid start function");
+   EOS_ASSERT(artifact.initdata_prologue_size <= artifact.initdata.size() && artifact.initdata_prologue_size <= memory::cb_offset,
+              wasm_serialization_error, "EOS VM OC code artifact has invalid initial memory");
+   EOS_ASSERT(artifact.starting_memory_pages <= (int)(wasm_constraints::maximum_linear_memory/wasm_constraints::wasm_page_size),
+              wasm_serialization_error, "EOS VM OC code artifact has invalid initial memory");
+
+   const code_tuple& ct = artifact.code;
+   if(_cache_index.get<by_hash>().find(boost::make_tuple(ct.code_id, ct.vm_version)) != _cache_index.get<by_hash>().end() ||
+      _outstanding_compiles_and_poison.count(ct))
+      return false;
+   _queued_compiles.erase(ct);
+   _blacklist.erase(ct);
+
+   _outstanding_compiles_and_poison.emplace(ct, false);
+   std::vector<wrapped_fd> fds_to_pass;
+   fds_to_pass.emplace_back(memfd_for_bytearray(artifact.machine_code));
+   fds_to_pass.emplace_back(memfd_for_bytearray(artifact.initdata));
+   code_compilation_result_message compiled{artifact.start, artifact.apply_offset, artifact.starting_memory_pages, artifact.initdata_prologue_size};
+   FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, import_code_message{ ct, compiled, _opt_level }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+   return true;
+}
+
+const warm_up_status& code_cache_async::get_warm_up_status() {
+   process_finished_compiles();
+   return _warm_up_status;
+}
+
+void code_cache_async::save_hot_codes() {
+   if(!_warm_up_codes)
+      return;
+   write_hot_codes(_hot_codes_path, rank_hot_codes(_execution_counts, _previous_hot_codes, _warm_up_codes));
+}
+
+//the previous run's list keeps short runs from forgetting it
+std::vector<code_tuple> rank_hot_codes(const std::unordered_map<code_tuple, uint64_t>& execution_counts,
+                                       const std::vector<code_tuple>& previous_hot_codes, uint32_t max_codes) {
+   std::vector<std::pair<uint64_t, code_tuple>> counted;
+   counted.reserve(execution_counts.size());
+   for(const auto& [ct, count] : execution_counts)
+      counted.emplace_back(count, ct);
+   const size_t top = std::min<size_t>(counted.size(), max_codes);
+   std::partial_sort(counted.begin(), counted.begin() + top, counted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+   std::vector<code_tuple> hot_codes;
+   for(size_t i = 0; i < top; ++i)
+      hot_codes.push_back(counted[i].second);
+   for(const code_tuple& ct : previous_hot_codes) {
+      if(hot_codes.size() >= max_codes)
+         break;
+      if(!execution_counts.count(ct))
+         hot_codes.push_back(ct);
+   }
+   return hot_codes;
+}
+
+void write_hot_codes(const bfs::path& path, const std::vector<code_tuple>& hot_codes) {
+   const auto data = fc::raw::pack(hot_codes);
+   std::ofstream ofs(path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+   ofs.write(data.data(), data.size());
+   EOS_ASSERT(ofs.good(), database_exception, "unable to write EOS VM OC hot codes");
+}
+
+std::vector<code_tuple> read_hot_codes(const bfs::path& path, uint32_t max_codes) {
+   std::vector<code_tuple> hot_codes;
+   std::string data;
+   fc::read_file_contents(path, data);
+   fc::datastream<const char*> ds(data.data(), data.size());
+   fc::raw::unpack(ds, hot_codes);
+   if(hot_codes.size() > max_codes)
+      hot_codes.resize(max_codes);
+   return hot_codes;
+}
+
+void code_cache_async::reload_shared_index() {
+   const fc::time_point now = fc::time_point::now();
+   if(_shared_cache_replaced || now < _next_shared_index_check)
+      return;
+   _next_shared_index_check = now + fc::milliseconds(500);
+
+   //executors mapped the cache file as it was when it was opened; offsets into a recreated or grown file are useless
+   struct stat cache_st, opened_st;
+   if(stat(_cache_file_path.generic_string().c_str(), &cache_st) || fstat(_cache_fd, &opened_st) ||
+      cache_st.st_ino != opened_st.st_ino || (size_t)opened_st.st_size != _shared_cache_size) {
+      wlog("shared EOS VM OC code cache was recreated or resized by the writing process; restart to use it again");
+      _shared_cache_replaced = true;
+      _cache_index.clear();
+      return;
+   }
+
+   //the writer replaces the index by renaming a new file over it, so a new inode means a new index
+   struct stat index_st;
+   if(stat(_shared_index_path.generic_string().c_str(), &index_st) || index_st.st_ino == _shared_index_ino)
+      return;
+
+   std::vector<code_descriptor> index;
+   try {
+      std::string data;
+      fc::read_file_contents(_shared_index_path, data);
+      fc::datastream<const char*> ds(data.data(), data.size());
+      fc::raw::unpack(ds, index);
+   } catch(const fc::exception& e) {
+      wlog("unable to read shared EOS VM OC code cache index ${f}: ${e}", ("f", _shared_index_path.generic_string())("e", e.to_detail_string()));
+      return;
+   }
+   _shared_index_ino = index_st.st_ino;
+
+   _cache_index.clear();
+   for(code_descriptor& cd : index) {
+      if(cd.codegen_version != 0 || cd.code_begin >= _shared_cache_size || cd.initdata_begin + cd.initdata_size > _shared_cache_size)
+         continue;
+      _cache_index.push_back(std::move(cd));
+   }
+}
+
+code_cache_sync::code_cache_sync(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
+   code_cache_base(data_dir, eosvmoc_config, db)
+{
+   EOS_ASSERT(_mode != cache_mode::shared_reader, misc_exception, "a shared read-only EOS VM OC code cache requires EOS VM OC in tier-up mode");
+}
+
 code_cache_sync::~code_cache_sync() {
    //it's exceedingly critical that we wait for the compile monitor to be done with all its work
    //This is easy in the sync case
@@ -189,7 +460,7 @@ const code_descriptor* const code_cache_sync::get_descriptor_for_code_sync(const
    std::vector<wrapped_fd> fds_to_pass;
    fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
 
-   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ {code_id, vm_version} }, fds_to_pass);
+   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ {code_id, vm_version}, _opt_level }, fds_to_pass);
    auto [success, message, fds] = read_message_with_fds(_compile_monitor_read_socket);
    EOS_ASSERT(success, wasm_execution_error, "failed to read response from monitor process");
    EOS_ASSERT(message.contains<wasm_compilation_result_message>(), wasm_execution_error, "unexpected response from monitor process");
@@ -204,11 +475,35 @@ const code_descriptor* const code_cache_sync::get_descriptor_for_code_sync(const
 
 code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
    _db(db),
-   _cache_file_path(data_dir/"code_cache.bin")
+   _cache_file_path((eosvmoc_config.cache_dir.empty() ? data_dir : eosvmoc_config.cache_dir)/"code_cache.bin"),
+   _opt_level(eosvmoc_config.opt_level),
+   _hot_opt_level(eosvmoc_config.hot_opt_level),
+   _hot_recompile_executions(eosvmoc_config.hot_recompile_executions),
+   _mode(eosvmoc_config.mode),
+   _shared_index_path(_cache_file_path.parent_path()/"code_cache.index")
 {
+   EOS_ASSERT(_opt_level <= max_opt_level && _hot_opt_level <= max_opt_level, misc_exception, "invalid EOS VM OC optimization tier");
+
    static_assert(sizeof(allocator_t) <= header_offset, "header offset intersects with allocator");
 
-   bfs::create_directories(data_dir);
+   if(_mode == cache_mode::shared_reader) {
+      //the writing process owns the file: its header, allocator and compile monitor are left alone
+      EOS_ASSERT(bfs::exists(_cache_file_path), database_exception, "shared EOS VM OC code cache ${f} does not exist, start the writing process first",
+                 ("f", _cache_file_path.generic_string()));
+      _cache_fd = ::open(_cache_file_path.generic_string().c_str(), O_RDONLY | O_CLOEXEC);
+      EOS_ASSERT(_cache_fd >= 0, database_exception, "failure to open shared code cache");
+      struct stat st;
+      EOS_ASSERT(fstat(_cache_fd, &st) == 0, database_exception, "failure to stat shared code cache");
+      _shared_cache_size = st.st_size;
+      EOS_ASSERT(_shared_cache_size >= total_header_size, bad_database_version_exception, "shared code cache is too small");
+      code_cache_header cache_header;
+      EOS_ASSERT(pread(_cache_fd, &cache_header, sizeof(cache_header), header_offset) == sizeof(cache_header), database_exception, "failed to read code cache header");
+      EOS_ASSERT(cache_header.id == header_id, bad_database_version_exception, "existing EOS VM OC code cache not compatible with this version");
+      _free_bytes_eviction_threshold = 0;
+      return;
+   }
+
+   bfs::create_directories(_cache_file_path.parent_path());
 
    if(!bfs::exists(_cache_file_path)) {
       EOS_ASSERT(eosvmoc_config.cache_size >= allocator_t::get_min_size(total_header_size), database_exception, "configured code cache size is too small");
@@ -281,6 +576,27 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
    int duped = dup(compile_monitor_conn);
    _compile_monitor_write_socket.assign(local::datagram_protocol(), duped);
    _compile_monitor_read_socket.assign(local::datagram_protocol(), compile_monitor_conn.release());
+
+   publish_shared_index();
+}
+
+//written to a temporary file and renamed over the previous index so readers never see a partial one
+void code_cache_base::publish_shared_index() {
+   _shared_index_changed = false;
+   if(_mode != cache_mode::shared_writer)
+      return;
+   const std::vector<code_descriptor> index(_cache_index.begin(), _cache_index.end());
+   const auto data = fc::raw::pack(index);
+   const bfs::path tmp_path = _shared_index_path.generic_string() + ".tmp";
+   {
+      std::ofstream ofs(tmp_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+      ofs.write(data.data(), data.size());
+      if(!ofs.good()) {
+         elog("unable to write shared EOS VM OC code cache index ${f}", ("f", tmp_path.generic_string()));
+         return;
+      }
+   }
+   bfs::rename(tmp_path, _shared_index_path);
 }
 
 void code_cache_base::set_on_disk_region_dirty(bool dirty) {
@@ -301,6 +617,11 @@ void code_cache_base::serialize_cache_index(fc::datastream<T>& ds) {
 }
 
 code_cache_base::~code_cache_base() {
+   if(_mode == cache_mode::shared_reader) {
+      close(_cache_fd);
+      return;
+   }
+
    //reopen the code cache in our process
    struct stat st;
    if(fstat(_cache_fd, &st))
@@ -345,17 +666,32 @@ code_cache_base::~code_cache_base() {
    close(_cache_fd);
    set_on_disk_region_dirty(false);
 
+   try {
+      publish_shared_index();
+   } FC_LOG_AND_DROP()
+
 }
 
 void code_cache_base::free_code(const digest_type& code_id, const uint8_t& vm_version) {
+   //the writing process drops the code from the index it publishes
+   if(_mode == cache_mode::shared_reader)
+      return;
+
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
-      write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*it} });
+      //readers of a shared cache may still be running the code
+      if(_mode != cache_mode::shared_writer)
+         write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*it} });
       _cache_index.get<by_hash>().erase(it);
+      _shared_index_changed = true;
    }
 
+   _hot_executions.erase(code_tuple{code_id, vm_version});
+   _hot_recompiled.erase(code_tuple{code_id, vm_version});
+
    //if it's in the queued list, erase it
-   _queued_compiles.erase({code_id, vm_version});
+   if(_queued_compiles.erase(code_tuple{code_id, vm_version}) && _warm_up_pending.erase(code_tuple{code_id, vm_version}))
+      ++_warm_up_status.failed;
 
    //however, if it's currently being compiled there is no way to cancel the compile,
    //so instead set a poison boolean that indicates not to insert the code in to the cache
@@ -365,7 +701,51 @@ void code_cache_base::free_code(const digest_type& code_id, const uint8_t& vm_ve
       compiling_it->second = true;
 }
 
+fc::optional<code_artifact> code_cache_base::export_code(const digest_type& code_id, const uint8_t& vm_version) {
+   auto it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
+   if(it == _cache_index.get<by_hash>().end())
+      return {};
+
+   struct stat st;
+   EOS_ASSERT(fstat(_cache_fd, &st) == 0, database_exception, "failure to stat code cache");
+   char* code_mapping = (char*)mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, _cache_fd, 0);
+   EOS_ASSERT(code_mapping != MAP_FAILED, database_exception, "failure to mmap code cache");
+   auto unmap = fc::make_scoped_exit([&]() { munmap(code_mapping, st.st_size); });
+
+   //the size of the code is not recorded, its allocation is at most a few bytes larger
+   const allocator_t* allocator = reinterpret_cast<const allocator_t*>(code_mapping);
+   const char* code = code_mapping + it->code_begin;
+   const char* initdata = code_mapping + it->initdata_begin;
+
+   code_artifact artifact;
+   artifact.target = code_artifact_target();
+   artifact.code = code_tuple{it->code_hash, it->vm_version};
+   artifact.start = it->start;
+   artifact.apply_offset = it->apply_offset;
+   artifact.starting_memory_pages = it->starting_memory_pages;
+   artifact.initdata_prologue_size = it->initdata_prologue_size;
+   artifact.machine_code.assign(code, code + allocator->size(code));
+   artifact.initdata.assign(initdata, initdata + it->initdata_size);
+   artifact.checksum = artifact.compute_checksum();
+   return artifact;
+}
+
+std::string code_artifact_target() {
+   //the generated code hardcodes the intrinsic ordinals and the layout of the memory before the linear memory
+   fc::sha256::encoder enc;
+   for(const auto& [name, entry] : get_intrinsic_map()) {
+      fc::raw::pack(enc, name);
+      fc::raw::pack(enc, (uint64_t)entry.ordinal);
+   }
+   fc::raw::pack(enc, (uint64_t)memory::cb_offset);
+   fc::raw::pack(enc, (uint64_t)memory::memory_prologue_size);
+   fc::raw::pack(enc, (uint64_t)sizeof(control_block));
+   return std::string("llvm-") + LLVM_VERSION_STRING + " " + llvm::sys::getProcessTriple() + " " + enc.result().str().substr(0, 16);
+}
+
 void code_cache_base::run_eviction_round() {
+   if(_mode == cache_mode::shared_writer)
+      return;
    evict_wasms_message evict_msg;
    for(unsigned int i = 0; i < 25 && _cache_index.size() > 1; ++i) {
       evict_msg.codes.emplace_back(_cache_index.back());
@@ -8,10 +8,13 @@
 #include <eosio/chain/webassembly/eos-vm-oc/code_cache.hpp>
 
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <boost/asio/local/datagram_protocol.hpp>
 #include <boost/signals2.hpp>
 
+#include <fstream>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 using namespace boost::asio;
@@ -72,7 +75,16 @@ struct compile_monitor_session {
                   connection_dead_signal();
                   return;
                }
-               kick_compile_off(compile.code, std::move(fds[0]));
+               kick_compile_off(compile, std::move(fds[0]));
+            },
+            [&, &fds=fds](const import_code_message& import) {
+               if(fds.size() != 2) {
+                  connection_dead_signal();
+                  return;
+               }
+               wasm_compilation_result_message reply{import.code, compilation_result_unknownfailure{}, _allocator->get_free_memory(), import.opt_level};
+               reply.result = store_code(import.code, import.compiled, fds);
+               write_message_with_fds(_nodeos_instance_socket, reply);
             },
             [&](const evict_wasms_message& evict) {
                for(const code_descriptor& cd : evict.codes) {
@@ -91,7 +103,8 @@ struct compile_monitor_session {
       });
    }
 
-   void kick_compile_off(const code_tuple& code_id, wrapped_fd&& wasm_code) {
+   void kick_compile_off(const compile_wasm_message& compile, wrapped_fd&& wasm_code) {
+      const code_tuple& code_id = compile.code;
       //prepare a requst to go out to the trampoline
       int socks[2];
       socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks);
@@ -101,62 +114,29 @@ struct compile_monitor_session {
       fds_pass_to_trampoline.emplace_back(socks[1]);
       fds_pass_to_trampoline.emplace_back(std::move(wasm_code));
 
-      eosvmoc_message trampoline_compile_request = compile_wasm_message{code_id};
+      eosvmoc_message trampoline_compile_request = compile;
       if(write_message_with_fds(_trampoline_socket, trampoline_compile_request, fds_pass_to_trampoline) == false) {
-         wasm_compilation_result_message reply{code_id, compilation_result_unknownfailure{}, _allocator->get_free_memory()};
+         wasm_compilation_result_message reply{code_id, compilation_result_unknownfailure{}, _allocator->get_free_memory(), compile.opt_level};
          write_message_with_fds(_nodeos_instance_socket, reply);
          return;
       }
 
-      current_compiles.emplace_front(code_id, std::move(response_socket));
+      current_compiles.emplace_front(compile, std::move(response_socket));
       read_message_from_compile_task(current_compiles.begin());
    }
 
-   void read_message_from_compile_task(std::list<std::tuple<code_tuple, local::datagram_protocol::socket>>::iterator current_compile_it) {
-      auto& [code, socket] = *current_compile_it;
+   void read_message_from_compile_task(std::list<std::tuple<compile_wasm_message, local::datagram_protocol::socket>>::iterator current_compile_it) {
+      auto& [compile, socket] = *current_compile_it;
       socket.async_wait(local::datagram_protocol::socket::wait_read, [this, current_compile_it](auto ec) {
          //at this point we only expect 1 of 2 things to happen: we either get a reply (success), or we get no reply (failure)
-         auto& [code, socket] = *current_compile_it;
+         auto& [compile, socket] = *current_compile_it;
+         const code_tuple& code = compile.code;
          auto [success, message, fds] = read_message_with_fds(socket);
          
-         wasm_compilation_result_message reply{code, compilation_result_unknownfailure{}, _allocator->get_free_memory()};
+         wasm_compilation_result_message reply{code, compilation_result_unknownfailure{}, _allocator->get_free_memory(), compile.opt_level};
          
-         void* code_ptr = nullptr;
-         void* mem_ptr = nullptr;
-         try {
-            if(success && message.contains<code_compilation_result_message>() && fds.size() == 2) {
-               code_compilation_result_message& result = message.get<code_compilation_result_message>();
-               code_ptr = _allocator->allocate(get_size_of_fd(fds[0]));
-               mem_ptr = _allocator->allocate(get_size_of_fd(fds[1]));
-
-               if(code_ptr == nullptr || mem_ptr == nullptr) {
-                  _allocator->deallocate(code_ptr);
-                  _allocator->deallocate(mem_ptr);
-                  reply.result = compilation_result_toofull();
-               }
-               else {
-                  copy_memfd_contents_to_pointer(code_ptr, fds[0]);
-                  copy_memfd_contents_to_pointer(mem_ptr, fds[1]);
-
-                  reply.result = code_descriptor {
-                     code.code_id,
-                     code.vm_version,
-                     0,
-                     (uintptr_t)code_ptr - (uintptr_t)_code_mapping,
-                     result.start,
-                     result.apply_offset,
-                     result.starting_memory_pages,
-                     (uintptr_t)mem_ptr - (uintptr_t)_code_mapping,
-                     (unsigned)get_size_of_fd(fds[1]),
-                     result.initdata_prologue_size
-                  };
-               }
-            }
-         }
-         catch(...) {
-            _allocator->deallocate(code_ptr);
-            _allocator->deallocate(mem_ptr);
-         }
+         if(success && message.contains<code_compilation_result_message>() && fds.size() == 2)
+            reply.result = store_code(code, message.get<code_compilation_result_message>(), fds);
 
          write_message_with_fds(_nodeos_instance_socket, reply);
 
@@ -171,6 +151,43 @@ struct compile_monitor_session {
    boost::signals2::signal<void()> connection_dead_signal;
 
 private:
+   //copies the code and initial memory of a compiled code into the cache
+   wasm_compilation_result store_code(const code_tuple& code, const code_compilation_result_message& result, const std::vector<wrapped_fd>& fds) {
+      void* code_ptr = nullptr;
+      void* mem_ptr = nullptr;
+      try {
+         code_ptr = _allocator->allocate(get_size_of_fd(fds[0]));
+         mem_ptr = _allocator->allocate(get_size_of_fd(fds[1]));
+
+         if(code_ptr == nullptr || mem_ptr == nullptr) {
+            _allocator->deallocate(code_ptr);
+            _allocator->deallocate(mem_ptr);
+            return compilation_result_toofull();
+         }
+
+         copy_memfd_contents_to_pointer(code_ptr, fds[0]);
+         copy_memfd_contents_to_pointer(mem_ptr, fds[1]);
+
+         return code_descriptor {
+            code.code_id,
+            code.vm_version,
+            0,
+            (uintptr_t)code_ptr - (uintptr_t)_code_mapping,
+            result.start,
+            result.apply_offset,
+            result.starting_memory_pages,
+            (uintptr_t)mem_ptr - (uintptr_t)_code_mapping,
+            (unsigned)get_size_of_fd(fds[1]),
+            result.initdata_prologue_size
+         };
+      }
+      catch(...) {
+         _allocator->deallocate(code_ptr);
+         _allocator->deallocate(mem_ptr);
+      }
+      return compilation_result_unknownfailure();
+   }
+
    boost::asio::io_context& _ctx;
    local::datagram_protocol::socket _nodeos_instance_socket;
    wrapped_fd  _cache_fd;
@@ -180,7 +197,7 @@ private:
    size_t _code_size;
    allocator_t* _allocator;
 
-   std::list<std::tuple<code_tuple, local::datagram_protocol::socket>> current_compiles;
+   std::list<std::tuple<compile_wasm_message, local::datagram_protocol::socket>> current_compiles;
 };
 
 struct compile_monitor {
@@ -323,4 +340,20 @@ wrapped_fd get_connection_to_compile_monitor(int cache_fd) {
    return socket_to_monitor_session;
 }
 
-}}}
\ No newline at end of file
+void set_compile_monitor_affinity(const std::vector<uint32_t>& cpus) {
+   const pid_t monitor = the_compile_monitor_trampoline.compile_manager_pid;
+   FC_ASSERT(monitor >= 0, "EOS VM oop connection doesn't look active");
+   std::vector<pid_t> pids{monitor};
+   //the trampoline was forked by the monitor before any configuration was available
+   std::ifstream children("/proc/" + std::to_string(monitor) + "/task/" + std::to_string(monitor) + "/children");
+   for(pid_t child; children >> child;)
+      pids.push_back(child);
+   if(pids.size() == 1)
+      wlog("unable to find the EOS VM OC compile trampoline, only the monitor is pinned");
+   ilog("pinning EOS VM OC compile processes to cpus ${c}", ("c", cpu_list_to_string(cpus)));
+   for(pid_t pid : pids)
+      set_cpu_affinity(cpus, pid);
+   thread_placement::instance().record({"oc-monitor", cpu_list_to_string(cpus), 0});
+}
+
+}}}
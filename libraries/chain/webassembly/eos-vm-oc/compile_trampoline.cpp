@@ -17,7 +17,7 @@ using namespace IR;
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
-void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {  //noexcept; we'll just blow up if anything tries to cross this boundry
+void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code, uint8_t opt_level, uint32_t partitions) noexcept {  //noexcept; we'll just blow up if anything tries to cross this boundry
    std::vector<uint8_t> wasm = vector_for_memfd(wasm_code);
 
    //ideally we catch exceptions and sent them upstream as strings for easier reporting
@@ -29,7 +29,7 @@ void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {
    wasm_injections::wasm_binary_injection<false> injector(module);
    injector.inject();
 
-   instantiated_code code = LLVMJIT::instantiateModule(module);
+   instantiated_code code = LLVMJIT::instantiateModule(module, opt_level, partitions);
 
    code_compilation_result_message result_message;
 
@@ -173,7 +173,11 @@ void run_compile_trampoline(int fd) {
          struct rlimit core_limits = {0u, 0u};
          setrlimit(RLIMIT_CORE, &core_limits);
 
-         run_compile(std::move(fds[0]), std::move(fds[1]));
+         //the processes compiling partitions of the module are waited for
+         signal(SIGCHLD, SIG_DFL);
+
+         const compile_wasm_message& compile = message.get<compile_wasm_message>();
+         run_compile(std::move(fds[0]), std::move(fds[1]), compile.opt_level, compile.partitions);
          _exit(0);
       }
       else if(pid == -1)
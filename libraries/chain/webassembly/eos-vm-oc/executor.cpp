@@ -147,7 +147,7 @@ executor::executor(const code_cache_base& cc) {
    mapping_is_executable = true;
 }
 
-void executor::execute(const code_descriptor& code, const memory& mem, apply_context& context) {
+void executor::execute(const code_descriptor& code, memory& mem, apply_context& context) {
    if(mapping_is_executable == false) {
       mprotect(code_mapping, code_mapping_size, PROT_EXEC|PROT_READ);
       mapping_is_executable = true;
@@ -156,11 +156,12 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    //prepare initial memory, mutable globals, and table data
    if(code.starting_memory_pages > 0 ) {
       arch_prctl(ARCH_SET_GS, (unsigned long*)(mem.zero_page_memory_base()+code.starting_memory_pages*memory::stride));
-      memset(mem.full_page_memory_base(), 0, 64u*1024u*code.starting_memory_pages);
+      mem.reset(code.starting_memory_pages);
    }
    else
       arch_prctl(ARCH_SET_GS, (unsigned long*)mem.zero_page_memory_base());
    memcpy(mem.full_page_memory_base() - code.initdata_prologue_size, code_mapping + code.initdata_begin, code.initdata_size);
+   mem.mark_dirty(code.starting_memory_pages);
 
    control_block* const cb = mem.get_control_block();
    cb->magic = signal_sentinel;
@@ -187,7 +188,8 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    }, this);
    context.trx_context.checktime(); //catch any expiration that might have occurred before setting up callback
 
-   auto cleanup = fc::make_scoped_exit([cb, &tt=context.trx_context.transaction_timer](){
+   auto cleanup = fc::make_scoped_exit([cb, &mem, &tt=context.trx_context.transaction_timer](){
+      mem.mark_dirty(cb->current_linear_memory_pages);
       cb->is_running = false;
       cb->bounce_buffers->clear();
       tt.set_expiration_callback(nullptr, nullptr);
@@ -227,4 +229,51 @@ executor::~executor() {
    arch_prctl(ARCH_SET_GS, nullptr);
 }
 
+struct executor_pool::execution_slice {
+   execution_slice(const code_cache_base& cc) : exec(cc) {}
+
+   executor exec;
+   memory   mem;
+};
+
+executor_pool::executor_pool(const code_cache_base& cc, uint32_t slices) {
+   EOS_ASSERT(slices > 0, wasm_exception, "EOS VM OC needs at least one execution slice");
+   //all slices are created up front, an executor expects the GS register of the creating thread to be unset
+   _slices.reserve(slices);
+   _free_slices.reserve(slices);
+   for(uint32_t i = 0; i < slices; ++i) {
+      _slices.emplace_back(std::make_unique<execution_slice>(cc));
+      _free_slices.push_back(_slices.back().get());
+   }
+}
+
+executor_pool::~executor_pool() {}
+
+executor_pool::execution_slice& executor_pool::acquire() {
+   std::unique_lock<std::mutex> g(_mtx);
+   _slice_released.wait(g, [this]() { return !_free_slices.empty(); });
+   execution_slice* s = _free_slices.back();
+   _free_slices.pop_back();
+   return *s;
+}
+
+void executor_pool::release(execution_slice& s) {
+   {
+      std::lock_guard<std::mutex> g(_mtx);
+      _free_slices.push_back(&s);
+   }
+   _slice_released.notify_one();
+}
+
+void executor_pool::execute(const code_descriptor& code, apply_context& context) {
+   execution_slice& s = acquire();
+   auto release_slice = fc::make_scoped_exit([this, &s, shared = _slices.size() > 1]() {
+      //once another thread may pick up this memory, don't leave it attached to this thread's signal handling
+      if(shared)
+         arch_prctl(ARCH_SET_GS, nullptr);
+      release(s);
+   });
+   s.exec.execute(code, s.mem, context);
+}
+
 }}}
@@ -8,6 +8,8 @@
 #include <sys/mman.h>
 #include <linux/memfd.h>
 
+#include <string.h>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 memory::memory() {
@@ -40,6 +42,18 @@ memory::memory() {
       intrinsic_jump_table[-intrinsic.second.ordinal] = (uintptr_t)intrinsic.second.function_ptr;
 }
 
+void memory::reset(uint64_t pages) {
+   const uint64_t dirty_bytes = dirty_pages*64u*1024u;
+   if(dirty_bytes >= release_threshold && std::min(pages, dirty_pages)*64u*1024u >= release_threshold) {
+      //punches a hole in the memfd, the pages read as zero through every slice mapping until written again
+      if(madvise(fullpage_base, dirty_bytes, MADV_REMOVE) == 0) {
+         dirty_pages = 0;
+         return;
+      }
+   }
+   memset(fullpage_base, 0, std::min(pages, dirty_pages)*64u*1024u);
+}
+
 memory::~memory() {
    munmap(mapbase, mapsize);
 }
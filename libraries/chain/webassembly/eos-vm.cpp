@@ -5,6 +5,10 @@
 //eos-vm includes
 #include <eosio/vm/backend.hpp>
 
+#include <fc/scoped_exit.hpp>
+
+#include <mutex>
+
 namespace eosio { namespace chain { namespace webassembly { namespace eos_vm_runtime {
 
 using namespace eosio::vm;
@@ -43,28 +47,36 @@ namespace {
 
 }
 
+/*
+ * A backend holds the parsed (and for the JIT, compiled) module together with its operand and call stacks, so it
+ * can only run one action at a time. A module keeps the backends it built and lends one to each action, with the
+ * linear memory of the running thread set before the run. The backends for running on several threads at once are
+ * built by prepare_concurrent_apply() ahead of the actions, so that no action pays for them.
+ */
 template<typename Impl>
 class eos_vm_instantiated_module : public wasm_instantiated_module_interface {
       using backend_t = backend<apply_context, Impl>;
    public:
       
-      eos_vm_instantiated_module(eos_vm_runtime<Impl>* runtime, std::unique_ptr<backend_t> mod) :
-         _runtime(runtime),
-         _instantiated_module(std::move(mod)) {}
+      eos_vm_instantiated_module(std::vector<uint8_t> code, std::unique_ptr<backend_t> mod) :
+         _code(std::move(code)) {
+         _idle.push_back(std::move(mod));
+      }
 
       void apply(apply_context& context) override {
-         _instantiated_module->set_wasm_allocator(&context.control.get_wasm_allocator());
-         _runtime->_bkend = _instantiated_module.get();
+         std::unique_ptr<backend_t> bkend = take_backend();
+         auto give_back = fc::make_scoped_exit([&]() { return_backend(std::move(bkend)); });
+         bkend->set_wasm_allocator(&context.control.get_wasm_allocator());
          auto fn = [&]() {
-            _runtime->_bkend->initialize(&context);
-            const auto& res = _runtime->_bkend->call(
+            bkend->initialize(&context);
+            const auto& res = bkend->call(
                 &context, "env", "apply", context.get_receiver().to_uint64_t(),
                 context.get_action().account.to_uint64_t(),
                 context.get_action().name.to_uint64_t());
          };
          try {
             checktime_watchdog wd(context.trx_context.transaction_timer);
-            _runtime->_bkend->timed_run(wd, fn);
+            bkend->timed_run(wd, fn);
          } catch(eosio::vm::timeout_exception&) {
             context.trx_context.checktime();
          } catch(eosio::vm::wasm_memory_exception& e) {
@@ -73,12 +85,52 @@ class eos_vm_instantiated_module : public wasm_instantiated_module_interface {
             // FIXME: Do better translation
             FC_THROW_EXCEPTION(wasm_execution_error, "something went wrong...");
          }
-         _runtime->_bkend = nullptr;
+      }
+
+      uint32_t prepare_concurrent_apply(uint32_t threads) override {
+         std::lock_guard g(_backends_mtx);
+         uint32_t built = 0;
+         for(; _kept + built < threads; ++built)
+            _idle.push_back(build());
+         _kept += built;
+         return built;
       }
 
    private:
-      eos_vm_runtime<Impl>*            _runtime;
-      std::unique_ptr<backend_t> _instantiated_module;
+      std::unique_ptr<backend_t> build() {
+         try {
+            wasm_code_ptr code(_code.data(), _code.size());
+            auto b = std::make_unique<backend_t>(code, _code.size());
+            registered_host_functions<apply_context>::resolve(b->get_module());
+            return b;
+         } catch(eosio::vm::exception& e) {
+            FC_THROW_EXCEPTION(wasm_execution_error, "Error building eos-vm interp: ${e}", ("e", e.what()));
+         }
+      }
+
+      std::unique_ptr<backend_t> take_backend() {
+         {
+            std::lock_guard g(_backends_mtx);
+            if(!_idle.empty()) {
+               auto b = std::move(_idle.back());
+               _idle.pop_back();
+               return b;
+            }
+         }
+         // more threads than prepared for; the extra backend is dropped after the action, see return_backend()
+         return build();
+      }
+
+      void return_backend(std::unique_ptr<backend_t> b) {
+         std::lock_guard g(_backends_mtx);
+         if(_idle.size() < _kept)
+            _idle.push_back(std::move(b));
+      }
+
+      std::vector<uint8_t>                        _code; ///< to build the backends of prepare_concurrent_apply()
+      std::mutex                                  _backends_mtx;
+      std::vector<std::unique_ptr<backend_t>>     _idle;
+      uint32_t                                    _kept = 1; ///< backends owned by the module, idle or lent out
 };
 
 template<typename Impl>
@@ -102,7 +154,7 @@ std::unique_ptr<wasm_instantiated_module_interface> eos_vm_runtime<Impl>::instan
       wasm_code_ptr code((uint8_t*)code_bytes, code_size);
       std::unique_ptr<backend_t> bkend = std::make_unique<backend_t>(code, code_size);
       registered_host_functions<apply_context>::resolve(bkend->get_module());
-      return std::make_unique<eos_vm_instantiated_module<Impl>>(this, std::move(bkend));
+      return std::make_unique<eos_vm_instantiated_module<Impl>>(std::vector<uint8_t>(code_bytes, code_bytes + code_size), std::move(bkend));
    } catch(eosio::vm::exception& e) {
       FC_THROW_EXCEPTION(wasm_execution_error, "Error building eos-vm interp: ${e}", ("e", e.what()));
    }
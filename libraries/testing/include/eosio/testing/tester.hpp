@@ -10,6 +10,7 @@
 #include <boost/tuple/tuple_io.hpp>
 
 #include <iosfwd>
+#include <sstream>
 
 #define REQUIRE_EQUAL_OBJECTS(left, right) { auto a = fc::variant( left ); auto b = fc::variant( right ); BOOST_REQUIRE_EQUAL( true, a.is_object() ); \
    BOOST_REQUIRE_EQUAL( true, b.is_object() ); \
@@ -160,6 +161,26 @@ namespace eosio { namespace testing {
          void              init(controller::config config, protocol_feature_set&& pfs, const genesis_state& genesis);
          void              init(controller::config config, protocol_feature_set&& pfs);
          void              execute_setup_policy(const setup_policy policy);
+         /// the part of the setup of policy which produces blocks
+         void              execute_setup_blocks(const setup_policy policy);
+         /// the part of the setup of policy which is left in the pending block
+         void              execute_setup_pending(const setup_policy policy);
+
+         /**
+          * When the tests run with --reuse-setup-snapshots (after the "--" of the boost test arguments) the state after
+          * execute_setup_blocks is kept in memory for the rest of the process, and testers with the same policy and read
+          * mode start from it instead of repeating the setup. The block log of such a tester starts after the setup
+          * blocks.
+          */
+         struct setup_snapshot {
+            std::string                       snapshot;            ///< binary snapshot
+            map<account_name, block_id_type>  last_produced_block;
+         };
+         static bool                   reuse_setup_snapshots();
+         /// nullptr unless setup snapshots are reused and one of policy and read_mode was saved
+         static const setup_snapshot*  find_setup_snapshot(const setup_policy policy, db_read_mode read_mode);
+         void                          save_setup_snapshot(const setup_policy policy);
+         void                          restore_setup_snapshot(const setup_snapshot& s);
 
          void              close();
          template <typename Lambda>
@@ -266,6 +287,10 @@ namespace eosio { namespace testing {
          transaction_trace_ptr push_reqauth(account_name from, string role, bool multi_sig = false);
          // use when just want any old non-context free action
          transaction_trace_ptr push_dummy(account_name from, const string& v = "blah", uint32_t billed_cpu_time_us = DEFAULT_BILLED_CPU_TIME_US );
+         // unsigned transaction with headers of a single onerror action made unique by memo, for checks done before applying
+         signed_transaction make_onerror_transaction( const string& memo,
+                                                      const permission_level& auth = {config::system_account_name, config::active_name},
+                                                      account_name account = config::system_account_name );
          transaction_trace_ptr transfer( account_name from, account_name to, asset amount, string memo, account_name currency );
          transaction_trace_ptr transfer( account_name from, account_name to, string amount, string memo, account_name currency );
          transaction_trace_ptr issue( account_name to, string amount, account_name currency , string memo);
@@ -394,8 +419,6 @@ namespace eosio { namespace testing {
             cfg.state_dir  = tempdir.path() / config::default_state_dir_name;
             cfg.state_size = 1024*1024*16;
             cfg.state_guard_size = 0;
-            cfg.reversible_cache_size = 1024*1024*8;
-            cfg.reversible_guard_size = 0;
             cfg.contracts_console = true;
             cfg.eosvmoc_config.cache_size = 1024*1024*8;
 
@@ -519,10 +542,17 @@ namespace eosio { namespace testing {
          config_validator(vcfg);
          vcfg.trusted_producers = trusted_producers;
 
-         validating_node = create_validating_node(vcfg, def_conf.second, true);
-
-         init(def_conf.first, def_conf.second);
-         execute_setup_policy(setup_policy::full);
+         if( const auto* s = find_setup_snapshot(setup_policy::full, def_conf.first.read_mode) ) {
+            validating_node = create_validating_node(vcfg, *s);
+            cfg = def_conf.first;
+            restore_setup_snapshot(*s);
+         } else {
+            validating_node = create_validating_node(vcfg, def_conf.second, true);
+            init(def_conf.first, def_conf.second);
+            execute_setup_blocks(setup_policy::full);
+            save_setup_snapshot(setup_policy::full);
+         }
+         execute_setup_pending(setup_policy::full);
       }
 
       static void config_validator(controller::config& vcfg) {
@@ -547,6 +577,17 @@ namespace eosio { namespace testing {
          return validating_node;
       }
 
+      static unique_ptr<controller> create_validating_node(controller::config vcfg, const setup_snapshot& s) {
+         std::istringstream snapshot_stream(s.snapshot);
+         auto reader = std::make_shared<istream_snapshot_reader>(snapshot_stream);
+         const auto chain_id = controller::extract_chain_id(*reader);
+         reader->return_to_header();
+         unique_ptr<controller> validating_node = std::make_unique<controller>(vcfg, make_protocol_feature_set(), chain_id);
+         validating_node->add_indices();
+         validating_node->startup( []() { return false; }, reader );
+         return validating_node;
+      }
+
       validating_tester(const fc::temp_directory& tempdir, bool use_genesis) {
          auto def_conf = default_config(tempdir);
          vcfg = def_conf.first;
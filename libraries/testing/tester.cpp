@@ -10,6 +10,7 @@
 #include <boost/iostreams/filter/gzip.hpp>
 
 #include <fstream>
+#include <sstream>
 
 #include <contracts.hpp>
 
@@ -155,8 +156,14 @@ namespace eosio { namespace testing {
       def_conf.first.read_mode = read_mode;
       cfg = def_conf.first;
 
-      open(def_conf.second);
-      execute_setup_policy(policy);
+      if( const auto* s = find_setup_snapshot(policy, read_mode) ) {
+         restore_setup_snapshot(*s);
+      } else {
+         open(def_conf.second);
+         execute_setup_blocks(policy);
+         save_setup_snapshot(policy);
+      }
+      execute_setup_pending(policy);
    }
 
    void base_tester::init(controller::config config, const snapshot_reader_ptr& snapshot) {
@@ -190,6 +197,11 @@ namespace eosio { namespace testing {
    }
 
    void base_tester::execute_setup_policy(const setup_policy policy) {
+      execute_setup_blocks(policy);
+      execute_setup_pending(policy);
+   }
+
+   void base_tester::execute_setup_blocks(const setup_policy policy) {
       const auto& pfm = control->get_protocol_feature_manager();
 
       auto schedule_preactivate_protocol_feature = [&]() {
@@ -199,19 +211,10 @@ namespace eosio { namespace testing {
       };
 
       switch (policy) {
-         case setup_policy::old_bios_only: {
-            set_before_preactivate_bios_contract();
-            break;
-         }
-         case setup_policy::preactivate_feature_only: {
-            schedule_preactivate_protocol_feature();
-            produce_block(); // block production is required to activate protocol feature
-            break;
-         }
+         case setup_policy::preactivate_feature_only:
          case setup_policy::preactivate_feature_and_new_bios: {
             schedule_preactivate_protocol_feature();
-            produce_block();
-            set_before_producer_authority_bios_contract();
+            produce_block(); // block production is required to activate protocol feature
             break;
          }
          case setup_policy::full: {
@@ -220,15 +223,92 @@ namespace eosio { namespace testing {
             set_before_producer_authority_bios_contract();
             preactivate_all_builtin_protocol_features();
             produce_block();
+            break;
+         }
+         case setup_policy::old_bios_only:
+         case setup_policy::none:
+         default:
+            break;
+      };
+   }
+
+   void base_tester::execute_setup_pending(const setup_policy policy) {
+      switch (policy) {
+         case setup_policy::old_bios_only: {
+            set_before_preactivate_bios_contract();
+            break;
+         }
+         case setup_policy::preactivate_feature_and_new_bios: {
+            set_before_producer_authority_bios_contract();
+            break;
+         }
+         case setup_policy::full: {
             set_bios_contract();
             break;
          }
+         case setup_policy::preactivate_feature_only:
          case setup_policy::none:
          default:
             break;
       };
    }
 
+   namespace {
+      using setup_snapshot_key = std::pair<setup_policy, db_read_mode>;
+
+      std::map<setup_snapshot_key, base_tester::setup_snapshot>& setup_snapshots() {
+         static std::map<setup_snapshot_key, base_tester::setup_snapshot> snapshots;
+         return snapshots;
+      }
+
+      // policies which produce blocks, the others are cheaper to set up than to restore
+      bool has_setup_blocks(const setup_policy policy) {
+         return policy != setup_policy::none && policy != setup_policy::old_bios_only;
+      }
+   }
+
+   bool base_tester::reuse_setup_snapshots() {
+      static const bool reuse = []() {
+         const auto& suite = boost::unit_test::framework::master_test_suite();
+         for( int i = 0; i < suite.argc; ++i ) {
+            if( suite.argv[i] == std::string("--reuse-setup-snapshots") )
+               return true;
+         }
+         return false;
+      }();
+      return reuse;
+   }
+
+   const base_tester::setup_snapshot* base_tester::find_setup_snapshot(const setup_policy policy, db_read_mode read_mode) {
+      if( !reuse_setup_snapshots() )
+         return nullptr;
+      const auto itr = setup_snapshots().find( setup_snapshot_key{policy, read_mode} );
+      return itr != setup_snapshots().end() ? &itr->second : nullptr;
+   }
+
+   void base_tester::save_setup_snapshot(const setup_policy policy) {
+      if( !reuse_setup_snapshots() || !has_setup_blocks(policy) || find_setup_snapshot(policy, cfg.read_mode) )
+         return;
+
+      // a snapshot cannot be taken with a pending block, the one started by the last produce_block is empty
+      unapplied_transactions.add_aborted( control->abort_block() );
+      std::ostringstream snapshot_stream;
+      auto writer = std::make_shared<ostream_snapshot_writer>(snapshot_stream);
+      control->write_snapshot(writer);
+      writer->finalize();
+      _start_block( control->head_block_time() + fc::milliseconds(config::block_interval_ms) );
+
+      setup_snapshots()[setup_snapshot_key{policy, cfg.read_mode}] = setup_snapshot{ snapshot_stream.str(), last_produced_block };
+   }
+
+   void base_tester::restore_setup_snapshot(const setup_snapshot& s) {
+      std::istringstream snapshot_stream(s.snapshot);
+      snapshot_reader_ptr reader = std::make_shared<istream_snapshot_reader>(snapshot_stream);
+      open( reader );
+      last_produced_block = s.last_produced_block;
+      _start_block( control->head_block_time() + fc::milliseconds(config::block_interval_ms) );
+   }
+
    void base_tester::close() {
       control.reset();
       chain_transactions.clear();
@@ -452,7 +532,7 @@ namespace eosio { namespace testing {
    void base_tester::produce_min_num_of_blocks_to_spend_time_wo_inactive_prod(const fc::microseconds target_elapsed_time) {
       fc::microseconds elapsed_time;
       while (elapsed_time < target_elapsed_time) {
-         for(uint32_t i = 0; i < control->head_block_state()->active_schedule.producers.size(); i++) {
+         for(uint32_t i = 0; i < control->head_block_state()->active_schedule->producers.size(); i++) {
             const auto time_to_skip = fc::milliseconds(config::producer_repetitions * config::block_interval_ms);
             produce_block(time_to_skip);
             elapsed_time += time_to_skip;
@@ -726,6 +806,15 @@ namespace eosio { namespace testing {
    }
 
 
+   signed_transaction base_tester::make_onerror_transaction( const string& memo, const permission_level& auth, account_name account ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{auth}, onerror{ 1, memo.data(), memo.size() } );
+      trx.actions.back().account = account;
+      set_transaction_headers( trx );
+      return trx;
+   }
+
+
    transaction_trace_ptr base_tester::transfer( account_name from, account_name to, string amount, string memo, account_name currency ) {
       return transfer( from, to, asset::from_string(amount), memo, currency );
    }
@@ -1,28 +1,480 @@
 #include <eosio/chain_api_plugin/chain_api_plugin.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/exceptions.hpp>
 
 #include <fc/io/json.hpp>
 
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _chain_api_plugin = app().register_plugin<chain_api_plugin>();
 
 using namespace eosio;
 
+/**
+ * Runs read-only chain API calls on the http threads. Calls are queued from the main thread and run during a read
+ * window, a low priority main thread task that does nothing but wait for them, so no block or transaction modifies
+ * the state while they read it. A window starts no new call after max_window_time so that reads can't starve
+ * blocks and transactions; whatever is left waits for the next window.
+ */
+class read_window_executor {
+public:
+   read_window_executor(boost::asio::io_context& ioc, uint16_t threads, fc::microseconds max_window_time)
+      : _ioc(ioc), _threads(threads), _max_window_time(max_window_time) {}
+
+   /// must be called on the main thread
+   void post(std::function<void()> call) {
+      _queue.emplace_back(std::move(call));
+      schedule_window();
+   }
+
+private:
+   void schedule_window() {
+      if(_window_scheduled)
+         return;
+      _window_scheduled = true;
+      app().post(priority::low, [this]() { run_window(); });
+   }
+
+   void run_window() {
+      _window_scheduled = false;
+      const fc::time_point window_end = fc::time_point::now() + _max_window_time;
+
+      std::unique_lock<std::mutex> g(_mtx);
+      for(;;) {
+         while(!_queue.empty() && _running < _threads && fc::time_point::now() < window_end) {
+            ++_running;
+            boost::asio::post(_ioc, [this, call{std::move(_queue.front())}]() {
+               try {
+                  call();
+               } FC_LOG_AND_DROP();
+               std::lock_guard<std::mutex> g(_mtx);
+               --_running;
+               _call_done.notify_one();
+            });
+            _queue.pop_front();
+         }
+         if(_running == 0)
+            break;
+         _call_done.wait(g);
+      }
+
+      if(!_queue.empty())
+         schedule_window();
+   }
+
+   boost::asio::io_context&          _ioc;
+   const uint16_t                    _threads;
+   const fc::microseconds            _max_window_time;
+   std::deque<std::function<void()>> _queue; ///< only touched on the main thread
+   bool                              _window_scheduled = false;
+   std::mutex                        _mtx;
+   std::condition_variable           _call_done;
+   uint16_t                          _running = 0;
+};
+
+/**
+ * Pushes chain events to the websocket connections of /v1/chain/subscribe instead of having clients poll for them.
+ * A client sends json objects {"subscribe": <topic>, ...} or {"unsubscribe": <topic>, ...}, where topic is
+ *  - "accepted_blocks" or "irreversible_blocks": the header of every such block,
+ *  - "transaction" with "id": every execution of the transaction, and its receipt once it is irreversible,
+ *  - "actions" with any of "receiver", "account" and "action": the traces of the matching actions, speculative
+ *    executions included,
+ *  - "table_rows" with "code" and optionally "scope" and "table": the rows of the contract tables inserted, updated
+ *    or removed by each accepted block, or by each irreversible block with "irreversible": true. Rows are given in
+ *    hex, or decoded with the abi of the contract with "decode": true. They are taken from the undo session of the
+ *    block like the chain state of state_history_plugin, so none are sent for blocks applied without one.
+ * Each event is serialized once for all its subscribers. Only used on the main thread.
+ */
+class subscription_manager {
+public:
+   static constexpr size_t max_filters = 256; ///< transaction and action subscriptions of one connection
+
+   explicit subscription_manager(controller& db) : db(db) {}
+
+   void connect( const fc::microseconds& max_serialization_time ) {
+      abi_serializer_max_time = max_serialization_time;
+      accepted_block_connection.emplace( db.accepted_block.connect( [this]( const chain::block_state_ptr& bsp ) {
+         send_block( "accepted_block", bsp, &subscriber::accepted_blocks );
+         send_accepted_table_rows( bsp );
+      } ) );
+      irreversible_block_connection.emplace( db.irreversible_block.connect( [this]( const chain::block_state_ptr& bsp ) {
+         send_block( "irreversible_block", bsp, &subscriber::irreversible_blocks );
+         send_irreversible_transactions( bsp );
+         send_irreversible_table_rows( bsp );
+      } ) );
+      applied_transaction_connection.emplace( db.applied_transaction.connect(
+            [this]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
+         send_transaction( std::get<0>(t) );
+      } ) );
+   }
+
+   void disconnect() {
+      accepted_block_connection.reset();
+      irreversible_block_connection.reset();
+      applied_transaction_connection.reset();
+      subscribers.clear();
+      irreversible_row_changes.clear();
+   }
+
+   websocket_handlers handlers() {
+      return {
+         [this]( websocket_session_ptr s ) { subscribers[std::move(s)]; },
+         [this]( websocket_session_ptr s, string message ) { on_message( std::move(s), message ); },
+         [this]( websocket_session_ptr s ) { subscribers.erase( s ); }
+      };
+   }
+
+private:
+   /// a field left empty matches any name
+   using action_filter = std::tuple<chain::name, chain::name, chain::name>; ///< receiver, account, action
+   /// scope or table left empty matches any
+   using table_filter = std::tuple<chain::name, chain::name, chain::name, bool>; ///< code, scope, table, irreversible
+
+   struct subscriber {
+      bool                                  accepted_blocks = false;
+      bool                                  irreversible_blocks = false;
+      std::set<chain::transaction_id_type>  transactions;
+      std::set<action_filter>               actions;
+      std::map<table_filter, bool>          table_rows; ///< decode by filter
+
+      /// engaged if the row changes of the table are sent to it, with whether they are decoded
+      fc::optional<bool> matches( chain::name code, chain::name scope, chain::name table, bool irreversible )const {
+         fc::optional<bool> decode;
+         for( auto itr = table_rows.lower_bound( table_filter{ code, chain::name(), chain::name(), false } );
+              itr != table_rows.end() && std::get<0>(itr->first) == code; ++itr ) {
+            const auto& f = itr->first;
+            if( std::get<3>(f) == irreversible &&
+                ( std::get<1>(f).empty() || std::get<1>(f) == scope ) &&
+                ( std::get<2>(f).empty() || std::get<2>(f) == table ) )
+               decode = ( decode && *decode ) || itr->second;
+         }
+         return decode;
+      }
+
+      bool matches( const chain::action_trace& at )const {
+         for( const auto& f : actions ) {
+            if( ( std::get<0>(f).empty() || std::get<0>(f) == at.receiver ) &&
+                ( std::get<1>(f).empty() || std::get<1>(f) == at.act.account ) &&
+                ( std::get<2>(f).empty() || std::get<2>(f) == at.act.name ) )
+               return true;
+         }
+         return false;
+      }
+   };
+
+   /// a row inserted, updated or removed by a block, its value after the block or before its removal
+   struct row_change {
+      chain::name            code;
+      chain::name            scope;
+      chain::name            table;
+      uint64_t               primary_key = 0;
+      chain::account_name    payer;
+      const char*            op = "";
+      chain::bytes           value;
+      bool                   irreversible = false; ///< some irreversible subscription takes it
+   };
+
+   /// row changes of an accepted block kept until it is irreversible
+   struct block_row_changes {
+      chain::block_id_type     id;
+      std::vector<row_change>  changes;
+   };
+
+   static string to_json( const fc::variant& v ) {
+      return fc::json::to_string( v, fc::time_point::maximum() );
+   }
+
+   void on_message( const websocket_session_ptr& s, const string& message ) {
+      auto itr = subscribers.find( s );
+      if( itr == subscribers.end() ) return;
+      try {
+         const auto request = fc::json::from_string( message ).get_object();
+         const bool subscribe = request.contains( "subscribe" );
+         EOS_ASSERT( subscribe || request.contains( "unsubscribe" ), chain::invalid_http_request,
+                     "request needs a subscribe or unsubscribe topic" );
+         const string topic = request[subscribe ? "subscribe" : "unsubscribe"].as_string();
+         subscriber& sub = itr->second;
+         auto check_filters = [&]() {
+            EOS_ASSERT( !subscribe || sub.transactions.size() + sub.actions.size() + sub.table_rows.size() < max_filters,
+                        chain::invalid_http_request, "at most ${n} transaction, action and table subscriptions per connection",
+                        ("n", max_filters) );
+         };
+         if( topic == "accepted_blocks" ) {
+            sub.accepted_blocks = subscribe;
+         } else if( topic == "irreversible_blocks" ) {
+            sub.irreversible_blocks = subscribe;
+         } else if( topic == "transaction" ) {
+            EOS_ASSERT( request.contains( "id" ), chain::invalid_http_request, "transaction subscription needs an id" );
+            const auto id = request["id"].as<chain::transaction_id_type>();
+            check_filters();
+            if( subscribe ) sub.transactions.insert( id );
+            else sub.transactions.erase( id );
+         } else if( topic == "actions" ) {
+            auto field = [&]( const char* key ) { return request.contains( key ) ? request[key].as<chain::name>() : chain::name(); };
+            const action_filter f{ field( "receiver" ), field( "account" ), field( "action" ) };
+            EOS_ASSERT( f != action_filter(), chain::invalid_http_request, "actions subscription needs a receiver, account or action" );
+            check_filters();
+            if( subscribe ) sub.actions.insert( f );
+            else sub.actions.erase( f );
+         } else if( topic == "table_rows" ) {
+            auto field = [&]( const char* key ) { return request.contains( key ) ? request[key].as<chain::name>() : chain::name(); };
+            auto flag = [&]( const char* key ) { return request.contains( key ) && request[key].as_bool(); };
+            const table_filter f{ field( "code" ), field( "scope" ), field( "table" ), flag( "irreversible" ) };
+            EOS_ASSERT( !std::get<0>(f).empty(), chain::invalid_http_request, "table_rows subscription needs a code" );
+            check_filters();
+            if( subscribe ) sub.table_rows[f] = flag( "decode" );
+            else sub.table_rows.erase( f );
+         } else {
+            EOS_THROW( chain::invalid_http_request, "unknown topic ${t}", ("t", topic) );
+         }
+         s->send( to_json( fc::mutable_variant_object( "type", subscribe ? "subscribed" : "unsubscribed" )( "request", request ) ) );
+      } catch( const fc::exception& e ) {
+         s->send( to_json( fc::mutable_variant_object( "type", "error" )( "message", e.to_string() ) ) );
+      } catch( const std::exception& e ) {
+         s->send( to_json( fc::mutable_variant_object( "type", "error" )( "message", e.what() ) ) );
+      }
+   }
+
+   void send_block( const char* type, const chain::block_state_ptr& bsp, bool subscriber::* topic ) {
+      string message;
+      for( const auto& sub : subscribers ) {
+         if( !(sub.second.*topic) ) continue;
+         if( message.empty() )
+            message = to_json( fc::mutable_variant_object( "type", type )( "block_num", bsp->block_num )( "id", bsp->id )
+                                                         ( "header", bsp->header ) );
+         sub.first->send( message );
+      }
+   }
+
+   void send_transaction( const chain::transaction_trace_ptr& trace ) {
+      string message;
+      for( auto& sub : subscribers ) {
+         if( !sub.second.transactions.count( trace->id ) ) continue;
+         if( message.empty() )
+            message = to_json( fc::mutable_variant_object( "type", "transaction" )( "status", "applied" )( "id", trace->id )
+                                                         ( "block_num", trace->block_num )( "receipt", trace->receipt )
+                                                         ( "except", trace->except ? trace->except->to_string() : string() ) );
+         sub.first->send( message );
+      }
+      for( const auto& at : trace->action_traces ) {
+         message.clear();
+         for( const auto& sub : subscribers ) {
+            if( sub.second.actions.empty() || !sub.second.matches( at ) ) continue;
+            if( message.empty() )
+               message = to_json( fc::mutable_variant_object( "type", "action" )( "trx_id", trace->id )
+                                                            ( "block_num", trace->block_num )( "trace", at ) );
+            sub.first->send( message );
+         }
+      }
+   }
+
+   void send_irreversible_transactions( const chain::block_state_ptr& bsp ) {
+      if( std::none_of( subscribers.begin(), subscribers.end(), []( const auto& sub ) { return !sub.second.transactions.empty(); } ) )
+         return;
+      for( const auto& receipt : bsp->block->transactions ) {
+         const auto id = receipt.trx.contains<chain::packed_transaction>() ? receipt.trx.get<chain::packed_transaction>().id()
+                                                                          : receipt.trx.get<chain::transaction_id_type>();
+         string message;
+         for( auto& sub : subscribers ) {
+            if( !sub.second.transactions.erase( id ) ) continue;
+            if( message.empty() )
+               message = to_json( fc::mutable_variant_object( "type", "transaction" )( "status", "irreversible" )( "id", id )
+                                                            ( "block_num", bsp->block_num )
+                                                            ( "receipt", static_cast<const chain::transaction_receipt_header&>( receipt ) ) );
+            sub.first->send( message );
+         }
+      }
+   }
+
+   bool any_table_rows()const {
+      return std::any_of( subscribers.begin(), subscribers.end(), []( const auto& sub ) { return !sub.second.table_rows.empty(); } );
+   }
+
+   /**
+    * Rows of the contract tables changed by the block just accepted whose table is subscribed to, read from the undo
+    * session of the block which is still the last one of the database.
+    */
+   std::vector<row_change> capture_row_changes() {
+      std::vector<row_change> changes;
+      const auto& cdb = db.db();
+      const auto& rows = cdb.get_index<chain::key_value_index>();
+      if( rows.stack().empty() )
+         return changes;
+      const auto& tables = cdb.get_index<chain::table_id_multi_index>();
+      std::map<uint64_t, const chain::table_id_object*> removed_tables;
+      if( !tables.stack().empty() ) {
+         for( const auto& rem : tables.stack().back().removed_values )
+            removed_tables[rem.first._id] = &rem.second;
+      }
+
+      auto add = [&]( const chain::key_value_object& row, const char* op ) {
+         const chain::table_id_object* t = tables.find( row.t_id._id );
+         if( !t ) {
+            auto itr = removed_tables.find( row.t_id._id );
+            if( itr == removed_tables.end() ) return;
+            t = itr->second;
+         }
+         bool accepted = false;
+         bool irreversible = false;
+         for( const auto& sub : subscribers ) {
+            accepted = accepted || !!sub.second.matches( t->code, t->scope, t->table, false );
+            irreversible = irreversible || !!sub.second.matches( t->code, t->scope, t->table, true );
+         }
+         if( !accepted && !irreversible )
+            return;
+         changes.push_back( { t->code, t->scope, t->table, row.primary_key, row.payer, op,
+                              chain::bytes( row.value.data(), row.value.data() + row.value.size() ), irreversible } );
+      };
+
+      const auto& undo = rows.stack().back();
+      for( const auto& old : undo.old_values )
+         add( rows.get( old.first ), "update" );
+      for( const auto& rem : undo.removed_values )
+         add( rem.second, "remove" );
+      for( auto id : undo.new_ids )
+         add( rows.get( id ), "insert" );
+      return changes;
+   }
+
+   fc::variant decoded_value( const row_change& c ) {
+      try {
+         if( auto abis = chain::abi_serializer_cache::instance().get( db.db(), c.code, abi_serializer_max_time ) ) {
+            const auto type = abis->get_table_type( c.table );
+            if( !type.empty() )
+               return abis->binary_to_variant( type, c.value, abi_serializer_max_time );
+         }
+      } FC_LOG_AND_DROP()
+      // not decodable with the current abi, left in hex
+      return fc::variant( c.value );
+   }
+
+   void send_table_rows( const char* status, uint32_t block_num, const chain::block_id_type& id,
+                         const std::vector<row_change>& changes, bool irreversible ) {
+      for( const auto& c : changes ) {
+         string messages[2]; // in hex, decoded
+         for( const auto& sub : subscribers ) {
+            if( sub.second.table_rows.empty() ) continue;
+            const auto decode = sub.second.matches( c.code, c.scope, c.table, irreversible );
+            if( !decode ) continue;
+            string& message = messages[*decode];
+            if( message.empty() )
+               message = to_json( fc::mutable_variant_object( "type", "table_row" )( "status", status )( "block_num", block_num )
+                                                            ( "block_id", id )( "op", c.op )( "code", c.code )( "scope", c.scope )
+                                                            ( "table", c.table )( "primary_key", c.primary_key )( "payer", c.payer )
+                                                            ( "data", *decode ? decoded_value( c ) : fc::variant( c.value ) ) );
+            sub.first->send( message );
+         }
+      }
+   }
+
+   void send_accepted_table_rows( const chain::block_state_ptr& bsp ) {
+      // a block at or below the last one accepted replaces the blocks from its number on
+      irreversible_row_changes.erase( irreversible_row_changes.lower_bound( bsp->block_num ), irreversible_row_changes.end() );
+      if( !any_table_rows() )
+         return;
+      auto changes = capture_row_changes();
+      if( changes.empty() )
+         return;
+      send_table_rows( "accepted", bsp->block_num, bsp->id, changes, false );
+
+      changes.erase( std::remove_if( changes.begin(), changes.end(), []( const row_change& c ) { return !c.irreversible; } ),
+                     changes.end() );
+      if( !changes.empty() )
+         irreversible_row_changes[bsp->block_num] = { bsp->id, std::move( changes ) };
+   }
+
+   void send_irreversible_table_rows( const chain::block_state_ptr& bsp ) {
+      auto itr = irreversible_row_changes.find( bsp->block_num );
+      if( itr != irreversible_row_changes.end() && itr->second.id == bsp->id )
+         send_table_rows( "irreversible", bsp->block_num, bsp->id, itr->second.changes, true );
+      irreversible_row_changes.erase( irreversible_row_changes.begin(), irreversible_row_changes.upper_bound( bsp->block_num ) );
+   }
+
+   controller&                                        db;
+   fc::microseconds                                   abi_serializer_max_time;
+   std::map<websocket_session_ptr, subscriber>        subscribers;
+   std::map<uint32_t, block_row_changes>              irreversible_row_changes; ///< by block number
+   fc::optional<boost::signals2::scoped_connection>   accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection>   irreversible_block_connection;
+   fc::optional<boost::signals2::scoped_connection>   applied_transaction_connection;
+};
+
 class chain_api_plugin_impl {
 public:
    chain_api_plugin_impl(controller& db)
-      : db(db) {}
+      : db(db), subscriptions(db) {}
 
    controller& db;
+   fc::microseconds read_window_time;
+   fc::optional<read_window_executor> read_executor;
+   subscription_manager subscriptions;
+
+   // responses of these calls are cached by http_plugin until the state they depend on changes
+   static constexpr const char* head_cached_urls[] = { "/v1/chain/get_info", "/v1/chain/get_block", "/v1/chain/get_producers" };
+   static constexpr const char* code_cached_urls[] = { "/v1/chain/get_abi", "/v1/chain/get_code_hash" };
+
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection> irreversible_block_connection;
+   fc::optional<boost::signals2::scoped_connection> applied_transaction_connection;
+   chain::block_id_type                             last_accepted_block_id;
+   bool                                             code_changed_since_last_block = false;
+
+   void connect_response_cache_invalidation( http_plugin& http ) {
+      auto clear = [&http]( const auto& urls ) {
+         for( const char* url : urls ) http.clear_cached_responses( url );
+      };
+
+      accepted_block_connection.emplace( db.accepted_block.connect( [this, clear]( const chain::block_state_ptr& bsp ) {
+         clear( head_cached_urls );
+         // a fork switch or an aborted speculative setcode/setabi may have reverted code or abi of any account
+         if( code_changed_since_last_block || bsp->header.previous != last_accepted_block_id )
+            clear( code_cached_urls );
+         code_changed_since_last_block = false;
+         last_accepted_block_id = bsp->id;
+      } ) );
+      irreversible_block_connection.emplace( db.irreversible_block.connect( [clear]( const chain::block_state_ptr& ) {
+         clear( std::initializer_list<const char*>{ "/v1/chain/get_info" } );
+      } ) );
+      applied_transaction_connection.emplace( db.applied_transaction.connect(
+            [this, clear]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
+         for( const auto& at : std::get<0>(t)->action_traces ) {
+            if( at.receiver == chain::config::system_account_name && at.act.account == chain::config::system_account_name &&
+                ( at.act.name == N(setcode) || at.act.name == N(setabi) ) ) {
+               clear( code_cached_urls );
+               code_changed_since_last_block = true;
+               return;
+            }
+         }
+      } ) );
+   }
 };
 
 
 chain_api_plugin::chain_api_plugin(){}
 chain_api_plugin::~chain_api_plugin(){}
 
-void chain_api_plugin::set_program_options(options_description&, options_description&) {}
-void chain_api_plugin::plugin_initialize(const variables_map&) {}
+void chain_api_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("read-only-read-window-time-us", bpo::value<uint32_t>()->default_value(0),
+          "Run read-only chain API queries that only read the chain state on the http-threads, pausing the main thread for at most this long "
+          "(in microseconds) at a time to start them. 0 runs them on the main thread.")
+         ;
+}
+
+void chain_api_plugin::plugin_initialize(const variables_map& options) {
+   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
+   my->read_window_time = fc::microseconds(options.at("read-only-read-window-time-us").as<uint32_t>());
+}
 
 struct async_result_visitor : public fc::visitor<fc::variant> {
    template<typename T>
@@ -44,45 +496,108 @@ struct async_result_visitor : public fc::visitor<fc::variant> {
           } \
        }}
 
+// answers requests accepting application/octet-stream with the bytes returned by call_name ## _packed
+#define CALL_PACKED(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             fc::variant result( fc::blob{ api_handle.call_name ## _packed(fc::json::from_string(body).as<api_namespace::call_name ## _params>()) } ); \
+             cb(http_response_code, std::move(result)); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+template<typename CallResult>
+auto async_response(const char* api_name, const char* call_name, string body, url_response_callback cb, int http_response_code) {
+   return [=](const fc::static_variant<fc::exception_ptr, CallResult>& result) {
+      if (result.template contains<fc::exception_ptr>()) {
+         try {
+            result.template get<fc::exception_ptr>()->dynamic_rethrow_exception();
+         } catch (...) {
+            http_plugin::handle_exception(api_name, call_name, body, cb);
+         }
+      } else {
+         cb(http_response_code, result.visit(async_result_visitor()));
+      }
+   };
+}
+
 #define CALL_ASYNC(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [api_handle](string, string body, url_response_callback cb) mutable { \
       if (body.empty()) body = "{}"; \
       api_handle.validate(); \
       api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(),\
-         [cb, body](const fc::static_variant<fc::exception_ptr, call_result>& result){\
-            if (result.contains<fc::exception_ptr>()) {\
-               try {\
-                  result.get<fc::exception_ptr>()->dynamic_rethrow_exception();\
-               } catch (...) {\
-                  http_plugin::handle_exception(#api_name, #call_name, body, cb);\
-               }\
-            } else {\
-               cb(http_response_code, result.visit(async_result_visitor()));\
-            }\
-         });\
+         async_response<call_result>(#api_name, #call_name, body, cb, http_response_code));\
+   }\
+}
+
+// called on an http thread: the json is parsed there, and so is a transaction in the packed form, which is also
+// prevalidated there; only one given unpacked needs the main thread for converting it with the abis of its actions
+#define CALL_TRX_ASYNC(api_name, api_handle, api_namespace, call_name, packed_call_name, call_result, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle, max_time](string, string body, url_response_callback cb) mutable { \
+      try { \
+         if (body.empty()) body = "{}"; \
+         auto params = fc::json::from_string(body).as<api_namespace::call_name ## _params>(); \
+         auto trx = api_namespace::parse_packed_transaction(params, max_time); \
+         if (trx) app().get_plugin<chain_plugin>().prevalidate_transaction(*trx); \
+         app().post(priority::low, [api_handle, params{std::move(params)}, trx{std::move(trx)}, body{std::move(body)}, cb{std::move(cb)}]() mutable { \
+            try { \
+               api_handle.validate(); \
+               auto next = async_response<call_result>(#api_name, #call_name, body, cb, http_response_code); \
+               if (trx) api_handle.packed_call_name(trx, std::move(next)); \
+               else api_handle.call_name(params, std::move(next)); \
+            } catch (...) { \
+               http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+            } \
+         }); \
+      } catch (...) { \
+         http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+      } \
    }\
 }
 
+// answers with the json string returned by call_name ## _json, sent as is
+#define CALL_SERIALIZED(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             fc::variant result( api_handle.call_name ## _json(fc::json::from_string(body).as<api_namespace::call_name ## _params>()) ); \
+             cb(http_response_code, std::move(result)); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
+#define CHAIN_RO_CALL_PACKED(call_name, http_response_code) CALL_PACKED(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+#define CHAIN_RO_CALL_SERIALIZED(call_name, http_response_code) CALL_SERIALIZED(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
 #define CHAIN_RW_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
+#define CHAIN_RW_CALL_TRX_ASYNC(call_name, packed_call_name, call_result, http_response_code) CALL_TRX_ASYNC(chain, rw_api, chain_apis::read_write, call_name, packed_call_name, call_result, http_response_code)
 
 void chain_api_plugin::plugin_startup() {
    ilog( "starting chain_api_plugin" );
-   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
    auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
    auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
 
    auto& _http_plugin = app().get_plugin<http_plugin>();
    ro_api.set_shorten_abi_errors( !_http_plugin.verbose_errors() );
+   ro_api.set_decode_thread_pool( _http_plugin.get_thread_pool_executor(), _http_plugin.get_thread_pool_size() );
 
-   _http_plugin.add_api({
+   api_description api = {
       CHAIN_RO_CALL(get_info, 200l),
       CHAIN_RO_CALL(get_activated_protocol_features, 200),
-      CHAIN_RO_CALL(get_block, 200),
+      CHAIN_RO_CALL_SERIALIZED(get_block, 200),
       CHAIN_RO_CALL(get_block_header_state, 200),
+      CHAIN_RO_CALL(get_transaction_block, 200),
       CHAIN_RO_CALL(get_account, 200),
       CHAIN_RO_CALL(get_code, 200),
       CHAIN_RO_CALL(get_code_hash, 200),
@@ -95,18 +610,133 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_currency_stats, 200),
       CHAIN_RO_CALL(get_producers, 200),
       CHAIN_RO_CALL(get_producer_schedule, 200),
+      CHAIN_RO_CALL(get_eosvmoc_warm_up_status, 200),
+      CHAIN_RO_CALL(export_eosvmoc_code, 200),
+      CHAIN_RO_CALL(get_wasm_cache_stats, 200),
+      CHAIN_RO_CALL(get_thread_placement, 200),
+      CHAIN_RO_CALL(get_startup_timing, 200),
+      CHAIN_RO_CALL(get_memory_usage, 200),
+      CHAIN_RO_CALL(get_wasm_profile, 200),
+      CHAIN_RO_CALL(get_action_stats, 200),
       CHAIN_RO_CALL(get_scheduled_transactions, 200),
       CHAIN_RO_CALL(abi_json_to_bin, 200),
       CHAIN_RO_CALL(abi_bin_to_json, 200),
       CHAIN_RO_CALL(get_required_keys, 200),
+      CHAIN_RO_CALL(get_required_keys_batch, 200),
       CHAIN_RO_CALL(get_transaction_id, 200),
+      CHAIN_RO_CALL(batch, 200),
       CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
-      CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
       CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
-      CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202)
-   });
+      CHAIN_RW_CALL(push_read_only_transaction, 200),
+      CHAIN_RW_CALL(import_eosvmoc_code, 200)
+   };
+
+   const fc::microseconds max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
+   api_description http_thread_api = {
+      CHAIN_RW_CALL_TRX_ASYNC(push_transaction, push_packed_transaction, chain_apis::read_write::push_transaction_results, 202),
+      CHAIN_RW_CALL_TRX_ASYNC(send_transaction, send_packed_transaction, chain_apis::read_write::send_transaction_results, 202)
+   };
+
+   api_description packed_api = {
+      CHAIN_RO_CALL_PACKED(get_block, 200),
+      CHAIN_RO_CALL_PACKED(get_account, 200),
+      CHAIN_RO_CALL_PACKED(get_raw_abi, 200),
+      CHAIN_RO_CALL_PACKED(get_table_rows, 200)
+   };
+
+   if( my->read_window_time.count() > 0 ) {
+      my->read_executor.emplace( _http_plugin.get_thread_pool_executor(), _http_plugin.get_thread_pool_size(), my->read_window_time );
+      // calls that only read chainbase; the ones touching the block log, fork database or authorization caches stay on the main thread
+      for( const char* call : { "get_account", "get_code", "get_code_hash", "get_abi", "get_raw_code_and_abi", "get_raw_abi",
+                                "get_table_rows", "get_table_by_scope", "get_currency_balance", "get_currency_stats",
+                                "get_producers", "abi_json_to_bin", "abi_bin_to_json", "batch" } ) {
+         const std::string url = std::string("/v1/chain/") + call;
+         for( auto* calls : { &api, &packed_api } ) {
+            auto itr = calls->find( url );
+            if( itr == calls->end() ) continue;
+            itr->second = [h = std::move(itr->second), &executor = *my->read_executor](string url, string body, url_response_callback cb) {
+               executor.post( [h, url{std::move(url)}, body{std::move(body)}, cb{std::move(cb)}]() mutable {
+                  h( std::move(url), std::move(body), std::move(cb) );
+               } );
+            };
+         }
+      }
+   }
+
+   if( app().get_plugin<chain_plugin>().get_producers_view() ) {
+      // answered on the http thread from the producers view, which replaces the head block response cache for it;
+      // requests arriving before the view is available go to the main thread
+      auto itr = api.find( "/v1/chain/get_producers" );
+      auto main_thread_handler = std::move( itr->second );
+      api.erase( itr );
+      http_thread_api.emplace( "/v1/chain/get_producers",
+            [ro_api, main_thread_handler](string url, string body, url_response_callback cb) mutable {
+               try {
+                  auto params = fc::json::from_string( body.empty() ? "{}" : body ).as<chain_apis::read_only::get_producers_params>();
+                  if( auto result = ro_api.get_producers_from_view( params ) ) {
+                     cb( 200, fc::variant( *result ) );
+                     return;
+                  }
+               } catch (...) {
+                  http_plugin::handle_exception( "chain", "get_producers", body, cb );
+                  return;
+               }
+               app().post( priority::low, [main_thread_handler, url{std::move(url)}, body{std::move(body)}, cb{std::move(cb)}]() mutable {
+                  main_thread_handler( std::move(url), std::move(body), std::move(cb) );
+               } );
+            } );
+   }
+
+   if( app().get_plugin<chain_plugin>().get_transaction_status_cache() ) {
+      // answered on the http thread from the transaction status cache, never touching the chain state
+      http_thread_api.emplace( "/v1/chain/get_transaction_status",
+            [ro_api](string url, string body, url_response_callback cb) mutable {
+               try {
+                  auto params = fc::json::from_string( body.empty() ? "{}" : body ).as<chain_apis::read_only::get_transaction_status_params>();
+                  cb( 200, fc::variant( ro_api.get_transaction_status( params ) ) );
+               } catch (...) {
+                  http_plugin::handle_exception( "chain", "get_transaction_status", body, cb );
+               }
+            } );
+   }
+
+   if( app().get_plugin<chain_plugin>().get_key_account_index() ) {
+      // answered on the http thread from the key account index, never touching the chain state
+      http_thread_api.emplace( "/v1/chain/get_accounts_by_authorizers",
+            [ro_api](string url, string body, url_response_callback cb) mutable {
+               try {
+                  auto params = fc::json::from_string( body.empty() ? "{}" : body ).as<chain_apis::read_only::get_accounts_by_authorizers_params>();
+                  cb( 200, fc::variant( ro_api.get_accounts_by_authorizers( params ) ) );
+               } catch (...) {
+                  http_plugin::handle_exception( "chain", "get_accounts_by_authorizers", body, cb );
+               }
+            } );
+   }
+
+   for( const auto& call : api ) {
+      if( std::count( std::begin(my->head_cached_urls), std::end(my->head_cached_urls), call.first ) ||
+          std::count( std::begin(my->code_cached_urls), std::end(my->code_cached_urls), call.first ) ) {
+         _http_plugin.add_cached_handler( call.first, call.second );
+      } else {
+         _http_plugin.add_handler( call.first, call.second );
+      }
+   }
+   _http_plugin.set_serialized_json_responses( "/v1/chain/get_block" );
+   for( const auto& call : http_thread_api )
+      _http_plugin.add_http_thread_handler( call.first, call.second );
+   for( const auto& call : packed_api )
+      _http_plugin.add_binary_handler( call.first, call.second );
+   my->connect_response_cache_invalidation( _http_plugin );
+
+   my->subscriptions.connect( app().get_plugin<chain_plugin>().get_abi_serializer_max_time() );
+   _http_plugin.add_websocket_handler( "/v1/chain/subscribe", my->subscriptions.handlers() );
 }
 
-void chain_api_plugin::plugin_shutdown() {}
+void chain_api_plugin::plugin_shutdown() {
+   my->accepted_block_connection.reset();
+   my->irreversible_block_connection.reset();
+   my->applied_transaction_connection.reset();
+   my->subscriptions.disconnect();
+}
 
 }
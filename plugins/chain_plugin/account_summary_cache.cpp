@@ -0,0 +1,131 @@
+#include <eosio/chain_plugin/account_summary_cache.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/permission_object.hpp>
+
+namespace eosio { namespace chain_apis {
+
+using namespace eosio::chain;
+
+account_summary_cache::account_summary_cache( const controller& chain, const fc::microseconds& abi_serializer_max_time, size_t capacity )
+:_chain(chain)
+,_abi_serializer_max_time(abi_serializer_max_time)
+,_capacity(capacity)
+{}
+
+account_summary_cache::summary_ptr account_summary_cache::get( const name& account ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto itr = _entries.find( account.to_uint64_t() );
+   if( itr == _entries.end() ) return {};
+   _lru.splice( _lru.begin(), _lru, itr->second.lru_itr );
+   return itr->second.summary;
+}
+
+void account_summary_cache::want( const name& account ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   if( _wanted.size() < _capacity ) _wanted.insert( account );
+}
+
+optional<flat_set<name>> account_summary_cache::changed_accounts()const {
+   const auto& d = _chain.db();
+   flat_set<name> changed;
+
+   // calls f with the prior and the current value of every row the block being accepted changed
+   bool complete = true;
+   auto for_each_changed = [&]( const auto& index, auto f ) {
+      if( index.stack().empty() ) {
+         complete = false;
+         return;
+      }
+      const auto& undo = index.stack().back();
+      for( const auto& old : undo.old_values ) f( old.second );
+      for( const auto& removed : undo.removed_values ) f( removed.second );
+      for( const auto& id : undo.new_ids ) f( index.get( id ) );
+   };
+
+   for_each_changed( d.get_index<account_index>(), [&]( const account_object& a ) { changed.insert( a.name ); } );
+   for_each_changed( d.get_index<account_metadata_index>(), [&]( const account_metadata_object& a ) { changed.insert( a.name ); } );
+   for_each_changed( d.get_index<permission_index>(), [&]( const permission_object& p ) { changed.insert( p.owner ); } );
+
+   const auto& table_index = d.get_index<table_id_multi_index>();
+   if( table_index.stack().empty() ) return {};
+   const auto& removed_tables = table_index.stack().back().removed_values;
+   for_each_changed( d.get_index<key_value_index>(), [&]( const key_value_object& row ) {
+      const table_id_object* table = table_index.find( row.t_id );
+      if( !table ) {
+         auto itr = removed_tables.find( row.t_id );
+         if( itr == removed_tables.end() ) return;
+         table = &itr->second;
+      }
+      if( table->code == N(eosio.token) ) {
+         if( table->table == N(accounts) ) changed.insert( table->scope );
+      } else if( table->code == config::system_account_name ) {
+         if( table->table == N(userres) || table->table == N(delband) || table->table == N(refunds) ) {
+            changed.insert( table->scope );
+         } else if( table->table == N(voters) || table->table == N(rexbal) ) {
+            changed.insert( name(row.primary_key) );
+         }
+      }
+   } );
+
+   if( !complete ) return {};
+   return changed;
+}
+
+void account_summary_cache::on_accepted_block( const block_state_ptr& bsp ) {
+   const auto& d = _chain.db();
+   abi_serializer_cache::abi_serializer_ptr abis;
+   try {
+      abis = abi_serializer_cache::instance().get( d, config::system_account_name, _abi_serializer_max_time );
+   } FC_LOG_AND_DROP()
+
+   optional<flat_set<name>> changed;
+   if( abis == _abis && bsp->header.previous == _last_block_id && d.revision() == int64_t(bsp->block_num) )
+      changed = changed_accounts();
+   _abis = std::move(abis);
+   _last_block_id = bsp->id;
+
+   vector<name> refresh;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      refresh.reserve( _wanted.size() + _lru.size() );
+      refresh.insert( refresh.end(), _wanted.begin(), _wanted.end() );
+      _wanted.clear();
+      for( const auto& account : _lru ) {
+         if( !changed || changed->count( account ) ) refresh.push_back( account );
+      }
+   }
+   if( refresh.empty() ) return;
+
+   read_only ro( _chain, _abi_serializer_max_time );
+   for( const auto& account : refresh ) {
+      summary_ptr summary;
+      try {
+         summary = std::make_shared<const read_only::get_account_results>( ro.get_account_summary( account, {} ) );
+      } catch( ... ) {
+         // account does not exist or its rows can not be decoded, get_account reports the error when asked
+      }
+
+      std::lock_guard<std::mutex> g( _mtx );
+      auto itr = _entries.find( account.to_uint64_t() );
+      if( !summary ) {
+         if( itr != _entries.end() ) {
+            _lru.erase( itr->second.lru_itr );
+            _entries.erase( itr );
+         }
+         continue;
+      }
+      if( itr != _entries.end() ) {
+         itr->second.summary = std::move(summary);
+         continue;
+      }
+      _lru.push_front( account );
+      _entries.emplace( account.to_uint64_t(), entry{ std::move(summary), _lru.begin() } );
+      if( _entries.size() > _capacity ) {
+         _entries.erase( _lru.back().to_uint64_t() );
+         _lru.pop_back();
+      }
+   }
+}
+
+} } /// eosio::chain_apis
@@ -1,4 +1,5 @@
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain_plugin/account_summary_cache.hpp>
 #include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
@@ -7,24 +8,38 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/wasm_interface.hpp>
 #include <eosio/chain/resource_limits.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/key_string_cache.hpp>
+#include <eosio/chain/memory_accounting.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/transaction_prevalidator.hpp>
+#include <eosio/chain/transaction_tracing.hpp>
 
 #include <eosio/chain/eosio_contract.hpp>
 
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/compile_monitor.hpp>
+#endif
+
 #include <chainbase/environment.hpp>
 
 #include <boost/signals2/connection.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/asio/post.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
 #include <signal.h>
 #include <cstdlib>
+#include <atomic>
 
 // reflect chainbase::environment for --print-build-info option
 FC_REFLECT_ENUM( chainbase::environment::os_t,
@@ -112,6 +127,49 @@ void validate(boost::any& v,
   }
 }
 
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+namespace eosvmoc {
+
+std::ostream& operator<<(std::ostream& osm, cache_mode m) {
+   if ( m == cache_mode::exclusive ) {
+      osm << "exclusive";
+   } else if ( m == cache_mode::shared_writer ) {
+      osm << "shared-writer";
+   } else if ( m == cache_mode::shared_reader ) {
+      osm << "shared-reader";
+   }
+
+   return osm;
+}
+
+void validate(boost::any& v,
+              const std::vector<std::string>& values,
+              cache_mode* /* target_type */,
+              int)
+{
+  using namespace boost::program_options;
+
+  // Make sure no previous assignment to 'v' was made.
+  validators::check_first_occurrence(v);
+
+  // Extract the first string from 'values'. If there is more than
+  // one string, it's an error, and exception will be thrown.
+  std::string const& s = validators::get_single_string(values);
+
+  if ( s == "exclusive" ) {
+     v = boost::any(cache_mode::exclusive);
+  } else if ( s == "shared-writer" ) {
+     v = boost::any(cache_mode::shared_writer);
+  } else if ( s == "shared-reader" ) {
+     v = boost::any(cache_mode::shared_reader);
+  } else {
+     throw validation_error(validation_error::invalid_option_value);
+  }
+}
+
+}
+#endif
+
 }
 
 using namespace eosio;
@@ -138,6 +196,8 @@ public:
    {}
 
    bfs::path                        blocks_dir;
+   bfs::path                        state_checkpoints_dir;
+   fc::optional<bfs::path>          state_in_use; ///< marker of the state database being open for writing
    bool                             readonly = false;
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
 
@@ -150,6 +210,11 @@ public:
    fc::optional<vm_type>            wasm_runtime;
    fc::microseconds                 abi_serializer_max_time_ms;
    fc::optional<bfs::path>          snapshot_path;
+   fc::optional<chain_apis::producers_view> producers;
+   fc::optional<chain_apis::account_summary_cache> account_summaries;
+   fc::optional<chain_apis::transaction_status_cache> trx_statuses;
+   fc::optional<chain_apis::key_account_index> key_accounts;
+   fc::optional<transaction_prevalidator> prevalidator;
 
 
    // retained references to channels for easy publication
@@ -186,6 +251,9 @@ chain_plugin::chain_plugin()
    app().register_config_type<eosio::chain::db_read_mode>();
    app().register_config_type<eosio::chain::validation_mode>();
    app().register_config_type<chainbase::pinnable_mapped_file::map_mode>();
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   app().register_config_type<eosvmoc::cache_mode>();
+#endif
 }
 
 chain_plugin::~chain_plugin(){}
@@ -195,6 +263,34 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
    cfg.add_options()
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
+         ("state-checkpoints-dir", bpo::value<bfs::path>()->default_value("state-checkpoints"),
+          "the location of the state checkpoints written by producer_plugin with state-checkpoint-interval-blocks (absolute path or relative to application data dir)")
+         ("trx-trace-sample-one-in", bpo::value<uint32_t>()->default_value(0),
+          "Trace one in this many transactions, chosen by id, from their arrival over http or p2p to their inclusion in a block (0 to disable)")
+         ("trx-trace-file", bpo::value<bfs::path>()->default_value("trx-traces.json"),
+          "File the transaction traces are appended to as OTLP JSON lines, for an OpenTelemetry collector file receiver (absolute path or relative to application data dir)")
+         ("state-checkpoint-recovery", bpo::value<bool>()->default_value(false),
+          "When the state database was not closed cleanly, restart from the latest state checkpoint and replay the blocks log from there "
+          "instead of failing on the dirty database")
+         ("compress-block-log", bpo::bool_switch()->default_value(false),
+          "Store each block of a newly created blocks.log zlib compressed. An existing block log keeps its format, use eosio-blocklog to convert it.")
+         ("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+          "Split blocks.log into partitions ending at multiples of this block number, 0 keeps a single blocks.log. "
+          "Completed partitions are moved to blocks-retained-dir and stay readable.")
+         ("max-retained-block-files", bpo::value<uint16_t>()->default_value(10),
+          "Number of completed block log partitions kept in blocks-retained-dir")
+         ("blocks-retained-dir", bpo::value<bfs::path>()->default_value(""),
+          "the location of the completed block log partitions (absolute path or relative to blocks dir), the blocks dir if empty")
+         ("blocks-archive-dir", bpo::value<bfs::path>()->default_value(""),
+          "the location block log partitions beyond max-retained-block-files are moved to (absolute path or relative to blocks dir). "
+          "They are removed if empty.")
+         ("trx-index", bpo::bool_switch()->default_value(false),
+          "Keep trx.index in the blocks dir, mapping the ids of the transactions in the block log to their blocks for get_transaction_block. "
+          "Blocks appended while it was not kept are added at startup, eosio-blocklog --make-trx-index builds it faster.")
+         ("account-index", bpo::bool_switch()->default_value(false),
+          "Keep accounts.bloom in the blocks dir, bloom filters of the accounts and action names of every 10000 blocks of the block log, "
+          "so that eosio-blocklog --account and --action read only the blocks which may match. "
+          "Blocks appended while it was not kept are added at startup, eosio-blocklog --make-account-index builds it faster.")
          ("protocol-features-dir", bpo::value<bfs::path>()->default_value("protocol_features"),
           "the location of the protocol_features directory (absolute path or relative to application config dir)")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
@@ -207,16 +303,57 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
             }
 #endif
          }), "Override default WASM runtime")
+         ("wasm-preinstantiate-codes", bpo::value<uint32_t>()->default_value(config::default_wasm_preinstantiate_codes),
+          "Number of most recently used contracts recorded at shutdown and instantiated on a background thread at the next startup. "
+          "When not 0, contracts are also instantiated in the background when set with setcode. Only with the eos-vm and eos-vm-jit runtimes.")
+         ("contract-row-hash-reserve", bpo::value<uint32_t>()->default_value(config::default_contract_row_hash_reserve),
+          "Number of contract table rows beyond those of the state that the hash index of rows by primary key is sized for when the "
+          "state is opened or loaded from a snapshot, so that storing rows does not rehash the index during a transaction. "
+          "Each row reserved takes 8 bytes of chain state memory, 8 MiB for the default. 0 reserves nothing")
+         ("wasm-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_cache_size / (1024*1024)),
+          "Estimated memory (in MiB) the instantiated contracts may use; least recently used contracts are dropped and instantiated again when needed. 0 is unbounded")
+         ("action-stats-window-blocks", bpo::value<uint32_t>()->default_value(0),
+          "Keep per receiver and action execution counts, CPU time percentiles, RAM deltas and notification fan-out over windows of this many blocks, "
+          "available through /v1/chain/get_action_stats. 0 disables it")
+         ("wasm-profile", bpo::bool_switch()->default_value(false),
+          "Time the wasm execution of every action per receiver and action. Available through /v1/chain/get_wasm_profile and written to wasm_profile.folded (flamegraph collapsed stacks) in the state directory at shutdown")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
           "Override default maximum ABI serialization time allowed in ms")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
          ("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")
-         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks database")
-         ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
+         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>(), "Deprecated and ignored, reversible blocks are kept in a file that grows as needed")
+         ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>(), "Deprecated and ignored, reversible blocks are kept in a file that grows as needed")
          ("signature-cpu-billable-pct", bpo::value<uint32_t>()->default_value(config::default_sig_cpu_bill_pct / config::percent_1),
           "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")
          ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in controller thread pool")
+         ("main-thread-cpus", bpo::value<string>(),
+          "CPUs the main thread is pinned to, as a list like 0-3,8; threads started by the main thread afterwards inherit it "
+          "unless pinned themselves")
+         ("thread-pool-cpus", bpo::value<vector<string>>()->composing()->multitoken(),
+          "CPUs a thread pool is pinned to, as name=cpu-list where name is one of chain, net, http, prod, txntest "
+          "(may specify multiple times)")
+         ("shared-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of worker threads shared by the thread pools listed in shared-thread-pool (0 to disable)")
+         ("shared-thread-pool", bpo::value<vector<string>>()->composing()->multitoken(),
+          "Thread pool run on the shared worker threads instead of its own, as name[:priority[:max-concurrency]] where name is "
+          "one of chain, net, http, prod, txntest. A max-concurrency of 0 uses the thread count configured for the pool "
+          "(may specify multiple times)")
+         ("shared-thread-cpu", bpo::value<vector<uint32_t>>()->composing()->multitoken(),
+          "CPU the shared worker threads are pinned to round-robin (may specify multiple times), not pinned if not given")
+         ("shared-thread-latency-sample-ms", bpo::value<uint32_t>()->default_value(1000),
+          "Interval at which the queueing latency of every shared thread pool is sampled (0 to disable)")
+         ("max-prefetched-blocks", bpo::value<uint32_t>()->default_value(config::default_max_prefetched_blocks),
+          "Maximum number of received blocks whose transaction signatures are recovered ahead of applying them (0 to disable)")
+         ("signature-recovery-cache-size", bpo::value<uint32_t>()->default_value(config::default_sig_recovery_cache_size),
+          "Maximum number of recovered transaction signature keys cached for reuse across peers and blocks (0 to disable)")
+         ("abi-serializer-cache-size", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_cache_size),
+          "Maximum number of account abi serializers cached for reuse across API requests and plugins (0 to disable)")
+         ("key-string-cache-size", bpo::value<uint32_t>()->default_value(config::default_key_string_cache_size),
+          "Maximum number of base58 strings of public keys, and of signatures, cached for API responses (0 to disable)")
+         ("memory-accounting", bpo::value<bool>()->default_value(true),
+          "Account the heap bytes held by the net buffers, the unapplied transactions, the packed blocks, the wasm cache and the "
+          "mongo_db_plugin queues, reported by /v1/chain/get_memory_usage and as prometheus metrics")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -249,6 +386,38 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("maximum-variable-signature-length", bpo::value<uint32_t>()->default_value(16384u),
           "Subjectively limit the maximum length of variable components in a variable legnth signature to this size in bytes")
          ("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.")
+         ("trusted-block", bpo::value<string>(),
+          "ID of a block whose history is trusted. Blocks up to it are replayed or synced without recovering the keys of their transactions nor checking their authorizations, "
+          "they are still executed and their merkle roots checked. The block is also enforced as a checkpoint.")
+         ("parallel-apply-analysis", bpo::bool_switch()->default_value(false),
+          "Record the accounts and contract tables touched by each transaction of applied blocks and log how many conflict-free groups they form")
+         ("producers-view", bpo::bool_switch()->default_value(false),
+          "Keep a decoded copy of the eosio producers table, updated from the rows changed by each block, and serve get_producers from it")
+         ("account-summary-cache-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of accounts whose permissions and system contract rows get_account keeps decoded, refreshed when a block changes them. "
+          "Cached parts reflect the head block instead of the speculative state. 0 disables the cache.")
+         ("transaction-status-window-sec", bpo::value<uint32_t>()->default_value(0),
+          "Keep the status of the transactions applied or included in blocks during this many seconds for get_transaction_status, "
+          "answered on the http threads. 0 disables it.")
+         ("key-account-index", bpo::bool_switch()->default_value(false),
+          "Keep an index from the keys and permission levels of every authority to the permissions holding them, built when the chain starts "
+          "and updated from the permissions changed by each block, for get_accounts_by_authorizers answered on the http threads")
+         ("transaction-prevalidation", bpo::value<bool>()->default_value(true),
+          "Reject incoming transactions which are expired, reference an unknown block, are already in a recent block or exceed the "
+          "net usage limit on the thread receiving them, before their keys are recovered and they reach the main thread.")
+         ("irreversible-step-time-us", bpo::value<uint32_t>()->default_value(0),
+          "Time after which the blocks becoming irreversible with a block are left to be committed with the following blocks, "
+          "so that a long backlog after irreversibility stalled does not stall a single block. At least 2 blocks are committed "
+          "each time whatever the time, so the backlog shrinks while irreversibility advances a block per block. Ignored in irreversible "
+          "read mode. 0 commits them all at once.")
+         ("irreversible-undo-free", bpo::bool_switch()->default_value(false),
+          "In irreversible read mode, apply the blocks becoming irreversible without undo sessions for them and their transactions. "
+          "A block failing to apply then stops nodeos without closing the state database, which has to be replayed or restored "
+          "from a snapshot. Ignored in the other read modes and with disable-replay-opts.")
+         ("fork-switch-delta-size-kb", bpo::value<uint32_t>()->default_value(0),
+          "Maximum size in KiB of the chainbase changes kept for each validated reversible block. Switching back to a fork whose blocks were "
+          "validated before replays those changes instead of executing the transactions again. The traces of their transactions are kept "
+          "with the changes, outside of this limit, and emitted again. 0 disables it.")
          ("database-map-mode", bpo::value<chainbase::pinnable_mapped_file::map_mode>()->default_value(chainbase::pinnable_mapped_file::map_mode::mapped),
           "Database map mode (\"mapped\", \"heap\", or \"locked\").\n"
           "In \"mapped\" mode database is memory mapped as a file.\n"
@@ -261,6 +430,15 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          )
 #ifdef __linux__
          ("database-hugepage-path", bpo::value<vector<string>>()->composing(), "Optional path for database hugepages when in \"locked\" mode (may specify multiple times)")
+         ("database-prefetch", bpo::bool_switch()->default_value(false),
+          "In \"mapped\" mode, stream the database file into the page cache with large sequential reads and fault in the whole mapping at startup")
+         ("database-transparent-hugepages", bpo::bool_switch()->default_value(false),
+          "Advise the kernel to back the database mapping with transparent huge pages in \"mapped\" and \"heap\" mode")
+         ("database-numa-node", bpo::value<int32_t>()->default_value(-1),
+          "NUMA node to bind the main thread and the database memory to, threads started afterwards inherit the binding (-1 to disable)")
+         ("database-load-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads reading the database file into the page cache at startup: in \"heap\" and \"locked\" mode before it "
+          "is loaded into memory (0 to disable), in \"mapped\" mode for database-prefetch (0 or 1 reads it sequentially)")
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -272,6 +450,27 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
                }
          }), "Number of threads to use for EOS VM OC tier-up")
          ("eos-vm-oc-enable", bpo::bool_switch(), "Enable EOS VM OC tier-up runtime")
+         ("eos-vm-oc-compile-cpus", bpo::value<string>(),
+          "CPUs the EOS VM OC compile monitor and its compile processes are pinned to, as a list like 12-15")
+         ("eos-vm-oc-warm-up-codes", bpo::value<uint32_t>()->default_value(eosvmoc::config().warm_up_codes),
+          "Number of most executed contracts recorded at shutdown and compiled by EOS VM OC at the next startup (0 to disable)")
+         ("eos-vm-oc-execution-slices", bpo::value<uint32_t>()->default_value(eosvmoc::config().execution_slices),
+          "Number of executor and memory pairs of EOS VM OC tier-up, each reserving its own address space for linear memory. "
+          "Pairs beyond the first run the context-free actions of transactions compiled by EOS VM OC ahead of their other actions")
+         ("eos-vm-oc-opt-level", bpo::value<uint32_t>()->default_value(eosvmoc::config().opt_level),
+          "Optimization tier (0 to 2) EOS VM OC compiles contracts at; higher tiers spend more compile time for faster code")
+         ("eos-vm-oc-hot-opt-level", bpo::value<uint32_t>()->default_value(eosvmoc::config().hot_opt_level),
+          "Optimization tier (0 to 2) EOS VM OC recompiles hot contracts at; only used when above eos-vm-oc-opt-level")
+         ("eos-vm-oc-hot-recompile-executions", bpo::value<uint32_t>()->default_value(eosvmoc::config().hot_recompile_executions),
+          "Number of executions of a contract compiled by EOS VM OC after which it is recompiled at eos-vm-oc-hot-opt-level")
+         ("eos-vm-oc-cache-mode", bpo::value<eosvmoc::cache_mode>()->default_value(eosvmoc::cache_mode::exclusive),
+          "How the EOS VM OC code cache is shared with other nodeos processes on this host:\n"
+          "\"exclusive\" - the cache is private to this process\n"
+          "\"shared-writer\" - this process compiles and publishes the cache, compiled code is never evicted\n"
+          "\"shared-reader\" - this process maps the writer's cache read-only and compiles nothing")
+         ("eos-vm-oc-cache-dir", bpo::value<bfs::path>(),
+          "Directory of the EOS VM OC code cache, the state directory if unset (relative paths are relative to the data directory); "
+          "point shared-reader processes at the directory of the shared-writer")
 #endif
          ;
 
@@ -315,6 +514,9 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("export-reversible-blocks", bpo::value<bfs::path>(),
            "export reversible block database in portable format into specified file and then exit")
          ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")
+         ("snapshot-delta", bpo::value<vector<bfs::path>>()->composing(),
+          "Snapshot delta to apply on top of --snapshot before reading it, may be given several times to apply a chain of deltas in order; "
+          "the resulting snapshot is written to snapshot-from-deltas.bin in the data directory")
          ;
 
 }
@@ -366,6 +568,27 @@ void clear_chainbase_files( const fc::path& p ) {
    fc::remove( p / "shared_memory.meta" );
 }
 
+/// created in the state directory once the chain is started, removed once the database is closed
+bfs::path state_in_use_marker( const bfs::path& state_dir ) {
+   return state_dir / "state-in-use";
+}
+
+/// @return the state checkpoint of the highest block in dir, the block number leads the block id in the name
+fc::optional<bfs::path> latest_state_checkpoint( const bfs::path& dir ) {
+   using boost::filesystem::directory_iterator;
+   fc::optional<bfs::path> latest;
+   if( !fc::is_directory( dir ) )
+      return latest;
+   for( directory_iterator enditr, itr{dir}; itr != enditr; ++itr ) {
+      const auto name = itr->path().filename().generic_string();
+      if( name.rfind( "state-checkpoint-", 0 ) != 0 || itr->path().extension() != ".bin" )
+         continue;
+      if( !latest || name > latest->filename().generic_string() )
+         latest = itr->path();
+   }
+   return latest;
+}
+
 optional<builtin_protocol_feature> read_builtin_protocol_feature( const fc::path& p  ) {
    try {
       return fc::json::from_file<builtin_protocol_feature>( p );
@@ -574,20 +797,20 @@ chain_plugin::do_hard_replay(const variables_map& options) {
              options.at( "fix-reversible-blocks" ).as<bool>()) {
             // Do not try to recover reversible blocks if the directory does not exist, unless the option was explicitly provided.
             if( !recover_reversible_blocks( backup_dir / config::reversible_blocks_dir_name,
-                                            my->chain_config->reversible_cache_size,
                                             my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
                                             options.at( "truncate-at-block" ).as<uint32_t>())) {
                ilog( "Reversible blocks database was not corrupted. Copying from backup to blocks directory." );
                fc::copy( backup_dir / config::reversible_blocks_dir_name,
                          my->chain_config->blocks_dir / config::reversible_blocks_dir_name );
-               fc::copy( backup_dir / config::reversible_blocks_dir_name / "shared_memory.bin",
-                         my->chain_config->blocks_dir / config::reversible_blocks_dir_name / "shared_memory.bin" );
+               fc::copy( backup_dir / config::reversible_blocks_dir_name / config::reversible_blocks_log_filename,
+                         my->chain_config->blocks_dir / config::reversible_blocks_dir_name / config::reversible_blocks_log_filename );
             }
          }
 }
 
 void chain_plugin::plugin_initialize(const variables_map& options) {
    ilog("initializing chain plugin");
+   startup_timeline::scope phase( "chain_plugin initialize" );
 
    try {
       try {
@@ -688,6 +911,17 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          }
       }
 
+      if( options.count("trusted-block") ) {
+         const auto id = block_id_type( options.at("trusted-block").as<string>() );
+         const auto num = block_header::num_from_id( id );
+         auto itr = my->loaded_checkpoints.find( num );
+         EOS_ASSERT( itr == my->loaded_checkpoints.end() || itr->second == id, plugin_config_exception,
+                     "trusted-block ${id} conflicts with the checkpoint at block number ${num}: ${cp}",
+                     ("id", id)("num", num)("cp", itr->second) );
+         my->loaded_checkpoints[num] = id;
+         my->chain_config->trusted_block = id;
+      }
+
       if( options.count( "wasm-runtime" ))
          my->wasm_runtime = options.at( "wasm-runtime" ).as<vm_type>();
 
@@ -704,12 +938,8 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if( options.count( "chain-state-db-guard-size-mb" ))
          my->chain_config->state_guard_size = options.at( "chain-state-db-guard-size-mb" ).as<uint64_t>() * 1024 * 1024;
 
-      if( options.count( "reversible-blocks-db-size-mb" ))
-         my->chain_config->reversible_cache_size =
-               options.at( "reversible-blocks-db-size-mb" ).as<uint64_t>() * 1024 * 1024;
-
-      if( options.count( "reversible-blocks-db-guard-size-mb" ))
-         my->chain_config->reversible_guard_size = options.at( "reversible-blocks-db-guard-size-mb" ).as<uint64_t>() * 1024 * 1024;
+      if( options.count( "reversible-blocks-db-size-mb" ) || options.count( "reversible-blocks-db-guard-size-mb" ))
+         wlog( "reversible-blocks-db-size-mb and reversible-blocks-db-guard-size-mb are deprecated and ignored" );
 
       if( options.count( "chain-threads" )) {
          my->chain_config->thread_pool_size = options.at( "chain-threads" ).as<uint16_t>();
@@ -717,6 +947,55 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
                      "chain-threads ${num} must be greater than 0", ("num", my->chain_config->thread_pool_size) );
       }
 
+      if( options.count( "main-thread-cpus" ) ) {
+         const auto cpus = parse_cpu_list( options.at( "main-thread-cpus" ).as<string>() );
+         EOS_ASSERT( !cpus.empty(), plugin_config_exception, "main-thread-cpus must list at least one cpu" );
+         ilog( "pinning main thread to cpus ${c}", ("c", cpu_list_to_string( cpus )) );
+         set_cpu_affinity( cpus );
+      }
+      thread_placement::instance().record( "main" );
+      if( options.count( "thread-pool-cpus" ) ) {
+         std::map<std::string, vector<uint32_t>> pool_cpus;
+         for( const auto& s : options.at( "thread-pool-cpus" ).as<vector<string>>() ) {
+            auto eq = s.find( '=' );
+            EOS_ASSERT( eq != string::npos && eq > 0, plugin_config_exception,
+                        "invalid thread-pool-cpus ${s}, expected name=cpu-list", ("s", s) );
+            pool_cpus[s.substr( 0, eq )] = parse_cpu_list( s.substr( eq + 1 ) );
+         }
+         thread_placement::instance().set_pool_cpus( std::move(pool_cpus) );
+      }
+
+      if( auto shared_threads = options.at( "shared-threads" ).as<uint16_t>() ) {
+         std::map<std::string, shared_thread_pool::lane_options> lanes;
+         if( options.count( "shared-thread-pool" ) ) {
+            for( const auto& s : options.at( "shared-thread-pool" ).as<vector<string>>() ) {
+               vector<string> parts;
+               boost::split( parts, s, boost::is_any_of( ":" ) );
+               EOS_ASSERT( !parts.empty() && !parts[0].empty() && parts.size() <= 3, plugin_config_exception,
+                           "invalid shared-thread-pool ${s}, expected name[:priority[:max-concurrency]]", ("s", s) );
+               shared_thread_pool::lane_options lane;
+               try {
+                  if( parts.size() > 1 ) lane.priority = boost::lexical_cast<uint32_t>( parts[1] );
+                  if( parts.size() > 2 ) lane.max_concurrency = boost::lexical_cast<uint32_t>( parts[2] );
+               } catch( const boost::bad_lexical_cast& ) {
+                  EOS_THROW( plugin_config_exception, "invalid shared-thread-pool ${s}, expected name[:priority[:max-concurrency]]", ("s", s) );
+               }
+               lanes[parts[0]] = lane;
+            }
+         }
+         vector<uint32_t> cpus;
+         if( options.count( "shared-thread-cpu" ) )
+            cpus = options.at( "shared-thread-cpu" ).as<vector<uint32_t>>();
+         shared_thread_pool::instance().configure( shared_threads, std::move(cpus), std::move(lanes),
+                                                   fc::milliseconds( options.at( "shared-thread-latency-sample-ms" ).as<uint32_t>() ) );
+      }
+
+      my->chain_config->max_prefetched_blocks = options.at( "max-prefetched-blocks" ).as<uint32_t>();
+      signature_recovery_cache::instance().set_capacity( options.at( "signature-recovery-cache-size" ).as<uint32_t>() );
+      abi_serializer_cache::instance().set_capacity( options.at( "abi-serializer-cache-size" ).as<uint32_t>() );
+      key_string_cache::instance().set_capacity( options.at( "key-string-cache-size" ).as<uint32_t>() );
+      memory_accounting::subsystem::set_enabled( options.at( "memory-accounting" ).as<bool>() );
+
       my->chain_config->sig_cpu_bill_pct = options.at("signature-cpu-billable-pct").as<uint32_t>();
       EOS_ASSERT( my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                   "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct) );
@@ -724,12 +1003,28 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
-
+      my->chain_config->wasm_preinstantiate_codes = options.at( "wasm-preinstantiate-codes" ).as<uint32_t>();
+      my->chain_config->wasm_cache_size = options.at( "wasm-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+      my->chain_config->contract_row_hash_reserve = options.at( "contract-row-hash-reserve" ).as<uint32_t>();
+      my->chain_config->wasm_profile = options.at( "wasm-profile" ).as<bool>();
+      my->chain_config->action_stats_window_blocks = options.at( "action-stats-window-blocks" ).as<uint32_t>();
+
+      my->chain_config->compress_block_log = options.at( "compress-block-log" ).as<bool>();
+      my->chain_config->trx_index = options.at( "trx-index" ).as<bool>();
+      my->chain_config->account_index = options.at( "account-index" ).as<bool>();
+      my->chain_config->blocks_log_partitions.stride = options.at( "blocks-log-stride" ).as<uint32_t>();
+      my->chain_config->blocks_log_partitions.max_retained_files = options.at( "max-retained-block-files" ).as<uint16_t>();
+      my->chain_config->blocks_log_partitions.retained_dir = options.at( "blocks-retained-dir" ).as<bfs::path>();
+      my->chain_config->blocks_log_partitions.archive_dir = options.at( "blocks-archive-dir" ).as<bfs::path>();
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
       my->chain_config->maximum_variable_signature_length = options.at( "maximum-variable-signature-length" ).as<uint32_t>();
+      my->chain_config->parallel_apply_analysis = options.at( "parallel-apply-analysis" ).as<bool>();
+      my->chain_config->fork_switch_delta_size = uint64_t(options.at( "fork-switch-delta-size-kb" ).as<uint32_t>()) * 1024;
+      my->chain_config->irreversible_step_time_us = options.at( "irreversible-step-time-us" ).as<uint32_t>();
+      my->chain_config->irreversible_undo_free = options.at( "irreversible-undo-free" ).as<bool>();
 
       if( options.count( "extract-genesis-json" ) || options.at( "print-genesis-json" ).as<bool>()) {
          fc::optional<genesis_state> gs;
@@ -799,14 +1094,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
             wlog( "The --truncate-at-block option does not work for a regular replay of the blockchain." );
          clear_chainbase_files( my->chain_config->state_dir );
          if( options.at( "fix-reversible-blocks" ).as<bool>()) {
-            if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
-                                            my->chain_config->reversible_cache_size )) {
+            if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name )) {
                ilog( "Reversible blocks database was not corrupted." );
             }
          }
       } else if( options.at( "fix-reversible-blocks" ).as<bool>()) {
          if( !recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
-                                         my->chain_config->reversible_cache_size,
                                          optional<fc::path>(),
                                          options.at( "truncate-at-block" ).as<uint32_t>())) {
             ilog( "Reversible blocks database verified to not be corrupted. Now exiting..." );
@@ -821,8 +1114,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          ilog("Importing reversible blocks from '${file}'", ("file", reversible_blocks_file.generic_string()) );
          fc::remove_all( my->chain_config->blocks_dir/config::reversible_blocks_dir_name );
 
-         import_reversible_blocks( my->chain_config->blocks_dir/config::reversible_blocks_dir_name,
-                                   my->chain_config->reversible_cache_size, reversible_blocks_file );
+         import_reversible_blocks( my->chain_config->blocks_dir/config::reversible_blocks_dir_name, reversible_blocks_file );
 
          EOS_THROW( node_management_success, "imported reversible blocks" );
       }
@@ -831,24 +1123,71 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          wlog("The --import-reversible-blocks option should be used by itself.");
       }
 
+      if( options.at( "trx-trace-sample-one-in" ).as<uint32_t>() > 0 ) {
+         auto ttf = options.at( "trx-trace-file" ).as<bfs::path>();
+         transaction_tracing::instance().configure( options.at( "trx-trace-sample-one-in" ).as<uint32_t>(),
+                                                    ttf.is_relative() ? app().data_dir() / ttf : ttf );
+      }
+
+      auto scd = options.at( "state-checkpoints-dir" ).as<bfs::path>();
+      my->state_checkpoints_dir = scd.is_relative() ? app().data_dir() / scd : scd;
+
+      // the state in use marker outlives an unclean shutdown, chainbase then refuses the dirty database
+      fc::optional<bfs::path> recovery_checkpoint;
+      if( options.at( "state-checkpoint-recovery" ).as<bool>() && !options.count( "snapshot" ) &&
+          fc::exists( state_in_use_marker( my->chain_config->state_dir ) ) ) {
+         recovery_checkpoint = latest_state_checkpoint( my->state_checkpoints_dir );
+         if( recovery_checkpoint ) {
+            wlog( "state database was not closed cleanly, restarting from state checkpoint ${c}",
+                  ("c", recovery_checkpoint->generic_string()) );
+            clear_chainbase_files( my->chain_config->state_dir );
+            fc::remove( state_in_use_marker( my->chain_config->state_dir ) );
+         } else {
+            wlog( "state database was not closed cleanly and there is no state checkpoint in ${d}",
+                  ("d", my->state_checkpoints_dir.generic_string()) );
+         }
+      }
+
       fc::optional<chain_id_type> chain_id;
-      if (options.count( "snapshot" )) {
-         my->snapshot_path = options.at( "snapshot" ).as<bfs::path>();
+      if (options.count( "snapshot" ) || recovery_checkpoint) {
+         my->snapshot_path = recovery_checkpoint ? *recovery_checkpoint : options.at( "snapshot" ).as<bfs::path>();
          EOS_ASSERT( fc::exists(*my->snapshot_path), plugin_config_exception,
                      "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()) );
 
+         if (!recovery_checkpoint && options.count( "snapshot-delta" )) {
+            const auto& deltas = options.at( "snapshot-delta" ).as<vector<bfs::path>>();
+            const bfs::path rebuilt = app().data_dir() / "snapshot-from-deltas.bin";
+            for( size_t i = 0; i < deltas.size(); ++i ) {
+               EOS_ASSERT( fc::exists(deltas[i]), plugin_config_exception,
+                           "Cannot load snapshot delta, ${name} does not exist", ("name", deltas[i].generic_string()) );
+               ilog( "applying snapshot delta ${d}", ("d", deltas[i].generic_string()) );
+               const bfs::path temp = rebuilt.generic_string() + "." + std::to_string(i);
+               {
+                  auto base_in = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
+                  auto delta_in = std::ifstream(deltas[i].generic_string(), (std::ios::in | std::ios::binary));
+                  auto out = std::ofstream(temp.generic_string(), (std::ios::out | std::ios::binary | std::ios::trunc));
+                  snapshot_delta::apply(base_in, delta_in, out);
+               }
+               if( i > 0 ) bfs::remove(*my->snapshot_path);
+               my->snapshot_path = temp;
+            }
+            bfs::rename(*my->snapshot_path, rebuilt);
+            my->snapshot_path = rebuilt;
+         }
+
          // recover genesis information from the snapshot
          // used for validation code below
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         istream_snapshot_reader reader(infile);
-         reader.validate();
-         chain_id = controller::extract_chain_id(reader);
+         auto reader = make_istream_snapshot_reader(infile);
+         reader->validate();
+         chain_id = controller::extract_chain_id(*reader);
          infile.close();
 
-         EOS_ASSERT( options.count( "genesis-timestamp" ) == 0,
+         // a configured genesis is left in place to restart from checkpoints, it was checked when the chain was created
+         EOS_ASSERT( recovery_checkpoint || options.count( "genesis-timestamp" ) == 0,
                  plugin_config_exception,
                  "--snapshot is incompatible with --genesis-timestamp as the snapshot contains genesis information");
-         EOS_ASSERT( options.count( "genesis-json" ) == 0,
+         EOS_ASSERT( recovery_checkpoint || options.count( "genesis-json" ) == 0,
                      plugin_config_exception,
                      "--snapshot is incompatible with --genesis-json as the snapshot contains genesis information");
 
@@ -991,6 +1330,9 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if ( options.count("read-mode") ) {
          my->chain_config->read_mode = options.at("read-mode").as<db_read_mode>();
       }
+      if( my->chain_config->irreversible_undo_free && my->chain_config->read_mode != db_read_mode::IRREVERSIBLE ) {
+         wlog( "irreversible-undo-free is ignored outside of the irreversible read mode" );
+      }
 
       if ( options.count("validation-mode") ) {
          my->chain_config->block_validation_mode = options.at("validation-mode").as<validation_mode>();
@@ -1000,6 +1342,10 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 #ifdef __linux__
       if( options.count("database-hugepage-path") )
          my->chain_config->db_hugepage_paths = options.at("database-hugepage-path").as<std::vector<std::string>>();
+      my->chain_config->db_memory.prefetch = options.at("database-prefetch").as<bool>();
+      my->chain_config->db_memory.transparent_hugepages = options.at("database-transparent-hugepages").as<bool>();
+      my->chain_config->db_memory.numa_node = options.at("database-numa-node").as<int32_t>();
+      my->chain_config->db_memory.load_threads = options.at("database-load-threads").as<uint32_t>();
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -1009,6 +1355,43 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->eosvmoc_config.threads = options.at("eos-vm-oc-compile-threads").as<uint64_t>();
       if( options["eos-vm-oc-enable"].as<bool>() )
          my->chain_config->eosvmoc_tierup = true;
+      if( options.count("eos-vm-oc-compile-cpus") )
+         eosvmoc::set_compile_monitor_affinity( parse_cpu_list( options.at("eos-vm-oc-compile-cpus").as<string>() ) );
+      if( options.count("eos-vm-oc-warm-up-codes") )
+         my->chain_config->eosvmoc_config.warm_up_codes = options.at("eos-vm-oc-warm-up-codes").as<uint32_t>();
+      if( options.count("eos-vm-oc-execution-slices") ) {
+         my->chain_config->eosvmoc_config.execution_slices = options.at("eos-vm-oc-execution-slices").as<uint32_t>();
+         EOS_ASSERT( my->chain_config->eosvmoc_config.execution_slices > 0, plugin_config_exception,
+                     "eos-vm-oc-execution-slices must be at least 1" );
+      }
+      if( options.count("eos-vm-oc-opt-level") ) {
+         const uint32_t opt_level = options.at("eos-vm-oc-opt-level").as<uint32_t>();
+         EOS_ASSERT( opt_level <= eosvmoc::max_opt_level, plugin_config_exception,
+                     "eos-vm-oc-opt-level must be at most ${m}", ("m", eosvmoc::max_opt_level) );
+         my->chain_config->eosvmoc_config.opt_level = opt_level;
+      }
+      if( options.count("eos-vm-oc-hot-opt-level") ) {
+         const uint32_t hot_opt_level = options.at("eos-vm-oc-hot-opt-level").as<uint32_t>();
+         EOS_ASSERT( hot_opt_level <= eosvmoc::max_opt_level, plugin_config_exception,
+                     "eos-vm-oc-hot-opt-level must be at most ${m}", ("m", eosvmoc::max_opt_level) );
+         my->chain_config->eosvmoc_config.hot_opt_level = hot_opt_level;
+      }
+      if( options.count("eos-vm-oc-hot-recompile-executions") ) {
+         my->chain_config->eosvmoc_config.hot_recompile_executions = options.at("eos-vm-oc-hot-recompile-executions").as<uint32_t>();
+         EOS_ASSERT( my->chain_config->eosvmoc_config.hot_recompile_executions > 0, plugin_config_exception,
+                     "eos-vm-oc-hot-recompile-executions must be non-zero" );
+      }
+      if( options.count("eos-vm-oc-cache-mode") )
+         my->chain_config->eosvmoc_config.mode = options.at("eos-vm-oc-cache-mode").as<eosvmoc::cache_mode>();
+      if( options.count("eos-vm-oc-cache-dir") ) {
+         auto cd = options.at("eos-vm-oc-cache-dir").as<bfs::path>();
+         if( cd.is_relative() )
+            my->chain_config->eosvmoc_config.cache_dir = app().data_dir() / cd;
+         else
+            my->chain_config->eosvmoc_config.cache_dir = cd;
+      }
+      EOS_ASSERT( my->chain_config->eosvmoc_config.mode != eosvmoc::cache_mode::shared_reader || my->chain_config->eosvmoc_tierup,
+                  plugin_config_exception, "eos-vm-oc-cache-mode shared-reader requires eos-vm-oc-enable" );
 #endif
 
       my->chain.emplace( *my->chain_config, std::move(pfs), *chain_id );
@@ -1052,11 +1435,36 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
                my->accepted_block_header_channel.publish( priority::medium, blk );
             } );
 
+      if( options.at( "producers-view" ).as<bool>() ) {
+         my->producers.emplace( *my->chain, my->abi_serializer_max_time_ms );
+      }
+      if( options.at( "account-summary-cache-size" ).as<uint32_t>() > 0 ) {
+         my->account_summaries.emplace( *my->chain, my->abi_serializer_max_time_ms, options.at( "account-summary-cache-size" ).as<uint32_t>() );
+      }
+      if( options.at( "transaction-prevalidation" ).as<bool>() ) {
+         my->prevalidator.emplace();
+      }
+      if( options.at( "transaction-status-window-sec" ).as<uint32_t>() > 0 ) {
+         my->trx_statuses.emplace( fc::seconds( options.at( "transaction-status-window-sec" ).as<uint32_t>() ) );
+      }
+      if( options.at( "key-account-index" ).as<bool>() ) {
+         EOS_ASSERT( my->chain->get_read_mode() != db_read_mode::IRREVERSIBLE, plugin_config_exception,
+                     "key-account-index needs the undo state of reversible blocks, it cannot be used in irreversible read mode" );
+         my->key_accounts.emplace( *my->chain );
+      }
+
       my->accepted_block_connection = my->chain->accepted_block.connect( [this]( const block_state_ptr& blk ) {
+         if( my->producers ) my->producers->on_accepted_block( blk );
+         if( my->account_summaries ) my->account_summaries->on_accepted_block( blk );
+         if( my->trx_statuses ) my->trx_statuses->on_accepted_block( blk );
+         if( my->key_accounts ) my->key_accounts->on_accepted_block( blk );
+         if( my->prevalidator ) my->prevalidator->on_accepted_block( blk, my->chain->get_global_properties().configuration );
          my->accepted_block_channel.publish( priority::high, blk );
       } );
 
       my->irreversible_block_connection = my->chain->irreversible_block.connect( [this]( const block_state_ptr& blk ) {
+         if( my->trx_statuses ) my->trx_statuses->on_irreversible_block( blk );
+         if( my->key_accounts ) my->key_accounts->on_irreversible_block( blk );
          my->irreversible_block_channel.publish( priority::low, blk );
       } );
 
@@ -1067,6 +1475,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
       my->applied_transaction_connection = my->chain->applied_transaction.connect(
             [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+               if( my->trx_statuses ) my->trx_statuses->on_applied_transaction( std::get<0>(t) );
                my->applied_transaction_channel.publish( priority::low, std::get<0>(t) );
             } );
 
@@ -1077,11 +1486,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
 void chain_plugin::plugin_startup()
 { try {
+   startup_timeline::scope phase( "chain_plugin startup" );
    try {
       auto shutdown = [](){ return app().is_quiting(); };
       if (my->snapshot_path) {
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
+         auto reader = make_istream_snapshot_reader(infile);
          my->chain->startup(shutdown, reader);
          infile.close();
       } else if( my->genesis ) {
@@ -1094,6 +1504,25 @@ void chain_plugin::plugin_startup()
       // make sure to properly close the db
       my->chain.reset();
       throw;
+   } catch (const state_unrecoverable_exception& e) {
+      // the db is left dirty by plugin_shutdown
+      elog("${details}", ("details", e.to_detail_string()));
+      throw;
+   }
+
+   if( !my->readonly ) {
+      my->state_in_use = state_in_use_marker( my->chain_config->state_dir );
+      std::ofstream( my->state_in_use->generic_string() );
+   }
+
+   if( my->prevalidator ) {
+      my->prevalidator->reset( my->chain->db(), my->chain->head_block_state(), my->chain->get_global_properties().configuration );
+   }
+
+   if( my->key_accounts ) {
+      startup_timeline::scope index_phase( "build key account index" );
+      my->key_accounts->rebuild();
+      ilog( "key account index holds ${n} permissions", ("n", my->key_accounts->size()) );
    }
 
    if(!my->readonly) {
@@ -1112,15 +1541,31 @@ void chain_plugin::plugin_startup()
 } FC_CAPTURE_AND_RETHROW() }
 
 void chain_plugin::plugin_shutdown() {
+   ilog( "signature recovery cache: ${s}", ("s", signature_recovery_cache::instance().get_stats()) );
+   ilog( "abi serializer cache: ${s}", ("s", abi_serializer_cache::instance().get_stats()) );
+   ilog( "key string cache: ${s}", ("s", key_string_cache::instance().get_stats()) );
+   for( const auto& lane : shared_thread_pool::instance().get_stats() )
+      ilog( "shared thread pool: ${s}", ("s", lane) );
    my->pre_accepted_block_connection.reset();
    my->accepted_block_header_connection.reset();
    my->accepted_block_connection.reset();
    my->irreversible_block_connection.reset();
    my->accepted_transaction_connection.reset();
    my->applied_transaction_connection.reset();
+   if( my->chain && my->chain->state_unrecoverable() ) {
+      // closing the controller would flush the state database and clear its dirty flag, the next start has to
+      // replay or load a snapshot instead
+      elog( "leaving the state database dirty, restart with a replay or from a snapshot" );
+      my->chain.release();
+      transaction_tracing::instance().shutdown();
+      return;
+   }
    if(app().is_quiting())
       my->chain->get_wasm_interface().indicate_shutting_down();
    my->chain.reset();
+   if( my->state_in_use )
+      fc::remove( *my->state_in_use );
+   transaction_tracing::instance().shutdown();
 }
 
 chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time)
@@ -1141,31 +1586,30 @@ void chain_plugin::accept_transaction(const chain::packed_transaction_ptr& trx,
    my->incoming_transaction_async_method(trx, false, std::move(next));
 }
 
+void chain_plugin::prevalidate_transaction( const chain::packed_transaction& trx )const {
+   if( my->prevalidator ) my->prevalidator->validate( trx );
+}
+
 bool chain_plugin::block_is_on_preferred_chain(const block_id_type& block_id) {
    auto b = chain().fetch_block_by_number( block_header::num_from_id(block_id) );
    return b && b->id() == block_id;
 }
 
-bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t cache_size,
-                                              optional<fc::path> new_db_dir, uint32_t truncate_at_block ) {
+bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, optional<fc::path> new_db_dir, uint32_t truncate_at_block ) {
    try {
-      chainbase::database reversible( db_dir, database::read_only); // Test if dirty
-      // If it reaches here, then the reversible database is not dirty
+      reversible_block_log reversible( db_dir, true ); // Test if a block was cut short
+      if( !reversible.dropped_partial_block() ) {
+         // If it reaches here, then the reversible block log is not corrupted
 
-      if( truncate_at_block == 0 )
-         return false;
+         if( truncate_at_block == 0 )
+            return false;
 
-      reversible.add_index<reversible_block_index>();
-      const auto& ubi = reversible.get_index<reversible_block_index,by_num>();
-
-      auto itr = ubi.rbegin();
-      if( itr != ubi.rend() && itr->blocknum <= truncate_at_block )
-         return false; // Because we are not going to be truncating the reversible database at all.
-   } catch( const std::runtime_error& ) {
-   } catch( ... ) {
-      throw;
+         if( !reversible.empty() && reversible.last_block_num() <= truncate_at_block )
+            return false; // Because we are not going to be truncating the reversible block log at all.
+      }
+   } catch( const reversible_blocks_exception& ) {
    }
-   // Reversible block database is dirty (or incompatible). So back it up (unless already moved) and then create a new one.
+   // Reversible block log is corrupted (or incompatible). So back it up (unless already moved) and then create a new one.
 
    auto reversible_dir = fc::canonical( db_dir );
    if( reversible_dir.filename().generic_string() == "." ) {
@@ -1196,17 +1640,17 @@ bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t c
 
    ilog( "Reconstructing '${reversible_dir}' from backed up reversible directory", ("reversible_dir", reversible_dir) );
 
-   optional<chainbase::database> old_reversible;
+   optional<reversible_block_log> old_reversible;
 
    try {
-      old_reversible = chainbase::database( backup_dir, database::read_only, 0, true );
-   } catch (const std::runtime_error &) {
-      // since we are allowing for dirty, it must be incompatible
-      ilog( "Did not recover any reversible blocks since reversible database incompatible");
+      old_reversible.emplace( backup_dir, true );
+   } catch( const reversible_blocks_exception& ) {
+      // the blocks cut short are skipped by the scan, it must be incompatible
+      ilog( "Did not recover any reversible blocks since reversible block log incompatible");
       return true;
    }
 
-   chainbase::database  new_reversible( reversible_dir, database::read_write, cache_size );
+   reversible_block_log new_reversible( reversible_dir );
    std::fstream         reversible_blocks;
    reversible_blocks.open( (reversible_dir.parent_path() / std::string("portable-reversible-blocks-").append( now ) ).generic_string().c_str(),
                            std::ios::out | std::ios::binary );
@@ -1214,57 +1658,47 @@ bool chain_plugin::recover_reversible_blocks( const fc::path& db_dir, uint32_t c
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   old_reversible->add_index<reversible_block_index>();
-   new_reversible.add_index<reversible_block_index>();
-   const auto& ubi = old_reversible->get_index<reversible_block_index,by_num>();
-   auto itr = ubi.begin();
-   if( itr != ubi.end() ) {
-      start = itr->blocknum;
+   if( !old_reversible->empty() ) {
+      start = old_reversible->first_block_num();
       end = start - 1;
    }
    if( truncate_at_block > 0 && start > truncate_at_block ) {
-      ilog( "Did not recover any reversible blocks since the specified block number to stop at (${stop}) is less than first block in the reversible database (${start}).", ("stop", truncate_at_block)("start", start) );
+      ilog( "Did not recover any reversible blocks since the specified block number to stop at (${stop}) is less than first block in the reversible block log (${start}).", ("stop", truncate_at_block)("start", start) );
       return true;
    }
    try {
-      for( ; itr != ubi.end(); ++itr ) {
-         EOS_ASSERT( itr->blocknum == end + 1, gap_in_reversible_blocks_db,
-                     "gap in reversible block database between ${end} and ${blocknum}",
-                     ("end", end)("blocknum", itr->blocknum)
-                   );
-         reversible_blocks.write( itr->packedblock.data(), itr->packedblock.size() );
-         new_reversible.create<reversible_block_object>( [&]( auto& ubo ) {
-            ubo.blocknum = itr->blocknum;
-            ubo.set_block( itr->get_block() ); // get_block and set_block rather than copying the packed data acts as additional validation
-         });
-         end = itr->blocknum;
+      for( ; !old_reversible->empty() && end < old_reversible->last_block_num(); ) {
+         const auto packed = old_reversible->read_serialized_block( end + 1 );
+         auto b = std::make_shared<signed_block>();
+         fc::datastream<const char*> ds( packed.data(), packed.size() );
+         fc::raw::unpack( ds, *b ); // unpacking rather than copying the packed data acts as additional validation
+         reversible_blocks.write( packed.data(), packed.size() );
+         new_reversible.append( b );
+         end = b->block_num();
          ++num;
          if( end == truncate_at_block )
             break;
       }
-   } catch( const gap_in_reversible_blocks_db& e ) {
-      wlog( "${details}", ("details", e.to_detail_string()) );
    } catch( ... ) {}
 
    if( end == truncate_at_block )
       ilog( "Stopped recovery of reversible blocks early at specified block number: ${stop}", ("stop", truncate_at_block) );
 
    if( num == 0 )
-      ilog( "There were no recoverable blocks in the reversible block database" );
+      ilog( "There were no recoverable blocks in the reversible block log" );
    else if( num == 1 )
-      ilog( "Recovered 1 block from reversible block database: block ${start}", ("start", start) );
+      ilog( "Recovered 1 block from reversible block log: block ${start}", ("start", start) );
    else
-      ilog( "Recovered ${num} blocks from reversible block database: blocks ${start} to ${end}",
+      ilog( "Recovered ${num} blocks from reversible block log: blocks ${start} to ${end}",
             ("num", num)("start", start)("end", end) );
 
    return true;
 }
 
 bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
-                                             uint32_t cache_size,
                                              const fc::path& reversible_blocks_file ) {
    std::fstream         reversible_blocks;
-   chainbase::database  new_reversible( reversible_dir, database::read_write, cache_size );
+   reversible_block_log new_reversible( reversible_dir );
    reversible_blocks.open( reversible_blocks_file.generic_string().c_str(), std::ios::in | std::ios::binary );
 
    reversible_blocks.seekg( 0, std::ios::end );
@@ -1274,7 +1708,6 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   new_reversible.add_index<reversible_block_index>();
    try {
       while( reversible_blocks.tellg() < end_pos ) {
          signed_block tmp;
@@ -1290,10 +1723,7 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
                       );
          }
 
-         new_reversible.create<reversible_block_object>( [&]( auto& ubo ) {
-            ubo.blocknum = num;
-            ubo.set_block( std::make_shared<signed_block>(std::move(tmp)) );
-         });
+         new_reversible.append( std::make_shared<signed_block>(std::move(tmp)) );
          end = num;
       }
    } catch( gap_in_reversible_blocks_db& e ) {
@@ -1311,48 +1741,40 @@ bool chain_plugin::import_reversible_blocks( const fc::path& reversible_dir,
 
 bool chain_plugin::export_reversible_blocks( const fc::path& reversible_dir,
                                              const fc::path& reversible_blocks_file ) {
-   chainbase::database  reversible( reversible_dir, database::read_only, 0, true );
+   reversible_block_log reversible( reversible_dir, true );
    std::fstream         reversible_blocks;
    reversible_blocks.open( reversible_blocks_file.generic_string().c_str(), std::ios::out | std::ios::binary );
 
    uint32_t num = 0;
    uint32_t start = 0;
    uint32_t end = 0;
-   reversible.add_index<reversible_block_index>();
-   const auto& ubi = reversible.get_index<reversible_block_index,by_num>();
-   auto itr = ubi.begin();
-   if( itr != ubi.end() ) {
-      start = itr->blocknum;
+   if( !reversible.empty() ) {
+      start = reversible.first_block_num();
       end = start - 1;
    }
    try {
-      for( ; itr != ubi.end(); ++itr ) {
-         EOS_ASSERT( itr->blocknum == end + 1, gap_in_reversible_blocks_db,
-                     "gap in reversible block database between ${end} and ${blocknum}",
-                     ("end", end)("blocknum", itr->blocknum)
-                   );
+      for( ; !reversible.empty() && end < reversible.last_block_num(); ) {
+         const auto packed = reversible.read_serialized_block( end + 1 );
          signed_block tmp;
-         fc::datastream<const char *> ds( itr->packedblock.data(), itr->packedblock.size() );
+         fc::datastream<const char *> ds( packed.data(), packed.size() );
          fc::raw::unpack(ds, tmp); // Verify that packed block has not been corrupted.
-         reversible_blocks.write( itr->packedblock.data(), itr->packedblock.size() );
-         end = itr->blocknum;
+         reversible_blocks.write( packed.data(), packed.size() );
+         end = tmp.block_num();
          ++num;
       }
-   } catch( const gap_in_reversible_blocks_db& e ) {
-      wlog( "${details}", ("details", e.to_detail_string()) );
    } catch( ... ) {}
 
    if( num == 0 ) {
-      ilog( "There were no recoverable blocks in the reversible block database" );
+      ilog( "There were no recoverable blocks in the reversible block log" );
       return false;
    }
    else if( num == 1 )
-      ilog( "Exported 1 block from reversible block database: block ${start}", ("start", start) );
+      ilog( "Exported 1 block from reversible block log: block ${start}", ("start", start) );
    else
-      ilog( "Exported ${num} blocks from reversible block database: blocks ${start} to ${end}",
+      ilog( "Exported ${num} blocks from reversible block log: blocks ${start} to ${end}",
             ("num", num)("start", start)("end", end) );
 
-   return (end >= start) && ((end - start + 1) == num);
+   return !reversible.dropped_partial_block() && (end >= start) && ((end - start + 1) == num);
 }
 
 controller& chain_plugin::chain() { return *my->chain; }
@@ -1366,6 +1788,26 @@ fc::microseconds chain_plugin::get_abi_serializer_max_time() const {
    return my->abi_serializer_max_time_ms;
 }
 
+const chain_apis::producers_view* chain_plugin::get_producers_view() const {
+   return my->producers ? &*my->producers : nullptr;
+}
+
+chain_apis::account_summary_cache* chain_plugin::get_account_summary_cache() const {
+   return my->account_summaries ? &*my->account_summaries : nullptr;
+}
+
+const chain_apis::transaction_status_cache* chain_plugin::get_transaction_status_cache() const {
+   return my->trx_statuses ? &*my->trx_statuses : nullptr;
+}
+
+const chain_apis::key_account_index* chain_plugin::get_key_account_index() const {
+   return my->key_accounts ? &*my->key_accounts : nullptr;
+}
+
+const bfs::path& chain_plugin::get_state_checkpoints_dir() const {
+   return my->state_checkpoints_dir;
+}
+
 void chain_plugin::log_guard_exception(const chain::guard_exception&e ) {
    if (e.code() == chain::database_guard_exception::code_value) {
       elog("Database has reached an unsafe level of usage, shutting down to avoid corrupting the database.  "
@@ -1386,6 +1828,13 @@ void chain_plugin::handle_guard_exception(const chain::guard_exception& e) {
    app().quit();
 }
 
+void chain_plugin::handle_state_unrecoverable(const chain::state_unrecoverable_exception& e) {
+   elog("${details}", ("details", e.to_detail_string()));
+   elog("state database changed by a failed block, quitting...");
+   // plugin_shutdown leaves the state database dirty
+   app().quit();
+}
+
 void chain_plugin::handle_db_exhaustion() {
    elog("database memory exhausted: increase chain-state-db-size-mb and/or reversible-blocks-db-size-mb");
    //return 1 -- it's what programs/nodeos/main.cpp considers "BAD_ALLOC"
@@ -1646,14 +2095,154 @@ string get_table_type( const abi_def& abi, const name& table_name ) {
    EOS_ASSERT( false, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table",table_name) );
 }
 
+namespace {
+   /// @return the field at path, array elements selected by their index, nullptr if the row has no such field
+   const fc::variant* find_table_row_field( const fc::variant& row, const string& path ) {
+      const fc::variant* v = &row;
+      for( size_t pos = 0; pos <= path.size(); ) {
+         size_t end = path.find( '.', pos );
+         if( end == string::npos ) end = path.size();
+         const string key = path.substr( pos, end - pos );
+         if( v->is_object() ) {
+            const auto& obj = v->get_object();
+            auto itr = obj.find( key );
+            if( itr == obj.end() ) return nullptr;
+            v = &itr->value();
+         } else if( v->is_array() ) {
+            if( key.empty() || key.find_first_not_of( "0123456789" ) != string::npos ) return nullptr;
+            const auto& arr = v->get_array();
+            const auto i = std::stoull( key );
+            if( i >= arr.size() ) return nullptr;
+            v = &arr[i];
+         } else {
+            return nullptr;
+         }
+         pos = end + 1;
+      }
+      return v;
+   }
+
+   bool is_decimal_string( const fc::variant& v ) {
+      return v.is_string() && v.get_string().find_first_of( ".eE" ) != string::npos;
+   }
+
+   __int128 to_int128( const fc::variant& v ) {
+      if( v.is_uint64() ) return v.as_uint64();
+      if( v.is_string() && !v.get_string().empty() && v.get_string()[0] != '-' ) return v.as_uint64();
+      return v.as_int64();
+   }
+
+   /// @return <0, 0 or >0 as a is less than, equal to or greater than b, nothing if they cannot be ordered
+   optional<int> compare_table_row_values( const fc::variant& a, const fc::variant& b ) {
+      try {
+         if( a.is_bool() || b.is_bool() ) {
+            return int(a.as_bool()) - int(b.as_bool());
+         }
+         if( a.is_numeric() || b.is_numeric() ) {
+            if( a.is_double() || b.is_double() || is_decimal_string( a ) || is_decimal_string( b ) ) {
+               const double x = a.as_double(), y = b.as_double();
+               return x < y ? -1 : ( y < x ? 1 : 0 );
+            }
+            const __int128 x = to_int128( a ), y = to_int128( b );
+            return x < y ? -1 : ( y < x ? 1 : 0 );
+         }
+         if( a.is_string() && b.is_string() ) {
+            const auto& x = a.get_string();
+            const auto& y = b.get_string();
+            // assets, e.g. "10.0000 EOS", compare by amount
+            if( x.find( ' ' ) != string::npos && y.find( ' ' ) != string::npos ) {
+               try {
+                  const auto ax = asset::from_string( x ), ay = asset::from_string( y );
+                  if( ax.get_symbol() == ay.get_symbol() )
+                     return ax.get_amount() < ay.get_amount() ? -1 : ( ay.get_amount() < ax.get_amount() ? 1 : 0 );
+               } catch( const fc::exception& ) {}
+            }
+            return x.compare( y );
+         }
+      } catch( const fc::exception& ) {
+         return {};
+      }
+      if( fc::json::to_string( a ) == fc::json::to_string( b ) )
+         return 0;
+      return {};
+   }
+
+   bool is_table_row_filter_op( const string& op ) {
+      return op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=";
+   }
+
+   void set_projected_field( fc::mutable_variant_object& out, const string& path, fc::variant value ) {
+      const auto dot = path.find( '.' );
+      if( dot == string::npos ) {
+         out.set( path, std::move(value) );
+         return;
+      }
+      const string key = path.substr( 0, dot );
+      fc::mutable_variant_object child;
+      auto itr = out.find( key );
+      if( itr != out.end() && itr->value().is_object() )
+         child = fc::mutable_variant_object( itr->value().get_object() );
+      set_projected_field( child, path.substr( dot + 1 ), std::move(value) );
+      out.set( key, std::move(child) );
+   }
+}
+
+void read_only::validate_table_row_filters( const read_only::get_table_rows_params& p ) {
+   if( p.filters.empty() && p.fields.empty() ) return;
+   EOS_ASSERT( p.json, chain::contract_table_query_exception, "filters and fields apply to json rows only" );
+   EOS_ASSERT( p.filters.size() <= max_table_row_filters, chain::contract_table_query_exception,
+               "At most ${max} filters, got ${n}", ("max", max_table_row_filters)("n", p.filters.size()) );
+   for( const auto& f : p.filters ) {
+      EOS_ASSERT( !f.field.empty(), chain::contract_table_query_exception, "filter without a field" );
+      EOS_ASSERT( is_table_row_filter_op( f.op ), chain::contract_table_query_exception,
+                  "Invalid filter op ${op} of ${field}, expected ==, !=, <, <=, > or >=", ("op", f.op)("field", f.field) );
+   }
+   for( const auto& field : p.fields )
+      EOS_ASSERT( !field.empty(), chain::contract_table_query_exception, "empty field path" );
+}
+
+bool read_only::table_row_matches( const fc::variant& row, const vector<table_row_filter>& filters ) {
+   for( const auto& f : filters ) {
+      const auto* v = find_table_row_field( row, f.field );
+      if( !v ) return false;
+      const auto c = compare_table_row_values( *v, f.value );
+      if( f.op == "!=" ) {
+         if( c && *c == 0 ) return false;
+         continue;
+      }
+      if( !c ) return false;
+      const bool match = f.op == "==" ? *c == 0 :
+                         f.op == "<"  ? *c < 0  :
+                         f.op == "<=" ? *c <= 0 :
+                         f.op == ">"  ? *c > 0  :
+                                        *c >= 0;
+      if( !match ) return false;
+   }
+   return true;
+}
+
+fc::variant read_only::project_table_row( const fc::variant& row, const vector<string>& fields ) {
+   fc::mutable_variant_object result;
+   for( const auto& path : fields ) {
+      if( const auto* v = find_table_row_field( row, path ) )
+         set_projected_field( result, path, *v );
+   }
+   return fc::variant( std::move(result) );
+}
+
 read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
+   validate_table_row_filters( p );
+   // binary rows are returned without looking at the ABI
+   const abi_def abi = p.json ? eosio::chain_apis::get_abi( db, p.code ) : abi_def();
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
    bool primary = false;
    auto table_with_index = get_table_index_name( p, primary );
    if( primary ) {
       EOS_ASSERT( p.table == table_with_index, chain::contract_table_query_exception, "Invalid table name ${t}", ( "t", p.table ));
+      if( !p.json ) {
+         return get_table_rows_ex<key_value_index>(p,abi);
+      }
       auto table_type = get_table_type( abi, p.table );
       if( table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name" ) {
          return get_table_rows_ex<key_value_index>(p,abi);
@@ -1712,6 +2301,29 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
 #pragma GCC diagnostic pop
 }
 
+bytes read_only::get_table_rows_packed( const read_only::get_table_rows_params& p )const {
+   get_table_rows_params binary_params = p;
+   binary_params.json = false;
+   auto rows = get_table_rows( binary_params );
+
+   get_table_rows_packed_result result;
+   const bool show_payer = p.show_payer && *p.show_payer;
+   result.rows.reserve( rows.rows.size() );
+   for( const auto& row : rows.rows ) {
+      if( show_payer ) {
+         const auto& obj = row.get_object();
+         result.rows.emplace_back( obj["data"].as<bytes>() );
+         result.payers.emplace_back( obj["payer"].as<name>() );
+      } else {
+         result.rows.emplace_back( row.as<bytes>() );
+      }
+   }
+   result.more = rows.more;
+   result.next_key = std::move( rows.next_key );
+   result.next_continuation = std::move( rows.next_continuation );
+   return fc::raw::pack( result );
+}
+
 read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_only::get_table_by_scope_params& p )const {
    read_only::get_table_by_scope_result result;
    const auto& d = db.db();
@@ -1731,6 +2343,13 @@ read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_o
       std::get<1>(upper_bound_lookup_tuple) = name(scope);
    }
 
+   if( p.continuation.size() ) {
+      const auto c = decode_continuation<scope_continuation>( p.continuation );
+      auto& bound = (p.reverse && *p.reverse) ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+      std::get<1>(bound) = c.scope;
+      std::get<2>(bound) = c.table;
+   }
+
    if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
       return result;
 
@@ -1746,6 +2365,7 @@ read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_o
       }
       if( itr != end_itr ) {
          result.more = itr->scope.to_string();
+         result.next_continuation = encode_continuation( scope_continuation{ itr->scope, itr->table } );
       }
    };
 
@@ -1827,10 +2447,41 @@ fc::variant get_global_row( const database& db, const abi_def& abi, const abi_se
    return abis.binary_to_variant(abis.get_table_type(N(global)), data, abi_serializer_max_time_ms, shorten_abi_errors );
 }
 
+optional<read_only::get_producers_result> read_only::get_producers_from_view( const read_only::get_producers_params& p ) const {
+   if( !producers ) return {};
+   auto s = producers->get_state();
+   if( !s ) return {};
+
+   read_only::get_producers_result result;
+   const auto lower = name{p.lower_bound}.to_uint64_t();
+   // same starting row as the by_secondary walk of get_producers: the first producer at or after lower in owner order
+   auto it = s->by_votes.begin();
+   if( lower != 0 ) {
+      auto key_itr = s->votes_key.lower_bound( lower );
+      it = key_itr == s->votes_key.end() ? s->by_votes.end()
+                                         : s->by_votes.find( std::make_pair(key_itr->second, key_itr->first) );
+   }
+   for( ; it != s->by_votes.end(); ++it ) {
+      if( result.rows.size() >= p.limit ) {
+         result.more = it->second->owner.to_string();
+         break;
+      }
+      if( p.json )
+         result.rows.emplace_back( it->second->json );
+      else
+         result.rows.emplace_back( fc::variant(it->second->data) );
+   }
+   result.total_producer_vote_weight = s->total_producer_vote_weight;
+   return result;
+}
+
 read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const try {
+   if( auto result = get_producers_from_view( p ) ) return std::move( *result );
+
    const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{ abi, abi_serializer_max_time };
+   const auto abis_ptr = abi_serializer_cache::instance().get(db.db(), config::system_account_name, abi_serializer_max_time);
+   const abi_serializer& abis = *abis_ptr;
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type",table_type));
 
    const auto& d = db.db();
@@ -1911,19 +2562,67 @@ read_only::get_producer_schedule_result read_only::get_producer_schedule( const
    return result;
 }
 
+read_only::get_wasm_cache_stats_result read_only::get_wasm_cache_stats( const read_only::get_wasm_cache_stats_params& ) const {
+   return db.get_wasm_cache_stats();
+}
+
+read_only::get_thread_placement_result read_only::get_thread_placement( const read_only::get_thread_placement_params& ) const {
+   return { thread_placement::instance().get() };
+}
+
+read_only::get_startup_timing_result read_only::get_startup_timing( const read_only::get_startup_timing_params& ) const {
+   return { startup_timeline::instance().get() };
+}
+
+read_only::get_memory_usage_result read_only::get_memory_usage( const read_only::get_memory_usage_params& ) const {
+   return memory_accounting::get_usage();
+}
+
+read_only::get_action_stats_result read_only::get_action_stats( const read_only::get_action_stats_params& p ) const {
+   get_action_stats_result result;
+   if( const auto* stats = db.get_action_stats() ) {
+      result.enabled = true;
+      result.window = p.completed ? stats->completed( p.limit ) : stats->current( p.limit );
+   }
+   return result;
+}
+
+read_only::get_wasm_profile_result read_only::get_wasm_profile( const read_only::get_wasm_profile_params& p ) const {
+   get_wasm_profile_result result;
+   result.rows = db.get_wasm_profile();
+   if( result.rows.size() > p.limit ) {
+      result.more = true;
+      result.rows.resize( p.limit );
+   }
+   return result;
+}
+
+read_only::get_eosvmoc_warm_up_status_result read_only::get_eosvmoc_warm_up_status( const read_only::get_eosvmoc_warm_up_status_params& ) const {
+   read_only::get_eosvmoc_warm_up_status_result result;
+   if( auto status = db.get_eosvmoc_warm_up_status() ) {
+      result.enabled  = true;
+      result.total    = status->total;
+      result.compiled = status->compiled;
+      result.failed   = status->failed;
+      result.pending  = status->total - status->compiled - status->failed;
+   }
+   return result;
+}
+
+read_only::export_eosvmoc_code_result read_only::export_eosvmoc_code( const read_only::export_eosvmoc_code_params& p ) const {
+   read_only::export_eosvmoc_code_result result{ p.code_hash, p.vm_version };
+   if( auto artifact = db.export_eosvmoc_code( p.code_hash, p.vm_version ) ) {
+      result.target = artifact->target;
+      result.artifact = fc::raw::pack( *artifact );
+   }
+   return result;
+}
+
 template<typename Api>
 struct resolver_factory {
    static auto make(const Api* api, const fc::microseconds& max_serialization_time) {
-      return [api, max_serialization_time](const account_name &name) -> optional<abi_serializer> {
-         const auto* accnt = api->db.db().template find<account_object, by_name>(name);
-         if (accnt != nullptr) {
-            abi_def abi;
-            if (abi_serializer::to_abi(accnt->abi, abi)) {
-               return abi_serializer(abi, max_serialization_time);
-            }
-         }
-
-         return optional<abi_serializer>();
+      return [api, max_serialization_time](const account_name &name) -> abi_serializer_cache::abi_serializer_ptr {
+         return abi_serializer_cache::instance().get(api->db.db(), name, max_serialization_time);
       };
    }
 };
@@ -2007,38 +2706,188 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
    return result;
 }
 
-fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+signed_block_ptr read_only::fetch_block( const string& block_num_or_id )const {
    signed_block_ptr block;
    optional<uint64_t> block_num;
 
-   EOS_ASSERT( !params.block_num_or_id.empty() && params.block_num_or_id.size() <= 64,
+   EOS_ASSERT( !block_num_or_id.empty() && block_num_or_id.size() <= 64,
                chain::block_id_type_exception,
                "Invalid Block number or ID, must be greater than 0 and less than 64 characters"
    );
 
    try {
-      block_num = fc::to_uint64(params.block_num_or_id);
+      block_num = fc::to_uint64(block_num_or_id);
    } catch( ... ) {}
 
    if( block_num.valid() ) {
       block = db.fetch_block_by_number( *block_num );
    } else {
       try {
-         block = db.fetch_block_by_id( fc::variant(params.block_num_or_id).as<block_id_type>() );
-      } EOS_RETHROW_EXCEPTIONS(chain::block_id_type_exception, "Invalid block ID: ${block_num_or_id}", ("block_num_or_id", params.block_num_or_id))
+         block = db.fetch_block_by_id( fc::variant(block_num_or_id).as<block_id_type>() );
+      } EOS_RETHROW_EXCEPTIONS(chain::block_id_type_exception, "Invalid block ID: ${block_num_or_id}", ("block_num_or_id", block_num_or_id))
    }
 
-   EOS_ASSERT( block, unknown_block_exception, "Could not find block: ${block}", ("block", params.block_num_or_id));
+   EOS_ASSERT( block, unknown_block_exception, "Could not find block: ${block}", ("block", block_num_or_id));
+   return block;
+}
+
+namespace {
+   enum class block_transactions { full, ids, none };
+
+   block_transactions parse_block_transactions( const string& s ) {
+      if( s == "full" ) return block_transactions::full;
+      if( s == "ids" ) return block_transactions::ids;
+      EOS_ASSERT( s == "none", chain::invalid_http_request, "Invalid transactions ${t}, expected full, ids or none", ("t", s) );
+      return block_transactions::none;
+   }
+
+   /// the abi serializer time of a get_block response is shared by all of its transactions
+   fc::time_point block_deadline( const fc::microseconds& max_time ) {
+      const fc::time_point now = fc::time_point::now();
+      if( max_time > fc::microseconds::maximum() - now.time_since_epoch() ) return fc::time_point::maximum();
+      return now + max_time;
+   }
+
+   fc::microseconds time_left( const fc::time_point& deadline ) {
+      if( deadline == fc::time_point::maximum() ) return fc::microseconds::maximum();
+      return std::max( deadline - fc::time_point::now(), fc::microseconds(0) );
+   }
+
+   /// fewest transactions of a block decoded by one thread
+   constexpr size_t min_decode_chunk = 16;
+
+   /**
+    * f(i) of every i below n, in order. Split into chunks of consecutive i run on thread_pool, if there is one and
+    * n is large enough, the calling thread taking the first chunk. The state may not change until it returns, which
+    * the calling thread, being the main thread or in a read window, guarantees by waiting for the chunks.
+    */
+   template<typename T, typename F>
+   std::vector<T> decode_in_order( size_t n, boost::asio::io_context* thread_pool, uint16_t threads, F f ) {
+      std::vector<T> result( n );
+      const size_t chunks = thread_pool ? std::min<size_t>( threads + 1, n / min_decode_chunk ) : 1;
+      const size_t chunk_size = chunks > 1 ? (n + chunks - 1) / chunks : n;
+      auto decode = [&result, &f]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            result[i] = f( i );
+      };
+
+      std::vector<std::future<void>> others;
+      for( size_t begin = chunk_size; begin < n; begin += chunk_size ) {
+         others.emplace_back( async_thread_pool( *thread_pool, [&decode, begin, end = std::min( n, begin + chunk_size )]() {
+            decode( begin, end );
+         } ) );
+      }
+      // the chunks reference result and f, all of them are waited for before returning or throwing
+      std::exception_ptr except;
+      try {
+         decode( 0, std::min( n, chunk_size ) );
+      } catch( ... ) {
+         except = std::current_exception();
+      }
+      for( auto& o : others ) {
+         try {
+            o.get();
+         } catch( ... ) {
+            if( !except ) except = std::current_exception();
+         }
+      }
+      if( except ) std::rethrow_exception( except );
+      return result;
+   }
+}
 
-   fc::variant pretty_output;
-   abi_serializer::to_variant(*block, pretty_output, make_resolver(this, abi_serializer_max_time), abi_serializer_max_time);
+fc::mutable_variant_object read_only::block_header_variant( const signed_block& block, const fc::time_point& deadline )const {
+   signed_block header( static_cast<const signed_block_header&>(block) );
+   header.block_extensions = block.block_extensions;
+   fc::variant pretty_header;
+   abi_serializer::to_variant(header, pretty_header, make_resolver(this, abi_serializer_max_time), time_left( deadline ));
 
-   uint32_t ref_block_prefix = block->id()._hash[1];
+   const block_id_type id = block.id();
+   uint32_t ref_block_prefix = id._hash[1];
 
-   return fc::mutable_variant_object(pretty_output.get_object())
-           ("id", block->id())
-           ("block_num",block->block_num())
-           ("ref_block_prefix", ref_block_prefix);
+   fc::mutable_variant_object result( pretty_header.get_object() );
+   result.erase( "transactions" );
+   result("id", id)
+         ("block_num", block.block_num())
+         ("ref_block_prefix", ref_block_prefix);
+   return result;
+}
+
+fc::variant read_only::block_transaction_variant( const transaction_receipt& receipt, bool id_only, const fc::time_point& deadline )const {
+   if( id_only ) {
+      if( receipt.trx.contains<transaction_id_type>() ) return fc::variant( receipt.trx.get<transaction_id_type>() );
+      return fc::variant( receipt.trx.get<packed_transaction>().id() );
+   }
+   fc::variant pretty_trx;
+   abi_serializer::to_variant(receipt, pretty_trx, make_resolver(this, abi_serializer_max_time), time_left( deadline ));
+   return pretty_trx;
+}
+
+fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+   const auto transactions = parse_block_transactions( params.transactions );
+   const signed_block_ptr block = fetch_block( params.block_num_or_id );
+   const fc::time_point deadline = block_deadline( abi_serializer_max_time );
+
+   fc::mutable_variant_object result = block_header_variant( *block, deadline );
+   if( transactions != block_transactions::none ) {
+      const bool id_only = transactions == block_transactions::ids;
+      result("transactions", decode_in_order<fc::variant>( block->transactions.size(), id_only ? nullptr : decode_thread_pool, decode_threads,
+         [&]( size_t i ) {
+            return block_transaction_variant( block->transactions[i], id_only, deadline );
+         } ));
+   }
+   return result;
+}
+
+string read_only::get_block_json( const get_block_params& params )const {
+   const auto transactions = parse_block_transactions( params.transactions );
+   const signed_block_ptr block = fetch_block( params.block_num_or_id );
+   const fc::time_point deadline = block_deadline( abi_serializer_max_time );
+
+   string json = fc::json::to_string( block_header_variant( *block, deadline ), fc::time_point::maximum() );
+   if( transactions == block_transactions::none ) return json;
+
+   // reopen the object to append the transactions to it
+   json.pop_back();
+   json += ",\"transactions\":[";
+   const bool id_only = transactions == block_transactions::ids;
+   const auto trxs = decode_in_order<string>( block->transactions.size(), id_only ? nullptr : decode_thread_pool, decode_threads,
+      [&]( size_t i ) {
+         return fc::json::to_string( block_transaction_variant( block->transactions[i], id_only, deadline ), fc::time_point::maximum() );
+      } );
+   for( size_t i = 0; i < trxs.size(); ++i ) {
+      if( i > 0 ) json += ',';
+      json += trxs[i];
+   }
+   json += "]}";
+   return json;
+}
+
+bytes read_only::get_block_packed( const get_block_params& params )const {
+   return fc::raw::pack( *fetch_block( params.block_num_or_id ) );
+}
+
+read_only::get_transaction_status_results read_only::get_transaction_status( const get_transaction_status_params& params )const {
+   EOS_ASSERT( trx_statuses, plugin_config_exception, "get_transaction_status needs transaction-status-window-sec" );
+   EOS_ASSERT( params.ids.size() <= max_transaction_status_ids, chain::contract_table_query_exception,
+               "At most ${max} ids per call, got ${n}", ("max", max_transaction_status_ids)("n", params.ids.size()) );
+   get_transaction_status_results result;
+   result.statuses = trx_statuses->get( params.ids, result );
+   return result;
+}
+
+read_only::get_accounts_by_authorizers_results read_only::get_accounts_by_authorizers( const get_accounts_by_authorizers_params& params )const {
+   EOS_ASSERT( key_accounts, plugin_config_exception, "get_accounts_by_authorizers needs key-account-index" );
+   EOS_ASSERT( params.accounts.size() + params.keys.size() <= max_authorizers, chain::contract_table_query_exception,
+               "At most ${max} accounts and keys per call, got ${n}", ("max", max_authorizers)("n", params.accounts.size() + params.keys.size()) );
+   return { key_accounts->get( params.accounts, params.keys ) };
+}
+
+read_only::get_transaction_block_results read_only::get_transaction_block( const get_transaction_block_params& params )const {
+   const auto block_num = db.get_transaction_block( params.id );
+   EOS_ASSERT( block_num, tx_not_found, "Transaction ${id} not found in the reversible blocks${log}",
+               ("id", params.id)("log", db.has_trx_index() ? " or the block log" : ", nodeos is not running with trx-index") );
+   return { params.id, *block_num, *block_num <= db.last_irreversible_block_num() };
 }
 
 fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
@@ -2083,7 +2932,18 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
          abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer_max_time);
       } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
 
-      app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
+      push_packed_transaction(pretty_input, std::move(next));
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
+void read_write::push_packed_transaction(const packed_transaction_ptr& trx, next_function<read_write::push_transaction_results> next) {
+   try {
+      transaction_tracing::instance().begin(trx->id(), "http");
+      app().get_method<incoming::methods::transaction_async>()(trx, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
             next(result.get<fc::exception_ptr>());
@@ -2157,35 +3017,128 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
    } CATCH_AND_CALL(next);
 }
 
-static void push_recurse(read_write* rw, int index, const std::shared_ptr<read_write::push_transactions_params>& params, const std::shared_ptr<read_write::push_transactions_results>& results, const next_function<read_write::push_transactions_results>& next) {
+packed_transaction_ptr read_write::parse_packed_transaction(const push_transaction_params& params, const fc::microseconds& max_serialization_time) {
+   const auto packed_trx = params.find( "packed_trx" );
+   if( packed_trx == params.end() || !packed_trx->value().is_string() || packed_trx->value().get_string().empty() )
+      return packed_transaction_ptr();
+
+   auto trx = std::make_shared<packed_transaction>();
+   // a packed transaction is converted without looking at any abi
+   auto no_abis = []( const account_name& ) -> optional<abi_serializer> { return optional<abi_serializer>(); };
+   try {
+      abi_serializer::from_variant(params, *trx, no_abis, max_serialization_time);
+   } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+   return trx;
+}
+
+read_write::push_read_only_transaction_results read_write::push_read_only_transaction(const read_write::push_read_only_transaction_params& params) {
+   packed_transaction pretty_input;
+   auto resolver = make_resolver(this, abi_serializer_max_time);
+   try {
+      abi_serializer::from_variant(params, pretty_input, resolver, abi_serializer_max_time);
+   } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+
+   auto trx = transaction_metadata::create_no_recover_keys( pretty_input, transaction_metadata::trx_type::input );
+   // still bounded by max_transaction_cpu_usage and the transaction's max_cpu_usage_ms
+   auto trace = db.push_read_only_transaction( trx, fc::time_point::maximum() );
+
+   fc::variant output;
+   try {
+      output = db.to_variant_with_abi( *trace, abi_serializer_max_time );
+   } catch( chain::abi_exception& ) {
+      output = *trace;
+   }
+   return push_read_only_transaction_results{ trace->id, output };
+}
+
+read_write::import_eosvmoc_code_results read_write::import_eosvmoc_code(const read_write::import_eosvmoc_code_params& params) {
+   eosvmoc::code_artifact artifact;
+   try {
+      fc::datastream<const char*> ds( params.artifact.data(), params.artifact.size() );
+      fc::raw::unpack( ds, artifact );
+   } EOS_RETHROW_EXCEPTIONS(chain::wasm_serialization_error, "Invalid EOS VM OC code artifact")
+   const bool imported = db.import_eosvmoc_code( artifact );
+   return import_eosvmoc_code_results{ artifact.code.code_id, artifact.code.vm_version, imported };
+}
+
+/// transactions of one push_transactions call
+struct push_transactions_batch {
+   vector<packed_transaction_ptr>          trxs;       ///< null where the transaction could not be parsed
+   vector<string>                          errors;     ///< why, for the null ones
+   read_write::push_transactions_results   results;
+   std::atomic<size_t>                     recovering{0};
+};
+
+static void push_recurse(read_write* rw, size_t index, const std::shared_ptr<push_transactions_batch>& batch, const next_function<read_write::push_transactions_results>& next) {
+   for( ; index < batch->trxs.size() && !batch->trxs[index]; ++index )
+      batch->results.emplace_back( read_write::push_transaction_results{ transaction_id_type(), fc::mutable_variant_object( "error", batch->errors[index] ) } );
+   if( index == batch->trxs.size() ) {
+      next(batch->results);
+      return;
+   }
+
    auto wrapped_next = [=](const fc::static_variant<fc::exception_ptr, read_write::push_transaction_results>& result) {
       if (result.contains<fc::exception_ptr>()) {
          const auto& e = result.get<fc::exception_ptr>();
-         results->emplace_back( read_write::push_transaction_results{ transaction_id_type(), fc::mutable_variant_object( "error", e->to_detail_string() ) } );
+         batch->results.emplace_back( read_write::push_transaction_results{ transaction_id_type(), fc::mutable_variant_object( "error", e->to_detail_string() ) } );
       } else {
          const auto& r = result.get<read_write::push_transaction_results>();
-         results->emplace_back( r );
+         batch->results.emplace_back( r );
       }
 
-      size_t next_index = index + 1;
-      if (next_index < params->size()) {
-         push_recurse(rw, next_index, params, results, next );
-      } else {
-         next(*results);
-      }
+      push_recurse(rw, index + 1, batch, next);
    };
 
-   rw->push_transaction(params->at(index), wrapped_next);
+   rw->push_packed_transaction(batch->trxs[index], wrapped_next);
 }
 
 void read_write::push_transactions(const read_write::push_transactions_params& params, next_function<read_write::push_transactions_results> next) {
    try {
       EOS_ASSERT( params.size() <= 1000, too_many_tx_at_once, "Attempt to push too many transactions at once" );
-      auto params_copy = std::make_shared<read_write::push_transactions_params>(params.begin(), params.end());
-      auto result = std::make_shared<read_write::push_transactions_results>();
-      result->reserve(params.size());
+      auto batch = std::make_shared<push_transactions_batch>();
+      batch->trxs.resize(params.size());
+      batch->errors.resize(params.size());
+      batch->results.reserve(params.size());
+
+      auto resolver = make_resolver(this, abi_serializer_max_time);
+      size_t parsed = 0;
+      for( size_t i = 0; i < params.size(); ++i ) {
+         try {
+            auto trx = std::make_shared<packed_transaction>();
+            try {
+               abi_serializer::from_variant(params[i], *trx, resolver, abi_serializer_max_time);
+            } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+            batch->trxs[i] = std::move(trx);
+            ++parsed;
+         } catch( const fc::exception& e ) {
+            batch->errors[i] = e.to_detail_string();
+         } catch( const std::exception& e ) {
+            batch->errors[i] = fc::std_exception_wrapper::from_current_exception(e).to_detail_string();
+         }
+      }
+      if( parsed == 0 ) {
+         push_recurse(this, 0, batch, next);
+         return;
+      }
 
-      push_recurse(this, 0, params_copy, result, next);
+      // The transactions still have to be applied one after the other, in order, as later ones may depend on
+      // earlier ones. Recovering all signatures at once leaves each of them a hit in the signature recovery cache.
+      batch->recovering = parsed;
+      const auto chain_id = db.get_chain_id();
+      for( const auto& trx : batch->trxs ) {
+         if( !trx ) continue;
+         boost::asio::post( db.get_thread_pool(), [rw = this, batch, trx, chain_id, next]() {
+            try {
+               flat_set<public_key_type> keys;
+               trx->get_signed_transaction().get_signature_keys( chain_id, fc::time_point::maximum(), keys );
+            } catch( ... ) {} // reported when the transaction is pushed
+            if( --batch->recovering == 0 ) {
+               app().post( priority::low, [rw, batch, next]() {
+                  push_recurse(rw, 0, batch, next);
+               } );
+            }
+         } );
+      }
    } catch ( boost::interprocess::bad_alloc& ) {
       chain_plugin::handle_db_exhaustion();
    } catch ( const std::bad_alloc& ) {
@@ -2202,7 +3155,18 @@ void read_write::send_transaction(const read_write::send_transaction_params& par
          abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer_max_time);
       } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
 
-      app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
+      send_packed_transaction(pretty_input, std::move(next));
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
+void read_write::send_packed_transaction(const packed_transaction_ptr& trx, next_function<read_write::send_transaction_results> next) {
+   try {
+      transaction_tracing::instance().begin(trx->id(), "http");
+      app().get_method<incoming::methods::transaction_async>()(trx, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
             next(result.get<fc::exception_ptr>());
@@ -2310,17 +3274,52 @@ read_only::get_raw_abi_results read_only::get_raw_abi( const get_raw_abi_params&
    return result;
 }
 
-read_only::get_account_results read_only::get_account( const get_account_params& params )const {
-   get_account_results result;
-   result.account_name = params.account_name;
+bytes read_only::get_raw_abi_packed( const get_raw_abi_params& params )const {
+   return fc::raw::pack( get_raw_abi( params ) );
+}
 
-   const auto& d = db.db();
+bytes read_only::get_account_packed( const get_account_params& params )const {
+   return fc::raw::pack( get_account( params ) );
+}
+
+read_only::get_account_results read_only::get_account( const get_account_params& params )const {
    const auto& rm = db.get_resource_limits_manager();
 
+   int64_t ram_quota = 0, net_weight = 0, cpu_weight = 0;
+   rm.get_account_limits( params.account_name, ram_quota, net_weight, cpu_weight );
+
+   get_account_results result;
+   if( account_summaries && !params.expected_core_symbol ) {
+      if( auto cached = account_summaries->get( params.account_name ) ) {
+         result = *cached;
+      } else {
+         result = get_account_summary( params.account_name, {} );
+         account_summaries->want( params.account_name );
+      }
+   } else {
+      result = get_account_summary( params.account_name, params.expected_core_symbol );
+   }
+
    result.head_block_num  = db.head_block_num();
    result.head_block_time = db.head_block_time();
 
-   rm.get_account_limits( result.account_name, result.ram_quota, result.net_weight, result.cpu_weight );
+   result.ram_quota  = ram_quota;
+   result.net_weight = net_weight;
+   result.cpu_weight = cpu_weight;
+
+   uint32_t greylist_limit = db.is_resource_greylisted(result.account_name) ? 1 : config::maximum_elastic_resource_multiplier;
+   result.net_limit = rm.get_account_net_limit_ex( result.account_name, greylist_limit).first;
+   result.cpu_limit = rm.get_account_cpu_limit_ex( result.account_name, greylist_limit).first;
+   result.ram_usage = rm.get_account_ram_usage( result.account_name );
+
+   return result;
+}
+
+read_only::get_account_results read_only::get_account_summary( const name& account, const optional<symbol>& expected_core_symbol )const {
+   get_account_results result;
+   result.account_name = account;
+
+   const auto& d = db.db();
 
    const auto& accnt_obj = db.get_account( result.account_name );
    const auto& accnt_metadata_obj = db.db().get<account_metadata_object,by_name>( result.account_name );
@@ -2329,14 +3328,9 @@ read_only::get_account_results read_only::get_account( const get_account_params&
    result.last_code_update = accnt_metadata_obj.last_code_update;
    result.created          = accnt_obj.creation_date;
 
-   uint32_t greylist_limit = db.is_resource_greylisted(result.account_name) ? 1 : config::maximum_elastic_resource_multiplier;
-   result.net_limit = rm.get_account_net_limit_ex( result.account_name, greylist_limit).first;
-   result.cpu_limit = rm.get_account_cpu_limit_ex( result.account_name, greylist_limit).first;
-   result.ram_usage = rm.get_account_ram_usage( result.account_name );
-
    const auto& permissions = d.get_index<permission_index,by_owner>();
-   auto perm = permissions.lower_bound( boost::make_tuple( params.account_name ) );
-   while( perm != permissions.end() && perm->owner == params.account_name ) {
+   auto perm = permissions.lower_bound( boost::make_tuple( account ) );
+   while( perm != permissions.end() && perm->owner == account ) {
       /// TODO: lookup perm->parent name
       name parent;
 
@@ -2353,20 +3347,17 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       ++perm;
    }
 
-   const auto& code_account = db.db().get<account_object,by_name>( config::system_account_name );
-
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   if( auto abis_ptr = abi_serializer_cache::instance().get( db.db(), config::system_account_name, abi_serializer_max_time ) ) {
+      const abi_serializer& abis = *abis_ptr;
 
       const auto token_code = N(eosio.token);
 
       auto core_symbol = extract_core_symbol();
 
-      if (params.expected_core_symbol.valid())
-         core_symbol = *(params.expected_core_symbol);
+      if (expected_core_symbol.valid())
+         core_symbol = *expected_core_symbol;
 
-      const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( token_code, params.account_name, N(accounts) ));
+      const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( token_code, account, N(accounts) ));
       if( t_id != nullptr ) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, core_symbol.to_symbol_code() ));
@@ -2381,10 +3372,10 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          }
       }
 
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(userres) ));
+      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, account, N(userres) ));
       if (t_id != nullptr) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
+         auto it = idx.find(boost::make_tuple( t_id->id, account.to_uint64_t() ));
          if ( it != idx.end() ) {
             vector<char> data;
             copy_inline_row(*it, data);
@@ -2392,10 +3383,10 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          }
       }
 
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(delband) ));
+      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, account, N(delband) ));
       if (t_id != nullptr) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
+         auto it = idx.find(boost::make_tuple( t_id->id, account.to_uint64_t() ));
          if ( it != idx.end() ) {
             vector<char> data;
             copy_inline_row(*it, data);
@@ -2403,10 +3394,10 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          }
       }
 
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(refunds) ));
+      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, account, N(refunds) ));
       if (t_id != nullptr) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
+         auto it = idx.find(boost::make_tuple( t_id->id, account.to_uint64_t() ));
          if ( it != idx.end() ) {
             vector<char> data;
             copy_inline_row(*it, data);
@@ -2417,7 +3408,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, config::system_account_name, N(voters) ));
       if (t_id != nullptr) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
+         auto it = idx.find(boost::make_tuple( t_id->id, account.to_uint64_t() ));
          if ( it != idx.end() ) {
             vector<char> data;
             copy_inline_row(*it, data);
@@ -2428,7 +3419,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, config::system_account_name, N(rexbal) ));
       if (t_id != nullptr) {
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
+         auto it = idx.find(boost::make_tuple( t_id->id, account.to_uint64_t() ));
          if( it != idx.end() ) {
             vector<char> data;
             copy_inline_row(*it, data);
@@ -2452,16 +3443,15 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
    const auto code_account = db.db().find<account_object,by_name>( params.code );
    EOS_ASSERT(code_account != nullptr, contract_query_exception, "Contract can't be found ${contract}", ("contract", params.code));
 
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account->abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   if( auto abis_ptr = abi_serializer_cache::instance().get( db.db(), params.code, abi_serializer_max_time ) ) {
+      const abi_serializer& abis = *abis_ptr;
       auto action_type = abis.get_action_type(params.action);
       EOS_ASSERT(!action_type.empty(), action_validate_exception, "Unknown action ${action} in contract ${contract}", ("action", params.action)("contract", params.code));
       try {
          result.binargs = abis.variant_to_binary( action_type, params.args, abi_serializer_max_time, shorten_abi_errors );
       } EOS_RETHROW_EXCEPTIONS(chain::invalid_action_args_exception,
                                 "'${args}' is invalid args for action '${action}' code '${code}'. expected '${proto}'",
-                                ("args", params.args)("action", params.action)("code", params.code)("proto", action_abi_to_variant(abi, action_type)))
+                                ("args", params.args)("action", params.action)("code", params.code)("proto", action_abi_to_variant(code_account->get_abi(), action_type)))
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
    }
@@ -2471,10 +3461,9 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
 
 read_only::abi_bin_to_json_result read_only::abi_bin_to_json( const read_only::abi_bin_to_json_params& params )const {
    abi_bin_to_json_result result;
-   const auto& code_account = db.db().get<account_object,by_name>( params.code );
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   db.db().get<account_object,by_name>( params.code );   // throws for an unknown account
+   if( auto abis_ptr = abi_serializer_cache::instance().get( db.db(), params.code, abi_serializer_max_time ) ) {
+      const abi_serializer& abis = *abis_ptr;
       result.args = abis.binary_to_variant( abis.get_action_type( params.action ), params.binargs, abi_serializer_max_time, shorten_abi_errors );
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
@@ -2482,16 +3471,50 @@ read_only::abi_bin_to_json_result read_only::abi_bin_to_json( const read_only::a
    return result;
 }
 
-read_only::get_required_keys_result read_only::get_required_keys( const get_required_keys_params& params )const {
-   transaction pretty_input;
-   auto resolver = make_resolver(this, abi_serializer_max_time);
-   try {
-      abi_serializer::from_variant(params.transaction, pretty_input, resolver, abi_serializer_max_time);
-   } EOS_RETHROW_EXCEPTIONS(chain::transaction_type_exception, "Invalid transaction")
+namespace {
+   /// the authorizations declared by the actions of a transaction in json, the action data does not affect them
+   vector<permission_level> declared_authorizations( const fc::variant& trx, fc::microseconds& delay ) {
+      vector<permission_level> auths;
+      try {
+         const auto& obj = trx.get_object();
+         delay = fc::seconds( obj.contains( "delay_sec" ) ? obj["delay_sec"].as<uint32_t>() : 0 );
+         if( obj.contains( "actions" ) ) {
+            for( const auto& act : obj["actions"].get_array() ) {
+               const auto& act_obj = act.get_object();
+               if( !act_obj.contains( "authorization" ) ) continue;
+               for( const auto& auth : act_obj["authorization"].get_array() )
+                  auths.emplace_back( auth.as<permission_level>() );
+            }
+         }
+      } EOS_RETHROW_EXCEPTIONS(chain::transaction_type_exception, "Invalid transaction")
+      return auths;
+   }
+}
 
-   auto required_keys_set = db.get_authorization_manager().get_required_keys( pretty_input, params.available_keys, fc::seconds( pretty_input.delay_sec ));
+read_only::get_required_keys_result read_only::get_required_keys( const get_required_keys_params& params )const {
+   fc::microseconds delay;
+   const auto auths = declared_authorizations( params.transaction, delay );
    get_required_keys_result result;
-   result.required_keys = required_keys_set;
+   result.required_keys = db.get_authorization_manager().get_required_keys( auths, params.available_keys, delay );
+   return result;
+}
+
+read_only::get_required_keys_batch_result read_only::get_required_keys_batch( const get_required_keys_batch_params& params )const {
+   EOS_ASSERT( params.transactions.size() <= max_required_keys_batch, chain::transaction_type_exception,
+               "At most ${max} transactions per call, got ${n}", ("max", max_required_keys_batch)("n", params.transactions.size()) );
+   const auto& auth_manager = db.get_authorization_manager();
+   get_required_keys_batch_result result;
+   result.results.reserve( params.transactions.size() );
+   for( const auto& trx : params.transactions ) {
+      result.results.emplace_back();
+      try {
+         fc::microseconds delay;
+         const auto auths = declared_authorizations( trx, delay );
+         result.results.back().required_keys = auth_manager.get_required_keys( auths, params.available_keys, delay );
+      } catch( const fc::exception& e ) {
+         result.results.back().error = e.top_message();
+      }
+   }
    return result;
 }
 
@@ -2499,6 +3522,45 @@ read_only::get_transaction_id_result read_only::get_transaction_id( const read_o
    return params.id();
 }
 
+read_only::batch_results read_only::batch( const read_only::batch_params& params )const {
+   static constexpr size_t max_batch_calls = 100;
+   EOS_ASSERT( params.size() <= max_batch_calls, chain::invalid_http_request,
+               "Batch of ${n} calls exceeds the maximum of ${max}", ("n", params.size())("max", max_batch_calls) );
+
+   using batch_handler = fc::variant (*)( const read_only&, const fc::variant& );
+#define BATCH_CALL(call_name) \
+   { #call_name, []( const read_only& ro, const fc::variant& p ) { return fc::variant( ro.call_name( p.as<read_only::call_name ## _params>() ) ); } }
+   static const std::map<string, batch_handler> handlers = {
+      BATCH_CALL(get_account),
+      BATCH_CALL(get_code_hash),
+      BATCH_CALL(get_abi),
+      BATCH_CALL(get_raw_abi),
+      BATCH_CALL(get_table_rows),
+      BATCH_CALL(get_table_by_scope),
+      BATCH_CALL(get_currency_balance),
+      BATCH_CALL(get_currency_stats),
+      BATCH_CALL(get_producers),
+      BATCH_CALL(abi_json_to_bin),
+      BATCH_CALL(abi_bin_to_json)
+   };
+#undef BATCH_CALL
+
+   batch_results results;
+   results.reserve( params.size() );
+   for( const auto& c : params ) {
+      try {
+         auto itr = handlers.find( c.call );
+         EOS_ASSERT( itr != handlers.end(), chain::invalid_http_request, "Unsupported batch call ${call}", ("call", c.call) );
+         results.emplace_back( fc::mutable_variant_object( "result", itr->second( *this, c.params ) ) );
+      } catch( const fc::exception& e ) {
+         results.emplace_back( fc::mutable_variant_object( "error", e.to_detail_string() ) );
+      } catch( const std::exception& e ) {
+         results.emplace_back( fc::mutable_variant_object( "error", e.what() ) );
+      }
+   }
+   return results;
+}
+
 namespace detail {
    struct ram_market_exchange_state_t {
       asset  ignore1;
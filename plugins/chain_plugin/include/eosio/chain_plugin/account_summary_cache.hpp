@@ -0,0 +1,58 @@
+#pragma once
+#include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain_apis {
+
+   /**
+    * Bounded LRU cache of read_only::get_account_summary results for the default core symbol.
+    *
+    * Summaries are only computed on the main thread while a block is accepted, so they always reflect the state of
+    * a head block. Accounts looked up without a cached summary are summarized at the next accepted block. An entry
+    * is refreshed when the block changes the account, its permissions, its core token balance or its userres,
+    * delband, refunds, voters or rexbal rows. Blocks applied without an undo session, fork switches and changes of
+    * the eosio abi refresh every entry.
+    */
+   class account_summary_cache {
+      public:
+         using summary_ptr = std::shared_ptr<const read_only::get_account_results>;
+
+         account_summary_cache( const chain::controller& chain, const fc::microseconds& abi_serializer_max_time, size_t capacity );
+
+         /// thread safe, nullptr if account has no cached summary
+         summary_ptr get( const chain::name& account );
+
+         /// thread safe, account is summarized at the next accepted block
+         void want( const chain::name& account );
+
+         /// main thread only
+         void on_accepted_block( const chain::block_state_ptr& bsp );
+
+      private:
+         /// accounts whose summary may have been changed by the block being accepted, empty if unknown
+         optional<flat_set<chain::name>> changed_accounts()const;
+
+         const chain::controller&                           _chain;
+         const fc::microseconds                             _abi_serializer_max_time;
+         const size_t                                       _capacity;
+
+         // main thread only
+         chain::abi_serializer_cache::abi_serializer_ptr    _abis;
+         chain::block_id_type                               _last_block_id;
+
+         struct entry {
+            summary_ptr                           summary;
+            std::list<chain::name>::iterator      lru_itr;
+         };
+
+         std::mutex                                         _mtx;
+         std::unordered_map<uint64_t, entry>                _entries;  ///< protected by _mtx
+         std::list<chain::name>                             _lru;      ///< most recently used first, protected by _mtx
+         flat_set<chain::name>                              _wanted;   ///< protected by _mtx
+   };
+
+} } /// eosio::chain_apis
@@ -12,11 +12,18 @@
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/fixed_bytes.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/startup_timeline.hpp>
+#include <eosio/chain/memory_accounting.hpp>
+#include <eosio/chain_plugin/producers_view.hpp>
+#include <eosio/chain_plugin/transaction_status_cache.hpp>
+#include <eosio/chain_plugin/key_account_index.hpp>
 
 #include <boost/container/flat_set.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <fc/static_variant.hpp>
+#include <fc/crypto/hex.hpp>
 
 namespace fc { class variant; }
 
@@ -75,21 +82,73 @@ string convert_to_string(const chain::key256_t& source, const string& key_type,
 template<>
 string convert_to_string(const float128_t& source, const string& key_type, const string& encode_type, const string& desc);
 
+/// exact position of the next row of a get_table_rows page
+struct table_continuation {
+   uint64_t     table_id = 0;  ///< id of the table_id_object of the walked index
+   uint64_t     primary_key = 0;
+   vector<char> secondary_key; ///< bytes of the secondary key, empty for the primary index
+};
+
+/// exact position of the next row of a get_table_by_scope page
+struct scope_continuation {
+   name scope;
+   name table;
+};
+
+/// continuations are handed to clients as opaque hex strings
+template<typename T>
+string encode_continuation(const T& c) {
+   const auto packed = fc::raw::pack(c);
+   return fc::to_hex(packed.data(), packed.size());
+}
+
+template<typename T>
+T decode_continuation(const string& str) {
+   try {
+      vector<char> packed(str.size() / 2);
+      EOS_ASSERT( str.size() % 2 == 0 && fc::from_hex(str, packed.data(), packed.size()) == packed.size(),
+                  chain::contract_table_query_exception, "continuation is not a hex string" );
+      return fc::raw::unpack<T>(packed);
+   } FC_RETHROW_EXCEPTIONS(warn, "Invalid continuation '${str}'", ("str", str))
+}
+
+
+class account_summary_cache;
 
 class read_only {
    const controller& db;
    const fc::microseconds abi_serializer_max_time;
    bool  shorten_abi_errors = true;
+   const producers_view* producers = nullptr;
+   account_summary_cache* account_summaries = nullptr;
+   const transaction_status_cache* trx_statuses = nullptr;
+   const key_account_index* key_accounts = nullptr;
+   boost::asio::io_context* decode_thread_pool = nullptr;
+   uint16_t decode_threads = 0;
+
+   chain::signed_block_ptr fetch_block( const string& block_num_or_id )const;
+   /// variant of the block without its transactions, with the fields get_block adds to it
+   fc::mutable_variant_object block_header_variant( const chain::signed_block& block, const fc::time_point& deadline )const;
+   /// variant of a transaction of a get_block response
+   fc::variant block_transaction_variant( const chain::transaction_receipt& receipt, bool id_only, const fc::time_point& deadline )const;
 
 public:
    static const string KEYi64;
 
-   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time)
-      : db(db), abi_serializer_max_time(abi_serializer_max_time) {}
+   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, const producers_view* producers = nullptr,
+             account_summary_cache* account_summaries = nullptr, const transaction_status_cache* trx_statuses = nullptr,
+             const key_account_index* key_accounts = nullptr)
+      : db(db), abi_serializer_max_time(abi_serializer_max_time), producers(producers), account_summaries(account_summaries),
+        trx_statuses(trx_statuses), key_accounts(key_accounts) {}
 
    void validate() const {}
 
    void set_shorten_abi_errors( bool f ) { shorten_abi_errors = f; }
+   /// threads get_block decodes the transactions of large blocks on, alongside the calling thread which waits for them
+   void set_decode_thread_pool( boost::asio::io_context& ioc, uint16_t threads ) {
+      decode_thread_pool = &ioc;
+      decode_threads = threads;
+   }
 
    using get_info_params = empty;
 
@@ -171,6 +230,8 @@ public:
       optional<symbol> expected_core_symbol;
    };
    get_account_results get_account( const get_account_params& params )const;
+   /// the part of get_account that does not change unless the account, its permissions or its system contract rows do
+   get_account_results get_account_summary( const name& account, const optional<symbol>& expected_core_symbol )const;
 
 
    struct get_code_results {
@@ -267,25 +328,110 @@ public:
       flat_set<public_key_type> required_keys;
    };
 
+   /// only the authorizations and delay_sec of the transaction are read, the action data is not decoded
    get_required_keys_result get_required_keys( const get_required_keys_params& params)const;
 
+   struct get_required_keys_batch_params {
+      vector<fc::variant>       transactions;
+      flat_set<public_key_type> available_keys; ///< shared by all the transactions
+   };
+   struct required_keys_of_transaction {
+      optional<flat_set<public_key_type>> required_keys;
+      optional<string>                    error; ///< of an invalid or unsatisfiable transaction
+   };
+   struct get_required_keys_batch_result {
+      vector<required_keys_of_transaction> results; ///< in the order of the transactions
+   };
+
+   static constexpr size_t max_required_keys_batch = 1000;
+
+   get_required_keys_batch_result get_required_keys_batch( const get_required_keys_batch_params& params )const;
+
    using get_transaction_id_params = transaction;
    using get_transaction_id_result = transaction_id_type;
 
    get_transaction_id_result get_transaction_id( const get_transaction_id_params& params)const;
 
+   struct batch_call {
+      string      call;   ///< name of a read-only call that only reads chain state, e.g. "get_table_rows"
+      fc::variant params; ///< params of that call
+   };
+
+   using batch_params = vector<batch_call>;
+   /// one entry per call, in order: {"result": ...} or {"error": ...}
+   using batch_results = vector<fc::variant>;
+
+   /// runs all calls against the same state, they share the abi_serializer_cache entries they need
+   batch_results batch( const batch_params& params )const;
+
    struct get_block_params {
       string block_num_or_id;
+      string transactions = "full"; ///< "full", "ids" for only the ids of the transactions, or "none" for only the header
    };
 
    fc::variant get_block(const get_block_params& params) const;
 
+   /**
+    * get_block already serialized to json. The block is converted one transaction at a time, so besides the json
+    * only the variant of a single transaction is held instead of the one of the whole block.
+    */
+   string get_block_json( const get_block_params& params )const;
+
+   struct get_transaction_block_params {
+      transaction_id_type id;
+   };
+
+   struct get_transaction_block_results {
+      transaction_id_type id;
+      uint32_t            block_num = 0;
+      bool                irreversible = false;
+   };
+
+   /// block including a transaction, irreversible transactions are only found with trx-index
+   get_transaction_block_results get_transaction_block( const get_transaction_block_params& params )const;
+
+   struct get_transaction_status_params {
+      vector<transaction_id_type> ids;
+   };
+
+   struct get_transaction_status_results : transaction_status_cache::chain_head {
+      vector<transaction_status_cache::status> statuses; ///< in the order of the ids
+   };
+
+   static constexpr size_t max_transaction_status_ids = 1000;
+
+   /// thread safe, answered from the transaction status cache of the last transaction-status-window-sec
+   get_transaction_status_results get_transaction_status( const get_transaction_status_params& params )const;
+
+   struct get_accounts_by_authorizers_params {
+      vector<chain::permission_level> accounts; ///< an empty permission matches every permission of the actor
+      vector<chain::public_key_type>  keys;
+   };
+
+   struct get_accounts_by_authorizers_results {
+      vector<key_account_index::account_result> accounts;
+   };
+
+   static constexpr size_t max_authorizers = 1000;
+
+   /// thread safe, answered from the key account index of key-account-index
+   get_accounts_by_authorizers_results get_accounts_by_authorizers( const get_accounts_by_authorizers_params& params )const;
+
    struct get_block_header_state_params {
       string block_num_or_id;
    };
 
    fc::variant get_block_header_state(const get_block_header_state_params& params) const;
 
+   /// compares a field of the decoded row, e.g. {"field":"balance","op":">=","value":"10.0000 EOS"}
+   struct table_row_filter {
+      string      field; ///< path of the field, nested fields and array elements separated by dots, e.g. "owner.keys.0"
+      string      op;    ///< ==, !=, <, <=, > or >=
+      fc::variant value;
+   };
+
+   static constexpr size_t max_table_row_filters = 16;
+
    struct get_table_rows_params {
       bool        json = false;
       name        code;
@@ -300,16 +446,39 @@ public:
       string      encode_type{"dec"}; //dec, hex , default=dec
       optional<bool>  reverse;
       optional<bool>  show_payer; // show RAM pyer
+      string      continuation; // next_continuation of the previous page, takes the place of lower_bound (upper_bound if reverse)
+      vector<table_row_filter> filters; // json only, rows must match all of them and the others do not count toward limit
+      vector<string> fields; // json only, paths of the fields to return instead of the whole row
     };
 
    struct get_table_rows_result {
       vector<fc::variant> rows; ///< one row per item, either encoded as hex String or JSON object
       bool                more = false; ///< true if last element in data is not the end and sizeof data() < limit
       string              next_key; ///< fill lower_bound with this value to fetch more rows
+      string              next_continuation; ///< fill continuation with this value to fetch the rows right after this page
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
 
+   /// get_table_rows with json off, the rows kept as their bytes instead of hex strings
+   struct get_table_rows_packed_result {
+      vector<chain::bytes> rows;
+      vector<name>         payers; ///< payer of each row, only filled if show_payer is set
+      bool                 more = false;
+      string               next_key;
+      string               next_continuation;
+   };
+
+   /**
+    * fc::raw packed results of some calls, for clients that would turn the json right back into binary.
+    * get_block packs the signed_block, without resolving the abis of its actions, and get_table_rows packs a
+    * get_table_rows_packed_result.
+    */
+   chain::bytes get_block_packed( const get_block_params& params )const;
+   chain::bytes get_account_packed( const get_account_params& params )const;
+   chain::bytes get_raw_abi_packed( const get_raw_abi_params& params )const;
+   chain::bytes get_table_rows_packed( const get_table_rows_params& params )const;
+
    struct get_table_by_scope_params {
       name        code; // mandatory
       name        table; // optional, act as filter
@@ -317,6 +486,7 @@ public:
       string      upper_bound; // upper bound of scope, optional
       uint32_t    limit = 10;
       optional<bool>  reverse;
+      string      continuation; // next_continuation of the previous page, takes the place of lower_bound (upper_bound if reverse)
    };
    struct get_table_by_scope_result_row {
       name        code;
@@ -328,6 +498,7 @@ public:
    struct get_table_by_scope_result {
       vector<get_table_by_scope_result_row> rows;
       string      more; ///< fill lower_bound with this value to fetch more rows
+      string      next_continuation; ///< fill continuation with this value to fetch the rows right after this page
    };
 
    get_table_by_scope_result get_table_by_scope( const get_table_by_scope_params& params )const;
@@ -367,6 +538,8 @@ public:
    };
 
    get_producers_result get_producers( const get_producers_params& params )const;
+   /// thread safe, empty if producers-view is disabled or not available
+   optional<get_producers_result> get_producers_from_view( const get_producers_params& params )const;
 
    struct get_producer_schedule_params {
    };
@@ -379,6 +552,89 @@ public:
 
    get_producer_schedule_result get_producer_schedule( const get_producer_schedule_params& params )const;
 
+   struct get_eosvmoc_warm_up_status_params {
+   };
+
+   struct get_eosvmoc_warm_up_status_result {
+      bool     enabled  = false; ///< EOS VM OC tier-up is enabled
+      uint32_t total    = 0;
+      uint32_t compiled = 0;
+      uint32_t failed   = 0;
+      uint32_t pending  = 0;
+   };
+
+   get_eosvmoc_warm_up_status_result get_eosvmoc_warm_up_status( const get_eosvmoc_warm_up_status_params& params )const;
+
+   struct export_eosvmoc_code_params {
+      fc::sha256 code_hash;
+      uint8_t    vm_version = 0;
+   };
+
+   struct export_eosvmoc_code_result {
+      fc::sha256 code_hash;
+      uint8_t    vm_version = 0;
+      string     target;    ///< nodes this code can be imported into, empty when the code is not compiled
+      bytes      artifact;  ///< packed eosvmoc::code_artifact, the params of import_eosvmoc_code
+   };
+
+   /// machine code of a contract compiled by EOS VM OC, for import_eosvmoc_code on other nodes built for the same target
+   export_eosvmoc_code_result export_eosvmoc_code( const export_eosvmoc_code_params& params )const;
+
+   struct get_wasm_cache_stats_params {
+   };
+
+   using get_wasm_cache_stats_result = chain::wasm_cache_stats;
+
+   get_wasm_cache_stats_result get_wasm_cache_stats( const get_wasm_cache_stats_params& params )const;
+
+   struct get_thread_placement_params {
+   };
+
+   struct get_thread_placement_result {
+      vector<chain::thread_placement::entry> threads;
+   };
+
+   get_thread_placement_result get_thread_placement( const get_thread_placement_params& params )const;
+
+   struct get_startup_timing_params {
+   };
+
+   struct get_startup_timing_result {
+      vector<chain::startup_phase> phases; ///< by start time, phases running concurrently overlap
+   };
+
+   get_startup_timing_result get_startup_timing( const get_startup_timing_params& params )const;
+
+   struct get_memory_usage_params {
+   };
+
+   using get_memory_usage_result = chain::memory_accounting::usage;
+
+   get_memory_usage_result get_memory_usage( const get_memory_usage_params& params )const;
+
+   struct get_wasm_profile_params {
+      uint32_t limit = 100;
+   };
+
+   struct get_wasm_profile_result {
+      vector<chain::wasm_profile_entry> rows; ///< most expensive first
+      bool                              more = false;
+   };
+
+   get_wasm_profile_result get_wasm_profile( const get_wasm_profile_params& params )const;
+
+   struct get_action_stats_params {
+      bool     completed = true; ///< the last completed window, otherwise the one in progress
+      uint32_t limit = 100;
+   };
+
+   struct get_action_stats_result {
+      bool                       enabled = false;
+      chain::action_stats_window window;
+   };
+
+   get_action_stats_result get_action_stats( const get_action_stats_params& params )const;
+
    struct get_scheduled_transactions_params {
       bool        json = false;
       string      lower_bound;  /// timestamp OR transaction ID
@@ -418,6 +674,18 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
+   static void validate_table_row_filters( const read_only::get_table_rows_params& p );
+   static bool table_row_matches( const fc::variant& row, const vector<table_row_filter>& filters );
+   static fc::variant project_table_row( const fc::variant& row, const vector<string>& fields );
+
+   /// rows are only decoded for json queries, binary ones need no ABI at all
+   abi_serializer_cache::abi_serializer_ptr get_table_rows_serializer( const read_only::get_table_rows_params& p )const {
+      if( !p.json ) return {};
+      auto abis = abi_serializer_cache::instance().get( db.db(), p.code, abi_serializer_max_time );
+      EOS_ASSERT( abis, chain::contract_table_query_exception, "No ABI for ${code}", ("code", p.code) );
+      return abis;
+   }
+
    template <typename IndexType, typename SecKeyType, typename ConvFn>
    read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
       read_only::get_table_rows_result result;
@@ -425,8 +693,7 @@ public:
 
       name scope{ convert_to_type<uint64_t>(p.scope, "scope") };
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
+      const auto abis = get_table_rows_serializer( p );
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -465,6 +732,15 @@ public:
             }
          }
 
+         if( p.continuation.size() ) {
+            const auto c = decode_continuation<table_continuation>( p.continuation );
+            EOS_ASSERT( c.table_id == static_cast<uint64_t>(index_t_id->id._id) && c.secondary_key.size() == sizeof(secondary_key_type),
+                        chain::contract_table_query_exception, "continuation does not belong to this index" );
+            auto& bound = (p.reverse && *p.reverse) ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            memcpy( &std::get<1>(bound), c.secondary_key.data(), sizeof(secondary_key_type) );
+            std::get<2>(bound) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
             return result;
 
@@ -479,7 +755,9 @@ public:
 
                fc::variant data_var;
                if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
+                  data_var = abis->binary_to_variant( abis->get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
+                  if( !p.filters.empty() && !table_row_matches( data_var, p.filters ) ) continue;
+                  if( !p.fields.empty() ) data_var = project_table_row( data_var, p.fields );
                } else {
                   data_var = fc::variant( data );
                }
@@ -495,6 +773,9 @@ public:
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->secondary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               table_continuation c{ static_cast<uint64_t>(index_t_id->id._id), itr->primary_key, vector<char>(sizeof(secondary_key_type)) };
+               memcpy( c.secondary_key.data(), &itr->secondary_key, sizeof(secondary_key_type) );
+               result.next_continuation = encode_continuation( c );
             }
          };
 
@@ -516,8 +797,7 @@ public:
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
+      const auto abis = get_table_rows_serializer( p );
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, name(scope), p.table));
       if( t_id != nullptr ) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -544,6 +824,14 @@ public:
             }
          }
 
+         if( p.continuation.size() ) {
+            const auto c = decode_continuation<table_continuation>( p.continuation );
+            EOS_ASSERT( c.table_id == static_cast<uint64_t>(t_id->id._id) && c.secondary_key.empty(),
+                        chain::contract_table_query_exception, "continuation does not belong to this table" );
+            auto& bound = (p.reverse && *p.reverse) ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            std::get<1>(bound) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple  )
             return result;
 
@@ -551,12 +839,14 @@ public:
             auto cur_time = fc::time_point::now();
             auto end_time = cur_time + fc::microseconds(1000 * 10); /// 10ms max time
             vector<char> data;
-            for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++count, ++itr, cur_time = fc::time_point::now() ) {
+            for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++itr, cur_time = fc::time_point::now() ) {
                copy_inline_row(*itr, data);
 
                fc::variant data_var;
                if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
+                  data_var = abis->binary_to_variant( abis->get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
+                  if( !p.filters.empty() && !table_row_matches( data_var, p.filters ) ) continue;
+                  if( !p.fields.empty() ) data_var = project_table_row( data_var, p.fields );
                } else {
                   data_var = fc::variant( data );
                }
@@ -566,10 +856,13 @@ public:
                } else {
                   result.rows.emplace_back( std::move(data_var) );
                }
+
+               ++count;
             }
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->primary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_continuation = encode_continuation( table_continuation{ static_cast<uint64_t>(t_id->id._id), itr->primary_key, {} } );
             }
          };
 
@@ -606,15 +899,42 @@ public:
       fc::variant                 processed;
    };
    void push_transaction(const push_transaction_params& params, chain::plugin_interface::next_function<push_transaction_results> next);
+   /// push_transaction of an already parsed transaction
+   void push_packed_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<push_transaction_results> next);
 
+   /**
+    * Converts params given in the packed form, with packed_trx, which needs no abi and so can be done on any thread.
+    * @return null if the transaction is given unpacked and has to go through push_transaction or send_transaction
+    */
+   static chain::packed_transaction_ptr parse_packed_transaction(const push_transaction_params& params, const fc::microseconds& max_serialization_time);
 
    using push_transactions_params  = vector<push_transaction_params>;
    using push_transactions_results = vector<push_transaction_results>;
+   /// the signatures of all transactions are recovered in parallel first, then they are pushed in order
    void push_transactions(const push_transactions_params& params, chain::plugin_interface::next_function<push_transactions_results> next);
 
    using send_transaction_params = push_transaction_params;
    using send_transaction_results = push_transaction_results;
    void send_transaction(const send_transaction_params& params, chain::plugin_interface::next_function<send_transaction_results> next);
+   void send_packed_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<send_transaction_results> next);
+
+   /// executes the transaction against the pending state and discards its effects, see controller::push_read_only_transaction
+   using push_read_only_transaction_params = push_transaction_params;
+   using push_read_only_transaction_results = push_transaction_results;
+   push_read_only_transaction_results push_read_only_transaction(const push_read_only_transaction_params& params);
+
+   struct import_eosvmoc_code_params {
+      bytes artifact; ///< as returned by export_eosvmoc_code
+   };
+
+   struct import_eosvmoc_code_results {
+      fc::sha256 code_hash;
+      uint8_t    vm_version = 0;
+      bool       imported = false; ///< false when the code was already compiled or compiling
+   };
+
+   /// stores machine code compiled by EOS VM OC on a trusted node, so the contract runs compiled without compiling it
+   import_eosvmoc_code_results import_eosvmoc_code(const import_eosvmoc_code_params& params);
 
    friend resolver_factory<read_write>;
 };
@@ -703,22 +1023,24 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
-   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time()); }
+   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time(), get_producers_view(), get_account_summary_cache(), get_transaction_status_cache(), get_key_account_index()); }
    chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time()); }
 
    void accept_block( const chain::signed_block_ptr& block );
+   /// thread safe, key recovery starts on the producer thread pool before the transaction is queued for the application thread;
+   /// next is called from the application thread, or right away if prevalidate_transaction rejects the transaction
    void accept_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<chain::transaction_trace_ptr> next);
+   /// thread safe, throws if trx is certain to be rejected by the chain for reasons which need no chain state to check
+   void prevalidate_transaction( const chain::packed_transaction& trx )const;
 
    bool block_is_on_preferred_chain(const chain::block_id_type& block_id);
 
    static bool recover_reversible_blocks( const fc::path& db_dir,
-                                          uint32_t cache_size,
                                           optional<fc::path> new_db_dir = optional<fc::path>(),
                                           uint32_t truncate_at_block = 0
                                         );
 
    static bool import_reversible_blocks( const fc::path& reversible_dir,
-                                         uint32_t cache_size,
                                          const fc::path& reversible_blocks_file
                                        );
 
@@ -733,8 +1055,20 @@ public:
 
    chain::chain_id_type get_chain_id() const;
    fc::microseconds get_abi_serializer_max_time() const;
+   /// nullptr unless producers-view is enabled
+   const chain_apis::producers_view* get_producers_view() const;
+   /// nullptr unless account-summary-cache-size is not 0
+   chain_apis::account_summary_cache* get_account_summary_cache() const;
+   /// nullptr unless transaction-status-window-sec is not 0
+   const chain_apis::transaction_status_cache* get_transaction_status_cache() const;
+   /// nullptr unless key-account-index is enabled
+   const chain_apis::key_account_index* get_key_account_index() const;
+   /// where state checkpoints are kept, named state-checkpoint-<block id>.bin
+   const bfs::path& get_state_checkpoints_dir() const;
 
    static void handle_guard_exception(const chain::guard_exception& e);
+   /// quits without closing the state database, see controller::state_unrecoverable
+   static void handle_state_unrecoverable(const chain::state_unrecoverable_exception& e);
    void do_hard_replay(const variables_map& options);
 
    static void handle_db_exhaustion();
@@ -756,17 +1090,27 @@ FC_REFLECT(eosio::chain_apis::read_only::get_info_results,
            (server_version_string)(fork_db_head_block_num)(fork_db_head_block_id)(server_full_version_string) )
 FC_REFLECT(eosio::chain_apis::read_only::get_activated_protocol_features_params, (lower_bound)(upper_bound)(limit)(search_by_block_num)(reverse) )
 FC_REFLECT(eosio::chain_apis::read_only::get_activated_protocol_features_results, (activated_protocol_features)(more) )
-FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id))
+FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id)(transactions))
 FC_REFLECT(eosio::chain_apis::read_only::get_block_header_state_params, (block_num_or_id))
+FC_REFLECT(eosio::chain_apis::read_only::get_transaction_status_params, (ids))
+FC_REFLECT_DERIVED(eosio::chain_apis::read_only::get_transaction_status_results, (eosio::chain_apis::transaction_status_cache::chain_head), (statuses))
+FC_REFLECT(eosio::chain_apis::read_only::get_accounts_by_authorizers_params, (accounts)(keys))
+FC_REFLECT(eosio::chain_apis::read_only::get_accounts_by_authorizers_results, (accounts))
+FC_REFLECT(eosio::chain_apis::read_only::get_transaction_block_params, (id))
+FC_REFLECT(eosio::chain_apis::read_only::get_transaction_block_results, (id)(block_num)(irreversible))
 
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer) )
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key) );
+FC_REFLECT( eosio::chain_apis::read_only::table_row_filter, (field)(op)(value) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer)(continuation)(filters)(fields) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key)(next_continuation) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_packed_result, (rows)(payers)(more)(next_key)(next_continuation) );
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit)(reverse) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit)(reverse)(continuation) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result_row, (code)(scope)(table)(payer)(count));
-FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result, (rows)(more) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result, (rows)(more)(next_continuation) );
+FC_REFLECT( eosio::chain_apis::table_continuation, (table_id)(primary_key)(secondary_key) )
+FC_REFLECT( eosio::chain_apis::scope_continuation, (scope)(table) )
 
 FC_REFLECT( eosio::chain_apis::read_only::get_currency_balance_params, (code)(account)(symbol));
 FC_REFLECT( eosio::chain_apis::read_only::get_currency_stats_params, (code)(symbol));
@@ -778,6 +1122,23 @@ FC_REFLECT( eosio::chain_apis::read_only::get_producers_result, (rows)(total_pro
 FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_producer_schedule_params )
 FC_REFLECT( eosio::chain_apis::read_only::get_producer_schedule_result, (active)(pending)(proposed) );
 
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_eosvmoc_warm_up_status_params )
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_wasm_cache_stats_params )
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_thread_placement_params )
+FC_REFLECT( eosio::chain_apis::read_only::get_thread_placement_result, (threads) )
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_startup_timing_params )
+FC_REFLECT( eosio::chain_apis::read_only::get_startup_timing_result, (phases) )
+FC_REFLECT_EMPTY( eosio::chain_apis::read_only::get_memory_usage_params )
+FC_REFLECT( eosio::chain_apis::read_only::get_wasm_profile_params, (limit) )
+FC_REFLECT( eosio::chain_apis::read_only::get_wasm_profile_result, (rows)(more) )
+FC_REFLECT( eosio::chain_apis::read_only::get_action_stats_params, (completed)(limit) )
+FC_REFLECT( eosio::chain_apis::read_only::get_action_stats_result, (enabled)(window) )
+FC_REFLECT( eosio::chain_apis::read_only::get_eosvmoc_warm_up_status_result, (enabled)(total)(compiled)(failed)(pending) );
+FC_REFLECT( eosio::chain_apis::read_only::export_eosvmoc_code_params, (code_hash)(vm_version) )
+FC_REFLECT( eosio::chain_apis::read_only::export_eosvmoc_code_result, (code_hash)(vm_version)(target)(artifact) )
+FC_REFLECT( eosio::chain_apis::read_write::import_eosvmoc_code_params, (artifact) )
+FC_REFLECT( eosio::chain_apis::read_write::import_eosvmoc_code_results, (code_hash)(vm_version)(imported) )
+
 FC_REFLECT( eosio::chain_apis::read_only::get_scheduled_transactions_params, (json)(lower_bound)(limit) )
 FC_REFLECT( eosio::chain_apis::read_only::get_scheduled_transactions_result, (transactions)(more) );
 
@@ -790,6 +1151,7 @@ FC_REFLECT( eosio::chain_apis::read_only::get_code_results, (account_name)(code_
 FC_REFLECT( eosio::chain_apis::read_only::get_code_hash_results, (account_name)(code_hash) )
 FC_REFLECT( eosio::chain_apis::read_only::get_abi_results, (account_name)(abi) )
 FC_REFLECT( eosio::chain_apis::read_only::get_account_params, (account_name)(expected_core_symbol) )
+FC_REFLECT( eosio::chain_apis::read_only::batch_call, (call)(params) )
 FC_REFLECT( eosio::chain_apis::read_only::get_code_params, (account_name)(code_as_wasm) )
 FC_REFLECT( eosio::chain_apis::read_only::get_code_hash_params, (account_name) )
 FC_REFLECT( eosio::chain_apis::read_only::get_abi_params, (account_name) )
@@ -804,3 +1166,6 @@ FC_REFLECT( eosio::chain_apis::read_only::abi_bin_to_json_params, (code)(action)
 FC_REFLECT( eosio::chain_apis::read_only::abi_bin_to_json_result, (args) )
 FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_params, (transaction)(available_keys) )
 FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_result, (required_keys) )
+FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_batch_params, (transactions)(available_keys) )
+FC_REFLECT( eosio::chain_apis::read_only::required_keys_of_transaction, (required_keys)(error) )
+FC_REFLECT( eosio::chain_apis::read_only::get_required_keys_batch_result, (results) )
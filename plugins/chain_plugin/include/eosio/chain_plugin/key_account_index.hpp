@@ -0,0 +1,91 @@
+#pragma once
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/controller.hpp>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace eosio { namespace chain_apis {
+
+   /**
+    * Reverse index of the authorities of every permission: from each key and each permission level of an authority
+    * to the (account, permission) it belongs to, so that wallets can find the accounts of their keys without
+    * history_plugin.
+    *
+    * Built from the state when the chain starts and kept up to date on the main thread from the undo state of every
+    * accepted block: only the permissions the block changed are read again. The permissions changed by reversible
+    * blocks are read again as well when a fork switch pops those blocks. Blocks applied without an undo session
+    * rebuild it from scratch. Answers from any thread without touching the chain state.
+    */
+   class key_account_index {
+      public:
+         struct account_result {
+            chain::name                             account_name;
+            chain::name                             permission_name;
+            optional<chain::permission_level>       authorizing_account;
+            optional<chain::public_key_type>        authorizing_key;
+            chain::weight_type                      weight = 0;
+            uint32_t                                threshold = 0;
+         };
+
+         explicit key_account_index( const chain::controller& chain );
+
+         /// main thread only
+         void rebuild();
+         void on_accepted_block( const chain::block_state_ptr& bsp );
+         void on_irreversible_block( const chain::block_state_ptr& bsp );
+
+         /**
+          * thread safe, the permissions whose authority holds one of authorizing_keys or authorizing_accounts, ordered by
+          * account and permission. A permission level with an empty permission matches every permission of its actor.
+          */
+         vector<account_result> get( const vector<chain::permission_level>& authorizing_accounts,
+                                     const vector<chain::public_key_type>& authorizing_keys )const;
+
+         /// thread safe, number of permissions indexed
+         size_t size()const;
+
+      private:
+         using permission_key = std::pair<chain::name, chain::name>; ///< (owner, name)
+
+         struct permission_entry {
+            uint32_t                                threshold = 0;
+            vector<chain::key_weight>               keys;
+            vector<chain::permission_level_weight>  accounts;
+         };
+
+         /// permissions changed by a reversible block, read again if the block is popped by a fork switch
+         struct block_permissions {
+            uint32_t                                block_num = 0;
+            vector<permission_key>                  permissions;
+         };
+
+         /// permissions changed by the block being accepted, empty if there is no undo state for it
+         optional<vector<permission_key>> changed_permissions()const;
+
+         /// @pre _mtx is held
+         void erase( const permission_key& perm );
+         /// @pre _mtx is held
+         void set( const chain::permission_object& p );
+         /// @pre _mtx is held, makes the entry of perm match the current state
+         void refresh( const permission_key& perm );
+
+         const chain::controller&                                                _chain;
+
+         // main thread only
+         std::deque<block_permissions>                                           _reversible;
+         chain::block_id_type                                                    _last_block_id;
+         bool                                                                    _built = false;
+
+         mutable std::mutex                                                      _mtx;
+         std::map<permission_key, permission_entry>                              _permissions; ///< protected by _mtx
+         std::set<std::tuple<chain::public_key_type, chain::name, chain::name>>  _by_key;      ///< (key, owner, name), protected by _mtx
+         std::set<std::tuple<chain::name, chain::name, chain::name, chain::name>> _by_account; ///< (actor, permission, owner, name), protected by _mtx
+   };
+
+} } /// eosio::chain_apis
+
+FC_REFLECT( eosio::chain_apis::key_account_index::account_result,
+            (account_name)(permission_name)(authorizing_account)(authorizing_key)(weight)(threshold) )
@@ -0,0 +1,70 @@
+#pragma once
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace eosio { namespace chain_apis {
+
+   /**
+    * Decoded copy of the rows of the eosio producers table, ordered like its by_votes secondary index.
+    *
+    * The copy is kept up to date on the main thread from the undo state of every accepted block: only the rows the
+    * block changed are decoded again. Blocks applied without an undo session, fork switches and abi changes rebuild
+    * it from scratch. Readers get an immutable state which they can use from any thread.
+    */
+   class producers_view {
+      public:
+         struct producer_row {
+            chain::name  owner;
+            chain::bytes data;
+            fc::variant  json;
+         };
+
+         struct state {
+            std::map<std::pair<double, uint64_t>, std::shared_ptr<const producer_row>> by_votes; ///< (secondary key, owner)
+            std::map<uint64_t, double>                                                    votes_key; ///< owner -> secondary key
+            double                                                                        total_producer_vote_weight = 0;
+         };
+
+         producers_view( const chain::controller& chain, const fc::microseconds& abi_serializer_max_time );
+
+         /// main thread only
+         void on_accepted_block( const chain::block_state_ptr& bsp );
+
+         /// thread safe, nullptr if the producers table or its abi is not available
+         std::shared_ptr<const state> get_state()const;
+
+      private:
+         struct table_ids {
+            int64_t producers = -1;
+            int64_t by_votes  = -1;
+            int64_t global    = -1;
+
+            bool operator==( const table_ids& o )const {
+               return producers == o.producers && by_votes == o.by_votes && global == o.global;
+            }
+         };
+
+         table_ids find_table_ids()const;
+         std::shared_ptr<const producer_row> decode_row( const chain::abi_serializer& abis, uint64_t owner, const chain::shared_blob& value )const;
+         double decode_total_vote_weight( const chain::abi_serializer& abis )const;
+
+         void rebuild( const chain::abi_serializer& abis );
+         bool update( const chain::abi_serializer& abis );
+         void set_state( std::shared_ptr<const state> s );
+
+         const chain::controller&                           _chain;
+         const fc::microseconds                             _abi_serializer_max_time;
+
+         // main thread only
+         chain::abi_serializer_cache::abi_serializer_ptr    _abis;
+         table_ids                                          _table_ids;
+         chain::block_id_type                               _last_block_id;
+
+         mutable std::mutex                                 _mtx;
+         std::shared_ptr<const state>                       _state; ///< protected by _mtx
+   };
+
+} } /// eosio::chain_apis
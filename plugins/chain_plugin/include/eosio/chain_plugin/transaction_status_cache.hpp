@@ -0,0 +1,86 @@
+#pragma once
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/trace.hpp>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain_apis {
+
+   /**
+    * Status of the transactions applied or included in a block during the last window of time, for clients polling
+    * many recent transactions by id.
+    *
+    * Fed on the main thread by applied_transaction, for transactions executed locally or failing, and by the
+    * accepted and irreversible block signals, for transactions included in blocks. The transactions of blocks
+    * replaced by a fork switch fall back to their local status until a block of the new branch includes them.
+    * Answers from any thread without touching the chain state.
+    */
+   class transaction_status_cache {
+      public:
+         struct status {
+            transaction_id_type                                 id;
+            string                                              state = "UNKNOWN"; ///< LOCALLY_APPLIED, FAILED, IN_BLOCK, IRREVERSIBLE or UNKNOWN
+            optional<uint32_t>                                  block_num;
+            optional<chain::block_id_type>                      block_id;
+            optional<chain::block_timestamp_type>               block_time;
+            optional<chain::transaction_receipt_header::status_enum> receipt_status;
+            optional<string>                                    error; ///< of a failed local execution
+         };
+
+         struct chain_head {
+            uint32_t              head_block_num = 0;
+            chain::block_id_type  head_block_id;
+            uint32_t              last_irreversible_block_num = 0;
+         };
+
+         explicit transaction_status_cache( const fc::microseconds& window );
+
+         /// main thread only
+         void on_applied_transaction( const chain::transaction_trace_ptr& trace );
+         void on_accepted_block( const chain::block_state_ptr& bsp );
+         void on_irreversible_block( const chain::block_state_ptr& bsp );
+
+         /// thread safe, in the order of ids
+         vector<status> get( const vector<transaction_id_type>& ids, chain_head& head )const;
+
+         size_t size()const;
+
+      private:
+         struct entry {
+            fc::time_point                   updated;
+            // set by the local execution
+            bool                             failed = false;
+            optional<string>                 error;
+            bool                             applied = false;
+            // set by the block including it
+            uint32_t                         block_num = 0;
+            chain::block_id_type             block_id;
+            chain::block_timestamp_type      block_time;
+            chain::transaction_receipt_header::status_enum receipt_status = chain::transaction_receipt_header::executed;
+         };
+
+         struct included_block {
+            chain::block_id_type             id;
+            vector<transaction_id_type>      trx_ids;
+         };
+
+         /// @pre _mtx is held
+         void prune( const fc::time_point& now );
+         entry& touch( const transaction_id_type& id, const fc::time_point& now );
+
+         const fc::microseconds                                 _window;
+
+         mutable std::mutex                                     _mtx;
+         std::unordered_map<transaction_id_type, entry>         _entries;   ///< protected by _mtx
+         std::deque<std::pair<fc::time_point, transaction_id_type>> _order; ///< ids by last update, stale pairs are skipped, protected by _mtx
+         std::map<uint32_t, included_block>                     _blocks;    ///< reversible blocks by number, protected by _mtx
+         chain_head                                             _head;      ///< protected by _mtx
+   };
+
+} } /// eosio::chain_apis
+
+FC_REFLECT( eosio::chain_apis::transaction_status_cache::status, (id)(state)(block_num)(block_id)(block_time)(receipt_status)(error) )
+FC_REFLECT( eosio::chain_apis::transaction_status_cache::chain_head, (head_block_num)(head_block_id)(last_irreversible_block_num) )
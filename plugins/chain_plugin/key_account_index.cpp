@@ -0,0 +1,158 @@
+#include <eosio/chain_plugin/key_account_index.hpp>
+#include <eosio/chain/permission_object.hpp>
+
+namespace eosio { namespace chain_apis {
+
+using namespace eosio::chain;
+
+key_account_index::key_account_index( const controller& chain )
+:_chain(chain)
+{}
+
+void key_account_index::erase( const permission_key& perm ) {
+   auto itr = _permissions.find( perm );
+   if( itr == _permissions.end() ) return;
+   for( const auto& k : itr->second.keys )
+      _by_key.erase( std::make_tuple( k.key, perm.first, perm.second ) );
+   for( const auto& a : itr->second.accounts )
+      _by_account.erase( std::make_tuple( a.permission.actor, a.permission.permission, perm.first, perm.second ) );
+   _permissions.erase( itr );
+}
+
+void key_account_index::set( const permission_object& p ) {
+   const permission_key perm( p.owner, p.name );
+   erase( perm );
+   permission_entry e;
+   e.threshold = p.auth.threshold;
+   e.keys.reserve( p.auth.keys.size() );
+   for( const auto& k : p.auth.keys ) {
+      e.keys.emplace_back( k );
+      _by_key.emplace( e.keys.back().key, p.owner, p.name );
+   }
+   e.accounts.assign( p.auth.accounts.begin(), p.auth.accounts.end() );
+   for( const auto& a : e.accounts )
+      _by_account.emplace( a.permission.actor, a.permission.permission, p.owner, p.name );
+   _permissions.emplace( perm, std::move(e) );
+}
+
+void key_account_index::refresh( const permission_key& perm ) {
+   const auto* p = _chain.db().find<permission_object, by_owner>( boost::make_tuple( perm.first, perm.second ) );
+   if( p ) set( *p );
+   else erase( perm );
+}
+
+void key_account_index::rebuild() {
+   const auto& d = _chain.db();
+   std::lock_guard<std::mutex> g( _mtx );
+   _permissions.clear();
+   _by_key.clear();
+   _by_account.clear();
+   for( const auto& p : d.get_index<permission_index>().indices() )
+      set( p );
+   _reversible.clear();
+   _last_block_id = _chain.head_block_id();
+   _built = true;
+}
+
+optional<vector<key_account_index::permission_key>> key_account_index::changed_permissions()const {
+   const auto& index = _chain.db().get_index<permission_index>();
+   if( index.stack().empty() ) return {};
+   vector<permission_key> changed;
+   const auto& undo = index.stack().back();
+   for( const auto& old : undo.old_values ) changed.emplace_back( old.second.owner, old.second.name );
+   for( const auto& removed : undo.removed_values ) changed.emplace_back( removed.second.owner, removed.second.name );
+   for( const auto& id : undo.new_ids ) {
+      const auto& p = index.get( id );
+      changed.emplace_back( p.owner, p.name );
+   }
+   return changed;
+}
+
+void key_account_index::on_accepted_block( const block_state_ptr& bsp ) {
+   // blocks replayed while the chain starts are covered by the rebuild which follows
+   if( !_built ) return;
+   auto changed = _chain.db().revision() == int64_t(bsp->block_num) ? changed_permissions() : optional<vector<permission_key>>();
+   if( !changed ) {
+      ilog( "rebuilding key account index at block ${n}", ("n", bsp->block_num) );
+      rebuild();
+      return;
+   }
+
+   std::lock_guard<std::mutex> g( _mtx );
+   if( bsp->header.previous != _last_block_id ) {
+      // blocks at or above this one were popped by a fork switch, undo what they did to the index
+      while( !_reversible.empty() && _reversible.back().block_num >= bsp->block_num ) {
+         for( const auto& perm : _reversible.back().permissions ) refresh( perm );
+         _reversible.pop_back();
+      }
+   }
+   for( const auto& perm : *changed ) refresh( perm );
+   _reversible.push_back( block_permissions{ bsp->block_num, std::move(*changed) } );
+   _last_block_id = bsp->id;
+}
+
+void key_account_index::on_irreversible_block( const block_state_ptr& bsp ) {
+   while( !_reversible.empty() && _reversible.front().block_num <= bsp->block_num ) {
+      _reversible.pop_front();
+   }
+}
+
+vector<key_account_index::account_result> key_account_index::get( const vector<permission_level>& authorizing_accounts,
+                                                                   const vector<public_key_type>& authorizing_keys )const {
+   const flat_set<permission_level> accounts( authorizing_accounts.begin(), authorizing_accounts.end() );
+   const flat_set<public_key_type> keys( authorizing_keys.begin(), authorizing_keys.end() );
+
+   // ordered by (account, permission, authorizer), a permission holding several of the authorizers is listed once for each
+   std::map<std::tuple<name, name, size_t, name>, account_result> found;
+   std::lock_guard<std::mutex> g( _mtx );
+   auto add = [&]( const permission_key& perm, size_t authorizer, name authorizer_permission, account_result r ) {
+      const auto& e = _permissions.at( perm );
+      r.account_name = perm.first;
+      r.permission_name = perm.second;
+      r.threshold = e.threshold;
+      found.emplace( std::make_tuple( perm.first, perm.second, authorizer, authorizer_permission ), std::move(r) );
+   };
+
+   for( size_t i = 0; i < accounts.size(); ++i ) {
+      const auto& level = *( accounts.begin() + i );
+      auto itr = level.permission.empty() ? _by_account.lower_bound( std::make_tuple( level.actor, name(), name(), name() ) )
+                                          : _by_account.lower_bound( std::make_tuple( level.actor, level.permission, name(), name() ) );
+      for( ; itr != _by_account.end() && std::get<0>(*itr) == level.actor; ++itr ) {
+         if( !level.permission.empty() && std::get<1>(*itr) != level.permission ) break;
+         const permission_key perm( std::get<2>(*itr), std::get<3>(*itr) );
+         const permission_level authorizing{ std::get<0>(*itr), std::get<1>(*itr) };
+         account_result r;
+         r.authorizing_account = authorizing;
+         for( const auto& a : _permissions.at( perm ).accounts ) {
+            if( a.permission == authorizing ) r.weight = a.weight;
+         }
+         add( perm, i, authorizing.permission, std::move(r) );
+      }
+   }
+
+   for( size_t i = 0; i < keys.size(); ++i ) {
+      const auto& key = *( keys.begin() + i );
+      for( auto itr = _by_key.lower_bound( std::make_tuple( key, name(), name() ) );
+           itr != _by_key.end() && std::get<0>(*itr) == key; ++itr ) {
+         const permission_key perm( std::get<1>(*itr), std::get<2>(*itr) );
+         account_result r;
+         r.authorizing_key = key;
+         for( const auto& k : _permissions.at( perm ).keys ) {
+            if( k.key == key ) r.weight = k.weight;
+         }
+         add( perm, accounts.size() + i, name(), std::move(r) );
+      }
+   }
+
+   vector<account_result> result;
+   result.reserve( found.size() );
+   for( auto& f : found ) result.push_back( std::move(f.second) );
+   return result;
+}
+
+size_t key_account_index::size()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _permissions.size();
+}
+
+} } /// eosio::chain_apis
@@ -0,0 +1,148 @@
+#include <eosio/chain_plugin/producers_view.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <softfloat.hpp>
+
+namespace eosio { namespace chain_apis {
+
+using namespace eosio::chain;
+
+producers_view::producers_view( const controller& chain, const fc::microseconds& abi_serializer_max_time )
+:_chain(chain)
+,_abi_serializer_max_time(abi_serializer_max_time)
+{}
+
+producers_view::table_ids producers_view::find_table_ids()const {
+   const auto& d = _chain.db();
+   static const uint8_t secondary_index_num = 0;
+   auto find = [&d]( name table ) -> int64_t {
+      const auto* t = d.find<table_id_object, by_code_scope_table>(
+            boost::make_tuple(config::system_account_name, config::system_account_name, table));
+      return t ? t->id._id : -1;
+   };
+   table_ids ids;
+   ids.producers = find( N(producers) );
+   ids.by_votes  = find( name(N(producers).to_uint64_t() | secondary_index_num) );
+   ids.global    = find( N(global) );
+   return ids;
+}
+
+std::shared_ptr<const producers_view::producer_row>
+producers_view::decode_row( const abi_serializer& abis, uint64_t owner, const shared_blob& value )const {
+   auto row = std::make_shared<producer_row>();
+   row->owner = name(owner);
+   row->data.assign( value.data(), value.data() + value.size() );
+   row->json = abis.binary_to_variant( abis.get_table_type(N(producers)), row->data, _abi_serializer_max_time, false );
+   return row;
+}
+
+double producers_view::decode_total_vote_weight( const abi_serializer& abis )const {
+   const auto& kv_index = _chain.db().get_index<key_value_index, by_scope_primary>();
+   const auto it = kv_index.find( boost::make_tuple(table_id(_table_ids.global), N(global).to_uint64_t()) );
+   EOS_ASSERT( it != kv_index.end(), contract_table_query_exception, "Missing row in table global" );
+   bytes data( it->value.data(), it->value.data() + it->value.size() );
+   return abis.binary_to_variant( abis.get_table_type(N(global)), data, _abi_serializer_max_time, false )["total_producer_vote_weight"].as_double();
+}
+
+void producers_view::rebuild( const abi_serializer& abis ) {
+   const auto& d = _chain.db();
+   EOS_ASSERT( _table_ids.producers >= 0 && _table_ids.by_votes >= 0 && _table_ids.global >= 0,
+               contract_table_query_exception, "Missing producers table" );
+
+   auto s = std::make_shared<state>();
+   const auto& kv_index = d.get_index<key_value_index, by_scope_primary>();
+   const auto& secondary_index = d.get_index<index_double_index, by_secondary>();
+   for( auto it = secondary_index.lower_bound( boost::make_tuple(table_id(_table_ids.by_votes)) );
+        it != secondary_index.end() && it->t_id._id == _table_ids.by_votes; ++it ) {
+      const auto kv = kv_index.find( boost::make_tuple(table_id(_table_ids.producers), it->primary_key) );
+      if( kv == kv_index.end() ) continue;
+      const double key = from_softfloat64( it->secondary_key );
+      s->by_votes.emplace( std::make_pair(key, it->primary_key), decode_row( abis, it->primary_key, kv->value ) );
+      s->votes_key.emplace( it->primary_key, key );
+   }
+   s->total_producer_vote_weight = decode_total_vote_weight( abis );
+   set_state( std::move(s) );
+}
+
+bool producers_view::update( const abi_serializer& abis ) {
+   const auto& d = _chain.db();
+   const auto& kv_undo_stack = d.get_index<key_value_index>().stack();
+   const auto& secondary_undo_stack = d.get_index<index_double_index>().stack();
+   if( kv_undo_stack.empty() || secondary_undo_stack.empty() ) return false;
+
+   // owners of the rows of either table the block changed
+   flat_set<uint64_t> changed;
+   bool global_changed = false;
+   auto collect = [&]( const auto& index, const auto& undo, int64_t tid ) {
+      for( const auto& old : undo.old_values ) {
+         if( old.second.t_id._id == tid ) changed.insert( old.second.primary_key );
+         global_changed = global_changed || old.second.t_id._id == _table_ids.global;
+      }
+      for( const auto& removed : undo.removed_values ) {
+         if( removed.second.t_id._id == tid ) changed.insert( removed.second.primary_key );
+      }
+      for( const auto& id : undo.new_ids ) {
+         const auto& row = index.get( id );
+         if( row.t_id._id == tid ) changed.insert( row.primary_key );
+      }
+   };
+   collect( d.get_index<key_value_index>(), kv_undo_stack.back(), _table_ids.producers );
+   collect( d.get_index<index_double_index>(), secondary_undo_stack.back(), _table_ids.by_votes );
+   if( changed.empty() && !global_changed ) return true;
+
+   auto s = std::make_shared<state>( *get_state() );
+   const auto& kv_index = d.get_index<key_value_index, by_scope_primary>();
+   const auto& secondary_by_primary = d.get_index<index_double_index, by_primary>();
+   for( const auto owner : changed ) {
+      auto key_itr = s->votes_key.find( owner );
+      if( key_itr != s->votes_key.end() ) {
+         s->by_votes.erase( std::make_pair(key_itr->second, owner) );
+         s->votes_key.erase( key_itr );
+      }
+      const auto kv = kv_index.find( boost::make_tuple(table_id(_table_ids.producers), owner) );
+      const auto sec = secondary_by_primary.find( boost::make_tuple(table_id(_table_ids.by_votes), owner) );
+      if( kv == kv_index.end() || sec == secondary_by_primary.end() ) continue;
+      const double key = from_softfloat64( sec->secondary_key );
+      s->by_votes.emplace( std::make_pair(key, owner), decode_row( abis, owner, kv->value ) );
+      s->votes_key.emplace( owner, key );
+   }
+   s->total_producer_vote_weight = decode_total_vote_weight( abis );
+   set_state( std::move(s) );
+   return true;
+}
+
+void producers_view::on_accepted_block( const block_state_ptr& bsp ) {
+   try {
+      const auto& d = _chain.db();
+      auto abis = abi_serializer_cache::instance().get( d, config::system_account_name, _abi_serializer_max_time );
+      const auto ids = find_table_ids();
+      const bool incremental = abis && abis == _abis && ids == _table_ids && get_state()
+                               && bsp->header.previous == _last_block_id && d.revision() == int64_t(bsp->block_num);
+      _abis = std::move(abis);
+      _table_ids = ids;
+      _last_block_id = bsp->id;
+      if( !_abis || _table_ids.producers < 0 ) {
+         set_state( nullptr );
+         return;
+      }
+      if( !incremental || !update( *_abis ) ) {
+         rebuild( *_abis );
+      }
+   } catch( const fc::exception& e ) {
+      wlog( "unable to update producers view at block ${n}: ${e}", ("n", bsp->block_num)("e", e.to_detail_string()) );
+      set_state( nullptr );
+   }
+}
+
+std::shared_ptr<const producers_view::state> producers_view::get_state()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _state;
+}
+
+void producers_view::set_state( std::shared_ptr<const state> s ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _state = std::move(s);
+}
+
+} } /// eosio::chain_apis
@@ -0,0 +1,116 @@
+#include <eosio/chain_plugin/transaction_status_cache.hpp>
+
+namespace eosio { namespace chain_apis {
+
+using namespace eosio::chain;
+
+transaction_status_cache::transaction_status_cache( const fc::microseconds& window )
+:_window( window )
+{}
+
+transaction_status_cache::entry& transaction_status_cache::touch( const transaction_id_type& id, const fc::time_point& now ) {
+   auto& e = _entries[id];
+   e.updated = now;
+   _order.emplace_back( now, id );
+   return e;
+}
+
+void transaction_status_cache::prune( const fc::time_point& now ) {
+   while( !_order.empty() && _order.front().first + _window < now ) {
+      auto itr = _entries.find( _order.front().second );
+      // a later update of the entry queued it again
+      if( itr != _entries.end() && itr->second.updated == _order.front().first )
+         _entries.erase( itr );
+      _order.pop_front();
+   }
+}
+
+void transaction_status_cache::on_applied_transaction( const transaction_trace_ptr& trace ) {
+   // transactions of blocks being applied get their status from the block once it is accepted
+   if( trace->producer_block_id )
+      return;
+   const auto now = fc::time_point::now();
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& e = touch( trace->id, now );
+   e.failed = !!trace->except;
+   e.applied = !trace->except;
+   if( trace->except )
+      e.error = trace->except->top_message();
+   else
+      e.error.reset();
+}
+
+void transaction_status_cache::on_accepted_block( const block_state_ptr& bsp ) {
+   const auto now = fc::time_point::now();
+   std::lock_guard<std::mutex> g( _mtx );
+
+   // a block at or below the head replaces the blocks from its number on
+   for( auto itr = _blocks.lower_bound( bsp->block_num ); itr != _blocks.end(); itr = _blocks.erase( itr ) ) {
+      for( const auto& id : itr->second.trx_ids ) {
+         auto e = _entries.find( id );
+         if( e != _entries.end() && e->second.block_id == itr->second.id ) {
+            e->second.block_num = 0;
+            e->second.block_id = block_id_type();
+         }
+      }
+   }
+
+   auto& included = _blocks[bsp->block_num];
+   included.id = bsp->id;
+   for( const auto& receipt : bsp->block->transactions ) {
+      const auto& id = receipt.trx.contains<packed_transaction>() ? receipt.trx.get<packed_transaction>().id()
+                                                                  : receipt.trx.get<transaction_id_type>();
+      auto& e = touch( id, now );
+      e.block_num = bsp->block_num;
+      e.block_id = bsp->id;
+      e.block_time = bsp->header.timestamp;
+      e.receipt_status = receipt.status;
+      included.trx_ids.push_back( id );
+   }
+   _head.head_block_num = bsp->block_num;
+   _head.head_block_id = bsp->id;
+
+   prune( now );
+}
+
+void transaction_status_cache::on_irreversible_block( const block_state_ptr& bsp ) {
+   std::lock_guard<std::mutex> g( _mtx );
+   _head.last_irreversible_block_num = bsp->block_num;
+   _blocks.erase( _blocks.begin(), _blocks.upper_bound( bsp->block_num ) );
+}
+
+vector<transaction_status_cache::status> transaction_status_cache::get( const vector<transaction_id_type>& ids, chain_head& head )const {
+   vector<status> result;
+   result.reserve( ids.size() );
+   std::lock_guard<std::mutex> g( _mtx );
+   head = _head;
+   for( const auto& id : ids ) {
+      result.emplace_back();
+      auto& s = result.back();
+      s.id = id;
+      auto itr = _entries.find( id );
+      if( itr == _entries.end() )
+         continue;
+      const auto& e = itr->second;
+      if( e.block_num ) {
+         s.state = e.block_num <= _head.last_irreversible_block_num ? "IRREVERSIBLE" : "IN_BLOCK";
+         s.block_num = e.block_num;
+         s.block_id = e.block_id;
+         s.block_time = e.block_time;
+         s.receipt_status = e.receipt_status;
+      } else if( e.failed ) {
+         s.state = "FAILED";
+         s.error = e.error;
+      } else if( e.applied ) {
+         s.state = "LOCALLY_APPLIED";
+      }
+   }
+   return result;
+}
+
+size_t transaction_status_cache::size()const {
+   std::lock_guard<std::mutex> g( _mtx );
+   return _entries.size();
+}
+
+} } /// eosio::chain_apis
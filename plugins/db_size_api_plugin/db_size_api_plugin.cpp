@@ -1,12 +1,314 @@
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
 #include <eosio/db_size_api_plugin/db_size_api_plugin.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/block_summary_object.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/database_header_object.hpp>
+#include <eosio/chain/database_utils.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/protocol_state_object.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <eosio/chain/transaction_object.hpp>
+
+#include <boost/core/demangle.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
 
 namespace eosio {
 
 static appbase::abstract_plugin& _db_size_api_plugin = app().register_plugin<db_size_api_plugin>();
 
 using namespace eosio;
+using namespace eosio::chain;
+
+using db_size_index_set = index_set<
+   account_index,
+   account_metadata_index,
+   account_ram_correction_index,
+   global_property_multi_index,
+   protocol_state_multi_index,
+   dynamic_global_property_multi_index,
+   block_summary_multi_index,
+   transaction_multi_index,
+   generated_transaction_multi_index,
+   table_id_multi_index,
+   code_index,
+   database_header_multi_index,
+   key_value_index,
+   index64_index,
+   index128_index,
+   index256_index,
+   index_double_index,
+   index_long_double_index,
+   permission_index,
+   permission_usage_index,
+   permission_link_index,
+   resource_limits::resource_limits_index,
+   resource_limits::resource_usage_index,
+   resource_limits::resource_limits_state_index,
+   resource_limits::resource_limits_config_index
+>;
+
+template<typename Index>
+struct is_contract_table_index : std::false_type {};
+template<> struct is_contract_table_index<key_value_index> : std::true_type {};
+template<> struct is_contract_table_index<index64_index> : std::true_type {};
+template<> struct is_contract_table_index<index128_index> : std::true_type {};
+template<> struct is_contract_table_index<index256_index> : std::true_type {};
+template<> struct is_contract_table_index<index_double_index> : std::true_type {};
+template<> struct is_contract_table_index<index_long_double_index> : std::true_type {};
+
+namespace {
+   // estimates of the boost::interprocess allocator and boost::multi_index layout on 64 bit platforms
+   constexpr uint64_t allocation_header_bytes = 16;
+   constexpr uint64_t ordered_node_bytes = 24;   // parent with packed color, left and right
+   constexpr uint32_t growth_sample_interval = 100;
+   constexpr size_t   growth_samples = 101;      // covers 10k blocks
+
+   template<typename Index>
+   uint64_t row_overhead_bytes() {
+      return allocation_header_bytes + ordered_node_bytes * boost::mpl::size<typename Index::index_type_list>::value;
+   }
+
+   template<typename Object>
+   uint64_t dynamic_bytes( const Object& ) { return 0; }
+
+   uint64_t dynamic_bytes( const key_value_object& o ) {
+      return o.value.size() ? o.value.size() + allocation_header_bytes : 0;
+   }
+}
+
+class db_size_api_plugin_impl : public std::enable_shared_from_this<db_size_api_plugin_impl> {
+public:
+   struct contract_usage {
+      uint64_t primary_rows = 0;
+      uint64_t primary_bytes = 0;
+      uint64_t secondary_rows = 0;
+      uint64_t secondary_bytes = 0;
+   };
+
+   // stage 0 walks key_value_index (or samples it per table), stages 1-5 the secondary indices
+   static constexpr uint32_t num_stages = 6;
+
+   uint32_t                                         rows_per_slice = 10000;
+   uint32_t                                         sample_rows = 0;
+
+   fc::optional<db_size_breakdown>                  completed;
+   std::map<account_name, contract_usage>           completed_contracts;
+
+   bool                                             scanning = false;
+   bool                                             shutting_down = false;
+   uint32_t                                         stage = 0;
+   uint64_t                                         next_id = 0;
+   uint64_t                                         value_bytes = 0;
+   std::map<account_name, contract_usage>           contracts;
+
+   std::deque<std::pair<uint32_t, uint64_t>>        used_bytes_samples; // (block_num, used_bytes)
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+
+   const chainbase::database& db()const { return app().get_plugin<chain_plugin>().chain().db(); }
+
+   static uint64_t used_bytes( const chainbase::database& db ) {
+      return db.get_segment_manager()->get_size() - db.get_segment_manager()->get_free_memory();
+   }
+
+   void on_accepted_block( const block_state_ptr& bsp ) {
+      if( bsp->block_num % growth_sample_interval != 0 )
+         return;
+      used_bytes_samples.emplace_back( bsp->block_num, used_bytes( db() ) );
+      while( used_bytes_samples.size() > growth_samples )
+         used_bytes_samples.pop_front();
+   }
+
+   int64_t growth_bytes_per_1k_blocks()const {
+      if( used_bytes_samples.size() < 2 )
+         return 0;
+      const auto& first = used_bytes_samples.front();
+      const auto& last = used_bytes_samples.back();
+      if( last.first <= first.first )
+         return 0;
+      return (int64_t(last.second) - int64_t(first.second)) * 1000 / int64_t(last.first - first.first);
+   }
+
+   void start_scan() {
+      if( scanning || shutting_down )
+         return;
+      scanning = true;
+      stage = 0;
+      next_id = 0;
+      value_bytes = 0;
+      contracts.clear();
+      post_slice();
+   }
+
+   void post_slice() {
+      app().post( priority::low, [weak = std::weak_ptr<db_size_api_plugin_impl>( shared_from_this() )]() {
+         auto self = weak.lock();
+         if( !self || self->shutting_down )
+            return;
+         try {
+            self->scan_slice();
+         } catch( const fc::exception& e ) {
+            elog( "db size breakdown failed: ${e}", ("e", e.to_detail_string()) );
+            self->scanning = false;
+         } catch( const std::exception& e ) {
+            elog( "db size breakdown failed: ${e}", ("e", e.what()) );
+            self->scanning = false;
+         }
+      } );
+   }
+
+   void scan_slice() {
+      const auto& d = db();
+      uint32_t budget = rows_per_slice;
+      while( budget > 0 && stage < num_stages ) {
+         bool done = true;
+         switch( stage ) {
+            case 0: done = sample_rows ? sample_tables( d, budget ) : scan_rows<key_value_index>( d, budget ); break;
+            case 1: done = sample_rows || scan_rows<index64_index>( d, budget ); break;
+            case 2: done = sample_rows || scan_rows<index128_index>( d, budget ); break;
+            case 3: done = sample_rows || scan_rows<index256_index>( d, budget ); break;
+            case 4: done = sample_rows || scan_rows<index_double_index>( d, budget ); break;
+            case 5: done = sample_rows || scan_rows<index_long_double_index>( d, budget ); break;
+         }
+         if( done ) {
+            ++stage;
+            next_id = 0;
+         }
+      }
+      if( stage < num_stages )
+         post_slice();
+      else
+         finish_scan( d );
+   }
+
+   /// walks the next rows of Index by id; rows created or removed between slices are picked up or missed accordingly
+   template<typename Index>
+   bool scan_rows( const chainbase::database& d, uint32_t& budget ) {
+      using object_type = typename Index::value_type;
+      constexpr bool primary = std::is_same<Index, key_value_index>::value;
+      const auto& idx = d.get_index<Index, by_id>();
+      auto itr = idx.lower_bound( typename object_type::id_type( next_id ) );
+      for( ; itr != idx.end() && budget > 0; ++itr, --budget ) {
+         const auto* t = d.find<table_id_object>( itr->t_id );
+         if( !t )
+            continue;
+         contract_usage& usage = contracts[t->code];
+         const uint64_t dyn = dynamic_bytes( *itr );
+         const uint64_t bytes = sizeof(object_type) + row_overhead_bytes<Index>() + dyn;
+         if( primary ) {
+            ++usage.primary_rows;
+            usage.primary_bytes += bytes;
+            value_bytes += dyn;
+         } else {
+            ++usage.secondary_rows;
+            usage.secondary_bytes += bytes;
+         }
+      }
+      if( itr == idx.end() )
+         return true;
+      next_id = itr->id._id;
+      return false;
+   }
+
+   /**
+    * Extrapolates the key_value_object bytes of each table from its first sample_rows rows. table_id_object::count
+    * includes the secondary index rows of the table so tables with secondary indices are overestimated.
+    */
+   bool sample_tables( const chainbase::database& d, uint32_t& budget ) {
+      const auto& tables = d.get_index<table_id_multi_index, by_id>();
+      const auto& rows = d.get_index<key_value_index, by_scope_primary>();
+      auto itr = tables.lower_bound( table_id( next_id ) );
+      for( ; itr != tables.end() && budget > 0; ++itr ) {
+         uint64_t sampled = 0;
+         uint64_t sampled_dyn = 0;
+         for( auto row = rows.lower_bound( boost::make_tuple( itr->id, 0 ) );
+              row != rows.end() && row->t_id == itr->id && sampled < sample_rows; ++row, ++sampled ) {
+            sampled_dyn += dynamic_bytes( *row );
+         }
+         budget -= std::min<uint64_t>( budget, sampled + 1 );
+         if( sampled == 0 )
+            continue;
+         const uint64_t count = std::max<uint64_t>( itr->count, sampled );
+         const uint64_t dyn = sampled_dyn * count / sampled;
+         contract_usage& usage = contracts[itr->code];
+         usage.primary_rows += count;
+         usage.primary_bytes += count * (sizeof(key_value_object) + row_overhead_bytes<key_value_index>()) + dyn;
+         value_bytes += dyn;
+      }
+      if( itr == tables.end() )
+         return true;
+      next_id = itr->id._id;
+      return false;
+   }
+
+   template<typename Index>
+   static db_size_index_bytes index_bytes( const chainbase::database& d ) {
+      using object_type = typename Index::value_type;
+      const auto& idx = d.get_index<Index>();
+      db_size_index_bytes ret;
+      ret.index = boost::core::demangle( typeid(object_type).name() );
+      ret.row_count = idx.indices().size();
+      ret.object_bytes = ret.row_count * sizeof(object_type);
+      ret.node_overhead_bytes = ret.row_count * row_overhead_bytes<Index>();
+      constexpr uint64_t id_bytes = sizeof(typename object_type::id_type) + allocation_header_bytes + ordered_node_bytes;
+      constexpr uint64_t copy_bytes = sizeof(object_type) + id_bytes;
+      for( const auto& undo : idx.stack() ) {
+         ret.undo_bytes += (undo.old_values.size() + undo.removed_values.size()) * copy_bytes
+                           + undo.new_ids.size() * id_bytes;
+      }
+      return ret;
+   }
+
+   void finish_scan( const chainbase::database& d ) {
+      db_size_breakdown result;
+      result.sampled = sample_rows != 0;
+      result.block_num = app().get_plugin<chain_plugin>().chain().head_block_num();
+      result.size = d.get_segment_manager()->get_size();
+      result.used_bytes = used_bytes( d );
+      result.segments = { db_size_segment_bytes{ "system" }, db_size_segment_bytes{ "contract_tables" } };
+      db_size_index_set::walk_indices( [&]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         result.indices.emplace_back( index_bytes<index_t>( d ) );
+         auto& i = result.indices.back();
+         if( std::is_same<index_t, key_value_index>::value )
+            i.dynamic_bytes = value_bytes;
+         result.undo_bytes += i.undo_bytes;
+         auto& segment = result.segments[is_contract_table_index<index_t>::value ? 1 : 0];
+         segment.row_count += i.row_count;
+         segment.bytes += i.object_bytes + i.node_overhead_bytes + i.dynamic_bytes;
+         segment.undo_bytes += i.undo_bytes;
+      } );
+      completed = std::move( result );
+      completed_contracts = std::move( contracts );
+      contracts.clear();
+      scanning = false;
+   }
+
+   static vector<db_size_contract_bytes> top_contracts( const std::map<account_name, contract_usage>& usage, uint32_t top,
+                                                        bool primary ) {
+      vector<db_size_contract_bytes> ret;
+      for( const auto& u : usage ) {
+         const auto rows = primary ? u.second.primary_rows : u.second.secondary_rows;
+         if( rows )
+            ret.push_back( { u.first, rows, primary ? u.second.primary_bytes : u.second.secondary_bytes } );
+      }
+      const size_t n = std::min<size_t>( top, ret.size() );
+      std::partial_sort( ret.begin(), ret.begin() + n, ret.end(),
+                         []( const auto& a, const auto& b ) { return a.bytes > b.bytes; } );
+      ret.resize( n );
+      return ret;
+   }
+};
 
 #define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
@@ -23,12 +325,47 @@ using namespace eosio;
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle->call_name();
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
+db_size_api_plugin::db_size_api_plugin()
+:my(std::make_shared<db_size_api_plugin_impl>())
+{}
+
+db_size_api_plugin::~db_size_api_plugin() = default;
+
+void db_size_api_plugin::set_program_options(options_description& cli, options_description& cfg) {
+   cfg.add_options()
+      ("db-size-scan-rows-per-slice", bpo::value<uint32_t>()->default_value(10000),
+       "Number of contract table rows /v1/db_size/get_breakdown walks on the main thread before yielding to other work")
+      ("db-size-sample-rows", bpo::value<uint32_t>()->default_value(0),
+       "Extrapolate the bytes of each contract table from this many of its rows instead of walking every row (0 for a full scan)")
+   ;
+}
+
+void db_size_api_plugin::plugin_initialize(const variables_map& options) {
+   try {
+      my->rows_per_slice = options.at( "db-size-scan-rows-per-slice" ).as<uint32_t>();
+      my->sample_rows = options.at( "db-size-sample-rows" ).as<uint32_t>();
+      EOS_ASSERT( my->rows_per_slice > 0, chain::plugin_config_exception,
+                  "db-size-scan-rows-per-slice must be greater than 0" );
+   } FC_LOG_AND_RETHROW()
+}
 
 void db_size_api_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
        CALL(db_size, this, get,
             INVOKE_R_V(this, get), 200),
+       CALL(db_size, this, get_breakdown,
+            INVOKE_R_R(this, get_breakdown, db_size_breakdown_params), 200),
    });
+   my->accepted_block_connection.emplace( app().get_plugin<chain_plugin>().chain().accepted_block.connect(
+         [my = my]( const block_state_ptr& bsp ) { my->on_accepted_block( bsp ); } ) );
+}
+
+void db_size_api_plugin::plugin_shutdown() {
+   my->shutting_down = true;
+   my->accepted_block_connection.reset();
 }
 
 db_size_stats db_size_api_plugin::get() {
@@ -46,6 +383,20 @@ db_size_stats db_size_api_plugin::get() {
    return ret;
 }
 
+db_size_breakdown db_size_api_plugin::get_breakdown(const db_size_breakdown_params& params) {
+   db_size_breakdown ret;
+   if( my->completed ) {
+      ret = *my->completed;
+      ret.top_primary = db_size_api_plugin_impl::top_contracts( my->completed_contracts, params.top, true );
+      ret.top_secondary = db_size_api_plugin_impl::top_contracts( my->completed_contracts, params.top, false );
+   }
+   my->start_scan();
+   ret.scanning = my->scanning;
+   ret.growth_bytes_per_1k_blocks = my->growth_bytes_per_1k_blocks();
+   return ret;
+}
+
+#undef INVOKE_R_R
 #undef INVOKE_R_V
 #undef CALL
 
@@ -21,28 +21,88 @@ struct db_size_stats {
    vector<db_size_index_count> indices;
 };
 
+/// estimated memory of one chainbase index
+struct db_size_index_bytes {
+   string   index;
+   uint64_t row_count = 0;
+   uint64_t object_bytes = 0;        ///< row_count * sizeof(object)
+   uint64_t node_overhead_bytes = 0; ///< tree nodes of every ordered index plus the allocation header of each row
+   uint64_t dynamic_bytes = 0;       ///< separately allocated row data, only key_value_object values
+   uint64_t undo_bytes = 0;          ///< copies and ids held by the undo stack of the index
+};
+
+/**
+ * estimated memory of a group of indices: "contract_tables" for the rows of contract tables and their secondary
+ * indices, "system" for every other index. The groups are where the indices are likely to be placed apart.
+ */
+struct db_size_segment_bytes {
+   string   segment;
+   uint64_t row_count = 0;
+   uint64_t bytes = 0;      ///< object, node overhead and dynamic bytes of its indices
+   uint64_t undo_bytes = 0;
+};
+
+struct db_size_contract_bytes {
+   chain::account_name code;
+   uint64_t            row_count = 0;
+   uint64_t            bytes = 0;
+};
+
+struct db_size_breakdown_params {
+   uint32_t top = 20;
+};
+
+struct db_size_breakdown {
+   bool                           scanning = false;  ///< a new breakdown is being computed
+   bool                           sampled = false;   ///< contract bytes are extrapolated from db-size-sample-rows rows per table
+   uint32_t                       block_num = 0;     ///< head block when the breakdown completed
+   uint64_t                       used_bytes = 0;
+   uint64_t                       size = 0;
+   uint64_t                       undo_bytes = 0;
+   int64_t                        growth_bytes_per_1k_blocks = 0;
+   vector<db_size_index_bytes>    indices;
+   vector<db_size_segment_bytes>  segments;
+   vector<db_size_contract_bytes> top_primary;       ///< contracts with the most key_value_object bytes
+   vector<db_size_contract_bytes> top_secondary;     ///< contracts with the most secondary index bytes, empty when sampled
+};
+
+class db_size_api_plugin_impl;
+
 class db_size_api_plugin : public plugin<db_size_api_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
 
-   db_size_api_plugin() = default;
+   db_size_api_plugin();
    db_size_api_plugin(const db_size_api_plugin&) = delete;
    db_size_api_plugin(db_size_api_plugin&&) = delete;
    db_size_api_plugin& operator=(const db_size_api_plugin&) = delete;
    db_size_api_plugin& operator=(db_size_api_plugin&&) = delete;
-   virtual ~db_size_api_plugin() override = default;
+   virtual ~db_size_api_plugin() override;
 
-   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
-   void plugin_initialize(const variables_map& vm) {}
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+   void plugin_initialize(const variables_map& vm);
    void plugin_startup();
-   void plugin_shutdown() {}
+   void plugin_shutdown();
 
    db_size_stats get();
 
+   /**
+    * Returns the last completed breakdown and starts computing a new one unless that is already in progress. The
+    * scan walks the contract tables in slices on the main thread so block processing is never held up for long.
+    */
+   db_size_breakdown get_breakdown(const db_size_breakdown_params& params);
+
 private:
+   std::shared_ptr<db_size_api_plugin_impl> my;
 };
 
 }
 
 FC_REFLECT( eosio::db_size_index_count, (index)(row_count) )
-FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
\ No newline at end of file
+FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
+FC_REFLECT( eosio::db_size_index_bytes, (index)(row_count)(object_bytes)(node_overhead_bytes)(dynamic_bytes)(undo_bytes) )
+FC_REFLECT( eosio::db_size_segment_bytes, (segment)(row_count)(bytes)(undo_bytes) )
+FC_REFLECT( eosio::db_size_contract_bytes, (code)(row_count)(bytes) )
+FC_REFLECT( eosio::db_size_breakdown_params, (top) )
+FC_REFLECT( eosio::db_size_breakdown, (scanning)(sampled)(block_num)(used_bytes)(size)(undo_bytes)(growth_bytes_per_1k_blocks)
+                                      (indices)(segments)(top_primary)(top_secondary) )
\ No newline at end of file
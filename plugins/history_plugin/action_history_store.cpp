@@ -0,0 +1,193 @@
+#include <eosio/history_plugin/action_history_store.hpp>
+
+namespace eosio {
+   using namespace chain;
+
+   action_history_store::action_history_store( const fc::path& dir )
+   :log_path( dir / "actions.log" ),
+    index_path( dir / "actions.index" ),
+    account_index( dir, "account_actions" ),
+    transaction_index( dir, "transaction_actions" )
+   {
+      log.set_file_path( log_path );
+      index.set_file_path( index_path );
+      reopen();
+
+      // drop what an unclean shutdown left half written: index entries past the log, log data past the last entry
+      log.seek_end( 0 );
+      const uint64_t log_size = log.tellp();
+      index.seek_end( 0 );
+      const uint64_t index_size = index.tellp();
+      num_actions = index_size / sizeof(uint64_t);
+      while( num_actions > 0 ) {
+         try {
+            const auto pos = position( num_actions - 1 );
+            if( pos < log_size ) {
+               log.seek( pos );
+               auto ds = log.create_datastream();
+               action_history_entry entry;
+               fc::raw::unpack( ds, entry );
+               log_end = pos + fc::raw::pack_size( entry );
+               if( log_end <= log_size )
+                  break;
+            }
+         } catch( const fc::exception& ) {
+         }
+         --num_actions;
+      }
+      if( num_actions == 0 )
+         log_end = 0;
+      if( log_end != log_size || index_size != num_actions * sizeof(uint64_t) ) {
+         wlog( "dropping ${n} bytes at the end of the action history log", ("n", log_size - log_end) );
+         truncate_files( num_actions );
+      }
+
+      // the records that were only in memory
+      const uint32_t flushed = std::min( account_index.flushed_block_num(), transaction_index.flushed_block_num() );
+      uint64_t num_indexed = 0;
+      for( auto i = first_action_of( flushed + 1 ); i < num_actions; ++i, ++num_indexed )
+         index_action( i, read_action( i ) );
+      ilog( "action history has ${n} actions, indexed ${i} of them again", ("n", num_actions)("i", num_indexed) );
+   }
+
+   void action_history_store::reopen() {
+      for( auto* f : { &log, &index } ) {
+         if( f->is_open() )
+            f->close();
+         f->open( "ab+" ); // creates the file
+         f->close();
+         f->open( "rb+" );
+      }
+   }
+
+   void action_history_store::truncate_files( uint64_t num ) {
+      const uint64_t end = num < num_actions ? position( num ) : log_end;
+      log.close();
+      index.close();
+      boost::filesystem::resize_file( log_path, end );
+      boost::filesystem::resize_file( index_path, num * sizeof(uint64_t) );
+      reopen();
+      num_actions = num;
+      log_end = end;
+   }
+
+   uint64_t action_history_store::position( uint64_t action_ordinal )const {
+      uint64_t pos = 0;
+      index.seek( action_ordinal * sizeof(pos) );
+      index.read( reinterpret_cast<char*>(&pos), sizeof(pos) );
+      return pos;
+   }
+
+   uint32_t action_history_store::block_num_of( uint64_t action_ordinal )const {
+      // global_sequence and block_num lead the entry
+      uint64_t global_sequence = 0;
+      uint32_t block_num = 0;
+      log.seek( position( action_ordinal ) );
+      log.read( reinterpret_cast<char*>(&global_sequence), sizeof(global_sequence) );
+      log.read( reinterpret_cast<char*>(&block_num), sizeof(block_num) );
+      return block_num;
+   }
+
+   uint64_t action_history_store::first_action_of( uint32_t block_num )const {
+      uint64_t lo = 0, hi = num_actions;
+      while( lo < hi ) {
+         const uint64_t mid = lo + (hi - lo) / 2;
+         if( block_num_of( mid ) < block_num )
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   uint32_t action_history_store::last_block_num()const {
+      return num_actions ? block_num_of( num_actions - 1 ) : 0;
+   }
+
+   void action_history_store::index_action( uint64_t action_ordinal, const action_history_entry& entry ) {
+      if( entry.block_num > account_index.flushed_block_num() ) {
+         for( auto a : entry.accounts )
+            account_index.add( {a, last_account_sequence( a ) + 1, entry.block_num, action_ordinal} );
+      }
+      if( entry.block_num > transaction_index.flushed_block_num() )
+         transaction_index.add( {entry.trx_id, action_ordinal, entry.block_num} );
+   }
+
+   void action_history_store::append( const std::vector<action_history_entry>& entries ) {
+      if( entries.empty() )
+         return;
+      std::vector<uint64_t> positions;
+      positions.reserve( entries.size() );
+      log.seek( log_end );
+      for( const auto& entry : entries ) {
+         const auto data = fc::raw::pack( entry );
+         log.write( data.data(), data.size() );
+         positions.push_back( log_end );
+         log_end += data.size();
+      }
+      log.flush();
+      // the index only points at entries which are completely in the log
+      index.seek( num_actions * sizeof(uint64_t) );
+      index.write( reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(uint64_t) );
+      index.flush();
+      for( const auto& entry : entries )
+         index_action( num_actions++, entry );
+   }
+
+   void action_history_store::truncate_from( uint32_t block_num ) {
+      if( block_num <= std::max( account_index.flushed_block_num(), transaction_index.flushed_block_num() ) ) {
+         // only happens when the chain restarts from an earlier state, e.g. a replay
+         wlog( "removing action history, it has irreversible blocks from ${b} on", ("b", block_num) );
+         clear();
+         return;
+      }
+      if( last_block_num() < block_num )
+         return;
+      const auto first = first_action_of( block_num );
+      truncate_files( first );
+      account_index.truncate_from( block_num );
+      transaction_index.truncate_from( block_num );
+   }
+
+   void action_history_store::set_irreversible( uint32_t block_num ) {
+      account_index.flush( block_num );
+      transaction_index.flush( block_num );
+   }
+
+   void action_history_store::clear() {
+      account_index.clear();
+      transaction_index.clear();
+      truncate_files( 0 );
+   }
+
+   int32_t action_history_store::last_account_sequence( account_name account )const {
+      auto r = account_index.last_before( std::make_tuple( account, std::numeric_limits<int32_t>::max() ) );
+      return r && r->account == account ? r->account_sequence_num : -1;
+   }
+
+   std::vector<account_history_record>
+   action_history_store::get_account_actions( account_name account, int32_t start, int32_t end )const {
+      end = std::min( end, std::numeric_limits<int32_t>::max() - 1 );
+      return account_index.range( std::make_tuple( account, start ), std::make_tuple( account, end + 1 ) );
+   }
+
+   std::vector<transaction_history_record>
+   action_history_store::get_transaction_actions( const transaction_id_type& id )const {
+      auto first = transaction_index.lower_bound( std::make_tuple( id, uint64_t(0) ) );
+      if( !first )
+         return {};
+      return transaction_index.range( std::make_tuple( first->trx_id, uint64_t(0) ),
+                                      std::make_tuple( first->trx_id, std::numeric_limits<uint64_t>::max() ) );
+   }
+
+   action_history_entry action_history_store::read_action( uint64_t action_ordinal )const {
+      EOS_ASSERT( action_ordinal < num_actions, plugin_exception, "action ${a} is not in the action history",
+                  ("a", action_ordinal) );
+      action_history_entry entry;
+      log.seek( position( action_ordinal ) );
+      auto ds = log.create_datastream();
+      fc::raw::unpack( ds, entry );
+      return entry;
+   }
+
+} /// namespace eosio
@@ -1,7 +1,9 @@
 #include <eosio/history_plugin/history_plugin.hpp>
+#include <eosio/history_plugin/action_history_store.hpp>
 #include <eosio/history_plugin/account_control_history_object.hpp>
 #include <eosio/history_plugin/public_key_history_object.hpp>
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
@@ -10,6 +12,10 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
 namespace eosio {
    using namespace chain;
    using boost::signals2::scoped_connection;
@@ -17,69 +23,6 @@ namespace eosio {
    static appbase::abstract_plugin& _history_plugin = app().register_plugin<history_plugin>();
 
 
-   struct account_history_object : public chainbase::object<account_history_object_type, account_history_object>  {
-      OBJECT_CTOR( account_history_object );
-
-      id_type      id;
-      account_name account; ///< the name of the account which has this action in its history
-      uint64_t     action_sequence_num = 0; ///< the sequence number of the relevant action (global)
-      int32_t      account_sequence_num = 0; ///< the sequence number for this account (per-account)
-   };
-
-   struct action_history_object : public chainbase::object<action_history_object_type, action_history_object> {
-
-      OBJECT_CTOR( action_history_object, (packed_action_trace) );
-
-      id_type      id;
-      uint64_t     action_sequence_num; ///< the sequence number of the relevant action
-
-      shared_string        packed_action_trace;
-      uint32_t             block_num;
-      block_timestamp_type block_time;
-      transaction_id_type  trx_id;
-   };
-   using account_history_id_type = account_history_object::id_type;
-   using action_history_id_type  = action_history_object::id_type;
-
-
-   struct by_action_sequence_num;
-   struct by_account_action_seq;
-   struct by_trx_id;
-
-   using action_history_index = chainbase::shared_multi_index_container<
-      action_history_object,
-      indexed_by<
-         ordered_unique<tag<by_id>, member<action_history_object, action_history_object::id_type, &action_history_object::id>>,
-         ordered_unique<tag<by_action_sequence_num>, member<action_history_object, uint64_t, &action_history_object::action_sequence_num>>,
-         ordered_unique<tag<by_trx_id>,
-            composite_key< action_history_object,
-               member<action_history_object, transaction_id_type, &action_history_object::trx_id>,
-               member<action_history_object, uint64_t, &action_history_object::action_sequence_num >
-            >
-         >
-      >
-   >;
-
-   using account_history_index = chainbase::shared_multi_index_container<
-      account_history_object,
-      indexed_by<
-         ordered_unique<tag<by_id>, member<account_history_object, account_history_object::id_type, &account_history_object::id>>,
-         ordered_unique<tag<by_account_action_seq>,
-            composite_key< account_history_object,
-               member<account_history_object, account_name, &account_history_object::account >,
-               member<account_history_object, int32_t, &account_history_object::account_sequence_num >
-            >
-         >
-      >
-   >;
-
-} /// namespace eosio
-
-CHAINBASE_SET_INDEX_TYPE(eosio::account_history_object, eosio::account_history_index)
-CHAINBASE_SET_INDEX_TYPE(eosio::action_history_object, eosio::action_history_index)
-
-namespace eosio {
-
    template<typename MultiIndex, typename LookupType>
    static void remove(chainbase::database& db, const account_name& account_name, const permission_name& permission)
    {
@@ -135,94 +78,103 @@ namespace eosio {
       }
    };
 
-   class history_plugin_impl {
+   /**
+    * A set of filter_entry arranged for matching actions: one hash lookup by receiver finds every entry that can
+    * match, then the action name and actors are checked against that receiver's entries only.
+    */
+   class compiled_filter {
       public:
-         bool bypass_filter = false;
-         std::set<filter_entry> filter_on;
-         std::set<filter_entry> filter_out;
-         chain_plugin*          chain_plug = nullptr;
-         fc::optional<scoped_connection> applied_transaction_connection;
-
-          bool filter(const action_trace& act) {
-            bool pass_on = false;
-            if (bypass_filter) {
-              pass_on = true;
-            }
-            if (filter_on.find({ act.receiver, {}, {} }) != filter_on.end()) {
-              pass_on = true;
+         struct receiver_entries {
+            bool                         all = false; ///< receiver::
+            flat_set<name>               actions;     ///< receiver:action:
+            flat_set<name>               actors;      ///< receiver::actor
+            flat_set<std::pair<name,name>> action_actors; ///< receiver:action:actor
+
+            bool matches( name action )const {
+               return all || actions.count( action );
             }
-            if (filter_on.find({ act.receiver, act.act.name, {} }) != filter_on.end()) {
-              pass_on = true;
+            bool matches( name action, name actor )const {
+               return matches( action ) || actors.count( actor ) || action_actors.count( std::make_pair( action, actor ) );
             }
-            for (const auto& a : act.act.authorization) {
-              if (filter_on.find({ act.receiver, {}, a.actor }) != filter_on.end()) {
-                pass_on = true;
-              }
-              if (filter_on.find({ act.receiver, act.act.name, a.actor }) != filter_on.end()) {
-                pass_on = true;
-              }
+            bool matches_any_actor( const action_trace& act )const {
+               if( matches( act.act.name ) )
+                  return true;
+               for( const auto& a : act.act.authorization ) {
+                  if( actors.count( a.actor ) || action_actors.count( std::make_pair( act.act.name, a.actor ) ) )
+                     return true;
+               }
+               return false;
             }
+         };
 
-            if (!pass_on) {  return false;  }
+         void add( const filter_entry& e ) {
+            auto& r = entries[e.receiver.to_uint64_t()];
+            if( e.action.empty() && e.actor.empty() )
+               r.all = true;
+            else if( e.actor.empty() )
+               r.actions.insert( e.action );
+            else if( e.action.empty() )
+               r.actors.insert( e.actor );
+            else
+               r.action_actors.insert( std::make_pair( e.action, e.actor ) );
+         }
 
-            if (filter_out.find({ act.receiver, {}, {} }) != filter_out.end()) {
-              return false;
-            }
-            if (filter_out.find({ act.receiver, act.act.name, {} }) != filter_out.end()) {
-              return false;
-            }
-            for (const auto& a : act.act.authorization) {
-              if (filter_out.find({ act.receiver, {}, a.actor }) != filter_out.end()) {
-                return false;
-              }
-              if (filter_out.find({ act.receiver, act.act.name, a.actor }) != filter_out.end()) {
-                return false;
-              }
-            }
+         /// nullptr if no entry has this receiver
+         const receiver_entries* find( name receiver )const {
+            auto it = entries.find( receiver.to_uint64_t() );
+            return it == entries.end() ? nullptr : &it->second;
+         }
 
-            return true;
-          }
+      private:
+         std::unordered_map<uint64_t, receiver_entries> entries;
+   };
 
-         set<account_name> account_set( const action_trace& act ) {
+   class history_plugin_impl {
+      public:
+         bool bypass_filter = false;
+         compiled_filter        filter_on;
+         compiled_filter        filter_out;
+         chain_plugin*          chain_plug = nullptr;
+         fc::optional<action_history_store> store;
+         mutable std::mutex     store_mtx; // store is written on ingest_thread and read by the api
+
+         // actions are filtered, packed and stored on ingest_thread, at most max_pending_blocks blocks behind
+         static constexpr uint32_t       max_pending_blocks = 16;
+         fc::optional<named_thread_pool> ingest_thread;
+         std::mutex                      pending_mtx;
+         std::condition_variable         pending_cv;
+         uint32_t                        pending_blocks = 0;
+         fc::optional<scoped_connection> applied_transaction_connection;
+         fc::optional<scoped_connection> accepted_block_connection;
+         fc::optional<scoped_connection> irreversible_block_connection;
+
+         // traces of the transactions of the pending block; their actions are stored once the block is accepted
+         std::map<transaction_id_type, transaction_trace_ptr> cached_traces;
+         transaction_trace_ptr                                onblock_trace;
+
+         bool filter( const action_trace& act )const {
+            const auto* on = filter_on.find( act.receiver );
+            if( !bypass_filter && !(on && on->matches_any_actor( act )) )
+               return false;
+            const auto* out = filter_out.find( act.receiver );
+            return !(out && out->matches_any_actor( act ));
+         }
+
+         set<account_name> account_set( const action_trace& act )const {
             set<account_name> result;
 
             result.insert( act.receiver );
+            const auto* on = filter_on.find( act.receiver );
+            const auto* out = filter_out.find( act.receiver );
             for( const auto& a : act.act.authorization ) {
-               if( bypass_filter ||
-                   filter_on.find({ act.receiver, {}, {}}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, {}, a.actor}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, act.act.name, {}}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, act.act.name, a.actor }) != filter_on.end() ) {
-                 if ((filter_out.find({ act.receiver, {}, {} }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, {}, a.actor }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, act.act.name, {} }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, act.act.name, a.actor }) == filter_out.end())) {
-                   result.insert( a.actor );
-                 }
+               if( (bypass_filter || (on && on->matches( act.act.name, a.actor ))) &&
+                   !(out && out->matches( act.act.name, a.actor )) ) {
+                  result.insert( a.actor );
                }
             }
             return result;
          }
 
-         void record_account_action( account_name n, const action_trace& act ) {
-            auto& chain = chain_plug->chain();
-            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-
-            const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
-            auto itr = idx.lower_bound( boost::make_tuple( name(n.to_uint64_t()+1), 0 ) );
-
-            uint64_t asn = 0;
-            if( itr != idx.begin() ) --itr;
-            if( itr->account == n )
-               asn = itr->account_sequence_num + 1;
-
-            const auto& a = db.create<account_history_object>( [&]( auto& aho ) {
-              aho.account = n;
-              aho.action_sequence_num = act.receipt->global_sequence;
-              aho.account_sequence_num = asn;
-            });
-         }
-
          void on_system_action( const action_trace& at ) {
             auto& chain = chain_plug->chain();
             chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
@@ -250,40 +202,108 @@ namespace eosio {
             }
          }
 
-         void on_action_trace( const action_trace& at ) {
-            if( filter( at ) ) {
-               //idump((fc::json::to_pretty_string(at)));
-               auto& chain = chain_plug->chain();
-               chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-
-               db.create<action_history_object>( [&]( auto& aho ) {
-                  auto ps = fc::raw::pack_size( at );
-                  aho.packed_action_trace.resize(ps);
-                  datastream<char*> ds( aho.packed_action_trace.data(), ps );
-                  fc::raw::pack( ds, at );
-                  aho.action_sequence_num = at.receipt->global_sequence;
-                  aho.block_num = chain.head_block_num() + 1;
-                  aho.block_time = chain.pending_block_time();
-                  aho.trx_id     = at.trx_id;
-               });
-
-               auto aset = account_set( at );
-               for( auto a : aset ) {
-                  record_account_action( a, at );
+         // runs on ingest_thread
+         void store_block_traces( const block_state_ptr& bsp, const vector<transaction_trace_ptr>& traces ) {
+            vector<action_history_entry> entries;
+            for( const auto& trace : traces ) {
+               for( const auto& at : trace->action_traces ) {
+                  if( !at.receipt || !filter( at ) ) continue;
+                  //idump((fc::json::to_pretty_string(at)));
+                  auto aset = account_set( at );
+                  action_history_entry entry;
+                  entry.global_sequence     = at.receipt->global_sequence;
+                  entry.block_num           = bsp->block_num;
+                  entry.block_time          = bsp->header.timestamp;
+                  entry.trx_id              = at.trx_id;
+                  entry.accounts            = vector<account_name>( aset.begin(), aset.end() );
+                  entry.packed_action_trace = fc::raw::pack( at );
+                  entries.push_back( std::move(entry) );
                }
             }
-            if( at.receiver == chain::config::system_account_name )
-               on_system_action( at );
+
+            std::lock_guard<std::mutex> g( store_mtx );
+            // replaces the actions of a block that was forked out
+            store->truncate_from( bsp->block_num );
+            store->append( entries );
+         }
+
+         void wait_for_pending_blocks( uint32_t max_pending ) {
+            std::unique_lock<std::mutex> g( pending_mtx );
+            pending_cv.wait( g, [&]{ return pending_blocks <= max_pending; } );
+         }
+
+         template<typename F>
+         void post_to_ingest_thread( F f ) {
+            // back-pressure, block application waits for ingestion to catch up
+            wait_for_pending_blocks( max_pending_blocks - 1 );
+            {
+               std::lock_guard<std::mutex> g( pending_mtx );
+               ++pending_blocks;
+            }
+            boost::asio::post( ingest_thread->get_executor(), [this, f = std::move(f)]() {
+               try {
+                  f();
+               } FC_LOG_AND_DROP()
+               {
+                  std::lock_guard<std::mutex> g( pending_mtx );
+                  --pending_blocks;
+               }
+               pending_cv.notify_all();
+            } );
+         }
+
+         static bool is_onblock( const transaction_trace_ptr& p ) {
+            if( p->action_traces.size() != 1 )
+               return false;
+            const auto& act = p->action_traces[0].act;
+            return act.account == chain::config::system_account_name && act.name == N(onblock) &&
+                   act.authorization.size() == 1 &&
+                   act.authorization[0].actor == chain::config::system_account_name &&
+                   act.authorization[0].permission == chain::config::active_name;
          }
 
          void on_applied_transaction( const transaction_trace_ptr& trace ) {
             if( !trace->receipt || (trace->receipt->status != transaction_receipt_header::executed &&
                   trace->receipt->status != transaction_receipt_header::soft_fail) )
                return;
+            // key and account links are state of the chain, undone with it when the block is dropped
             for( const auto& atrace : trace->action_traces ) {
-               if( !atrace.receipt ) continue;
-               on_action_trace( atrace );
+               if( atrace.receipt && atrace.receiver == chain::config::system_account_name )
+                  on_system_action( atrace );
+            }
+            if( is_onblock( trace ) )
+               onblock_trace = trace;
+            else if( trace->failed_dtrx_trace )
+               cached_traces[trace->failed_dtrx_trace->id] = trace;
+            else
+               cached_traces[trace->id] = trace;
+         }
+
+         void on_accepted_block( const block_state_ptr& bsp ) {
+            vector<transaction_trace_ptr> traces;
+            if( onblock_trace )
+               traces.push_back( onblock_trace );
+            for( const auto& r : bsp->block->transactions ) {
+               transaction_id_type id;
+               if( r.trx.contains<transaction_id_type>() )
+                  id = r.trx.get<transaction_id_type>();
+               else
+                  id = r.trx.get<packed_transaction>().id();
+               auto it = cached_traces.find( id );
+               if( it != cached_traces.end() )
+                  traces.push_back( it->second );
             }
+            cached_traces.clear();
+            onblock_trace.reset();
+
+            post_to_ingest_thread( [this, bsp, traces = std::move(traces)]() { store_block_traces( bsp, traces ); } );
+         }
+
+         void on_irreversible_block( const block_state_ptr& bsp ) {
+            post_to_ingest_thread( [this, block_num = bsp->block_num]() {
+               std::lock_guard<std::mutex> g( store_mtx );
+               store->set_irreversible( block_num );
+            } );
          }
    };
 
@@ -305,6 +325,10 @@ namespace eosio {
             ("filter-out,F", bpo::value<vector<string>>()->composing(),
              "Do not track actions which match receiver:action:actor. Action and Actor both blank excludes all from Reciever. Actor blank excludes all from reciever:action. Receiver may not be blank.")
             ;
+      cfg.add_options()
+            ("history-dir", bpo::value<bfs::path>()->default_value("history"),
+             "the location of the action history directory (absolute path or relative to application data dir)")
+            ;
    }
 
    void history_plugin::plugin_initialize(const variables_map& options) {
@@ -314,7 +338,7 @@ namespace eosio {
             for( auto& s : fo ) {
                if( s == "*" || s == "\"*\"" ) {
                   my->bypass_filter = true;
-                  wlog( "--filter-on * enabled. This can fill shared_mem, causing nodeos to stop." );
+                  wlog( "--filter-on * enabled. This can fill the disk of history-dir." );
                   break;
                }
                std::vector<std::string> v;
@@ -323,7 +347,7 @@ namespace eosio {
                filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
                EOS_ASSERT( fe.receiver.to_uint64_t(), fc::invalid_arg_exception,
                            "Invalid value ${s} for --filter-on", ("s", s));
-               my->filter_on.insert( fe );
+               my->filter_on.add( fe );
             }
          }
          if( options.count( "filter-out" )) {
@@ -335,7 +359,7 @@ namespace eosio {
                filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
                EOS_ASSERT( fe.receiver.to_uint64_t(), fc::invalid_arg_exception,
                            "Invalid value ${s} for --filter-out", ("s", s));
-               my->filter_out.insert( fe );
+               my->filter_out.add( fe );
             }
          }
 
@@ -345,23 +369,44 @@ namespace eosio {
 
          chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
          // TODO: Use separate chainbase database for managing the state of the history_plugin (or remove deprecated history_plugin entirely)
-         db.add_index<account_history_index>();
-         db.add_index<action_history_index>();
          db.add_index<account_control_history_multi_index>();
          db.add_index<public_key_history_multi_index>();
 
+         // actions are kept out of the chain state, in an append only store
+         auto dir = options.at( "history-dir" ).as<bfs::path>();
+         if( dir.is_relative() )
+            dir = app().data_dir() / dir;
+         bfs::create_directories( dir );
+         my->store.emplace( dir );
+         my->ingest_thread.emplace( "hist", 1 );
+
          my->applied_transaction_connection.emplace(
                chain.applied_transaction.connect( [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
                   my->on_applied_transaction( std::get<0>(t) );
                } ));
+         my->accepted_block_connection.emplace(
+               chain.accepted_block.connect( [&]( const block_state_ptr& bsp ) {
+                  my->on_accepted_block( bsp );
+               } ));
+         my->irreversible_block_connection.emplace(
+               chain.irreversible_block.connect( [&]( const block_state_ptr& bsp ) {
+                  my->on_irreversible_block( bsp );
+               } ));
       } FC_LOG_AND_RETHROW()
    }
 
    void history_plugin::plugin_startup() {
+      // the chain state may be older than the store, e.g. after a replay
+      const auto& chain = my->chain_plug->chain();
+      my->store->truncate_from( chain.head_block_num() + 1 );
    }
 
    void history_plugin::plugin_shutdown() {
       my->applied_transaction_connection.reset();
+      my->accepted_block_connection.reset();
+      my->irreversible_block_connection.reset();
+      my->wait_for_pending_blocks( 0 );
+      my->ingest_thread.reset();
    }
 
 
@@ -371,11 +416,10 @@ namespace eosio {
       read_only::get_actions_result read_only::get_actions( const read_only::get_actions_params& params )const {
          edump((params));
         auto& chain = history->chain_plug->chain();
-        const auto& db = chain.db();
+        std::lock_guard<std::mutex> g( history->store_mtx );
+        const auto& store = *history->store;
         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
 
-        const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
-
         int32_t start = 0;
         int32_t pos = params.pos ? *params.pos : -1;
         int32_t end = 0;
@@ -383,14 +427,9 @@ namespace eosio {
         auto n = params.account_name;
         idump((pos));
         if( pos == -1 ) {
-            auto itr = idx.lower_bound( boost::make_tuple( name(n.to_uint64_t()+1), 0 ) );
-            if( itr == idx.begin() ) {
-               if( itr->account == n )
-                  pos = itr->account_sequence_num+1;
-            } else if( itr != idx.begin() ) --itr;
-
-            if( itr->account == n )
-               pos = itr->account_sequence_num + 1;
+            auto last = store.last_account_sequence( n );
+            if( last >= 0 )
+               pos = last + 1;
         }
 
         if( pos== -1 ) pos = 0xfffffff;
@@ -407,22 +446,21 @@ namespace eosio {
 
         idump((start)(end));
 
-        auto start_itr = idx.lower_bound( boost::make_tuple( n, start ) );
-        auto end_itr = idx.upper_bound( boost::make_tuple( n, end) );
+        auto records = store.get_account_actions( n, start, end );
 
         auto start_time = fc::time_point::now();
         auto end_time = start_time;
 
         get_actions_result result;
         result.last_irreversible_block = chain.last_irreversible_block_num();
-        while( start_itr != end_itr ) {
-           const auto& a = db.get<action_history_object, by_action_sequence_num>( start_itr->action_sequence_num );
+        for( const auto& r : records ) {
+           const auto a = store.read_action( r.action_ordinal );
            fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
            action_trace t;
            fc::raw::unpack( ds, t );
            result.actions.emplace_back( ordered_action_result{
-                                 start_itr->action_sequence_num,
-                                 start_itr->account_sequence_num,
+                                 a.global_sequence,
+                                 r.account_sequence_num,
                                  a.block_num, a.block_time,
                                  chain.to_variant_with_abi(t, abi_serializer_max_time)
                                  });
@@ -432,7 +470,6 @@ namespace eosio {
               result.time_limit_exceeded_error = true;
               break;
            }
-           ++start_itr;
         }
         return result;
       }
@@ -461,32 +498,38 @@ namespace eosio {
             return (*(input_id.data() + input_id_size) & 0xF0) == (*(id.data() + input_id_size) & 0xF0);
          };
 
-         const auto& db = chain.db();
-         const auto& idx = db.get_index<action_history_index, by_trx_id>();
-         auto itr = idx.lower_bound( boost::make_tuple( input_id ) );
+         std::lock_guard<std::mutex> g( history->store_mtx );
+         const auto& store = *history->store;
+         const auto records = store.get_transaction_actions( input_id );
+
+         bool in_history = (!records.empty() && txn_id_matched(records.front().trx_id) );
 
-         bool in_history = (itr != idx.end() && txn_id_matched(itr->trx_id) );
+         auto block_num_hint = p.block_num_hint;
+         if( !in_history && !block_num_hint && input_id_length == 64 ) {
+            // the block of a whole id can be looked up in the reversible blocks and in trx.index
+            if( auto block_num = chain.get_transaction_block( input_id ) )
+               block_num_hint = *block_num;
+         }
 
-         if( !in_history && !p.block_num_hint ) {
+         if( !in_history && !block_num_hint ) {
             EOS_THROW(tx_not_found, "Transaction ${id} not found in history and no block hint was given", ("id",p.id));
          }
 
          get_transaction_result result;
 
          if( in_history ) {
-            result.id         = itr->trx_id;
+            result.id         = records.front().trx_id;
             result.last_irreversible_block = chain.last_irreversible_block_num();
-            result.block_num  = itr->block_num;
-            result.block_time = itr->block_time;
 
-            while( itr != idx.end() && itr->trx_id == result.id ) {
+            for( const auto& r : records ) {
+              const auto a = store.read_action( r.action_ordinal );
+              result.block_num  = a.block_num;
+              result.block_time = a.block_time;
 
-              fc::datastream<const char*> ds( itr->packed_action_trace.data(), itr->packed_action_trace.size() );
+              fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
               action_trace t;
               fc::raw::unpack( ds, t );
               result.traces.emplace_back( chain.to_variant_with_abi(t, abi_serializer_max_time) );
-
-              ++itr;
             }
 
             auto blk = chain.fetch_block_by_number( result.block_num );
@@ -512,7 +555,7 @@ namespace eosio {
                }
             }
          } else {
-            auto blk = chain.fetch_block_by_number(*p.block_num_hint);
+            auto blk = chain.fetch_block_by_number(*block_num_hint);
             bool found = false;
             if (blk) {
                for (const auto& receipt: blk->transactions) {
@@ -522,7 +565,7 @@ namespace eosio {
                      if( txn_id_matched(id) ) {
                         result.id = id;
                         result.last_irreversible_block = chain.last_irreversible_block_num();
-                        result.block_num = *p.block_num_hint;
+                        result.block_num = *block_num_hint;
                         result.block_time = blk->timestamp;
                         fc::mutable_variant_object r("receipt", receipt);
                         r("trx", chain.to_variant_with_abi(pt.get_signed_transaction(), abi_serializer_max_time));
@@ -535,7 +578,7 @@ namespace eosio {
                      if( txn_id_matched(id) ) {
                         result.id = id;
                         result.last_irreversible_block = chain.last_irreversible_block_num();
-                        result.block_num = *p.block_num_hint;
+                        result.block_num = *block_num_hint;
                         result.block_time = blk->timestamp;
                         fc::mutable_variant_object r("receipt", receipt);
                         result.trx = move(r);
@@ -547,7 +590,7 @@ namespace eosio {
             }
 
             if (!found) {
-               EOS_THROW(tx_not_found, "Transaction ${id} not found in history or in block number ${n}", ("id",p.id)("n", *p.block_num_hint));
+               EOS_THROW(tx_not_found, "Transaction ${id} not found in history or in block number ${n}", ("id",p.id)("n", *block_num_hint));
             }
          }
 
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <eosio/chain/block_timestamp.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/types.hpp>
+#include <fc/io/cfile.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/optional.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <map>
+#include <memory>
+#include <set>
+
+namespace eosio {
+
+   /// the position of an action in the history of an account
+   struct account_history_record {
+      chain::account_name account;
+      int32_t             account_sequence_num = 0;
+      uint32_t            block_num = 0;
+      uint64_t            action_ordinal = 0; ///< position of the action in the action log
+
+      std::tuple<chain::account_name, int32_t> key()const { return std::make_tuple( account, account_sequence_num ); }
+   };
+
+   /// an action of a transaction
+   struct transaction_history_record {
+      chain::transaction_id_type trx_id;
+      uint64_t                   action_ordinal = 0;
+      uint32_t                   block_num = 0;
+
+      std::tuple<chain::transaction_id_type, uint64_t> key()const { return std::make_tuple( trx_id, action_ordinal ); }
+   };
+
+   /// an entry of the action log
+   struct action_history_entry {
+      uint64_t                         global_sequence = 0;
+      uint32_t                         block_num = 0;
+      chain::block_timestamp_type      block_time;
+      chain::transaction_id_type       trx_id;
+      std::vector<chain::account_name> accounts; ///< the accounts that have the action in their history
+      chain::bytes                     packed_action_trace;
+   };
+
+} /// namespace eosio
+
+FC_REFLECT( eosio::account_history_record, (account)(account_sequence_num)(block_num)(action_ordinal) )
+FC_REFLECT( eosio::transaction_history_record, (trx_id)(action_ordinal)(block_num) )
+FC_REFLECT( eosio::action_history_entry, (global_sequence)(block_num)(block_time)(trx_id)(accounts)(packed_action_trace) )
+
+namespace eosio {
+
+   /**
+    * An on disk index of fixed size records ordered by Record::key().
+    *
+    * Records are kept in memory until their block is irreversible. Once there are enough of them they are written
+    * to an immutable segment file of sorted records, named after the range of blocks it covers. A new segment is
+    * merged with the one before it as long as that one is not more than twice as large, which keeps the number of
+    * segments to search logarithmic in the number of records.
+    */
+   template<typename Record>
+   class sorted_segment_index {
+      public:
+         using key_type = decltype( std::declval<Record>().key() );
+
+         static constexpr uint64_t min_segment_records = 64 * 1024;
+
+         sorted_segment_index( fc::path dir, std::string name );
+
+         /// the records of blocks up to and including this one are in segments
+         uint32_t flushed_block_num()const { return segments.empty() ? 0 : segments.back()->last_block; }
+
+         void add( const Record& r );
+         /// drops the records of block_num and later blocks, which have to be in memory
+         void truncate_from( uint32_t block_num );
+         /// writes the records of irreversible blocks to a new segment once there are min_segment_records of them
+         void flush( uint32_t irreversible_block_num );
+         void clear();
+
+         /// the first record with a key that is not less than key
+         fc::optional<Record> lower_bound( const key_type& key )const;
+         /// the last record with a key less than key
+         fc::optional<Record> last_before( const key_type& key )const;
+         /// the records with keys in [lo, hi) in key order
+         std::vector<Record>  range( const key_type& lo, const key_type& hi )const;
+
+      private:
+         struct key_less {
+            using is_transparent = void;
+            bool operator()( const Record& a, const Record& b )const { return a.key() < b.key(); }
+            bool operator()( const Record& a, const key_type& k )const { return a.key() < k; }
+            bool operator()( const key_type& k, const Record& b )const { return k < b.key(); }
+         };
+
+         struct segment {
+            fc::path          path;
+            uint32_t          first_block = 0;
+            uint32_t          last_block = 0;
+            uint64_t          count = 0;
+            mutable fc::cfile file;
+
+            Record   read( uint64_t i )const;
+            uint64_t lower_bound( const key_type& key )const;
+         };
+
+         std::unique_ptr<segment> open_segment( const fc::path& path, uint32_t first_block, uint32_t last_block )const;
+         fc::path                 segment_path( uint32_t first_block, uint32_t last_block )const;
+
+         /// writes the records produced by next() until it returns false to a new segment
+         template<typename F>
+         std::unique_ptr<segment> write_segment( uint32_t first_block, uint32_t last_block, F next )const;
+         void                     merge_last_two();
+
+         static uint64_t record_size() { static const uint64_t size = fc::raw::pack_size( Record() ); return size; }
+
+         fc::path                               dir;
+         std::string                            name;
+         std::vector<std::unique_ptr<segment>>  segments;      ///< in block order
+         std::set<Record, key_less>             memtable;
+         std::map<uint32_t, uint64_t>           block_counts;  ///< number of records in memtable by block
+   };
+
+   /**
+    * The actions recorded by history_plugin: an append only log of action_history_entry, an index of the log
+    * positions by action ordinal, and sorted_segment_index of the actions of each account and of each transaction.
+    *
+    * The log is the source of truth: the records that were in memory when nodeos stopped are indexed again from
+    * it when the store is opened. Actions of reversible blocks are dropped from the end of the log when their
+    * block is forked out.
+    */
+   class action_history_store {
+      public:
+         explicit action_history_store( const fc::path& dir );
+         action_history_store( const action_history_store& ) = delete;
+         action_history_store& operator=( const action_history_store& ) = delete;
+
+         /// drops the actions of block_num and later blocks
+         void     truncate_from( uint32_t block_num );
+         /// the entries are written with one flush
+         void     append( const std::vector<action_history_entry>& entries );
+         void     set_irreversible( uint32_t block_num );
+         void     clear();
+
+         /// the last block with recorded actions, 0 if there are none
+         uint32_t last_block_num()const;
+
+         /// -1 if account has no history
+         int32_t  last_account_sequence( chain::account_name account )const;
+         /// the actions of account with sequence numbers in [start, end]
+         std::vector<account_history_record>     get_account_actions( chain::account_name account, int32_t start, int32_t end )const;
+         /// the actions of the transaction with the smallest id that is not less than id
+         std::vector<transaction_history_record> get_transaction_actions( const chain::transaction_id_type& id )const;
+         action_history_entry                    read_action( uint64_t action_ordinal )const;
+
+      private:
+         void     reopen();
+         void     truncate_files( uint64_t num );
+         uint64_t position( uint64_t action_ordinal )const;
+         uint32_t block_num_of( uint64_t action_ordinal )const;
+         uint64_t first_action_of( uint32_t block_num )const;
+         void     index_action( uint64_t action_ordinal, const action_history_entry& entry );
+
+         fc::path                                         log_path;
+         fc::path                                         index_path;
+         mutable fc::cfile                                log;
+         mutable fc::cfile                                index;
+         uint64_t                                         num_actions = 0;
+         uint64_t                                         log_end = 0;
+         sorted_segment_index<account_history_record>     account_index;
+         sorted_segment_index<transaction_history_record> transaction_index;
+   };
+
+   template<typename Record>
+   sorted_segment_index<Record>::sorted_segment_index( fc::path d, std::string n )
+   :dir( std::move(d) ), name( std::move(n) )
+   {
+      std::vector<std::unique_ptr<segment>> found;
+      for( boost::filesystem::directory_iterator it( dir ), end; it != end; ++it ) {
+         const auto filename = it->path().filename().string();
+         if( filename.compare( 0, name.size() + 1, name + "-" ) != 0 )
+            continue;
+         if( it->path().extension() == ".tmp" ) {
+            boost::filesystem::remove( it->path() ); // left behind by a write that did not finish
+            continue;
+         }
+         uint32_t first_block = 0, last_block = 0;
+         if( it->path().extension() != ".seg" ||
+             sscanf( filename.c_str() + name.size(), "-%u-%u.seg", &first_block, &last_block ) != 2 )
+            continue;
+         found.push_back( open_segment( it->path(), first_block, last_block ) );
+      }
+      std::sort( found.begin(), found.end(), []( const auto& a, const auto& b ) {
+         return std::make_tuple( a->first_block, b->last_block ) < std::make_tuple( b->first_block, a->last_block );
+      } );
+      for( auto& s : found ) {
+         // the inputs of a merge that did not get to remove them are covered by the merged segment
+         if( !segments.empty() && s->last_block <= segments.back()->last_block ) {
+            s->file.close();
+            boost::filesystem::remove( s->path );
+            continue;
+         }
+         segments.push_back( std::move(s) );
+      }
+   }
+
+   template<typename Record>
+   fc::path sorted_segment_index<Record>::segment_path( uint32_t first_block, uint32_t last_block )const {
+      return dir / (name + "-" + std::to_string( first_block ) + "-" + std::to_string( last_block ) + ".seg");
+   }
+
+   template<typename Record>
+   std::unique_ptr<typename sorted_segment_index<Record>::segment>
+   sorted_segment_index<Record>::open_segment( const fc::path& path, uint32_t first_block, uint32_t last_block )const {
+      auto s = std::make_unique<segment>();
+      s->path = path;
+      s->first_block = first_block;
+      s->last_block = last_block;
+      s->file.set_file_path( path );
+      s->file.open( "rb" );
+      s->count = boost::filesystem::file_size( path ) / record_size();
+      return s;
+   }
+
+   template<typename Record>
+   Record sorted_segment_index<Record>::segment::read( uint64_t i )const {
+      Record r;
+      file.seek( i * record_size() );
+      auto ds = file.create_datastream();
+      fc::raw::unpack( ds, r );
+      return r;
+   }
+
+   template<typename Record>
+   uint64_t sorted_segment_index<Record>::segment::lower_bound( const key_type& key )const {
+      uint64_t lo = 0, hi = count;
+      while( lo < hi ) {
+         const uint64_t mid = lo + (hi - lo) / 2;
+         if( read( mid ).key() < key )
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   template<typename Record>
+   void sorted_segment_index<Record>::add( const Record& r ) {
+      EOS_ASSERT( r.block_num > flushed_block_num(), chain::plugin_exception,
+                  "record of block ${b} is older than the ${n} index", ("b", r.block_num)("n", name) );
+      if( memtable.insert( r ).second )
+         ++block_counts[r.block_num];
+   }
+
+   template<typename Record>
+   void sorted_segment_index<Record>::truncate_from( uint32_t block_num ) {
+      EOS_ASSERT( block_num > flushed_block_num(), chain::plugin_exception,
+                  "block ${b} of the ${n} index is already written to a segment", ("b", block_num)("n", name) );
+      if( block_counts.lower_bound( block_num ) == block_counts.end() )
+         return;
+      for( auto it = memtable.begin(); it != memtable.end(); ) {
+         if( it->block_num >= block_num )
+            it = memtable.erase( it );
+         else
+            ++it;
+      }
+      block_counts.erase( block_counts.lower_bound( block_num ), block_counts.end() );
+   }
+
+   template<typename Record>
+   template<typename F>
+   std::unique_ptr<typename sorted_segment_index<Record>::segment>
+   sorted_segment_index<Record>::write_segment( uint32_t first_block, uint32_t last_block, F next )const {
+      const auto path = segment_path( first_block, last_block );
+      const fc::path tmp_path = path.generic_string() + ".tmp";
+      {
+         fc::cfile out;
+         out.set_file_path( tmp_path );
+         out.open( "wb" );
+         std::vector<char> buffer( record_size() );
+         Record r;
+         while( next( r ) ) {
+            fc::datastream<char*> ds( buffer.data(), buffer.size() );
+            fc::raw::pack( ds, r );
+            out.write( buffer.data(), buffer.size() );
+         }
+         out.flush();
+         out.close();
+      }
+      fc::rename( tmp_path, path );
+      return open_segment( path, first_block, last_block );
+   }
+
+   template<typename Record>
+   void sorted_segment_index<Record>::flush( uint32_t irreversible_block_num ) {
+      uint64_t num_irreversible = 0;
+      for( auto it = block_counts.begin(); it != block_counts.end() && it->first <= irreversible_block_num; ++it )
+         num_irreversible += it->second;
+      if( num_irreversible < min_segment_records )
+         return;
+
+      auto it = memtable.begin();
+      auto s = write_segment( flushed_block_num() + 1, irreversible_block_num, [&]( Record& r ) {
+         while( it != memtable.end() && it->block_num > irreversible_block_num )
+            ++it;
+         if( it == memtable.end() )
+            return false;
+         r = *it;
+         it = memtable.erase( it );
+         return true;
+      } );
+      block_counts.erase( block_counts.begin(), block_counts.upper_bound( irreversible_block_num ) );
+      segments.push_back( std::move(s) );
+
+      while( segments.size() >= 2 && segments[segments.size() - 2]->count <= 2 * segments.back()->count )
+         merge_last_two();
+   }
+
+   template<typename Record>
+   void sorted_segment_index<Record>::merge_last_two() {
+      auto second = std::move( segments.back() );
+      segments.pop_back();
+      auto first = std::move( segments.back() );
+      segments.pop_back();
+
+      uint64_t i = 0, j = 0;
+      auto merged = write_segment( first->first_block, second->last_block, [&]( Record& r ) {
+         if( i == first->count && j == second->count )
+            return false;
+         if( j == second->count ) {
+            r = first->read( i++ );
+         } else if( i == first->count ) {
+            r = second->read( j++ );
+         } else {
+            auto a = first->read( i );
+            auto b = second->read( j );
+            if( a.key() < b.key() ) {
+               r = a; ++i;
+            } else {
+               r = b; ++j;
+            }
+         }
+         return true;
+      } );
+
+      for( auto* s : { first.get(), second.get() } ) {
+         s->file.close();
+         boost::filesystem::remove( s->path );
+      }
+      segments.push_back( std::move(merged) );
+   }
+
+   template<typename Record>
+   void sorted_segment_index<Record>::clear() {
+      for( auto& s : segments ) {
+         s->file.close();
+         boost::filesystem::remove( s->path );
+      }
+      segments.clear();
+      memtable.clear();
+      block_counts.clear();
+   }
+
+   template<typename Record>
+   fc::optional<Record> sorted_segment_index<Record>::lower_bound( const key_type& key )const {
+      fc::optional<Record> result;
+      auto consider = [&]( const Record& r ) {
+         if( !result || r.key() < result->key() )
+            result = r;
+      };
+      for( const auto& s : segments ) {
+         auto i = s->lower_bound( key );
+         if( i < s->count )
+            consider( s->read( i ) );
+      }
+      auto it = memtable.lower_bound( key );
+      if( it != memtable.end() )
+         consider( *it );
+      return result;
+   }
+
+   template<typename Record>
+   fc::optional<Record> sorted_segment_index<Record>::last_before( const key_type& key )const {
+      fc::optional<Record> result;
+      auto consider = [&]( const Record& r ) {
+         if( !result || result->key() < r.key() )
+            result = r;
+      };
+      for( const auto& s : segments ) {
+         auto i = s->lower_bound( key );
+         if( i > 0 )
+            consider( s->read( i - 1 ) );
+      }
+      auto it = memtable.lower_bound( key );
+      if( it != memtable.begin() )
+         consider( *std::prev( it ) );
+      return result;
+   }
+
+   template<typename Record>
+   std::vector<Record> sorted_segment_index<Record>::range( const key_type& lo, const key_type& hi )const {
+      std::vector<Record> result;
+      for( const auto& s : segments ) {
+         for( auto i = s->lower_bound( lo ); i < s->count; ++i ) {
+            auto r = s->read( i );
+            if( !(r.key() < hi) )
+               break;
+            result.push_back( std::move(r) );
+         }
+      }
+      result.insert( result.end(), memtable.lower_bound( lo ), memtable.lower_bound( hi ) );
+      std::sort( result.begin(), result.end(), key_less() );
+      return result;
+   }
+
+} /// namespace eosio
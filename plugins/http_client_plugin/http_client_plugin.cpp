@@ -1,11 +1,28 @@
 #include <eosio/http_client_plugin/http_client_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <fc/scoped_exit.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/asio/strand.hpp>
 #include <fstream>
 
 namespace eosio {
 
-http_client_plugin::http_client_plugin():my(new http_client()){}
+struct http_client_plugin_impl {
+   /// an http_client is not thread safe, each lane runs the requests of its own one at a time on a strand
+   struct lane {
+      explicit lane(boost::asio::io_context& ioc) : strand(ioc) {}
+
+      http_client                      client;
+      boost::asio::io_context::strand  strand;
+      std::atomic<uint32_t>            in_flight{0};
+   };
+
+   std::vector<std::unique_ptr<lane>>      lanes;
+   fc::optional<chain::named_thread_pool>  thread_pool; ///< after lanes, joined before they go
+};
+
+http_client_plugin::http_client_plugin():my(new http_client()),impl(new http_client_plugin_impl()){}
 http_client_plugin::~http_client_plugin(){}
 
 void http_client_plugin::set_program_options(options_description&, options_description& cfg) {
@@ -14,12 +31,20 @@ void http_client_plugin::set_program_options(options_description&, options_descr
        "PEM encoded trusted root certificate (or path to file containing one) used to validate any TLS connections made.  (may specify multiple times)\n")
       ("https-client-validate-peers", boost::program_options::value<bool>()->default_value(true),
        "true: validate that the peer certificates are valid and trusted, false: ignore cert errors")
+      ("http-client-threads", boost::program_options::value<uint16_t>()->default_value(2),
+       "Number of threads of asynchronous requests such as those of KEOSD signature providers, each keeps its own persistent connections")
       ;
 
 }
 
 void http_client_plugin::plugin_initialize(const variables_map& options) {
    try {
+      const auto threads = options.at( "http-client-threads" ).as<uint16_t>();
+      EOS_ASSERT( threads > 0, chain::plugin_config_exception, "http-client-threads ${num} must be greater than 0", ("num", threads) );
+      impl->thread_pool.emplace( "httpc", threads );
+      for( uint16_t i = 0; i < threads; ++i )
+         impl->lanes.emplace_back( std::make_unique<http_client_plugin_impl::lane>( impl->thread_pool->get_executor() ) );
+
       if( options.count( "https-client-root-cert" )) {
          const std::vector<std::string> root_pems = options["https-client-root-cert"].as<std::vector<std::string>>();
          for( const auto& root_pem : root_pems ) {
@@ -40,6 +65,8 @@ void http_client_plugin::plugin_initialize(const variables_map& options) {
 
             try {
                my->add_cert( pem_str );
+               for( auto& l : impl->lanes )
+                  l->client.add_cert( pem_str );
             } catch ( const fc::exception& e ) {
                elog( "Failed to read PEM : ${e} \n${pem}\n", ("pem", pem_str)( "e", e.to_detail_string()));
             }
@@ -47,6 +74,8 @@ void http_client_plugin::plugin_initialize(const variables_map& options) {
       }
 
       my->set_verify_peers( options.at( "https-client-validate-peers" ).as<bool>());
+      for( auto& l : impl->lanes )
+         l->client.set_verify_peers( options.at( "https-client-validate-peers" ).as<bool>());
    } FC_LOG_AND_RETHROW()
 }
 
@@ -55,7 +84,24 @@ void http_client_plugin::plugin_startup() {
 }
 
 void http_client_plugin::plugin_shutdown() {
+   if( impl->thread_pool )
+      impl->thread_pool->stop();
+}
+
+std::future<fc::variant> http_client_plugin::post_async(const fc::url& dest, const fc::variant& payload, const fc::time_point& deadline) {
+   auto least_busy = std::min_element( impl->lanes.begin(), impl->lanes.end(), []( const auto& a, const auto& b ) {
+      return a->in_flight < b->in_flight;
+   } );
+   EOS_ASSERT( least_busy != impl->lanes.end(), chain::plugin_exception, "http_client_plugin is not initialized" );
+   http_client_plugin_impl::lane& l = **least_busy;
 
+   auto task = std::make_shared<std::packaged_task<fc::variant()>>( [&l, dest, payload, deadline]() {
+      auto done = fc::make_scoped_exit( [&l]() { --l.in_flight; } );
+      return l.client.post_sync( dest, payload, deadline );
+   } );
+   ++l.in_flight;
+   boost::asio::post( l.strand, [task]() { (*task)(); } );
+   return task->get_future();
 }
 
 }
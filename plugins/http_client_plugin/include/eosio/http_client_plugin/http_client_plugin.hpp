@@ -2,6 +2,8 @@
 #include <appbase/application.hpp>
 #include <fc/network/http/http_client.hpp>
 
+#include <future>
+
 namespace eosio {
    using namespace appbase;
    using fc::http_client;
@@ -23,8 +25,17 @@ namespace eosio {
            return *my;
         }
 
+        /**
+         * Posts payload to dest on one of the http-client-threads, the one with the fewest requests in flight. Every
+         * thread has an http_client of its own which keeps its connections alive between requests, so requests to an
+         * endpoint posted after the first one do not set up a connection. Thread safe, valid after plugin_initialize.
+         */
+        std::future<fc::variant> post_async(const fc::url& dest, const fc::variant& payload,
+                                            const fc::time_point& deadline = fc::time_point::maximum());
+
       private:
         std::unique_ptr<http_client> my;
+        std::unique_ptr<struct http_client_plugin_impl> impl;
    };
 
 }
@@ -3,6 +3,7 @@
 #include <eosio/http_plugin/local_endpoint.hpp>
 #endif
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/metrics.hpp>
 #include <eosio/chain/thread_utils.hpp>
 
 #include <fc/network/ip.hpp>
@@ -14,6 +15,10 @@
 
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -23,8 +28,14 @@
 #include <websocketpp/logger/stub.hpp>
 
 #include <thread>
+#include <mutex>
+#include <unordered_map>
 #include <memory>
 #include <regex>
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <sstream>
 
 const fc::string logger_name("http_plugin");
 fc::logger logger;
@@ -34,6 +45,7 @@ namespace eosio {
    static appbase::abstract_plugin& _http_plugin = app().register_plugin<http_plugin>();
 
    namespace asio = boost::asio;
+   namespace metrics = chain::metrics;
 
    using std::map;
    using std::vector;
@@ -46,6 +58,7 @@ namespace eosio {
    using boost::asio::ip::address_v6;
    using std::shared_ptr;
    using websocketpp::connection_hdl;
+   namespace bio = boost::iostreams;
 
    enum https_ecdh_curve_t {
       SECP384R1,
@@ -138,9 +151,43 @@ namespace eosio {
 
    static bool verbose_http_errors = false;
 
+   template<class T>
+   class websocket_session_impl : public websocket_session {
+      public:
+         websocket_session_impl( websocketpp::server<T>& ws, connection_hdl hdl, size_t max_buffered_bytes )
+            : _ws( ws ), _hdl( std::move( hdl ) ), _max_buffered_bytes( max_buffered_bytes ) {}
+
+         bool send( const string& message ) override {
+            websocketpp::lib::error_code ec;
+            auto con = _ws.get_con_from_hdl( _hdl, ec );
+            if( ec || con->get_state() != websocketpp::session::state::open ) return false;
+            if( con->get_buffered_amount() + message.size() > _max_buffered_bytes ) {
+               fc_dlog( logger, "closing websocket of ${ep}, ${b} bytes buffered", ("ep", con->get_resource())("b", con->get_buffered_amount()) );
+               con->close( websocketpp::close::status::try_again_later, "too slow", ec );
+               return false;
+            }
+            ec = con->send( message, websocketpp::frame::opcode::text );
+            return !ec;
+         }
+
+         void close( const string& reason ) override {
+            websocketpp::lib::error_code ec;
+            _ws.close( _hdl, websocketpp::close::status::normal, reason, ec );
+         }
+
+      private:
+         websocketpp::server<T>&  _ws;
+         const connection_hdl     _hdl;
+         const size_t             _max_buffered_bytes;
+   };
+
    class http_plugin_impl {
       public:
          map<string,url_handler>  url_handlers;
+         set<string>              plain_text_urls; ///< responses sent as text/plain instead of json
+         set<string>              serialized_json_urls; ///< string responses holding json, sent as is
+         set<string>              http_thread_urls; ///< handlers called on the http thread pool instead of the main thread
+         map<string,url_handler>  binary_url_handlers; ///< used instead of url_handlers for application/octet-stream requests
          optional<tcp::endpoint>  listen_endpoint;
          string                   access_control_allow_origin;
          string                   access_control_allow_headers;
@@ -156,6 +203,151 @@ namespace eosio {
          size_t                                      max_bytes_in_flight = 0;
          fc::microseconds                            max_response_time{30*1000};
 
+         /// serialized responses of one cached url, keyed by the normalized request body
+         struct response_cache {
+            std::mutex                                          mtx;
+            std::unordered_map<string, std::pair<int, string>>  responses;
+            uint64_t                                            generation = 0; ///< bumped by every clear
+         };
+         map<string, std::shared_ptr<response_cache>>          response_caches;
+         size_t                                                response_cache_size = 1024;
+
+         /// where the time of the requests to one url goes
+         struct endpoint_metrics {
+            explicit endpoint_metrics( const string& url )
+            : queue_wait_us( registry().get_histogram( "nodeos_http_queue_wait_microseconds", "time requests waited for the main thread",
+                                                       metrics::time_buckets_us(), label( url ) ) )
+            , handler_us( registry().get_histogram( "nodeos_http_handler_microseconds", "time from handler start to its response",
+                                                    metrics::time_buckets_us(), label( url ) ) )
+            , serialize_us( registry().get_histogram( "nodeos_http_serialize_microseconds", "time spent serializing and compressing responses",
+                                                      metrics::time_buckets_us(), label( url ) ) )
+            , response_bytes( registry().get_histogram( "nodeos_http_response_bytes", "size of the response bodies sent",
+                                                        metrics::size_buckets(), label( url ) ) )
+            , cache_hits( registry().get_counter( "nodeos_http_cache_hits_total", "responses sent from the response cache", label( url ) ) )
+            {}
+
+            static metrics::registry& registry() { return metrics::registry::instance(); }
+            static string label( const string& url ) { return metrics::registry::label( "url", url ); }
+
+            metrics::histogram&    queue_wait_us;    ///< posted to the main thread until the handler starts
+            metrics::histogram&    handler_us;       ///< handler start until it calls back with the response
+            metrics::histogram&    serialize_us;     ///< json serialization and compression on the http threads
+            metrics::histogram&    response_bytes;   ///< body sent, after compression
+            metrics::counter&      cache_hits;       ///< answered from the response cache, in none of the above
+         };
+         /**
+          * Admission control of one url, configured by http-endpoint-limit. Requests over the limits are answered
+          * with 429 on the http thread instead of being queued for the main thread.
+          */
+         struct endpoint_limit {
+            int                    priority = appbase::priority::low; ///< of the handler call posted to the main thread
+            double                 rate = 0;            ///< requests per second refilling the token bucket, 0 for no rate limit
+            double                 burst = 0;           ///< size of the token bucket
+            uint32_t               max_concurrent = 0;  ///< admitted requests not answered yet, 0 for no limit
+            std::atomic<uint32_t>  concurrent{0};
+            metrics::counter*      rejected = nullptr;
+
+            std::mutex             mtx;
+            double                 tokens = 0;
+            fc::time_point         last_refill;
+
+            bool take_token() {
+               if( rate <= 0 ) return true;
+               std::lock_guard<std::mutex> g( mtx );
+               const fc::time_point now = fc::time_point::now();
+               tokens = std::min( burst, tokens + rate * (now - last_refill).count() / 1000000.0 );
+               last_refill = now;
+               if( tokens < 1 ) return false;
+               tokens -= 1;
+               return true;
+            }
+         };
+
+         /// held by everything a request admitted under max_concurrent posts, frees its slot once all are done
+         struct concurrency_slot {
+            explicit concurrency_slot( std::shared_ptr<endpoint_limit> l ) : limit( std::move( l ) ) {}
+            ~concurrency_slot() { limit->concurrent.fetch_sub( 1, std::memory_order_relaxed ); }
+            std::shared_ptr<endpoint_limit> limit;
+         };
+
+         map<string, std::shared_ptr<endpoint_limit>>          endpoint_limits;
+
+         /// @return false if the request has to be rejected, otherwise slot is set if it takes a concurrency slot
+         bool admit( const std::shared_ptr<endpoint_limit>& limit, std::shared_ptr<concurrency_slot>& slot ) {
+            if( limit->max_concurrent ) {
+               if( limit->concurrent.fetch_add( 1, std::memory_order_relaxed ) >= limit->max_concurrent ) {
+                  limit->concurrent.fetch_sub( 1, std::memory_order_relaxed );
+                  limit->rejected->add();
+                  return false;
+               }
+               slot = std::make_shared<concurrency_slot>( limit );
+            }
+            if( !limit->take_token() ) {
+               slot.reset();
+               limit->rejected->add();
+               return false;
+            }
+            return true;
+         }
+
+         /// parses <url>=<key>:<value>[,<key>:<value>...] of http-endpoint-limit
+         void add_endpoint_limit( const string& spec ) {
+            const size_t eq = spec.find( '=' );
+            EOS_ASSERT( eq != string::npos && eq > 0, chain::plugin_config_exception,
+                        "http-endpoint-limit '${s}' is not <url>=<key>:<value>[,...]", ("s", spec) );
+            auto limit = std::make_shared<endpoint_limit>();
+            limit->rejected = &metrics::registry::instance().get_counter( "nodeos_http_rejected_total", "requests rejected by http-endpoint-limit",
+                                                                          metrics::registry::label( "url", spec.substr( 0, eq ) ) );
+            std::istringstream settings( spec.substr( eq + 1 ) );
+            string setting;
+            while( std::getline( settings, setting, ',' ) ) {
+               const size_t colon = setting.find( ':' );
+               EOS_ASSERT( colon != string::npos, chain::plugin_config_exception,
+                           "http-endpoint-limit setting '${s}' is not <key>:<value>", ("s", setting) );
+               const string key = setting.substr( 0, colon );
+               const string value = setting.substr( colon + 1 );
+               if( key == "priority" ) {
+                  if( value == "low" ) limit->priority = appbase::priority::low;
+                  else if( value == "medium" ) limit->priority = appbase::priority::medium;
+                  else if( value == "high" ) limit->priority = appbase::priority::high;
+                  else EOS_THROW( chain::plugin_config_exception, "http-endpoint-limit priority '${v}' is not low, medium or high", ("v", value) );
+               } else if( key == "rate" ) {
+                  limit->rate = std::stod( value );
+               } else if( key == "burst" ) {
+                  limit->burst = std::stod( value );
+               } else if( key == "concurrent" ) {
+                  limit->max_concurrent = std::stoul( value );
+               } else {
+                  EOS_THROW( chain::plugin_config_exception, "unknown http-endpoint-limit setting '${k}'", ("k", key) );
+               }
+            }
+            EOS_ASSERT( limit->rate >= 0 && limit->burst >= 0, chain::plugin_config_exception,
+                        "http-endpoint-limit '${s}' rate and burst must not be negative", ("s", spec) );
+            if( limit->burst < 1 ) limit->burst = std::max( 1.0, limit->rate );
+            limit->tokens = limit->burst;
+            limit->last_refill = fc::time_point::now();
+            endpoint_limits[spec.substr( 0, eq )] = std::move( limit );
+         }
+
+         map<string, websocket_handlers>                       websocket_handlers_by_url;
+         size_t                                                websocket_max_buffered_bytes = 4*1024*1024;
+         std::mutex                                            websocket_sessions_mtx;
+         /// open websocket connections of all servers with the handlers of their url
+         std::map<connection_hdl, std::pair<websocket_session_ptr, const websocket_handlers*>,
+                  std::owner_less<connection_hdl>>             websocket_sessions;
+
+         bool                                                  metrics_enabled = false;
+         map<string, std::shared_ptr<endpoint_metrics>>        endpoint_metrics_by_url;
+
+         string prometheus_metrics()const {
+            return metrics::registry::instance().prometheus_text( "nodeos_http_" );
+         }
+
+         size_t                   compression_min_bytes = 0; ///< smallest response body compressed, 0 disables compression
+         int                      compression_level = 6;
+         long                     idle_timeout_ms = 0; ///< time a client has to send its request after connecting, 0 waits forever
+         optional<int>            listen_backlog;
+
          optional<tcp::endpoint>  https_listen_endpoint;
          string                   https_cert_chain;
          string                   https_key;
@@ -291,6 +483,167 @@ namespace eosio {
             return true;
          }
 
+         /**
+          * @return true if con was answered from the cache; otherwise key and generation are what the response has to
+          * be stored under, key is left empty if the body is not valid json
+          */
+         template<class T>
+         bool find_cached_response( response_cache& cache, const string& body, string& key, uint64_t& generation, const T& con ) {
+            try {
+               key = fc::json::to_string( fc::json::from_string( body.empty() ? "{}" : body ), fc::time_point::maximum() );
+            } catch( ... ) {
+               key.clear();
+               return false;
+            }
+            int code = 0;
+            string json;
+            {
+               std::lock_guard<std::mutex> g( cache.mtx );
+               auto itr = cache.responses.find( key );
+               if( itr == cache.responses.end() ) {
+                  generation = cache.generation;
+                  return false;
+               }
+               code = itr->second.first;
+               json = itr->second.second;
+            }
+            set_response_body( con, std::move( json ) );
+            con->set_status( websocketpp::http::status_code::value( code ) );
+            return true;
+         }
+
+         /// true if the request lists application/octet-stream in its Accept header, without q=0
+         static bool accepts_binary( const string& accept ) {
+            const size_t pos = accept.find( "application/octet-stream" );
+            if( pos == string::npos ) return false;
+            const size_t end = accept.find( ',', pos );
+            const size_t q = accept.find( "q=", pos );
+            return q == string::npos || q > end || std::strtod( accept.c_str() + q + 2, nullptr ) > 0.0;
+         }
+
+         enum class content_encoding { identity, gzip, deflate };
+
+         /// gzip is preferred over deflate when both are accepted; encodings with q=0 are refused
+         static content_encoding negotiate_encoding( const string& accept_encoding ) {
+            bool gzip = false, deflate = false;
+            size_t pos = 0;
+            while( pos < accept_encoding.size() ) {
+               size_t end = accept_encoding.find( ',', pos );
+               if( end == string::npos ) end = accept_encoding.size();
+               string coding = accept_encoding.substr( pos, end - pos );
+               pos = end + 1;
+
+               bool refused = false;
+               const size_t params = coding.find( ';' );
+               if( params != string::npos ) {
+                  const size_t q = coding.find( "q=", params );
+                  refused = q != string::npos && std::strtod( coding.c_str() + q + 2, nullptr ) <= 0.0;
+                  coding.resize( params );
+               }
+               coding.erase( 0, coding.find_first_not_of( " \t" ) );
+               coding.erase( coding.find_last_not_of( " \t" ) + 1 );
+               std::transform( coding.begin(), coding.end(), coding.begin(), ::tolower );
+
+               if( coding == "gzip" || coding == "x-gzip" || coding == "*" ) gzip = !refused;
+               else if( coding == "deflate" ) deflate = !refused;
+            }
+            return gzip ? content_encoding::gzip : deflate ? content_encoding::deflate : content_encoding::identity;
+         }
+
+         /// deflate is the zlib format of RFC 1950, as HTTP defines it
+         string compress( const string& body, content_encoding encoding )const {
+            string out;
+            out.reserve( body.size() / 4 );
+            bio::filtering_ostream comp;
+            if( encoding == content_encoding::gzip )
+               comp.push( bio::gzip_compressor( bio::gzip_params( compression_level ) ) );
+            else
+               comp.push( bio::zlib_compressor( bio::zlib_params( compression_level ) ) );
+            comp.push( bio::back_inserter( out ) );
+            bio::write( comp, body.data(), body.size() );
+            bio::close( comp );
+            return out;
+         }
+
+         /// sets the response body, compressed when it is large enough and the client accepts an encoding;
+         /// called on the http thread pool
+         template<typename T>
+         size_t set_response_body( const T& con, string&& body ) {
+            if( compression_min_bytes && body.size() >= compression_min_bytes ) {
+               con->append_header( "Vary", "Accept-Encoding" );
+               const content_encoding encoding = negotiate_encoding( con->get_request_header( "Accept-Encoding" ) );
+               if( encoding != content_encoding::identity ) {
+                  try {
+                     string compressed = compress( body, encoding );
+                     con->append_header( "Content-Encoding", encoding == content_encoding::gzip ? "gzip" : "deflate" );
+                     body = std::move( compressed );
+                  } catch( const std::exception& e ) {
+                     fc_wlog( logger, "unable to compress http response, sending it uncompressed: ${e}", ("e", e.what()) );
+                  }
+               }
+            }
+            const size_t size = body.size();
+            con->set_body( std::move( body ) );
+            return size;
+         }
+
+         template<class T>
+         void configure_server( websocketpp::server<T>& ws ) {
+            ws.set_open_handshake_timeout( idle_timeout_ms );
+            if( listen_backlog ) ws.set_listen_backlog( *listen_backlog );
+            ws.set_max_message_size( max_body_size );
+
+            // only urls registered by add_websocket_handler can be upgraded
+            ws.set_validate_handler( [this, &ws]( connection_hdl hdl ) {
+               auto con = ws.get_con_from_hdl( hdl );
+               if( !allow_host<T>( con->get_request(), con ) ) return false;
+               if( websocket_handlers_by_url.count( con->get_resource() ) ) return true;
+               con->set_status( websocketpp::http::status_code::not_found );
+               return false;
+            } );
+            ws.set_open_handler( [this, &ws]( connection_hdl hdl ) {
+               auto con = ws.get_con_from_hdl( hdl );
+               auto itr = websocket_handlers_by_url.find( con->get_resource() );
+               if( itr == websocket_handlers_by_url.end() ) return;
+               auto session = std::make_shared<websocket_session_impl<T>>( ws, hdl, websocket_max_buffered_bytes );
+               {
+                  std::lock_guard<std::mutex> g( websocket_sessions_mtx );
+                  websocket_sessions[hdl] = std::make_pair( session, &itr->second );
+               }
+               if( itr->second.on_open )
+                  app().post( appbase::priority::low, [session, &handlers = itr->second]() { handlers.on_open( session ); } );
+            } );
+            ws.set_message_handler( [this]( connection_hdl hdl, typename websocketpp::server<T>::message_ptr msg ) {
+               std::unique_lock<std::mutex> g( websocket_sessions_mtx );
+               auto itr = websocket_sessions.find( hdl );
+               if( itr == websocket_sessions.end() || !itr->second.second->on_message ) return;
+               auto session = itr->second.first;
+               const auto& handlers = *itr->second.second;
+               g.unlock();
+               app().post( appbase::priority::low, [session, &handlers, payload{msg->get_payload()}]() mutable {
+                  handlers.on_message( session, std::move( payload ) );
+               } );
+            } );
+            ws.set_close_handler( [this]( connection_hdl hdl ) {
+               std::unique_lock<std::mutex> g( websocket_sessions_mtx );
+               auto itr = websocket_sessions.find( hdl );
+               if( itr == websocket_sessions.end() ) return;
+               auto session = std::move( itr->second.first );
+               const auto& handlers = *itr->second.second;
+               websocket_sessions.erase( itr );
+               g.unlock();
+               if( handlers.on_close )
+                  app().post( appbase::priority::low, [session, &handlers]() { handlers.on_close( session ); } );
+            } );
+         }
+
+         void store_cached_response( response_cache& cache, string&& key, uint64_t generation, int code, const string& json ) {
+            std::lock_guard<std::mutex> g( cache.mtx );
+            if( generation != cache.generation ) return; // cleared while the response was being computed
+            if( cache.responses.size() >= response_cache_size ) cache.responses.clear();
+            cache.responses.emplace( std::move( key ), std::make_pair( code, json ) );
+         }
+
          template<class T>
          void handle_http_request(typename websocketpp::server<T>::connection_ptr con) {
             try {
@@ -325,12 +678,55 @@ namespace eosio {
                std::string resource = con->get_uri()->get_resource();
                auto handler_itr = url_handlers.find( resource );
                if( handler_itr != url_handlers.end()) {
+                  const bool plain_text = plain_text_urls.count( resource ) > 0;
+                  const bool serialized_json = serialized_json_urls.count( resource ) > 0;
+                  bool binary = false;
+                  if( !binary_url_handlers.empty() && accepts_binary( req.get_header( "Accept" ) ) ) {
+                     auto binary_itr = binary_url_handlers.find( resource );
+                     if( binary_itr != binary_url_handlers.end() ) {
+                        handler_itr = binary_itr;
+                        binary = true;
+                     }
+                  }
+                  std::shared_ptr<response_cache> cache;
+                  string cache_key;
+                  uint64_t cache_generation = 0;
+                  std::shared_ptr<endpoint_metrics> metrics;
+                  auto metrics_itr = endpoint_metrics_by_url.find( resource );
+                  if( metrics_itr != endpoint_metrics_by_url.end() ) metrics = metrics_itr->second;
+                  auto cache_itr = response_caches.find( resource );
+                  if( !binary && cache_itr != response_caches.end() ) {
+                     if( find_cached_response( *cache_itr->second, body, cache_key, cache_generation, con ) ) {
+                        if( metrics ) metrics->cache_hits.add();
+                        return;
+                     }
+                     if( !cache_key.empty() ) cache = cache_itr->second;
+                  }
+
+                  int priority = appbase::priority::low;
+                  std::shared_ptr<concurrency_slot> slot;
+                  auto limit_itr = endpoint_limits.find( resource );
+                  if( limit_itr != endpoint_limits.end() ) {
+                     priority = limit_itr->second->priority;
+                     if( !admit( limit_itr->second, slot ) ) {
+                        fc_dlog( logger, "429 - endpoint limit reached: ${ep}", ("ep", resource) );
+                        error_results results{websocketpp::http::status_code::too_many_requests, "Too Many Requests", error_results::error_info()};
+                        con->set_body( fc::json::to_string( results, fc::time_point::maximum() ));
+                        con->set_status( websocketpp::http::status_code::too_many_requests );
+                        return;
+                     }
+                  }
+
                   con->defer_http_response();
                   bytes_in_flight += body.size();
-                  app().post( appbase::priority::low,
-                              [&ioc = thread_pool->get_executor(), &bytes_in_flight = this->bytes_in_flight,
-                               handler_itr, this, resource{std::move( resource )}, body{std::move( body )}, con]() mutable {
+                  const fc::time_point posted = metrics ? fc::time_point::now() : fc::time_point();
+                  auto run_handler = [&ioc = thread_pool->get_executor(), &bytes_in_flight = this->bytes_in_flight,
+                               handler_itr, this, resource{std::move( resource )}, body{std::move( body )}, con,
+                               cache{std::move( cache )}, cache_key{std::move( cache_key )}, cache_generation, plain_text,
+                               serialized_json, binary, metrics{std::move( metrics )}, posted, slot]() mutable {
                      const size_t body_size = body.size();
+                     const fc::time_point handler_start = metrics ? fc::time_point::now() : fc::time_point();
+                     if( metrics ) metrics->queue_wait_us.record( std::max<int64_t>( (handler_start - posted).count(), 0 ) );
                      if( !verify_max_bytes_in_flight( con ) ) {
                         con->send_http_response();
                         bytes_in_flight -= body_size;
@@ -338,7 +734,9 @@ namespace eosio {
                      }
                      try {
                         handler_itr->second( std::move( resource ), std::move( body ),
-                                 [&ioc, &bytes_in_flight, con, this]( int code, fc::variant response_body ) {
+                                 [&ioc, &bytes_in_flight, con, this, cache{std::move( cache )}, cache_key{std::move( cache_key )},
+                                  cache_generation, plain_text, serialized_json, binary, metrics, handler_start, slot]( int code, fc::variant response_body ) mutable {
+                           if( metrics ) metrics->handler_us.record( std::max<int64_t>( (fc::time_point::now() - handler_start).count(), 0 ) );
                            size_t response_size = 0;
                            try {
                               response_size = fc::raw::pack_size( response_body );
@@ -350,12 +748,33 @@ namespace eosio {
                            } else {
                               boost::asio::post( ioc,
                                  [response_body{std::move( response_body )}, response_size, &bytes_in_flight,
-                                  con, code, max_response_time=max_response_time]() mutable {
+                                  con, code, max_response_time=max_response_time, this, cache{std::move( cache )},
+                                  cache_key{std::move( cache_key )}, cache_generation, plain_text, serialized_json, binary, metrics{std::move( metrics )},
+                                  slot{std::move( slot )}]() mutable {
+                                 const fc::time_point serialize_start = metrics ? fc::time_point::now() : fc::time_point();
                                  std::string json;
                                  try {
-                                    json = fc::json::to_string( response_body, fc::time_point::now() + max_response_time );
-                                    con->set_body( std::move( json ) );
+                                    if( binary && response_body.get_type() == fc::variant::blob_type ) {
+                                       // errors of binary requests are still sent as json
+                                       const auto& data = response_body.get_blob().data;
+                                       json.assign( data.begin(), data.end() );
+                                       con->replace_header( "Content-type", "application/octet-stream" );
+                                    } else if( plain_text && response_body.is_string() ) {
+                                       json = response_body.get_string();
+                                       con->replace_header( "Content-type", "text/plain; charset=utf-8" );
+                                    } else if( serialized_json && response_body.is_string() ) {
+                                       json = response_body.get_string();
+                                    } else {
+                                       json = fc::json::to_string( response_body, fc::time_point::now() + max_response_time );
+                                    }
+                                    if( cache && code == websocketpp::http::status_code::ok )
+                                       store_cached_response( *cache, std::move( cache_key ), cache_generation, code, json );
+                                    const size_t sent_size = set_response_body( con, std::move( json ) );
                                     con->set_status( websocketpp::http::status_code::value( code ) );
+                                    if( metrics ) {
+                                       metrics->serialize_us.record( std::max<int64_t>( (fc::time_point::now() - serialize_start).count(), 0 ) );
+                                       metrics->response_bytes.record( sent_size );
+                                    }
                                  } catch( ... ) {
                                     handle_exception<T>( con );
                                  }
@@ -372,7 +791,11 @@ namespace eosio {
                         con->send_http_response();
                      }
                      bytes_in_flight -= body_size;
-                  } );
+                  };
+                  if( http_thread_urls.count( handler_itr->first ) )
+                     boost::asio::post( thread_pool->get_executor(), std::move( run_handler ) );
+                  else
+                     app().post( priority, std::move( run_handler ) );
 
                } else {
                   fc_dlog( logger, "404 - not found: ${ep}", ("ep", resource) );
@@ -393,6 +816,7 @@ namespace eosio {
                ws.init_asio( &thread_pool->get_executor() );
                ws.set_reuse_addr(true);
                ws.set_max_http_body_size(max_body_size);
+               configure_server(ws);
                // capture server_ioc shared_ptr in http handler to keep it alive while in use
                ws.set_http_handler([&](connection_hdl hdl) {
                   handle_http_request<detail::asio_with_stub_log<T>>(ws.get_con_from_hdl(hdl));
@@ -502,12 +926,58 @@ namespace eosio {
              "Additionaly acceptable values for the \"Host\" header of incoming HTTP requests, can be specified multiple times.  Includes http/s_server_address by default.")
             ("http-threads", bpo::value<uint16_t>()->default_value( my->thread_pool_size ),
              "Number of worker threads in http thread pool")
+            ("http-response-cache-size", bpo::value<uint32_t>()->default_value( my->response_cache_size ),
+             "Maximum number of responses kept for each endpoint that supports response caching, 0 disables the cache")
+            ("http-compression-min-bytes", bpo::value<uint32_t>()->default_value( my->compression_min_bytes ),
+             "Smallest response body in bytes that is gzip or deflate compressed for clients sending Accept-Encoding, 0 disables compression")
+            ("http-compression-level", bpo::value<int>()->default_value( my->compression_level ),
+             "Compression level of http responses, from 1 (fastest) to 9 (smallest)")
+            ("http-idle-timeout-ms", bpo::value<uint32_t>()->default_value( my->idle_timeout_ms ),
+             "Time in milliseconds a client has to send its request after connecting before the connection is closed, 0 to wait forever")
+            ("http-listen-backlog", bpo::value<int>(),
+             "Maximum number of connections waiting to be accepted, the operating system default if not set")
+            ("http-endpoint-limit", bpo::value<std::vector<string>>()->composing(),
+             "Admission control of an endpoint as <url>=<key>:<value>[,<key>:<value>...], can be specified multiple times. Keys are "
+             "priority (low, medium or high, of its handler on the main thread, default low), rate (requests per second), "
+             "burst (requests admitted at once when idle, default rate) and concurrent (requests being processed). "
+             "Requests over a limit are answered with 429, e.g. /v1/chain/get_table_rows=rate:200,concurrent:16")
+            ("http-websocket-max-buffered-kb", bpo::value<uint32_t>()->default_value( my->websocket_max_buffered_bytes / 1024 ),
+             "Maximum size in kilobytes of the messages queued for a websocket connection, a slower client is disconnected")
+            ("http-metrics", bpo::bool_switch()->default_value(false),
+             "Measure queue wait, handler and serialization time and response size of every endpoint, served in the Prometheus text format by /v1/http/prometheus_metrics "
+             "and, with the other metrics of the process, by prometheus_plugin")
             ;
    }
 
    void http_plugin::plugin_initialize(const variables_map& options) {
       try {
          my->validate_host = options.at("http-validate-host").as<bool>();
+         my->response_cache_size = options.at("http-response-cache-size").as<uint32_t>();
+         my->compression_min_bytes = options.at("http-compression-min-bytes").as<uint32_t>();
+         my->compression_level = options.at("http-compression-level").as<int>();
+         EOS_ASSERT( my->compression_level >= 1 && my->compression_level <= 9, chain::plugin_config_exception,
+                     "http-compression-level ${l} must be between 1 and 9", ("l", my->compression_level));
+         my->idle_timeout_ms = options.at("http-idle-timeout-ms").as<uint32_t>();
+         my->websocket_max_buffered_bytes = options.at("http-websocket-max-buffered-kb").as<uint32_t>() * 1024;
+         my->metrics_enabled = options.at("http-metrics").as<bool>();
+         if( my->metrics_enabled ) {
+            add_plain_text_handler( "/v1/http/prometheus_metrics", [this](string, string body, url_response_callback cb) {
+               try {
+                  cb( 200, fc::variant( my->prometheus_metrics() ) );
+               } catch (...) {
+                  http_plugin::handle_exception( "http", "prometheus_metrics", body, cb );
+               }
+            });
+         }
+         if( options.count( "http-endpoint-limit" )) {
+            for( const auto& spec : options.at( "http-endpoint-limit" ).as<vector<string>>() )
+               my->add_endpoint_limit( spec );
+         }
+         if( options.count( "http-listen-backlog" )) {
+            my->listen_backlog = options.at("http-listen-backlog").as<int>();
+            EOS_ASSERT( *my->listen_backlog > 0, chain::plugin_config_exception,
+                        "http-listen-backlog ${b} must be greater than 0", ("b", *my->listen_backlog));
+         }
          if( options.count( "http-alias" )) {
             const auto& aliases = options["http-alias"].as<vector<string>>();
             my->valid_hosts.insert(aliases.begin(), aliases.end());
@@ -620,6 +1090,7 @@ namespace eosio {
             my->unix_server.clear_access_channels(websocketpp::log::alevel::all);
             my->unix_server.init_asio( &my->thread_pool->get_executor() );
             my->unix_server.set_max_http_body_size(my->max_body_size);
+            my->configure_server(my->unix_server);
             my->unix_server.listen(*my->unix_endpoint);
             my->unix_server.set_http_handler([&, &ioc = my->thread_pool->get_executor()](connection_hdl hdl) {
                my->handle_http_request<detail::asio_local_with_stub_log>( my->unix_server.get_con_from_hdl(hdl));
@@ -693,9 +1164,58 @@ namespace eosio {
       }
    }
 
+   boost::asio::io_context& http_plugin::get_thread_pool_executor() {
+      EOS_ASSERT( my->thread_pool, chain::plugin_exception, "http thread pool not started" );
+      return my->thread_pool->get_executor();
+   }
+
+   uint16_t http_plugin::get_thread_pool_size()const {
+      return my->thread_pool_size;
+   }
+
    void http_plugin::add_handler(const string& url, const url_handler& handler) {
       fc_ilog( logger, "add api url: ${c}", ("c", url) );
       my->url_handlers.insert(std::make_pair(url,handler));
+      if( my->metrics_enabled )
+         my->endpoint_metrics_by_url.emplace( url, std::make_shared<http_plugin_impl::endpoint_metrics>( url ) );
+   }
+
+   void http_plugin::add_plain_text_handler(const string& url, const url_handler& handler) {
+      add_handler( url, handler );
+      my->plain_text_urls.insert( url );
+   }
+
+   void http_plugin::set_serialized_json_responses(const string& url) {
+      my->serialized_json_urls.insert( url );
+   }
+
+   void http_plugin::add_http_thread_handler(const string& url, const url_handler& handler) {
+      add_handler( url, handler );
+      my->http_thread_urls.insert( url );
+   }
+
+   void http_plugin::add_binary_handler(const string& url, const url_handler& handler) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->binary_url_handlers.insert(std::make_pair(url,handler));
+   }
+
+   void http_plugin::add_cached_handler(const string& url, const url_handler& handler) {
+      add_handler( url, handler );
+      if( my->response_cache_size > 0 )
+         my->response_caches.emplace( url, std::make_shared<http_plugin_impl::response_cache>() );
+   }
+
+   void http_plugin::clear_cached_responses(const string& url) {
+      auto itr = my->response_caches.find( url );
+      if( itr == my->response_caches.end() ) return;
+      std::lock_guard<std::mutex> g( itr->second->mtx );
+      itr->second->responses.clear();
+      ++itr->second->generation;
+   }
+
+   void http_plugin::add_websocket_handler(const string& url, const websocket_handlers& handlers) {
+      fc_ilog( logger, "add websocket url: ${c}", ("c", url) );
+      my->websocket_handlers_by_url[url] = handlers;
    }
 
    void http_plugin::handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb ) {
@@ -4,6 +4,8 @@
 
 #include <fc/reflect/reflect.hpp>
 
+#include <boost/asio/io_context.hpp>
+
 namespace eosio {
    using namespace appbase;
 
@@ -36,6 +38,29 @@ namespace eosio {
     */
    using api_description = std::map<string, url_handler>;
 
+   /**
+    * @brief An open websocket connection of a websocket url
+    *
+    * Messages are queued per connection. A connection whose queue grows over http-websocket-max-buffered-kb is
+    * closed instead of buffering without bound.
+    */
+   class websocket_session {
+      public:
+         virtual ~websocket_session() = default;
+
+         /// queues a text message; may be called from any thread, false if the connection is closed or was too slow
+         virtual bool send( const string& message ) = 0;
+         virtual void close( const string& reason ) = 0;
+   };
+   using websocket_session_ptr = std::shared_ptr<websocket_session>;
+
+   /// callbacks of a websocket url, called on the appbase application thread
+   struct websocket_handlers {
+      std::function<void(websocket_session_ptr)>          on_open;
+      std::function<void(websocket_session_ptr, string)>  on_message;
+      std::function<void(websocket_session_ptr)>          on_close;
+   };
+
    struct http_plugin_defaults {
       //If empty, unix socket support will be completely disabled. If not empty,
       // unix socket support is enabled with the given default path (treated relative
@@ -78,6 +103,39 @@ namespace eosio {
         void handle_sighup() override;
 
         void add_handler(const string& url, const url_handler&);
+
+        /// Like add_handler, but a string response body is sent as is with content type text/plain instead of as json
+        void add_plain_text_handler(const string& url, const url_handler&);
+
+        /**
+         * String response bodies of the handler of url, whichever way it was added, already hold serialized json and
+         * are sent as is; spares handlers producing large responses from building them as an fc::variant first
+         */
+        void set_serialized_json_responses(const string& url);
+
+        /**
+         * Like add_handler, but the handler is called on an http thread instead of the main thread, for work like
+         * parsing the request before it posts whatever needs the chain state to the main thread itself
+         */
+        void add_http_thread_handler(const string& url, const url_handler&);
+
+        /**
+         * Handler used instead of the one of add_handler(url) for requests accepting application/octet-stream. It
+         * answers with an fc::blob variant, whose bytes are sent as is; any other response, like an error, is sent
+         * as json. Such responses are never cached.
+         */
+        void add_binary_handler(const string& url, const url_handler&);
+
+        /**
+         * Like add_handler, but successful responses are kept, already serialized, per request body and answered
+         * from the http threads without calling the handler until clear_cached_responses(url) is called
+         */
+        void add_cached_handler(const string& url, const url_handler&);
+        /// may be called from any thread
+        void clear_cached_responses(const string& url);
+
+        /// accepts websocket connections on url
+        void add_websocket_handler(const string& url, const websocket_handlers&);
         void add_api(const api_description& api) {
            for (const auto& call : api)
               add_handler(call.first, call.second);
@@ -86,6 +144,10 @@ namespace eosio {
         // standard exception handling for api handlers
         static void handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb );
 
+        /// executor of the http-threads, only valid between plugin_startup and plugin_shutdown
+        boost::asio::io_context& get_thread_pool_executor();
+        uint16_t get_thread_pool_size()const;
+
         bool is_on_loopback() const;
         bool is_secure() const;
 
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <eosio/mongo_db_plugin/bson.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/trace.hpp>
+
+namespace eosio {
+
+/**
+ * Writes ABI serialized binary straight into BSON by walking the compiled types of an abi_serializer, without the
+ * fc::variant tree of binary_to_variant in between. The BSON is the same as to_bson of binary_to_variant. Integers,
+ * floats, names and strings are converted directly; other built-ins, types that are not compiled and structs whose
+ * fields binary_to_variant would merge or bson.hpp would treat as an extended JSON value go through binary_to_variant.
+ */
+class abi_to_bson {
+public:
+   abi_to_bson( const chain::abi_serializer& abis, const fc::microseconds& max_serialization_time );
+
+   /// appends the value of type to c, c is left partially written if an exception is thrown
+   void append( const std::string_view& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c );
+
+private:
+   using compiled_type = chain::abi_serializer::compiled_type;
+   typedef void (*built_in_writer)( fc::datastream<const char*>&, bsoncxx::builder::core& );
+
+   /// @return false if null was appended
+   bool append( const compiled_type& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c, size_t depth );
+   bool append_variant( const std::string_view& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c );
+   /// @return number of fields appended
+   size_t append_fields( const compiled_type& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c, size_t depth );
+   void check( size_t depth )const;
+
+   static built_in_writer find_built_in_writer( const compiled_type& type );
+   static bool has_extended_json_key( const compiled_type& type );
+
+   const chain::abi_serializer& abis;
+   fc::microseconds             max_serialization_time;
+   fc::time_point               deadline;
+};
+
+/// appends act as abi_serializer::to_variant converts it: data decoded with the ABI from resolver, if it has one
+template<typename Resolver>
+void append_action( const chain::action& act, Resolver&& resolver, const fc::microseconds& max_serialization_time,
+                    bsoncxx::builder::core& c );
+
+/// appends the fields of atrace as abi_serializer::to_variant converts them, act with append_action
+template<typename Resolver>
+void append_action_trace( const chain::action_trace& atrace, Resolver&& resolver,
+                          const fc::microseconds& max_serialization_time, bsoncxx::builder::core& c );
+
+} // namespace eosio
+
+namespace eosio {
+
+namespace abi_bson_detail {
+
+template <typename T>
+void integer_to_bson( fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   T v;
+   fc::raw::unpack( stream, v );
+   // to_bson writes every fc::variant integer as int64
+   c.append( static_cast<int64_t>(v) );
+}
+
+template <typename T>
+void varint_to_bson( fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   T v;
+   fc::raw::unpack( stream, v );
+   c.append( static_cast<int64_t>(v.value) );
+}
+
+template <typename T>
+void float_to_bson( fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   T v;
+   fc::raw::unpack( stream, v );
+   c.append( static_cast<double>(v) );
+}
+
+inline void name_to_bson( fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   chain::name n;
+   fc::raw::unpack( stream, n );
+   c.append( n.to_string() );
+}
+
+inline void string_to_bson( fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   std::string s;
+   fc::raw::unpack( stream, s );
+   c.append( std::move( s ) );
+}
+
+} // namespace abi_bson_detail
+
+abi_to_bson::abi_to_bson( const chain::abi_serializer& abis, const fc::microseconds& max_serialization_time )
+: abis( abis ), max_serialization_time( max_serialization_time ), deadline( fc::time_point::now() + max_serialization_time )
+{
+}
+
+void abi_to_bson::append( const std::string_view& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   if( const auto* t = abis.find_compiled_type( type ) ) {
+      append( *t, stream, c, 0 );
+   } else {
+      append_variant( type, stream, c );
+   }
+}
+
+abi_to_bson::built_in_writer abi_to_bson::find_built_in_writer( const compiled_type& type ) {
+   using namespace abi_bson_detail;
+   // the unpacked types of abi_serializer::configure_built_in_types, bool is unpacked as uint8
+   static const std::map<std::string_view, built_in_writer> writers = {
+         {"bool",      &integer_to_bson<uint8_t>},
+         {"int8",      &integer_to_bson<int8_t>},
+         {"uint8",     &integer_to_bson<uint8_t>},
+         {"int16",     &integer_to_bson<int16_t>},
+         {"uint16",    &integer_to_bson<uint16_t>},
+         {"int32",     &integer_to_bson<int32_t>},
+         {"uint32",    &integer_to_bson<uint32_t>},
+         {"int64",     &integer_to_bson<int64_t>},
+         {"uint64",    &integer_to_bson<uint64_t>},
+         {"varint32",  &varint_to_bson<fc::signed_int>},
+         {"varuint32", &varint_to_bson<fc::unsigned_int>},
+         {"float32",   &float_to_bson<float>},
+         {"float64",   &float_to_bson<double>},
+         {"name",      &name_to_bson},
+         {"string",    &string_to_bson}
+   };
+   if( type.built_in_array || type.built_in_optional ) return nullptr;
+   auto itr = writers.find( type.fundamental );
+   return itr != writers.end() ? itr->second : nullptr;
+}
+
+bool abi_to_bson::has_extended_json_key( const compiled_type& type ) {
+   // to_bson turns an object with a single "$oid", "$date" or "$timestamp" key into that BSON type
+   size_t count = 0;
+   const std::string* key = nullptr;
+   for( const compiled_type* t = &type; t != nullptr; t = t->base ) {
+      count += t->struct_itr->second.fields.size();
+      if( !t->struct_itr->second.fields.empty() ) key = &t->struct_itr->second.fields.front().name;
+   }
+   return count == 1 && !key->empty() && key->front() == '$';
+}
+
+void abi_to_bson::check( size_t depth )const {
+   const size_t max_recursion_depth = chain::abi_serializer::max_recursion_depth;
+   EOS_ASSERT( depth < max_recursion_depth, chain::abi_recursion_depth_exception,
+               "recursive definition, max_recursion_depth ${r} ", ("r", max_recursion_depth) );
+   EOS_ASSERT( fc::time_point::now() < deadline, chain::abi_serialization_deadline_exception,
+               "serialization time limit ${t}us exceeded", ("t", max_serialization_time) );
+}
+
+bool abi_to_bson::append_variant( const std::string_view& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c ) {
+   auto v = abis.binary_to_variant( type, stream, max_serialization_time, true );
+   to_bson( v, c );
+   return !v.is_null();
+}
+
+size_t abi_to_bson::append_fields( const compiled_type& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c,
+                                   size_t depth ) {
+   check( depth );
+   size_t appended = 0;
+   if( type.base ) {
+      appended += append_fields( *type.base, stream, c, depth + 1 );
+   }
+   const auto& st = type.struct_itr->second;
+   bool encountered_extension = false;
+   for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+      const auto& field = st.fields[i];
+      const auto& compiled_field = type.fields[i];
+      encountered_extension |= compiled_field.extension;
+      if( !stream.remaining() ) {
+         if( compiled_field.extension ) {
+            continue;
+         }
+         EOS_ASSERT( !encountered_extension, chain::abi_exception,
+                     "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                     ("f", field.name)("p", st.name) );
+         EOS_THROW( chain::unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                    ("f", field.name)("p", st.name) );
+      }
+      c.key_view( field.name );
+      append( *compiled_field.type, stream, c, depth + 1 );
+      ++appended;
+   }
+   return appended;
+}
+
+bool abi_to_bson::append( const compiled_type& type, fc::datastream<const char*>& stream, bsoncxx::builder::core& c, size_t depth ) {
+   using kind_type = compiled_type::kind_type;
+   check( depth );
+   switch( type.kind ) {
+      case kind_type::unknown:
+         return append_variant( type.name, stream, c );
+      case kind_type::built_in: {
+         if( auto writer = find_built_in_writer( type ) ) {
+            try {
+               writer( stream, c );
+               return true;
+            } EOS_RETHROW_EXCEPTIONS( chain::unpack_exception, "Unable to unpack built-in type '${type}'", ("type", type.fundamental) )
+         }
+         fc::variant v;
+         try {
+            v = type.built_in->first( stream, type.built_in_array, type.built_in_optional );
+         } EOS_RETHROW_EXCEPTIONS( chain::unpack_exception, "Unable to unpack built-in type '${type}'", ("type", type.fundamental) )
+         to_bson( v, c );
+         return !v.is_null();
+      }
+      case kind_type::array: {
+         fc::unsigned_int size;
+         fc::raw::unpack( stream, size );
+         c.open_array();
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            EOS_ASSERT( append( *type.element, stream, c, depth + 1 ), chain::unpack_exception,
+                        "Invalid packed array '${t}'", ("t", type.name) );
+         }
+         c.close_array();
+         return true;
+      }
+      case kind_type::optional: {
+         char flag;
+         fc::raw::unpack( stream, flag );
+         if( flag ) return append( *type.element, stream, c, depth + 1 );
+         c.append( bsoncxx::types::b_null{} );
+         return false;
+      }
+      case kind_type::variant: {
+         fc::unsigned_int select;
+         fc::raw::unpack( stream, select );
+         EOS_ASSERT( (size_t)select < type.variant_types.size(), chain::unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${t}'", ("select", select.value)("t", type.name) );
+         c.open_array();
+         c.append( type.variant_itr->second.types[select] );
+         append( *type.variant_types[select], stream, c, depth + 1 );
+         c.close_array();
+         return true;
+      }
+      case kind_type::structure:
+         break;
+   }
+
+   if( !type.unique_fields || has_extended_json_key( type ) ) {
+      return append_variant( type.name, stream, c );
+   }
+   c.open_document();
+   const auto appended = append_fields( type, stream, c, depth );
+   EOS_ASSERT( appended > 0, chain::unpack_exception, "Unable to unpack '${t}' from stream", ("t", type.name) );
+   c.close_document();
+   return true;
+}
+
+template<typename Resolver>
+void append_action( const chain::action& act, Resolver&& resolver, const fc::microseconds& max_serialization_time,
+                    bsoncxx::builder::core& c ) {
+   c.open_document();
+   c.key_view( "account" ).append( act.account.to_string() );
+   c.key_view( "name" ).append( act.name.to_string() );
+   c.key_view( "authorization" );
+   to_bson( fc::variant( act.authorization ), c );
+
+   bool decoded = false;
+   try {
+      const chain::abi_serializer* abis = resolver( act.account );
+      if( abis ) {
+         auto type = abis->get_action_type( act.name );
+         if( !type.empty() ) {
+            // any failure to decode leaves the data as hex, like abi_serializer::to_variant
+            bsoncxx::builder::core data( false );
+            fc::datastream<const char*> stream( act.data.data(), act.data.size() );
+            data.key_view( "data" );
+            abi_to_bson( *abis, max_serialization_time ).append( type, stream, data );
+            c.concatenate( data.view_document() );
+            decoded = true;
+         }
+      }
+   } catch( ... ) {
+   }
+
+   if( decoded ) c.key_view( "hex_data" );
+   else c.key_view( "data" );
+   to_bson( fc::variant( act.data ), c );
+   c.close_document();
+}
+
+namespace abi_bson_detail {
+
+template<typename Resolver>
+struct action_trace_to_bson {
+   const chain::action_trace& atrace;
+   Resolver&                  resolver;
+   const fc::microseconds&    max_serialization_time;
+   bsoncxx::builder::core&    c;
+
+   template<typename Member, class Class, Member (Class::*member)>
+   void operator()( const char* name )const {
+      c.key_view( name );
+      if constexpr( std::is_same_v<Member, chain::action> ) {
+         append_action( atrace.*member, resolver, max_serialization_time, c );
+      } else {
+         to_bson( fc::variant( atrace.*member ), c );
+      }
+   }
+};
+
+} // namespace abi_bson_detail
+
+template<typename Resolver>
+void append_action_trace( const chain::action_trace& atrace, Resolver&& resolver,
+                          const fc::microseconds& max_serialization_time, bsoncxx::builder::core& c ) {
+   fc::reflector<chain::action_trace>::visit(
+         abi_bson_detail::action_trace_to_bson<std::decay_t<Resolver>>{atrace, resolver, max_serialization_time, c} );
+}
+
+} // namespace eosio
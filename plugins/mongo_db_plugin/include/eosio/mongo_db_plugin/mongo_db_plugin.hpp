@@ -8,6 +8,16 @@ namespace eosio {
 
 using mongo_db_plugin_impl_ptr = std::shared_ptr<class mongo_db_plugin_impl>;
 
+struct mongo_db_queue_metrics {
+   uint64_t queued_bytes      = 0; ///< estimated size of the queued entries and of those being processed
+   uint32_t queued_entries    = 0;
+   uint64_t peak_queued_bytes = 0;
+   uint64_t throttled         = 0; ///< times nodeos waited for the queue to drain to the low watermark
+   uint64_t throttled_us      = 0; ///< summed time of those waits
+   uint64_t last_latency_us   = 0; ///< queue time of the oldest entry of the last processed batch
+   uint64_t max_latency_us    = 0;
+};
+
 /**
  * Provides persistence to MongoDB for:
  * accounts
@@ -36,9 +46,14 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
+   mongo_db_queue_metrics queue_metrics()const;
+
 private:
    mongo_db_plugin_impl_ptr my;
 };
 
 }
 
+FC_REFLECT( eosio::mongo_db_queue_metrics, (queued_bytes)(queued_entries)(peak_queued_bytes)(throttled)(throttled_us)
+                                           (last_latency_us)(max_latency_us) )
+
@@ -1,10 +1,14 @@
 #include <eosio/mongo_db_plugin/mongo_db_plugin.hpp>
 #include <eosio/mongo_db_plugin/bson.hpp>
+#include <eosio/mongo_db_plugin/abi_bson.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/key_string_cache.hpp>
+#include <eosio/chain/memory_accounting.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
@@ -12,9 +16,11 @@
 #include <fc/variant.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/asio/io_context_strand.hpp>
 #include <boost/chrono.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <condition_variable>
 #include <queue>
 #include <thread>
 #include <mutex>
@@ -69,6 +75,8 @@ public:
    fc::optional<boost::signals2::scoped_connection> irreversible_block_connection;
    fc::optional<boost::signals2::scoped_connection> accepted_transaction_connection;
    fc::optional<boost::signals2::scoped_connection> applied_transaction_connection;
+   /// runs the handlers of the signals above when mongodb-async-signals is set
+   std::shared_ptr<chain::async_signal_consumer>    signal_consumer;
 
    void consume_blocks();
 
@@ -85,12 +93,13 @@ public:
    void process_irreversible_block(const chain::block_state_ptr&);
    void _process_irreversible_block(const chain::block_state_ptr&);
 
-   optional<abi_serializer> get_abi_serializer( account_name n );
+   /// @return the cached serializer, valid until the next call
+   const abi_serializer* get_abi_serializer( account_name n );
    template<typename T> fc::variant to_variant_with_abi( const T& obj );
 
    void purge_abi_cache();
 
-   bool add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
+   bool add_action_trace( std::vector<mongocxx::model::write>& action_traces, const chain::action_trace& atrace,
                           const chain::transaction_trace_ptr& t,
                           bool executed, const std::chrono::milliseconds& now,
                           bool& write_ttrace );
@@ -114,7 +123,34 @@ public:
    void wipe_database();
    void create_expiration_index(mongocxx::collection& collection, uint32_t expire_after_seconds);
 
+   /// an entry of the queues between the main thread and the consume thread
+   template<typename T>
+   struct queued_entry {
+      T              value;
+      uint64_t       size = 0; ///< bytes accounted against the queue watermarks
+      fc::time_point enqueued;
+   };
+
    template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e);
+   /// processes and pops all entries of queue, then releases their bytes
+   template<typename Queue, typename Process> void process_queue(Queue& queue, Process&& process);
+   mongo_db_queue_metrics get_queue_metrics();
+
+   /// bulk writes of one collection, built on the consume thread and executed on the writer_pool
+   struct collection_writer {
+      collection_writer( const std::string& name, bool ordered ) : name( name ), ordered( ordered ) {}
+
+      const std::string                                 name;
+      const bool                                        ordered; ///< writes have to be applied in order
+      std::unique_ptr<boost::asio::io_context::strand>  strand;  ///< serializes the bulk writes of ordered collections
+      std::vector<mongocxx::model::write>               pending; ///< not yet submitted, consume thread only
+      uint32_t                                          in_flight = 0; ///< submitted bulk writes, guarded by writes_mtx
+   };
+
+   void submit_writes( collection_writer& w );
+   void submit_all_writes();
+   void wait_for_writes( collection_writer& w );
+   void wait_for_all_writes();
 
    bool configured{false};
    bool wipe_database_on_startup{false};
@@ -139,28 +175,42 @@ public:
 
    // consum thread
    mongocxx::collection _accounts;
-   mongocxx::collection _trans;
-   mongocxx::collection _trans_traces;
-   mongocxx::collection _action_traces;
    mongocxx::collection _block_states;
    mongocxx::collection _blocks;
    mongocxx::collection _pub_keys;
    mongocxx::collection _account_controls;
 
-   size_t max_queue_size = 0;
-   int queue_sleep_time = 0;
+   // queued bytes include the entries taken by the consume thread until they are processed;
+   // the main thread waits above the high watermark until they drop to the low watermark
+   uint64_t queue_high_watermark = 0;
+   uint64_t queue_low_watermark = 0;
    size_t abi_cache_size = 0;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_process_queue;
-   std::deque<chain::block_state_ptr> block_state_queue;
-   std::deque<chain::block_state_ptr> block_state_process_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_process_queue;
+   std::deque<queued_entry<chain::transaction_metadata_ptr>> transaction_metadata_queue;
+   std::deque<queued_entry<chain::transaction_metadata_ptr>> transaction_metadata_process_queue;
+   std::deque<queued_entry<chain::transaction_trace_ptr>> transaction_trace_queue;
+   std::deque<queued_entry<chain::transaction_trace_ptr>> transaction_trace_process_queue;
+   std::deque<queued_entry<chain::block_state_ptr>> block_state_queue;
+   std::deque<queued_entry<chain::block_state_ptr>> block_state_process_queue;
+   std::deque<queued_entry<chain::block_state_ptr>> irreversible_block_state_queue;
+   std::deque<queued_entry<chain::block_state_ptr>> irreversible_block_state_process_queue;
+   mongo_db_queue_metrics queue_metrics; ///< guarded by mtx
    std::mutex mtx;
    std::condition_variable condition;
+   std::condition_variable space_condition; ///< queued bytes dropped
    std::thread consume_thread;
+
+   // writer threads, the consume thread waits when max_pending_bulk_writes are in flight
+   uint32_t writer_threads = 0;
+   fc::optional<eosio::chain::named_thread_pool> writer_pool;
+   collection_writer blocks_writer{blocks_col, true};
+   collection_writer block_states_writer{block_states_col, true};
+   collection_writer trans_writer{trans_col, true};
+   collection_writer trans_traces_writer{trans_traces_col, false};
+   collection_writer action_traces_writer{action_traces_col, false};
+   uint32_t pending_bulk_writes = 0;
+   std::mutex writes_mtx;
+   std::condition_variable writes_cv;
+   static constexpr uint32_t max_pending_bulk_writes = 16;
    std::atomic_bool done{false};
    std::atomic_bool startup{true};
    fc::optional<chain::chain_id_type> chain_id;
@@ -284,27 +334,90 @@ bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
 }
 
 
+namespace {
+
+uint64_t estimated_size( const chain::transaction_metadata_ptr& t ) {
+   return t->packed_trx()->get_unprunable_size() + t->packed_trx()->get_prunable_size() + sizeof( *t );
+}
+
+uint64_t estimated_size( const chain::transaction_trace_ptr& t ) {
+   uint64_t size = sizeof( *t );
+   for( const auto& at : t->action_traces ) {
+      size += sizeof( at ) + at.act.data.size() + at.console.size() +
+              at.act.authorization.size() * sizeof( chain::permission_level ) +
+              at.account_ram_deltas.size() * sizeof( chain::account_delta );
+   }
+   if( t->failed_dtrx_trace ) size += estimated_size( t->failed_dtrx_trace );
+   return size;
+}
+
+uint64_t estimated_size( const chain::block_state_ptr& bs ) {
+   uint64_t size = sizeof( *bs ) + sizeof( *bs->block );
+   for( const auto& receipt : bs->block->transactions ) {
+      size += sizeof( receipt );
+      if( receipt.trx.contains<packed_transaction>() ) {
+         const auto& pt = receipt.trx.get<packed_transaction>();
+         size += pt.get_unprunable_size() + pt.get_prunable_size();
+      }
+   }
+   return size;
+}
+
+} // anonymous namespace
+
 template<typename Queue, typename Entry>
 void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e ) {
+   const uint64_t size = estimated_size( e );
    std::unique_lock<std::mutex> lock( mtx );
-   auto queue_size = queue.size();
-   if( queue_size > max_queue_size ) {
-      lock.unlock();
+   // an entry larger than the high watermark is still taken when nothing else is queued
+   if( queue_metrics.queued_bytes > 0 && queue_metrics.queued_bytes + size > queue_high_watermark && !done ) {
+      const auto start = fc::time_point::now();
+      ++queue_metrics.throttled;
       condition.notify_one();
-      queue_sleep_time += 10;
-      if( queue_sleep_time > 1000 )
-         wlog("queue size: ${q}", ("q", queue_size));
-      std::this_thread::sleep_for( std::chrono::milliseconds( queue_sleep_time ));
-      lock.lock();
-   } else {
-      queue_sleep_time -= 10;
-      if( queue_sleep_time < 0 ) queue_sleep_time = 0;
+      while( queue_metrics.queued_bytes > queue_low_watermark && !done ) {
+         if( space_condition.wait_for( lock, std::chrono::seconds( 5 ) ) == std::cv_status::timeout ) {
+            wlog( "waiting for mongo_db_plugin queue of ${b} bytes to drain", ("b", queue_metrics.queued_bytes) );
+         }
+      }
+      queue_metrics.throttled_us += (fc::time_point::now() - start).count();
    }
-   queue.emplace_back( e );
+   queue.push_back( {e, size, fc::time_point::now()} );
+   chain::memory_accounting::mongo_db_queues().allocated( size );
+   queue_metrics.queued_bytes += size;
+   ++queue_metrics.queued_entries;
+   queue_metrics.peak_queued_bytes = std::max( queue_metrics.peak_queued_bytes, queue_metrics.queued_bytes );
    lock.unlock();
    condition.notify_one();
 }
 
+template<typename Queue, typename Process>
+void mongo_db_plugin_impl::process_queue( Queue& queue, Process&& process ) {
+   if( queue.empty() ) return;
+   const auto now = fc::time_point::now();
+   const auto latency = now - queue.front().enqueued; // the oldest entry
+   uint64_t bytes = 0;
+   uint32_t entries = 0;
+   while( !queue.empty() ) {
+      process( queue.front().value );
+      bytes += queue.front().size;
+      ++entries;
+      queue.pop_front();
+   }
+
+   chain::memory_accounting::mongo_db_queues().freed( bytes );
+   std::lock_guard<std::mutex> lock( mtx );
+   queue_metrics.queued_bytes -= bytes;
+   queue_metrics.queued_entries -= entries;
+   queue_metrics.last_latency_us = latency.count();
+   queue_metrics.max_latency_us = std::max<uint64_t>( queue_metrics.max_latency_us, latency.count() );
+   space_condition.notify_all();
+}
+
+mongo_db_queue_metrics mongo_db_plugin_impl::get_queue_metrics() {
+   std::lock_guard<std::mutex> lock( mtx );
+   return queue_metrics;
+}
+
 void mongo_db_plugin_impl::accepted_transaction( const chain::transaction_metadata_ptr& t ) {
    try {
       if( store_transactions ) {
@@ -393,9 +506,6 @@ void mongo_db_plugin_impl::consume_blocks() {
       auto& mongo_conn = *mongo_client;
 
       _accounts = mongo_conn[db_name][accounts_col];
-      _trans = mongo_conn[db_name][trans_col];
-      _trans_traces = mongo_conn[db_name][trans_traces_col];
-      _action_traces = mongo_conn[db_name][action_traces_col];
       _blocks = mongo_conn[db_name][blocks_col];
       _block_states = mongo_conn[db_name][block_states_col];
       _pub_keys = mongo_conn[db_name][pub_keys_col];
@@ -442,11 +552,7 @@ void mongo_db_plugin_impl::consume_blocks() {
          // process transactions
          auto start_time = fc::time_point::now();
          auto size = transaction_trace_process_queue.size();
-         while (!transaction_trace_process_queue.empty()) {
-            const auto& t = transaction_trace_process_queue.front();
-            process_applied_transaction(t);
-            transaction_trace_process_queue.pop_front();
-         }
+         process_queue( transaction_trace_process_queue, [this]( const auto& t ) { process_applied_transaction( t ); } );
          auto time = fc::time_point::now() - start_time;
          auto per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
@@ -454,11 +560,7 @@ void mongo_db_plugin_impl::consume_blocks() {
 
          start_time = fc::time_point::now();
          size = transaction_metadata_process_queue.size();
-         while (!transaction_metadata_process_queue.empty()) {
-            const auto& t = transaction_metadata_process_queue.front();
-            process_accepted_transaction(t);
-            transaction_metadata_process_queue.pop_front();
-         }
+         process_queue( transaction_metadata_process_queue, [this]( const auto& t ) { process_accepted_transaction( t ); } );
          time = fc::time_point::now() - start_time;
          per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
@@ -467,29 +569,29 @@ void mongo_db_plugin_impl::consume_blocks() {
          // process blocks
          start_time = fc::time_point::now();
          size = block_state_process_queue.size();
-         while (!block_state_process_queue.empty()) {
-            const auto& bs = block_state_process_queue.front();
-            process_accepted_block( bs );
-            block_state_process_queue.pop_front();
-         }
+         process_queue( block_state_process_queue, [this]( const auto& bs ) { process_accepted_block( bs ); } );
          time = fc::time_point::now() - start_time;
          per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
             ilog( "process_accepted_block,       time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
 
-         // process irreversible blocks
+         submit_all_writes();
+
+         // process irreversible blocks, they look up the blocks written above
          start_time = fc::time_point::now();
          size = irreversible_block_state_process_queue.size();
-         while (!irreversible_block_state_process_queue.empty()) {
-            const auto& bs = irreversible_block_state_process_queue.front();
-            process_irreversible_block(bs);
-            irreversible_block_state_process_queue.pop_front();
+         if( size > 0 ) {
+            wait_for_writes( blocks_writer );
+            wait_for_writes( block_states_writer );
          }
+         process_queue( irreversible_block_state_process_queue, [this]( const auto& bs ) { process_irreversible_block( bs ); } );
          time = fc::time_point::now() - start_time;
          per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
             ilog( "process_irreversible_block,   time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
 
+         submit_all_writes();
+
          if( transaction_metadata_size == 0 &&
              transaction_trace_size == 0 &&
              block_state_size == 0 &&
@@ -498,6 +600,7 @@ void mongo_db_plugin_impl::consume_blocks() {
             break;
          }
       }
+      wait_for_all_writes();
       ilog("mongo_db_plugin consume thread shutdown gracefully");
    } catch (fc::exception& e) {
       elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
@@ -577,6 +680,62 @@ bsoncxx::oid make_custom_oid() {
 
 } // anonymous namespace
 
+void mongo_db_plugin_impl::submit_writes( collection_writer& w ) {
+   if( w.pending.empty() ) return;
+
+   {
+      std::unique_lock<std::mutex> lock( writes_mtx );
+      writes_cv.wait( lock, [this]() { return pending_bulk_writes < max_pending_bulk_writes; } );
+      ++pending_bulk_writes;
+      ++w.in_flight;
+   }
+
+   auto write = [this, &w, writes = std::make_shared<std::vector<mongocxx::model::write>>( std::move( w.pending ) )]() {
+      try {
+         auto client = mongo_pool->acquire();
+         mongocxx::options::bulk_write bulk_opts;
+         bulk_opts.ordered( w.ordered );
+         auto bulk = (*client)[db_name][w.name].create_bulk_write( bulk_opts );
+         for( const auto& op : *writes ) {
+            bulk.append( op );
+         }
+         if( !bulk.execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk ${c} write failed", ("c", w.name) );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( w.name + " bulk write", __LINE__ );
+      }
+      std::lock_guard<std::mutex> lock( writes_mtx );
+      --pending_bulk_writes;
+      --w.in_flight;
+      writes_cv.notify_all();
+   };
+   w.pending.clear();
+
+   if( w.ordered ) {
+      boost::asio::post( *w.strand, std::move( write ) );
+   } else {
+      boost::asio::post( writer_pool->get_executor(), std::move( write ) );
+   }
+}
+
+void mongo_db_plugin_impl::submit_all_writes() {
+   for( auto* w : { &trans_writer, &trans_traces_writer, &action_traces_writer, &block_states_writer, &blocks_writer } ) {
+      submit_writes( *w );
+   }
+}
+
+void mongo_db_plugin_impl::wait_for_writes( collection_writer& w ) {
+   std::unique_lock<std::mutex> lock( writes_mtx );
+   writes_cv.wait( lock, [&w]() { return w.in_flight == 0; } );
+}
+
+void mongo_db_plugin_impl::wait_for_all_writes() {
+   submit_all_writes();
+   std::unique_lock<std::mutex> lock( writes_mtx );
+   writes_cv.wait( lock, [this]() { return pending_bulk_writes == 0; } );
+}
+
 void mongo_db_plugin_impl::purge_abi_cache() {
    if( abi_cache_index.size() < abi_cache_size ) return;
 
@@ -588,7 +747,7 @@ void mongo_db_plugin_impl::purge_abi_cache() {
    }
 }
 
-optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name n ) {
+const abi_serializer* mongo_db_plugin_impl::get_abi_serializer( account_name n ) {
    using bsoncxx::builder::basic::kvp;
    using bsoncxx::builder::basic::make_document;
    if( n.good()) {
@@ -600,7 +759,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                entry.last_accessed = fc::time_point::now();
             });
 
-            return itr->serializer;
+            return itr->serializer ? &*itr->serializer : nullptr;
          }
 
          auto account = _accounts.find_one( make_document( kvp("name", n.to_string())) );
@@ -612,7 +771,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                   abi = from_bson( view["abi"].get_document() ).as<abi_def>();
                } catch (...) {
                   ilog( "Unable to convert account abi to abi_def for ${n}", ( "n", n ));
-                  return optional<abi_serializer>();
+                  return nullptr;
                }
 
                purge_abi_cache(); // make room if necessary
@@ -662,13 +821,13 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                }
                abis.set_abi( abi, abi_serializer_max_time );
                entry.serializer.emplace( std::move( abis ) );
-               abi_cache_index.insert( entry );
-               return entry.serializer;
+               auto inserted = abi_cache_index.emplace( std::move( entry ) ).first;
+               return &*inserted->serializer;
             }
          }
       } FC_CAPTURE_AND_LOG((n))
    }
-   return optional<abi_serializer>();
+   return nullptr;
 }
 
 template<typename T>
@@ -771,12 +930,12 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
    fc::variant signing_keys;
    const flat_set<public_key_type>& keys = t->recovered_keys();
    if( !keys.empty() ) {
-      signing_keys = keys;
+      signing_keys = chain::key_string_cache::instance().to_variants( keys );
    } else {
       flat_set<public_key_type> pub_keys;
       trx.get_signature_keys( *chain_id, fc::time_point::maximum(), pub_keys, false );
       if( !pub_keys.empty() ) {
-         signing_keys = pub_keys;
+         signing_keys = chain::key_string_cache::instance().to_variants( pub_keys );
       }
    }
 
@@ -799,21 +958,14 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 
    trans_doc.append( kvp( "createdAt", b_date{now} ) );
 
-   try {
-      mongocxx::options::update update_opts{};
-      update_opts.upsert( true );
-      if( !_trans.update_one( make_document( kvp( "trx_id", trx_id_str ) ),
-                              make_document( kvp( "$set", trans_doc.view() ) ), update_opts ) ) {
-         EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", trx_id) );
-      }
-   } catch( ... ) {
-      handle_mongo_exception( "trans insert", __LINE__ );
-   }
-
+   mongocxx::model::update_one update_op{make_document( kvp( "trx_id", trx_id_str ) ),
+                                         make_document( kvp( "$set", trans_doc.extract() ) )};
+   update_op.upsert( true );
+   trans_writer.pending.emplace_back( std::move( update_op ) );
 }
 
 bool
-mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
+mongo_db_plugin_impl::add_action_trace( std::vector<mongocxx::model::write>& action_traces, const chain::action_trace& atrace,
                                         const chain::transaction_trace_ptr& t,
                                         bool executed, const std::chrono::milliseconds& now,
                                         bool& write_ttrace )
@@ -834,12 +986,15 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
       // improve data distributivity when using mongodb sharding
       action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
 
-      auto v = to_variant_with_abi( atrace );
       try {
-         action_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
+         bsoncxx::builder::core trace_doc( false );
+         append_action_trace( atrace, [&]( account_name n ) { return get_abi_serializer( n ); },
+                              abi_serializer_max_time, trace_doc );
+         action_traces_doc.append( bsoncxx::builder::concatenate_doc{trace_doc.view_document()} );
       } catch( bsoncxx::exception& e ) {
          elog( "Unable to convert action trace to BSON: ${e}", ("e", e.what()) );
          try {
+            auto v = to_variant_with_abi( atrace );
             elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
          } catch(...) {}
       }
@@ -848,8 +1003,7 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
       }
       action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
 
-      mongocxx::model::insert_one insert_op{action_traces_doc.view()};
-      bulk_action_traces.append( insert_op );
+      action_traces.emplace_back( mongocxx::model::insert_one{action_traces_doc.extract()} );
       added = true;
    }
 
@@ -866,16 +1020,14 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-   mongocxx::options::bulk_write bulk_opts;
-   bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_action_traces = _action_traces.create_bulk_write(bulk_opts);
+   std::vector<mongocxx::model::write> action_traces;
    bool write_atraces = false;
    bool write_ttrace = false; // filters apply to transaction_traces as well
    bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
 
    for( const auto& atrace : t->action_traces ) {
       try {
-         write_atraces |= add_action_trace( bulk_action_traces, atrace, t, executed, now, write_ttrace );
+         write_atraces |= add_action_trace( action_traces, atrace, t, executed, now, write_ttrace );
       } catch(...) {
          handle_mongo_exception("add action traces", __LINE__);
       }
@@ -898,13 +1050,7 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
          }
          trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
 
-         try {
-            if( !_trans_traces.insert_one( trans_traces_doc.view() ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", t->id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "trans_traces insert: " + t->id.str(), __LINE__ );
-         }
+         trans_traces_writer.pending.emplace_back( mongocxx::model::insert_one{trans_traces_doc.extract()} );
       } catch( ... ) {
          handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
@@ -912,14 +1058,9 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
 
    // insert action_traces
    if( write_atraces ) {
-      try {
-         if( !bulk_action_traces.execute() ) {
-            EOS_ASSERT( false, chain::mongo_db_insert_fail,
-                        "Bulk action traces insert failed for transaction trace: ${id}", ("id", t->id) );
-         }
-      } catch( ... ) {
-         handle_mongo_exception( "action traces insert", __LINE__ );
-      }
+      auto& pending = action_traces_writer.pending;
+      pending.insert( pending.end(), std::make_move_iterator( action_traces.begin() ),
+                      std::make_move_iterator( action_traces.end() ) );
    }
 
 }
@@ -930,9 +1071,6 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
    using bsoncxx::builder::basic::kvp;
    using bsoncxx::builder::basic::make_document;
 
-   mongocxx::options::update update_opts{};
-   update_opts.upsert( true );
-
    auto block_num = bs->block_num;
    if( block_num % 1000 == 0 )
       ilog( "block_num: ${b}", ("b", block_num) );
@@ -942,6 +1080,14 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
+   auto upsert = [&]( collection_writer& w, bsoncxx::document::value doc ) {
+      auto filter = update_blocks_via_block_num ? make_document( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ) )
+                                                : make_document( kvp( "block_id", block_id_str ) );
+      mongocxx::model::update_one update_op{std::move( filter ), make_document( kvp( "$set", std::move( doc ) ) )};
+      update_op.upsert( true );
+      w.pending.emplace_back( std::move( update_op ) );
+   };
+
    if( store_block_states ) {
       auto block_state_doc = bsoncxx::builder::basic::document{};
       block_state_doc.append( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ),
@@ -960,21 +1106,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
       }
       block_state_doc.append( kvp( "createdAt", b_date{now} ) );
 
-      try {
-         if( update_blocks_via_block_num ) {
-            if( !_block_states.update_one( make_document( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ) ),
-                                           make_document( kvp( "$set", block_state_doc.view() ) ), update_opts ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert block_state ${num}", ("num", block_num) );
-            }
-         } else {
-            if( !_block_states.update_one( make_document( kvp( "block_id", block_id_str ) ),
-                                           make_document( kvp( "$set", block_state_doc.view() ) ), update_opts ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert block_state ${bid}", ("bid", block_id) );
-            }
-         }
-      } catch( ... ) {
-         handle_mongo_exception( "block_states insert: " + block_id_str, __LINE__ );
-      }
+      upsert( block_states_writer, block_state_doc.extract() );
    }
 
    if( store_blocks ) {
@@ -993,21 +1125,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
       }
       block_doc.append( kvp( "createdAt", b_date{now} ) );
 
-      try {
-         if( update_blocks_via_block_num ) {
-            if( !_blocks.update_one( make_document( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ) ),
-                                     make_document( kvp( "$set", block_doc.view() ) ), update_opts ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert block ${num}", ("num", block_num) );
-            }
-         } else {
-            if( !_blocks.update_one( make_document( kvp( "block_id", block_id_str ) ),
-                                     make_document( kvp( "$set", block_doc.view() ) ), update_opts ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert block ${bid}", ("bid", block_id) );
-            }
-         }
-      } catch( ... ) {
-         handle_mongo_exception( "blocks insert: " + block_id_str, __LINE__ );
-      }
+      upsert( blocks_writer, block_doc.extract() );
    }
 }
 
@@ -1025,40 +1143,34 @@ void mongo_db_plugin_impl::_process_irreversible_block(const chain::block_state_
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-   if( store_blocks ) {
-      auto ir_block = find_block( _blocks, block_id_str );
+   // consume_blocks waits for the accepted blocks to be written before irreversible blocks are processed
+   auto mark_irreversible = [&]( collection_writer& w, mongocxx::collection& collection ) {
+      auto ir_block = find_block( collection, block_id_str );
       if( !ir_block ) {
          _process_accepted_block( bs );
-         ir_block = find_block( _blocks, block_id_str );
+         submit_writes( w );
+         wait_for_writes( w );
+         ir_block = find_block( collection, block_id_str );
          if( !ir_block ) return; // should never happen
       }
 
       auto update_doc = make_document( kvp( "$set", make_document( kvp( "irreversible", b_bool{true} ),
                                                                    kvp( "updatedAt", b_date{now} ) ) ) );
 
-      _blocks.update_one( make_document( kvp( "_id", ir_block->view()["_id"].get_oid() ) ), update_doc.view() );
+      w.pending.emplace_back( mongocxx::model::update_one{make_document( kvp( "_id", ir_block->view()["_id"].get_oid() ) ),
+                                                          std::move( update_doc )} );
+   };
+
+   if( store_blocks ) {
+      mark_irreversible( blocks_writer, _blocks );
    }
 
    if( store_block_states ) {
-      auto ir_block = find_block( _block_states, block_id_str );
-      if( !ir_block ) {
-         _process_accepted_block( bs );
-         ir_block = find_block( _block_states, block_id_str );
-         if( !ir_block ) return; // should never happen
-      }
-
-      auto update_doc = make_document( kvp( "$set", make_document( kvp( "irreversible", b_bool{true} ),
-                                                                   kvp( "updatedAt", b_date{now} ) ) ) );
-
-      _block_states.update_one( make_document( kvp( "_id", ir_block->view()["_id"].get_oid() ) ), update_doc.view() );
+      mark_irreversible( block_states_writer, _block_states );
    }
 
    if( store_transactions ) {
       const auto block_num = bs->block->block_num();
-      bool transactions_in_block = false;
-      mongocxx::options::bulk_write bulk_opts;
-      bulk_opts.ordered( false );
-      auto bulk = _trans.create_bulk_write( bulk_opts );
 
       for( const auto& receipt : bs->block->transactions ) {
          string trx_id_str;
@@ -1077,20 +1189,9 @@ void mongo_db_plugin_impl::_process_irreversible_block(const chain::block_state_
                                                                       kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ),
                                                                       kvp( "updatedAt", b_date{now} ) ) ) );
 
-         mongocxx::model::update_one update_op{make_document( kvp( "trx_id", trx_id_str ) ), update_doc.view()};
+         mongocxx::model::update_one update_op{make_document( kvp( "trx_id", trx_id_str ) ), std::move( update_doc )};
          update_op.upsert( false );
-         bulk.append( update_op );
-         transactions_in_block = true;
-      }
-
-      if( transactions_in_block ) {
-         try {
-            if( !bulk.execute() ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk transaction insert failed for block: ${bid}", ("bid", block_id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "bulk transaction insert", __LINE__ );
-         }
+         trans_writer.pending.emplace_back( std::move( update_op ) );
       }
    }
 }
@@ -1110,7 +1211,7 @@ void mongo_db_plugin_impl::add_pub_keys( const vector<chain::key_weight>& keys,
       auto find_doc = bsoncxx::builder::basic::document();
 
       find_doc.append( kvp( "account", name.to_string()),
-                       kvp( "public_key", pub_key_weight.key.operator string()),
+                       kvp( "public_key", chain::key_string_cache::instance().to_string( pub_key_weight.key )),
                        kvp( "permission", permission.to_string()) );
 
       auto update_doc = make_document( kvp( "$set", make_document( bsoncxx::builder::concatenate_doc{find_doc.view()},
@@ -1320,9 +1421,11 @@ mongo_db_plugin_impl::~mongo_db_plugin_impl() {
          ilog( "mongo_db_plugin shutdown in process please be patient this can take a few minutes" );
          done = true;
          condition.notify_one();
+         space_condition.notify_all();
 
          consume_thread.join();
 
+         writer_pool.reset();
          mongo_pool.reset();
       } catch( std::exception& e ) {
          elog( "Exception on mongo_db_plugin shutdown of consume thread: ${e}", ("e", e.what()));
@@ -1485,6 +1588,11 @@ void mongo_db_plugin_impl::init() {
 
    ilog("starting db plugin thread");
 
+   writer_pool.emplace( "mongow", writer_threads );
+   for( auto* w : { &blocks_writer, &block_states_writer, &trans_writer, &trans_traces_writer, &action_traces_writer } ) {
+      w->strand = std::make_unique<boost::asio::io_context::strand>( writer_pool->get_executor() );
+   }
+
    consume_thread = std::thread( [this] {
       fc::set_os_thread_name( "mongodb" );
       consume_blocks();
@@ -1506,13 +1614,25 @@ mongo_db_plugin::~mongo_db_plugin()
 {
 }
 
+mongo_db_queue_metrics mongo_db_plugin::queue_metrics()const {
+   return my->get_queue_metrics();
+}
+
 void mongo_db_plugin::set_program_options(options_description& cli, options_description& cfg)
 {
    cfg.add_options()
-         ("mongodb-queue-size,q", bpo::value<uint32_t>()->default_value(1024),
-         "The target queue size between nodeos and MongoDB plugin thread.")
+         ("mongodb-queue-size,q", bpo::value<uint32_t>(),
+         "Deprecated and ignored, the queue is bounded by mongodb-queue-high-watermark-mb.")
+         ("mongodb-queue-high-watermark-mb", bpo::value<uint64_t>()->default_value(512),
+          "Estimated size in MiB of the blocks, transactions and traces queued between nodeos and the MongoDB plugin "
+          "thread at which nodeos waits for the queue to drain.")
+         ("mongodb-queue-low-watermark-mb", bpo::value<uint64_t>()->default_value(384),
+          "Estimated queue size in MiB at which nodeos continues after waiting.")
          ("mongodb-abi-cache-size", bpo::value<uint32_t>()->default_value(2048),
           "The maximum size of the abi cache for serializing data.")
+         ("mongodb-writer-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of threads writing to MongoDB. Each collection is written in order, different collections and "
+          "the traces of a collection in parallel.")
          ("mongodb-wipe", bpo::bool_switch()->default_value(false),
          "Required with --replay-blockchain, --hard-replay-blockchain, or --delete-all-blocks to wipe mongo db."
          "This option required to prevent accidental wipe of mongo db.")
@@ -1536,6 +1656,11 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
           "Enables storing action traces in mongodb.")
          ("mongodb-expire-after-seconds", bpo::value<uint32_t>()->default_value(0),
           "Enables expiring data in mongodb after a specified number of seconds.")
+         ("mongodb-async-signals", bpo::bool_switch()->default_value(false),
+          "Queue blocks, transactions and traces on a thread of the plugin instead of the thread applying blocks, "
+          "whose wait on a full queue then only happens once mongodb-async-signals-queue-size signals are pending.")
+         ("mongodb-async-signals-queue-size", bpo::value<uint32_t>()->default_value(1024),
+          "Signals waiting for the plugin thread when mongodb-async-signals is set.")
          ("mongodb-filter-on", bpo::value<vector<string>>()->composing(),
           "Track actions which match receiver:action:actor. Receiver, Action, & Actor may be blank to include all. i.e. eosio:: or :transfer:  Use * or leave unspecified to include all.")
          ("mongodb-filter-out", bpo::value<vector<string>>()->composing(),
@@ -1566,12 +1691,18 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          my->abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
 
          if( options.count( "mongodb-queue-size" )) {
-            my->max_queue_size = options.at( "mongodb-queue-size" ).as<uint32_t>();
+            wlog( "mongodb-queue-size is ignored, use mongodb-queue-high-watermark-mb and mongodb-queue-low-watermark-mb" );
          }
+         my->queue_high_watermark = options.at( "mongodb-queue-high-watermark-mb" ).as<uint64_t>() * 1024 * 1024;
+         my->queue_low_watermark = options.at( "mongodb-queue-low-watermark-mb" ).as<uint64_t>() * 1024 * 1024;
+         EOS_ASSERT( my->queue_low_watermark < my->queue_high_watermark, chain::plugin_config_exception,
+                     "mongodb-queue-low-watermark-mb < mongodb-queue-high-watermark-mb required" );
          if( options.count( "mongodb-abi-cache-size" )) {
             my->abi_cache_size = options.at( "mongodb-abi-cache-size" ).as<uint32_t>();
             EOS_ASSERT( my->abi_cache_size > 0, chain::plugin_config_exception, "mongodb-abi-cache-size > 0 required" );
          }
+         my->writer_threads = options.at( "mongodb-writer-threads" ).as<uint32_t>();
+         EOS_ASSERT( my->writer_threads > 0, chain::plugin_config_exception, "mongodb-writer-threads > 0 required" );
          if( options.count( "mongodb-block-start" )) {
             my->start_block_num = options.at( "mongodb-block-start" ).as<uint32_t>();
          }
@@ -1646,21 +1777,39 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          auto& chain = chain_plug->chain();
          my->chain_id.emplace( chain.get_chain_id());
 
-         my->accepted_block_connection.emplace( chain.accepted_block.connect( [&]( const chain::block_state_ptr& bs ) {
-            my->accepted_block( bs );
-         } ));
-         my->irreversible_block_connection.emplace(
-               chain.irreversible_block.connect( [&]( const chain::block_state_ptr& bs ) {
-                  my->applied_irreversible_block( bs );
-               } ));
-         my->accepted_transaction_connection.emplace(
-               chain.accepted_transaction.connect( [&]( const chain::transaction_metadata_ptr& t ) {
-                  my->accepted_transaction( t );
-               } ));
-         my->applied_transaction_connection.emplace(
-               chain.applied_transaction.connect( [&]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
-                  my->applied_transaction( std::get<0>(t) );
-               } ));
+         if( options.at( "mongodb-async-signals" ).as<bool>() ) {
+            auto& c = *( my->signal_consumer = chain.make_async_signal_consumer(
+                  "mongos", options.at( "mongodb-async-signals-queue-size" ).as<uint32_t>() ) );
+            c.connect<chain::block_state_ptr>( chain.accepted_block, [&]( const chain::block_state_ptr& bs ) {
+               my->accepted_block( bs );
+            } );
+            c.connect<chain::block_state_ptr>( chain.irreversible_block, [&]( const chain::block_state_ptr& bs ) {
+               my->applied_irreversible_block( bs );
+            } );
+            c.connect<chain::transaction_metadata_ptr>( chain.accepted_transaction, [&]( const chain::transaction_metadata_ptr& t ) {
+               my->accepted_transaction( t );
+            } );
+            // only the trace is used, the signed_transaction is not copied
+            c.connect<chain::transaction_trace_ptr>( chain.applied_transaction,
+                  []( const auto& t ) { return std::get<0>(t); },
+                  [&]( const chain::transaction_trace_ptr& t ) { my->applied_transaction( t ); } );
+         } else {
+            my->accepted_block_connection.emplace( chain.accepted_block.connect( [&]( const chain::block_state_ptr& bs ) {
+               my->accepted_block( bs );
+            } ));
+            my->irreversible_block_connection.emplace(
+                  chain.irreversible_block.connect( [&]( const chain::block_state_ptr& bs ) {
+                     my->applied_irreversible_block( bs );
+                  } ));
+            my->accepted_transaction_connection.emplace(
+                  chain.accepted_transaction.connect( [&]( const chain::transaction_metadata_ptr& t ) {
+                     my->accepted_transaction( t );
+                  } ));
+            my->applied_transaction_connection.emplace(
+                  chain.applied_transaction.connect( [&]( std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t ) {
+                     my->applied_transaction( std::get<0>(t) );
+                  } ));
+         }
 
          if( my->wipe_database_on_startup ) {
             my->wipe_database();
@@ -1683,6 +1832,7 @@ void mongo_db_plugin::plugin_shutdown()
    my->irreversible_block_connection.reset();
    my->accepted_transaction_connection.reset();
    my->applied_transaction_connection.reset();
+   my->signal_consumer.reset();
 
    my.reset();
 }
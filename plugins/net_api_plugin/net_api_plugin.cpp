@@ -6,6 +6,7 @@
 #include <fc/io/json.hpp>
 
 #include <chrono>
+#include <sstream>
 
 namespace eosio { namespace detail {
   struct net_api_plugin_empty {};
@@ -54,6 +55,74 @@ using namespace eosio;
      api_handle.call_name(); \
      eosio::detail::net_api_plugin_empty result;
 
+namespace {
+
+string prometheus_label( const string& value ) {
+   string escaped;
+   escaped.reserve( value.size() );
+   for( char c : value ) {
+      if( c == '\\' || c == '"' ) escaped += '\\';
+      if( c == '\n' ) {
+         escaped += "\\n";
+         continue;
+      }
+      escaped += c;
+   }
+   return escaped;
+}
+
+/// net_plugin metrics in the Prometheus text exposition format, one sample per peer and message type
+string prometheus_metrics( const vector<connection_metrics>& metrics ) {
+   std::ostringstream out;
+   auto peer_metric = [&]( const char* name, const char* type, const char* help, auto get ) {
+      out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+      for( const auto& m : metrics ) {
+         out << name << "{peer=\"" << prometheus_label( m.peer ) << "\",connection_id=\"" << m.connection_id << "\"} "
+             << get( m ) << "\n";
+      }
+   };
+   auto message_metric = [&]( const char* name, const char* help, auto get ) {
+      out << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n";
+      for( const auto& m : metrics ) {
+         for( const auto& mt : m.messages ) {
+            out << name << "{peer=\"" << prometheus_label( m.peer ) << "\",connection_id=\"" << m.connection_id
+                << "\",type=\"" << mt.type << "\"} " << get( mt ) << "\n";
+         }
+      }
+   };
+
+   peer_metric( "nodeos_p2p_connected", "gauge", "1 if the handshake with the peer completed",
+                []( const connection_metrics& m ) { return m.connected ? 1 : 0; } );
+   peer_metric( "nodeos_p2p_write_queue_bytes", "gauge", "bytes queued for sending to the peer",
+                []( const connection_metrics& m ) { return m.write_queue_bytes; } );
+   peer_metric( "nodeos_p2p_messages_dropped_total", "counter", "received blocks and transactions dropped",
+                []( const connection_metrics& m ) { return m.messages_dropped; } );
+   peer_metric( "nodeos_p2p_handshake_rtt_microseconds", "gauge", "handshake round trip time, -1 if unknown",
+                []( const connection_metrics& m ) { return m.handshake_rtt_us; } );
+   peer_metric( "nodeos_p2p_blocks_relayed_total", "counter", "blocks received from the peer and relayed",
+                []( const connection_metrics& m ) { return m.blocks_relayed; } );
+   peer_metric( "nodeos_p2p_block_relay_microseconds_total", "counter", "summed time from block receipt to relay",
+                []( const connection_metrics& m ) { return m.block_relay_us_total; } );
+   peer_metric( "nodeos_p2p_block_relay_microseconds_max", "gauge", "longest time from block receipt to relay",
+                []( const connection_metrics& m ) { return m.block_relay_us_max; } );
+   peer_metric( "nodeos_p2p_rtt_microseconds", "gauge", "average time_message round trip, 0 until measured",
+                []( const connection_metrics& m ) { return m.rtt_us; } );
+   peer_metric( "nodeos_p2p_sync_block_interval_microseconds", "gauge", "average time between sync blocks delivered",
+                []( const connection_metrics& m ) { return m.block_interval_us; } );
+   peer_metric( "nodeos_p2p_peer_score", "gauge", "cost used to rank peers for sync and fetch, lower is preferred",
+                []( const connection_metrics& m ) { return m.score; } );
+   message_metric( "nodeos_p2p_messages_received_total", "messages received by type",
+                   []( const message_type_metrics& mt ) { return mt.messages_in; } );
+   message_metric( "nodeos_p2p_bytes_received_total", "bytes received by message type",
+                   []( const message_type_metrics& mt ) { return mt.bytes_in; } );
+   message_metric( "nodeos_p2p_messages_sent_total", "messages queued for sending by type",
+                   []( const message_type_metrics& mt ) { return mt.messages_out; } );
+   message_metric( "nodeos_p2p_bytes_sent_total", "bytes queued for sending by message type",
+                   []( const message_type_metrics& mt ) { return mt.bytes_out; } );
+   return out.str();
+}
+
+} // anonymous namespace
 
 void net_api_plugin::plugin_startup() {
    ilog("starting net_api_plugin");
@@ -73,9 +142,26 @@ void net_api_plugin::plugin_startup() {
             INVOKE_R_R(net_mgr, status, std::string), 201),
        CALL(net, net_mgr, connections,
             INVOKE_R_V(net_mgr, connections), 201),
+       CALL(net, net_mgr, metrics,
+            INVOKE_R_V(net_mgr, metrics), 201),
+       CALL(net, net_mgr, propagation,
+            INVOKE_R_V(net_mgr, propagation), 201),
+       CALL(net, net_mgr, fetch_snapshot,
+            INVOKE_R_R(net_mgr, fetch_snapshot, snapshot_fetch_params), 201),
+       CALL(net, net_mgr, snapshot_status,
+            INVOKE_R_V(net_mgr, snapshot_status), 201),
     //   CALL(net, net_mgr, open,
     //        INVOKE_V_R(net_mgr, open, std::string), 200),
    });
+
+   app().get_plugin<http_plugin>().add_plain_text_handler( "/v1/net/prometheus_metrics",
+      [&net_mgr](string, string body, url_response_callback cb) mutable {
+         try {
+            cb( 200, fc::variant( prometheus_metrics( net_mgr.metrics() ) ) );
+         } catch (...) {
+            http_plugin::handle_exception( "net", "prometheus_metrics", body, cb );
+         }
+      });
 }
 
 void net_api_plugin::plugin_initialize(const variables_map& options) {
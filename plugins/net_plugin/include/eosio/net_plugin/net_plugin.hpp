@@ -6,11 +6,93 @@
 namespace eosio {
    using namespace appbase;
 
+   struct compression_stats {
+      uint64_t          uncompressed_bytes = 0;
+      uint64_t          compressed_bytes   = 0;
+      double            ratio              = 0; ///< compressed_bytes / uncompressed_bytes
+      uint64_t          cpu_time_us        = 0;
+   };
+
    struct connection_status {
       string            peer;
       bool              connecting = false;
       bool              syncing    = false;
       handshake_message last_handshake;
+      bool              compression = false; ///< peer accepts compressed_message
+      compression_stats sent;     ///< messages compressed for this peer
+      compression_stats received; ///< compressed messages received from this peer
+   };
+
+   struct message_type_metrics {
+      string            type;
+      uint64_t          messages_in  = 0;
+      uint64_t          bytes_in     = 0;
+      uint64_t          messages_out = 0; ///< queued for sending
+      uint64_t          bytes_out    = 0;
+   };
+
+   struct connection_metrics {
+      string            peer;
+      uint32_t          connection_id = 0;
+      bool              connected = false;
+      uint64_t          write_queue_bytes = 0;
+      uint64_t          messages_dropped  = 0; ///< received blocks and transactions dropped as known, unexpected or over limit
+      int64_t           handshake_rtt_us  = -1; ///< from sending our first handshake to receiving the peer's, -1 until known
+      uint64_t          blocks_relayed    = 0; ///< blocks received from this peer and accepted for relaying to the others
+      uint64_t          block_relay_us_total = 0; ///< summed time from receipt to relay of blocks_relayed
+      uint64_t          block_relay_us_max   = 0;
+      int64_t           rtt_us            = 0; ///< average time_message round trip, 0 until measured
+      int64_t           block_interval_us = 0; ///< average time between sync blocks delivered, 0 until measured
+      int64_t           score             = 0; ///< cost used to rank peers for sync and fetch, lower is preferred
+      vector<message_type_metrics> messages; ///< by net_message type, types never sent nor received omitted
+   };
+
+   struct snapshot_fetch_params {
+      optional<block_id_type> head_block_id; ///< snapshot to fetch, the one offered by the most peers if not given
+   };
+
+   struct snapshot_fetch_status {
+      string                  state; ///< idle, listing, downloading, verifying, complete or failed
+      optional<block_id_type> head_block_id;
+      uint64_t                size = 0;
+      uint32_t                chunks = 0;
+      uint32_t                chunks_received = 0;
+      uint32_t                peers = 0;  ///< peers serving the chosen snapshot
+      string                  path;       ///< the verified snapshot once complete, to start nodeos with --snapshot
+      string                  error;
+   };
+
+   struct block_first_seen {
+      uint32_t          block_num = 0;
+      block_id_type     id;
+      account_name      producer;
+      fc::time_point    first_seen;
+      int64_t           latency_us = 0; ///< from the block timestamp, negative when received before it
+      string            peer;           ///< that delivered it first
+   };
+
+   struct producer_propagation_histogram {
+      account_name      producer;
+      uint64_t          blocks = 0;
+      int64_t           latency_us_total = 0;
+      int64_t           latency_us_min = 0;
+      int64_t           latency_us_max = 0;
+      vector<uint64_t>  buckets; ///< blocks by latency, bucket i up to bucket_bounds_ms[i], the last one above them all
+   };
+
+   struct peer_block_deliveries {
+      string            peer;
+      uint64_t          blocks_first = 0; ///< blocks this peer delivered before any other
+      uint64_t          blocks_later = 0; ///< blocks this peer delivered after another one did
+      uint64_t          lag_us_total = 0; ///< summed delay of blocks_later behind the first delivery
+      uint64_t          lag_us_max   = 0;
+   };
+
+   struct block_propagation_stats {
+      vector<int64_t>                         bucket_bounds_ms;
+      vector<producer_propagation_histogram>  producers;
+      vector<peer_block_deliveries>           peers;
+      vector<block_first_seen>                recent; ///< most recent first
    };
 
    class net_plugin : public appbase::plugin<net_plugin>
@@ -31,6 +113,10 @@ namespace eosio {
         string                       disconnect( const string& endpoint );
         optional<connection_status>  status( const string& endpoint )const;
         vector<connection_status>    connections()const;
+        vector<connection_metrics>   metrics()const;
+        block_propagation_stats      propagation()const;
+        snapshot_fetch_status        fetch_snapshot( const snapshot_fetch_params& params );
+        snapshot_fetch_status        snapshot_status()const;
 
       private:
         std::shared_ptr<class net_plugin_impl> my;
@@ -38,4 +124,14 @@ namespace eosio {
 
 }
 
-FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::compression_stats, (uncompressed_bytes)(compressed_bytes)(ratio)(cpu_time_us) )
+FC_REFLECT( eosio::snapshot_fetch_params, (head_block_id) )
+FC_REFLECT( eosio::snapshot_fetch_status, (state)(head_block_id)(size)(chunks)(chunks_received)(peers)(path)(error) )
+FC_REFLECT( eosio::message_type_metrics, (type)(messages_in)(bytes_in)(messages_out)(bytes_out) )
+FC_REFLECT( eosio::connection_metrics, (peer)(connection_id)(connected)(write_queue_bytes)(messages_dropped)(handshake_rtt_us)
+                                       (blocks_relayed)(block_relay_us_total)(block_relay_us_max)(rtt_us)(block_interval_us)(score)(messages) )
+FC_REFLECT( eosio::block_first_seen, (block_num)(id)(producer)(first_seen)(latency_us)(peer) )
+FC_REFLECT( eosio::producer_propagation_histogram, (producer)(blocks)(latency_us_total)(latency_us_min)(latency_us_max)(buckets) )
+FC_REFLECT( eosio::peer_block_deliveries, (peer)(blocks_first)(blocks_later)(lag_us_total)(lag_us_max) )
+FC_REFLECT( eosio::block_propagation_stats, (bucket_bounds_ms)(producers)(peers)(recent) )
+FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake)(compression)(sent)(received) )
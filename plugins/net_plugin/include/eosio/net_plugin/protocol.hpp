@@ -128,6 +128,100 @@ namespace eosio {
       uint32_t end_block;
    };
 
+   /**
+    * The which and payload of a signed_block, packed_transaction or packed_transactions_message net_message, zlib
+    * compressed.
+    * Only sent to peers advertising the compressed_messages protocol version in the network_version
+    * of their handshake_message.
+    */
+   struct compressed_message {
+      vector<char> data;
+   };
+
+   /**
+    * A signed_block whose receipts listed in elided carry the id of their packed_transaction instead of the
+    * transaction, as the receiving peer is known to have those transactions. Only sent to peers advertising
+    * the compact_blocks protocol version in the network_version of their handshake_message.
+    */
+   struct compact_block_message {
+      signed_block      block;
+      vector<uint32_t>  elided; ///< indices into block.transactions, ascending
+   };
+
+   /// requests the transactions of a compact_block_message that the receiver could not find locally
+   struct block_trxs_request_message {
+      block_id_type     block_id;
+      vector<uint32_t>  indices; ///< indices into the transactions of the block
+   };
+
+   /// answers a block_trxs_request_message, trxs are in the order of the requested indices, empty if the block is unknown
+   struct block_trxs_message {
+      block_id_type               block_id;
+      vector<packed_transaction>  trxs;
+   };
+
+   /**
+    * Requests the headers of blocks start_block to end_block, used to verify the chain of block headers before
+    * downloading the blocks. Only sent to peers advertising the header_sync protocol version.
+    */
+   struct block_headers_request_message {
+      uint32_t start_block = 0;
+      uint32_t end_block   = 0;
+   };
+
+   /// answers a block_headers_request_message, consecutive headers from start_block, fewer if the sender has less
+   struct block_headers_message {
+      vector<signed_block_header> headers;
+   };
+
+   /**
+    * Asks for the snapshots the peer serves, answered with a snapshot_list_message. The snapshot messages are
+    * only sent to peers advertising the snapshot_transfer protocol version.
+    */
+   struct snapshot_list_request_message {
+   };
+
+   struct snapshot_description {
+      block_id_type     head_block_id;
+      uint64_t          size = 0;       ///< bytes of the snapshot file
+      uint32_t          chunk_size = 0; ///< bytes of each snapshot_chunk_message but the last
+      fc::sha256        manifest_digest; ///< sha256 of the packed chunk hashes of the snapshot_manifest_message
+   };
+
+   struct snapshot_list_message {
+      vector<snapshot_description> snapshots;
+   };
+
+   struct snapshot_manifest_request_message {
+      block_id_type     head_block_id;
+   };
+
+   /// chunk_hashes holds the sha256 of every chunk of the snapshot, empty if the snapshot is not served
+   struct snapshot_manifest_message {
+      snapshot_description snapshot;
+      vector<fc::sha256>   chunk_hashes;
+   };
+
+   struct snapshot_chunk_request_message {
+      block_id_type     head_block_id;
+      uint32_t          chunk = 0;
+   };
+
+   /// data is empty if the snapshot or chunk is not served
+   struct snapshot_chunk_message {
+      block_id_type     head_block_id;
+      uint32_t          chunk = 0;
+      vector<char>      data;
+   };
+
+   /**
+    * Relayed transactions sent together, each one handled as if it came in its own packed_transaction net_message.
+    * Only sent to peers advertising the trx_batches protocol version.
+    */
+   struct packed_transactions_message {
+      vector<packed_transaction> trxs;
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -136,7 +230,20 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      compressed_message,   // which = 9
+                                      compact_block_message,
+                                      block_trxs_request_message,
+                                      block_trxs_message,
+                                      block_headers_request_message,
+                                      block_headers_message,
+                                      snapshot_list_request_message,
+                                      snapshot_list_message,
+                                      snapshot_manifest_request_message,
+                                      snapshot_manifest_message,
+                                      snapshot_chunk_request_message,
+                                      snapshot_chunk_message,
+                                      packed_transactions_message>;
 
 } // namespace eosio
 
@@ -155,6 +262,20 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::compressed_message, (data) )
+FC_REFLECT( eosio::compact_block_message, (block)(elided) )
+FC_REFLECT( eosio::block_trxs_request_message, (block_id)(indices) )
+FC_REFLECT( eosio::block_trxs_message, (block_id)(trxs) )
+FC_REFLECT( eosio::block_headers_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::block_headers_message, (headers) )
+FC_REFLECT( eosio::snapshot_list_request_message, )
+FC_REFLECT( eosio::snapshot_description, (head_block_id)(size)(chunk_size)(manifest_digest) )
+FC_REFLECT( eosio::snapshot_list_message, (snapshots) )
+FC_REFLECT( eosio::snapshot_manifest_request_message, (head_block_id) )
+FC_REFLECT( eosio::snapshot_manifest_message, (snapshot)(chunk_hashes) )
+FC_REFLECT( eosio::snapshot_chunk_request_message, (head_block_id)(chunk) )
+FC_REFLECT( eosio::snapshot_chunk_message, (head_block_id)(chunk)(data) )
+FC_REFLECT( eosio::packed_transactions_message, (trxs) )
 
 /**
  *
@@ -5,10 +5,16 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/transaction_tracing.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/memory_accounting.hpp>
+#include <eosio/chain/startup_timeline.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <eosio/chain/contract_types.hpp>
+#include <eosio/chain/snapshot.hpp>
 
 #include <fc/network/message_buffer.hpp>
 #include <fc/network/ip.hpp>
@@ -23,8 +29,17 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
-
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <fstream>
+#include <set>
 #include <shared_mutex>
 
 using namespace eosio::chain::plugin_interface;
@@ -38,6 +53,7 @@ namespace eosio {
    using boost::asio::ip::address_v4;
    using boost::asio::ip::host_name;
    using boost::multi_index_container;
+   namespace bfs = boost::filesystem;
 
    using fc::time_point;
    using fc::time_point_sec;
@@ -45,6 +61,7 @@ namespace eosio {
    using eosio::chain::sha256_less;
 
    class connection;
+   class shared_send_buffer;
 
    using connection_ptr = std::shared_ptr<connection>;
    using connection_wptr = std::weak_ptr<connection>;
@@ -64,6 +81,7 @@ namespace eosio {
       time_point_sec  expires;        /// time after which this may be purged.
       uint32_t        block_num = 0;  /// block transaction was included in
       uint32_t        connection_id = 0;
+      packed_transaction_ptr trx;     /// kept to rebuild compact blocks, set when received or broadcast by us
    };
 
    struct by_expiry;
@@ -137,14 +155,45 @@ namespace eosio {
          in_sync
       };
 
+      /// range of blocks requested from one peer during lib_catchup
+      struct sync_span {
+         uint32_t       next_num; ///< next block expected from source
+         uint32_t       end_num;
+         connection_ptr source;   ///< empty while waiting to be reassigned
+         fc::time_point last_recv; ///< time of the request or of the last block received from source
+      };
+
+      /// block received ahead of sync_next_expected_num, held until the blocks before it are applied
+      struct buffered_block {
+         connection_ptr   source;
+         block_id_type    id;
+         signed_block_ptr block;
+      };
+
       mutable std::mutex sync_mtx;
       uint32_t       sync_known_lib_num;
       uint32_t       sync_last_requested_num;
       uint32_t       sync_next_expected_num;
       uint32_t       sync_req_span;
-      connection_ptr sync_source;
+      uint32_t       sync_max_spans;
+      connection_ptr sync_source; ///< peer of the last requested span, starting point of the search for the next
+      deque<sync_span>                   sync_spans;          ///< outstanding spans in block order
+      std::map<uint32_t, buffered_block> sync_reorder_buffer; ///< bounded by sync_max_spans * sync_req_span
       std::atomic<stages> sync_state;
 
+      /** \name Header-first sync
+       *  During lib_catchup the block headers are requested ahead of the blocks and verified with
+       *  block_header_state, blocks are then only requested up to the last verified header and must match it.
+       *  @{
+       */
+      const bool                        sync_headers_first;
+      bool                              header_sync_failed = false; ///< plain sync for the rest of this catchup
+      bool                              header_base_pending = false; ///< head block state requested from the main thread
+      block_header_state_ptr            header_state;   ///< last verified header, the next batch is requested after it
+      connection_ptr                    header_source;  ///< peer of the outstanding block_headers_request_message
+      std::map<uint32_t, block_id_type> verified_ids;   ///< ids of verified headers of blocks not yet applied
+      /** @} */
+
    private:
       constexpr static auto stage_str( stages s );
       void set_state( stages s );
@@ -152,25 +201,65 @@ namespace eosio {
       void request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn = connection_ptr() );
       void start_sync( const connection_ptr& c, uint32_t target );
       bool verify_catchup( const connection_ptr& c, uint32_t num, const block_id_type& id );
+      // call with sync_mtx locked
+      bool can_request_span()const;
+      bool headers_active()const;
+      /// highest block that may be requested, the known lib or the last verified header
+      uint32_t sync_request_limit()const;
+      /// @return peer to ask for the next batch of headers and the range, empty if none is needed or possible
+      std::tuple<connection_ptr, uint32_t, uint32_t> next_header_request();
+      void reset_headers();
+      connection_ptr next_sync_source( const connection_ptr& conn );
+      deque<sync_span>::iterator find_span( const connection_ptr& c );
+      void reset_spans();
 
    public:
-      explicit sync_manager( uint32_t span );
+      sync_manager( uint32_t span, uint32_t max_spans, bool headers_first );
       static void send_handshakes();
       bool syncing_with_peer() const { return sync_state == lib_catchup; }
       void sync_reset_lib_num( const connection_ptr& conn );
       void sync_reassign_fetch( const connection_ptr& c, go_away_reason reason );
       void rejected_block( const connection_ptr& c, uint32_t blk_num );
       void sync_recv_block( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
+      /**
+       * Accounts a block received for a sync span, b is null for a block that is already known
+       * @return true if the block was taken by the sync manager, to be processed once the blocks before it are applied
+       */
+      bool sync_recv_span_block( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, const signed_block_ptr& b );
       void sync_update_expected( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
       void recv_handshake( const connection_ptr& c, const handshake_message& msg );
       void sync_recv_notice( const connection_ptr& c, const notice_message& msg );
+      void sync_recv_headers( const connection_ptr& c, const block_headers_message& msg );
+   };
+
+   /**
+    * Index split into shards by id, each with its own mutex, so net threads handling different
+    * blocks or transactions do not contend on one lock.
+    */
+   template<typename Index>
+   class sharded_index {
+   public:
+      static constexpr size_t num_shards = 16;
+
+      struct shard {
+         mutable std::mutex mtx;
+         Index              index;
+      };
+
+      // for block ids the leading bytes hold the block number, the second word is hash for blocks and transactions alike
+      shard&       get( const fc::sha256& id )       { return _shards[id._hash[1] % num_shards]; }
+      const shard& get( const fc::sha256& id ) const { return _shards[id._hash[1] % num_shards]; }
+
+      std::array<shard, num_shards>&       shards()       { return _shards; }
+      const std::array<shard, num_shards>& shards() const { return _shards; }
+
+   private:
+      std::array<shard, num_shards> _shards;
    };
 
    class dispatch_manager {
-      mutable std::mutex      blk_state_mtx;
-      peer_block_state_index  blk_state;
-      mutable std::mutex      local_txns_mtx;
-      node_transaction_index  local_txns;
+      sharded_index<peer_block_state_index>  blk_state;
+      sharded_index<node_transaction_index>  local_txns;
 
    public:
       boost::asio::io_context::strand  strand;
@@ -178,9 +267,10 @@ namespace eosio {
       explicit dispatch_manager(boost::asio::io_context& io_context)
       : strand( io_context ) {}
 
-      void bcast_transaction(const packed_transaction& trx);
+      void bcast_transaction(const packed_transaction_ptr& trx);
       void rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num);
-      void bcast_block(const block_state_ptr& bs);
+      /// @param packed  b as packed by fc::raw::pack if it was packed already
+      void bcast_block(const signed_block_ptr& b, const block_id_type& id, const std::shared_ptr<const std::vector<char>>& packed = {});
       void bcast_notice( const block_id_type& id );
       void rejected_block(const block_id_type& id);
 
@@ -201,9 +291,136 @@ namespace eosio {
       void update_txns_block_num( const transaction_id_type& id, uint32_t blk_num );
       bool peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const;
       bool have_txn( const transaction_id_type& tid ) const;
+      packed_transaction_ptr find_txn( const transaction_id_type& tid ) const;
       void expire_txns( uint32_t lib_num );
    };
 
+   /**
+    * Serves the snapshots of producer_plugin's snapshots directory to peers, and downloads one from them for
+    * bootstrapping a node. The snapshot offered by the most peers is chosen, its manifest of chunk hashes must
+    * match the digest those peers advertise, and its chunks are requested from all of them in parallel and
+    * verified against the manifest. Thread safe.
+    */
+   class snapshot_manager {
+   public:
+      snapshot_manager( boost::asio::io_context& io_context, bfs::path download_dir, bool serve, uint64_t max_size );
+
+      // serving, called from connection strand
+      void recv_list_request( const connection_ptr& c );
+      void recv_manifest_request( const connection_ptr& c, const snapshot_manifest_request_message& msg );
+      void recv_chunk_request( const connection_ptr& c, const snapshot_chunk_request_message& msg );
+
+      // downloading
+      snapshot_fetch_status start_fetch( const optional<block_id_type>& head_block_id );
+      snapshot_fetch_status get_status()const;
+      void recv_list( const connection_ptr& c, const snapshot_list_message& msg );
+      void recv_manifest( const connection_ptr& c, const snapshot_manifest_message& msg );
+      void recv_chunk( const connection_ptr& c, const snapshot_chunk_message& msg );
+      void stop();
+
+   private:
+      enum class fetch_state { idle, listing, downloading, verifying, complete, failed };
+      static const char* state_str( fetch_state s );
+
+      /// a snapshot file of the snapshots directory with its chunk hashes, rehashed when the file changes
+      struct served_snapshot {
+         bfs::path path;
+         std::time_t             last_write_time = 0;
+         snapshot_description    description;
+         vector<fc::sha256>      chunk_hashes;
+      };
+      struct chunk_request {
+         connection_ptr          source;
+         fc::time_point          time;
+      };
+
+      bool serving()const;
+      void scan_snapshots(); // call with served_mtx locked
+
+      // call with mtx locked
+      void fail( const string& reason );
+      void choose_snapshot();
+      void request_manifest();
+      void request_chunks();
+      optional<uint32_t> next_needed_chunk();
+      void drop_source( const connection_ptr& c );
+      void start_timer();
+      void finish();
+      uint32_t chunk_bytes( uint32_t chunk )const;
+
+      void on_timer();
+      static void send( const connection_ptr& c, const net_message& msg );
+
+      const bfs::path                    download_dir;
+      const bool                         serve;
+      const uint64_t                     max_size;   ///< larger snapshots offered by peers are ignored
+
+      std::mutex                         served_mtx;
+      std::map<block_id_type, served_snapshot> served;
+
+      mutable std::mutex                 mtx;
+      fetch_state                        state = fetch_state::idle;
+      optional<block_id_type>            wanted_id;
+      fc::time_point                     list_deadline;
+      /// snapshots offered while listing, by head block id and manifest digest, with the peers offering them
+      std::map<std::pair<block_id_type, fc::sha256>, std::pair<snapshot_description, std::set<connection_ptr>>> offers;
+      optional<snapshot_description>     chosen;
+      std::set<connection_ptr>           sources;    ///< peers offering chosen, dropped on a bad or late reply
+      connection_ptr                     manifest_source;
+      fc::time_point                     manifest_time;
+      vector<fc::sha256>                 chunk_hashes;
+      vector<bool>                       received;
+      uint32_t                           chunks_received = 0;
+      uint32_t                           next_chunk = 0;
+      deque<uint32_t>                    retry_chunks;
+      std::map<uint32_t, chunk_request>  outstanding;
+      std::ofstream                      file;       ///< temp_path the chunks are written to
+      bfs::path                          temp_path;
+      bfs::path                          final_path;
+      string                             error;
+      boost::asio::steady_timer          timer;
+   };
+
+   /**
+    * Records when each block produced recently was first received, and from which peer, to measure how long blocks
+    * take to propagate to this node. Latency is measured from the block timestamp, so it includes the clock skew
+    * between this node and the producer. Blocks older than max_block_age_us when received are catching up, not
+    * propagating, and are left out. Thread safe.
+    */
+   class block_propagation_tracker {
+   public:
+      static constexpr int64_t          max_block_age_us = 30*1000*1000;
+      static constexpr size_t           max_recent_blocks = 256;
+      /// upper bounds of the latency histogram buckets, a last bucket holds the blocks seen later
+      static constexpr std::array<int64_t, 12> bucket_bounds_ms{ {50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000} };
+
+      // called from connection strand
+      void recv_block( const block_header& bh, const block_id_type& id, const string& peer );
+
+      block_propagation_stats get_stats()const;
+
+   private:
+      struct producer_histogram {
+         uint64_t         blocks = 0;
+         int64_t          latency_us_total = 0;
+         int64_t          latency_us_min = std::numeric_limits<int64_t>::max();
+         int64_t          latency_us_max = std::numeric_limits<int64_t>::min();
+         std::array<uint64_t, bucket_bounds_ms.size() + 1> buckets{};
+      };
+      struct peer_deliveries {
+         uint64_t         blocks_first = 0;
+         uint64_t         blocks_later = 0;
+         uint64_t         lag_us_total = 0;
+         uint64_t         lag_us_max = 0;
+      };
+
+      mutable std::mutex                             mtx;
+      std::map<block_id_type, block_first_seen>      recent;       ///< by id, at most max_recent_blocks
+      deque<block_id_type>                           recent_order; ///< ids of recent in the order first seen
+      std::map<account_name, producer_histogram>     producers;
+      std::map<string, peer_deliveries>              peers;        ///< by peer name, stable across reconnects
+   };
+
    class net_plugin_impl : public std::enable_shared_from_this<net_plugin_impl> {
    public:
       unique_ptr<tcp::acceptor>        acceptor;
@@ -211,6 +428,8 @@ namespace eosio {
 
       unique_ptr< sync_manager >       sync_master;
       unique_ptr< dispatch_manager >   dispatcher;
+      unique_ptr< snapshot_manager >   snapshot_master;
+      block_propagation_tracker        propagation;
 
       /**
        * Thread safe, only updated in plugin initialize
@@ -221,6 +440,8 @@ namespace eosio {
 
       vector<string>                        supplied_peers;
       vector<chain::public_key_type>        allowed_peers; ///< peer keys allowed to connect
+      mutable std::mutex                    early_relay_mtx;
+      std::set<chain::public_key_type>      early_relay_peers; ///< keys of the peers whose new blocks are relayed before they are applied
       std::map<chain::public_key_type,
                chain::private_key_type>     private_keys; ///< overlapping with producer keys, also authenticating non-producing nodes
       enum possible_connections : char {
@@ -251,6 +472,13 @@ namespace eosio {
       chain_plugin*                         chain_plug = nullptr;
       producer_plugin*                      producer_plug = nullptr;
       bool                                  use_socket_read_watermark = false;
+      uint32_t                              compression_threshold = 0; ///< minimum frame size sent compressed, 0 disables
+      bool                                  use_compact_blocks = false;
+      uint32_t                              trx_bandwidth_limit = 0; ///< bytes per second of transactions relayed to each peer, 0 for no limit
+      fc::microseconds                      trx_batch_window; ///< relayed transactions wait this long to be batched, 0 disables batching
+      bool                                  serve_snapshots = false;
+      bfs::path                             snapshot_download_dir;
+      uint64_t                              snapshot_max_size = 0; ///< bytes of the largest snapshot fetched from peers
       /** @} */
 
       mutable std::shared_mutex             connections_mtx;
@@ -315,6 +543,12 @@ namespace eosio {
        * \return False if the peer should not connect, true otherwise.
        */
       bool authenticate_peer(const handshake_message& msg) const;
+      /// @return true if msg proves the peer holds one of the early_relay_peers keys
+      bool is_early_relay_peer(const handshake_message& msg) const;
+      /// relays b to the other peers if its header and producer signature are valid, @return true if it was relayed
+      bool relay_early( const block_id_type& id, const signed_block_ptr& b, const connection_ptr& c );
+      /// stops relaying blocks of c early, a block it sent was relayed early and then failed
+      void demote_early_relay_peer( const connection_ptr& c );
       /** \brief Retrieve public key used to authenticate with peers.
        *
        * Finds a key to use for authentication.  If this node is a producer, use
@@ -381,6 +615,7 @@ namespace eosio {
    constexpr auto     def_send_buffer_size_mb = 4;
    constexpr auto     def_send_buffer_size = 1024*1024*def_send_buffer_size_mb;
    constexpr auto     def_max_write_queue_size = def_send_buffer_size*10;
+   constexpr size_t   def_write_batch_size = 256*1024; // bytes per async_write, beyond the live blocks queued
    constexpr auto     def_max_trx_in_progress_size = 100*1024*1024; // 100 MB
    constexpr auto     def_max_consecutive_rejected_blocks = 3; // num of rejected blocks before disconnect
    constexpr auto     def_max_consecutive_immediate_connection_close = 9; // back off if client keeps closing
@@ -391,10 +626,30 @@ namespace eosio {
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr uint32_t def_max_sync_headers = 1000; // most headers requested or sent in one block_headers_message
+   constexpr uint32_t def_snapshot_chunk_size = 1024*1024;
+   constexpr uint32_t def_snapshot_chunks_per_peer = 2; // outstanding chunk requests per peer, more from a peer disconnects it
+   constexpr uint32_t def_snapshot_max_size_mb = 64*1024;
+   constexpr auto     def_snapshot_list_wait = std::chrono::seconds(3); // time to collect snapshot_list_messages
+   constexpr auto     def_snapshot_request_timeout = std::chrono::seconds(30);
 
    constexpr auto     message_header_size = 4;
    constexpr uint32_t signed_block_which = 7;        // see protocol net_message
    constexpr uint32_t packed_transaction_which = 8;  // see protocol net_message
+   constexpr uint32_t compressed_message_which = 9;  // see protocol net_message
+   constexpr uint32_t compact_block_which = 10;      // see protocol net_message
+   constexpr uint32_t snapshot_chunk_which = 20;     // see protocol net_message
+   constexpr uint32_t packed_transactions_which = 21; // see protocol net_message
+   constexpr uint32_t num_net_message_types = 22;    // see protocol net_message
+
+   const char* const net_message_type_names[num_net_message_types] = {
+      "handshake_message", "chain_size_message", "go_away_message", "time_message", "notice_message",
+      "request_message", "sync_request_message", "signed_block", "packed_transaction", "compressed_message",
+      "compact_block_message", "block_trxs_request_message", "block_trxs_message", "block_headers_request_message",
+      "block_headers_message", "snapshot_list_request_message", "snapshot_list_message", "snapshot_manifest_request_message",
+      "snapshot_manifest_message", "snapshot_chunk_request_message", "snapshot_chunk_message",
+      "packed_transactions_message"
+   };
 
    /**
     *  For a while, network version was a 16 bit value equal to the second set of 16 bits
@@ -417,8 +672,23 @@ namespace eosio {
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
    constexpr uint16_t block_id_notify = 2;
+   /**
+    *  The versions above block_id_notify stand for other capabilities in upstream releases (3 is proto_pruned_types
+    *  there), so they are advertised as network_version values of a range of their own starting at ext_version_base.
+    *  A peer advertising a version of the net_version_base range is not assumed to support more than block_id_notify,
+    *  and a peer unaware of the extension range takes this node for a proto_base peer.
+    */
+   constexpr uint16_t ext_version_base = net_version_base + 0x0100;
+   constexpr uint16_t compressed_messages = 3; ///< peer accepts compressed_message
+   constexpr uint16_t compact_blocks = 4;      ///< peer accepts compact_block_message
+   constexpr uint16_t header_sync = 5;         ///< peer answers block_headers_request_message
+   constexpr uint16_t snapshot_transfer = 6;   ///< peer answers the snapshot request messages
+   constexpr uint16_t trx_batches = 7;         ///< peer accepts packed_transactions_message
+
+   constexpr uint16_t net_version = trx_batches;
 
-   constexpr uint16_t net_version = block_id_notify;
+   /// a batch of relayed transactions is sent once it holds this many bytes, without waiting for trx_batch_window
+   constexpr size_t   max_trx_batch_size = 64*1024;
 
    /**
     * Index by start_block_num
@@ -434,13 +704,108 @@ namespace eosio {
       time_point   start_time; ///< time request made or received
    };
 
+   /**
+    * Process wide pool of the buffers of sent frames and decompressed messages, thread safe. A buffer goes back to the
+    * pool, keeping its capacity, once the last connection holding it has written it, so frames sent to many peers are
+    * not each allocated and faulted in anew. Buffers are pooled in power of two size classes up to max_pooled_size,
+    * at most max_pooled_bytes of them.
+    */
+   class net_buffer_pool : boost::noncopyable {
+   public:
+      using buffer_ptr = std::shared_ptr<vector<char>>;
+
+      static constexpr size_t min_pooled_size  = 256;
+      static constexpr size_t size_classes     = 16; // up to 8 MiB
+      static constexpr size_t max_pooled_bytes = 64*1024*1024;
+
+      static net_buffer_pool& instance() {
+         // never destroyed, buffers return to it until the very end
+         static net_buffer_pool* pool = new net_buffer_pool;
+         return *pool;
+      }
+
+      /// a buffer of size bytes
+      buffer_ptr get( size_t size ) {
+         std::unique_ptr<vector<char>> b;
+         const size_t c = ceil_class( size );
+         if( c < size_classes ) {
+            std::lock_guard<std::mutex> g( mtx );
+            auto& free = free_buffers[c];
+            if( !free.empty() ) {
+               b = std::move( free.back() );
+               free.pop_back();
+               pooled_bytes -= b->capacity();
+            }
+         }
+         if( !b ) {
+            b = std::make_unique<vector<char>>();
+            b->reserve( c < size_classes ? class_size( c ) : size );
+            chain::memory_accounting::net_buffers().allocated( b->capacity() );
+         }
+         b->resize( size );
+         return buffer_ptr( b.release(), []( vector<char>* p ) { instance().put( std::unique_ptr<vector<char>>( p ) ); } );
+      }
+
+   private:
+      static size_t class_size( size_t c ) { return min_pooled_size << c; }
+
+      /// smallest class whose buffers hold size bytes
+      static size_t ceil_class( size_t size ) {
+         size_t c = 0;
+         while( c < size_classes && class_size( c ) < size ) ++c;
+         return c;
+      }
+
+      /// buffers are accounted to net_buffers from their allocation until the pool drops them
+      void put( std::unique_ptr<vector<char>> b ) {
+         const size_t capacity = b->capacity();
+         if( capacity < min_pooled_size || capacity >= 2 * class_size( size_classes - 1 ) ) {
+            chain::memory_accounting::net_buffers().freed( capacity );
+            return;
+         }
+         // largest class the buffer holds
+         size_t c = 0;
+         while( c + 1 < size_classes && class_size( c + 1 ) <= b->capacity() ) ++c;
+         b->clear();
+         std::lock_guard<std::mutex> g( mtx );
+         if( pooled_bytes + b->capacity() > max_pooled_bytes ) {
+            chain::memory_accounting::net_buffers().freed( capacity );
+            return;
+         }
+         pooled_bytes += b->capacity();
+         free_buffers[c].push_back( std::move( b ) );
+      }
+
+      std::mutex                                                   mtx;
+      std::array<vector<std::unique_ptr<vector<char>>>, size_classes> free_buffers;
+      size_t                                                       pooled_bytes = 0;
+   };
+
    // thread safe
+   /// write classes of queued_buffer, in priority order
+   enum write_queue_type : uint8_t {
+      live_block_queue,  ///< blocks broadcast or requested by id
+      sync_block_queue,  ///< blocks sent in response to sync_request_message
+      notice_queue,      ///< all other protocol messages
+      trx_queue,         ///< relayed transactions
+      num_write_queues
+   };
+
    class queued_buffer : boost::noncopyable {
    public:
+      /// @param trx_bytes_per_sec cap on the bytes of transactions written per second, 0 for no cap
+      explicit queued_buffer( uint32_t trx_bytes_per_sec )
+         : _trx_bytes_per_sec( trx_bytes_per_sec )
+         , _trx_allowance( trx_bytes_per_sec ) {}
+
       void clear_write_queue() {
          std::lock_guard<std::mutex> g( _mtx );
-         _write_queue.clear();
-         _sync_write_queue.clear();
+         for( auto& w_queue : _write_queues ) {
+            w_queue.clear();
+         }
+         for( auto& deficit : _deficits ) {
+            deficit = 0;
+         }
          _write_queue_size = 0;
       }
 
@@ -461,22 +826,32 @@ namespace eosio {
          return _out_queue.empty();
       }
 
-      bool ready_to_send() const {
+      bool ready_to_send() {
          std::lock_guard<std::mutex> g( _mtx );
          // if out_queue is not empty then async_write is in progress
-         return ((!_sync_write_queue.empty() || !_write_queue.empty()) && _out_queue.empty());
+         if( !_out_queue.empty() ) return false;
+         refill_trx_allowance();
+         for( uint8_t q = 0; q < num_write_queues; ++q ) {
+            if( can_send( q ) ) return true;
+         }
+         return false;
+      }
+
+      /// @return time until queued transactions held back by the bandwidth cap may be written, zero if none are
+      fc::microseconds trx_throttle_delay() {
+         std::lock_guard<std::mutex> g( _mtx );
+         if( _write_queues[trx_queue].empty() || !_trx_bytes_per_sec ) return fc::microseconds();
+         refill_trx_allowance();
+         if( _trx_allowance > 0 ) return fc::microseconds();
+         return fc::microseconds( (1 - _trx_allowance) * 1000000 / _trx_bytes_per_sec + 1 );
       }
 
       // @param callback must not callback into queued_buffer
       bool add_write_queue( const std::shared_ptr<vector<char>>& buff,
                             std::function<void( boost::system::error_code, std::size_t )> callback,
-                            bool to_sync_queue ) {
+                            write_queue_type queue ) {
          std::lock_guard<std::mutex> g( _mtx );
-         if( to_sync_queue ) {
-            _sync_write_queue.push_back( {buff, callback} );
-         } else {
-            _write_queue.push_back( {buff, callback} );
-         }
+         _write_queues[queue].push_back( {buff, callback} );
          _write_queue_size += buff->size();
          if( _write_queue_size > 2 * def_max_write_queue_size ) {
             return false;
@@ -484,13 +859,38 @@ namespace eosio {
          return true;
       }
 
+      /**
+       * Live blocks are always written first and in full. The other queues share the rest of the batch, up to
+       * def_write_batch_size bytes, by deficit round robin weighted by their priority, so a backlog of sync
+       * blocks does not starve notices and transactions. Transactions are also held to the bandwidth cap.
+       */
       void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs ) {
          std::lock_guard<std::mutex> g( _mtx );
-         if( _sync_write_queue.size() > 0 ) { // always send msgs from sync_write_queue first
-            fill_out_buffer( bufs, _sync_write_queue );
-         } else { // postpone real_time write_queue if sync queue is not empty
-            fill_out_buffer( bufs, _write_queue );
-            EOS_ASSERT( _write_queue_size == 0, plugin_exception, "write queue size expected to be zero" );
+         size_t batch_size = 0;
+         auto& live_queue = _write_queues[live_block_queue];
+         while( !live_queue.empty() ) {
+            batch_size += move_to_out_queue( bufs, live_queue );
+         }
+
+         refill_trx_allowance();
+         bool sendable = true;
+         while( sendable && batch_size < def_write_batch_size ) {
+            sendable = false;
+            for( uint8_t q = live_block_queue + 1; q < num_write_queues && batch_size < def_write_batch_size; ++q ) {
+               auto& w_queue = _write_queues[q];
+               if( !can_send( q ) ) {
+                  if( w_queue.empty() ) _deficits[q] = 0;
+                  continue;
+               }
+               sendable = true;
+               _deficits[q] += write_queue_quantum[q];
+               while( can_send( q ) && w_queue.front().buff->size() <= _deficits[q] ) {
+                  const size_t size = move_to_out_queue( bufs, w_queue );
+                  _deficits[q] -= size;
+                  if( q == trx_queue && _trx_bytes_per_sec ) _trx_allowance -= size;
+                  batch_size += size;
+               }
+            }
          }
       }
 
@@ -503,15 +903,35 @@ namespace eosio {
 
    private:
       struct queued_write;
-      void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs,
-                            deque<queued_write>& w_queue ) {
-         while ( w_queue.size() > 0 ) {
-            auto& m = w_queue.front();
-            bufs.push_back( boost::asio::buffer( *m.buff ));
-            _write_queue_size -= m.buff->size();
-            _out_queue.emplace_back( m );
-            w_queue.pop_front();
-         }
+
+      /// bytes each queue may add to a write batch per round, live blocks are not limited
+      static constexpr size_t write_queue_quantum[num_write_queues] = { 0, 512*1024, 128*1024, 64*1024 };
+
+      // call with _mtx locked
+      bool can_send( uint8_t q ) const {
+         if( _write_queues[q].empty() ) return false;
+         return q != trx_queue || !_trx_bytes_per_sec || _trx_allowance > 0;
+      }
+
+      // call with _mtx locked
+      void refill_trx_allowance() {
+         if( !_trx_bytes_per_sec ) return;
+         const auto now = fc::time_point::now();
+         const int64_t elapsed_us = (now - _trx_allowance_time).count();
+         _trx_allowance_time = now;
+         // burst of at most one second of the cap
+         _trx_allowance = std::min<int64_t>( _trx_bytes_per_sec, _trx_allowance + elapsed_us * _trx_bytes_per_sec / 1000000 );
+      }
+
+      // call with _mtx locked
+      size_t move_to_out_queue( std::vector<boost::asio::const_buffer>& bufs, deque<queued_write>& w_queue ) {
+         auto& m = w_queue.front();
+         const size_t size = m.buff->size();
+         bufs.push_back( boost::asio::buffer( *m.buff ));
+         _write_queue_size -= size;
+         _out_queue.emplace_back( m );
+         w_queue.pop_front();
+         return size;
       }
 
    private:
@@ -522,12 +942,142 @@ namespace eosio {
 
       mutable std::mutex  _mtx;
       uint32_t            _write_queue_size{0};
-      deque<queued_write> _write_queue;
-      deque<queued_write> _sync_write_queue; // sync_write_queue will be sent first
+      deque<queued_write> _write_queues[num_write_queues];
+      size_t              _deficits[num_write_queues]{};
       deque<queued_write> _out_queue;
 
+      const uint32_t      _trx_bytes_per_sec;
+      int64_t             _trx_allowance;      ///< bytes of transactions that may still be written, may go negative
+      fc::time_point      _trx_allowance_time = fc::time_point::now();
+
    }; // queued_buffer
 
+   // thread safe, updated from the connection strand and read by net_api_plugin status calls
+   struct compression_counters {
+      std::atomic<uint64_t> uncompressed_bytes{0};
+      std::atomic<uint64_t> compressed_bytes{0};
+      std::atomic<uint64_t> cpu_time_us{0};
+
+      void add( uint64_t uncompressed, uint64_t compressed ) {
+         uncompressed_bytes += uncompressed;
+         compressed_bytes += compressed;
+      }
+
+      compression_stats get()const {
+         compression_stats stats;
+         stats.uncompressed_bytes = uncompressed_bytes;
+         stats.compressed_bytes = compressed_bytes;
+         stats.ratio = stats.uncompressed_bytes ? double( stats.compressed_bytes ) / stats.uncompressed_bytes : 0;
+         stats.cpu_time_us = cpu_time_us;
+         return stats;
+      }
+   };
+
+   // totals of the connection_counters of every connection by message type, exported by the metrics registry
+   struct net_metrics {
+      using counter = chain::metrics::counter;
+      std::array<counter*, num_net_message_types> messages_in;
+      std::array<counter*, num_net_message_types> bytes_in;
+      std::array<counter*, num_net_message_types> messages_out;
+      std::array<counter*, num_net_message_types> bytes_out;
+
+      static net_metrics& instance() {
+         static net_metrics the_instance;
+         return the_instance;
+      }
+
+   private:
+      net_metrics() {
+         auto& r = chain::metrics::registry::instance();
+         for( uint32_t i = 0; i < num_net_message_types; ++i ) {
+            const auto label = chain::metrics::registry::label( "type", net_message_type_names[i] );
+            messages_in[i]  = &r.get_counter( "nodeos_net_messages_received_total", "p2p messages received", label );
+            bytes_in[i]     = &r.get_counter( "nodeos_net_received_bytes_total", "bytes of the p2p messages received", label );
+            messages_out[i] = &r.get_counter( "nodeos_net_messages_sent_total", "p2p messages sent", label );
+            bytes_out[i]    = &r.get_counter( "nodeos_net_sent_bytes_total", "bytes of the p2p messages sent", label );
+         }
+      }
+   };
+
+   // thread safe, updated from the connection strand and read by net_api_plugin metrics calls
+   struct connection_counters {
+      struct message_counters {
+         std::atomic<uint64_t> messages_in{0};
+         std::atomic<uint64_t> bytes_in{0};
+         std::atomic<uint64_t> messages_out{0};
+         std::atomic<uint64_t> bytes_out{0};
+      };
+
+      std::array<message_counters, num_net_message_types> messages;
+      std::atomic<uint64_t> messages_dropped{0};
+      std::atomic<int64_t>  handshake_rtt_us{-1};
+      std::atomic<uint64_t> blocks_relayed{0};
+      std::atomic<uint64_t> block_relay_us_total{0};
+      std::atomic<uint64_t> block_relay_us_max{0};
+
+      void received( uint32_t which, uint64_t bytes ) {
+         if( which >= num_net_message_types ) return;
+         ++messages[which].messages_in;
+         messages[which].bytes_in += bytes;
+         auto& totals = net_metrics::instance();
+         totals.messages_in[which]->add();
+         totals.bytes_in[which]->add( bytes );
+      }
+
+      void sent( uint32_t which, uint64_t bytes ) {
+         if( which >= num_net_message_types ) return;
+         ++messages[which].messages_out;
+         messages[which].bytes_out += bytes;
+         auto& totals = net_metrics::instance();
+         totals.messages_out[which]->add();
+         totals.bytes_out[which]->add( bytes );
+      }
+
+      void block_relayed( const fc::microseconds& latency ) {
+         const uint64_t us = std::max<int64_t>( latency.count(), 0 );
+         ++blocks_relayed;
+         block_relay_us_total += us;
+         uint64_t prev_max = block_relay_us_max.load();
+         while( prev_max < us && !block_relay_us_max.compare_exchange_weak( prev_max, us ) ) {}
+      }
+   };
+
+
+   /**
+    * Running estimates of how fast a peer delivers, used to prefer the fastest peers for sync spans and
+    * block fetches. Thread safe, updated from the connection strand and read while choosing peers.
+    */
+   struct peer_performance {
+      std::atomic<int64_t>  rtt_us{0};            ///< average time_message round trip, 0 until measured
+      std::atomic<int64_t>  block_interval_us{0}; ///< average time between sync blocks delivered, 0 until measured
+      std::atomic<uint32_t> stalls{0};            ///< sync and fetch timeouts since the peer last completed a sync span
+      std::atomic<uint32_t> rejected{0};          ///< blocks rejected since the peer last completed a sync span
+
+      void add_rtt( const fc::microseconds& rtt ) { add_sample( rtt_us, rtt.count() ); }
+      void add_block_interval( const fc::microseconds& interval ) { add_sample( block_interval_us, interval.count() ); }
+
+      void span_completed() {
+         stalls = 0;
+         rejected = 0;
+      }
+
+      /**
+       * Expected cost of asking this peer for blocks, lower is better. Peers not yet measured score 0 so
+       * they are tried and get an estimate; each stall or rejected block doubles the cost, up to 1024 times.
+       */
+      int64_t score()const {
+         const uint32_t penalty = std::min<uint32_t>( stalls + rejected, 10 );
+         return (block_interval_us + rtt_us) << penalty;
+      }
+
+   private:
+      // exponentially weighted moving average of the last 8 or so samples
+      static void add_sample( std::atomic<int64_t>& avg, int64_t sample ) {
+         sample = std::max<int64_t>( sample, 1 );
+         const int64_t prev = avg;
+         avg = prev ? prev + (sample - prev) / 8 : sample;
+      }
+   };
 
    class connection : public std::enable_shared_from_this<connection> {
    public:
@@ -573,17 +1123,41 @@ namespace eosio {
       queued_buffer           buffer_queue;
 
       std::atomic<uint32_t>   trx_in_progress_size{0};
+      std::atomic<bool>       early_relay{false}; ///< new blocks of the peer are relayed before they are applied
       const uint32_t          connection_id;
       int16_t                 sent_handshake_count = 0;
       std::atomic<bool>       connecting{true};
       std::atomic<bool>       syncing{false};
       uint16_t                protocol_version = 0;
+      std::atomic<bool>       peer_accepts_compression{false}; // protocol_version >= compressed_messages
+      compression_counters    sent_compression;
+      compression_counters    received_compression;
+      connection_counters     counters;
+      peer_performance        performance;
+      fc::time_point          handshake_sent_time; // only accessed from strand, first handshake of the session
+
+      /// compact block waiting on the block_trxs_message with its missing transactions
+      struct pending_compact_block {
+         block_id_type     id;
+         signed_block_ptr  block;
+         vector<uint32_t>  missing;
+      };
+      optional<pending_compact_block> pending_compact; // only accessed from strand
       uint16_t                consecutive_rejected_blocks = 0;
       std::atomic<uint16_t>   consecutive_immediate_connection_close = 0;
+      uint32_t                snapshot_chunks_serving = 0; // only accessed from strand, chunk requests of the peer not replied to yet
 
       std::mutex                            response_expected_timer_mtx;
       boost::asio::steady_timer             response_expected_timer;
 
+      boost::asio::steady_timer             write_throttle_timer; // only accessed from strand
+      bool                                  write_throttle_pending = false;
+
+      // relayed transactions waiting to be sent as a packed_transactions_message
+      vector<std::shared_ptr<shared_send_buffer>> pending_trx_batch; // only accessed from strand
+      size_t                                pending_trx_batch_size = 0; ///< bytes of the packed transactions
+      boost::asio::steady_timer             trx_batch_timer; // only accessed from strand
+
       std::atomic<go_away_reason>           no_retry{no_reason};
 
       mutable std::mutex          conn_mtx; //< mtx for last_req .. local_endpoint_port
@@ -598,8 +1172,10 @@ namespace eosio {
       string                      remote_endpoint_port;
       string                      local_endpoint_ip;
       string                      local_endpoint_port;
+      optional<fc::variant_object> logger_variant; // built by get_logger_variant, reset when a field it shows changes
 
       connection_status get_status()const;
+      connection_metrics get_metrics()const;
 
       /** \name Peer Timestamps
        *  Time message handling
@@ -637,6 +1213,10 @@ namespace eosio {
        * encountered unpacking or processing the message.
        */
       bool process_next_message(uint32_t message_length);
+      /// @return true if a block already known or not expected from the peer was handled and should be dropped
+      bool skip_block( const block_header& bh, const block_id_type& blk_id );
+      /// decompresses msg and handles the block or transaction it carries
+      void process_compressed_message( const compressed_message& msg );
 
       void send_handshake();
 
@@ -662,6 +1242,7 @@ namespace eosio {
       /** @} */
 
       const string peer_name();
+      const string peer_name_locked()const; // must call with held conn_mtx
 
       void blk_send_branch( const block_id_type& msg_head_id );
       void blk_send_branch_impl( uint32_t msg_head_num, uint32_t lib_num, uint32_t head_num );
@@ -670,9 +1251,23 @@ namespace eosio {
 
       void enqueue( const net_message &msg );
       void enqueue_block( const signed_block_ptr& sb, bool to_sync_queue = false);
+      void enqueue_serialized_block( uint32_t num, const std::vector<char>& block_data, bool to_sync_queue = false );
+      /// @return true if a block or transaction frame of this size is sent to the peer as a compressed_message
+      bool compress_frame( size_t frame_size )const;
+      /// @return compressed_message frame of frame, or frame if compressing does not make it smaller
+      std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const std::shared_ptr<std::vector<char>>& frame );
+      /// @return true if b was queued as a compact_block_message
+      bool enqueue_compact_block( const signed_block_ptr& b );
+      /// queues a block or transaction frame, compressed if negotiated with the peer
+      void enqueue_compressible( const std::shared_ptr<std::vector<char>>& frame, write_queue_type queue );
+      /// @return true if relayed transactions are sent to the peer in packed_transactions_message batches
+      bool batch_transactions()const;
+      /// adds a transaction to the batch sent once trx_batch_window passed or max_trx_batch_size is reached
+      void enqueue_batched_trx( const std::shared_ptr<shared_send_buffer>& trx );
+      void send_trx_batch();
       void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                            go_away_reason close_after_send,
-                           bool to_sync_queue = false);
+                           write_queue_type queue );
       void cancel_sync(go_away_reason);
       void flush_queues();
       bool enqueue_sync_block();
@@ -686,8 +1281,10 @@ namespace eosio {
 
       void queue_write(const std::shared_ptr<vector<char>>& buff,
                        std::function<void(boost::system::error_code, std::size_t)> callback,
-                       bool to_sync_queue = false);
+                       write_queue_type queue);
       void do_queue_write();
+      /// retries do_queue_write once transactions held back by the bandwidth cap may be written
+      void throttle_queue_write();
 
       static bool is_valid( const handshake_message& msg );
 
@@ -716,20 +1313,44 @@ namespace eosio {
       void handle_message( const block_id_type& id, signed_block_ptr msg );
       void handle_message( const packed_transaction& msg ) = delete; // packed_transaction_ptr overload used instead
       void handle_message( packed_transaction_ptr msg );
-
-      void process_signed_block( const block_id_type& id, signed_block_ptr msg );
+      /// handles the transactions of a packed_transactions_message unpacked from ds, past its which
+      template<typename Stream>
+      void handle_packed_transactions( Stream& ds );
+      void handle_message( const compact_block_message& msg );
+      void handle_message( const block_trxs_request_message& msg );
+      void handle_message( const block_trxs_message& msg );
+      void handle_message( const block_headers_request_message& msg );
+      void handle_message( const block_headers_message& msg );
+      void handle_message( const snapshot_list_request_message& msg );
+      void handle_message( const snapshot_list_message& msg );
+      void handle_message( const snapshot_manifest_request_message& msg );
+      void handle_message( const snapshot_manifest_message& msg );
+      void handle_message( const snapshot_chunk_request_message& msg );
+      void handle_message( const snapshot_chunk_message& msg );
+
+      /// verifies the transactions of a rebuilt compact block and handles it as a received signed_block
+      void complete_compact_block( const block_id_type& blk_id, signed_block_ptr b );
+      void request_full_block( const block_id_type& blk_id );
+
+      /// @param sync_buffered block was held in the sync reorder buffer, processed even if the connection closed since
+      /// @param received time the block was received from the peer, recorded as relay latency once accepted
+      void process_signed_block( const block_id_type& id, signed_block_ptr msg, bool sync_buffered = false,
+                                 fc::time_point received = fc::time_point() );
 
       fc::variant_object get_logger_variant()  {
-         fc::mutable_variant_object mvo;
-         mvo( "_name", peer_name());
          std::lock_guard<std::mutex> g_conn( conn_mtx );
-         mvo( "_id", conn_node_id )
-            ( "_sid", conn_node_id.str().substr( 0, 7 ) )
-            ( "_ip", remote_endpoint_ip )
-            ( "_port", remote_endpoint_port )
-            ( "_lip", local_endpoint_ip )
-            ( "_lport", local_endpoint_port );
-         return mvo;
+         if( !logger_variant ) {
+            fc::mutable_variant_object mvo;
+            mvo( "_name", peer_name_locked() )
+               ( "_id", conn_node_id )
+               ( "_sid", conn_node_id.str().substr( 0, 7 ) )
+               ( "_ip", remote_endpoint_ip )
+               ( "_port", remote_endpoint_port )
+               ( "_lip", local_endpoint_ip )
+               ( "_lport", local_endpoint_port );
+            logger_variant = fc::variant_object( std::move( mvo ) );
+         }
+         return *logger_variant;
       }
    };
 
@@ -786,6 +1407,72 @@ namespace eosio {
          fc_dlog( logger, "handle sync_request_message" );
          c->handle_message( msg );
       }
+
+      void operator()( const compact_block_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle compact_block_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const block_trxs_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle block_trxs_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const block_trxs_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle block_trxs_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const block_headers_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle block_headers_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const block_headers_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle block_headers_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_list_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_list_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_list_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_list_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_manifest_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_manifest_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_manifest_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_manifest_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_chunk_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_chunk_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const snapshot_chunk_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle snapshot_chunk_message" );
+         c->handle_message( msg );
+      }
    };
 
    template<typename Function>
@@ -811,8 +1498,11 @@ namespace eosio {
       : peer_addr( endpoint ),
         strand( my_impl->thread_pool->get_executor() ),
         socket( new tcp::socket( my_impl->thread_pool->get_executor() ) ),
+        buffer_queue( my_impl->trx_bandwidth_limit ),
         connection_id( ++my_impl->current_connection_id ),
         response_expected_timer( my_impl->thread_pool->get_executor() ),
+        write_throttle_timer( my_impl->thread_pool->get_executor() ),
+        trx_batch_timer( my_impl->thread_pool->get_executor() ),
         last_handshake_recv(),
         last_handshake_sent()
    {
@@ -823,8 +1513,11 @@ namespace eosio {
       : peer_addr(),
         strand( my_impl->thread_pool->get_executor() ),
         socket( new tcp::socket( my_impl->thread_pool->get_executor() ) ),
+        buffer_queue( my_impl->trx_bandwidth_limit ),
         connection_id( ++my_impl->current_connection_id ),
         response_expected_timer( my_impl->thread_pool->get_executor() ),
+        write_throttle_timer( my_impl->thread_pool->get_executor() ),
+        trx_batch_timer( my_impl->thread_pool->get_executor() ),
         last_handshake_recv(),
         last_handshake_sent()
    {
@@ -841,6 +1534,7 @@ namespace eosio {
       remote_endpoint_port = ec ? unknown : std::to_string(rep.port());
       local_endpoint_ip = ec2 ? unknown : lep.address().to_string();
       local_endpoint_port = ec2 ? unknown : std::to_string(lep.port());
+      logger_variant.reset();
    }
 
    void connection::set_connection_type( const string& peer_add ) {
@@ -873,11 +1567,40 @@ namespace eosio {
       stat.peer = peer_addr;
       stat.connecting = connecting;
       stat.syncing = syncing;
+      stat.compression = peer_accepts_compression;
+      stat.sent = sent_compression.get();
+      stat.received = received_compression.get();
       std::lock_guard<std::mutex> g( conn_mtx );
       stat.last_handshake = last_handshake_recv;
       return stat;
    }
 
+   connection_metrics connection::get_metrics()const {
+      connection_metrics m;
+      m.peer = peer_addr;
+      m.connection_id = connection_id;
+      m.connected = socket_is_open() && !connecting;
+      m.write_queue_bytes = buffer_queue.write_queue_size();
+      m.messages_dropped = counters.messages_dropped;
+      m.handshake_rtt_us = counters.handshake_rtt_us;
+      m.blocks_relayed = counters.blocks_relayed;
+      m.block_relay_us_total = counters.block_relay_us_total;
+      m.block_relay_us_max = counters.block_relay_us_max;
+      m.rtt_us = performance.rtt_us;
+      m.block_interval_us = performance.block_interval_us;
+      m.score = performance.score();
+      for( uint32_t which = 0; which < num_net_message_types; ++which ) {
+         const auto& c = counters.messages[which];
+         message_type_metrics mt{net_message_type_names[which], c.messages_in, c.bytes_in, c.messages_out, c.bytes_out};
+         if( mt.messages_in || mt.messages_out ) m.messages.emplace_back( std::move( mt ) );
+      }
+      if( m.peer.empty() ) {
+         std::lock_guard<std::mutex> g( conn_mtx );
+         m.peer = remote_endpoint_ip + ":" + remote_endpoint_port;
+      }
+      return m;
+   }
+
    bool connection::start_session() {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
 
@@ -927,6 +1650,7 @@ namespace eosio {
       self->connecting = false;
       self->syncing = false;
       self->consecutive_rejected_blocks = 0;
+      self->snapshot_chunks_serving = 0;
       ++self->consecutive_immediate_connection_close;
       bool has_last_req = false;
       {
@@ -936,16 +1660,22 @@ namespace eosio {
          self->last_handshake_sent = handshake_message();
          self->last_close = fc::time_point::now();
          self->conn_node_id = fc::sha256();
+         self->logger_variant.reset();
       }
       if( has_last_req && !shutdown ) {
          my_impl->dispatcher->retry_fetch( self->shared_from_this() );
       }
       self->peer_requested.reset();
       self->sent_handshake_count = 0;
+      self->handshake_sent_time = fc::time_point();
       if( !shutdown) my_impl->sync_master->sync_reset_lib_num( self->shared_from_this() );
       fc_ilog( logger, "closing '${a}', ${p}", ("a", self->peer_address())("p", self->peer_name()) );
       fc_dlog( logger, "canceling wait on ${p}", ("p", self->peer_name()) ); // peer_name(), do not hold conn_mtx
       self->cancel_wait();
+      self->write_throttle_timer.cancel();
+      self->trx_batch_timer.cancel();
+      self->pending_trx_batch.clear();
+      self->pending_trx_batch_size = 0;
 
       if( reconnect && !shutdown ) {
          my_impl->start_conn_timer( std::chrono::milliseconds( 100 ), connection_wptr() );
@@ -1051,6 +1781,7 @@ namespace eosio {
             static_assert( std::is_same_v<decltype( c->sent_handshake_count ), int16_t>, "INT16_MAX based on int16_t" );
             if( c->sent_handshake_count == INT16_MAX ) c->sent_handshake_count = 1; // do not wrap
             c->last_handshake_sent.generation = ++c->sent_handshake_count;
+            if( c->last_handshake_sent.generation == 1 ) c->handshake_sent_time = fc::time_point::now();
             auto last_handshake_sent = c->last_handshake_sent;
             g_conn.unlock();
             fc_ilog( logger, "Sending handshake generation ${g} to ${ep}, lib ${lib}, head ${head}, id ${id}",
@@ -1081,8 +1812,8 @@ namespace eosio {
 
    void connection::queue_write(const std::shared_ptr<vector<char>>& buff,
                                 std::function<void(boost::system::error_code, std::size_t)> callback,
-                                bool to_sync_queue) {
-      if( !buffer_queue.add_write_queue( buff, callback, to_sync_queue )) {
+                                write_queue_type queue) {
+      if( !buffer_queue.add_write_queue( buff, callback, queue )) {
          fc_wlog( logger, "write_queue full ${s} bytes, giving up on connection ${p}",
                   ("s", buffer_queue.write_queue_size())("p", peer_name()) );
          close();
@@ -1092,8 +1823,11 @@ namespace eosio {
    }
 
    void connection::do_queue_write() {
-      if( !buffer_queue.ready_to_send() )
+      if( !buffer_queue.ready_to_send() ) {
+         if( buffer_queue.is_out_queue_empty() )
+            throttle_queue_write();
          return;
+      }
       connection_ptr c(shared_from_this());
 
       std::vector<boost::asio::const_buffer> bufs;
@@ -1165,15 +1899,29 @@ namespace eosio {
          peer_requested.reset();
          fc_ilog( logger, "completing enqueue_sync_block ${num} to ${p}", ("num", num)("p", peer_name()) );
       }
+      uint32_t lib = 0;
+      std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+      if( num <= lib ) {
+         // the block log is read here on the net thread, blocks not in it yet are fetched on the main thread below
+         std::vector<char> block_data;
+         try {
+            block_data = my_impl->chain_plug->chain().fetch_serialized_block_from_log( num );
+         } FC_LOG_AND_DROP()
+         if( !block_data.empty() ) {
+            enqueue_serialized_block( num, block_data, true );
+            return true;
+         }
+      }
       connection_wptr weak = shared_from_this();
       app().post( priority::medium, [num, weak{std::move(weak)}]() {
          connection_ptr c = weak.lock();
          if( !c ) return;
          controller& cc = my_impl->chain_plug->chain();
-         signed_block_ptr sb = cc.fetch_block_by_number( num );
-         if( sb ) {
-            c->strand.post( [c, sb{std::move(sb)}]() {
-               c->enqueue_block( sb, true );
+         // irreversible blocks are forwarded as stored in the block log, without unpacking and repacking them
+         auto block_data = std::make_shared<std::vector<char>>( cc.fetch_serialized_block_by_number( num ) );
+         if( !block_data->empty() ) {
+            c->strand.post( [c, num, block_data{std::move(block_data)}]() {
+               c->enqueue_serialized_block( num, *block_data, true );
             });
          } else {
             c->strand.post( [c, num]() {
@@ -1200,12 +1948,12 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>(buffer_size);
+      auto send_buffer = net_buffer_pool::instance().get( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size);
       ds.write( header, header_size );
       fc::raw::pack( ds, m );
 
-      enqueue_buffer( send_buffer, close_after_send );
+      enqueue_buffer( send_buffer, close_after_send, notice_queue );
    }
 
    template< typename T>
@@ -1219,7 +1967,7 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>( buffer_size );
+      auto send_buffer = net_buffer_pool::instance().get( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size );
       ds.write( header, header_size );
       fc::raw::pack( ds, unsigned_int( which ) );
@@ -1235,22 +1983,206 @@ namespace eosio {
       return create_send_buffer( signed_block_which, *sb );
    }
 
+   static std::shared_ptr<std::vector<char>> create_send_buffer_from_serialized_block( const std::vector<char>& block_data ) {
+      // same framing as create_send_buffer( signed_block_which, ... ) with the block already packed
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      const uint32_t payload_size = which_size + block_data.size();
+
+      const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
+      constexpr size_t header_size = sizeof( payload_size );
+      static_assert( header_size == message_header_size, "invalid message_header_size" );
+      const size_t buffer_size = header_size + payload_size;
+
+      auto send_buffer = net_buffer_pool::instance().get( buffer_size );
+      fc::datastream<char*> ds( send_buffer->data(), buffer_size );
+      ds.write( header, header_size );
+      fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+      ds.write( block_data.data(), block_data.size() );
+
+      return send_buffer;
+   }
+
    static std::shared_ptr<std::vector<char>> create_send_buffer( const packed_transaction& trx ) {
       // this implementation is to avoid copy of packed_transaction to net_message
       // matches which of net_message for packed_transaction
       return create_send_buffer( packed_transaction_which, trx );
    }
 
+   /**
+    * Block or transaction frame broadcast to many connections. The compressed frame is created once, by the
+    * first connection that negotiated compression, and shared by the others; its cpu time is accounted to
+    * that first connection only.
+    */
+   class shared_send_buffer {
+   public:
+      explicit shared_send_buffer( std::shared_ptr<std::vector<char>> frame ) : uncompressed( std::move( frame ) ) {}
+
+      const std::shared_ptr<std::vector<char>>& frame()const { return uncompressed; }
+
+      // thread safe, call from the strand of c
+      const std::shared_ptr<std::vector<char>>& get( connection& c ) {
+         if( !c.compress_frame( uncompressed->size() ) ) return uncompressed;
+         std::call_once( compressed_once, [&]() { compressed = c.create_compressed_send_buffer( uncompressed ); } );
+         if( compressed != uncompressed )
+            c.sent_compression.add( uncompressed->size(), compressed->size() );
+         return compressed;
+      }
+
+   private:
+      const std::shared_ptr<std::vector<char>> uncompressed;
+      std::once_flag                           compressed_once;
+      std::shared_ptr<std::vector<char>>       compressed;
+   };
+
+   bool connection::compress_frame( size_t frame_size )const {
+      return peer_accepts_compression && my_impl->compression_threshold != 0 && frame_size >= my_impl->compression_threshold;
+   }
+
+   std::shared_ptr<std::vector<char>> connection::create_compressed_send_buffer( const std::shared_ptr<std::vector<char>>& frame ) {
+      namespace bio = boost::iostreams;
+      const auto start = fc::time_point::now();
+      compressed_message msg;
+      {
+         bio::filtering_ostream comp;
+         comp.push( bio::zlib_compressor( bio::zlib::best_speed ) );
+         comp.push( bio::back_inserter( msg.data ) );
+         // the payload of the frame is the which and the packed block or transaction
+         comp.write( frame->data() + message_header_size, frame->size() - message_header_size );
+      }
+      auto send_buffer = create_send_buffer( compressed_message_which, msg );
+      sent_compression.cpu_time_us += (fc::time_point::now() - start).count();
+      return send_buffer->size() < frame->size() ? send_buffer : frame;
+   }
+
+   void connection::enqueue_compressible( const std::shared_ptr<std::vector<char>>& frame, write_queue_type queue ) {
+      if( !compress_frame( frame->size() ) ) {
+         enqueue_buffer( frame, no_reason, queue );
+         return;
+      }
+      auto send_buffer = create_compressed_send_buffer( frame );
+      if( send_buffer != frame )
+         sent_compression.add( frame->size(), send_buffer->size() );
+      enqueue_buffer( send_buffer, no_reason, queue );
+   }
+
+   bool connection::batch_transactions()const {
+      return my_impl->trx_batch_window != fc::microseconds() && protocol_version >= trx_batches;
+   }
+
+   // called from connection strand
+   void connection::enqueue_batched_trx( const std::shared_ptr<shared_send_buffer>& trx ) {
+      static const size_t which_size = fc::raw::pack_size( unsigned_int( packed_transaction_which ) );
+      pending_trx_batch_size += trx->frame()->size() - message_header_size - which_size;
+      pending_trx_batch.push_back( trx );
+      if( pending_trx_batch_size >= max_trx_batch_size ) {
+         send_trx_batch();
+      } else if( pending_trx_batch.size() == 1 ) {
+         trx_batch_timer.expires_from_now( std::chrono::microseconds( my_impl->trx_batch_window.count() ) );
+         trx_batch_timer.async_wait( boost::asio::bind_executor( strand,
+               [c = shared_from_this()]( boost::system::error_code ec ) {
+            // a batch sent when full may leave this running for the next one, which is then sent early
+            if( ec || !c->socket_is_open() ) return;
+            c->send_trx_batch();
+         } ) );
+      }
+   }
+
+   // called from connection strand
+   void connection::send_trx_batch() {
+      if( pending_trx_batch.empty() ) return;
+      if( pending_trx_batch.size() == 1 ) {
+         enqueue_buffer( pending_trx_batch.front()->get( *this ), no_reason, trx_queue );
+      } else {
+         // the frames hold the which of packed_transaction followed by the packed transaction, which is what
+         // vector<packed_transaction> is packed from
+         static const size_t trx_which_size = fc::raw::pack_size( unsigned_int( packed_transaction_which ) );
+         const uint32_t which_size = fc::raw::pack_size( unsigned_int( packed_transactions_which ) );
+         const uint32_t count_size = fc::raw::pack_size( unsigned_int( pending_trx_batch.size() ) );
+         const uint32_t payload_size = which_size + count_size + pending_trx_batch_size;
+
+         const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
+         constexpr size_t header_size = sizeof( payload_size );
+         static_assert( header_size == message_header_size, "invalid message_header_size" );
+         const size_t buffer_size = header_size + payload_size;
+
+         auto send_buffer = net_buffer_pool::instance().get( buffer_size );
+         fc::datastream<char*> ds( send_buffer->data(), buffer_size );
+         ds.write( header, header_size );
+         fc::raw::pack( ds, unsigned_int( packed_transactions_which ) );
+         fc::raw::pack( ds, unsigned_int( pending_trx_batch.size() ) );
+         for( const auto& trx : pending_trx_batch ) {
+            const auto& frame = trx->frame();
+            ds.write( frame->data() + message_header_size + trx_which_size, frame->size() - message_header_size - trx_which_size );
+         }
+         fc_dlog( logger, "sending ${n} trxs to ${p} in one batch", ("n", pending_trx_batch.size())("p", peer_name()) );
+         enqueue_compressible( send_buffer, trx_queue );
+      }
+      pending_trx_batch.clear();
+      pending_trx_batch_size = 0;
+   }
+
+   // called from connection strand
+   bool connection::enqueue_compact_block( const signed_block_ptr& b ) {
+      if( !my_impl->use_compact_blocks || protocol_version < compact_blocks ) return false;
+
+      compact_block_message msg;
+      static_cast<signed_block_header&>( msg.block ) = *b;
+      msg.block.block_extensions = b->block_extensions;
+      msg.block.transactions.reserve( b->transactions.size() );
+      for( const auto& receipt : b->transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            const auto& id = receipt.trx.get<packed_transaction>().id();
+            if( my_impl->dispatcher->peer_has_txn( id, connection_id ) ) {
+               msg.elided.push_back( msg.block.transactions.size() );
+               msg.block.transactions.emplace_back( id );
+               static_cast<transaction_receipt_header&>( msg.block.transactions.back() ) = receipt;
+               continue;
+            }
+         }
+         msg.block.transactions.push_back( receipt );
+      }
+      if( msg.elided.empty() ) return false;
+
+      fc_dlog( logger, "enqueue compact block ${num}, ${e} of ${t} transactions elided",
+               ("num", b->block_num())("e", msg.elided.size())("t", b->transactions.size()) );
+      enqueue_buffer( create_send_buffer( compact_block_which, msg ), no_reason, live_block_queue );
+      return true;
+   }
+
    void connection::enqueue_block( const signed_block_ptr& sb, bool to_sync_queue) {
       fc_dlog( logger, "enqueue block ${num}", ("num", sb->block_num()) );
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
-      enqueue_buffer( create_send_buffer( sb ), no_reason, to_sync_queue);
+      enqueue_compressible( create_send_buffer( sb ), to_sync_queue ? sync_block_queue : live_block_queue );
+   }
+
+   // called from connection strand
+   void connection::throttle_queue_write() {
+      const fc::microseconds delay = buffer_queue.trx_throttle_delay();
+      if( delay == fc::microseconds() || write_throttle_pending ) return;
+      write_throttle_pending = true;
+      write_throttle_timer.expires_from_now( std::chrono::microseconds( delay.count() ) );
+      write_throttle_timer.async_wait( boost::asio::bind_executor( strand,
+            [c = shared_from_this()]( boost::system::error_code ec ) {
+         c->write_throttle_pending = false;
+         if( ec || !c->socket_is_open() ) return;
+         c->do_queue_write();
+      } ) );
+   }
+
+   void connection::enqueue_serialized_block( uint32_t num, const std::vector<char>& block_data, bool to_sync_queue ) {
+      fc_dlog( logger, "enqueue serialized block ${num}", ("num", num) );
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      enqueue_compressible( create_send_buffer_from_serialized_block( block_data ),
+                            to_sync_queue ? sync_block_queue : live_block_queue );
    }
 
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                                     go_away_reason close_after_send,
-                                    bool to_sync_queue)
+                                    write_queue_type queue)
    {
+      // frames start with the message length followed by the single byte varint of the net_message which
+      if( send_buffer->size() > message_header_size )
+         counters.sent( static_cast<uint8_t>( (*send_buffer)[message_header_size] ), send_buffer->size() );
       connection_ptr self = shared_from_this();
       queue_write(send_buffer,
             [conn{std::move(self)}, close_after_send](boost::system::error_code ec, std::size_t ) {
@@ -1262,7 +2194,7 @@ namespace eosio {
                            return;
                         }
                   },
-                  to_sync_queue);
+                  queue);
    }
 
    // thread safe
@@ -1296,6 +2228,7 @@ namespace eosio {
    // called from connection strand
    void connection::sync_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         ++performance.stalls;
          my_impl->sync_master->sync_reassign_fetch( shared_from_this(), benign_other );
       } else if( ec == boost::asio::error::operation_aborted ) {
       } else {
@@ -1306,6 +2239,10 @@ namespace eosio {
    // locks conn_mtx, do not call while holding conn_mtx
    const string connection::peer_name() {
       std::lock_guard<std::mutex> g_conn( conn_mtx );
+      return peer_name_locked();
+   }
+
+   const string connection::peer_name_locked()const {
       if( !last_handshake_recv.p2p_address.empty() ) {
          return last_handshake_recv.p2p_address;
       }
@@ -1320,6 +2257,7 @@ namespace eosio {
 
    void connection::fetch_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         ++performance.stalls;
          my_impl->dispatcher->retry_fetch( shared_from_this() );
       } else if( ec == boost::asio::error::operation_aborted ) {
          if( !connected() ) {
@@ -1338,13 +2276,15 @@ namespace eosio {
 
    //-----------------------------------------------------------
 
-    sync_manager::sync_manager( uint32_t req_span )
+    sync_manager::sync_manager( uint32_t req_span, uint32_t max_spans, bool headers_first )
       :sync_known_lib_num( 0 )
       ,sync_last_requested_num( 0 )
       ,sync_next_expected_num( 1 )
       ,sync_req_span( req_span )
+      ,sync_max_spans( max_spans )
       ,sync_source()
       ,sync_state(in_sync)
+      ,sync_headers_first( headers_first )
    {
    }
 
@@ -1369,6 +2309,9 @@ namespace eosio {
       std::unique_lock<std::mutex> g( sync_mtx );
       if( sync_state == in_sync ) {
          sync_source.reset();
+         sync_spans.clear();
+         sync_reorder_buffer.clear();
+         reset_headers();
       }
       if( !c ) return;
       if( c->current() ) {
@@ -1376,112 +2319,226 @@ namespace eosio {
          if( c->last_handshake_recv.last_irreversible_block_num > sync_known_lib_num ) {
             sync_known_lib_num = c->last_handshake_recv.last_irreversible_block_num;
          }
-      } else if( c == sync_source ) {
-         sync_last_requested_num = 0;
-         request_next_chunk( std::move(g) );
+      } else {
+         auto span = find_span( c );
+         const bool was_header_source = c == header_source;
+         if( was_header_source ) header_source.reset();
+         if( span != sync_spans.end() ) span->source.reset();
+         if( span != sync_spans.end() || was_header_source ) {
+            request_next_chunk( std::move(g) );
+         }
       }
    }
 
    // call with g_sync locked
-   void sync_manager::request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn ) {
-      uint32_t fork_head_block_num = 0;
-      uint32_t lib_block_num = 0;
-      std::tie( lib_block_num, std::ignore, fork_head_block_num,
-                std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+   bool sync_manager::can_request_span()const {
+      const uint32_t limit = sync_request_limit();
+      if( sync_spans.size() >= sync_max_spans || sync_last_requested_num >= limit ) return false;
+      const uint32_t start = std::max( sync_last_requested_num + 1, sync_next_expected_num );
+      if( start > limit ) return false;
+      // only full spans, or the last one up to the limit, within the window of blocks not yet applied
+      const uint32_t window_end = sync_next_expected_num + sync_max_spans * sync_req_span - 1;
+      return std::min( start + sync_req_span - 1, limit ) <= window_end;
+   }
 
-      fc_dlog( logger, "sync_last_requested_num: ${r}, sync_next_expected_num: ${e}, sync_known_lib_num: ${k}, sync_req_span: ${s}",
-               ("r", sync_last_requested_num)("e", sync_next_expected_num)("k", sync_known_lib_num)("s", sync_req_span) );
+   // call with g_sync locked
+   bool sync_manager::headers_active()const {
+      return sync_headers_first && !header_sync_failed && sync_state == lib_catchup;
+   }
 
-      if( fork_head_block_num < sync_last_requested_num && sync_source && sync_source->current() ) {
-         fc_ilog( logger, "ignoring request, head is ${h} last req = ${r} source is ${p}",
-                  ("h", fork_head_block_num)( "r", sync_last_requested_num )( "p", sync_source->peer_name() ) );
-         return;
+   // call with g_sync locked
+   uint32_t sync_manager::sync_request_limit()const {
+      if( !headers_active() ) return sync_known_lib_num;
+      return header_state ? std::min( header_state->block_num, sync_known_lib_num ) : 0;
+   }
+
+   // call with g_sync locked
+   void sync_manager::reset_headers() {
+      header_sync_failed = false;
+      header_base_pending = false;
+      header_state.reset();
+      header_source.reset();
+      verified_ids.clear();
+   }
+
+   // call with g_sync locked
+   std::tuple<connection_ptr, uint32_t, uint32_t> sync_manager::next_header_request() {
+      if( !headers_active() || header_source || header_base_pending ) return {};
+      if( !header_state ) {
+         // headers are verified starting from our head block
+         header_base_pending = true;
+         app().post( priority::medium, [this]() {
+            block_header_state_ptr head = my_impl->chain_plug->chain().head_block_state();
+            std::unique_lock<std::mutex> g( sync_mtx );
+            if( !header_base_pending ) return;
+            header_base_pending = false;
+            if( headers_active() && !header_state ) {
+               header_state = std::move( head );
+               request_next_chunk( std::move( g ) );
+            }
+         } );
+         return {};
+      }
+      const uint32_t verified_num = header_state->block_num;
+      // keep the verified headers ahead of the blocks by at most two batches or parallel windows
+      const uint32_t lookahead = 2 * std::max<uint32_t>( def_max_sync_headers, sync_max_spans * sync_req_span );
+      if( verified_num >= sync_known_lib_num || verified_num >= sync_next_expected_num + lookahead ) return {};
+
+      connection_ptr best;
+      int64_t best_score = 0;
+      for_each_block_connection( [this, &best, &best_score]( const auto& c ) {
+         if( c->current() && c->protocol_version >= header_sync && find_span( c ) == sync_spans.end() ) {
+            const int64_t score = c->performance.score();
+            if( !best || score < best_score ) {
+               best = c;
+               best_score = score;
+            }
+         }
+         return true;
+      } );
+      if( !best ) {
+         fc_ilog( logger, "no peer for header-first sync, requesting blocks without verified headers" );
+         header_sync_failed = true;
+         return {};
+      }
+      header_source = best;
+      const uint32_t start = verified_num + 1;
+      return std::make_tuple( best, start, std::min( start + def_max_sync_headers - 1, sync_known_lib_num ) );
+   }
+
+   // call with g_sync locked
+   deque<sync_manager::sync_span>::iterator sync_manager::find_span( const connection_ptr& c ) {
+      return std::find_if( sync_spans.begin(), sync_spans.end(), [&c]( const auto& span ) { return span.source == c; } );
+   }
+
+   // call with g_sync locked
+   void sync_manager::reset_spans() {
+      for( const auto& span : sync_spans ) {
+         if( span.source ) {
+            span.source->strand.post( [c = span.source]() {
+               c->cancel_sync( benign_other );
+            } );
+         }
       }
+      sync_spans.clear();
+      sync_reorder_buffer.clear();
+      sync_last_requested_num = 0;
+   }
+
+   // call with g_sync locked
+   connection_ptr sync_manager::next_sync_source( const connection_ptr& conn ) {
+      auto usable = [this]( const connection_ptr& c ) {
+         return c->current() && !c->is_transactions_only_connection() && find_span( c ) == sync_spans.end() &&
+                c != header_source;
+      };
 
       /* ----------
-       * next chunk provider selection criteria
-       * a provider is supplied and able to be used, use it.
-       * otherwise select the next available from the list, round-robin style.
+       * next span provider selection criteria
+       * the usable peer with the lowest performance score, skipping peers already serving a span.
+       * ties go to a supplied provider, then to the next available from the list, round-robin style.
        */
 
-      if (conn && conn->current() ) {
-         sync_source = conn;
-      } else {
-         std::shared_lock<std::shared_mutex> g( my_impl->connections_mtx );
-         if( my_impl->connections.size() == 0 ) {
-            sync_source.reset();
-         } else if( my_impl->connections.size() == 1 ) {
-            if (!sync_source) {
-               sync_source = *my_impl->connections.begin();
-            }
-         } else {
-            // init to a linear array search
-            auto cptr = my_impl->connections.begin();
-            auto cend = my_impl->connections.end();
-            // do we remember the previous source?
-            if (sync_source) {
-               //try to find it in the list
-               cptr = my_impl->connections.find( sync_source );
-               cend = cptr;
-               if( cptr == my_impl->connections.end() ) {
-                  //not there - must have been closed! cend is now connections.end, so just flatten the ring.
-                  sync_source.reset();
-                  cptr = my_impl->connections.begin();
-               } else {
-                  //was found - advance the start to the next. cend is the old source.
-                  if( ++cptr == my_impl->connections.end() && cend != my_impl->connections.end() ) {
-                     cptr = my_impl->connections.begin();
-                  }
-               }
-            }
+      connection_ptr best;
+      int64_t best_score = 0;
+      auto consider = [&]( const connection_ptr& c ) {
+         if( !usable( c ) ) return;
+         const int64_t score = c->performance.score();
+         if( !best || score < best_score ) {
+            best = c;
+            best_score = score;
+         }
+      };
 
-            //scan the list of peers looking for another able to provide sync blocks.
-            if( cptr != my_impl->connections.end() ) {
-               auto cstart_it = cptr;
-               do {
-                  //select the first one which is current and break out.
-                  if( !(*cptr)->is_transactions_only_connection() && (*cptr)->current() ) {
-                     sync_source = *cptr;
-                     break;
-                  }
-                  if( ++cptr == my_impl->connections.end() )
-                     cptr = my_impl->connections.begin();
-               } while( cptr != cstart_it );
-            }
-            // no need to check the result, either source advanced or the whole list was checked and the old source is reused.
+      if( conn ) consider( conn );
+
+      std::shared_lock<std::shared_mutex> g( my_impl->connections_mtx );
+      if( !my_impl->connections.empty() ) {
+         // start after the previous source, which is checked last
+         auto cptr = my_impl->connections.begin();
+         if( sync_source ) {
+            cptr = my_impl->connections.upper_bound( sync_source );
+            if( cptr == my_impl->connections.end() )
+               cptr = my_impl->connections.begin();
          }
+         auto cstart_it = cptr;
+         do {
+            if( *cptr != conn ) consider( *cptr );
+            if( ++cptr == my_impl->connections.end() )
+               cptr = my_impl->connections.begin();
+         } while( cptr != cstart_it );
+      }
+      if( best ) sync_source = best;
+      return best;
+   }
+
+   // call with g_sync locked
+   void sync_manager::request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn ) {
+      uint32_t lib_block_num = 0;
+      std::tie( lib_block_num, std::ignore, std::ignore,
+                std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+
+      fc_dlog( logger, "sync_last_requested_num: ${r}, sync_next_expected_num: ${e}, sync_known_lib_num: ${k}, sync_req_span: ${s}",
+               ("r", sync_last_requested_num)("e", sync_next_expected_num)("k", sync_known_lib_num)("s", sync_req_span) );
+
+      // spans left by a stalled or closed peer are handed out first, then new spans while the window allows
+      vector<std::tuple<connection_ptr, uint32_t, uint32_t>> requests;
+      const auto now = fc::time_point::now();
+      for( auto& span : sync_spans ) {
+         if( span.source ) continue;
+         span.source = next_sync_source( conn );
+         if( !span.source ) break;
+         span.last_recv = now;
+         requests.emplace_back( span.source, span.next_num, span.end_num );
+      }
+      // header source is chosen first, it does not also serve a span
+      auto header_request = next_header_request();
+      while( can_request_span() ) {
+         connection_ptr c = next_sync_source( conn );
+         if( !c ) break;
+         uint32_t start = std::max( sync_last_requested_num + 1, sync_next_expected_num );
+         uint32_t end = std::min( start + sync_req_span - 1, sync_request_limit() );
+         sync_last_requested_num = end;
+         sync_spans.push_back( sync_span{ start, end, c, now } );
+         requests.emplace_back( c, start, end );
       }
 
       // verify there is an available source
-      if( !sync_source || !sync_source->current() || sync_source->is_transactions_only_connection() ) {
+      const bool have_source = std::any_of( sync_spans.begin(), sync_spans.end(), []( const auto& span ) { return !!span.source; } ) ||
+                               header_source || header_base_pending;
+      if( !have_source && (!sync_spans.empty() || !sync_source || !sync_source->current()) ) {
          fc_elog( logger, "Unable to continue syncing at this time");
          sync_known_lib_num = lib_block_num;
+         sync_spans.clear();
+         sync_reorder_buffer.clear();
          sync_last_requested_num = 0;
+         reset_headers();
          set_state( in_sync ); // probably not, but we can't do anything else
          return;
       }
 
-      bool request_sent = false;
-      if( sync_last_requested_num != sync_known_lib_num ) {
-         uint32_t start = sync_next_expected_num;
-         uint32_t end = start + sync_req_span - 1;
-         if( end > sync_known_lib_num )
-            end = sync_known_lib_num;
-         if( end > 0 && end >= start ) {
-            sync_last_requested_num = end;
-            connection_ptr c = sync_source;
-            g_sync.unlock();
-            request_sent = true;
-            c->strand.post( [c, start, end]() {
-               fc_ilog( logger, "requesting range ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
-               c->request_sync_blocks( start, end );
-            } );
-         }
+      connection_ptr handshake_source;
+      if( requests.empty() && sync_spans.empty() && sync_last_requested_num >= sync_known_lib_num ) {
+         handshake_source = sync_source;
       }
-      if( !request_sent ) {
-         connection_ptr c = sync_source;
-         g_sync.unlock();
-         c->send_handshake();
+      g_sync.unlock();
+
+      for( auto& r : requests ) {
+         connection_ptr c = std::get<0>( r );
+         c->strand.post( [c, start = std::get<1>( r ), end = std::get<2>( r )]() {
+            fc_ilog( logger, "requesting range ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
+            c->request_sync_blocks( start, end );
+         } );
+      }
+      if( std::get<0>( header_request ) ) {
+         connection_ptr c = std::get<0>( header_request );
+         c->strand.post( [c, start = std::get<1>( header_request ), end = std::get<2>( header_request )]() {
+            fc_ilog( logger, "requesting headers ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
+            c->enqueue( block_headers_request_message{ start, end } );
+            c->sync_wait();
+         } );
+      }
+      if( handshake_source ) {
+         handshake_source->send_handshake();
       }
    }
 
@@ -1524,6 +2581,7 @@ namespace eosio {
       if( sync_state == in_sync ) {
          set_state( lib_catchup );
          sync_next_expected_num = std::max( lib_num + 1, sync_next_expected_num );
+         reset_headers();
       }
 
       fc_ilog( logger, "Catching up with chain, our last req is ${cc}, theirs is ${t} peer ${p}",
@@ -1538,9 +2596,16 @@ namespace eosio {
       fc_ilog( logger, "reassign_fetch, our last req is ${cc}, next expected is ${ne} peer ${p}",
                ("cc", sync_last_requested_num)( "ne", sync_next_expected_num )( "p", c->peer_name() ) );
 
-      if( c == sync_source ) {
+      auto span = find_span( c );
+      if( span != sync_spans.end() ) {
          c->cancel_sync(reason);
-         sync_last_requested_num = 0;
+         // the rest of the span goes to the next peer, c is tried last
+         span->source.reset();
+         sync_source = c;
+         request_next_chunk( std::move(g) );
+      } else if( c == header_source ) {
+         // headers are asked of the next fastest peer
+         header_source.reset();
          request_next_chunk( std::move(g) );
       }
    }
@@ -1725,16 +2790,75 @@ namespace eosio {
       }
    }
 
+   // called from connection strand
+   void sync_manager::sync_recv_headers( const connection_ptr& c, const block_headers_message& msg ) {
+      std::unique_lock<std::mutex> g( sync_mtx );
+      if( c != header_source || !headers_active() || !header_state ) {
+         fc_dlog( logger, "ignoring block headers not requested from ${p}", ("p", c->peer_name()) );
+         return;
+      }
+      c->cancel_wait();
+      block_header_state_ptr base = header_state;
+      g.unlock();
+
+      // signature recovery of the headers is done on the thread pool, off the connection strand
+      boost::asio::post( my_impl->thread_pool->get_executor(), [this, c, msg, base{std::move(base)}]() {
+         block_header_state_ptr verified = base;
+         vector<block_id_type> ids;
+         try {
+            EOS_ASSERT( !msg.headers.empty() && msg.headers.size() <= def_max_sync_headers, plugin_exception,
+                        "invalid number of block headers ${n}", ("n", msg.headers.size()) );
+            const auto& pfs = my_impl->chain_plug->chain().get_protocol_feature_manager().get_protocol_feature_set();
+            ids.reserve( msg.headers.size() );
+            for( const auto& h : msg.headers ) {
+               EOS_ASSERT( h.previous == verified->id, plugin_exception, "block header ${n} does not link to ${id}",
+                           ("n", h.block_num())("id", verified->id) );
+               // activated protocol features, like the rest of the block, are validated when the block is applied
+               verified = std::make_shared<block_header_state>( verified->next( h, {}, pfs,
+                     []( block_timestamp_type, const flat_set<digest_type>&, const vector<digest_type>& ) {} ) );
+               ids.push_back( verified->id );
+            }
+         } catch( const fc::exception& e ) {
+            fc_wlog( logger, "block headers from ${p} not verified, requesting blocks without verified headers: ${e}",
+                     ("p", c->peer_name())("e", e.to_string()) );
+            verified.reset();
+         }
+
+         std::unique_lock<std::mutex> g( sync_mtx );
+         if( c != header_source || header_state != base ) return; // headers reset while verifying
+         header_source.reset();
+         if( verified ) {
+            uint32_t num = base->block_num;
+            for( auto& id : ids ) {
+               verified_ids.emplace( ++num, std::move( id ) );
+            }
+            header_state = std::move( verified );
+         } else {
+            ++c->performance.rejected;
+            header_sync_failed = true;
+         }
+         request_next_chunk( std::move( g ) );
+      } );
+   }
+
    // called from connection strand
    void sync_manager::rejected_block( const connection_ptr& c, uint32_t blk_num ) {
       std::unique_lock<std::mutex> g( sync_mtx );
+      ++c->performance.rejected;
       if( ++c->consecutive_rejected_blocks > def_max_consecutive_rejected_blocks ) {
          fc_wlog( logger, "block ${bn} not accepted from ${p}, closing connection", ("bn", blk_num)("p", c->peer_name()) );
-         sync_last_requested_num = 0;
+         reset_spans();
          sync_source.reset();
          g.unlock();
          c->close();
       } else {
+         if( sync_state == lib_catchup && !sync_reorder_buffer.empty() ) {
+            // blocks buffered behind the rejected one can not be applied, request them again
+            reset_spans();
+            request_next_chunk( std::move(g) );
+         } else {
+            g.unlock();
+         }
          c->send_handshake();
       }
    }
@@ -1753,7 +2877,69 @@ namespace eosio {
             return;
          }
          sync_next_expected_num = blk_num + 1;
+
+         verified_ids.erase( verified_ids.begin(), verified_ids.lower_bound( sync_next_expected_num ) );
+         sync_reorder_buffer.erase( sync_reorder_buffer.begin(), sync_reorder_buffer.lower_bound( sync_next_expected_num ) );
+         auto next = sync_reorder_buffer.find( sync_next_expected_num );
+         if( next != sync_reorder_buffer.end() ) {
+            buffered_block b = std::move( next->second );
+            sync_reorder_buffer.erase( next );
+            g_sync.unlock();
+            app().post( priority::high, [b{std::move(b)}]() {
+               b.source->process_signed_block( b.id, b.block, true );
+            } );
+         }
+      }
+   }
+
+   // called from connection strand
+   bool sync_manager::sync_recv_span_block( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, const signed_block_ptr& b ) {
+      std::unique_lock<std::mutex> g_sync( sync_mtx );
+      if( sync_state != lib_catchup ) return false;
+
+      auto span = find_span( c );
+      if( span == sync_spans.end() || blk_num < span->next_num || blk_num > span->end_num ) {
+         if( blk_num > sync_next_expected_num ) {
+            // left over from a span that was reassigned or reset, it could not be linked
+            fc_dlog( logger, "dropping sync block ${bn} not requested from ${p}", ("bn", blk_num)("p", c->peer_name()) );
+            return true;
+         }
+         return false;
+      }
+
+      auto vid = verified_ids.find( blk_num );
+      if( vid != verified_ids.end() && vid->second != blk_id ) {
+         fc_wlog( logger, "sync block ${bn} from ${p} does not match its verified header, requesting the span elsewhere",
+                  ("bn", blk_num)("p", c->peer_name()) );
+         ++c->performance.rejected;
+         span->source.reset();
+         sync_source = c;
+         c->cancel_sync( benign_other );
+         request_next_chunk( std::move( g_sync ) );
+         return true;
       }
+
+      span->next_num = blk_num + 1;
+      const auto now = fc::time_point::now();
+      c->performance.add_block_interval( now - span->last_recv );
+      span->last_recv = now;
+      bool buffered = false;
+      if( b && blk_num > sync_next_expected_num ) {
+         sync_reorder_buffer[blk_num] = buffered_block{ c, blk_id, b };
+         buffered = true;
+      }
+      if( blk_num == span->end_num ) {
+         sync_spans.erase( span );
+         c->performance.span_completed();
+         c->cancel_wait();
+         if( can_request_span() ) {
+            request_next_chunk( std::move( g_sync ) );
+         }
+      } else {
+         g_sync.unlock();
+         c->sync_wait();
+      }
+      return buffered;
    }
 
    // called from connection strand
@@ -1771,6 +2957,9 @@ namespace eosio {
       if( state == head_catchup ) {
          fc_dlog( logger, "sync_manager in head_catchup state" );
          sync_source.reset();
+         sync_spans.clear();
+         sync_reorder_buffer.clear();
+         reset_headers();
          g_sync.unlock();
 
          block_id_type null_id;
@@ -1802,14 +2991,13 @@ namespace eosio {
          if( blk_num == sync_known_lib_num ) {
             fc_dlog( logger, "All caught up with last known last irreversible block resending handshake" );
             set_state( in_sync );
+            sync_spans.clear();
+            sync_reorder_buffer.clear();
             g_sync.unlock();
             send_handshakes();
-         } else if( blk_num == sync_last_requested_num ) {
+         } else if( can_request_span() ) {
+            // applying blocks opened the window for another span
             request_next_chunk( std::move( g_sync) );
-         } else {
-            g_sync.unlock();
-            fc_dlog( logger, "calling sync_wait on connection ${p}", ("p", c->peer_name()) );
-            c->sync_wait();
          }
       }
    }
@@ -1818,13 +3006,14 @@ namespace eosio {
 
    // thread safe
    bool dispatch_manager::add_peer_block( const block_id_type& blkid, uint32_t connection_id) {
-      std::lock_guard<std::mutex> g( blk_state_mtx );
-      auto bptr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      bool added = (bptr == blk_state.end());
+      auto& shard = blk_state.get( blkid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto bptr = shard.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      bool added = (bptr == shard.index.end());
       if( added ) {
-         blk_state.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
+         shard.index.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
       } else if( !bptr->have_block ) {
-         blk_state.modify( bptr, []( auto& pb ) {
+         shard.index.modify( bptr, []( auto& pb ) {
             pb.have_block = true;
          });
       }
@@ -1832,25 +3021,28 @@ namespace eosio {
    }
 
    bool dispatch_manager::add_peer_block_id( const block_id_type& blkid, uint32_t connection_id) {
-      std::lock_guard<std::mutex> g( blk_state_mtx );
-      auto bptr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      bool added = (bptr == blk_state.end());
+      auto& shard = blk_state.get( blkid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto bptr = shard.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      bool added = (bptr == shard.index.end());
       if( added ) {
-         blk_state.insert( {blkid, block_header::num_from_id( blkid ), connection_id, false} );
+         shard.index.insert( {blkid, block_header::num_from_id( blkid ), connection_id, false} );
       }
       return added;
    }
 
    bool dispatch_manager::peer_has_block( const block_id_type& blkid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      const auto blk_itr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      return blk_itr != blk_state.end();
+      const auto& shard = blk_state.get( blkid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      const auto blk_itr = shard.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      return blk_itr != shard.index.end();
    }
 
    bool dispatch_manager::have_block( const block_id_type& blkid ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
+      const auto& shard = blk_state.get( blkid );
+      std::lock_guard<std::mutex> g( shard.mtx );
       // by_block_id sorts have_block by greater so have_block == true will be the first one found
-      const auto& index = blk_state.get<by_block_id>();
+      const auto& index = shard.index.get<by_block_id>();
       auto blk_itr = index.find( blkid );
       if( blk_itr != index.end() ) {
          return blk_itr->have_block;
@@ -1859,85 +3051,101 @@ namespace eosio {
    }
 
    size_t dispatch_manager::num_entries( uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      return blk_state.get<by_id>().count( connection_id );
+      size_t count = 0;
+      for( const auto& shard : blk_state.shards() ) {
+         std::lock_guard<std::mutex> g( shard.mtx );
+         count += shard.index.get<by_id>().count( connection_id );
+      }
+      return count;
    }
 
    bool dispatch_manager::add_peer_txn( const node_transaction_state& nts ) {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
-      bool added = (tptr == local_txns.end());
+      auto& shard = local_txns.get( nts.id );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto tptr = shard.index.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
+      bool added = (tptr == shard.index.end());
       if( added ) {
-         local_txns.insert( nts );
+         shard.index.insert( nts );
       }
       return added;
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const signed_block_ptr& sb ) {
-      update_block_num ubn( sb->block_num() );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
       for( const auto& recpt : sb->transactions ) {
          const transaction_id_type& id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>()
                                                                   : recpt.trx.get<packed_transaction>().id();
-         auto range = local_txns.get<by_id>().equal_range( id );
-         for( auto itr = range.first; itr != range.second; ++itr ) {
-            local_txns.modify( itr, ubn );
-         }
+         update_txns_block_num( id, sb->block_num() );
       }
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const transaction_id_type& id, uint32_t blk_num ) {
       update_block_num ubn( blk_num );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto range = local_txns.get<by_id>().equal_range( id );
+      auto& shard = local_txns.get( id );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto range = shard.index.get<by_id>().equal_range( id );
       for( auto itr = range.first; itr != range.second; ++itr ) {
-         local_txns.modify( itr, ubn );
+         shard.index.modify( itr, ubn );
       }
    }
 
    bool dispatch_manager::peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
-      return tptr != local_txns.end();
+      const auto& shard = local_txns.get( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      const auto tptr = shard.index.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
+      return tptr != shard.index.end();
    }
 
    bool dispatch_manager::have_txn( const transaction_id_type& tid ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( tid );
-      return tptr != local_txns.end();
+      const auto& shard = local_txns.get( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      const auto tptr = shard.index.get<by_id>().find( tid );
+      return tptr != shard.index.end();
+   }
+
+   packed_transaction_ptr dispatch_manager::find_txn( const transaction_id_type& tid ) const {
+      const auto& shard = local_txns.get( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto range = shard.index.get<by_id>().equal_range( tid );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         if( itr->trx ) return itr->trx;
+      }
+      return packed_transaction_ptr();
    }
 
    void dispatch_manager::expire_txns( uint32_t lib_num ) {
       size_t start_size = 0, end_size = 0;
 
-      std::unique_lock<std::mutex> g( local_txns_mtx );
-      start_size = local_txns.size();
-      auto& old = local_txns.get<by_expiry>();
-      auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
-      auto ex_up = old.upper_bound( time_point::now() );
-      old.erase( ex_lo, ex_up );
-      g.unlock(); // allow other threads opportunity to use local_txns
-
-      g.lock();
-      auto& stale = local_txns.get<by_block_num>();
-      stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
-      end_size = local_txns.size();
-      g.unlock();
+      // one shard at a time to give other threads opportunity to use local_txns
+      for( auto& shard : local_txns.shards() ) {
+         std::lock_guard<std::mutex> g( shard.mtx );
+         start_size += shard.index.size();
+         auto& old = shard.index.get<by_expiry>();
+         auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
+         auto ex_up = old.upper_bound( time_point::now() );
+         old.erase( ex_lo, ex_up );
+
+         auto& stale = shard.index.get<by_block_num>();
+         stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
+         end_size += shard.index.size();
+      }
 
       fc_dlog( logger, "expire_local_txns size ${s} removed ${r}", ("s", start_size)( "r", start_size - end_size ) );
    }
 
    void dispatch_manager::expire_blocks( uint32_t lib_num ) {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      auto& stale_blk = blk_state.get<by_block_num>();
-      stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+      for( auto& shard : blk_state.shards() ) {
+         std::lock_guard<std::mutex> g( shard.mtx );
+         auto& stale_blk = shard.index.get<by_block_num>();
+         stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+      }
    }
 
    // thread safe
-   void dispatch_manager::bcast_block(const block_state_ptr& bs) {
-      fc_dlog( logger, "bcast block ${b}", ("b", bs->block_num) );
+   void dispatch_manager::bcast_block(const signed_block_ptr& b, const block_id_type& id,
+                                      const std::shared_ptr<const std::vector<char>>& packed) {
+      fc_dlog( logger, "bcast block ${b}", ("b", b->block_num()) );
 
       bool have_connection = false;
       for_each_block_connection( [&have_connection]( auto& cp ) {
@@ -1952,24 +3160,28 @@ namespace eosio {
       } );
 
       if( !have_connection ) return;
-      std::shared_ptr<std::vector<char>> send_buffer = create_send_buffer( bs->block );
+      auto send_buffer = std::make_shared<shared_send_buffer>( packed ? create_send_buffer_from_serialized_block( *packed )
+                                                                       : create_send_buffer( b ) );
 
-      for_each_block_connection( [this, bs, send_buffer]( auto& cp ) {
+      for_each_block_connection( [this, b, id, send_buffer]( auto& cp ) {
          if( !cp->current() ) {
             return true;
          }
-         cp->strand.post( [this, cp, bs, send_buffer]() {
-            uint32_t bnum = bs->block_num;
+         cp->strand.post( [this, cp, b, id, send_buffer]() {
+            uint32_t bnum = block_header::num_from_id( id );
             std::unique_lock<std::mutex> g_conn( cp->conn_mtx );
             bool has_block = cp->last_handshake_recv.last_irreversible_block_num >= bnum;
             g_conn.unlock();
             if( !has_block ) {
-               if( !add_peer_block( bs->id, cp->connection_id ) ) {
+               // a block relayed early is not sent again once it is accepted
+               if( !add_peer_block( id, cp->connection_id ) ) {
                   fc_dlog( logger, "not bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
                   return;
                }
                fc_dlog( logger, "bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
-               cp->enqueue_buffer( send_buffer, no_reason );
+               if( !cp->enqueue_compact_block( b ) ) {
+                  cp->enqueue_buffer( send_buffer->get( *cp ), no_reason, live_block_queue );
+               }
             }
          });
          return true;
@@ -2024,12 +3236,12 @@ namespace eosio {
       fc_dlog( logger, "rejected block ${id}", ("id", id) );
    }
 
-   void dispatch_manager::bcast_transaction(const packed_transaction& trx) {
-      const auto& id = trx.id();
-      time_point_sec trx_expiration = trx.expiration();
-      node_transaction_state nts = {id, trx_expiration, 0, 0};
+   void dispatch_manager::bcast_transaction(const packed_transaction_ptr& trx) {
+      const auto& id = trx->id();
+      time_point_sec trx_expiration = trx->expiration();
+      node_transaction_state nts = {id, trx_expiration, 0, 0, trx};
 
-      std::shared_ptr<std::vector<char>> send_buffer;
+      std::shared_ptr<shared_send_buffer> send_buffer;
       for_each_connection( [this, &trx, &nts, &send_buffer]( auto& cp ) {
          if( cp->is_blocks_only_connection() || !cp->current() ) {
             return true;
@@ -2039,12 +3251,16 @@ namespace eosio {
             return true;
          }
          if( !send_buffer ) {
-            send_buffer = create_send_buffer( trx );
+            send_buffer = std::make_shared<shared_send_buffer>( create_send_buffer( *trx ) );
          }
 
          cp->strand.post( [cp, send_buffer]() {
             fc_dlog( logger, "sending trx to ${n}", ("n", cp->peer_name()) );
-            cp->enqueue_buffer( send_buffer, no_reason );
+            if( cp->batch_transactions() ) {
+               cp->enqueue_batched_trx( send_buffer );
+            } else {
+               cp->enqueue_buffer( send_buffer->get( *cp ), no_reason, trx_queue );
+            }
          } );
          return true;
       } );
@@ -2109,7 +3325,10 @@ namespace eosio {
          }
          last_req = *c->last_req;
       }
-      for_each_block_connection( [this, &c, &last_req, &bid]( auto& conn ) {
+      // ask the fastest idle peer known to have the block
+      connection_ptr best;
+      int64_t best_score = 0;
+      for_each_block_connection( [this, &c, &bid, &best, &best_score]( auto& conn ) {
          if( conn == c )
             return true;
          {
@@ -2119,18 +3338,24 @@ namespace eosio {
             }
          }
 
-         bool sendit = peer_has_block( bid, conn->connection_id );
-         if( sendit ) {
-            conn->strand.post( [conn, last_req{std::move(last_req)}]() {
-               conn->enqueue( last_req );
-               conn->fetch_wait();
-               std::lock_guard<std::mutex> g_conn_conn( conn->conn_mtx );
-               conn->last_req = last_req;
-            } );
-            return false;
+         if( peer_has_block( bid, conn->connection_id ) ) {
+            const int64_t score = conn->performance.score();
+            if( !best || score < best_score ) {
+               best = conn;
+               best_score = score;
+            }
          }
          return true;
       } );
+      if( best ) {
+         best->strand.post( [conn = best, last_req{std::move(last_req)}]() {
+            conn->enqueue( last_req );
+            conn->fetch_wait();
+            std::lock_guard<std::mutex> g_conn_conn( conn->conn_mtx );
+            conn->last_req = last_req;
+         } );
+         return;
+      }
 
       // at this point no other peer has it, re-request or do nothing?
       fc_wlog( logger, "no peer has last_req" );
@@ -2419,44 +3644,17 @@ namespace eosio {
          auto peek_ds = pending_message_buffer.create_peek_datastream();
          unsigned_int which{};
          fc::raw::unpack( peek_ds, which );
+         counters.received( which, message_length + message_header_size );
          if( which == signed_block_which ) {
             block_header bh;
             fc::raw::unpack( peek_ds, bh );
 
             const block_id_type blk_id = bh.id();
-            const uint32_t blk_num = bh.block_num();
-            if( my_impl->dispatcher->have_block( blk_id ) ) {
-               fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
-                        ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
-               my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
-               cancel_wait();
-
+            if( skip_block( bh, blk_id ) ) {
+               ++counters.messages_dropped;
                pending_message_buffer.advance_read_ptr( message_length );
                return true;
             }
-            fc_dlog( logger, "${p} received block ${num}, id ${id}...",
-                     ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16)) );
-            if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
-               uint32_t lib = 0;
-               std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
-               if( blk_num < lib ) {
-                  std::unique_lock<std::mutex> g( conn_mtx );
-                  const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
-                  g.unlock();
-                  if( blk_num < last_sent_lib ) {
-                     fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
-                     close();
-                  } else {
-                     fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
-                     enqueue( (sync_request_message) {0, 0} );
-                     send_handshake();
-                     cancel_wait();
-                  }
-
-                  pending_message_buffer.advance_read_ptr( message_length );
-                  return true;
-               }
-            }
 
             auto ds = pending_message_buffer.create_datastream();
             fc::raw::unpack( ds, which ); // throw away
@@ -2471,6 +3669,18 @@ namespace eosio {
             fc::raw::unpack( ds, *ptr );
             handle_message( std::move( ptr ) );
 
+         } else if( which == packed_transactions_which ) {
+            auto ds = pending_message_buffer.create_datastream();
+            fc::raw::unpack( ds, which ); // throw away
+            handle_packed_transactions( ds );
+
+         } else if( which == compressed_message_which ) {
+            auto ds = pending_message_buffer.create_datastream();
+            fc::raw::unpack( ds, which ); // throw away
+            compressed_message msg;
+            fc::raw::unpack( ds, msg );
+            process_compressed_message( msg );
+
          } else {
             auto ds = pending_message_buffer.create_datastream();
             net_message msg;
@@ -2488,6 +3698,589 @@ namespace eosio {
       return true;
    }
 
+   bool connection::skip_block( const block_header& bh, const block_id_type& blk_id ) {
+      const uint32_t blk_num = bh.block_num();
+      my_impl->propagation.recv_block( bh, blk_id, peer_name() );
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
+                  ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_span_block( shared_from_this(), blk_id, blk_num, signed_block_ptr() );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
+         return true;
+      }
+      fc_dlog( logger, "${p} received block ${num}, id ${id}...",
+               ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16)) );
+      if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
+         uint32_t lib = 0;
+         std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+         if( blk_num < lib ) {
+            std::unique_lock<std::mutex> g( conn_mtx );
+            const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
+            g.unlock();
+            if( blk_num < last_sent_lib ) {
+               fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
+               close();
+            } else {
+               fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
+               enqueue( (sync_request_message) {0, 0} );
+               send_handshake();
+               cancel_wait();
+            }
+            return true;
+         }
+      }
+      return false;
+   }
+
+   void connection::process_compressed_message( const compressed_message& msg ) {
+      namespace bio = boost::iostreams;
+      const auto start = fc::time_point::now();
+      // decompressed into a pooled buffer, the message is unpacked from it
+      auto payload_buffer = net_buffer_pool::instance().get( msg.data.size() * 4 );
+      std::vector<char>& payload = *payload_buffer;
+      payload.clear();
+      try {
+         bio::filtering_istream decomp;
+         decomp.push( bio::zlib_decompressor() );
+         decomp.push( bio::array_source( msg.data.data(), msg.data.size() ) );
+         char chunk[4096];
+         while( decomp.read( chunk, sizeof(chunk) ) || decomp.gcount() > 0 ) {
+            payload.insert( payload.end(), chunk, chunk + decomp.gcount() );
+            // same bound as the length of an uncompressed message
+            EOS_ASSERT( payload.size() <= def_send_buffer_size*2, plugin_exception,
+                        "compressed message from ${p} exceeds maximum message size", ("p", peer_name()) );
+         }
+      } catch( const bio::zlib_error& e ) {
+         EOS_THROW( plugin_exception, "Could not decompress message from ${p}: ${e}", ("p", peer_name())("e", e.what()) );
+      }
+      received_compression.add( payload.size(), msg.data.size() );
+      received_compression.cpu_time_us += (fc::time_point::now() - start).count();
+
+      fc::datastream<const char*> ds( payload.data(), payload.size() );
+      unsigned_int which{};
+      fc::raw::unpack( ds, which );
+      if( which == signed_block_which ) {
+         shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
+         fc::raw::unpack( ds, *ptr );
+         const block_id_type blk_id = ptr->id();
+         if( skip_block( *ptr, blk_id ) ) {
+            ++counters.messages_dropped;
+            return;
+         }
+         handle_message( blk_id, std::move( ptr ) );
+      } else if( which == packed_transaction_which ) {
+         shared_ptr<packed_transaction> ptr = std::make_shared<packed_transaction>();
+         fc::raw::unpack( ds, *ptr );
+         handle_message( std::move( ptr ) );
+      } else if( which == packed_transactions_which ) {
+         handle_packed_transactions( ds );
+      } else {
+         EOS_THROW( plugin_exception, "Unexpected message ${w} compressed by ${p}", ("w", which.value)("p", peer_name()) );
+      }
+   }
+
+   snapshot_manager::snapshot_manager( boost::asio::io_context& io_context, bfs::path download_dir, bool serve, uint64_t max_size )
+   : download_dir( std::move( download_dir ) )
+   , serve( serve )
+   , max_size( max_size )
+   , timer( io_context ) {}
+
+   const char* snapshot_manager::state_str( fetch_state s ) {
+      switch( s ) {
+         case fetch_state::idle : return "idle";
+         case fetch_state::listing : return "listing";
+         case fetch_state::downloading : return "downloading";
+         case fetch_state::verifying : return "verifying";
+         case fetch_state::complete : return "complete";
+         case fetch_state::failed : return "failed";
+      }
+      return "unknown";
+   }
+
+   bool snapshot_manager::serving()const {
+      return serve && my_impl->producer_plug && my_impl->producer_plug->get_state() == abstract_plugin::started;
+   }
+
+   // call with served_mtx locked, from thread pool since new snapshot files are hashed
+   void snapshot_manager::scan_snapshots() {
+      static const string prefix = "snapshot-";
+      static const string suffix = ".bin";
+      const size_t name_size = prefix.size() + 2*sizeof(block_id_type) + suffix.size();
+
+      std::map<block_id_type, served_snapshot> found;
+      boost::system::error_code ec;
+      const bfs::path dir = my_impl->producer_plug->get_snapshots_dir();
+      for( bfs::directory_iterator itr( dir, ec ), end; !ec && itr != end; itr.increment( ec ) ) {
+         const bfs::path& p = itr->path();
+         const string name = p.filename().string();
+         if( name.size() != name_size || name.compare( 0, prefix.size(), prefix ) != 0 ||
+             name.compare( name_size - suffix.size(), suffix.size(), suffix ) != 0 )
+            continue;
+         block_id_type id;
+         try {
+            id = block_id_type( name.substr( prefix.size(), 2*sizeof(block_id_type) ) );
+         } catch( ... ) {
+            continue;
+         }
+         boost::system::error_code fec;
+         const uint64_t size = bfs::file_size( p, fec );
+         if( fec || size == 0 ) continue;
+         const std::time_t mtime = bfs::last_write_time( p, fec );
+         if( fec ) continue;
+
+         auto i = served.find( id );
+         if( i != served.end() && i->second.description.size == size && i->second.last_write_time == mtime ) {
+            found.emplace( id, std::move( i->second ) );
+            continue;
+         }
+
+         served_snapshot s;
+         s.path = p;
+         s.last_write_time = mtime;
+         s.description.head_block_id = id;
+         s.description.size = size;
+         s.description.chunk_size = def_snapshot_chunk_size;
+         std::ifstream in( p.string(), std::ios::binary );
+         vector<char> buf( def_snapshot_chunk_size );
+         for( uint64_t pos = 0; pos < size && in; pos += def_snapshot_chunk_size ) {
+            const auto n = static_cast<std::streamsize>( std::min<uint64_t>( def_snapshot_chunk_size, size - pos ) );
+            if( in.read( buf.data(), n ) )
+               s.chunk_hashes.emplace_back( fc::sha256::hash( buf.data(), n ) );
+         }
+         if( s.chunk_hashes.size() != (size + def_snapshot_chunk_size - 1) / def_snapshot_chunk_size ) {
+            fc_wlog( logger, "unable to read snapshot ${p}", ("p", p.string()) );
+            continue;
+         }
+         s.description.manifest_digest = fc::sha256::hash( s.chunk_hashes );
+         fc_ilog( logger, "serving snapshot ${id} of ${s} bytes", ("id", id)("s", size) );
+         found.emplace( id, std::move( s ) );
+      }
+      served = std::move( found );
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_list_request( const connection_ptr& c ) {
+      if( !serving() ) {
+         c->enqueue( snapshot_list_message{} );
+         return;
+      }
+      boost::asio::post( my_impl->thread_pool->get_executor(), [this, c]() {
+         snapshot_list_message reply;
+         {
+            std::lock_guard<std::mutex> g( served_mtx );
+            scan_snapshots();
+            for( const auto& s : served )
+               reply.snapshots.push_back( s.second.description );
+         }
+         c->strand.post( [c, reply{std::move(reply)}]() {
+            c->enqueue( reply );
+         } );
+      } );
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_manifest_request( const connection_ptr& c, const snapshot_manifest_request_message& msg ) {
+      if( !serving() ) {
+         c->enqueue( snapshot_manifest_message{ snapshot_description{ msg.head_block_id }, {} } );
+         return;
+      }
+      boost::asio::post( my_impl->thread_pool->get_executor(), [this, c, id = msg.head_block_id]() {
+         snapshot_manifest_message reply;
+         reply.snapshot.head_block_id = id;
+         {
+            std::lock_guard<std::mutex> g( served_mtx );
+            if( served.find( id ) == served.end() ) scan_snapshots();
+            auto i = served.find( id );
+            if( i != served.end() ) {
+               reply.snapshot = i->second.description;
+               reply.chunk_hashes = i->second.chunk_hashes;
+            }
+         }
+         c->strand.post( [c, reply{std::move(reply)}]() {
+            c->enqueue( reply );
+         } );
+      } );
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_chunk_request( const connection_ptr& c, const snapshot_chunk_request_message& msg ) {
+      if( !serving() ) {
+         c->enqueue( snapshot_chunk_message{ msg.head_block_id, msg.chunk, {} } );
+         return;
+      }
+      // a fetching peer waits for its chunks before requesting more, see request_chunks()
+      if( ++c->snapshot_chunks_serving > def_snapshot_chunks_per_peer ) {
+         peer_wlog( c, "more than ${n} snapshot chunk requests in flight, disconnecting", ("n", def_snapshot_chunks_per_peer) );
+         c->close( false );
+         return;
+      }
+      boost::asio::post( my_impl->thread_pool->get_executor(), [this, c, msg]() {
+         snapshot_chunk_message reply{ msg.head_block_id, msg.chunk, {} };
+         bfs::path path;
+         uint64_t pos = 0, n = 0;
+         {
+            std::lock_guard<std::mutex> g( served_mtx );
+            if( served.find( msg.head_block_id ) == served.end() ) scan_snapshots();
+            auto i = served.find( msg.head_block_id );
+            if( i != served.end() && msg.chunk < i->second.chunk_hashes.size() ) {
+               const auto& d = i->second.description;
+               path = i->second.path;
+               pos = uint64_t( msg.chunk ) * d.chunk_size;
+               n = std::min<uint64_t>( d.chunk_size, d.size - pos );
+            }
+         }
+         if( n > 0 ) {
+            std::ifstream in( path.string(), std::ios::binary );
+            reply.data.resize( n );
+            if( !in.seekg( pos ) || !in.read( reply.data.data(), n ) )
+               reply.data.clear();
+         }
+         // chunks are bulk data, queue them behind blocks and notices like sync blocks
+         auto send_buffer = create_send_buffer( snapshot_chunk_which, reply );
+         c->strand.post( [c, send_buffer{std::move(send_buffer)}]() {
+            // reset when closed meanwhile
+            if( c->snapshot_chunks_serving > 0 ) --c->snapshot_chunks_serving;
+            c->enqueue_buffer( send_buffer, no_reason, sync_block_queue );
+         } );
+      } );
+   }
+
+   void snapshot_manager::send( const connection_ptr& c, const net_message& msg ) {
+      c->strand.post( [c, msg]() {
+         // check protocol_version here since only accessed from strand
+         if( c->protocol_version >= snapshot_transfer )
+            c->enqueue( msg );
+      } );
+   }
+
+   snapshot_fetch_status snapshot_manager::start_fetch( const optional<block_id_type>& head_block_id ) {
+      {
+         std::lock_guard<std::mutex> g( mtx );
+         EOS_ASSERT( state != fetch_state::listing && state != fetch_state::downloading && state != fetch_state::verifying,
+                     plugin_exception, "snapshot fetch already in progress" );
+         wanted_id = head_block_id;
+         offers.clear();
+         chosen.reset();
+         sources.clear();
+         manifest_source.reset();
+         chunk_hashes.clear();
+         received.clear();
+         chunks_received = 0;
+         next_chunk = 0;
+         retry_chunks.clear();
+         outstanding.clear();
+         temp_path.clear();
+         final_path.clear();
+         error.clear();
+         state = fetch_state::listing;
+         list_deadline = fc::time_point::now() +
+                         fc::microseconds( std::chrono::duration_cast<std::chrono::microseconds>( def_snapshot_list_wait ).count() );
+         fc_ilog( logger, "requesting snapshot lists from peers" );
+         for_each_connection( []( const connection_ptr& c ) {
+            if( c->connected() ) send( c, snapshot_list_request_message{} );
+            return true;
+         } );
+         start_timer();
+      }
+      return get_status();
+   }
+
+   snapshot_fetch_status snapshot_manager::get_status()const {
+      std::lock_guard<std::mutex> g( mtx );
+      snapshot_fetch_status status;
+      status.state = state_str( state );
+      if( chosen ) {
+         status.head_block_id = chosen->head_block_id;
+         status.size = chosen->size;
+      } else {
+         status.head_block_id = wanted_id;
+      }
+      status.chunks = chunk_hashes.size();
+      status.chunks_received = chunks_received;
+      status.peers = sources.size();
+      if( state == fetch_state::complete ) status.path = final_path.generic_string();
+      status.error = error;
+      return status;
+   }
+
+   void snapshot_manager::stop() {
+      std::lock_guard<std::mutex> g( mtx );
+      boost::system::error_code ec;
+      timer.cancel( ec );
+      if( state == fetch_state::listing || state == fetch_state::downloading )
+         fail( "shutdown" );
+   }
+
+   // call with mtx locked
+   void snapshot_manager::start_timer() {
+      timer.expires_from_now( std::chrono::seconds( 1 ) );
+      timer.async_wait( [this]( boost::system::error_code ec ) {
+         if( ec || my_impl->in_shutdown ) return;
+         on_timer();
+      } );
+   }
+
+   void snapshot_manager::on_timer() {
+      std::lock_guard<std::mutex> g( mtx );
+      const auto now = fc::time_point::now();
+      const auto timeout = fc::microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>( def_snapshot_request_timeout ).count() );
+      if( state == fetch_state::listing ) {
+         if( now >= list_deadline ) choose_snapshot();
+      } else if( state == fetch_state::downloading ) {
+         if( chunk_hashes.empty() ) {
+            if( manifest_source && now - manifest_time > timeout ) {
+               peer_wlog( manifest_source, "snapshot manifest request timed out" );
+               drop_source( manifest_source );
+            }
+         } else {
+            std::set<connection_ptr> stalled;
+            for( const auto& r : outstanding ) {
+               if( now - r.second.time > timeout ) stalled.insert( r.second.source );
+            }
+            for( const auto& c : stalled ) {
+               peer_wlog( c, "snapshot chunk request timed out" );
+               drop_source( c );
+            }
+            request_chunks();
+         }
+      }
+      if( state == fetch_state::listing || state == fetch_state::downloading )
+         start_timer();
+   }
+
+   // call with mtx locked
+   void snapshot_manager::fail( const string& reason ) {
+      fc_elog( logger, "snapshot fetch failed: ${e}", ("e", reason) );
+      state = fetch_state::failed;
+      error = reason;
+      sources.clear();
+      manifest_source.reset();
+      outstanding.clear();
+      if( file.is_open() ) file.close();
+      if( !temp_path.empty() ) {
+         boost::system::error_code ec;
+         bfs::remove( temp_path, ec );
+      }
+   }
+
+   // call with mtx locked
+   void snapshot_manager::choose_snapshot() {
+      auto best = offers.end();
+      for( auto i = offers.begin(); i != offers.end(); ++i ) {
+         const snapshot_description& d = i->second.first;
+         if( wanted_id && d.head_block_id != *wanted_id ) continue;
+         if( best == offers.end() || i->second.second.size() > best->second.second.size() ||
+             ( i->second.second.size() == best->second.second.size() &&
+               block_header::num_from_id( d.head_block_id ) > block_header::num_from_id( best->first.first ) ) ) {
+            best = i;
+         }
+      }
+      if( best == offers.end() ) {
+         fail( wanted_id ? "no peer serves snapshot " + wanted_id->str() : string( "no peer serves a snapshot" ) );
+         return;
+      }
+      chosen = best->second.first;
+      sources = std::move( best->second.second );
+      offers.clear();
+      fc_ilog( logger, "fetching snapshot ${id} of ${s} bytes from ${n} peers",
+               ("id", chosen->head_block_id)("s", chosen->size)("n", sources.size()) );
+      state = fetch_state::downloading;
+      request_manifest();
+   }
+
+   // call with mtx locked
+   void snapshot_manager::request_manifest() {
+      if( sources.empty() ) {
+         fail( "no peer left serving snapshot " + chosen->head_block_id.str() );
+         return;
+      }
+      manifest_source = *sources.begin();
+      manifest_time = fc::time_point::now();
+      send( manifest_source, snapshot_manifest_request_message{ chosen->head_block_id } );
+   }
+
+   // call with mtx locked
+   uint32_t snapshot_manager::chunk_bytes( uint32_t chunk )const {
+      const uint64_t pos = uint64_t( chunk ) * chosen->chunk_size;
+      return static_cast<uint32_t>( std::min<uint64_t>( chosen->chunk_size, chosen->size - pos ) );
+   }
+
+   // call with mtx locked
+   optional<uint32_t> snapshot_manager::next_needed_chunk() {
+      while( !retry_chunks.empty() ) {
+         const uint32_t chunk = retry_chunks.front();
+         retry_chunks.pop_front();
+         if( !received[chunk] && outstanding.find( chunk ) == outstanding.end() ) return chunk;
+      }
+      while( next_chunk < chunk_hashes.size() ) {
+         const uint32_t chunk = next_chunk++;
+         if( !received[chunk] ) return chunk;
+      }
+      return {};
+   }
+
+   // call with mtx locked
+   void snapshot_manager::request_chunks() {
+      if( state != fetch_state::downloading ) return;
+      std::map<connection_ptr, uint32_t> load;
+      for( const auto& c : sources ) load[c] = 0;
+      for( const auto& r : outstanding ) ++load[r.second.source];
+      const auto now = fc::time_point::now();
+      for( auto& l : load ) {
+         for( ; l.second < def_snapshot_chunks_per_peer; ++l.second ) {
+            optional<uint32_t> chunk = next_needed_chunk();
+            if( !chunk ) return;
+            outstanding[*chunk] = chunk_request{ l.first, now };
+            send( l.first, snapshot_chunk_request_message{ chosen->head_block_id, *chunk } );
+         }
+      }
+   }
+
+   // call with mtx locked
+   void snapshot_manager::drop_source( const connection_ptr& c ) {
+      if( sources.erase( c ) == 0 ) return;
+      ++c->performance.stalls;
+      for( auto i = outstanding.begin(); i != outstanding.end(); ) {
+         if( i->second.source == c ) {
+            retry_chunks.push_back( i->first );
+            i = outstanding.erase( i );
+         } else {
+            ++i;
+         }
+      }
+      if( sources.empty() ) {
+         fail( "no peer left serving snapshot " + chosen->head_block_id.str() );
+      } else if( c == manifest_source ) {
+         manifest_source.reset();
+         if( chunk_hashes.empty() ) request_manifest();
+      }
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_list( const connection_ptr& c, const snapshot_list_message& msg ) {
+      std::lock_guard<std::mutex> g( mtx );
+      if( state != fetch_state::listing ) return;
+      for( const auto& d : msg.snapshots ) {
+         // chunks must fit in a message
+         if( d.size == 0 || d.chunk_size == 0 || d.chunk_size > def_send_buffer_size ) continue;
+         if( d.size > max_size ) {
+            peer_wlog( c, "ignoring snapshot ${id} of ${s} bytes, larger than p2p-snapshot-max-size-mb",
+                       ("id", d.head_block_id)("s", d.size) );
+            continue;
+         }
+         auto& offer = offers[std::make_pair( d.head_block_id, d.manifest_digest )];
+         if( offer.second.empty() ) {
+            offer.first = d;
+         } else if( offer.first.size != d.size || offer.first.chunk_size != d.chunk_size ) {
+            continue;
+         }
+         offer.second.insert( c );
+      }
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_manifest( const connection_ptr& c, const snapshot_manifest_message& msg ) {
+      const fc::sha256 digest = fc::sha256::hash( msg.chunk_hashes );
+      std::lock_guard<std::mutex> g( mtx );
+      if( state != fetch_state::downloading || c != manifest_source || !chunk_hashes.empty() ) return;
+      const uint64_t num_chunks = ( chosen->size + chosen->chunk_size - 1 ) / chosen->chunk_size;
+      if( msg.snapshot.head_block_id != chosen->head_block_id || msg.snapshot.size != chosen->size ||
+          msg.snapshot.chunk_size != chosen->chunk_size || msg.chunk_hashes.size() != num_chunks ||
+          digest != chosen->manifest_digest ) {
+         peer_wlog( c, "snapshot manifest does not match the offered snapshot" );
+         drop_source( c );
+         return;
+      }
+
+      boost::system::error_code ec;
+      bfs::create_directories( download_dir, ec );
+      temp_path = download_dir / ( ".incomplete-snapshot-" + chosen->head_block_id.str() + ".bin" );
+      file.open( temp_path.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+      if( !file ) {
+         fail( "unable to write " + temp_path.generic_string() );
+         return;
+      }
+      chunk_hashes = msg.chunk_hashes;
+      received.assign( chunk_hashes.size(), false );
+      manifest_source.reset();
+      request_chunks();
+   }
+
+   // called from connection strand
+   void snapshot_manager::recv_chunk( const connection_ptr& c, const snapshot_chunk_message& msg ) {
+      const fc::sha256 hash = fc::sha256::hash( msg.data.data(), msg.data.size() );
+      std::lock_guard<std::mutex> g( mtx );
+      if( state != fetch_state::downloading || msg.head_block_id != chosen->head_block_id ) return;
+      auto i = outstanding.find( msg.chunk );
+      if( i == outstanding.end() || i->second.source != c ) return; // late reply of a chunk requested elsewhere
+      outstanding.erase( i );
+
+      if( msg.data.size() != chunk_bytes( msg.chunk ) || hash != chunk_hashes[msg.chunk] ) {
+         peer_wlog( c, "snapshot chunk ${n} does not match the manifest", ("n", msg.chunk) );
+         retry_chunks.push_back( msg.chunk );
+         drop_source( c );
+         request_chunks();
+         return;
+      }
+      file.seekp( uint64_t( msg.chunk ) * chosen->chunk_size );
+      if( !file.write( msg.data.data(), msg.data.size() ) ) {
+         fail( "unable to write " + temp_path.generic_string() );
+         return;
+      }
+      received[msg.chunk] = true;
+      if( ++chunks_received == chunk_hashes.size() ) {
+         finish();
+      } else {
+         request_chunks();
+      }
+   }
+
+   // call with mtx locked
+   void snapshot_manager::finish() {
+      file.close();
+      if( !file ) {
+         fail( "unable to write " + temp_path.generic_string() );
+         return;
+      }
+      state = fetch_state::verifying;
+      sources.clear();
+      fc_ilog( logger, "received snapshot ${id}, validating", ("id", chosen->head_block_id) );
+      boost::asio::post( my_impl->thread_pool->get_executor(), [this, temp = temp_path, id = chosen->head_block_id]() {
+         // the chunks match the manifest the peers agreed on, also make sure the snapshot is of this chain
+         string reason;
+         try {
+            std::ifstream in( temp.generic_string(), std::ios::binary );
+            auto reader = make_istream_snapshot_reader( in );
+            reader->validate();
+            const chain_id_type snapshot_chain_id = controller::extract_chain_id( *reader );
+            if( snapshot_chain_id != my_impl->chain_id )
+               reason = "snapshot is of chain " + snapshot_chain_id.str();
+         } catch( const fc::exception& e ) {
+            reason = "invalid snapshot: " + e.to_string();
+         } catch( const std::exception& e ) {
+            reason = string( "invalid snapshot: " ) + e.what();
+         }
+
+         std::lock_guard<std::mutex> g( mtx );
+         if( state != fetch_state::verifying ) return;
+         if( !reason.empty() ) {
+            fail( reason );
+            return;
+         }
+         final_path = download_dir / ( "snapshot-" + id.str() + ".bin" );
+         boost::system::error_code ec;
+         bfs::rename( temp, final_path, ec );
+         if( ec ) {
+            fail( "unable to rename to " + final_path.generic_string() + ": " + ec.message() );
+            return;
+         }
+         state = fetch_state::complete;
+         fc_ilog( logger, "snapshot ${id} ready, restart with --snapshot ${p}", ("id", id)("p", final_path.generic_string()) );
+      } );
+   }
+
    // call only from main application thread
    void net_plugin_impl::update_chain_info() {
       controller& cc = chain_plug->chain();
@@ -2551,6 +4344,10 @@ namespace eosio {
                ("g", msg.generation)( "ep", peer_name() )
                ( "lib", msg.last_irreversible_block_num )( "head", msg.head_num ) );
 
+      if( handshake_sent_time != fc::time_point() ) {
+         counters.handshake_rtt_us = (fc::time_point::now() - handshake_sent_time).count();
+         handshake_sent_time = fc::time_point();
+      }
       connecting = false;
       if (msg.generation == 1) {
          if( msg.node_id == my_impl->node_id) {
@@ -2608,6 +4405,9 @@ namespace eosio {
             return;
          }
          protocol_version = my_impl->to_protocol_version(msg.network_version);
+         peer_accepts_compression = protocol_version >= compressed_messages;
+         early_relay = my_impl->is_early_relay_peer( msg );
+         if( early_relay ) peer_ilog( this, "relaying new blocks of the peer before applying them" );
          if( protocol_version != net_version ) {
             fc_ilog( logger, "Local network version: ${nv} Remote version: ${mnv}",
                      ("nv", net_version)( "mnv", protocol_version ) );
@@ -2616,6 +4416,7 @@ namespace eosio {
          g_conn.lock();
          if( conn_node_id != msg.node_id ) {
             conn_node_id = msg.node_id;
+            logger_variant.reset();
          }
          g_conn.unlock();
 
@@ -2671,6 +4472,7 @@ namespace eosio {
 
       std::unique_lock<std::mutex> g_conn( conn_mtx );
       last_handshake_recv = msg;
+      logger_variant.reset();
       g_conn.unlock();
       my_impl->sync_master->recv_handshake( shared_from_this(), msg );
    }
@@ -2682,6 +4484,7 @@ namespace eosio {
       if( msg.reason == duplicate ) {
          std::lock_guard<std::mutex> g_conn( conn_mtx );
          conn_node_id = msg.node_id;
+         logger_variant.reset();
       }
       if( msg.reason == wrong_version ) {
          if( !retry ) no_retry = fatal_other; // only retry once on wrong version
@@ -2717,6 +4520,8 @@ namespace eosio {
 
       double offset = (double(rec - org) + double(msg.xmt - dst)) / 2;
       double NsecPerUsec{1000};
+      // round trip less the time the peer held the message
+      performance.add_rtt( fc::microseconds( static_cast<int64_t>( ((dst - org) - (msg.xmt - rec)) / NsecPerUsec ) ) );
 
       if( logger.is_enabled( fc::log_level::all ) )
          logger.log( FC_LOG_MESSAGE( all, "Clock offset is ${o}ns (${us}us)",
@@ -2848,6 +4653,18 @@ namespace eosio {
              trx->get_signatures().size() * sizeof(signature_type);
    }
 
+   template<typename Stream>
+   void connection::handle_packed_transactions( Stream& ds ) {
+      unsigned_int count{};
+      fc::raw::unpack( ds, count );
+      peer_dlog( this, "received ${n} packed_transactions", ("n", count.value) );
+      for( uint32_t i = 0; i < count.value; ++i ) {
+         shared_ptr<packed_transaction> ptr = std::make_shared<packed_transaction>();
+         fc::raw::unpack( ds, *ptr );
+         handle_message( std::move( ptr ) );
+      }
+   }
+
    void connection::handle_message( packed_transaction_ptr trx ) {
       if( my_impl->db_read_mode == eosio::db_read_mode::READ_ONLY ) {
          fc_dlog( logger, "got a txn in read-only mode - dropping" );
@@ -2861,22 +4678,26 @@ namespace eosio {
       if( trx_in_progress_sz > def_max_trx_in_progress_size ) {
          fc_wlog( logger, "Dropping trx ${id}, too many trx in progress ${s} bytes",
                   ("id", tid)("s", trx_in_progress_sz) );
+         ++counters.messages_dropped;
          return;
       }
 
       bool have_trx = my_impl->dispatcher->have_txn( tid );
-      node_transaction_state nts = {tid, trx->expiration(), 0, connection_id};
+      node_transaction_state nts = {tid, trx->expiration(), 0, connection_id, trx};
       my_impl->dispatcher->add_peer_txn( nts );
 
       if( have_trx ) {
          fc_dlog( logger, "got a duplicate transaction - dropping ${id}", ("id", tid) );
+         ++counters.messages_dropped;
          return;
       }
 
       trx_in_progress_size += calc_trx_size( trx );
-      app().post( priority::low, [trx{std::move(trx)}, weak = weak_from_this()]() {
-         my_impl->chain_plug->accept_transaction( trx,
-            [weak, trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
+      transaction_tracing::instance().begin( tid, "p2p" );
+      // accept_transaction is thread safe, called here so signature recovery starts on the thread pool right away
+      // instead of after the transaction waits its turn on the application thread
+      my_impl->chain_plug->accept_transaction( trx,
+         [weak = weak_from_this(), trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
          // next (this lambda) called from application thread
          if (result.contains<fc::exception_ptr>()) {
             fc_dlog( logger, "bad packed_transaction : ${m}", ("m", result.get<fc::exception_ptr>()->what()) );
@@ -2892,28 +4713,213 @@ namespace eosio {
          if( conn ) {
             conn->trx_in_progress_size -= calc_trx_size( trx );
          }
-        });
       });
    }
 
    // called from connection strand
    void connection::handle_message( const block_id_type& id, signed_block_ptr ptr ) {
       peer_dlog( this, "received signed_block ${id}", ("id", ptr->block_num() ) );
-      app().post(priority::high, [ptr{std::move(ptr)}, id, c = shared_from_this()]() mutable {
-         c->process_signed_block( id, std::move( ptr ) );
+      // start transaction signature recovery now so it overlaps with blocks still queued ahead of this one
+      my_impl->chain_plug->chain().prefetch_block( ptr );
+      if( my_impl->sync_master->sync_recv_span_block( shared_from_this(), id, ptr->block_num(), ptr ) ) {
+         return;
+      }
+      app().post(priority::high, [ptr{std::move(ptr)}, id, c = shared_from_this(), received = fc::time_point::now()]() mutable {
+         c->process_signed_block( id, std::move( ptr ), false, received );
       });
       my_impl->dispatcher->bcast_notice( id );
    }
 
+   // called from connection strand
+   void connection::handle_message( const compact_block_message& msg ) {
+      const block_id_type blk_id = msg.block.id();
+      peer_dlog( this, "received compact_block_message ${n}, ${e} of ${t} transactions elided",
+                 ("n", msg.block.block_num())("e", msg.elided.size())("t", msg.block.transactions.size()) );
+      if( skip_block( msg.block, blk_id ) ) {
+         ++counters.messages_dropped;
+         return;
+      }
+
+      auto b = std::make_shared<signed_block>( msg.block );
+      vector<uint32_t> missing;
+      for( uint32_t i : msg.elided ) {
+         EOS_ASSERT( i < b->transactions.size() && b->transactions[i].trx.contains<transaction_id_type>(), plugin_exception,
+                     "Invalid elided transaction ${i} of compact block from ${p}", ("i", i)("p", peer_name()) );
+         auto& receipt = b->transactions[i];
+         packed_transaction_ptr trx = my_impl->dispatcher->find_txn( receipt.trx.get<transaction_id_type>() );
+         if( trx ) {
+            receipt.trx = *trx;
+         } else {
+            missing.push_back( i );
+         }
+      }
+      if( missing.empty() ) {
+         complete_compact_block( blk_id, std::move( b ) );
+         return;
+      }
+
+      fc_dlog( logger, "requesting ${m} transactions of compact block ${n} from ${p}",
+               ("m", missing.size())("n", b->block_num())("p", peer_name()) );
+      enqueue( block_trxs_request_message{ blk_id, missing } );
+      pending_compact = pending_compact_block{ blk_id, std::move( b ), std::move( missing ) };
+   }
+
+   // called from connection strand
+   void connection::handle_message( const block_trxs_request_message& msg ) {
+      connection_wptr weak = shared_from_this();
+      app().post( priority::medium, [msg, weak{std::move(weak)}]() {
+         connection_ptr c = weak.lock();
+         if( !c ) return;
+         signed_block_ptr b;
+         try {
+            b = my_impl->chain_plug->chain().fetch_block_by_id( msg.block_id );
+         } catch( ... ) {
+            fc_elog( logger, "caught exception fetching block id ${id} for ${p}", ("id", msg.block_id)( "p", c->peer_address() ) );
+         }
+         c->strand.post( [c, msg, b{std::move(b)}]() {
+            block_trxs_message reply;
+            reply.block_id = msg.block_id;
+            if( b ) {
+               reply.trxs.reserve( msg.indices.size() );
+               for( uint32_t i : msg.indices ) {
+                  if( i >= b->transactions.size() || !b->transactions[i].trx.contains<packed_transaction>() ) {
+                     reply.trxs.clear();
+                     break;
+                  }
+                  reply.trxs.push_back( b->transactions[i].trx.get<packed_transaction>() );
+               }
+            }
+            c->enqueue( reply );
+         } );
+      } );
+   }
+
+   void connection::handle_message( const block_headers_request_message& msg ) {
+      peer_dlog( this, "received block_headers_request_message ${s} to ${e}", ("s", msg.start_block)("e", msg.end_block) );
+      const uint32_t end = std::min( msg.end_block, msg.start_block + def_max_sync_headers - 1 );
+      connection_wptr weak = shared_from_this();
+      app().post( priority::medium, [start = msg.start_block, end, weak{std::move(weak)}]() {
+         connection_ptr c = weak.lock();
+         if( !c ) return;
+         controller& cc = my_impl->chain_plug->chain();
+         block_headers_message reply;
+         try {
+            for( uint32_t num = start; num <= end && num >= start; ++num ) { // stop at wrap around of a bad end
+               signed_block_ptr b = cc.fetch_block_by_number( num );
+               if( !b ) break;
+               reply.headers.emplace_back( static_cast<const signed_block_header&>( *b ) );
+            }
+         } catch( ... ) {
+            fc_elog( logger, "caught exception fetching block headers ${s} to ${e} for ${p}",
+                     ("s", start)("e", end)( "p", c->peer_address() ) );
+         }
+         c->strand.post( [c, reply{std::move(reply)}]() {
+            c->enqueue( reply );
+         } );
+      } );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const block_headers_message& msg ) {
+      peer_dlog( this, "received block_headers_message with ${n} headers", ("n", msg.headers.size()) );
+      my_impl->sync_master->sync_recv_headers( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_list_request_message& msg ) {
+      peer_dlog( this, "received snapshot_list_request_message" );
+      my_impl->snapshot_master->recv_list_request( shared_from_this() );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_list_message& msg ) {
+      peer_dlog( this, "received snapshot_list_message with ${n} snapshots", ("n", msg.snapshots.size()) );
+      my_impl->snapshot_master->recv_list( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_manifest_request_message& msg ) {
+      peer_dlog( this, "received snapshot_manifest_request_message ${id}", ("id", msg.head_block_id) );
+      my_impl->snapshot_master->recv_manifest_request( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_manifest_message& msg ) {
+      peer_dlog( this, "received snapshot_manifest_message with ${n} chunks", ("n", msg.chunk_hashes.size()) );
+      my_impl->snapshot_master->recv_manifest( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_chunk_request_message& msg ) {
+      peer_dlog( this, "received snapshot_chunk_request_message ${n}", ("n", msg.chunk) );
+      my_impl->snapshot_master->recv_chunk_request( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const snapshot_chunk_message& msg ) {
+      peer_dlog( this, "received snapshot_chunk_message ${n} of ${s} bytes", ("n", msg.chunk)("s", msg.data.size()) );
+      my_impl->snapshot_master->recv_chunk( shared_from_this(), msg );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const block_trxs_message& msg ) {
+      if( !pending_compact || pending_compact->id != msg.block_id ) {
+         fc_dlog( logger, "ignoring transactions of block ${id} not pending from ${p}", ("id", msg.block_id)("p", peer_name()) );
+         return;
+      }
+      pending_compact_block pending = std::move( *pending_compact );
+      pending_compact.reset();
+
+      if( msg.trxs.size() != pending.missing.size() ) {
+         request_full_block( pending.id );
+         return;
+      }
+      for( size_t i = 0; i < msg.trxs.size(); ++i ) {
+         auto& receipt = pending.block->transactions[pending.missing[i]];
+         if( msg.trxs[i].id() != receipt.trx.get<transaction_id_type>() ) {
+            request_full_block( pending.id );
+            return;
+         }
+         receipt.trx = msg.trxs[i];
+      }
+      complete_compact_block( pending.id, std::move( pending.block ) );
+   }
+
+   // called from connection strand
+   void connection::complete_compact_block( const block_id_type& blk_id, signed_block_ptr b ) {
+      vector<digest_type> trx_digests;
+      trx_digests.reserve( b->transactions.size() );
+      for( const auto& receipt : b->transactions )
+         trx_digests.emplace_back( receipt.digest() );
+      if( merkle( std::move( trx_digests ) ) != b->transaction_mroot ) {
+         // a local transaction with the same id may differ in signatures or context free data
+         fc_dlog( logger, "rebuilt compact block ${n} does not match, requesting full block from ${p}",
+                  ("n", b->block_num())("p", peer_name()) );
+         request_full_block( blk_id );
+         return;
+      }
+      handle_message( blk_id, std::move( b ) );
+   }
+
+   // called from connection strand
+   void connection::request_full_block( const block_id_type& blk_id ) {
+      request_message req;
+      req.req_blocks.mode = normal;
+      req.req_blocks.ids.push_back( blk_id );
+      req.req_trx.mode = none;
+      enqueue( req );
+   }
+
    // called from application thread
-   void connection::process_signed_block( const block_id_type& blk_id, signed_block_ptr msg ) {
+   void connection::process_signed_block( const block_id_type& blk_id, signed_block_ptr msg, bool sync_buffered,
+                                          fc::time_point received ) {
       controller& cc = my_impl->chain_plug->chain();
       uint32_t blk_num = msg->block_num();
       // use c in this method instead of this to highlight that all methods called on c-> must be thread safe
       connection_ptr c = shared_from_this();
 
-      // if we have closed connection then stop processing
-      if( !c->socket_is_open() )
+      // if we have closed connection then stop processing, blocks after a buffered one wait on it being applied
+      if( !c->socket_is_open() && !sync_buffered )
          return;
 
       try {
@@ -2934,6 +4940,9 @@ namespace eosio {
       peer_dlog( c, "received signed_block : #${n} block age in secs = ${age}",
                  ("n", blk_num)( "age", age.to_seconds() ) );
 
+      // forwarded to the other peers while it is applied below
+      const bool relayed_early = c->early_relay && !sync_buffered && my_impl->relay_early( blk_id, msg, c );
+
       go_away_reason reason = fatal_other;
       try {
          my_impl->chain_plug->accept_block(msg);
@@ -2958,6 +4967,8 @@ namespace eosio {
       }
 
       if( reason == no_reason ) {
+         // accepted_block has queued the block for relay to the other peers
+         if( received != fc::time_point() ) c->counters.block_relayed( fc::time_point::now() - received );
          boost::asio::post( my_impl->thread_pool->get_executor(), [dispatcher = my_impl->dispatcher.get(), cid=c->connection_id, blk_id, msg]() {
             dispatcher->add_peer_block( blk_id, cid );
             dispatcher->update_txns_block_num( msg );
@@ -2967,6 +4978,7 @@ namespace eosio {
             sync_master->sync_recv_block( c, blk_id, blk_num, true );
          });
       } else {
+         if( relayed_early ) my_impl->demote_early_relay_peer( c );
          c->strand.post( [sync_master = my_impl->sync_master.get(), dispatcher = my_impl->dispatcher.get(), c, blk_id, blk_num]() {
             sync_master->rejected_block( c, blk_num );
             dispatcher->rejected_block( blk_id );
@@ -3097,12 +5109,66 @@ namespace eosio {
       }
    }
 
+   void block_propagation_tracker::recv_block( const block_header& bh, const block_id_type& id, const string& peer ) {
+      const auto now = fc::time_point::now();
+      const int64_t latency_us = (now - bh.timestamp.to_time_point()).count();
+      std::lock_guard<std::mutex> g( mtx );
+      auto itr = recent.find( id );
+      if( itr != recent.end() ) {
+         auto& p = peers[peer];
+         const uint64_t lag_us = (now - itr->second.first_seen).count();
+         ++p.blocks_later;
+         p.lag_us_total += lag_us;
+         p.lag_us_max = std::max( p.lag_us_max, lag_us );
+         return;
+      }
+      if( latency_us > max_block_age_us )
+         return;
+
+      recent.emplace( id, block_first_seen{ bh.block_num(), id, bh.producer, now, latency_us, peer } );
+      recent_order.push_back( id );
+      if( recent_order.size() > max_recent_blocks ) {
+         recent.erase( recent_order.front() );
+         recent_order.pop_front();
+      }
+
+      ++peers[peer].blocks_first;
+
+      auto& h = producers[bh.producer];
+      ++h.blocks;
+      h.latency_us_total += latency_us;
+      h.latency_us_min = std::min( h.latency_us_min, latency_us );
+      h.latency_us_max = std::max( h.latency_us_max, latency_us );
+      const auto bucket = std::lower_bound( bucket_bounds_ms.begin(), bucket_bounds_ms.end(), latency_us / 1000 ) - bucket_bounds_ms.begin();
+      ++h.buckets[bucket];
+   }
+
+   block_propagation_stats block_propagation_tracker::get_stats()const {
+      block_propagation_stats result;
+      result.bucket_bounds_ms.assign( bucket_bounds_ms.begin(), bucket_bounds_ms.end() );
+      std::lock_guard<std::mutex> g( mtx );
+      result.producers.reserve( producers.size() );
+      for( const auto& [producer, h] : producers ) {
+         result.producers.push_back( { producer, h.blocks, h.latency_us_total, h.latency_us_min, h.latency_us_max,
+                                       vector<uint64_t>( h.buckets.begin(), h.buckets.end() ) } );
+      }
+      result.peers.reserve( peers.size() );
+      for( const auto& [peer, p] : peers ) {
+         result.peers.push_back( { peer, p.blocks_first, p.blocks_later, p.lag_us_total, p.lag_us_max } );
+      }
+      result.recent.reserve( recent_order.size() );
+      for( auto i = recent_order.rbegin(); i != recent_order.rend(); ++i ) {
+         result.recent.push_back( recent.at( *i ) );
+      }
+      return result;
+   }
+
    // called from application thread
    void net_plugin_impl::on_accepted_block(const block_state_ptr& block) {
       update_chain_info();
       dispatcher->strand.post( [this, block]() {
          fc_dlog( logger, "signaled, blk num = ${num}, id = ${id}", ("num", block->block_num)("id", block->id) );
-         dispatcher->bcast_block( block );
+         dispatcher->bcast_block( block->block, block->id, block->packed_block() );
       });
    }
 
@@ -3124,11 +5190,57 @@ namespace eosio {
             dispatcher->rejected_transaction(results.second->packed_trx(), head_blk_num);
          } else {
             fc_dlog( logger, "signaled ACK, trx-id = ${id}", ("id", id) );
-            dispatcher->bcast_transaction(*results.second->packed_trx());
+            dispatcher->bcast_transaction(results.second->packed_trx());
+            if( results.second->trace ) results.second->trace->step( "p2p.relay" );
          }
       });
    }
 
+   bool net_plugin_impl::is_early_relay_peer(const handshake_message& msg) const {
+      {
+         std::lock_guard<std::mutex> g( early_relay_mtx );
+         if( !early_relay_peers.count( msg.key ) ) return false;
+      }
+      if( msg.sig == chain::signature_type() || msg.token != fc::sha256::hash( msg.time ) ) return false;
+      try {
+         return chain::public_key_type( crypto::public_key( msg.sig, msg.token, true ) ) == msg.key;
+      } catch( const fc::exception& ) {
+         return false;
+      }
+   }
+
+   // called from application thread
+   bool net_plugin_impl::relay_early( const block_id_type& id, const signed_block_ptr& b, const connection_ptr& c ) {
+      controller& cc = chain_plug->chain();
+      if( b->block_num() <= cc.fork_db_pending_head_block_num() ) return false; // only new blocks at the head
+      block_state_ptr prev = cc.fetch_block_state_by_id( b->previous );
+      if( !prev ) return false;
+      try {
+         // header, producer schedule and producer signature, but not the transactions nor activated protocol features
+         prev->next( *b, vector<signature_type>(), cc.get_protocol_feature_manager().get_protocol_feature_set(),
+                     []( block_timestamp_type, const flat_set<digest_type>&, const vector<digest_type>& ) {} );
+      } catch( const fc::exception& e ) {
+         peer_dlog( c, "not relaying block ${n} early: ${e}", ("n", b->block_num())("e", e.to_string()) );
+         return false;
+      }
+      peer_dlog( c, "relaying block ${n} early", ("n", b->block_num()) );
+      dispatcher->add_peer_block( id, c->connection_id );
+      dispatcher->strand.post( [this, b, id]() {
+         dispatcher->bcast_block( b, id );
+      });
+      return true;
+   }
+
+   void net_plugin_impl::demote_early_relay_peer( const connection_ptr& c ) {
+      c->early_relay = false;
+      std::unique_lock<std::mutex> g_conn( c->conn_mtx );
+      const auto key = c->last_handshake_recv.key;
+      g_conn.unlock();
+      std::lock_guard<std::mutex> g( early_relay_mtx );
+      if( early_relay_peers.erase( key ) )
+         peer_wlog( c, "block relayed early failed, no longer relaying blocks of ${k} early", ("k", key) );
+   }
+
    bool net_plugin_impl::authenticate_peer(const handshake_message& msg) const {
       if(allowed_connections == None)
          return false;
@@ -3211,7 +5323,7 @@ namespace eosio {
          hello.network_version = net_version_base + proto_explicit_sync; // try previous version
          send = true;
       } else {
-         hello.network_version = net_version_base + net_version;
+         hello.network_version = ext_version_base + net_version;
       }
       const auto prev_head_id = hello.head_id;
       uint32_t lib, head;
@@ -3276,6 +5388,10 @@ namespace eosio {
          ( "agent-name", bpo::value<string>()->default_value("\"EOS Test Agent\""), "The name supplied to identify this node amongst the peers.")
          ( "allowed-connection", bpo::value<vector<string>>()->multitoken()->default_value({"any"}, "any"), "Can be 'any' or 'producers' or 'specified' or 'none'. If 'specified', peer-key must be specified at least once. If only 'producers', peer-key is not required. 'producers' and 'specified' may be combined.")
          ( "peer-key", bpo::value<vector<string>>()->composing()->multitoken(), "Optional public key of peer allowed to connect.  May be used multiple times.")
+         ( "p2p-early-relay-peer-key", bpo::value<vector<string>>()->composing()->multitoken(),
+           "Public key of a trusted peer, proven by the signature of its handshake, whose new blocks are relayed to the "
+           "other peers as soon as their header and producer signature are valid, while they are still being applied. "
+           "A peer sending a block that then fails is no longer trusted until restart. May be used multiple times.")
          ( "peer-private-key", boost::program_options::value<vector<string>>()->composing()->multitoken(),
            "Tuple of [PublicKey, WIF private key] (may specify multiple times)")
          ( "max-clients", bpo::value<int>()->default_value(def_max_clients), "Maximum number of clients from which connections are accepted, use 0 for no limit")
@@ -3284,7 +5400,32 @@ namespace eosio {
          ( "net-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
            "Number of worker threads in net_plugin thread pool" )
          ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+         ( "sync-parallel-spans", bpo::value<uint32_t>()->default_value(1),
+           "number of sync-fetch-span chunks requested at once from different peers during synchronization, "
+           "blocks received out of order are buffered until the blocks before them are applied")
+         ( "sync-header-first", bpo::value<bool>()->default_value(false),
+           "during synchronization request and verify the block headers ahead of the blocks, from peers supporting it; "
+           "blocks are then only requested up to the last verified header and rejected if they do not match it")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable expirimental socket read watermark optimization")
+         ( "p2p-trx-bandwidth-limit", bpo::value<uint32_t>()->default_value(0),
+           "Maximum bytes per second of transactions relayed to each peer, 0 for no limit. Blocks and other messages "
+           "are not limited and are always written ahead of queued transactions.")
+         ( "p2p-compact-blocks", bpo::value<bool>()->default_value(false),
+           "Relay new blocks to peers supporting it as compact blocks, sending only the ids of the transactions the peer "
+           "is known to have. Compact blocks from peers are always accepted.")
+         ( "p2p-trx-batch-window-us", bpo::value<uint32_t>()->default_value(0),
+           "Relayed transactions are sent to peers supporting it in batches, each transaction waiting at most this many "
+           "microseconds for others to join its batch, 0 sends every transaction on its own. Batches from peers are "
+           "always accepted.")
+         ( "p2p-compression-threshold", bpo::value<uint32_t>()->default_value(0),
+           "Blocks and transactions of at least this many bytes are sent zlib compressed to peers supporting it, 0 disables. "
+           "Compressed messages from peers are always accepted.")
+         ( "p2p-serve-snapshots", bpo::value<bool>()->default_value(false),
+           "Serve the snapshots of the producer_plugin snapshots directory to peers fetching a snapshot")
+         ( "p2p-snapshot-download-dir", bpo::value<bfs::path>()->default_value("snapshots"),
+           "the location of the directory snapshots fetched from peers are written to (absolute path or relative to application data dir)")
+         ( "p2p-snapshot-max-size-mb", bpo::value<uint32_t>()->default_value(def_snapshot_max_size_mb),
+           "Snapshots offered by peers larger than this many MiB are not fetched")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
            "Available Variables:\n"
@@ -3308,7 +5449,10 @@ namespace eosio {
       try {
          peer_log_format = options.at( "peer-log-format" ).as<string>();
 
-         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>()));
+         const uint32_t sync_parallel_spans = options.at( "sync-parallel-spans" ).as<uint32_t>();
+         EOS_ASSERT( sync_parallel_spans > 0, plugin_config_exception, "sync-parallel-spans must be at least 1" );
+         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>(), sync_parallel_spans,
+                                                  options.at( "sync-header-first" ).as<bool>() ));
 
          my->connector_period = std::chrono::seconds( options.at( "connection-cleanup-period" ).as<int>());
          my->max_cleanup_time_ms = options.at("max-cleanup-time-msec").as<int>();
@@ -3318,6 +5462,15 @@ namespace eosio {
          my->max_nodes_per_host = options.at( "p2p-max-nodes-per-host" ).as<int>();
 
          my->use_socket_read_watermark = options.at( "use-socket-read-watermark" ).as<bool>();
+         my->compression_threshold = options.at( "p2p-compression-threshold" ).as<uint32_t>();
+         my->use_compact_blocks = options.at( "p2p-compact-blocks" ).as<bool>();
+         my->trx_bandwidth_limit = options.at( "p2p-trx-bandwidth-limit" ).as<uint32_t>();
+         my->trx_batch_window = fc::microseconds( options.at( "p2p-trx-batch-window-us" ).as<uint32_t>() );
+
+         my->serve_snapshots = options.at( "p2p-serve-snapshots" ).as<bool>();
+         const auto snapshot_dir = options.at( "p2p-snapshot-download-dir" ).as<bfs::path>();
+         my->snapshot_download_dir = snapshot_dir.is_relative() ? app().data_dir() / snapshot_dir : snapshot_dir;
+         my->snapshot_max_size = uint64_t( options.at( "p2p-snapshot-max-size-mb" ).as<uint32_t>() ) * 1024*1024;
 
          if( options.count( "p2p-listen-endpoint" ) && options.at("p2p-listen-endpoint").as<string>().length()) {
             my->p2p_address = options.at( "p2p-listen-endpoint" ).as<string>();
@@ -3363,6 +5516,12 @@ namespace eosio {
             }
          }
 
+         if( options.count( "p2p-early-relay-peer-key" )) {
+            for( const std::string& key_string : options["p2p-early-relay-peer-key"].as<std::vector<std::string>>() ) {
+               my->early_relay_peers.insert( dejsonify<chain::public_key_type>( key_string ));
+            }
+         }
+
          if( options.count( "peer-private-key" )) {
             const std::vector<std::string> key_id_to_wif_pair_strings = options["peer-private-key"].as<std::vector<std::string>>();
             for( const std::string& key_id_to_wif_pair_string : key_id_to_wif_pair_strings ) {
@@ -3382,6 +5541,7 @@ namespace eosio {
 
    void net_plugin::plugin_startup() {
       handle_sighup();
+      chain::startup_timeline::scope phase( "net_plugin startup" );
       try {
 
       fc_ilog( logger, "my node_id is ${id}", ("id", my->node_id ));
@@ -3391,6 +5551,8 @@ namespace eosio {
       my->thread_pool.emplace( "net", my->thread_pool_size );
 
       my->dispatcher.reset( new dispatch_manager( my_impl->thread_pool->get_executor() ) );
+      my->snapshot_master.reset( new snapshot_manager( my_impl->thread_pool->get_executor(), my->snapshot_download_dir,
+                                                       my->serve_snapshots, my->snapshot_max_size ) );
 
       chain::controller&cc = my->chain_plug->chain();
       my->db_read_mode = cc.get_read_mode();
@@ -3496,6 +5658,8 @@ namespace eosio {
             if( my->keepalive_timer )
                my->keepalive_timer->cancel();
          }
+         if( my->snapshot_master )
+            my->snapshot_master->stop();
 
          {
             fc_ilog( logger, "close ${s} connections", ("s", my->connections.size()) );
@@ -3571,6 +5735,28 @@ namespace eosio {
       return result;
    }
 
+   vector<connection_metrics> net_plugin::metrics()const {
+      vector<connection_metrics> result;
+      std::shared_lock<std::shared_mutex> g( my->connections_mtx );
+      result.reserve( my->connections.size() );
+      for( const auto& c : my->connections ) {
+         result.push_back( c->get_metrics() );
+      }
+      return result;
+   }
+
+   block_propagation_stats net_plugin::propagation()const {
+      return my->propagation.get_stats();
+   }
+
+   snapshot_fetch_status net_plugin::fetch_snapshot( const snapshot_fetch_params& params ) {
+      return my->snapshot_master->start_fetch( params.head_block_id );
+   }
+
+   snapshot_fetch_status net_plugin::snapshot_status()const {
+      return my->snapshot_master->get_status();
+   }
+
    // call with connections_mtx
    connection_ptr net_plugin_impl::find_connection( const string& host )const {
       for( const auto& c : connections )
@@ -3579,9 +5765,13 @@ namespace eosio {
    }
 
    constexpr uint16_t net_plugin_impl::to_protocol_version(uint16_t v) {
+      if (v >= ext_version_base) {
+         v -= ext_version_base;
+         return (v > net_version_range) ? 0 : v;
+      }
       if (v >= net_version_base) {
          v -= net_version_base;
-         return (v > net_version_range) ? 0 : v;
+         return (v > net_version_range) ? 0 : std::min(v, block_id_notify);
       }
       return 0;
    }
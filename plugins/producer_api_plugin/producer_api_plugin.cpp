@@ -111,6 +111,8 @@ void producer_api_plugin::plugin_startup() {
             INVOKE_R_V(producer, get_whitelist_blacklist), 201),
        CALL(producer, producer, set_whitelist_blacklist,
             INVOKE_V_R(producer, set_whitelist_blacklist, producer_plugin::whitelist_blacklist), 201),
+       CALL(producer, producer, get_whitelist_blacklist_stats,
+            INVOKE_R_V(producer, get_whitelist_blacklist_stats), 201),
        CALL(producer, producer, get_integrity_hash,
             INVOKE_R_V(producer, get_integrity_hash), 201),
        CALL_ASYNC(producer, producer, create_snapshot, producer_plugin::snapshot_information,
@@ -124,6 +126,10 @@ void producer_api_plugin::plugin_startup() {
                                  producer_plugin::get_supported_protocol_features_params), 201),
        CALL(producer, producer, get_account_ram_corrections,
             INVOKE_R_R(producer, get_account_ram_corrections, producer_plugin::get_account_ram_corrections_params), 201),
+       CALL(producer, producer, get_block_timelines,
+            INVOKE_R_V(producer, get_block_timelines), 201),
+       CALL(producer, producer, get_signature_provider_stats,
+            INVOKE_R_V(producer, get_signature_provider_stats), 201),
    });
 }
 
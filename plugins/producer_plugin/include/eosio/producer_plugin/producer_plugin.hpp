@@ -22,6 +22,7 @@ public:
       fc::optional<int32_t>   subjective_cpu_leeway_us;
       fc::optional<double>    incoming_defer_ratio;
       fc::optional<uint32_t>  greylist_limit;
+      fc::optional<uint64_t>  subjective_account_cpu_budget_us;
    };
 
    struct whitelist_blacklist {
@@ -68,6 +69,46 @@ public:
       optional<account_name>   more;
    };
 
+   /// where the time of a produced or received block went, durations in microseconds
+   struct block_timeline {
+      uint32_t             block_num = 0;
+      chain::block_id_type block_id;
+      account_name         producer;
+      bool                 produced = false;          ///< produced by this node, otherwise received
+      fc::time_point       block_time;
+      fc::time_point       start_time;                ///< start of the pending block when produced, arrival when received
+      int64_t              latency_us = 0;            ///< time from block_time to being committed
+      int64_t              main_thread_wait_us = 0;   ///< delay of the production timer running on the main thread
+      int64_t              remove_expired_us = 0;
+      int64_t              unapplied_us = 0;
+      int64_t              scheduled_and_incoming_us = 0;
+      int64_t              incoming_us = 0;
+      int64_t              finalize_us = 0;           ///< excluding sign_us
+      int64_t              sign_us = 0;
+      int64_t              commit_us = 0;
+      int64_t              apply_us = 0;              ///< push_block of a received block
+      int64_t              elapsed_us = 0;            ///< from start_time to the block being committed
+      uint32_t             trxs_succeeded = 0;
+      uint32_t             trxs_failed = 0;
+      uint32_t             trxs_retried = 0;          ///< subjectively failed, left for a later block
+      uint32_t             scheduled_trxs = 0;        ///< deferred transactions run, included in the counts above
+      uint32_t             block_trxs = 0;
+      int64_t              cpu_billed_us = 0;         ///< of the transactions in the block
+      int64_t              trx_wall_us = 0;           ///< running transactions, including failed and retried ones
+   };
+
+   /// latency of the signatures of produced blocks per signature provider, from asking for all the signatures of a
+   /// block to having the one of the provider, in microseconds
+   struct signature_provider_stats {
+      chain::public_key_type key;
+      std::string            provider;       ///< KEY or the url of keosd
+      uint64_t               signatures = 0;
+      uint64_t               failures = 0;
+      int64_t                avg_us = 0;
+      int64_t                max_us = 0;
+      int64_t                last_us = 0;
+   };
+
    template<typename T>
    using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
 
@@ -99,9 +140,13 @@ public:
 
    whitelist_blacklist get_whitelist_blacklist() const;
    void set_whitelist_blacklist(const whitelist_blacklist& params);
+   /// lookup counters of the lists, restarted whenever a list is replaced
+   chain::whitelist_blacklist_stats get_whitelist_blacklist_stats() const;
 
    integrity_hash_information get_integrity_hash() const;
    void create_snapshot(next_function<snapshot_information> next);
+   /// directory create_snapshot writes to, valid after plugin_initialize
+   fc::path get_snapshots_dir() const;
 
    scheduled_protocol_feature_activations get_scheduled_protocol_feature_activations() const;
    void schedule_protocol_feature_activations(const scheduled_protocol_feature_activations& schedule);
@@ -110,13 +155,18 @@ public:
 
    get_account_ram_corrections_result  get_account_ram_corrections( const get_account_ram_corrections_params& params ) const;
 
+   /// timelines of the most recent produced and received blocks, oldest first
+   std::vector<block_timeline> get_block_timelines() const;
+
+   std::vector<signature_provider_stats> get_signature_provider_stats() const;
+
 private:
    std::shared_ptr<class producer_plugin_impl> my;
 };
 
 } //eosio
 
-FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(max_scheduled_transaction_time_per_block_ms)(subjective_cpu_leeway_us)(incoming_defer_ratio)(greylist_limit));
+FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(max_scheduled_transaction_time_per_block_ms)(subjective_cpu_leeway_us)(incoming_defer_ratio)(greylist_limit)(subjective_account_cpu_budget_us));
 FC_REFLECT(eosio::producer_plugin::greylist_params, (accounts));
 FC_REFLECT(eosio::producer_plugin::whitelist_blacklist, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)(action_blacklist)(key_blacklist) )
 FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash))
@@ -125,3 +175,8 @@ FC_REFLECT(eosio::producer_plugin::scheduled_protocol_feature_activations, (prot
 FC_REFLECT(eosio::producer_plugin::get_supported_protocol_features_params, (exclude_disabled)(exclude_unactivatable))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_params, (lower_bound)(upper_bound)(limit)(reverse))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_result, (rows)(more))
+FC_REFLECT(eosio::producer_plugin::block_timeline, (block_num)(block_id)(producer)(produced)(block_time)(start_time)(latency_us)
+           (main_thread_wait_us)(remove_expired_us)(unapplied_us)(scheduled_and_incoming_us)(incoming_us)(finalize_us)(sign_us)
+           (commit_us)(apply_us)(elapsed_us)(trxs_succeeded)(trxs_failed)(trxs_retried)(scheduled_trxs)(block_trxs)
+           (cpu_billed_us)(trx_wall_us))
+FC_REFLECT(eosio::producer_plugin::signature_provider_stats, (key)(provider)(signatures)(failures)(avg_us)(max_us)(last_us))
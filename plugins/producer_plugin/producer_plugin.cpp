@@ -3,9 +3,17 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/transaction_tracing.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/mpsc_ring.hpp>
 #include <eosio/chain/unapplied_transaction_queue.hpp>
+#include <eosio/chain/incoming_transaction_queue.hpp>
+#include <eosio/chain/transaction_prescreener.hpp>
+#include <eosio/chain/subjective_cpu_ledger.hpp>
+#include <eosio/chain/adaptive_block_timing.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
@@ -16,6 +24,8 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
@@ -26,6 +36,9 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace bmi = boost::multi_index;
 using bmi::indexed_by;
 using bmi::ordered_non_unique;
@@ -108,11 +121,12 @@ class pending_snapshot {
 public:
    using next_t = producer_plugin::next_function<producer_plugin::snapshot_information>;
 
-   pending_snapshot(const block_id_type& block_id, next_t& next, std::string pending_path, std::string final_path)
+   pending_snapshot(const block_id_type& block_id, next_t& next, std::string pending_path, std::string final_path, bool written = true)
    : block_id(block_id)
    , next(next)
    , pending_path(pending_path)
    , final_path(final_path)
+   , written(written)
    {}
 
    uint32_t get_height() const {
@@ -156,6 +170,7 @@ public:
    next_t            next;
    std::string       pending_path;
    std::string       final_path;
+   bool              written = true; ///< false while a background snapshot is still being written to pending_path
 };
 
 using pending_snapshot_index = multi_index_container<
@@ -186,6 +201,13 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       bool remove_expired_persisted_trxs( const fc::time_point& deadline );
       bool remove_expired_blacklisted_trxs( const fc::time_point& deadline );
       bool process_unapplied_trxs( const fc::time_point& deadline );
+      /// writes the delta from base to snapshot next to snapshot on the thread pool, logging failures
+      void write_snapshot_delta( const bfs::path& base, const bfs::path& snapshot );
+      /// requests a snapshot of the state every _state_checkpoint_interval blocks, kept as a state checkpoint once irreversible
+      void maybe_write_state_checkpoint( uint32_t block_num );
+      /// durably places snapshot among the state checkpoints on the thread pool and removes the oldest ones
+      void keep_state_checkpoint( const bfs::path& snapshot );
+
       bool process_scheduled_and_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit );
       bool process_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit );
 
@@ -193,20 +215,39 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       bool     _production_enabled                 = false;
       bool     _pause_production                   = false;
 
-      using signature_provider_type = std::function<chain::signature_type(chain::digest_type)>;
+      /// the future is ready unless the provider asks another process to sign, see http_client_plugin::post_async
+      using signature_provider_type = std::function<std::future<chain::signature_type>(chain::digest_type)>;
+      struct signature_provider_totals {
+         std::string provider;
+         uint64_t    signatures = 0;
+         uint64_t    failures = 0;
+         int64_t     total_us = 0;
+         int64_t     max_us = 0;
+         int64_t     last_us = 0;
+      };
       std::map<chain::public_key_type, signature_provider_type> _signature_providers;
+      std::map<chain::public_key_type, signature_provider_totals> _signature_provider_totals;
       std::set<chain::account_name>                             _producers;
       boost::asio::deadline_timer                               _timer;
       std::map<chain::account_name, uint32_t>                   _producer_watermarks;
       pending_block_mode                                        _pending_block_mode;
       unapplied_transaction_queue                               _unapplied_transactions;
       fc::optional<named_thread_pool>                           _thread_pool;
+      uint16_t                                                  _thread_pool_size = 0;
+      /// queued incoming transactions screened while each produced block is signed, 0 if none
+      uint32_t                                                  _prescreen_trxs = 0;
 
       std::atomic<int32_t>                                      _max_transaction_time_ms; // modified by app thread, read by net_plugin thread pool
       fc::microseconds                                          _max_irreversible_block_age_us;
       int32_t                                                   _produce_time_offset_us = 0;
       int32_t                                                   _last_block_time_offset_us = 0;
+      adaptive_block_timing                                     _adaptive_timing;
+      /// id and slot of our last block of a round, until the first block of the next producer is received
+      fc::optional<std::pair<block_id_type, uint32_t>>          _last_round_block;
       int32_t                                                   _max_scheduled_transaction_time_per_block_ms = 0;
+      uint32_t                                                  _max_scheduled_transaction_cpu_per_block_pct = 100;
+      /// subjective failures of scheduled transactions in a row, retried with the backoff of unapplied transactions
+      std::map<transaction_id_type, subjective_failure>         _scheduled_trx_failures;
       fc::time_point                                            _irreversible_block_time;
       fc::microseconds                                          _keosd_provider_timeout_us;
 
@@ -242,11 +283,91 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
        */
       uint32_t _timer_corelation_id = 0;
 
+      // SCHED_FIFO priority of the main thread while a block is being produced, 0 to leave it alone
+      int  _production_realtime_priority = 0;
+      bool _realtime_active = false;
+
+      void update_production_priority( bool producing ) {
+         if( _production_realtime_priority == 0 || producing == _realtime_active ) return;
+         if( set_realtime_priority( producing ? _production_realtime_priority : 0 ) || !producing ) {
+            _realtime_active = producing;
+            thread_placement::instance().record( "main", _realtime_active ? _production_realtime_priority : 0 );
+         } else {
+            // not permitted, do not keep retrying every block
+            _production_realtime_priority = 0;
+         }
+      }
+
+      /// exported by the metrics registry
+      struct producer_metrics {
+         static std::string result( const char* r ) { return chain::metrics::registry::label( "result", r ); }
+         chain::metrics::counter& blocks_produced = chain::metrics::registry::instance().get_counter(
+               "nodeos_producer_blocks_produced_total", "blocks produced by this node" );
+         chain::metrics::counter& trxs_accepted = chain::metrics::registry::instance().get_counter(
+               "nodeos_producer_incoming_transactions_total", "incoming transactions by outcome", result( "accepted" ) );
+         chain::metrics::counter& trxs_rejected = chain::metrics::registry::instance().get_counter(
+               "nodeos_producer_incoming_transactions_total", "incoming transactions by outcome", result( "rejected" ) );
+         chain::metrics::counter& trxs_relayed = chain::metrics::registry::instance().get_counter(
+               "nodeos_producer_incoming_transactions_total", "incoming transactions by outcome", result( "relayed" ) );
+      };
+      producer_metrics _metrics;
+
+      // forward incoming transactions after the cheap checks only, executing one in every _relay_execution_sample_interval
+      bool      _relay_without_execution = false;
+      uint32_t  _relay_execution_sample_interval = 0;
+      uint64_t  _relayed_trxs = 0;
+      uint64_t  _relay_sampled_trxs = 0;
+      uint64_t  _relay_sample_failures = 0;
+
       // keep a expected ratio between defer txn and incoming txn
       double _incoming_defer_ratio = 1.0; // 1:1
 
       // path to write the snapshots to
       bfs::path _snapshots_dir;
+      // serialize snapshots to memory on the main thread and write them to disk on the thread pool
+      bool      _background_snapshots = false;
+      // write snapshots as compressed snapshot containers
+      bool      _compress_snapshots = false;
+      // write with every snapshot a delta against the previous one this node wrote
+      bool      _snapshot_deltas = false;
+      bfs::path _last_snapshot_path;
+      // blocks between state checkpoints, 0 when disabled
+      uint32_t  _state_checkpoint_interval = 0;
+      uint32_t  _state_checkpoints_to_keep = 2;
+      bool      _state_checkpoint_pending = false;
+
+      using block_timeline = producer_plugin::block_timeline;
+      fc::optional<block_timeline>                              _pending_timeline; // of the block being built
+      std::deque<block_timeline>                                _block_timelines;
+      uint32_t                                                  _max_block_timelines = 0;
+
+      /// adds the time since start to a phase of the pending block timeline
+      void record_phase( int64_t block_timeline::* phase, const fc::time_point& start ) {
+         if( _pending_timeline ) (*_pending_timeline).*phase += (fc::time_point::now() - start).count();
+      }
+
+      /// accounts a transaction run of the pending block started at start
+      void record_trx_run( const fc::time_point& start, const transaction_trace_ptr& trace, bool retried, bool scheduled = false ) {
+         if( !_pending_timeline ) return;
+         block_timeline& t = *_pending_timeline;
+         t.trx_wall_us += (fc::time_point::now() - start).count();
+         if( retried ) ++t.trxs_retried;
+         else if( trace->except ) ++t.trxs_failed;
+         else ++t.trxs_succeeded;
+         if( scheduled ) ++t.scheduled_trxs;
+      }
+
+      void add_block_timeline( block_timeline&& t, const signed_block_ptr& b, const fc::time_point& committed ) {
+         t.block_id = b->id();
+         t.block_trxs = b->transactions.size();
+         for( const auto& r : b->transactions )
+            t.cpu_billed_us += r.cpu_usage_us;
+         t.latency_us = (committed - t.block_time).count();
+         t.elapsed_us = (committed - t.start_time).count();
+         _block_timelines.emplace_back( std::move( t ) );
+         while( _block_timelines.size() > _max_block_timelines )
+            _block_timelines.pop_front();
+      }
 
       void consider_new_watermark( account_name producer, uint32_t block_num ) {
          auto itr = _producer_watermarks.find( producer );
@@ -267,6 +388,21 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       void on_block( const block_state_ptr& bsp ) {
          _unapplied_transactions.clear_applied( bsp );
+         _subjective_cpu_ledger.prune( fc::time_point::now() );
+         maybe_write_state_checkpoint( bsp->block_num );
+         if( transaction_tracing::instance().enabled() ) end_transaction_traces( bsp );
+      }
+
+      void end_transaction_traces( const block_state_ptr& bsp ) {
+         auto& tracing = transaction_tracing::instance();
+         for( const auto& receipt : bsp->block->transactions ) {
+            if( !receipt.trx.contains<packed_transaction>() ) continue;
+            const auto& id = receipt.trx.get<packed_transaction>().id();
+            if( auto trace = tracing.find( id ) ) {
+               trace->step( "block.inclusion", "block " + std::to_string( bsp->block_num ) );
+               tracing.end( id, "included" );
+            }
+         }
       }
 
       void on_block_header( const block_state_ptr& bsp ) {
@@ -275,13 +411,16 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       void on_irreversible_block( const signed_block_ptr& lib ) {
          _irreversible_block_time = lib->timestamp.to_time_point();
-         const chain::controller& chain = chain_plug->chain();
+         promote_pending_snapshots( lib->block_num() );
+      }
 
-         // promote any pending snapshots
+      // promote the written pending snapshots up to lib_height
+      void promote_pending_snapshots( uint32_t lib_height ) {
+         const chain::controller& chain = chain_plug->chain();
          auto& snapshots_by_height = _pending_snapshot_index.get<by_height>();
-         uint32_t lib_height = lib->block_num();
 
-         while (!snapshots_by_height.empty() && snapshots_by_height.begin()->get_height() <= lib_height) {
+         while (!snapshots_by_height.empty() && snapshots_by_height.begin()->get_height() <= lib_height &&
+                snapshots_by_height.begin()->written) {
             const auto& pending = snapshots_by_height.begin();
             auto next = pending->next;
 
@@ -333,6 +472,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       };
 
       void on_incoming_block(const signed_block_ptr& block) {
+         const auto received_time = fc::time_point::now();
          auto id = block->id();
          auto blk_num = block->block_num();
 
@@ -359,6 +499,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          });
 
          // push the new block
+         const auto apply_start = fc::time_point::now();
          try {
             chain.push_block( bsf, [this]( const branch_type& forked_branch ) {
                _unapplied_transactions.add_forked( forked_branch );
@@ -368,6 +509,9 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          } catch ( const guard_exception& e ) {
             chain_plugin::handle_guard_exception(e);
             return;
+         } catch ( const state_unrecoverable_exception& e ) {
+            chain_plugin::handle_state_unrecoverable(e);
+            return;
          } catch( const fc::exception& e ) {
             elog((e.to_detail_string()));
             app().get_channel<channels::rejected_block>().publish( priority::medium, block );
@@ -378,6 +522,37 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
             chain_plugin::handle_db_exhaustion();
          }
 
+         if( _adaptive_timing.enabled() ) {
+            const int64_t latency_us = (fc::time_point::now() - block->timestamp.to_time_point()).count();
+            // blocks of a catching up node say nothing of the network
+            if( latency_us < fc::seconds( 30 ).count() )
+               _adaptive_timing.record_latency( block->producer, latency_us );
+            if( _last_round_block && block->timestamp.slot > _last_round_block->second && _producers.count( block->producer ) == 0 ) {
+               const bool received = block->previous == _last_round_block->first;
+               // only a block building on an earlier block of ours tells the last one was missed
+               if( received || block_header::num_from_id( block->previous ) < block_header::num_from_id( _last_round_block->first ) ) {
+                  _adaptive_timing.record_handoff( received );
+                  fc_dlog( _log, "next producer ${p} ${r} our last block #${n}, last block offset ${o} us",
+                           ("p", block->producer)("r", received ? "received" : "missed")
+                           ("n", block_header::num_from_id( _last_round_block->first ))
+                           ("o", _adaptive_timing.last_block_offset_us( block->producer, _last_block_time_offset_us )) );
+               }
+               _last_round_block.reset();
+            }
+         }
+
+         if( _max_block_timelines > 0 ) {
+            const auto now = fc::time_point::now();
+            block_timeline t;
+            t.block_num = blk_num;
+            t.producer = block->producer;
+            t.block_time = block->timestamp;
+            t.start_time = received_time;
+            t.apply_us = (now - apply_start).count();
+            t.trxs_succeeded = block->transactions.size();
+            add_block_timeline( std::move( t ), block, now );
+         }
+
          const auto& hbs = chain.head_block_state();
          if( hbs->header.timestamp.next().to_time_point() >= fc::time_point::now() ) {
             _production_enabled = true;
@@ -397,75 +572,216 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          }
       }
 
-      class incoming_transaction_queue {
-         uint64_t max_incoming_transaction_queue_size = 0;
-         uint64_t size_in_bytes = 0;
-         std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _incoming_transactions;
+      incoming_transaction_queue _pending_incoming_transactions;
+      /// CPU spent on failed runs of incoming transactions by first authorizer, which the chain does not bill
+      subjective_cpu_ledger      _subjective_cpu_ledger;
+      fc::microseconds           _subjective_cpu_window;
 
-      private:
-         static uint64_t calc_size( const transaction_metadata_ptr& trx ) {
-            return trx->packed_trx()->get_unprunable_size() + trx->packed_trx()->get_prunable_size() + sizeof( *trx );
-         }
+      static account_name first_authorizer_of( const transaction_metadata_ptr& trx ) {
+         return trx->packed_trx()->get_transaction().first_authorizer();
+      }
 
-         void add_size( const transaction_metadata_ptr& trx ) {
-            auto size = calc_size( trx );
-            EOS_ASSERT( size_in_bytes + size < max_incoming_transaction_queue_size, tx_resource_exhaustion, "Transaction exceeded producer resource limit" );
-            size_in_bytes += size;
+      /// queues behind all others the transactions p predicts to fail
+      void deprioritize_prescreened( transaction_prescreener& p ) {
+         const auto& failures = p.stop();
+         std::map<const transaction_metadata*, const string*> failing;
+         for( size_t i = 0; i < p.screened(); ++i ) {
+            if( failures[i] ) failing.emplace( p.transactions()[i].trx.get(), &*failures[i] );
          }
-
-      public:
-         void set_max_incoming_transaction_queue_size( uint64_t v ) { max_incoming_transaction_queue_size = v; }
-
-         void add( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
-            add_size( trx );
-            _incoming_transactions.emplace_back( trx, persist_until_expired, std::move( next ) );
+         size_t deprioritized = 0;
+         if( !failing.empty() ) {
+            deprioritized = _pending_incoming_transactions.deprioritize_front( p.transactions().size(), [&]( const transaction_metadata_ptr& trx ) {
+               auto itr = failing.find( trx.get() );
+               if( itr == failing.end() ) return false;
+               fc_dlog( _trx_trace_log, "[TRX_TRACE] Prescreening predicts tx: ${txid} fails: ${why}, DEPRIORITIZING",
+                        ("txid", trx->id())("why", *itr->second) );
+               return true;
+            } );
          }
+         fc_dlog( _log, "Prescreened ${s} of ${n} queued transactions, deprioritized ${d}",
+                  ("s", p.screened())("n", p.transactions().size())("d", deprioritized) );
+      }
 
-         void add_front( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
-            add_size( trx );
-            _incoming_transactions.emplace_front( trx, persist_until_expired, std::move( next ) );
+      /// queues trx by the incoming transaction policy, or behind all others if deprioritized, rejecting the transactions it evicts
+      void queue_incoming_transaction( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next,
+                                       bool deprioritized = false ) {
+         auto evicted = _pending_incoming_transactions.add( trx, persist_until_expired, std::move( next ), deprioritized );
+         for( auto& e : evicted ) {
+            auto except_ptr = std::static_pointer_cast<fc::exception>( std::make_shared<tx_resource_exhaustion>(
+                  FC_LOG_MESSAGE( error, "transaction ${id} evicted from the full incoming transaction queue", ("id", e.trx_meta->id()) ) ) );
+            e.next( except_ptr );
+            _transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>( except_ptr, e.trx_meta ) );
          }
+      }
 
-         auto pop_front() {
-            EOS_ASSERT( !_incoming_transactions.empty(), producer_exception, "logic error, front() called on empty incoming_transactions" );
-            auto intrx = _incoming_transactions.front();
-            _incoming_transactions.pop_front();
-            const transaction_metadata_ptr& trx = std::get<0>( intrx );
-            size_in_bytes -= calc_size( trx );
-            return intrx;
+      // thread safe, net_plugin calls this from its threads so key recovery starts as soon as a transaction is received
+      void on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+         auto trace = transaction_tracing::instance().begin( trx->id(), "api" );
+         if( trace ) trace->step( "intake" );
+         try {
+            chain_plug->prevalidate_transaction( *trx );
+         } catch( const fc::exception& e ) {
+            transaction_tracing::instance().end( trx->id(), std::string( "rejected: " ) + e.what() );
+            auto except_ptr = e.dynamic_copy_exception();
+            fc_dlog( _trx_trace_log, "[TRX_TRACE] Prevalidation is REJECTING tx: ${txid} : ${why} ", ("txid", trx->id())("why", e.what()) );
+            _metrics.trxs_rejected.add();
+            next( except_ptr );
+            _transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>( except_ptr,
+                  transaction_metadata::create_no_recover_keys( *trx, transaction_metadata::trx_type::input ) ) );
+            return;
          }
 
-         bool empty()const { return _incoming_transactions.empty(); }
-         size_t size()const { return _incoming_transactions.size(); }
-      };
-
-      incoming_transaction_queue _pending_incoming_transactions;
-
-      void on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          chain::controller& chain = chain_plug->chain();
          const auto max_trx_time_ms = _max_transaction_time_ms.load();
          fc::microseconds max_trx_cpu_usage = max_trx_time_ms < 0 ? fc::microseconds::maximum() : fc::milliseconds( max_trx_time_ms );
 
          auto future = transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
-                chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit() );
+                chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit(),
+                std::move( trace ) );
          boost::asio::post( _thread_pool->get_executor(), [self = this, future{std::move(future)}, persist_until_expired, next{std::move(next)}]() mutable {
             if( future.valid() ) {
                future.wait();
-               app().post( priority::low, [self, future{std::move(future)}, persist_until_expired, next{std::move( next )}]() mutable {
-                  try {
-                     self->process_incoming_transaction_async( future.get(), persist_until_expired, std::move( next ) );
-                  } CATCH_AND_CALL(next);
-               } );
+               recovered_trx r{ std::move( future ), persist_until_expired, std::move( next ) };
+               if( self->_recovered_trxs.push( std::move( r ) ) ) {
+                  self->schedule_recovered_trxs_drain();
+               } else {
+                  // ring is full, hand this one over on its own
+                  app().post( priority::low, [self, r{std::move( r )}]() mutable {
+                     self->process_recovered_trx( r );
+                  } );
+               }
             }
          });
       }
 
-      void process_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+      /// transaction whose keys were recovered on the producer threads, on its way to the main thread
+      struct recovered_trx {
+         recover_keys_future                  future;
+         bool                                 persist_until_expired = false;
+         next_function<transaction_trace_ptr> next;
+      };
+
+      static constexpr size_t recovered_trxs_drain_batch = 256;
+
+      // handed over in batches instead of one app().post each, which allocates a closure and takes the queue mutex
+      mpsc_ring<recovered_trx>  _recovered_trxs{ 16384 };
+      std::atomic<bool>         _recovered_trxs_drain_posted{false};
+
+      void schedule_recovered_trxs_drain() {
+         if( _recovered_trxs_drain_posted.exchange( true ) ) return;
+         app().post( priority::low, [self = this]() { self->drain_recovered_trxs(); } );
+      }
+
+      // main thread; a batch at a time so that higher priority work gets in between
+      void drain_recovered_trxs() {
+         // cleared before popping so that a push after the last pop posts another drain
+         _recovered_trxs_drain_posted = false;
+         recovered_trx r;
+         for( size_t n = 0; n < recovered_trxs_drain_batch && _recovered_trxs.pop( r ); ++n ) {
+            process_recovered_trx( r );
+         }
+         if( !_recovered_trxs.empty() ) schedule_recovered_trxs_drain();
+      }
+
+      void process_recovered_trx( recovered_trx& r ) {
+         try {
+            if( _relay_without_execution ) {
+               relay_incoming_transaction( r.future.get(), r.persist_until_expired, std::move( r.next ) );
+            } else {
+               process_incoming_transaction_async( r.future.get(), r.persist_until_expired, std::move( r.next ) );
+            }
+         } CATCH_AND_CALL(r.next);
+      }
+
+      // main thread; the checks which need neither execution nor more than a lookup, signatures being already recovered
+      void check_relayed_transaction( const chain::controller& chain, const transaction_metadata& trx )const {
+         const auto& id = trx.id();
+         const auto& t = trx.packed_trx()->get_transaction();
+         EOS_ASSERT( fc::time_point( t.expiration ) >= chain.head_block_time(), expired_tx_exception,
+                     "expired transaction ${id}, expiration ${e}, block time ${bt}",
+                     ("id", id)("e", t.expiration)("bt", chain.head_block_time()) );
+         EOS_ASSERT( !chain.is_known_unexpired_transaction( id ), tx_duplicate, "duplicate transaction ${id}", ("id", id) );
+
+         const auto& actor_whitelist = chain.get_actor_whitelist();
+         const auto& actor_blacklist = chain.get_actor_blacklist();
+         const auto& contract_whitelist = chain.get_contract_whitelist();
+         const auto& contract_blacklist = chain.get_contract_blacklist();
+         const auto& action_blacklist = chain.get_action_blacklist();
+         for( const auto& a : t.actions ) {
+            EOS_ASSERT( contract_whitelist.empty() || contract_whitelist.count( a.account ), contract_whitelist_exception,
+                        "account '${code}' is not on the contract whitelist", ("code", a.account) );
+            EOS_ASSERT( !contract_whitelist.empty() || !contract_blacklist.count( a.account ), contract_blacklist_exception,
+                        "account '${code}' is on the contract blacklist", ("code", a.account) );
+            EOS_ASSERT( !action_blacklist.count( std::make_pair( a.account, a.name ) ), action_blacklist_exception,
+                        "action '${code}::${action}' is on the action blacklist", ("code", a.account)("action", a.name) );
+            for( const auto& auth : a.authorization ) {
+               EOS_ASSERT( actor_whitelist.empty() || actor_whitelist.count( auth.actor ), actor_whitelist_exception,
+                           "authorizing actor(s) in transaction are not on the actor whitelist: ${actors}", ("actors", vector<account_name>{auth.actor}) );
+               EOS_ASSERT( !actor_whitelist.empty() || !actor_blacklist.count( auth.actor ), actor_blacklist_exception,
+                           "authorizing actor(s) in transaction are on the actor blacklist: ${actors}", ("actors", vector<account_name>{auth.actor}) );
+            }
+         }
+         const auto& key_blacklist = chain.get_key_blacklist();
+         if( !key_blacklist.empty() ) {
+            for( const auto& key : trx.recovered_keys() )
+               EOS_ASSERT( !key_blacklist.count( key ), key_blacklist_exception, "public key '${key}' is on the key blacklist", ("key", key) );
+         }
+      }
+
+      // main thread; forwards trx without executing it, the producers receiving it execute it anyway
+      void relay_incoming_transaction( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
+         chain::controller& chain = chain_plug->chain();
+         if( _relay_execution_sample_interval > 0 && ++_relayed_trxs % _relay_execution_sample_interval == 0 ) {
+            // executed in full, to tell how much of the relayed traffic would fail
+            ++_relay_sampled_trxs;
+            process_incoming_transaction_async( trx, persist_until_expired,
+                  [this, next{std::move(next)}]( const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& response ) {
+               const bool failed = response.contains<fc::exception_ptr>() || response.get<transaction_trace_ptr>()->except;
+               if( failed && ++_relay_sample_failures % 100 == 0 ) {
+                  wlog( "${f} of the ${n} relayed transactions executed as samples failed", ("f", _relay_sample_failures)("n", _relay_sampled_trxs) );
+               }
+               next( response );
+            } );
+            return;
+         }
+
+         try {
+            check_relayed_transaction( chain, *trx );
+         } catch( const fc::exception& e ) {
+            auto except_ptr = e.dynamic_copy_exception();
+            fc_dlog( _trx_trace_log, "[TRX_TRACE] Relay is REJECTING tx: ${txid} : ${why} ", ("txid", trx->id())("why", e.what()) );
+            _metrics.trxs_rejected.add();
+            if( trx->trace ) transaction_tracing::instance().end( trx->id(), std::string( "rejected: " ) + e.what() );
+            next( except_ptr );
+            _transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>( except_ptr, trx ) );
+            return;
+         }
+
+         fc_dlog( _trx_trace_log, "[TRX_TRACE] Relay is FORWARDING tx: ${txid}", ("txid", trx->id()) );
+         _metrics.trxs_relayed.add();
+         if( trx->trace ) transaction_tracing::instance().end( trx->id(), "relayed" );
+         // a trace without action traces, nothing was executed
+         auto trace = std::make_shared<transaction_trace>();
+         trace->id = trx->id();
+         trace->block_num = chain.head_block_num() + 1;
+         trace->block_time = block_timestamp_type( chain.head_block_time() );
+         next( trace );
+         _transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>( nullptr, trx ) );
+      }
+
+      /// @param deprioritized trx already waited behind the transactions of the accounts within their CPU budget
+      void process_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next,
+                                              bool deprioritized = false) {
          chain::controller& chain = chain_plug->chain();
 
+         if( trx->trace ) trx->trace->step( "producer.queue" );
+
          auto send_response = [this, &trx, &chain, &next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& response) {
             next(response);
             if (response.contains<fc::exception_ptr>()) {
+               _metrics.trxs_rejected.add();
+               if( trx->trace )
+                  transaction_tracing::instance().end( trx->id(), std::string( "failed: " ) + response.get<fc::exception_ptr>()->what() );
                _transaction_ack_channel.publish(priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>(response.get<fc::exception_ptr>(), trx));
                if (_pending_block_mode == pending_block_mode::producing) {
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} is REJECTING tx: ${txid} : ${why} ",
@@ -479,6 +795,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                           ("why",response.get<fc::exception_ptr>()->what()));
                }
             } else {
+               _metrics.trxs_accepted.add();
                _transaction_ack_channel.publish(priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>(nullptr, trx));
                if (_pending_block_mode == pending_block_mode::producing) {
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} is ACCEPTING tx: ${txid}",
@@ -511,7 +828,14 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
             }
 
             if( !chain.is_building_block()) {
-               _pending_incoming_transactions.add( trx, persist_until_expired, next );
+               queue_incoming_transaction( trx, persist_until_expired, next );
+               return;
+            }
+
+            if( !deprioritized && _subjective_cpu_ledger.over_budget( first_authorizer_of( trx ), fc::time_point::now() ) ) {
+               fc_dlog( _trx_trace_log, "[TRX_TRACE] First authorizer of tx: ${txid} is over its subjective CPU budget, DEPRIORITIZING",
+                        ("txid", trx->id()) );
+               queue_incoming_transaction( trx, persist_until_expired, next, true );
                return;
             }
 
@@ -524,10 +848,14 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                deadline = block_deadline;
             }
 
+            const auto trx_start = fc::time_point::now();
             auto trace = chain.push_transaction( trx, deadline );
+            if( trace->receipt ) _pending_incoming_transactions.record_cpu_usage( trx, trace->receipt->cpu_usage_us );
+            record_trx_run( trx_start, trace, trace->except && failure_is_subjective( *trace->except, deadline_is_subjective ) );
             if( trace->except ) {
+               _subjective_cpu_ledger.record( first_authorizer_of( trx ), trace->elapsed.count(), fc::time_point::now() );
                if( failure_is_subjective( *trace->except, deadline_is_subjective )) {
-                  _pending_incoming_transactions.add( trx, persist_until_expired, next );
+                  queue_incoming_transaction( trx, persist_until_expired, next, deprioritized );
                   if( _pending_block_mode == pending_block_mode::producing ) {
                      fc_dlog( _trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} COULD NOT FIT, tx: ${txid} RETRYING ",
                               ("block_num", chain.head_block_num() + 1)
@@ -629,6 +957,11 @@ void producer_plugin::set_program_options(
          ("pause-on-startup,x", boost::program_options::bool_switch()->notifier([this](bool p){my->_pause_production = p;}), "Start this node in a state where production is paused")
          ("max-transaction-time", bpo::value<int32_t>()->default_value(30),
           "Limits the maximum time (in milliseconds) that is allowed a pushed transaction's code to execute before being considered invalid")
+         ("relay-without-execution", bpo::bool_switch()->default_value(false),
+          "Forward incoming transactions after checking their signatures, expiration, duplication and the black and white lists, "
+          "without executing them; TaPoS and size are checked by transaction-prevalidation. Only for nodes with no producer-name.")
+         ("relay-execution-sample-interval", bpo::value<uint32_t>()->default_value(0),
+          "With relay-without-execution, execute one in this many incoming transactions as usual and log how many of those fail. 0 executes none.")
          ("max-irreversible-block-age", bpo::value<int32_t>()->default_value( -1 ),
           "Limits the maximum age (in seconds) of the DPOS Irreversible Block for a chain this node will produce blocks on (use negative value to indicate unlimited)")
          ("producer-name,p", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -653,18 +986,65 @@ void producer_plugin::set_program_options(
           "offset of non last block producing time in microseconds. Negative number results in blocks to go out sooner, and positive number results in blocks to go out later")
          ("last-block-time-offset-us", boost::program_options::value<int32_t>()->default_value(0),
           "offset of last block producing time in microseconds. Negative number results in blocks to go out sooner, and positive number results in blocks to go out later")
+         ("adaptive-last-block-time-offset", bpo::bool_switch()->default_value(false),
+          "Adapt the offset of the last block of a round to the latency of the blocks of the next producer, from their timestamp to their validation by this node, "
+          "and to whether the next producer received our last block, within adaptive-last-block-time-offset-min-us and -max-us. "
+          "last-block-time-offset-us is used until blocks of the next producer were received")
+         ("adaptive-last-block-time-offset-min-us", bpo::value<int32_t>()->default_value(-250000),
+          "the earliest the adaptive offset of the last block of a round goes, in microseconds")
+         ("adaptive-last-block-time-offset-max-us", bpo::value<int32_t>()->default_value(0),
+          "the latest the adaptive offset of the last block of a round goes, in microseconds")
+         ("adaptive-last-block-time-offset-margin-us", bpo::value<uint32_t>()->default_value(10000),
+          "microseconds added to the expected latency to the next producer by the adaptive offset of the last block of a round")
+         ("max-scheduled-transaction-cpu-per-block-pct", bpo::value<uint32_t>()->default_value(100),
+          "Percentage of the block CPU limit scheduled transactions may be billed in a produced block before the rest of the block is left to incoming transactions")
          ("max-scheduled-transaction-time-per-block-ms", boost::program_options::value<int32_t>()->default_value(100),
           "Maximum wall-clock time, in milliseconds, spent retiring scheduled transactions in any block before returning to normal transaction processing.")
          ("subjective-cpu-leeway-us", boost::program_options::value<int32_t>()->default_value( config::default_subjective_cpu_leeway_us ),
           "Time in microseconds allowed for a transaction that starts with insufficient CPU quota to complete and cover its CPU usage.")
+         ("subjective-account-cpu-budget-us", bpo::value<uint64_t>()->default_value(0),
+          "CPU time in microseconds of failed incoming transactions, which the chain does not bill, their first authorizer may use "
+          "per subjective-account-cpu-window-ms before its incoming transactions are applied after those of all other accounts (0 to disable)")
+         ("subjective-account-cpu-window-ms", bpo::value<uint32_t>()->default_value(60*1000),
+          "Window in milliseconds over which the CPU time of subjective-account-cpu-budget-us decays")
          ("incoming-defer-ratio", bpo::value<double>()->default_value(1.0),
           "ratio between incoming transations and deferred transactions when both are exhausted")
          ("incoming-transaction-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
           "Maximum size (in MiB) of the incoming transaction queue. Exceeding this value will subjectively drop transaction with resource exhaustion.")
+         ("incoming-transaction-queue-policy", bpo::value<string>()->default_value( "fifo" ),
+          "Order in which incoming transactions are applied, when the queue is full a transaction ordered ahead of the last queued ones evicts them:\n"
+          "   fifo     \tarrival order, a full queue drops new transactions\n"
+          "   account  \tround robin between the first authorizers of the transactions\n"
+          "   expiry   \tearliest expiration first\n"
+          "   cpu      \tlowest CPU usage of previous runs of the same first action first\n"
+          "   priority \tfirst authorizers listed by incoming-transaction-priority-account first, in listed order")
+         ("incoming-transaction-priority-account", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "Account whose transactions are applied first with incoming-transaction-queue-policy=priority, may be specified multiple times in priority order")
+         ("block-timelines", bpo::value<uint32_t>()->default_value(100),
+          "Number of timelines of the most recent produced and received blocks kept for get_block_timelines, 0 disables")
          ("producer-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in producer thread pool")
+         ("prescreen-queued-trxs", bpo::value<uint32_t>()->default_value(0),
+          "Number of queued incoming transactions screened on the producer threads against the state of each produced block while it is signed. "
+          "Those which have expired, use unknown accounts or authorities, or whose authorizers lack the CPU they are estimated to use are "
+          "queued behind the others. 0 disables it.")
+         ("production-realtime-priority", bpo::value<uint32_t>()->default_value(0),
+          "SCHED_FIFO priority (1 to 99) the main thread runs at while producing a block, needs CAP_SYS_NICE or an rtprio limit (0 to disable)")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("background-snapshots", bpo::value<bool>()->default_value(false),
+          "Serialize snapshots to memory and write them to the snapshots directory on the producer threads, so block "
+          "processing only stops for serializing the state. Requires free memory for the size of the snapshot.")
+         ("snapshot-compression", bpo::value<bool>()->default_value(false),
+          "Write snapshots compressed, as chunks of zlib streams with a chunk directory. --snapshot reads both forms.")
+         ("snapshot-deltas", bpo::value<bool>()->default_value(false),
+          "Write with every snapshot after the first one, on the thread pool, a delta against the previous snapshot written by this node "
+          "named after the snapshot with a .delta extension. --snapshot-delta applies it to the previous snapshot.")
+         ("state-checkpoint-interval-blocks", bpo::value<uint32_t>()->default_value(0),
+          "Write a snapshot every this many blocks and, once its block is irreversible, keep it durably in state-checkpoints-dir, "
+          "where state-checkpoint-recovery restarts from after an unclean shutdown (0 to disable)")
+         ("state-checkpoints-to-keep", bpo::value<uint32_t>()->default_value(2),
+          "Number of the most recent state checkpoints kept, older ones are removed")
          ;
    config_file_options.add(producer_options);
 }
@@ -683,7 +1063,7 @@ chain::signature_type producer_plugin::sign_compact(const chain::public_key_type
     auto private_key_itr = my->_signature_providers.find(key);
     EOS_ASSERT(private_key_itr != my->_signature_providers.end(), producer_priv_key_not_found, "Local producer has no private key in config.ini corresponding to public key ${key}", ("key", key));
 
-    return private_key_itr->second(digest);
+    return private_key_itr->second(digest).get();
   }
   else {
     return chain::signature_type();
@@ -706,7 +1086,9 @@ if( options.count(op_name) ) { \
 static producer_plugin_impl::signature_provider_type
 make_key_signature_provider(const private_key_type& key) {
    return [key]( const chain::digest_type& digest ) {
-      return key.sign(digest);
+      std::promise<chain::signature_type> signature;
+      signature.set_value(key.sign(digest));
+      return signature.get_future();
    };
 }
 
@@ -727,9 +1109,14 @@ make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl,
          fc::variant params;
          fc::to_variant(std::make_pair(digest, pubkey), params);
          auto deadline = impl->_keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + impl->_keosd_provider_timeout_us : fc::time_point::maximum();
-         return app().get_plugin<http_client_plugin>().get_client().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
+         auto response = app().get_plugin<http_client_plugin>().post_async(keosd_url, params, deadline);
+         return std::async(std::launch::deferred, [response = std::move(response)]() mutable {
+            return response.get().as<chain::signature_type>();
+         });
       } else {
-         return signature_type();
+         std::promise<chain::signature_type> signature;
+         signature.set_value(signature_type());
+         return signature.get_future();
       }
    };
 }
@@ -756,6 +1143,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
          try {
             auto key_id_to_wif_pair = dejsonify<std::pair<public_key_type, private_key_type>>(key_id_to_wif_pair_string);
             my->_signature_providers[key_id_to_wif_pair.first] = make_key_signature_provider(key_id_to_wif_pair.second);
+            my->_signature_provider_totals[key_id_to_wif_pair.first].provider = "KEY";
             auto blanked_privkey = std::string(std::string(key_id_to_wif_pair.second).size(), '*' );
             wlog("\"private-key\" is DEPRECATED, use \"signature-provider=${pub}=KEY:${priv}\"", ("pub",key_id_to_wif_pair.first)("priv", blanked_privkey));
          } catch ( fc::exception& e ) {
@@ -782,8 +1170,10 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
             if (spec_type_str == "KEY") {
                my->_signature_providers[pubkey] = make_key_signature_provider(private_key_type(spec_data));
+               my->_signature_provider_totals[pubkey].provider = spec_type_str;
             } else if (spec_type_str == "KEOSD") {
                my->_signature_providers[pubkey] = make_keosd_signature_provider(my, spec_data, pubkey);
+               my->_signature_provider_totals[pubkey].provider = spec_data;
             }
 
          } catch (...) {
@@ -797,8 +1187,15 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
    my->_produce_time_offset_us = options.at("produce-time-offset-us").as<int32_t>();
 
    my->_last_block_time_offset_us = options.at("last-block-time-offset-us").as<int32_t>();
+   my->_adaptive_timing.configure( options.at("adaptive-last-block-time-offset").as<bool>(),
+                                   options.at("adaptive-last-block-time-offset-min-us").as<int32_t>(),
+                                   options.at("adaptive-last-block-time-offset-max-us").as<int32_t>(),
+                                   options.at("adaptive-last-block-time-offset-margin-us").as<uint32_t>() );
 
    my->_max_scheduled_transaction_time_per_block_ms = options.at("max-scheduled-transaction-time-per-block-ms").as<int32_t>();
+   my->_max_scheduled_transaction_cpu_per_block_pct = options.at("max-scheduled-transaction-cpu-per-block-pct").as<uint32_t>();
+   EOS_ASSERT( my->_max_scheduled_transaction_cpu_per_block_pct <= 100, plugin_config_exception,
+               "max-scheduled-transaction-cpu-per-block-pct ${p} must be at most 100", ("p", my->_max_scheduled_transaction_cpu_per_block_pct) );
 
    if( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() != config::default_subjective_cpu_leeway_us ) {
       chain.set_subjective_cpu_leeway( fc::microseconds( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() ) );
@@ -808,6 +1205,11 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_max_irreversible_block_age_us = fc::seconds(options.at("max-irreversible-block-age").as<int32_t>());
 
+   my->_relay_without_execution = options.at( "relay-without-execution" ).as<bool>();
+   my->_relay_execution_sample_interval = options.at( "relay-execution-sample-interval" ).as<uint32_t>();
+   EOS_ASSERT( !my->_relay_without_execution || my->_producers.empty(), plugin_config_exception,
+               "relay-without-execution cannot be used with producer-name, producers have to execute the transactions they include" );
+
    auto max_incoming_transaction_queue_size = options.at("incoming-transaction-queue-size-mb").as<uint16_t>() * 1024*1024;
 
    EOS_ASSERT( max_incoming_transaction_queue_size > 0, plugin_config_exception,
@@ -815,12 +1217,56 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_pending_incoming_transactions.set_max_incoming_transaction_queue_size( max_incoming_transaction_queue_size );
 
+   my->_max_block_timelines = options.at("block-timelines").as<uint32_t>();
+
+   const std::string queue_policy = options.at("incoming-transaction-queue-policy").as<std::string>();
+   if( queue_policy == "fifo" ) {
+      my->_pending_incoming_transactions.set_policy( trx_queue_policy::fifo );
+   } else if( queue_policy == "account" ) {
+      my->_pending_incoming_transactions.set_policy( trx_queue_policy::account_fair );
+   } else if( queue_policy == "expiry" ) {
+      my->_pending_incoming_transactions.set_policy( trx_queue_policy::expiry );
+   } else if( queue_policy == "cpu" ) {
+      my->_pending_incoming_transactions.set_policy( trx_queue_policy::cpu );
+   } else if( queue_policy == "priority" ) {
+      my->_pending_incoming_transactions.set_policy( trx_queue_policy::priority );
+   } else {
+      EOS_THROW( plugin_config_exception, "unknown incoming-transaction-queue-policy ${p}", ("p", queue_policy) );
+   }
+   if( options.count("incoming-transaction-priority-account") ) {
+      EOS_ASSERT( queue_policy == "priority", plugin_config_exception,
+                  "incoming-transaction-priority-account requires incoming-transaction-queue-policy=priority" );
+      std::vector<account_name> priority_accounts;
+      for( const auto& a : options["incoming-transaction-priority-account"].as<std::vector<std::string>>() )
+         priority_accounts.emplace_back( a );
+      my->_pending_incoming_transactions.set_priority_accounts( priority_accounts );
+   }
+
+   my->_subjective_cpu_window = fc::milliseconds( options.at("subjective-account-cpu-window-ms").as<uint32_t>() );
+   EOS_ASSERT( my->_subjective_cpu_window.count() > 0, plugin_config_exception, "subjective-account-cpu-window-ms must be greater than 0" );
+   my->_subjective_cpu_ledger.set_budget( options.at("subjective-account-cpu-budget-us").as<uint64_t>(), my->_subjective_cpu_window );
+
    my->_incoming_defer_ratio = options.at("incoming-defer-ratio").as<double>();
 
    auto thread_pool_size = options.at( "producer-threads" ).as<uint16_t>();
    EOS_ASSERT( thread_pool_size > 0, plugin_config_exception,
                "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
    my->_thread_pool.emplace( "prod", thread_pool_size );
+   my->_thread_pool_size = thread_pool_size;
+
+   my->_prescreen_trxs = options.at( "prescreen-queued-trxs" ).as<uint32_t>();
+   my->_pending_incoming_transactions.set_track_cpu_usage( my->_prescreen_trxs > 0 );
+
+   my->_production_realtime_priority = options.at( "production-realtime-priority" ).as<uint32_t>();
+   EOS_ASSERT( my->_production_realtime_priority <= 99, plugin_config_exception,
+               "production-realtime-priority ${p} must be at most 99", ("p", my->_production_realtime_priority) );
+
+   my->_background_snapshots = options.at( "background-snapshots" ).as<bool>();
+   my->_compress_snapshots = options.at( "snapshot-compression" ).as<bool>();
+   my->_snapshot_deltas = options.at( "snapshot-deltas" ).as<bool>();
+   my->_state_checkpoint_interval = options.at( "state-checkpoint-interval-blocks" ).as<uint32_t>();
+   my->_state_checkpoints_to_keep = options.at( "state-checkpoints-to-keep" ).as<uint32_t>();
+   EOS_ASSERT( my->_state_checkpoints_to_keep > 0, plugin_config_exception, "state-checkpoints-to-keep must be greater than 0" );
 
    if( options.count( "snapshots-dir" )) {
       auto sd = options.at( "snapshots-dir" ).as<bfs::path>();
@@ -929,6 +1375,7 @@ void producer_plugin::plugin_shutdown() {
    } catch(fc::exception& e) {
       edump((e.to_detail_string()));
    }
+   my->update_production_priority( false );
 
    if( my->_thread_pool ) {
       my->_thread_pool->stop();
@@ -1003,6 +1450,10 @@ void producer_plugin::update_runtime_options(const runtime_options& options) {
    if (options.greylist_limit) {
       chain.set_greylist_limit(*options.greylist_limit);
    }
+
+   if (options.subjective_account_cpu_budget_us) {
+      my->_subjective_cpu_ledger.set_budget(*options.subjective_account_cpu_budget_us, my->_subjective_cpu_window);
+   }
 }
 
 producer_plugin::runtime_options producer_plugin::get_runtime_options() const {
@@ -1016,7 +1467,8 @@ producer_plugin::runtime_options producer_plugin::get_runtime_options() const {
             my->chain_plug->chain().get_subjective_cpu_leeway()->count() :
             fc::optional<int32_t>(),
       my->_incoming_defer_ratio,
-      my->chain_plug->chain().get_greylist_limit()
+      my->chain_plug->chain().get_greylist_limit(),
+      my->_subjective_cpu_ledger.budget_us()
    };
 }
 
@@ -1067,6 +1519,10 @@ void producer_plugin::set_whitelist_blacklist(const producer_plugin::whitelist_b
    if(params.key_blacklist.valid()) chain.set_key_blacklist(*params.key_blacklist);
 }
 
+chain::whitelist_blacklist_stats producer_plugin::get_whitelist_blacklist_stats() const {
+   return my->chain_plug->chain().get_whitelist_blacklist_stats();
+}
+
 producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash() const {
    chain::controller& chain = my->chain_plug->chain();
 
@@ -1084,9 +1540,25 @@ producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(
    return {chain.head_block_id(), chain.calculate_integrity_hash()};
 }
 
+fc::path producer_plugin::get_snapshots_dir() const {
+   return my->_snapshots_dir;
+}
+
 void producer_plugin::create_snapshot(producer_plugin::next_function<producer_plugin::snapshot_information> next) {
    chain::controller& chain = my->chain_plug->chain();
 
+   if( my->_snapshot_deltas ) {
+      next = [my = my, next]( const fc::static_variant<fc::exception_ptr, producer_plugin::snapshot_information>& result ) {
+         if( result.contains<producer_plugin::snapshot_information>() ) {
+            const bfs::path snapshot_path = result.get<producer_plugin::snapshot_information>().snapshot_name;
+            if( !my->_last_snapshot_path.empty() )
+               my->write_snapshot_delta( my->_last_snapshot_path, snapshot_path );
+            my->_last_snapshot_path = snapshot_path;
+         }
+         next( result );
+      };
+   }
+
    auto head_id = chain.head_block_id();
    const auto& snapshot_path = pending_snapshot::get_final_path(head_id, my->_snapshots_dir);
    const auto& temp_path     = pending_snapshot::get_temp_path(head_id, my->_snapshots_dir);
@@ -1098,15 +1570,33 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
       return;
    }
 
+   auto abort_pending_block = [&]() {
+      if (chain.is_building_block()) {
+         // abort the pending block
+         my->_unapplied_transactions.add_aborted( chain.abort_block() );
+         return true;
+      }
+      return false;
+   };
+
+   auto write_state = [&]( std::ostream& out ) {
+      if( my->_compress_snapshots ) {
+         auto writer = std::make_shared<compressed_ostream_snapshot_writer>(out);
+         chain.write_snapshot(writer);
+         writer->finalize();
+      } else {
+         auto writer = std::make_shared<ostream_snapshot_writer>(out);
+         chain.write_snapshot(writer);
+         writer->finalize();
+      }
+   };
+
    auto write_snapshot = [&]( const bfs::path& p ) -> void {
       auto reschedule = fc::make_scoped_exit([this](){
          my->schedule_production_loop();
       });
 
-      if (chain.is_building_block()) {
-         // abort the pending block
-         my->_unapplied_transactions.add_aborted( chain.abort_block() );
-      } else {
+      if( !abort_pending_block() ) {
          reschedule.cancel();
       }
 
@@ -1114,15 +1604,68 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
 
       // create the snapshot
       auto snap_out = std::ofstream(p.generic_string(), (std::ios::out | std::ios::binary));
-      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-      chain.write_snapshot(writer);
-      writer->finalize();
+      write_state(snap_out);
       snap_out.flush();
       snap_out.close();
    };
 
+   // The state is serialized to memory on the main thread, which takes a fraction of the time of writing it out.
+   // The file is written to temp_path and renamed to p on the thread pool, calling done with the result on the main thread.
+   auto write_snapshot_in_background = [&]( const bfs::path& p, std::function<void(const fc::exception_ptr&)> done ) -> void {
+      auto reschedule = fc::make_scoped_exit([this](){
+         my->schedule_production_loop();
+      });
+
+      if( !abort_pending_block() ) {
+         reschedule.cancel();
+      }
+
+      bfs::create_directory( p.parent_path() );
+
+      auto snap_buf = std::make_shared<std::stringstream>( std::ios::in | std::ios::out | std::ios::binary );
+      write_state(*snap_buf);
+
+      boost::asio::post( my->_thread_pool->get_executor(),
+                         [snap_buf{std::move(snap_buf)}, temp_path, p, head_id, done{std::move(done)}]() {
+         fc::exception_ptr except_ptr;
+         auto set_except_ptr = [&except_ptr]( const fc::exception_ptr& e ) { except_ptr = e; };
+         try {
+            auto snap_out = std::ofstream(temp_path.generic_string(), (std::ios::out | std::ios::binary));
+            snap_out << snap_buf->rdbuf();
+            snap_out.flush();
+            snap_out.close();
+            EOS_ASSERT( snap_out, snapshot_finalization_exception,
+                        "Unable to write snapshot of block number ${bn}", ("bn", block_header::num_from_id(head_id)) );
+
+            boost::system::error_code ec;
+            bfs::rename(temp_path, p, ec);
+            EOS_ASSERT(!ec, snapshot_finalization_exception,
+                  "Unable to promote temp snapshot for block number ${bn}: [code: ${ec}] ${message}",
+                  ("bn", block_header::num_from_id(head_id))
+                  ("ec", ec.value())
+                  ("message", ec.message()));
+         } CATCH_AND_CALL (set_except_ptr);
+         app().post( priority::medium, [except_ptr{std::move(except_ptr)}, done{std::move(done)}]() {
+            done( except_ptr );
+         } );
+      } );
+   };
+
    // If in irreversible mode, create snapshot and return path to snapshot immediately.
    if( chain.get_read_mode() == db_read_mode::IRREVERSIBLE ) {
+      if( my->_background_snapshots ) {
+         try {
+            write_snapshot_in_background( snapshot_path, [next, head_id, snapshot_path]( const fc::exception_ptr& e ) {
+               if( e ) {
+                  next( e );
+               } else {
+                  next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+               }
+            } );
+         } CATCH_AND_CALL (next);
+         return;
+      }
+
       try {
          write_snapshot( temp_path );
 
@@ -1155,6 +1698,29 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
    } else {
       const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir);
 
+      if( my->_background_snapshots ) {
+         try {
+            write_snapshot_in_background( pending_path, [my = my, head_id]( const fc::exception_ptr& e ) {
+               auto& pending_by_id = my->_pending_snapshot_index.get<by_id>();
+               auto itr = pending_by_id.find( head_id );
+               if( itr == pending_by_id.end() ) return;
+               if( e ) {
+                  auto next = itr->next;
+                  pending_by_id.erase( itr );
+                  next( e );
+                  return;
+               }
+               pending_by_id.modify( itr, []( auto& entry ) {
+                  entry.written = true;
+               } );
+               // lib may have passed the snapshot while it was written
+               my->promote_pending_snapshots( my->chain_plug->chain().last_irreversible_block_num() );
+            } );
+            my->_pending_snapshot_index.emplace(head_id, next, pending_path.generic_string(), snapshot_path.generic_string(), false);
+         } CATCH_AND_CALL (next);
+         return;
+      }
+
       try {
          write_snapshot( temp_path ); // create a new pending snapshot
 
@@ -1276,10 +1842,115 @@ producer_plugin::get_account_ram_corrections( const get_account_ram_corrections_
    return result;
 }
 
+void producer_plugin_impl::write_snapshot_delta( const bfs::path& base, const bfs::path& snapshot ) {
+   boost::asio::post( _thread_pool->get_executor(), [base, snapshot]() {
+      const bfs::path delta_path = snapshot.generic_string() + ".delta";
+      const bfs::path temp_path = delta_path.generic_string() + ".tmp";
+      try {
+         {
+            auto base_in = std::ifstream(base.generic_string(), (std::ios::in | std::ios::binary));
+            auto snapshot_in = std::ifstream(snapshot.generic_string(), (std::ios::in | std::ios::binary));
+            auto out = std::ofstream(temp_path.generic_string(), (std::ios::out | std::ios::binary | std::ios::trunc));
+            EOS_ASSERT( base_in && snapshot_in, snapshot_exception, "Unable to open the snapshots to write the delta between" );
+            snapshot_delta::write(base_in, snapshot_in, out);
+         }
+         bfs::rename(temp_path, delta_path);
+         ilog( "wrote snapshot delta ${d} against ${b}", ("d", delta_path.generic_string())("b", base.generic_string()) );
+      } catch( const fc::exception& e ) {
+         elog( "Unable to write snapshot delta ${d}: ${e}", ("d", delta_path.generic_string())("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         elog( "Unable to write snapshot delta ${d}: ${e}", ("d", delta_path.generic_string())("e", e.what()) );
+      }
+   } );
+}
+
+void producer_plugin_impl::maybe_write_state_checkpoint( uint32_t block_num ) {
+   if( _state_checkpoint_interval == 0 || _state_checkpoint_pending || block_num % _state_checkpoint_interval != 0 )
+      return;
+   _state_checkpoint_pending = true;
+   // accepted_block is emitted while the block is still pending, the snapshot is taken once it is committed
+   app().post( priority::low, [this]() {
+      app().get_plugin<producer_plugin>().create_snapshot(
+            [this]( const fc::static_variant<fc::exception_ptr, producer_plugin::snapshot_information>& result ) {
+         _state_checkpoint_pending = false;
+         if( result.contains<fc::exception_ptr>() ) {
+            elog( "Unable to write state checkpoint: ${e}", ("e", result.get<fc::exception_ptr>()->to_detail_string()) );
+            return;
+         }
+         keep_state_checkpoint( result.get<producer_plugin::snapshot_information>().snapshot_name );
+      } );
+   } );
+}
+
+namespace {
+   void fsync_path( const bfs::path& p ) {
+      const int fd = ::open( p.generic_string().c_str(), O_RDONLY );
+      EOS_ASSERT( fd >= 0, snapshot_exception, "Unable to open ${p} to sync it", ("p", p.generic_string()) );
+      const int r = ::fsync( fd );
+      ::close( fd );
+      EOS_ASSERT( r == 0, snapshot_exception, "Unable to sync ${p}", ("p", p.generic_string()) );
+   }
+}
+
+void producer_plugin_impl::keep_state_checkpoint( const bfs::path& snapshot ) {
+   const bfs::path dir = chain_plug->get_state_checkpoints_dir();
+   // with snapshot deltas the snapshot stays in place as the base of the next delta
+   const bool keep_snapshot = _snapshot_deltas;
+   boost::asio::post( _thread_pool->get_executor(), [snapshot, dir, keep_snapshot, to_keep = _state_checkpoints_to_keep]() {
+      const std::string prefix = "state-checkpoint-";
+      const std::string id = snapshot.stem().generic_string().substr( std::string( "snapshot-" ).size() );
+      const bfs::path checkpoint = dir / (prefix + id + ".bin");
+      const bfs::path temp_path = dir / (".incomplete-" + prefix + id + ".bin");
+      try {
+         bfs::create_directories( dir );
+         boost::system::error_code ec;
+         bfs::create_hard_link( snapshot, temp_path, ec );
+         if( ec )
+            bfs::copy_file( snapshot, temp_path, bfs::copy_option::overwrite_if_exists );
+         // only a checkpoint whose content is on disk gets its final name, the name is its mark of integrity
+         fsync_path( temp_path );
+         bfs::rename( temp_path, checkpoint );
+         fsync_path( dir );
+         if( !keep_snapshot )
+            bfs::remove( snapshot );
+         ilog( "wrote state checkpoint ${c}", ("c", checkpoint.generic_string()) );
+
+         std::vector<bfs::path> checkpoints;
+         for( bfs::directory_iterator enditr, itr{dir}; itr != enditr; ++itr ) {
+            const auto name = itr->path().filename().generic_string();
+            if( name.rfind( prefix, 0 ) == 0 && itr->path().extension() == ".bin" )
+               checkpoints.push_back( itr->path() );
+         }
+         // the block number leads the block id, names sort by block
+         std::sort( checkpoints.begin(), checkpoints.end() );
+         for( size_t i = 0; i + to_keep < checkpoints.size(); ++i )
+            bfs::remove( checkpoints[i] );
+      } catch( const fc::exception& e ) {
+         elog( "Unable to keep state checkpoint ${c}: ${e}", ("c", checkpoint.generic_string())("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         elog( "Unable to keep state checkpoint ${c}: ${e}", ("c", checkpoint.generic_string())("e", e.what()) );
+      }
+   } );
+}
+
+std::vector<producer_plugin::signature_provider_stats> producer_plugin::get_signature_provider_stats() const {
+   std::vector<signature_provider_stats> result;
+   result.reserve(my->_signature_provider_totals.size());
+   for (const auto& [key, totals] : my->_signature_provider_totals) {
+      result.push_back({key, totals.provider, totals.signatures, totals.failures,
+                        totals.signatures ? totals.total_us / int64_t(totals.signatures) : 0, totals.max_us, totals.last_us});
+   }
+   return result;
+}
+
+std::vector<producer_plugin::block_timeline> producer_plugin::get_block_timelines() const {
+   return std::vector<block_timeline>( my->_block_timelines.begin(), my->_block_timelines.end() );
+}
+
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
-   const auto& active_schedule = hbs->active_schedule.producers;
+   const auto& active_schedule = hbs->active_schedule->producers;
 
    // determine if this producer is in the active schedule and if so, where
    auto itr = std::find_if(active_schedule.begin(), active_schedule.end(), [&](const auto& asp){ return asp.producer_name == producer_name; });
@@ -1348,6 +2019,11 @@ fc::time_point producer_plugin_impl::calculate_pending_block_time() const {
 
 fc::time_point producer_plugin_impl::calculate_block_deadline( const fc::time_point& block_time ) const {
    bool last_block = ((block_timestamp_type(block_time).slot % config::producer_repetitions) == config::producer_repetitions - 1);
+   if( last_block && _adaptive_timing.enabled() ) {
+      const auto next = chain_plug->chain().head_block_state()->get_scheduled_producer( block_timestamp_type(block_time).next() ).producer_name;
+      if( _producers.count( next ) == 0 )
+         return block_time + fc::microseconds( _adaptive_timing.last_block_offset_us( next, _last_block_time_offset_us ) );
+   }
    return block_time + fc::microseconds(last_block ? _last_block_time_offset_us : _produce_time_offset_us);
 }
 
@@ -1478,6 +2154,16 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
       chain.start_block( block_time, blocks_to_confirm, features_to_activate );
    } LOG_AND_DROP();
 
+   _pending_timeline.reset();
+   if( chain.is_building_block() && _max_block_timelines > 0 ) {
+      _pending_timeline.emplace();
+      _pending_timeline->block_num = chain.head_block_num() + 1;
+      _pending_timeline->producer = scheduled_producer.producer_name;
+      _pending_timeline->produced = true;
+      _pending_timeline->block_time = block_time;
+      _pending_timeline->start_time = now;
+   }
+
    if( chain.is_building_block() ) {
       const auto& pending_block_signing_authority = chain.pending_block_signing_authority();
       const fc::time_point preprocess_deadline = calculate_block_deadline(block_time);
@@ -1488,15 +2174,20 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
       }
 
       try {
-         if( !remove_expired_persisted_trxs( preprocess_deadline ) )
-            return start_block_result::exhausted;
-         if( !remove_expired_blacklisted_trxs( preprocess_deadline ) )
+         auto phase_start = fc::time_point::now();
+         const bool expired_removed = remove_expired_persisted_trxs( preprocess_deadline ) &&
+                                      remove_expired_blacklisted_trxs( preprocess_deadline );
+         record_phase( &block_timeline::remove_expired_us, phase_start );
+         if( !expired_removed )
             return start_block_result::exhausted;
 
          // limit execution of pending incoming to once per block
          size_t pending_incoming_process_limit = _pending_incoming_transactions.size();
 
-         if( !process_unapplied_trxs( preprocess_deadline ) )
+         phase_start = fc::time_point::now();
+         const bool unapplied_processed = process_unapplied_trxs( preprocess_deadline );
+         record_phase( &block_timeline::unapplied_us, phase_start );
+         if( !unapplied_processed )
             return start_block_result::exhausted;
 
          if (_pending_block_mode == pending_block_mode::producing) {
@@ -1508,7 +2199,9 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
                );
             }
             // may exhaust scheduled_trx_deadline but not preprocess_deadline, exhausted preprocess_deadline checked below
+            phase_start = fc::time_point::now();
             process_scheduled_and_incoming_trxs( scheduled_trx_deadline, pending_incoming_process_limit );
+            record_phase( &block_timeline::scheduled_and_incoming_us, phase_start );
          }
 
          if( app().is_quiting() ) // db guard exception above in LOG_AND_DROP could have called app().quit()
@@ -1516,7 +2209,10 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          if (preprocess_deadline <= fc::time_point::now()) {
             return start_block_result::exhausted;
          } else {
-            if( !process_incoming_trxs( preprocess_deadline, pending_incoming_process_limit ) )
+            phase_start = fc::time_point::now();
+            const bool incoming_processed = process_incoming_trxs( preprocess_deadline, pending_incoming_process_limit );
+            record_phase( &block_timeline::incoming_us, phase_start );
+            if( !incoming_processed )
                return start_block_result::exhausted;
             return start_block_result::succeeded;
          }
@@ -1609,8 +2305,9 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
    bool exhausted = false;
    if( !_unapplied_transactions.empty() ) {
       chain::controller& chain = chain_plug->chain();
-      int num_applied = 0, num_failed = 0, num_processed = 0;
+      int num_applied = 0, num_failed = 0, num_processed = 0, num_skipped = 0;
       auto unapplied_trxs_size = _unapplied_transactions.size();
+      const uint32_t pending_block_num = chain.head_block_num() + 1;
       auto itr     = (_pending_block_mode == pending_block_mode::producing) ?
                      _unapplied_transactions.begin() : _unapplied_transactions.persisted_begin();
       auto end_itr = (_pending_block_mode == pending_block_mode::producing) ?
@@ -1621,6 +2318,14 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
             break;
          }
 
+         // skip a transaction failing subjectively before, until it is due or there is the time it used when it failed
+         if( !unapplied_transaction_queue::retry_due( *itr, pending_block_num ) ||
+             fc::time_point::now() + itr->last_failure.elapsed > deadline ) {
+            ++num_skipped;
+            ++itr;
+            continue;
+         }
+
          const transaction_metadata_ptr trx = itr->trx_meta;
          ++num_processed;
          try {
@@ -1632,12 +2337,18 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
                trx_deadline = deadline;
             }
 
+            const auto trx_start = fc::time_point::now();
             auto trace = chain.push_transaction( trx, trx_deadline );
+            record_trx_run( trx_start, trace, trace->except && failure_is_subjective( *trace->except, deadline_is_subjective ) );
             if( trace->except ) {
                if( failure_is_subjective( *trace->except, deadline_is_subjective ) ) {
                   exhausted = true;
                   // don't erase, subjective failure so try again next time
-                  break;
+                  _unapplied_transactions.record_subjective_failure( itr, trace->except->code(), trace->elapsed, pending_block_num );
+                  // out of block time nothing else fits, a block resource limit may still leave room for smaller transactions
+                  if( trace->except->code() == deadline_exception::code_value ) break;
+                  ++itr;
+                  continue;
                } else {
                   // this failed our configured maximum transaction time, we don't want to replay it
                   ++num_failed;
@@ -1653,8 +2364,9 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
          ++itr;
       }
 
-      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}",
-               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed) );
+      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}, "
+                     "Skipped after subjective failure ${skipped}",
+               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed)("skipped", num_skipped) );
    }
    return !exhausted;
 }
@@ -1665,36 +2377,48 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
    int num_applied = 0;
    int num_failed = 0;
    int num_processed = 0;
+   int num_backed_off = 0;
    bool exhausted = false;
    double incoming_trx_weight = 0.0;
 
    auto& blacklist_by_id = _blacklisted_transactions.get<by_id>();
    chain::controller& chain = chain_plug->chain();
-   time_point pending_block_time = chain.pending_block_time();
+   const time_point pending_block_time = chain.pending_block_time();
+   const uint32_t pending_block_num = chain.head_block_num() + 1;
    const auto& sch_idx = chain.db().get_index<generated_transaction_multi_index,by_delay>();
    const auto scheduled_trxs_size = sch_idx.size();
-   auto sch_itr = sch_idx.begin();
-   while( sch_itr != sch_idx.end() ) {
-      if( sch_itr->delay_until > pending_block_time) break;    // not scheduled yet
-      if( sch_itr->published >= pending_block_time ) {
-         ++sch_itr;
-         continue; // do not allow schedule and execute in same block
+
+   // collect the due transactions in one pass, executing them only removes them or schedules new ones for later blocks
+   std::vector<transaction_id_type> due;
+   for( auto sch_itr = sch_idx.begin(); sch_itr != sch_idx.end() && sch_itr->delay_until <= pending_block_time; ++sch_itr ) {
+      if( sch_itr->published >= pending_block_time ) continue; // do not allow schedule and execute in same block
+      if( blacklist_by_id.find( sch_itr->trx_id ) != blacklist_by_id.end() ) continue;
+      auto failure = _scheduled_trx_failures.find( sch_itr->trx_id );
+      if( failure != _scheduled_trx_failures.end() && !unapplied_transaction_queue::retry_due( failure->second, pending_block_num ) ) {
+         ++num_backed_off;
+         continue;
       }
+      due.push_back( sch_itr->trx_id );
+   }
+
+   // drop the failure records of transactions executed or removed since
+   for( auto itr = _scheduled_trx_failures.begin(); itr != _scheduled_trx_failures.end(); ) {
+      if( !chain.db().find<generated_transaction_object, by_trx_id>( itr->first ) ) itr = _scheduled_trx_failures.erase( itr );
+      else ++itr;
+   }
+
+   const int64_t cpu_budget_us = int64_t(chain.get_global_properties().configuration.max_block_cpu_usage)
+                                 * _max_scheduled_transaction_cpu_per_block_pct / 100;
+   int64_t cpu_billed_us = 0;
+
+   for( const auto& trx_id : due ) {
       if( deadline <= fc::time_point::now() ) {
          exhausted = true;
          break;
       }
-
-      const transaction_id_type trx_id = sch_itr->trx_id; // make copy since reference could be invalidated
-      if (blacklist_by_id.find(trx_id) != blacklist_by_id.end()) {
-         ++sch_itr;
-         continue;
-      }
-
-      auto sch_itr_next = sch_itr; // save off next since sch_itr may be invalidated by loop
-      ++sch_itr_next;
-      const auto next_delay_until = sch_itr_next != sch_idx.end() ? sch_itr_next->delay_until : sch_itr->delay_until;
-      const auto next_id = sch_itr_next != sch_idx.end() ? sch_itr_next->id : sch_itr->id;
+      if( cpu_billed_us >= cpu_budget_us ) break; // the rest of the block is left to incoming transactions
+      // removed by an earlier scheduled transaction canceling it
+      if( !chain.db().find<generated_transaction_object, by_trx_id>( trx_id ) ) continue;
 
       num_processed++;
 
@@ -1708,7 +2432,7 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
          auto e = _pending_incoming_transactions.pop_front();
          --pending_incoming_process_limit;
          incoming_trx_weight -= 1.0;
-         process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+         process_incoming_transaction_async(e.trx_meta, e.persist_until_expired, e.next, e.deprioritized());
       }
 
       if (deadline <= fc::time_point::now()) {
@@ -1724,9 +2448,17 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
             trx_deadline = deadline;
          }
 
+         const auto trx_start = fc::time_point::now();
          auto trace = chain.push_scheduled_transaction(trx_id, trx_deadline);
+         record_trx_run( trx_start, trace, trace->except && failure_is_subjective(*trace->except, deadline_is_subjective), true );
+         if( trace->receipt ) cpu_billed_us += trace->receipt->cpu_usage_us;
          if (trace->except) {
             if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
+               auto& f = _scheduled_trx_failures[trx_id];
+               if( f.count == 0 || pending_block_num > f.block_num ) ++f.count;
+               f.code = trace->except->code();
+               f.elapsed = trace->elapsed;
+               f.block_num = pending_block_num;
                exhausted = true;
                break;
             } else {
@@ -1742,15 +2474,13 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
 
       incoming_trx_weight += _incoming_defer_ratio;
       if (!pending_incoming_process_limit) incoming_trx_weight = 0.0;
-
-      if( sch_itr_next == sch_idx.end() ) break;
-      sch_itr = sch_idx.lower_bound( boost::make_tuple( next_delay_until, next_id ) );
    }
 
    if( scheduled_trxs_size > 0 ) {
       fc_dlog( _log,
-               "Processed ${m} of ${n} scheduled transactions, Applied ${applied}, Failed/Dropped ${failed}",
-               ( "m", num_processed )( "n", scheduled_trxs_size )( "applied", num_applied )( "failed", num_failed ) );
+               "Processed ${m} of ${n} scheduled transactions, Applied ${applied}, Failed/Dropped ${failed}, Backed off ${b}, CPU ${c}us",
+               ( "m", num_processed )( "n", scheduled_trxs_size )( "applied", num_applied )( "failed", num_failed )
+               ( "b", num_backed_off )( "c", cpu_billed_us ) );
    }
 
    return !exhausted;
@@ -1769,7 +2499,7 @@ bool producer_plugin_impl::process_incoming_trxs( const fc::time_point& deadline
          }
          auto e = _pending_incoming_transactions.pop_front();
          --pending_incoming_process_limit;
-         process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+         process_incoming_transaction_async(e.trx_meta, e.persist_until_expired, e.next, e.deprioritized());
          ++processed;
       }
       fc_dlog(_log, "Processed ${n} pending transactions, ${p} left", ("n", processed)("p", _pending_incoming_transactions.size()));
@@ -1783,6 +2513,8 @@ void producer_plugin_impl::schedule_production_loop() {
    std::weak_ptr<producer_plugin_impl> weak_this = shared_from_this();
 
    auto result = start_block();
+   update_production_priority( result != start_block_result::failed && result != start_block_result::waiting &&
+                               _pending_block_mode == pending_block_mode::producing );
 
    if (result == start_block_result::failed) {
       elog("Failed to start a pending block, will try again later");
@@ -1811,6 +2543,7 @@ void producer_plugin_impl::schedule_production_loop() {
       static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
       auto deadline = calculate_block_deadline(chain.pending_block_time());
 
+      fc::time_point production_time = deadline;
       if (deadline > fc::time_point::now()) {
          // ship this block off no later than its deadline
          EOS_ASSERT( chain.is_building_block(), missing_pending_block_state, "producing without pending_block_state, start_block succeeded" );
@@ -1822,10 +2555,12 @@ void producer_plugin_impl::schedule_production_loop() {
          auto expect_time = chain.pending_block_time() - fc::microseconds(config::block_interval_us);
          // ship this block off up to 1 block time earlier or immediately
          if (fc::time_point::now() >= expect_time) {
+            production_time = fc::time_point::now();
             _timer.expires_from_now( boost::posix_time::microseconds( 0 ));
             fc_dlog(_log, "Scheduling Block Production on Exhausted Block #${num} immediately",
                           ("num", chain.head_block_num()+1));
          } else {
+            production_time = expect_time;
             _timer.expires_at(epoch + boost::posix_time::microseconds(expect_time.time_since_epoch().count()));
             fc_dlog(_log, "Scheduling Block Production on Exhausted Block #${num} at ${time}",
                           ("num", chain.head_block_num()+1)("time",expect_time));
@@ -1833,9 +2568,11 @@ void producer_plugin_impl::schedule_production_loop() {
       }
 
       _timer.async_wait( app().get_priority_queue().wrap( priority::high,
-            [&chain,weak_this,cid=++_timer_corelation_id](const boost::system::error_code& ec) {
+            [&chain,weak_this,cid=++_timer_corelation_id,production_time](const boost::system::error_code& ec) {
                auto self = weak_this.lock();
                if( self && ec != boost::asio::error::operation_aborted && cid == self->_timer_corelation_id ) {
+                  if( self->_pending_timeline )
+                     self->_pending_timeline->main_thread_wait_us = (fc::time_point::now() - production_time).count();
                   // pending_block_state expected, but can't assert inside async_wait
                   auto block_num = chain.is_building_block() ? chain.head_block_num() + 1 : 0;
                   fc_dlog( _log, "Produce block timer for ${num} running at ${time}", ("num", block_num)("time", fc::time_point::now()) );
@@ -1924,14 +2661,14 @@ void producer_plugin_impl::produce_block() {
 
 
    const auto& auth = chain.pending_block_signing_authority();
-   std::vector<std::reference_wrapper<const signature_provider_type>> relevant_providers;
+   std::vector<std::map<public_key_type, signature_provider_type>::const_iterator> relevant_providers;
 
    relevant_providers.reserve(_signature_providers.size());
 
    producer_authority::for_each_key(auth, [&](const public_key_type& key){
       const auto& iter = _signature_providers.find(key);
       if (iter != _signature_providers.end()) {
-         relevant_providers.emplace_back(iter->second);
+         relevant_providers.emplace_back(iter);
       }
    });
 
@@ -1942,23 +2679,75 @@ void producer_plugin_impl::produce_block() {
       _protocol_features_signaled = false;
    }
 
+   // the queued transactions are screened against the state of this block for the next one
+   fc::optional<transaction_prescreener> prescreener;
+   vector<transaction_prescreener::queued_transaction> to_prescreen;
+   if( _prescreen_trxs > 0 && !_pending_incoming_transactions.empty() ) {
+      prescreener.emplace( chain, chain.pending_block_time() + fc::milliseconds( config::block_interval_ms ) );
+      for( auto& trx : _pending_incoming_transactions.front( _prescreen_trxs ) ) {
+         const uint32_t cpu_estimate_us = _pending_incoming_transactions.cpu_estimate( trx );
+         to_prescreen.push_back( { std::move( trx ), cpu_estimate_us } );
+      }
+   }
+
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
+   const auto finalize_start = fc::time_point::now();
+   fc::microseconds sign_time;
    chain.finalize_block( [&]( const digest_type& d ) {
       auto debug_logger = maybe_make_debug_time_logger();
+      const auto sign_start = fc::time_point::now();
+
+      // nothing modifies the state until the signatures are returned, the worker threads read it meanwhile
+      auto stop_prescreen = fc::make_scoped_exit( [&]() { if( prescreener ) prescreener->stop(); } );
+      if( prescreener ) prescreener->start( _thread_pool->get_executor(), _thread_pool_size, std::move( to_prescreen ) );
+
       vector<signature_type> sigs;
       sigs.reserve(relevant_providers.size());
 
-      // sign with all relevant public keys
+      // sign with all relevant public keys, the providers signing in the background all at once
+      vector<std::future<signature_type>> pending_sigs;
+      pending_sigs.reserve(relevant_providers.size());
       for (const auto& p : relevant_providers) {
-         sigs.emplace_back(p.get()(d));
+         pending_sigs.emplace_back(p->second(d));
+      }
+      for (size_t i = 0; i < pending_sigs.size(); ++i) {
+         auto& totals = _signature_provider_totals[relevant_providers[i]->first];
+         try {
+            sigs.emplace_back(pending_sigs[i].get());
+         } catch (...) {
+            ++totals.failures;
+            throw;
+         }
+         const int64_t us = (fc::time_point::now() - sign_start).count();
+         ++totals.signatures;
+         totals.total_us += us;
+         totals.max_us = std::max(totals.max_us, us);
+         totals.last_us = us;
       }
+      sign_time += fc::time_point::now() - sign_start;
       return sigs;
    } );
 
+   if( prescreener ) deprioritize_prescreened( *prescreener );
+
+   const auto commit_start = fc::time_point::now();
    chain.commit_block();
 
    block_state_ptr new_bs = chain.head_block_state();
 
+   if( _pending_timeline ) {
+      const auto now = fc::time_point::now();
+      _pending_timeline->finalize_us = (commit_start - finalize_start - sign_time).count();
+      _pending_timeline->sign_us = sign_time.count();
+      _pending_timeline->commit_us = (now - commit_start).count();
+      add_block_timeline( std::move( *_pending_timeline ), new_bs->block, now );
+      _pending_timeline.reset();
+   }
+
+   if( _adaptive_timing.enabled() && new_bs->header.timestamp.slot % config::producer_repetitions == config::producer_repetitions - 1 )
+      _last_round_block.emplace( new_bs->id, new_bs->header.timestamp.slot );
+
+   _metrics.blocks_produced.add();
    ilog("Produced block ${id}... #${n} @ ${t} signed by ${p} [trxs: ${count}, lib: ${lib}, confirmed: ${confs}]",
         ("p",new_bs->header.producer)("id",new_bs->id.str().substr(8,16))
         ("n",new_bs->block_num)("t",new_bs->header.timestamp)
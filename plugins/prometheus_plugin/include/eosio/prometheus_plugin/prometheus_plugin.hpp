@@ -0,0 +1,33 @@
+#pragma once
+
+#include <eosio/http_plugin/http_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+/**
+ * Serves every metric of the process wide chain::metrics::registry, which the controller, net_plugin,
+ * producer_plugin, http_plugin and state_history_plugin record, in the prometheus text format on
+ * /v1/prometheus/metrics.
+ */
+class prometheus_plugin : public plugin<prometheus_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((http_plugin))
+
+   prometheus_plugin() = default;
+   prometheus_plugin(const prometheus_plugin&) = delete;
+   prometheus_plugin(prometheus_plugin&&) = delete;
+   prometheus_plugin& operator=(const prometheus_plugin&) = delete;
+   prometheus_plugin& operator=(prometheus_plugin&&) = delete;
+   virtual ~prometheus_plugin() override = default;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
+   void plugin_initialize(const variables_map& vm);
+   void plugin_startup() {}
+   void plugin_shutdown() {}
+};
+
+}
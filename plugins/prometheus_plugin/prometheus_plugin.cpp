@@ -0,0 +1,21 @@
+#include <eosio/prometheus_plugin/prometheus_plugin.hpp>
+#include <eosio/chain/metrics.hpp>
+
+#include <fc/variant.hpp>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _prometheus_plugin = app().register_plugin<prometheus_plugin>();
+
+void prometheus_plugin::plugin_initialize(const variables_map&) {
+   // recording a metric never waits for this, the registry only locks to list the metrics
+   app().get_plugin<http_plugin>().add_plain_text_handler( "/v1/prometheus/metrics", [](string, string body, url_response_callback cb) {
+      try {
+         cb( 200, fc::variant( chain::metrics::registry::instance().prometheus_text() ) );
+      } catch (...) {
+         http_plugin::handle_exception( "prometheus", "metrics", body, cb );
+      }
+   });
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <eosio/state_history_plugin/state_history_plugin.hpp>
+
+namespace eosio {
+
+/*
+ * Filters of get_blocks_request_v1, applied to the decompressed log entries before they are sent. The entries are
+ * only scanned as far as needed to find the accounts, action names and tables; what passes is copied unchanged.
+ */
+
+/// the transaction traces of traces (as stored in the trace log) that have a matching action trace
+bytes filter_traces(const get_blocks_request_v1& req, const bytes& traces);
+
+/// the rows of matching contract tables of deltas (as stored in the chain state log)
+bytes filter_deltas(const get_blocks_request_v1& req, const bytes& deltas);
+
+} // namespace eosio
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <memory>
 #include <stdint.h>
 
 #include <eosio/chain/block_header.hpp>
@@ -26,13 +31,29 @@ namespace eosio {
  * each entry:
  *    state_history_log_header
  *    payload
+ *
+ * payload of version 0 entries:
+ *    uint32_t size, zlib compressed data
+ *
+ * payload of version 1 entries, the codec can differ between entries of a log:
+ *    state_history_compression codec, uint32_t size, compressed data
+ *
+ * A log which retains a window of blocks is split into partitions of the same format. New entries go to *.log, the
+ * active partition; once it holds partition_blocks blocks it is renamed to *-<first block>-<last block>.log, with its
+ * index, and a new active partition is started. The oldest partitions are removed once the newer ones hold at least
+ * retained_blocks blocks.
  */
 
 inline uint64_t       ship_magic(uint32_t version) { return N(ship).to_uint64_t() | version; }
 inline bool           is_ship(uint64_t magic) { return (magic & 0xffff'ffff'0000'0000) == N(ship).to_uint64_t(); }
 inline uint32_t       get_ship_version(uint64_t magic) { return magic; }
-inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) == 0; }
-static const uint32_t ship_current_version = 0;
+inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) <= 1; }
+static const uint32_t ship_current_version = 1;
+
+enum class state_history_compression : uint8_t {
+   zlib = 0,
+   zstd = 1,
+};
 
 struct state_history_log_header {
    uint64_t             magic        = ship_magic(ship_current_version);
@@ -43,27 +64,94 @@ static const int state_history_log_header_serial_size = sizeof(state_history_log
                                                         sizeof(state_history_log_header::block_id) +
                                                         sizeof(state_history_log_header::payload_size);
 
+/// read only mapping of a file which is appended to through a cfile; the mapping grows when more of it is needed
+class state_history_mapped_file {
+ private:
+   std::string                        filename;
+   boost::interprocess::mapped_region region;
+
+ public:
+   explicit state_history_mapped_file(std::string filename)
+       : filename(std::move(filename)) {}
+
+   const char* data() const { return static_cast<const char*>(region.get_address()); }
+   uint64_t    size() const { return region.get_size(); }
+
+   /// maps the file again if the first `needed` bytes are not mapped yet; they have to be flushed to the file
+   void ensure(uint64_t needed) {
+      if (needed <= size())
+         return;
+      boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+      region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+      EOS_ASSERT(needed <= size(), chain::plugin_exception, "read past the end of ${f}", ("f", filename));
+   }
+
+   /// has to be called before the file is truncated, renamed or removed
+   void reset() { region = boost::interprocess::mapped_region(); }
+};
+
+/// read only partition of a log, rolled out of its active partition
+struct state_history_rolled_partition {
+   uint32_t                  begin_block = 0;
+   uint32_t                  end_block   = 0;
+   std::string               log_filename;
+   std::string               index_filename;
+   state_history_mapped_file log_view;
+   state_history_mapped_file index_view;
+
+   state_history_rolled_partition(uint32_t begin_block, uint32_t end_block, std::string log_filename,
+                                  std::string index_filename)
+       : begin_block(begin_block)
+       , end_block(end_block)
+       , log_filename(std::move(log_filename))
+       , index_filename(std::move(index_filename))
+       , log_view(this->log_filename)
+       , index_view(this->index_filename) {}
+
+   uint64_t get_pos(uint32_t block_num) {
+      uint64_t pos;
+      uint64_t offset = (block_num - begin_block) * sizeof(pos);
+      index_view.ensure(offset + sizeof(pos));
+      memcpy(&pos, index_view.data() + offset, sizeof(pos));
+      return pos;
+   }
+};
+
 class state_history_log {
  private:
-   const char* const    name = "";
-   std::string          log_filename;
-   std::string          index_filename;
-   fc::cfile            log;
-   fc::cfile            index;
-   uint32_t             _begin_block = 0;
+   const char* const         name = "";
+   std::string               log_filename;
+   std::string               index_filename;
+   fc::cfile                 log;
+   fc::cfile                 index;
+   state_history_mapped_file log_view;   // reads of entries
+   state_history_mapped_file index_view; // reads of positions
+   uint32_t             _begin_block = 0; // of the active partition
    uint32_t             _end_block   = 0;
    chain::block_id_type last_block_id;
+   uint32_t             retained_blocks  = 0; // 0 retains all blocks
+   uint32_t             partition_blocks = 0; // 0 never rolls the active partition
+   std::deque<std::unique_ptr<state_history_rolled_partition>> rolled; // oldest first
 
  public:
-   state_history_log(const char* const name, std::string log_filename, std::string index_filename)
+   state_history_log(const char* const name, std::string log_filename, std::string index_filename,
+                     uint32_t retained_blocks = 0)
        : name(name)
        , log_filename(std::move(log_filename))
-       , index_filename(std::move(index_filename)) {
+       , index_filename(std::move(index_filename))
+       , log_view(this->log_filename)
+       , index_view(this->index_filename)
+       , retained_blocks(retained_blocks)
+       , partition_blocks(retained_blocks ? std::max<uint32_t>(retained_blocks / 8, 1000) : 0) {
+      open_rolled_partitions();
       open_log();
       open_index();
+      EOS_ASSERT(rolled.empty() || rolled.back()->end_block == _begin_block, chain::plugin_exception,
+                 "${name}.log does not follow ${f}", ("name", name)("f", rolled.back()->log_filename));
+      prune();
    }
 
-   uint32_t begin_block() const { return _begin_block; }
+   uint32_t begin_block() const { return rolled.empty() ? _begin_block : rolled.front()->begin_block; }
    uint32_t end_block() const { return _end_block; }
 
    void read_header(state_history_log_header& header, bool assert_version = true) {
@@ -88,10 +176,14 @@ class state_history_log {
    template <typename F>
    void write_entry(const state_history_log_header& header, const chain::block_id_type& prev_id, F write_payload) {
       auto block_num = chain::block_header::num_from_id(header.block_id);
-      EOS_ASSERT(_begin_block == _end_block || block_num <= _end_block, chain::plugin_exception,
+      EOS_ASSERT(begin_block() == _end_block || block_num <= _end_block, chain::plugin_exception,
                  "missed a block in ${name}.log", ("name", name));
 
-      if (_begin_block != _end_block && block_num > _begin_block) {
+      // a fork which reaches back into rolled partitions continues from the partition holding its first block
+      while (!rolled.empty() && block_num < _begin_block)
+         unroll();
+
+      if (begin_block() != _end_block && block_num > begin_block()) {
          if (block_num == _end_block) {
             EOS_ASSERT(prev_id == last_block_id, chain::plugin_exception, "missed a fork change in ${name}.log",
                        ("name", name));
@@ -105,6 +197,8 @@ class state_history_log {
 
       if (block_num < _end_block)
          truncate(block_num);
+      else if (partition_blocks && _end_block - _begin_block >= partition_blocks)
+         roll();
       log.seek_end(0);
       uint64_t pos = log.tellp();
       write_header(header);
@@ -116,28 +210,140 @@ class state_history_log {
 
       index.seek_end(0);
       index.write((char*)&pos, sizeof(pos));
+      // entries are read through the mappings
+      log.flush();
+      index.flush();
       if (_begin_block == _end_block)
          _begin_block = block_num;
       _end_block    = block_num + 1;
       last_block_id = header.block_id;
    }
 
-   // returns cfile positioned at payload
-   fc::cfile& get_entry(uint32_t block_num, state_history_log_header& header) {
-      EOS_ASSERT(block_num >= _begin_block && block_num < _end_block, chain::plugin_exception,
-                 "read non-existing block in ${name}.log", ("name", name));
-      log.seek(get_pos(block_num));
-      read_header(header);
-      return log;
+   // returns a view of the payload, valid until the log is written to
+   fc::datastream<const char*> get_entry(uint32_t block_num, state_history_log_header& header) {
+      auto [view, pos] = find_entry(block_num);
+      read_mapped_header(*view, pos, header);
+      uint64_t payload_pos = pos + state_history_log_header_serial_size;
+      view->ensure(payload_pos + header.payload_size);
+      return fc::datastream<const char*>(view->data() + payload_pos, header.payload_size);
    }
 
    chain::block_id_type get_block_id(uint32_t block_num) {
+      auto [view, pos] = find_entry(block_num);
       state_history_log_header header;
-      get_entry(block_num, header);
+      read_mapped_header(*view, pos, header);
       return header.block_id;
    }
 
  private:
+   /// the mapped partition holding block_num and the position of its entry there
+   std::pair<state_history_mapped_file*, uint64_t> find_entry(uint32_t block_num) {
+      EOS_ASSERT(block_num >= begin_block() && block_num < _end_block, chain::plugin_exception,
+                 "read non-existing block in ${name}.log", ("name", name));
+      if (block_num >= _begin_block)
+         return {&log_view, get_pos(block_num)};
+      auto it = std::upper_bound(rolled.begin(), rolled.end(), block_num,
+                                 [](uint32_t b, const auto& p) { return b < p->end_block; });
+      return {&(*it)->log_view, (*it)->get_pos(block_num)};
+   }
+
+   std::string partition_filename(uint32_t begin, uint32_t end, const char* extension) const {
+      char suffix[32];
+      snprintf(suffix, sizeof(suffix), "-%010u-%010u", begin, end - 1);
+      return (boost::filesystem::path(log_filename).replace_extension().string() + suffix) + extension;
+   }
+
+   void open_rolled_partitions() {
+      auto base   = boost::filesystem::path(log_filename).replace_extension();
+      auto prefix = base.filename().string() + "-";
+      if (!boost::filesystem::is_directory(base.parent_path()))
+         return;
+      for (auto& entry : boost::filesystem::directory_iterator(base.parent_path())) {
+         auto     filename = entry.path().filename().string();
+         uint32_t begin, last;
+         if (entry.path().extension() != ".log" || filename.compare(0, prefix.size(), prefix) ||
+             sscanf(filename.c_str() + prefix.size(), "%u-%u.log", &begin, &last) != 2 || last < begin)
+            continue;
+         auto index_filename = boost::filesystem::path(entry.path()).replace_extension(".index").string();
+         EOS_ASSERT(boost::filesystem::exists(index_filename) &&
+                        boost::filesystem::file_size(index_filename) == (uint64_t(last) + 1 - begin) * sizeof(uint64_t),
+                    chain::plugin_exception, "corrupt ${f}", ("f", index_filename));
+         rolled.push_back(std::make_unique<state_history_rolled_partition>(begin, last + 1, entry.path().string(),
+                                                                           index_filename));
+      }
+      if (rolled.empty())
+         return;
+      std::sort(rolled.begin(), rolled.end(), [](const auto& a, const auto& b) { return a->begin_block < b->begin_block; });
+      for (size_t i = 1; i < rolled.size(); ++i)
+         EOS_ASSERT(rolled[i - 1]->end_block == rolled[i]->begin_block, chain::plugin_exception,
+                    "${f} does not follow ${p}", ("f", rolled[i]->log_filename)("p", rolled[i - 1]->log_filename));
+
+      // the active partition starts empty after the newest rolled one
+      auto&                    newest = *rolled.back();
+      state_history_log_header header;
+      read_mapped_header(newest.log_view, newest.get_pos(newest.end_block - 1), header);
+      _begin_block = _end_block = newest.end_block;
+      last_block_id             = header.block_id;
+      ilog("${name}.log has rolled partitions with blocks ${b}-${e}",
+           ("name", name)("b", rolled.front()->begin_block)("e", newest.end_block - 1));
+   }
+
+   void close_active() {
+      log.flush();
+      index.flush();
+      log_view.reset();
+      index_view.reset();
+      log.close();
+      index.close();
+   }
+
+   /// renames the active partition to a rolled one and starts an empty one
+   void roll() {
+      close_active();
+      auto p = std::make_unique<state_history_rolled_partition>(_begin_block, _end_block,
+                                                                partition_filename(_begin_block, _end_block, ".log"),
+                                                                partition_filename(_begin_block, _end_block, ".index"));
+      // an index without its log is ignored, one left behind regenerated
+      boost::filesystem::rename(index_filename, p->index_filename);
+      boost::filesystem::rename(log_filename, p->log_filename);
+      ilog("rolled blocks ${b}-${e} of ${name}.log to ${f}",
+           ("b", _begin_block)("e", _end_block - 1)("name", name)("f", p->log_filename));
+      rolled.push_back(std::move(p));
+      _begin_block = _end_block;
+      open_log();
+      open_index();
+      prune();
+   }
+
+   /// makes the newest rolled partition the active one again, the active one only holds blocks after it
+   void unroll() {
+      close_active();
+      auto& p = *rolled.back();
+      p.log_view.reset();
+      p.index_view.reset();
+      boost::filesystem::rename(p.log_filename, log_filename);
+      boost::filesystem::rename(p.index_filename, index_filename);
+      _begin_block = p.begin_block;
+      rolled.pop_back();
+      open_log();
+      open_index();
+   }
+
+   /// removes the oldest rolled partitions the newer ones do not need to hold retained_blocks
+   void prune() {
+      if (!retained_blocks)
+         return;
+      while (!rolled.empty() && _end_block - rolled.front()->end_block >= retained_blocks) {
+         auto& p = *rolled.front();
+         p.log_view.reset();
+         p.index_view.reset();
+         boost::filesystem::remove(p.log_filename);
+         boost::filesystem::remove(p.index_filename);
+         ilog("pruned blocks ${b}-${e} from ${name}.log", ("b", p.begin_block)("e", p.end_block - 1)("name", name));
+         rolled.pop_front();
+      }
+   }
+
    bool get_last_block(uint64_t size) {
       state_history_log_header header;
       uint64_t                 suffix;
@@ -225,6 +431,7 @@ class state_history_log {
       index.seek_end(0);
       if (index.tellp() == (static_cast<int>(_end_block) - _begin_block) * sizeof(uint64_t))
          return;
+      index_view.reset();
       ilog("Regenerate ${name}.index", ("name", name));
       index.close();
       index.open( "w+b" ); // std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::trunc
@@ -257,12 +464,22 @@ class state_history_log {
             fflush(stdout);
          }
       }
+      index.flush();
+   }
+
+   void read_mapped_header(state_history_mapped_file& view, uint64_t pos, state_history_log_header& header) {
+      view.ensure(pos + state_history_log_header_serial_size);
+      fc::datastream<const char*> ds(view.data() + pos, state_history_log_header_serial_size);
+      fc::raw::unpack(ds, header);
+      EOS_ASSERT(is_ship(header.magic) && is_ship_supported_version(header.magic), chain::plugin_exception,
+                 "corrupt ${name}.log (0)", ("name", name));
    }
 
    uint64_t get_pos(uint32_t block_num) {
       uint64_t pos;
-      index.seek((block_num - _begin_block) * sizeof(pos));
-      index.read((char*)&pos, sizeof(pos));
+      uint64_t offset = (block_num - _begin_block) * sizeof(pos);
+      index_view.ensure(offset + sizeof(pos));
+      memcpy(&pos, index_view.data() + offset, sizeof(pos));
       return pos;
    }
 
@@ -270,13 +487,15 @@ class state_history_log {
       log.flush();
       index.flush();
       uint64_t num_removed = 0;
+      log_view.reset();
+      index_view.reset();
       if (block_num <= _begin_block) {
          num_removed = _end_block - _begin_block;
          log.seek(0);
          index.seek(0);
          boost::filesystem::resize_file(log_filename, 0);
          boost::filesystem::resize_file(index_filename, 0);
-         _begin_block = _end_block = 0;
+         _begin_block = _end_block = rolled.empty() ? 0 : _begin_block;
       } else {
          num_removed  = _end_block - block_num;
          uint64_t pos = get_pos(block_num);
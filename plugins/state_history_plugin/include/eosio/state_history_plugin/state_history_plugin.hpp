@@ -98,6 +98,21 @@ struct get_blocks_request_v0 {
    bool                        fetch_deltas           = false;
 };
 
+/// get_blocks_request_v0 with filters applied by the server, an empty filter matches everything
+struct get_blocks_request_v1 : get_blocks_request_v0 {
+   /// transaction traces with an action whose receiver or account is in trace_accounts
+   std::vector<chain::name> trace_accounts = {};
+   /// transaction traces with an action of one of these names
+   std::vector<chain::name> trace_actions  = {};
+   /// contract table deltas with rows of these contracts, other table deltas are not sent when set
+   std::vector<chain::name> delta_codes    = {};
+   /// contract table deltas with rows of these tables, other table deltas are not sent when set
+   std::vector<chain::name> delta_tables   = {};
+
+   bool filters_traces() const { return !trace_accounts.empty() || !trace_actions.empty(); }
+   bool filters_deltas() const { return !delta_codes.empty() || !delta_tables.empty(); }
+};
+
 struct get_blocks_ack_request_v0 {
    uint32_t num_messages = 0;
 };
@@ -112,7 +127,8 @@ struct get_blocks_result_v0 {
    fc::optional<bytes>          deltas;
 };
 
-using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0>;
+using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0,
+                                         get_blocks_request_v1>;
 using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0>;
 
 class state_history_plugin : public plugin<state_history_plugin> {
@@ -141,4 +157,5 @@ FC_REFLECT_EMPTY(eosio::get_status_request_v0);
 FC_REFLECT(eosio::get_status_result_v0, (head)(last_irreversible)(trace_begin_block)(trace_end_block)(chain_state_begin_block)(chain_state_end_block));
 FC_REFLECT(eosio::get_blocks_request_v0, (start_block_num)(end_block_num)(max_messages_in_flight)(have_positions)(irreversible_only)(fetch_block)(fetch_traces)(fetch_deltas));
 FC_REFLECT(eosio::get_blocks_ack_request_v0, (num_messages));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v1, (eosio::get_blocks_request_v0), (trace_accounts)(trace_actions)(delta_codes)(delta_tables));
 // clang-format on
@@ -0,0 +1,151 @@
+#include <eosio/state_history_plugin/state_history_filter.hpp>
+#include <eosio/state_history_plugin/state_history_serialization.hpp>
+
+namespace eosio {
+using namespace chain;
+
+namespace {
+
+using input_stream = fc::datastream<const char*>;
+
+template <typename T>
+T read(input_stream& ds) {
+   T v;
+   fc::raw::unpack(ds, v);
+   return v;
+}
+
+void skip(input_stream& ds, uint64_t size) {
+   EOS_ASSERT(size <= ds.remaining(), plugin_exception, "state history log entry is truncated");
+   ds.skip(size);
+}
+
+void skip_varuint(input_stream& ds) { read<fc::unsigned_int>(ds); }
+void skip_bytes(input_stream& ds) { skip(ds, read<fc::unsigned_int>(ds).value); }
+
+// auth_sequence, authorization and account_ram_deltas entries are all pairs of uint64_t
+void skip_pairs(input_stream& ds) { skip(ds, uint64_t(read<fc::unsigned_int>(ds).value) * 2 * sizeof(uint64_t)); }
+
+bool contains(const std::vector<name>& filter, name n) {
+   return filter.empty() || std::find(filter.begin(), filter.end(), n) != filter.end();
+}
+
+/// skips an action_trace_v0, returns true if it matches the trace filter
+bool scan_action_trace(const get_blocks_request_v1& req, input_stream& ds) {
+   skip_varuint(ds); // variant index
+   skip_varuint(ds); // action_ordinal
+   skip_varuint(ds); // creator_action_ordinal
+   if (read<bool>(ds)) {
+      skip_varuint(ds); // variant index
+      skip(ds, sizeof(uint64_t) + sizeof(digest_type) + sizeof(uint64_t) + sizeof(uint64_t));
+      skip_pairs(ds);   // auth_sequence
+      skip_varuint(ds); // code_sequence
+      skip_varuint(ds); // abi_sequence
+   }
+   name receiver{read<uint64_t>(ds)};
+   name account{read<uint64_t>(ds)};
+   name action{read<uint64_t>(ds)};
+   skip_pairs(ds); // authorization
+   skip_bytes(ds); // data
+   skip(ds, sizeof(bool) + sizeof(int64_t)); // context_free, elapsed
+   skip_bytes(ds); // console
+   skip_pairs(ds); // account_ram_deltas
+   if (read<bool>(ds))
+      skip_bytes(ds); // except
+   if (read<bool>(ds))
+      skip(ds, sizeof(uint64_t)); // error_code
+
+   bool account_matches = contains(req.trace_accounts, receiver) || contains(req.trace_accounts, account);
+   return account_matches && contains(req.trace_actions, action);
+}
+
+/// skips a transaction_trace_v0, returns true if it or its failed deferred transaction has a matching action
+bool scan_transaction_trace(const get_blocks_request_v1& req, input_stream& ds) {
+   skip_varuint(ds); // variant index
+   skip(ds, sizeof(transaction_id_type) + sizeof(uint8_t) + sizeof(uint32_t)); // id, status, cpu_usage_us
+   skip_varuint(ds);                                                           // net_usage_words
+   skip(ds, sizeof(int64_t) + sizeof(uint64_t) + sizeof(bool));                // elapsed, net_usage, scheduled
+
+   bool matches = false;
+   for (uint32_t n = read<fc::unsigned_int>(ds); n > 0; --n)
+      matches = scan_action_trace(req, ds) || matches;
+
+   if (read<bool>(ds))
+      skip(ds, sizeof(uint64_t) + sizeof(int64_t)); // account_ram_delta
+   if (read<bool>(ds))
+      skip_bytes(ds); // except
+   if (read<bool>(ds))
+      skip(ds, sizeof(uint64_t)); // error_code
+   if (read<bool>(ds))
+      matches = scan_transaction_trace(req, ds) || matches; // failed_dtrx_trace
+
+   if (read<bool>(ds)) {
+      // partial_transaction_v0
+      skip_varuint(ds);
+      skip(ds, sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t)); // expiration, ref_block_num, ref_block_prefix
+      skip_varuint(ds);                                                 // max_net_usage_words
+      skip(ds, sizeof(uint8_t));                                        // max_cpu_usage_ms
+      skip_varuint(ds);                                                 // delay_sec
+      read<extensions_type>(ds);
+      read<std::vector<signature_type>>(ds);
+      read<std::vector<bytes>>(ds);
+   }
+   return matches;
+}
+
+/// contract_table, contract_row and the contract_index rows all start with the code, scope and table
+bool contract_row_matches(const get_blocks_request_v1& req, const char* data, size_t size) {
+   input_stream ds(data, size);
+   skip_varuint(ds); // variant index
+   name code{read<uint64_t>(ds)};
+   skip(ds, sizeof(uint64_t)); // scope
+   name table{read<uint64_t>(ds)};
+   return contains(req.delta_codes, code) && contains(req.delta_tables, table);
+}
+
+} // namespace
+
+bytes filter_traces(const get_blocks_request_v1& req, const bytes& traces) {
+   input_stream                                ds(traces.data(), traces.size());
+   std::vector<std::pair<const char*, size_t>> kept;
+   size_t                                      kept_size = 0;
+   for (uint32_t n = read<fc::unsigned_int>(ds); n > 0; --n) {
+      auto begin = ds.pos();
+      if (scan_transaction_trace(req, ds)) {
+         kept.emplace_back(begin, ds.pos() - begin);
+         kept_size += ds.pos() - begin;
+      }
+   }
+
+   fc::unsigned_int      count(kept.size());
+   bytes                 result(fc::raw::pack_size(count) + kept_size);
+   fc::datastream<char*> out(result.data(), result.size());
+   fc::raw::pack(out, count);
+   for (auto& k : kept)
+      out.write(k.first, k.second);
+   return result;
+}
+
+bytes filter_deltas(const get_blocks_request_v1& req, const bytes& deltas) {
+   input_stream             ds(deltas.data(), deltas.size());
+   std::vector<table_delta> result;
+   for (uint32_t n = read<fc::unsigned_int>(ds); n > 0; --n) {
+      table_delta delta;
+      delta.struct_version = read<fc::unsigned_int>(ds);
+      delta.name           = read<std::string>(ds);
+      bool is_contract     = delta.name.compare(0, 9, "contract_") == 0;
+      for (uint32_t rows = read<fc::unsigned_int>(ds); rows > 0; --rows) {
+         bool     present = read<bool>(ds);
+         uint32_t size    = read<fc::unsigned_int>(ds);
+         auto     data    = ds.pos();
+         skip(ds, size);
+         if (is_contract && contract_row_matches(req, data, size))
+            delta.rows.obj.emplace_back(present, bytes(data, data + size));
+      }
+      if (!delta.rows.obj.empty())
+         result.push_back(std::move(delta));
+   }
+   return fc::raw::pack(result);
+}
+
+} // namespace eosio
@@ -1,4 +1,7 @@
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/state_history_plugin/state_history_filter.hpp>
 #include <eosio/state_history_plugin/state_history_log.hpp>
 #include <eosio/state_history_plugin/state_history_serialization.hpp>
 
@@ -13,6 +16,14 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#ifdef EOSIO_SHIP_ZSTD
+#include <zstd.h>
+#endif
+
 using tcp    = boost::asio::ip::tcp;
 namespace ws = boost::beast::websocket;
 
@@ -38,26 +49,80 @@ auto catch_and_log(F f) {
 }
 
 namespace bio = boost::iostreams;
-static bytes zlib_compress_bytes(bytes in) {
+static bytes zlib_compress_bytes(bytes in, int level) {
    bytes                  out;
    bio::filtering_ostream comp;
-   comp.push(bio::zlib_compressor(bio::zlib::default_compression));
+   comp.push(bio::zlib_compressor(level));
    comp.push(bio::back_inserter(out));
    bio::write(comp, in.data(), in.size());
    bio::close(comp);
    return out;
 }
 
-static bytes zlib_decompress(const bytes& in) {
+static bytes zlib_decompress(const char* in, size_t size) {
    bytes                  out;
    bio::filtering_ostream decomp;
    decomp.push(bio::zlib_decompressor());
    decomp.push(bio::back_inserter(out));
-   bio::write(decomp, in.data(), in.size());
+   bio::write(decomp, in, size);
    bio::close(decomp);
    return out;
 }
 
+#ifdef EOSIO_SHIP_ZSTD
+static bytes zstd_compress_bytes(const bytes& in, int level) {
+   bytes  out(ZSTD_compressBound(in.size()));
+   size_t size = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), level);
+   EOS_ASSERT(!ZSTD_isError(size), plugin_exception, "zstd compression failed: ${e}", ("e", ZSTD_getErrorName(size)));
+   out.resize(size);
+   return out;
+}
+
+static bytes zstd_decompress(const char* in, size_t in_size) {
+   auto content_size = ZSTD_getFrameContentSize(in, in_size);
+   EOS_ASSERT(content_size != ZSTD_CONTENTSIZE_ERROR && content_size != ZSTD_CONTENTSIZE_UNKNOWN, plugin_exception,
+              "corrupt zstd entry in state history log");
+   bytes  out(content_size);
+   size_t size = ZSTD_decompress(out.data(), out.size(), in, in_size);
+   EOS_ASSERT(!ZSTD_isError(size) && size == out.size(), plugin_exception, "zstd decompression failed");
+   return out;
+}
+#endif
+
+static bool zstd_supported() {
+#ifdef EOSIO_SHIP_ZSTD
+   return true;
+#else
+   return false;
+#endif
+}
+
+static bytes compress_bytes(bytes in, state_history_compression codec, fc::optional<int> level) {
+   switch (codec) {
+      case state_history_compression::zlib:
+         return zlib_compress_bytes(std::move(in), level ? *level : bio::zlib::default_compression);
+#ifdef EOSIO_SHIP_ZSTD
+      case state_history_compression::zstd:
+         return zstd_compress_bytes(in, level ? *level : ZSTD_CLEVEL_DEFAULT);
+#endif
+      default:
+         EOS_THROW(plugin_exception, "unsupported state history compression ${c}", ("c", (uint32_t)codec));
+   }
+}
+
+static bytes decompress(const char* in, size_t size, state_history_compression codec) {
+   switch (codec) {
+      case state_history_compression::zlib:
+         return zlib_decompress(in, size);
+#ifdef EOSIO_SHIP_ZSTD
+      case state_history_compression::zstd:
+         return zstd_decompress(in, size);
+#endif
+      default:
+         EOS_THROW(plugin_exception, "unsupported state history compression ${c} in log entry", ("c", (uint32_t)codec));
+   }
+}
+
 template <typename T>
 bool include_delta(const T& old, const T& curr) {
    return true;
@@ -115,44 +180,92 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    fc::optional<state_history_log>                            trace_log;
    fc::optional<state_history_log>                            chain_state_log;
    bool                                                       trace_debug_mode = false;
+   state_history_compression                                  compression = state_history_compression::zlib;
+   fc::optional<int>                                          compression_level;
    bool                                                       stopping = false;
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            accepted_block_connection;
    string                                                     endpoint_address = "0.0.0.0";
    uint16_t                                                   endpoint_port    = 8080;
    std::unique_ptr<tcp::acceptor>                             acceptor;
+   chain::metrics::counter&                                   results_sent = chain::metrics::registry::instance().get_counter(
+         "nodeos_ship_results_sent_total", "get_blocks results sent to state history clients" );
+   chain::metrics::gauge&                                     sessions_connected = chain::metrics::registry::instance().get_gauge(
+         "nodeos_ship_sessions", "connected state history clients" );
    std::map<transaction_id_type, augmented_transaction_trace> cached_traces;
    fc::optional<augmented_transaction_trace>                  onblock_trace;
+   bool                                                       chain_state_captured = false;
+
+   // packing, compression and writing of the logs run on write_thread, at most max_pending_writes blocks behind
+   static constexpr uint32_t                                  max_pending_writes = 8;
+   fc::optional<named_thread_pool>                            write_thread;
+   std::mutex                                                 log_mtx; // guards trace_log and chain_state_log
+   std::mutex                                                 pending_mtx;
+   std::condition_variable                                    pending_cv;
+   uint32_t                                                   pending_writes = 0;
+
+   // sessions far behind read and decompress the entries of up to prefetch_blocks blocks ahead on read_threads,
+   // until prefetch_budget bytes of them are waiting to be sent
+   static constexpr uint32_t                                  read_thread_count = 2;
+   uint32_t                                                   prefetch_blocks = 0;
+   uint64_t                                                   prefetch_budget = 0;
+   fc::optional<named_thread_pool>                            read_threads;
+
+   /// the last block in log, 0 if there is none
+   uint32_t last_written_block(state_history_log& log) {
+      std::lock_guard<std::mutex> g(log_mtx);
+      return log.end_block() ? log.end_block() - 1 : 0;
+   }
 
-   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result) {
-      if (block_num < log.begin_block() || block_num >= log.end_block())
-         return;
-      state_history_log_header header;
-      auto&                    stream = log.get_entry(block_num, header);
-      uint32_t                 s;
-      stream.read((char*)&s, sizeof(s));
-      bytes compressed(s);
-      if (s)
-         stream.read(compressed.data(), s);
-      result = zlib_decompress(compressed);
+   void wait_for_pending_writes(uint32_t max_pending) {
+      std::unique_lock<std::mutex> g(pending_mtx);
+      pending_cv.wait(g, [&] { return pending_writes <= max_pending; });
+   }
+
+   /// block_id, if given, is set to the id of the block of the entry
+   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result,
+                      chain::block_id_type* block_id = nullptr) {
+      bytes                     compressed;
+      state_history_compression codec = state_history_compression::zlib;
+      {
+         std::lock_guard<std::mutex> g(log_mtx);
+         if (block_num < log.begin_block() || block_num >= log.end_block())
+            return;
+         state_history_log_header header;
+         auto                     stream = log.get_entry(block_num, header);
+         if (get_ship_version(header.magic) >= 1)
+            stream.read((char*)&codec, sizeof(codec));
+         uint32_t s;
+         stream.read((char*)&s, sizeof(s));
+         EOS_ASSERT(s <= stream.remaining(), plugin_exception, "corrupt entry of block ${b}", ("b", block_num));
+         // copied out of the mapped log, so that entries are decompressed without holding log_mtx
+         compressed.assign(stream.pos(), stream.pos() + s);
+         if (block_id)
+            *block_id = header.block_id;
+      }
+      result = decompress(compressed.data(), compressed.size(), codec);
    }
 
    void get_block(uint32_t block_num, fc::optional<bytes>& result) {
-      chain::signed_block_ptr p;
+      // the bytes packed once for the fork database, or those of the block log, without repacking the block
+      bytes packed;
       try {
-         p = chain_plug->chain().fetch_block_by_number(block_num);
+         packed = chain_plug->chain().fetch_serialized_block_by_number(block_num);
       } catch (...) {
          return;
       }
-      if (p)
-         result = fc::raw::pack(*p);
+      if (!packed.empty())
+         result = std::move(packed);
    }
 
    fc::optional<chain::block_id_type> get_block_id(uint32_t block_num) {
-      if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
-         return trace_log->get_block_id(block_num);
-      if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
-         return chain_state_log->get_block_id(block_num);
+      {
+         std::lock_guard<std::mutex> g(log_mtx);
+         if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
+            return trace_log->get_block_id(block_num);
+         if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
+            return chain_state_log->get_block_id(block_num);
+      }
       try {
          auto block = chain_plug->chain().fetch_block_by_number(block_num);
          if (block)
@@ -162,15 +275,85 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       return {};
    }
 
+   using shared_buffer = std::shared_ptr<const std::vector<char>>;
+   enum class result_part : uint8_t { block, traces, deltas };
+
+   struct cached_part {
+      chain::block_id_type block_id;
+      shared_buffer        data;
+   };
+
+   // block, traces and deltas of recently sent blocks, packed as they appear in get_blocks_result_v0, so that
+   // sessions following the head share one copy instead of each reading, decompressing and packing it again
+   static constexpr size_t                                    max_cached_parts = 3 * 32;
+   std::map<std::pair<uint32_t, result_part>, cached_part>    result_cache;
+
+   static shared_buffer pack_part(const fc::optional<bytes>& part) {
+      fc::datastream<size_t> ps;
+      history_pack_big_bytes(ps, part);
+      auto                  data = std::make_shared<std::vector<char>>(ps.tellp());
+      fc::datastream<char*> ds(data->data(), data->size());
+      history_pack_big_bytes(ds, part);
+      return data;
+   }
+
+   static const shared_buffer& absent_part() {
+      static const shared_buffer absent = pack_part({});
+      return absent;
+   }
+
+   /// block_id is the id of block_num the session is sending; an entry of a block that was forked out is replaced
+   shared_buffer get_result_part(uint32_t block_num, const chain::block_id_type& block_id, result_part part) {
+      auto key = std::make_pair(block_num, part);
+      auto it  = result_cache.find(key);
+      if (it != result_cache.end() && it->second.block_id == block_id)
+         return it->second.data;
+
+      fc::optional<bytes> result;
+      if (part == result_part::block)
+         get_block(block_num, result);
+      else if (part == result_part::traces && trace_log)
+         get_log_entry(*trace_log, block_num, result);
+      else if (part == result_part::deltas && chain_state_log)
+         get_log_entry(*chain_state_log, block_num, result);
+      auto data = pack_part(result);
+
+      result_cache[key] = cached_part{block_id, data};
+      // sessions catching up from far behind should not push out the blocks the live sessions are about to send
+      while (result_cache.size() > max_cached_parts)
+         result_cache.erase(result_cache.begin());
+      return data;
+   }
+
    struct session : std::enable_shared_from_this<session> {
+      // a websocket message, written as a sequence of buffers that may be shared with other sessions
+      using message = std::vector<shared_buffer>;
+
+      // while catching up this many results are queued at once, so they are written back to back
+      static constexpr uint32_t max_results_per_update = 8;
+
       std::shared_ptr<state_history_plugin_impl> plugin;
       std::unique_ptr<ws::stream<tcp::socket>>   socket_stream;
       bool                                       sending  = false;
       bool                                       sent_abi = false;
-      std::vector<std::vector<char>>             send_queue;
-      fc::optional<get_blocks_request_v0>        current_request;
+      std::deque<message>                        send_queue;
+      std::vector<boost::asio::const_buffer>     send_buffers; // of send_queue.front() while it is being written
+      fc::optional<get_blocks_request_v1>        current_request;
       bool                                       need_to_send_update = false;
 
+      struct prefetched_entry {
+         chain::block_id_type        block_id; // of the log entries
+         fc::optional<shared_buffer> traces;
+         fc::optional<shared_buffer> deltas;
+         uint64_t                    size = 0;
+      };
+      // an empty entry is still being read; entries read for an earlier prefetch_generation are dropped
+      std::map<uint32_t, fc::optional<prefetched_entry>> prefetched;
+      uint64_t                                           prefetched_size     = 0;
+      uint32_t                                           next_prefetch       = 0;
+      uint32_t                                           prefetch_generation = 0;
+      std::shared_ptr<const get_blocks_request_v1>       prefetch_request; // current_request, shared with read_threads
+
       session(std::shared_ptr<state_history_plugin_impl> plugin)
           : plugin(std::move(plugin)) {}
 
@@ -206,13 +389,13 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
 
       void send(const char* s) {
-         send_queue.push_back({s, s + strlen(s)});
+         send_queue.push_back({std::make_shared<const std::vector<char>>(s, s + strlen(s))});
          send();
       }
 
       template <typename T>
       void send(T obj) {
-         send_queue.push_back(fc::raw::pack(state_result{std::move(obj)}));
+         send_queue.push_back({std::make_shared<const std::vector<char>>(fc::raw::pack(state_result{std::move(obj)}))});
          send();
       }
 
@@ -224,35 +407,78 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          sending = true;
          socket_stream->binary(sent_abi);
          sent_abi = true;
+         send_buffers.clear();
+         for (auto& b : send_queue.front())
+            send_buffers.push_back(boost::asio::buffer(*b));
          socket_stream->async_write( //
-             boost::asio::buffer(send_queue[0]),
+             send_buffers,
              [self = shared_from_this()](boost::system::error_code ec, size_t) {
                 self->callback(ec, "async_write", [self] {
-                   self->send_queue.erase(self->send_queue.begin());
+                   self->send_queue.pop_front();
                    self->sending = false;
                    self->send();
                 });
              });
       }
 
+      /// the filtered entry is specific to this session, so unlike the unfiltered one it is not cached
+      template <typename F>
+      shared_buffer get_filtered_part(state_history_log& log, uint32_t block_num, F filter) {
+         fc::optional<bytes> entry;
+         plugin->get_log_entry(log, block_num, entry);
+         if (entry)
+            entry = filter(*current_request, *entry);
+         return pack_part(entry);
+      }
+
+      /// get_blocks_result_v0 as a state_result; only the leading positions are packed for this session
+      message pack_blocks_result(const get_blocks_result_v0& result, const fc::optional<shared_buffer>& block,
+                                 const fc::optional<shared_buffer>& traces,
+                                 const fc::optional<shared_buffer>& deltas) {
+         auto pack_positions = [&](auto& ds) {
+            fc::raw::pack(ds, fc::unsigned_int(state_result{get_blocks_result_v0{}}.which()));
+            fc::raw::pack(ds, result.head);
+            fc::raw::pack(ds, result.last_irreversible);
+            fc::raw::pack(ds, result.this_block);
+            fc::raw::pack(ds, result.prev_block);
+         };
+         fc::datastream<size_t> ps;
+         pack_positions(ps);
+         auto                  positions = std::make_shared<std::vector<char>>(ps.tellp());
+         fc::datastream<char*> ds(positions->data(), positions->size());
+         pack_positions(ds);
+
+         return {positions, block ? *block : absent_part(), traces ? *traces : absent_part(),
+                 deltas ? *deltas : absent_part()};
+      }
+
       using result_type = void;
       void operator()(get_status_request_v0&) {
          auto&                chain = plugin->chain_plug->chain();
          get_status_result_v0 result;
          result.head              = {chain.head_block_num(), chain.head_block_id()};
          result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
-         if (plugin->trace_log) {
-            result.trace_begin_block = plugin->trace_log->begin_block();
-            result.trace_end_block   = plugin->trace_log->end_block();
-         }
-         if (plugin->chain_state_log) {
-            result.chain_state_begin_block = plugin->chain_state_log->begin_block();
-            result.chain_state_end_block   = plugin->chain_state_log->end_block();
+         {
+            std::lock_guard<std::mutex> g(plugin->log_mtx);
+            if (plugin->trace_log) {
+               result.trace_begin_block = plugin->trace_log->begin_block();
+               result.trace_end_block   = plugin->trace_log->end_block();
+            }
+            if (plugin->chain_state_log) {
+               result.chain_state_begin_block = plugin->chain_state_log->begin_block();
+               result.chain_state_end_block   = plugin->chain_state_log->end_block();
+            }
          }
          send(std::move(result));
       }
 
       void operator()(get_blocks_request_v0& req) {
+         get_blocks_request_v1 unfiltered;
+         static_cast<get_blocks_request_v0&>(unfiltered) = std::move(req);
+         (*this)(unfiltered);
+      }
+
+      void operator()(get_blocks_request_v1& req) {
          for (auto& cp : req.have_positions) {
             if (req.start_block_num <= cp.block_num)
                continue;
@@ -262,9 +488,105 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          }
          req.have_positions.clear();
          current_request = req;
+         reset_prefetch();
          send_update(true);
       }
 
+      /// has to be called when current_request changes
+      void reset_prefetch() {
+         prefetched.clear();
+         prefetched_size = 0;
+         next_prefetch   = 0;
+         ++prefetch_generation;
+         prefetch_request.reset();
+      }
+
+      /// reads the entries of the next blocks ahead of current_request on read_threads, unless the session is close to
+      /// current, the last block it may send, where they are shared with the other sessions through result_cache
+      void prefetch(uint32_t current) {
+         while (!prefetched.empty() && prefetched.begin()->first < current_request->start_block_num &&
+                prefetched.begin()->second) {
+            prefetched_size -= prefetched.begin()->second->size;
+            prefetched.erase(prefetched.begin());
+         }
+         if (!plugin->read_threads ||
+             uint64_t(current_request->start_block_num) + plugin->prefetch_blocks > current ||
+             !((current_request->fetch_traces && plugin->trace_log) ||
+               (current_request->fetch_deltas && plugin->chain_state_log)))
+            return;
+         if (!prefetch_request)
+            prefetch_request = std::make_shared<const get_blocks_request_v1>(*current_request);
+         next_prefetch = std::max(next_prefetch, current_request->start_block_num);
+         auto last     = std::min<uint64_t>(current_request->end_block_num,
+                                            uint64_t(current_request->start_block_num) + plugin->prefetch_blocks);
+         for (; next_prefetch < last && prefetched_size < plugin->prefetch_budget; ++next_prefetch) {
+            prefetched[next_prefetch];
+            boost::asio::post(plugin->read_threads->get_executor(), [self = shared_from_this(), block_num = next_prefetch,
+                                                                     generation = prefetch_generation,
+                                                                     req        = prefetch_request]() {
+               auto entry = std::make_shared<fc::optional<prefetched_entry>>();
+               try {
+                  *entry = self->read_entry(*req, block_num);
+               } catch (...) {
+                  // read again, reporting the error, when it is sent
+               }
+               app().post(priority::medium, [self, block_num, generation, entry]() {
+                  if (self->plugin->stopping || !self->plugin->sessions.count(self.get()) ||
+                      generation != self->prefetch_generation)
+                     return;
+                  auto it = self->prefetched.find(block_num);
+                  if (it == self->prefetched.end())
+                     return;
+                  if (!*entry) {
+                     self->prefetched.erase(it);
+                  } else {
+                     self->prefetched_size += (*entry)->size;
+                     it->second = std::move(*entry);
+                  }
+                  self->send_update();
+               });
+            });
+         }
+      }
+
+      /// runs on read_threads
+      prefetched_entry read_entry(const get_blocks_request_v1& req, uint32_t block_num) {
+         prefetched_entry entry;
+         auto             read = [&](state_history_log& log, bool filtered, auto filter) {
+            fc::optional<bytes>  data;
+            chain::block_id_type block_id;
+            plugin->get_log_entry(log, block_num, data, &block_id);
+            if (data) {
+               EOS_ASSERT(entry.block_id == chain::block_id_type() || entry.block_id == block_id, plugin_exception,
+                          "block ${b} changed while it was read", ("b", block_num));
+               entry.block_id = block_id;
+               if (filtered)
+                  data = filter(req, *data);
+            }
+            auto part = pack_part(data);
+            entry.size += part->size();
+            return part;
+         };
+         if (req.fetch_traces && plugin->trace_log)
+            entry.traces = read(*plugin->trace_log, req.filters_traces(), filter_traces);
+         if (req.fetch_deltas && plugin->chain_state_log)
+            entry.deltas = read(*plugin->chain_state_log, req.filters_deltas(), filter_deltas);
+         return entry;
+      }
+
+      /// the prefetched entry of block_num if it is of block_id
+      fc::optional<prefetched_entry> take_prefetched(uint32_t block_num, const chain::block_id_type& block_id) {
+         fc::optional<prefetched_entry> result;
+         auto                           it = prefetched.find(block_num);
+         if (it == prefetched.end() || !it->second)
+            return result;
+         prefetched_size -= it->second->size;
+         if (it->second->block_id == block_id)
+            result = std::move(it->second);
+         prefetched.erase(it);
+         return result;
+      }
+
       void operator()(get_blocks_ack_request_v0& req) {
          if (!current_request)
             return;
@@ -279,32 +601,63 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
              !current_request->max_messages_in_flight)
             return;
          auto&                chain = plugin->chain_plug->chain();
-         get_blocks_result_v0 result;
-         result.head              = {chain.head_block_num(), chain.head_block_id()};
-         result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
+         get_blocks_result_v0 positions;
+         positions.head              = {chain.head_block_num(), chain.head_block_id()};
+         positions.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
          uint32_t current =
-             current_request->irreversible_only ? result.last_irreversible.block_num : result.head.block_num;
-         if (current_request->start_block_num <= current &&
-             current_request->start_block_num < current_request->end_block_num) {
-            auto block_id = plugin->get_block_id(current_request->start_block_num);
-            if (block_id) {
-               result.this_block  = block_position{current_request->start_block_num, *block_id};
-               auto prev_block_id = plugin->get_block_id(current_request->start_block_num - 1);
-               if (prev_block_id)
-                  result.prev_block = block_position{current_request->start_block_num - 1, *prev_block_id};
-               if (current_request->fetch_block)
-                  plugin->get_block(current_request->start_block_num, result.block);
-               if (current_request->fetch_traces && plugin->trace_log)
-                  plugin->get_log_entry(*plugin->trace_log, current_request->start_block_num, result.traces);
-               if (current_request->fetch_deltas && plugin->chain_state_log)
-                  plugin->get_log_entry(*plugin->chain_state_log, current_request->start_block_num, result.deltas);
+             current_request->irreversible_only ? positions.last_irreversible.block_num : positions.head.block_num;
+         // blocks still being written are sent once they are in the logs
+         if (current_request->fetch_traces && plugin->trace_log)
+            current = std::min(current, plugin->last_written_block(*plugin->trace_log));
+         if (current_request->fetch_deltas && plugin->chain_state_log)
+            current = std::min(current, plugin->last_written_block(*plugin->chain_state_log));
+
+         prefetch(current);
+
+         for (uint32_t n = 0; n < max_results_per_update && current_request->max_messages_in_flight &&
+                              (n == 0 || need_to_send_update);
+              ++n) {
+            // results are sent in order, this one is sent once its entries are read
+            auto waiting = prefetched.find(current_request->start_block_num);
+            if (waiting != prefetched.end() && !waiting->second)
+               break;
+            get_blocks_result_v0        result = positions;
+            fc::optional<shared_buffer> block, traces, deltas;
+            if (current_request->start_block_num <= current &&
+                current_request->start_block_num < current_request->end_block_num) {
+               auto block_num = current_request->start_block_num;
+               auto block_id  = plugin->get_block_id(block_num);
+               if (block_id) {
+                  result.this_block  = block_position{block_num, *block_id};
+                  auto prev_block_id = plugin->get_block_id(block_num - 1);
+                  if (prev_block_id)
+                     result.prev_block = block_position{block_num - 1, *prev_block_id};
+                  if (current_request->fetch_block)
+                     block = plugin->get_result_part(block_num, *block_id, result_part::block);
+                  if (auto entry = take_prefetched(block_num, *block_id)) {
+                     traces = std::move(entry->traces);
+                     deltas = std::move(entry->deltas);
+                  } else {
+                     if (current_request->fetch_traces && plugin->trace_log)
+                        traces = current_request->filters_traces()
+                                     ? get_filtered_part(*plugin->trace_log, block_num, filter_traces)
+                                     : plugin->get_result_part(block_num, *block_id, result_part::traces);
+                     if (current_request->fetch_deltas && plugin->chain_state_log)
+                        deltas = current_request->filters_deltas()
+                                     ? get_filtered_part(*plugin->chain_state_log, block_num, filter_deltas)
+                                     : plugin->get_result_part(block_num, *block_id, result_part::deltas);
+                  }
+               }
+               ++current_request->start_block_num;
             }
-            ++current_request->start_block_num;
+            send_queue.push_back(pack_blocks_result(result, block, traces, deltas));
+            plugin->results_sent.add();
+            --current_request->max_messages_in_flight;
+            need_to_send_update = current_request->start_block_num <= current &&
+                                  current_request->start_block_num < current_request->end_block_num;
          }
-         send(std::move(result));
-         --current_request->max_messages_in_flight;
-         need_to_send_update = current_request->start_block_num <= current &&
-                               current_request->start_block_num < current_request->end_block_num;
+         if (!send_queue.empty())
+            send();
       }
 
       template <typename F>
@@ -346,6 +699,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       void close() {
          socket_stream->next_layer().close();
          plugin->sessions.erase(this);
+         plugin->sessions_connected.set(plugin->sessions.size());
       }
    };
    std::map<session*, std::shared_ptr<session>> sessions;
@@ -387,6 +741,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          catch_and_log([&] {
             auto s            = std::make_shared<session>(self);
             sessions[s.get()] = s;
+            sessions_connected.set(sessions.size());
             s->start(std::move(*socket));
          });
          catch_and_log([&] { do_accept(); });
@@ -417,22 +772,51 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    }
 
    void on_accepted_block(const block_state_ptr& block_state) {
-      store_traces(block_state);
-      store_chain_state(block_state);
+      auto traces = capture_traces(block_state);
+      auto deltas = capture_chain_state(block_state);
+      if (!write_thread)
+         return notify_sessions(block_state->block_num);
+
+      // back-pressure, block application waits for the writes to catch up
+      wait_for_pending_writes(max_pending_writes - 1);
+      {
+         std::lock_guard<std::mutex> g(pending_mtx);
+         ++pending_writes;
+      }
+      auto& db = chain_plug->chain().db();
+      boost::asio::post(write_thread->get_executor(), [self = shared_from_this(), &db, block_state,
+                                                       traces = std::move(traces), deltas = std::move(deltas)]() {
+         catch_and_log([&] { self->store_traces(db, block_state, traces); });
+         catch_and_log([&] { self->store_chain_state(block_state, deltas); });
+         {
+            std::lock_guard<std::mutex> g(self->pending_mtx);
+            --self->pending_writes;
+         }
+         self->pending_cv.notify_all();
+         app().post(priority::medium, [self, block_num = block_state->block_num]() {
+            if (!self->stopping)
+               self->notify_sessions(block_num);
+         });
+      });
+   }
+
+   void notify_sessions(uint32_t block_num) {
       for (auto& s : sessions) {
          auto& p = s.second;
          if (p) {
-            if (p->current_request && block_state->block_num < p->current_request->start_block_num)
-               p->current_request->start_block_num = block_state->block_num;
+            if (p->current_request && block_num < p->current_request->start_block_num) {
+               p->current_request->start_block_num = block_num;
+               p->reset_prefetch();
+            }
             p->send_update(true);
          }
       }
    }
 
-   void store_traces(const block_state_ptr& block_state) {
-      if (!trace_log)
-         return;
+   std::vector<augmented_transaction_trace> capture_traces(const block_state_ptr& block_state) {
       std::vector<augmented_transaction_trace> traces;
+      if (!trace_log)
+         return traces;
       if (onblock_trace)
          traces.push_back(*onblock_trace);
       for (auto& r : block_state->block->transactions) {
@@ -448,30 +832,41 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
       cached_traces.clear();
       onblock_trace.reset();
+      return traces;
+   }
 
-      auto& db         = chain_plug->chain().db();
-      auto  traces_bin = zlib_compress_bytes(fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)));
+   // runs on write_thread, traces are serialized without reading from db
+   void store_traces(const chainbase::database& db, const block_state_ptr& block_state,
+                     const std::vector<augmented_transaction_trace>& traces) {
+      if (!trace_log)
+         return;
+      auto traces_bin = compress_bytes(fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)),
+                                       compression, compression_level);
       EOS_ASSERT(traces_bin.size() == (uint32_t)traces_bin.size(), plugin_exception, "traces is too big");
 
       state_history_log_header header{.magic        = ship_magic(ship_current_version),
                                       .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + traces_bin.size()};
+                                      .payload_size = sizeof(compression) + sizeof(uint32_t) + traces_bin.size()};
+      std::lock_guard<std::mutex> g(log_mtx);
       trace_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
          uint32_t s = (uint32_t)traces_bin.size();
+         stream.write((char*)&compression, sizeof(compression));
          stream.write((char*)&s, sizeof(s));
          if (!traces_bin.empty())
             stream.write(traces_bin.data(), traces_bin.size());
       });
    }
 
-   void store_chain_state(const block_state_ptr& block_state) {
+   /// rows are packed here since they are read from db, which changes with the next block
+   std::vector<table_delta> capture_chain_state(const block_state_ptr& block_state) {
+      std::vector<table_delta> deltas;
       if (!chain_state_log)
-         return;
-      bool fresh = chain_state_log->begin_block() == chain_state_log->end_block();
+         return deltas;
+      bool fresh = !chain_state_captured;
+      chain_state_captured = true;
       if (fresh)
          ilog("Placing initial state in block ${n}", ("n", block_state->block->block_num()));
 
-      std::vector<table_delta> deltas;
       auto&                    db = chain_plug->chain().db();
 
       const auto&                                table_id_index = db.get_index<table_id_multi_index>();
@@ -549,14 +944,22 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       process_table("resource_usage", db.get_index<resource_limits::resource_usage_index>(), pack_row);
       process_table("resource_limits_state", db.get_index<resource_limits::resource_limits_state_index>(), pack_row);
       process_table("resource_limits_config", db.get_index<resource_limits::resource_limits_config_index>(), pack_row);
+      return deltas;
+   }
 
-      auto deltas_bin = zlib_compress_bytes(fc::raw::pack(deltas));
+   // runs on write_thread
+   void store_chain_state(const block_state_ptr& block_state, const std::vector<table_delta>& deltas) {
+      if (!chain_state_log)
+         return;
+      auto deltas_bin = compress_bytes(fc::raw::pack(deltas), compression, compression_level);
       EOS_ASSERT(deltas_bin.size() == (uint32_t)deltas_bin.size(), plugin_exception, "deltas is too big");
       state_history_log_header header{.magic        = ship_magic(ship_current_version),
                                       .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + deltas_bin.size()};
+                                      .payload_size = sizeof(compression) + sizeof(uint32_t) + deltas_bin.size()};
+      std::lock_guard<std::mutex> g(log_mtx);
       chain_state_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
          uint32_t s = (uint32_t)deltas_bin.size();
+         stream.write((char*)&compression, sizeof(compression));
          stream.write((char*)&s, sizeof(s));
          if (!deltas_bin.empty())
             stream.write(deltas_bin.data(), deltas_bin.size());
@@ -581,6 +984,22 @@ void state_history_plugin::set_program_options(options_description& cli, options
            "your internal network.");
    options("trace-history-debug-mode", bpo::bool_switch()->default_value(false),
            "enable debug mode for trace history");
+   options("state-history-compression", bpo::value<string>()->default_value("zlib"),
+           "compression of new state history log entries, existing entries are read with the codec they were written "
+           "with:\n"
+           "  \"zlib\"\n"
+           "  \"zstd\" - only if nodeos was built with zstd");
+   options("state-history-compression-level", bpo::value<int>(),
+           "compression level of state-history-compression, default is the default level of the codec");
+   options("state-history-prefetch-blocks", bpo::value<uint32_t>()->default_value(32),
+           "number of blocks ahead whose traces and deltas a session catching up reads and decompresses in the "
+           "background, 0 reads them as they are sent");
+   options("state-history-prefetch-mb", bpo::value<uint32_t>()->default_value(64),
+           "size in MiB of the read ahead traces and deltas a session catching up may hold");
+   options("state-history-retained-blocks", bpo::value<uint32_t>()->default_value(0),
+           "number of most recent blocks the state history logs retain, 0 retains all of them. The logs are split into "
+           "partitions of an eighth of this number of blocks, at least 1000, the oldest ones are removed as new ones are "
+           "written");
 }
 
 void state_history_plugin::plugin_initialize(const variables_map& options) {
@@ -622,12 +1041,36 @@ void state_history_plugin::plugin_initialize(const variables_map& options) {
          my->trace_debug_mode = true;
       }
 
+      const auto& compression = options.at("state-history-compression").as<string>();
+      if (compression == "zstd") {
+         EOS_ASSERT(zstd_supported(), plugin_config_exception, "nodeos was built without zstd support");
+         my->compression = state_history_compression::zstd;
+      } else {
+         EOS_ASSERT(compression == "zlib", plugin_config_exception, "unknown state-history-compression ${c}",
+                    ("c", compression));
+      }
+      if (options.count("state-history-compression-level")) {
+         my->compression_level = options.at("state-history-compression-level").as<int>();
+         EOS_ASSERT(my->compression != state_history_compression::zlib ||
+                        (*my->compression_level >= bio::zlib::default_compression && *my->compression_level <= bio::zlib::best_compression),
+                    plugin_config_exception, "zlib state-history-compression-level has to be between -1 and 9");
+      }
+
+      const auto retained_blocks = options.at("state-history-retained-blocks").as<uint32_t>();
       if (options.at("trace-history").as<bool>())
          my->trace_log.emplace("trace_history", (state_history_dir / "trace_history.log").string(),
-                               (state_history_dir / "trace_history.index").string());
-      if (options.at("chain-state-history").as<bool>())
+                               (state_history_dir / "trace_history.index").string(), retained_blocks);
+      if (options.at("chain-state-history").as<bool>()) {
          my->chain_state_log.emplace("chain_state_history", (state_history_dir / "chain_state_history.log").string(),
-                                     (state_history_dir / "chain_state_history.index").string());
+                                     (state_history_dir / "chain_state_history.index").string(), retained_blocks);
+         my->chain_state_captured = my->chain_state_log->begin_block() != my->chain_state_log->end_block();
+      }
+      if (my->trace_log || my->chain_state_log)
+         my->write_thread.emplace("ship", 1);
+      my->prefetch_blocks = options.at("state-history-prefetch-blocks").as<uint32_t>();
+      my->prefetch_budget = uint64_t(options.at("state-history-prefetch-mb").as<uint32_t>()) * 1024 * 1024;
+      if ((my->trace_log || my->chain_state_log) && my->prefetch_blocks)
+         my->read_threads.emplace("ship_read", state_history_plugin_impl::read_thread_count);
    }
    FC_LOG_AND_RETHROW()
 } // state_history_plugin::plugin_initialize
@@ -637,6 +1080,9 @@ void state_history_plugin::plugin_startup() { my->listen(); }
 void state_history_plugin::plugin_shutdown() {
    my->applied_transaction_connection.reset();
    my->accepted_block_connection.reset();
+   my->read_threads.reset();
+   my->wait_for_pending_writes(0);
+   my->write_thread.reset();
    while (!my->sessions.empty())
       my->sessions.begin()->second->close();
    my->stopping = true;
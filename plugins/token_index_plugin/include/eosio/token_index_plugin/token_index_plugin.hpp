@@ -0,0 +1,84 @@
+#pragma once
+
+#include <eosio/http_plugin/http_plugin.hpp>
+#include <eosio/chain_plugin/chain_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+struct token_balance {
+   chain::account_name code;
+   chain::asset        balance;
+};
+
+struct get_balances_params {
+   chain::account_name account;
+};
+
+struct get_balances_result {
+   vector<token_balance> balances;
+};
+
+struct token_holder {
+   chain::account_name account;
+   chain::asset        balance;
+};
+
+struct get_holders_params {
+   chain::account_name code;
+   string              symbol;          ///< symbol code, e.g. "EOS"
+   uint32_t            limit = 100;
+   string              lower_bound;     ///< `more` of a previous call
+};
+
+struct get_holders_result {
+   vector<token_holder> holders;        ///< in descending balance order
+   string               more;           ///< fill lower_bound with this value to fetch more holders
+};
+
+class token_index_plugin_impl;
+
+/**
+ * Indexes the rows of the `accounts` tables of eosio.token compatible contracts: rows keyed by the symbol code of the
+ * asset they start with. Balances are looked up by holder, and holders of a token are ranked by balance, without
+ * walking table scopes.
+ *
+ * The index is built when the plugin starts and kept up to date from the undo state of every accepted block.
+ */
+class token_index_plugin : public plugin<token_index_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
+
+   token_index_plugin();
+   token_index_plugin(const token_index_plugin&) = delete;
+   token_index_plugin(token_index_plugin&&) = delete;
+   token_index_plugin& operator=(const token_index_plugin&) = delete;
+   token_index_plugin& operator=(token_index_plugin&&) = delete;
+   virtual ~token_index_plugin() override;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+   void plugin_initialize(const variables_map& vm);
+   void plugin_startup();
+   void plugin_shutdown();
+
+   /// balances of every indexed token held by an account
+   get_balances_result get_balances(const get_balances_params& params);
+
+   /// holders of one token ranked by balance
+   get_holders_result get_holders(const get_holders_params& params);
+
+private:
+   std::shared_ptr<token_index_plugin_impl> my;
+};
+
+}
+
+FC_REFLECT( eosio::token_balance, (code)(balance) )
+FC_REFLECT( eosio::get_balances_params, (account) )
+FC_REFLECT( eosio::get_balances_result, (balances) )
+FC_REFLECT( eosio::token_holder, (account)(balance) )
+FC_REFLECT( eosio::get_holders_params, (code)(symbol)(limit)(lower_bound) )
+FC_REFLECT( eosio::get_holders_result, (holders)(more) )
@@ -0,0 +1,255 @@
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+#include <eosio/token_index_plugin/token_index_plugin.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/signals2/connection.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _token_index_plugin = app().register_plugin<token_index_plugin>();
+
+using namespace eosio;
+using namespace eosio::chain;
+
+class token_index_plugin_impl {
+public:
+   /// (holder, code, symbol code)
+   using balance_key = std::tuple<account_name, account_name, uint64_t>;
+
+   struct holder_entry {
+      account_name code;
+      uint64_t     sym_code = 0;
+      int64_t      amount = 0;
+      account_name holder;
+   };
+
+   /// groups the holders of a token, largest balance first
+   struct holder_order {
+      bool operator()( const holder_entry& a, const holder_entry& b )const {
+         return std::tie( a.code, a.sym_code, b.amount, a.holder ) < std::tie( b.code, b.sym_code, a.amount, b.holder );
+      }
+   };
+
+   /// keys touched by a reversible block, re-read if the block is popped by a fork switch
+   struct block_keys {
+      block_id_type       id;
+      uint32_t            block_num = 0;
+      vector<balance_key> keys;
+   };
+
+   flat_set<account_name>                          contracts;  ///< empty indexes every contract
+   std::map<balance_key, asset>                    balances;
+   std::set<holder_entry, holder_order>            holders;
+   std::deque<block_keys>                          reversible;
+   block_id_type                                   last_block_id;
+
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection> irreversible_block_connection;
+
+   bool indexed( const table_id_object& table )const {
+      return table.table == N(accounts) && ( contracts.empty() || contracts.count( table.code ) );
+   }
+
+   /// the balance of an eosio.token compatible row, its primary key is the symbol code of the asset it starts with
+   static optional<asset> row_balance( const key_value_object& row ) {
+      if( row.value.size() < sizeof(asset) ) return {};
+      asset balance;
+      fc::datastream<const char*> ds( row.value.data(), row.value.size() );
+      fc::raw::unpack( ds, balance );
+      if( !balance.get_symbol().valid() || balance.get_symbol().to_symbol_code().value != row.primary_key ) return {};
+      return balance;
+   }
+
+   void erase( const balance_key& key ) {
+      auto itr = balances.find( key );
+      if( itr == balances.end() ) return;
+      holders.erase( holder_entry{ std::get<1>(key), std::get<2>(key), itr->second.get_amount(), std::get<0>(key) } );
+      balances.erase( itr );
+   }
+
+   void set( const balance_key& key, const asset& balance ) {
+      erase( key );
+      balances.emplace( key, balance );
+      holders.insert( holder_entry{ std::get<1>(key), std::get<2>(key), balance.get_amount(), std::get<0>(key) } );
+   }
+
+   /// makes the index entry of key match the current state
+   void refresh( const database& db, const balance_key& key ) {
+      erase( key );
+      const auto* table = db.find<table_id_object, by_code_scope_table>(
+            boost::make_tuple( std::get<1>(key), std::get<0>(key), N(accounts) ) );
+      if( !table ) return;
+      const auto* row = db.find<key_value_object, by_scope_primary>( boost::make_tuple( table->id, std::get<2>(key) ) );
+      if( !row ) return;
+      if( auto balance = row_balance( *row ) ) set( key, *balance );
+   }
+
+   void rebuild( const database& db ) {
+      balances.clear();
+      holders.clear();
+      reversible.clear();
+      const auto& kv_index = db.get_index<key_value_index, by_scope_primary>();
+      for( const auto& table : db.get_index<table_id_multi_index>().indices() ) {
+         if( !indexed( table ) ) continue;
+         for( auto itr = kv_index.lower_bound( boost::make_tuple( table.id ) ); itr != kv_index.end() && itr->t_id == table.id; ++itr ) {
+            if( auto balance = row_balance( *itr ) ) set( balance_key{ table.scope, table.code, itr->primary_key }, *balance );
+         }
+      }
+   }
+
+   /// keys of the rows of indexed tables changed by the block being accepted, empty if there is no undo state for it
+   optional<vector<balance_key>> changed_keys( const database& db )const {
+      const auto& kv_index = db.get_index<key_value_index>();
+      const auto& table_index = db.get_index<table_id_multi_index>();
+      if( kv_index.stack().empty() || table_index.stack().empty() ) return {};
+      const auto& removed_tables = table_index.stack().back().removed_values;
+
+      vector<balance_key> keys;
+      auto add = [&]( const key_value_object& row ) {
+         const table_id_object* table = table_index.find( row.t_id );
+         if( !table ) {
+            auto itr = removed_tables.find( row.t_id );
+            if( itr == removed_tables.end() ) return;
+            table = &itr->second;
+         }
+         if( indexed( *table ) ) keys.emplace_back( table->scope, table->code, row.primary_key );
+      };
+      const auto& undo = kv_index.stack().back();
+      for( const auto& old : undo.old_values ) add( old.second );
+      for( const auto& removed : undo.removed_values ) add( removed.second );
+      for( const auto& id : undo.new_ids ) add( kv_index.get( id ) );
+      return keys;
+   }
+
+   void on_accepted_block( const block_state_ptr& bsp ) {
+      const auto& db = app().get_plugin<chain_plugin>().chain().db();
+      auto keys = db.revision() == int64_t(bsp->block_num) ? changed_keys( db ) : optional<vector<balance_key>>();
+      if( !keys ) {
+         ilog( "rebuilding token index at block ${n}", ("n", bsp->block_num) );
+         rebuild( db );
+         last_block_id = bsp->id;
+         return;
+      }
+
+      if( bsp->header.previous != last_block_id ) {
+         // blocks at or above this one were popped by a fork switch, undo what they did to the index
+         while( !reversible.empty() && reversible.back().block_num >= bsp->block_num ) {
+            for( const auto& key : reversible.back().keys ) refresh( db, key );
+            reversible.pop_back();
+         }
+      }
+      for( const auto& key : *keys ) refresh( db, key );
+      reversible.push_back( block_keys{ bsp->id, bsp->block_num, std::move(*keys) } );
+      last_block_id = bsp->id;
+   }
+
+   void on_irreversible_block( const block_state_ptr& bsp ) {
+      while( !reversible.empty() && reversible.front().block_num <= bsp->block_num ) {
+         reversible.pop_front();
+      }
+   }
+};
+
+#define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          try { \
+             if (body.empty()) body = "{}"; \
+             INVOKE \
+             cb(http_response_code, fc::variant(result)); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
+token_index_plugin::token_index_plugin()
+:my(std::make_shared<token_index_plugin_impl>())
+{}
+
+token_index_plugin::~token_index_plugin() = default;
+
+void token_index_plugin::set_program_options(options_description& cli, options_description& cfg) {
+   cfg.add_options()
+      ("token-index-contract", bpo::value<vector<string>>()->composing(),
+       "Token contract whose accounts tables are indexed (may specify multiple times), every contract if not given")
+   ;
+}
+
+void token_index_plugin::plugin_initialize(const variables_map& options) {
+   try {
+      if( options.count( "token-index-contract" ) ) {
+         for( const auto& c : options.at( "token-index-contract" ).as<vector<string>>() )
+            my->contracts.insert( name(c) );
+      }
+      EOS_ASSERT( app().get_plugin<chain_plugin>().chain().get_read_mode() != db_read_mode::IRREVERSIBLE,
+                  chain::plugin_config_exception, "token_index_plugin needs the undo state of reversible blocks, it cannot be used in irreversible read mode" );
+   } FC_LOG_AND_RETHROW()
+}
+
+void token_index_plugin::plugin_startup() {
+   auto& chain = app().get_plugin<chain_plugin>().chain();
+   my->rebuild( chain.db() );
+   my->last_block_id = chain.head_block_id();
+   ilog( "token index holds ${n} balances", ("n", my->balances.size()) );
+
+   app().get_plugin<http_plugin>().add_api({
+       CALL(token_index, this, get_balances,
+            INVOKE_R_R(this, get_balances, get_balances_params), 200),
+       CALL(token_index, this, get_holders,
+            INVOKE_R_R(this, get_holders, get_holders_params), 200),
+   });
+   my->accepted_block_connection.emplace( chain.accepted_block.connect(
+         [my = my]( const block_state_ptr& bsp ) { my->on_accepted_block( bsp ); } ) );
+   my->irreversible_block_connection.emplace( chain.irreversible_block.connect(
+         [my = my]( const block_state_ptr& bsp ) { my->on_irreversible_block( bsp ); } ) );
+}
+
+void token_index_plugin::plugin_shutdown() {
+   my->accepted_block_connection.reset();
+   my->irreversible_block_connection.reset();
+}
+
+get_balances_result token_index_plugin::get_balances(const get_balances_params& params) {
+   get_balances_result result;
+   for( auto itr = my->balances.lower_bound( token_index_plugin_impl::balance_key{ params.account, name(), 0 } );
+        itr != my->balances.end() && std::get<0>(itr->first) == params.account; ++itr ) {
+      result.balances.push_back( token_balance{ std::get<1>(itr->first), itr->second } );
+   }
+   return result;
+}
+
+get_holders_result token_index_plugin::get_holders(const get_holders_params& params) {
+   const uint64_t sym_code = symbol::from_string( "0," + boost::algorithm::to_upper_copy( params.symbol ) ).to_symbol_code().value;
+   using entry = token_index_plugin_impl::holder_entry;
+
+   auto itr = my->holders.lower_bound( entry{ params.code, sym_code, std::numeric_limits<int64_t>::max(), name() } );
+   if( !params.lower_bound.empty() ) {
+      const name from( params.lower_bound );
+      auto bal = my->balances.find( token_index_plugin_impl::balance_key{ from, params.code, sym_code } );
+      EOS_ASSERT( bal != my->balances.end(), chain::contract_table_query_exception,
+                  "${a} does not hold ${s}", ("a", from)("s", params.symbol) );
+      itr = my->holders.find( entry{ params.code, sym_code, bal->second.get_amount(), from } );
+   }
+
+   get_holders_result result;
+   for( ; itr != my->holders.end() && itr->code == params.code && itr->sym_code == sym_code; ++itr ) {
+      if( result.holders.size() >= params.limit ) {
+         result.more = itr->holder.to_string();
+         break;
+      }
+      auto bal = my->balances.find( token_index_plugin_impl::balance_key{ itr->holder, itr->code, itr->sym_code } );
+      result.holders.push_back( token_holder{ itr->holder, bal->second } );
+   }
+   return result;
+}
+
+}
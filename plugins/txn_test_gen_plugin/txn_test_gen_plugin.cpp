@@ -1,6 +1,7 @@
 #include <eosio/txn_test_gen_plugin/txn_test_gen_plugin.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
+#include <eosio/chain/account_object.hpp>
 #include <eosio/chain/thread_utils.hpp>
 
 #include <fc/variant.hpp>
@@ -11,6 +12,12 @@
 
 #include <boost/asio/high_resolution_timer.hpp>
 #include <boost/algorithm/clamp.hpp>
+#include <boost/algorithm/string/replace.hpp>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
 
 #include <Inline/BasicTypes.h>
 #include <IR/Module.h>
@@ -28,10 +35,52 @@ namespace eosio { namespace detail {
   struct txn_test_gen_status {
      string status;
   };
+
+  struct workload_signer {
+     chain::name account;
+     string      private_key;   ///< signs for account@active
+  };
+
+  /// data is the action as json; the strings "${signer}", "${peer}" and "${nonce}" in it are replaced by the signing
+  /// account, another random signer and a counter unique to the transaction
+  struct workload_action {
+     chain::name account;
+     chain::name action;
+     fc::variant data;
+     uint32_t    weight = 1;
+  };
+
+  struct workload_spec {
+     vector<workload_signer> signers;
+     vector<workload_action> actions;
+     uint32_t                start_tps = 100;
+     uint32_t                target_tps = 100;
+     uint32_t                ramp_seconds = 0;      ///< linear ramp from start_tps to target_tps
+     uint32_t                duration_seconds = 0;  ///< 0 runs until stop_generation
+  };
+
+  struct workload_status {
+     bool     running = false;
+     uint64_t elapsed_ms = 0;
+     uint64_t sent = 0;
+     uint64_t accepted = 0;
+     uint64_t rejected = 0;
+     uint64_t included = 0;       ///< seen in an accepted block
+     double   achieved_tps = 0;   ///< included / elapsed
+     uint32_t p50_latency_ms = 0; ///< from signing to the accepted block including it
+     uint32_t p90_latency_ms = 0;
+     uint32_t p99_latency_ms = 0;
+     uint32_t max_latency_ms = 0;
+  };
 }}
 
 FC_REFLECT(eosio::detail::txn_test_gen_empty, );
 FC_REFLECT(eosio::detail::txn_test_gen_status, (status));
+FC_REFLECT(eosio::detail::workload_signer, (account)(private_key));
+FC_REFLECT(eosio::detail::workload_action, (account)(action)(data)(weight));
+FC_REFLECT(eosio::detail::workload_spec, (signers)(actions)(start_tps)(target_tps)(ramp_seconds)(duration_seconds));
+FC_REFLECT(eosio::detail::workload_status, (running)(elapsed_ms)(sent)(accepted)(rejected)(included)(achieved_tps)
+                                           (p50_latency_ms)(p90_latency_ms)(p99_latency_ms)(max_latency_ms));
 
 namespace eosio {
 
@@ -61,6 +110,13 @@ using namespace eosio::chain;
      api_handle->call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>()); \
      eosio::detail::txn_test_gen_empty result;
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto status = api_handle->call_name(fc::json::from_string(body).as<in_param>()); \
+     eosio::detail::txn_test_gen_status result = { status };
+
+#define INVOKE_R_V(api_handle, call_name) \
+     auto result = api_handle->call_name();
+
 #define INVOKE_V_V(api_handle, call_name) \
      api_handle->call_name(); \
      eosio::detail::txn_test_gen_empty result;
@@ -96,6 +152,28 @@ struct txn_test_gen_plugin_impl {
    uint64_t _total_us = 0;
    uint64_t _txcount = 0;
 
+   static constexpr uint32_t workload_tick_ms = 100;
+   static constexpr uint64_t workload_chunk_size = 50;   ///< transactions signed by one thread pool task
+   static constexpr uint32_t max_workload_tps = 100000;
+
+   struct workload_state {
+      eosio::detail::workload_spec                   spec;
+      vector<fc::crypto::private_key>                keys;               ///< of spec.signers
+      std::map<name, abi_serializer>                 serializers;        ///< by contract account
+      vector<string>                                 action_types;       ///< of spec.actions
+      vector<uint64_t>                               cumulative_weights; ///< of spec.actions
+      fc::time_point                                 start;
+      fc::time_point                                 end = fc::time_point::maximum();
+      double                                         carry = 0;          ///< fraction of a transaction left from the last tick
+      std::atomic<uint64_t>                          nonce{0};
+      std::atomic<uint64_t>                          sent{0};
+      std::atomic<uint64_t>                          accepted{0};
+      std::atomic<uint64_t>                          rejected{0};
+      std::mutex                                     mtx;
+      std::map<transaction_id_type, fc::time_point>  in_flight;          ///< guarded by mtx, by signing time
+      vector<uint32_t>                               latencies_ms;       ///< guarded by mtx
+   };
+
    uint16_t                                             thread_pool_size;
    fc::optional<eosio::chain::named_thread_pool>        thread_pool;
    std::shared_ptr<boost::asio::high_resolution_timer>  timer;
@@ -329,6 +407,19 @@ struct txn_test_gen_plugin_impl {
       });
    }
 
+   block_id_type get_reference_block_id(const controller& cc) const {
+      uint32_t reference_block_num = cc.last_irreversible_block_num();
+      if (txn_reference_block_lag >= 0) {
+         reference_block_num = cc.head_block_num();
+         if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
+            reference_block_num = 0;
+         } else {
+            reference_block_num -= (uint32_t)txn_reference_block_lag;
+         }
+      }
+      return cc.get_block_id_for_num(reference_block_num);
+   }
+
    void send_transaction(std::function<void(const fc::exception_ptr&)> next, uint64_t nonce_prefix) {
       std::vector<signed_transaction> trxs;
       trxs.reserve(2*batch);
@@ -342,17 +433,7 @@ struct txn_test_gen_plugin_impl {
 
          static uint64_t nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
 
-         uint32_t reference_block_num = cc.last_irreversible_block_num();
-         if (txn_reference_block_lag >= 0) {
-            reference_block_num = cc.head_block_num();
-            if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
-               reference_block_num = 0;
-            } else {
-               reference_block_num -= (uint32_t)txn_reference_block_lag;
-            }
-         }
-
-         block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
+         block_id_type reference_block_id = get_reference_block_id(cc);
 
          for(unsigned int i = 0; i < batch; ++i) {
          {
@@ -384,6 +465,237 @@ struct txn_test_gen_plugin_impl {
       push_transactions(std::move(trxs), next);
    }
 
+   static fc::variant fill_workload_template(const fc::variant& v, const string& signer, const string& peer, const string& nonce) {
+      if (v.is_string()) {
+         string s = v.get_string();
+         boost::replace_all(s, "${signer}", signer);
+         boost::replace_all(s, "${peer}", peer);
+         boost::replace_all(s, "${nonce}", nonce);
+         return fc::variant(std::move(s));
+      }
+      if (v.is_object()) {
+         fc::mutable_variant_object o;
+         for (const auto& e : v.get_object())
+            o(e.key(), fill_workload_template(e.value(), signer, peer, nonce));
+         return fc::variant(std::move(o));
+      }
+      if (v.is_array()) {
+         fc::variants a;
+         a.reserve(v.size());
+         for (const auto& e : v.get_array())
+            a.push_back(fill_workload_template(e, signer, peer, nonce));
+         return fc::variant(std::move(a));
+      }
+      return v;
+   }
+
+   string start_workload(const eosio::detail::workload_spec& spec) {
+      ilog("Starting transaction test plugin workload");
+      if(running)
+         return "start_generation already running";
+      if(spec.signers.empty())
+         return "at least one signer is required";
+      if(spec.actions.empty())
+         return "at least one action is required";
+      if(spec.target_tps < 1 || spec.target_tps > max_workload_tps || spec.start_tps > max_workload_tps)
+         return "start_tps and target_tps must be at most " + std::to_string(max_workload_tps) + ", target_tps at least 1";
+
+      controller& cc = app().get_plugin<chain_plugin>().chain();
+      auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
+
+      auto w = std::make_shared<workload_state>();
+      w->spec = spec;
+      for (const auto& signer : spec.signers)
+         w->keys.emplace_back(signer.private_key);
+      uint64_t total_weight = 0;
+      for (const auto& a : spec.actions) {
+         if (a.weight == 0)
+            return "action weights must be positive";
+         auto itr = w->serializers.find(a.account);
+         if (itr == w->serializers.end()) {
+            const auto* account = cc.db().find<account_object, by_name>(a.account);
+            if (!account || account->abi.size() == 0)
+               return "no abi set on account " + a.account.to_string();
+            itr = w->serializers.emplace(a.account, abi_serializer(account->get_abi(), abi_serializer_max_time)).first;
+         }
+         auto type = itr->second.get_action_type(a.action);
+         if (type.empty())
+            return "no action " + a.action.to_string() + " in the abi of " + a.account.to_string();
+         w->action_types.push_back(type);
+         total_weight += a.weight;
+         w->cumulative_weights.push_back(total_weight);
+      }
+      w->nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
+      w->start = fc::time_point::now();
+
+      workload = w;
+      running = true;
+
+      thread_pool.emplace( "txntest", thread_pool_size );
+      timer = std::make_shared<boost::asio::high_resolution_timer>(thread_pool->get_executor());
+
+      ilog("Started transaction test plugin workload; ${s} signers, ${a} actions, ${b} to ${t} tps over ${r} s by ${n} load generation threads",
+           ("s", spec.signers.size())("a", spec.actions.size())("b", spec.start_tps)("t", spec.target_tps)
+           ("r", spec.ramp_seconds)("n", thread_pool_size));
+
+      boost::asio::post( thread_pool->get_executor(), [this]() {
+         arm_workload_timer(boost::asio::high_resolution_timer::clock_type::now());
+      });
+      return "success";
+   }
+
+   void arm_workload_timer(boost::asio::high_resolution_timer::time_point s) {
+      auto w = workload;
+      const double elapsed_s = (fc::time_point::now() - w->start).count() / 1e6;
+      if (w->spec.duration_seconds && elapsed_s >= w->spec.duration_seconds) {
+         app().post(priority::low, [this]() {
+            if(running)
+               stop_generation();
+         });
+         return;
+      }
+      double tps = w->spec.target_tps;
+      if (elapsed_s < w->spec.ramp_seconds)
+         tps = w->spec.start_tps + (double(w->spec.target_tps) - w->spec.start_tps) * elapsed_s / w->spec.ramp_seconds;
+      // timer handlers run one at a time, so carry needs no synchronization
+      w->carry += tps * workload_tick_ms / 1000;
+      const uint64_t count = static_cast<uint64_t>(w->carry);
+      w->carry -= count;
+      for (uint64_t first = 0; first < count; first += workload_chunk_size) {
+         const uint64_t n = std::min(workload_chunk_size, count - first);
+         boost::asio::post( thread_pool->get_executor(), [this, w, n]() {
+            send_workload_transactions(w, n);
+         });
+      }
+
+      timer->expires_at(s + std::chrono::milliseconds(workload_tick_ms));
+      timer->async_wait([this](const boost::system::error_code& ec) {
+         if(!running || ec)
+            return;
+         arm_workload_timer(timer->expires_at());
+      });
+   }
+
+   void send_workload_transactions(const std::shared_ptr<workload_state>& w, uint64_t count) {
+      auto trxs = std::make_shared<std::vector<std::pair<transaction_id_type, packed_transaction_ptr>>>();
+      trxs->reserve(count);
+
+      try {
+         controller& cc = app().get_plugin<chain_plugin>().chain();
+         auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
+         auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
+         block_id_type reference_block_id = get_reference_block_id(cc);
+         auto expiration = cc.head_block_time() + fc::seconds(30);
+
+         static thread_local std::mt19937_64 rng{std::random_device{}()};
+         const size_t signers = w->keys.size();
+
+         for (uint64_t i = 0; i < count; ++i) {
+            const size_t signer = std::uniform_int_distribution<size_t>(0, signers - 1)(rng);
+            size_t peer = signer;
+            if (signers > 1) {
+               peer = std::uniform_int_distribution<size_t>(0, signers - 2)(rng);
+               if (peer >= signer)
+                  ++peer;
+            }
+            const uint64_t pick = std::uniform_int_distribution<uint64_t>(0, w->cumulative_weights.back() - 1)(rng);
+            const size_t a = std::upper_bound(w->cumulative_weights.begin(), w->cumulative_weights.end(), pick) - w->cumulative_weights.begin();
+            const auto& act = w->spec.actions[a];
+            const string nonce = std::to_string(w->nonce++);
+
+            const name& signer_account = w->spec.signers[signer].account;
+            auto data = fill_workload_template(act.data, signer_account.to_string(), w->spec.signers[peer].account.to_string(), nonce);
+
+            signed_transaction trx;
+            trx.actions.emplace_back(vector<permission_level>{{signer_account, config::active_name}}, act.account, act.action,
+                                     w->serializers.at(act.account).variant_to_binary(w->action_types[a], data, abi_serializer_max_time));
+            trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack(nonce)));
+            trx.set_reference_block(reference_block_id);
+            trx.expiration = expiration;
+            trx.sign(w->keys[signer], chainid);
+            trxs->emplace_back(trx.id(), std::make_shared<packed_transaction>(std::move(trx)));
+         }
+      } catch ( const fc::exception& e ) {
+         elog("generating workload transaction failed: ${e}", ("e", e.to_detail_string()));
+         app().post(priority::low, [this]() {
+            if(running)
+               stop_generation();
+         });
+         return;
+      }
+
+      const auto now = fc::time_point::now();
+      {
+         std::lock_guard<std::mutex> g(w->mtx);
+         for (const auto& t : *trxs)
+            w->in_flight.emplace(t.first, now);
+      }
+      w->sent += trxs->size();
+
+      app().post(priority::low, [w, trxs]() {
+         chain_plugin& cp = app().get_plugin<chain_plugin>();
+         for (const auto& t : *trxs) {
+            cp.accept_transaction( t.second, [w, id = t.first](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
+               if (result.contains<fc::exception_ptr>() || result.get<transaction_trace_ptr>()->except) {
+                  ++w->rejected;
+                  std::lock_guard<std::mutex> g(w->mtx);
+                  w->in_flight.erase(id);
+               } else {
+                  ++w->accepted;
+               }
+            });
+         }
+      });
+   }
+
+   void on_accepted_block(const block_state_ptr& bsp) {
+      auto w = workload;
+      if (!w)
+         return;
+      const auto now = fc::time_point::now();
+      std::lock_guard<std::mutex> g(w->mtx);
+      if (w->in_flight.empty())
+         return;
+      for (const auto& receipt : bsp->block->transactions) {
+         const auto& id = receipt.trx.contains<transaction_id_type>() ? receipt.trx.get<transaction_id_type>()
+                                                                       : receipt.trx.get<packed_transaction>().id();
+         auto itr = w->in_flight.find(id);
+         if (itr == w->in_flight.end())
+            continue;
+         w->latencies_ms.push_back((now - itr->second).count() / 1000);
+         w->in_flight.erase(itr);
+      }
+   }
+
+   eosio::detail::workload_status workload_status() {
+      eosio::detail::workload_status result;
+      auto w = workload;
+      if (!w)
+         return result;
+      result.running = running && w->end == fc::time_point::maximum();
+      result.elapsed_ms = (std::min(fc::time_point::now(), w->end) - w->start).count() / 1000;
+      result.sent = w->sent;
+      result.accepted = w->accepted;
+      result.rejected = w->rejected;
+      std::vector<uint32_t> latencies;
+      {
+         std::lock_guard<std::mutex> g(w->mtx);
+         latencies = w->latencies_ms;
+      }
+      result.included = latencies.size();
+      if (result.elapsed_ms)
+         result.achieved_tps = result.included * 1000.0 / result.elapsed_ms;
+      if (!latencies.empty()) {
+         std::sort(latencies.begin(), latencies.end());
+         auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))]; };
+         result.p50_latency_ms = percentile(0.50);
+         result.p90_latency_ms = percentile(0.90);
+         result.p99_latency_ms = percentile(0.99);
+         result.max_latency_ms = latencies.back();
+      }
+      return result;
+   }
+
    void stop_generation() {
       if(!running)
          throw fc::exception(fc::invalid_operation_exception_code);
@@ -394,6 +706,11 @@ struct txn_test_gen_plugin_impl {
 
       ilog("Stopping transaction generation test");
 
+      if (workload && workload->end == fc::time_point::maximum()) {
+         workload->end = fc::time_point::now();
+         ilog("workload: ${s}", ("s", workload_status()));
+      }
+
       if (_txcount) {
          ilog("${d} transactions executed, ${t}us / transaction", ("d", _txcount)("t", _total_us / (double)_txcount));
          _txcount = _total_us = 0;
@@ -410,6 +727,9 @@ struct txn_test_gen_plugin_impl {
    action act_b_to_a;
 
    int32_t txn_reference_block_lag;
+
+   std::shared_ptr<workload_state>                    workload;
+   fc::optional<boost::signals2::scoped_connection>   accepted_block_connection;
 };
 
 txn_test_gen_plugin::txn_test_gen_plugin() {}
@@ -441,11 +761,16 @@ void txn_test_gen_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
       CALL_ASYNC(txn_test_gen, my, create_test_accounts, INVOKE_ASYNC_R_R(my, create_test_accounts, std::string, std::string), 200),
       CALL(txn_test_gen, my, stop_generation, INVOKE_V_V(my, stop_generation), 200),
-      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200)
+      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200),
+      CALL(txn_test_gen, my, start_workload, INVOKE_R_R(my, start_workload, eosio::detail::workload_spec), 200),
+      CALL(txn_test_gen, my, workload_status, INVOKE_R_V(my, workload_status), 200)
    });
+   my->accepted_block_connection.emplace( app().get_plugin<chain_plugin>().chain().accepted_block.connect(
+         [this]( const chain::block_state_ptr& bsp ) { my->on_accepted_block( bsp ); } ) );
 }
 
 void txn_test_gen_plugin::plugin_shutdown() {
+   my->accepted_block_connection.reset();
    try {
       my->stop_generation();
    }
@@ -98,6 +98,11 @@ class wallet_api
       /** Returns a signature given the digest and public_key, if this wallet can sign via that public key
        */
       virtual fc::optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) = 0;
+
+      /** Returns true if try_sign_digest may be called from several threads at once, as long as the wallet is
+       *  neither modified nor locked meanwhile
+       */
+      virtual bool can_sign_concurrently() const { return false; }
 };
 
 }}
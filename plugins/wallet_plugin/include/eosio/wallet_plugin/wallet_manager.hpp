@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/wallet_plugin/wallet_api.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/filesystem/path.hpp>
@@ -39,6 +40,10 @@ public:
    /// @see wallet_manager::set_timeout(const std::chrono::seconds& t)
    /// @param secs The timeout in seconds.
    void set_timeout(int64_t secs) { set_timeout(std::chrono::seconds(secs)); }
+
+   /// Set the number of threads sign_transactions uses for wallets that can sign concurrently.
+   /// @param threads 1 signs on the calling thread.
+   void set_signing_threads(uint16_t threads);
       
    /// Sign transaction with the private keys specified via their public keys.
    /// Use chain_controller::get_required_keys to determine which keys are needed for txn.
@@ -50,6 +55,18 @@ public:
    chain::signed_transaction sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys,
                                              const chain::chain_id_type& id);
 
+   /// Sign several transactions in one call.
+   /// The digest of each transaction is computed once and the signatures made by wallets that can sign concurrently
+   /// are spread over the signing threads, see set_signing_threads.
+   /// @param txns the transactions to sign.
+   /// @param keys the public keys to sign each transaction with, either one set per transaction or a single set
+   ///             used for all of them
+   /// @param id the chain_id to sign the transactions with.
+   /// @return txns signed, in the same order
+   /// @throws fc::exception if corresponding private keys not found in unlocked wallets
+   std::vector<chain::signed_transaction> sign_transactions(const std::vector<chain::signed_transaction>& txns,
+                                                            const std::vector<flat_set<public_key_type>>& keys,
+                                                            const chain::chain_id_type& id);
 
    /// Sign digest with the private keys specified via their public keys.
    /// @param digest the digest to sign.
@@ -130,6 +147,11 @@ private:
    /// Calls lock_all() if timeout has passed.
    void check_timeout();
 
+   /// Rebuilds key_index from the unlocked wallets.
+   void reindex_keys();
+   /// Adds a key of the unlocked wallet name to key_index.
+   void index_key(const std::string& name, const public_key_type& key);
+
 private:
    using timepoint_t = std::chrono::time_point<std::chrono::system_clock>;
    std::map<std::string, std::unique_ptr<wallet_api>> wallets;
@@ -138,6 +160,15 @@ private:
    boost::filesystem::path dir = ".";
    boost::filesystem::path lock_path = dir / "wallet.lock";
    std::unique_ptr<boost::interprocess::file_lock> wallet_dir_lock;
+   fc::optional<chain::named_thread_pool> signing_pool; ///< only set for more than one signing thread
+
+   struct key_signer {
+      std::string  wallet;
+      wallet_api*  api = nullptr;
+   };
+   /// the wallet signing with each key of the unlocked wallets, the first by name holding it, kept up to date as
+   /// wallets are unlocked, locked and their keys change so that signing goes straight to the wallet of a key
+   std::map<public_key_type, key_signer> key_index;
 
    void start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t);
    void initialize_lock();
@@ -44,6 +44,13 @@ void wallet_manager::set_timeout(const std::chrono::seconds& t) {
              ("t", t.count())("now", now.time_since_epoch().count())("timeout_time", timeout_time.time_since_epoch().count()));
 }
 
+void wallet_manager::set_signing_threads(uint16_t threads) {
+   EOS_ASSERT(threads > 0, wallet_exception, "signing threads must be at least 1");
+   signing_pool.reset();
+   if (threads > 1)
+      signing_pool.emplace("sign", threads);
+}
+
 void wallet_manager::check_timeout() {
    if (timeout_time != timepoint_t::max()) {
       const auto& now = std::chrono::system_clock::now();
@@ -84,6 +91,7 @@ std::string wallet_manager::create(const std::string& name) {
       wallets.erase(it);
    }
    wallets.emplace(name, std::move(wallet));
+   reindex_keys();
 
    return password;
 }
@@ -108,6 +116,7 @@ void wallet_manager::open(const std::string& name) {
       wallets.erase(it);
    }
    wallets.emplace(name, std::move(wallet));
+   reindex_keys();
 }
 
 std::vector<std::string> wallet_manager::list_wallets() {
@@ -138,18 +147,36 @@ map<public_key_type,private_key_type> wallet_manager::list_keys(const string& na
 flat_set<public_key_type> wallet_manager::get_public_keys() {
    check_timeout();
    EOS_ASSERT(!wallets.empty(), wallet_not_available_exception, "You don't have any wallet!");
-   flat_set<public_key_type> result;
    bool is_all_wallet_locked = true;
    for (const auto& i : wallets) {
-      if (!i.second->is_locked()) {
-         result.merge(i.second->list_public_keys());
-      }
       is_all_wallet_locked &= i.second->is_locked();
    }
    EOS_ASSERT(!is_all_wallet_locked, wallet_locked_exception, "You don't have any unlocked wallet!");
+   flat_set<public_key_type> result;
+   result.reserve(key_index.size());
+   for (const auto& k : key_index) {
+      result.insert(result.end(), k.first);
+   }
    return result;
 }
 
+void wallet_manager::reindex_keys() {
+   key_index.clear();
+   for (const auto& i : wallets) {
+      if (!i.second->is_locked()) {
+         for (const auto& pk : i.second->list_public_keys())
+            key_index.emplace(pk, key_signer{i.first, i.second.get()});
+      }
+   }
+}
+
+void wallet_manager::index_key(const std::string& name, const public_key_type& key) {
+   auto& signer = key_index[key];
+   // as in reindex_keys(), the first wallet by name holding the key signs with it
+   if (!signer.api || name < signer.wallet)
+      signer = key_signer{name, wallets.at(name).get()};
+}
+
 
 void wallet_manager::lock_all() {
    // no call to check_timeout since we are locking all anyway
@@ -158,6 +185,7 @@ void wallet_manager::lock_all() {
          i.second->lock();
       }
    }
+   key_index.clear();
 }
 
 void wallet_manager::lock(const std::string& name) {
@@ -170,6 +198,7 @@ void wallet_manager::lock(const std::string& name) {
       return;
    }
    w->lock();
+   reindex_keys();
 }
 
 void wallet_manager::unlock(const std::string& name, const std::string& password) {
@@ -183,6 +212,7 @@ void wallet_manager::unlock(const std::string& name, const std::string& password
       return;
    }
    w->unlock(password);
+   reindex_keys();
 }
 
 void wallet_manager::import_key(const std::string& name, const std::string& wif_key) {
@@ -195,6 +225,7 @@ void wallet_manager::import_key(const std::string& name, const std::string& wif_
       EOS_THROW(chain::wallet_locked_exception, "Wallet is locked: ${w}", ("w", name));
    }
    w->import_key(wif_key);
+   index_key(name, private_key_type(wif_key).get_public_key());
 }
 
 void wallet_manager::remove_key(const std::string& name, const std::string& password, const std::string& key) {
@@ -208,6 +239,7 @@ void wallet_manager::remove_key(const std::string& name, const std::string& pass
    }
    w->check_password(password); //throws if bad password
    w->remove_key(key);
+   reindex_keys();
 }
 
 string wallet_manager::create_key(const std::string& name, const std::string& key_type) {
@@ -221,45 +253,89 @@ string wallet_manager::create_key(const std::string& name, const std::string& ke
    }
 
    string upper_key_type = boost::to_upper_copy<std::string>(key_type);
-   return w->create_key(upper_key_type);
+   string key = w->create_key(upper_key_type);
+   index_key(name, public_key_type(key));
+   return key;
 }
 
 chain::signed_transaction
 wallet_manager::sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
    check_timeout();
    chain::signed_transaction stxn(txn);
+   const chain::digest_type digest = stxn.sig_digest(id, stxn.context_free_data);
 
    for (const auto& pk : keys) {
-      bool found = false;
-      for (const auto& i : wallets) {
-         if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(stxn.sig_digest(id, stxn.context_free_data), pk);
-            if (sig) {
-               stxn.signatures.push_back(*sig);
-               found = true;
-               break; // inner for
-            }
-         }
-      }
-      if (!found) {
+      auto itr = key_index.find(pk);
+      fc::optional<signature_type> sig;
+      if (itr != key_index.end())
+         sig = itr->second.api->try_sign_digest(digest, pk);
+      if (!sig) {
          EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
       }
+      stxn.signatures.push_back(*sig);
    }
 
    return stxn;
 }
 
+std::vector<chain::signed_transaction>
+wallet_manager::sign_transactions(const std::vector<chain::signed_transaction>& txns,
+                                  const std::vector<flat_set<public_key_type>>& keys,
+                                  const chain::chain_id_type& id) {
+   check_timeout();
+   EOS_ASSERT(keys.size() == txns.size() || keys.size() == 1, chain::wallet_exception,
+              "Expected one set of keys per transaction or a single set for all of them, got ${k} for ${t} transactions",
+              ("k", keys.size())("t", txns.size()));
+
+   std::vector<chain::signed_transaction> result(txns);
+   std::vector<std::vector<std::future<fc::optional<signature_type>>>> pending(result.size());
+   for (size_t t = 0; t < result.size(); ++t) {
+      const auto& trx_keys = keys.size() == 1 ? keys.front() : keys[t];
+      const chain::digest_type digest = result[t].sig_digest(id, result[t].context_free_data);
+      for (const auto& pk : trx_keys) {
+         auto itr = key_index.find(pk);
+         if (itr == key_index.end()) {
+            EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+         }
+         wallet_api* w = itr->second.api;
+         if (signing_pool && w->can_sign_concurrently()) {
+            pending[t].emplace_back(chain::async_thread_pool(signing_pool->get_executor(), [w, digest, pk]() {
+               return w->try_sign_digest(digest, pk);
+            }));
+         } else {
+            std::promise<fc::optional<signature_type>> p;
+            p.set_value(w->try_sign_digest(digest, pk));
+            pending[t].emplace_back(p.get_future());
+         }
+      }
+   }
+
+   for (size_t t = 0; t < result.size(); ++t) {
+      const auto& trx_keys = keys.size() == 1 ? keys.front() : keys[t];
+      auto pk = trx_keys.begin();
+      for (auto& f : pending[t]) {
+         fc::optional<signature_type> sig = f.get();
+         if (!sig) {
+            EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", *pk));
+         }
+         result[t].signatures.push_back(*sig);
+         ++pk;
+      }
+   }
+
+   return result;
+}
+
 chain::signature_type
 wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_type& key) {
    check_timeout();
 
    try {
-      for (const auto& i : wallets) {
-         if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(digest, key);
-            if (sig)
-               return *sig;
-         }
+      auto itr = key_index.find(key);
+      if (itr != key_index.end()) {
+         fc::optional<signature_type> sig = itr->second.api->try_sign_digest(digest, key);
+         if (sig)
+            return *sig;
       }
    } FC_LOG_AND_RETHROW();
 
@@ -270,6 +346,7 @@ void wallet_manager::own_and_use_wallet(const string& name, std::unique_ptr<wall
    if(wallets.find(name) != wallets.end())
       EOS_THROW(wallet_exception, "Tried to use wallet name that already exists.");
    wallets.emplace(name, std::move(wallet));
+   reindex_keys();
 }
 
 void wallet_manager::start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t)
@@ -13,6 +13,9 @@
 #include <ostream>
 #include <string>
 #include <regex>
+#include <sstream>
+#include <map>
+#include <memory>
 #include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -29,10 +32,50 @@ using boost::asio::ip::tcp;
 using namespace eosio::chain;
 namespace eosio { namespace client { namespace http {
 
+   template<class T>
+   std::string do_txrx(T& socket, const std::string& request, unsigned int& status_code, bool& keep_alive);
+
    namespace detail {
+      /// a connection to one server, kept open by http_context_impl for its next request when the server allows it
+      class connection {
+         public:
+            virtual ~connection() = default;
+            virtual std::string txrx(const std::string& request, unsigned int& status_code, bool& keep_alive) = 0;
+      };
+
+      template<class Stream>
+      class stream_connection : public connection {
+         public:
+            template<typename... Args>
+            explicit stream_connection(Args&&... args) : stream(std::forward<Args>(args)...) {}
+
+            ~stream_connection() {
+               shutdown(stream);
+            }
+
+            std::string txrx(const std::string& request, unsigned int& status_code, bool& keep_alive) override {
+               return do_txrx(stream, request, status_code, keep_alive);
+            }
+
+            Stream stream;
+
+         private:
+            template<class S>
+            static void shutdown(S&) {}
+
+            static void shutdown(boost::asio::ssl::stream<tcp::socket>& s) {
+               //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
+               try {s.shutdown();} catch(...) {}
+            }
+      };
+
       class http_context_impl {
          public:
             boost::asio::io_service ios;
+            /// loading the platform root certificates is expensive, they are loaded once for all https connections
+            std::unique_ptr<boost::asio::ssl::context> ssl_context;
+            /// idle keep-alive connections, by scheme, server, port and certificate verification
+            std::map<string, std::unique_ptr<connection>> connections;
       };
 
       void http_context_deleter::operator()(http_context_impl* p) const {
@@ -55,9 +98,9 @@ namespace eosio { namespace client { namespace http {
    }
 
    template<class T>
-   std::string do_txrx(T& socket, boost::asio::streambuf& request_buff, unsigned int& status_code) {
+   std::string do_txrx(T& socket, const std::string& request, unsigned int& status_code, bool& keep_alive) {
       // Send the request.
-      boost::asio::write(socket, request_buff);
+      boost::asio::write(socket, boost::asio::buffer(request));
 
       // Read the response status line. The response streambuf will automatically
       // grow to accommodate the entire line. The growth may be limited by passing
@@ -83,12 +126,18 @@ namespace eosio { namespace client { namespace http {
       // Process the response headers.
       std::string header;
       int response_content_length = -1;
+      keep_alive = false;
       std::regex clregex(R"xx(^content-length:\s+(\d+))xx", std::regex_constants::icase);
+      std::regex karegex(R"xx(^connection:\s*keep-alive)xx", std::regex_constants::icase);
       while (std::getline(response_stream, header) && header != "\r") {
          std::smatch match;
          if(std::regex_search(header, match, clregex))
             response_content_length = std::stoi(match[1]);
+         else if(std::regex_search(header, karegex))
+            keep_alive = true;
       }
+      // without a length the end of the body is the end of the connection
+      keep_alive = keep_alive && response_content_length != -1;
 
       // Attempt to read the response body using the length indicated by the
       // Content-length header. If the header was not present just read all available bytes.
@@ -183,6 +232,37 @@ namespace eosio { namespace client { namespace http {
       }
    }
 
+   std::unique_ptr<detail::connection> do_connect(const connection_param& cp) {
+      const auto& url = cp.url;
+      if(url.scheme == "unix") {
+         auto conn = std::make_unique<detail::stream_connection<boost::asio::local::stream_protocol::socket>>(cp.context->ios);
+         conn->stream.connect(boost::asio::local::stream_protocol::endpoint(url.server));
+         return conn;
+      }
+      else if(url.scheme == "http") {
+         auto conn = std::make_unique<detail::stream_connection<tcp::socket>>(cp.context->ios);
+         do_connect(conn->stream, url);
+         return conn;
+      }
+      else { //https
+         if(!cp.context->ssl_context) {
+            cp.context->ssl_context = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23_client);
+            fc::add_platform_root_cas_to_context(*cp.context->ssl_context);
+         }
+
+         auto conn = std::make_unique<detail::stream_connection<boost::asio::ssl::stream<tcp::socket>>>(cp.context->ios, *cp.context->ssl_context);
+         auto& socket = conn->stream;
+         SSL_set_tlsext_host_name(socket.native_handle(), url.server.c_str());
+         if(cp.verify_cert) {
+            socket.set_verify_mode(boost::asio::ssl::verify_peer);
+            socket.set_verify_callback(boost::asio::ssl::rfc2818_verification(url.server));
+         }
+         do_connect(socket.next_layer(), url);
+         socket.handshake(boost::asio::ssl::stream_base::client);
+         return conn;
+      }
+   }
+
    fc::variant do_http_call( const connection_param& cp,
                              const fc::variant& postdata,
                              bool print_request,
@@ -194,14 +274,14 @@ namespace eosio { namespace client { namespace http {
 
    const auto& url = cp.url;
 
-   boost::asio::streambuf request;
-   std::ostream request_stream(&request);
+   std::ostringstream request_stream;
    auto host_header_value = format_host_header(url);
+   // keep-alive as the HTTP/1.0 extension, so that a response always ends with its content-length or the connection
    request_stream << "POST " << url.path << " HTTP/1.0\r\n";
    request_stream << "Host: " << host_header_value << "\r\n";
    request_stream << "content-length: " << postjson.size() << "\r\n";
    request_stream << "Accept: */*\r\n";
-   request_stream << "Connection: close\r\n";
+   request_stream << "Connection: keep-alive\r\n";
    // append more customized headers
    std::vector<string>::iterator itr;
    for (itr = cp.headers.begin(); itr != cp.headers.end(); itr++) {
@@ -209,13 +289,12 @@ namespace eosio { namespace client { namespace http {
    }
    request_stream << "\r\n";
    request_stream << postjson;
+   const std::string request = request_stream.str();
 
    if ( print_request ) {
-      string s(request.size(), '\0');
-      buffer_copy(boost::asio::buffer(s), request.data());
       std::cerr << "REQUEST:" << std::endl
                 << "---------------------" << std::endl
-                << s << std::endl
+                << request << std::endl
                 << "---------------------" << std::endl;
    }
 
@@ -223,31 +302,32 @@ namespace eosio { namespace client { namespace http {
    std::string re;
 
    try {
-      if(url.scheme == "unix") {
-         boost::asio::local::stream_protocol::socket unix_socket(cp.context->ios);
-         unix_socket.connect(boost::asio::local::stream_protocol::endpoint(url.server));
-         re = do_txrx(unix_socket, request, status_code);
-      }
-      else if(url.scheme == "http") {
-         tcp::socket socket(cp.context->ios);
-         do_connect(socket, url);
-         re = do_txrx(socket, request, status_code);
-      }
-      else { //https
-         boost::asio::ssl::context ssl_context(boost::asio::ssl::context::sslv23_client);
-         fc::add_platform_root_cas_to_context(ssl_context);
+      auto& connections = cp.context->connections;
+      const string connection_key = url.scheme + "://" + url.server + ":" + url.port + (cp.verify_cert ? "" : " unverified");
+      for(;;) {
+         std::unique_ptr<detail::connection> conn;
+         auto itr = connections.find(connection_key);
+         const bool reused = itr != connections.end();
+         if(reused) {
+            conn = std::move(itr->second);
+            connections.erase(itr);
+         } else {
+            conn = do_connect(cp);
+         }
 
-         boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket(cp.context->ios, ssl_context);
-         SSL_set_tlsext_host_name(socket.native_handle(), url.server.c_str());
-         if(cp.verify_cert) {
-            socket.set_verify_mode(boost::asio::ssl::verify_peer);
-            socket.set_verify_callback(boost::asio::ssl::rfc2818_verification(url.server));
+         bool keep_alive = false;
+         try {
+            re = conn->txrx(request, status_code, keep_alive);
+         } catch( const boost::system::system_error& e ) {
+            // the server may have closed an idle connection before it read the request, retry it on a new one
+            if( reused && ( e.code() == boost::asio::error::eof || e.code() == boost::asio::error::connection_reset ||
+                            e.code() == boost::asio::error::broken_pipe ) )
+               continue;
+            throw;
          }
-         do_connect(socket.next_layer(), url);
-         socket.handshake(boost::asio::ssl::stream_base::client);
-         re = do_txrx(socket, request, status_code);
-         //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
-         try {socket.shutdown();} catch(...) {}
+         if(keep_alive)
+            connections[connection_key] = std::move(conn);
+         break;
       }
    } catch ( invalid_http_request& e ) {
       e.append_log( FC_LOG_MESSAGE( info, "Please verify this url is valid: ${url}", ("url", url.scheme + "://" + url.server + ":" + url.port + url.path) ) );
@@ -68,6 +68,9 @@ Options:
 #include <string>
 #include <vector>
 #include <regex>
+#include <thread>
+#include <atomic>
+#include <fstream>
 #include <iostream>
 #include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
@@ -101,6 +104,7 @@ Options:
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/algorithm/string/classification.hpp>
 
@@ -164,6 +168,9 @@ string default_wallet_url = "unix://" + (determine_home_directory() / "eosio-wal
 string wallet_url; //to be set to default_wallet_url in main
 bool no_verify = false;
 vector<string> headers;
+string cache_dir = (determine_home_directory() / "eosio-wallet" / "cleos-cache").string();
+uint32_t abi_cache_ttl_sec = 0;
+uint32_t tapos_reuse_sec = 0;
 
 auto   tx_expiration = fc::seconds(30);
 const fc::microseconds abi_serializer_max_time = fc::seconds(10); // No risk to client side serialization taking a long time
@@ -269,6 +276,56 @@ eosio::chain_apis::read_only::get_info_results get_info() {
    return call(url, get_info_func).as<eosio::chain_apis::read_only::get_info_results>();
 }
 
+/// file of the on-disk cache, separate for every node url
+bfs::path cache_file( const string& kind, const string& file_name ) {
+   return bfs::path( cache_dir ) / kind / fc::sha256::hash( url ).str().substr( 0, 16 ) / file_name;
+}
+
+fc::optional<fc::variant> load_cache_file( const bfs::path& file, uint32_t ttl_sec, fc::microseconds& age ) {
+   try {
+      if( !bfs::exists( file ) ) return {};
+      auto v = fc::json::from_file( file.string() );
+      age = fc::time_point::now() - v["fetched"].as<fc::time_point>();
+      if( age >= fc::seconds( ttl_sec ) || age < fc::microseconds() ) return {}; // too old, or from a clock set back
+      return v;
+   } catch( ... ) {
+      return {}; // the cache is only an optimization, a corrupt file is fetched again
+   }
+}
+
+void save_cache_file( const bfs::path& file, fc::mutable_variant_object&& v ) {
+   try {
+      v( "fetched", fc::time_point::now() );
+      bfs::create_directories( file.parent_path() );
+      // other cleos processes may read the file at the same time
+      auto tmp = file;
+      tmp += "." + std::to_string( getpid() ) + ".tmp";
+      fc::json::save_to_file( fc::variant( std::move( v ) ), tmp.string(), false );
+      bfs::rename( tmp, file );
+   } catch( ... ) {}
+}
+
+/**
+ * get_info for the TAPOS and expiration of a new transaction, reused for --tapos-reuse-sec. The head block time of a
+ * reused one is advanced by its age so that expirations stay the same.
+ */
+eosio::chain_apis::read_only::get_info_results get_tapos_info() {
+   if( tapos_reuse_sec == 0 )
+      return get_info();
+   const auto file = cache_file( "info", "get_info.json" );
+   fc::microseconds age;
+   if( auto cached = load_cache_file( file, tapos_reuse_sec, age ) ) {
+      try {
+         auto info = (*cached)["info"].as<eosio::chain_apis::read_only::get_info_results>();
+         info.head_block_time += age;
+         return info;
+      } catch( ... ) {}
+   }
+   auto info = get_info();
+   save_cache_file( file, fc::mutable_variant_object( "info", info ) );
+   return info;
+}
+
 string generate_nonce_string() {
    return fc::to_string(fc::time_point::now().time_since_epoch().count());
 }
@@ -304,7 +361,7 @@ void sign_transaction(signed_transaction& trx, fc::variant& required_keys, const
 }
 
 fc::variant push_transaction( signed_transaction& trx, packed_transaction::compression_type compression = packed_transaction::compression_type::none ) {
-   auto info = get_info();
+   auto info = get_tapos_info();
 
    if (trx.signatures.size() == 0) { // #5445 can't change txn content if already signed
       trx.expiration = info.head_block_time + tx_expiration;
@@ -389,17 +446,52 @@ void print_action( const fc::variant& at ) {
    }
 }
 
+/**
+ * abi of account, from the on-disk cache for --abi-cache-ttl. An expired entry is revalidated by its hash with
+ * get_raw_abi, which only sends the abi back if it changed.
+ */
+fc::optional<abi_def> fetch_abi( const name& account ) {
+   if( abi_cache_ttl_sec == 0 ) {
+      auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
+      return result.as<eosio::chain_apis::read_only::get_abi_results>().abi;
+   }
+
+   const auto file = cache_file( "abi", account.to_string() + ".json" );
+   fc::optional<fc::sha256> cached_hash;
+   bytes raw_abi;
+   fc::microseconds age;
+   // an expired entry is still good for its hash
+   if( auto cached = load_cache_file( file, std::numeric_limits<uint32_t>::max(), age ) ) {
+      try {
+         cached_hash = (*cached)["abi_hash"].as<fc::sha256>();
+         raw_abi = (*cached)["abi"].as<bytes>();
+      } catch( ... ) {
+         cached_hash.reset();
+         raw_abi.clear();
+      }
+   }
+   if( !cached_hash || age >= fc::seconds( abi_cache_ttl_sec ) ) {
+      auto result = call(get_raw_abi_func, fc::mutable_variant_object("account_name", account)("abi_hash", cached_hash))
+                       .as<eosio::chain_apis::read_only::get_raw_abi_results>();
+      if( result.abi ) raw_abi = result.abi->data;
+      else if( !cached_hash || *cached_hash != result.abi_hash ) raw_abi.clear();
+      save_cache_file( file, fc::mutable_variant_object( "abi_hash", result.abi_hash )( "abi", raw_abi ) );
+   }
+   if( raw_abi.empty() )
+      return {};
+   return fc::raw::unpack<abi_def>( raw_abi );
+}
+
 //resolver for ABI serializer to decode actions in proposed transaction in multisig contract
 auto abi_serializer_resolver = [](const name& account) -> fc::optional<abi_serializer> {
    static unordered_map<account_name, fc::optional<abi_serializer> > abi_cache;
    auto it = abi_cache.find( account );
    if ( it == abi_cache.end() ) {
-      auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
-      auto abi_results = result.as<eosio::chain_apis::read_only::get_abi_results>();
+      const auto abi = fetch_abi( account );
 
       fc::optional<abi_serializer> abis;
-      if( abi_results.abi.valid() ) {
-         abis.emplace( *abi_results.abi, abi_serializer_max_time );
+      if( abi.valid() ) {
+         abis.emplace( *abi, abi_serializer_max_time );
       } else {
          std::cerr << "ABI for contract " << account.to_string() << " not found. Action data will be shown in hex only." << std::endl;
       }
@@ -559,6 +651,211 @@ void send_transaction( signed_transaction& trx, packed_transaction::compression_
    }
 }
 
+/// an action of a line of the input of push bulk
+struct bulk_action {
+   size_t        line = 0;
+   chain::action act;
+};
+
+/// outcome of a line of the input of push bulk
+struct bulk_result {
+   size_t                          line = 0;
+   fc::optional<transaction_id_type> transaction_id;
+   fc::optional<string>              error;
+};
+
+/**
+ * actions of a push bulk input file, one per line: JSON objects with account, name, data and optionally authorization,
+ * or with csv lines of account,action,permission,data where data is the JSON rest of the line. Actions without an
+ * authorization are authorized by --permission. Blank lines and lines starting with # are skipped, lines which cannot
+ * be read or serialized end in errors.
+ */
+vector<bulk_action> read_bulk_actions( const string& file, bool csv, vector<bulk_result>& errors ) {
+   std::ifstream in( file );
+   EOSC_ASSERT( in, "ERROR: Failed to open file \"${p}\"", ("p", file) );
+   vector<bulk_action> result;
+   const auto default_permissions = get_account_permissions( tx_permission );
+   string line;
+   for( size_t n = 1; std::getline( in, line ); ++n ) {
+      boost::algorithm::trim( line );
+      if( line.empty() || line[0] == '#' ) continue;
+      try {
+         bulk_action a;
+         a.line = n;
+         fc::variant data;
+         if( csv ) {
+            vector<string> fields;
+            size_t pos = 0;
+            for( int i = 0; i < 3; ++i ) {
+               const auto comma = line.find( ',', pos );
+               EOSC_ASSERT( comma != string::npos, "expected account,action,permission,data" );
+               fields.push_back( boost::algorithm::trim_copy( line.substr( pos, comma - pos ) ) );
+               pos = comma + 1;
+            }
+            a.act.account = name( fields[0] );
+            a.act.name = name( fields[1] );
+            if( !fields[2].empty() ) a.act.authorization = get_account_permissions( { fields[2] } );
+            data = fc::json::from_string( line.substr( pos ), fc::json::relaxed_parser );
+         } else {
+            const auto v = fc::json::from_string( line, fc::json::relaxed_parser );
+            a.act.account = v["account"].as<account_name>();
+            a.act.name = v["name"].as<action_name>();
+            if( v.get_object().contains( "authorization" ) ) a.act.authorization = v["authorization"].as<vector<permission_level>>();
+            if( v.get_object().contains( "data" ) ) data = v["data"];
+         }
+         if( a.act.authorization.empty() ) a.act.authorization = default_permissions;
+         EOSC_ASSERT( !a.act.authorization.empty(), "no authorization, give it in the line or with --permission" );
+         // abis are fetched once per contract, abi_serializer_resolver keeps them
+         a.act.data = variant_to_bin( a.act.account, a.act.name, data );
+         result.push_back( std::move( a ) );
+      } catch( const fc::exception& e ) {
+         errors.push_back( { n, {}, e.top_message() } );
+      } catch( const std::exception& e ) {
+         errors.push_back( { n, {}, string( e.what() ) } );
+      }
+   }
+   return result;
+}
+
+/**
+ * Pushes the actions of a file in transactions of actions_per_trx actions, with the TAPOS of a single get_info, the
+ * keys each set of authorizations needs asked for once and the transactions signed by keosd batch_size at a time, then
+ * pushed with push_transactions batch_size at a time on up to concurrency connections. Batches pushed concurrently
+ * may be applied in any order. Prints the outcome of every line as a JSON object per line.
+ */
+void push_bulk( const string& file, bool csv, uint32_t actions_per_trx, uint32_t batch_size, uint32_t concurrency ) {
+   EOSC_ASSERT( actions_per_trx > 0, "ERROR: actions per transaction must be at least 1" );
+   EOSC_ASSERT( batch_size > 0 && batch_size <= 1000, "ERROR: batch size must be between 1 and 1000" );
+   EOSC_ASSERT( concurrency > 0, "ERROR: concurrency must be at least 1" );
+   const auto start = fc::time_point::now();
+
+   vector<bulk_result> results;
+   const auto actions = read_bulk_actions( file, csv, results );
+
+   // the transactions with the lines of their actions
+   vector<signed_transaction> trxs;
+   vector<vector<size_t>> trx_lines;
+   const auto info = get_tapos_info();
+   block_id_type ref_block_id = info.last_irreversible_block_id;
+   try {
+      if( !tx_ref_block_num_or_id.empty() )
+         ref_block_id = call( get_block_func, fc::mutable_variant_object( "block_num_or_id", tx_ref_block_num_or_id ) )["id"].as<block_id_type>();
+   } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
+   const int64_t nonce_base = fc::time_point::now().time_since_epoch().count();
+   for( size_t i = 0; i < actions.size(); i += actions_per_trx ) {
+      signed_transaction trx;
+      trx.expiration = info.head_block_time + tx_expiration;
+      trx.set_reference_block( ref_block_id );
+      trx.max_cpu_usage_ms = tx_max_cpu_usage;
+      trx.max_net_usage_words = (tx_max_net_usage + 7)/8;
+      trx.delay_sec = delaysec;
+      if( tx_force_unique )
+         trx.context_free_actions.emplace_back( vector<permission_level>{}, config::null_account_name, name("nonce"), fc::raw::pack( nonce_base + int64_t(trxs.size()) ) );
+      vector<size_t> lines;
+      for( size_t j = i; j < std::min( actions.size(), i + actions_per_trx ); ++j ) {
+         trx.actions.push_back( actions[j].act );
+         lines.push_back( actions[j].line );
+      }
+      trxs.push_back( std::move( trx ) );
+      trx_lines.push_back( std::move( lines ) );
+   }
+
+   if( !tx_skip_sign && !trxs.empty() ) {
+      // transactions with the same authorizations need the same keys
+      const auto public_keys = call( wallet_url, wallet_public_keys );
+      std::map<flat_set<permission_level>, flat_set<public_key_type>> keys_by_auths;
+      vector<flat_set<public_key_type>> keys;
+      keys.reserve( trxs.size() );
+      for( const auto& trx : trxs ) {
+         flat_set<permission_level> auths;
+         for( const auto& a : trx.actions )
+            auths.insert( a.authorization.begin(), a.authorization.end() );
+         auto itr = keys_by_auths.find( auths );
+         if( itr == keys_by_auths.end() ) {
+            const auto required = call( get_required_keys, fc::mutable_variant_object( "transaction", (transaction)trx )( "available_keys", public_keys ) );
+            itr = keys_by_auths.emplace( std::move( auths ), required["required_keys"].as<flat_set<public_key_type>>() ).first;
+         }
+         keys.push_back( itr->second );
+      }
+      for( size_t i = 0; i < trxs.size(); i += batch_size ) {
+         const size_t end = std::min<size_t>( trxs.size(), i + batch_size );
+         fc::variants sign_args = { fc::variant( vector<signed_transaction>( trxs.begin() + i, trxs.begin() + end ) ),
+                                    fc::variant( vector<flat_set<public_key_type>>( keys.begin() + i, keys.begin() + end ) ),
+                                    fc::variant( info.chain_id ) };
+         auto signed_trxs = call( wallet_url, wallet_sign_trxs, sign_args ).as<vector<signed_transaction>>();
+         std::move( signed_trxs.begin(), signed_trxs.end(), trxs.begin() + i );
+      }
+   }
+
+   if( tx_dont_broadcast ) {
+      for( const auto& trx : trxs ) {
+         const auto v = tx_return_packed ? fc::variant( packed_transaction( trx, packed_transaction::compression_type::none ) ) : fc::variant( trx );
+         cout << fc::json::to_string( v, fc::time_point::maximum() ) << "\n";
+      }
+      return;
+   }
+
+   // every worker has its own connection, batches are taken in order
+   vector<fc::variant> batch_results( ( trxs.size() + batch_size - 1 ) / batch_size );
+   vector<fc::optional<string>> batch_errors( batch_results.size() );
+   std::atomic<size_t> next_batch{0};
+   auto work = [&]() {
+      auto worker_context = eosio::client::http::create_http_context();
+      for( size_t b = next_batch++; b < batch_results.size(); b = next_batch++ ) {
+         try {
+            const size_t first = b * batch_size;
+            const size_t end = std::min<size_t>( trxs.size(), first + batch_size );
+            vector<packed_transaction> batch;
+            batch.reserve( end - first );
+            for( size_t i = first; i < end; ++i )
+               batch.emplace_back( trxs[i], packed_transaction::compression_type::none );
+            eosio::client::http::connection_param cp( worker_context, parse_url( url ) + push_txns_func, !no_verify, headers );
+            batch_results[b] = eosio::client::http::do_http_call( cp, fc::variant( batch ), print_request, print_response );
+         } catch( const fc::exception& e ) {
+            batch_errors[b] = e.top_message();
+         } catch( const std::exception& e ) {
+            batch_errors[b] = string( e.what() );
+         }
+      }
+   };
+   vector<std::thread> workers;
+   for( uint32_t i = 1; i < std::min<size_t>( concurrency, batch_results.size() ); ++i )
+      workers.emplace_back( work );
+   work();
+   for( auto& w : workers )
+      w.join();
+
+   size_t failed_trxs = 0;
+   for( size_t t = 0; t < trxs.size(); ++t ) {
+      const size_t b = t / batch_size;
+      bulk_result r;
+      r.transaction_id = trxs[t].id();
+      if( batch_errors[b] ) {
+         r.error = batch_errors[b];
+      } else {
+         const auto& processed = batch_results[b].get_array().at( t % batch_size )["processed"];
+         if( processed.is_object() && processed.get_object().contains( "error" ) )
+            r.error = processed["error"].as_string();
+      }
+      if( r.error ) ++failed_trxs;
+      for( size_t line : trx_lines[t] ) {
+         r.line = line;
+         results.push_back( r );
+      }
+   }
+   std::sort( results.begin(), results.end(), []( const bulk_result& a, const bulk_result& b ) { return a.line < b.line; } );
+   for( const auto& r : results ) {
+      auto v = fc::mutable_variant_object( "line", r.line );
+      if( r.transaction_id ) v( "transaction_id", *r.transaction_id );
+      if( r.error ) v( "error", *r.error );
+      cout << fc::json::to_string( fc::variant( std::move( v ) ), fc::time_point::maximum() ) << "\n";
+   }
+   const auto elapsed = fc::time_point::now() - start;
+   std::cerr << localized( "pushed ${t} transactions of ${a} actions in ${ms} ms, ${f} transactions and ${e} lines failed",
+                           ("t", trxs.size())("a", actions.size())("ms", elapsed.count() / 1000)("f", failed_trxs)
+                           ("e", results.size() - actions.size()) ) << std::endl;
+}
+
 chain::permission_level to_permission_level(const std::string& s) {
    auto at_pos = s.find('@');
    return permission_level { name(s.substr(0, at_pos)), name(s.substr(at_pos + 1)) };
@@ -2411,6 +2708,9 @@ int main( int argc, char** argv ) {
 
    app.add_option( "-r,--header", header_opt_callback, localized("pass specific HTTP header; repeat this option to pass multiple headers"));
    app.add_flag( "-n,--no-verify", no_verify, localized("don't verify peer certificate when using HTTPS"));
+   app.add_option( "--cache-dir", cache_dir, localized("directory of the cache used by --abi-cache-ttl and --tapos-reuse-sec"), true );
+   app.add_option( "--abi-cache-ttl", abi_cache_ttl_sec, localized("use contract ABIs from the cache for this many seconds before checking with ${n} that they did not change, 0 disables the cache", ("n", node_executable_name)) );
+   app.add_option( "--tapos-reuse-sec", tapos_reuse_sec, localized("reuse the chain info of the last transaction for the TAPOS and expiration of new ones for this many seconds, 0 gets it for every transaction") );
    app.add_flag( "--no-auto-" + string(key_store_executable_name), no_auto_keosd, localized("don't automatically launch a ${k} if one is not currently running", ("k", key_store_executable_name)));
    app.set_callback([&app]{ ensure_keosd_running(&app);});
 
@@ -2672,6 +2972,8 @@ int main( int argc, char** argv ) {
    string index_position;
    bool reverse = false;
    bool show_payer = false;
+   string table_filters;
+   vector<string> table_fields;
    auto getTable = get->add_subcommand( "table", localized("Retrieve the contents of a database table"), false);
    getTable->add_option( "account", code, localized("The account who owns the table") )->required();
    getTable->add_option( "scope", scope, localized("The scope within the contract in which the table is found") )->required();
@@ -2692,6 +2994,10 @@ int main( int argc, char** argv ) {
    getTable->add_flag("-b,--binary", binary, localized("Return the value as BINARY rather than using abi to interpret as JSON"));
    getTable->add_flag("-r,--reverse", reverse, localized("Iterate in reverse order"));
    getTable->add_flag("--show-payer", show_payer, localized("show RAM payer"));
+   getTable->add_option( "--filters", table_filters,
+                         localized("JSON string or filename of an array of {\"field\", \"op\", \"value\"}, the rows must match all of them, e.g. "
+                                   "'[{\"field\":\"balance\",\"op\":\">=\",\"value\":\"10.0000 EOS\"}]'") );
+   getTable->add_option( "--fields", table_fields, localized("Fields of the rows to return, nested fields separated by dots") );
 
 
    getTable->set_callback([&] {
@@ -2708,6 +3014,8 @@ int main( int argc, char** argv ) {
                          ("encode_type", encode_type)
                          ("reverse", reverse)
                          ("show_payer", show_payer)
+                         ("filters", table_filters.empty() ? fc::variants() : json_from_file_or_string( table_filters ).get_array())
+                         ("fields", table_fields)
                          );
 
       std::cout << fc::json::to_pretty_string(result)
@@ -3484,6 +3792,23 @@ int main( int argc, char** argv ) {
    });
 
 
+   // push bulk
+   string bulk_file;
+   bool bulk_csv = false;
+   uint32_t bulk_actions_per_trx = 1;
+   uint32_t bulk_batch_size = 100;
+   uint32_t bulk_concurrency = 4;
+   auto bulkSubcommand = push->add_subcommand("bulk", localized("Push the actions of a file, one per line, in many transactions"));
+   bulkSubcommand->add_option("file", bulk_file, localized("The file of the actions, a JSON object with account, name, data and optionally authorization per line, or with --csv account,action,permission,data lines"))->required();
+   bulkSubcommand->add_flag("--csv", bulk_csv, localized("Read account,action,permission,data lines, data being the JSON rest of the line and an empty permission standing for --permission"));
+   bulkSubcommand->add_option("--actions-per-trx", bulk_actions_per_trx, localized("The number of actions of each transaction"), true);
+   bulkSubcommand->add_option("--batch-size", bulk_batch_size, localized("The number of transactions signed and pushed together, at most 1000"), true);
+   bulkSubcommand->add_option("--concurrency", bulk_concurrency, localized("The number of batches pushed at the same time, batches pushed together may be applied in any order"), true);
+   add_standard_transaction_options(bulkSubcommand);
+   bulkSubcommand->set_callback([&] {
+      push_bulk(bulk_file, bulk_csv, bulk_actions_per_trx, bulk_batch_size, bulk_concurrency);
+   });
+
    // multisig subcommand
    auto msig = app.add_subcommand("multisig", localized("Multisig contract commands"), false);
    msig->require_subcommand();
@@ -1,8 +1,13 @@
 #include <memory>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/account_bloom_index.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/config.hpp>
-#include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/protocol_feature_manager.hpp>
+#include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/filesystem.hpp>
@@ -15,6 +20,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include <chrono>
+#include <mutex>
 
 #ifndef _WIN32
 #define FOPEN(p, m) fopen(p, m)
@@ -35,6 +41,8 @@ struct blocklog {
    {}
 
    void read_log();
+   std::string format_block(const signed_block_ptr& b) const;
+   void replay_benchmark();
    void set_program_options(options_description& cli);
    void initialize(const variables_map& options);
 
@@ -44,9 +52,25 @@ struct blocklog {
    uint32_t                         last_block = std::numeric_limits<uint32_t>::max();
    bool                             no_pretty_print = false;
    bool                             as_json_array = false;
+   bool                             ndjson = false;
+   bool                             binary_output = false;
+   uint16_t                         threads = 1;
    bool                             make_index = false;
+   bool                             make_trx_index = false;
+   bool                             make_account_index = false;
+   optional<account_name>           account_filter;
+   optional<action_name>            action_filter;
    bool                             trim_log = false;
    bool                             smoke_test = false;
+   bool                             compress_log = false;
+   bool                             decompress_log = false;
+   bool                             replay_bench = false;
+   bfs::path                        snapshot;
+   bfs::path                        work_dir;
+   wasm_interface::vm_type          wasm_runtime = config::default_wasm_runtime;
+   bool                             eosvmoc_tierup = false;
+   uint64_t                         state_size_mb = 0;
+   uint16_t                         chain_threads = 0;
    bool                             help = false;
 };
 
@@ -79,25 +103,16 @@ void blocklog::read_log() {
       first_block = block_logger.first_block_num();
    }
 
-   optional<chainbase::database> reversible_blocks;
-   try {
-      reversible_blocks.emplace(blocks_dir / config::reversible_blocks_dir_name, chainbase::database::read_only, config::default_reversible_cache_size);
-      reversible_blocks->add_index<reversible_block_index>();
-      const auto& idx = reversible_blocks->get_index<reversible_block_index,by_num>();
-      auto first = idx.lower_bound(end->block_num());
-      auto last = idx.rbegin();
-      if (first != idx.end() && last != idx.rend())
-         ilog( "existing reversible block num ${first} through block num ${last} ", ("first",first->get_block()->block_num())("last",last->get_block()->block_num()) );
-      else {
-         elog( "no blocks available in reversible block database: only block_log blocks are available" );
-         reversible_blocks.reset();
-      }
-   } catch( const std::runtime_error& e ) {
-      if( std::string(e.what()).find("database dirty flag set") != std::string::npos ) {
-         elog( "database dirty flag set (likely due to unclean shutdown): only block_log blocks are available" );
-      } else {
-         throw;
-      }
+   optional<reversible_block_log> reversible_blocks;
+   reversible_blocks.emplace(blocks_dir / config::reversible_blocks_dir_name, true);
+   if (reversible_blocks->dropped_partial_block())
+      elog( "reversible block log ends with a block cut short (likely due to unclean shutdown): it is not included" );
+   if (!reversible_blocks->empty() && reversible_blocks->last_block_num() >= end->block_num())
+      ilog( "existing reversible block num ${first} through block num ${last} ",
+            ("first",std::max(reversible_blocks->first_block_num(), end->block_num()))("last",reversible_blocks->last_block_num()) );
+   else {
+      elog( "no blocks available in reversible block log: only block_log blocks are available" );
+      reversible_blocks.reset();
    }
 
    std::ofstream output_blocks;
@@ -118,44 +133,69 @@ void blocklog::read_log() {
       *out << "[";
    uint32_t block_num = (first_block < 1) ? 1 : first_block;
    signed_block_ptr next;
-   fc::variant pretty_output;
-   const fc::microseconds deadline = fc::seconds(10);
-   auto print_block = [&](signed_block_ptr& next) {
-      abi_serializer::to_variant(*next,
-                                 pretty_output,
-                                 []( account_name n ) { return optional<abi_serializer>(); },
-                                 deadline);
-      const auto block_id = next->id();
-      const uint32_t ref_block_prefix = block_id._hash[1];
-      const auto enhanced_object = fc::mutable_variant_object
-                 ("block_num",next->block_num())
-                 ("id", block_id)
-                 ("ref_block_prefix", ref_block_prefix)
-                 (pretty_output.get_object());
-      fc::variant v(std::move(enhanced_object));
-      if (no_pretty_print)
-         fc::json::to_stream(*out, v, fc::time_point::maximum(), fc::json::stringify_large_ints_and_doubles);
-      else
-         *out << fc::json::to_pretty_string(v) << "\n";
-   };
    bool contains_obj = false;
-   while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
+   auto write_block = [&](const std::string& formatted) {
       if (as_json_array && contains_obj)
          *out << ",";
-      print_block(next);
+      out->write(formatted.data(), formatted.size());
       ++block_num;
       contains_obj = true;
+   };
+   const bool filtered = account_filter || action_filter;
+   auto matches = [&](const signed_block_ptr& b) {
+      return !filtered || account_bloom_index::touches(*b, account_filter, action_filter);
+   };
+   const uint32_t log_last_block = std::min(last_block, end->block_num());
+   if (filtered && block_num <= log_last_block) {
+      // only the blocks of the ranges accounts.bloom does not rule out are read, every block without it
+      vector<std::pair<uint32_t, uint32_t>> ranges{{block_num, log_last_block}};
+      const auto index_file = blocks_dir / "accounts.bloom";
+      if (bfs::exists(index_file)) {
+         account_bloom_index index(index_file);
+         ranges = index.find(block_num, log_last_block, account_filter, action_filter);
+      }
+      for (const auto& r : ranges) {
+         for (uint32_t n = r.first; n <= r.second; ++n) {
+            next = block_logger.read_block_by_num(n);
+            if (next && matches(next))
+               write_block(format_block(next));
+         }
+      }
+      block_num = log_last_block + 1;
+   } else if (threads > 1 && block_num <= log_last_block) {
+      // blocks are read sequentially from the position blocks.index gives for the first one, then deserialized and
+      // formatted on the pool; the formatted blocks are written in block order
+      std::mutex formatted_mtx;
+      std::map<uint32_t, std::string> formatted;
+      named_thread_pool pool("blklog", threads);
+      block_log_prefetcher prefetcher(blocks_dir, block_logger.first_block_num(), block_num, log_last_block, threads * 8u,
+                                      pool.get_executor(), [&](const signed_block_ptr& b) {
+         auto f = format_block(b);
+         std::lock_guard<std::mutex> g(formatted_mtx);
+         formatted.emplace(b->block_num(), std::move(f));
+      });
+      while ((next = prefetcher.next())) {
+         std::string f;
+         {
+            std::lock_guard<std::mutex> g(formatted_mtx);
+            auto itr = formatted.find(next->block_num());
+            f = std::move(itr->second);
+            formatted.erase(itr);
+         }
+         write_block(f);
+      }
+   } else {
+      while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
+         write_block(format_block(next));
+      }
    }
 
    if (reversible_blocks) {
-      const reversible_block_object* obj = nullptr;
-      while( (block_num <= last_block) && (obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) ) {
-         if (as_json_array && contains_obj)
-            *out << ",";
-         auto next = obj->get_block();
-         print_block(next);
-         ++block_num;
-         contains_obj = true;
+      while( (block_num <= last_block) && (next = reversible_blocks->read_block(block_num)) ) {
+         if (matches(next))
+            write_block(format_block(next));
+         else
+            ++block_num;
       }
    }
 
@@ -164,6 +204,187 @@ void blocklog::read_log() {
    rt.report();
 }
 
+static protocol_feature_set make_protocol_feature_set() {
+   protocol_feature_set pfs;
+   map< builtin_protocol_feature_t, optional<digest_type> > visited_builtins;
+
+   std::function<digest_type(builtin_protocol_feature_t)> add_builtins =
+   [&pfs, &visited_builtins, &add_builtins]( builtin_protocol_feature_t codename ) -> digest_type {
+      auto res = visited_builtins.emplace( codename, optional<digest_type>() );
+      if( !res.second ) {
+         EOS_ASSERT( res.first->second, protocol_feature_exception,
+                     "invariant failure: cycle found in builtin protocol feature dependencies" );
+         return *res.first->second;
+      }
+      auto f = protocol_feature_set::make_default_builtin_protocol_feature( codename,
+      [&add_builtins]( builtin_protocol_feature_t d ) {
+         return add_builtins( d );
+      } );
+      const auto& pf = pfs.add_feature( f );
+      res.first->second = pf.feature_digest;
+      return pf.feature_digest;
+   };
+
+   for( const auto& p : builtin_protocol_feature_codenames ) {
+      add_builtins( p.first );
+   }
+   return pfs;
+}
+
+// thread safe, called on the worker threads when threads > 1
+std::string blocklog::format_block(const signed_block_ptr& b) const {
+   if (binary_output) {
+      // the packed signed_block preceded by its size as a little endian uint32
+      const uint32_t size = fc::raw::pack_size(*b);
+      std::string result(sizeof(size) + size, '\0');
+      memcpy(&result[0], &size, sizeof(size));
+      fc::datastream<char*> ds(&result[sizeof(size)], size);
+      fc::raw::pack(ds, *b);
+      return result;
+   }
+   fc::variant pretty_output;
+   const fc::microseconds deadline = fc::seconds(10);
+   abi_serializer::to_variant(*b,
+                              pretty_output,
+                              []( account_name n ) { return optional<abi_serializer>(); },
+                              deadline);
+   const auto block_id = b->id();
+   const uint32_t ref_block_prefix = block_id._hash[1];
+   const auto enhanced_object = fc::mutable_variant_object
+              ("block_num",b->block_num())
+              ("id", block_id)
+              ("ref_block_prefix", ref_block_prefix)
+              (pretty_output.get_object());
+   fc::variant v(std::move(enhanced_object));
+   if (ndjson)
+      return fc::json::to_string(v, fc::time_point::maximum(), fc::json::stringify_large_ints_and_doubles) + "\n";
+   if (no_pretty_print)
+      return fc::json::to_string(v, fc::time_point::maximum(), fc::json::stringify_large_ints_and_doubles);
+   return fc::json::to_pretty_string(v) + "\n";
+}
+
+// applies blocks of blocks.log to a fresh state started from a snapshot or the genesis in the log and reports the
+// time spent in each phase; blocks before first_block are applied without being measured
+void blocklog::replay_benchmark() {
+   block_log source(blocks_dir);
+   EOS_ASSERT( source.head(), block_log_exception, "No blocks found in block log" );
+
+   optional<fc::temp_directory> temp_dir;
+   bfs::path dir = work_dir;
+   if (dir.empty()) {
+      temp_dir.emplace();
+      dir = temp_dir->path();
+   }
+   EOS_ASSERT( !bfs::exists(dir / config::default_state_dir_name / "shared_memory.bin"), block_log_exception,
+               "work-dir ${d} already contains a state, replay-benchmark needs an empty one", ("d", dir.generic_string()) );
+
+   controller::config cfg;
+   cfg.blocks_dir = dir / config::default_blocks_dir_name;
+   cfg.state_dir = dir / config::default_state_dir_name;
+   cfg.state_size = state_size_mb * 1024 * 1024;
+   cfg.thread_pool_size = chain_threads;
+   cfg.wasm_runtime = wasm_runtime;
+   cfg.eosvmoc_tierup = eosvmoc_tierup;
+   cfg.apply_phase_timing = true;
+
+   std::ifstream snapshot_in;
+   std::shared_ptr<istream_snapshot_reader> reader;
+   optional<genesis_state> genesis;
+   chain_id_type chain_id;
+   if (!snapshot.empty()) {
+      snapshot_in.open(snapshot.generic_string(), (std::ios::in | std::ios::binary));
+      EOS_ASSERT( snapshot_in.good(), snapshot_exception, "Cannot open snapshot ${s}", ("s", snapshot.generic_string()) );
+      reader = make_istream_snapshot_reader(snapshot_in);
+      reader->validate();
+      chain_id = controller::extract_chain_id(*reader);
+   } else {
+      genesis = block_log::extract_genesis_state(blocks_dir);
+      EOS_ASSERT( genesis, block_log_exception, "blocks.log does not start at genesis, give a snapshot" );
+      chain_id = genesis->compute_chain_id();
+   }
+   EOS_ASSERT( block_log::extract_chain_id(blocks_dir) == chain_id, block_log_exception,
+               "the chain id of blocks.log does not match the one of the starting state" );
+
+   controller chain(cfg, make_protocol_feature_set(), chain_id);
+   chain.add_indices();
+   auto shutdown = [](){ return false; };
+   if (reader) {
+      chain.startup(shutdown, reader);
+      snapshot_in.close();
+   } else {
+      chain.startup(shutdown, *genesis);
+   }
+
+   uint32_t block_num = chain.head_block_num() + 1;
+   EOS_ASSERT( block_num >= source.first_block_num(), block_log_exception,
+               "blocks.log starts at block ${f}, after the first block ${b} to apply", ("f", source.first_block_num())("b", block_num) );
+   const uint32_t measure_from = std::max(first_block, block_num);
+   ilog( "replaying from block ${b}, measuring from block ${m}", ("b", block_num)("m", measure_from) );
+
+   apply_phase_stats& stats = *chain.get_apply_phase_stats();
+   apply_phase_stats baseline;
+   uint64_t deserialize_ns = 0;
+   auto start = std::chrono::steady_clock::now();
+   for (; block_num <= last_block; ++block_num) {
+      signed_block_ptr b;
+      {
+         apply_phase_timer deserialize_timer( block_num >= measure_from ? &deserialize_ns : nullptr );
+         b = source.read_block_by_num(block_num);
+      }
+      if (!b)
+         break;
+      if (block_num == measure_from) {
+         baseline = stats;
+         start = std::chrono::steady_clock::now();
+      }
+      auto bsf = chain.create_block_state_future(b);
+      chain.push_block(bsf, forked_branch_callback{}, trx_meta_cache_lookup{});
+   }
+   const uint64_t total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+   EOS_ASSERT( block_num > measure_from, block_log_exception, "no block was measured, blocks.log ends at block ${b}", ("b", block_num - 1) );
+
+   const uint64_t blocks = stats.blocks - baseline.blocks;
+   const uint64_t transactions = stats.transactions - baseline.transactions;
+   const uint64_t db_write_ns = stats.db_write_ns - baseline.db_write_ns;
+   const uint64_t wasm_ns = stats.wasm_ns - baseline.wasm_ns;
+   const uint64_t phases[] = { deserialize_ns,
+                               stats.recover_keys_ns - baseline.recover_keys_ns,
+                               stats.authorization_ns - baseline.authorization_ns,
+                               wasm_ns > db_write_ns ? wasm_ns - db_write_ns : 0,
+                               db_write_ns,
+                               stats.finalize_block_ns - baseline.finalize_block_ns,
+                               stats.commit_block_ns - baseline.commit_block_ns };
+   const char* const phase_names[] = { "deserialize", "recover_keys", "authorization", "wasm", "db_write", "finalize_block", "commit_block" };
+   uint64_t measured_ns = 0;
+   fc::mutable_variant_object phase_ms;
+   for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); ++i) {
+      measured_ns += phases[i];
+      phase_ms(phase_names[i], phases[i] / 1000000.0);
+   }
+   phase_ms("other", (total_ns > measured_ns ? total_ns - measured_ns : 0) / 1000000.0);
+
+   const double seconds = total_ns / 1e9;
+   fc::variant result = fc::mutable_variant_object()
+         ("first_block", measure_from)
+         ("last_block", block_num - 1)
+         ("wasm_runtime", fc::variant(wasm_runtime))
+         ("eosvmoc_tierup", eosvmoc_tierup)
+         ("blocks", blocks)
+         ("transactions", transactions)
+         ("seconds", seconds)
+         ("blocks_per_second", seconds > 0 ? blocks / seconds : 0)
+         ("transactions_per_second", seconds > 0 ? transactions / seconds : 0)
+         ("phase_ms", phase_ms);
+
+   if (!output_file.empty()) {
+      std::ofstream out(output_file.generic_string().c_str());
+      EOS_ASSERT( out.good(), block_log_exception, "Unable to open file ${f}", ("f", output_file.generic_string()) );
+      out << fc::json::to_pretty_string(result) << "\n";
+   } else {
+      std::cout << fc::json::to_pretty_string(result) << "\n";
+   }
+}
+
 void blocklog::set_program_options(options_description& cli)
 {
    cli.add_options()
@@ -179,12 +400,51 @@ void blocklog::set_program_options(options_description& cli)
           "Do not pretty print the output.  Useful if piping to jq to improve performance.")
          ("as-json-array", bpo::bool_switch(&as_json_array)->default_value(false),
           "Print out json blocks wrapped in json array (otherwise the output is free-standing json objects).")
+         ("ndjson", bpo::bool_switch(&ndjson)->default_value(false),
+          "Print one compact json block per line.")
+         ("binary", bpo::bool_switch(&binary_output)->default_value(false),
+          "Print every block as its packed signed_block preceded by the size of it as a little endian uint32 instead of json.")
+         ("threads,t", bpo::value<uint16_t>(&threads)->default_value(1),
+          "Number of threads deserializing and converting the blocks of blocks.log, or indexing regions of it with --make-index. The output stays in block order.")
          ("make-index", bpo::bool_switch(&make_index)->default_value(false),
           "Create blocks.index from blocks.log. Must give 'blocks-dir'. Give 'output-file' relative to current directory or absolute path (default is <blocks-dir>/blocks.index).")
+         ("make-trx-index", bpo::bool_switch(&make_trx_index)->default_value(false),
+          "Create trx.index, the block numbers of the transaction ids, from blocks.log for nodeos --trx-index, reading blocks on 'threads' threads. "
+          "Must give 'blocks-dir'. Give 'output-file' relative to current directory or absolute path (default is <blocks-dir>/trx.index).")
+         ("make-account-index", bpo::bool_switch(&make_account_index)->default_value(false),
+          "Create accounts.bloom, bloom filters of the accounts and action names of every 10000 blocks, from blocks.log for nodeos --account-index "
+          "and 'account' and 'action', filling the filters on 'threads' threads. "
+          "Must give 'blocks-dir'. Give 'output-file' relative to current directory or absolute path (default is <blocks-dir>/accounts.bloom).")
+         ("account", bpo::value<std::string>(),
+          "Print only the blocks with an action of this account or authorized by it. The ranges of blocks <blocks-dir>/accounts.bloom rules out are not read.")
+         ("action", bpo::value<std::string>(),
+          "Print only the blocks with an action of this name, with 'account' an action of this name of or authorized by the account.")
          ("trim-blocklog", bpo::bool_switch(&trim_log)->default_value(false),
           "Trim blocks.log and blocks.index. Must give 'blocks-dir' and 'first and/or 'last'.")
          ("smoke-test", bpo::bool_switch(&smoke_test)->default_value(false),
           "Quick test that blocks.log and blocks.index are well formed and agree with each other.")
+         ("compress-blocklog", bpo::bool_switch(&compress_log)->default_value(false),
+          "Write a copy of blocks.log and blocks.index with every block zlib compressed. Must give 'blocks-dir' and 'output-dir'.")
+         ("decompress-blocklog", bpo::bool_switch(&decompress_log)->default_value(false),
+          "Write an uncompressed copy of a compressed blocks.log and its blocks.index. Must give 'blocks-dir' and 'output-dir'.")
+         ("replay-benchmark", bpo::bool_switch(&replay_bench)->default_value(false),
+          "Apply the blocks of blocks.log up to 'last' to a new state without networking and print blocks/s, transactions/s and the time spent "
+          "deserializing, waiting for signature recovery, checking authorizations, executing wasm, writing tables, finalizing and committing. "
+          "Blocks before 'first' are applied without being measured.")
+         ("snapshot", bpo::value<bfs::path>(&snapshot),
+          "the snapshot replay-benchmark starts from; without it the state starts from the genesis of blocks.log")
+         ("work-dir", bpo::value<bfs::path>(&work_dir),
+          "the empty directory replay-benchmark writes its state and blocks to, a temporary directory if not given")
+         ("wasm-runtime", bpo::value<wasm_interface::vm_type>(&wasm_runtime)->value_name("runtime"),
+          "the WASM runtime replay-benchmark uses")
+         ("eos-vm-oc-enable", bpo::bool_switch(&eosvmoc_tierup)->default_value(false),
+          "Enable the EOS VM OC tier-up runtime for replay-benchmark")
+         ("chain-state-db-size-mb", bpo::value<uint64_t>(&state_size_mb)->default_value(config::default_state_size / (1024 * 1024)),
+          "Maximum size (in MiB) of the state replay-benchmark creates")
+         ("chain-threads", bpo::value<uint16_t>(&chain_threads)->default_value(config::default_controller_thread_pool_size),
+          "Number of controller threads replay-benchmark uses for signature recovery")
+         ("output-dir", bpo::value<bfs::path>(),
+          "the directory to write the converted block log to for compress-blocklog and decompress-blocklog (absolute path or relative to the current directory)")
          ("help,h", bpo::bool_switch(&help)->default_value(false), "Print this help message and exit.")
          ;
 }
@@ -204,6 +464,14 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+      EOS_ASSERT( !(binary_output && (as_json_array || ndjson)), block_log_exception,
+                  "binary cannot be combined with as-json-array or ndjson" );
+      EOS_ASSERT( !(ndjson && as_json_array), block_log_exception, "ndjson cannot be combined with as-json-array" );
+      EOS_ASSERT( threads > 0, block_log_exception, "threads must be at least 1" );
+      if (options.count( "account" ))
+         account_filter = account_name( options.at( "account" ).as<std::string>() );
+      if (options.count( "action" ))
+         action_filter = action_name( options.at( "action" ).as<std::string>() );
    } FC_LOG_AND_RETHROW()
 
 }
@@ -248,12 +516,7 @@ void smoke_test(bfs::path block_dir) {
    uint64_t file_pos;
    auto size = fread((void*)&file_pos, sizeof(uint64_t), 1, td.blk_in);
    EOS_ASSERT( size == 1, block_log_exception, "${file} read fails", ("file", td.block_file_name.string()) );
-   status = fseek(td.blk_in, file_pos + trim_data::blknum_offset, SEEK_SET);
-   EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} ${pos} from beginning of file", ("file", td.block_file_name.string())("pos", file_pos + trim_data::blknum_offset) );
-   uint32_t bnum;
-   size = fread((void*)&bnum, sizeof(uint32_t), 1, td.blk_in);
-   EOS_ASSERT( size == 1, block_log_exception, "${file} read fails", ("file", td.block_file_name.string()) );
-   bnum = endian_reverse_u32(bnum) + 1;                       //convert from big endian to little endian and add 1
+   const uint32_t bnum = td.read_block_num(file_pos);
    EOS_ASSERT( td.last_block == bnum, block_log_exception, "blocks.log says last block is ${lb} which disagrees with blocks.index", ("lb", bnum) );
    cout << "blocks.log and blocks.index agree on number of blocks\n";
    uint32_t delta = (td.last_block + 8 - td.first_block) >> 3;
@@ -301,6 +564,18 @@ int main(int argc, char** argv) {
          }
          return 0;
       }
+      if (blog.compress_log || blog.decompress_log) {
+         EOS_ASSERT( !(blog.compress_log && blog.decompress_log), block_log_exception,
+                     "compress-blocklog and decompress-blocklog cannot be used together" );
+         EOS_ASSERT( vmap.count("output-dir") > 0, block_log_exception, "output-dir is required to convert the block log" );
+         bfs::path out_dir = vmap.at("output-dir").as<bfs::path>();
+         if (out_dir.is_relative())
+            out_dir = bfs::current_path() / out_dir;
+         report_time rt(blog.compress_log ? "compressing blocklog" : "decompressing blocklog");
+         block_log::convert_log(vmap.at("blocks-dir").as<bfs::path>(), out_dir, blog.compress_log);
+         rt.report();
+         return 0;
+      }
       if (blog.make_index) {
          const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
          bfs::path out_file = blocks_dir / "blocks.index";
@@ -312,11 +587,40 @@ int main(int argc, char** argv) {
          report_time rt("making index");
          const auto log_level = fc::logger::get(DEFAULT_LOGGER).get_log_level();
          fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::debug);
-         block_log::construct_index(block_file.generic_string(), out_file.generic_string());
+         block_log::construct_index(block_file.generic_string(), out_file.generic_string(), blog.threads);
          fc::logger::get(DEFAULT_LOGGER).set_log_level(log_level);
          rt.report();
          return 0;
       }
+      if (blog.make_trx_index) {
+         const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
+         bfs::path out_file = blocks_dir / "trx.index";
+         if (vmap.count("output-file") > 0)
+             out_file = vmap.at("output-file").as<bfs::path>();
+
+         report_time rt("making trx index");
+         block_log::construct_trx_index(blocks_dir, out_file, std::max<uint16_t>(blog.threads, 1));
+         rt.report();
+         return 0;
+      }
+      if (blog.make_account_index) {
+         const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
+         bfs::path out_file = blocks_dir / "accounts.bloom";
+         if (vmap.count("output-file") > 0)
+             out_file = vmap.at("output-file").as<bfs::path>();
+
+         report_time rt("making account index");
+         block_log::construct_account_index(blocks_dir, out_file, std::max<uint16_t>(blog.threads, 1));
+         rt.report();
+         return 0;
+      }
+      if (blog.replay_bench) {
+         blog.initialize(vmap);
+         report_time rt("replay benchmark");
+         blog.replay_benchmark();
+         rt.report();
+         return 0;
+      }
       //else print blocks.log as JSON
       blog.initialize(vmap);
       blog.read_log();
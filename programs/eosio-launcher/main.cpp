@@ -3,6 +3,7 @@
 #include <math.h>
 #include <sstream>
 #include <regex>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -29,6 +30,8 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <net/if.h>
+#include <eosio/chain/block_timestamp.hpp>
+#include <eosio/chain/config.hpp>
 #include <eosio/chain/genesis_state.hpp>
 
 #include "config.hpp"
@@ -323,6 +326,30 @@ struct last_run_def {
   vector <node_rt_info> running_nodes;
 };
 
+struct benchmark_node_report {
+  string   name;
+  uint32_t head_block_num = 0;
+  uint32_t last_irreversible_block_num = 0;
+  uint32_t blocks_seen = 0;               // blocks of the measured range that reached the node
+  int64_t  p50_block_latency_ms = 0;      // first poll seeing a block minus its timestamp
+  int64_t  p90_block_latency_ms = 0;
+  int64_t  max_block_latency_ms = 0;
+  uint32_t failed_polls = 0;
+};
+
+struct benchmark_report {
+  uint32_t    seconds = 0;
+  uint32_t    latency_ms = 0;
+  uint32_t    first_block_num = 0;
+  uint32_t    last_block_num = 0;
+  uint32_t    blocks = 0;
+  uint32_t    missed_slots = 0;           // slots between the first and last block without a block
+  uint64_t    transactions = 0;
+  double      tps = 0;
+  fc::variant workload_status;
+  vector<benchmark_node_report> nodes;
+};
+
 enum launch_modes {
   LM_NONE,
   LM_LOCAL,
@@ -428,6 +455,13 @@ struct launcher_def {
    fc::optional<uint32_t> max_block_cpu_usage;
    fc::optional<uint32_t> max_transaction_cpu_usage;
    eosio::chain::genesis_state genesis_from_file;
+   uint32_t benchmark_seconds = 0;
+   uint32_t benchmark_latency_ms = 0;
+   uint32_t benchmark_sample_ms = 100;
+   string benchmark_net_device;
+   bfs::path benchmark_workload;
+   string benchmark_load_node;
+   bfs::path benchmark_report_file;
 
    void assign_name (eosd_def &node, bool is_bios);
 
@@ -473,6 +507,9 @@ struct launcher_def {
    void roll (const string& host_names);
    void start_all (string &gts, launch_modes mode);
    void ignite ();
+   string load_node_name ();
+   void impair_network (bool enable);
+   void benchmark ();
 };
 
 void
@@ -506,6 +543,13 @@ launcher_def::set_options (bpo::options_description &cfg) {
     ("script",bpo::value<string>(&start_script)->default_value("bios_boot.sh"),"the generated startup script name")
     ("max-block-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-block-cpu-usage\" value to use in the genesis.json file")
     ("max-transaction-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-transaction-cpu-usage\" value to use in the genesis.json file")
+    ("benchmark-seconds",bpo::value<uint32_t>(&benchmark_seconds)->default_value(0),"After starting and booting the network, measure block propagation latency, missed slots and TPS of all nodes for this many seconds. 0 disables the benchmark")
+    ("benchmark-latency-ms",bpo::value<uint32_t>(&benchmark_latency_ms)->default_value(0),"Delay added with tc netem to every packet on benchmark-net-device of each host during the benchmark (requires root)")
+    ("benchmark-net-device",bpo::value<string>(&benchmark_net_device)->default_value("lo"),"network device benchmark-latency-ms is applied to")
+    ("benchmark-sample-ms",bpo::value<uint32_t>(&benchmark_sample_ms)->default_value(100),"interval between polls of the get_info of every node during the benchmark")
+    ("benchmark-workload",bpo::value<bfs::path>(&benchmark_workload),"JSON file with the txn_test_gen_plugin start_workload request sent to benchmark-load-node when the benchmark starts. That node is configured with the plugin")
+    ("benchmark-load-node",bpo::value<string>(&benchmark_load_node),"node receiving the workload, the first non-bios node by default")
+    ("benchmark-report",bpo::value<bfs::path>(&benchmark_report_file)->default_value("benchmark.json"),"file the benchmark results are written to")
         ;
 }
 
@@ -1138,6 +1182,9 @@ launcher_def::write_config_file (tn_node_def &node) {
     }
     cfg << "plugin = eosio::producer_plugin\n";
   }
+  if (!benchmark_workload.empty() && node.name == load_node_name()) {
+    cfg << "plugin = eosio::txn_test_gen_plugin\n";
+  }
   if( instance.has_db ) {
     cfg << "plugin = eosio::mongo_db_plugin\n";
   }
@@ -1839,6 +1886,199 @@ launcher_def::ignite() {
 
  }
 
+string
+launcher_def::load_node_name () {
+  if (!benchmark_load_node.empty()) {
+    return benchmark_load_node;
+  }
+  for (const auto &n : network.nodes) {
+    if (n.first != "bios") {
+      return n.first;
+    }
+  }
+  return "bios";
+}
+
+void
+launcher_def::impair_network (bool enable) {
+  const string cmd = enable
+    ? "tc qdisc add dev " + benchmark_net_device + " root netem delay " + std::to_string(benchmark_latency_ms) + "ms"
+    : "tc qdisc del dev " + benchmark_net_device + " root";
+  for (auto &h : bindings) {
+    cerr << (enable ? "impairing " : "restoring ") << benchmark_net_device << " on " << h.host_name << endl;
+    do_command(h, h.host_name, {}, cmd);
+  }
+}
+
+// POST body to path of a node's http endpoint and return the JSON response, throws on failure
+fc::variant
+http_post (const string &host, uint16_t port, const string &path, const string &body = "{}") {
+  tcp::iostream stream;
+  stream.expires_after(std::chrono::seconds(5));
+  stream.connect(host, std::to_string(port));
+  FC_ASSERT(stream, "unable to connect to ${h}:${p}", ("h",host)("p",port));
+  stream << "POST " << path << " HTTP/1.1\r\n"
+         << "Host: " << host << ":" << port << "\r\n"
+         << "Content-Type: application/json\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Connection: close\r\n\r\n"
+         << body << std::flush;
+
+  string line;
+  std::getline(stream, line);
+  std::istringstream status_line(line);
+  string version;
+  unsigned status = 0;
+  status_line >> version >> status;
+  while (std::getline(stream, line) && line != "\r") {
+  }
+  const string response((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  FC_ASSERT(status >= 200 && status < 300, "${path} on ${h}:${p} returned ${s}: ${r}",
+            ("path",path)("h",host)("p",port)("s",status)("r",response));
+  return fc::json::from_string(response);
+}
+
+int64_t
+percentile (vector<int64_t> &values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  const size_t rank = std::min(values.size() - 1, size_t(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + rank, values.end());
+  return values[rank];
+}
+
+void
+launcher_def::benchmark () {
+  struct polled_node {
+    string                        host;
+    uint16_t                      port = 0;
+    bool                          polled = false;
+    map<uint32_t, fc::time_point> first_seen;
+    benchmark_node_report         report;
+  };
+  vector<polled_node> nodes;
+  for (auto &h : bindings) {
+    for (auto &inst : h.instances) {
+      if (inst.node && !inst.node->dont_start) {
+        polled_node n;
+        n.host = inst.host;
+        n.port = inst.http_port;
+        n.report.name = inst.node->name;
+        nodes.push_back(n);
+      }
+    }
+  }
+  if (nodes.empty()) {
+    cerr << "no started nodes to benchmark" << endl;
+    return;
+  }
+  // blocks are read from the load node, or the first node
+  auto reference = std::find_if(nodes.begin(), nodes.end(),
+                                [name = load_node_name()](const polled_node &n) { return n.report.name == name; });
+  if (reference == nodes.end()) {
+    reference = nodes.begin();
+  }
+
+  if (benchmark_latency_ms) {
+    impair_network(true);
+  }
+
+  benchmark_report report;
+  report.seconds = benchmark_seconds;
+  report.latency_ms = benchmark_latency_ms;
+  try {
+    if (!benchmark_workload.empty()) {
+      fc::mutable_variant_object spec(fc::json::from_file(benchmark_workload).get_object());
+      if (!spec.find("duration_seconds")) {
+        spec("duration_seconds", benchmark_seconds);
+      }
+      auto result = http_post(reference->host, reference->port, "/v1/txn_test_gen/start_workload", fc::json::to_string(spec));
+      cerr << "start_workload on " << reference->report.name << ": " << fc::json::to_string(result) << endl;
+    }
+
+    cerr << "benchmarking " << nodes.size() << " nodes for " << benchmark_seconds << " seconds" << endl;
+    const auto sample_interval = fc::milliseconds(std::max<uint32_t>(benchmark_sample_ms, 1));
+    const auto end = fc::time_point::now() + fc::seconds(benchmark_seconds);
+    while (fc::time_point::now() < end) {
+      const auto sample_start = fc::time_point::now();
+      for (auto &n : nodes) {
+        try {
+          const auto info = http_post(n.host, n.port, "/v1/chain/get_info");
+          const auto now = fc::time_point::now();
+          const uint32_t head = info["head_block_num"].as<uint32_t>();
+          // blocks the node already had when the benchmark started are not measured
+          if (n.polled) {
+            for (uint32_t b = n.report.head_block_num + 1; b <= head; ++b) {
+              n.first_seen.emplace(b, now);
+            }
+          }
+          n.polled = true;
+          n.report.head_block_num = std::max(n.report.head_block_num, head);
+          n.report.last_irreversible_block_num = info["last_irreversible_block_num"].as<uint32_t>();
+        } catch (...) {
+          ++n.report.failed_polls;
+        }
+      }
+      const auto elapsed = fc::time_point::now() - sample_start;
+      if (elapsed < sample_interval) {
+        std::this_thread::sleep_for(std::chrono::microseconds((sample_interval - elapsed).count()));
+      }
+    }
+
+    if (!benchmark_workload.empty()) {
+      try {
+        report.workload_status = http_post(reference->host, reference->port, "/v1/txn_test_gen/workload_status");
+      } catch (const fc::exception &e) {
+        cerr << "workload_status failed: " << e.to_string() << endl;
+      }
+    }
+
+    // the block timestamps and transactions come from the reference node
+    map<uint32_t, eosio::chain::block_timestamp_type> timestamps;
+    if (!reference->first_seen.empty()) {
+      report.first_block_num = reference->first_seen.begin()->first;
+      report.last_block_num = reference->first_seen.rbegin()->first;
+      for (uint32_t b = report.first_block_num; b <= report.last_block_num; ++b) {
+        const auto block = http_post(reference->host, reference->port, "/v1/chain/get_block",
+                                     "{\"block_num_or_id\":" + std::to_string(b) + "}");
+        timestamps[b] = block["timestamp"].as<eosio::chain::block_timestamp_type>();
+        report.transactions += block["transactions"].get_array().size();
+      }
+      report.blocks = timestamps.size();
+      const uint32_t slots = timestamps.rbegin()->second.slot - timestamps.begin()->second.slot + 1;
+      report.missed_slots = slots - report.blocks;
+      report.tps = report.transactions / (slots * eosio::chain::config::block_interval_ms / 1000.0);
+    }
+
+    for (auto &n : nodes) {
+      vector<int64_t> latencies;
+      for (const auto &seen : n.first_seen) {
+        const auto ts = timestamps.find(seen.first);
+        if (ts != timestamps.end()) {
+          latencies.push_back((seen.second - ts->second.to_time_point()).count() / 1000);
+        }
+      }
+      n.report.blocks_seen = latencies.size();
+      n.report.p50_block_latency_ms = percentile(latencies, 0.5);
+      n.report.p90_block_latency_ms = percentile(latencies, 0.9);
+      n.report.max_block_latency_ms = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+      report.nodes.push_back(n.report);
+    }
+  } catch (const fc::exception &e) {
+    cerr << "benchmark failed: " << e.to_detail_string() << endl;
+  }
+
+  if (benchmark_latency_ms) {
+    impair_network(false);
+  }
+
+  fc::json::save_to_file(report, benchmark_report_file, true);
+  cerr << "blocks " << report.first_block_num << " to " << report.last_block_num << ": " << report.blocks << " blocks, "
+       << report.missed_slots << " missed slots, " << report.transactions << " transactions, " << report.tps << " TPS\n"
+       << "benchmark results written to " << benchmark_report_file << endl;
+}
+
 void
 launcher_def::start_all (string &gts, launch_modes mode) {
   switch (mode) {
@@ -2055,6 +2295,9 @@ int main (int argc, char *argv[]) {
       top.generate();
       top.start_all(gts, mode);
       top.ignite();
+      if (top.benchmark_seconds) {
+        top.benchmark();
+      }
     }
   } catch (bpo::unknown_option &ex) {
     cerr << ex.what() << endl;
@@ -2100,3 +2343,9 @@ FC_REFLECT( server_identities, (producer) (nonprod) (db) (default_eosio_home) (s
 FC_REFLECT( node_rt_info, (remote)(pid_file)(kill_cmd) )
 
 FC_REFLECT( last_run_def, (running_nodes) )
+
+FC_REFLECT( benchmark_node_report, (name)(head_block_num)(last_irreversible_block_num)(blocks_seen)
+            (p50_block_latency_ms)(p90_block_latency_ms)(max_block_latency_ms)(failed_polls) )
+
+FC_REFLECT( benchmark_report, (seconds)(latency_ms)(first_block_num)(last_block_num)(blocks)(missed_slots)
+            (transactions)(tps)(workload_status)(nodes) )
@@ -5,6 +5,7 @@
 #include <eosio/net_plugin/net_plugin.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <eosio/version/version.hpp>
+#include <eosio/chain/async_appender.hpp>
 
 #include <fc/log/logger_config.hpp>
 #include <fc/log/appender.hpp>
@@ -60,6 +61,7 @@ void logging_conf_handler()
 
 void initialize_logging()
 {
+   fc::log_config::register_appender<eosio::chain::async_appender>( "async" );
    auto config_path = app().get_logging_conf();
    if(fc::exists(config_path))
      fc::configure_logging(config_path); // intentionally allowing exceptions to escape
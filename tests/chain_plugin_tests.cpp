@@ -98,6 +98,15 @@ BOOST_FIXTURE_TEST_CASE( get_block_with_invalid_abi, TESTER ) try {
    BOOST_TEST(block_str.find("Should Not Assert!") != std::string::npos);
    BOOST_TEST(block_str.find("011253686f756c64204e6f742041737365727421") != std::string::npos); //action data
 
+   // serialized one transaction at a time to the same json
+   BOOST_TEST(plugin.get_block_json(param) == json::to_string(plugin.get_block(param), fc::time_point::maximum()));
+   chain_apis::read_only::get_block_params ids_param{headnumstr, "ids"};
+   auto ids_block = fc::json::from_string(plugin.get_block_json(ids_param));
+   BOOST_REQUIRE_EQUAL(ids_block["transactions"].get_array().size(), 1u);
+   BOOST_TEST(ids_block["transactions"].get_array()[0].is_string());
+   chain_apis::read_only::get_block_params header_param{headnumstr, "none"};
+   BOOST_TEST(!fc::json::from_string(plugin.get_block_json(header_param)).get_object().contains("transactions"));
+
    // set an invalid abi (int8->xxxx)
    std::string abi2 = contracts::asserter_abi().data();
    auto pos = abi2.find("int8");
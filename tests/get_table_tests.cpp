@@ -670,4 +670,127 @@ BOOST_FIXTURE_TEST_CASE( get_table_next_key_test, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_table_next_key_test
 
+BOOST_FIXTURE_TEST_CASE( get_table_continuation_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   // primary keys 0..3, the secondary sec64 index holds 5 twice
+   for( uint64_t input : { 2, 5, 5, 7 } ) {
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+   }
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params params;
+   params.json = true;
+   params.code = N(test);
+   params.scope = "test";
+   params.table = N(numobjs);
+   params.key_type = "i64";
+   params.limit = 1;
+
+   auto walk = [&]() {
+      vector<uint64_t> keys;
+      params.continuation.clear();
+      for( ;; ) {
+         auto res = plugin.get_table_rows(params);
+         for( const auto& row : res.rows ) keys.push_back( row.get_object()["key"].as<uint64_t>() );
+         BOOST_REQUIRE_EQUAL( res.more, !res.next_continuation.empty() );
+         if( !res.more ) break;
+         params.continuation = res.next_continuation;
+      }
+      return keys;
+   };
+
+   params.index_position = "1";
+   BOOST_TEST( walk() == (vector<uint64_t>{ 0, 1, 2, 3 }), boost::test_tools::per_element() );
+   params.reverse = true;
+   BOOST_TEST( walk() == (vector<uint64_t>{ 3, 2, 1, 0 }), boost::test_tools::per_element() );
+
+   // next_key would start the third page at sec64 5 again, the continuation resumes at the exact row
+   params.index_position = "2";
+   params.reverse = false;
+   BOOST_TEST( walk() == (vector<uint64_t>{ 0, 1, 2, 3 }), boost::test_tools::per_element() );
+   params.reverse = true;
+   BOOST_TEST( walk() == (vector<uint64_t>{ 3, 2, 1, 0 }), boost::test_tools::per_element() );
+
+   // a continuation only fits the index it came from
+   params.reverse = false;
+   params.index_position = "1";
+   params.continuation.clear();
+   const auto primary_continuation = plugin.get_table_rows(params).next_continuation;
+   params.index_position = "2";
+   params.continuation = primary_continuation;
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+   params.continuation = "zz";
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), fc::exception );
+
+   // binary rows are returned without decoding
+   params.json = false;
+   params.index_position = "1";
+   params.continuation.clear();
+   params.limit = 10;
+   auto res = plugin.get_table_rows(params);
+   BOOST_REQUIRE_EQUAL( res.rows.size(), 4u );
+   BOOST_TEST( res.rows[0].is_string() );
+
+   // the packed form holds the same rows as bytes
+   params.show_payer = true;
+   const auto packed = fc::raw::unpack<chain_apis::read_only::get_table_rows_packed_result>( plugin.get_table_rows_packed(params) );
+   params.show_payer.reset();
+   BOOST_REQUIRE_EQUAL( packed.rows.size(), 4u );
+   BOOST_REQUIRE_EQUAL( packed.payers.size(), 4u );
+   BOOST_TEST( packed.rows[0] == res.rows[0].as<bytes>() );
+   BOOST_TEST( packed.payers[0] == N(test) );
+   BOOST_TEST( !packed.more );
+
+   // get_table_by_scope resumes at the exact (scope, table)
+   push_action(N(test), N(addhashobj), N(test), mutable_variant_object()("hashinput", "firstinput"));
+   produce_block();
+   chain_apis::read_only::get_table_by_scope_params scope_params;
+   scope_params.code = N(test);
+   scope_params.limit = 1;
+   vector<name> tables;
+   for( ;; ) {
+      auto scope_res = plugin.get_table_by_scope(scope_params);
+      for( const auto& row : scope_res.rows ) tables.push_back( row.table );
+      if( scope_res.next_continuation.empty() ) break;
+      scope_params.continuation = scope_res.next_continuation;
+   }
+   BOOST_REQUIRE_EQUAL( std::count( tables.begin(), tables.end(), N(numobjs) ), 1 );
+   BOOST_REQUIRE_EQUAL( std::count( tables.begin(), tables.end(), N(hashobjs) ), 1 );
+
+} FC_LOG_AND_RETHROW() /// get_table_continuation_test
+
+BOOST_FIXTURE_TEST_CASE( batch_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+   push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", 2));
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only::batch_params calls = {
+      { "get_table_rows", mutable_variant_object()("json", true)("code", "test")("scope", "test")("table", "numobjs") },
+      { "get_abi",        mutable_variant_object()("account_name", "test") },
+      { "get_block",      mutable_variant_object()("block_num_or_id", "1") },
+      { "get_account",    mutable_variant_object()("account_name", "nosuchacct") }
+   };
+   auto results = plugin.batch( calls );
+   BOOST_REQUIRE_EQUAL( results.size(), calls.size() );
+   BOOST_TEST( results[0]["result"]["rows"][size_t(0)]["sec64"].as<uint64_t>() == 2u );
+   BOOST_TEST( results[1]["result"]["account_name"].as_string() == "test" );
+   // calls outside of the chain state and failing calls only fail their own entry
+   BOOST_TEST( results[2].get_object().contains( "error" ) );
+   BOOST_TEST( results[3].get_object().contains( "error" ) );
+
+   BOOST_CHECK_THROW( plugin.batch( chain_apis::read_only::batch_params( 101, calls[1] ) ), chain::invalid_http_request );
+
+} FC_LOG_AND_RETHROW() /// batch_test
+
 BOOST_AUTO_TEST_SUITE_END()
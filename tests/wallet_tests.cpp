@@ -262,6 +262,61 @@ BOOST_AUTO_TEST_CASE(wallet_manager_create_test) {
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(wallet_manager_key_index_test)
+{ try {
+   using namespace eosio::wallet;
+
+   if (fc::exists("test.wallet")) fc::remove("test.wallet");
+   if (fc::exists("test2.wallet")) fc::remove("test2.wallet");
+
+   constexpr auto key1 = "5JktVNHnRX48BUdtewU7N1CyL4Z886c42x7wYW7XhNWkDQRhdcS";
+   constexpr auto key2 = "5Ju5RTcVDo35ndtzHioPMgebvBM6LkJ6tvuU6LTNQv8yaz3ggZr";
+   const auto pub1 = private_key_type(std::string(key1)).get_public_key();
+   const auto pub2 = private_key_type(std::string(key2)).get_public_key();
+   const chain::digest_type digest = chain::digest_type::hash(std::string("key index"));
+
+   wallet_manager wm;
+   auto pw = wm.create("test");
+   auto pw2 = wm.create("test2");
+   // key1 is held by both wallets, key2 only by test2
+   wm.import_key("test2", key1);
+   wm.import_key("test2", key2);
+   wm.import_key("test", key1);
+   BOOST_CHECK_EQUAL(2u, wm.get_public_keys().size());
+   BOOST_CHECK(wm.sign_digest(digest, pub1) == private_key_type(std::string(key1)).sign(digest));
+
+   // key1 is still signed for by test2 once test is locked
+   wm.lock("test");
+   BOOST_CHECK_EQUAL(2u, wm.get_public_keys().size());
+   BOOST_CHECK_NO_THROW(wm.sign_digest(digest, pub1));
+
+   wm.lock("test2");
+   BOOST_CHECK_THROW(wm.get_public_keys(), wallet_locked_exception);
+   BOOST_CHECK_THROW(wm.sign_digest(digest, pub1), chain::wallet_missing_pub_key_exception);
+
+   wm.unlock("test", pw);
+   BOOST_CHECK_EQUAL(1u, wm.get_public_keys().size());
+   BOOST_CHECK_NO_THROW(wm.sign_digest(digest, pub1));
+   BOOST_CHECK_THROW(wm.sign_digest(digest, pub2), chain::wallet_missing_pub_key_exception);
+
+   chain::signed_transaction trx;
+   auto chain_id = genesis_state().compute_chain_id();
+   flat_set<public_key_type> pubkeys{pub1, pub2};
+   BOOST_CHECK_THROW(wm.sign_transaction(trx, pubkeys, chain_id), chain::wallet_missing_pub_key_exception);
+   wm.unlock("test2", pw2);
+   trx = wm.sign_transaction(trx, pubkeys, chain_id);
+   BOOST_CHECK_EQUAL(2u, trx.signatures.size());
+
+   // removing key1 from test leaves test2 signing with it
+   wm.remove_key("test", pw, string(pub1));
+   BOOST_CHECK_EQUAL(2u, wm.get_public_keys().size());
+   wm.lock("test2");
+   BOOST_CHECK_EQUAL(0u, wm.get_public_keys().size());
+
+   fc::remove("test.wallet");
+   fc::remove("test2.wallet");
+} FC_LOG_AND_RETHROW() }
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -51,6 +51,7 @@ void verify_round_trip_conversion( const abi_serializer& abis, const type_name&
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes), hex);
    auto var2 = abis.binary_to_variant(type, bytes, max_serialization_time);
    BOOST_REQUIRE_EQUAL(fc::json::to_string(var2, fc::time_point::now() + max_serialization_time), expected_json);
+   BOOST_REQUIRE_EQUAL(abis.binary_to_json(type, bytes, max_serialization_time), expected_json);
    auto bytes2 = abis.variant_to_binary(type, var2, max_serialization_time);
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes2), hex);
 }
@@ -2787,4 +2788,146 @@ BOOST_AUTO_TEST_CASE(serialize_optional_struct_type)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(compiled_types_round_trip)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [
+         {"new_type_name": "node_list", "type": "node[]"},
+         {"new_type_name": "count", "type": "uint16"}
+      ],
+      "structs": [
+         {"name": "base", "base": "", "fields": [
+            {"name": "id", "type": "count"}
+         ]},
+         {"name": "node", "base": "base", "fields": [
+            {"name": "value", "type": "v"},
+            {"name": "children", "type": "node_list"},
+            {"name": "extra", "type": "string$"}
+         ]}
+      ],
+      "variants": [
+         {"name": "v", "types": ["int8", "count", "node?"]}
+      ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+
+      // recursive types through typedefs, arrays, optionals, variants and base structs
+      verify_round_trip_conversion(abis, "node",
+         R"({"id":1,"value":["node?",{"id":2,"value":["count",3],"children":[],"extra":"x"}],"children":[{"id":4,"value":["int8",5],"children":[],"extra":"z"}],"extra":"y"})",
+         "010002010200010300000178010400000500017a0179");
+
+      // types not named by the abi still go through the uncompiled lookup
+      verify_round_trip_conversion(abis, "count[]", R"([1,2])", "0201000200");
+      verify_round_trip_conversion(abis, "node_list?", R"(null)", "00");
+
+      // copies refer to their own compiled types
+      optional<abi_serializer> copy;
+      {
+         abi_serializer original( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+         copy.emplace( original );
+      }
+      verify_round_trip_conversion(*copy, "base", R"({"id":7})", "0700");
+
+      // a specialized built-in takes precedence over the abi type of the same name
+      abis.add_specialized_unpack_pack( "base",
+         std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
+            []( fc::datastream<const char*>& stream, bool is_array, bool is_optional ) -> fc::variant {
+               uint8_t v;
+               fc::raw::unpack( stream, v );
+               return fc::variant( v );
+            },
+            []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool is_optional ) {
+               fc::raw::pack( ds, var.as<uint8_t>() );
+            }
+         ) );
+      verify_round_trip_conversion(abis, "base", R"(9)", "09");
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(binary_to_json_matches_variant)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [
+         {"new_type_name": "amount", "type": "int64"}
+      ],
+      "structs": [
+         {"name": "base", "base": "", "fields": [
+            {"name": "owner", "type": "name"},
+            {"name": "flag", "type": "bool"}
+         ]},
+         {"name": "row", "base": "base", "fields": [
+            {"name": "\"quoted\"", "type": "uint64"},
+            {"name": "balance", "type": "amount"},
+            {"name": "small", "type": "int8[]"},
+            {"name": "memo", "type": "string?"},
+            {"name": "ratio", "type": "float64"},
+            {"name": "tag", "type": "v"},
+            {"name": "seq", "type": "varint32"}
+         ]},
+         {"name": "dup", "base": "base", "fields": [
+            {"name": "owner", "type": "uint32"}
+         ]},
+         {"name": "empty", "base": "", "fields": []},
+         {"name": "holder", "base": "", "fields": [
+            {"name": "items", "type": "base?[]"}
+         ]}
+      ],
+      "variants": [
+         {"name": "v", "types": ["uint32", "base"]}
+      ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+
+      auto check = [&]( const type_name& type, const std::string& json ) {
+         auto bin = abis.variant_to_binary( type, fc::json::from_string(json), max_serialization_time );
+         const auto expected = fc::json::to_string( abis.binary_to_variant( type, bin, max_serialization_time ), fc::time_point::maximum() );
+         BOOST_REQUIRE_EQUAL( abis.binary_to_json( type, bin, max_serialization_time ), expected );
+
+         fc::datastream<const char*> ds( bin.data(), bin.size() );
+         std::string out = "[";
+         abis.binary_to_json( type, ds, out, max_serialization_time );
+         BOOST_REQUIRE_EQUAL( out, "[" + expected );
+         BOOST_REQUIRE_EQUAL( ds.remaining(), 0u );
+      };
+
+      // integers beyond 32 bits are quoted by fc::json
+      check( "row", R"({"owner":"alice","flag":1,"\"quoted\"":"18446744073709551615","balance":"-4294967296","small":[-1,2],"memo":null,"ratio":"1.5","tag":["base",{"owner":"bob","flag":0}],"seq":-5})" );
+      check( "row", R"({"owner":"","flag":0,"\"quoted\"":4294967295,"balance":-4294967295,"small":[],"memo":"a\nb","ratio":"0","tag":["uint32",7],"seq":0})" );
+      // a repeated field name keeps the value written last
+      check( "dup", R"({"owner":5,"flag":1})" );
+      check( "amount[]", R"(["4294967296",1])" );
+
+      // same errors as binary_to_variant
+      BOOST_CHECK_THROW( abis.binary_to_json( "empty", bytes(), max_serialization_time ), unpack_exception );
+      auto absent = abis.variant_to_binary( "holder", fc::json::from_string(R"({"items":[null]})"), max_serialization_time );
+      BOOST_CHECK_THROW( abis.binary_to_variant( "holder", absent, max_serialization_time ), unpack_exception );
+      BOOST_CHECK_THROW( abis.binary_to_json( "holder", absent, max_serialization_time ), unpack_exception );
+      auto truncated = abis.variant_to_binary( "base", fc::json::from_string(R"({"owner":"alice","flag":1})"), max_serialization_time );
+      truncated.pop_back();
+      BOOST_CHECK_THROW( abis.binary_to_json( "base", truncated, max_serialization_time ), unpack_exception );
+
+      // specialized built-ins are written through their unpack function
+      abis.add_specialized_unpack_pack( "name",
+         std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
+            []( fc::datastream<const char*>& stream, bool is_array, bool is_optional ) -> fc::variant {
+               uint64_t v;
+               fc::raw::unpack( stream, v );
+               return fc::variant( v );
+            },
+            []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool is_optional ) {
+               fc::raw::pack( ds, var.as<uint64_t>() );
+            }
+         ) );
+      check( "base", R"({"owner":42,"flag":1})" );
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,8 @@
 
 #include <contracts.hpp>
 
+#include "test_wasts.hpp"
+
 #define DUMMY_ACTION_DEFAULT_A 0x45
 #define DUMMY_ACTION_DEFAULT_B 0xab11cd1244556677
 #define DUMMY_ACTION_DEFAULT_C 0x7451ae12
@@ -1662,6 +1664,37 @@ BOOST_FIXTURE_TEST_CASE(db_tests, TESTER) { try {
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
 
+/*************************************************************************************
+ * db_lookup_cache_tests test case
+ *************************************************************************************/
+BOOST_FIXTURE_TEST_CASE(db_lookup_cache_tests, TESTER) { try {
+   produce_blocks(2);
+   create_account( N(tablecache) );
+   produce_blocks(1);
+   set_code( N(tablecache), table_lookup_cache_wast );
+   produce_blocks(1);
+
+   // the table lookups and rows of an apply_context are cached, the contract asserts they follow its stores and removals
+   for( int i = 0; i < 2; ++i ) {
+      signed_transaction trx;
+      action act;
+      act.account = N(tablecache);
+      act.name = N();
+      act.authorization = vector<permission_level>{{N(tablecache),config::active_name}};
+      trx.actions.push_back( act );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(tablecache), "active" ), control->get_chain_id() );
+      push_transaction( trx );
+      produce_blocks(1);
+      BOOST_REQUIRE_EQUAL( true, chain_has_transaction(trx.id()) );
+
+      BOOST_REQUIRE( control->db().find<table_id_object, by_code_scope_table>(
+                        boost::make_tuple( N(tablecache), N(tablecache), N(tbl) ) ) == nullptr );
+   }
+
+   BOOST_REQUIRE_EQUAL( validate(), true );
+} FC_LOG_AND_RETHROW() }
+
 /*************************************************************************************
  * multi_index_tests test case
  *************************************************************************************/
@@ -2786,4 +2819,52 @@ BOOST_FIXTURE_TEST_CASE(action_ordinal_failtest3, TESTER) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+/*************************************************************************************
+ * read_only_transaction_tests test case
+ *************************************************************************************/
+BOOST_FIXTURE_TEST_CASE(read_only_transaction_tests, TESTER) { try {
+   produce_blocks(2);
+   create_account( N(testapi) );
+   create_account( N(testapi2) );
+   produce_blocks(10);
+   set_code( N(testapi), contracts::test_api_wasm() );
+   set_code( N(testapi2), contracts::test_api_db_wasm() );
+   set_abi(  N(testapi2), contracts::test_api_db_abi().data() );
+   produce_blocks(1);
+
+   auto push_read_only = [&]( vector<action> actions ) {
+      signed_transaction trx;
+      trx.actions = std::move( actions );
+      set_transaction_headers( trx );
+      return control->push_read_only_transaction( transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::input ),
+                                                  fc::time_point::maximum() );
+   };
+   // no signature is needed and the trace of a read-only call is returned
+   auto trace = push_read_only( { action( vector<permission_level>{{N(testapi), config::active_name}},
+                                          test_api_action<TEST_METHOD("test_print", "test_prints")>{} ) } );
+   BOOST_REQUIRE( !trace->except );
+   BOOST_REQUIRE_EQUAL( trace->action_traces.size(), 1u );
+   BOOST_CHECK_EQUAL( trace->action_traces.front().console, "abcefg" );
+   BOOST_CHECK( !trace->receipt );
+
+   // contract table writes are rejected
+   trace = push_read_only( { action( vector<permission_level>{{N(testapi2), config::active_name}}, N(testapi2), N(pg), bytes() ) } );
+   BOOST_REQUIRE( trace->except );
+   BOOST_CHECK_EQUAL( trace->except->code(), read_only_trx_write_exception::code_value );
+
+   // so are native actions
+   trace = push_read_only( { action( vector<permission_level>{{config::system_account_name, config::active_name}},
+                                     newaccount{ config::system_account_name, N(rotester),
+                                                 authority( get_public_key( N(rotester), "owner" ) ),
+                                                 authority( get_public_key( N(rotester), "active" ) ) } ) } );
+   BOOST_REQUIRE( trace->except );
+   BOOST_CHECK_EQUAL( trace->except->code(), read_only_trx_write_exception::code_value );
+   BOOST_CHECK( !control->db().find<account_object, by_name>( N(rotester) ) );
+
+   // the writes of a regular transaction still go through
+   push_action( N(testapi2), N(pg), N(testapi2), mutable_variant_object() );
+
+   BOOST_REQUIRE_EQUAL( validate(), true );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
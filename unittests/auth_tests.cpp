@@ -417,6 +417,8 @@ try {
    };
 
    create_acc(acc2);
+   // usage billed while building a block is written to the database when the block is finalized
+   chain.produce_block();
 
    const auto &usage = db.get<resource_usage_object,by_owner>(acc1);
 
@@ -426,7 +428,6 @@ try {
    BOOST_TEST(usage.net_usage.average() > 0U);
    BOOST_REQUIRE_EQUAL(usage.cpu_usage.average(), usage2.cpu_usage.average());
    BOOST_REQUIRE_EQUAL(usage.net_usage.average(), usage2.net_usage.average());
-   chain.produce_block();
 
 } FC_LOG_AND_RETHROW() }
 
@@ -480,6 +481,36 @@ try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( authority_cache ) { try {
+   TESTER chain;
+
+   chain.create_account(N(alice));
+   chain.produce_block();
+
+   const auto& am = chain.control->get_authorization_manager();
+   const vector<action> acts{ action( {permission_level{N(alice), config::active_name}}, N(eosio), N(reqauth), bytes() ) };
+   const auto old_key = chain.get_public_key(N(alice), "active");
+   const auto new_key = chain.get_public_key(N(alice), "new");
+
+   am.check_authorization(acts, {old_key});
+   am.check_authorization(acts, {old_key});
+
+   // a cached result still reports the keys that were not used
+   am.check_authorization(acts, {old_key, new_key}, {}, fc::microseconds(0), std::function<void()>(), true);
+   BOOST_REQUIRE_THROW( am.check_authorization(acts, {old_key, new_key}), tx_irrelevant_sig );
+
+   // updateauth invalidates the cache
+   chain.set_authority(N(alice), config::active_name, authority(new_key));
+   BOOST_REQUIRE_THROW( am.check_authorization(acts, {old_key}), unsatisfied_authorization );
+   am.check_authorization(acts, {new_key});
+
+   // so does undoing the permission change
+   chain.control->abort_block();
+   BOOST_REQUIRE_THROW( am.check_authorization(acts, {new_key}), unsatisfied_authorization );
+   am.check_authorization(acts, {old_key});
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( linkauth_special ) { try {
    TESTER chain;
 
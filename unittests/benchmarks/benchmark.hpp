@@ -0,0 +1,81 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace benchmark {
+
+   /// one execution of the measured code; state it needs is built by the setup function and captured
+   using operation = std::function<void()>;
+   using setup_function = std::function<operation()>;
+
+   struct benchmark_case {
+      std::string    name;
+      setup_function setup;
+   };
+
+   struct benchmark_result {
+      std::string name;
+      uint64_t    iterations = 0;   ///< per repetition
+      uint32_t    repetitions = 0;
+      double      min_ns = 0;       ///< per operation, over the repetitions
+      double      median_ns = 0;
+      double      mean_ns = 0;
+      double      max_ns = 0;
+      std::map<std::string, double> counters; ///< other measurements of the case, see set_counter
+   };
+
+   std::vector<benchmark_case>& registered_cases();
+
+   struct registrar {
+      registrar( std::string name, setup_function setup ) {
+         registered_cases().push_back( {std::move(name), std::move(setup)} );
+      }
+   };
+
+   /// makes cases depending on the command line, called once the options are parsed
+   using case_generator = std::function<std::vector<benchmark_case>()>;
+   std::vector<case_generator>& registered_generators();
+
+   struct generator_registrar {
+      explicit generator_registrar( case_generator g ) {
+         registered_generators().push_back( std::move(g) );
+      }
+   };
+
+   /// records a measurement other than the time per operation, e.g. memory, for the running case; the last value wins
+   void set_counter( const std::string& name, double value );
+
+   /// a contract and action given with --benchmark-wasm=<wasm file>,<abi file>,<action>,<json action data>
+   struct user_contract {
+      std::string wasm_file;
+      std::string abi_file;
+      std::string action;
+      std::string data;
+   };
+   const std::vector<user_contract>& user_contracts();
+
+} } // eosio::benchmark
+
+FC_REFLECT( eosio::benchmark::benchmark_result, (name)(iterations)(repetitions)(min_ns)(median_ns)(mean_ns)(max_ns)(counters) )
+
+/**
+ * Defines a benchmark; the body does the setup and returns the operation to time, e.g.
+ *
+ *    EOSIO_BENCHMARK(merkle_1000) {
+ *       auto ids = std::make_shared<vector<digest_type>>( ... );
+ *       return [ids]() { merkle( *ids ); };
+ *    }
+ */
+#define EOSIO_BENCHMARK(NAME) \
+   static ::eosio::benchmark::operation BOOST_PP_CAT(benchmark_setup_, NAME)(); \
+   static ::eosio::benchmark::registrar BOOST_PP_CAT(benchmark_registrar_, NAME){ BOOST_PP_STRINGIZE(NAME), &BOOST_PP_CAT(benchmark_setup_, NAME) }; \
+   static ::eosio::benchmark::operation BOOST_PP_CAT(benchmark_setup_, NAME)()
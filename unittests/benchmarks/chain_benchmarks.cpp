@@ -0,0 +1,313 @@
+#include "benchmark.hpp"
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/authorization_manager.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/incremental_merkle.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/platform_timer.hpp>
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
+#endif
+#include <eosio/testing/tester.hpp>
+
+#include <fc/crypto/sha1.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/variant_object.hpp>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+   // pending transactions are put in a block every transactions_per_block operations to stay below the block limits
+   constexpr uint64_t transactions_per_block = 100;
+
+   std::shared_ptr<tester> make_token_tester() {
+      auto t = std::make_shared<tester>();
+      t->create_accounts( { N(alice), N(bob), N(eosio.token) } );
+      t->set_code( N(eosio.token), contracts::eosio_token_wasm() );
+      t->set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+      t->push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                      ("issuer", "alice")("maximum_supply", "1000000000.0000 TKN") );
+      t->push_action( N(eosio.token), N(issue), N(alice), mvo()
+                      ("to", "alice")("quantity", "1000000000.0000 TKN")("memo", "") );
+      t->produce_block();
+      return t;
+   }
+
+   abi_serializer token_abi_serializer() {
+      return abi_serializer( fc::json::from_string( contracts::eosio_token_abi().data() ).as<abi_def>(),
+                             base_tester::abi_serializer_max_time );
+   }
+
+   /// pushes one action per operation, memo or value made unique by the counter
+   operation push_per_operation( std::shared_ptr<tester> t, account_name contract, action_name act, account_name actor,
+                                 std::function<fc::variant_object(uint64_t)> data ) {
+      auto counter = std::make_shared<uint64_t>( 0 );
+      return [t, contract, act, actor, data, counter]() {
+         t->push_action( contract, act, actor, data( (*counter)++ ) );
+         if( *counter % transactions_per_block == 0 )
+            t->produce_block();
+      };
+   }
+}
+
+/// end to end: builds, signs and pushes a transfer, including the wasm execution
+EOSIO_BENCHMARK(push_token_transfer) {
+   auto t = make_token_tester();
+   return push_per_operation( t, N(eosio.token), N(transfer), N(alice), []( uint64_t i ) {
+      return fc::variant_object( mvo()("from", "alice")("to", "bob")("quantity", "0.0001 TKN")("memo", std::to_string(i)) );
+   } );
+}
+
+/// multi_index emplace of a row with four secondary indices, mostly db_*_i64 and db_idx* intrinsics
+EOSIO_BENCHMARK(db_multi_index_emplace) {
+   auto t = std::make_shared<tester>();
+   t->create_account( N(tbl) );
+   t->set_code( N(tbl), contracts::get_table_test_wasm() );
+   t->set_abi( N(tbl), contracts::get_table_test_abi().data() );
+   t->produce_block();
+   return push_per_operation( t, N(tbl), N(addnumobj), N(tbl), []( uint64_t i ) {
+      return fc::variant_object( mvo()("input", i) );
+   } );
+}
+
+/// multi_index find and modify of one existing row
+EOSIO_BENCHMARK(db_multi_index_modify) {
+   auto t = std::make_shared<tester>();
+   t->create_account( N(snap) );
+   t->set_code( N(snap), contracts::snapshot_test_wasm() );
+   t->set_abi( N(snap), contracts::snapshot_test_abi().data() );
+   t->produce_block();
+   return push_per_operation( t, N(snap), N(increment), N(snap), []( uint64_t i ) {
+      return fc::variant_object( mvo()("value", 1 + i % 1000) );
+   } );
+}
+
+EOSIO_BENCHMARK(abi_variant_to_binary_transfer) {
+   auto abis = std::make_shared<abi_serializer>( token_abi_serializer() );
+   auto data = std::make_shared<fc::variant>( mvo()("from", "alice")("to", "bob")("quantity", "1.0000 TKN")("memo", "benchmark") );
+   return [abis, data]() {
+      abis->variant_to_binary( "transfer", *data, base_tester::abi_serializer_max_time );
+   };
+}
+
+EOSIO_BENCHMARK(abi_binary_to_variant_transfer) {
+   auto abis = std::make_shared<abi_serializer>( token_abi_serializer() );
+   auto bin = std::make_shared<bytes>( abis->variant_to_binary( "transfer",
+                                           mvo()("from", "alice")("to", "bob")("quantity", "1.0000 TKN")("memo", "benchmark"),
+                                           base_tester::abi_serializer_max_time ) );
+   return [abis, bin]() {
+      abis->binary_to_variant( "transfer", *bin, base_tester::abi_serializer_max_time );
+   };
+}
+
+namespace {
+   /// 4096 sorted keys, half of them sharing their high word with another key as (owner, id) pairs do
+   std::shared_ptr<vector<key256_t>> sorted_key256s() {
+      auto keys = std::make_shared<vector<key256_t>>();
+      for( uint32_t i = 0; i < 2048; ++i ) {
+         const auto h = fc::sha256::hash( i );
+         const uint128_t high = (uint128_t( h._hash[0] ) << 64) | h._hash[1];
+         const uint128_t low  = (uint128_t( h._hash[2] ) << 64) | h._hash[3];
+         keys->push_back( key256_t{ high, low } );
+         keys->push_back( key256_t{ high, low + 1 } );
+      }
+      std::sort( keys->begin(), keys->end() );
+      return keys;
+   }
+
+   /// a lower_bound of every key, as the ordered index does for db_idx256_lowerbound and find
+   template<typename Less>
+   operation key256_lower_bounds() {
+      auto keys = sorted_key256s();
+      auto sink = std::make_shared<size_t>( 0 );
+      return [keys, sink]() {
+         for( const auto& k : *keys )
+            *sink += std::lower_bound( keys->begin(), keys->end(), k, Less() ) - keys->begin();
+      };
+   }
+}
+
+/// 4096 lower bounds among 4096 idx256 keys with the generic comparator of std::array
+EOSIO_BENCHMARK(key256_lower_bound_std_less) {
+   return key256_lower_bounds<std::less<key256_t>>();
+}
+
+/// 4096 lower bounds among 4096 idx256 keys with the comparator of index256_index
+EOSIO_BENCHMARK(key256_lower_bound_key256_less) {
+   return key256_lower_bounds<key256_less>();
+}
+
+/// the transaction merkle root of a block with 1000 transactions
+EOSIO_BENCHMARK(merkle_1000) {
+   auto ids = std::make_shared<vector<digest_type>>();
+   for( uint32_t i = 0; i < 1000; ++i )
+      ids->push_back( digest_type::hash( i ) );
+   return [ids]() {
+      merkle( *ids );
+   };
+}
+
+/// the block id append done for every block
+EOSIO_BENCHMARK(incremental_merkle_append) {
+   auto m = std::make_shared<incremental_merkle>();
+   auto counter = std::make_shared<uint64_t>( 0 );
+   return [m, counter]() {
+      m->append( digest_type::hash( (*counter)++ ) );
+   };
+}
+
+namespace {
+   /// a block of 100 token transfers
+   signed_block_ptr transfer_block() {
+      auto t = make_token_tester();
+      for( uint64_t i = 0; i < 100; ++i ) {
+         t->push_action( N(eosio.token), N(transfer), N(alice), mvo()
+                         ("from", "alice")("to", "bob")("quantity", "0.0001 TKN")("memo", std::to_string(i)) );
+      }
+      return t->produce_block();
+   }
+}
+
+/// a block of 100 transfers packed, as the block log, net_plugin and state history do; reports bytes, the packed size
+EOSIO_BENCHMARK(signed_block_pack_100) {
+   auto b = transfer_block();
+   benchmark::set_counter( "bytes", fc::raw::pack_size( *b ) );
+   return [b]() {
+      fc::raw::pack( *b );
+   };
+}
+
+/// the size pass pack() makes before packing, to allocate the result once
+EOSIO_BENCHMARK(signed_block_pack_size_100) {
+   auto b = transfer_block();
+   auto sink = std::make_shared<size_t>( 0 );
+   return [b, sink]() {
+      *sink += fc::raw::pack_size( *b );
+   };
+}
+
+/// a block of 100 transfers unpacked, as blocks read from the block log or received from peers are
+EOSIO_BENCHMARK(signed_block_unpack_100) {
+   auto packed = std::make_shared<bytes>( fc::raw::pack( *transfer_block() ) );
+   return [packed]() {
+      fc::raw::unpack<signed_block>( *packed );
+   };
+}
+
+/// 1000 digests packed and unpacked, a vector of trivially copyable elements as in incremental merkles and snapshots
+EOSIO_BENCHMARK(digest_vector_pack_unpack_1000) {
+   auto ids = std::make_shared<vector<digest_type>>();
+   for( uint32_t i = 0; i < 1000; ++i )
+      ids->push_back( digest_type::hash( i ) );
+   return [ids]() {
+      fc::raw::unpack<vector<digest_type>>( fc::raw::pack( *ids ) );
+   };
+}
+
+/// 1000 idx256 keys packed and unpacked, std::array<uint128_t,2> elements as in snapshots of index256 tables
+EOSIO_BENCHMARK(key256_vector_pack_unpack_1000) {
+   auto keys = sorted_key256s();
+   keys->resize( 1000 );
+   return [keys]() {
+      fc::raw::unpack<vector<key256_t>>( fc::raw::pack( *keys ) );
+   };
+}
+
+namespace {
+   /// hashing as the crypto_api intrinsics do, in blocks of hashing_checktime_block_size bytes with a checktime between them
+   template<class Encoder>
+   operation encode_in_checktime_blocks( size_t size ) {
+      auto data = std::make_shared<vector<char>>( size, 'x' );
+      benchmark::set_counter( "bytes", size );
+      return [data]() {
+         Encoder e;
+         const char* p = data->data();
+         size_t left = data->size();
+         const size_t bs = config::hashing_checktime_block_size;
+         for( ; left > bs; p += bs, left -= bs )
+            e.write( p, bs );
+         e.write( p, left );
+         e.result();
+      };
+   }
+}
+
+/**
+ * sha256 and sha1 of short and long inputs through the fc encoders used by crypto_api. OpenSSL picks the SHA
+ * extensions at runtime; on x86 running the cases again with OPENSSL_ia32cap=":~0x20000000" masks SHA-NI, which
+ * compares the accelerated code with the plain one on the same machine.
+ */
+EOSIO_BENCHMARK(crypto_sha256_encode_64) {
+   return encode_in_checktime_blocks<fc::sha256::encoder>( 64 );
+}
+
+EOSIO_BENCHMARK(crypto_sha256_encode_1mib) {
+   return encode_in_checktime_blocks<fc::sha256::encoder>( 1024*1024 );
+}
+
+EOSIO_BENCHMARK(crypto_sha1_encode_64) {
+   return encode_in_checktime_blocks<fc::sha1::encoder>( 64 );
+}
+
+EOSIO_BENCHMARK(crypto_sha1_encode_1mib) {
+   return encode_in_checktime_blocks<fc::sha1::encoder>( 1024*1024 );
+}
+
+/// a 2 of 3 key authority satisfied by two keys
+EOSIO_BENCHMARK(check_authorization_2_of_3) {
+   auto t = std::make_shared<tester>();
+   t->create_account( N(alice) );
+   vector<key_weight> keys = { {base_tester::get_public_key( N(alice), "k1" ), 1},
+                               {base_tester::get_public_key( N(alice), "k2" ), 1},
+                               {base_tester::get_public_key( N(alice), "k3" ), 1} };
+   std::sort( keys.begin(), keys.end(), []( const key_weight& a, const key_weight& b ) { return a.key < b.key; } );
+   t->set_authority( N(alice), config::active_name, authority( 2, keys, {} ), config::owner_name );
+   t->produce_block();
+
+   auto actions = std::make_shared<vector<action>>();
+   actions->emplace_back( vector<permission_level>{{N(alice), config::active_name}}, N(alice), N(nop), bytes() );
+   auto provided = std::make_shared<flat_set<public_key_type>>(
+         flat_set<public_key_type>{ keys[0].key, keys[2].key } );
+   return [t, actions, provided]() {
+      t->control->get_authorization_manager().check_authorization( *actions, *provided );
+   };
+}
+
+/// public key recovery from a K1 signature; transactions go through signature_recovery_cache, this is a miss
+EOSIO_BENCHMARK(recover_k1_signature) {
+   auto key = base_tester::get_private_key( N(alice), "active" );
+   auto digest = digest_type::hash( std::string( "benchmark" ) );
+   auto sig = key.sign( digest );
+   return [digest, sig]() {
+      public_key_type( sig, digest );
+   };
+}
+
+/// arming and disarming the deadline timer of the thread, done once per transaction
+EOSIO_BENCHMARK(platform_timer_arm_disarm) {
+   return []() {
+      auto& timer = platform_timer::current_thread_timer();
+      timer.start( fc::time_point::now() + fc::milliseconds(30) );
+      timer.stop();
+   };
+}
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+/// EOS VM OC linear memory reset before an action of a contract starting with 4MiB of memory which writes to a few pages
+EOSIO_BENCHMARK(eosvmoc_memory_reset_4mib_sparse) {
+   auto mem = std::make_shared<eosvmoc::memory>();
+   return [mem]() {
+      constexpr uint64_t pages = 64;
+      mem->reset( pages );
+      for( uint64_t p = 0; p < pages; p += 16 )
+         mem->full_page_memory_base()[p*64*1024] = 1;
+      mem->mark_dirty( pages );
+   };
+}
+#endif
@@ -0,0 +1,165 @@
+#include "benchmark.hpp"
+
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace eosio { namespace benchmark {
+
+   std::vector<benchmark_case>& registered_cases() {
+      static std::vector<benchmark_case> cases;
+      return cases;
+   }
+
+   std::vector<case_generator>& registered_generators() {
+      static std::vector<case_generator> generators;
+      return generators;
+   }
+
+   namespace {
+      uint64_t                      min_time_ns = 200'000'000;
+      uint32_t                      repetitions = 5;
+      std::string                   output_file;
+      std::vector<benchmark_result> results;
+      std::vector<benchmark_case>   generated_cases;
+      std::vector<user_contract>    contracts;
+      std::map<std::string, double> counters; ///< of the running case
+
+      user_contract parse_user_contract( const std::string& arg ) {
+         // the json data goes last as it may contain commas
+         user_contract c;
+         std::string* fields[] = { &c.wasm_file, &c.abi_file, &c.action };
+         size_t pos = 0;
+         for( auto* f : fields ) {
+            const auto comma = arg.find( ',', pos );
+            EOS_ASSERT( comma != std::string::npos, chain::misc_exception,
+                        "--benchmark-wasm needs <wasm file>,<abi file>,<action>,<json action data>, got ${a}", ("a", arg) );
+            *f = arg.substr( pos, comma - pos );
+            pos = comma + 1;
+         }
+         c.data = arg.substr( pos );
+         return c;
+      }
+
+      uint64_t time_ns( const operation& op, uint64_t iterations ) {
+         const auto start = std::chrono::steady_clock::now();
+         for( uint64_t i = 0; i < iterations; ++i )
+            op();
+         return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+      }
+
+      void run_case( const benchmark_case& c ) {
+         counters.clear();
+         const operation op = c.setup();
+
+         // grow the iteration count until one repetition takes min_time_ns
+         uint64_t iterations = 1;
+         while( time_ns( op, iterations ) < min_time_ns && iterations < (uint64_t(1) << 40) )
+            iterations *= 2;
+
+         std::vector<double> per_op;
+         for( uint32_t r = 0; r < repetitions; ++r )
+            per_op.push_back( double( time_ns( op, iterations ) ) / iterations );
+         std::sort( per_op.begin(), per_op.end() );
+
+         benchmark_result result;
+         result.name = c.name;
+         result.iterations = iterations;
+         result.repetitions = repetitions;
+         result.min_ns = per_op.front();
+         result.median_ns = per_op[per_op.size() / 2];
+         for( double ns : per_op )
+            result.mean_ns += ns / per_op.size();
+         result.max_ns = per_op.back();
+         result.counters = counters;
+
+         std::cout << fc::format_string( "${n}: ${m} ns/op median, ${min} min, ${max} max, ${i} iterations x ${r}",
+                                         fc::mutable_variant_object()("n", result.name)("m", uint64_t(result.median_ns))
+                                         ("min", uint64_t(result.min_ns))("max", uint64_t(result.max_ns))
+                                         ("i", result.iterations)("r", result.repetitions) ) << std::endl;
+         for( const auto& counter : result.counters )
+            std::cout << "   " << counter.first << ": " << counter.second << std::endl;
+         results.push_back( std::move(result) );
+      }
+
+      void write_results() {
+         if( output_file.empty() )
+            return;
+         std::ofstream out( output_file );
+         out << fc::json::to_pretty_string( results ) << std::endl;
+      }
+   }
+
+   void set_counter( const std::string& name, double value ) {
+      counters[name] = value;
+   }
+
+   const std::vector<user_contract>& user_contracts() {
+      return contracts;
+   }
+
+} } // eosio::benchmark
+
+void translate_fc_exception(const fc::exception &e) {
+   std::cerr << "\033[33m" <<  e.to_detail_string() << "\033[0m" << std::endl;
+   BOOST_TEST_FAIL("Caught Unexpected Exception");
+}
+
+/**
+ * Each benchmark is a test case of the master suite, so --run_test selects them. Options of the benchmarks go after
+ * "--", e.g. "chain_benchmark --run_test=merkle_1000 -- --eos-vm-jit --benchmark-out=results.json"
+ *    --benchmark-out=<file>           json array with one benchmark_result per case
+ *    --benchmark-min-time-ms=<ms>     minimum duration of one repetition, default 200
+ *    --benchmark-repetitions=<n>      repetitions of each case, default 5
+ *    --benchmark-wasm=<wasm file>,<abi file>,<action>,<json action data>
+ *                                     adds a contract to the corpus of the wasm runtime cases, may be repeated
+ */
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
+   using namespace eosio::benchmark;
+
+   bool is_verbose = false;
+   for (int i = 0; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--verbose") {
+         is_verbose = true;
+      } else if (arg.find("--benchmark-out=") == 0) {
+         output_file = arg.substr(std::strlen("--benchmark-out="));
+      } else if (arg.find("--benchmark-min-time-ms=") == 0) {
+         min_time_ns = std::stoull(arg.substr(std::strlen("--benchmark-min-time-ms="))) * 1'000'000;
+      } else if (arg.find("--benchmark-repetitions=") == 0) {
+         repetitions = std::max<uint32_t>(1, std::stoul(arg.substr(std::strlen("--benchmark-repetitions="))));
+      } else if (arg.find("--benchmark-wasm=") == 0) {
+         contracts.push_back(parse_user_contract(arg.substr(std::strlen("--benchmark-wasm="))));
+      }
+   }
+   if(is_verbose) {
+      fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::debug);
+   } else {
+      fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+   }
+
+   boost::unit_test::unit_test_monitor.register_exception_translator<fc::exception>(&translate_fc_exception);
+
+   for (const auto& g : registered_generators()) {
+      auto cases = g();
+      generated_cases.insert(generated_cases.end(), cases.begin(), cases.end());
+   }
+   for (const auto* list : { &registered_cases(), &generated_cases }) {
+      for (const auto& c : *list) {
+         boost::unit_test::framework::master_test_suite().add(
+            boost::unit_test::make_test_case( [&c]() { run_case(c); }, c.name, __FILE__, __LINE__ ) );
+      }
+   }
+   std::atexit(&write_results);
+   return nullptr;
+}
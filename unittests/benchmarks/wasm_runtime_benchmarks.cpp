@@ -0,0 +1,178 @@
+#include "benchmark.hpp"
+
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <contracts.hpp>
+
+#include <fstream>
+#include <iterator>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+/**
+ * Runs a corpus of contracts through every wasm runtime of the build, so that runtimes are compared on the same
+ * actions. For each contract and runtime:
+ *    wasm_<contract>_<runtime>_call         an action of an instantiated contract, the steady state
+ *    wasm_<contract>_<runtime>_first_call   a setcode of a new version of the contract and its first action,
+ *                                           with the counter instantiation_us of the runtime alone
+ * Both report resident_kib, the estimated memory of the instantiated contracts.
+ *
+ * The corpus is made of contracts of the tree and of the contracts given with --benchmark-wasm, e.g. modules of
+ * eosio-wasm-spec-tests.
+ */
+namespace {
+   struct corpus_contract {
+      std::string          name;
+      std::vector<uint8_t> wasm;
+      std::string          abi;
+      action_name          action;
+      /// creates what the action needs, the contract is deployed on account
+      std::function<fc::variant(tester&, account_name account)> setup;
+   };
+
+   std::vector<corpus_contract> corpus() {
+      std::vector<corpus_contract> result;
+      auto abi_string = []( const std::vector<char>& abi ) { return std::string( abi.data() ); };
+
+      result.push_back( { "token_transfer", contracts::eosio_token_wasm(), abi_string( contracts::eosio_token_abi() ), N(transfer),
+         []( tester& t, account_name account ) {
+            t.create_account( N(alice) );
+            t.push_action( account, N(create), account, mvo()("issuer", account)("maximum_supply", "1000000000.0000 TKN") );
+            t.push_action( account, N(issue), account, mvo()("to", account)("quantity", "1000000000.0000 TKN")("memo", "") );
+            return fc::variant( mvo()("from", account)("to", "alice")("quantity", "0.0001 TKN")("memo", "") );
+         } } );
+      result.push_back( { "payloadless", contracts::payloadless_wasm(), abi_string( contracts::payloadless_abi() ), N(doit),
+         []( tester&, account_name ) {
+            return fc::variant( mvo() );
+         } } );
+      result.push_back( { "noop", contracts::noop_wasm(), abi_string( contracts::noop_abi() ), N(anyaction),
+         []( tester&, account_name account ) {
+            return fc::variant( mvo()("from", account)("type", "")("data", "") );
+         } } );
+      result.push_back( { "multi_index_modify", contracts::snapshot_test_wasm(), abi_string( contracts::snapshot_test_abi() ), N(increment),
+         []( tester&, account_name ) {
+            return fc::variant( mvo()("value", 1) );
+         } } );
+
+      for( size_t i = 0; i < benchmark::user_contracts().size(); ++i ) {
+         const auto& c = benchmark::user_contracts()[i];
+         auto read_file = []( const std::string& path ) {
+            std::ifstream in( path, std::ios::binary );
+            EOS_ASSERT( in, misc_exception, "cannot read ${p}", ("p", path) );
+            return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+         };
+         const auto wasm = read_file( c.wasm_file );
+         const auto data = fc::json::from_string( c.data );
+         result.push_back( { "user" + std::to_string( i ), std::vector<uint8_t>( wasm.begin(), wasm.end() ),
+                                read_file( c.abi_file ), name( c.action ),
+            [data]( tester&, account_name ) { return data; } } );
+      }
+      return result;
+   }
+
+   std::vector<std::pair<std::string, wasm_interface::vm_type>> runtimes() {
+      return {
+#ifdef EOSIO_WABT_RUNTIME_ENABLED
+         { "wabt",       wasm_interface::vm_type::wabt },
+#endif
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+         { "eos_vm",     wasm_interface::vm_type::eos_vm },
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+         { "eos_vm_jit", wasm_interface::vm_type::eos_vm_jit },
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+         { "eos_vm_oc",  wasm_interface::vm_type::eos_vm_oc },
+#endif
+      };
+   }
+
+   /// a chain running one runtime with the contract deployed on N(bench)
+   struct runtime_chain {
+      fc::temp_directory dir;
+      tester             t;
+      const account_name account = N(bench);
+      action             act;
+      uint64_t           counter = 0;
+
+      runtime_chain( wasm_interface::vm_type vm, const corpus_contract& c )
+      : t( dir, [vm]( controller::config& cfg ) { cfg.wasm_runtime = vm; }, true )
+      {
+         t.execute_setup_policy( setup_policy::full );
+         t.create_account( account );
+         t.set_code( account, c.wasm );
+         t.set_abi( account, c.abi.c_str() );
+         t.produce_block();
+         const auto data = c.setup( t, account );
+         t.produce_block();
+         act = t.get_action( account, c.action, { {account, config::active_name} }, data.get_object() );
+      }
+
+      /// the action data is the same every time, the net usage limit makes the transaction ids unique
+      void push_action() {
+         signed_transaction trx;
+         trx.actions.push_back( act );
+         t.set_transaction_headers( trx );
+         trx.max_net_usage_words = 1'000'000 + counter++;
+         trx.sign( t.get_private_key( account, "active" ), t.control->get_chain_id() );
+         t.push_transaction( trx );
+      }
+
+      void report_cache() {
+         const auto stats = t.control->get_wasm_interface().get_cache_stats();
+         benchmark::set_counter( "resident_kib", stats.resident_bytes / 1024.0 );
+         if( stats.misses )
+            benchmark::set_counter( "instantiation_us", double( stats.instantiation_time_us ) / stats.misses );
+      }
+   };
+
+   /// the wasm with a custom section holding n appended, which changes the code hash but not the code
+   std::vector<uint8_t> code_version( const std::vector<uint8_t>& wasm, uint64_t n ) {
+      std::vector<uint8_t> result = wasm;
+      const uint8_t section[] = { 0, 10, 1, 'v' }; // custom section of 10 bytes named "v"
+      result.insert( result.end(), std::begin( section ), std::end( section ) );
+      for( int i = 0; i < 8; ++i )
+         result.push_back( uint8_t( n >> (8 * i) ) );
+      return result;
+   }
+
+   std::vector<benchmark::benchmark_case> wasm_runtime_cases() {
+      std::vector<benchmark::benchmark_case> cases;
+      for( const auto& c : corpus() ) {
+         for( const auto& r : runtimes() ) {
+            const auto vm = r.second;
+            cases.push_back( { "wasm_" + c.name + "_" + r.first + "_call", [c, vm]() -> benchmark::operation {
+               auto chain = std::make_shared<runtime_chain>( vm, c );
+               return [chain]() {
+                  chain->push_action();
+                  // stay below the block limits
+                  if( chain->counter % 100 == 0 ) {
+                     chain->t.produce_block();
+                     chain->report_cache();
+                  }
+               };
+            } } );
+            cases.push_back( { "wasm_" + c.name + "_" + r.first + "_first_call", [c, vm]() -> benchmark::operation {
+               auto chain = std::make_shared<runtime_chain>( vm, c );
+               return [chain, wasm = c.wasm]() {
+                  chain->t.set_code( chain->account, code_version( wasm, chain->counter ) );
+                  chain->push_action();
+                  if( chain->counter % 10 == 0 ) {
+                     chain->t.produce_block();
+                     chain->report_cache();
+                  }
+               };
+            } } );
+         }
+      }
+      return cases;
+   }
+
+   benchmark::generator_registrar wasm_runtime_generator{ &wasm_runtime_cases };
+}
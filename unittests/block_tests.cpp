@@ -1,6 +1,9 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
 
+#include <mutex>
+#include <thread>
+
 using namespace eosio;
 using namespace testing;
 using namespace chain;
@@ -159,6 +162,65 @@ BOOST_AUTO_TEST_CASE(untrusted_producer_test)
    }) ;
 }
 
+// verify that blocks apply the same whether their transaction keys were prefetched, prefetched twice, or dropped from the prefetched blocks
+BOOST_AUTO_TEST_CASE(prefetched_block_test)
+{
+   fc::temp_directory tempdir;
+   validating_tester main(tempdir, [](controller::config& cfg) { cfg.max_prefetched_blocks = 3; }, true);
+
+   vector<signed_block_ptr> blocks;
+   for (auto name : { N(alice), N(bob), N(carol), N(dave), N(erin), N(frank) }) {
+      main.create_account(name);
+      blocks.emplace_back(main.produce_block_no_validation());
+   }
+
+   // newest first, so only the keys of the oldest three blocks are still retained when they are pushed
+   for (auto itr = blocks.rbegin(); itr != blocks.rend(); ++itr)
+      main.validating_node->prefetch_block(*itr);
+   main.validating_node->prefetch_block(blocks.front());
+
+   for (const auto& b : blocks)
+      main.validate_push_block(b);
+   BOOST_REQUIRE_EQUAL(main.validating_node->head_block_id(), main.control->head_block_id());
+   BOOST_REQUIRE(main.validating_node->db().find<account_object, by_name>(N(frank)));
+}
+
+// verify that a body prefetched under the id of a block does not replace the transactions of the block applied under it
+BOOST_AUTO_TEST_CASE(prefetched_tampered_block_test)
+{
+   validating_tester main;
+
+   main.create_account(N(alice));
+   auto b = main.produce_block_no_validation();
+
+   // same header and so the same id, with the transaction signed by another key
+   auto tampered = std::make_shared<signed_block>(b->clone());
+   auto signed_tx = tampered->transactions.back().trx.get<packed_transaction>().get_signed_transaction();
+   signed_tx.signatures.clear();
+   signed_tx.sign(main.get_private_key(N(alice), "active"), main.control->get_chain_id());
+   tampered->transactions.back().trx = packed_transaction(signed_tx);
+   BOOST_REQUIRE_EQUAL(tampered->id(), b->id());
+
+   main.validating_node->prefetch_block(tampered);
+   main.validate_push_block(b);
+   BOOST_REQUIRE_EQUAL(main.validating_node->head_block_id(), b->id());
+}
+
+// verify that the keys recovered by prefetching a block are the ones its transactions are authorized with
+BOOST_AUTO_TEST_CASE(prefetched_untrusted_block_test)
+{
+   validating_tester main;
+   // the validating node rejects the block the main node produced
+   main.skip_validate = true;
+
+   auto blocks = corrupt_trx_in_block(main, N(tstproducera));
+   main.validating_node->prefetch_block( blocks.second );
+   BOOST_REQUIRE_EXCEPTION(main.validate_push_block( blocks.second ), fc::exception ,
+   [] (const fc::exception &e)->bool {
+      return e.code() == unsatisfied_authorization::code_value ;
+   }) ;
+}
+
 /**
  * Ensure that the block broadcasted by producing node and receiving node is identical
  */
@@ -274,4 +336,52 @@ BOOST_FIXTURE_TEST_CASE( abort_block_transactions_tester, validating_tester) { t
 
    } FC_LOG_AND_RETHROW() }
 
+/**
+ * Signals handed to an async_signal_consumer are handled on its thread, in the order they were emitted, and
+ * wait_for_async_signals() returns once they all are.
+ */
+BOOST_AUTO_TEST_CASE(async_signal_consumer_test) { try {
+   tester chain;
+
+   const auto main_thread = std::this_thread::get_id();
+   std::mutex mtx;
+   vector<uint32_t> accepted;
+   vector<uint32_t> irreversible;
+   vector<transaction_id_type> applied;
+   bool on_main_thread = false;
+   auto consumer = chain.control->make_async_signal_consumer( "test", 2 );
+   consumer->connect<block_state_ptr>( chain.control->accepted_block, [&]( const block_state_ptr& bsp ) {
+      std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+      std::lock_guard<std::mutex> g( mtx );
+      on_main_thread |= std::this_thread::get_id() == main_thread;
+      accepted.push_back( bsp->block_num );
+   } );
+   consumer->connect<block_state_ptr>( chain.control->irreversible_block, [&]( const block_state_ptr& bsp ) {
+      std::lock_guard<std::mutex> g( mtx );
+      irreversible.push_back( bsp->block_num );
+   } );
+   consumer->connect<std::tuple<transaction_trace_ptr, signed_transaction>>( chain.control->applied_transaction,
+         [&]( const std::tuple<transaction_trace_ptr, signed_transaction>& t ) {
+      std::lock_guard<std::mutex> g( mtx );
+      BOOST_CHECK( std::get<0>(t)->id == std::get<1>(t).id() );
+      applied.push_back( std::get<0>(t)->id );
+   } );
+
+   const auto first = chain.control->head_block_num() + 1;
+   chain.create_account( N(alice) );
+   chain.produce_blocks( 10 );
+   chain.control->wait_for_async_signals();
+   BOOST_REQUIRE_EQUAL( consumer->queued(), 0u );
+
+   std::lock_guard<std::mutex> g( mtx );
+   BOOST_REQUIRE( !on_main_thread );
+   BOOST_REQUIRE_EQUAL( accepted.size(), 10u );
+   for( uint32_t i = 0; i < accepted.size(); ++i )
+      BOOST_REQUIRE_EQUAL( accepted[i], first + i );
+   BOOST_REQUIRE( !irreversible.empty() );
+   for( uint32_t i = 1; i < irreversible.size(); ++i )
+      BOOST_REQUIRE_EQUAL( irreversible[i], irreversible[i-1] + 1 );
+   BOOST_REQUIRE( !applied.empty() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
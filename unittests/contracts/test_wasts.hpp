@@ -775,3 +775,49 @@ static const std::vector<uint8_t> varuint_memory_flags{
   0x07, 0x09, 0x01, 0x05, 'a', 'p', 'p', 'l', 'y', 0x00, 0x00, // exports
   0x0a, 0x04, 0x01, 0x02, 0x00, 0x0b // code
 };
+
+// stores, removes and finds primary key 1 of table "tbl" of the receiver again within the same action, creating and
+// removing the table on the way
+static const char table_lookup_cache_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $assert (param i32 i32)))
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_remove_i64" (func $db_remove_i64 (param i32)))
+ (import "env" "db_end_i64" (func $db_end_i64 (param i64 i64 i64) (result i32)))
+ (import "env" "db_get_i64" (func $db_get_i64 (param i32 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (data (i32.const 64) "table lookup cache\00")
+ (export "apply" (func $apply))
+ (func $find (param $0 i64) (param $1 i64) (result i32)
+  (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 14547189746360123392) (get_local $1))
+ )
+ (func $store (param $0 i64) (param $1 i64) (param $2 i64) (result i32)
+  (i64.store (i32.const 0) (get_local $2))
+  (call $db_store_i64 (get_local $0) (i64.const 14547189746360123392) (get_local $0) (get_local $1) (i32.const 0) (i32.const 8))
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $itr i32)
+  ;; the miss of the table is cached and has to be replaced when the table is created
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 1)) (i32.const -1)) (i32.const 64))
+  (set_local $itr (call $store (get_local $0) (i64.const 1) (i64.const 100)))
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 1)) (get_local $itr)) (i32.const 64))
+  ;; removing the only row removes the table
+  (call $db_remove_i64 (get_local $itr))
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 1)) (i32.const -1)) (i32.const 64))
+  (call $assert (i32.eq (call $db_end_i64 (get_local $0) (get_local $0) (i64.const 14547189746360123392)) (i32.const -1)) (i32.const 64))
+  ;; the same primary key stored again is a new row
+  (set_local $itr (call $store (get_local $0) (i64.const 1) (i64.const 200)))
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 1)) (get_local $itr)) (i32.const 64))
+  (drop (call $db_get_i64 (get_local $itr) (i32.const 16) (i32.const 8)))
+  (call $assert (i64.eq (i64.load (i32.const 16)) (i64.const 200)) (i32.const 64))
+  ;; a removed row is not found while its table remains
+  (drop (call $store (get_local $0) (i64.const 2) (i64.const 300)))
+  (call $db_remove_i64 (get_local $itr))
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 1)) (call $db_end_i64 (get_local $0) (get_local $0) (i64.const 14547189746360123392))) (i32.const 64))
+  (call $db_remove_i64 (call $find (get_local $0) (i64.const 2)))
+  (call $assert (i32.eq (call $find (get_local $0) (i64.const 2)) (i32.const -1)) (i32.const 64))
+ )
+)
+)=====";
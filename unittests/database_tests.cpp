@@ -1,4 +1,5 @@
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/crypto/digest.hpp>
@@ -45,6 +46,48 @@ BOOST_AUTO_TEST_SUITE(database_tests)
       } FC_LOG_AND_RETHROW()
    }
 
+   // The hashed index of key_value_object finds the same rows as the ordered one, through undo
+   BOOST_AUTO_TEST_CASE(table_primary_hash_test) {
+      try {
+         TESTER test;
+         eosio::chain::database& db = const_cast<eosio::chain::database&>( test.control->db() );
+
+         auto ses = db.start_undo_session(true);
+         const auto& tab = db.create<table_id_object>([](table_id_object& t) {
+            t.code = name("billy");
+            t.scope = name("billy");
+            t.table = name("accounts");
+         });
+         for( uint64_t pk = 0; pk < 100; ++pk ) {
+            db.create<key_value_object>([&](key_value_object& o) {
+               o.t_id = tab.id;
+               o.primary_key = pk * 7;
+            });
+         }
+         const auto tid = tab.id;
+
+         for( uint64_t pk = 0; pk < 700; ++pk ) {
+            const auto* hashed = db.find<key_value_object, by_table_primary>( boost::make_tuple( tid, pk ) );
+            const auto* ordered = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tid, pk ) );
+            BOOST_TEST( hashed == ordered );
+            BOOST_TEST( (hashed != nullptr) == (pk % 7 == 0) );
+         }
+
+         ses.undo();
+         BOOST_TEST( db.find<key_value_object, by_table_primary>( boost::make_tuple( tid, 7 ) ) == nullptr );
+      } FC_LOG_AND_RETHROW()
+   }
+
+   // The hashed index of key_value_object has buckets for the configured number of rows once the state is opened
+   BOOST_AUTO_TEST_CASE(table_primary_hash_reserve_test) {
+      try {
+         fc::temp_directory tempdir;
+         tester test( tempdir, []( controller::config& cfg ) { cfg.contract_row_hash_reserve = 5000; }, true );
+         const auto& by_hash = test.control->db().get_index<key_value_index>().indices().get<by_table_primary>();
+         BOOST_TEST( by_hash.bucket_count() >= by_hash.size() + 5000 );
+      } FC_LOG_AND_RETHROW()
+   }
+
    // Test the block fetching methods on database, fetch_bock_by_id, and fetch_block_by_number
    BOOST_AUTO_TEST_CASE(get_blocks) {
       try {
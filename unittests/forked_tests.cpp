@@ -126,6 +126,117 @@ BOOST_AUTO_TEST_CASE( fork_with_bad_block ) try {
 
 } FC_LOG_AND_RETHROW();
 
+/**
+ *  A node keeping state deltas re-applies the blocks of its branch from them after failing to switch to a fork with a
+ *  bad block, and must end up where a node executing those blocks again does, with the same traces emitted.
+ */
+BOOST_AUTO_TEST_CASE( fork_switch_state_delta_replay ) try {
+   tester bios;
+   bios.produce_block();
+   bios.create_accounts( {N(a),N(b),N(c),N(d),N(e),N(eosio.token)} );
+   bios.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+   bios.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+   bios.produce_block();
+   bios.push_action( N(eosio.token), N(create), N(eosio.token), mutable_variant_object()
+              ("issuer",       "eosio" )
+              ("maximum_supply", core_from_string("10000000.0000"))
+      );
+   bios.push_action( N(eosio.token), N(issue), config::system_account_name, mutable_variant_object()
+              ("to",       "eosio" )
+              ("quantity", core_from_string("100.0000"))
+              ("memo", "")
+      );
+   bios.produce_block();
+   bios.set_producers( {N(a),N(b),N(c),N(d),N(e)} );
+   BOOST_REQUIRE( produce_until_transition( bios, N(e), N(a) ) );
+
+   fc::temp_directory replay_dir, full_dir;
+   tester replay( replay_dir, []( controller::config& cfg ) { cfg.fork_switch_delta_size = 1024*1024; }, true );
+   tester full( full_dir, []( controller::config& ) {}, true );
+   tester remote(setup_policy::none);
+   push_blocks( bios, replay );
+   push_blocks( bios, full );
+   push_blocks( bios, remote );
+
+   // traces with a receipt emitted for the blocks of a, by block
+   using traces_by_block = std::map<block_id_type, vector<transaction_trace_ptr>>;
+   std::set<block_id_type> a_blocks;
+   const auto record = [&a_blocks]( tester& t, traces_by_block& traces ) {
+      return t.control->applied_transaction.connect(
+            [&a_blocks, &traces]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> applied ) {
+         const auto& trace = std::get<0>(applied);
+         if( trace->receipt && trace->producer_block_id && a_blocks.count( *trace->producer_block_id ) )
+            traces[*trace->producer_block_id].push_back( trace );
+      } );
+   };
+
+   // a's blocks change token balances
+   for( int i = 0; i < 6; ++i ) {
+      bios.push_action( N(eosio.token), N(transfer), config::system_account_name, mutable_variant_object()
+              ("from",     "eosio")
+              ("to",       "a" )
+              ("quantity", core_from_string("1.0000"))
+              ("memo",     std::to_string(i))
+         );
+      auto blk = bios.produce_block();
+      BOOST_REQUIRE_EQUAL( blk->producer.to_string(), "a" );
+      a_blocks.insert( blk->id() );
+   }
+   traces_by_block validated;
+   {
+      boost::signals2::scoped_connection c = record( replay, validated );
+      push_blocks( bios, replay );
+      push_blocks( bios, full );
+   }
+   BOOST_REQUIRE_EQUAL( validated.size(), a_blocks.size() );
+
+   // remote skips a's blocks and produces a longer fork whose last block is bad
+   auto offset = fc::milliseconds(config::block_interval_ms * 13);
+   vector<signed_block_ptr> fork;
+   for( int i = 0; i < 7; ++i ) {
+      auto b = remote.produce_block( offset );
+      BOOST_REQUIRE_EQUAL( b->producer.to_string(), "b" );
+      fork.push_back( b );
+      offset = fc::milliseconds(config::block_interval_ms);
+   }
+   auto bad = std::make_shared<signed_block>( fork.back()->clone() );
+   bad->action_mroot._hash[0] ^= 0x1ULL;
+   auto header_bmroot = digest_type::hash( std::make_pair( bad->digest(), remote.control->head_block_state()->blockroot_merkle.get_root() ) );
+   auto sig_digest = digest_type::hash( std::make_pair( header_bmroot, remote.control->head_block_state()->pending_schedule.schedule_hash ) );
+   bad->producer_signature = remote.get_private_key( N(b), "active" ).sign( sig_digest );
+   fork.back() = bad;
+
+   traces_by_block replayed, reapplied;
+   {
+      boost::signals2::scoped_connection c1 = record( replay, replayed );
+      boost::signals2::scoped_connection c2 = record( full, reapplied );
+      for( tester* t : { &replay, &full } ) {
+         for( size_t i = 0; i < fork.size() - 1; ++i )
+            t->push_block( fork[i] );
+         BOOST_REQUIRE_EXCEPTION( t->push_block( fork.back() ), fc::exception,
+                                  fc_exception_message_is( "Block ID does not match" ) );
+         BOOST_REQUIRE_EQUAL( t->control->head_block_id(), bios.control->head_block_id() );
+      }
+   }
+
+   BOOST_CHECK_EQUAL( replay.control->calculate_integrity_hash(), full.control->calculate_integrity_hash() );
+
+   BOOST_REQUIRE_EQUAL( replayed.size(), a_blocks.size() );
+   BOOST_REQUIRE_EQUAL( reapplied.size(), a_blocks.size() );
+   for( const auto& id : a_blocks ) {
+      const auto& r = replayed[id];
+      const auto& f = reapplied[id];
+      BOOST_REQUIRE_EQUAL( r.size(), f.size() );
+      BOOST_REQUIRE_EQUAL( r.size(), validated[id].size() );
+      for( size_t i = 0; i < r.size(); ++i ) {
+         BOOST_CHECK_EQUAL( r[i]->id, f[i]->id );
+         // the traces of the first validation, so the block was replayed from its delta
+         BOOST_CHECK( r[i] == validated[id][i] );
+      }
+   }
+
+} FC_LOG_AND_RETHROW();
+
 BOOST_AUTO_TEST_CASE( forking ) try {
    tester c;
    while (c.control->head_block_num() < 3) {
@@ -279,6 +390,19 @@ BOOST_AUTO_TEST_CASE( forking ) try {
  *  This test verifies that the fork-choice rule favors the branch with
  *  the highest last irreversible block over one that is longer.
  */
+/// the reversible blocks found by number are the ones of the head branch
+void check_head_branch_by_number( tester& t ) {
+   const uint32_t lib = t.control->last_irreversible_block_num();
+   uint32_t checked = 0;
+   for( auto b = t.control->head_block_state(); b && b->block_num > lib; b = t.control->fetch_block_state_by_id( b->header.previous ) ) {
+      BOOST_REQUIRE( t.control->fetch_block_state_by_number( b->block_num ) );
+      BOOST_CHECK_EQUAL( t.control->fetch_block_state_by_number( b->block_num )->id, b->id );
+      BOOST_CHECK_EQUAL( t.control->get_block_id_for_num( b->block_num ), b->id );
+      ++checked;
+   }
+   BOOST_CHECK_EQUAL( checked, t.control->head_block_num() - lib );
+}
+
 BOOST_AUTO_TEST_CASE( prune_remove_branch ) try {
    tester c;
    while (c.control->head_block_num() < 11) {
@@ -323,6 +447,7 @@ BOOST_AUTO_TEST_CASE( prune_remove_branch ) try {
 
    BOOST_REQUIRE_EQUAL(87u, c.control->head_block_num());
    BOOST_REQUIRE_EQUAL(73u, c2.control->head_block_num());
+   check_head_branch_by_number(c);
 
    // push fork from c2 => c
    size_t p = fork_num;
@@ -333,6 +458,7 @@ BOOST_AUTO_TEST_CASE( prune_remove_branch ) try {
    }
 
    BOOST_REQUIRE_EQUAL(73u, c.control->head_block_num());
+   check_head_branch_by_number(c);
 
 } FC_LOG_AND_RETHROW()
 
@@ -513,6 +639,77 @@ BOOST_AUTO_TEST_CASE( irreversible_mode ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( irreversible_undo_free_bad_block ) try {
+   tester main;
+   main.produce_block();
+
+   fc::temp_directory irreversible_dir;
+   tester irreversible( irreversible_dir, []( controller::config& cfg ) {
+      cfg.read_mode = db_read_mode::IRREVERSIBLE;
+      cfg.irreversible_undo_free = true;
+   }, true );
+   push_blocks( main, irreversible );
+   BOOST_REQUIRE_EQUAL( irreversible.control->head_block_num(), main.control->last_irreversible_block_num() );
+
+   // a block creating bob whose action_mroot is corrupted, and a block on top of it making it irreversible
+   main.create_accounts( {N(bob)} );
+   auto b = main.produce_block();
+   incremental_merkle block_merkle = main.control->head_block_state()->blockroot_merkle;
+   auto c = main.produce_block();
+   const auto schedule_hash = main.control->head_block_state()->pending_schedule.schedule_hash;
+   const auto resign = [&]( signed_block& blk ) {
+      auto header_bmroot = digest_type::hash( std::make_pair( blk.digest(), block_merkle.get_root() ) );
+      auto sig_digest = digest_type::hash( std::make_pair( header_bmroot, schedule_hash ) );
+      blk.producer_signature = main.get_private_key( config::system_account_name, "active" ).sign( sig_digest );
+   };
+   auto bad = std::make_shared<signed_block>( b->clone() );
+   bad->action_mroot._hash[0] ^= 0x1ULL;
+   resign( *bad );
+   block_merkle.append( bad->id() );
+   auto child = std::make_shared<signed_block>( c->clone() );
+   child->previous = bad->id();
+   resign( *child );
+
+   // irreversible mode only validates the headers of the reversible blocks
+   irreversible.push_block( bad );
+   BOOST_REQUIRE( !irreversible.control->state_unrecoverable() );
+   BOOST_REQUIRE_EXCEPTION( irreversible.push_block( child ), state_unrecoverable_exception,
+                            fc_exception_message_starts_with( "block " + std::to_string( bad->block_num() ) ) );
+   BOOST_CHECK( irreversible.control->state_unrecoverable() );
+
+   // the transactions of the failed block stay applied
+   BOOST_CHECK( irreversible.control->db().find<account_object, by_name>( N(bob) ) != nullptr );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( irreversible_undo_free_tampered_body ) try {
+   tester main;
+   main.produce_block();
+
+   fc::temp_directory irreversible_dir;
+   tester irreversible( irreversible_dir, []( controller::config& cfg ) {
+      cfg.read_mode = db_read_mode::IRREVERSIBLE;
+      cfg.irreversible_undo_free = true;
+   }, true );
+   push_blocks( main, irreversible );
+
+   // the header, and so the id and producer signature, of a block creating bob with its transactions removed
+   main.create_accounts( {N(bob)} );
+   auto b = main.produce_block();
+   auto c = main.produce_block();
+   auto tampered = std::make_shared<signed_block>( b->clone() );
+   tampered->transactions.clear();
+   BOOST_REQUIRE_EQUAL( tampered->id(), b->id() );
+
+   // caught before the state is changed without undo sessions, the block fails like any invalid block
+   irreversible.push_block( tampered );
+   BOOST_REQUIRE_THROW( irreversible.push_block( c ), fc::exception );
+   BOOST_REQUIRE( !irreversible.control->state_unrecoverable() );
+   BOOST_CHECK( irreversible.control->db().find<account_object, by_name>( N(bob) ) == nullptr );
+   BOOST_CHECK_EQUAL( irreversible.control->head_block_id(), b->previous );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_CASE( reopen_forkdb ) try {
    tester c1;
 
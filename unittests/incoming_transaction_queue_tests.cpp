@@ -0,0 +1,257 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/incoming_transaction_queue.hpp>
+#include <eosio/chain/subjective_cpu_ledger.hpp>
+#include <eosio/chain/contract_types.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+
+BOOST_AUTO_TEST_SUITE(incoming_transaction_queue_tests)
+
+auto unique_trx_meta_data( account_name actor, uint32_t expiration_sec = 0 ) {
+
+   static uint64_t nextid = 0;
+   ++nextid;
+
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec( expiration_sec );
+   trx.actions.emplace_back( vector<permission_level>{{actor,config::active_name}},
+                             onerror{ nextid, "test", 4 });
+   return transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::input );
+}
+
+void add( incoming_transaction_queue& q, const transaction_metadata_ptr& trx ) {
+   BOOST_REQUIRE( q.add( trx, false, []( const auto& ) {} ).empty() );
+}
+
+auto next( incoming_transaction_queue& q ) {
+   return q.pop_front().trx_meta;
+}
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_fifo ) try {
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 1024*1024 );
+   BOOST_CHECK( q.empty() );
+
+   auto trx1 = unique_trx_meta_data( N(alice) );
+   auto trx2 = unique_trx_meta_data( N(bob) );
+   auto trx3 = unique_trx_meta_data( N(alice) );
+   add( q, trx1 );
+   add( q, trx2 );
+   q.add_front( trx3, false, []( const auto& ) {} );
+   BOOST_CHECK_EQUAL( q.size(), 3u );
+   BOOST_CHECK( next( q ) == trx3 );
+   BOOST_CHECK( next( q ) == trx1 );
+   BOOST_CHECK( next( q ) == trx2 );
+   BOOST_CHECK( q.empty() );
+   BOOST_CHECK_THROW( q.pop_front(), producer_exception );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_fifo
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_account_fair ) try {
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 1024*1024 );
+   q.set_policy( trx_queue_policy::account_fair );
+
+   // a burst of one account does not delay the others
+   auto spam1 = unique_trx_meta_data( N(spammer) );
+   auto spam2 = unique_trx_meta_data( N(spammer) );
+   auto spam3 = unique_trx_meta_data( N(spammer) );
+   auto alice1 = unique_trx_meta_data( N(alice) );
+   auto bob1 = unique_trx_meta_data( N(bob) );
+   auto alice2 = unique_trx_meta_data( N(alice) );
+   add( q, spam1 );
+   add( q, spam2 );
+   add( q, spam3 );
+   add( q, alice1 );
+   add( q, bob1 );
+   add( q, alice2 );
+   BOOST_CHECK( next( q ) == spam1 );
+   BOOST_CHECK( next( q ) == alice1 );
+   BOOST_CHECK( next( q ) == bob1 );
+   BOOST_CHECK( next( q ) == spam2 );
+
+   // an account arriving later does not get ahead of the current round
+   auto carol1 = unique_trx_meta_data( N(carol) );
+   add( q, carol1 );
+   BOOST_CHECK( next( q ) == alice2 );
+   BOOST_CHECK( next( q ) == carol1 );
+   BOOST_CHECK( next( q ) == spam3 );
+   BOOST_CHECK( q.empty() );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_account_fair
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_expiry_and_cpu ) try {
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 1024*1024 );
+   q.set_policy( trx_queue_policy::expiry );
+
+   auto late = unique_trx_meta_data( N(alice), 300 );
+   auto early = unique_trx_meta_data( N(alice), 100 );
+   add( q, late );
+   add( q, early );
+   BOOST_CHECK( next( q ) == early );
+   BOOST_CHECK( next( q ) == late );
+
+   q.set_policy( trx_queue_policy::cpu );
+   auto expensive = unique_trx_meta_data( N(alice) );
+   q.record_cpu_usage( expensive, 5000 ); // all test transactions share the same first action
+   auto trx1 = unique_trx_meta_data( N(alice) );
+   add( q, trx1 );
+   q.record_cpu_usage( expensive, 100000 );
+   auto trx2 = unique_trx_meta_data( N(alice) );
+   add( q, trx2 );
+   q.record_cpu_usage( expensive, 0 );
+   auto trx3 = unique_trx_meta_data( N(alice) );
+   add( q, trx3 );
+   BOOST_CHECK( next( q ) == trx1 );
+   BOOST_CHECK( next( q ) == trx3 );
+   BOOST_CHECK( next( q ) == trx2 );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_expiry_and_cpu
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_eviction ) try {
+   auto vip = unique_trx_meta_data( N(exchange) );
+   auto spam1 = unique_trx_meta_data( N(spammer) );
+   auto spam2 = unique_trx_meta_data( N(spammer) );
+   const uint64_t trx_size = vip->packed_trx()->get_unprunable_size() + vip->packed_trx()->get_prunable_size() + sizeof( *vip );
+
+   // a full fifo queue drops new transactions
+   incoming_transaction_queue fifo;
+   fifo.set_max_incoming_transaction_queue_size( 2*trx_size + 1 );
+   add( fifo, spam1 );
+   add( fifo, spam2 );
+   BOOST_CHECK_THROW( fifo.add( vip, false, []( const auto& ) {} ), tx_resource_exhaustion );
+   BOOST_CHECK_EQUAL( fifo.size(), 2u );
+
+   // a full priority queue evicts the lowest priority transaction
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 2*trx_size + 1 );
+   q.set_policy( trx_queue_policy::priority );
+   q.set_priority_accounts( { N(exchange) } );
+   add( q, spam1 );
+   add( q, spam2 );
+   auto evicted = q.add( vip, false, []( const auto& ) {} );
+   BOOST_REQUIRE_EQUAL( evicted.size(), 1u );
+   BOOST_CHECK( evicted.front().trx_meta == spam2 );
+   BOOST_CHECK_THROW( q.add( unique_trx_meta_data( N(spammer) ), false, []( const auto& ) {} ), tx_resource_exhaustion );
+   BOOST_CHECK( next( q ) == vip );
+   BOOST_CHECK( next( q ) == spam1 );
+   BOOST_CHECK( q.empty() );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_eviction
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_deprioritized ) try {
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 1024*1024 );
+   q.set_policy( trx_queue_policy::account_fair );
+
+   auto spam1 = unique_trx_meta_data( N(spammer) );
+   auto spam2 = unique_trx_meta_data( N(spammer) );
+   auto alice1 = unique_trx_meta_data( N(alice) );
+   auto bob1 = unique_trx_meta_data( N(bob) );
+   BOOST_REQUIRE( q.add( spam1, false, []( const auto& ) {}, true ).empty() );
+   add( q, alice1 );
+   BOOST_REQUIRE( q.add( spam2, false, []( const auto& ) {}, true ).empty() );
+   add( q, bob1 );
+   BOOST_CHECK( next( q ) == alice1 );
+   BOOST_CHECK( next( q ) == bob1 );
+   auto e = q.pop_front();
+   BOOST_CHECK( e.trx_meta == spam1 );
+   BOOST_CHECK( e.deprioritized() );
+   BOOST_CHECK( next( q ) == spam2 );
+   BOOST_CHECK( q.empty() );
+
+   // a full queue evicts deprioritized transactions first, even with the fifo policy
+   const uint64_t trx_size = spam1->packed_trx()->get_unprunable_size() + spam1->packed_trx()->get_prunable_size() + sizeof( *spam1 );
+   incoming_transaction_queue fifo;
+   fifo.set_max_incoming_transaction_queue_size( 2*trx_size + 1 );
+   add( fifo, alice1 );
+   BOOST_REQUIRE( fifo.add( spam1, false, []( const auto& ) {}, true ).empty() );
+   BOOST_CHECK_THROW( fifo.add( spam2, false, []( const auto& ) {}, true ), tx_resource_exhaustion );
+   auto evicted = fifo.add( bob1, false, []( const auto& ) {} );
+   BOOST_REQUIRE_EQUAL( evicted.size(), 1u );
+   BOOST_CHECK( evicted.front().trx_meta == spam1 );
+   BOOST_CHECK( next( fifo ) == alice1 );
+   BOOST_CHECK( next( fifo ) == bob1 );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_deprioritized
+
+BOOST_AUTO_TEST_CASE( incoming_transaction_queue_deprioritize_front ) try {
+   incoming_transaction_queue q;
+   q.set_max_incoming_transaction_queue_size( 1024*1024 );
+   q.set_policy( trx_queue_policy::account_fair );
+
+   auto alice1 = unique_trx_meta_data( N(alice) );
+   auto bob1 = unique_trx_meta_data( N(bob) );
+   auto alice2 = unique_trx_meta_data( N(alice) );
+   auto spam1 = unique_trx_meta_data( N(spammer) );
+   add( q, alice1 );
+   add( q, bob1 );
+   add( q, alice2 );
+   BOOST_REQUIRE( q.add( spam1, false, []( const auto& ) {}, true ).empty() );
+
+   auto front = q.front( 10 );
+   BOOST_REQUIRE_EQUAL( front.size(), 3u );
+   BOOST_CHECK( front[0] == alice1 );
+   BOOST_CHECK( front[1] == bob1 );
+   BOOST_CHECK( front[2] == alice2 );
+   BOOST_CHECK_EQUAL( q.front( 2 ).size(), 2u );
+
+   // only the first two are considered, alice2 stays ahead of the deprioritized ones
+   BOOST_CHECK_EQUAL( q.deprioritize_front( 2, []( const transaction_metadata_ptr& ) { return true; } ), 2u );
+   BOOST_CHECK_EQUAL( q.size(), 4u );
+   BOOST_CHECK( next( q ) == alice2 );
+   BOOST_CHECK( next( q ) == spam1 );
+   auto e = q.pop_front();
+   BOOST_CHECK( e.trx_meta == alice1 );
+   BOOST_CHECK( e.deprioritized() );
+   BOOST_CHECK( next( q ) == bob1 );
+   BOOST_CHECK( q.empty() );
+
+   // CPU usage is only recorded for estimates with the cpu policy or when tracked
+   q.record_cpu_usage( alice1, 100 );
+   BOOST_CHECK_EQUAL( q.cpu_estimate( alice1 ), 0u );
+   q.set_track_cpu_usage( true );
+   q.record_cpu_usage( alice1, 100 );
+   BOOST_CHECK_EQUAL( q.cpu_estimate( alice1 ), 100u );
+
+} FC_LOG_AND_RETHROW() /// incoming_transaction_queue_deprioritize_front
+
+BOOST_AUTO_TEST_CASE( subjective_cpu_ledger_decay ) try {
+   subjective_cpu_ledger ledger;
+   const fc::time_point t0 = block_timestamp_type( 1000 ).to_time_point();
+   ledger.record( N(spammer), 5000, t0 );
+   BOOST_CHECK( !ledger.over_budget( N(spammer), t0 ) ); // disabled
+   BOOST_CHECK_EQUAL( ledger.size(), 0u );
+
+   // two slots window
+   ledger.set_budget( 1000, fc::milliseconds( 1000 ) );
+   ledger.record( N(spammer), 1500, t0 );
+   ledger.record( N(alice), 500, t0 );
+   BOOST_CHECK_EQUAL( ledger.usage_us( N(spammer), t0 ), 1500u );
+   BOOST_CHECK( ledger.over_budget( N(spammer), t0 ) );
+   BOOST_CHECK( !ledger.over_budget( N(alice), t0 ) );
+   BOOST_CHECK( !ledger.over_budget( N(bob), t0 ) );
+
+   // half of the window later half of it is left
+   const fc::time_point t1 = t0 + fc::milliseconds( config::block_interval_ms );
+   BOOST_CHECK_EQUAL( ledger.usage_us( N(spammer), t1 ), 750u );
+   BOOST_CHECK( !ledger.over_budget( N(spammer), t1 ) );
+   ledger.record( N(spammer), 500, t1 );
+   BOOST_CHECK( ledger.over_budget( N(spammer), t1 ) );
+
+   // a clock going back does not go back in the window
+   BOOST_CHECK_EQUAL( ledger.usage_us( N(spammer), t0 ), 1250u );
+
+   ledger.prune( t1 );
+   BOOST_CHECK_EQUAL( ledger.size(), 2u );
+   const fc::time_point t3 = t1 + fc::milliseconds( 2 * config::block_interval_ms );
+   BOOST_CHECK_EQUAL( ledger.usage_us( N(spammer), t3 ), 0u );
+   ledger.prune( t3 );
+   BOOST_CHECK_EQUAL( ledger.size(), 0u );
+
+} FC_LOG_AND_RETHROW() /// subjective_cpu_ledger_decay
+
+BOOST_AUTO_TEST_SUITE_END()
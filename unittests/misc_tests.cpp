@@ -1,9 +1,28 @@
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/access_list.hpp>
+#include <eosio/chain/action_stats.hpp>
+#include <eosio/chain/adaptive_block_timing.hpp>
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/authority_checker.hpp>
 #include <eosio/chain/chain_config.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/incremental_merkle.hpp>
+#include <eosio/chain/memory_accounting.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/native_float.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/key_string_cache.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/transaction_conflict_detector.hpp>
+#include <eosio/chain/transaction_tracing.hpp>
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/code_artifact.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/code_cache.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/compile_queue.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
+#endif
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -13,6 +32,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <softfloat.hpp>
+
 #ifdef NON_VALIDATING_TEST
 #define TESTER tester
 #else
@@ -144,6 +165,35 @@ BOOST_AUTO_TEST_CASE(name_suffix_tests)
    BOOST_CHECK_EQUAL( name{name_suffix(N(abcdefhij.123))}, name{N(123)} );
 }
 
+BOOST_AUTO_TEST_CASE(name_symbol_to_chars_test) { try {
+   static_assert( N(eosio).length() == 5 );
+   BOOST_CHECK_EQUAL( name().length(), 0u );
+   BOOST_CHECK_EQUAL( name().to_string(), "" );
+
+   char buf[asset::max_string_length];
+   for( const char* s : { "a", "eosio", "eosio.token", "abcdefghijkl", "abcdefghijklj", "zzzzzzzzzzzzj", "a.b.c", "1" } ) {
+      const name n( s );
+      BOOST_CHECK_EQUAL( n.length(), strlen( s ) );
+      BOOST_CHECK_EQUAL( string( buf, n.to_chars( buf ) ), s );
+      BOOST_CHECK_EQUAL( n.to_string(), s );
+   }
+   BOOST_CHECK_THROW( name( "eosio." ), name_type_exception );
+   BOOST_CHECK_THROW( name( "abcdefghijklz" ), name_type_exception );
+   BOOST_CHECK_THROW( name( "Eosio" ), name_type_exception );
+
+   const symbol sym( 4, "SYS" );
+   BOOST_CHECK_EQUAL( string( buf, sym.to_chars( buf ) ), "4,SYS" );
+   BOOST_CHECK_EQUAL( symbol( 18, "ABCDEFG" ).to_string(), "18,ABCDEFG" );
+   BOOST_CHECK_EQUAL( sym.name(), "SYS" );
+
+   for( const char* s : { "0.0000 SYS", "1.0000 SYS", "-0.0001 SYS", "12345.6789 SYS", "-4611686018427387903 ABCDEFG",
+                          "-4.611686018427387903 ABCDEFG", "0.000000000000000001 ABC", "7 A" } ) {
+      const asset a = asset::from_string( s );
+      BOOST_CHECK_EQUAL( string( buf, a.to_chars( buf ) ), s );
+      BOOST_CHECK_EQUAL( a.to_string(), s );
+   }
+} FC_LOG_AND_RETHROW() }
+
 /// Test processing of unbalanced strings
 BOOST_AUTO_TEST_CASE(json_from_string_test)
 {
@@ -752,6 +802,11 @@ BOOST_AUTO_TEST_CASE(transaction_test) { try {
    BOOST_CHECK_EQUAL(1u, keys.size());
    BOOST_CHECK_EQUAL(public_key, *keys.begin());
 
+   // copies share the unpacked transaction
+   packed_transaction pkt6( pkt4 );
+   BOOST_CHECK_EQUAL(true, &pkt6.get_transaction() == &pkt4.get_transaction());
+   BOOST_CHECK_EQUAL(pkt6.id(), pkt4.id());
+
 } FC_LOG_AND_RETHROW() }
 
 
@@ -1110,6 +1165,228 @@ BOOST_AUTO_TEST_CASE(stable_priority_queue_test) {
   } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(transaction_conflict_groups_test) {
+   transaction_conflict_detector detector;
+   BOOST_CHECK( detector.current() == nullptr );
+   BOOST_CHECK_EQUAL( detector.conflict_groups().size(), 0u );
+
+   // 0: alice transfers on eosio.token
+   auto* s = detector.begin_transaction();
+   s->add_account( N(alice) );
+   s->add_account( N(eosio.token) );
+   s->add_table( N(eosio.token), N(alice), N(accounts) );
+   // 1: bob votes, unrelated to 0
+   s = detector.begin_transaction();
+   s->add_account( N(bob) );
+   s->add_table( N(eosio), N(eosio), N(voters) );
+   // 2: carol plays a game, unrelated to 0 and 1
+   s = detector.begin_transaction();
+   s->add_account( N(carol) );
+   s->add_table( N(game), N(game), N(state) );
+   BOOST_CHECK( detector.current() == s );
+   // 3: dave votes, conflicts with 1 through the shared table
+   s = detector.begin_transaction();
+   s->add_account( N(dave) );
+   s->add_table( N(eosio), N(eosio), N(voters) );
+   // 4: alice plays the game, merges the groups of 0 and 2
+   s = detector.begin_transaction();
+   s->add_account( N(alice) );
+   s->add_table( N(game), N(game), N(state) );
+
+   const auto groups = detector.conflict_groups();
+   BOOST_REQUIRE_EQUAL( groups.size(), 2u );
+   BOOST_CHECK( groups[0] == (vector<uint32_t>{0, 2, 4}) );
+   BOOST_CHECK( groups[1] == (vector<uint32_t>{1, 3}) );
+
+   detector.reset();
+   BOOST_CHECK_EQUAL( detector.size(), 0u );
+}
+
+BOOST_AUTO_TEST_CASE(merkle_hash_canonical_pair_test) {
+   // reference implementation the fast path must stay bit-identical to
+   auto reference_merkle = []( vector<digest_type> ids ) {
+      if( ids.empty() ) return digest_type();
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 ) ids.push_back( ids.back() );
+         for( size_t i = 0; i < ids.size() / 2; ++i )
+            ids[i] = digest_type::hash( make_canonical_pair( ids[2 * i], ids[2 * i + 1] ) );
+         ids.resize( ids.size() / 2 );
+      }
+      return ids.front();
+   };
+
+   vector<digest_type> leaves;
+   incremental_merkle im;
+   BOOST_CHECK( merkle( leaves ) == digest_type() );
+   for( uint32_t i = 0; i < 130; ++i ) {
+      leaves.emplace_back( digest_type::hash( i ) );
+      const auto& l = leaves.back();
+      BOOST_CHECK( hash_canonical_pair( l, leaves.front() ) == digest_type::hash( make_canonical_pair( l, leaves.front() ) ) );
+      BOOST_CHECK( merkle( leaves ) == reference_merkle( leaves ) );
+      im.append( l );
+      BOOST_CHECK( im.get_root() == merkle( leaves ) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(signature_recovery_cache_test) {
+   auto& cache = signature_recovery_cache::instance();
+   cache.clear();
+   const auto orig_capacity = cache.get_stats().capacity;
+   cache.set_capacity( 2 );
+
+   auto k1 = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string( "k1" ) ) );
+   auto k2 = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string( "k2" ) ) );
+   auto d1 = digest_type::hash( std::string( "d1" ) );
+   auto d2 = digest_type::hash( std::string( "d2" ) );
+   auto s11 = k1.sign( d1 );
+   auto s21 = k2.sign( d1 );
+   auto s12 = k1.sign( d2 );
+
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   // same digest, different signature
+   BOOST_CHECK( cache.recover( s21, d1 ) == k2.get_public_key() );
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 1u );
+   BOOST_CHECK_EQUAL( stats.misses, 2u );
+   BOOST_CHECK_EQUAL( stats.size, 2u );
+
+   // s11 is the least recently used and gets evicted
+   BOOST_CHECK( cache.recover( s12, d2 ) == k1.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 2u );
+   BOOST_CHECK( cache.recover( s21, d1 ) == k2.get_public_key() );
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.misses, 4u );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+
+   // a recovery without the canonical check, as done by the intrinsics, is not reused for one requiring it
+   cache.set_capacity( orig_capacity );
+   cache.clear();
+   BOOST_CHECK( cache.recover( s11, d1, false ) == k1.get_public_key() );
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   BOOST_CHECK( cache.recover( s11, d1, false ) == k1.get_public_key() );
+   BOOST_CHECK( cache.recover( s11, d1 ) == k1.get_public_key() );
+   stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.misses, 2u );
+   BOOST_CHECK_EQUAL( stats.size, 1u );
+
+   cache.clear();
+}
+
+BOOST_AUTO_TEST_CASE(key_string_cache_test) {
+   auto& cache = key_string_cache::instance();
+   cache.clear();
+   const auto orig_capacity = cache.get_stats().capacity;
+   cache.set_capacity( 1 );
+
+   auto k1 = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string( "k1" ) ) );
+   auto k2 = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string( "k2" ) ) );
+   auto s1 = k1.sign( digest_type::hash( std::string( "d1" ) ) );
+
+   BOOST_CHECK_EQUAL( cache.to_string( k1.get_public_key() ), std::string( k1.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.to_string( k1.get_public_key() ), std::string( k1.get_public_key() ) );
+   // signatures have their own table and do not evict the key
+   BOOST_CHECK_EQUAL( cache.to_string( s1 ), std::string( s1 ) );
+   BOOST_CHECK_EQUAL( cache.to_string( k1.get_public_key() ), std::string( k1.get_public_key() ) );
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.misses, 2u );
+   BOOST_CHECK_EQUAL( stats.size, 2u );
+
+   // k1 is evicted
+   BOOST_CHECK_EQUAL( cache.to_string( k2.get_public_key() ), std::string( k2.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.to_string( k1.get_public_key() ), std::string( k1.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.get_stats().misses, 4u );
+
+   const auto strings = cache.to_variants( vector<public_key_type>{ k1.get_public_key(), k2.get_public_key() } );
+   BOOST_REQUIRE_EQUAL( strings.size(), 2u );
+   BOOST_CHECK_EQUAL( strings[0].as_string(), std::string( k1.get_public_key() ) );
+   BOOST_CHECK_EQUAL( strings[1].as_string(), std::string( k2.get_public_key() ) );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+   BOOST_CHECK_EQUAL( cache.to_string( s1 ), std::string( s1 ) );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+
+   cache.set_capacity( orig_capacity );
+   cache.clear();
+}
+
+BOOST_AUTO_TEST_CASE(abi_serializer_cache_test) { try {
+   static const char* hi_abi = R"=====({
+      "version": "eosio::abi/1.0",
+      "structs": [{ "name": "hi", "base": "", "fields": [{ "name": "user", "type": "name" }] }],
+      "actions": [{ "name": "hi", "type": "hi", "ricardian_contract": "" }]
+   })=====";
+   static const char* bye_abi = R"=====({
+      "version": "eosio::abi/1.0",
+      "structs": [{ "name": "bye", "base": "", "fields": [{ "name": "user", "type": "name" }] }],
+      "actions": [{ "name": "bye", "type": "bye", "ricardian_contract": "" }]
+   })=====";
+
+   tester t;
+   t.create_accounts( {N(alice), N(bob)} );
+   const auto& db = t.control->db();
+   const auto max_time = tester::abi_serializer_max_time;
+
+   auto& cache = abi_serializer_cache::instance();
+   cache.clear();
+   const auto orig_capacity = cache.get_stats().capacity;
+   cache.set_capacity( 1 );
+
+   BOOST_CHECK( !cache.get( db, N(alice), max_time ) );
+   BOOST_CHECK( !cache.get( db, N(nobody), max_time ) );
+
+   t.set_abi( N(alice), hi_abi );
+   auto hi = cache.get( db, N(alice), max_time );
+   BOOST_REQUIRE( hi );
+   BOOST_CHECK_EQUAL( hi->get_action_type( N(hi) ), "hi" );
+   BOOST_CHECK( cache.get( db, N(alice), max_time ) == hi );
+
+   // a new abi bumps abi_sequence
+   t.set_abi( N(alice), bye_abi );
+   auto bye = cache.get( db, N(alice), max_time );
+   BOOST_REQUIRE( bye && bye != hi );
+   BOOST_CHECK_EQUAL( bye->get_action_type( N(bye) ), "bye" );
+   BOOST_CHECK( bye->get_action_type( N(hi) ).empty() );
+   // serializers handed out stay usable after being replaced
+   BOOST_CHECK_EQUAL( hi->get_action_type( N(hi) ), "hi" );
+
+   // alice is evicted
+   t.set_abi( N(bob), hi_abi );
+   BOOST_REQUIRE( cache.get( db, N(bob), max_time ) );
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.size, 1u );
+   BOOST_CHECK( cache.get( db, N(alice), max_time ) != bye );
+   stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 1u );
+   BOOST_CHECK_EQUAL( stats.misses, 4u );
+
+   // the abi of the same sequence on another chain is not mixed up
+   tester other;
+   other.create_accounts( {N(alice)} );
+   other.set_abi( N(alice), hi_abi );
+   other.produce_block();
+   other.set_abi( N(alice), hi_abi );
+   BOOST_CHECK_EQUAL( cache.get( other.control->db(), N(alice), max_time )->get_action_type( N(hi) ), "hi" );
+   BOOST_CHECK_EQUAL( cache.get( db, N(alice), max_time )->get_action_type( N(bye) ), "bye" );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+   BOOST_CHECK( cache.get( db, N(alice), max_time ) );
+   BOOST_CHECK_EQUAL( cache.get_stats().size, 0u );
+
+   cache.set_capacity( orig_capacity );
+   cache.clear();
+} FC_LOG_AND_RETHROW() }
+
 // test that std::bad_alloc is being thrown
 BOOST_AUTO_TEST_CASE(bad_alloc_test) {
    tester t; // force a controller to be constructed and set the new_handler
@@ -1121,6 +1398,447 @@ BOOST_AUTO_TEST_CASE(bad_alloc_test) {
    BOOST_CHECK( ptr == nullptr );
 }
 
+BOOST_AUTO_TEST_CASE(action_stats_test) { try {
+   action_stats stats( 2 );
+   for( int i = 1; i <= 100; ++i )
+      stats.record( N(alice), N(eosio.token), N(transfer), fc::microseconds( i ), 10, i == 100 );
+   stats.record_notifications( N(eosio.token), N(transfer), 3 );
+   stats.record_notifications( N(eosio.token), N(transfer), 0 );
+   stats.on_accepted_block( 5 );
+
+   auto current = stats.current( 10 );
+   BOOST_REQUIRE_EQUAL( current.first_block, 5u );
+   BOOST_REQUIRE_EQUAL( current.rows.size(), 2u );
+   const auto& alice = current.rows[0];
+   BOOST_REQUIRE_EQUAL( alice.receiver, N(alice) );
+   BOOST_REQUIRE_EQUAL( alice.count, 100u );
+   BOOST_REQUIRE_EQUAL( alice.failures, 1u );
+   BOOST_REQUIRE_EQUAL( alice.total_us, 5050u );
+   BOOST_REQUIRE_EQUAL( alice.max_us, 100u );
+   BOOST_REQUIRE_EQUAL( alice.ram_delta, 1000 );
+   BOOST_REQUIRE_EQUAL( alice.p50_us, 64u );  // the median falls in [32, 64)
+   BOOST_REQUIRE_EQUAL( alice.p99_us, 100u ); // bucket [64, 128) capped at the maximum
+   BOOST_REQUIRE_EQUAL( current.rows[1].receiver, N(eosio.token) );
+   BOOST_REQUIRE_EQUAL( current.rows[1].notifications, 3u );
+   BOOST_REQUIRE_EQUAL( stats.current( 1 ).rows.size(), 1u );
+   BOOST_REQUIRE( stats.completed( 10 ).rows.empty() );
+
+   stats.on_accepted_block( 6 );
+   BOOST_REQUIRE( stats.current( 10 ).rows.empty() );
+   auto completed = stats.completed( 10 );
+   BOOST_REQUIRE_EQUAL( completed.first_block, 5u );
+   BOOST_REQUIRE_EQUAL( completed.last_block, 6u );
+   BOOST_REQUIRE_EQUAL( completed.rows.size(), 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(key256_less_test) { try {
+   boost::random::mt19937 rng( 0x5eed );
+   const auto random128 = [&]() {
+      uint128_t v = 0;
+      for( int i = 0; i < 4; ++i ) v = (v << 32) | rng();
+      return v;
+   };
+   const uint128_t max = std::numeric_limits<uint128_t>::max();
+   // equal high words are the case the low word decides
+   const std::vector<uint128_t> words = { 0, 1, max - 1, max, uint128_t(1) << 64, uint128_t(1) << 127, random128() };
+   std::vector<key256_t> keys;
+   for( auto a : words )
+      for( auto b : words )
+         keys.push_back( key256_t{ a, b } );
+   for( int i = 0; i < 100; ++i )
+      keys.push_back( key256_t{ rng() % 2 ? words[rng() % words.size()] : random128(), random128() } );
+
+   for( const auto& a : keys )
+      for( const auto& b : keys )
+         BOOST_REQUIRE_EQUAL( key256_less()( a, b ), std::less<key256_t>()( a, b ) );
+} FC_LOG_AND_RETHROW() }
+
+// differential fuzz of the hardware fast path of the softfloat intrinsics
+BOOST_AUTO_TEST_CASE(native_float_matches_softfloat_test) { try {
+   boost::random::mt19937 rng( 0x5eed );
+   // uniform bit patterns rarely reach subnormals, infinities and cancellation, so bias towards them
+   const auto random64 = [&]() { return (uint64_t( rng() ) << 32) | rng(); };
+   const auto f32_operand = [&]( uint32_t other ) -> uint32_t {
+      uint32_t v = rng();
+      switch( rng() % 4 ) {
+         case 0: return v & 0x807FFFFF;                           // zero or subnormal
+         case 1: return (v & 0x807FFFFF) | (rng() % 2 ? 0x7F000000 : 0x00800000); // largest or smallest normal exponent
+         case 2: return other ^ (v & 0x800000FF);                 // close to the other operand
+         default: return v;
+      }
+   };
+   const auto f64_operand = [&]( uint64_t other ) -> uint64_t {
+      uint64_t v = random64();
+      switch( rng() % 4 ) {
+         case 0: return v & 0x800FFFFFFFFFFFFFull;
+         case 1: return (v & 0x800FFFFFFFFFFFFFull) | (rng() % 2 ? 0x7FE0000000000000ull : 0x0010000000000000ull);
+         case 2: return other ^ (v & 0x80000000000000FFull);
+         default: return v;
+      }
+   };
+   const auto as_float  = []( uint32_t v ) { float f;  memcpy( &f, &v, sizeof(f) ); return f; };
+   const auto as_double = []( uint64_t v ) { double d; memcpy( &d, &v, sizeof(d) ); return d; };
+   const auto bits32    = []( float f )    { uint32_t v; memcpy( &v, &f, sizeof(v) ); return v; };
+   const auto bits64    = []( double d )   { uint64_t v; memcpy( &v, &d, sizeof(v) ); return v; };
+
+   uint64_t native = 0, mismatches = 0;
+   const auto check32 = [&]( bool computed, float r, float32_t expected ) {
+      if( !computed ) return;
+      ++native;
+      if( bits32( r ) != expected.v ) ++mismatches;
+   };
+   const auto check64 = [&]( bool computed, double r, float64_t expected ) {
+      if( !computed ) return;
+      ++native;
+      if( bits64( r ) != expected.v ) ++mismatches;
+   };
+
+   for( int i = 0; i < 200000; ++i ) {
+      const uint32_t a32 = rng(), b32 = f32_operand( a32 );
+      const float a = as_float( a32 ), b = as_float( b32 );
+      const float32_t sa{a32}, sb{b32};
+      float r;
+      check32( native_float::compute( r, [&]{ return a + b; } ), r, f32_add( sa, sb ) );
+      check32( native_float::compute( r, [&]{ return a - b; } ), r, f32_sub( sa, sb ) );
+      check32( native_float::compute( r, [&]{ return a * b; } ), r, f32_mul( sa, sb ) );
+      check32( native_float::compute( r, [&]{ return a / b; } ), r, f32_div( sa, sb ) );
+      check32( native_float::compute( r, [&]{ return std::sqrt( b ); } ), r, f32_sqrt( sb ) );
+
+      const uint64_t a64 = random64(), b64 = f64_operand( a64 );
+      const double c = as_double( a64 ), d = as_double( b64 );
+      const float64_t sc{a64}, sd{b64};
+      double q;
+      check64( native_float::compute( q, [&]{ return c + d; } ), q, f64_add( sc, sd ) );
+      check64( native_float::compute( q, [&]{ return c - d; } ), q, f64_sub( sc, sd ) );
+      check64( native_float::compute( q, [&]{ return c * d; } ), q, f64_mul( sc, sd ) );
+      check64( native_float::compute( q, [&]{ return c / d; } ), q, f64_div( sc, sd ) );
+      check64( native_float::compute( q, [&]{ return std::sqrt( d ); } ), q, f64_sqrt( sd ) );
+
+      check64( native_float::compute( q, [&]{ return double( b ); } ), q, f32_to_f64( sb ) );
+      check32( native_float::compute( r, [&]{ return float( d ); } ), r, f64_to_f32( sd ) );
+
+      const uint64_t n = random64() >> (rng() % 64);
+      check32( native_float::compute( r, [&]{ return float( int32_t( n ) ); } ), r, i32_to_f32( int32_t( n ) ) );
+      check32( native_float::compute( r, [&]{ return float( int64_t( n ) ); } ), r, i64_to_f32( int64_t( n ) ) );
+      check32( native_float::compute( r, [&]{ return float( uint32_t( n ) ); } ), r, ui32_to_f32( uint32_t( n ) ) );
+      check32( native_float::compute( r, [&]{ return float( n ); } ), r, ui64_to_f32( n ) );
+      check64( native_float::compute( q, [&]{ return double( int32_t( n ) ); } ), q, i32_to_f64( int32_t( n ) ) );
+      check64( native_float::compute( q, [&]{ return double( int64_t( n ) ); } ), q, i64_to_f64( int64_t( n ) ) );
+      check64( native_float::compute( q, [&]{ return double( uint32_t( n ) ); } ), q, ui32_to_f64( uint32_t( n ) ) );
+      check64( native_float::compute( q, [&]{ return double( n ); } ), q, ui64_to_f64( n ) );
+   }
+
+   BOOST_TEST_MESSAGE( native << " results computed in hardware" );
+   BOOST_REQUIRE_EQUAL( mismatches, 0u );
+#ifdef EOSIO_NATIVE_FLOAT_ENABLED
+   BOOST_REQUIRE_GT( native, 0u );
+#endif
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(copy_on_write_test) { try {
+   producer_authority_schedule sched{ 1, { producer_authority{ N(proda), block_signing_authority_v0{ 1, {{base_tester::get_public_key(N(proda), "active"), 1}} } } } };
+
+   detail::schedule_info a;
+   a.schedule = sched;
+   detail::schedule_info b = a;
+   BOOST_REQUIRE( b.schedule.shares_with( a.schedule ) );
+
+   b.schedule.mutate().version = 2;
+   BOOST_REQUIRE( !b.schedule.shares_with( a.schedule ) );
+   BOOST_REQUIRE_EQUAL( a.schedule->version, 1u );
+   BOOST_REQUIRE_EQUAL( b.schedule->version, 2u );
+
+   // packs like the plain schedule
+   BOOST_REQUIRE( fc::raw::pack( a.schedule ) == fc::raw::pack( sched ) );
+   auto unpacked = fc::raw::unpack<detail::schedule_info>( fc::raw::pack( a ) );
+   BOOST_REQUIRE( *unpacked.schedule == sched );
+   BOOST_REQUIRE_EQUAL( fc::json::to_string( fc::variant( a.schedule ), fc::time_point::maximum() ),
+                        fc::json::to_string( fc::variant( sched ), fc::time_point::maximum() ) );
+
+   // default constructed values share an instance that is never modified
+   detail::shared_schedule c, d;
+   c.mutate().version = 3;
+   BOOST_REQUIRE_EQUAL( d->version, 0u );
+   BOOST_REQUIRE_EQUAL( detail::shared_schedule()->version, 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(access_list_test) { try {
+   flat_set<account_name> entries;
+   for( uint64_t i = 0; i < 5000; ++i ) entries.insert( name( i * 7919 + 1 ) );
+
+   access_list<account_name> list;
+   BOOST_REQUIRE( list.empty() );
+   BOOST_REQUIRE( !list.contains( name(1) ) );
+   list.reset( entries );
+   BOOST_REQUIRE( !list.empty() );
+
+   for( const auto& e : entries ) BOOST_REQUIRE( list.contains( e ) );
+   uint64_t absent = 0;
+   for( uint64_t i = 0; i < 5000; ++i ) {
+      const name n( i * 7919 + 2 );
+      BOOST_REQUIRE( !list.contains( n ) );
+      ++absent;
+   }
+
+   auto stats = list.get_stats();
+   BOOST_REQUIRE_EQUAL( stats.entries, entries.size() );
+   BOOST_REQUIRE_EQUAL( stats.checks, entries.size() + absent );
+   BOOST_REQUIRE_EQUAL( stats.matches, entries.size() );
+   // the filter must reject the bulk of the values which are not on the list
+   BOOST_REQUIRE_GT( stats.prefiltered, absent * 9 / 10 );
+
+   access_list<pair<account_name, action_name>> actions;
+   actions.reset( { { N(eosio.token), N(transfer) } } );
+   BOOST_REQUIRE( actions.contains( std::make_pair( N(eosio.token), N(transfer) ) ) );
+   BOOST_REQUIRE( !actions.contains( std::make_pair( N(eosio.token), N(issue) ) ) );
+   BOOST_REQUIRE_EQUAL( actions.get_stats().checks, 2u );
+
+   list.reset( {} );
+   BOOST_REQUIRE( list.empty() );
+   BOOST_REQUIRE_EQUAL( list.get_stats().checks, 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(eosvmoc_code_artifact_test) { try {
+   eosvmoc::code_artifact artifact;
+   artifact.target = "llvm-8.0.1 x86_64-pc-linux-gnu 0123456789abcdef";
+   artifact.code = eosvmoc::code_tuple{ fc::sha256::hash( string("code") ), 0 };
+   artifact.start = eosvmoc::code_offset{ 16 };
+   artifact.apply_offset = 32;
+   artifact.machine_code.assign( 64, '\xcc' );
+   artifact.initdata.assign( 8, 0 );
+   artifact.checksum = artifact.compute_checksum();
+
+   auto copy = fc::raw::unpack<eosvmoc::code_artifact>( fc::raw::pack( artifact ) );
+   BOOST_REQUIRE( copy.checksum == copy.compute_checksum() );
+   BOOST_REQUIRE( copy.start.get<eosvmoc::code_offset>().offset == 16u );
+
+   copy.machine_code[3] = 0;
+   BOOST_REQUIRE( copy.checksum != copy.compute_checksum() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(transaction_tracing_test) { try {
+   fc::temp_directory tempdir;
+   const auto file = tempdir.path() / "traces.json";
+   auto& tracing = transaction_tracing::instance();
+   tracing.configure( 1, file );
+
+   const auto id = fc::sha256::hash( std::string( "trx" ) );
+   auto trace = tracing.begin( id, "http" );
+   BOOST_REQUIRE( trace );
+   BOOST_REQUIRE( tracing.begin( id, "p2p" ) == trace );
+   trace->step( "recover_keys" );
+   trace->step( "execute" );
+   tracing.end( id, "included" );
+   BOOST_REQUIRE( !tracing.find( id ) );
+   tracing.shutdown();
+
+   std::ifstream in( file.generic_string() );
+   std::string line;
+   BOOST_REQUIRE( std::getline( in, line ) );
+   const auto spans = fc::json::from_string( line )["resourceSpans"][size_t(0)]["scopeSpans"][size_t(0)]["spans"].get_array();
+   BOOST_REQUIRE_EQUAL( spans.size(), 3u );
+   BOOST_REQUIRE_EQUAL( spans[0]["name"].as_string(), "transaction" );
+   BOOST_REQUIRE_EQUAL( spans[0]["traceId"].as_string(), fc::to_hex( id.data(), 16 ) );
+   BOOST_REQUIRE_EQUAL( spans[2]["name"].as_string(), "execute" );
+   BOOST_REQUIRE_EQUAL( spans[2]["parentSpanId"].as_string(), spans[0]["spanId"].as_string() );
+   BOOST_REQUIRE( !std::getline( in, line ) );
+
+   tracing.configure( 0, file );
+   BOOST_REQUIRE( !tracing.begin( id, "http" ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(metrics_registry_test) { try {
+   auto& r = metrics::registry::instance();
+
+   auto& c = r.get_counter( "test_metrics_counter_total", "a counter", metrics::registry::label( "kind", "a\"b" ) );
+   BOOST_REQUIRE_EQUAL( &c, &r.get_counter( "test_metrics_counter_total", "a counter", metrics::registry::label( "kind", "a\"b" ) ) );
+   std::vector<std::thread> threads;
+   for( int t = 0; t < 4; ++t )
+      threads.emplace_back( [&c]() { for( int i = 0; i < 1000; ++i ) c.add(); } );
+   for( auto& t : threads ) t.join();
+   BOOST_REQUIRE_EQUAL( c.value(), 4000u );
+
+   r.get_gauge( "test_metrics_gauge", "a gauge" ).set( -5 );
+   auto& h = r.get_histogram( "test_metrics_histogram", "a histogram", { 10, 100 } );
+   h.record( 5 );
+   h.record( 10 );
+   h.record( 50 );
+   h.record( 500 );
+   BOOST_CHECK_THROW( r.get_gauge( "test_metrics_counter_total", "not a gauge" ), misc_exception );
+
+   const auto text = r.prometheus_text( "test_metrics_" );
+   BOOST_REQUIRE_EQUAL( text,
+      "# HELP test_metrics_counter_total a counter\n"
+      "# TYPE test_metrics_counter_total counter\n"
+      "test_metrics_counter_total{kind=\"a\\\"b\"} 4000\n"
+      "# HELP test_metrics_gauge a gauge\n"
+      "# TYPE test_metrics_gauge gauge\n"
+      "test_metrics_gauge -5\n"
+      "# HELP test_metrics_histogram a histogram\n"
+      "# TYPE test_metrics_histogram histogram\n"
+      "test_metrics_histogram_bucket{le=\"10\"} 2\n"
+      "test_metrics_histogram_bucket{le=\"100\"} 3\n"
+      "test_metrics_histogram_bucket{le=\"+Inf\"} 4\n"
+      "test_metrics_histogram_sum 565\n"
+      "test_metrics_histogram_count 4\n" );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(memory_accounting_test) { try {
+   memory_accounting::subsystem s( "test_memory" );
+   BOOST_REQUIRE_EQUAL( s.live_bytes(), 0 );
+   {
+      memory_accounting::tracked_bytes a( s, 100 );
+      memory_accounting::tracked_bytes b( s, 20 );
+      BOOST_REQUIRE_EQUAL( s.live_bytes(), 120 );
+
+      memory_accounting::tracked_bytes moved( std::move( a ) );
+      BOOST_REQUIRE_EQUAL( a.bytes(), 0u );
+      BOOST_REQUIRE_EQUAL( moved.bytes(), 100u );
+      BOOST_REQUIRE_EQUAL( s.live_bytes(), 120 );
+
+      moved = std::move( b ); // frees the 100 bytes it held
+      BOOST_REQUIRE_EQUAL( s.live_bytes(), 20 );
+   }
+   BOOST_REQUIRE_EQUAL( s.live_bytes(), 0 );
+   BOOST_REQUIRE_EQUAL( s.allocated_bytes(), 120u );
+
+   s.allocated( 8 );
+   s.freed( 8 );
+   BOOST_REQUIRE_EQUAL( s.live_bytes(), 0 );
+   BOOST_REQUIRE_EQUAL( s.allocated_bytes(), 128u );
+
+   const auto text = metrics::registry::instance().prometheus_text( "nodeos_memory_" );
+   BOOST_REQUIRE( text.find( "nodeos_memory_allocated_bytes_total{subsystem=\"test_memory\"} 128\n" ) != std::string::npos );
+
+   const auto usage = memory_accounting::get_usage();
+   BOOST_REQUIRE( usage.enabled );
+   BOOST_REQUIRE_EQUAL( usage.subsystems.size(), 5u );
+   BOOST_REQUIRE_EQUAL( usage.subsystems[0].name, "net_buffers" );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(adaptive_block_timing_test) { try {
+   adaptive_block_timing timing;
+   timing.record_latency( N(next), 100000 );
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(next), -5000 ), -5000 );
+
+   timing.configure( true, -250000, 0, 10000 );
+   // the static offset until blocks of the next producer are measured
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(next), -5000 ), -5000 );
+   timing.record_latency( N(next), 100000 );
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(next), -5000 ), -250000 ); // 100ms + 4 * 50ms deviation, clamped
+   for( int i = 0; i < 40; ++i )
+      timing.record_latency( N(next), 100000 );
+   const auto steady = timing.last_block_offset_us( N(next), -5000 );
+   BOOST_REQUIRE_LE( steady, -110000 );
+   BOOST_REQUIRE_GE( steady, -111000 );
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(other), -5000 ), -5000 );
+
+   // a missed handoff moves the deadline earlier, received ones bring it back
+   timing.record_handoff( false );
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(next), -5000 ), steady - adaptive_block_timing::missed_handoff_penalty_us );
+   for( int i = 0; i < 100; ++i )
+      timing.record_handoff( true );
+   BOOST_REQUIRE_GE( timing.last_block_offset_us( N(next), -5000 ), steady - 10 );
+
+   // a slow block moves it up at once
+   timing.record_latency( N(next), 400000 );
+   BOOST_REQUIRE_EQUAL( timing.last_block_offset_us( N(next), -5000 ), -250000 );
+
+   // within the bounds, however given
+   adaptive_block_timing early;
+   early.configure( true, 0, -20000, 0 );
+   early.record_latency( N(next), -100000 );
+   BOOST_REQUIRE_EQUAL( early.last_block_offset_us( N(next), -5000 ), -20000 );
+} FC_LOG_AND_RETHROW() }
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+BOOST_AUTO_TEST_CASE(eosvmoc_memory_reset_test) { try {
+   eosvmoc::memory mem;
+   constexpr uint64_t page = 64*1024;
+   auto dirty = [&]( uint64_t pages ) {
+      for( uint64_t p = 0; p < pages; ++p ) mem.full_page_memory_base()[p*page + p] = 1;
+      mem.mark_dirty( pages );
+   };
+   auto all_zero = [&]( uint64_t pages ) {
+      return std::all_of( mem.full_page_memory_base(), mem.full_page_memory_base() + pages*page, []( uint8_t b ) { return b == 0; } );
+   };
+
+   // cleared by writing
+   dirty( 4 );
+   mem.reset( 4 );
+   BOOST_REQUIRE( all_zero( 4 ) );
+
+   // released, including the pages beyond those reset which an earlier execution grew into
+   const uint64_t large = 2*eosvmoc::memory::release_threshold/page;
+   dirty( large + 8 );
+   mem.reset( large );
+   BOOST_REQUIRE( all_zero( large + 8 ) );
+
+   // pages past those reset and never released are left to grow_memory to clear
+   dirty( 8 );
+   mem.reset( 2 );
+   BOOST_REQUIRE( all_zero( 2 ) );
+   BOOST_REQUIRE_EQUAL( mem.full_page_memory_base()[2*page + 2], 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(eosvmoc_compile_queue_test) { try {
+   auto code = []( const char* name ) { return eosvmoc::code_tuple{ fc::sha256::hash( string(name) ), 0 }; };
+   eosvmoc::compile_queue queue;
+   for( const char* name : { "a", "b", "c", "d", "b" } )
+      queue.push( code(name) );
+   BOOST_REQUIRE_EQUAL( queue.size(), 4u );
+
+   // interpreter time first, then executions, then the order queued
+   queue.record_interpreted_execution( code("c"), fc::microseconds(300) );
+   queue.record_interpreted_execution( code("b"), fc::microseconds(100) );
+   queue.record_interpreted_execution( code("b"), fc::microseconds(200) );
+   queue.record_interpreted_execution( code("d"), fc::microseconds(-5) );
+   queue.record_interpreted_execution( code("e"), fc::microseconds(1000) );
+   BOOST_REQUIRE( !queue.contains( code("e") ) );
+
+   // dropped code loses its hotness when queued again
+   queue.push( code("f") );
+   queue.record_interpreted_execution( code("f"), fc::microseconds(1000) );
+   BOOST_REQUIRE( queue.erase( code("f") ) );
+   BOOST_REQUIRE( !queue.erase( code("f") ) );
+   queue.push( code("f") );
+
+   vector<eosvmoc::code_tuple> order;
+   while( !queue.empty() ) {
+      order.push_back( queue.front() );
+      queue.pop_front();
+   }
+   const vector<eosvmoc::code_tuple> expected = { code("b"), code("c"), code("d"), code("a"), code("f") };
+   BOOST_REQUIRE( order == expected );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(eosvmoc_hot_codes_test) { try {
+   fc::temp_directory tempdir;
+   const auto file = tempdir.path() / "hot_codes.bin";
+   auto code = []( const char* name ) { return eosvmoc::code_tuple{ fc::sha256::hash( string(name) ), 0 }; };
+   using codes = vector<eosvmoc::code_tuple>;
+
+   // most executed first, then the previous run's codes not executed in this one
+   auto ranked = eosvmoc::rank_hot_codes( { {code("a"), 5}, {code("b"), 50}, {code("c"), 1} }, { code("d"), code("a"), code("e") }, 4 );
+   BOOST_REQUIRE( ranked == codes({ code("b"), code("a"), code("c"), code("d") }) );
+
+   eosvmoc::write_hot_codes( file, ranked );
+   BOOST_REQUIRE( eosvmoc::read_hot_codes( file, 4 ) == ranked );
+   BOOST_REQUIRE( eosvmoc::read_hot_codes( file, 2 ) == codes({ code("b"), code("a") }) );
+
+   // a short next run keeps what it did not execute
+   auto next = eosvmoc::rank_hot_codes( { {code("d"), 3} }, eosvmoc::read_hot_codes( file, 4 ), 4 );
+   BOOST_REQUIRE( next == codes({ code("d"), code("b"), code("a"), code("c") }) );
+
+   eosvmoc::write_hot_codes( file, {} );
+   BOOST_REQUIRE( eosvmoc::read_hot_codes( file, 4 ).empty() );
+
+   const auto data = fc::raw::pack( ranked );
+   std::ofstream( file.generic_string(), std::ofstream::binary | std::ofstream::trunc ).write( data.data(), data.size() / 2 );
+   BOOST_REQUIRE_THROW( eosvmoc::read_hot_codes( file, 4 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
@@ -237,6 +237,56 @@ BOOST_AUTO_TEST_SUITE(resource_limits_test)
 
    } FC_LOG_AND_RETHROW();
 
+   BOOST_FIXTURE_TEST_CASE(pending_usage_sessions, resource_limits_fixture) try {
+      const account_name account(1);
+      initialize_account(account);
+      set_account_limits(account, -1, -1, 1 );
+      process_account_limit_updates();
+
+      const uint64_t increment = 1000;
+      const uint64_t initial_block_cpu = get_block_cpu_limit();
+
+      {  // undone usage is forgotten
+         auto s = start_usage_session();
+         add_transaction_usage({account}, increment, 0, 0);
+         BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), initial_block_cpu - increment);
+         s.undo();
+      }
+      BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), initial_block_cpu);
+      BOOST_REQUIRE_EQUAL(get_account_cpu_limit_ex(account).first.used, 0);
+
+      {  // nested sessions behave like undo sessions, destroying a session undoes it
+         auto outer = start_usage_session();
+         {
+            auto inner = start_usage_session();
+            add_transaction_usage({account}, increment, 0, 0);
+            inner.squash();
+         }
+         {
+            auto inner = start_usage_session();
+            add_transaction_usage({account}, increment, 0, 0);
+         }
+         BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), initial_block_cpu - increment);
+         outer.squash();
+      }
+      BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), initial_block_cpu - increment);
+
+      const auto used = get_account_cpu_limit_ex(account).first.used;
+      BOOST_REQUIRE(used > 0);
+
+      // usage is written to the database and the block usage reset
+      process_block_usage(0);
+      BOOST_REQUIRE_EQUAL(get_account_cpu_limit_ex(account).first.used, used);
+      BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), config::default_max_block_cpu_usage);
+
+      // sessions must be ended in reverse order
+      auto a = start_usage_session();
+      auto b = start_usage_session();
+      BOOST_REQUIRE_THROW(a.squash(), resource_limit_exception);
+      b.undo();
+      a.undo();
+   } FC_LOG_AND_RETHROW();
+
    BOOST_FIXTURE_TEST_CASE(enforce_account_ram_limit, resource_limits_fixture) try {
       const uint64_t limit = 1000;
       const uint64_t increment = 77;
@@ -257,6 +307,19 @@ BOOST_AUTO_TEST_SUITE(resource_limits_test)
       BOOST_REQUIRE_THROW(verify_account_ram_usage(account), ram_usage_exceeded);
    } FC_LOG_AND_RETHROW();
 
+   BOOST_FIXTURE_TEST_CASE(enforce_account_ram_limit_combined, resource_limits_fixture) try {
+      const account_name account(1);
+      initialize_account(account);
+      set_account_limits(account, 1000, -1, -1 );
+      process_account_limit_updates();
+
+      add_pending_ram_usage(account, 1000, true);
+      BOOST_REQUIRE_EQUAL(get_account_ram_usage(account), 1000);
+      // a zero delta is still verified
+      add_pending_ram_usage(account, 0, true);
+      BOOST_REQUIRE_THROW(add_pending_ram_usage(account, 1, true), ram_usage_exceeded);
+   } FC_LOG_AND_RETHROW();
+
    BOOST_FIXTURE_TEST_CASE(enforce_account_ram_limit_underflow, resource_limits_fixture) try {
       const account_name account(1);
       initialize_account(account);
@@ -1,10 +1,21 @@
+#include <atomic>
+#include <fstream>
 #include <sstream>
+#include <thread>
 
+#include <eosio/chain/account_bloom_index.hpp>
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/reversible_block_log.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/trx_block_index.hpp>
 #include <eosio/testing/tester.hpp>
 
+#include <fc/variant_object.hpp>
+
 #include <boost/mpl/list.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -78,4 +89,542 @@ BOOST_AUTO_TEST_CASE(test_restart_with_different_chain_id)
    BOOST_REQUIRE_EXCEPTION(other.open(chain_id), chain_id_type_exception, fc_exception_message_starts_with("chain ID in state "));
 }
 
+BOOST_AUTO_TEST_CASE(test_idx256_rows_survive_restart)
+{
+   // chainbase finds the index of an existing state database by the name of its objects, which must not change with
+   // the comparator of the index
+   static_assert( std::is_same<index256_object, secondary_index<key256_t,index256_object_type>::index_object>::value,
+                  "idx256 objects must keep their type" );
+
+   tester chain;
+   chain.create_account( N(testapi) );
+   chain.produce_block();
+   chain.set_code( N(testapi), contracts::test_api_db_wasm() );
+   chain.set_abi( N(testapi), contracts::test_api_db_abi().data() );
+   chain.produce_block();
+   // stores an idx256 row with primary key 1
+   chain.push_action( N(testapi), N(sk32align), N(testapi), fc::mutable_variant_object() );
+   chain.produce_blocks(2);
+
+   const auto idx256_rows = [&chain]() {
+      vector<uint64_t> rows;
+      for( const auto& o : chain.control->db().get_index<index256_index, by_secondary>() )
+         rows.push_back( o.primary_key );
+      return rows;
+   };
+   BOOST_REQUIRE_EQUAL( idx256_rows().size(), 1u );
+
+   chain.close();
+   chain.open();
+   const auto rows = idx256_rows();
+   BOOST_REQUIRE_EQUAL( rows.size(), 1u );
+   BOOST_REQUIRE_EQUAL( rows[0], 1u );
+   chain.produce_block();
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_prefetcher)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log blog(cfg.blocks_dir);
+   const uint32_t head_num = blog.head()->block_num();
+   BOOST_REQUIRE(head_num > 10);
+
+   named_thread_pool pool("pftest", 2);
+   std::atomic<uint32_t> decoded{0};
+   // a queue much smaller than the range exercises the reader waiting on the consumer
+   block_log_prefetcher prefetcher(cfg.blocks_dir, blog.first_block_num(), 3, head_num, 2, pool.get_executor(),
+                                   [&decoded](const signed_block_ptr&) { ++decoded; });
+   uint32_t expected = 3;
+   while (auto b = prefetcher.next()) {
+      BOOST_REQUIRE_EQUAL(b->block_num(), expected);
+      BOOST_REQUIRE(b->id() == blog.read_block_by_num(expected)->id());
+      ++expected;
+   }
+   BOOST_REQUIRE_EQUAL(expected, head_num + 1);
+   BOOST_REQUIRE_EQUAL(decoded.load(), head_num - 2);
+   BOOST_REQUIRE(!prefetcher.next());
+
+   // stopping before the range is consumed must not block
+   block_log_prefetcher partial(cfg.blocks_dir, blog.first_block_num(), 1, head_num, 1, pool.get_executor());
+   BOOST_REQUIRE_EQUAL(partial.next()->block_num(), 1u);
+   partial.stop();
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_block_log)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   fc::temp_directory tempdir;
+   const auto compressed_dir = tempdir.path() / "compressed";
+   const auto uncompressed_dir = tempdir.path() / "uncompressed";
+
+   block_log::convert_log(cfg.blocks_dir, compressed_dir, true);
+   BOOST_REQUIRE_THROW(block_log::convert_log(cfg.blocks_dir, compressed_dir, true), block_log_exception);
+   {
+      block_log original(cfg.blocks_dir);
+      block_log compressed(compressed_dir);
+      BOOST_REQUIRE(!original.is_compressed());
+      BOOST_REQUIRE(compressed.is_compressed());
+      BOOST_REQUIRE_EQUAL(compressed.version(), block_log::compressed_version);
+      BOOST_REQUIRE(compressed.head_id() == original.head_id());
+      const uint32_t head_num = original.head()->block_num();
+      for (uint32_t n = original.first_block_num(); n <= head_num; ++n) {
+         BOOST_REQUIRE(compressed.read_block_by_num(n)->id() == original.read_block_by_num(n)->id());
+         BOOST_REQUIRE(compressed.read_block_id_by_num(n) == original.read_block_id_by_num(n));
+      }
+
+      named_thread_pool pool("cmptest", 1);
+      block_log_prefetcher prefetcher(compressed_dir, compressed.first_block_num(), 1, head_num, 4, pool.get_executor());
+      uint32_t expected = 1;
+      while (auto b = prefetcher.next()) {
+         BOOST_REQUIRE_EQUAL(b->block_num(), expected++);
+      }
+      BOOST_REQUIRE_EQUAL(expected, head_num + 1);
+   }
+
+   // the index of a compressed log can be rebuilt from the block positions
+   fc::remove(compressed_dir / "blocks.index");
+   {
+      block_log compressed(compressed_dir);
+      BOOST_REQUIRE(compressed.read_block_by_num(7)->block_num() == 7u);
+      trim_data td(compressed_dir);
+      BOOST_REQUIRE_EQUAL(td.read_block_num(td.block_pos(td.last_block)), td.last_block);
+   }
+
+   // converting back gives the original log
+   block_log::convert_log(compressed_dir, uncompressed_dir, false);
+   std::ifstream original_file((cfg.blocks_dir / "blocks.log").generic_string(), std::ios::binary);
+   std::ifstream uncompressed_file((uncompressed_dir / "blocks.log").generic_string(), std::ios::binary);
+   std::string original_data((std::istreambuf_iterator<char>(original_file)), std::istreambuf_iterator<char>());
+   std::string uncompressed_data((std::istreambuf_iterator<char>(uncompressed_file)), std::istreambuf_iterator<char>());
+   BOOST_REQUIRE(original_data == uncompressed_data);
+
+   // an existing compressed log keeps being written compressed
+   const uint32_t converted_head_num = block_log(compressed_dir).head()->block_num();
+   remove_existing_blocks(cfg);
+   fc::copy(compressed_dir / "blocks.log", cfg.blocks_dir / "blocks.log");
+   fc::copy(compressed_dir / "blocks.index", cfg.blocks_dir / "blocks.index");
+   chain.open();
+   chain.produce_blocks(5);
+   chain.close();
+   block_log appended(cfg.blocks_dir);
+   BOOST_REQUIRE(appended.is_compressed());
+   BOOST_REQUIRE(appended.head()->block_num() > converted_head_num);
+   for (uint32_t n = appended.first_block_num(); n <= appended.head()->block_num(); ++n) {
+      BOOST_REQUIRE_EQUAL(appended.read_block_by_num(n)->block_num(), n);
+   }
+}
+
+BOOST_AUTO_TEST_CASE(test_partitioned_block_log)
+{
+   tester chain;
+   chain.produce_blocks(45);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log source(cfg.blocks_dir);
+   const uint32_t head_num = source.head()->block_num();
+   BOOST_REQUIRE(head_num > 40);
+
+   fc::temp_directory tempdir;
+   const auto blocks_dir = tempdir.path() / "blocks";
+   block_log_partition_config partitions;
+   partitions.stride = 10;
+   partitions.max_retained_files = 2;
+   partitions.retained_dir = "retained";
+   partitions.archive_dir = tempdir.path() / "archive";
+
+   const auto verify = [&](const block_log& blog) {
+      BOOST_REQUIRE_EQUAL(blog.first_block_num(), 21u);
+      BOOST_REQUIRE_EQUAL(blog.log_first_block_num(), 41u);
+      BOOST_REQUIRE(blog.head_id() == source.head_id());
+      BOOST_REQUIRE(!blog.read_block_by_num(20));
+      BOOST_REQUIRE(blog.read_serialized_block_by_num(20).empty());
+      for (uint32_t n = 21; n <= head_num; ++n) {
+         BOOST_REQUIRE(blog.read_block_by_num(n)->id() == source.read_block_id_by_num(n));
+         BOOST_REQUIRE(blog.read_block_id_by_num(n) == source.read_block_id_by_num(n));
+         BOOST_REQUIRE(blog.read_serialized_block_by_num(n) == source.read_serialized_block_by_num(n));
+      }
+   };
+   {
+      block_log blog(blocks_dir, false, partitions);
+      blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), source.read_block_by_num(1));
+      for (uint32_t n = 2; n <= head_num; ++n)
+         blog.append(source.read_block_by_num(n));
+      verify(blog);
+   }
+   BOOST_REQUIRE(fc::exists(blocks_dir / "retained" / "blocks-21-30.log"));
+   BOOST_REQUIRE(fc::exists(blocks_dir / "retained" / "blocks-31-40.index"));
+   BOOST_REQUIRE(fc::exists(partitions.archive_dir / "blocks-1-10.log"));
+   BOOST_REQUIRE(fc::exists(partitions.archive_dir / "blocks-11-20.index"));
+
+   // reopening finds the retained partitions
+   verify(block_log(blocks_dir, false, partitions));
+
+   // the head is the last block of the newest partition while blocks.log holds no block yet
+   const auto split_dir = tempdir.path() / "split";
+   {
+      block_log blog(split_dir, false, partitions);
+      blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), source.read_block_by_num(1));
+      for (uint32_t n = 2; n <= 30; ++n)
+         blog.append(source.read_block_by_num(n));
+   }
+   {
+      block_log blog(split_dir, false, partitions);
+      BOOST_REQUIRE_EQUAL(blog.head()->block_num(), 30u);
+      BOOST_REQUIRE_EQUAL(blog.log_first_block_num(), 31u);
+      blog.append(source.read_block_by_num(31));
+      BOOST_REQUIRE(blog.read_block_by_num(30)->id() == source.read_block_id_by_num(30));
+      BOOST_REQUIRE(blog.read_block_by_num(31)->id() == source.read_block_id_by_num(31));
+   }
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_block_log_reads)
+{
+   tester chain;
+   chain.produce_blocks(45);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log source(cfg.blocks_dir);
+   const uint32_t head_num = source.head()->block_num();
+   vector<signed_block_ptr> blocks(head_num + 1);
+   for (uint32_t n = 1; n <= head_num; ++n)
+      blocks[n] = source.read_block_by_num(n);
+
+   fc::temp_directory tempdir;
+   block_log_partition_config partitions;
+   partitions.stride = 10;
+   block_log blog(tempdir.path(), false, partitions);
+   blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), blocks[1]);
+
+   // readers walk the blocks appended so far while the log grows and splits into partitions
+   std::atomic<uint32_t> appended{1};
+   std::atomic<bool> failed{false};
+   vector<std::thread> readers;
+   for (int i = 0; i < 4; ++i) {
+      readers.emplace_back([&]() {
+         try {
+            for (uint32_t last = 0; last < head_num; ) {
+               last = appended.load();
+               for (uint32_t n = 1; n <= last; ++n) {
+                  if (blog.read_block_id_by_num(n) != blocks[n]->id() ||
+                      blog.read_serialized_block_by_num(n) != fc::raw::pack(*blocks[n]))
+                     failed = true;
+               }
+            }
+         } catch (...) {
+            failed = true;
+         }
+      });
+   }
+   for (uint32_t n = 2; n <= head_num; ++n) {
+      blog.append(blocks[n]);
+      appended = n;
+   }
+   for (auto& t : readers)
+      t.join();
+   BOOST_REQUIRE(!failed);
+   BOOST_REQUIRE(blog.read_block_by_num(head_num)->id() == source.head_id());
+}
+
+BOOST_AUTO_TEST_CASE(test_async_block_log_append)
+{
+   tester chain;
+   chain.produce_blocks(45);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log source(cfg.blocks_dir);
+   const uint32_t head_num = source.head()->block_num();
+
+   fc::temp_directory tempdir;
+   block_log_partition_config partitions;
+   partitions.stride = 10;
+   {
+      block_log blog(tempdir.path(), true, partitions);
+      blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), source.read_block_by_num(1));
+      for (uint32_t n = 2; n <= head_num; ++n) {
+         const auto b = source.read_block_by_num(n);
+         blog.prepare_append(b);
+         blog.append_async(b);
+         // readable whether it is still queued or already written
+         BOOST_REQUIRE(blog.head_id() == b->id());
+         BOOST_REQUIRE(blog.read_block_id_by_num(n) == b->id());
+         BOOST_REQUIRE(blog.read_serialized_block_by_num(n) == fc::raw::pack(*b));
+      }
+      blog.flush();
+      BOOST_REQUIRE_EQUAL(blog.log_first_block_num(), head_num - head_num % 10 + 1);
+   }
+
+   block_log reopened(tempdir.path(), true, partitions);
+   BOOST_REQUIRE(reopened.head_id() == source.head_id());
+   for (uint32_t n = 1; n <= head_num; ++n)
+      BOOST_REQUIRE(reopened.read_block_by_num(n)->id() == source.read_block_id_by_num(n));
+}
+
+BOOST_AUTO_TEST_CASE(test_trx_block_index)
+{
+   tester chain;
+   vector<std::pair<transaction_id_type, uint32_t>> trxs;
+   for (auto a : {N(alice), N(bob), N(carol), N(dave)}) {
+      auto trace = chain.create_account(a);
+      trxs.emplace_back(trace->id, trace->block_num);
+      chain.produce_block();
+   }
+   // the last one is still reversible
+   BOOST_REQUIRE(!chain.control->has_trx_index());
+   BOOST_REQUIRE_EQUAL(*chain.control->get_transaction_block(trxs.back().first), trxs.back().second);
+   BOOST_REQUIRE(!chain.control->get_transaction_block(transaction_id_type()));
+   chain.produce_blocks(5);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   const auto verify = [&](const auto& find) {
+      for (const auto& t : trxs) {
+         const auto block_nums = find(t.first);
+         BOOST_REQUIRE(std::find(block_nums.begin(), block_nums.end(), t.second) != block_nums.end());
+      }
+      BOOST_REQUIRE(find(transaction_id_type()).empty());
+   };
+
+   // built from the whole log when first kept, then while appending
+   const auto head_num = [&]() {
+      block_log blog(cfg.blocks_dir);
+      blog.open_trx_index();
+      BOOST_REQUIRE(blog.has_trx_index());
+      verify([&](const transaction_id_type& id) { return blog.find_trx_block_nums(id); });
+      return blog.head()->block_num();
+   }();
+   {
+      fc::temp_directory tempdir;
+      block_log source(cfg.blocks_dir);
+      block_log blog(tempdir.path());
+      blog.open_trx_index();
+      blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), source.read_block_by_num(1));
+      for (uint32_t n = 2; n <= head_num; ++n)
+         blog.append_async(source.read_block_by_num(n));
+      verify([&](const transaction_id_type& id) { return blog.find_trx_block_nums(id); });
+      blog.flush();
+      verify([&](const transaction_id_type& id) { return blog.find_trx_block_nums(id); });
+   }
+
+   // rebuilt in parallel like eosio-blocklog does
+   fc::temp_directory tempdir;
+   const auto index_file = tempdir.path() / "trx.index";
+   block_log::construct_trx_index(cfg.blocks_dir, index_file, 4);
+   trx_block_index index(index_file);
+   BOOST_REQUIRE_EQUAL(index.last_block_num(), head_num);
+   verify([&](const transaction_id_type& id) { return index.find(id); });
+
+   // the controller finds irreversible transactions through it
+   cfg.trx_index = true;
+   chain.init(cfg);
+   BOOST_REQUIRE(chain.control->has_trx_index());
+   for (const auto& t : trxs)
+      BOOST_REQUIRE_EQUAL(*chain.control->get_transaction_block(t.first), t.second);
+}
+
+BOOST_AUTO_TEST_CASE(test_account_bloom_index)
+{
+   tester chain;
+   chain.create_accounts({N(alice), N(bob)});
+   chain.produce_blocks(30);
+   chain.set_authority(N(alice), N(spare), authority(chain.get_public_key(N(alice), "spare")), config::active_name);
+   const uint32_t alice_block = chain.produce_block()->block_num();
+   chain.produce_blocks(30);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log source(cfg.blocks_dir);
+   const uint32_t head_num = source.head()->block_num();
+   const auto b = source.read_block_by_num(alice_block);
+   BOOST_REQUIRE(account_bloom_index::touches(*b, N(alice), {}));
+   BOOST_REQUIRE(account_bloom_index::touches(*b, N(alice), N(updateauth)));
+   BOOST_REQUIRE(account_bloom_index::touches(*b, {}, N(updateauth)));
+   BOOST_REQUIRE(!account_bloom_index::touches(*b, N(alice), N(newaccount)));
+   BOOST_REQUIRE(!account_bloom_index::touches(*b, N(bob), {}));
+
+   using ranges = vector<std::pair<uint32_t, uint32_t>>;
+   using account_opt = fc::optional<account_name>;
+   using action_opt = fc::optional<action_name>;
+   const auto blocks_of = [](const ranges& r) {
+      uint32_t blocks = 0;
+      for (const auto& p : r)
+         blocks += p.second - p.first + 1;
+      return blocks;
+   };
+   const auto verify = [&](const auto& find) {
+      const auto r = find(account_opt(N(alice)), action_opt(N(updateauth)));
+      BOOST_REQUIRE(std::any_of(r.begin(), r.end(), [&](const auto& p) { return p.first <= alice_block && alice_block <= p.second; }));
+      BOOST_REQUIRE(find(account_opt(N(nobody)), action_opt()).empty());
+      BOOST_REQUIRE(find(account_opt(), action_opt()) == (ranges{{1, head_num}}));
+      return blocks_of(r);
+   };
+
+   // ranges of 4 blocks, added block by block, most of them are ruled out
+   fc::temp_directory tempdir;
+   const auto small_file = tempdir.path() / "small.bloom";
+   {
+      account_bloom_index index(small_file, 4, 256);
+      for (uint32_t n = 1; n <= head_num; ++n)
+         index.add(*source.read_block_by_num(n));
+      BOOST_REQUIRE_LT(verify([&](const account_opt& account, const action_opt& action) { return index.find(1, head_num, account, action); }), head_num / 2);
+      // blocks past the last indexed are returned whole
+      index.set_last_block_num(alice_block - 1);
+      BOOST_REQUIRE(index.find(1, head_num, N(nobody), {}) == (ranges{{alice_block, head_num}}));
+      index.set_last_block_num(head_num);
+   }
+   {
+      account_bloom_index reopened(small_file);
+      BOOST_REQUIRE_EQUAL(reopened.blocks_per_range(), 4u);
+      BOOST_REQUIRE_EQUAL(reopened.last_block_num(), head_num);
+      verify([&](const account_opt& account, const action_opt& action) { return reopened.find(1, head_num, account, action); });
+   }
+
+   // built from the whole log when first kept
+   {
+      block_log blog(cfg.blocks_dir);
+      blog.open_account_index();
+      BOOST_REQUIRE(blog.has_account_index());
+      verify([&](const account_opt& account, const action_opt& action) { return blog.find_account_block_ranges(1, head_num, account, action); });
+   }
+
+   // rebuilt in parallel like eosio-blocklog does
+   const auto index_file = tempdir.path() / "accounts.bloom";
+   block_log::construct_account_index(cfg.blocks_dir, index_file, 4);
+   account_bloom_index index(index_file);
+   BOOST_REQUIRE_EQUAL(index.last_block_num(), head_num);
+   verify([&](const account_opt& account, const action_opt& action) { return index.find(1, head_num, account, action); });
+}
+
+BOOST_AUTO_TEST_CASE(test_read_serialized_block)
+{
+   tester chain;
+   chain.produce_blocks(10);
+   // reversible blocks are packed once, when added to the fork database, and the bytes are shared
+   const auto head_state = chain.control->head_block_state();
+   const auto head = head_state->block;
+   BOOST_REQUIRE(head_state->cached_packed_block());
+   BOOST_REQUIRE(head_state->packed_block() == head_state->cached_packed_block());
+   BOOST_REQUIRE(*head_state->packed_block() == fc::raw::pack(*head));
+   BOOST_REQUIRE(chain.control->fetch_serialized_block_by_number(head->block_num()) == fc::raw::pack(*head));
+   chain.close();
+
+   auto cfg = chain.get_config();
+   fc::temp_directory tempdir;
+   block_log::convert_log(cfg.blocks_dir, tempdir.path(), true);
+
+   block_log original(cfg.blocks_dir);
+   block_log compressed(tempdir.path());
+   const uint32_t head_num = original.head()->block_num();
+   for (uint32_t n = original.first_block_num(); n <= head_num; ++n) {
+      const auto packed = fc::raw::pack(*original.read_block_by_num(n));
+      BOOST_REQUIRE(original.read_serialized_block_by_num(n) == packed);
+      BOOST_REQUIRE(compressed.read_serialized_block_by_num(n) == packed);
+   }
+   BOOST_REQUIRE(original.read_serialized_block_by_num(head_num + 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_fork_database_journal)
+{
+   tester chain;
+   chain.produce_blocks(10);
+
+   // the journal is current without closing the chain, as if the process was killed
+   auto cfg = chain.get_config();
+   fc::temp_directory tempdir;
+   const auto journal = tempdir.path() / config::forkdb_journal_filename;
+   fc::copy(cfg.state_dir / config::forkdb_journal_filename, journal);
+   BOOST_REQUIRE(!fc::exists(cfg.state_dir / config::forkdb_filename));
+
+   const auto no_validation = [](block_timestamp_type, const flat_set<digest_type>&, const vector<digest_type>&) {};
+   {
+      fork_database fdb(tempdir.path());
+      fdb.open(no_validation);
+      BOOST_REQUIRE(fdb.head()->id == chain.control->fork_db_head_block_id());
+      BOOST_REQUIRE(fdb.root()->id == chain.control->last_irreversible_block_id());
+   }
+
+   // a record cut short is dropped
+   const auto journal_size = fc::file_size(journal);
+   boost::filesystem::resize_file(journal.generic_string(), journal_size - 1);
+   {
+      fork_database fdb(tempdir.path());
+      fdb.open(no_validation);
+      BOOST_REQUIRE(fdb.head());
+      BOOST_REQUIRE(fdb.head()->block_num <= chain.control->fork_db_head_block_num());
+   }
+   BOOST_REQUIRE(fc::file_size(journal) < journal_size - 1);
+
+   // restarting from the journal
+   chain.close();
+   chain.open();
+   chain.produce_blocks(3);
+}
+
+BOOST_AUTO_TEST_CASE(test_reversible_block_log)
+{
+   tester chain;
+   std::vector<signed_block_ptr> blocks;
+   for (int i = 0; i < 10; ++i)
+      blocks.push_back(chain.produce_block());
+
+   fc::temp_directory tempdir;
+   const auto log_path = tempdir.path() / config::reversible_blocks_log_filename;
+   {
+      reversible_block_log log(tempdir.path());
+      BOOST_REQUIRE(log.empty());
+      for (const auto& b : blocks)
+         log.append(b);
+      BOOST_REQUIRE_THROW(log.append(blocks[3]), reversible_blocks_exception);
+      BOOST_REQUIRE_EQUAL(log.first_block_num(), blocks.front()->block_num());
+      BOOST_REQUIRE_EQUAL(log.last_block_num(), blocks.back()->block_num());
+      for (const auto& b : blocks) {
+         BOOST_REQUIRE(log.read_block_id(b->block_num()) == b->id());
+         BOOST_REQUIRE(log.read_serialized_block(b->block_num()) == fc::raw::pack(*b));
+      }
+      BOOST_REQUIRE(!log.read_block(blocks.back()->block_num() + 1));
+
+      // irreversible blocks from the front, popped blocks from the back
+      log.remove_through(blocks[2]->block_num());
+      log.truncate_from(blocks[8]->block_num());
+      BOOST_REQUIRE_EQUAL(log.first_block_num(), blocks[3]->block_num());
+      BOOST_REQUIRE_EQUAL(log.last_block_num(), blocks[7]->block_num());
+      log.append(blocks[8]);
+   }
+
+   // the irreversible blocks that were not reclaimed yet are still in the file
+   const auto file_size = fc::file_size(log_path);
+   {
+      reversible_block_log log(tempdir.path(), true);
+      BOOST_REQUIRE(!log.dropped_partial_block());
+      BOOST_REQUIRE_EQUAL(log.first_block_num(), blocks.front()->block_num());
+      BOOST_REQUIRE_EQUAL(log.last_block_num(), blocks[8]->block_num());
+      BOOST_REQUIRE(log.read_block(blocks[8]->block_num())->id() == blocks[8]->id());
+   }
+
+   // a block cut short is dropped
+   boost::filesystem::resize_file(log_path.generic_string(), file_size - 1);
+   {
+      reversible_block_log log(tempdir.path());
+      BOOST_REQUIRE(log.dropped_partial_block());
+      BOOST_REQUIRE_EQUAL(log.last_block_num(), blocks[7]->block_num());
+      log.append(blocks[8]);
+   }
+   BOOST_REQUIRE_EQUAL(fc::file_size(log_path), file_size);
+
+   // restarting with the reversible blocks of the chain
+   chain.close();
+   chain.open();
+   chain.produce_blocks(3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,8 @@
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <boost/mpl/list.hpp>
@@ -167,9 +169,62 @@ struct buffered_snapshot_suite {
    }
 };
 
+struct compressed_snapshot_suite {
+   using writer_t = compressed_ostream_snapshot_writer;
+   using reader_t = compressed_istream_snapshot_reader;
+   using write_storage_t = std::ostringstream;
+   using snapshot_t = std::string;
+   using read_storage_t = std::istringstream;
+
+   struct writer : public writer_t {
+      writer( const std::shared_ptr<write_storage_t>& storage )
+      :writer_t(*storage)
+      ,storage(storage)
+      {
+
+      }
+
+      std::shared_ptr<write_storage_t> storage;
+   };
+
+   struct reader : public reader_t {
+      explicit reader(const std::shared_ptr<read_storage_t>& storage)
+      :reader_t(*storage)
+      ,storage(storage)
+      {}
+
+      std::shared_ptr<read_storage_t> storage;
+   };
+
+
+   static auto get_writer() {
+      return std::make_shared<writer>(std::make_shared<write_storage_t>());
+   }
+
+   static auto finalize(const std::shared_ptr<writer>& w) {
+      w->finalize();
+      return w->storage->str();
+   }
+
+   static auto get_reader( const snapshot_t& buffer) {
+      return std::make_shared<reader>(std::make_shared<read_storage_t>(buffer));
+   }
+
+   template<typename Snapshot>
+   static snapshot_t load_from_file() {
+      // compress the binary snapshot as is
+      const std::string bin = Snapshot::bin();
+      std::ostringstream out;
+      detail::compressed_snapshot_ostream compressed(out, compressed_ostream_snapshot_writer::default_chunk_size);
+      compressed.stream.write(bin.data(), bin.size());
+      compressed.buf.finish();
+      return out.str();
+   }
+};
+
 BOOST_AUTO_TEST_SUITE(snapshot_tests)
 
-using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite>;
+using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite, compressed_snapshot_suite>;
 
 namespace {
    void variant_diff_helper(const fc::variant& lhs, const fc::variant& rhs, std::function<void(const std::string&, const fc::variant&, const fc::variant&)>&& out){
@@ -581,4 +636,219 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_restart_with_existing_state_and_truncated_blo
    verify_integrity_hash<SNAPSHOT_SUITE>(*chain.control, *snap_chain.control);
 }
 
+BOOST_AUTO_TEST_CASE(test_concurrent_section_writer)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+   named_thread_pool pool("snaptest", 3);
+
+   const auto write_rows = [&db]( auto& section, size_t shard ) {
+      for( uint64_t row = 0; row < 100; ++row ) {
+         section.add_row(shard * 1000 + row, db);
+         section.add_row(std::string("row"), db);
+      }
+   };
+
+   // sequentially written sections
+   std::ostringstream expected_out;
+   ostream_snapshot_writer expected(expected_out);
+   sha256::encoder expected_enc;
+   integrity_hash_snapshot_writer expected_hash(expected_enc);
+   for( auto* w : std::vector<snapshot_writer*>{ &expected, &expected_hash } ) {
+      w->write_section("first", [&]( auto& section ) { write_rows(section, 0); });
+      w->write_section("sharded", [&]( auto& section ) {
+         for( size_t shard = 0; shard < 7; ++shard ) write_rows(section, shard);
+      });
+      w->write_section("empty", []( auto& ) {});
+   }
+   expected.finalize();
+
+   // the same sections written by shards on the thread pool
+   std::ostringstream actual_out;
+   ostream_snapshot_writer actual(actual_out);
+   sha256::encoder actual_enc;
+   integrity_hash_snapshot_writer actual_hash(actual_enc);
+   for( auto* w : std::vector<snapshot_writer*>{ &actual, &actual_hash } ) {
+      concurrent_section_writer sections(*w, pool.get_executor(), 2);
+      sections.add_section("first", [&]( auto& section ) { write_rows(section, 0); });
+      sections.add_section("sharded", 7, write_rows);
+      sections.add_section("empty", 0, write_rows);
+      sections.finish();
+   }
+   actual.finalize();
+
+   BOOST_REQUIRE(expected_out.str() == actual_out.str());
+   BOOST_REQUIRE(expected_enc.result() == actual_enc.result());
+
+   // sections are found through the section index in any order
+   std::istringstream in(actual_out.str());
+   istream_snapshot_reader reader(in);
+   reader.validate();
+   uint64_t value = 0;
+   reader.read_section("sharded", [&]( auto& section ) {
+      BOOST_REQUIRE(!section.empty());
+      section.read_row(value);
+   });
+   BOOST_REQUIRE_EQUAL(value, 0u);
+   std::string str;
+   reader.read_section("first", [&]( auto& section ) {
+      section.read_row(value);
+      section.read_row(str);
+   });
+   BOOST_REQUIRE_EQUAL(str, "row");
+   reader.read_section("empty", [&]( auto& section ) {
+      BOOST_REQUIRE(section.empty());
+   });
+   BOOST_REQUIRE_THROW(reader.read_section("missing", []( auto& ) {}), snapshot_exception);
+
+   // a failing shard is rethrown
+   std::ostringstream failed_out;
+   ostream_snapshot_writer failed(failed_out);
+   concurrent_section_writer sections(failed, pool.get_executor(), 2);
+   sections.add_section("failing", 3, [&]( auto& section, size_t shard ) {
+      EOS_ASSERT(shard != 1, snapshot_exception, "shard failed");
+      write_rows(section, shard);
+   });
+   BOOST_REQUIRE_THROW(sections.finish(), snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_snapshot_container)
+{
+   tester chain;
+   chain.produce_blocks(5);
+
+   std::ostringstream plain_out;
+   auto plain = std::make_shared<ostream_snapshot_writer>(plain_out);
+   chain.control->write_snapshot(plain);
+   plain->finalize();
+
+   std::ostringstream compressed_out;
+   // small chunks so that section sizes are patched after their chunks were compressed
+   auto compressed = std::make_shared<compressed_ostream_snapshot_writer>(compressed_out, 4096);
+   chain.control->write_snapshot(compressed);
+   compressed->finalize();
+   BOOST_REQUIRE(compressed_out.str().size() < plain_out.str().size());
+
+   // the container decompresses to the binary snapshot, including the section sizes patched after compression
+   std::istringstream in(compressed_out.str());
+   BOOST_REQUIRE(compressed_istream_snapshot_reader::is_compressed(in));
+   detail::compressed_snapshot_istream decompressed(in);
+   std::string data((std::istreambuf_iterator<char>(decompressed.stream)), std::istreambuf_iterator<char>());
+   BOOST_REQUIRE(data == plain_out.str());
+
+   // both forms are read through make_istream_snapshot_reader
+   std::istringstream plain_in(plain_out.str());
+   BOOST_REQUIRE(!compressed_istream_snapshot_reader::is_compressed(plain_in));
+   auto plain_reader = make_istream_snapshot_reader(plain_in);
+   plain_reader->validate();
+   std::istringstream compressed_in(compressed_out.str());
+   auto compressed_reader = make_istream_snapshot_reader(compressed_in);
+   compressed_reader->validate();
+   BOOST_REQUIRE(controller::extract_chain_id(*compressed_reader) == controller::extract_chain_id(*plain_reader));
+
+   // a truncated container is rejected
+   std::istringstream truncated(compressed_out.str().substr(0, compressed_out.str().size() - 1));
+   BOOST_REQUIRE_THROW(make_istream_snapshot_reader(truncated), snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot_delta)
+{
+   tester chain;
+   chain.create_accounts({N(alice), N(bob)});
+   chain.produce_blocks(5);
+
+   auto take_snapshot = [&]( bool compressed ) {
+      std::ostringstream out;
+      if( compressed ) {
+         auto writer = std::make_shared<compressed_ostream_snapshot_writer>(out);
+         chain.control->write_snapshot(writer);
+         writer->finalize();
+      } else {
+         auto writer = std::make_shared<ostream_snapshot_writer>(out);
+         chain.control->write_snapshot(writer);
+         writer->finalize();
+      }
+      return out.str();
+   };
+   const auto base = take_snapshot(false);
+   chain.create_accounts({N(carol)});
+   chain.produce_blocks(5);
+   const auto middle = take_snapshot(true);
+   chain.create_accounts({N(dave)});
+   chain.produce_blocks(5);
+   const auto target = take_snapshot(false);
+
+   auto write_delta = []( const std::string& from, const std::string& to ) {
+      std::istringstream from_in(from), to_in(to);
+      std::ostringstream out;
+      snapshot_delta::write(from_in, to_in, out);
+      return out.str();
+   };
+   auto apply_delta = []( const std::string& from, const std::string& delta ) {
+      std::istringstream from_in(from), delta_in(delta);
+      BOOST_REQUIRE(snapshot_delta::is_delta(delta_in));
+      std::ostringstream out;
+      snapshot_delta::apply(from_in, delta_in, out);
+      return out.str();
+   };
+
+   // a chain of deltas, the middle one read compressed, rebuilds the uncompressed target
+   const auto first = write_delta(base, middle);
+   const auto second = write_delta(middle, target);
+   BOOST_REQUIRE(second.size() < target.size());
+   const auto rebuilt = apply_delta(apply_delta(base, first), second);
+   BOOST_REQUIRE(rebuilt == target);
+   std::istringstream rebuilt_in(rebuilt);
+   make_istream_snapshot_reader(rebuilt_in)->validate();
+
+   // deltas only apply to their own base, in order
+   BOOST_REQUIRE_THROW(apply_delta(base, second), snapshot_exception);
+   std::istringstream not_a_delta(target);
+   BOOST_REQUIRE(!snapshot_delta::is_delta(not_a_delta));
+}
+
+BOOST_AUTO_TEST_CASE(test_rows_across_read_buffer)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+
+   // rows larger than the read buffer and rows straddling its boundary
+   const std::string large_row(detail::buffered_istream::buffer_size * 2 + 7, 'x');
+   const std::string small_row(1000, 'y');
+   std::ostringstream out;
+   ostream_snapshot_writer writer(out);
+   writer.write_section("rows", [&]( auto& section ) {
+      for( size_t i = 0; i < 2000; ++i ) {
+         section.add_row(small_row, db);
+      }
+      section.add_row(large_row, db);
+      section.add_row(uint64_t(42), db);
+   });
+   writer.write_section("after", [&]( auto& section ) {
+      section.add_row(uint64_t(7), db);
+   });
+   writer.finalize();
+
+   std::istringstream in(out.str());
+   istream_snapshot_reader reader(in);
+   reader.validate();
+   reader.read_section("rows", [&]( auto& section ) {
+      std::string row;
+      for( size_t i = 0; i < 2000; ++i ) {
+         BOOST_REQUIRE(section.read_row(row));
+         BOOST_REQUIRE(row == small_row);
+      }
+      BOOST_REQUIRE(section.read_row(row));
+      BOOST_REQUIRE(row == large_row);
+      uint64_t value = 0;
+      BOOST_REQUIRE(!section.read_row(value));
+      BOOST_REQUIRE_EQUAL(value, 42u);
+   });
+   reader.read_section("after", [&]( auto& section ) {
+      uint64_t value = 0;
+      section.read_row(value);
+      BOOST_REQUIRE_EQUAL(value, 7u);
+   });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
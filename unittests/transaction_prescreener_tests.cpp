@@ -0,0 +1,61 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/transaction_prescreener.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/contract_types.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+BOOST_AUTO_TEST_SUITE(transaction_prescreener_tests)
+
+transaction_metadata_ptr make_trx( tester& t, account_name account, const permission_level& auth, const string& memo ) {
+   return transaction_metadata::create_no_recover_keys( packed_transaction( t.make_onerror_transaction( memo, auth, account ) ),
+                                                        transaction_metadata::trx_type::input );
+}
+
+BOOST_AUTO_TEST_CASE( prescreen ) try {
+   tester t;
+   t.create_accounts( {N(alice), N(bob)} );
+   auto& rl = t.control->get_mutable_resource_limits_manager();
+   rl.set_account_limits( N(alice), -1, -1, 0 );
+   rl.set_account_limits( N(bob), -1, -1, 100 );
+   t.produce_block();
+
+   const fc::time_point block_time = t.control->pending_block_time();
+   transaction_prescreener p( *t.control, block_time );
+
+   auto ok = make_trx( t, config::system_account_name, {N(bob), config::active_name}, "ok" );
+   BOOST_CHECK( !p.screen( *ok, 0 ) );
+
+   auto unknown_account = make_trx( t, N(nobody), {N(bob), config::active_name}, "unknown account" );
+   BOOST_CHECK( p.screen( *unknown_account, 0 ) );
+
+   auto unknown_authority = make_trx( t, config::system_account_name, {N(bob), N(missing)}, "unknown authority" );
+   BOOST_CHECK( p.screen( *unknown_authority, 0 ) );
+
+   // alice has no CPU weight, bob is not estimated to use more than he has
+   auto no_cpu = make_trx( t, config::system_account_name, {N(alice), config::active_name}, "no cpu" );
+   BOOST_CHECK( p.screen( *no_cpu, 0 ) );
+   BOOST_CHECK( !p.screen( *ok, 1000 ) );
+
+   transaction_prescreener later( *t.control, fc::time_point( ok->packed_trx()->expiration() ) + fc::seconds( 1 ) );
+   BOOST_CHECK( later.screen( *ok, 0 ) );
+
+   // screened on worker threads, in the order given
+   named_thread_pool pool( "prescreen", 2 );
+   transaction_prescreener workers( *t.control, block_time );
+   workers.start( pool.get_executor(), 2, { {ok, 0}, {unknown_account, 0}, {unknown_authority, 0}, {no_cpu, 0} } );
+   const auto& failures = workers.stop();
+   BOOST_REQUIRE_EQUAL( workers.screened(), 4u );
+   BOOST_REQUIRE_EQUAL( failures.size(), 4u );
+   BOOST_CHECK( !failures[0] );
+   BOOST_CHECK( failures[1] );
+   BOOST_CHECK( failures[2] );
+   BOOST_CHECK( failures[3] );
+
+} FC_LOG_AND_RETHROW() /// prescreen
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,49 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/transaction_prevalidator.hpp>
+#include <eosio/chain/contract_types.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+BOOST_AUTO_TEST_SUITE(transaction_prevalidator_tests)
+
+BOOST_AUTO_TEST_CASE( prevalidate ) try {
+   tester t;
+   t.produce_blocks( 2 );
+
+   transaction_prevalidator v;
+   v.reset( t.control->db(), t.control->head_block_state(), t.control->get_global_properties().configuration );
+   auto c = t.control->accepted_block.connect( [&]( const block_state_ptr& bsp ) {
+      v.on_accepted_block( bsp, t.control->get_global_properties().configuration );
+   } );
+
+   // passes until a block includes it
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                            newaccount{ config::system_account_name, N(alice), authority( t.get_public_key( N(alice), "owner" ) ),
+                                        authority( t.get_public_key( N(alice), "active" ) ) } );
+   t.set_transaction_headers( trx );
+   trx.sign( t.get_private_key( config::system_account_name, "active" ), t.control->get_chain_id() );
+   BOOST_CHECK_NO_THROW( v.validate( packed_transaction( trx ) ) );
+   t.push_transaction( trx );
+   t.produce_block();
+   BOOST_CHECK_THROW( v.validate( packed_transaction( trx ) ), tx_duplicate );
+   BOOST_CHECK_EQUAL( v.recent_ids(), 1u );
+
+   auto expired = t.make_onerror_transaction( "expired" );
+   expired.expiration = fc::time_point_sec( t.control->head_block_time() ) - 1;
+   BOOST_CHECK_THROW( v.validate( packed_transaction( expired ) ), expired_tx_exception );
+
+   auto wrong_fork = t.make_onerror_transaction( "wrong fork" );
+   wrong_fork.ref_block_prefix += 1;
+   BOOST_CHECK_THROW( v.validate( packed_transaction( wrong_fork ) ), invalid_ref_block_exception );
+
+   auto too_big = t.make_onerror_transaction( string( 1024, 'x' ) );
+   too_big.max_net_usage_words = 16;
+   BOOST_CHECK_THROW( v.validate( packed_transaction( too_big ) ), tx_net_usage_exceeded );
+
+} FC_LOG_AND_RETHROW() /// prevalidate
+
+BOOST_AUTO_TEST_SUITE_END()
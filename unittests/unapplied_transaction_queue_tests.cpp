@@ -20,6 +20,18 @@ auto unique_trx_meta_data() {
    return transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::input );
 }
 
+auto trx_meta_data_expiring( uint32_t expiration_sec ) {
+   static uint64_t nextid = 0;
+   ++nextid;
+
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec( expiration_sec );
+   account_name creator = config::system_account_name;
+   trx.actions.emplace_back( vector<permission_level>{{creator,config::active_name}},
+                             onerror{ nextid, "expiring", 8 });
+   return transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::input );
+}
+
 auto next( unapplied_transaction_queue& q ) {
    transaction_metadata_ptr trx;
    auto itr = q.begin();
@@ -306,5 +318,98 @@ BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_test ) try {
 
 } FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_test
 
+BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_subjective_failure_backoff ) try {
+
+   unapplied_transaction_queue q;
+   auto trx1 = unique_trx_meta_data();
+   auto trx2 = unique_trx_meta_data();
+   q.add_aborted( { trx1, trx2 } );
+
+   auto itr = q.begin();
+   BOOST_REQUIRE( itr->trx_meta == trx1 );
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *itr, 10 ) );
+
+   // retried after 1, 2, 4 ... blocks while failing in a row
+   q.record_subjective_failure( itr, deadline_exception::code_value, fc::microseconds( 300 ), 10 );
+   BOOST_CHECK_EQUAL( itr->last_failure.count, 1u );
+   BOOST_CHECK_EQUAL( itr->last_failure.elapsed.count(), 300 );
+   BOOST_CHECK( !unapplied_transaction_queue::retry_due( *itr, 10 ) );
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *itr, 11 ) );
+
+   // failing again in the same block does not extend the backoff
+   q.record_subjective_failure( itr, block_cpu_usage_exceeded::code_value, fc::microseconds( 200 ), 10 );
+   BOOST_CHECK_EQUAL( itr->last_failure.count, 1u );
+   BOOST_CHECK_EQUAL( itr->last_failure.code, block_cpu_usage_exceeded::code_value );
+
+   q.record_subjective_failure( itr, deadline_exception::code_value, fc::microseconds( 300 ), 11 );
+   BOOST_CHECK( !unapplied_transaction_queue::retry_due( *itr, 12 ) );
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *itr, 13 ) );
+   q.record_subjective_failure( itr, deadline_exception::code_value, fc::microseconds( 300 ), 13 );
+   BOOST_CHECK( !unapplied_transaction_queue::retry_due( *itr, 16 ) );
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *itr, 17 ) );
+
+   for( uint32_t n = 0; n < 10; ++n )
+      q.record_subjective_failure( itr, deadline_exception::code_value, fc::microseconds( 300 ), 100 + 100*n );
+   BOOST_CHECK( !unapplied_transaction_queue::retry_due( *itr, 1000 + unapplied_transaction_queue::max_failure_backoff_blocks - 1 ) );
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *itr, 1000 + unapplied_transaction_queue::max_failure_backoff_blocks ) );
+
+   // other transactions are unaffected
+   BOOST_CHECK( unapplied_transaction_queue::retry_due( *(++q.begin()), 10 ) );
+
+} FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_subjective_failure_backoff
+
+BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_clear_expired ) try {
+
+   unapplied_transaction_queue q;
+   auto trx1 = trx_meta_data_expiring( 1000 );
+   auto trx2 = trx_meta_data_expiring( 1001 );
+   auto trx3 = trx_meta_data_expiring( 1001 );
+   auto trx4 = trx_meta_data_expiring( 1005 );
+   auto trx5 = trx_meta_data_expiring( 990 ); // already expired when queued
+   q.add_aborted( { trx2, trx4 } );
+   q.add_persisted( trx1 );
+   q.add_persisted( trx3 );
+   q.add_aborted( { trx5 } );
+
+   // trx2 leaves the queue before it expires, its stale id is skipped
+   auto itr = q.begin();
+   while( itr->trx_meta != trx2 ) ++itr;
+   q.erase( itr );
+
+   std::vector<transaction_id_type> expired;
+   auto record = [&]( const transaction_id_type& id, trx_enum_type ) { expired.push_back( id ); };
+   const auto no_deadline = fc::time_point::maximum();
+
+   BOOST_CHECK( q.clear_expired( fc::time_point( fc::seconds( 999 ) ), no_deadline, record ) );
+   BOOST_REQUIRE_EQUAL( expired.size(), 1u );
+   BOOST_CHECK( expired[0] == trx5->id() );
+
+   BOOST_CHECK( q.clear_expired( fc::time_point( fc::seconds( 1001 ) ), no_deadline, record ) );
+   BOOST_REQUIRE_EQUAL( expired.size(), 3u );
+   BOOST_CHECK( std::count( expired.begin(), expired.end(), trx1->id() ) == 1 );
+   BOOST_CHECK( std::count( expired.begin(), expired.end(), trx3->id() ) == 1 );
+   BOOST_CHECK_EQUAL( q.size(), 1u );
+   BOOST_CHECK( q.get_trx( trx4->id() ) == trx4 );
+
+   // a passed deadline stops before anything is removed, the next call picks up where it stopped
+   BOOST_CHECK( !q.clear_expired( fc::time_point( fc::seconds( 2000 ) ), fc::time_point(), record ) );
+   BOOST_CHECK_EQUAL( q.size(), 1u );
+   BOOST_CHECK( q.clear_expired( fc::time_point( fc::seconds( 2000 ) ), no_deadline, record ) );
+   BOOST_CHECK( q.empty() );
+   BOOST_CHECK( expired.back() == trx4->id() );
+
+   // re-queuing the same transactions over and over keeps working once stale ids are compacted away
+   auto trx6 = trx_meta_data_expiring( 3000 );
+   for( int i = 0; i < 5000; ++i ) {
+      q.add_aborted( { trx6 } );
+      BOOST_REQUIRE( next( q ) == trx6 );
+   }
+   q.add_aborted( { trx6 } );
+   BOOST_CHECK( q.clear_expired( fc::time_point( fc::seconds( 3000 ) ), no_deadline, record ) );
+   BOOST_CHECK( q.empty() );
+   BOOST_CHECK( expired.back() == trx6->id() );
+
+} FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_clear_expired
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -1017,6 +1017,34 @@ BOOST_FIXTURE_TEST_CASE(noop, TESTER) try {
 
  } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(wasm_cache_stats_test, TESTER) try {
+   produce_blocks(2);
+   create_accounts( {N(noop)} );
+   produce_block();
+
+   set_code(N(noop), contracts::noop_wasm());
+   set_abi(N(noop), contracts::noop_abi().data());
+   produce_block();
+
+   const auto before = control->get_wasm_cache_stats();
+   for( int i = 0; i < 2; ++i ) {
+      push_action( N(noop), N(anyaction), N(noop), mutable_variant_object()
+                   ("from", "noop")
+                   ("type", "some type")
+                   ("data", std::to_string(i)) );
+      produce_block();
+   }
+   const auto after = control->get_wasm_cache_stats();
+
+   // onblock runs the system contract too, so only the second anyaction is known to hit
+   BOOST_REQUIRE_GT( after.misses, 0u );
+   BOOST_REQUIRE_LT( before.hits, after.hits );
+   BOOST_REQUIRE_GT( after.resident_bytes, 0u );
+   BOOST_REQUIRE_GE( after.entries, 1u );
+   BOOST_REQUIRE_EQUAL( 0u, after.max_bytes );
+   BOOST_REQUIRE_EQUAL( 0u, after.evictions );
+} FC_LOG_AND_RETHROW()
+
 // abi_serializer::to_variant failed because eosio_system_abi modified via set_abi.
 // This test also verifies that chain_initializer::eos_contract_abi() does not conflict
 // with eosio_system_abi as they are not allowed to contain duplicates.